@@ -1,6 +1,14 @@
 [main]
 version                             = @PACKAGE_VERSION@
 invert_screenshots_colors           = false
+flag_frame_profiler                 = false
+frame_profiler_frames               = 120
+flag_render_stats                   = false
+flag_tracing                        = false
+flag_parallel_init                  = true
+flag_deferred_init                  = true
+flag_parallel_update                = true
+network_cache_size                  = 100
 
 [plugins_load_at_startup]
 Oculars                             = false
@@ -20,6 +28,48 @@ minimum_fps                         = 18
 maximum_fps                         = 10000
 #viewport_effect                     = sphericMirrorDistorter
 viewport_effect                     = none
+stereo_mode                         = none
+stereo_lens_offset                  = 0
+flag_stereo_reprojection            = false
+stereo_reprojection_margin          = 64
+stereo_frame_budget                 = 0.011
+stereo_lens_distortion              = 1,0,0,0
+stereo_chromatic_aberration         = 1,1
+viewport_samples                    = 0
+flag_foveated_rendering             = false
+foveated_periphery_scale            = 0.5
+foveated_inset_size                 = 0.4
+flag_dome_cubemap                   = false
+dome_cubemap_face_size              = 0
+flag_dynamic_resolution             = false
+dynamic_resolution_budget           = 0.014
+dynamic_resolution_min_scale        = 0.5
+dynamic_resolution_sharpness        = 0.2
+flag_temporal_antialiasing          = false
+temporal_antialiasing_feedback      = 0.9
+flag_live_output                    = false
+live_output_command                 = ffmpeg -f rawvideo -pix_fmt bgra -s %1x%2 -r %3 -i - -vf vflip -c:v libx264 -preset ultrafast -tune zerolatency -f mpegts srt://127.0.0.1:9000?mode=listener
+live_output_width                   = 0
+live_output_height                  = 0
+live_output_fps                     = 30
+head_pose_prediction                = 0
+texture_upload_budget               = 4
+flag_texture_upload_thread          = true
+texture_memory_budget               = 1024
+tile_prefetch_time                  = 0.3
+hips_max_parallel_requests          = 4
+flag_text_glyph_atlas               = true
+flag_shader_cache                   = true
+flag_idle_redraw                    = false
+idle_refresh_period                 = 10
+render_profile                      = default
+
+[low_power]
+flag_vertex_buffers_only            = true
+atmosphere_resolution               = 16
+atmosphere_rows_per_frame           = 4
+max_star_catalogs                   = 4
+max_sky_labels                      = 64
 
 [projection]
 type                                = ProjectionStereographic
@@ -48,6 +98,23 @@ distorter_max_fov                   = 180
 texture_triangle_base_length        = 8
 flag_use_ext_framebuffer_object     = false
 
+[warp_mesh]
+flag_enabled                        = false
+buffer_size                         = 2048
+nb_projectors                       = 0
+
+[viewports]
+nb_viewports                        = 0
+
+[sensors]
+flag_enabled                        = false
+format                              = opentrack
+port                                = 4242
+poll_rate                           = 1000
+axis_signs                          = 1,1,1
+max_prediction                      = 0.05
+gravity_time_constant               = 0.5
+
 [localization]
 sky_culture                         = western
 sky_locale                          = system
@@ -58,6 +125,7 @@ date_display_format                 = yyyymmdd
 
 [search]
 flag_search_online                  = true
+flag_parallel_object_search         = true
 simbad_server_url                   = http://simbad.u-strasbg.fr/
 
 [stars]
@@ -66,6 +134,12 @@ absolute_scale                      = 1.0
 star_twinkle_amount                 = 0.2
 flag_star_twinkle                   = true
 flag_point_star                     = false
+flag_star_vertex_buffers            = false
+flag_gpu_star_projection            = false
+flag_lazy_catalog_loading           = true
+flag_mmap_access_hints              = true
+position_cache_max_stars            = 2000000
+flag_parallel_drawing               = true
 
 #Johannes:
 #I recommend setting mag_converter_max_fov to 180, so that the sky gets not so
@@ -114,6 +188,7 @@ mouse_cursor_timeout                = 10
 flag_mouse_cursor_timeout           = false
 day_key_mode                        = calendar
 selected_object_info                = all
+info_panel_update_interval          = 200
 auto_hide_horizontal_toolbar        = true
 auto_hide_vertical_toolbar          = true
 
@@ -181,6 +256,11 @@ flag_fog                            = true
 flag_atmosphere                     = true
 flag_landscape_sets_location        = false
 atmosphere_fade_duration            = 0.5
+flag_atmosphere_gpu_luminance       = true
+atmosphere_reuse_threshold          = 0.01
+atmosphere_rows_per_frame           = 0
+flag_landscape_gpu_mesh             = true
+flag_async_loading                  = true
 # This is for people who require some minimum visibility for the landscapes
 minimal_brightness                  = 0.01
 flag_minimal_brightness             = false
@@ -193,6 +273,9 @@ flag_constellation_name             = false
 flag_constellation_art              = false
 flag_constellation_boundaries       = false
 flag_constellation_isolate_selected = false
+flag_gpu_constellations             = false
+flag_async_sky_culture_loading      = true
+flag_gpu_grid_lines                 = false
 flag_azimuthal_grid                 = false
 flag_equatorial_grid                = false
 flag_equatorial_J2000_grid          = false
@@ -221,10 +304,19 @@ flag_star_name                      = true
 flag_planets                        = true
 flag_planets_hints                  = false
 flag_planets_orbits                 = false
+flag_gpu_orbits                     = true
 flag_light_travel_time              = true
+flag_parallel_planet_positions      = true
+flag_ephemeris_cache                = false
+ephemeris_cache_window              = 4
+flag_batch_orbit_solver             = true
+flag_skip_faint_minor_planets       = true
+flag_dormant_minor_planets          = true
 flag_object_trails                  = false
 flag_nebula                         = true
 flag_nebula_name                    = false
+flag_label_culling                  = true
+max_sky_labels                      = 0
 flag_nebula_long_name               = false
 flag_nebula_display_no_texture      = false
 extinction_mode_below_horizon       = mirror
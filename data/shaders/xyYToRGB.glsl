@@ -24,10 +24,70 @@ attribute highp vec4 skyColor;
 // The output variable passed to the fragment shader
 varying mediump vec3 resultSkyColor;
 
+#ifdef GPU_LUMINANCE
+// Variables for the luminance computation (see Skybright.cpp)
+// When GPU_LUMINANCE is defined, the alpha channel of skyColor is not used
+// and the luminance is computed here from the unprojected vertex position.
+uniform highp vec3 moonPos;
+uniform highp float K, C3, C4;
+uniform highp float bMoonTerm1, bTwilightTerm, bNightTerm;
+uniform highp float eclipseFactor;
+uniform highp float lightPollutionLuminance;
+
+highp float pow10(highp float x)
+{
+	return exp(x*ln10);
+}
+
+// Port of Skybright::getLuminance()
+highp float getLuminance(highp float cosDistMoon, highp float cosDistSun, highp float cosDistZenith)
+{
+	// Air mass
+	highp float bKX = pow10(-0.4 * K * (1. / (cosDistZenith + 0.025*exp(-11.*cosDistZenith))));
+
+	// Daylight brightness
+	highp float distSun = acos(clamp(cosDistSun, -1., 1.));
+	highp float FSv = 18886.28 / (distSun*distSun + 0.0007)
+		+ pow10(6.15 - (distSun+0.001)* 1.43239)
+		+ 229086.77 * ( 1.06 + cosDistSun*cosDistSun );
+	highp float b_daylight = 9.289663e-12 * (1. - bKX) * (FSv * C4 + 440000. * (1. - C4));
+
+	// Twilight brightness
+	highp float b_twilight = pow10(bTwilightTerm + 0.063661977 * acos(clamp(cosDistZenith, -1., 1.))/max(K, 0.05)) * (1.7453293 / distSun) * (1.-bKX);
+
+	// Total sky brightness
+	highp float b_total = min(b_twilight, b_daylight);
+
+	// Moonlight brightness, don't compute if less than 1% daylight
+	if ((bMoonTerm1 * (1. - bKX) * (28860205.1341274269 * C3 + 440000. * (1. - C3)))/b_total>0.01)
+	{
+		cosDistMoon = min(cosDistMoon, 1.);
+		highp float dist_moon = acos(cosDistMoon);
+		highp float FM = 18886.28 / (dist_moon*dist_moon + 0.0005)
+			+ pow10(6.15 - dist_moon * 1.43239)
+			+ 229086.77 * ( 1.06 + cosDistMoon*cosDistMoon );
+		b_total += bMoonTerm1 * (1. - bKX) * (FM * C3 + 440000. * (1. - C3));
+	}
+
+	// Dark night sky brightness, don't compute if less than 1% daylight
+	if ((bNightTerm*bKX)/b_total>0.01)
+	{
+		b_total += (0.4 + 0.6 / sqrt(0.04 + 0.96 * cosDistZenith*cosDistZenith)) * bNightTerm * bKX;
+	}
+
+	return (b_total<0.) ? 0. : b_total * (900900.9 * pi * 1e-4 * 3239389.*2. *1.5);
+}
+#endif
+
 void main()
 {
 	gl_Position = projectionMatrix*vec4(skyVertex, 0., 1.);
 	highp vec4 color = skyColor;
+#ifdef GPU_LUMINANCE
+	// Same corrections as in Atmosphere::computeColor()
+	color[3] = getLuminance(dot(moonPos, color.xyz), dot(sunPos, color.xyz), color[2]);
+	color[3] = color[3]*eclipseFactor + 0.0001 + lightPollutionLuminance;
+#endif
 
 	///////////////////////////////////////////////////////////////////////////
 	// First compute the xy color component
@@ -0,0 +1,364 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "ClusterSync.hpp"
+#include "StelActionMgr.hpp"
+#include "StelApp.hpp"
+#include "StelCore.hpp"
+#include "StelModuleMgr.hpp"
+#include "StelMovementMgr.hpp"
+#include "StelTranslator.hpp"
+#include "StelUtils.hpp"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QUdpSocket>
+
+//! Marker at the beginning of all the datagrams.
+static const quint32 ClusterSyncMagic = 0x53544c43;
+
+StelModule* ClusterSyncStelPluginInterface::getStelModule() const
+{
+	return new ClusterSync();
+}
+
+StelPluginInfo ClusterSyncStelPluginInterface::getPluginInfo() const
+{
+	StelPluginInfo info;
+	info.id = "ClusterSync";
+	info.displayedName = N_("Cluster Sync");
+	info.authors = "Stellarium team";
+	info.contact = "www.stellarium.org";
+	info.description = N_("Synchronizes the date, view and displayed items of several instances of Stellarium over the network, and aligns the display of their frames. Used to drive a dome with several computers.");
+	info.version = CLUSTERSYNC_VERSION;
+	return info;
+}
+
+ClusterSync::ClusterSync()
+	: conf(NULL)
+	, mode(ModeNone)
+	, port(0)
+	, nodeId(0)
+	, nbSlaves(0)
+	, flagSwapBarrier(true)
+	, swapTimeout(50)
+	, fullStateInterval(60)
+	, viewOffsetAzimuth(0.)
+	, viewOffsetAltitude(0.)
+	, socket(NULL)
+	, frameNumber(0)
+	, statePending(false)
+	, hasState(false)
+	, swapReceived(false)
+{
+	setObjectName("ClusterSync");
+	conf = StelApp::getInstance().getSettings();
+}
+
+ClusterSync::~ClusterSync()
+{
+}
+
+double ClusterSync::getCallOrder(StelModuleActionName actionName) const
+{
+	// The master sends the state once all the other modules are updated, the slaves apply it before them.
+	// The swap barrier is at the end of the drawing.
+	if (actionName==StelModule::ActionUpdate)
+		return mode==ModeMaster ? 100000. : -100000.;
+	if (actionName==StelModule::ActionDraw)
+		return 100000.;
+	return 0;
+}
+
+void ClusterSync::init()
+{
+	// Because the plug-in has no configuration GUI, users rely on what's
+	// written in the configuration file to know what can be configured.
+	Q_ASSERT(conf);
+	if (!conf->childGroups().contains("ClusterSync"))
+		restoreDefaultConfiguration();
+	loadConfiguration();
+	if (mode==ModeNone)
+		return;
+
+	socket = new QUdpSocket(this);
+	if (!socket->bind(QHostAddress::AnyIPv4, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint) ||
+		!socket->joinMulticastGroup(groupAddress))
+	{
+		qWarning() << "ClusterSync: cannot join the multicast group" << groupAddress.toString() << "on port" << port << ":" << socket->errorString();
+		delete socket;
+		socket = NULL;
+		mode = ModeNone;
+		return;
+	}
+	// The nodes are expected to be on the same local network
+	socket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readPendingDatagrams()));
+
+	if (mode==ModeSlave)
+	{
+		// The view is entirely driven by the master
+		StelApp::getInstance().getCore()->getMovementMgr()->setFlagTracking(false);
+	}
+	qDebug() << "ClusterSync: running as" << (mode==ModeMaster ? "master" : "slave") << "node" << nodeId
+		 << "on" << groupAddress.toString() << "port" << port;
+}
+
+void ClusterSync::deinit()
+{
+	if (socket)
+	{
+		socket->leaveMulticastGroup(groupAddress);
+		delete socket;
+		socket = NULL;
+	}
+}
+
+void ClusterSync::loadConfiguration()
+{
+	Q_ASSERT(conf);
+	conf->beginGroup("ClusterSync");
+	const QString modeName = conf->value("mode", "none").toString();
+	mode = modeName=="master" ? ModeMaster : (modeName=="slave" ? ModeSlave : ModeNone);
+	groupAddress = QHostAddress(conf->value("multicast_group", "239.255.43.21").toString());
+	port = conf->value("port", 45454).toInt();
+	nodeId = conf->value("node_id", 0).toInt();
+	nbSlaves = conf->value("nb_slaves", 0).toInt();
+	flagSwapBarrier = conf->value("flag_swap_barrier", true).toBool();
+	swapTimeout = conf->value("swap_timeout_ms", 50).toInt();
+	fullStateInterval = qMax(1, conf->value("full_state_interval", 60).toInt());
+	viewOffsetAzimuth = conf->value("view_offset_azimuth", 0.).toDouble();
+	viewOffsetAltitude = conf->value("view_offset_altitude", 0.).toDouble();
+	conf->endGroup();
+}
+
+void ClusterSync::restoreDefaultConfiguration()
+{
+	Q_ASSERT(conf);
+	conf->remove("ClusterSync");
+	conf->beginGroup("ClusterSync");
+	conf->setValue("mode", "none");
+	conf->setValue("multicast_group", "239.255.43.21");
+	conf->setValue("port", 45454);
+	conf->setValue("node_id", 0);
+	conf->setValue("nb_slaves", 0);
+	conf->setValue("flag_swap_barrier", true);
+	conf->setValue("swap_timeout_ms", 50);
+	conf->setValue("full_state_interval", 60);
+	conf->setValue("view_offset_azimuth", 0.);
+	conf->setValue("view_offset_altitude", 0.);
+	conf->endGroup();
+}
+
+void ClusterSync::update(double)
+{
+	if (mode==ModeMaster)
+	{
+		++frameNumber;
+		sendState(StelApp::getInstance().getCore());
+	}
+	else if (mode==ModeSlave && hasState)
+	{
+		// The view is set after the core update, so that it uses the transformation matrices of the new date
+		StelCore* core = StelApp::getInstance().getCore();
+		Vec3d dir = state.viewDirectionJ2000;
+		if (viewOffsetAzimuth!=0. || viewOffsetAltitude!=0.)
+		{
+			double az, alt;
+			StelUtils::rectToSphe(&az, &alt, core->j2000ToAltAz(dir, StelCore::RefractionOff));
+			alt = qBound(-M_PI/2., alt + viewOffsetAltitude*M_PI/180., M_PI/2.);
+			StelUtils::spheToRect(az + viewOffsetAzimuth*M_PI/180., alt, dir);
+			dir = core->altAzToJ2000(dir, StelCore::RefractionOff);
+		}
+		core->getMovementMgr()->setViewDirectionJ2000(dir);
+	}
+}
+
+void ClusterSync::draw(StelCore*)
+{
+	if (mode!=ModeNone && flagSwapBarrier)
+		swapBarrier();
+}
+
+void ClusterSync::sendState(StelCore* core)
+{
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << ClusterSyncMagic << (quint8)MessageState << frameNumber;
+	out << core->getJDay();
+	out << core->getMovementMgr()->getViewDirectionJ2000() << core->getMovementMgr()->getCurrentFov();
+	out << (qint32)core->getCurrentProjectionType();
+
+	// Only the actions which changed are sent, and all of them regularly for the slaves which missed datagrams
+	const bool fullState = frameNumber%fullStateInterval==0;
+	QHash<QString, bool> actions;
+	StelActionMgr* actionMgr = StelApp::getInstance().getStelActionManager();
+	foreach (const QString& group, actionMgr->getGroupList())
+	{
+		foreach (const StelAction* action, actionMgr->getActionList(group))
+		{
+			if (!action->isCheckable())
+				continue;
+			const QString id = action->getId();
+			const bool checked = action->isChecked();
+			QHash<QString, bool>::ConstIterator iter = sentActions.constFind(id);
+			if (fullState || iter==sentActions.constEnd() || iter.value()!=checked)
+			{
+				actions.insert(id, checked);
+				sentActions.insert(id, checked);
+			}
+		}
+	}
+	out << actions;
+	socket->writeDatagram(data, groupAddress, port);
+}
+
+void ClusterSync::sendMessage(MessageType type, quint32 frame)
+{
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << ClusterSyncMagic << (quint8)type << frame << (qint32)nodeId;
+	socket->writeDatagram(data, groupAddress, port);
+}
+
+int ClusterSync::processDatagram(const QByteArray& data)
+{
+	QDataStream in(data);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, frame;
+	quint8 type;
+	in >> magic >> type >> frame;
+	if (in.status()!=QDataStream::Ok || magic!=ClusterSyncMagic)
+		return -1;
+
+	if (mode==ModeSlave && type==MessageState)
+	{
+		FrameState s;
+		qint32 projectionType;
+		in >> s.jd >> s.viewDirectionJ2000 >> s.fov >> projectionType >> s.actions;
+		if (in.status()!=QDataStream::Ok)
+			return -1;
+		s.projectionType = projectionType;
+		// Keep the changes of the actions of a state which was not applied yet
+		for (QHash<QString, bool>::ConstIterator iter=state.actions.constBegin();iter!=state.actions.constEnd();++iter)
+		{
+			if (!s.actions.contains(iter.key()))
+				s.actions.insert(iter.key(), iter.value());
+		}
+		state = s;
+		frameNumber = frame;
+		statePending = true;
+		swapReceived = false;
+		return type;
+	}
+	if (mode==ModeSlave && type==MessageSwap && frame==frameNumber)
+	{
+		swapReceived = true;
+		return type;
+	}
+	if (mode==ModeMaster && type==MessageReady && frame==frameNumber)
+	{
+		qint32 slave;
+		in >> slave;
+		readySlaves.insert(slave);
+		return type;
+	}
+	// The datagrams sent by the node itself are received too as it is in the group
+	return -1;
+}
+
+void ClusterSync::readPendingDatagrams()
+{
+	while (socket->hasPendingDatagrams())
+	{
+		QByteArray data;
+		data.resize(socket->pendingDatagramSize());
+		socket->readDatagram(data.data(), data.size());
+		processDatagram(data);
+	}
+	if (statePending)
+		applyPendingState();
+}
+
+void ClusterSync::applyPendingState()
+{
+	Q_ASSERT(mode==ModeSlave);
+	statePending = false;
+	hasState = true;
+	StelCore* core = StelApp::getInstance().getCore();
+	// The time is stopped on the slaves so that the core update keeps exactly the date of the master
+	core->setTimeRate(0.);
+	core->setJDay(state.jd);
+	core->getMovementMgr()->zoomTo(state.fov, 0.f);
+	if (core->getCurrentProjectionType()!=(StelCore::ProjectionType)state.projectionType)
+		core->setCurrentProjectionType((StelCore::ProjectionType)state.projectionType);
+
+	StelActionMgr* actionMgr = StelApp::getInstance().getStelActionManager();
+	for (QHash<QString, bool>::ConstIterator iter=state.actions.constBegin();iter!=state.actions.constEnd();++iter)
+	{
+		StelAction* action = actionMgr->findAction(iter.key());
+		if (action && action->isCheckable() && action->isChecked()!=iter.value())
+			action->setChecked(iter.value());
+	}
+	state.actions.clear();
+}
+
+void ClusterSync::swapBarrier()
+{
+	if (mode==ModeSlave)
+	{
+		if (!hasState)
+			return;
+		sendMessage(MessageReady, frameNumber);
+	}
+	else if (nbSlaves<=0)
+		return;
+
+	QElapsedTimer timer;
+	timer.start();
+	while (mode==ModeSlave ? !swapReceived : readySlaves.size()<nbSlaves)
+	{
+		// The slaves which finished drawing before the master already reported it
+		const int remaining = swapTimeout - (int)timer.elapsed();
+		if (remaining<=0 || !socket->waitForReadyRead(remaining))
+			break;
+		while (socket->hasPendingDatagrams())
+		{
+			QByteArray data;
+			data.resize(socket->pendingDatagramSize());
+			socket->readDatagram(data.data(), data.size());
+			processDatagram(data);
+		}
+	}
+
+	if (mode==ModeMaster)
+	{
+		sendMessage(MessageSwap, frameNumber);
+		readySlaves.clear();
+	}
+	else if (statePending)
+	{
+		// The state of the next frame arrived during the wait
+		applyPendingState();
+	}
+}
@@ -0,0 +1,155 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _CLUSTERSYNC_HPP_
+#define _CLUSTERSYNC_HPP_
+
+#include "StelModule.hpp"
+#include "VecMath.hpp"
+
+#include <QHash>
+#include <QHostAddress>
+#include <QSet>
+#include <QString>
+
+class QSettings;
+class QUdpSocket;
+
+//! @class ClusterSync
+//! Keep several instances of Stellarium running on different machines in sync, e.g. to drive
+//! the projectors of a dome. One instance is the master: it is controlled as usual, and at each
+//! frame it sends its state to the other instances, the slaves, over UDP multicast. The state
+//! contains the date, the view direction and field of view, the projection and
+//! the checked state of the checkable actions (only the changed ones, and all of them regularly).
+//! Each slave applies the state and draws its own part of the dome, given by an offset of the
+//! view in the alt-azimuthal frame.
+//! With the swap barrier enabled, each slave reports the end of the drawing of each frame and
+//! waits for the master, which waits for the reports of all the slaves before telling them to
+//! present the frame, so that all the nodes show the same frame at the same time. The waits
+//! are bounded by a timeout so that a missing node only slows down the other ones.
+//! The plug-in has no GUI, it is configured in the [ClusterSync] section of the configuration file.
+class ClusterSync : public StelModule
+{
+	Q_OBJECT
+public:
+	enum Mode
+	{
+		ModeNone,	//!< The plug-in does nothing
+		ModeMaster,	//!< The instance controls the slaves
+		ModeSlave	//!< The instance follows the master
+	};
+
+	ClusterSync();
+	virtual ~ClusterSync();
+
+	///////////////////////////////////////////////////////////////////////////
+	// Methods defined in the StelModule class
+	virtual void init();
+	virtual void deinit();
+	virtual void update(double deltaTime);
+	virtual void draw(StelCore* core);
+	virtual double getCallOrder(StelModuleActionName actionName) const;
+
+	Mode getMode() const {return mode;}
+
+public slots:
+	//! Load the plug-in's settings from the [ClusterSync] section of the configuration file.
+	void loadConfiguration();
+	//! Write the default settings in the configuration file.
+	void restoreDefaultConfiguration();
+
+private slots:
+	//! Read the datagrams received, outside of the swap barrier.
+	void readPendingDatagrams();
+
+private:
+	//! Types of the datagrams.
+	enum MessageType
+	{
+		MessageState=0,	//!< State of a frame, from the master
+		MessageReady=1,	//!< A slave has drawn a frame
+		MessageSwap=2	//!< The frame can be presented, from the master
+	};
+
+	//! The state of a frame sent by the master.
+	struct FrameState
+	{
+		double jd;
+		Vec3d viewDirectionJ2000;
+		double fov;
+		int projectionType;
+		//! Checked state of the actions which changed.
+		QHash<QString, bool> actions;
+	};
+
+	//! Send the state of the current frame to the slaves.
+	void sendState(StelCore* core);
+	//! Apply the date and field of view of the last state received, before the core update.
+	void applyPendingState();
+
+	//! Handle a received datagram, and return its type or -1 if it was not for this node.
+	int processDatagram(const QByteArray& data);
+	void sendMessage(MessageType type, quint32 frameNumber);
+	//! Wait at the end of the drawing of a frame until all the nodes have drawn it.
+	void swapBarrier();
+
+	QSettings* conf;
+	Mode mode;
+	QHostAddress groupAddress;
+	quint16 port;
+	int nodeId;
+	int nbSlaves;
+	bool flagSwapBarrier;
+	int swapTimeout;
+	int fullStateInterval;
+	double viewOffsetAzimuth;
+	double viewOffsetAltitude;
+
+	QUdpSocket* socket;
+	quint32 frameNumber;
+
+	//! Master: checked state of the actions sent to the slaves.
+	QHash<QString, bool> sentActions;
+	//! Master: slaves which reported the end of the current frame.
+	QSet<int> readySlaves;
+
+	//! Slave: last state received, and whether it was applied.
+	FrameState state;
+	bool statePending;
+	bool hasState;
+	//! Slave: whether the master allowed to present the current frame.
+	bool swapReceived;
+};
+
+
+#include <QObject>
+#include "StelPluginInterface.hpp"
+
+//! This class is used by Qt to manage a plug-in interface
+class ClusterSyncStelPluginInterface : public QObject, public StelPluginInterface
+{
+	Q_OBJECT
+	Q_PLUGIN_METADATA(IID "stellarium.StelGuiPluginInterface/1.0")
+	Q_INTERFACES(StelPluginInterface)
+public:
+	virtual StelModule* getStelModule() const;
+	virtual StelPluginInfo getPluginInfo() const;
+};
+
+#endif // _CLUSTERSYNC_HPP_
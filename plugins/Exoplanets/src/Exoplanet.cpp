@@ -25,6 +25,7 @@
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 #include "StelTexture.hpp"
+#include "StelTextureMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
 #include "StelModuleMgr.hpp"
@@ -39,7 +40,7 @@
 #include <QVariant>
 #include <QList>
 
-StelTextureSP Exoplanet::markerTexture;
+int Exoplanet::markerSprite = -1;
 bool Exoplanet::distributionMode = false;
 bool Exoplanet::timelineMode = false;
 bool Exoplanet::habitableMode = false;
@@ -464,11 +465,11 @@ void Exoplanet::draw(StelCore* core, StelPainter *painter)
 
 	if (mag <= mlimit)
 	{		
-		Exoplanet::markerTexture->bind();
+		StelApp::getInstance().getTextureManager().getSpriteAtlas()->bind();
 		float size = getAngularSize(NULL)*M_PI/180.*painter->getProjector()->getPixelPerRadAtCenter();
 		float shift = 5.f + size/1.6f;
 
-		painter->drawSprite2dMode(XYZ, distributionMode ? 4.f : 5.f);
+		painter->drawSprite2dMode(XYZ, distributionMode ? 4.f : 5.f, StelApp::getInstance().getTextureManager().getSpriteTexRect(markerSprite));
 
 		if (labelsFader.getInterstate()<=0.f && !distributionMode && (mag+1.f)<mlimit && smgr->getFlagLabels())
 		{
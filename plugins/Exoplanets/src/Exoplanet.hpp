@@ -113,7 +113,8 @@ private:
 	Vec3d XYZ;                         // holds J2000 position	
 
 	static StelTextureSP hintTexture;
-	static StelTextureSP markerTexture;
+	//! The id of the marker image in the sprite atlas.
+	static int markerSprite;
 	static Vec3f habitableExoplanetMarkerColor;
 	static Vec3f exoplanetMarkerColor;
 	static bool distributionMode;
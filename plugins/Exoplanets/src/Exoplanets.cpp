@@ -29,6 +29,7 @@
 #include "StelObjectMgr.hpp"
 #include "StelTextureMgr.hpp"
 #include "StelJsonParser.hpp"
+#include "StelBinaryCatalog.hpp"
 #include "StelFileMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
@@ -39,8 +40,6 @@
 #include "StelActionMgr.hpp"
 #include "StelProgressController.hpp"
 
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QKeyEvent>
 #include <QDebug>
 #include <QFileInfo>
@@ -88,7 +87,7 @@ Exoplanets::Exoplanets()
 	, EPCountAll(0)
 	, EPCountPH(0)
 	, updateState(CompleteNoUpdates)
-	, downloadMgr(NULL)
+	, updater(NULL)
 	, updateTimer(0)
 	, messageTimer(0)
 	, updatesEnabled(false)
@@ -118,7 +117,7 @@ Exoplanets::~Exoplanets()
 void Exoplanets::deinit()
 {
 	ep.clear();
-	Exoplanet::markerTexture.clear();
+	epIndex.clear();
 	texPointer.clear();
 }
 
@@ -164,7 +163,7 @@ void Exoplanets::init()
 			return;
 
 		texPointer = StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/pointeur2.png");
-		Exoplanet::markerTexture = StelApp::getInstance().getTextureManager().createTexture(":/Exoplanets/exoplanet.png");
+		Exoplanet::markerSprite = StelApp::getInstance().getTextureManager().addSprite(":/Exoplanets/exoplanet.png");
 
 		// key bindings and other actions
 		addAction("actionShow_Exoplanets", N_("Exoplanets"), N_("Show exoplanets"), "showExoplanets", "Ctrl+Alt+E");
@@ -186,6 +185,15 @@ void Exoplanets::init()
 	messageTimer->stop();
 	connect(messageTimer, SIGNAL(timeout()), this, SLOT(messageTimeout()));
 
+	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
+}
+
+//! Load the catalog and schedule its updates once the first frames are shown.
+void Exoplanets::deferredInit()
+{
+	if (jsonCatalogPath.isEmpty())
+		return;
+
 	// If the json file does not already exist, create it from the resource in the Qt resource
 	if(QFileInfo(jsonCatalogPath).exists())
 	{
@@ -205,16 +213,15 @@ void Exoplanets::init()
 	readJsonFile();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloadComplete(QNetworkReply*)));
+	updater = new StelCatalogUpdater("Exoplanets", jsonCatalogPath, this);
+	connect(updater, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(updateDownloadProgress(qint64,qint64)));
+	connect(updater, SIGNAL(finished(StelCatalogUpdater::Result)), this, SLOT(updateFinished(StelCatalogUpdater::Result)));
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
 	updateTimer->setInterval(13000);     // check once every 13 seconds to see if it is time for an update
 	connect(updateTimer, SIGNAL(timeout()), this, SLOT(checkForUpdate()));
 	updateTimer->start();
-
-	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
 }
 
 void Exoplanets::draw(StelCore* core)
@@ -226,11 +233,14 @@ void Exoplanets::draw(StelCore* core)
 	StelPainter painter(prj);
 	painter.setFont(font);
 	
+	// The markers share the same texture and blending, record them to draw them at once
+	painter.beginBatch();
 	foreach (const ExoplanetP& eps, ep)
 	{
 		if (eps && eps->initialized)
 			eps->draw(core, &painter);
 	}
+	painter.endBatch();
 
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer())
 		drawPointer(core, painter);
@@ -269,20 +279,10 @@ QList<StelObjectP> Exoplanets::searchAround(const Vec3d& av, double limitFov, co
 
 	Vec3d v(av);
 	v.normalize();
-	double cosLimFov = cos(limitFov * M_PI/180.);
-	Vec3d equPos;
-
-	foreach(const ExoplanetP& eps, ep)
+	const SphericalCap cap(v, cos(limitFov * M_PI/180.));
+	foreach(const StelRegionObjectP& obj, epIndex.getPointsInRegion(&cap))
 	{
-		if (eps->initialized)
-		{
-			equPos = eps->XYZ;
-			equPos.normalize();
-			if (equPos[0]*v[0] + equPos[1]*v[1] + equPos[2]*v[2]>=cosLimFov)
-			{
-				result.append(qSharedPointerCast<StelObject>(eps));
-			}
-		}
+		result.append(qSharedPointerCast<StelObject>(obj));
 	}
 
 	return result;
@@ -497,16 +497,7 @@ QVariantMap Exoplanets::loadEPMap(QString path)
 	if (path.isEmpty())
 	    path = jsonCatalogPath;
 
-	QVariantMap map;
-	QFile jsonFile(path);
-	if (!jsonFile.open(QIODevice::ReadOnly))
-		qWarning() << "Exoplanets: cannot open " << QDir::toNativeSeparators(path);
-	else
-	{
-		map = StelJsonParser::parse(jsonFile.readAll()).toMap();
-		jsonFile.close();
-	}
-	return map;
+	return StelBinaryCatalog::loadJsonCatalog(path);
 }
 
 /*
@@ -515,6 +506,7 @@ QVariantMap Exoplanets::loadEPMap(QString path)
 void Exoplanets::setEPMap(const QVariantMap& map)
 {
 	ep.clear();
+	epIndex.clear();
 	PSCount = EPCountAll = EPCountPH = 0;
 	QVariantMap epsMap = map.value("stars").toMap();
 	foreach(QString epsKey, epsMap.keys())
@@ -528,6 +520,7 @@ void Exoplanets::setEPMap(const QVariantMap& map)
 		if (eps->initialized)
 		{
 			ep.append(eps);
+			epIndex.insert(qSharedPointerCast<StelRegionObject>(eps));
 			EPCountAll += eps->getCountExoplanets();
 			EPCountPH += eps->getCountHabitableExoplanets();
 		}
@@ -594,7 +587,10 @@ ExoplanetP Exoplanets::getByID(const QString& id)
 bool Exoplanets::configureGui(bool show)
 {
 	if (show)
+	{
+		StelApp::getInstance().finishDeferredInit(this);
 		exoplanetsConfigDialog->setVisible(true);
+	}
 	return true;
 }
 
@@ -670,6 +666,11 @@ void Exoplanets::checkForUpdate(void)
 
 void Exoplanets::updateJSON(void)
 {
+	// The updater is created with the catalog
+	StelApp::getInstance().finishDeferredInit(this);
+	if (!updater)
+		return;
+
 	if (updateState==Exoplanets::Updating)
 	{
 		qWarning() << "Exoplanets: already updating...  will not start again current update is complete.";
@@ -693,46 +694,17 @@ void Exoplanets::updateJSON(void)
 	progressBar->setRange(0, 100);
 	progressBar->setFormat("Update exoplanets");
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(updateUrl));
-	request.setRawHeader("User-Agent", QString("Mozilla/5.0 (Stellarium Exoplanets Plugin %1; http://stellarium.org/)").arg(EXOPLANETS_PLUGIN_VERSION).toUtf8());
-	downloadMgr->get(request);
-
-	updateState = Exoplanets::CompleteUpdates;
-	emit(updateStateChanged(updateState));
-	emit(jsonUpdateComplete());
+	updater->update(QUrl(updateUrl), QString("Mozilla/5.0 (Stellarium Exoplanets Plugin %1; http://stellarium.org/)").arg(EXOPLANETS_PLUGIN_VERSION).toUtf8());
 }
 
-void Exoplanets::updateDownloadComplete(QNetworkReply* reply)
+void Exoplanets::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	// check the download worked, and save the data to file if this is the case.
-	if (reply->error() != QNetworkReply::NoError)
-	{
-		qWarning() << "Exoplanets: FAILED to download" << reply->url() << " Error: " << reply->errorString();
-	}
-	else
-	{
-		// download completed successfully.
-		try
-		{
-			QString jsonFilePath = StelFileMgr::findFile("modules/Exoplanets", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::Directory)) + "/exoplanets.json";
-			QFile jsonFile(jsonFilePath);
-			if (jsonFile.exists())
-				jsonFile.remove();
-
-			if (jsonFile.open(QIODevice::WriteOnly | QIODevice::Text))
-			{
-				jsonFile.write(reply->readAll());
-				jsonFile.close();
-			}
-		}
-		catch (std::runtime_error &e)
-		{
-			qWarning() << "Exoplanets: cannot write JSON data to file:" << e.what();
-		}
-
-	}
+	if (progressBar && bytesTotal > 0)
+		progressBar->setValue((int)(100 * bytesReceived / bytesTotal));
+}
 
+void Exoplanets::updateFinished(StelCatalogUpdater::Result result)
+{
 	if (progressBar)
 	{
 		progressBar->setValue(100);
@@ -740,7 +712,25 @@ void Exoplanets::updateDownloadComplete(QNetworkReply* reply)
 		progressBar = NULL;
 	}
 
-	readJsonFile();
+	switch (result)
+	{
+		case StelCatalogUpdater::Updated:
+			// The new catalog was parsed in a worker thread, it replaces the current one at once
+			setEPMap(updater->takeCatalog());
+			updateState = Exoplanets::CompleteUpdates;
+			break;
+		case StelCatalogUpdater::NotModified:
+			updateState = Exoplanets::CompleteNoUpdates;
+			break;
+		case StelCatalogUpdater::DownloadFailed:
+			updateState = Exoplanets::DownloadError;
+			break;
+		default:
+			updateState = Exoplanets::OtherError;
+			break;
+	}
+	emit(updateStateChanged(updateState));
+	emit(jsonUpdateComplete());
 }
 
 void Exoplanets::displayMessage(const QString& message, const QString hexColor)
@@ -20,9 +20,11 @@
 #define _EXOPLANETS_HPP_
 
 #include "StelObjectModule.hpp"
+#include "StelCatalogUpdater.hpp"
 #include "StelObject.hpp"
 #include "StelFader.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelSphericalIndex.hpp"
 #include "Exoplanet.hpp"
 #include <QFont>
 #include <QVariantMap>
@@ -30,8 +32,6 @@
 #include <QList>
 #include <QSharedPointer>
 
-class QNetworkAccessManager;
-class QNetworkReply;
 class QSettings;
 class QTimer;
 class ExoplanetsDialog;
@@ -62,8 +62,10 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in the StelModule class
 	virtual void init();
+	virtual void deferredInit();
 	virtual void deinit();
 	virtual void update(double deltaTime);
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true);}
 	virtual void draw(StelCore* core);
 	virtual void drawPointer(StelCore* core, StelPainter& painter);
 	virtual double getCallOrder(StelModuleActionName actionName) const;
@@ -241,10 +243,12 @@ private:
 
 	StelTextureSP texPointer;
 	QList<ExoplanetP> ep;
+	//! Spatial index of the objects of the list, used by searchAround().
+	StelSphericalIndex epIndex;
 
 	// variables and functions for the updater
 	UpdateState updateState;
-	QNetworkAccessManager* downloadMgr;
+	StelCatalogUpdater* updater;
 	QString updateUrl;	
 	QTimer* updateTimer;
 	QTimer* messageTimer;
@@ -268,7 +272,9 @@ private slots:
 	//! if the last update was longer than updateFrequencyHours ago then the update is
 	//! done.
 	void checkForUpdate(void);
-	void updateDownloadComplete(QNetworkReply* reply);
+	void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	//! Called when the updater is done, replaces the catalog if a new one was downloaded.
+	void updateFinished(StelCatalogUpdater::Result result);
 
 };
 
@@ -0,0 +1,10 @@
+-- Indexes on the columns used to filter and sort the observations and sessions,
+-- and by the triggers checking the references when a row is deleted.
+CREATE INDEX observations_session_idx ON observations(session_id);
+CREATE INDEX observations_target_idx ON observations(target_id);
+CREATE INDEX observations_observer_idx ON observations(observer_id);
+CREATE INDEX observations_begin_idx ON observations(begin);
+CREATE INDEX sessions_begin_idx ON sessions(begin);
+CREATE INDEX sessions_site_idx ON sessions(site_id);
+CREATE INDEX sessions_observer_idx ON sessions(observer_id);
+CREATE INDEX targets_name_idx ON targets(name);
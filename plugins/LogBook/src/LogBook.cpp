@@ -394,15 +394,13 @@ bool LogBook::createDatabaseStructures()
 					// update the record
 					updateQuery.bindValue(":new", currentFile);
 					updateQuery.bindValue(":old", lastFile);
-					QString sql("UPDATE logbook_system SET last_script_run = ");
-					sql.append(QVariant(currentFile).toString()).append(" WHERE last_script_run = ").append(QVariant(lastFile).toString());
-					if (query.exec(sql)) {
+					if (updateQuery.exec()) {
 						lastFile = currentFile;
 					} else {
 						result = false;
 						qDebug() << "LogBook: Error updateing system table; bind values are ("
-								 << updateQuery.boundValues() << ").  \n\tError is: " << query.lastError()
-								 << "\n\tThe query was: " << query.lastQuery() ;
+								 << updateQuery.boundValues() << ").  \n\tError is: " << updateQuery.lastError()
+								 << "\n\tThe query was: " << updateQuery.lastQuery() ;
 					}
 				}
 			}
@@ -424,24 +422,31 @@ bool LogBook::processSqlFile(QString &fileName)
 		qWarning() << "LogBook: could not process SQL file " << fileName;
 		result = false;
 	} else {
+		QSqlDatabase db = QSqlDatabase::database("LogBook");
+		QSqlQuery query(db);
+		// Without a transaction SQLite syncs the file after each statement
+		db.transaction();
 		QTextStream inStream(&file);
 		while (!inStream.atEnd()) {
 			QString line = inStream.readLine();
 			if (!line.startsWith("--") && !line.trimmed().size() == 0) {
-				if (!executeSql(line)) {
+				if (!executeSql(line, query)) {
 					result = false;
 				}
 			}
 		}
+		if (result) {
+			db.commit();
+		} else {
+			db.rollback();
+		}
 	}
 	qDebug() << "LogBook: finished processing SQL file  " << fileName;
 	return result;
 }
 
-bool LogBook::executeSql(QString &sql)
+bool LogBook::executeSql(QString &sql, QSqlQuery &query)
 {
-	QSqlDatabase db = QSqlDatabase::database("LogBook");
-	QSqlQuery query = QSqlQuery(db);
 	bool result = query.exec(sql);
 	if (!result) {
 		qWarning() << "LogBook: error executing SQL: " << query.lastError();
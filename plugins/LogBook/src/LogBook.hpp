@@ -74,8 +74,9 @@ private:
 	
 	//! executes a single SQL statement.
 	//! @param the SQL string.
+	//! @param query the query used to execute the statement, reused for all the lines of a file.
 	//! @return true if there was no error, false if there was an error.
-	bool executeSql(QString &sql);
+	bool executeSql(QString &sql, QSqlQuery &query);
 	
 	void initializeActions();
 	
@@ -87,6 +88,7 @@ private:
 	QByteArray nightStyleSheet;
 
 	//! reads a file line by line, and calls executeSql() with each line. Blank lines or SQL comments are ignored.
+	//! The whole file is executed in one transaction, so that the inserts are written to the disk at once.
 	//! @param the file name that contains the SQL.
 	//! @return true if there was no error, false if there was an error.
 	bool processSqlFile(QString &fileName);
@@ -444,6 +444,8 @@ void ObservationsDialog::setupModels()
 	observationsModel->setObjectName("Observations Table Model");
 	observationsModel->setRelation(3, QSqlRelation(TARGETS, "target_id", "name"));
 	observationsModel->setEditStrategy(QSqlTableModel::OnFieldChange);
+	// Sorted on the indexed date column, the rows are then fetched as the view scrolls
+	observationsModel->setSort(observationsModel->fieldIndex("begin"), Qt::AscendingOrder);
 	observationsModel->setFilter(QString("session_id = %1").arg(sessionKey));
 	observationsModel->select();
 	
@@ -313,6 +313,8 @@ void SessionsDialog::setupModels()
 	sessionsModel->setObjectName("Sessions Table Model");
 	sessionsModel->setRelation(3, QSqlRelation(SITES, "site_id", "name"));
 	sessionsModel->setEditStrategy(QSqlTableModel::OnFieldChange);
+	// Sorted on the indexed date column, the rows are then fetched as the view scrolls
+	sessionsModel->setSort(sessionsModel->fieldIndex("begin"), Qt::AscendingOrder);
 	sessionsModel->select();
 
 	fieldModels[QString(OBSERVERS)] = new FieldConcatModel(tableModels[OBSERVERS], QStringList() << "surname" << "name", ", " , this);
@@ -19,7 +19,6 @@
  */
 
 #include <QDir>
-#include <QNetworkReply>
 #include <QSettings>
 #include <QTimer>
 
@@ -81,7 +80,7 @@ MeteorShowers::MeteorShowers()
 	, GlowIcon(NULL)
 	, toolbarButton(NULL)
 	, updateState(CompleteNoUpdates)
-	, downloadMgr(NULL)
+	, updater(NULL)
 	, progressBar(NULL)
 	, updateTimer(0)
 	, messageTimer(0)
@@ -206,8 +205,9 @@ void MeteorShowers::init()
 	readJsonFile();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloadComplete(QNetworkReply*)));
+	updater = new StelCatalogUpdater("MeteorShowers", showersJsonPath, this);
+	connect(updater, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(updateDownloadProgress(qint64,qint64)));
+	connect(updater, SIGNAL(finished(StelCatalogUpdater::Result)), this, SLOT(updateFinished(StelCatalogUpdater::Result)));
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
@@ -369,21 +369,26 @@ void MeteorShowers::drawStream(StelCore* core, StelPainter& painter)
 		return;
 	}
 
+	float thickness, bolideSize;
+	Meteor::calculateThickness(core, thickness, bolideSize);
+
 	int index = 0;
 	if (active.size() > 0)
 	{
 		foreach (const activeData &a, activeInfo)
 		{
 			Q_UNUSED(a);
-			// step through and draw all active meteors
+			// step through all active meteors
 			std::vector<MeteorStream*>::iterator iter;
 			for (iter = active[index].begin(); iter != active[index].end(); ++iter)
 			{
-				(*iter)->draw(core, painter);
+				(*iter)->addToBatch(core, thickness, bolideSize, streamBatch);
 			}
 			index++;
 		}
 	}
+	// and draw the meteors of all the showers together
+	Meteor::drawBatch(painter, streamBatch);
 }
 
 int MeteorShowers::calculateZHR(int zhr, QString variable, QDateTime start, QDateTime finish, QDateTime peak)
@@ -577,6 +582,13 @@ void MeteorShowers::update(double deltaTime)
 		}
 	}
 
+	// The meteors of all the showers share the budget of the sporadic meteors
+	int nbMeteors = 0;
+	for (unsigned int i=0; i<active.size(); i++)
+	{
+		nbMeteors += active[i].size();
+	}
+
 	index = 0;
 	foreach (const activeData &current, activeInfo)
 	{
@@ -604,12 +616,13 @@ void MeteorShowers::update(double deltaTime)
 			mpf = 1;
 		}
 
-		for (int i=0; i<mpf; ++i)
+		for (int i=0; i<mpf && nbMeteors<MeteorMgr::MaxMeteors; ++i)
 		{
 			// start new meteor based on ZHR time probability
 			double prob = ((double)rand())/RAND_MAX;
 			if (ZHR>0 && prob<((double)ZHR*zhrToWsr*deltaTime/1000.0/(double)mpf))
 			{
+				++nbMeteors;
 				MeteorStream *m = new MeteorStream(core,
 								   current.speed,
 								   current.radiantAlpha,
@@ -1142,47 +1155,17 @@ void MeteorShowers::updateJSON(void)
 	progressBar->setRange(0, 100);
 	progressBar->setFormat("Update meteor showers");
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(updateUrl));
-	request.setRawHeader("User-Agent", QString("Mozilla/5.0 (Stellarium Meteor Showers Plugin %1; http://stellarium.org/)").arg(METEORSHOWERS_PLUGIN_VERSION).toUtf8());
-	downloadMgr->get(request);
-
-	updateState = MeteorShowers::CompleteUpdates;
-	emit(updateStateChanged(updateState));
-	emit(jsonUpdateComplete());
+	updater->update(QUrl(updateUrl), QString("Mozilla/5.0 (Stellarium Meteor Showers Plugin %1; http://stellarium.org/)").arg(METEORSHOWERS_PLUGIN_VERSION).toUtf8());
 }
 
-void MeteorShowers::updateDownloadComplete(QNetworkReply* reply)
+void MeteorShowers::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	// check the download worked, and save the data to file if this is the case.
-	if (reply->error() != QNetworkReply::NoError)
-	{
-		qWarning() << "MeteorShowers: FAILED to download" << reply->url() << " Error:" << reply->errorString();
-	}
-	else
-	{
-		// download completed successfully.
-		QString jsonFilePath = StelFileMgr::findFile("modules/MeteorShowers", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::Directory)) + "/showers.json";
-		if (jsonFilePath.isEmpty())
-		{
-			qWarning() << "MeteorShowers: cannot write JSON data to file";
-		}
-		else
-		{
-			QFile jsonFile(jsonFilePath);
-			if (jsonFile.exists())
-			{
-				jsonFile.remove();
-			}
-
-			if (jsonFile.open(QIODevice::WriteOnly | QIODevice::Text))
-			{
-				jsonFile.write(reply->readAll());
-				jsonFile.close();
-			}
-		}
-	}
+	if (progressBar && bytesTotal > 0)
+		progressBar->setValue((int)(100 * bytesReceived / bytesTotal));
+}
 
+void MeteorShowers::updateFinished(StelCatalogUpdater::Result result)
+{
 	if (progressBar)
 	{
 		progressBar->setValue(100);
@@ -1190,7 +1173,25 @@ void MeteorShowers::updateDownloadComplete(QNetworkReply* reply)
 		progressBar = NULL;
 	}
 
-	readJsonFile();
+	switch (result)
+	{
+		case StelCatalogUpdater::Updated:
+			// The new catalog was parsed in a worker thread, it replaces the current one at once
+			setShowersMap(updater->takeCatalog());
+			updateState = MeteorShowers::CompleteUpdates;
+			break;
+		case StelCatalogUpdater::NotModified:
+			updateState = MeteorShowers::CompleteNoUpdates;
+			break;
+		case StelCatalogUpdater::DownloadFailed:
+			updateState = MeteorShowers::DownloadError;
+			break;
+		default:
+			updateState = MeteorShowers::OtherError;
+			break;
+	}
+	emit(updateStateChanged(updateState));
+	emit(jsonUpdateComplete());
 }
 
 void MeteorShowers::displayMessage(const QString& message, const QString hexColor)
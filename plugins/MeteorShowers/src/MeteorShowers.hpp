@@ -26,10 +26,9 @@
 #include "MeteorShower.hpp"
 #include "MeteorStream.hpp"
 #include "StelObjectModule.hpp"
+#include "StelCatalogUpdater.hpp"
 
 class MeteorShowerDialog;
-class QNetworkAccessManager;
-class QNetworkReply;
 class StelButton;
 
 typedef QSharedPointer<MeteorShower> MeteorShowerP;
@@ -331,7 +330,7 @@ private:
 
 	// variables and functions for the updater
 	UpdateState updateState;
-	QNetworkAccessManager* downloadMgr;
+	StelCatalogUpdater* updater;
 	QString updateUrl;
 	QString updateFile;
 	class StelProgressController* progressBar;
@@ -347,6 +346,7 @@ private:
 
 	//MS
 	std::vector<std::vector<MeteorStream*> > active;		// Matrix containing all active meteors
+	Meteor::DrawBatch streamBatch;	// Geometry of the meteors of all the showers, kept to reuse its memory
 	static const double zhrToWsr;  // factor to convert from zhr to whole earth per second rate
 
 	bool flagShowARG;  //! Show marker of active radiant based on generic data
@@ -378,7 +378,9 @@ private slots:
 	//! if the last update was longer than updateFrequencyHours ago then the update is
 	//! done.
 	void checkForUpdate(void);
-	void updateDownloadComplete(QNetworkReply* reply);
+	void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	//! Called when the updater is done, replaces the catalog if a new one was downloaded.
+	void updateFinished(StelCatalogUpdater::Result result);
 };
 
 
@@ -125,3 +125,14 @@ void MeteorStream::draw(const StelCore* core, StelPainter& sPainter)
 
 	Meteor::drawBolide(core, sPainter, meteor, m_viewMatrix, bolideSize);
 }
+
+void MeteorStream::addToBatch(const StelCore* core, float thickness, float bolideSize, Meteor::DrawBatch& batch) const
+{
+	if (!m_alive)
+	{
+		return;
+	}
+
+	Meteor::addTrain(core, meteor, m_viewMatrix, thickness, m_segments, m_lineColorArray, m_trainColorArray, batch);
+	Meteor::addBolide(core, meteor, m_viewMatrix, bolideSize, batch);
+}
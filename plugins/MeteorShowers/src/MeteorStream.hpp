@@ -55,6 +55,10 @@ public:
 	//! Draws the meteor.
 	void draw(const StelCore* core, StelPainter& sPainter);
 
+	//! Add the meteor to a batch drawn with Meteor::drawBatch(),
+	//! with the sizes computed by Meteor::calculateThickness().
+	void addToBatch(const StelCore* core, float thickness, float bolideSize, Meteor::DrawBatch& batch) const;
+
 private:
 	bool m_alive;             //! Indicate if the meteor it still visible
 
@@ -70,6 +70,7 @@ Nova::Nova(const QVariantMap& map)
 	RA = StelUtils::getDecAngle(map.value("RA").toString());
 	Dec = StelUtils::getDecAngle(map.value("Dec").toString());	
 	distance = map.value("distance").toDouble();
+	StelUtils::spheToRect(RA, Dec, XYZ);
 
 	initialized = true;
 }
@@ -288,34 +289,16 @@ void Nova::update(double deltaTime)
 	labelsFader.update((int)(deltaTime*1000));
 }
 
-void Nova::draw(StelCore* core, StelPainter* painter)
+void Nova::drawLabel(StelCore* core, StelPainter* painter, float mag)
 {
-	StelSkyDrawer* sd = core->getSkyDrawer();
 	StarMgr* smgr = GETSTELMODULE(StarMgr); // It's need for checking displaying of labels for stars
-
-	Vec3f color = Vec3f(1.f,1.f,1.f);
-	RCMag rcMag;
-	float size, shift;
-	double mag;
-
-	StelUtils::spheToRect(RA, Dec, XYZ);
-	mag = getVMagnitudeWithExtinction(core);
-	sd->preDrawPointSource(painter);
-	float mlimit = sd->getLimitMagnitude();
-
-	if (mag <= mlimit)
+	const float mlimit = core->getSkyDrawer()->getLimitMagnitude();
+	if (labelsFader.getInterstate()<=0.f && (mag+5.f)<mlimit && smgr->getFlagLabels())
 	{
-		sd->computeRCMag(mag, &rcMag);
-		sd->drawPointSource(painter, Vec3f(XYZ[0], XYZ[1], XYZ[2]), rcMag, color, false);
-		painter->setColor(color[0], color[1], color[2], 1);
-		size = getAngularSize(NULL)*M_PI/180.*painter->getProjector()->getPixelPerRadAtCenter();
-		shift = 6.f + size/1.8f;
-		if (labelsFader.getInterstate()<=0.f && (mag+5.f)<mlimit && smgr->getFlagLabels())
-		{
-			QString name = novaName.isEmpty() ? designation : novaName;
-			painter->drawText(XYZ, name, 0, shift, shift, false);
-		}
+		painter->setColor(1.f, 1.f, 1.f, 1.f);
+		const float size = getAngularSize(NULL)*M_PI/180.*painter->getProjector()->getPixelPerRadAtCenter();
+		const float shift = 6.f + size/1.8f;
+		QString name = novaName.isEmpty() ? designation : novaName;
+		painter->drawText(XYZ, name, 0, shift, shift, false);
 	}
-
-	sd->postDrawPointSource(painter);
 }
@@ -76,7 +76,9 @@ private:
 
 	Vec3d XYZ;                         // holds J2000 position
 
-	void draw(StelCore* core, StelPainter* painter);
+	//! Draw the label of the nova, once its point source was drawn by Novae.
+	//! @param mag the magnitude of the nova with the extinction.
+	void drawLabel(StelCore* core, StelPainter* painter, float mag);
 
 	// Nova
 	QString designation;		//! The ID of the nova
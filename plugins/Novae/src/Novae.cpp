@@ -27,6 +27,7 @@
 #include "StelModuleMgr.hpp"
 #include "StelObjectMgr.hpp"
 #include "StelJsonParser.hpp"
+#include "StelBinaryCatalog.hpp"
 #include "StelFileMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelPainter.hpp"
@@ -38,8 +39,6 @@
 #include "NovaeDialog.hpp"
 #include "StelProgressController.hpp"
 
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QKeyEvent>
 #include <QProgressBar>
 #include <QDebug>
@@ -85,8 +84,9 @@ StelPluginInfo NovaeStelPluginInterface::getPluginInfo() const
 Novae::Novae()
 	: NovaCnt(0)
 	, texPointer(NULL)
+	, novaCatalogJD(0.)
 	, updateState(CompleteNoUpdates)
-	, downloadMgr(NULL)
+	, updater(NULL)
 	, progressBar(NULL)
 	, updateTimer(NULL)
 	, messageTimer(NULL)
@@ -157,6 +157,15 @@ void Novae::init()
 	messageTimer->stop();
 	connect(messageTimer, SIGNAL(timeout()), this, SLOT(messageTimeout()));
 
+	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
+}
+
+//! Load the catalog and schedule its updates once the first frames are shown.
+void Novae::deferredInit()
+{
+	if (novaeJsonPath.isEmpty())
+		return;
+
 	// If the json file does not already exist, create it from the resource in the Qt resource
 	if(QFileInfo(novaeJsonPath).exists())
 	{
@@ -176,16 +185,15 @@ void Novae::init()
 	readJsonFile();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloadComplete(QNetworkReply*)));
+	updater = new StelCatalogUpdater("Novae", novaeJsonPath, this);
+	connect(updater, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(updateDownloadProgress(qint64,qint64)));
+	connect(updater, SIGNAL(finished(StelCatalogUpdater::Result)), this, SLOT(updateFinished(StelCatalogUpdater::Result)));
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
 	updateTimer->setInterval(13000);     // check once every 13 seconds to see if it is time for an update
 	connect(updateTimer, SIGNAL(timeout()), this, SLOT(checkForUpdate()));
 	updateTimer->start();
-
-	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
 }
 
 /*
@@ -196,15 +204,24 @@ void Novae::draw(StelCore* core)
 	StelProjectorP prj = core->getProjection(StelCore::FrameJ2000);
 	StelPainter painter(prj);
 	painter.setFont(font);
-	
-	foreach (const NovaP& n, nova)
+
+	// The magnitudes of the novae only change with the date
+	if (core->getJDay()!=novaCatalogJD)
 	{
-		if (n && n->initialized)
-		{
-			n->draw(core, &painter);
-		}
+		QVector<float> magnitudes;
+		magnitudes.reserve(nova.size());
+		foreach (const NovaP& n, nova)
+			magnitudes.append(n->getVMagnitude(core));
+		novaCatalog.setMagnitudes(magnitudes);
+		novaCatalogJD = core->getJDay();
 	}
 
+	QVector<int> visible;
+	QVector<float> magnitudes;
+	novaCatalog.draw(core, &painter, &visible, &magnitudes);
+	for (int i=0;i<visible.size();++i)
+		nova.at(visible.at(i))->drawLabel(core, &painter, magnitudes.at(i));
+
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer())
 	{
 		drawPointer(core, painter);
@@ -240,20 +257,10 @@ QList<StelObjectP> Novae::searchAround(const Vec3d& av, double limitFov, const S
 
 	Vec3d v(av);
 	v.normalize();
-	double cosLimFov = cos(limitFov * M_PI/180.);
-	Vec3d equPos;
-
-	foreach(const NovaP& n, nova)
+	const SphericalCap cap(v, cos(limitFov * M_PI/180.));
+	foreach(const StelRegionObjectP& obj, novaIndex.getPointsInRegion(&cap))
 	{
-		if (n->initialized)
-		{
-			equPos = n->XYZ;
-			equPos.normalize();
-			if (equPos[0]*v[0] + equPos[1]*v[1] + equPos[2]*v[2]>=cosLimFov)
-			{
-				result.append(qSharedPointerCast<StelObject>(n));
-			}
-		}
+		result.append(qSharedPointerCast<StelObject>(obj));
 	}
 
 	return result;
@@ -469,16 +476,7 @@ QVariantMap Novae::loadNovaeMap(QString path)
 	if (path.isEmpty())
 	    path = novaeJsonPath;
 
-	QVariantMap map;
-	QFile jsonFile(path);
-	if (!jsonFile.open(QIODevice::ReadOnly))
-		qWarning() << "Novae: cannot open" << QDir::toNativeSeparators(path);
-	else
-	{
-		map = StelJsonParser::parse(jsonFile.readAll()).toMap();
-		jsonFile.close();
-	}
-	return map;
+	return StelBinaryCatalog::loadJsonCatalog(path);
 }
 
 /*
@@ -487,6 +485,7 @@ QVariantMap Novae::loadNovaeMap(QString path)
 void Novae::setNovaeMap(const QVariantMap& map)
 {
 	nova.clear();
+	novaIndex.clear();
 	novalist.clear();
 	NovaCnt=0;
 	QVariantMap novaeMap = map.value("nova").toMap();
@@ -500,9 +499,23 @@ void Novae::setNovaeMap(const QVariantMap& map)
 
 		NovaP n(new Nova(novaeData));
 		if (n->initialized)
+		{
 			nova.append(n);
+			novaIndex.insert(qSharedPointerCast<StelRegionObject>(n));
+		}
 
 	}
+
+	QVector<Vec3d> positions;
+	QVector<float> magnitudes;
+	foreach (const NovaP& n, nova)
+	{
+		positions.append(n->XYZ);
+		magnitudes.append(n->minMagnitude);
+	}
+	novaCatalog.setPoints(positions, magnitudes, QVector<Vec3f>(nova.size(), Vec3f(1.f,1.f,1.f)));
+	// Compute the magnitudes at the next drawing
+	novaCatalogJD = 0.;
 }
 
 int Novae::getJsonFileVersion(void)
@@ -564,7 +577,10 @@ NovaP Novae::getByID(const QString& id)
 bool Novae::configureGui(bool show)
 {
 	if (show)
+	{
+		StelApp::getInstance().finishDeferredInit(this);
 		configDialog->setVisible(true);
+	}
 	return true;
 }
 
@@ -626,6 +642,11 @@ void Novae::checkForUpdate(void)
 
 void Novae::updateJSON(void)
 {
+	// The updater is created with the catalog
+	StelApp::getInstance().finishDeferredInit(this);
+	if (!updater)
+		return;
+
 	if (updateState==Novae::Updating)
 	{
 		qWarning() << "Novae: already updating...  will not start again current update is complete.";
@@ -650,51 +671,43 @@ void Novae::updateJSON(void)
 	progressBar->setFormat("Update novae");
 	
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(updateUrl));
-	request.setRawHeader("User-Agent", QString("Mozilla/5.0 (Stellarium Bright Novae Plugin %1; http://stellarium.org/)").arg(NOVAE_PLUGIN_VERSION).toUtf8());
-	downloadMgr->get(request);
-
-	updateState = Novae::CompleteUpdates;
-	emit(updateStateChanged(updateState));
-	emit(jsonUpdateComplete());
+	updater->update(QUrl(updateUrl), QString("Mozilla/5.0 (Stellarium Bright Novae Plugin %1; http://stellarium.org/)").arg(NOVAE_PLUGIN_VERSION).toUtf8());
 }
 
-void Novae::updateDownloadComplete(QNetworkReply* reply)
+void Novae::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	// check the download worked, and save the data to file if this is the case.
-	if (reply->error() != QNetworkReply::NoError)
-	{
-		qWarning() << "Novae: FAILED to download" << reply->url() << " Error: " << reply->errorString();
-	}
-	else
-	{
-		// download completed successfully.
-		QString jsonFilePath = StelFileMgr::findFile("modules/Novae", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::Directory)) + "/novae.json";
-		if (jsonFilePath.isEmpty())
-		{
-			qWarning() << "Novae: cannot write JSON data to file";
-		}
-		else
-		{
-			QFile jsonFile(jsonFilePath);
-			if (jsonFile.exists())
-				jsonFile.remove();
-
-			if(jsonFile.open(QIODevice::WriteOnly | QIODevice::Text))
-			{
-				jsonFile.write(reply->readAll());
-				jsonFile.close();
-			}
-		}
-	}
+	if (progressBar && bytesTotal > 0)
+		progressBar->setValue((int)(100 * bytesReceived / bytesTotal));
+}
 
+void Novae::updateFinished(StelCatalogUpdater::Result result)
+{
 	if (progressBar)
 	{
 		progressBar->setValue(100);
 		StelApp::getInstance().removeProgressBar(progressBar);
 		progressBar = NULL;
 	}
+
+	switch (result)
+	{
+		case StelCatalogUpdater::Updated:
+			// The new catalog was parsed in a worker thread, it replaces the current one at once
+			setNovaeMap(updater->takeCatalog());
+			updateState = Novae::CompleteUpdates;
+			break;
+		case StelCatalogUpdater::NotModified:
+			updateState = Novae::CompleteNoUpdates;
+			break;
+		case StelCatalogUpdater::DownloadFailed:
+			updateState = Novae::DownloadError;
+			break;
+		default:
+			updateState = Novae::OtherError;
+			break;
+	}
+	emit(updateStateChanged(updateState));
+	emit(jsonUpdateComplete());
 }
 
 void Novae::displayMessage(const QString& message, const QString hexColor)
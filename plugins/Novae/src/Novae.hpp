@@ -20,10 +20,13 @@
 #define _NOVAE_HPP_
 
 #include "StelObjectModule.hpp"
+#include "StelCatalogUpdater.hpp"
 #include "StelObject.hpp"
 #include "StelFader.hpp"
 #include "Nova.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelSphericalIndex.hpp"
+#include "StelPointCatalog.hpp"
 #include <QFont>
 #include <QVariantMap>
 #include <QDateTime>
@@ -31,8 +34,6 @@
 #include <QSharedPointer>
 #include <QHash>
 
-class QNetworkAccessManager;
-class QNetworkReply;
 class QProgressBar;
 class QSettings;
 class QTimer;
@@ -81,6 +82,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in the StelModule class
 	virtual void init();
+	virtual void deferredInit();
 	virtual void update(double) {;}
 	virtual void draw(StelCore* core);
 	virtual void drawPointer(StelCore* core, StelPainter& painter);
@@ -222,11 +224,16 @@ private:
 
 	StelTextureSP texPointer;
 	QList<NovaP> nova;
+	//! Spatial index of the objects of the list, used by searchAround().
+	StelSphericalIndex novaIndex;
+	//! The novae of the list drawn as point sources, with their magnitudes updated when the date changes.
+	StelPointCatalog novaCatalog;
+	double novaCatalogJD;
 	QHash<QString, double> novalist;
 
 	// variables and functions for the updater
 	UpdateState updateState;
-	QNetworkAccessManager* downloadMgr;
+	StelCatalogUpdater* updater;
 	QString updateUrl;
 	class StelProgressController* progressBar;
 	QTimer* updateTimer;
@@ -246,7 +253,9 @@ private slots:
 	//! if the last update was longer than updateFrequencyHours ago then the update is
 	//! done.
 	void checkForUpdate(void);
-	void updateDownloadComplete(QNetworkReply* reply);
+	void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	//! Called when the updater is done, replaces the catalog if a new one was downloaded.
+	void updateFinished(StelCatalogUpdater::Result result);
 
 };
 
@@ -47,6 +47,7 @@
 #include "StelObjectMgr.hpp"
 #include "StelObserver.hpp"
 #include "StelProjector.hpp"
+#include "StelRiseSet.hpp"
 #include "StelSkyDrawer.hpp"
 #include "StelUtils.hpp"
 #include "StelPainter.hpp"
@@ -93,6 +94,10 @@ Observability::Observability()
 	, ObserverLoc(0.)
 	, myPlanet(NULL)
 	, nDays(0)
+	, sunDataDays(0)
+	, planetDataDays(0)
+	, sunHChanged(false)
+	, yearlyReportChanged(false)
 	, dmyFormat(false)
 	, hasRisen(false)
 	, configChanged(false)
@@ -213,6 +218,8 @@ void Observability::updateMessageText()
 	// TRANSLATORS: The space at the end is significant - another sentence may follow.
 	msgPrevFullMoon	= q_("Previous Full Moon: %1 %2 at %3:%4. ");
 	msgNextFullMoon	= q_("Next Full Moon: %1 %2 at %3:%4. ");
+	// TRANSLATORS: Progress of the computation of the yearly observability, in percent.
+	msgComputing	= q_("(computing... %1%)");
 }
 
 double Observability::getCallOrder(StelModuleActionName actionName) const
@@ -259,9 +266,12 @@ void Observability::draw(StelCore* core)
 	if (!flagShowReport)
 		return; // Button is off.
 
+	computeTimer.start();
+
 /////////////////////////////////////////////////////////////////
 // PRELIMINARS:
 	bool locChanged, yearChanged;
+	bool objectChanged = false;
 	StelObjectP selectedObject;
 	PlanetP ssObject, parentPlanet;
 
@@ -307,7 +317,7 @@ void Observability::draw(StelCore* core)
 	{
 		yearChanged = true;
 		curYear = auxy;
-		updateSunData(core);
+		startSunData();
 	}
 	else
 	{
@@ -353,14 +363,23 @@ void Observability::draw(StelCore* core)
 
 
 
+// Go on computing the Sun's position for the days of the year left:
+	bool sunDataReady = updateSunData(core);
+
 // If we have changed latitude (or year), we update the vector of Sun's hour 
 // angles at twilight, and re-compute Sun/Moon ephemeris (if selected):
 	if (locChanged || yearChanged || configChanged) 
 	{
-		updateSunH();
+		sunHChanged = true;
 		lastJDMoon = 0.0;
 	};
 
+	if (sunHChanged && sunDataReady)
+	{
+		updateSunH();
+		sunHChanged = false;
+	};
+
 //////////////////////////////////////////////////////////////////
 
 
@@ -405,6 +424,7 @@ void Observability::draw(StelCore* core)
 		{ // Check also if the (new) source belongs to the Solar System:
 
 			souChanged = true;
+			objectChanged = true;
 			selName = name;
 
 			Planet* planet = dynamic_cast<Planet*>(selectedObject.data());
@@ -628,6 +648,7 @@ void Observability::draw(StelCore* core)
 // Compute yearly ephemeris (only if necessary, and not for Sun nor Moon):
 
 
+	lineProgress.clear();
 	if (isSun) 
 	{
 		lineBestNight.clear();
@@ -635,26 +656,49 @@ void Observability::draw(StelCore* core)
 	}
 	else if (!isMoon && show_Year)
 	{
+		if (souChanged || locChanged || yearChanged)
+			yearlyReportChanged = true;
 
-		if (!isStar && (souChanged || yearChanged)) // Object moves.
-			updatePlanetData(core); // Re-compute ephemeris.
-		else
-		{ // Object is fixed on the sky.
-			double auxH = calculateHourAngle(mylat,refractedHorizonAlt,selDec);
-			double auxSidT1 = toUnsignedRA(selRA - auxH); 
-			double auxSidT2 = toUnsignedRA(selRA + auxH); 
-			for (int i=0;i<nDays;i++) {
-				objectH0[i] = auxH;
-				objectRA[i] = selRA;
-				objectDec[i] = selDec;
-				objectSidT[0][i] = auxSidT1;
-				objectSidT[1][i] = auxSidT2;
-			};
-		};
+// The planet's coordinates are computed incrementally, after the Sun's ones:
+		bool dataReady = sunDataReady;
+		if (!isStar)
+		{
+			if (objectChanged || yearChanged)
+				startPlanetData();
+			dataReady = sunDataReady && updatePlanetData(core);
+		}
+
+		if (!dataReady)
+		{
+			int percent = isStar ? 100*sunDataDays/nDays
+			                     : 50*(sunDataDays+planetDataDays)/nDays;
+			lineProgress = msgComputing.arg(percent);
+			lineBestNight.clear();
+			lineObservableRange.clear();
+			lineAcroCos.clear();
+		}
 
 // Determine source observability (only if something changed):
-		if ((souChanged || locChanged || yearChanged))
+		else if (yearlyReportChanged)
 		{
+			yearlyReportChanged = false;
+
+			if (isStar)
+			{ // Object is fixed on the sky.
+				double auxH = calculateHourAngle(mylat,refractedHorizonAlt,selDec);
+				double auxSidT1 = toUnsignedRA(selRA - auxH); 
+				double auxSidT2 = toUnsignedRA(selRA + auxH); 
+				for (int i=0;i<nDays;i++) {
+					objectH0[i] = auxH;
+					objectRA[i] = selRA;
+					objectDec[i] = selDec;
+					objectSidT[0][i] = auxSidT1;
+					objectSidT[1][i] = auxSidT2;
+				};
+			}
+			else // Object moves.
+				updateObjectH();
+
 			lineBestNight.clear();
 			lineObservableRange.clear();
 
@@ -825,7 +869,7 @@ void Observability::draw(StelCore* core)
 	
 	if ((isMoon && show_FullMoon) || (!isSun && !isMoon && show_Year)) 
 	{
-		painter.drawText(xLine, yLine, msgThisYear);
+		painter.drawText(xLine, yLine, lineProgress.isEmpty() ? msgThisYear : msgThisYear + " " + lineProgress);
 		if (show_Best_Night || show_FullMoon)
 		{
 			yLine -= lineSpacing;
@@ -857,17 +901,19 @@ double Observability::calculateHourAngle(double latitude,
                                          double elevation,
                                          double declination)
 {
-	double denom = std::cos(latitude)*std::cos(declination);
-	double numer = (std::sin(elevation)-std::sin(latitude)*std::sin(declination));
-
-	if ( std::abs(numer) > std::abs(denom) ) 
-	{
+	double hourAngle = StelRiseSet::hourAngle(latitude, elevation, declination);
+	if (hourAngle < 0.0)
 		return -0.5/86400.; // Source doesn't reach that altitude.
-	}
-	else
-	{
-		return Rad2Hr * std::acos(numer/denom);
-	}
+	return Rad2Hr * hourAngle;
+}
+
+// Same as calculateHourAngle() for each day of the year:
+void Observability::calculateHourAngles(double latitude, double elevation,
+                                        const double* declinations, double* hourAngles)
+{
+	StelRiseSet::hourAngles(latitude, elevation, nDays, declinations, hourAngles);
+	for (int i=0; i<nDays; i++)
+		hourAngles[i] = (hourAngles[i] < 0.0) ? -0.5/86400. : Rad2Hr * hourAngles[i];
 }
 ////////////////////////////////////
 
@@ -971,27 +1017,76 @@ QString Observability::formatAsDateRange(int startDay, int endDay)
 }
 //////////////////////////////////////////////
 
-// Compute planet's position for each day of the current year:
-void Observability::updatePlanetData(StelCore *core)
+// Restart the computation of the planet's position for each day of the current year:
+void Observability::startPlanetData()
 {
-	double tempH;
+	planetDataDays = 0;
+	QHash<QPair<QString, int>, PlanetYearCoords>::const_iterator it =
+		planetCoordsCache.constFind(qMakePair(myPlanet->getEnglishName(), curYear));
+	if (it == planetCoordsCache.constEnd())
+		return;
+
 	for (int i=0; i<nDays; i++)
 	{
-		getPlanetCoords(core, yearJD[i], objectRA[i], objectDec[i], false);
-		tempH = calculateHourAngle(mylat, refractedHorizonAlt, objectDec[i]);
-		objectH0[i] = tempH;
-		objectSidT[0][i] = toUnsignedRA(objectRA[i]-tempH);
-		objectSidT[1][i] = toUnsignedRA(objectRA[i]+tempH);
+		objectRA[i] = it->ra[i];
+		objectDec[i] = it->dec[i];
 	}
+	planetDataDays = nDays;
+}
+
+// Compute planet's position for the days of the current year left:
+bool Observability::updatePlanetData(StelCore *core)
+{
+	if (planetDataDays == nDays)
+		return true;
+
+	// The Earth's positions were stored with the Sun data, only the planet has to move.
+	do
+	{
+		const int i = planetDataDays;
+		myPlanet->computePosition(yearJD[i]);
+		Pos1 = myPlanet->getHeliocentricEclipticPos();
+		LocTrans = (core->matVsop87ToJ2000)*(Mat4d::translation(EarthPos[i]));
+		Pos2 = core->j2000ToEquinoxEqu(LocTrans*Pos1);
+		toRADec(Pos2, objectRA[i], objectDec[i]);
+		++planetDataDays;
+	} while (planetDataDays<nDays && hasComputeTimeLeft());
 
 // Return the planet to its current time:
-	getPlanetCoords(core, myJD, objectRA[0], objectDec[0], true);
+	myPlanet->computePosition(myJD);
+	myPlanet->computeTransMatrix(myJD);
+
+	if (planetDataDays < nDays)
+		return false;
+
+	if (planetCoordsCache.size() >= MaxCachedPlanetYears)
+		planetCoordsCache.clear();
+	PlanetYearCoords& coords = planetCoordsCache[qMakePair(myPlanet->getEnglishName(), curYear)];
+	coords.ra.resize(nDays);
+	coords.dec.resize(nDays);
+	for (int i=0; i<nDays; i++)
+	{
+		coords.ra[i] = objectRA[i];
+		coords.dec[i] = objectDec[i];
+	}
+	return true;
+}
+
+// Compute the planet's rise/set sidereal times for each day of the current year:
+void Observability::updateObjectH()
+{
+	calculateHourAngles(mylat, refractedHorizonAlt, objectDec, objectH0);
+	for (int i=0; i<nDays; i++)
+	{
+		objectSidT[0][i] = toUnsignedRA(objectRA[i]-objectH0[i]);
+		objectSidT[1][i] = toUnsignedRA(objectRA[i]+objectH0[i]);
+	}
 }
 
 /////////////////////////////////////////////////
-// Computes the Sun's RA and Dec (and the JD) for 
-// each day of the current year.
-void Observability::updateSunData(StelCore* core) 
+// Restart the computation of the Sun's coordinates (and the JD)
+// for each day of the current year.
+void Observability::startSunData()
 {
 	int day, month, year, sameYear;
 // Get current date:
@@ -1003,23 +1098,45 @@ void Observability::updateSunData(StelCore* core)
 // Check if we are on a leap year:
 	StelUtils::getDateFromJulianDay(Jan1stJD+365., &sameYear, &month, &day);
 	nDays = (year==sameYear)?366:365;
-	
+
+	for (int i=0; i<nDays; i++)
+		yearJD[i] = Jan1stJD + (double)i;
+	sunDataDays = 0;
+}
+
+/////////////////////////////////////////////////
+// Computes the Sun's RA and Dec for the days of the
+// current year left.
+bool Observability::updateSunData(StelCore* core) 
+{
+	if (sunDataDays == nDays)
+		return true;
+
 // Compute Earth's position throughout the year:
 	Vec3d pos, sunPos;
-	for (int i=0; i<nDays; i++)
+	do
 	{
-		yearJD[i] = Jan1stJD + (double)i;
+		const int i = sunDataDays;
 		myEarth->computePosition(yearJD[i]);
 		myEarth->computeTransMatrix(yearJD[i]);
 		pos = myEarth->getHeliocentricEclipticPos();
 		sunPos = core->j2000ToEquinoxEqu((core->matVsop87ToJ2000)*(-pos));
 		EarthPos[i] = -pos;
 		toRADec(sunPos,sunRA[i],sunDec[i]);
-	};
+		++sunDataDays;
+	} while (sunDataDays<nDays && hasComputeTimeLeft());
 
 //Return the Earth to its current time:
 	myEarth->computePosition(myJD);
 	myEarth->computeTransMatrix(myJD);
+
+	return sunDataDays == nDays;
+}
+
+// Checked after each day, so that at least one day is computed in each frame.
+bool Observability::hasComputeTimeLeft() const
+{
+	return computeTimer.elapsed() < ComputeTimeBudget;
 }
 ///////////////////////////////////////////////////
 
@@ -1028,16 +1145,16 @@ void Observability::updateSunData(StelCore* core)
 // Computes Sun's Sidereal Times at twilight and culmination:
 void Observability::updateSunH()
 {
-	double tempH, tempH00;
+	double tempH[366], tempH00[366];
+	calculateHourAngles(mylat, twilightAltRad, sunDec, tempH);
+	calculateHourAngles(mylat, refractedHorizonAlt, sunDec, tempH00);
 
 	for (int i=0; i<nDays; i++)
 	{
-		tempH = calculateHourAngle(mylat, twilightAltRad, sunDec[i]);
-		tempH00 = calculateHourAngle(mylat, refractedHorizonAlt, sunDec[i]);
-		if (tempH > 0.0)
+		if (tempH[i] > 0.0)
 		{
-			sunSidT[0][i] = toUnsignedRA(sunRA[i]-tempH*(1.00278));
-			sunSidT[1][i] = toUnsignedRA(sunRA[i]+tempH*(1.00278));
+			sunSidT[0][i] = toUnsignedRA(sunRA[i]-tempH[i]*(1.00278));
+			sunSidT[1][i] = toUnsignedRA(sunRA[i]+tempH[i]*(1.00278));
 		}
 		else
 		{
@@ -1045,10 +1162,10 @@ void Observability::updateSunH()
 			sunSidT[1][i] = -1000.0;
 		}
 		
-		if (tempH00>0.0)
+		if (tempH00[i]>0.0)
 		{
-			sunSidT[2][i] = toUnsignedRA(sunRA[i]+tempH00);
-			sunSidT[3][i] = toUnsignedRA(sunRA[i]-tempH00);
+			sunSidT[2][i] = toUnsignedRA(sunRA[i]+tempH00[i]);
+			sunSidT[3][i] = toUnsignedRA(sunRA[i]-tempH00[i]);
 		}
 		else
 		{
@@ -19,8 +19,12 @@
 #define OBSERVABILITY_HPP_
 
 #include "StelModule.hpp"
+#include <QElapsedTimer>
 #include <QFont>
+#include <QHash>
+#include <QPair>
 #include <QString>
+#include <QVector>
 #include "VecMath.hpp"
 #include "SolarSystem.hpp"
 #include "Planet.hpp"
@@ -151,6 +155,14 @@ private:
 	                          double elevation,
 	                          double declination);
 
+//! Computes calculateHourAngle() for the declinations of each day of the year.
+//! @param latitude latitude of the observer (in radians).
+//! @param elevation elevation angle of the object (horizon=0) in radians.
+//! @param declinations declinations of the object for each day, in radians.
+//! @param hourAngles the hour angles for each day, in hours.
+	void calculateHourAngles(double latitude, double elevation,
+	                         const double* declinations, double* hourAngles);
+
 //! Computes the Hour Angle for a given Right Ascension and Sidereal Time.
 //! @param RA right ascension (hours).
 //! @param ST sidereal time (degrees).
@@ -236,15 +248,33 @@ private:
 //! @param RA right ascension (in hours).
 	double toUnsignedRA(double RA);
 
+//! Restart the computation of the selected planet's coordinates through the year,
+//! or take them from planetCoordsCache if they were already computed.
+	void startPlanetData();
+
 //! Prepare arrays with data for the selected object for each day of the year.
-//! Computes the RA, Dec and rise/set sidereal times of the selected planet
-//! for each day of the current year.
+//! Computes the RA and Dec of the selected planet for the days of the current
+//! year not computed yet, until the time budget of the frame is spent.
+//! The Sun data must be complete.
 //! @param core the current Stellarium core.
-	void updatePlanetData(StelCore* core);
+//! @returns true when the coordinates are known for the whole year.
+	bool updatePlanetData(StelCore* core);
+
+//! Computes the rise/set sidereal times of the selected object for each day
+//! of the year, from its RA and Dec.
+	void updateObjectH();
 
-//! Computes the Sun's RA and Dec for each day of a given year.
+//! Restart the computation of the Sun's coordinates for the current year.
+	void startSunData();
+
+//! Computes the Sun's RA and Dec for the days of the current year not computed
+//! yet, until the time budget of the frame is spent.
 //! @param core current Stellarium core.
-	void updateSunData(StelCore* core);
+//! @returns true when the Sun data are known for the whole year.
+	bool updateSunData(StelCore* core);
+
+//! Whether some time is left in the current frame to compute the yearly data.
+	bool hasComputeTimeLeft() const;
 
 //! Computes the Sun's Sid. Times at astronomical twilight (for each year's day)
 	void updateSunH();
@@ -315,6 +345,38 @@ private:
 	//! Days in the current year (366 on leap years).
 	int nDays;
 
+	//! @name Incremental computation of the yearly data.
+	//! The yearly ephemeris is spread over several frames, so that selecting
+	//! a new object does not freeze the display. The computation runs in the
+	//! main thread because it moves the Earth and the planets of the SolarSystem.
+	//! @{
+	//! Number of days of the current year for which the Sun data are computed.
+	int sunDataDays;
+	//! Number of days of the current year for which the planet coordinates are computed.
+	int planetDataDays;
+	//! Whether the Sun's sidereal times must be recomputed when the Sun data are complete.
+	bool sunHChanged;
+	//! Whether the yearly report must be recomputed when the data are complete.
+	bool yearlyReportChanged;
+	//! Started at the beginning of each frame to limit the time spent computing.
+	QElapsedTimer computeTimer;
+	//! Maximum time spent computing the yearly data in each frame, in milliseconds.
+	static const int ComputeTimeBudget = 4;
+	//! Coordinates of a planet for each day of a year.
+	struct PlanetYearCoords
+	{
+		QVector<double> ra;
+		QVector<double> dec;
+	};
+	//! Geocentric coordinates already computed, indexed by planet name and year.
+	//! They do not depend on the location, which can be changed without recomputing them.
+	QHash<QPair<QString, int>, PlanetYearCoords> planetCoordsCache;
+	//! Limit of planetCoordsCache, which is cleared when it is full.
+	static const int MaxCachedPlanetYears = 64;
+	//! Progress of the computation appended to the "this year" line, or empty if complete.
+	QString lineProgress;
+	//! @}
+
 	//! Untranslated name of the currently selected object.
 	//! Used to check if the selection has changed.
 	QString selName;
@@ -367,7 +429,7 @@ private:
 	//! @{
 	QString msgSetsAt, msgRoseAt, msgSetAt, msgRisesAt, msgCircumpolar, msgNoRise, msgCulminatesAt, msgCulminatedAt, msgH, msgM, msgS;
 	QString msgSrcNotObs, msgNoACRise, msgGreatElong, msgLargSSep, msgNone, msgAcroRise, msgNoAcroRise, msgCosmRise, msgNoCosmRise;
-	QString msgWholeYear, msgNotObs, msgAboveHoriz, msgToday, msgThisYear, msgPrevFullMoon, msgNextFullMoon;
+	QString msgWholeYear, msgNotObs, msgAboveHoriz, msgToday, msgThisYear, msgPrevFullMoon, msgNextFullMoon, msgComputing;
 	//! @}
 
 };
@@ -23,6 +23,7 @@
 #include "GridLinesMgr.hpp"
 #include "LabelMgr.hpp"
 #include "SkyGui.hpp"
+#include "StarMgr.hpp"
 #include "StelActionMgr.hpp"
 #include "StelApp.hpp"
 #include "StelCore.hpp"
@@ -148,7 +149,8 @@ Oculars::Oculars():
 	actualFOV(0),
 	initialFOV(0),
 	flagInitFOVUsage(false),
-	reticleRotation(0)
+	reticleRotation(0),
+	infoTextInset(0.f)
 {
 	font.setPixelSize(14);
 
@@ -1554,18 +1556,56 @@ void Oculars::paintText(const StelCore* core)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_BLEND);
 
-	// Get the X & Y positions, and the line height
+	// The text is only built again when the instruments or the values it shows changed
 	painter.setFont(font);
-	QString widthString = "MMMMMMMMMMMMMMMMMMM";
-	float insetFromRHS = painter.getFontMetrics().width(widthString);
+	updateInfoText(painter, ocular, telescope, lens, ccd);
+
+	// Get the X & Y positions, and the line height
 	StelProjector::StelProjectorParams projectorParams = core->getCurrentStelProjectorParams();
 	int xPosition = projectorParams.viewportXywh[2];
-	xPosition -= insetFromRHS;
+	xPosition -= infoTextInset;
 	int yPosition = projectorParams.viewportXywh[3];
 	yPosition -= 40;
 	const int lineHeight = painter.getFontMetrics().height();
-	
-	
+
+	foreach (const QString& line, infoTextLines)
+	{
+		painter.drawText(xPosition, yPosition, line);
+		yPosition-=lineHeight;
+	}
+}
+
+void Oculars::updateInfoText(StelPainter& painter, Ocular* ocular, Telescope* telescope, Lens* lens, CCD* ccd)
+{
+	// Collect the values shown in the text, without formatting them
+	QVector<double> values;
+	QStringList names;
+	values << selectedOcularIndex << selectedTelescopeIndex << selectedLensIndex << selectedCCDIndex
+	       << flagShowOculars << flagShowCCD << flagDecimalDegrees;
+	names << StelApp::getInstance().getLocaleMgr().getAppLanguage() << font.toString();
+	if (flagShowOculars) {
+		names << ocular->name();
+		values << ocular->isBinoculars();
+		if (!ocular->isBinoculars()) {
+			values << ocular->effectiveFocalLength() << ocular->appearentFOV()
+			       << ocular->magnification(telescope, lens) << ocular->actualFOV(telescope, lens);
+			names << (lens != NULL ? lens->name() : QString()) << telescope->name();
+		}
+	}
+	if (flagShowCCD) {
+		values << ccd->getActualFOVx(telescope, lens) << ccd->getActualFOVy(telescope, lens);
+		names << ccd->name() << telescope->name();
+	}
+	if (values==infoTextValues && names==infoTextNames)
+		return;
+	infoTextValues = values;
+	infoTextNames = names;
+	infoTextLines.clear();
+
+	QString widthString = "MMMMMMMMMMMMMMMMMMM";
+	float insetFromRHS = painter.getFontMetrics().width(widthString);
+	infoTextInset = insetFromRHS;
+
 	// The Ocular
 	if (flagShowOculars) {
 		QString ocularNumberLabel;
@@ -1583,25 +1623,22 @@ void Oculars::paintText(const StelCore* core)
 		}
 		// The name of the ocular could be really long.
 		if (name.length() > widthString.length()) {
-			xPosition -= (insetFromRHS / 2.0);
+			infoTextInset += (insetFromRHS / 2.0);
 		}
-		painter.drawText(xPosition, yPosition, ocularNumberLabel);
-		yPosition-=lineHeight;
+		infoTextLines << ocularNumberLabel;
 		
 		if (!ocular->isBinoculars()) {
 			QString eFocalLength = QVariant(ocular->effectiveFocalLength()).toString();
 			// TRANSLATORS: FL = Focal length
 			QString eFocalLengthLabel = QString(q_("Ocular FL: %1 mm")).arg(eFocalLength);
-			painter.drawText(xPosition, yPosition, eFocalLengthLabel);
-			yPosition-=lineHeight;
+			infoTextLines << eFocalLengthLabel;
 			
 			QString ocularFov = QString::number(ocular->appearentFOV());
 			ocularFov.append(QChar(0x00B0));//Degree sign
 			// TRANSLATORS: aFOV = apparent field of view
 			QString ocularFOVLabel = QString(q_("Ocular aFOV: %1"))
 						 .arg(ocularFov);
-			painter.drawText(xPosition, yPosition, ocularFOVLabel);
-			yPosition-=lineHeight;
+			infoTextLines << ocularFOVLabel;
 	
 			QString lensNumberLabel;
 			// Barlow and Shapley lens
@@ -1621,8 +1658,7 @@ void Oculars::paintText(const StelCore* core)
 			{
 				lensNumberLabel = QString (q_("Lens: none"));
 			}
-			painter.drawText(xPosition, yPosition, lensNumberLabel);
-			yPosition-=lineHeight;
+			infoTextLines << lensNumberLabel;
 		
 			// The telescope
 			QString telescopeNumberLabel;
@@ -1638,8 +1674,7 @@ void Oculars::paintText(const StelCore* core)
 						.arg(selectedTelescopeIndex)
 						.arg(telescopeName);
 			}
-			painter.drawText(xPosition, yPosition, telescopeNumberLabel);
-			yPosition-=lineHeight;
+			infoTextLines << telescopeNumberLabel;
 			
 			// General info
 			double magnification = ((int)(ocular->magnification(telescope, lens) * 10.0)) / 10.0;
@@ -1647,14 +1682,13 @@ void Oculars::paintText(const StelCore* core)
 			magString.append(QChar(0x00D7));//Multiplication sign
 			QString magnificationLabel = QString(q_("Magnification: %1"))
 			                             .arg(magString);
-			painter.drawText(xPosition, yPosition, magnificationLabel);
-			yPosition-=lineHeight;
+			infoTextLines << magnificationLabel;
 			
 			double fov = ((int)(ocular->actualFOV(telescope, lens) * 10000.00)) / 10000.0;
 			QString fovString = QString::number(fov);
 			fovString.append(QChar(0x00B0));//Degree sign
 			QString fovLabel = QString(q_("FOV: %1")).arg(fovString);
-			painter.drawText(xPosition, yPosition, fovLabel);
+			infoTextLines << fovLabel;
 		}
 	}
 
@@ -1676,10 +1710,8 @@ void Oculars::paintText(const StelCore* core)
 					.arg(selectedCCDIndex)
 					.arg(name);
 		}
-		painter.drawText(xPosition, yPosition, ccdSensorLabel);
-		yPosition-=lineHeight;
-		painter.drawText(xPosition, yPosition, ccdInfoLabel);
-		yPosition-=lineHeight;
+		infoTextLines << ccdSensorLabel;
+		infoTextLines << ccdInfoLabel;
 
 		// The telescope
 		QString telescopeNumberLabel;
@@ -1695,9 +1727,8 @@ void Oculars::paintText(const StelCore* core)
 					.arg(selectedTelescopeIndex)
 					.arg(telescopeName);
 		}
-		painter.drawText(xPosition, yPosition, telescopeNumberLabel);
+		infoTextLines << telescopeNumberLabel;
 	}
-	
 }
 
 void Oculars::validateAndLoadIniFile()
@@ -1863,9 +1894,11 @@ void Oculars::zoomOcular()
 	movementManager->setFlagEnableMouseNavigation(false);
 	
 	// We won't always have a selected object
+	Vec3d fieldCenter = movementManager->getViewDirectionJ2000();
 	if (StelApp::getInstance().getStelObjectMgr().getWasSelected()) {
 		StelObjectP selectedObject = StelApp::getInstance().getStelObjectMgr().getSelectedObject()[0];
 		movementManager->moveToJ2000(selectedObject->getEquinoxEquatorialPos(core), 0.0, 1);
+		fieldCenter = selectedObject->getJ2000EquatorialPos(core);
 	}
 
 	// Set the screen display
@@ -1905,6 +1938,14 @@ void Oculars::zoomOcular()
 	if (useMaxEyepieceAngle && ocular->appearentFOV() > 0.0 && !ocular->isBinoculars()) {
 		actualFOV = maxEyepieceAngle * actualFOV / ocular->appearentFOV();
 	}
+
+	// Start reading the deep catalogs around the target, so that they are ready when the
+	// stars of the narrow field become visible
+	if (telescope)
+	{
+		StarMgr* starMgr = GETSTELMODULE(StarMgr);
+		starMgr->prefetchRegion(fieldCenter, actualFOV, 2.1 + 5*std::log10(telescope->diameter()));
+	}
 	movementManager->zoomTo(actualFOV, 0.0);
 }
 
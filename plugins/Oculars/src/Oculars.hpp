@@ -31,6 +31,8 @@
 
 #include <QFont>
 #include <QSettings>
+#include <QStringList>
+#include <QVector>
 
 #define MIN_OCULARS_INI_VERSION 2
 
@@ -160,6 +162,8 @@ private:
 	//! Paints the text about the current object selections to the upper right hand of the screen.
 	//! Should only be called from a 'ready' state; currently from the draw() method.
 	void paintText(const StelCore * core);
+	//! Build the lines drawn by paintText() again if the instruments or the values they show changed.
+	void updateInfoText(class StelPainter& painter, Ocular* ocular, Telescope* telescope, Lens* lens, CCD* ccd);
 
 	//! This method is called by the zoom() method, when this plugin is toggled off; it resets to the default view.
 	void unzoomOcular();
@@ -273,6 +277,13 @@ private:
 	double initialFOV;	//!< Holds the initial FOV
 	bool flagInitFOVUsage;	//!< Flag used to track if we use default initial FOV (value at the startup of planetarium).
 	double reticleRotation;
+
+	//! The values and names the information text was built from, see updateInfoText().
+	QVector<double> infoTextValues;
+	QStringList infoTextNames;
+	//! The lines of the information text and their inset from the right of the viewport.
+	QStringList infoTextLines;
+	float infoTextInset;
 };
 
 
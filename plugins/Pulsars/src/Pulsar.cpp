@@ -25,6 +25,7 @@
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 #include "StelTexture.hpp"
+#include "StelTextureMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
 #include "StelModuleMgr.hpp"
@@ -40,7 +41,7 @@
 
 #define PSR_INERTIA 1.0e45 /* Typical moment of inertia for a pulsar */
 
-StelTextureSP Pulsar::markerTexture;
+int Pulsar::markerSprite = -1;
 
 bool Pulsar::distributionMode = false;
 bool Pulsar::glitchFlag = false;
@@ -393,11 +394,11 @@ void Pulsar::draw(StelCore* core, StelPainter *painter)
 
 	if (mag <= mlimit)
 	{		
-		Pulsar::markerTexture->bind();
+		StelApp::getInstance().getTextureManager().getSpriteAtlas()->bind();
 		float size = getAngularSize(NULL)*M_PI/180.*painter->getProjector()->getPixelPerRadAtCenter();
 		float shift = 5.f + size/1.6f;		
 
-		painter->drawSprite2dMode(XYZ, distributionMode ? 4.f : 5.f);
+		painter->drawSprite2dMode(XYZ, distributionMode ? 4.f : 5.f, StelApp::getInstance().getTextureManager().getSpriteTexRect(markerSprite));
 
 		if (labelsFader.getInterstate()<=0.f && !distributionMode && (mag+2.f)<mlimit)
 		{
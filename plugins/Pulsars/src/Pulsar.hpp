@@ -90,7 +90,8 @@ private:
 	Vec3d XYZ;                         // holds J2000 position	
 
 	static StelTextureSP hintTexture;
-	static StelTextureSP markerTexture;
+	//! The id of the marker image in the sprite atlas.
+	static int markerSprite;
 	static bool distributionMode;
 	static bool glitchFlag;
 	static Vec3f markerColor;
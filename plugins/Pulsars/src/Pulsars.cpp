@@ -29,6 +29,7 @@
 #include "StelObjectMgr.hpp"
 #include "StelTextureMgr.hpp"
 #include "StelJsonParser.hpp"
+#include "StelBinaryCatalog.hpp"
 #include "StelFileMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
@@ -38,8 +39,6 @@
 #include "PulsarsDialog.hpp"
 #include "StelProgressController.hpp"
 
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QKeyEvent>
 #include <QDebug>
 #include <QFileInfo>
@@ -84,7 +83,7 @@ StelPluginInfo PulsarsStelPluginInterface::getPluginInfo() const
 Pulsars::Pulsars()
 	: PsrCount(0)
 	, updateState(CompleteNoUpdates)
-	, downloadMgr(NULL)
+	, updater(NULL)
 	, updateTimer(0)
 	, messageTimer(0)
 	, updatesEnabled(false)
@@ -122,7 +121,7 @@ Pulsars::~Pulsars()
 void Pulsars::deinit()
 {
 	psr.clear();
-	Pulsar::markerTexture.clear();
+	psrIndex.clear();
 	texPointer.clear();
 }
 
@@ -163,7 +162,7 @@ void Pulsars::init()
 			return;
 
 		texPointer = StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/pointeur2.png");
-		Pulsar::markerTexture = StelApp::getInstance().getTextureManager().createTexture(":/Pulsars/pulsar.png");
+		Pulsar::markerSprite = StelApp::getInstance().getTextureManager().addSprite(":/Pulsars/pulsar.png");
 
 		// key bindings and other actions
 		addAction("actionShow_Pulsars", N_("Pulsars"), N_("Show pulsars"), "pulsarsVisible", "Ctrl+Alt+P");
@@ -189,6 +188,15 @@ void Pulsars::init()
 	messageTimer->stop();
 	connect(messageTimer, SIGNAL(timeout()), this, SLOT(messageTimeout()));
 
+	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
+}
+
+//! Load the catalog and schedule its updates once the first frames are shown.
+void Pulsars::deferredInit()
+{
+	if (jsonCatalogPath.isEmpty())
+		return;
+
 	// If the json file does not already exist, create it from the resource in the Qt resource
 	if(QFileInfo(jsonCatalogPath).exists())
 	{
@@ -208,16 +216,15 @@ void Pulsars::init()
 	readJsonFile();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloadComplete(QNetworkReply*)));
+	updater = new StelCatalogUpdater("Pulsars", jsonCatalogPath, this);
+	connect(updater, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(updateDownloadProgress(qint64,qint64)));
+	connect(updater, SIGNAL(finished(StelCatalogUpdater::Result)), this, SLOT(updateFinished(StelCatalogUpdater::Result)));
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
 	updateTimer->setInterval(13000);     // check once every 13 seconds to see if it is time for an update
 	connect(updateTimer, SIGNAL(timeout()), this, SLOT(checkForUpdate()));
 	updateTimer->start();
-
-	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
 }
 
 /*
@@ -232,11 +239,14 @@ void Pulsars::draw(StelCore* core)
 	StelPainter painter(prj);
 	painter.setFont(font);
 	
+	// The markers share the same texture and blending, record them to draw them at once
+	painter.beginBatch();
 	foreach (const PulsarP& pulsar, psr)
 	{
 		if (pulsar && pulsar->initialized)
 			pulsar->draw(core, &painter);
 	}
+	painter.endBatch();
 
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer())
 		drawPointer(core, painter);
@@ -277,20 +287,10 @@ QList<StelObjectP> Pulsars::searchAround(const Vec3d& av, double limitFov, const
 
 	Vec3d v(av);
 	v.normalize();
-	double cosLimFov = cos(limitFov * M_PI/180.);
-	Vec3d equPos;
-
-	foreach(const PulsarP& pulsar, psr)
+	const SphericalCap cap(v, cos(limitFov * M_PI/180.));
+	foreach(const StelRegionObjectP& obj, psrIndex.getPointsInRegion(&cap))
 	{
-		if (pulsar->initialized)
-		{
-			equPos = pulsar->XYZ;
-			equPos.normalize();
-			if (equPos[0]*v[0] + equPos[1]*v[1] + equPos[2]*v[2]>=cosLimFov)
-			{
-				result.append(qSharedPointerCast<StelObject>(pulsar));
-			}
-		}
+		result.append(qSharedPointerCast<StelObject>(obj));
 	}
 
 	return result;
@@ -501,16 +501,7 @@ QVariantMap Pulsars::loadPSRMap(QString path)
 	if (path.isEmpty())
 	    path = jsonCatalogPath;
 
-	QVariantMap map;
-	QFile jsonFile(path);
-	if (!jsonFile.open(QIODevice::ReadOnly))
-		qWarning() << "Pulsars: cannot open" << QDir::toNativeSeparators(path);
-	else
-	{
-		map = StelJsonParser::parse(jsonFile.readAll()).toMap();
-		jsonFile.close();
-	}
-	return map;
+	return StelBinaryCatalog::loadJsonCatalog(path);
 }
 
 /*
@@ -519,6 +510,7 @@ QVariantMap Pulsars::loadPSRMap(QString path)
 void Pulsars::setPSRMap(const QVariantMap& map)
 {
 	psr.clear();
+	psrIndex.clear();
 	PsrCount = 0;
 	QVariantMap psrMap = map.value("pulsars").toMap();
 	foreach(QString psrKey, psrMap.keys())
@@ -530,7 +522,10 @@ void Pulsars::setPSRMap(const QVariantMap& map)
 
 		PulsarP pulsar(new Pulsar(psrData));
 		if (pulsar->initialized)
+		{
 			psr.append(pulsar);
+			psrIndex.insert(qSharedPointerCast<StelRegionObject>(pulsar));
+		}
 
 	}
 }
@@ -594,7 +589,10 @@ PulsarP Pulsars::getByID(const QString& id)
 bool Pulsars::configureGui(bool show)
 {
 	if (show)
+	{
+		StelApp::getInstance().finishDeferredInit(this);
 		configDialog->setVisible(true);
+	}
 	return true;
 }
 
@@ -674,6 +672,11 @@ void Pulsars::checkForUpdate(void)
 
 void Pulsars::updateJSON(void)
 {
+	// The updater is created with the catalog
+	StelApp::getInstance().finishDeferredInit(this);
+	if (!updater)
+		return;
+
 	if (updateState==Pulsars::Updating)
 	{
 		qWarning() << "Pulsars: already updating...  will not start again current update is complete.";
@@ -697,49 +700,43 @@ void Pulsars::updateJSON(void)
 	progressBar->setRange(0, 100);
 	progressBar->setFormat("Update pulsars");
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(updateUrl));
-	request.setRawHeader("User-Agent", QString("Mozilla/5.0 (Stellarium Pulsars Plugin %1; http://stellarium.org/)").arg(PULSARS_PLUGIN_VERSION).toUtf8());
-	downloadMgr->get(request);
-
-	updateState = Pulsars::CompleteUpdates;
-	emit(updateStateChanged(updateState));
-	emit(jsonUpdateComplete());
+	updater->update(QUrl(updateUrl), QString("Mozilla/5.0 (Stellarium Pulsars Plugin %1; http://stellarium.org/)").arg(PULSARS_PLUGIN_VERSION).toUtf8());
 }
 
-void Pulsars::updateDownloadComplete(QNetworkReply* reply)
+void Pulsars::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	// check the download worked, and save the data to file if this is the case.
-	if (reply->error() != QNetworkReply::NoError)
-	{
-		qWarning() << "Pulsars: FAILED to download" << reply->url() << " Error: " << reply->errorString();
-	}
-	else
-	{
-		// download completed successfully.
-		QString jsonFilePath = StelFileMgr::findFile("modules/Pulsars", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::Directory)) + "/pulsars.json";
-		if (jsonFilePath.isEmpty())
-		{
-			qWarning() << "Pulsars: cannot write JSON data to file:" << QDir::toNativeSeparators(jsonCatalogPath);
-			return;
-		}
-		QFile jsonFile(jsonFilePath);
-		if (jsonFile.exists())
-			jsonFile.remove();
-
-		if(jsonFile.open(QIODevice::WriteOnly | QIODevice::Text))
-		{
-			jsonFile.write(reply->readAll());
-			jsonFile.close();
-		}
-	}
+	if (progressBar && bytesTotal > 0)
+		progressBar->setValue((int)(100 * bytesReceived / bytesTotal));
+}
 
+void Pulsars::updateFinished(StelCatalogUpdater::Result result)
+{
 	if (progressBar)
 	{
 		progressBar->setValue(100);
 		StelApp::getInstance().removeProgressBar(progressBar);
-		progressBar=NULL;
+		progressBar = NULL;
+	}
+
+	switch (result)
+	{
+		case StelCatalogUpdater::Updated:
+			// The new catalog was parsed in a worker thread, it replaces the current one at once
+			setPSRMap(updater->takeCatalog());
+			updateState = Pulsars::CompleteUpdates;
+			break;
+		case StelCatalogUpdater::NotModified:
+			updateState = Pulsars::CompleteNoUpdates;
+			break;
+		case StelCatalogUpdater::DownloadFailed:
+			updateState = Pulsars::DownloadError;
+			break;
+		default:
+			updateState = Pulsars::OtherError;
+			break;
 	}
+	emit(updateStateChanged(updateState));
+	emit(jsonUpdateComplete());
 }
 
 void Pulsars::displayMessage(const QString& message, const QString hexColor)
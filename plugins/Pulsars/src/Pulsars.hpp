@@ -20,9 +20,11 @@
 #define _PULSARS_HPP_
 
 #include "StelObjectModule.hpp"
+#include "StelCatalogUpdater.hpp"
 #include "StelObject.hpp"
 #include "StelFader.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelSphericalIndex.hpp"
 #include "Pulsar.hpp"
 #include <QFont>
 #include <QVariantMap>
@@ -30,8 +32,6 @@
 #include <QList>
 #include <QSharedPointer>
 
-class QNetworkAccessManager;
-class QNetworkReply;
 class QSettings;
 class QTimer;
 class QPixmap;
@@ -64,6 +64,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in the StelModule class
 	virtual void init();
+	virtual void deferredInit();
 	virtual void deinit();
 	virtual void update(double) {;}
 	virtual void draw(StelCore* core);
@@ -219,12 +220,14 @@ private:
 
 	StelTextureSP texPointer;
 	QList<PulsarP> psr;
+	//! Spatial index of the objects of the list, used by searchAround().
+	StelSphericalIndex psrIndex;
 
 	int PsrCount;
 
 	// variables and functions for the updater
 	UpdateState updateState;
-	QNetworkAccessManager* downloadMgr;
+	StelCatalogUpdater* updater;
 	QString updateUrl;	
 	QTimer* updateTimer;
 	QTimer* messageTimer;
@@ -252,7 +255,9 @@ private slots:
 	//! if the last update was longer than updateFrequencyHours ago then the update is
 	//! done.
 	void checkForUpdate(void);
-	void updateDownloadComplete(QNetworkReply* reply);
+	void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	//! Called when the updater is done, replaces the catalog if a new one was downloaded.
+	void updateFinished(StelCatalogUpdater::Result result);
 
 };
 
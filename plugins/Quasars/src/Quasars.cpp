@@ -29,6 +29,7 @@
 #include "StelObjectMgr.hpp"
 #include "StelTextureMgr.hpp"
 #include "StelJsonParser.hpp"
+#include "StelBinaryCatalog.hpp"
 #include "StelFileMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
@@ -38,8 +39,6 @@
 #include "QuasarsDialog.hpp"
 #include "StelProgressController.hpp"
 
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QKeyEvent>
 #include <QDebug>
 #include <QFileInfo>
@@ -84,7 +83,7 @@ StelPluginInfo QuasarsStelPluginInterface::getPluginInfo() const
 Quasars::Quasars()
 	: QsrCount(0)
 	, updateState(CompleteNoUpdates)
-	, downloadMgr(NULL)
+	, updater(NULL)
 	, updateTimer(0)
 	, messageTimer(0)
 	, updatesEnabled(false)
@@ -123,6 +122,7 @@ Quasars::~Quasars()
 void Quasars::deinit()
 {
 	QSO.clear();
+	qsoIndex.clear();
 	Quasar::markerTexture.clear();
 	texPointer.clear();
 }
@@ -190,6 +190,15 @@ void Quasars::init()
 	messageTimer->stop();
 	connect(messageTimer, SIGNAL(timeout()), this, SLOT(messageTimeout()));
 
+	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
+}
+
+//! Load the catalog and schedule its updates once the first frames are shown.
+void Quasars::deferredInit()
+{
+	if (catalogJsonPath.isEmpty())
+		return;
+
 	// If the json file does not already exist, create it from the resource in the Qt resource
 	if(QFileInfo(catalogJsonPath).exists())
 	{
@@ -209,16 +218,15 @@ void Quasars::init()
 	readJsonFile();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloadComplete(QNetworkReply*)));
+	updater = new StelCatalogUpdater("Quasars", catalogJsonPath, this);
+	connect(updater, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(updateDownloadProgress(qint64,qint64)));
+	connect(updater, SIGNAL(finished(StelCatalogUpdater::Result)), this, SLOT(updateFinished(StelCatalogUpdater::Result)));
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
 	updateTimer->setInterval(13000);     // check once every 13 seconds to see if it is time for an update
 	connect(updateTimer, SIGNAL(timeout()), this, SLOT(checkForUpdate()));
 	updateTimer->start();
-
-	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
 }
 
 /*
@@ -278,20 +286,10 @@ QList<StelObjectP> Quasars::searchAround(const Vec3d& av, double limitFov, const
 
 	Vec3d v(av);
 	v.normalize();
-	double cosLimFov = cos(limitFov * M_PI/180.);
-	Vec3d equPos;
-
-	foreach(const QuasarP& quasar, QSO)
+	const SphericalCap cap(v, cos(limitFov * M_PI/180.));
+	foreach(const StelRegionObjectP& obj, qsoIndex.getPointsInRegion(&cap))
 	{
-		if (quasar->initialized)
-		{
-			equPos = quasar->XYZ;
-			equPos.normalize();
-			if (equPos[0]*v[0] + equPos[1]*v[1] + equPos[2]*v[2]>=cosLimFov)
-			{
-				result.append(qSharedPointerCast<StelObject>(quasar));
-			}
-		}
+		result.append(qSharedPointerCast<StelObject>(obj));
 	}
 
 	return result;
@@ -504,16 +502,7 @@ QVariantMap Quasars::loadQSOMap(QString path)
 	if (path.isEmpty())
 	    path = catalogJsonPath;
 
-	QVariantMap map;
-	QFile jsonFile(path);
-	if (!jsonFile.open(QIODevice::ReadOnly))
-		qWarning() << "Quasars: cannot open" << QDir::toNativeSeparators(path);
-	else
-	{
-		map = StelJsonParser::parse(jsonFile.readAll()).toMap();
-		jsonFile.close();
-	}
-	return map;
+	return StelBinaryCatalog::loadJsonCatalog(path);
 }
 
 /*
@@ -522,6 +511,7 @@ QVariantMap Quasars::loadQSOMap(QString path)
 void Quasars::setQSOMap(const QVariantMap& map)
 {
 	QSO.clear();
+	qsoIndex.clear();
 	QsrCount = 0;
 	QVariantMap qsoMap = map.value("quasars").toMap();
 	foreach(QString qsoKey, qsoMap.keys())
@@ -533,7 +523,10 @@ void Quasars::setQSOMap(const QVariantMap& map)
 
 		QuasarP quasar(new Quasar(qsoData));
 		if (quasar->initialized)
+		{
 			QSO.append(quasar);
+			qsoIndex.insert(qSharedPointerCast<StelRegionObject>(quasar));
+		}
 
 	}
 }
@@ -597,7 +590,10 @@ QuasarP Quasars::getByID(const QString& id)
 bool Quasars::configureGui(bool show)
 {
 	if (show)
+	{
+		StelApp::getInstance().finishDeferredInit(this);
 		configDialog->setVisible(true);
+	}
 	return true;
 }
 
@@ -671,6 +667,11 @@ void Quasars::checkForUpdate(void)
 
 void Quasars::updateJSON(void)
 {
+	// The updater is created with the catalog
+	StelApp::getInstance().finishDeferredInit(this);
+	if (!updater)
+		return;
+
 	if (updateState==Quasars::Updating)
 	{
 		qWarning() << "Quasars: already updating...  will not start again current update is complete.";
@@ -694,49 +695,43 @@ void Quasars::updateJSON(void)
 	progressBar->setRange(0, 100);
 	progressBar->setFormat("Update quasars");
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(updateUrl));
-	request.setRawHeader("User-Agent", QString("Mozilla/5.0 (Stellarium Quasars Plugin %1; http://stellarium.org/)").arg(QUASARS_PLUGIN_VERSION).toUtf8());
-	downloadMgr->get(request);
-
-	updateState = Quasars::CompleteUpdates;
-	emit(updateStateChanged(updateState));
-	emit(jsonUpdateComplete());
+	updater->update(QUrl(updateUrl), QString("Mozilla/5.0 (Stellarium Quasars Plugin %1; http://stellarium.org/)").arg(QUASARS_PLUGIN_VERSION).toUtf8());
 }
 
-void Quasars::updateDownloadComplete(QNetworkReply* reply)
+void Quasars::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	// check the download worked, and save the data to file if this is the case.
-	if (reply->error() != QNetworkReply::NoError)
-	{
-		qWarning() << "Quasars: FAILED to download" << reply->url() << " Error: " << reply->errorString();
-	}
-	else
-	{
-		// download completed successfully.
-		QString jsonFilePath = StelFileMgr::findFile("modules/Quasars", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::Directory)) + "/quasars.json";
-		if (jsonFilePath.isEmpty())
-		{
-			qWarning() << "Quasars: cannot write JSON data to file:" << QDir::toNativeSeparators(jsonFilePath);
-			return;
-		}
-		QFile jsonFile(jsonFilePath);
-		if (jsonFile.exists())
-			jsonFile.remove();
-
-		if(jsonFile.open(QIODevice::WriteOnly | QIODevice::Text))
-		{
-			jsonFile.write(reply->readAll());
-			jsonFile.close();
-		}
-	}
+	if (progressBar && bytesTotal > 0)
+		progressBar->setValue((int)(100 * bytesReceived / bytesTotal));
+}
 
+void Quasars::updateFinished(StelCatalogUpdater::Result result)
+{
 	if (progressBar)
 	{
 		progressBar->setValue(100);
 		StelApp::getInstance().removeProgressBar(progressBar);
 		progressBar = NULL;
 	}
+
+	switch (result)
+	{
+		case StelCatalogUpdater::Updated:
+			// The new catalog was parsed in a worker thread, it replaces the current one at once
+			setQSOMap(updater->takeCatalog());
+			updateState = Quasars::CompleteUpdates;
+			break;
+		case StelCatalogUpdater::NotModified:
+			updateState = Quasars::CompleteNoUpdates;
+			break;
+		case StelCatalogUpdater::DownloadFailed:
+			updateState = Quasars::DownloadError;
+			break;
+		default:
+			updateState = Quasars::OtherError;
+			break;
+	}
+	emit(updateStateChanged(updateState));
+	emit(jsonUpdateComplete());
 }
 
 void Quasars::displayMessage(const QString& message, const QString hexColor)
@@ -20,8 +20,10 @@
 #define _QUASARS_HPP_
 
 #include "StelObjectModule.hpp"
+#include "StelCatalogUpdater.hpp"
 #include "StelObject.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelSphericalIndex.hpp"
 #include "Quasar.hpp"
 #include <QFont>
 #include <QVariantMap>
@@ -31,8 +33,6 @@
 
 class StelPainter;
 
-class QNetworkAccessManager;
-class QNetworkReply;
 class QSettings;
 class QTimer;
 class QPixmap;
@@ -63,6 +63,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in the StelModule class
 	virtual void init();
+	virtual void deferredInit();
 	virtual void deinit();
 	virtual void update(double) {;}
 	virtual void draw(StelCore* core);
@@ -216,10 +217,12 @@ private:
 
 	StelTextureSP texPointer;
 	QList<QuasarP> QSO;
+	//! Spatial index of the objects of the list, used by searchAround().
+	StelSphericalIndex qsoIndex;
 
 	// variables and functions for the updater
 	UpdateState updateState;
-	QNetworkAccessManager* downloadMgr;
+	StelCatalogUpdater* updater;
 	QString updateUrl;	
 	QTimer* updateTimer;
 	QTimer* messageTimer;
@@ -246,7 +249,9 @@ private slots:
 	//! if the last update was longer than updateFrequencyHours ago then the update is
 	//! done.
 	void checkForUpdate(void);
-	void updateDownloadComplete(QNetworkReply* reply);
+	void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	//! Called when the updater is done, replaces the catalog if a new one was downloaded.
+	void updateFinished(StelCatalogUpdater::Result result);
 
 };
 
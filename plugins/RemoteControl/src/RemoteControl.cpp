@@ -0,0 +1,504 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "RemoteControl.hpp"
+#include "StelActionMgr.hpp"
+#include "StelApp.hpp"
+#include "StelCore.hpp"
+#include "StelModuleMgr.hpp"
+#include "StelMovementMgr.hpp"
+#include "StelTranslator.hpp"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QThread>
+#include <QUdpSocket>
+
+//! Maximum number of values in one datagram, to stay well below the maximum size of the UDP datagrams.
+static const int MaxValuesPerDatagram = 256;
+
+StelModule* RemoteControlStelPluginInterface::getStelModule() const
+{
+	return new RemoteControl();
+}
+
+StelPluginInfo RemoteControlStelPluginInterface::getPluginInfo() const
+{
+	StelPluginInfo info;
+	info.id = "RemoteControl";
+	info.displayedName = N_("Remote Control");
+	info.authors = "Stellarium team";
+	info.contact = "www.stellarium.org";
+	info.description = N_("Lets external programs control the date, the view, the actions and the properties of the modules with a compact binary protocol over UDP, and receive the values which change at each frame.");
+	info.version = REMOTECONTROL_VERSION;
+	return info;
+}
+
+/*************************************************************************
+ The network side, running in its own thread
+*************************************************************************/
+RemoteControlServer::RemoteControlServer(quint16 aport) : port(aport), socket(NULL)
+{
+}
+
+void RemoteControlServer::start()
+{
+	socket = new QUdpSocket(this);
+	if (!socket->bind(QHostAddress::Any, port))
+	{
+		qWarning() << "RemoteControl: cannot listen on port" << port << ":" << socket->errorString();
+		delete socket;
+		socket = NULL;
+		return;
+	}
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readPendingDatagrams()));
+	qDebug() << "RemoteControl: listening on port" << port;
+}
+
+void RemoteControlServer::stop()
+{
+	delete socket;
+	socket = NULL;
+}
+
+void RemoteControlServer::send(const QByteArray& data, const QHostAddress& address, quint16 aport)
+{
+	if (socket)
+		socket->writeDatagram(data, address, aport);
+}
+
+QList<RemoteControlServer::Request> RemoteControlServer::takeRequests()
+{
+	QMutexLocker locker(&mutex);
+	QList<Request> res;
+	res.swap(requests);
+	return res;
+}
+
+void RemoteControlServer::readPendingDatagrams()
+{
+	QList<Request> received;
+	while (socket->hasPendingDatagrams())
+	{
+		QByteArray data;
+		data.resize(socket->pendingDatagramSize());
+		Request request;
+		socket->readDatagram(data.data(), data.size(), &request.sender, &request.senderPort);
+
+		// The datagrams are decoded here so that the main thread only has to apply the values
+		QDataStream in(data);
+		in.setVersion(QDataStream::Qt_5_0);
+		quint32 magic, sequence;
+		quint8 type;
+		in >> magic >> type >> sequence;
+		if (in.status()!=QDataStream::Ok || magic!=RemoteControl::Magic)
+			continue;
+		request.type = type;
+		if (type==RemoteControl::MessageSet)
+		{
+			quint16 count;
+			in >> count;
+			for (int i=0;i<count && in.status()==QDataStream::Ok;++i)
+			{
+				quint16 id;
+				QVariant value;
+				in >> id >> value;
+				request.values.append(qMakePair((int)id, value));
+			}
+			if (in.status()!=QDataStream::Ok)
+			{
+				qWarning() << "RemoteControl: invalid Set message from" << request.sender.toString();
+				continue;
+			}
+		}
+		else if (type!=RemoteControl::MessageTableRequest && type!=RemoteControl::MessageSubscribe)
+			continue;
+		received.append(request);
+	}
+	if (received.isEmpty())
+		return;
+	QMutexLocker locker(&mutex);
+	requests.append(received);
+}
+
+/*************************************************************************
+ The module, running in the main thread
+*************************************************************************/
+RemoteControl::RemoteControl()
+	: conf(NULL)
+	, flagEnabled(false)
+	, port(0)
+	, subscriptionTimeout(10000)
+	, thread(NULL)
+	, server(NULL)
+	, sequence(0)
+{
+	setObjectName("RemoteControl");
+	conf = StelApp::getInstance().getSettings();
+}
+
+RemoteControl::~RemoteControl()
+{
+}
+
+double RemoteControl::getCallOrder(StelModuleActionName actionName) const
+{
+	// The received values are applied before the update of the other modules
+	if (actionName==StelModule::ActionUpdate)
+		return -100000.;
+	return 0;
+}
+
+void RemoteControl::init()
+{
+	// Because the plug-in has no configuration GUI, users rely on what's
+	// written in the configuration file to know what can be configured.
+	Q_ASSERT(conf);
+	if (!conf->childGroups().contains("RemoteControl"))
+		restoreDefaultConfiguration();
+	loadConfiguration();
+	if (!flagEnabled)
+		return;
+
+	qRegisterMetaType<QHostAddress>("QHostAddress");
+	clock.start();
+	thread = new QThread();
+	server = new RemoteControlServer(port);
+	server->moveToThread(thread);
+	connect(thread, SIGNAL(started()), server, SLOT(start()));
+	thread->start();
+}
+
+void RemoteControl::deinit()
+{
+	if (!thread)
+		return;
+	QMetaObject::invokeMethod(server, "stop", Qt::BlockingQueuedConnection);
+	thread->quit();
+	thread->wait();
+	delete server;
+	server = NULL;
+	delete thread;
+	thread = NULL;
+}
+
+void RemoteControl::loadConfiguration()
+{
+	Q_ASSERT(conf);
+	conf->beginGroup("RemoteControl");
+	flagEnabled = conf->value("flag_enabled", false).toBool();
+	port = conf->value("port", 45460).toInt();
+	subscriptionTimeout = conf->value("subscription_timeout_ms", 10000).toInt();
+	conf->endGroup();
+}
+
+void RemoteControl::restoreDefaultConfiguration()
+{
+	Q_ASSERT(conf);
+	conf->remove("RemoteControl");
+	conf->beginGroup("RemoteControl");
+	conf->setValue("flag_enabled", false);
+	conf->setValue("port", 45460);
+	conf->setValue("subscription_timeout_ms", 10000);
+	conf->endGroup();
+}
+
+void RemoteControl::buildTable()
+{
+	Entry entry;
+	entry.action = NULL;
+	entry.object = NULL;
+	entry.kind = EntryJd;
+	entry.name = "core.jd";
+	entries.append(entry);
+	entry.kind = EntryTimeRate;
+	entry.name = "core.timeRate";
+	entries.append(entry);
+	entry.kind = EntryViewDirection;
+	entry.name = "view.directionJ2000";
+	entries.append(entry);
+	entry.kind = EntryFov;
+	entry.name = "view.fov";
+	entries.append(entry);
+
+	entry.kind = EntryAction;
+	StelActionMgr* actionMgr = StelApp::getInstance().getStelActionManager();
+	foreach (const QString& group, actionMgr->getGroupList())
+	{
+		foreach (StelAction* action, actionMgr->getActionList(group))
+		{
+			entry.name = "action." + action->getId();
+			entry.action = action;
+			entries.append(entry);
+		}
+	}
+	entry.action = NULL;
+
+	// The properties inherited from QObject (objectName) are not exposed, neither are the ones
+	// of the custom types as they cannot be streamed without registered operators
+	entry.kind = EntryProperty;
+	const int firstProperty = QObject::staticMetaObject.propertyCount();
+	foreach (StelModule* module, StelApp::getInstance().getModuleMgr().getAllModules())
+	{
+		const QMetaObject* metaObject = module->metaObject();
+		for (int i=firstProperty;i<metaObject->propertyCount();++i)
+		{
+			const QMetaProperty property = metaObject->property(i);
+			if (!property.isReadable() || !property.isWritable() || property.userType()>=QMetaType::User)
+				continue;
+			entry.name = module->objectName() + "." + property.name();
+			entry.object = module;
+			entry.property = property;
+			entries.append(entry);
+		}
+	}
+	if (entries.size()>65535)
+	{
+		qWarning() << "RemoteControl: too many values, only the first 65535 can be controlled";
+		entries.resize(65535);
+	}
+	qDebug() << "RemoteControl:" << entries.size() << "values can be controlled";
+}
+
+QVariant RemoteControl::readEntry(const Entry& entry) const
+{
+	StelCore* core = StelApp::getInstance().getCore();
+	switch (entry.kind)
+	{
+		case EntryJd:
+			return core->getJDay();
+		case EntryTimeRate:
+			return core->getTimeRate();
+		case EntryViewDirection:
+		{
+			const Vec3d v = core->getMovementMgr()->getViewDirectionJ2000();
+			QVariantList l;
+			l << v[0] << v[1] << v[2];
+			return l;
+		}
+		case EntryFov:
+			return core->getMovementMgr()->getCurrentFov();
+		case EntryAction:
+			// The actions which are not checkable have no value
+			return entry.action->isCheckable() ? QVariant(entry.action->isChecked()) : QVariant();
+		case EntryProperty:
+			return entry.property.read(entry.object);
+	}
+	return QVariant();
+}
+
+void RemoteControl::writeEntry(const Entry& entry, const QVariant& value)
+{
+	StelCore* core = StelApp::getInstance().getCore();
+	switch (entry.kind)
+	{
+		case EntryJd:
+			core->setJDay(value.toDouble());
+			break;
+		case EntryTimeRate:
+			core->setTimeRate(value.toDouble());
+			break;
+		case EntryViewDirection:
+		{
+			const QVariantList l = value.toList();
+			if (l.size()!=3)
+			{
+				qWarning() << "RemoteControl: view.directionJ2000 expects a list of 3 numbers";
+				break;
+			}
+			Vec3d v(l[0].toDouble(), l[1].toDouble(), l[2].toDouble());
+			v.normalize();
+			core->getMovementMgr()->setViewDirectionJ2000(v);
+			break;
+		}
+		case EntryFov:
+			core->getMovementMgr()->zoomTo(value.toDouble(), 0.f);
+			break;
+		case EntryAction:
+			if (!entry.action->isCheckable())
+				entry.action->trigger();
+			else if (entry.action->isChecked()!=value.toBool())
+				entry.action->setChecked(value.toBool());
+			break;
+		case EntryProperty:
+			if (!entry.property.write(entry.object, value))
+				qWarning() << "RemoteControl: cannot set" << entry.name << "to" << value;
+			break;
+	}
+}
+
+void RemoteControl::applyValues(const QList<QPair<int, QVariant> >& values)
+{
+	for (int i=0;i<values.size();++i)
+	{
+		const int id = values.at(i).first;
+		if (id>=entries.size())
+		{
+			qWarning() << "RemoteControl: unknown id" << id;
+			continue;
+		}
+		writeEntry(entries.at(id), values.at(i).second);
+	}
+	// The properties written may change the sky without any fader
+	if (!values.isEmpty())
+		StelApp::getInstance().markFrameDirty();
+}
+
+void RemoteControl::subscribe(const QHostAddress& address, quint16 aport)
+{
+	const qint64 expiration = clock.elapsed() + subscriptionTimeout;
+	for (int i=0;i<subscribers.size();++i)
+	{
+		Subscriber& s = subscribers[i];
+		if (s.address==address && s.port==aport)
+		{
+			s.expiration = expiration;
+			return;
+		}
+	}
+	Subscriber s;
+	s.address = address;
+	s.port = aport;
+	s.expiration = expiration;
+	subscribers.append(s);
+}
+
+QByteArray RemoteControl::makeHeader(MessageType type)
+{
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << Magic << (quint8)type << ++sequence;
+	return data;
+}
+
+void RemoteControl::send(const QByteArray& data, const QHostAddress& address, quint16 aport)
+{
+	QMetaObject::invokeMethod(server, "send", Qt::QueuedConnection, Q_ARG(QByteArray, data),
+				  Q_ARG(QHostAddress, address), Q_ARG(quint16, aport));
+}
+
+void RemoteControl::sendTable(const QHostAddress& address, quint16 aport)
+{
+	for (int first=0;first<entries.size();first+=MaxValuesPerDatagram)
+	{
+		const int count = qMin(MaxValuesPerDatagram, entries.size()-first);
+		QByteArray data = makeHeader(MessageTable);
+		QDataStream out(&data, QIODevice::WriteOnly | QIODevice::Append);
+		out.setVersion(QDataStream::Qt_5_0);
+		out << (quint16)count;
+		for (int i=first;i<first+count;++i)
+		{
+			const Entry& entry = entries.at(i);
+			QString typeName;
+			switch (entry.kind)
+			{
+				case EntryViewDirection:
+					typeName = "QVariantList";
+					break;
+				case EntryAction:
+					typeName = entry.action->isCheckable() ? "bool" : "void";
+					break;
+				case EntryProperty:
+					typeName = entry.property.typeName();
+					break;
+				default:
+					typeName = "double";
+			}
+			out << (quint16)i << entry.name << typeName;
+		}
+		send(data, address, aport);
+	}
+}
+
+void RemoteControl::sendDeltas()
+{
+	const qint64 now = clock.elapsed();
+	for (int i=subscribers.size()-1;i>=0;--i)
+	{
+		if (subscribers.at(i).expiration<now)
+			subscribers.removeAt(i);
+	}
+	if (subscribers.isEmpty())
+		return;
+
+	// The values are read once for all the subscribers
+	QVector<QVariant> values(entries.size());
+	for (int i=0;i<entries.size();++i)
+		values[i] = readEntry(entries.at(i));
+
+	for (int s=0;s<subscribers.size();++s)
+	{
+		Subscriber& subscriber = subscribers[s];
+		const bool full = subscriber.sent.isEmpty();
+		if (full)
+			subscriber.sent.resize(entries.size());
+		QList<int> changed;
+		for (int i=0;i<values.size();++i)
+		{
+			if (!values.at(i).isValid() || (!full && values.at(i)==subscriber.sent.at(i)))
+				continue;
+			changed.append(i);
+			subscriber.sent[i] = values.at(i);
+		}
+		for (int first=0;first<changed.size();first+=MaxValuesPerDatagram)
+		{
+			const int count = qMin(MaxValuesPerDatagram, changed.size()-first);
+			QByteArray data = makeHeader(MessageDelta);
+			QDataStream out(&data, QIODevice::WriteOnly | QIODevice::Append);
+			out.setVersion(QDataStream::Qt_5_0);
+			out << (quint16)count;
+			for (int i=first;i<first+count;++i)
+				out << (quint16)changed.at(i) << values.at(changed.at(i));
+			send(data, subscriber.address, subscriber.port);
+		}
+	}
+}
+
+void RemoteControl::update(double)
+{
+	if (!server)
+		return;
+	// The modules of the plug-ins loaded after this one are only known once all of them are initialized
+	if (entries.isEmpty())
+		buildTable();
+
+	// The values changed by the previous frame are sent before applying the new requests
+	sendDeltas();
+
+	const QList<RemoteControlServer::Request> requests = server->takeRequests();
+	foreach (const RemoteControlServer::Request& request, requests)
+	{
+		switch (request.type)
+		{
+			case MessageTableRequest:
+				sendTable(request.sender, request.senderPort);
+				break;
+			case MessageSet:
+				applyValues(request.values);
+				break;
+			case MessageSubscribe:
+				subscribe(request.sender, request.senderPort);
+				break;
+		}
+	}
+}
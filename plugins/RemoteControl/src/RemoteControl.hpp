@@ -0,0 +1,204 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _REMOTECONTROL_HPP_
+#define _REMOTECONTROL_HPP_
+
+#include "StelModule.hpp"
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QList>
+#include <QMetaProperty>
+#include <QMutex>
+#include <QPair>
+#include <QVariant>
+#include <QVector>
+
+class QSettings;
+class QThread;
+class QUdpSocket;
+class StelAction;
+
+//! @class RemoteControlServer
+//! Receive and send the datagrams of the RemoteControl protocol in a network thread.
+//! The received datagrams are decoded in the thread and queued for the main thread.
+class RemoteControlServer : public QObject
+{
+	Q_OBJECT
+public:
+	//! A decoded request.
+	struct Request
+	{
+		int type;
+		QHostAddress sender;
+		quint16 senderPort;
+		QList<QPair<int, QVariant> > values;
+	};
+
+	RemoteControlServer(quint16 port);
+
+	//! Take the requests received since the last call, thread safe.
+	QList<Request> takeRequests();
+
+public slots:
+	//! Open the socket, called in the network thread.
+	void start();
+	//! Close the socket, called in the network thread.
+	void stop();
+	//! Send a datagram, to be invoked with a queued connection from the main thread.
+	void send(const QByteArray& data, const QHostAddress& address, quint16 port);
+
+private slots:
+	void readPendingDatagrams();
+
+private:
+	quint16 port;
+	QUdpSocket* socket;
+	QMutex mutex;
+	QList<Request> requests;
+};
+
+//! @class RemoteControl
+//! Control Stellarium from external programs like show control systems with a compact binary
+//! protocol, without the overhead of the scripts. The datagrams are sent over UDP, and the requests
+//! received are applied in batch at the beginning of each frame.
+//! Each controllable value has a numeric id. The ids are listed by the TableRequest message, and are:
+//! - the built-in values: core.jd, core.timeRate, view.directionJ2000 (a list of 3 doubles) and view.fov.
+//! - the actions of the StelActionMgr, as action.<id>. Checkable actions take a bool, the other ones are
+//!   triggered whatever the value.
+//! - the readable and writable properties of the modules, as <module>.<property>.
+//!
+//! All the datagrams start with the magic number 0x5354524d, the message type (quint8) and a sequence
+//! number (quint32), and are written with QDataStream version Qt_5_0:
+//! - TableRequest (0): ask for the table of the ids, replied with a Table message.
+//! - Table (1): quint16 count, then count times (quint16 id, QString name, QString type name).
+//! - Set (2): quint16 count, then count times (quint16 id, QVariant value). Only the changed values
+//!   need to be sent, all the values of one datagram are applied in the same frame.
+//! - Subscribe (3): ask to receive the values which change. The subscriptions expire when they are not
+//!   renewed by a new Subscribe message (after 10 seconds by default).
+//! - Delta (4): quint16 count, then count times (quint16 id, QVariant value), the values which changed
+//!   during the last frame, sent to the subscribers. The first Delta after a Subscribe has all the values.
+//! The plug-in has no GUI, it is configured in the [RemoteControl] section of the configuration file.
+class RemoteControl : public StelModule
+{
+	Q_OBJECT
+public:
+	RemoteControl();
+	virtual ~RemoteControl();
+
+	///////////////////////////////////////////////////////////////////////////
+	// Methods defined in the StelModule class
+	virtual void init();
+	virtual void deinit();
+	virtual void update(double deltaTime);
+	virtual void draw(StelCore*) {;}
+	virtual double getCallOrder(StelModuleActionName actionName) const;
+
+	//! The types of the messages.
+	enum MessageType
+	{
+		MessageTableRequest=0,
+		MessageTable=1,
+		MessageSet=2,
+		MessageSubscribe=3,
+		MessageDelta=4
+	};
+
+	static const quint32 Magic = 0x5354524d;
+
+public slots:
+	//! Load the plug-in's settings from the [RemoteControl] section of the configuration file.
+	void loadConfiguration();
+	//! Write the default settings in the configuration file.
+	void restoreDefaultConfiguration();
+
+private:
+	enum EntryKind
+	{
+		EntryJd,
+		EntryTimeRate,
+		EntryViewDirection,
+		EntryFov,
+		EntryAction,
+		EntryProperty
+	};
+
+	//! A controllable value.
+	struct Entry
+	{
+		EntryKind kind;
+		QString name;
+		StelAction* action;
+		QObject* object;
+		QMetaProperty property;
+	};
+
+	struct Subscriber
+	{
+		QHostAddress address;
+		quint16 port;
+		qint64 expiration;
+		//! The values sent, empty before the first Delta.
+		QVector<QVariant> sent;
+	};
+
+	//! Build the table of the controllable values, once all the modules are loaded.
+	void buildTable();
+	//! Apply the values of a Set request.
+	void applyValues(const QList<QPair<int, QVariant> >& values);
+	//! Add or renew a subscription.
+	void subscribe(const QHostAddress& address, quint16 port);
+	QVariant readEntry(const Entry& entry) const;
+	void writeEntry(const Entry& entry, const QVariant& value);
+	QByteArray makeHeader(MessageType type);
+	void sendTable(const QHostAddress& address, quint16 port);
+	//! Send the values which changed to the subscribers.
+	void sendDeltas();
+	void send(const QByteArray& data, const QHostAddress& address, quint16 port);
+
+	QSettings* conf;
+	bool flagEnabled;
+	quint16 port;
+	//! Milliseconds after which a subscription expires.
+	int subscriptionTimeout;
+	QThread* thread;
+	RemoteControlServer* server;
+	QVector<Entry> entries;
+	QList<Subscriber> subscribers;
+	quint32 sequence;
+	QElapsedTimer clock;
+};
+
+
+#include <QObject>
+#include "StelPluginInterface.hpp"
+
+//! This class is used by Qt to manage a plug-in interface
+class RemoteControlStelPluginInterface : public QObject, public StelPluginInterface
+{
+	Q_OBJECT
+	Q_PLUGIN_METADATA(IID "stellarium.StelGuiPluginInterface/1.0")
+	Q_INTERFACES(StelPluginInterface)
+public:
+	virtual StelModule* getStelModule() const;
+	virtual StelPluginInfo getPluginInfo() const;
+};
+
+#endif // _REMOTECONTROL_HPP_
@@ -36,6 +36,7 @@
 #include <QByteArray>
 
 #include "gsatellite/gTime.hpp"
+#include "gsatellite/stdsat.h"
 
 #include <cmath>
 
@@ -50,6 +51,7 @@ int Satellite::orbitLineFadeSegments = 4;
 int Satellite::orbitLineSegmentDuration = 20;
 bool Satellite::orbitLinesFlag = true;
 bool Satellite::realisticModeFlag = false;
+Vec3d Satellite::observerDirection = Vec3d(1.,0.,0.);
 
 
 Satellite::Satellite(const QString& identifier, const QVariantMap& map)
@@ -59,6 +61,7 @@ Satellite::Satellite(const QString& identifier, const QVariantMap& map)
       userDefined(false),
       newlyAdded(false),
       orbitValid(false),
+      belowHorizon(false),
       jdLaunchYearJan1(0),
       stdMag(99.),
       height(0.),
@@ -70,7 +73,9 @@ Satellite::Satellite(const QString& identifier, const QVariantMap& map)
       visibility(0),
       phaseAngle(0.),
       lastEpochCompForOrbit(0.),
-      epochTime(0.)
+      epochTime(0.),
+      pSnapshotSatWrapper(NULL),
+      orbitCenterVertices(StelVertexArray::Lines)
 
 {
 	// return initialized if the mandatory fields are not present
@@ -159,6 +164,7 @@ Satellite::~Satellite()
 		delete pSatWrapper;
 		pSatWrapper = NULL;
 	}
+	delete pSnapshotSatWrapper;
 }
 
 double Satellite::roundToDp(float n, int dp)
@@ -409,6 +415,12 @@ void Satellite::setNewTleElements(const QString& tle1, const QString& tle2)
 	tleElements.second.clear();
 	tleElements.second.append(tle2);
 
+	// The snapshots computed from the previous elements are not valid anymore
+	delete pSnapshotSatWrapper;
+	pSnapshotSatWrapper = NULL;
+	for (int i=0; i<NbSnapshots; ++i)
+		snapshots[i].valid = false;
+
 	pSatWrapper = new gSatWrapper(id, tle1, tle2);
 	orbitPoints.clear();
 	
@@ -421,13 +433,85 @@ void Satellite::update(double)
 	{
 		StelCore* core = StelApp::getInstance().getCore();
 		double JD = core->getJDay();
-		epochTime = JD - core->getDeltaT(JD)/86400; // Delta T anti-correction for artificial satellites
+		propagate(JD - core->getDeltaT(JD)/86400); // Delta T anti-correction for artificial satellites
+		updatePosition();
+	}
+}
 
+void Satellite::propagate(double epoch)
+{
+	if (pSatWrapper && orbitValid)
+	{
+		epochTime = epoch;
 		pSatWrapper->setEpoch(epochTime);
 		position                 = pSatWrapper->getTEMEPos();
 		velocity                 = pSatWrapper->getTEMEVel();
 		latLongSubPointPosition  = pSatWrapper->getSubPoint();
 		height                   = latLongSubPointPosition[2];
+	}
+}
+
+void Satellite::propagateSnapshot(int slot, double epoch)
+{
+	Q_ASSERT(slot>=0 && slot<NbSnapshots);
+	StateSnapshot& snapshot = snapshots[slot];
+	snapshot.valid = false;
+	// orbitValid is not checked here as it is changed by the main thread
+	if (!pSatWrapper)
+		return;
+	if (!pSnapshotSatWrapper)
+		pSnapshotSatWrapper = new gSatWrapper(id, QString::fromLatin1(tleElements.first), QString::fromLatin1(tleElements.second));
+	pSnapshotSatWrapper->setEpoch(epoch);
+	snapshot.epoch    = epoch;
+	snapshot.position = pSnapshotSatWrapper->getTEMEPos();
+	snapshot.velocity = pSnapshotSatWrapper->getTEMEVel();
+	snapshot.valid    = true;
+}
+
+bool Satellite::interpolateSnapshots(int slot0, int slot1, double epoch)
+{
+	Q_ASSERT(slot0>=0 && slot0<NbSnapshots && slot1>=0 && slot1<NbSnapshots);
+	if (!pSatWrapper || !orbitValid)
+		return true; // Nothing to compute anyway
+	const StateSnapshot& s0 = snapshots[slot0];
+	const StateSnapshot& s1 = snapshots[slot1];
+	if (!s0.valid || !s1.valid)
+		return false;
+
+	// Positions are in km and velocities in km/s, so the interpolation is done in seconds
+	const double h = (s1.epoch - s0.epoch)*86400.;
+	Vec3d pos, vel;
+	if (h<=0. || epoch>s1.epoch)
+	{
+		// Linear extrapolation from the last snapshot
+		const double dt = (epoch - s1.epoch)*86400.;
+		pos = s1.position + s1.velocity*dt;
+		vel = s1.velocity;
+	}
+	else
+	{
+		const double t = (epoch - s0.epoch)*86400./h;
+		const double t2 = t*t;
+		const double t3 = t2*t;
+		pos = s0.position*(2.*t3-3.*t2+1.) + s0.velocity*(h*(t3-2.*t2+t))
+		    + s1.position*(3.*t2-2.*t3) + s1.velocity*(h*(t3-t2));
+		vel = (s0.position-s1.position)*((6.*t2-6.*t)/h) + s0.velocity*(3.*t2-4.*t+1.)
+		    + s1.velocity*(3.*t2-2.*t);
+	}
+
+	epochTime = epoch;
+	pSatWrapper->setEpochState(epochTime, pos, vel);
+	position                 = pos;
+	velocity                 = vel;
+	latLongSubPointPosition  = pSatWrapper->getSubPoint();
+	height                   = latLongSubPointPosition[2];
+	return true;
+}
+
+void Satellite::updatePosition(bool skipBelowHorizon)
+{
+	if (pSatWrapper && orbitValid)
+	{
 		if (height <= 0.0)
 		{
 			// The orbit is no longer valid.  Causes include very out of date
@@ -441,6 +525,14 @@ void Satellite::update(double)
 			return;
 		}
 
+		// The orbit line is computed from horizontal coordinates, so it needs them anyway
+		belowHorizon = skipBelowHorizon && !orbitDisplayed && !isInObserverFootprint();
+		if (belowHorizon)
+		{
+			visibility = NOT_VISIBLE;
+			return;
+		}
+
 		elAzPosition             = pSatWrapper->getAltAz();
 		elAzPosition.normalize();
 
@@ -453,6 +545,32 @@ void Satellite::update(double)
 	}
 }
 
+bool Satellite::isInObserverFootprint() const
+{
+	// A satellite at the height h is above the horizon from the points of the Earth
+	// at an angular distance lower than acos(R/(R+h)) from its sub point. A small
+	// margin accounts for the flattening of the Earth, the altitude of the observer
+	// and the refraction.
+	static const double margin = 2.*M_PI/180.;
+	static const double cosMargin = std::cos(margin);
+	static const double sinMargin = std::sin(margin);
+	const double cosFootprint = KEARTHRADIUS/(KEARTHRADIUS+height);
+	const double sinFootprint = std::sqrt(1.-cosFootprint*cosFootprint);
+
+	const double lat = latLongSubPointPosition[0]*M_PI/180.;
+	const double lng = latLongSubPointPosition[1]*M_PI/180.;
+	const double cosLat = std::cos(lat);
+	const Vec3d subPointDirection(cosLat*std::cos(lng), cosLat*std::sin(lng), std::sin(lat));
+	return subPointDirection.dot(observerDirection) >= cosFootprint*cosMargin - sinFootprint*sinMargin;
+}
+
+void Satellite::setObserverLocation(double latitude, double longitude)
+{
+	const double lat = latitude*M_PI/180.;
+	const double lng = longitude*M_PI/180.;
+	observerDirection.set(std::cos(lat)*std::cos(lng), std::cos(lat)*std::sin(lng), std::sin(lat));
+}
+
 double Satellite::getDoppler(double freq) const
 {
 	double result;
@@ -534,9 +652,10 @@ bool Satellite::operator <(const Satellite& another) const
 		return false;
 }
 
-void Satellite::draw(StelCore* core, StelPainter& painter, float)
+void Satellite::draw(StelCore* core, StelPainter& painter, StelSkyDrawer::PointSourceBatch& pointSources)
 {
 	if (core->getJDay() < jdLaunchYearJan1) return;
+	if (belowHorizon) return;
 
 	XYZ = getJ2000EquatorialPos(core);
 	StelSkyDrawer* sd = core->getSkyDrawer();
@@ -550,27 +669,19 @@ void Satellite::draw(StelCore* core, StelPainter& painter, float)
 	if (realisticModeFlag)
 	{
 		double mag = getVMagnitude(core);
-		RCMag rcMag;
-		Vec3f color = Vec3f(1.f,1.f,1.f);
-
-		StelProjectorP origP = painter.getProjector(); // Save projector state
-		painter.setProjector(prj);
-
-		sd->preDrawPointSource(&painter);
 		if (mag <= sd->getLimitMagnitude())
 		{
+			RCMag rcMag;
 			sd->computeRCMag(mag, &rcMag);
-			sd->drawPointSource(&painter, Vec3f(XYZ[0], XYZ[1], XYZ[2]), rcMag, color, true);
-			painter.setColor(color[0], color[1], color[2], 1);
-
-			if (Satellite::showLabels)
-				painter.drawText(XYZ, name, 0, 10, 10, false);
+			sd->projectPointSource(prj.data(), Vec3f(XYZ[0], XYZ[1], XYZ[2]), rcMag, Vec3f(1.f,1.f,1.f), true, pointSources);
 
+			Vec3d xy;
+			if (Satellite::showLabels && prj->project(XYZ,xy))
+			{
+				painter.setColor(1.f, 1.f, 1.f, 1.f);
+				painter.drawText(xy[0], xy[1], name, 0, 10, 10, false);
+			}
 		}
-
-		sd->postDrawPointSource(&painter);
-
-		painter.setProjector(origP); // Restrore projector state
 	}
 	else
 	{
@@ -590,43 +701,24 @@ void Satellite::draw(StelCore* core, StelPainter& painter, float)
 
 void Satellite::drawOrbit(StelPainter& painter)
 {
-	Vec3d position,previousPosition;
+	if (orbitPoints.size()<2)
+		return;
 
 	glDisable(GL_TEXTURE_2D);
 
-	QList<Vec3d>::iterator it= orbitPoints.begin();
-
-	//First point projection calculation
-	previousPosition.set(it->operator [](0), it->operator [](1), it->operator [](2));
-
-	it++;
-	StelVertexArray vertexArray;
-	vertexArray.primitiveType=StelVertexArray::Lines;
-
-	//Rest of points
+	// Draw end (fading) parts of orbit lines one segment at a time.
 	for (int i=1; i<orbitPoints.size(); i++)
 	{
-		position.set(it->operator [](0), it->operator [](1), it->operator [](2));
-		it++;
-		position.normalize();
-		previousPosition.normalize();
-		
-		// Draw end (fading) parts of orbit lines one segment at a time.
 		if (i<=orbitLineFadeSegments || orbitLineSegments-i < orbitLineFadeSegments)
 		{
 			painter.setColor(orbitColor[0], orbitColor[1], orbitColor[2], hintBrightness * calculateOrbitSegmentIntensity(i));
-			painter.drawGreatCircleArc(previousPosition, position, &viewportHalfspace);
-		}
-		else
-		{
-			vertexArray.vertex << previousPosition << position;
+			painter.drawGreatCircleArc(orbitPoints.at(i-1), orbitPoints.at(i), &viewportHalfspace);
 		}
-		previousPosition = position;
 	}
 
 	// Draw center section of orbit in one go
 	painter.setColor(orbitColor[0], orbitColor[1], orbitColor[2], hintBrightness);
-	painter.drawGreatCircleArcs(vertexArray, &viewportHalfspace);
+	painter.drawGreatCircleArcs(orbitCenterVertices, &viewportHalfspace);
 
 	glEnable(GL_TEXTURE_2D);
 }
@@ -646,89 +738,62 @@ float Satellite::calculateOrbitSegmentIntensity(int segNum)
 	}
 }
 
-void Satellite::computeOrbitPoints()
+Vec3d Satellite::computeOrbitPoint(double epoch)
 {
-	gTimeSpan computeInterval(0, 0, 0, orbitLineSegmentDuration);
-	gTimeSpan orbitSpan(0, 0, 0, orbitLineSegments*orbitLineSegmentDuration/2);
-	gTime epochTm;
-	gTime epoch(epochTime);
-	gTime lastEpochComp(lastEpochCompForOrbit);
-	Vec3d elAzVector;
-	int diffSlots;
-
+	pSatWrapper->setEpoch(epoch);
+	Vec3d elAzVector = pSatWrapper->getAltAz();
+	elAzVector.normalize();
+	return elAzVector;
+}
 
-	if (orbitPoints.isEmpty())//Setup orbitPoins
+void Satellite::computeOrbitPoints()
+{
+	// The orbit line is a window of orbitLineSegments segments centered on the
+	// current epoch. The points are computed at whole multiples of the segment
+	// duration from lastEpochCompForOrbit, so that when time runs only the
+	// points entering the window have to be propagated.
+	const double segmentDuration = orbitLineSegmentDuration/86400.; // days
+	const double orbitSpan = (orbitLineSegments*orbitLineSegmentDuration/2)/86400.; // days
+	int diffSlots = 0;
+	if (orbitPoints.size()==orbitLineSegments+1)
+		diffSlots = (int)((epochTime - lastEpochCompForOrbit)/segmentDuration);
+
+	if (orbitPoints.size()!=orbitLineSegments+1 || qAbs(diffSlots)>orbitLineSegments)
 	{
-		epochTm  = epoch - orbitSpan;
-
+		orbitPoints.clear();
 		for (int i=0; i<=orbitLineSegments; i++)
-		{
-			pSatWrapper->setEpoch(epochTm.getGmtTm());
-			elAzVector  = pSatWrapper->getAltAz();
-			orbitPoints.append(elAzVector);
-			epochTm    += computeInterval;
-		}
+			orbitPoints.append(computeOrbitPoint(epochTime - orbitSpan + i*segmentDuration));
 		lastEpochCompForOrbit = epochTime;
 	}
-	else if (epochTime > lastEpochCompForOrbit)
-	{ // compute next orbit point when clock runs forward
-
-		gTimeSpan diffTime = epoch - lastEpochComp;
-		diffSlots          = (int)(diffTime.getDblSeconds()/orbitLineSegmentDuration);
-
-		if (diffSlots > 0)
+	else if (diffSlots>0)
+	{
+		// Clock running forward: remove points at beginning of list and add points at end.
+		for (int i=1; i<=diffSlots; i++)
 		{
-			if (diffSlots > orbitLineSegments)
-			{
-				diffSlots = orbitLineSegments + 1;
-				epochTm  = epoch - orbitSpan;
-			}
-			else
-			{
-				epochTm   = lastEpochComp + orbitSpan + computeInterval;
-			}
-
-			for (int i=0; i<diffSlots; i++)
-			{
-				//remove points at beginning of list and add points at end.
-				orbitPoints.removeFirst();
-				pSatWrapper->setEpoch(epochTm.getGmtTm());
-				elAzVector  = pSatWrapper->getAltAz();
-				orbitPoints.append(elAzVector);
-				epochTm    += computeInterval;
-			}
-
-			lastEpochCompForOrbit = epochTime;
+			orbitPoints.removeFirst();
+			orbitPoints.append(computeOrbitPoint(lastEpochCompForOrbit + orbitSpan + i*segmentDuration));
 		}
+		lastEpochCompForOrbit += diffSlots*segmentDuration;
 	}
-	else if (epochTime < lastEpochCompForOrbit)
-	{ // compute next orbit point when clock runs backward
-		gTimeSpan diffTime = lastEpochComp - epoch;
-		diffSlots          = (int)(diffTime.getDblSeconds()/orbitLineSegmentDuration);
-
-		if (diffSlots > 0)
+	else if (diffSlots<0)
+	{
+		// Clock running backward: remove points at end of list and add points at beginning.
+		for (int i=1; i<=-diffSlots; i++)
 		{
-			if (diffSlots > orbitLineSegments)
-			{
-				diffSlots = orbitLineSegments + 1;
-				epochTm   = epoch + orbitSpan;
-			}
-			else
-			{
-				epochTm   = epoch - orbitSpan - computeInterval;
-			}
-			for (int i=0; i<diffSlots; i++)
-			{ //remove points at end of list and add points at beginning.
-				orbitPoints.removeLast();
-				pSatWrapper->setEpoch(epochTm.getGmtTm());
-				elAzVector  = pSatWrapper->getAltAz();
-				orbitPoints.push_front(elAzVector);
-				epochTm -= computeInterval;
-
-			}
-			lastEpochCompForOrbit = epochTime;
+			orbitPoints.removeLast();
+			orbitPoints.prepend(computeOrbitPoint(lastEpochCompForOrbit - orbitSpan - i*segmentDuration));
 		}
+		lastEpochCompForOrbit += diffSlots*segmentDuration;
 	}
+	else
+	{
+		return;
+	}
+
+	// Rebuild the central, non fading, part of the line only when the points change
+	orbitCenterVertices.vertex.clear();
+	for (int i=orbitLineFadeSegments+1; i<=orbitLineSegments-orbitLineFadeSegments && i<orbitPoints.size(); i++)
+		orbitCenterVertices.vertex << orbitPoints.at(i-1) << orbitPoints.at(i);
 }
 
 
@@ -29,6 +29,7 @@
 #include <QVariant>
 
 #include "StelObject.hpp"
+#include "StelSkyDrawer.hpp"
 #include "StelTextureTypes.hpp"
 #include "StelSphereGeometry.hpp"
 #include "gSatWrapper.hpp"
@@ -136,6 +137,39 @@ public:
 	// calculate faders, new position
 	void update(double deltaTime);
 
+	//! Run the SGP4 propagation to the given epoch (in Julian Days, without Delta T).
+	//! This only touches the data of this satellite, so the propagation of several
+	//! satellites can be run concurrently. updatePosition() must be called afterward.
+	void propagate(double epoch);
+	//! Compute the quantities derived from the propagated position (horizontal
+	//! coordinates, range, visibility...). Must be called from the main thread.
+	//! @param skipBelowHorizon if true and the satellite is below the horizon of the
+	//! observer (see isInObserverFootprint()), the derived quantities are not computed
+	//! and the satellite is not drawn until it rises.
+	void updatePosition(bool skipBelowHorizon=false);
+	//! Coarse test of the visibility of the satellite from the observer location set by
+	//! setObserverLocation(): check that the observer is inside the footprint of the
+	//! satellite, i.e. the area of the Earth surface from which it is above the horizon.
+	//! Only uses the sub point, so it is much cheaper than the horizontal coordinates.
+	bool isInObserverFootprint() const;
+	//! Set the geographic location used by isInObserverFootprint().
+	//! @param latitude, longitude in degrees.
+	static void setObserverLocation(double latitude, double longitude);
+
+	//! Number of state snapshots kept by each satellite for the background propagation.
+	static const int NbSnapshots = 3;
+	//! Run the SGP4 propagation to the given epoch and store the result in a snapshot
+	//! slot, without changing the current position of the satellite. This uses a
+	//! separate propagator, so it can run in a worker thread while the main thread
+	//! reads the other slots. The caller is responsible for not writing a slot which is read.
+	void propagateSnapshot(int slot, double epoch);
+	//! Set the current state from the cubic Hermite interpolation between two snapshots,
+	//! the epoch being between their epochs or shortly after the last one.
+	//! updatePosition() must be called afterward.
+	//! @return false if one of the snapshots is not available yet, in which case
+	//! propagate() has to be used.
+	bool interpolateSnapshots(int slot0, int slot1, double epoch);
+
 	double getDoppler(double freq) const;
 	static float showLabels;
 	static double roundToDp(float n, int dp);
@@ -165,6 +199,9 @@ public:
 private:
 	//draw orbits methods
 	void computeOrbitPoints();
+	//! Get the normalized horizontal position of the satellite at the given epoch.
+	//! @warning Changes the epoch of pSatWrapper.
+	Vec3d computeOrbitPoint(double epoch);
 	void drawOrbit(StelPainter& painter);
 	//! returns 0 - 1.0 for the DRAWORBIT_FADE_NUMBER segments at
 	//! each end of an orbit, with 1 in the middle.
@@ -185,6 +222,9 @@ private:
 	//! Flag indicating that the satellite was added during the current session.
 	bool newlyAdded;
 	bool orbitValid;
+	//! Flag indicating that the derived quantities were not computed in the
+	//! last update because the satellite was below the horizon.
+	bool belowHorizon;
 
 	//! Identifier of the satellite, must be unique within the list.
 	//! Currently, the Satellite Catalog Number/NORAD Number is used,
@@ -226,8 +266,13 @@ private:
 	static bool  realisticModeFlag;
 	//! Mask controlling which info display flags should be honored.
 	static StelObject::InfoStringGroupFlags flagsMask;
+	//! Unit vector of the observer location in geocentric coordinates.
+	static Vec3d observerDirection;
 
-	void draw(StelCore *core, StelPainter& painter, float maxMagHints);
+	//! Draw the hint, label and orbit of the satellite with a painter recording a batch,
+	//! see StelPainter::beginBatch(). In realistic mode the satellite is not drawn, but
+	//! projected in pointSources so that all the satellites are drawn at once.
+	void draw(StelCore *core, StelPainter& painter, StelSkyDrawer::PointSourceBatch& pointSources);
 
 	//Satellite Orbit Position calculation
 	gSatWrapper *pSatWrapper;
@@ -243,7 +288,22 @@ private:
 	Vec3f    orbitColor;
 	double    lastEpochCompForOrbit; //measured in Julian Days
 	double    epochTime;  //measured in Julian Days
-	QList<Vec3d> orbitPoints; //orbit points represented by ElAzPos vectors
+
+	//! State of the satellite propagated in the background.
+	struct StateSnapshot
+	{
+		StateSnapshot() : valid(false), epoch(0.) {}
+		bool  valid;
+		double epoch; //measured in Julian Days
+		Vec3d position;
+		Vec3d velocity;
+	};
+	//! Propagator used by propagateSnapshot(), created on first use.
+	gSatWrapper* pSnapshotSatWrapper;
+	StateSnapshot snapshots[NbSnapshots];
+	QList<Vec3d> orbitPoints; //orbit points represented by normalized ElAzPos vectors
+	//! Segments of the orbit line drawn without fading, updated with orbitPoints.
+	StelVertexArray orbitCenterVertices;
 };
 
 typedef QSharedPointer<Satellite> SatelliteP;
@@ -0,0 +1,353 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "SatellitePasses.hpp"
+#include "gSatWrapper.hpp"
+
+#include <QMetaObject>
+#include <QtConcurrent>
+
+#include <cmath>
+
+namespace
+{
+	//! Precision of the refined dates, in days.
+	const double datePrecision = 1./86400.;
+	//! Altitude of the Sun below which the observer is in the dark, in degrees.
+	const double twilightSunAltitude = -6.;
+	//! Local maxima of the coarse samples closer than this to the minimum
+	//! altitude are refined, to find the short passes between two samples.
+	const double grazingMargin = 5.;
+	//! Above this number of predicted passes, the cache is cleared.
+	const int maxCachedPasses = 200000;
+
+	double altitudeOf(const Vec3d& topo)
+	{
+		return std::asin(topo[2]/topo.length()) * 180./M_PI;
+	}
+
+	double azimuthOf(const Vec3d& topo)
+	{
+		// The topocentric coordinates are south, east, zenith
+		double az = std::atan2(topo[1], -topo[0]) * 180./M_PI;
+		return az < 0. ? az + 360. : az;
+	}
+
+	//! Positions of one satellite relative to one observer.
+	class PassContext
+	{
+	public:
+		PassContext(gSatWrapper& sat, const StelLocation& loc, double minAltitude)
+			: sat(sat), latitude(loc.latitude), longitude(loc.longitude), altitude(loc.altitude), minAltitude(minAltitude) {}
+
+		Vec3d topocentric(double jd) const
+		{
+			sat.setEpoch(jd);
+			return gSatWrapper::computeAltAz(gTime(jd), sat.getTEMEPos(), latitude, longitude, altitude);
+		}
+
+		double satelliteAltitude(double jd) const {return altitudeOf(topocentric(jd));}
+		double satelliteAzimuth(double jd) const {return azimuthOf(topocentric(jd));}
+		bool isRisen(double jd) const {return satelliteAltitude(jd) > minAltitude;}
+
+		//! Whether the satellite is sunlit while the observer is in the dark.
+		bool isVisible(double jd) const
+		{
+			const gTime t(jd);
+			const Vec3d sunPos = gSatWrapper::computeSunECIPos(t);
+			if (altitudeOf(gSatWrapper::computeAltAz(t, sunPos, latitude, longitude, altitude)) > twilightSunAltitude)
+				return false;
+			sat.setEpoch(jd);
+			return gSatWrapper::isSunlit(sat.getTEMEPos(), sunPos);
+		}
+
+		//! Find the date at which a test changes between two dates, by bisection.
+		//! @param out the date at which the test is false.
+		//! @param in the date at which the test is true, before or after out.
+		//! @return the date closest to out at which the test is true, within datePrecision.
+		double bisect(bool (PassContext::*test)(double) const, double out, double in) const
+		{
+			while (std::fabs(in-out) > datePrecision)
+			{
+				const double mid = 0.5*(in+out);
+				if ((this->*test)(mid))
+					in = mid;
+				else
+					out = mid;
+			}
+			return in;
+		}
+
+		//! Find the date of the maximum altitude between two dates, by golden section search.
+		double culmination(double a, double b) const
+		{
+			static const double r = 0.618033988749895;
+			double c = b - r*(b-a);
+			double d = a + r*(b-a);
+			double fc = satelliteAltitude(c);
+			double fd = satelliteAltitude(d);
+			while (b-a > datePrecision)
+			{
+				if (fc > fd)
+				{
+					b = d; d = c; fd = fc;
+					c = b - r*(b-a);
+					fc = satelliteAltitude(c);
+				}
+				else
+				{
+					a = c; c = d; fc = fd;
+					d = a + r*(b-a);
+					fd = satelliteAltitude(d);
+				}
+			}
+			return 0.5*(a+b);
+		}
+
+	private:
+		gSatWrapper& sat;
+		double latitude;
+		double longitude;
+		double altitude;
+		double minAltitude;
+	};
+
+	//! Complete a pass whose rise and set dates are known.
+	void finishPass(const PassContext& ctx, SatellitePass& pass)
+	{
+		pass.culminationJD = ctx.culmination(pass.riseJD, pass.setJD);
+		pass.maxAltitude = ctx.satelliteAltitude(pass.culminationJD);
+		pass.riseAzimuth = ctx.satelliteAzimuth(pass.riseJD);
+		pass.setAzimuth = ctx.satelliteAzimuth(pass.setJD);
+
+		// The visibility changes at most a few times during a pass, sample it
+		// coarsely and refine the first and last changes.
+		const int nbSamples = 20;
+		const double step = (pass.setJD-pass.riseJD)/nbSamples;
+		int first = -1, last = -1;
+		for (int i=0; i<=nbSamples; ++i)
+		{
+			if (ctx.isVisible(pass.riseJD + i*step))
+			{
+				if (first<0)
+					first = i;
+				last = i;
+			}
+		}
+		pass.visibleStartJD = pass.visibleEndJD = pass.riseJD;
+		if (first<0)
+			return;
+		pass.visibleStartJD = first==0 ? pass.riseJD : ctx.bisect(&PassContext::isVisible, pass.riseJD + (first-1)*step, pass.riseJD + first*step);
+		pass.visibleEndJD = last==nbSamples ? pass.setJD : ctx.bisect(&PassContext::isVisible, pass.riseJD + (last+1)*step, pass.riseJD + last*step);
+	}
+
+	bool passBefore(const SatellitePass& p1, const SatellitePass& p2)
+	{
+		return p1.riseJD < p2.riseJD;
+	}
+}
+
+SatellitePassPredictor::SatellitePassPredictor(QObject* parent)
+	: QObject(parent)
+	, currentStartJD(0.)
+	, currentEndJD(0.)
+{
+	connect(&watcher, SIGNAL(finished()), this, SLOT(collectResults()));
+}
+
+SatellitePassPredictor::~SatellitePassPredictor()
+{
+	cancel();
+}
+
+QList<SatellitePass> SatellitePassPredictor::computePasses(const SatellitePassRequest& satellite, const StelLocation& location,
+                                                           double startJD, double endJD, double minAltitude)
+{
+	QList<SatellitePass> passes;
+	gSatWrapper sat(satellite.id, QString::fromLatin1(satellite.tle1), QString::fromLatin1(satellite.tle2));
+	const PassContext ctx(sat, location, minAltitude);
+
+	// A coarse step of one minute does not miss the passes of the low orbits,
+	// which last several minutes. The mean motion is in revolutions per day.
+	const double meanMotion = satellite.tle2.mid(52, 11).trimmed().toDouble();
+	const double step = (meanMotion > 6. ? 60. : 300.)/86400.;
+
+	double t0 = startJD;
+	double alt0 = ctx.satelliteAltitude(t0);
+	double tPrev = t0;
+	double altPrev = alt0;
+	bool inPass = alt0 > minAltitude;
+	SatellitePass pass;
+	pass.id = satellite.id;
+	pass.riseJD = startJD;
+	while (t0 < endJD)
+	{
+		const double t1 = qMin(t0 + step, endJD);
+		const double alt1 = ctx.satelliteAltitude(t1);
+		if (!inPass && alt1 > minAltitude)
+		{
+			pass.riseJD = ctx.bisect(&PassContext::isRisen, t0, t1);
+			inPass = true;
+		}
+		else if (inPass && alt1 <= minAltitude)
+		{
+			pass.setJD = ctx.bisect(&PassContext::isRisen, t1, t0);
+			finishPass(ctx, pass);
+			passes.append(pass);
+			inPass = false;
+		}
+		else if (!inPass && alt0 > altPrev && alt0 >= alt1 && alt0 > minAltitude - grazingMargin)
+		{
+			// A maximum below the minimum altitude between the samples may hide a short pass
+			const double tMax = ctx.culmination(tPrev, t1);
+			if (ctx.isRisen(tMax))
+			{
+				pass.riseJD = ctx.bisect(&PassContext::isRisen, tPrev, tMax);
+				pass.setJD = ctx.bisect(&PassContext::isRisen, t1, tMax);
+				finishPass(ctx, pass);
+				passes.append(pass);
+			}
+		}
+		tPrev = t0;
+		altPrev = alt0;
+		t0 = t1;
+		alt0 = alt1;
+	}
+	if (inPass)
+	{
+		// Pass truncated by the end of the range
+		pass.setJD = endJD;
+		finishPass(ctx, pass);
+		passes.append(pass);
+	}
+	return passes;
+}
+
+SatellitePassPredictor::Job SatellitePassPredictor::runJob(const Job& job)
+{
+	Job result = job;
+	result.result.startJD = job.startJD;
+	result.result.endJD = job.endJD;
+	result.result.passes = computePasses(job.satellite, job.location, job.startJD, job.endJD);
+	return result;
+}
+
+QString SatellitePassPredictor::cacheKey(const SatellitePassRequest& satellite, const StelLocation& location)
+{
+	// The epoch is in columns 19 to 32 of the first line
+	return QString("%1,%2,%3|%4|%5")
+	        .arg(location.latitude, 0, 'f', 4)
+	        .arg(location.longitude, 0, 'f', 4)
+	        .arg(location.altitude)
+	        .arg(satellite.id)
+	        .arg(QString::fromLatin1(satellite.tle1.mid(18, 14)));
+}
+
+void SatellitePassPredictor::predict(const QList<SatellitePassRequest>& satellites, const StelLocation& location, double startJD, double days)
+{
+	cancel();
+
+	int nbCachedPasses = 0;
+	foreach (const CacheEntry& entry, cache)
+		nbCachedPasses += entry.passes.size();
+	if (nbCachedPasses > maxCachedPasses)
+		cache.clear();
+
+	currentStartJD = startJD;
+	currentEndJD = startJD + days;
+	currentKeys.clear();
+	QList<Job> jobs;
+	foreach (const SatellitePassRequest& satellite, satellites)
+	{
+		const QString key = cacheKey(satellite, location);
+		currentKeys.insert(satellite.id, key);
+		QHash<QString, CacheEntry>::const_iterator entry = cache.constFind(key);
+		if (entry != cache.constEnd() && entry.value().startJD <= currentStartJD && entry.value().endJD >= currentEndJD)
+			continue;
+		Job job;
+		job.key = key;
+		job.satellite = satellite;
+		job.location = location;
+		job.startJD = currentStartJD;
+		job.endJD = currentEndJD;
+		jobs.append(job);
+	}
+
+	if (jobs.isEmpty())
+		QMetaObject::invokeMethod(this, "passesPredicted", Qt::QueuedConnection);
+	else
+		watcher.setFuture(QtConcurrent::mapped(jobs, runJob));
+}
+
+void SatellitePassPredictor::cancel()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+	// Keep the satellites which were computed
+	storeResults();
+}
+
+void SatellitePassPredictor::waitForFinished()
+{
+	watcher.waitForFinished();
+	storeResults();
+}
+
+void SatellitePassPredictor::storeResults()
+{
+	const QFuture<Job> future = watcher.future();
+	const int count = future.resultCount();
+	for (int i=0; i<count; ++i)
+	{
+		const Job& job = future.resultAt(i);
+		cache.insert(job.key, job.result);
+	}
+}
+
+void SatellitePassPredictor::collectResults()
+{
+	if (watcher.future().isCanceled())
+		return;
+	storeResults();
+	emit passesPredicted();
+}
+
+QList<SatellitePass> SatellitePassPredictor::getPasses(const QString& id) const
+{
+	QList<SatellitePass> passes;
+	QHash<QString, CacheEntry>::const_iterator entry = cache.constFind(currentKeys.value(id));
+	if (entry == cache.constEnd())
+		return passes;
+	foreach (const SatellitePass& pass, entry.value().passes)
+	{
+		if (pass.setJD >= currentStartJD && pass.riseJD <= currentEndJD)
+			passes.append(pass);
+	}
+	return passes;
+}
+
+QList<SatellitePass> SatellitePassPredictor::getAllPasses() const
+{
+	QList<SatellitePass> passes;
+	QHash<QString, QString>::const_iterator i;
+	for (i = currentKeys.constBegin(); i != currentKeys.constEnd(); ++i)
+		passes << getPasses(i.key());
+	qSort(passes.begin(), passes.end(), passBefore);
+	return passes;
+}
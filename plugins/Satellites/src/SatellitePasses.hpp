@@ -0,0 +1,139 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _SATELLITEPASSES_HPP_
+#define _SATELLITEPASSES_HPP_
+
+#include "StelLocation.hpp"
+
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+//! A pass of a satellite above the horizon of an observer.
+//! The dates are Julian Days in UTC, like the epochs of the TLE sets.
+struct SatellitePass
+{
+	QString id;
+	double riseJD;
+	double culminationJD;
+	double setJD;
+	//! Azimuths at rise and set, in degrees from the north through the east.
+	double riseAzimuth;
+	double setAzimuth;
+	//! Altitude at culmination, in degrees.
+	double maxAltitude;
+	//! Part of the pass during which the satellite is sunlit while the
+	//! observer is in the dark, equal dates if there is none.
+	double visibleStartJD;
+	double visibleEndJD;
+
+	bool isVisible() const {return visibleEndJD > visibleStartJD;}
+};
+
+//! TLE set of a satellite whose passes are to be predicted.
+struct SatellitePassRequest
+{
+	QString id;
+	QByteArray tle1;
+	QByteArray tle2;
+};
+
+//! @class SatellitePassPredictor
+//! Predict the passes of many satellites over several days in worker threads.
+//! The positions are first computed with a coarse step, then the rise, set,
+//! culmination and visibility limits found in each interval are refined by
+//! bisection. The passes are cached by observer location and TLE epoch, so
+//! that only the satellites whose elements were updated are computed again.
+class SatellitePassPredictor : public QObject
+{
+	Q_OBJECT
+public:
+	SatellitePassPredictor(QObject* parent=NULL);
+	~SatellitePassPredictor();
+
+	//! Start the prediction of the passes in the given range of dates.
+	//! A prediction which is still running is cancelled.
+	//! @param startJD, days the range of dates, in Julian Days UTC.
+	void predict(const QList<SatellitePassRequest>& satellites, const StelLocation& location, double startJD, double days);
+	//! Return true if a prediction is running in the background.
+	bool isRunning() const {return watcher.isRunning();}
+	//! Wait for the end of the running prediction, and collect its results.
+	void waitForFinished();
+	//! Stop the running prediction, keeping the satellites already computed.
+	void cancel();
+
+	//! Get the passes of a satellite predicted by the last call to predict(),
+	//! in chronological order.
+	QList<SatellitePass> getPasses(const QString& id) const;
+	//! Get the passes of all the satellites predicted by the last call to
+	//! predict(), in chronological order.
+	QList<SatellitePass> getAllPasses() const;
+
+	//! Compute the passes of one satellite, thread safe.
+	//! @param minAltitude the altitude in degrees above which the satellite
+	//! is considered as risen.
+	static QList<SatellitePass> computePasses(const SatellitePassRequest& satellite, const StelLocation& location,
+	                                          double startJD, double endJD, double minAltitude=0.);
+
+signals:
+	//! Emitted when the passes of the last call to predict() are all available.
+	void passesPredicted();
+
+private slots:
+	void collectResults();
+
+private:
+	//! The passes of a satellite for a range of dates.
+	struct CacheEntry
+	{
+		double startJD;
+		double endJD;
+		QList<SatellitePass> passes;
+	};
+
+	//! The computation of one satellite in a worker thread.
+	struct Job
+	{
+		QString key;
+		SatellitePassRequest satellite;
+		StelLocation location;
+		double startJD;
+		double endJD;
+		CacheEntry result;
+	};
+	static Job runJob(const Job& job);
+	//! Move the results of the finished jobs to the cache.
+	void storeResults();
+
+	//! Key of the cache, from the observer location and the TLE epoch.
+	static QString cacheKey(const SatellitePassRequest& satellite, const StelLocation& location);
+
+	QFutureWatcher<Job> watcher;
+	QHash<QString, CacheEntry> cache;
+	//! Cache keys of the satellites of the last prediction, by satellite ID.
+	QHash<QString, QString> currentKeys;
+	double currentStartJD;
+	double currentEndJD;
+};
+
+#endif // _SATELLITEPASSES_HPP_
@@ -35,11 +35,15 @@
 #include "Planet.hpp"
 #include "SolarSystem.hpp"
 #include "StelJsonParser.hpp"
+#include "StelBinaryCatalog.hpp"
 #include "SatellitesDialog.hpp"
 #include "LabelMgr.hpp"
+#include "LandscapeMgr.hpp"
 #include "StelTranslator.hpp"
 #include "StelProgressController.hpp"
 #include "StelUtils.hpp"
+#include "StelJobSystem.hpp"
+#include "StelRenderStats.hpp"
 
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -51,6 +55,8 @@
 #include <QVariantMap>
 #include <QVariant>
 #include <QDir>
+#include <QSet>
+#include <QtConcurrent>
 
 StelModule* SatellitesStelPluginInterface::getStelModule() const
 {
@@ -88,6 +94,14 @@ Satellites::Satellites()
 	, autoRemoveEnabled(false)
 	, updateFrequencyHours(0)
 	, messageTimer(0)
+	, flagBackgroundPropagation(false)
+	, backgroundPropagationRate(10.)
+	, pendingSnapshot(-1)
+	, previousSnapshot(-1)
+	, latestSnapshot(-1)
+	, passPredictor(NULL)
+	, passPredictionDays(3.)
+	, statsPropagated(-1)
 {
 	setObjectName("Satellites");
 	configDialog = new SatellitesDialog();
@@ -95,12 +109,20 @@ Satellites::Satellites()
 
 void Satellites::deinit()
 {
+	// An update finishing now would not be applied
+	disconnect(&updateWatcher, 0, this, 0);
+	updateWatcher.waitForFinished();
+	waitForCatalogSave();
+	waitForPropagation();
+	if (passPredictor)
+		passPredictor->cancel();
 	Satellite::hintTexture.clear();
 	texPointer.clear();
 }
 
 Satellites::~Satellites()
 {
+	waitForPropagation();
 	delete configDialog;
 }
 
@@ -161,6 +183,8 @@ void Satellites::init()
 		return;
 	}
 
+	statsPropagated = StelApp::getInstance().getRenderStats()->registerCounter("Satellites propagated");
+
 	// A timer for hiding alert messages
 	messageTimer = new QTimer(this);
 	messageTimer->setSingleShot(true);   // recurring check for update
@@ -194,15 +218,18 @@ void Satellites::init()
 	loadCatalog();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)),
-	        this, SLOT(saveDownloadedUpdate(QNetworkReply*)));
+	downloadMgr = StelApp::getInstance().getNetworkAccessManager();
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
 	updateTimer->setInterval(13000);     // check once every 13 seconds to see if it is time for an update
 	connect(updateTimer, SIGNAL(timeout()), this, SLOT(checkForUpdate()));
 	updateTimer->start();
+	// The update lists are parsed in the background
+	connect(&updateWatcher, SIGNAL(finished()), this, SLOT(finishTleUpdate()));
+
+	passPredictor = new SatellitePassPredictor(this);
+	connect(passPredictor, SIGNAL(passesPredicted()), this, SIGNAL(passesPredicted()));
 
 	earth = GETSTELMODULE(SolarSystem)->getEarth();
 	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
@@ -216,6 +243,7 @@ void Satellites::init()
 
 bool Satellites::backupCatalog(bool deleteOriginal)
 {
+	waitForCatalogSave();
 	QFile old(catalogPath);
 	if (!old.exists())
 	{
@@ -255,6 +283,21 @@ double Satellites::getCallOrder(StelModuleActionName actionName) const
 	return 0;
 }
 
+qint64 Satellites::getMemoryUsed() const
+{
+	qint64 total = 0;
+	foreach(const SatelliteP& sat, satellites)
+	{
+		total += sizeof(Satellite) + sizeof(SatelliteP);
+		if (sat->pSatWrapper)
+			total += sizeof(gSatWrapper);
+		// The orbit points are stored in the nodes of a QList, the strings in UTF-16
+		total += sat->orbitPoints.size()*(qint64)(sizeof(Vec3d)+sizeof(void*));
+		total += (sat->id.size()+sat->name.size()+sat->description.size()+sat->internationalDesignator.size())*sizeof(ushort);
+	}
+	return total;
+}
+
 QList<StelObjectP> Satellites::searchAround(const Vec3d& av, double limitFov, const StelCore*) const
 {
 	QList<StelObjectP> result;
@@ -518,6 +561,9 @@ void Satellites::restoreDefaultSettings()
 	conf->setValue("orbit_fade_segments", 5);
 	conf->setValue("orbit_segment_duration", 20);
 	conf->setValue("realistic_mode_enabled", false);
+	conf->setValue("background_propagation_enabled", false);
+	conf->setValue("background_propagation_rate", 10.);
+	conf->setValue("pass_prediction_days", 3.);
 	
 	conf->endGroup(); // saveTleSources() opens it for itself
 	
@@ -655,6 +701,13 @@ void Satellites::loadSettings()
 	// realistic mode
 	setFlagRelisticMode(conf->value("realistic_mode_enabled", false).toBool());
 
+	// background propagation
+	backgroundPropagationRate = qMax(conf->value("background_propagation_rate", 10.).toDouble(), 0.1);
+	setFlagBackgroundPropagation(conf->value("background_propagation_enabled", false).toBool());
+
+	// pass prediction
+	passPredictionDays = qBound(0.1, conf->value("pass_prediction_days", 3.).toDouble(), 30.);
+
 	conf->endGroup();
 }
 
@@ -683,6 +736,13 @@ void Satellites::saveSettings()
 	// realistic mode
 	conf->setValue("realistic_mode_enabled", getFlagRealisticMode());
 
+	// background propagation
+	conf->setValue("background_propagation_enabled", flagBackgroundPropagation);
+	conf->setValue("background_propagation_rate", backgroundPropagationRate);
+
+	// pass prediction
+	conf->setValue("pass_prediction_days", passPredictionDays);
+
 	conf->endGroup();
 	
 	// Update sources...
@@ -721,29 +781,20 @@ const QString Satellites::readCatalogVersion()
 	return jsonVersion;
 }
 
-bool Satellites::saveDataMap(const QVariantMap& map, QString path)
+void Satellites::saveDataMap(const QVariantMap& map, QString path)
 {
 	if (path.isEmpty())
 		path = catalogPath;
 
-	QFile jsonFile(path);
-	StelJsonParser parser;
-
-	if (jsonFile.exists())
-		jsonFile.remove();
+	// The writes of the same file must not overlap
+	waitForCatalogSave();
+	qDebug() << "Satellites::saveTleMap() writing to:" << QDir::toNativeSeparators(path);
+	saveJob = QtConcurrent::run(StelBinaryCatalog::saveJsonCatalog, map, path);
+}
 
-	if (!jsonFile.open(QIODevice::WriteOnly))
-	{
-		qWarning() << "Satellites::saveTleMap() cannot open for writing:" << QDir::toNativeSeparators(path);
-		return false;
-	}
-	else
-	{
-		qDebug() << "Satellites::saveTleMap() writing to:" << QDir::toNativeSeparators(path);
-		parser.write(map, &jsonFile);
-		jsonFile.close();
-		return true;
-	}
+void Satellites::waitForCatalogSave()
+{
+	saveJob.waitForFinished();
 }
 
 QVariantMap Satellites::loadDataMap(QString path)
@@ -751,16 +802,9 @@ QVariantMap Satellites::loadDataMap(QString path)
 	if (path.isEmpty())
 		path = catalogPath;
 
-	QVariantMap map;
-	QFile jsonFile(path);
-	if (!jsonFile.open(QIODevice::ReadOnly))
-		qWarning() << "Satellites::loadTleMap cannot open " << QDir::toNativeSeparators(path);
-	else
-	{
-		map = StelJsonParser::parse(&jsonFile).toMap();
-		jsonFile.close();
-	}
-	return map;
+	waitForCatalogSave();
+
+	return StelBinaryCatalog::loadJsonCatalog(path);
 }
 
 void Satellites::setDataMap(const QVariantMap& map)
@@ -778,6 +822,7 @@ void Satellites::setDataMap(const QVariantMap& map)
 	if (satelliteListModel)
 		satelliteListModel->beginSatellitesChange();
 	
+	waitForPropagation();
 	satellites.clear();
 	groups.clear();
 	QVariantMap satMap = map.value("satellites").toMap();
@@ -919,13 +964,21 @@ QStringList Satellites::listAllIds()
 bool Satellites::add(const TleData& tleData)
 {
 	//TODO: Duplicates check!!! --BM
-	
+	SatelliteP sat = createSatellite(tleData);
+	if (sat.isNull())
+		return false;
+	satellites.append(sat);
+	return true;
+}
+
+SatelliteP Satellites::createSatellite(const TleData& tleData)
+{
 	// More validation?
 	if (tleData.id.isEmpty() ||
 	        tleData.name.isEmpty() ||
 	        tleData.first.isEmpty() ||
 	        tleData.second.isEmpty())
-		return false;
+		return SatelliteP();
 	
 	QVariantList hintColor;
 	hintColor << defaultHintColor[0]
@@ -947,11 +1000,10 @@ bool Satellites::add(const TleData& tleData)
 	if (sat->initialized)
 	{
 		qDebug() << "Satellite added:" << tleData.id << tleData.name;
-		satellites.append(sat);
 		sat->setNew();
-		return true;
+		return sat;
 	}
-	return false;
+	return SatelliteP();
 }
 
 void Satellites::add(const TleDataList& newSatellites)
@@ -984,6 +1036,7 @@ void Satellites::remove(const QStringList& idList)
 	if (satelliteListModel)
 		satelliteListModel->beginSatellitesChange();
 	
+	waitForPropagation();
 	StelObjectMgr* objMgr = GETSTELMODULE(StelObjectMgr);
 	int numRemoved = 0;
 	for (int i = 0; i < satellites.size(); i++)
@@ -1097,6 +1150,39 @@ void Satellites::setFlagRelisticMode(bool b)
 	}
 }
 
+void Satellites::setFlagBackgroundPropagation(bool b)
+{
+	if (flagBackgroundPropagation != b)
+	{
+		waitForPropagation();
+		flagBackgroundPropagation = b;
+		// Snapshots left from a previous activation are outdated
+		previousSnapshot = -1;
+		latestSnapshot = -1;
+		emit settingsChanged();
+	}
+}
+
+void Satellites::predictPasses()
+{
+	QList<SatellitePassRequest> requests;
+	foreach(const SatelliteP& sat, satellites)
+	{
+		if (sat->initialized && sat->displayed)
+		{
+			SatellitePassRequest request;
+			request.id = sat->id;
+			request.tle1 = sat->tleElements.first;
+			request.tle2 = sat->tleElements.second;
+			requests.append(request);
+		}
+	}
+	// Same time scale as the propagation in update()
+	StelCore* core = StelApp::getInstance().getCore();
+	const double JD = core->getJDay();
+	passPredictor->predict(requests, core->getCurrentLocation(), JD - core->getDeltaT(JD)/86400, passPredictionDays);
+}
+
 void Satellites::setFlagHints(bool b)
 {
 	if (hintFader != b)
@@ -1200,13 +1286,20 @@ void Satellites::updateFromOnlineSources()
 		if (source.url.isValid())
 		{
 			updateSources.append(source);
-			downloadMgr->get(QNetworkRequest(source.url));
+			// The shared manager sends conditional requests and keeps the files in its cache
+			QNetworkRequest request(source.url);
+			request.setPriority(QNetworkRequest::LowPriority);
+			QNetworkReply* reply = downloadMgr->get(request);
+			connect(reply, SIGNAL(finished()), this, SLOT(saveDownloadedUpdate()));
 		}
 	}
 }
 
-void Satellites::saveDownloadedUpdate(QNetworkReply* reply)
+void Satellites::saveDownloadedUpdate()
 {
+	QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+	Q_ASSERT(reply);
+	reply->deleteLater();
 	// check the download worked, and save the data to file if this is the case.
 	if (reply->error() != QNetworkReply::NoError)
 	{
@@ -1265,25 +1358,18 @@ void Satellites::saveDownloadedUpdate(QNetworkReply* reply)
 		progressBar = 0;
 	}
 	
-	// All files have been downloaded, finish the update
-	TleDataHash newData;
+	// All files have been downloaded, finish the update in the background
+	QList<QPair<QString, bool> > files;
 	for (int i = 0; i < updateSources.count(); i++)
 	{
 		if (!updateSources[i].file)
 			continue;
-		if (updateSources[i].file->open(QFile::ReadOnly|QFile::Text))
-		{
-			parseTleFile(*updateSources[i].file,
-			             newData,
-			             updateSources[i].addNew);
-			updateSources[i].file->close();
-			delete updateSources[i].file;
-			updateSources[i].file = 0;
-		}
+		files.append(qMakePair(updateSources[i].file->fileName(), updateSources[i].addNew));
+		delete updateSources[i].file;
+		updateSources[i].file = 0;
 	}
-	updateSources.clear();	
-	parseQSMagFile(qsMagFilePath);
-	updateSatellites(newData);
+	updateSources.clear();
+	startTleUpdate(files, false);
 }
 
 void Satellites::updateObserverLocation(StelLocation)
@@ -1330,32 +1416,138 @@ void Satellites::saveCatalog(QString path)
 }
 
 void Satellites::updateFromFiles(QStringList paths, bool deleteFiles)
+{
+	QList<QPair<QString, bool> > files;
+	foreach(const QString& tleFilePath, paths)
+		files.append(qMakePair(tleFilePath, autoAddEnabled));
+	startTleUpdate(files, deleteFiles);
+}
+
+void Satellites::updateSatellites(TleDataHash& newTleSets)
+{
+	TleUpdate update;
+	mergeTleUpdate(snapshotTleSets(), newTleSets, qsMagList, update);
+	applyTleUpdate(update);
+}
+
+QList<TleSnapshot> Satellites::snapshotTleSets() const
+{
+	QList<TleSnapshot> loaded;
+	loaded.reserve(satellites.size());
+	foreach(const SatelliteP& sat, satellites)
+	{
+		TleSnapshot tle;
+		tle.id = sat->id;
+		tle.name = sat->name;
+		tle.first = sat->tleElements.first;
+		tle.second = sat->tleElements.second;
+		tle.userDefined = sat->userDefined;
+		loaded.append(tle);
+	}
+	return loaded;
+}
+
+void Satellites::mergeTleUpdate(const QList<TleSnapshot>& loaded,
+                                TleDataHash& newTleSets,
+                                const QHash<QString, double>& qsMags,
+                                TleUpdate& update)
+{
+	// Right, we should now have a map of all the elements we downloaded.  For each satellite
+	// which this module is managing, see if it exists with an updated element, and update it if so...
+	update.sourceCount = newTleSets.count(); // newTleSets is modified below
+	foreach(const TleSnapshot& sat, loaded)
+	{
+		// Satellites marked as "user-defined" are protected from updates and
+		// removal.
+		if (sat.userDefined)
+		{
+			qDebug() << "Satellite ignored (user-protected):"
+			         << sat.id << sat.name;
+			continue;
+		}
+
+		TleData newTle = newTleSets.take(sat.id);
+		if (!newTle.name.isEmpty())
+		{
+			if (sat.first != newTle.first ||
+			    sat.second != newTle.second ||
+			    sat.name != newTle.name)
+				update.changed.insert(sat.id, newTle);
+			if (qsMags.contains(sat.id))
+				update.stdMags.insert(sat.id, qsMags.value(sat.id));
+		}
+		else
+			update.missing.append(sat.id);
+	}
+
+	// Only those not in the loaded collection have remained
+	// (autoAddEnabled is not checked, because it's already in the flags)
+	QHash<QString, TleData>::const_iterator i;
+	for (i = newTleSets.constBegin(); i != newTleSets.constEnd(); ++i)
+	{
+		if (i.value().addThis)
+			update.added.append(i.value());
+	}
+}
+
+TleUpdate Satellites::parseTleUpdate(const QList<QPair<QString, bool> >& files,
+                                     bool deleteFiles,
+                                     const QString& qsMagFile,
+                                     const QList<TleSnapshot>& loaded)
 {
 	// Container for the new data.
 	TleDataHash newTleSets;
-	foreach(const QString& tleFilePath, paths)
+	for (int i = 0; i < files.size(); i++)
 	{
-		QFile tleFile(tleFilePath);
+		QFile tleFile(files.at(i).first);
 		if (tleFile.open(QIODevice::ReadOnly|QIODevice::Text))
 		{
-			parseTleFile(tleFile, newTleSets, autoAddEnabled);
+			parseTleFile(tleFile, newTleSets, files.at(i).second);
 			tleFile.close();
 
 			if (deleteFiles)
 				tleFile.remove();
 		}
 	}
-	parseQSMagFile(qsMagFilePath);
-	updateSatellites(newTleSets);
+
+	TleUpdate update;
+	update.qsMagList = readQSMagFile(qsMagFile);
+	mergeTleUpdate(loaded, newTleSets, update.qsMagList, update);
+	return update;
 }
 
-void Satellites::updateSatellites(TleDataHash& newTleSets)
+void Satellites::startTleUpdate(const QList<QPair<QString, bool> >& files, bool deleteFiles)
+{
+	if (updateWatcher.isRunning())
+	{
+		qWarning() << "Satellites: the previous update is not finished yet";
+		emit updateStateChanged(OtherError);
+		emit tleUpdateComplete(0, satellites.count(), 0, 0);
+		return;
+	}
+
+	updateState = Satellites::Updating;
+	emit(updateStateChanged(updateState));
+	// The satellites changed or removed until the end of the parsing are
+	// handled by applyTleUpdate(), which works on the IDs
+	updateWatcher.setFuture(QtConcurrent::run(Satellites::parseTleUpdate, files, deleteFiles, qsMagFilePath, snapshotTleSets()));
+}
+
+void Satellites::finishTleUpdate()
+{
+	const TleUpdate update = updateWatcher.result();
+	if (!update.qsMagList.isEmpty())
+		qsMagList = update.qsMagList;
+	applyTleUpdate(update);
+}
+
+void Satellites::applyTleUpdate(const TleUpdate& update)
 {
 	// Save the update time.
 	// One of the reasons it's here is that lastUpdate is used below.
 	markLastUpdate();
 	
-	if (newTleSets.isEmpty())
+	if (update.sourceCount == 0)
 	{
 		qWarning() << "Satellites: update files contain no TLE sets!";
 		updateState = OtherError;
@@ -1366,80 +1558,68 @@ void Satellites::updateSatellites(TleDataHash& newTleSets)
 	if (satelliteListModel)
 		satelliteListModel->beginSatellitesChange();
 	
-	// Right, we should now have a map of all the elements we downloaded.  For each satellite
-	// which this module is managing, see if it exists with an updated element, and update it if so...
-	int sourceCount = newTleSets.count(); // newTleSets is modified below
+	waitForPropagation();
+
+	// The new list is built aside and swapped with the current one at the end
+	const QSet<QString> missing = update.missing.toSet();
+	StelObjectMgr* objMgr = GETSTELMODULE(StelObjectMgr);
+	const QList<StelObjectP> selected = objMgr->getSelectedObject("Satellite");
+	QList<SatelliteP> newSatellites;
+	newSatellites.reserve(satellites.size() + update.added.size());
+	QSet<QString> loadedIds;
 	int updatedCount = 0;
-	int totalCount = 0;
+	const int totalCount = satellites.size();
 	int addedCount = 0;
-	int missingCount = 0; // Also the number of removed sats, if any.
-	QStringList toBeRemoved;
+	const int missingCount = update.missing.size(); // Also the number of removed sats, if any.
 	foreach(const SatelliteP& sat, satellites)
 	{
-		totalCount++;
-		
-		// Satellites marked as "user-defined" are protected from updates and
-		// removal.
-		if (sat->userDefined)
-		{
-			qDebug() << "Satellite ignored (user-protected):"
-			         << sat->id << sat->name;
-			continue;
-		}
-		
-		QString id = sat->id;
-		TleData newTle = newTleSets.take(id);
-		if (!newTle.name.isEmpty())
+		TleDataHash::const_iterator newTle = update.changed.constFind(sat->id);
+		if (newTle != update.changed.constEnd() && !sat->userDefined)
 		{
-			if (sat->tleElements.first != newTle.first ||
-			    sat->tleElements.second != newTle.second ||
-			    sat->name != newTle.name)
-			{
-				// We have updated TLE elements for this satellite
-				sat->setNewTleElements(newTle.first, newTle.second);
-				
-				// Update the name if it has been changed in the source list
-				sat->name = newTle.name;
+			// We have updated TLE elements for this satellite
+			sat->setNewTleElements(newTle.value().first, newTle.value().second);
 
-				// we reset this to "now" when we started the update.
-				sat->lastUpdated = lastUpdate;
-				updatedCount++;
-			}
-			if (qsMagList.contains(id))
-				sat->stdMag = qsMagList[id];
+			// Update the name if it has been changed in the source list
+			sat->name = newTle.value().name;
 
+			// we reset this to "now" when we started the update.
+			sat->lastUpdated = lastUpdate;
+			updatedCount++;
 		}
-		else
+		if (update.stdMags.contains(sat->id))
+			sat->stdMag = update.stdMags.value(sat->id);
+
+		if (missing.contains(sat->id) && !sat->userDefined)
 		{
 			if (autoRemoveEnabled)
-				toBeRemoved.append(sat->id);
-			else
-				qWarning() << "Satellites:" << sat->id << sat->name
-				           << "is missing in the update lists.";
-			missingCount++;
+			{
+				if (selected.contains(sat.staticCast<StelObject>()))
+					objMgr->unSelect();
+				qDebug() << "Satellite removed:" << sat->id << sat->name;
+				continue;
+			}
+			qWarning() << "Satellites:" << sat->id << sat->name
+			           << "is missing in the update lists.";
 		}
+		loadedIds.insert(sat->id);
+		newSatellites.append(sat);
 	}
 	
-	// Only those not in the loaded collection have remained
-	// (autoAddEnabled is not checked, because it's already in the flags)
-	QHash<QString, TleData>::const_iterator i;
-	for (i = newTleSets.begin(); i != newTleSets.end(); ++i)
+	foreach(const TleData& tleData, update.added)
 	{
-		if (i.value().addThis)
+		// It may have been added by the user during the parsing
+		if (loadedIds.contains(tleData.id))
+			continue;
+		SatelliteP sat = createSatellite(tleData);
+		if (!sat.isNull())
 		{
-			// Add the satellite...
-			if (add(i.value()))
-				addedCount++;
+			newSatellites.append(sat);
+			addedCount++;
 		}
 	}
 	if (addedCount)
-		qSort(satellites);
-	
-	if (autoRemoveEnabled && !toBeRemoved.isEmpty())
-	{
-		qWarning() << "Satellites: purging objects that were not updated...";
-		remove(toBeRemoved);
-	}
+		qSort(newSatellites);
+	satellites.swap(newSatellites);
 	
 	if (updatedCount > 0 ||
 	        (autoRemoveEnabled && missingCount > 0))
@@ -1457,7 +1637,7 @@ void Satellites::updateSatellites(TleDataHash& newTleSets)
 	         << updatedCount << "/" << totalCount << "updated,"
 	         << addedCount << "added,"
 	         << missingCount << "missing or removed."
-	         << sourceCount << "source entries parsed.";
+	         << update.sourceCount << "source entries parsed.";
 
 	emit(updateStateChanged(updateState));
 	emit(tleUpdateComplete(updatedCount, totalCount, addedCount, missingCount));
@@ -1533,26 +1713,34 @@ void Satellites::parseQSMagFile(QString qsMagFile)
 	// Description of file and some additional information you can find here:
 	// 1) http://www.prismnet.com/~mmccants/tles/mccdesc.html
 	// 2) http://www.prismnet.com/~mmccants/tles/intrmagdef.html
+	const QHash<QString, double> mags = readQSMagFile(qsMagFile);
+	if (!mags.isEmpty())
+		qsMagList = mags;
+}
+
+QHash<QString, double> Satellites::readQSMagFile(const QString& qsMagFile)
+{
+	QHash<QString, double> mags;
 	if (qsMagFile.isEmpty())
-		return;
+		return mags;
 
 	QFile qsmFile(qsMagFile);
 	if (!qsmFile.open(QIODevice::ReadOnly))
 	{
 		qWarning() << "Satellites: oops... cannot open " << QDir::toNativeSeparators(qsMagFile);
-		return;
+		return mags;
 	}
 
-	qsMagList.clear();
 	while (!qsmFile.atEnd())
 	{
 		QString line = QString(qsmFile.readLine());
 		QString id   = line.mid(0,5).trimmed();
 		QString smag = line.mid(33,4).trimmed();
 		if (!smag.isEmpty())
-			qsMagList.insert(id, smag.toDouble());
+			mags.insert(id, smag.toDouble());
 	}
 	qsmFile.close();
+	return mags;
 }
 
 void Satellites::update(double deltaTime)
@@ -1562,10 +1750,121 @@ void Satellites::update(double deltaTime)
 
 	hintFader.update((int)(deltaTime*1000));
 
+	// All the satellites are propagated for the same epoch, in one batch spread over the thread pool.
+	StelCore* core = StelApp::getInstance().getCore();
+	const double JD = core->getJDay();
+	const double epoch = JD - core->getDeltaT(JD)/86400; // Delta T anti-correction for artificial satellites
+	QVector<Satellite*> batch;
+	batch.reserve(satellites.size());
 	foreach(const SatelliteP& sat, satellites)
 	{
 		if (sat->initialized && sat->displayed)
-			sat->update(deltaTime);
+			batch.append(sat.data());
+	}
+	if (!flagBackgroundPropagation || !updateFromSnapshots(batch, epoch))
+		propagateBatch(batch, epoch);
+
+	// When the ground hides what is below the horizon, the satellites which are
+	// not above it are culled from their sub point, unless they are selected.
+	const StelLocation& loc = core->getCurrentLocation();
+	Satellite::setObserverLocation(loc.latitude, loc.longitude);
+	const bool cullBelowHorizon = GETSTELMODULE(LandscapeMgr)->getFlagLandscape();
+	QList<const StelObject*> selected;
+	if (cullBelowHorizon)
+	{
+		foreach(const StelObjectP& obj, GETSTELMODULE(StelObjectMgr)->getSelectedObject("Satellite"))
+			selected.append(obj.data());
+	}
+	foreach(Satellite* sat, batch)
+		sat->updatePosition(cullBelowHorizon && !selected.contains(sat));
+}
+
+//! Functor running the SGP4 propagation of one satellite.
+struct SatellitePropagator
+{
+	typedef void result_type;
+	SatellitePropagator(double epoch) : epoch(epoch) {}
+	void operator()(Satellite* sat) const {sat->propagate(epoch);}
+	double epoch;
+};
+
+void Satellites::propagateBatch(QVector<Satellite*>& batch, double epoch)
+{
+	// Below this number of satellites the thread pool overhead is not worth it
+	static const int minConcurrentSatellites = 64;
+	const SatellitePropagator propagator(epoch);
+	StelApp::getInstance().getJobSystem()->blockingMap(batch, propagator, minConcurrentSatellites/2);
+	StelApp::getInstance().getRenderStats()->add(statsPropagated, batch.size());
+}
+
+//! Job run in a worker thread computing one snapshot of all the given satellites.
+static void propagateSnapshots(QVector<Satellite*> batch, int slot, double epoch)
+{
+	foreach(Satellite* sat, batch)
+		sat->propagateSnapshot(slot, epoch);
+}
+
+bool Satellites::updateFromSnapshots(const QVector<Satellite*>& batch, double epoch)
+{
+	// Position of the epoch between the two last snapshots: 0 at the previous one, 1 at the latest one.
+	// Snapshots are propagated ahead of time, so the epoch is normally between them.
+	// When time is stopped both snapshots are at the same epoch.
+	bool covered = false;
+	double t = 0.;
+	if (previousSnapshot>=0 && latestSnapshot>=0)
+	{
+		const double e0 = snapshotEpochs[previousSnapshot];
+		const double e1 = snapshotEpochs[latestSnapshot];
+		if (e1==e0)
+			covered = qAbs(epoch-e1)<=1./86400.;
+		else
+		{
+			t = (epoch-e0)/(e1-e0);
+			covered = t>=0. && t<=1.5;
+		}
+	}
+
+	// The latest snapshot is replaced once the epoch reaches it, so that the
+	// pending one can be reused by the next job.
+	if (pendingSnapshot>=0 && propagationJob.isFinished() && (!covered || t>=1.))
+	{
+		previousSnapshot = latestSnapshot;
+		latestSnapshot = pendingSnapshot;
+		pendingSnapshot = -1;
+		return updateFromSnapshots(batch, epoch);
+	}
+
+	if (pendingSnapshot<0)
+	{
+		const double timeRate = StelApp::getInstance().getCore()->getTimeRate();
+		if (timeRate!=0. || !covered)
+		{
+			// Use the slot which is not read
+			for (pendingSnapshot=0; pendingSnapshot==previousSnapshot || pendingSnapshot==latestSnapshot; ++pendingSnapshot) {}
+			// Aim two periods ahead: one while the job runs, one while it is read
+			snapshotEpochs[pendingSnapshot] = epoch + 2.*timeRate/backgroundPropagationRate;
+			propagationJob = QtConcurrent::run(propagateSnapshots, batch, pendingSnapshot, snapshotEpochs[pendingSnapshot]);
+		}
+	}
+
+	if (!covered)
+		return false;
+
+	foreach(Satellite* sat, batch)
+	{
+		// Satellites added after the last snapshots are propagated directly
+		if (!sat->interpolateSnapshots(previousSnapshot, latestSnapshot, epoch))
+			sat->propagate(epoch);
+	}
+	return true;
+}
+
+void Satellites::waitForPropagation()
+{
+	if (pendingSnapshot>=0)
+	{
+		propagationJob.waitForFinished();
+		// The results are still valid, they will be used by the next update()
 	}
 }
 
@@ -1584,11 +1883,24 @@ void Satellites::draw(StelCore* core)
 	glEnable(GL_TEXTURE_2D);
 	Satellite::hintTexture->bind();
 	Satellite::viewportHalfspace = painter.getProjector()->getBoundingCap();
+
+	// The hints and orbits are recorded and drawn in a few draw calls, the labels over them,
+	// and in realistic mode the satellites are collected to be drawn as one batch of point sources
+	pointSources.clear();
+	painter.beginBatch();
 	foreach (const SatelliteP& sat, satellites)
 	{
 		if (sat && sat->initialized && sat->displayed)
-			sat->draw(core, painter, 1.0);
+			sat->draw(core, painter, pointSources);
+	}
+	if (!pointSources.vertices.isEmpty() || !pointSources.bigHaloPositions.isEmpty())
+	{
+		StelSkyDrawer* sd = core->getSkyDrawer();
+		sd->preDrawPointSource(&painter);
+		sd->drawPointSourceBatch(&painter, pointSources);
+		sd->postDrawPointSource(&painter);
 	}
+	painter.endBatch();
 
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer())
 		drawPointer(core, painter);
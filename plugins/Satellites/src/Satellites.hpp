@@ -21,6 +21,7 @@
 
 #include "StelObjectModule.hpp"
 #include "Satellite.hpp"
+#include "SatellitePasses.hpp"
 #include "StelFader.hpp"
 #include "StelGui.hpp"
 #include "StelDialog.hpp"
@@ -28,6 +29,8 @@
 
 #include <QDateTime>
 #include <QFile>
+#include <QFuture>
+#include <QFutureWatcher>
 #include <QDir>
 #include <QUrl>
 #include <QVariantMap>
@@ -74,6 +77,36 @@ struct TleSource
 
 typedef QList<TleSource> TleSourceList;
 
+//! Copy of the TLE set of a loaded satellite, used to merge an update in a
+//! worker thread without touching the Satellite objects.
+struct TleSnapshot
+{
+	QString id;
+	QString name;
+	QByteArray first;
+	QByteArray second;
+	bool userDefined;
+};
+
+//! Result of the merge of TLE update lists with the loaded satellites,
+//! computed in a worker thread and applied at once in the main thread.
+struct TleUpdate
+{
+	TleUpdate() : sourceCount(0) {}
+	//! New TLE sets of the loaded satellites which changed, by satellite ID.
+	TleDataHash changed;
+	//! Standard magnitudes of the loaded satellites found in the lists.
+	QHash<QString, double> stdMags;
+	//! New satellites which should be added.
+	TleDataList added;
+	//! IDs of the loaded satellites missing in the lists.
+	QStringList missing;
+	//! Content of the qs.mag file, empty if it could not be read.
+	QHash<QString, double> qsMagList;
+	//! Number of TLE sets parsed from the lists.
+	int sourceCount;
+};
+
 /*! @mainpage notitle
 @section overview Plugin Overview
 
@@ -169,9 +202,13 @@ public:
 	virtual void init();
 	virtual void deinit();
 	virtual void update(double deltaTime);
+	//! The satellites are propagated for the current time, and their visibility depends on the observer and the sun.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true, UpdateTime|UpdateObserver|UpdatePlanets);}
 	virtual void draw(StelCore* core);
 	virtual void drawPointer(StelCore* core, StelPainter& painter);
 	virtual double getCallOrder(StelModuleActionName actionName) const;
+	//! Estimate the memory used by the satellites of the catalog, with their propagators and orbits.
+	virtual qint64 getMemoryUsed() const;
 
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in StelObjectManager class
@@ -300,8 +337,9 @@ public:
 	
 	//! Reads update file(s) in celestrak's .txt format, and updates
 	//! the TLE elements for exisiting satellites from them.
-	//! Indirectly emits signals updateStateChanged() and tleUpdateComplete(),
-	//! as it calls updateSatellites().
+	//! The files are parsed and merged in a worker thread, the satellites
+	//! are updated when it is done, which emits signals updateStateChanged()
+	//! and tleUpdateComplete().
 	//! See updateFromOnlineSources() for the other kind of update operation.
 	//! @param paths a list of paths to update files
 	//! @param deleteFiles if set, the update files are deleted after
@@ -309,9 +347,10 @@ public:
 	void updateFromFiles(QStringList paths, bool deleteFiles=false);
 	
 	//! Updates the loaded satellite collection from the provided data.
-	//! Worker function called by updateFromFiles() and saveDownloadedUpdate().
-	//! (Respecitvely, user-initiated update from file(s) and user- or auto-
-	//! initiated update from online source(s).)
+	//! Synchronous version of the merge done in the background by
+	//! updateFromFiles() and saveDownloadedUpdate(). (Respecitvely,
+	//! user-initiated update from file(s) and user- or auto-initiated update
+	//! from online source(s).)
 	//! Emits updateStateChanged() and tleUpdateComplete().
 	//! @note Instead of splitting this method off updateFromFiles() and passing
 	//! the auto-add flag through data structures, another possiblity was to
@@ -339,6 +378,9 @@ public:
 	//! @note We are having permissions for use this file from Mike McCants.
 	//! @param name of file
 	void parseQSMagFile(QString qsMagFile);
+	//! Read the standard magnitudes of a qs.mag file, by satellite ID.
+	//! @return an empty hash if the file cannot be read.
+	static QHash<QString, double> readQSMagFile(const QString& qsMagFile);
 	
 	bool getFlagHints() {return hintFader;}
 	//! get the label font size.
@@ -346,11 +388,20 @@ public:
 	int getLabelFontSize() {return labelFont.pixelSize();}
 	bool getFlagLabels();
 	bool getFlagRealisticMode();
+	//! Get whether the satellites are propagated in a worker thread.
+	bool getFlagBackgroundPropagation() const {return flagBackgroundPropagation;}
 	//! Get the current status of the orbit line rendering flag.
 	bool getOrbitLinesFlag();
 	bool isAutoAddEnabled() const { return autoAddEnabled; }
 	bool isAutoRemoveEnabled() const { return autoRemoveEnabled; }	
 
+	//! Get the passes of a satellite found by the last predictPasses(),
+	//! in chronological order. Empty while the prediction is running.
+	QList<SatellitePass> getPasses(const QString& id) const {return passPredictor->getPasses(id);}
+	//! Get the passes of all the satellites found by the last predictPasses(),
+	//! in chronological order.
+	QList<SatellitePass> getAllPasses() const {return passPredictor->getAllPasses();}
+
 signals:
 	//! Emitted when some of the plugin settings have been changed.
 	//! Used to communicate with the configuration window.
@@ -371,6 +422,9 @@ signals:
 	//! update source(s) (and were removed, if autoRemoveEnabled is set).
 	void tleUpdateComplete(int updated, int total, int added, int missing);
 
+	//! Emitted when the passes predicted by predictPasses() are available.
+	void passesPredicted();
+
 public slots:
 	// FIXME: Put back the getter functions - for scripts? --BM
 	
@@ -397,6 +451,17 @@ public slots:
 
 	//! Emits settingsChanged() if the value changes.
 	void setFlagRelisticMode(bool b);
+
+	//! Enable the propagation of the satellites in a worker thread, the positions
+	//! drawn being interpolated from the snapshots it computes.
+	void setFlagBackgroundPropagation(bool b);
+
+	//! Predict in the background the passes of the displayed satellites above
+	//! the current location, for the number of days of the pass_prediction_days
+	//! setting from the current date. Emits passesPredicted() when it is done.
+	//! The passes of the satellites whose elements did not change since a
+	//! previous prediction at the same location are not computed again.
+	void predictPasses();
 	
 	//! set the label font size.
 	//! @param size the pixel size of the font
@@ -448,6 +513,46 @@ private:
 	//! accepting TleData... --BM
 	//! @returns true if the addition was successful.
 	bool add(const TleData& tleData);
+	//! Create the satellite described by the data.
+	//! @returns a null pointer if the data is not valid.
+	SatelliteP createSatellite(const TleData& tleData);
+
+	//! Copy the TLE sets of the loaded satellites for mergeTleUpdate().
+	QList<TleSnapshot> snapshotTleSets() const;
+	//! Compare the TLE sets read from update lists with the loaded ones.
+	//! Thread safe, it only uses its arguments.
+	//! @param[in,out] newTleSets the TLE sets read, the ones of the loaded
+	//! satellites are taken out of the hash.
+	static void mergeTleUpdate(const QList<TleSnapshot>& loaded,
+	                           TleDataHash& newTleSets,
+	                           const QHash<QString, double>& qsMags,
+	                           TleUpdate& update);
+	//! Read and merge update lists, run in a worker thread by startTleUpdate().
+	//! @param files the paths of the lists, with the flag telling whether
+	//! their new satellites should be added.
+	static TleUpdate parseTleUpdate(const QList<QPair<QString, bool> >& files,
+	                                bool deleteFiles,
+	                                const QString& qsMagFile,
+	                                const QList<TleSnapshot>& loaded);
+	//! Start the parsing and merge of update lists in a worker thread.
+	//! finishTleUpdate() applies the result.
+	void startTleUpdate(const QList<QPair<QString, bool> >& files, bool deleteFiles);
+	//! Apply a merged update to the satellites, which are swapped at once
+	//! with their updated list.
+	//! Emits updateStateChanged() and tleUpdateComplete().
+	void applyTleUpdate(const TleUpdate& update);
+
+	//! Run the SGP4 propagation of all the given satellites to the same epoch,
+	//! distributing large batches over the global thread pool.
+	void propagateBatch(QVector<Satellite*>& batch, double epoch);
+	//! Set the positions of the given satellites from the snapshots computed in
+	//! the background, and start the computation of the next snapshot if needed.
+	//! @return false if the snapshots do not cover the epoch (for example after
+	//! a jump in time), in which case propagateBatch() has to be used.
+	bool updateFromSnapshots(const QVector<Satellite*>& batch, double epoch);
+	//! Wait for the end of the background propagation, which has to be done
+	//! before satellites are removed or their elements changed.
+	void waitForPropagation();
 	
 	//! Delete Satellites section in main config.ini, then create with default values.
 	void restoreDefaultSettings();
@@ -472,8 +577,12 @@ private:
 
 	//! Save a structure representing a satellite catalog to a JSON file.
 	//! If no path is specified, catalogPath is used.
-	//! @see createDataMap()
-	bool saveDataMap(const QVariantMap& map, QString path=QString());
+	//! The file and its binary version are written in a worker thread.
+	//! @see createDataMap(), waitForCatalogSave()
+	void saveDataMap(const QVariantMap& map, QString path=QString());
+	//! Wait for the end of the saving of the catalog, which has to be done
+	//! before the catalog file is read or replaced.
+	void waitForCatalogSave();
 	//! Load a structure representing a satellite catalog from a JSON file.
 	//! If no path is specified, catalogPath is used.
 	QVariantMap loadDataMap(QString path=QString());
@@ -561,6 +670,10 @@ private:
 	bool autoRemoveEnabled;
 	QDateTime lastUpdate;
 	int updateFrequencyHours;
+	//! Parsing and merge of the update lists in a worker thread.
+	QFutureWatcher<TleUpdate> updateWatcher;
+	//! Saving of the catalog in a worker thread.
+	QFuture<void> saveJob;
 	//@}
 	
 	//! @name Screen message infrastructure
@@ -569,6 +682,34 @@ private:
 	QList<int> messageIDs;
 	//@}
 
+	//! @name Background propagation
+	//@{
+	//! Flag enabling the propagation of the satellites in a worker thread.
+	bool flagBackgroundPropagation;
+	//! Number of snapshots to propagate per second of real time.
+	double backgroundPropagationRate;
+	QFuture<void> propagationJob;
+	//! Snapshot slot written by propagationJob, -1 if no job is running.
+	int pendingSnapshot;
+	//! The two last snapshot slots computed, -1 if not available.
+	int previousSnapshot;
+	int latestSnapshot;
+	double snapshotEpochs[Satellite::NbSnapshots];
+	//@}
+
+	//! The satellites drawn in realistic mode, reused from one frame to the next.
+	StelSkyDrawer::PointSourceBatch pointSources;
+
+	//! @name Pass prediction
+	//@{
+	SatellitePassPredictor* passPredictor;
+	//! Number of days predicted by predictPasses().
+	double passPredictionDays;
+	//@}
+
+	//! The render statistics counter of the satellites propagated by propagateBatch().
+	int statsPropagated;
+
 	// GUI
 	SatellitesDialog* configDialog;	
 
@@ -585,7 +726,9 @@ private slots:
 	//! temporary files and then read them. If we give up on the idea to
 	//! re-use them later when adding manually satellites, parseTleFile()
 	//! can be modified to read directly form QNetworkReply-s. --BM
-	void saveDownloadedUpdate(QNetworkReply* reply);
+	void saveDownloadedUpdate();
+	//! Apply the result of the update started by startTleUpdate().
+	void finishTleUpdate();
 	void updateObserverLocation(StelLocation loc);
 
 };
@@ -136,14 +136,25 @@ void gSatWrapper::setEpoch(double ai_julianDaysEpoch)
 		pSatellite->setEpoch(ai_julianDaysEpoch);
 }
 
+void gSatWrapper::setEpochState(double ai_julianDaysEpoch, const Vec3d& ai_position, const Vec3d& ai_velocity)
+{
+	epoch = ai_julianDaysEpoch;
+	if (pSatellite)
+		pSatellite->setState(epoch, ai_position.v, ai_velocity.v);
+}
+
 
 void gSatWrapper::calcObserverECIPosition(Vec3d& ao_position, Vec3d& ao_velocity)
 {
-
 	StelLocation loc   = StelApp::getInstance().getCore()->getCurrentLocation();
+	computeObserverECIPosition(epoch, loc.latitude, loc.longitude, loc.altitude, ao_position, ao_velocity);
+}
 
-	double radLatitude = loc.latitude * KDEG2RAD;
-        double theta       = epoch.toThetaLMST(loc.longitude * KDEG2RAD);
+void gSatWrapper::computeObserverECIPosition(const gTime& ai_epoch, double ai_latitude, double ai_longitude, double ai_altitude,
+                                             Vec3d& ao_position, Vec3d& ao_velocity)
+{
+	double radLatitude = ai_latitude * KDEG2RAD;
+	double theta       = ai_epoch.toThetaLMST(ai_longitude * KDEG2RAD);
 	double r;
 	double c,sq;
 
@@ -153,32 +164,35 @@ void gSatWrapper::calcObserverECIPosition(Vec3d& ao_position, Vec3d& ao_velocity
 	c = 1/sqrt(1 + __f*(__f - 2)*Sqr(sin(radLatitude)));
 	sq = Sqr(1 - __f)*c;
 
-	r = (KEARTHRADIUS*c + (loc.altitude/1000))*cos(radLatitude);
+	r = (KEARTHRADIUS*c + (ai_altitude/1000))*cos(radLatitude);
 	ao_position[0] = r * cos(theta);/*kilometers*/
 	ao_position[1] = r * sin(theta);
-	ao_position[2] = (KEARTHRADIUS*sq + (loc.altitude/1000))*sin(radLatitude);
-        ao_velocity[0] = -KMFACTOR*ao_position[1];/*kilometers/second*/
-        ao_velocity[1] =  KMFACTOR*ao_position[0];
-        ao_velocity[2] =  0;
+	ao_position[2] = (KEARTHRADIUS*sq + (ai_altitude/1000))*sin(radLatitude);
+	ao_velocity[0] = -KMFACTOR*ao_position[1];/*kilometers/second*/
+	ao_velocity[1] =  KMFACTOR*ao_position[0];
+	ao_velocity[2] =  0;
 }
 
 
 
 Vec3d gSatWrapper::getAltAz()
 {
-
 	StelLocation loc   = StelApp::getInstance().getCore()->getCurrentLocation();
+	return computeAltAz(epoch, getTEMEPos(), loc.latitude, loc.longitude, loc.altitude);
+}
+
+Vec3d gSatWrapper::computeAltAz(const gTime& ai_epoch, const Vec3d& ai_ECIPos, double ai_latitude, double ai_longitude, double ai_altitude)
+{
 	Vec3d topoSatPos;
 	Vec3d observerECIPos;
 	Vec3d observerECIVel;
 
-	double  radLatitude    = loc.latitude * KDEG2RAD;
-        double  theta          = epoch.toThetaLMST(loc.longitude * KDEG2RAD);
+	double  radLatitude    = ai_latitude * KDEG2RAD;
+	double  theta          = ai_epoch.toThetaLMST(ai_longitude * KDEG2RAD);
 
-	calcObserverECIPosition(observerECIPos, observerECIVel);
+	computeObserverECIPosition(ai_epoch, ai_latitude, ai_longitude, ai_altitude, observerECIPos, observerECIVel);
 
-	Vec3d satECIPos  = getTEMEPos();
-	Vec3d slantRange = satECIPos - observerECIPos;
+	Vec3d slantRange = ai_ECIPos - observerECIPos;
 
 	//top_s
 	topoSatPos[0] = (sin(radLatitude) * cos(theta)*slantRange[0]
@@ -287,6 +301,26 @@ double gSatWrapper::getPhaseAngle()
 	return sunECIPos.angle(getTEMEPos());
 }
 
+Vec3d gSatWrapper::computeSunECIPos(const gTime& ai_epoch)
+{
+	// Reference: Astronomical Almanac, section C "Low precision formulas for the Sun"
+	const double n       = ai_epoch.getGmtTm() - 2451545.0;
+	const double L       = (280.460 + 0.9856474*n) * KDEG2RAD;
+	const double g       = (357.528 + 0.9856003*n) * KDEG2RAD;
+	const double lambda  = L + (1.915*sin(g) + 0.020*sin(2*g)) * KDEG2RAD;
+	const double epsilon = (23.439 - 0.0000004*n) * KDEG2RAD;
+	const double R       = (1.00014 - 0.01671*cos(g) - 0.00014*cos(2*g)) * AU;
+
+	return Vec3d(R*cos(lambda), R*cos(epsilon)*sin(lambda), R*sin(epsilon)*sin(lambda));
+}
+
+bool gSatWrapper::isSunlit(const Vec3d& ai_satECIPos, const Vec3d& ai_sunECIPos)
+{
+	// On the day side, or far enough from the axis of the cylindrical shadow
+	const double sunSatAngle = ai_sunECIPos.angle(ai_satECIPos);
+	return sunSatAngle < M_PI/2 || ai_satECIPos.length()*sin(sunSatAngle) > KEARTHRADIUS;
+}
+
 
 
 
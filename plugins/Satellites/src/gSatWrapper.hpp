@@ -57,6 +57,13 @@ public:
 
 	void setEpoch(double ai_julianDaysEpoch);
 
+	//! Set the epoch and the TEME state of the satellite without running the
+	//! propagator, for example from an interpolation between two propagated states.
+	//! @param ai_julianDaysEpoch the epoch of the state in Julian Days.
+	//! @param ai_position the TEME position measured in Km.
+	//! @param ai_velocity the TEME velocity measured in Km/s.
+	void setEpochState(double ai_julianDaysEpoch, const Vec3d& ai_position, const Vec3d& ai_velocity);
+
 	// Operation getTEMEPos
 	//! @brief This operation isolate gSatTEME getPos operation.
 	//! @return Vec3d with TEME position. Units measured in Km.
@@ -117,6 +124,30 @@ public:
 
 	double getPhaseAngle();
 
+	//! @name Thread safe computations
+	//! These functions only use their arguments, so they can be used by the
+	//! predictions made in worker threads.
+	//@{
+	//! Compute the ECI position and velocity of an observer.
+	//! @param ai_epoch the time of the position.
+	//! @param ai_latitude, ai_longitude geographic coordinates in degrees.
+	//! @param ai_altitude altitude in meters.
+	//! @param[out] ao_position Observer ECI position vector measured in Km
+	//! @param[out] ao_velocity Observer ECI velocity vector measured in Km/s
+	static void computeObserverECIPosition(const gTime& ai_epoch, double ai_latitude, double ai_longitude, double ai_altitude,
+	                                       Vec3d& ao_position, Vec3d& ao_velocity);
+	//! Compute the topocentric coordinates (south, east, zenith) of an ECI position.
+	//! @param ai_ECIPos the ECI position measured in Km.
+	//! @return Vect3d Vector with coordinates (meassured in km)
+	static Vec3d computeAltAz(const gTime& ai_epoch, const Vec3d& ai_ECIPos, double ai_latitude, double ai_longitude, double ai_altitude);
+	//! Compute a low precision (0.01 deg) ECI position of the Sun, from the
+	//! formula of the Astronomical Almanac.
+	//! @return Vec3d with ECI position measured in Km.
+	static Vec3d computeSunECIPos(const gTime& ai_epoch);
+	//! Check whether a satellite is out of the shadow of the Earth.
+	static bool isSunlit(const Vec3d& ai_satECIPos, const Vec3d& ai_sunECIPos);
+	//@}
+
 
 private:
         // Operation calcObserverECIPosition
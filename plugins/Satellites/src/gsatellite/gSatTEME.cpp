@@ -125,6 +125,17 @@ void gSatTEME::setMinSinceKepEpoch(double ai_minSinceKepEpoch)
 	m_SubPoint    = computeSubPoint( Epoch);
 }
 
+void gSatTEME::setState(gTime ai_time, const double ai_position[3], const double ai_vel[3])
+{
+	m_Position[ 0]= ai_position[ 0];
+	m_Position[ 1]= ai_position[ 1];
+	m_Position[ 2]= ai_position[ 2];
+	m_Vel[ 0]     = ai_vel[ 0];
+	m_Vel[ 1]     = ai_vel[ 1];
+	m_Vel[ 2]     = ai_vel[ 2];
+	m_SubPoint    = computeSubPoint( ai_time);
+}
+
 gVector gSatTEME::computeSubPoint(gTime ai_Time)
 {
 
@@ -83,6 +83,14 @@ public:
 	//! and fraction of minutes.
 	void setMinSinceKepEpoch(double ai_minSinceKepEpoch);
 
+	// Operation: setState( gTime ai_time, const double ai_position[3], const double ai_vel[3])
+	//! @brief Set the state vector for the given epoch without running the propagator,
+	//! for example from an interpolation between two propagated states.
+	//! @param[in] 	ai_time gTime object storing the epoch of the state.
+	//! @param[in] 	ai_position TEME position measured in Km.
+	//! @param[in] 	ai_vel TEME velocity measured in Km/s.
+	void setState(gTime ai_time, const double ai_position[3], const double ai_vel[3]);
+
 	// Operation: getPos()
 	//! @brief Get the TEME satellite position Vector
 	//! @return gVector
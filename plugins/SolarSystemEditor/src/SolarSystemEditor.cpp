@@ -37,7 +37,10 @@
 #include <QDir>
 #include <QFile>
 #include <QSettings>
+#include <QSet>
 #include <QString>
+#include <QThreadPool>
+#include <QtConcurrent>
 
 #include <cmath>
 #include <stdexcept>
@@ -74,6 +77,7 @@ SolarSystemEditor::SolarSystemEditor()
 	//I really hope that the file manager is instantiated before this
 	defaultSolarSystemFilePath	= QFileInfo(StelFileMgr::getInstallationDir() + "/data/ssystem.ini").absoluteFilePath();
 	customSolarSystemFilePath	= QFileInfo(StelFileMgr::getUserDir() + "/data/ssystem.ini").absoluteFilePath();
+	customMinorBodiesFilePath	= QFileInfo(StelFileMgr::getUserDir() + "/data/minor_bodies.dat").absoluteFilePath();
 }
 
 SolarSystemEditor::~SolarSystemEditor()
@@ -234,6 +238,12 @@ bool SolarSystemEditor::resetSolarSystemConfigurationFile()
 			return false;
 		}
 	}
+	if (QFile::exists(customMinorBodiesFilePath) && !QFile::remove(customMinorBodiesFilePath))
+	{
+		qWarning() << "Unable to delete" << QDir::toNativeSeparators(customMinorBodiesFilePath)
+		         << endl << "Please remove the file manually.";
+		return false;
+	}
 
 	return cloneSolarSystemConfigurationFile();
 }
@@ -342,17 +352,65 @@ QHash<QString,QString> SolarSystemEditor::listAllLoadedObjectsInFile(QString fil
 	return loadedObjects;
 }
 
+QHash<QString,QString> SolarSystemEditor::listAllLoadedObjectsInDatabase()
+{
+	MinorBodyStore store;
+	if (!QFile::exists(customMinorBodiesFilePath) || !store.open(customMinorBodiesFilePath))
+		return QHash<QString,QString>();
+
+	QSet<QString> planetNames = solarSystemManager->getAllPlanetEnglishNames().toSet();
+	QHash<QString,QString> loadedObjects;
+	for (int i=0; i<store.size(); ++i)
+	{
+		QString name = store.getName(i);
+		if (planetNames.contains(name))
+		{
+			const int minorPlanetNumber = store.getRecord(i).minorPlanetNumber;
+			loadedObjects.insert(name, convertToGroupName(name, minorPlanetNumber));
+		}
+	}
+	return loadedObjects;
+}
+
 QHash<QString,QString> SolarSystemEditor::listAllLoadedSsoIdentifiers()
 {
+	QHash<QString,QString> loadedObjects = listAllLoadedObjectsInDatabase();
 	if (QFile::exists(customSolarSystemFilePath))
 	{
-		return listAllLoadedObjectsInFile(customSolarSystemFilePath);
+		//The objects of ssystem.ini take precedence when loading the Solar System
+		QHash<QString,QString> fileObjects = listAllLoadedObjectsInFile(customSolarSystemFilePath);
+		for (QHash<QString,QString>::const_iterator it = fileObjects.constBegin(); it != fileObjects.constEnd(); ++it)
+			loadedObjects.insert(it.key(), it.value());
 	}
 	else
 	{
 		//TODO: Error message
-		return QHash<QString,QString>();
 	}
+	return loadedObjects;
+}
+
+bool SolarSystemEditor::replaceInMinorBodiesDatabase(const QSet<QString>& names, const QVector<MinorBodyStore::Record>& records)
+{
+	QVector<MinorBodyStore::Record> allRecords;
+	if (QFile::exists(customMinorBodiesFilePath))
+	{
+		if (!MinorBodyStore::readAll(customMinorBodiesFilePath, allRecords))
+			qWarning() << "The invalid minor bodies database" << QDir::toNativeSeparators(customMinorBodiesFilePath) << "will be overwritten.";
+	}
+	else if (records.isEmpty())
+	{
+		return true;
+	}
+
+	QVector<MinorBodyStore::Record> newRecords;
+	newRecords.reserve(allRecords.size() + records.size());
+	foreach (const MinorBodyStore::Record& record, allRecords)
+	{
+		if (!names.contains(record.name))
+			newRecords.append(record);
+	}
+	newRecords += records;
+	return MinorBodyStore::write(customMinorBodiesFilePath, newRecords);
 }
 
 bool SolarSystemEditor::removeSsoWithName(QString name)
@@ -367,6 +425,15 @@ bool SolarSystemEditor::removeSsoWithName(QString name)
 		return false;
 	}
 
+	//The object may be in the minor bodies database
+	if (listAllLoadedObjectsInDatabase().contains(name))
+	{
+		QSet<QString> names;
+		names.insert(name);
+		if (!replaceInMinorBodiesDatabase(names, QVector<MinorBodyStore::Record>()))
+			return false;
+	}
+
 	//Make sure that the file exists
 	if (!QFile::exists(customSolarSystemFilePath))
 	{
@@ -1152,6 +1219,109 @@ QList<SsoElements> SolarSystemEditor::readXEphemOneLineElementsFromFile(QString
 	return objectList;
 }
 
+//! Parse a chunk of lines of orbital elements into records of the minor bodies database.
+struct ParseElementsChunk
+{
+	typedef QVector<MinorBodyStore::Record> result_type;
+	ParseElementsChunk(SolarSystemEditor* editor, SolarSystemEditor::ElementsFormat format)
+		: editor(editor), format(format) {}
+	result_type operator()(const QList<QByteArray>& lines) const
+	{
+		result_type records;
+		records.reserve(lines.size());
+		foreach (const QByteArray& line, lines)
+		{
+			QString oneLineElements = QString(line);
+			while (oneLineElements.endsWith('\n') || oneLineElements.endsWith('\r'))
+				oneLineElements.chop(1);
+			if (oneLineElements.isEmpty())
+				continue;
+
+			SsoElements object;
+			switch (format)
+			{
+				case SolarSystemEditor::MpcCometElements:
+					object = editor->readMpcOneLineCometElements(oneLineElements);
+					break;
+				case SolarSystemEditor::XEphemElements:
+					object = editor->readXEphemOneLineElements(oneLineElements);
+					break;
+				case SolarSystemEditor::MpcMinorPlanetElements:
+				default:
+					object = editor->readMpcOneLineMinorPlanetElements(oneLineElements);
+			}
+			MinorBodyStore::Record record;
+			if (!object.isEmpty() && MinorBodyStore::recordFromElements(object, record))
+				records.append(record);
+		}
+		return records;
+	}
+	SolarSystemEditor* editor;
+	SolarSystemEditor::ElementsFormat format;
+};
+
+int SolarSystemEditor::importElementsFileToDatabase(QString filePath, ElementsFormat format)
+{
+	QFile elementsFile(filePath);
+	if (!elementsFile.open(QFile::ReadOnly))
+	{
+		qDebug() << "Unable to open for reading" << QDir::toNativeSeparators(filePath);
+		qDebug() << "File error:" << elementsFile.errorString();
+		return -1;
+	}
+
+	//The file is read by chunks, each split in as many parts as there are threads,
+	//so that only the records and not the text of the whole file are kept in memory
+	static const int LinesPerTask = 2000;
+	const int nbTasks = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+	const qint64 fileSize = elementsFile.size();
+	ParseElementsChunk parse(this, format);
+
+	QVector<MinorBodyStore::Record> records;
+	QHash<QString,int> recordIndices;
+	int lineCount = 0;
+	while (!elementsFile.atEnd())
+	{
+		QList<QList<QByteArray> > tasks;
+		for (int t=0; t<nbTasks && !elementsFile.atEnd(); ++t)
+		{
+			QList<QByteArray> lines;
+			lines.reserve(LinesPerTask);
+			while (lines.size()<LinesPerTask && !elementsFile.atEnd())
+				lines.append(elementsFile.readLine(1024));
+			lineCount += lines.size();
+			tasks.append(lines);
+		}
+
+		const QList<QVector<MinorBodyStore::Record> > results = QtConcurrent::blockingMapped(tasks, parse);
+		//Keep the last occurrence of each object, as the file order is preserved
+		foreach (const QVector<MinorBodyStore::Record>& chunk, results)
+		{
+			foreach (const MinorBodyStore::Record& record, chunk)
+			{
+				QHash<QString,int>::const_iterator it = recordIndices.constFind(record.name);
+				if (it != recordIndices.constEnd())
+					records[it.value()] = record;
+				else
+				{
+					recordIndices.insert(record.name, records.size());
+					records.append(record);
+				}
+			}
+		}
+		emit importProgress(elementsFile.pos(), fileSize);
+	}
+	elementsFile.close();
+	qDebug() << "Done reading orbital elements."
+	         << "Recognized" << records.size() << "objects"
+	         << "out of" << lineCount << "lines.";
+
+	QSet<QString> names = QSet<QString>::fromList(recordIndices.keys());
+	if (!replaceInMinorBodiesDatabase(names, records))
+		return -1;
+	return records.size();
+}
+
 bool SolarSystemEditor::appendToSolarSystemConfigurationFile(QList<SsoElements> objectList)
 {
 	qDebug() << "appendToSolarSystemConfigurationFile begin ... "; // GZ
@@ -1202,6 +1372,33 @@ bool SolarSystemEditor::appendToSolarSystemConfigurationFile(QList<SsoElements>
 	delete solarSystemSettings;
 	solarSystemSettings = NULL;
 
+	//The minor bodies orbiting the Sun go to the database, the others to ssystem.ini
+	QSet<QString> newNames;
+	QVector<MinorBodyStore::Record> newRecords;
+	QList<SsoElements> fileObjects;
+	foreach (SsoElements object, objectList)
+	{
+		QString name = object.value("name").toString();
+		if (name.isEmpty() || object.value("section_name").toString().isEmpty())
+			continue;
+		newNames.insert(name);
+
+		MinorBodyStore::Record record;
+		if (MinorBodyStore::recordFromElements(object, record))
+			newRecords.append(record);
+		else
+			fileObjects.append(object);
+	}
+	bool appendedToDatabase = false;
+	if (replaceInMinorBodiesDatabase(newNames, newRecords))
+	{
+		appendedToDatabase = !newRecords.isEmpty();
+		if (appendedToDatabase)
+			qDebug() << "Appended" << newRecords.size() << "objects to" << QDir::toNativeSeparators(customMinorBodiesFilePath);
+	}
+	if (fileObjects.isEmpty())
+		return appendedToDatabase;
+
 	//Write to file
 	//TODO: The usual validation
 	qDebug() << "Appending to file...";
@@ -1209,9 +1406,9 @@ bool SolarSystemEditor::appendToSolarSystemConfigurationFile(QList<SsoElements>
 	if(solarSystemConfigurationFile.open(QFile::WriteOnly | QFile::Append | QFile::Text))
 	{
 		QTextStream output (&solarSystemConfigurationFile);
-		bool appendedAtLeastOne = false;
+		bool appendedAtLeastOne = appendedToDatabase;
 
-		foreach (SsoElements object, objectList)
+		foreach (SsoElements object, fileObjects)
 		{
 			if (!object.contains("section_name"))
 				continue;
@@ -1305,6 +1502,16 @@ bool SolarSystemEditor::updateSolarSystemConfigurationFile(QList<SsoElements> ob
 			<< "orbit_SemiMajorAxis"
 			<< "orbit_TimeAtPericenter";
 
+	//The objects of the minor bodies database are updated there
+	QVector<MinorBodyStore::Record> databaseRecords;
+	if (QFile::exists(customMinorBodiesFilePath))
+		MinorBodyStore::readAll(customMinorBodiesFilePath, databaseRecords);
+	QHash<QString,int> databaseIndices;
+	for (int i=0; i<databaseRecords.size(); ++i)
+		databaseIndices.insert(databaseRecords.at(i).name, i);
+	QHash<QString,QString> fileObjects = listAllLoadedObjectsInFile(customSolarSystemFilePath);
+	bool databaseChanged = false;
+
 	qDebug() << "Updating objects...";
 	foreach (SsoElements object, objectList)
 	{
@@ -1317,6 +1524,48 @@ bool SolarSystemEditor::updateSolarSystemConfigurationFile(QList<SsoElements> ob
 			continue;
 		object.remove("section_name");
 
+		if (databaseIndices.contains(name) && !fileObjects.contains(name))
+		{
+			MinorBodyStore::Record update;
+			if (!MinorBodyStore::recordFromElements(object, update))
+			{
+				qDebug() << "Skipping update of" << sectionName << ", as it can't be stored in the minor bodies database.";
+				continue;
+			}
+			MinorBodyStore::Record& record = databaseRecords[databaseIndices.value(name)];
+			if (flags.testFlag(UpdateNameAndNumber))
+			{
+				record.minorPlanetNumber = update.minorPlanetNumber;
+				record.provisionalDesignation = update.provisionalDesignation;
+			}
+			if (flags.testFlag(UpdateType))
+			{
+				record.type = update.type;
+			}
+			if (flags.testFlag(UpdateOrbitalElements))
+			{
+				record.pericenterDistance = update.pericenterDistance;
+				record.eccentricity = update.eccentricity;
+				record.inclination = update.inclination;
+				record.ascendingNode = update.ascendingNode;
+				record.argOfPericenter = update.argOfPericenter;
+				record.timeAtPericenter = update.timeAtPericenter;
+				record.meanMotion = update.meanMotion;
+				record.orbitGoodDays = update.orbitGoodDays;
+				record.semiMajorAxis = update.semiMajorAxis;
+			}
+			if (flags.testFlag(UpdateMagnitudeParameters)
+			    && object.contains("absolute_magnitude") && object.contains("slope_parameter")
+			    && record.type != MinorBodyStore::Plutoid)
+			{
+				record.absoluteMagnitude = update.absoluteMagnitude;
+				record.slopeParameter = update.slopeParameter;
+			}
+			databaseChanged = true;
+			qDebug() << "Updated successfully" << sectionName;
+			continue;
+		}
+
 		if (loadedObjects.contains(name))
 		{
 			if (sectionName != loadedObjects.value(name))
@@ -1401,6 +1650,9 @@ bool SolarSystemEditor::updateSolarSystemConfigurationFile(QList<SsoElements> ob
 		qDebug() << "Updated successfully" << sectionName;
 	}
 
+	if (databaseChanged && !MinorBodyStore::write(customMinorBodiesFilePath, databaseRecords))
+		return false;
+
 	return true;
 }
 
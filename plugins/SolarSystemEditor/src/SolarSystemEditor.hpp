@@ -23,10 +23,12 @@
 
 #include "StelGui.hpp"
 #include "StelModule.hpp"
+#include "MinorBodyStore.hpp"
 //#include "CAIMainWindow.hpp"
 
 #include <QHash>
 #include <QList>
+#include <QSet>
 #include <QString>
 #include <QVariant>
 
@@ -148,6 +150,25 @@ public:
 	//! readXEphemOneLineElements() is used internally to parse each line.
 	QList<SsoElements> readXEphemOneLineElementsFromFile(QString filePath);
 
+	//! Formats of the files which can be imported with importElementsFileToDatabase().
+	enum ElementsFormat {
+		MpcCometElements,	//!< See readMpcOneLineCometElements()
+		MpcMinorPlanetElements,	//!< See readMpcOneLineMinorPlanetElements()
+		XEphemElements		//!< See readXEphemOneLineElements()
+	};
+
+	//! Adds all the objects of a file of one-line orbital elements to the
+	//! user minor bodies database, for files too large to go through
+	//! SsoElements lists, like the complete MPCORB.DAT.
+	//! The file is read in chunks of lines which are parsed in parallel
+	//! directly into MinorBodyStore records. The objects which can't be
+	//! stored in the database are skipped.
+	//! This function can be run in a worker thread; it doesn't reload
+	//! the Solar System.
+	//! eturns the number of objects imported, or -1 if the file can't be
+	//! read or the database can't be written.
+	int importElementsFileToDatabase(QString filePath, ElementsFormat format);
+
 	//! Adds a new entry at the end of the user solar system configuration file.
 	//! This function writes directly to the file. See the note on why QSettings
 	//! was not used in the description of
@@ -173,6 +194,10 @@ public:
 	//! Invalid entries in the list (that don't contain a value for
 	//! "section_name" or it is an empty string) are skipped and the processing
 	//! continues from the next entry.
+	//!
+	//! The asteroids, plutoids and comets orbiting the Sun with no texture of
+	//! their own (i.e. all the objects imported from the MPC) are written to the
+	//! user minor bodies database instead, see MinorBodyStore.
 	//! \todo Protect the default Solar System configuration?
 	//! \todo At least warn when overwriting old entries?
 	bool appendToSolarSystemConfigurationFile(QList<SsoElements>);
@@ -197,11 +222,13 @@ public:
 	//! in the installation directory.
 	QHash<QString,QString> getDefaultSsoIdentifiers() {return defaultSsoIdentifiers;}
 
-	//! Lists the objects listed in the current user ssystem.ini.
+	//! Lists the objects listed in the current user ssystem.ini and in the
+	//! user minor bodies database.
 	//! As the name suggests, the list is compiled when the function is run.
 	QHash<QString,QString> listAllLoadedSsoIdentifiers();
 
-	//! Removes an object from the user Solar System configuration file.
+	//! Removes an object from the user Solar System configuration file
+	//! or from the user minor bodies database.
 	//! Reloads the Solar System on successfull removal.
 	//! \arg name true name of the object ("name" parameter in the configuration file)
 	//! \returns true if the entry has been removed successfully or there is
@@ -216,6 +243,9 @@ public:
 
 	//! returns the path
 	QString getCustomSolarSystemFilePath() const {return customSolarSystemFilePath;}
+	//! Returns the path of the database where the minor bodies orbiting the Sun are added.
+	//! The copy and replacement of the configuration file don't include it.
+	QString getCustomMinorBodiesFilePath() const {return customMinorBodiesFilePath;}
 	
 public slots:
 	//! Resets the Solar System configuration file and reloads the Solar System.
@@ -226,6 +256,11 @@ signals:
 	//TODO: This should be part of SolarSystem::reloadPlanets()
 	void solarSystemChanged();
 
+	//! Emitted by importElementsFileToDatabase() after each chunk of the file.
+	//! \param bytesRead the number of bytes of the file read so far
+	//! \param bytesTotal the size of the file
+	void importProgress(qint64 bytesRead, qint64 bytesTotal);
+
 private slots:
 	void updateI18n();
 
@@ -240,6 +275,9 @@ private:
 
 	QString customSolarSystemFilePath;
 	QString defaultSolarSystemFilePath;
+	//! The asteroids and comets imported from the MPC are stored there rather than in
+	//! ssystem.ini, as QSettings is too slow for tens of thousands of objects.
+	QString customMinorBodiesFilePath;
 
 	//! A hash matching SSO names with the group names used to identify them
 	//! in the configuration file.
@@ -254,6 +292,15 @@ private:
 	//! defaultSsoNames.
 	//! Does not check if the file exists.
 	QHash<QString,QString> listAllLoadedObjectsInFile(QString filePath);
+	//! Gets the names of the loaded objects of the user minor bodies database,
+	//! with the group names they would have in a configuration file.
+	QHash<QString,QString> listAllLoadedObjectsInDatabase();
+
+	//! Replaces the bodies with the given names in the user minor bodies database
+	//! by the given records, and removes the names which have no record.
+	//! 
+eturns true if the database has been written successfully
+	bool replaceInMinorBodiesDatabase(const QSet<QString>& names, const QVector<MinorBodyStore::Record>& records);
 
 	//! Creates a copy of the default ssystem.ini file in the user data directory.
 	//! \returns true if a file already exists or the copying has been successful
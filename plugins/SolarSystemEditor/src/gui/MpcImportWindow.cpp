@@ -48,6 +48,8 @@
 #include <QUrl>
 #include <QUrlQuery>
 #include <QDir>
+#include <QFileInfo>
+#include <QtConcurrent>
 
 MpcImportWindow::MpcImportWindow()
 	: importType(ImportType())
@@ -55,6 +57,8 @@ MpcImportWindow::MpcImportWindow()
 	, queryReply(0)
 	, downloadProgressBar(0)
 	, queryProgressBar(0)
+	, importWatcher(0)
+	, importProgressBar(0)
 	, countdown(0)
 {
 	ui = new Ui_mpcImportWindow();
@@ -86,6 +90,10 @@ MpcImportWindow::~MpcImportWindow()
 		StelApp::getInstance().removeProgressBar(downloadProgressBar);
 	if (queryProgressBar)
 		StelApp::getInstance().removeProgressBar(queryProgressBar);
+	if (importWatcher)
+		importWatcher->waitForFinished();
+	if (importProgressBar)
+		StelApp::getInstance().removeProgressBar(importProgressBar);
 }
 
 void MpcImportWindow::createDialogContent()
@@ -225,6 +233,13 @@ void MpcImportWindow::acquireObjectData()
 		if (filePath.isEmpty())
 			return;
 
+		//The complete lists (e.g. MPCORB.DAT) are too large to be displayed
+		if (QFileInfo(filePath).size() > LargeFileSize)
+		{
+			importFileToDatabase(filePath);
+			return;
+		}
+
 		QList<SsoElements> objects = readElementsFromFile(importType, filePath);
 		if (objects.isEmpty())
 			return;
@@ -675,6 +690,62 @@ void MpcImportWindow::downloadComplete(QNetworkReply *reply)
 	connect(ssoManager, SIGNAL(solarSystemChanged()), this, SLOT(resetDialog()));
 }
 
+void MpcImportWindow::importFileToDatabase(QString filePath)
+{
+	if (importWatcher)
+		return;
+
+	importProgressBar = StelApp::getInstance().addProgressBar();
+	importProgressBar->setValue(0);
+	importProgressBar->setRange(0, 0);
+	enableInterface(false);
+
+	SolarSystemEditor::ElementsFormat format = (importType == MpcComets)
+		? SolarSystemEditor::MpcCometElements
+		: SolarSystemEditor::MpcMinorPlanetElements;
+	connect(ssoManager, SIGNAL(importProgress(qint64,qint64)), this, SLOT(updateImportProgress(qint64,qint64)));
+	importWatcher = new QFutureWatcher<int>(this);
+	connect(importWatcher, SIGNAL(finished()), this, SLOT(importToDatabaseFinished()));
+	importWatcher->setFuture(QtConcurrent::run(ssoManager, &SolarSystemEditor::importElementsFileToDatabase, filePath, format));
+}
+
+void MpcImportWindow::updateImportProgress(qint64 bytesRead, qint64 bytesTotal)
+{
+	if (importProgressBar == NULL || bytesTotal <= 0)
+		return;
+
+	//In thousandths, as the progress bars hold ints
+	importProgressBar->setRange(0, 1000);
+	importProgressBar->setValue((int)(bytesRead * 1000 / bytesTotal));
+}
+
+void MpcImportWindow::importToDatabaseFinished()
+{
+	disconnect(ssoManager, SIGNAL(importProgress(qint64,qint64)), this, SLOT(updateImportProgress(qint64,qint64)));
+	const int nbImported = importWatcher->result();
+	importWatcher->deleteLater();
+	importWatcher = NULL;
+	if (importProgressBar)
+	{
+		StelApp::getInstance().removeProgressBar(importProgressBar);
+		importProgressBar = NULL;
+	}
+
+	if (nbImported < 0)
+	{
+		qWarning() << "The import of the file to the minor bodies database failed.";
+		enableInterface(true);
+		return;
+	}
+	qDebug() << "Imported" << nbImported << "objects to the minor bodies database.";
+
+	//Refresh the Solar System
+	GETSTELMODULE(SolarSystem)->reloadPlanets();
+
+	resetDialog();
+	emit objectsImported();
+}
+
 void MpcImportWindow::deleteDownloadProgressBar()
 {
 	disconnect(this, SLOT(updateDownloadProgress(qint64,qint64)));
@@ -22,6 +22,7 @@
 #define _MPC_IMPORT_WINDOW_
 
 #include <QObject>
+#include <QFutureWatcher>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QStandardItemModel>
@@ -81,6 +82,10 @@ private slots:
 	void receiveQueryReply(QNetworkReply * reply);
 	void readQueryReply(QNetworkReply * reply);
 
+	//Import of the large files to the minor bodies database
+	void updateImportProgress(qint64 bytesRead, qint64 bytesTotal);
+	void importToDatabaseFinished();
+
 	//! Marks (checks) all items in the results lists
 	void markAll();
 	//! Unmarks (unchecks) all items in the results lists
@@ -121,6 +126,14 @@ private:
 	void deleteDownloadProgressBar();
 	void deleteQueryProgressBar();
 
+	//! Files larger than this are imported directly to the minor bodies database,
+	//! without listing the objects for selection (about 5000 objects).
+	static const qint64 LargeFileSize = 1024*1024;
+	//! Import all the objects of a large file in a worker thread.
+	void importFileToDatabase(QString filePath);
+	QFutureWatcher<int> * importWatcher;
+	class StelProgressController * importProgressBar;
+
 	typedef QHash<QString,QString> Bookmarks;
 	QHash<ImportType, Bookmarks> bookmarks;
 	void loadBookmarks();
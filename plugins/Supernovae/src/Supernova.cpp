@@ -59,6 +59,7 @@ Supernova::Supernova(const QVariantMap& map)
 	snde = StelUtils::getDecAngle(map.value("delta").toString());
 	note = map.value("note").toString();
 	distance = map.value("distance").toDouble();
+	StelUtils::spheToRect(snra, snde, XYZ);
 
 	initialized = true;
 }
@@ -225,33 +226,15 @@ void Supernova::update(double deltaTime)
 	labelsFader.update((int)(deltaTime*1000));
 }
 
-void Supernova::draw(StelCore* core, StelPainter& painter)
+void Supernova::drawLabel(StelCore* core, StelPainter& painter, float mag)
 {
-	StelSkyDrawer* sd = core->getSkyDrawer();
 	StarMgr* smgr = GETSTELMODULE(StarMgr); // It's need for checking displaying of labels for stars
-
-	Vec3f color = Vec3f(1.f,1.f,1.f);
-	RCMag rcMag;
-	float size, shift;
-	double mag;
-
-	StelUtils::spheToRect(snra, snde, XYZ);
-	mag = getVMagnitudeWithExtinction(core);
-	sd->preDrawPointSource(&painter);
-	float mlimit = sd->getLimitMagnitude();
-	
-	if (mag <= mlimit)
+	const float mlimit = core->getSkyDrawer()->getLimitMagnitude();
+	if (labelsFader.getInterstate()<=0.f && (mag+5.f)<mlimit && smgr->getFlagLabels())
 	{
-		sd->computeRCMag(mag, &rcMag);		
-		sd->drawPointSource(&painter, Vec3f(XYZ[0], XYZ[1], XYZ[2]), rcMag, color, false);
-		painter.setColor(color[0], color[1], color[2], 1);
-		size = getAngularSize(NULL)*M_PI/180.*painter.getProjector()->getPixelPerRadAtCenter();
-		shift = 6.f + size/1.8f;
-		if (labelsFader.getInterstate()<=0.f && (mag+5.f)<mlimit && smgr->getFlagLabels())
-		{
-			painter.drawText(XYZ, designation, 0, shift, shift, false);
-		}
+		painter.setColor(1.f, 1.f, 1.f, 1.f);
+		const float size = getAngularSize(NULL)*M_PI/180.*painter.getProjector()->getPixelPerRadAtCenter();
+		const float shift = 6.f + size/1.8f;
+		painter.drawText(XYZ, designation, 0, shift, shift, false);
 	}
-
-	sd->postDrawPointSource(&painter);
 }
@@ -79,7 +79,9 @@ private:
 
 	static StelTextureSP hintTexture;
 
-	void draw(StelCore* core, StelPainter& painter);
+	//! Draw the label of the supernova, once its point source was drawn by Supernovae.
+	//! @param mag the magnitude of the supernova with the extinction.
+	void drawLabel(StelCore* core, StelPainter& painter, float mag);
 
 	// Supernova
 	QString designation;               //! The ID of the supernova
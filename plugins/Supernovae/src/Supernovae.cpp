@@ -27,6 +27,7 @@
 #include "StelObjectMgr.hpp"
 #include "StelTextureMgr.hpp"
 #include "StelJsonParser.hpp"
+#include "StelBinaryCatalog.hpp"
 #include "StelFileMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
@@ -36,8 +37,6 @@
 #include "SupernovaeDialog.hpp"
 #include "StelProgressController.hpp"
 
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QKeyEvent>
 #include <QDebug>
 #include <QFileInfo>
@@ -81,8 +80,9 @@ StelPluginInfo SupernovaeStelPluginInterface::getPluginInfo() const
 */
 Supernovae::Supernovae()
 	: SNCount(0)
+	, snCatalogJD(0.)
 	, updateState(CompleteNoUpdates)
-	, downloadMgr(NULL)
+	, updater(NULL)
 	, progressBar(NULL)
 	, updateTimer(0)
 	, messageTimer(0)
@@ -160,6 +160,15 @@ void Supernovae::init()
 	messageTimer->stop();
 	connect(messageTimer, SIGNAL(timeout()), this, SLOT(messageTimeout()));
 
+	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
+}
+
+//! Load the catalog and schedule its updates once the first frames are shown.
+void Supernovae::deferredInit()
+{
+	if (sneJsonPath.isEmpty())
+		return;
+
 	// If the json file does not already exist, create it from the resource in the Qt resource
 	if(QFileInfo(sneJsonPath).exists())
 	{
@@ -179,16 +188,15 @@ void Supernovae::init()
 	readJsonFile();
 
 	// Set up download manager and the update schedule
-	downloadMgr = new QNetworkAccessManager(this);
-	connect(downloadMgr, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloadComplete(QNetworkReply*)));
+	updater = new StelCatalogUpdater("Supernovae", sneJsonPath, this);
+	connect(updater, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(updateDownloadProgress(qint64,qint64)));
+	connect(updater, SIGNAL(finished(StelCatalogUpdater::Result)), this, SLOT(updateFinished(StelCatalogUpdater::Result)));
 	updateState = CompleteNoUpdates;
 	updateTimer = new QTimer(this);
 	updateTimer->setSingleShot(false);   // recurring check for update
 	updateTimer->setInterval(13000);     // check once every 13 seconds to see if it is time for an update
 	connect(updateTimer, SIGNAL(timeout()), this, SLOT(checkForUpdate()));
 	updateTimer->start();
-
-	GETSTELMODULE(StelObjectMgr)->registerStelObjectMgr(this);
 }
 
 /*
@@ -199,13 +207,24 @@ void Supernovae::draw(StelCore* core)
 	StelProjectorP prj = core->getProjection(StelCore::FrameJ2000);
 	StelPainter painter(prj);
 	painter.setFont(font);
-	
-	foreach (const SupernovaP& sn, snstar)
+
+	// The magnitudes of the supernovae only change with the date
+	if (core->getJDay()!=snCatalogJD)
 	{
-		if (sn && sn->initialized)
-			sn->draw(core, painter);
+		QVector<float> magnitudes;
+		magnitudes.reserve(snstar.size());
+		foreach (const SupernovaP& sn, snstar)
+			magnitudes.append(sn->getVMagnitude(core));
+		snCatalog.setMagnitudes(magnitudes);
+		snCatalogJD = core->getJDay();
 	}
 
+	QVector<int> visible;
+	QVector<float> magnitudes;
+	snCatalog.draw(core, &painter, &visible, &magnitudes);
+	for (int i=0;i<visible.size();++i)
+		snstar.at(visible.at(i))->drawLabel(core, painter, magnitudes.at(i));
+
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer())
 		drawPointer(core, painter);
 
@@ -240,20 +259,10 @@ QList<StelObjectP> Supernovae::searchAround(const Vec3d& av, double limitFov, co
 
 	Vec3d v(av);
 	v.normalize();
-	double cosLimFov = cos(limitFov * M_PI/180.);
-	Vec3d equPos;
-
-	foreach(const SupernovaP& sn, snstar)
+	const SphericalCap cap(v, cos(limitFov * M_PI/180.));
+	foreach(const StelRegionObjectP& obj, snIndex.getPointsInRegion(&cap))
 	{
-		if (sn->initialized)
-		{
-			equPos = sn->XYZ;
-			equPos.normalize();
-			if (equPos[0]*v[0] + equPos[1]*v[1] + equPos[2]*v[2]>=cosLimFov)
-			{
-				result.append(qSharedPointerCast<StelObject>(sn));
-			}
-		}
+		result.append(qSharedPointerCast<StelObject>(obj));
 	}
 
 	return result;
@@ -452,16 +461,7 @@ QVariantMap Supernovae::loadSNeMap(QString path)
 	if (path.isEmpty())
 	    path = sneJsonPath;
 
-	QVariantMap map;
-	QFile jsonFile(path);
-	if (!jsonFile.open(QIODevice::ReadOnly))
-		qWarning() << "Supernovae: cannot open" << QDir::toNativeSeparators(path);
-	else
-	{
-		map = StelJsonParser::parse(jsonFile.readAll()).toMap();
-		jsonFile.close();
-	}
-	return map;
+	return StelBinaryCatalog::loadJsonCatalog(path);
 }
 
 /*
@@ -470,6 +470,7 @@ QVariantMap Supernovae::loadSNeMap(QString path)
 void Supernovae::setSNeMap(const QVariantMap& map)
 {
 	snstar.clear();
+	snIndex.clear();
 	snlist.clear();
 	SNCount = 0;
 	QVariantMap sneMap = map.value("supernova").toMap();
@@ -483,9 +484,23 @@ void Supernovae::setSNeMap(const QVariantMap& map)
 
 		SupernovaP sn(new Supernova(sneData));
 		if (sn->initialized)
+		{
 			snstar.append(sn);
+			snIndex.insert(qSharedPointerCast<StelRegionObject>(sn));
+		}
+
+	}
 
+	QVector<Vec3d> positions;
+	QVector<float> magnitudes;
+	foreach (const SupernovaP& sn, snstar)
+	{
+		positions.append(sn->XYZ);
+		magnitudes.append(sn->maxMagnitude);
 	}
+	snCatalog.setPoints(positions, magnitudes, QVector<Vec3f>(snstar.size(), Vec3f(1.f,1.f,1.f)));
+	// Compute the magnitudes at the next drawing
+	snCatalogJD = 0.;
 }
 
 int Supernovae::getJsonFileVersion(void)
@@ -568,7 +583,10 @@ SupernovaP Supernovae::getByID(const QString& id)
 bool Supernovae::configureGui(bool show)
 {
 	if (show)
+	{
+		StelApp::getInstance().finishDeferredInit(this);
 		configDialog->setVisible(true);
+	}
 	return true;
 }
 
@@ -630,6 +648,11 @@ void Supernovae::checkForUpdate(void)
 
 void Supernovae::updateJSON(void)
 {
+	// The updater is created with the catalog
+	StelApp::getInstance().finishDeferredInit(this);
+	if (!updater)
+		return;
+
 	if (updateState==Supernovae::Updating)
 	{
 		qWarning() << "Supernovae: already updating...  will not start again current update is complete.";
@@ -653,43 +676,17 @@ void Supernovae::updateJSON(void)
 	progressBar->setRange(0, 100);
 	progressBar->setFormat("Update historical supernovae");
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(updateUrl));
-	request.setRawHeader("User-Agent", QString("Mozilla/5.0 (Stellarium Historical Supernovae Plugin %1; http://stellarium.org/)").arg(SUPERNOVAE_PLUGIN_VERSION).toUtf8());
-	downloadMgr->get(request);
-
-	updateState = Supernovae::CompleteUpdates;
-	emit(updateStateChanged(updateState));
-	emit(jsonUpdateComplete());
+	updater->update(QUrl(updateUrl), QString("Mozilla/5.0 (Stellarium Historical Supernovae Plugin %1; http://stellarium.org/)").arg(SUPERNOVAE_PLUGIN_VERSION).toUtf8());
 }
 
-void Supernovae::updateDownloadComplete(QNetworkReply* reply)
+void Supernovae::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	// check the download worked, and save the data to file if this is the case.
-	if (reply->error() != QNetworkReply::NoError)
-	{
-		qWarning() << "Supernovae: FAILED to download" << reply->url() << " Error: " << reply->errorString();
-	}
-	else
-	{
-		// download completed successfully.
-		QString jsonFilePath = StelFileMgr::findFile("modules/Supernovae", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::Directory)) + "/supernovae.json";
-		if (jsonFilePath.isEmpty())
-		{
-			qWarning() << "Supernovae: cannot write JSON data to file:" << QDir::toNativeSeparators(jsonFilePath);
-			return;
-		}
-		QFile jsonFile(jsonFilePath);
-		if (jsonFile.exists())
-			jsonFile.remove();
-
-		if(jsonFile.open(QIODevice::WriteOnly | QIODevice::Text))
-		{
-			jsonFile.write(reply->readAll());
-			jsonFile.close();
-		}
-	}
+	if (progressBar && bytesTotal > 0)
+		progressBar->setValue((int)(100 * bytesReceived / bytesTotal));
+}
 
+void Supernovae::updateFinished(StelCatalogUpdater::Result result)
+{
 	if (progressBar)
 	{
 		progressBar->setValue(100);
@@ -697,7 +694,25 @@ void Supernovae::updateDownloadComplete(QNetworkReply* reply)
 		progressBar = NULL;
 	}
 
-	readJsonFile();
+	switch (result)
+	{
+		case StelCatalogUpdater::Updated:
+			// The new catalog was parsed in a worker thread, it replaces the current one at once
+			setSNeMap(updater->takeCatalog());
+			updateState = Supernovae::CompleteUpdates;
+			break;
+		case StelCatalogUpdater::NotModified:
+			updateState = Supernovae::CompleteNoUpdates;
+			break;
+		case StelCatalogUpdater::DownloadFailed:
+			updateState = Supernovae::DownloadError;
+			break;
+		default:
+			updateState = Supernovae::OtherError;
+			break;
+	}
+	emit(updateStateChanged(updateState));
+	emit(jsonUpdateComplete());
 }
 
 void Supernovae::displayMessage(const QString& message, const QString hexColor)
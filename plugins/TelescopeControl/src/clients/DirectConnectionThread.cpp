@@ -0,0 +1,94 @@
+/*
+ * Stellarium Telescope Control Plug-in
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "DirectConnectionThread.hpp"
+
+#include "Server.hpp"
+#include "LogFile.hpp"
+
+#include <QMutexLocker>
+
+DirectConnectionThread::DirectConnectionThread(Server &server, QTextStream *log)
+	: server(server)
+	, log(log)
+	, stopRequested(0)
+	, connected(1)
+	, gotoPending(false)
+	, gotoRa(0)
+	, gotoDec(0)
+{
+}
+
+DirectConnectionThread::~DirectConnectionThread(void)
+{
+	stop();
+}
+
+void DirectConnectionThread::stop(void)
+{
+	stopRequested.fetchAndStoreRelease(1);
+	wait();
+}
+
+void DirectConnectionThread::run(void)
+{
+	// The main thread switches its log stream between the slots
+	setThreadLogFile(log);
+	while (stopRequested.loadAcquire() == 0)
+	{
+		server.step(StepTimeoutMicros);
+	}
+}
+
+void DirectConnectionThread::postPosition(const Vec3d &pos, long long int micros, int status)
+{
+	RawPosition p;
+	p.pos = pos;
+	p.micros = micros;
+	p.status = status;
+	QMutexLocker lock(&mutex);
+	positions.append(p);
+}
+
+QList<DirectConnectionThread::RawPosition> DirectConnectionThread::takePositions(void)
+{
+	QMutexLocker lock(&mutex);
+	QList<RawPosition> taken;
+	taken.swap(positions);
+	return taken;
+}
+
+void DirectConnectionThread::postGoto(unsigned int ra_int, int dec_int)
+{
+	QMutexLocker lock(&mutex);
+	gotoPending = true;
+	gotoRa = ra_int;
+	gotoDec = dec_int;
+}
+
+bool DirectConnectionThread::takeGoto(unsigned int &ra_int, int &dec_int)
+{
+	QMutexLocker lock(&mutex);
+	if (!gotoPending)
+		return false;
+	gotoPending = false;
+	ra_int = gotoRa;
+	dec_int = gotoDec;
+	return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * Stellarium Telescope Control Plug-in
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _DIRECT_CONNECTION_THREAD_HPP_
+#define _DIRECT_CONNECTION_THREAD_HPP_
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+
+#include "VecMath.hpp"
+
+class QTextStream;
+class Server;
+
+//! Runs the serial communication of a direct telescope client in its own thread,
+//! so that a slow serial line or a mount which does not answer never delays a frame.
+//! The thread steps the Server of the client in a loop: the commands are written and
+//! the answers read as soon as the port is ready, and the client can queue the next
+//! position query right after the last answer.
+//! The client exchanges data with the main thread only through this object:
+//! the main thread posts the gotos and takes the positions, the connection thread
+//! takes the gotos and posts the positions.
+class DirectConnectionThread : public QThread
+{
+public:
+	//! A position read from the telescope, in the equinox of the telescope.
+	struct RawPosition
+	{
+		Vec3d pos;
+		//! The time the answer was read, on the GetNow() clock.
+		long long int micros;
+		int status;
+	};
+
+	//! @param log the log stream of the slot of the client, used by the connection thread.
+	DirectConnectionThread(Server &server, QTextStream *log);
+	~DirectConnectionThread(void);
+
+	//! Ask the loop to end and wait for it.
+	void stop(void);
+
+	//! Set by the connection thread when the serial port is open or closed.
+	void setConnected(bool b) {connected.fetchAndStoreRelease(b ? 1 : 0);}
+	bool isConnected(void) const {return connected.loadAcquire() != 0;}
+
+	//! Called by the connection thread when a position is read.
+	void postPosition(const Vec3d &pos, long long int micros, int status);
+	//! Called by the main thread to take the positions read since the last call.
+	QList<RawPosition> takePositions(void);
+
+	//! Called by the main thread. A goto replaces the one not yet taken.
+	void postGoto(unsigned int ra_int, int dec_int);
+	//! Called by the connection thread, returns false when no goto is waiting.
+	bool takeGoto(unsigned int &ra_int, int &dec_int);
+
+protected:
+	void run(void);
+
+private:
+	//! The time the Server waits for the serial port in each step.
+	static const long long int StepTimeoutMicros = 10000;
+
+	Server &server;
+	QTextStream *log;
+	QAtomicInt stopRequested;
+	QAtomicInt connected;
+
+	QMutex mutex;
+	QList<RawPosition> positions;
+	bool gotoPending;
+	unsigned int gotoRa;
+	int gotoDec;
+};
+
+#endif // _DIRECT_CONNECTION_THREAD_HPP_
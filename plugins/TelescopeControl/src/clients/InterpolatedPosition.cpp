@@ -25,6 +25,8 @@
 
 #include "InterpolatedPosition.hpp"
 
+const qint64 InterpolatedPosition::MaxExtrapolationMicros;
+
 InterpolatedPosition::InterpolatedPosition() :
 		end_position(positions+(sizeof(positions)/sizeof(positions[0])))
 {
@@ -48,6 +50,7 @@ void InterpolatedPosition::reset()
 		position_pointer->status = 0;
 	}
 	position_pointer = positions;
+	server_minus_client = 0;
 }
 
 void InterpolatedPosition::add(Vec3d &position, qint64 clientTime, qint64 serverTime, int status)
@@ -62,6 +65,15 @@ void InterpolatedPosition::add(Vec3d &position, qint64 clientTime, qint64 server
 	position_pointer->server_micros = serverTime;
 	position_pointer->client_micros = clientTime;
 	position_pointer->status = status;
+
+	// The sample received with the smallest delay gives the best estimate of the
+	// offset between the clocks, and it is an upper bound of the true offset
+	server_minus_client = serverTime - clientTime;
+	for (const Position *p = positions; p < end_position; p++)
+	{
+		if (p->client_micros != INT64_MAX && p->server_micros - p->client_micros > server_minus_client)
+			server_minus_client = p->server_micros - p->client_micros;
+	}
 }
 
 Vec3d InterpolatedPosition::get(qint64 now) const
@@ -72,17 +84,36 @@ Vec3d InterpolatedPosition::get(qint64 now) const
 	}
 
 	const Position *p = position_pointer;
+	const Position *pp = previous(p);
+	if (now >= getClientTime(*p))
+	{
+		// Extrapolate the motion between the last two positions
+		if (pp->client_micros == INT64_MAX)
+			return Vec3d(p->pos);
+		const qint64 interval = getClientTime(*p) - getClientTime(*pp);
+		if (interval <= 0 || interval > MaxExtrapolationMicros)
+			return Vec3d(p->pos);
+		const qint64 elapsed = qMin(now - getClientTime(*p), MaxExtrapolationMicros);
+		Vec3d rval = p->pos + (p->pos - pp->pos) * ((double)elapsed / interval);
+		double f = rval.lengthSquared();
+		if (f > 0.0)
+		{
+			return (1.0/sqrt(f))*rval;
+		}
+		return Vec3d(p->pos);
+	}
+
 	do
 	{
-		const Position *pp = p;
-		if (pp == positions) pp = end_position;
-		pp--;
+		pp = previous(p);
 		if (pp->client_micros == INT64_MAX) break;
-		if (pp->client_micros <= now && now <= p->client_micros)
+		const qint64 t0 = getClientTime(*pp);
+		const qint64 t1 = getClientTime(*p);
+		if (t0 <= now && now <= t1)
 		{
-			if (pp->client_micros != p->client_micros)
+			if (t0 != t1)
 			{
-				Vec3d rval = p->pos * (now - pp->client_micros) + pp->pos * (p->client_micros - now);
+				Vec3d rval = p->pos * (now - t0) + pp->pos * (t1 - now);
 				double f = rval.lengthSquared();
 				if (f > 0.0)
 				{
@@ -42,22 +42,44 @@ struct Position
 	int status;
 };
 
+//! Keeps the last positions reported by a telescope to estimate where it points at any time.
+//! The positions are placed on the client clock using the time at which the server
+//! measured them, so the jitter of the transport does not disturb the interpolation.
+//! The offset between the clocks is estimated from the sample received with the
+//! smallest delay among the stored ones, which follows a slow drift of the clocks.
+//! After the last position the motion is extrapolated, so that a fast moving mount
+//! can be displayed with a short delay between two reports.
 class InterpolatedPosition {
 public:
 	InterpolatedPosition();
 	~InterpolatedPosition();
 	
+	//! Store a new position.
+	//! @param clientTime the time the position was received, on the client clock.
+	//! @param serverTime the time the position was measured, on the server clock.
 	void add(Vec3d& position, qint64 clientTime, qint64 serverTime, int status = 0);
-	//! returns the current interpolated position
+	//! returns the position at the given time on the client clock, interpolated
+	//! between the stored positions or extrapolated after the last one.
 	Vec3d get(qint64 time) const;
 	//! resets/initializes the array of positions kept for position interpolation
 	void reset();
 	bool isKnown() const {return (position_pointer->client_micros != INT64_MAX);}
+	//! Get the estimated difference between the server and client clocks, in microseconds.
+	qint64 getServerMinusClientMicros() const {return server_minus_client;}
+
+	//! The motion is not extrapolated further than this after the last position,
+	//! so that the displayed position stops when the telescope stops reporting.
+	static const qint64 MaxExtrapolationMicros = 1000000;
 	
 private:
+	//! Get the time of a stored position on the client clock.
+	qint64 getClientTime(const Position& p) const {return p.server_micros - server_minus_client;}
+	const Position *previous(const Position *p) const {return (p == positions ? end_position : p) - 1;}
+
 	Position positions[16];
 	Position *position_pointer;
 	Position *const end_position;
+	qint64 server_minus_client;
 };
  
  #endif //_INTEPOLATED_POSITION_HPP_
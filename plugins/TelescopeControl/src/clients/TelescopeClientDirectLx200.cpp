@@ -28,6 +28,7 @@
 
 #include "Lx200Connection.hpp"
 #include "Lx200Command.hpp"
+#include "DirectConnectionThread.hpp"
 #include "LogFile.hpp"
 #include "StelCore.hpp"
 
@@ -38,6 +39,7 @@ TelescopeClientDirectLx200::TelescopeClientDirectLx200 (const QString &name, con
 	: TelescopeClient(name)
 	, time_delay(0)
 	, equinox(eq)
+	, connectionThread(NULL)
 	, lx200(NULL)
 	, long_format_used(false)
 	, answers_received(false)
@@ -97,6 +99,16 @@ TelescopeClientDirectLx200::TelescopeClientDirectLx200 (const QString &name, con
 	queue_get_position = true;
 	next_pos_time = -0x8000000000000000LL;
 	answers_received = false;
+	
+	// log_file is the stream of the slot of this client during its creation
+	connectionThread = new DirectConnectionThread(*this, log_file);
+	connectionThread->start();
+}
+
+TelescopeClientDirectLx200::~TelescopeClientDirectLx200(void)
+{
+	// The connection thread must not step a Server being destroyed
+	delete connectionThread;
 }
 
 //! queues a GOTO command
@@ -122,7 +134,7 @@ void TelescopeClientDirectLx200::telescopeGoto(const Vec3d &j2000Pos)
 		unsigned int ra_int = (unsigned int)floor(0.5 + ra*(((unsigned int)0x80000000)/M_PI));
 		int dec_int = (int)floor(0.5 + dec*(((unsigned int)0x80000000)/M_PI));
 
-		gotoReceived(ra_int, dec_int);
+		connectionThread->postGoto(ra_int, dec_int);
 	}
 	/*
 		else
@@ -151,9 +163,26 @@ bool TelescopeClientDirectLx200::prepareCommunication()
 	return true;
 }
 
+//! Takes the positions read by the connection thread.
 void TelescopeClientDirectLx200::performCommunication()
 {
-	step(10000);
+	if (!connectionThread)
+		return;
+	const QList<DirectConnectionThread::RawPosition> positions(connectionThread->takePositions());
+	if (positions.isEmpty())
+		return;
+	// getNow() is on the GetNow() clock corrected by Delta T
+	const qint64 clock_offset = getNow() - GetNow();
+	const StelCore* core = StelApp::getInstance().getCore();
+	foreach (const DirectConnectionThread::RawPosition &p, positions)
+	{
+		Vec3d j2000Position = p.pos;
+		if (equinox == EquinoxJNow)
+			j2000Position = core->equinoxEquToJ2000(p.pos);
+		//Server time is the time of reading, because this class is the server
+		const qint64 micros = (qint64) p.micros;
+		interpolatedPosition.add(j2000Position, micros + clock_offset, micros, p.status);
+	}
 }
 
 void TelescopeClientDirectLx200::communicationResetReceived(void)
@@ -207,43 +236,50 @@ void TelescopeClientDirectLx200::decReceived(unsigned int dec_int)
 	queue_get_position = true;
 }
 
+//! Runs in the connection thread. The position is queried again as soon as
+//! the last one is read, but not more than 10 times per second.
 void TelescopeClientDirectLx200::step(long long int timeout_micros)
 {
+	if (!lx200)
+	{
+		// The serial port has been closed
+		QThread::usleep(timeout_micros);
+		return;
+	}
+	unsigned int goto_ra;
+	int goto_dec;
+	if (connectionThread->takeGoto(goto_ra, goto_dec))
+		gotoReceived(goto_ra, goto_dec);
 	long long int now = GetNow();
 	if (queue_get_position && now >= next_pos_time)
 	{
 		lx200->sendCommand(new Lx200CommandGetRa(*this));
 		lx200->sendCommand(new Lx200CommandGetDec(*this));
 		queue_get_position = false;
-		next_pos_time = now + 500000;// 500000;
+		next_pos_time = now + 100000;
 	}
 	Server::step(timeout_micros);
+	if (!hasConnection(lx200))
+		lx200 = NULL; // deleted by Server::step()
+	connectionThread->setConnected(lx200 && !lx200->isClosed());
 }
 
 bool TelescopeClientDirectLx200::isConnected(void) const
 {
-	return (!lx200->isClosed());//TODO
+	return (connectionThread && connectionThread->isConnected());
 }
 
 bool TelescopeClientDirectLx200::isInitialized(void) const
 {
-	return (!lx200->isClosed());
+	return (connectionThread && connectionThread->isConnected());
 }
 
 //Merged from Connection::sendPosition() and TelescopeTCP::performReading()
+//Runs in the connection thread, the position is converted in performCommunication()
 void TelescopeClientDirectLx200::sendPosition(unsigned int ra_int, int dec_int, int status)
 {
-	//Server time is "now", because this class is the server
-	const qint64 server_micros = (qint64) getNow();
 	const double ra  =  ra_int * (M_PI/(unsigned int)0x80000000);
 	const double dec = dec_int * (M_PI/(unsigned int)0x80000000);
 	const double cdec = cos(dec);
-	Vec3d position(cos(ra)*cdec, sin(ra)*cdec, sin(dec));
-	Vec3d j2000Position = position;
-	if (equinox == EquinoxJNow)
-	{
-		const StelCore* core = StelApp::getInstance().getCore();
-		j2000Position = core->equinoxEquToJ2000(position);
-	}
-	interpolatedPosition.add(j2000Position, getNow(), server_micros, status);
+	connectionThread->postPosition(Vec3d(cos(ra)*cdec, sin(ra)*cdec, sin(dec)), GetNow(), status);
 }
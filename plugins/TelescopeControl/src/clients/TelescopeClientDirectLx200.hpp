@@ -36,19 +36,19 @@
 #include "Server.hpp" //from the telescope server source tree
 #include "TelescopeClient.hpp" //from the plug-in's source tree
 
+class DirectConnectionThread;
 class Lx200Connection;
 
 //! Telescope client that connects directly to a Meade LX200 through a serial port.
 //! This class has been created by merging the code of TelescopeTCP and ServerLx200.
+//! The methods inherited from Server run in a DirectConnectionThread, the
+//! methods inherited from TelescopeClient in the main thread.
 class TelescopeClientDirectLx200 : public TelescopeClient, public Server
 {
 	Q_OBJECT
 public:
 	TelescopeClientDirectLx200(const QString &name, const QString &parameters, Equinox eq = EquinoxJ2000);
-	~TelescopeClientDirectLx200(void)
-	{
-		//hangup();
-	}
+	~TelescopeClientDirectLx200(void);
 	
 	//======================================================================
 	// Methods inherited from TelescopeClient
@@ -89,8 +89,11 @@ private:
 
 	Equinox equinox;
 	
+	//! Runs step(), NULL when the serial port could not be opened.
+	DirectConnectionThread *connectionThread;
+	
 	//======================================================================
-	// Members inherited from ServerLx200
+	// Members inherited from ServerLx200, used in the connection thread
 	Lx200Connection *lx200;
 	bool long_format_used;
 	bool answers_received;
@@ -28,6 +28,7 @@
 
 #include "NexStarConnection.hpp"
 #include "NexStarCommand.hpp"
+#include "DirectConnectionThread.hpp"
 #include "LogFile.hpp"
 #include "StelCore.hpp"
 
@@ -38,6 +39,7 @@ TelescopeClientDirectNexStar::TelescopeClientDirectNexStar(const QString &name,
 	: TelescopeClient(name)
 	, time_delay(0)
 	, equinox(eq)
+	, connectionThread(NULL)
 	, nexstar(NULL)
 	, last_ra(0)
 	, queue_get_position(true)
@@ -93,6 +95,16 @@ TelescopeClientDirectNexStar::TelescopeClientDirectNexStar(const QString &name,
 	last_ra = 0;
 	queue_get_position = true;
 	next_pos_time = -0x8000000000000000LL;
+	
+	// log_file is the stream of the slot of this client during its creation
+	connectionThread = new DirectConnectionThread(*this, log_file);
+	connectionThread->start();
+}
+
+TelescopeClientDirectNexStar::~TelescopeClientDirectNexStar(void)
+{
+	// The connection thread must not step a Server being destroyed
+	delete connectionThread;
 }
 
 //! queues a GOTO command
@@ -118,7 +130,7 @@ void TelescopeClientDirectNexStar::telescopeGoto(const Vec3d &j2000Pos)
 		unsigned int ra_int = (unsigned int)floor(0.5 + ra*(((unsigned int)0x80000000)/M_PI));
 		int dec_int = (int)floor(0.5 + dec*(((unsigned int)0x80000000)/M_PI));
 
-		gotoReceived(ra_int, dec_int);
+		connectionThread->postGoto(ra_int, dec_int);
 	}
 	/*
 		else
@@ -147,9 +159,26 @@ bool TelescopeClientDirectNexStar::prepareCommunication()
 	return true;
 }
 
+//! Takes the positions read by the connection thread.
 void TelescopeClientDirectNexStar::performCommunication()
 {
-	step(10000);
+	if (!connectionThread)
+		return;
+	const QList<DirectConnectionThread::RawPosition> positions(connectionThread->takePositions());
+	if (positions.isEmpty())
+		return;
+	// getNow() is on the GetNow() clock corrected by Delta T
+	const qint64 clock_offset = getNow() - GetNow();
+	const StelCore* core = StelApp::getInstance().getCore();
+	foreach (const DirectConnectionThread::RawPosition &p, positions)
+	{
+		Vec3d j2000Position = p.pos;
+		if (equinox == EquinoxJNow)
+			j2000Position = core->equinoxEquToJ2000(p.pos);
+		//Server time is the time of reading, because this class is the server
+		const qint64 micros = (qint64) p.micros;
+		interpolatedPosition.add(j2000Position, micros + clock_offset, micros, p.status);
+	}
 }
 
 void TelescopeClientDirectNexStar::communicationResetReceived(void)
@@ -183,42 +212,49 @@ void TelescopeClientDirectNexStar::decReceived(unsigned int dec_int)
 	queue_get_position = true;
 }
 
+//! Runs in the connection thread. The position is queried again as soon as
+//! the last one is read, but not more than 10 times per second.
 void TelescopeClientDirectNexStar::step(long long int timeout_micros)
 {
+	if (!nexstar)
+	{
+		// The serial port has been closed
+		QThread::usleep(timeout_micros);
+		return;
+	}
+	unsigned int goto_ra;
+	int goto_dec;
+	if (connectionThread->takeGoto(goto_ra, goto_dec))
+		gotoReceived(goto_ra, goto_dec);
 	long long int now = GetNow();
 	if (queue_get_position && now >= next_pos_time)
 	{
 		nexstar->sendCommand(new NexStarCommandGetRaDec(*this));
 		queue_get_position = false;
-		next_pos_time = now + 500000;
+		next_pos_time = now + 100000;
 	}
 	Server::step(timeout_micros);
+	if (!hasConnection(nexstar))
+		nexstar = NULL; // deleted by Server::step()
+	connectionThread->setConnected(nexstar && !nexstar->isClosed());
 }
 
 bool TelescopeClientDirectNexStar::isConnected(void) const
 {
-	return (!nexstar->isClosed());//TODO
+	return (connectionThread && connectionThread->isConnected());
 }
 
 bool TelescopeClientDirectNexStar::isInitialized(void) const
 {
-	return (!nexstar->isClosed());
+	return (connectionThread && connectionThread->isConnected());
 }
 
 //Merged from Connection::sendPosition() and TelescopeTCP::performReading()
+//Runs in the connection thread, the position is converted in performCommunication()
 void TelescopeClientDirectNexStar::sendPosition(unsigned int ra_int, int dec_int, int status)
 {
-	//Server time is "now", because this class is the server
-	const qint64 server_micros = (qint64) GetNow();
 	const double ra  =  ra_int * (M_PI/(unsigned int)0x80000000);
 	const double dec = dec_int * (M_PI/(unsigned int)0x80000000);
 	const double cdec = cos(dec);
-	Vec3d position(cos(ra)*cdec, sin(ra)*cdec, sin(dec));
-	Vec3d j2000Position = position;
-	if (equinox == EquinoxJNow)
-	{
-		const StelCore* core = StelApp::getInstance().getCore();
-		j2000Position = core->equinoxEquToJ2000(position);
-	}
-	interpolatedPosition.add(j2000Position, getNow(), server_micros, status);
+	connectionThread->postPosition(Vec3d(cos(ra)*cdec, sin(ra)*cdec, sin(dec)), GetNow(), status);
 }
@@ -37,19 +37,19 @@
 #include "TelescopeClient.hpp" //from the plug-in's source tree
 #include "InterpolatedPosition.hpp"
 
+class DirectConnectionThread;
 class NexStarConnection;
 
 //! Telescope client that connects directly to a Celestron NexStar through a serial port.
 //! This class has been created by merging the code of TelescopeTCP and ServerNexStar.
+//! The methods inherited from Server run in a DirectConnectionThread, the
+//! methods inherited from TelescopeClient in the main thread.
 class TelescopeClientDirectNexStar : public TelescopeClient, public Server
 {
 	Q_OBJECT
 public:
 	TelescopeClientDirectNexStar(const QString &name, const QString &parameters, Equinox eq = EquinoxJ2000);
-	~TelescopeClientDirectNexStar(void)
-	{
-		//hangup();
-	}
+	~TelescopeClientDirectNexStar(void);
 	
 	//======================================================================
 	// Methods inherited from TelescopeClient
@@ -89,8 +89,11 @@ private:
 
 	Equinox equinox;
 	
+	//! Runs step(), NULL when the serial port could not be opened.
+	DirectConnectionThread *connectionThread;
+	
 	//======================================================================
-	// Members taken from ServerNexStar
+	// Members taken from ServerNexStar, used in the connection thread
 	NexStarConnection *nexstar;
 	
 	unsigned int last_ra;
@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
 #include "Connection.hpp"
 #include "Server.hpp"
 #include "LogFile.hpp"
+#include "SocketPoller.hpp"
 
 using namespace std;
 
@@ -96,30 +97,31 @@ Connection::Connection(Server &server, SOCKET fd) : Socket(server, fd)
 	server_minus_client_time = 0x7FFFFFFFFFFFFFFFLL;
 }
 
-void Connection::prepareSelectFds(fd_set &read_fds,
-                                  fd_set &write_fds,
-                                  int &fd_max)
+void Connection::prepareEvents(SocketPoller &poller)
 {
+	// The messages composed during the step are sent in one write,
+	// most of the time the socket accepts them at once
+	if (!IS_INVALID_SOCKET(fd) && write_buff_end > write_buff)
+		performWriting();
+	int events = 0;
 	if (!IS_INVALID_SOCKET(fd))
 	{
-		if (fd_max < (int)fd)
-			fd_max = (int)fd;
+		events = SocketPoller::Readable;
 		if (write_buff_end > write_buff)
-			FD_SET(fd, &write_fds);
-		FD_SET(fd, &read_fds);
+			events |= SocketPoller::Writable;
 	}
+	poller.watch(this, fd, events);
 }
 
-void Connection::handleSelectFds(const fd_set &read_fds,
-                                 const fd_set &write_fds)
+void Connection::handleEvents(int events)
 {
 	if (!IS_INVALID_SOCKET(fd))
 	{
-		if (FD_ISSET(fd, const_cast<fd_set *>(&write_fds)))
+		if (events & SocketPoller::Writable)
 		{
 			performWriting();
 		}
-		if (!IS_INVALID_SOCKET(fd) && FD_ISSET(fd, const_cast<fd_set *>(&read_fds)))
+		if (!IS_INVALID_SOCKET(fd) && (events & SocketPoller::Readable))
 		{
 			performReading();
 		}
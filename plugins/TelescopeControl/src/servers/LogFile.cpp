@@ -20,6 +20,7 @@
 #include "LogFile.hpp"
 
 #include <QTextStream>
+#include <QThreadStorage>
 
 QTextStream &operator<<(QTextStream &o, const Now &now)
 {
@@ -39,4 +40,21 @@ QTextStream &operator<<(QTextStream &o, const Now &now)
 	return o;
 }
 
-QTextStream * log_file = NULL;
+static QTextStream *shared_log_file = NULL;
+// QThreadStorage deletes the pointer it holds, not the stream
+static QThreadStorage<QTextStream**> thread_log_files;
+
+QTextStream *&threadLogFile(void)
+{
+	if (thread_log_files.hasLocalData())
+		return *thread_log_files.localData();
+	return shared_log_file;
+}
+
+void setThreadLogFile(QTextStream *stream)
+{
+	if (thread_log_files.hasLocalData())
+		*thread_log_files.localData() = stream;
+	else
+		thread_log_files.setLocalData(new QTextStream*(stream));
+}
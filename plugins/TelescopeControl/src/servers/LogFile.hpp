@@ -38,6 +38,13 @@ public:
 
 QTextStream &operator<<(QTextStream &o, const Now &now);
 
-extern QTextStream *log_file;
+//! Get the log stream of the calling thread. The threads which called
+//! setThreadLogFile() have their own, the other ones share the stream
+//! selected by TelescopeControl::logAtSlot().
+QTextStream *&threadLogFile(void);
+//! Give the calling thread its own log stream.
+void setThreadLogFile(QTextStream *stream);
+
+#define log_file threadLogFile()
 
 #endif
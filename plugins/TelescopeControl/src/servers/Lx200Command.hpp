@@ -44,6 +44,10 @@ public:
 	virtual void print(QTextStream &o) const = 0;
 	virtual bool isCommandGotoSelected(void) const {return false;}
 	virtual bool shortAnswerReceived(void) const {return false;}
+	//! Tells whether the command can be written before the answer of the
+	//! previous one is read. Only the queries with an answer terminated by
+	//! '#' can, the answers of the other commands are not always complete.
+	virtual bool canBePipelined(void) const {return false;}
 	//returns true when reading is finished
 	
 protected:
@@ -138,6 +142,7 @@ public:
 	bool writeCommandToBuffer(char *&buff, char *end);
 	int readAnswerFromBuffer(const char *&buff, const char *end);
 	void print(QTextStream &o) const;
+	bool canBePipelined(void) const {return true;}
 };
 
 //! Meade LX200 command: Get the current declination.
@@ -148,6 +153,7 @@ public:
 	bool writeCommandToBuffer(char *&buff, char *end);
 	int readAnswerFromBuffer(const char *&buff, const char *end);
 	void print(QTextStream &o) const;
+	bool canBePipelined(void) const {return true;}
 };
 
 #endif //_LX200_COMMAND_HPP_
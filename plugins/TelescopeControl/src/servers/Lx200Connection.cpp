@@ -38,6 +38,8 @@ Lx200Connection::Lx200Connection(Server &server, const char *serial_device) : Se
 	next_send_time = GetNow();
 	read_timeout_endtime = 0x7FFFFFFFFFFFFFFFLL;
 	goto_commands_queued = 0;
+	// enough for the right ascension and the declination
+	max_commands_in_flight = 2;
 }
 
 //! Resets the connection.
@@ -222,15 +224,19 @@ void Lx200Connection::dataReceived(const char *&p, const char *read_buff_end)
 			delete command_list.front();
 			command_list.pop_front();
 			read_timeout_endtime = 0x7FFFFFFFFFFFFFFFLL;
+			if (!command_list.empty() && command_list.front()->hasBeenWrittenToBuffer())
+			{
+				// pipelined, the answer may already be in the buffer
+				read_timeout_endtime = GetNow() + 5000000;
+				continue;
+			}
 			if (!writeFrontCommandToBuffer())
 				break;
 		}
 	}
 }
 
-void Lx200Connection::prepareSelectFds(fd_set &read_fds,
-                                       fd_set &write_fds,
-                                       int &fd_max)
+void Lx200Connection::prepareEvents(SocketPoller &poller)
 {
 	// if some telegram is delayed try to queue it now:
 	flushCommandList();
@@ -241,7 +247,7 @@ void Lx200Connection::prepareSelectFds(fd_set &read_fds,
 			// the lazy telescope, propably AutoStar 494
 			// has not sent the full answer
 			#ifdef DEBUG4
-			*log_file << Now() << "Lx200Connection::prepareSelectFds: "
+			*log_file << Now() << "Lx200Connection::prepareEvents: "
 			                      "dequeueing command("
 			                   << *command_list.front()
 			                   << ") because of timeout"
@@ -260,7 +266,7 @@ void Lx200Connection::prepareSelectFds(fd_set &read_fds,
 			resetCommunication();
 		}
 	}
-	SerialPort::prepareSelectFds(read_fds, write_fds, fd_max);
+	SerialPort::prepareEvents(poller);
 }
 
 void Lx200Connection::flushCommandList(void)
@@ -297,6 +303,39 @@ void Lx200Connection::flushCommandList(void)
 				break;
 			}
 		}
+		pipelineCommands();
+	}
+}
+
+void Lx200Connection::pipelineCommands(void)
+{
+	int in_flight = 0;
+	for (list<Lx200Command*>::const_iterator it(command_list.begin());
+	     it != command_list.end();
+	     it++)
+	{
+		if ((*it)->hasBeenWrittenToBuffer())
+		{
+			if (!(*it)->canBePipelined())
+				return;
+			in_flight++;
+			continue;
+		}
+		// the front command is written by writeFrontCommandToBuffer()
+		if (in_flight == 0 || in_flight >= max_commands_in_flight)
+			return;
+		if (!(*it)->canBePipelined() || GetNow() < next_send_time)
+			return;
+		if (!(*it)->writeCommandToBuffer(write_buff_end, write_buff+sizeof(write_buff)))
+			return;
+		#ifdef DEBUG4
+		*log_file << Now()
+		          << "Lx200Connection::pipelineCommands("
+		          << (**it)
+		          << "): queued"
+		          << endl;
+		#endif
+		in_flight++;
 	}
 }
 
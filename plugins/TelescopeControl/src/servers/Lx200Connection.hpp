@@ -50,13 +50,17 @@ private:
 	//! Not implemented, as this is not a connection to a client.
 	void sendPosition(unsigned int ra_int, int dec_int, int status) {Q_UNUSED(ra_int); Q_UNUSED(dec_int); Q_UNUSED(status);}
 	void resetCommunication(void);
-	void prepareSelectFds(fd_set &read_fds, fd_set &write_fds, int &fd_max);
+	void prepareEvents(SocketPoller &poller);
 	bool writeFrontCommandToBuffer(void);
 	//! Flushes the command queue, sending commands to the write buffer.
 	//! This method iterates over the queue, writing to the write buffer
 	//! as many commands as possible, until it reaches a command that
 	//! requires an answer.
 	void flushCommandList(void);
+	//! Writes the commands which can be pipelined behind the ones waiting
+	//! for their answer, so that the telescope answers them without waiting
+	//! for a round trip of the serial line between them.
+	void pipelineCommands(void);
 	
 private:
 	list<Lx200Command*> command_list;
@@ -64,6 +68,8 @@ private:
 	long long int next_send_time;
 	long long int read_timeout_endtime;
 	int goto_commands_queued;
+	//! The maximum number of commands written and not yet answered.
+	int max_commands_in_flight;
 };
 
 #endif //_LX200_CONNECTION_HPP_
@@ -189,16 +189,15 @@ int SerialPort::writeNonblocking(const char *buf, int count)
 
 #endif
 
-void SerialPort::prepareSelectFds(fd_set &read_fds,
-                                  fd_set &write_fds,
-                                  int &fd_max)
+void SerialPort::prepareEvents(SocketPoller &poller)
 {
 #ifdef Q_OS_WIN32
 	// handle all IO here
+	Q_UNUSED(poller);
 	if (write_buff_end > write_buff)
 		performWriting();
 	performReading();
 #else
-	Connection::prepareSelectFds(read_fds, write_fds, fd_max);
+	Connection::prepareEvents(poller);
 #endif //Q_OS_WIN32
 }
@@ -54,34 +54,29 @@ void Server::sendPosition(unsigned int ra_int, int dec_int, int status)
 
 void Server::step(long long int timeout_micros)
 {
-	fd_set read_fds, write_fds;
-	FD_ZERO(&read_fds);
-	FD_ZERO(&write_fds);
-	int fd_max = -1;
-	
 	for (SocketList::const_iterator it(socket_list.begin());
 	     it != socket_list.end();
 	     it++)
 	{
-		(*it)->prepareSelectFds(read_fds, write_fds, fd_max);
+		(*it)->prepareEvents(poller);
 	}
 	
-	struct timeval tv;
-	if (timeout_micros < 0)
-		timeout_micros = 0;
-	tv.tv_sec = timeout_micros / 1000000;
-	tv.tv_usec = timeout_micros % 1000000;
-	const int select_rc = select(fd_max+1, &read_fds, &write_fds, 0, &tv);
-	if (select_rc > 0)
+	const int nb_ready = poller.wait(timeout_micros);
+	if (nb_ready > 0)
 	{
+		// Only the connections with events are handled
+		for (int i = 0; i < nb_ready; i++)
+		{
+			poller.getReadySocket(i)->handleEvents(poller.getReadyEvents(i));
+		}
 		SocketList::iterator it(socket_list.begin());
 		while (it != socket_list.end())
 		{
-			(*it)->handleSelectFds(read_fds, write_fds);
 			if ((*it)->isClosed())
 			{
 				SocketList::iterator tmp(it);
 				it++;
+				poller.forget(*tmp);
 				delete (*tmp);
 				socket_list.erase(tmp);
 			}
@@ -93,6 +88,18 @@ void Server::step(long long int timeout_micros)
 	}
 }
 
+bool Server::hasConnection(const Socket *s) const
+{
+	for (SocketList::const_iterator it(socket_list.begin());
+	     it != socket_list.end();
+	     it++)
+	{
+		if (*it == s)
+			return true;
+	}
+	return false;
+}
+
 void Server::closeAcceptedConnections(void)
 {
 	for (SocketList::iterator it(socket_list.begin());
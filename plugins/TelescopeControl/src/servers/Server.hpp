@@ -25,6 +25,8 @@ Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
 #ifndef _SERVER_HPP_
 #define _SERVER_HPP_
 
+#include "SocketPoller.hpp"
+
 #include <list>
 using namespace std;
 
@@ -40,8 +42,9 @@ class Socket;
 //! Classes that inherit Server (such as ServerLx200) also have a special
 //! device-specific connection object (such as Lx200Connection) that represents
 //! a serial connection to the device. The step() method calls
-//! Socket::prepareSelectFds() and Socket::handleSelectFds() for each connection
-//! in the list. These methods are reimplemented for each class.
+//! Socket::prepareEvents() for each connection in the list, waits for the events
+//! with a SocketPoller and calls Socket::handleEvents() for the connections
+//! which have some. These methods are reimplemented for each class.
 class Server
 {
 public:
@@ -63,6 +66,9 @@ protected:
 			socket_list.push_back(s);
 	}
 	void closeAcceptedConnections(void);
+	//! Tells whether a connection is still in the list. The closed
+	//! connections are deleted by step().
+	bool hasConnection(const Socket *s) const;
 	friend class Listener;
 	
 private:
@@ -78,6 +84,8 @@ private:
 	};
 	//! A list of the connections maintained by the server.
 	SocketList socket_list;
+	//! Waits for the events of the connections.
+	SocketPoller poller;
 };
 
 #endif
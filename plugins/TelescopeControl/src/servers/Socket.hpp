@@ -73,14 +73,18 @@ static inline int SetNonblocking(int s)
 long long int GetNow(void);
 
 class Server;
+class SocketPoller;
 
 class Socket
 {
 public:
 	virtual ~Socket() { hangup(); }
 	void hangup();
-	virtual void prepareSelectFds(fd_set &read_fds, fd_set &write_fds, int &fd_max) = 0;
-	virtual void handleSelectFds(const fd_set &read_fds, const fd_set &write_fds) = 0;
+	//! Do the work needed before waiting, and declare to the poller the events to wait for.
+	virtual void prepareEvents(SocketPoller &poller) = 0;
+	//! Handle the events reported by the poller.
+	//! @param events a combination of SocketPoller::Readable and SocketPoller::Writable.
+	virtual void handleEvents(int events) = 0;
 	virtual bool isClosed() const
 	{
 		return IS_INVALID_SOCKET(fd);
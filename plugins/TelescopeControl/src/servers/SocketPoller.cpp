@@ -0,0 +1,234 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "SocketPoller.hpp"
+#include "LogFile.hpp"
+
+#if defined(Q_OS_LINUX)
+  #define USE_EPOLL
+  #include <sys/epoll.h>
+#elif defined(Q_OS_MAC) || defined(Q_OS_FREEBSD) || defined(Q_OS_OPENBSD) || defined(Q_OS_NETBSD)
+  #define USE_KQUEUE
+  #include <sys/types.h>
+  #include <sys/event.h>
+  #include <sys/time.h>
+#elif !defined(Q_OS_WIN32)
+  #include <sys/select.h>
+#endif
+
+SocketPoller::SocketPoller(void) : poll_fd(-1)
+{
+#if defined(USE_EPOLL)
+	poll_fd = epoll_create(16);
+#elif defined(USE_KQUEUE)
+	poll_fd = kqueue();
+#endif
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	if (poll_fd < 0)
+	{
+		*log_file << Now() << "SocketPoller::SocketPoller: can't create the event queue: "
+		                   << STRERROR(ERRNO) << endl;
+	}
+#endif
+}
+
+SocketPoller::~SocketPoller(void)
+{
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+	if (poll_fd >= 0)
+		::close(poll_fd);
+#endif
+}
+
+void SocketPoller::watch(Socket *socket, SOCKET fd, int events)
+{
+	Entry new_entry;
+	new_entry.fd = fd;
+	new_entry.events = IS_INVALID_SOCKET(fd) ? 0 : events;
+
+	map<Socket*, Entry>::iterator it(entries.find(socket));
+	if (it == entries.end())
+	{
+		if (new_entry.events == 0)
+			return;
+		Entry old_entry;
+		old_entry.fd = INVALID_SOCKET;
+		old_entry.events = 0;
+		update(socket, old_entry, new_entry);
+		entries[socket] = new_entry;
+	}
+	else if (it->second.fd != new_entry.fd || it->second.events != new_entry.events)
+	{
+		update(socket, it->second, new_entry);
+		if (new_entry.events == 0)
+			entries.erase(it);
+		else
+			it->second = new_entry;
+	}
+}
+
+void SocketPoller::forget(Socket *socket)
+{
+	map<Socket*, Entry>::iterator it(entries.find(socket));
+	if (it != entries.end())
+	{
+		Entry new_entry;
+		new_entry.fd = INVALID_SOCKET;
+		new_entry.events = 0;
+		update(socket, it->second, new_entry);
+		entries.erase(it);
+	}
+}
+
+void SocketPoller::update(Socket *socket, const Entry &old_entry, const Entry &new_entry)
+{
+#if defined(USE_EPOLL)
+	// Closing a descriptor removes it from the set, so the errors of the removals are ignored
+	const bool same_fd = (old_entry.fd == new_entry.fd);
+	if (old_entry.events != 0 && (!same_fd || new_entry.events == 0))
+		epoll_ctl(poll_fd, EPOLL_CTL_DEL, old_entry.fd, 0);
+	if (new_entry.events != 0)
+	{
+		struct epoll_event ev;
+		ev.events = ((new_entry.events & Readable) ? EPOLLIN : 0)
+		          | ((new_entry.events & Writable) ? EPOLLOUT : 0);
+		ev.data.ptr = socket;
+		const int op = (same_fd && old_entry.events != 0) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		if (epoll_ctl(poll_fd, op, new_entry.fd, &ev) < 0)
+		{
+			*log_file << Now() << "SocketPoller::update: epoll_ctl failed: "
+			                   << STRERROR(ERRNO) << endl;
+		}
+	}
+#elif defined(USE_KQUEUE)
+	struct kevent changes[4];
+	int nb_changes = 0;
+	const bool same_fd = (old_entry.fd == new_entry.fd);
+	const int filters[2] = {EVFILT_READ, EVFILT_WRITE};
+	const int flags[2] = {Readable, Writable};
+	for (int i = 0; i < 2; i++)
+	{
+		const bool had = (old_entry.events & flags[i]) != 0;
+		const bool has = (new_entry.events & flags[i]) != 0;
+		if (had && (!same_fd || !has))
+		{
+			EV_SET(&changes[nb_changes], old_entry.fd, filters[i], EV_DELETE, 0, 0, 0);
+			nb_changes++;
+		}
+		if (has && (!same_fd || !had))
+		{
+			EV_SET(&changes[nb_changes], new_entry.fd, filters[i], EV_ADD, 0, 0, socket);
+			nb_changes++;
+		}
+	}
+	// Apply the changes one by one, so that the removal of a closed descriptor
+	// does not prevent the other changes
+	for (int i = 0; i < nb_changes; i++)
+		kevent(poll_fd, &changes[i], 1, 0, 0, 0);
+#else
+	Q_UNUSED(socket);
+	Q_UNUSED(old_entry);
+	Q_UNUSED(new_entry);
+#endif
+}
+
+void SocketPoller::addReady(Socket *socket, int events)
+{
+	for (vector<pair<Socket*, int> >::iterator it(ready.begin()); it != ready.end(); it++)
+	{
+		if (it->first == socket)
+		{
+			it->second |= events;
+			return;
+		}
+	}
+	ready.push_back(make_pair(socket, events));
+}
+
+int SocketPoller::wait(long long int timeout_micros)
+{
+	ready.clear();
+	if (timeout_micros < 0)
+		timeout_micros = 0;
+
+#if defined(USE_EPOLL)
+	struct epoll_event events[64];
+	const int timeout_ms = (int)((timeout_micros + 999) / 1000);
+	const int rc = epoll_wait(poll_fd, events, 64, timeout_ms);
+	if (rc < 0)
+		return (ERRNO == EINTR) ? 0 : -1;
+	for (int i = 0; i < rc; i++)
+	{
+		// Errors and hangups are reported as readable, the reading then finds them
+		int ev = 0;
+		if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			ev |= Readable;
+		if (events[i].events & EPOLLOUT)
+			ev |= Writable;
+		ready.push_back(make_pair(static_cast<Socket*>(events[i].data.ptr), ev));
+	}
+#elif defined(USE_KQUEUE)
+	struct kevent events[64];
+	struct timespec ts;
+	ts.tv_sec = timeout_micros / 1000000;
+	ts.tv_nsec = (timeout_micros % 1000000) * 1000;
+	const int rc = kevent(poll_fd, 0, 0, events, 64, &ts);
+	if (rc < 0)
+		return (ERRNO == EINTR) ? 0 : -1;
+	for (int i = 0; i < rc; i++)
+	{
+		addReady(static_cast<Socket*>(events[i].udata),
+		         (events[i].filter == EVFILT_WRITE) ? Writable : Readable);
+	}
+#else
+	fd_set read_fds, write_fds;
+	FD_ZERO(&read_fds);
+	FD_ZERO(&write_fds);
+	int fd_max = -1;
+	for (map<Socket*, Entry>::const_iterator it(entries.begin()); it != entries.end(); it++)
+	{
+		if (fd_max < (int)it->second.fd)
+			fd_max = (int)it->second.fd;
+		if (it->second.events & Readable)
+			FD_SET(it->second.fd, &read_fds);
+		if (it->second.events & Writable)
+			FD_SET(it->second.fd, &write_fds);
+	}
+	struct timeval tv;
+	tv.tv_sec = timeout_micros / 1000000;
+	tv.tv_usec = timeout_micros % 1000000;
+	const int rc = select(fd_max+1, &read_fds, &write_fds, 0, &tv);
+	if (rc < 0)
+		return (ERRNO == EINTR) ? 0 : -1;
+	if (rc > 0)
+	{
+		for (map<Socket*, Entry>::const_iterator it(entries.begin()); it != entries.end(); it++)
+		{
+			int ev = 0;
+			if (FD_ISSET(it->second.fd, &read_fds))
+				ev |= Readable;
+			if (FD_ISSET(it->second.fd, &write_fds))
+				ev |= Writable;
+			if (ev)
+				ready.push_back(make_pair(it->first, ev));
+		}
+	}
+#endif
+	return (int)ready.size();
+}
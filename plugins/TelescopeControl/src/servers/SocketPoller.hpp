@@ -0,0 +1,84 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _SOCKET_POLLER_HPP_
+#define _SOCKET_POLLER_HPP_
+
+#include "Socket.hpp"
+
+#include <map>
+#include <vector>
+using namespace std;
+
+//! Wait for I/O events on the sockets or serial ports of a Server.
+//! The interest of each Socket is declared with watch() before each wait, and
+//! only the changes are passed to the system, so the cost of a step depends on the
+//! number of sockets with events rather than on the number of sockets.
+//! The backend is epoll on Linux, kqueue on Mac OS X and the BSDs, and select()
+//! on the other systems. On Windows, the serial ports do their overlapped I/O in
+//! Socket::prepareEvents() and never need to be watched.
+class SocketPoller
+{
+public:
+	enum Events
+	{
+		Readable = 1,
+		Writable = 2
+	};
+
+	SocketPoller(void);
+	~SocketPoller(void);
+
+	//! Declare the events a socket waits for.
+	//! @param socket the socket, given back by getReadySocket().
+	//! @param fd the descriptor of the socket. An invalid one stops the watching.
+	//! @param events a combination of Readable and Writable, 0 to stop the watching.
+	void watch(Socket *socket, SOCKET fd, int events);
+	//! Stop watching a socket, to be called before it is deleted.
+	void forget(Socket *socket);
+
+	//! Wait for events on the watched sockets.
+	//! @return the number of sockets with events, 0 on timeout, -1 on error.
+	int wait(long long int timeout_micros);
+	//! Get the sockets with events after wait(), for @p i from 0 to the returned count.
+	Socket *getReadySocket(int i) const {return ready[i].first;}
+	int getReadyEvents(int i) const {return ready[i].second;}
+
+private:
+	struct Entry
+	{
+		SOCKET fd;
+		int events;
+	};
+	//! Pass the change of interest of a socket to the system.
+	void update(Socket *socket, const Entry &old_entry, const Entry &new_entry);
+	//! Merge the events of a socket reported separately by kqueue.
+	void addReady(Socket *socket, int events);
+
+	map<Socket*, Entry> entries;
+	vector<pair<Socket*, int> > ready;
+	//! The epoll or kqueue descriptor, unused with select().
+	int poll_fd;
+
+	// no copying
+	SocketPoller(const SocketPoller&);
+	const SocketPoller &operator=(const SocketPoller&);
+};
+
+#endif //_SOCKET_POLLER_HPP_
@@ -72,7 +72,19 @@ void CLIProcessor::parseCLIArgsPreConfig(const QStringList& argList)
 		          << "--projection-type       : Specify projection type, e.g. stereographic\n"
 		          << "--restore-defaults      : Delete existing config.ini and use defaults\n"
 		          << "--multires-image        : With filename / URL argument, specify a\n"
-		          << "                          multi-resolution image to load\n";
+		          << "                          multi-resolution image to load\n"
+		          << "--benchmark             : Draw the number of frames passed as parameter\n"
+		          << "                          after the startup script, report the frame\n"
+		          << "                          times and exit\n"
+		          << "--benchmark-output      : Specify a JSON file for the benchmark report\n"
+		          << "--benchmark-max-frame-time : Exit with an error if the 99th percentile\n"
+		          << "                          of the benchmark frame time is over this\n"
+		          << "                          value (milliseconds)\n"
+		          << "--capture-session       : Record the session in the file passed as\n"
+		          << "                          parameter, to replay it later\n"
+		          << "--replay-session        : Replay the session recorded in the file passed\n"
+		          << "                          as parameter with the benchmark options, and\n"
+		          << "                          exit\n";
 		exit(0);
 	}
 
@@ -118,6 +130,10 @@ void CLIProcessor::parseCLIArgsPostConfig(const QStringList& argList, QSettings*
 	float fov;
 	QString landscapeId, homePlanet, longitude, latitude, skyDate, skyTime;
 	QString projectionType, screenshotDir, multiresImage, startupScript;
+	int benchmarkFrames;
+	QString benchmarkOutput;
+	double benchmarkMaxFrameTime;
+	QString captureSession, replaySession;
 	try
 	{
 		fullScreen = argsGetYesNoOption(argList, "-f", "--full-screen", -1);
@@ -133,6 +149,11 @@ void CLIProcessor::parseCLIArgsPostConfig(const QStringList& argList, QSettings*
 		screenshotDir = argsGetOptionWithArg(argList, "", "--screenshot-dir", "").toString();
 		multiresImage = argsGetOptionWithArg(argList, "", "--multires-image", "").toString();
 		startupScript = argsGetOptionWithArg(argList, "", "--startup-script", "").toString();
+		benchmarkFrames = argsGetOptionWithArg(argList, "", "--benchmark", -1).toInt();
+		benchmarkOutput = argsGetOptionWithArg(argList, "", "--benchmark-output", "").toString();
+		benchmarkMaxFrameTime = argsGetOptionWithArg(argList, "", "--benchmark-max-frame-time", 0.).toDouble();
+		captureSession = argsGetOptionWithArg(argList, "", "--capture-session", "").toString();
+		replaySession = argsGetOptionWithArg(argList, "", "--replay-session", "").toString();
 	}
 	catch (std::runtime_error& e)
 	{
@@ -214,6 +235,18 @@ void CLIProcessor::parseCLIArgsPostConfig(const QStringList& argList, QSettings*
 		qApp->setProperty("onetime_startup_script", startupScript);
 	}
 
+	if (benchmarkFrames>0 || !replaySession.isEmpty())
+	{
+		qApp->setProperty("benchmark_frames", benchmarkFrames);
+		qApp->setProperty("benchmark_output", benchmarkOutput);
+		qApp->setProperty("benchmark_max_frame_time", benchmarkMaxFrameTime);
+	}
+
+	if (!replaySession.isEmpty())
+		qApp->setProperty("session_replay_file", replaySession);
+	else if (!captureSession.isEmpty())
+		qApp->setProperty("session_capture_file", captureSession);
+
 	if (fov>0.0) confSettings->setValue("navigation/init_fov", fov);
 	if (!projectionType.isEmpty()) confSettings->setValue("projection/type", projectionType);
 	if (!screenshotDir.isEmpty())
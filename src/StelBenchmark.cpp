@@ -0,0 +1,176 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelBenchmark.hpp"
+#include "StelApp.hpp"
+#include "StelFrameProfiler.hpp"
+#include "StelJsonParser.hpp"
+#include "StelOpenGL.hpp"
+#include "StelSessionRecorder.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGLWidget>
+#include <QOpenGLFramebufferObject>
+#include <QPair>
+
+#include <algorithm>
+
+StelBenchmark::StelBenchmark(QGLWidget* aglWidget, int anbFrames, const QString& areplayFile, const QString& aoutputFile, double amaxFrameTime, QObject* parent)
+	: QObject(parent)
+	, glWidget(aglWidget)
+	, nbFrames(qMax(anbFrames, 1))
+	, replayFile(areplayFile)
+	, outputFile(aoutputFile)
+	, maxFrameTime(amaxFrameTime)
+{
+}
+
+void StelBenchmark::run()
+{
+	// Time step of the updates, as for a display running at 60 fps
+	static const double timeStep = 1./60.;
+	// Frames drawn before the measures, to load the textures and fill the caches
+	static const int nbWarmupFrames = 10;
+
+	StelApp& app = StelApp::getInstance();
+	glWidget->makeCurrent();
+	const QSize size = glWidget->size()*app.getDevicePixelsPerPixel();
+	QOpenGLFramebufferObject fbo(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+	// A replayed session starts from its first frame, the warmup frames would change its state
+	StelSessionRecorder* session = NULL;
+	if (!replayFile.isEmpty())
+	{
+		session = app.getSessionRecorder();
+		if (!session->startReplay(replayFile))
+		{
+			app.quit(1);
+			return;
+		}
+		nbFrames = qMax(session->getNbReplayFrames(), 1);
+	}
+	const int nbSkippedFrames = session ? 0 : nbWarmupFrames;
+
+	StelFrameProfiler* profiler = app.getFrameProfiler();
+	profiler->setEnabled(false);
+	profiler->setNbFrames(nbFrames);
+
+	qDebug() << "Running the benchmark on" << nbFrames << "frames of" << size.width() << "x" << size.height() << "pixels";
+	QVector<double> frameTimes, captureTimes;
+	frameTimes.reserve(nbFrames);
+	QElapsedTimer frameTimer, totalTimer;
+	for (int i=0; i<nbSkippedFrames+nbFrames; ++i)
+	{
+		if (i==nbSkippedFrames)
+		{
+			profiler->setEnabled(true);
+			totalTimer.start();
+		}
+		frameTimer.start();
+		double deltaTime = timeStep;
+		if (session)
+		{
+			double captureTime;
+			if (!session->replayFrame(&deltaTime, &captureTime))
+				break;
+			captureTimes << captureTime;
+		}
+		fbo.bind();
+		app.update(deltaTime);
+		app.draw();
+		// Wait for the GPU, so that the frame time includes the rendering
+		glFinish();
+		fbo.release();
+		if (i>=nbSkippedFrames)
+			frameTimes << frameTimer.nsecsElapsed()/1e6;
+	}
+	const QVariantMap report = makeReport(frameTimes, captureTimes, totalTimer.nsecsElapsed()/1e9);
+
+	qDebug() << "Benchmark results:"
+	         << qPrintable(QString("%1 fps, frame time p50 %2 ms, p99 %3 ms, max %4 ms")
+	                       .arg(report.value("fps").toDouble(), 0, 'f', 1)
+	                       .arg(report.value("frameTimeP50").toDouble(), 0, 'f', 2)
+	                       .arg(report.value("frameTimeP99").toDouble(), 0, 'f', 2)
+	                       .arg(report.value("frameTimeMax").toDouble(), 0, 'f', 2));
+
+	if (!outputFile.isEmpty())
+	{
+		QFile file(outputFile);
+		if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			StelJsonParser::write(report, &file);
+			file.close();
+			qDebug() << "Benchmark report written to" << QDir::toNativeSeparators(outputFile);
+		}
+		else
+			qWarning() << "ERROR: cannot write the benchmark report to" << QDir::toNativeSeparators(outputFile);
+	}
+
+	int exitCode = 0;
+	if (maxFrameTime>0. && report.value("frameTimeP99").toDouble()>maxFrameTime)
+	{
+		qWarning() << "The 99th percentile of the frame time is over" << maxFrameTime << "ms";
+		exitCode = 1;
+	}
+	app.quit(exitCode);
+}
+
+QVariantMap StelBenchmark::makeReport(const QVector<double>& frameTimes, const QVector<double>& captureTimes, double totalTime) const
+{
+	QVector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	const int n = sorted.size();
+	double sum = 0.;
+	foreach (double t, sorted)
+		sum += t;
+
+	QVariantMap report;
+	report["frames"] = n;
+	report["totalTime"] = totalTime;
+	report["fps"] = totalTime>0. ? n/totalTime : 0.;
+	report["frameTimeMean"] = n>0 ? sum/n : 0.;
+	report["frameTimeP50"] = n>0 ? sorted.at(qMin(n-1, n/2)) : 0.;
+	report["frameTimeP99"] = n>0 ? sorted.at(qMin(n-1, (int)(n*0.99))) : 0.;
+	report["frameTimeMax"] = n>0 ? sorted.last() : 0.;
+	report["modules"] = StelApp::getInstance().getFrameProfiler()->toVariantMap();
+
+	if (!captureTimes.isEmpty())
+	{
+		// The slowest frames of the replay, with the time at which they were captured
+		static const int nbSlowestFrames = 10;
+		QVector<QPair<double, int> > frames;
+		for (int i=0; i<frameTimes.size(); ++i)
+			frames << qMakePair(frameTimes.at(i), i);
+		std::sort(frames.begin(), frames.end());
+		QVariantList slowest;
+		for (int i=frames.size()-1; i>=0 && i>=frames.size()-nbSlowestFrames; --i)
+		{
+			QVariantMap frame;
+			frame["frame"] = frames.at(i).second;
+			frame["frameTime"] = frames.at(i).first;
+			frame["captureTime"] = captureTimes.at(frames.at(i).second);
+			slowest << frame;
+		}
+		report["slowestFrames"] = slowest;
+	}
+	return report;
+}
@@ -0,0 +1,69 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELBENCHMARK_HPP_
+#define _STELBENCHMARK_HPP_
+
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+class QGLWidget;
+
+//! @class StelBenchmark
+//! Render a fixed number of frames as fast as possible and report the frame times.
+//! The scene is set up by the startup script (see the --startup-script option), which
+//! is run before the benchmark starts. The frames are then updated with a fixed time
+//! step, so that the time rate and the movements started by the script are replayed
+//! identically at each run, and drawn in an offscreen framebuffer.
+//! The report contains the frame rate, the median and 99th percentile of the frame
+//! time and the timings of each module measured by the StelFrameProfiler.
+//! When a session captured by the StelSessionRecorder is replayed, its frames are drawn
+//! with their recorded time steps and events instead, and the report also lists the
+//! slowest frames with the time at which they were captured, to locate the stutters.
+class StelBenchmark : public QObject
+{
+	Q_OBJECT
+public:
+	//! @param glWidget the widget owning the GL context to use.
+	//! @param nbFrames the number of frames to measure.
+	//! @param replayFile the session to replay, if not empty. All its frames are measured.
+	//! @param outputFile the JSON file in which the report is written, if not empty.
+	//! @param maxFrameTime the maximum 99th percentile of the frame time in ms, 0 for no limit.
+	StelBenchmark(QGLWidget* glWidget, int nbFrames, const QString& replayFile, const QString& outputFile, double maxFrameTime, QObject* parent=NULL);
+
+public slots:
+	//! Run the benchmark and quit the application. The exit code is 1 if the 99th
+	//! percentile of the frame time is over the maximum frame time.
+	void run();
+
+private:
+	//! Compute the report from the measured frame times.
+	//! @param captureTimes the times of the replayed frames in the captured session, or empty.
+	QVariantMap makeReport(const QVector<double>& frameTimes, const QVector<double>& captureTimes, double totalTime) const;
+
+	QGLWidget* glWidget;
+	int nbFrames;
+	QString replayFile;
+	QString outputFile;
+	double maxFrameTime;
+};
+
+#endif // _STELBENCHMARK_HPP_
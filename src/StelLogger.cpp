@@ -21,7 +21,11 @@
 #include "StelUtils.hpp"
 
 #include <QDateTime>
+#include <QMutex>
 #include <QProcess>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
 #ifdef Q_OS_WIN
  #include <windows.h>
 #endif
@@ -29,13 +33,135 @@
 // Init statics variables.
 QFile StelLogger::logFile;
 QString StelLogger::log;
+// The modules can log from worker threads, e.g. while they are preloaded
+static QMutex logMutex;
+// Serialize the writes to the log file between the writer thread and flush()
+static QMutex fileMutex;
+static QWaitCondition logCondition;
+
+// Ring buffer of the messages waiting for the writer thread. When it is full the new
+// messages are dropped, and their number is written once there is room again.
+static const int logQueueSize = 4096;
+static QVector<QString> logQueue(logQueueSize);
+static int logQueueHead = 0;
+static int logQueueCount = 0;
+static int logDropped = 0;
+static bool logWriterStop = false;
+
+// Consecutive identical messages are written only once
+static QString lastMessage;
+static int lastMessageRepeats = 0;
+
+// Take the queued messages, logMutex must be locked.
+static void takeLogQueue(QStringList& batch)
+{
+	batch.clear();
+	for (int i=0; i<logQueueCount; ++i)
+	{
+		QString& msg = logQueue[(logQueueHead+i)%logQueueSize];
+		batch << msg;
+		msg.clear();
+	}
+	logQueueHead = (logQueueHead+logQueueCount)%logQueueSize;
+	logQueueCount = 0;
+	if (logDropped>0)
+	{
+		batch << QString("[%1 log messages dropped]\n").arg(logDropped);
+		logDropped = 0;
+	}
+}
+
+// Add a message to the ring buffer, logMutex must be locked.
+static void pushLogQueue(const QString& msg)
+{
+	if (logQueueCount==logQueueSize)
+	{
+		++logDropped;
+		return;
+	}
+	logQueue[(logQueueHead+logQueueCount)%logQueueSize] = msg;
+	++logQueueCount;
+}
+
+// The open log file, written by the writer thread or directly before it is started
+static QFile* logOutput = NULL;
+
+// Write a batch of messages, fileMutex must be locked.
+static void writeLogBatch(const QStringList& batch)
+{
+	if (batch.isEmpty() || !logOutput)
+		return;
+	const QByteArray data = batch.join(QString()).toLocal8Bit();
+	logOutput->write(data.constData(), data.size());
+}
+
+static void emitLog(const QString& msg);
+
+// Log the number of repetitions of the last message, logMutex must be locked.
+static void pushLogRepeats()
+{
+	if (lastMessageRepeats>0)
+		emitLog(QString("[last message repeated %1 times]\n").arg(lastMessageRepeats));
+	lastMessageRepeats = 0;
+}
+
+//! @class StelLogWriter
+//! Thread writing the queued messages to the log file.
+class StelLogWriter : public QThread
+{
+protected:
+	virtual void run()
+	{
+		QStringList batch;
+		forever
+		{
+			logMutex.lock();
+			while (logQueueCount==0 && logDropped==0 && !logWriterStop)
+				logCondition.wait(&logMutex);
+			if (logQueueCount==0 && logDropped==0)
+			{
+				logMutex.unlock();
+				return;
+			}
+			takeLogQueue(batch);
+			// Lock the file before releasing the queue to keep the order with flush()
+			fileMutex.lock();
+			logMutex.unlock();
+			writeLogBatch(batch);
+			fileMutex.unlock();
+		}
+	}
+};
+
+static StelLogWriter* logWriter = NULL;
+
+// Queue a message, or write it directly when there is no writer thread, logMutex must be locked.
+static void emitLog(const QString& msg)
+{
+	if (logWriter)
+	{
+		pushLogQueue(msg);
+		logCondition.wakeOne();
+	}
+	else
+	{
+		QMutexLocker fileLock(&fileMutex);
+		writeLogBatch(QStringList(msg));
+	}
+}
 
 void StelLogger::init(const QString& logFilePath)
 {
 	logFile.setFileName(logFilePath);
 
 	if (logFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text | QIODevice::Unbuffered))
+	{
+		logOutput = &logFile;
+		logWriterStop = false;
+		logWriter = new StelLogWriter();
+		logWriter->start(QThread::LowPriority);
 		qInstallMessageHandler(StelLogger::debugLogHandler);
+	}
 
 	// write timestamp
 	writeLog(QString("%1").arg(QDateTime::currentDateTime().toString(Qt::ISODate)));
@@ -250,20 +376,73 @@ void StelLogger::init(const QString& logFilePath)
 void StelLogger::deinit()
 {
 	qInstallMessageHandler(0);
+	if (logWriter)
+	{
+		logMutex.lock();
+		pushLogRepeats();
+		logWriterStop = true;
+		logCondition.wakeOne();
+		logMutex.unlock();
+		logWriter->wait();
+		logMutex.lock();
+		StelLogWriter* writer = logWriter;
+		logWriter = NULL;
+		logMutex.unlock();
+		delete writer;
+	}
+	flush();
+	logOutput = NULL;
 	logFile.close();
 }
 
-void StelLogger::debugLogHandler(QtMsgType, const QMessageLogContext&, const QString& msg)
+void StelLogger::flush()
 {
-	fprintf(stderr, "%s\n", msg.toUtf8().constData());
-	writeLog(QString(msg));
+	QStringList batch;
+	logMutex.lock();
+	pushLogRepeats();
+	takeLogQueue(batch);
+	fileMutex.lock();
+	logMutex.unlock();
+	writeLogBatch(batch);
+	fileMutex.unlock();
+}
+
+void StelLogger::debugLogHandler(QtMsgType type, const QMessageLogContext&, const QString& msg)
+{
+	if (queueLog(msg + "\n"))
+		fprintf(stderr, "%s\n", msg.toUtf8().constData());
+	// Qt aborts after a fatal message, write everything before
+	if (type==QtFatalMsg)
+		flush();
 }
 
 void StelLogger::writeLog(QString msg)
 {
 	msg += "\n";
-	logFile.write(qPrintable(msg), msg.size());
+	queueLog(msg);
+}
+
+bool StelLogger::queueLog(const QString& msg)
+{
+	QMutexLocker lock(&logMutex);
+	if (msg==lastMessage)
+	{
+		++lastMessageRepeats;
+		return false;
+	}
+	pushLogRepeats();
+	lastMessage = msg;
 	log += msg;
+	emitLog(msg);
+	return true;
+}
+
+void writeLogBatch(const QStringList& batch)
+{
+	if (batch.isEmpty() || !logFile.isOpen())
+		return;
+	const QByteArray data = batch.join(QString()).toLocal8Bit();
+	logFile.write(data.constData(), data.size());
 }
 
 QString StelLogger::getMsvcVersionString(int ver)
@@ -29,6 +29,10 @@
 //! Class wit only static members used to manage logging for Stellarium.
 //! The debugLogHandler() method allow to defined it as a standard Qt messages handler
 //! which is then used by qDebug, qWarning and qFatal.
+//! The messages are queued and written to the log file by a writer thread, so that bursts
+//! of warnings don't stall the drawing on slow disks. Consecutive identical messages are
+//! written once, followed by the number of repetitions. The queue is flushed synchronously
+//! before a fatal message, and by deinit().
 class StelLogger
 {
 public:
@@ -38,8 +42,12 @@ public:
 
 	//! Deinitialize the log file.
 	//! Must be called after init() was called.
+	//! Write the pending messages and stop the writer thread.
 	static void deinit();
 
+	//! Write the pending messages to the log file in the calling thread.
+	static void flush();
+
 	//! Handler for qDebug() and friends. Writes message to log file at $USERDIR/log.txt and echoes to stderr.
 	static void debugLogHandler(QtMsgType, const QMessageLogContext&, const QString& str);
 
@@ -55,6 +63,10 @@ public:
 	static void writeLog(QString msg);
 
 private:
+	//! Queue a message for the writer thread, thread safe.
+	//! @return false if the message repeats the previous one and was not queued.
+	static bool queueLog(const QString& msg);
+
 	static QFile logFile;
 	static QString log;
 	
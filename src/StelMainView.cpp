@@ -18,6 +18,7 @@
  */
 
 #include "StelMainView.hpp"
+#include "StelBenchmark.hpp"
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 #include "StelFileMgr.hpp"
@@ -29,15 +30,19 @@
 #include "StelUtils.hpp"
 #include "StelActionMgr.hpp"
 #include "StelOpenGL.hpp"
+#include "StelFrameRecorder.hpp"
 
 #include <QDeclarativeItem>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QGLWidget>
 #include <QGuiApplication>
 #include <QFileInfo>
 #include <QIcon>
 #include <QMoveEvent>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
 #include <QPluginLoader>
 #include <QScreen>
 #include <QSettings>
@@ -46,9 +51,18 @@
 #include <QTimer>
 #include <QWidget>
 #include <QWindow>
+#include <QtConcurrent>
 #include <QDeclarativeContext>
 
 #include <clocale>
+#include <cmath>
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+// Maximum time spent rendering recorded frames before showing the last one in the window
+static const int MaxRecordingBatchMs = 100;
 
 // Initialize static variables
 StelMainView* StelMainView::singleton = NULL;
@@ -105,15 +119,29 @@ void StelSkyItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *optio
 	Q_UNUSED(option);
 	Q_UNUSED(widget);
 
-	const double now = StelApp::getTotalRunTime();
-	double dt = now - previousPaintTime;
-	previousPaintTime = now;
-
 	painter->beginNativePainting();
 	glClearColor(0, 0, 0, 1);
 	glClear(GL_COLOR_BUFFER_BIT);
-	StelApp::getInstance().update(dt);
-	StelApp::getInstance().draw();
+	// When the last frame was too slow for the head-mounted display, present
+	// it again for the new head pose and skip the update of this frame.
+	if (!StelApp::getInstance().drawReprojectedFrame())
+	{
+		const double now = StelApp::getTotalRunTime();
+		double dt = now - previousPaintTime;
+		previousPaintTime = now;
+
+		StelApp::getInstance().update(dt);
+		StelApp::getInstance().draw();
+
+		// When recording, render several frames per refresh of the window, only the last one is shown
+		QElapsedTimer batchTimer;
+		batchTimer.start();
+		while (StelApp::getInstance().getFrameRecorder()->hasPendingFrames() && batchTimer.elapsed()<MaxRecordingBatchMs)
+		{
+			StelApp::getInstance().update(0.);
+			StelApp::getInstance().draw();
+		}
+	}
 
 	painter->endNativePainting();
 }
@@ -226,11 +254,14 @@ protected:
 };
 
 StelMainView::StelMainView(QWidget* parent)
-	: QDeclarativeView(parent), gui(NULL),
+	: QDeclarativeView(parent), gui(NULL), stelApp(NULL),
 	  flagInvertScreenShotColors(false),
 	  screenShotPrefix("stellarium-"),
 	  screenShotDir(""),
-	  cursorTimeout(-1.f), flagCursorTimeout(false), minFpsTimer(NULL), maxfps(10000.f)
+	  screenShotBufferIndex(0),
+	  screenShotPixelBufferSupported(-1),
+	  cursorTimeout(-1.f), flagCursorTimeout(false), frameTimer(NULL), frameStartTime(0.),
+	  frameCostIndex(0), predictedFrameCost(0.), flagFrameBudgetExceeded(false), refreshPeriod(0.), maxfps(10000.f)
 {
 	StelApp::initStatic();
 	
@@ -251,6 +282,8 @@ StelMainView::StelMainView(QWidget* parent)
 	connect(this, SIGNAL(screenshotRequested()), this, SLOT(doScreenshot()));
 
 	lastEventTimeSec = 0;
+	for (int i=0;i<NbFrameCostSamples;++i)
+		frameCosts[i] = 0.;
 
 	// Create an openGL viewport
 	QGLFormat glFormat(QGL::StencilBuffer | QGL::DepthBuffer | QGL::DoubleBuffer);
@@ -343,13 +376,34 @@ void StelMainView::init(QSettings* conf)
 	setCursorTimeout(conf->value("gui/mouse_cursor_timeout", 10.f).toFloat());
 	maxfps = conf->value("video/maximum_fps",10000.f).toFloat();
 	minfps = conf->value("video/minimum_fps",10000.f).toFloat();
-	flagMaxFpsUpdatePending = false;
+
+	// When the buffer swaps wait for the vertical retrace, a frame can only be shown every
+	// swapInterval refreshes, so the frames are scheduled on this period.
+	const int swapInterval = glWidget->format().swapInterval();
+	const double refreshRate = glWidget->windowHandle()->screen()->refreshRate();
+	if (swapInterval>0 && refreshRate>0.)
+		refreshPeriod = swapInterval/refreshRate;
+	qDebug() << "Swap interval:" << swapInterval << "display refresh rate:" << refreshRate;
 
 	// XXX: This should be done in StelApp::init(), unfortunately for the moment we need init the gui before the
 	// plugins, because the gui create the QActions needed by some plugins.
 	StelApp::getInstance().initPlugIns();
 
 	QThread::currentThread()->setPriority(QThread::HighestPriority);
+
+	if (qApp->property("benchmark_frames").isValid())
+	{
+		// The benchmark drives the updates and draws itself. The queued call makes it
+		// start once the event loop runs, after the startup script.
+		StelBenchmark* benchmark = new StelBenchmark(glWidget,
+		                                             qApp->property("benchmark_frames").toInt(),
+		                                             qApp->property("session_replay_file").toString(),
+		                                             qApp->property("benchmark_output").toString(),
+		                                             qApp->property("benchmark_max_frame_time").toDouble(),
+		                                             this);
+		QMetaObject::invokeMethod(benchmark, "run", Qt::QueuedConnection);
+		return;
+	}
 	startMainLoop();
 }
 
@@ -429,50 +483,27 @@ void StelMainView::updateScene() {
 	// To fix this we manually do it here.
 	skyItem->update();
 	scene()->update();
+	// The paint normally schedules the next frame, but keep the loop running if it doesn't happen,
+	// e.g. when the window is hidden.
+	if (frameTimer!=NULL)
+		frameTimer->start((int)(1./getMinFps()*1000.));
 }
 
 void StelMainView::thereWasAnEvent()
 {
 	lastEventTimeSec = StelApp::getTotalRunTime();
-}
-
-void StelMainView::maxFpsSceneUpdate()
-{
-	updateScene();
-	flagMaxFpsUpdatePending = false;
+	// Draw the animations started by the event, as long as the maximum frame rate is kept
+	if (stelApp)
+		stelApp->markFrameDirty(2.5);
+	// Don't wait for the end of the low frame rate period to react to the event
+	if (frameTimer!=NULL && frameTimer->isActive())
+		scheduleNextFrame();
 }
 
 void StelMainView::drawBackground(QPainter*, const QRectF&)
 {
 	const double now = StelApp::getTotalRunTime();
-	const double JD_SECOND=0.000011574074074074074074;
-
-	// Determines when the next display will need to be triggered
-	// The current policy is that after an event, the FPS is maximum for 2.5 seconds
-	// after that, it switches back to the default minfps value to save power.
-	// The fps is also kept to max if the timerate is higher than normal speed.
-	const float timeRate = StelApp::getInstance().getCore()->getTimeRate();
-	const bool needMaxFps = (now - lastEventTimeSec < 2.5) || fabs(timeRate) > JD_SECOND;
-	if (needMaxFps)
-	{
-		if (!flagMaxFpsUpdatePending)
-		{
-			double duration = 1./getMaxFps();
-			int dur = (int)(duration*1000);
-
-			if (minFpsTimer!=NULL)
-			{
-				disconnect(minFpsTimer, SIGNAL(timeout()), 0, 0);
-				delete minFpsTimer;
-				minFpsTimer = NULL;
-			}
-			flagMaxFpsUpdatePending = true;
-			QTimer::singleShot(dur<5 ? 5 : dur, this, SLOT(maxFpsSceneUpdate()));
-		}
-	} else if (minFpsTimer == NULL) {
-		// Restart the minfps timer
-		minFpsChanged();
-	}
+	frameStartTime = now;
 
 	// Manage cursor timeout
 	if (cursorTimeout>0.f && (now-lastEventTimeSec>cursorTimeout) && flagCursorTimeout)
@@ -487,25 +518,86 @@ void StelMainView::drawBackground(QPainter*, const QRectF&)
 	}
 }
 
-void StelMainView::startMainLoop()
+void StelMainView::drawForeground(QPainter* painter, const QRectF&)
 {
-	// Set a timer refreshing for every minfps frames
-	minFpsChanged();
-}
+	bool screenShotPending = !requestedScreenShots.isEmpty();
+	for (int i=0; i<NbScreenShotBuffers; ++i)
+		screenShotPending |= !screenShotBuffers[i].filePath.isEmpty();
+	if (screenShotPending)
+	{
+		painter->beginNativePainting();
+		readBackScreenShots();
+		painter->endNativePainting();
+	}
 
-void StelMainView::minFpsChanged()
-{
-	if (minFpsTimer!=NULL)
+	// Predict the duration of the next frames from the longest of the last ones,
+	// so that a single slow frame is enough to start the next ones earlier.
+	frameCosts[frameCostIndex] = StelApp::getTotalRunTime() - frameStartTime;
+	frameCostIndex = (frameCostIndex+1) % NbFrameCostSamples;
+	predictedFrameCost = 0.;
+	for (int i=0;i<NbFrameCostSamples;++i)
+		predictedFrameCost = qMax(predictedFrameCost, frameCosts[i]);
+
+	const double budget = getTargetFramePeriod();
+	const bool exceeded = predictedFrameCost > budget;
+	if (exceeded != flagFrameBudgetExceeded)
 	{
-		disconnect(minFpsTimer, SIGNAL(timeout()), 0, 0);
-		delete minFpsTimer;
-		minFpsTimer = NULL;
+		flagFrameBudgetExceeded = exceeded;
+		emit frameBudgetExceeded(exceeded, predictedFrameCost, budget);
 	}
 
-	minFpsTimer = new QTimer(this);
-	connect(minFpsTimer, SIGNAL(timeout()), this, SLOT(updateScene()));
+	if (frameTimer!=NULL)
+		scheduleNextFrame();
+}
+
+double StelMainView::getTargetFramePeriod() const
+{
+	const double JD_SECOND=0.000011574074074074074074;
+
+	// The frames being recorded are rendered as fast as possible
+	if (StelApp::getInstance().getFrameRecorder()->isRecording())
+		return 0.;
+
+	// The current policy is that after an event, the FPS is maximum for 2.5 seconds
+	// after that, it switches back to the default minfps value to save power.
+	// The fps is also kept to max if the timerate is higher than normal speed.
+	const double now = StelApp::getTotalRunTime();
+	const float timeRate = StelApp::getInstance().getCore()->getTimeRate();
+	const bool needMaxFps = (now - lastEventTimeSec < 2.5) || fabs(timeRate) > JD_SECOND;
+	double period = 1./(needMaxFps ? getMaxFps() : getMinFps());
+
+	// Frames can't be shown more often than the display refreshes, and a period between
+	// two refreshes would make the frames alternate between two durations.
+	if (refreshPeriod>0.)
+		period = qMax(1., std::ceil(period/refreshPeriod - 0.01)) * refreshPeriod;
+	return period;
+}
+
+void StelMainView::scheduleNextFrame()
+{
+	// Start the next frame as late as possible while still finishing it by the end of the period,
+	// so that it shows the most recent state. The margin absorbs the timer inaccuracy.
+	const double margin = 0.002;
+	const double now = StelApp::getTotalRunTime();
+	const double start = frameStartTime + getTargetFramePeriod() - predictedFrameCost - margin;
+	const int delay = (int)((start-now)*1000.);
+	frameTimer->start(delay<1 ? 1 : delay);
+}
+
+void StelMainView::startMainLoop()
+{
+	frameTimer = new QTimer(this);
+	frameTimer->setSingleShot(true);
+	frameTimer->setTimerType(Qt::PreciseTimer);
+	connect(frameTimer, SIGNAL(timeout()), this, SLOT(updateScene()));
+	frameTimer->start(0);
+}
 
-	minFpsTimer->start((int)(1./getMinFps()*1000.));
+void StelMainView::minFpsChanged()
+{
+	// Apply the new frame rate from the last frame rather than waiting for the end of the longer period
+	if (frameTimer!=NULL)
+		scheduleNextFrame();
 }
 
 
@@ -571,6 +663,14 @@ void StelMainView::keyReleaseEvent(QKeyEvent* event)
 //! Delete openGL textures (to call before the GLContext disappears)
 void StelMainView::deinitGL()
 {
+	for (int i=0; i<NbScreenShotBuffers; ++i)
+	{
+		collectScreenShot(screenShotBuffers[i]);
+		delete screenShotBuffers[i].buffer;
+		screenShotBuffers[i].buffer = NULL;
+	}
+	foreach (QFuture<bool> future, screenShotWrites)
+		future.waitForFinished();
 	StelApp::getInstance().deinit();
 	delete gui;
 	gui = NULL;
@@ -586,10 +686,6 @@ void StelMainView::saveScreenShot(const QString& filePrefix, const QString& save
 void StelMainView::doScreenshot(void)
 {
 	QFileInfo shotDir;
-	QImage im = glWidget->grabFrameBuffer();
-	if (flagInvertScreenShotColors)
-		im.invertPixels();
-
 	if (screenShotDir == "")
 		shotDir = QFileInfo(StelFileMgr::getScreenshotDir());
 	else
@@ -606,16 +702,144 @@ void StelMainView::doScreenshot(void)
 		return;
 	}
 
+	// Forget the files already written
+	for (int i=screenShotWrites.size()-1; i>=0; --i)
+	{
+		if (screenShotWrites.at(i).isFinished())
+		{
+			screenShotWrites.removeAt(i);
+			screenShotWriteFiles.removeAt(i);
+		}
+	}
+
 	QFileInfo shotPath;
 	for (int j=0; j<100000; ++j)
 	{
 		shotPath = QFileInfo(shotDir.filePath() + "/" + screenShotPrefix + QString("%1").arg(j, 3, 10, QLatin1Char('0')) + ".png");
-		if (!shotPath.exists())
+		if (!shotPath.exists() && !isScreenShotPending(shotPath.filePath()))
 			break;
 	}
 
-	qDebug() << "INFO Saving screenshot in file: " << QDir::toNativeSeparators(shotPath.filePath());
-	if (!im.save(shotPath.filePath())) {
-		qWarning() << "WARNING failed to write screenshot to: " << QDir::toNativeSeparators(shotPath.filePath());
+	// The frame is read back at the end of the next paint and written in the background
+	ScreenShot shot;
+	shot.filePath = shotPath.filePath();
+	shot.invert = flagInvertScreenShotColors;
+	requestedScreenShots.append(shot);
+	updateScene();
+}
+
+bool StelMainView::isScreenShotPending(const QString& filePath) const
+{
+	if (screenShotWriteFiles.contains(filePath))
+		return true;
+	foreach (const ScreenShot& shot, requestedScreenShots)
+	{
+		if (shot.filePath==filePath)
+			return true;
+	}
+	for (int i=0; i<NbScreenShotBuffers; ++i)
+	{
+		if (screenShotBuffers[i].filePath==filePath)
+			return true;
+	}
+	return false;
+}
+
+void StelMainView::readBackScreenShots()
+{
+	// The transfers issued in the previous frames are complete by now
+	for (int i=0; i<NbScreenShotBuffers; ++i)
+		collectScreenShot(screenShotBuffers[i]);
+
+	if (requestedScreenShots.isEmpty())
+		return;
+
+	if (screenShotPixelBufferSupported<0)
+	{
+		const QSurfaceFormat format = QOpenGLContext::currentContext()->format();
+		screenShotPixelBufferSupported = format.renderableType()!=QSurfaceFormat::OpenGLES &&
+			(format.majorVersion()>2 || (format.majorVersion()==2 && format.minorVersion()>=1) ||
+			 QOpenGLContext::currentContext()->hasExtension("GL_ARB_pixel_buffer_object"));
+	}
+
+	const qreal ratio = glWidget->windowHandle() ? glWidget->windowHandle()->devicePixelRatio() : 1.;
+	const QSize size = glWidget->size() * ratio;
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	foreach (ScreenShot shot, requestedScreenShots)
+	{
+		shot.size = size;
+		if (!screenShotPixelBufferSupported)
+		{
+			// Without pixel buffers, only the encoding is done in the background
+			QImage im(size, QImage::Format_ARGB32);
+			glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, im.bits());
+			screenShotWrites.append(QtConcurrent::run(writeScreenShot, im, shot.filePath, shot.invert, true));
+			screenShotWriteFiles.append(shot.filePath);
+			continue;
+		}
+
+		ScreenShot& slot = screenShotBuffers[screenShotBufferIndex];
+		screenShotBufferIndex = (screenShotBufferIndex+1) % NbScreenShotBuffers;
+		collectScreenShot(slot);
+		if (slot.buffer==NULL)
+		{
+			slot.buffer = new QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer);
+			slot.buffer->setUsagePattern(QOpenGLBuffer::StreamRead);
+			slot.buffer->create();
+		}
+		slot.buffer->bind();
+		slot.buffer->allocate(size.width()*size.height()*4);
+		// With a pixel pack buffer bound, glReadPixels() only queues the transfer and returns
+		glReadPixels(0, 0, size.width(), size.height(), GL_BGRA, GL_UNSIGNED_BYTE, 0);
+		slot.buffer->release();
+		slot.size = size;
+		slot.filePath = shot.filePath;
+		slot.invert = shot.invert;
+	}
+	requestedScreenShots.clear();
+
+	// Collect the pixels in the next frame rather than waiting for the minimal frame rate
+	QMetaObject::invokeMethod(this, "updateScene", Qt::QueuedConnection);
+}
+
+void StelMainView::collectScreenShot(ScreenShot& shot)
+{
+	if (shot.buffer==NULL || shot.filePath.isEmpty())
+		return;
+
+	QImage im(shot.size, QImage::Format_ARGB32);
+	shot.buffer->bind();
+	const uchar* pixels = static_cast<const uchar*>(shot.buffer->map(QOpenGLBuffer::ReadOnly));
+	if (pixels!=NULL)
+	{
+		memcpy(im.bits(), pixels, im.byteCount());
+		shot.buffer->unmap();
+	}
+	shot.buffer->release();
+
+	if (pixels==NULL)
+		qWarning() << "WARNING failed to read back screenshot: " << QDir::toNativeSeparators(shot.filePath);
+	else
+	{
+		screenShotWrites.append(QtConcurrent::run(writeScreenShot, im, shot.filePath, shot.invert, false));
+		screenShotWriteFiles.append(shot.filePath);
+	}
+	shot.filePath.clear();
+}
+
+bool StelMainView::writeScreenShot(QImage image, QString filePath, bool invert, bool swapRedBlue)
+{
+	// The rows of the OpenGL framebuffer go from the bottom to the top
+	image = image.mirrored(false, true);
+	if (swapRedBlue)
+		image = image.rgbSwapped();
+	if (invert)
+		image.invertPixels();
+
+	qDebug() << "INFO Saving screenshot in file: " << QDir::toNativeSeparators(filePath);
+	if (!image.save(filePath)) {
+		qWarning() << "WARNING failed to write screenshot to: " << QDir::toNativeSeparators(filePath);
+		return false;
 	}
+	return true;
 }
@@ -25,10 +25,14 @@
 #include <QDeclarativeView>
 #include <QCoreApplication>
 #include <QEventLoop>
+#include <QFuture>
+#include <QImage>
+#include <QStringList>
 
 class QDeclarativeItem;
 class QGLWidget;
 class QMoveEvent;
+class QOpenGLBuffer;
 class QResizeEvent;
 class StelGuiBase;
 class StelQGLWidget;
@@ -108,7 +112,11 @@ public slots:
 	//! Get the current maximum frames per second.
 	float getMaxFps() {return maxfps;}
 
-	void maxFpsSceneUpdate();
+	//! Get the duration of the next frames predicted from the last frames, in seconds.
+	double getPredictedFrameCost() const {return predictedFrameCost;}
+	//! Get whether the predicted frame duration is longer than the frame period currently targeted.
+	bool isFrameBudgetExceeded() const {return flagFrameBudgetExceeded;}
+
 	//! Updates the scene and process all events
 	void updateScene();
 
@@ -129,6 +137,9 @@ protected:
 	//! Update the mouse pointer state and schedule next redraw.
 	//! This method is called automatically by Qt.
 	virtual void drawBackground(QPainter* painter, const QRectF &rect);
+	//! Measure the duration of the frame and schedule the next one.
+	//! This method is called automatically by Qt after all the items were painted.
+	virtual void drawForeground(QPainter* painter, const QRectF &rect);
 
 signals:
 	//! emitted when saveScreenShot is requested with saveScreenShot().
@@ -136,6 +147,14 @@ signals:
 	//! thread, where as saveScreenShot() might get called from another one.
 	void screenshotRequested(void);
 
+	//! Emitted when the predicted frame duration becomes longer than the frame period targeted,
+	//! and again when it becomes short enough. Modules can connect to it to lower their quality
+	//! (e.g. the number of star levels or the atmosphere resolution) while the budget is exceeded.
+	//! @param exceeded true if the frames take longer than the targeted period.
+	//! @param predictedCost the predicted frame duration in seconds.
+	//! @param budget the targeted frame period in seconds.
+	void frameBudgetExceeded(bool exceeded, double predictedCost, double budget);
+
 private slots:
 	// Do the actual screenshot generation in the main thread with this method.
 	void doScreenshot(void);
@@ -143,6 +162,12 @@ private slots:
 	void minFpsChanged();
 
 private:
+	//! Get the period between two frames to target, in seconds.
+	//! It is a multiple of the display refresh period when the buffer swaps are synchronized with it.
+	double getTargetFramePeriod() const;
+	//! Start the timer triggering the next frame so that it is done when the period is over.
+	void scheduleNextFrame();
+
 	//! Start the display loop
 	void startMainLoop();
 	
@@ -166,14 +191,56 @@ private:
 	QString screenShotPrefix;
 	QString screenShotDir;
 
+	//! A screenshot requested or being read back from the GPU.
+	struct ScreenShot
+	{
+		ScreenShot() : buffer(NULL), invert(false) {}
+		//! Pixel buffer the frame is read in, NULL if not read yet.
+		QOpenGLBuffer* buffer;
+		QSize size;
+		QString filePath;
+		bool invert;
+	};
+	//! Read back the requested screenshots, and give the ones read in the previous frames to the workers.
+	//! Called at the end of the frame, when the back buffer contains the whole picture.
+	void readBackScreenShots();
+	//! Copy the content of a pixel buffer to an image and give it to a worker.
+	void collectScreenShot(ScreenShot& shot);
+	//! Whether a screenshot file is going to be written.
+	bool isScreenShotPending(const QString& filePath) const;
+	//! Write a screenshot file, in a worker thread.
+	static bool writeScreenShot(QImage image, QString filePath, bool invert, bool swapRedBlue);
+
+	//! Screenshots requested since the last frame.
+	QList<ScreenShot> requestedScreenShots;
+	//! Double buffered readback, a frame is mapped one frame after its read was issued.
+	static const int NbScreenShotBuffers = 2;
+	ScreenShot screenShotBuffers[NbScreenShotBuffers];
+	int screenShotBufferIndex;
+	//! Whether pixel buffers can be used, -1 if not known yet.
+	int screenShotPixelBufferSupported;
+	//! The files being written by the worker threads.
+	QList<QFuture<bool> > screenShotWrites;
+	QStringList screenShotWriteFiles;
+
 	// Number of second before the mouse cursor disappears
 	float cursorTimeout;
 	bool flagCursorTimeout;
 
 	double lastEventTimeSec;
 
-	QTimer* minFpsTimer;
-	bool flagMaxFpsUpdatePending;
+	//! Single shot timer triggering the update of the next frame.
+	QTimer* frameTimer;
+	//! Time at which the last frame started to be painted, in seconds.
+	double frameStartTime;
+	//! Durations of the last frames in seconds, as a ring buffer.
+	static const int NbFrameCostSamples = 16;
+	double frameCosts[NbFrameCostSamples];
+	int frameCostIndex;
+	double predictedFrameCost;
+	bool flagFrameBudgetExceeded;
+	//! Duration of one display refresh in seconds, or 0 if the buffer swaps are not synchronized with it.
+	double refreshPeriod;
 	//! The minimum desired frame rate in frame per second.
 	float minfps;
 	//! The maximum desired frame rate in frame per second.
@@ -23,6 +23,8 @@
 #include "StelProjector.hpp"
 #include "StelCore.hpp"
 #include "StelUtils.hpp"
+#include "StelTracer.hpp"
+#include "StelJobSystem.hpp"
 
 #include <QDebug>
 #include <QFile>
@@ -30,63 +32,67 @@
 #include <QUrl>
 #include <QDir>
 #include <QBuffer>
-#include <QThread>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QPointer>
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <stdexcept>
 #include <stdio.h>
 
-// #include <QNetworkDiskCache>
-
-// Init statics
-QNetworkAccessManager* MultiLevelJsonBase::networkAccessManager = NULL;
-
 QNetworkAccessManager& MultiLevelJsonBase::getNetworkAccessManager()
 {
-	if (networkAccessManager==NULL)
-	{
-		networkAccessManager = new QNetworkAccessManager(&StelApp::getInstance());
-// Cache on JSON files doesn't work, and I don't know why.
-// There may be a problem in Qt for text objects caching (compression is activated in cache)
-// 		QNetworkDiskCache* cache = new QNetworkDiskCache(networkAccessManager);
-// 		QString cachePath = StelApp::getInstance().getCacheDir();
-// 		cache->setCacheDirectory(cachePath+"/JSONCache");
-// 		networkAccessManager->setCache(cache);
-		connect(networkAccessManager, SIGNAL(finished(QNetworkReply*)), &StelApp::getInstance(), SLOT(reportFileDownloadFinished(QNetworkReply*)));
-	}
-	return *networkAccessManager;
+	// The descriptions share the connections and the cache with the textures of the tiles
+	return *StelApp::getInstance().getNetworkAccessManager();
 }
 
 /*************************************************************************
-  Class used to load a JSON file in a thread
+  Jobs used to load a JSON file in the thread pool
  *************************************************************************/
-class JsonLoadThread : public QThread
+class JsonLoadJob : public StelJob
 {
 	public:
-		JsonLoadThread(MultiLevelJsonBase* atile, QByteArray content, bool aqZcompressed=false, bool agzCompressed=false) : QThread((QObject*)atile),
-			tile(atile), data(content), qZcompressed(aqZcompressed), gzCompressed(agzCompressed){;}
+		JsonLoadJob(MultiLevelJsonBase* atile, QByteArray content, bool aqZcompressed=false, bool agzCompressed=false, const QString& acacheKey=QString()) :
+			tile(atile), data(content), qZcompressed(aqZcompressed), gzCompressed(agzCompressed), cacheKey(acacheKey){;}
 		virtual void run();
 	private:
 		MultiLevelJsonBase* tile;
 		QByteArray data;
 		const bool qZcompressed;
 		const bool gzCompressed;
+		//! If not empty, the key under which the parsed file is saved in the cache.
+		const QString cacheKey;
 };
 
-void JsonLoadThread::run()
+//! Run in the main thread once the file is parsed, unless the tile was deleted meanwhile.
+class JsonLoadFinishedJob : public StelJob
+{
+	public:
+		JsonLoadFinishedJob(MultiLevelJsonBase* atile) : tile(atile) {;}
+		virtual void run() {if (tile) tile->jsonLoadFinished();}
+	private:
+		QPointer<MultiLevelJsonBase> tile;
+};
+
+void JsonLoadJob::run()
 {
 	try
 	{
 		QBuffer buf(&data);
 		buf.open(QIODevice::ReadOnly);
 		tile->temporaryResultMap = MultiLevelJsonBase::loadFromJSON(buf, qZcompressed, gzCompressed);
+		if (!cacheKey.isEmpty())
+			MultiLevelJsonBase::saveToCache(cacheKey, tile->temporaryResultMap);
 	}
 	catch (std::runtime_error e)
 	{
 		qWarning() << "WARNING : Can't parse loaded JSON description: " << e.what();
 		tile->errorOccured = true;
 	}
+	StelApp::getInstance().getJobSystem()->submitToMainThread(new JsonLoadFinishedJob(tile));
 }
 
 MultiLevelJsonBase::MultiLevelJsonBase(MultiLevelJsonBase* parent) : StelSkyLayer(parent)
@@ -94,7 +100,7 @@ MultiLevelJsonBase::MultiLevelJsonBase(MultiLevelJsonBase* parent) : StelSkyLaye
 	errorOccured = false;
 	httpReply = NULL;
 	downloading = false;
-	loadThread = NULL;
+	loadJobs = NULL;
 	loadingState = false;
 	lastPercent = 0;
 	// Avoid tiles to be deleted just after constructed
@@ -133,6 +139,21 @@ void MultiLevelJsonBase::initFromUrl(const QString& url)
 		}
 		QFileInfo finf(fileName);
 		baseUrl = finf.absolutePath()+'/';
+		// The modification date and size of local files play the role of the ETag
+		const QString cacheKey = finf.absoluteFilePath() + '|' + QString::number(finf.lastModified().toMSecsSinceEpoch()) + '|' + QString::number(finf.size());
+		QVariantMap cachedMap;
+		if (loadFromCache(cacheKey, cachedMap))
+		{
+			try
+			{
+				loadFromQVariantMap(cachedMap);
+				return;
+			}
+			catch (std::runtime_error e)
+			{
+				qWarning() << "WARNING : Invalid cached JSON description: " << QDir::toNativeSeparators(fileName) << ": " << e.what();
+			}
+		}
 		QFile f(fileName);
 		if(f.open(QIODevice::ReadOnly))
 		{
@@ -140,7 +161,9 @@ void MultiLevelJsonBase::initFromUrl(const QString& url)
 			const bool gzCompressed = fileName.endsWith(".gz");
 			try
 			{
-				loadFromQVariantMap(loadFromJSON(f, compressed, gzCompressed));
+				const QVariantMap map = loadFromJSON(f, compressed, gzCompressed);
+				saveToCache(cacheKey, map);
+				loadFromQVariantMap(map);
 			}
 			catch (std::runtime_error e)
 			{
@@ -219,16 +242,11 @@ MultiLevelJsonBase::~MultiLevelJsonBase()
 		//httpReply->deleteLater();
 		httpReply = NULL;
 	}
-	if (loadThread && loadThread->isRunning())
+	if (loadJobs)
 	{
-		//qDebug() << "--> Abort thread " << contructorUrl;
-		disconnect(loadThread, SIGNAL(finished()), this, SLOT(jsonLoadFinished()));
-		// The thread is currently running, it needs to be properly stopped
-		if (loadThread->wait(1)==false)
-		{
-			loadThread->terminate();
-			//loadThread->wait(2000);
-		}
+		// The job writes in this tile: drop it if not started yet, else wait for its end
+		delete loadJobs;
+		loadJobs = NULL;
 	}
 	foreach (MultiLevelJsonBase* tile, subTiles)
 	{
@@ -260,6 +278,7 @@ void MultiLevelJsonBase::cancelDeletion()
 // Load the tile information from a JSON file
 QVariantMap MultiLevelJsonBase::loadFromJSON(QIODevice& input, bool qZcompressed, bool gzCompressed)
 {
+	STEL_TRACE_SCOPE("MultiLevelJsonBase::loadFromJSON");
 	StelJsonParser parser;
 	QVariantMap map;
 	if (qZcompressed && input.size()>0)
@@ -288,6 +307,61 @@ QVariantMap MultiLevelJsonBase::loadFromJSON(QIODevice& input, bool qZcompressed
 }
 
 
+// The cache files start with this magic number, followed by a format version
+static const quint32 jsonCacheMagic = 0x534a4331;
+static const quint32 jsonCacheVersion = 1;
+
+static QString getJsonCacheFileName(const QString& key)
+{
+	const QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+	return StelFileMgr::getCacheDir() + "/JSONCache/" + QString::fromLatin1(hash) + ".bin";
+}
+
+bool MultiLevelJsonBase::loadFromCache(const QString& key, QVariantMap& map)
+{
+	QFile file(getJsonCacheFileName(key));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	// Map the file to avoid copying it before deserializing
+	const qint64 size = file.size();
+	uchar* mapped = file.map(0, size);
+	QByteArray data = mapped ? QByteArray::fromRawData((const char*)mapped, size) : file.readAll();
+	QDataStream in(data);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, version;
+	QString storedKey;
+	in >> magic >> version;
+	bool ok = false;
+	if (magic==jsonCacheMagic && version==jsonCacheVersion)
+	{
+		// The key is stored to detect hash collisions
+		in >> storedKey;
+		if (storedKey==key)
+		{
+			in >> map;
+			ok = in.status()==QDataStream::Ok && !map.isEmpty();
+		}
+	}
+	if (mapped)
+		file.unmap(mapped);
+	return ok;
+}
+
+void MultiLevelJsonBase::saveToCache(const QString& key, const QVariantMap& map)
+{
+	const QString fileName = getJsonCacheFileName(key);
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	// Write in a temporary file so that other threads never read a partial file
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << jsonCacheMagic << jsonCacheVersion << key << map;
+	if (out.status()!=QDataStream::Ok || !file.commit())
+		qWarning() << "WARNING : Can't write the JSON cache file: " << QDir::toNativeSeparators(fileName);
+}
+
 // Called when the download for the JSON file terminated
 void MultiLevelJsonBase::downloadFinished()
 {
@@ -318,21 +392,45 @@ void MultiLevelJsonBase::downloadFinished()
 
 	const bool qZcompressed = httpReply->request().url().path().endsWith(".qZ");
 	const bool gzCompressed = httpReply->request().url().path().endsWith(".gz");
+	// Remote files can be cached only if the server gives a version for them
+	QString cacheKey;
+	QByteArray version = httpReply->rawHeader("ETag");
+	if (version.isEmpty())
+		version = httpReply->rawHeader("Last-Modified");
+	if (!version.isEmpty())
+		cacheKey = httpReply->request().url().toString() + '|' + QString::fromLatin1(version);
 	httpReply->deleteLater();
 	httpReply=NULL;
 
-	Q_ASSERT(loadThread==NULL);
-	loadThread = new JsonLoadThread(this, content, qZcompressed, gzCompressed);
-	connect(loadThread, SIGNAL(finished()), this, SLOT(jsonLoadFinished()));
-	loadThread->start(QThread::LowestPriority);
+	if (!cacheKey.isEmpty() && loadFromCache(cacheKey, temporaryResultMap))
+	{
+		downloading = false;
+		try
+		{
+			loadFromQVariantMap(temporaryResultMap);
+			return;
+		}
+		catch (std::runtime_error e)
+		{
+			qWarning() << "WARNING: invalid cached variant map: " << e.what();
+			downloading = true;
+		}
+	}
+
+	Q_ASSERT(loadJobs==NULL);
+	loadJobs = new StelJobGroup();
+	StelApp::getInstance().getJobSystem()->submit(*loadJobs, new JsonLoadJob(this, content, qZcompressed, gzCompressed, cacheKey), StelJobSystem::PriorityBackground);
 }
 
 // Called when the element is fully loaded from the JSON file
 void MultiLevelJsonBase::jsonLoadFinished()
 {
-	loadThread->wait();
-	delete loadThread;
-	loadThread = NULL;
+	STEL_TRACE_SCOPE("MultiLevelJsonBase::jsonLoadFinished");
+	if (loadJobs==NULL)
+		return;
+	loadJobs->wait();
+	delete loadJobs;
+	loadJobs = NULL;
 	downloading = false;
 	if (errorOccured)
 		return;
@@ -35,7 +35,8 @@ class MultiLevelJsonBase : public StelSkyLayer
 {
 	Q_OBJECT
 
-	friend class JsonLoadThread;
+	friend class JsonLoadJob;
+	friend class JsonLoadFinishedJob;
 
 public:
 	//! Default constructor.
@@ -112,6 +113,13 @@ protected:
 	//! Load the element information from a JSON file
 	static QVariantMap loadFromJSON(QIODevice& input, bool qZcompressed=false, bool gzCompressed=false);
 
+	//! Load the element information from the on-disk cache of the parsed JSON files.
+	//! @param key identifies the file and its version, e.g. its URL and ETag.
+	//! @return false if the file is not in the cache.
+	static bool loadFromCache(const QString& key, QVariantMap& map);
+	//! Save the parsed element information in the on-disk cache. Can be called from any thread.
+	static void saveToCache(const QString& key, const QVariantMap& map);
+
 private:
 	//! Return the base URL prefixed to relative URL
 	QString getBaseUrl() const {return baseUrl;}
@@ -122,7 +130,8 @@ private:
 	// The delay after which a scheduled deletion will occur
 	float deletionDelay;
 
-	class JsonLoadThread* loadThread;
+	//! The job parsing the JSON file in the thread pool.
+	class StelJobGroup* loadJobs;
 
 	// Time at which deletion was first scheduled
 	double timeWhenDeletionScheduled;
@@ -133,10 +142,8 @@ private:
 	bool loadingState;
 	int lastPercent;
 
-	//! The network manager to use for downloading JSON files
-	static class QNetworkAccessManager* networkAccessManager;
-
-	static QNetworkAccessManager& getNetworkAccessManager();
+	//! The network manager to use for downloading JSON files, the one of the application.
+	static class QNetworkAccessManager& getNetworkAccessManager();
 };
 
 #endif // _MULTILEVELJSONBASE_HPP_
@@ -256,27 +256,6 @@ Vec3d OctahedronPolygon::getPointInside() const
 	return res;
 }
 
-void OctahedronPolygon::append(const OctahedronPolygon& other)
-{
-	Q_ASSERT(sides.size()==8 && other.sides.size()==8);
-	for (int i=0;i<8;++i)
-	{
-		sides[i] += other.sides[i];
-	}
-}
-
-void OctahedronPolygon::appendReversed(const OctahedronPolygon& other)
-{
-	Q_ASSERT(sides.size()==8 && other.sides.size()==8);
-	for (int i=0;i<8;++i)
-	{
-		foreach (const SubContour& sub, other.sides[i])
-		{
-			sides[i] += sub.reversed();
-		}
-	}
-}
-
 void OctahedronPolygon::projectOnOctahedron(QVarLengthArray<QVector<SubContour>,8 >& inSides)
 {
 	Q_ASSERT(inSides.size()==8);
@@ -549,7 +528,7 @@ void endLineLoopCallback(OctTessLineLoopCallbackData* data)
 	data->result.clear();
 }
 
-void OctahedronPolygon::tesselate(TessWindingRule windingRule)
+void OctahedronPolygon::tesselate(TessWindingRule windingRule, int sideMask)
 {
 	Q_ASSERT(sides.size()==8);
 	// Use GLUES tesselation functions to transform the polygon into a list of triangles
@@ -567,7 +546,7 @@ void OctahedronPolygon::tesselate(TessWindingRule windingRule)
 	// Call the tesselator on each side
 	for (int i=0;i<8;++i)
 	{
-		if (sides[i].isEmpty())
+		if (sides[i].isEmpty() || (sideMask & (1<<i))==0)
 			continue;
 		sides[i] = tesselateOneSideLineLoop(tess, i);
 	}
@@ -593,29 +572,72 @@ QString OctahedronPolygon::toJson() const
 
 void OctahedronPolygon::inPlaceIntersection(const OctahedronPolygon& mpoly)
 {
-	if (!intersectsBoundingCap(capN, capD, mpoly.capN, mpoly.capD))
+	if (isEmpty())
 		return;
-	append(mpoly);
-	tesselate(WindingAbsGeqTwo);
-	//tesselate(WindingPositive);
+	if (mpoly.isEmpty() || !intersectsBoundingCap(capN, capD, mpoly.capN, mpoly.capD))
+	{
+		for (int i=0;i<8;++i)
+			sides[i].clear();
+		updateVertexArray();
+		return;
+	}
+	// The intersection is empty on the sides where one of the polygons has no contour,
+	// only the sides where both have contours need to be tesselated.
+	int sideMask = 0;
+	for (int i=0;i<8;++i)
+	{
+		if (sides[i].isEmpty() || mpoly.sides[i].isEmpty())
+			sides[i].clear();
+		else
+		{
+			sides[i] += mpoly.sides[i];
+			sideMask |= 1<<i;
+		}
+	}
+	tesselate(WindingAbsGeqTwo, sideMask);
 	updateVertexArray();
 }
 
 void OctahedronPolygon::inPlaceUnion(const OctahedronPolygon& mpoly)
 {
+	if (mpoly.isEmpty())
+		return;
+	if (isEmpty())
+	{
+		*this = mpoly;
+		return;
+	}
 	const bool intersect = intersectsBoundingCap(capN, capD, mpoly.capN, mpoly.capD);
-	append(mpoly);
+	// The contours of a side are kept as they are when only one of the polygons has contours on it
+	int sideMask = 0;
+	for (int i=0;i<8;++i)
+	{
+		if (!sides[i].isEmpty() && !mpoly.sides[i].isEmpty())
+			sideMask |= 1<<i;
+		sides[i] += mpoly.sides[i];
+	}
 	if (intersect)
-		tesselate(WindingPositive);
+		tesselate(WindingPositive, sideMask);
 	updateVertexArray();
 }
 
 void OctahedronPolygon::inPlaceSubtraction(const OctahedronPolygon& mpoly)
 {
-	if (!intersectsBoundingCap(capN, capD, mpoly.capN, mpoly.capD))
+	if (isEmpty() || mpoly.isEmpty() || !intersectsBoundingCap(capN, capD, mpoly.capN, mpoly.capD))
 		return;
-	appendReversed(mpoly);
-	tesselate(WindingPositive);
+	// Only the sides where both polygons have contours are modified
+	int sideMask = 0;
+	for (int i=0;i<8;++i)
+	{
+		if (sides[i].isEmpty() || mpoly.sides[i].isEmpty())
+			continue;
+		foreach (const SubContour& sub, mpoly.sides[i])
+			sides[i] += sub.reversed();
+		sideMask |= 1<<i;
+	}
+	if (sideMask==0)
+		return;
+	tesselate(WindingPositive, sideMask);
 	updateVertexArray();
 }
 
@@ -121,10 +121,6 @@ private:
 	//! Creates a full Octahedron.
 	static OctahedronPolygon createAllSkyOctahedronPolygon();
 
-	//! Append all theOctahedronPolygonach octahedron sides. No tesselation occurs at this point,
-	//! and a call to tesselatOctahedronPolygon each appended SubContours per side.
-	void append(const OctahedronPolygon& other);
-	void appendReversed(const OctahedronPolygon& other);
 	void appendSubContour(const SubContour& contour);
 
 	enum TessWindingRule
@@ -136,7 +132,8 @@ private:
 	bool sideContains2D(const Vec3d& p, int sideNb) const;
 
 	//! Tesselate the contours per side, producing (in @var sides) a list of triangles subcontours according to the given rule.
-	void tesselate(TessWindingRule rule);
+	//! @param sideMask the sides to tesselate, bit i being set for side i. The other sides are left unchanged.
+	void tesselate(TessWindingRule rule, int sideMask=0xFF);
 
 	QVector<SubContour> tesselateOneSideLineLoop(struct GLUEStesselator* tess, int sidenb) const;
 	QVector<Vec3d> tesselateOneSideTriangles(struct GLUEStesselator* tess, int sidenb) const;
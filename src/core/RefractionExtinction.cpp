@@ -23,8 +23,44 @@
 #include "StelApp.hpp"
 #include "RefractionExtinction.hpp"
 
+const float Extinction::AirmassTableMinCosZ = -0.035f;
+const float Extinction::AirmassTableScale = Extinction::AirmassTableSize/(1.f-Extinction::AirmassTableMinCosZ);
+float Extinction::airmassTable[Extinction::AirmassTableSize+1];
+bool Extinction::airmassTableInitialized = false;
+
 Extinction::Extinction() : ext_coeff(50), undergroundExtinctionMode(UndergroundExtinctionMirror)
 {
+	if (!airmassTableInitialized)
+	{
+		for (int i=0; i<=AirmassTableSize; ++i)
+			airmassTable[i] = airmass(AirmassTableMinCosZ+i/AirmassTableScale, false);
+		airmassTableInitialized = true;
+	}
+}
+
+void Extinction::forward(int num, const Vec3f* altAzPos, float* mag) const
+{
+	for (int i=0; i<num; ++i)
+		mag[i] += tabulatedAirmass(altAzPos[i][2]) * ext_coeff;
+}
+
+void Extinction::getExtinctionRange(float minSinAlt, float maxSinAlt, float& minMag, float& maxMag) const
+{
+	// The airmass decreases with the altitude above the table minimum, and below it in the mirror mode,
+	// so the extremes are at the bounds of the range or on both sides of the table minimum.
+	float a = tabulatedAirmass(minSinAlt);
+	float b = tabulatedAirmass(maxSinAlt);
+	minMag = std::min(a, b);
+	maxMag = std::max(a, b);
+	if (minSinAlt < AirmassTableMinCosZ && maxSinAlt >= AirmassTableMinCosZ)
+	{
+		a = tabulatedAirmass(AirmassTableMinCosZ);
+		b = tabulatedAirmass(AirmassTableMinCosZ-0.0001f);
+		minMag = std::min(minMag, std::min(a, b));
+		maxMag = std::max(maxMag, std::max(a, b));
+	}
+	minMag *= ext_coeff;
+	maxMag *= ext_coeff;
 }
 
 // airmass computation for cosine of zenith angle z
@@ -108,9 +144,65 @@ void Refraction::updatePrecomputed()
 {
 	press_temp_corr_Bennett=pressure/1010.f * 283.f/(273.f+temperature) / 60.f;
 	press_temp_corr_Saemundson=1.02f*press_temp_corr_Bennett;
+
+	// The formulae leave the positions unchanged below the bottom of their transition zones
+	const float forwardBounds[3]={MIN_GEO_ALTITUDE_DEG-TRANSITION_WIDTH_GEO_DEG, MIN_GEO_ALTITUDE_DEG, 90.f};
+	buildRefractionTables(forwardTables, forwardBounds, 3, true);
+	// The backward formula switches from the polynomial fit to Bennett above 0.22879 degrees
+	const float backwardBounds[4]={MIN_APP_ALTITUDE_DEG-TRANSITION_WIDTH_APP_DEG, MIN_APP_ALTITUDE_DEG, 0.22879f, 90.f};
+	buildRefractionTables(backwardTables, backwardBounds, 4, false);
 }
 
-void Refraction::innerRefractionForward(Vec3d& altAzPos) const
+// Spacing of the tabulated values of tan(alt/2), which gives errors under 0.3 arcsecond.
+static const double REFRACTION_TABLE_STEPS_PER_UNIT=4096.;
+
+void Refraction::buildRefractionTables(QVector<RefractionTable>& tables, const float* boundsDeg, int nbBounds, bool forward) const
+{
+	tables.resize(nbBounds-1);
+	for (int k=0; k<nbBounds-1; ++k)
+	{
+		RefractionTable& table=tables[k];
+		table.minT=std::tan(boundsDeg[k]*M_PI/360.);
+		table.maxT=std::tan(boundsDeg[k+1]*M_PI/360.);
+		const int n=qMax(8, (int)std::ceil((table.maxT-table.minT)*REFRACTION_TABLE_STEPS_PER_UNIT));
+		table.scale=n/(table.maxT-table.minT);
+		table.angles.resize(n+1);
+		for (int i=0; i<=n; ++i)
+		{
+			// The formula is evaluated strictly inside the range, on the side of its discontinuities belonging to it
+			const double t=qBound(table.minT+1e-9, table.minT+(table.maxT-table.minT)*i/n, table.maxT-1e-9);
+			const double alt=2.*std::atan(t);
+			Vec3d v(std::cos(alt), 0., std::sin(alt));
+			if (forward)
+				computeRefractionForward(v);
+			else
+				computeRefractionBackward(v);
+			table.angles[i]=std::asin(qBound(-1., v[2], 1.))-alt;
+		}
+	}
+}
+
+void Refraction::applyRefractionTables(const QVector<RefractionTable>& tables, Vec3d& altAzPos)
+{
+	const double length = altAzPos.length();
+	const double s = altAzPos[2]/length;
+	const double c = std::sqrt(altAzPos[0]*altAzPos[0]+altAzPos[1]*altAzPos[1])/length;
+	const double t = s/(1.+c);
+	if (t <= tables.first().minT)
+		return;
+	int k=0;
+	while (k < tables.size()-1 && t >= tables.at(k).maxT)
+		++k;
+	const RefractionTable& table = tables.at(k);
+	const double f = (t-table.minT)*table.scale;
+	const int i = qBound(0, (int)f, table.angles.size()-2);
+	const float* a = table.angles.constData()+i;
+	const double da = a[0]+(f-i)*(a[1]-a[0]);
+	// sin(alt+da), the refraction angle being under one degree
+	altAzPos[2] = qMin(s*(1.-0.5*da*da)+c*da*(1.-da*da/6.), 1.)*length;
+}
+
+void Refraction::computeRefractionForward(Vec3d& altAzPos) const
 {
 	const double length = altAzPos.length();
 	double geom_alt_deg=180./M_PI*std::asin(altAzPos[2]/length);
@@ -132,7 +224,7 @@ void Refraction::innerRefractionForward(Vec3d& altAzPos) const
 	}
 }
 
-void Refraction::innerRefractionBackward(Vec3d& altAzPos) const
+void Refraction::computeRefractionBackward(Vec3d& altAzPos) const
 {
 	// going from observed position/magnitude to geometrical position and atmosphere-free mag.
 	const double length = altAzPos.length();
@@ -198,14 +290,48 @@ void Refraction::backward(Vec3f& altAzPos) const
 	altAzPos.transfo4d(invertPreTransfoMatf);
 }
 
+void Refraction::forwardArray(int n, Vec3d* altAzPos) const
+{
+	preTransfoMat.transfoArray(n, altAzPos);
+	for (int i=0; i<n; ++i)
+		innerRefractionForward(altAzPos[i]);
+	postTransfoMat.transfoArray(n, altAzPos);
+}
+
+void Refraction::forwardArray(int n, Vec3f* altAzPos) const
+{
+	Vec3d vf;
+	for (int i=0; i<n; ++i)
+	{
+		vf.set(altAzPos[i][0], altAzPos[i][1], altAzPos[i][2]);
+		vf.transfo4d(preTransfoMat);
+		innerRefractionForward(vf);
+		vf.transfo4d(postTransfoMat);
+		altAzPos[i].set(vf[0], vf[1], vf[2]);
+	}
+}
+
+void Refraction::backwardArray(int n, Vec3d* altAzPos) const
+{
+	invertPostTransfoMat.transfoArray(n, altAzPos);
+	for (int i=0; i<n; ++i)
+		innerRefractionBackward(altAzPos[i]);
+	invertPreTransfoMat.transfoArray(n, altAzPos);
+}
+
 void Refraction::setPressure(float p)
 {
+	// The tables are only rebuilt when the atmosphere changes
+	if (p==pressure)
+		return;
 	pressure=p;
 	updatePrecomputed();
 }
 
 void Refraction::setTemperature(float t)
 {
+	if (t==temperature)
+		return;
 	temperature=t;
 	updatePrecomputed();
 }
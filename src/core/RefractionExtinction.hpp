@@ -31,6 +31,8 @@
 #include "VecMath.hpp"
 #include "StelProjector.hpp"
 
+#include <QVector>
+
 //! @class Extinction
 //! This class performs extinction computations, following literature from atmospheric optics and astronomy.
 //! Airmass computations are limited to meaningful altitudes.
@@ -83,6 +85,22 @@ public:
 		*mag -= airmass(altAzPos[2], false) * ext_coeff;
 	}
 
+	//! Get the extinction in magnitudes for a geometrical altitude, interpolated in a precomputed airmass table.
+	//! This is faster than forward() and accurate to about 0.01 airmass, which is enough for the stars.
+	//! @param sinAlt the sine of the geometrical altitude.
+	float getExtinction(float sinAlt) const
+	{
+		return tabulatedAirmass(sinAlt) * ext_coeff;
+	}
+
+	//! Compute the extinction of arrays of size @param num NORMALIZED position vectors and magnitudes, with the airmass table.
+	void forward(int num, const Vec3f* altAzPos, float* mag) const;
+
+	//! Get the minimum and maximum extinction in magnitudes over a range of geometrical altitudes,
+	//! so that it can be applied once to a group of objects when it is the same for all of them.
+	//! @param minSinAlt,maxSinAlt the sines of the lowest and highest altitudes of the range.
+	void getExtinctionRange(float minSinAlt, float maxSinAlt, float& minMag, float& maxMag) const;
+
 	//! Set visual extinction coefficient (mag/airmass), influences extinction computation.
 	//! @param k= 0.1 for highest mountains, 0.2 for very good lowland locations, 0.35 for typical lowland, 0.5 in humid climates.
 	void setExtinctionCoefficient(float k) { ext_coeff=k; }
@@ -101,6 +119,30 @@ private:
 	//! Rozenberg is infinite at Z=92.17 deg, Young at Z=93.6 deg, so this function RETURNS SUBHORIZONTAL_AIRMASS BELOW -2 DEGREES!
 	float airmass(float cosZ, const bool apparent_z=true) const;
 
+	//! Get the geometrical airmass of Young interpolated in the table, with the underground mode applied.
+	float tabulatedAirmass(float cosZ) const
+	{
+		if (cosZ < AirmassTableMinCosZ)
+		{
+			if (undergroundExtinctionMode==UndergroundExtinctionZero)
+				return 0.f;
+			if (undergroundExtinctionMode==UndergroundExtinctionMax)
+				return 42.f;
+			cosZ = std::min(1.f, 2.f*AirmassTableMinCosZ - cosZ);
+		}
+		const float f = (cosZ-AirmassTableMinCosZ)*AirmassTableScale;
+		const int i = std::min((int)f, AirmassTableSize-1);
+		return airmassTable[i] + (f-i)*(airmassTable[i+1]-airmassTable[i]);
+	}
+
+	//! Geometrical airmass for regularly spaced values of cos(z) from the altitude where the underground
+	//! modes start to the zenith, where the formula is smooth. It does not depend on the settings.
+	static const int AirmassTableSize = 1024;
+	static const float AirmassTableMinCosZ;
+	static const float AirmassTableScale;
+	static float airmassTable[AirmassTableSize+1];
+	static bool airmassTableInitialized;
+
 	//! k, magnitudes/airmass, in [0.00, ... 1.00], (default 0.20).
 	float ext_coeff;
 
@@ -143,6 +185,12 @@ public:
 	//! Note that forward/backward are no absolute reverse operations!
 	void backward(Vec3f& altAzPos) const;
 
+	//! Apply refraction to an array of positions, with the transformation matrices applied once per call.
+	void forwardArray(int n, Vec3d* altAzPos) const;
+	void forwardArray(int n, Vec3f* altAzPos) const;
+	//! Remove refraction from an array of positions.
+	void backwardArray(int n, Vec3d* altAzPos) const;
+
 	void combine(const Mat4d& m)
 	{
 		setPreTransfoMat(preTransfoMat*m);
@@ -150,7 +198,7 @@ public:
 
 	Mat4d getApproximateLinearTransfo() const {return postTransfoMat*preTransfoMat;}
 
-	StelProjector::ModelViewTranformP clone() const {Refraction* refr = new Refraction(); *refr=*this; return StelProjector::ModelViewTranformP(refr);}
+	StelProjector::ModelViewTranformP clone() const {return StelProjector::ModelViewTranformP(new Refraction(*this));}
 
 	//! Set surface air pressure (mbars), influences refraction computation.
 	void setPressure(float p_mbar);
@@ -165,11 +213,37 @@ public:
 	void setPostTransfoMat(const Mat4d& m);
 
 private:
-	//! Update precomputed variables.
+	//! Update precomputed variables and rebuild the refraction tables.
 	void updatePrecomputed();
 
-	void innerRefractionForward(Vec3d& altAzPos) const;
-	void innerRefractionBackward(Vec3d& altAzPos) const;
+	//! Apply the refraction formulae, used to build the tables.
+	void computeRefractionForward(Vec3d& altAzPos) const;
+	void computeRefractionBackward(Vec3d& altAzPos) const;
+
+	//! Apply the refraction by interpolating in the tables.
+	void innerRefractionForward(Vec3d& altAzPos) const {applyRefractionTables(forwardTables, altAzPos);}
+	void innerRefractionBackward(Vec3d& altAzPos) const {applyRefractionTables(backwardTables, altAzPos);}
+
+	//! Refraction angle in radians tabulated for regularly spaced values of tan(alt/2), over a range of
+	//! altitudes in which the formula has no discontinuity.
+	//! tan(alt/2) is almost proportional to the altitude and is computed from the position vector without
+	//! any inverse trigonometric function.
+	struct RefractionTable
+	{
+		double minT;
+		double maxT;
+		//! Number of intervals per unit of tan(alt/2).
+		double scale;
+		QVector<float> angles;
+	};
+	//! Tabulate a formula over the altitude ranges separated by the given bounds in degrees.
+	void buildRefractionTables(QVector<RefractionTable>& tables, const float* boundsDeg, int nbBounds, bool forward) const;
+	static void applyRefractionTables(const QVector<RefractionTable>& tables, Vec3d& altAzPos);
+
+	//! The tables are rebuilt when the pressure or temperature change, and are implicitly shared by
+	//! the copies of the transformation done for each projection.
+	QVector<RefractionTable> forwardTables;
+	QVector<RefractionTable> backwardTables;
 	
 	//! These 3 Atmosphere parameters can be controlled by GUI.
 	//! Pressure[mbar] (1013)
@@ -17,15 +17,26 @@
  */
 
 #include "SimbadSearcher.hpp"
-
+#include "StelApp.hpp"
+#include "StelFileMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
 #include <QNetworkReply>
 #include <QNetworkAccessManager>
+#include <QDataStream>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
 #include <QTimer>
 
-SimbadLookupReply::SimbadLookupReply(const QString& aurl, QNetworkAccessManager* anetMgr, int delayMs) : url(aurl), reply(NULL), netMgr(anetMgr), currentStatus(SimbadLookupQuerying)
+// Number of lookups kept in the cache
+static const int CacheSize = 500;
+// Days after which the results of the cache are queried again
+static const int CacheLifetimeDays = 30;
+// Version of the file of the cache
+static const quint32 CacheFileMagic = 0x53494d31;
+
+SimbadLookupReply::SimbadLookupReply(const QString& aurl, SimbadSearcher* asearcher, int delayMs) : url(aurl), searcher(asearcher), started(false), currentStatus(SimbadLookupQuerying)
 {
 	// First wait before starting query. This avoids sending a query for each autocompletion letter.
 	QTimer::singleShot(delayMs, this, SLOT(delayTimerCompleted()));
@@ -33,32 +44,159 @@ SimbadLookupReply::SimbadLookupReply(const QString& aurl, QNetworkAccessManager*
 
 SimbadLookupReply::~SimbadLookupReply()
 {
-	if (reply)
+	if (started && currentStatus==SimbadLookupQuerying && searcher)
+		searcher->cancelQuery(this);
+}
+
+void SimbadLookupReply::delayTimerCompleted()
+{
+	if (!searcher)
+	{
+		setError(q_("Network error"));
+		return;
+	}
+	started = true;
+	searcher->startQuery(this);
+}
+
+void SimbadLookupReply::setResults(const QMap<QString, Vec3d>& results)
+{
+	resultPositions = results;
+	currentStatus = SimbadLookupFinished;
+	emit statusChanged();
+}
+
+void SimbadLookupReply::setError(const QString& error)
+{
+	errorString = error;
+	currentStatus = SimbadLookupErrorOccured;
+	emit statusChanged();
+}
+
+// Get a I18n string describing the current status.
+QString SimbadLookupReply::getCurrentStatusString() const
+{
+	switch (currentStatus)
+	{
+		case SimbadLookupQuerying:
+			return q_("Querying");
+		case SimbadLookupErrorOccured:
+			return q_("Error");
+		case SimbadLookupFinished:
+			return resultPositions.isEmpty() ? q_("Not found") : q_("Found");
+	}
+	return QString();
+}
+
+SimbadSearcher::SimbadSearcher(QObject* parent) : QObject(parent)
+{
+	networkMgr = StelApp::getInstance().getNetworkAccessManager();
+	cache.setMaxCost(CacheSize);
+	loadCache();
+}
+
+SimbadSearcher::~SimbadSearcher()
+{
+	saveCache();
+	foreach (QNetworkReply* reply, pendingLookups.keys())
 	{
 		disconnect(reply, SIGNAL(finished()), this, SLOT(httpQueryFinished()));
 		reply->abort();
 		reply->deleteLater();
-		reply = NULL;
 	}
 }
 
-void SimbadLookupReply::delayTimerCompleted()
+// Lookup in Simbad for the passed object name.
+SimbadLookupReply* SimbadSearcher::lookup(const QString& serverUrl, const QString& objectName, int maxNbResult, int delayMs)
 {
-	reply = netMgr->get(QNetworkRequest(url));
-	connect(reply, SIGNAL(finished()), this, SLOT(httpQueryFinished()));
+	// Create the Simbad query
+	QString url(serverUrl);
+	url += "simbad/sim-script?script=format object \"%COO(d;A D)\\n%IDLIST(1)\"\n";
+	url += QString("set epoch J2000\nset limit %1\n query id ").arg(maxNbResult);
+	url += objectName;
+	// The results already known don't need to wait for the end of the typing
+	if (cache.contains(url))
+		delayMs = 0;
+	return new SimbadLookupReply(url, this, delayMs);
 }
 
-void SimbadLookupReply::httpQueryFinished()
+void SimbadSearcher::startQuery(SimbadLookupReply* lookupReply)
 {
+	const QString& url = lookupReply->url;
+	const CacheEntry* entry = cache.object(url);
+	if (entry && entry->date.daysTo(QDateTime::currentDateTime())<CacheLifetimeDays)
+	{
+		lookupReply->setResults(entry->results);
+		return;
+	}
+
+	// Wait for the same query if it is already running
+	QNetworkReply* reply = pendingReplies.value(url);
+	if (reply==NULL)
+	{
+		QNetworkRequest req(url);
+		// The user is waiting for the result
+		req.setPriority(QNetworkRequest::HighPriority);
+		reply = networkMgr->get(req);
+		connect(reply, SIGNAL(finished()), this, SLOT(httpQueryFinished()));
+		pendingReplies.insert(url, reply);
+	}
+	pendingLookups[reply].append(lookupReply);
+}
+
+void SimbadSearcher::cancelQuery(SimbadLookupReply* lookupReply)
+{
+	QNetworkReply* reply = pendingReplies.value(lookupReply->url);
+	if (reply==NULL)
+		return;
+	QList<SimbadLookupReply*>& lookups = pendingLookups[reply];
+	lookups.removeAll(lookupReply);
+	if (!lookups.isEmpty())
+		return;
+	// Nobody waits for the result anymore
+	pendingLookups.remove(reply);
+	pendingReplies.remove(lookupReply->url);
+	disconnect(reply, SIGNAL(finished()), this, SLOT(httpQueryFinished()));
+	reply->abort();
+	reply->deleteLater();
+}
+
+void SimbadSearcher::httpQueryFinished()
+{
+	QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+	Q_ASSERT(reply);
+	reply->deleteLater();
+	const QList<SimbadLookupReply*> lookups = pendingLookups.take(reply);
+	// The url of the request may be encoded differently than the key of the cache
+	const QString url = pendingReplies.key(reply);
+	pendingReplies.remove(url);
+
 	if (reply->error()!=QNetworkReply::NoError)
 	{
-		currentStatus = SimbadLookupErrorOccured;
-		errorString = QString("%1: %2").arg(q_("Network error")).arg(reply->errorString());
-		emit statusChanged();
+		const QString error = QString("%1: %2").arg(q_("Network error")).arg(reply->errorString());
+		foreach (SimbadLookupReply* lookupReply, lookups)
+			lookupReply->setError(error);
 		return;
 	}
 
-	// No error, try to parse the Simbad result
+	QMap<QString, Vec3d> results;
+	QString error;
+	if (!parseResult(reply, results, error))
+	{
+		foreach (SimbadLookupReply* lookupReply, lookups)
+			lookupReply->setError(error);
+		return;
+	}
+	CacheEntry* entry = new CacheEntry;
+	entry->results = results;
+	entry->date = QDateTime::currentDateTime();
+	cache.insert(url, entry);
+	foreach (SimbadLookupReply* lookupReply, lookups)
+		lookupReply->setResults(results);
+}
+
+bool SimbadSearcher::parseResult(QNetworkReply* reply, QMap<QString, Vec3d>& results, QString& error)
+{
 	QByteArray line;
 	bool found = false;
 	//qDebug() << reply->readAll();
@@ -89,10 +227,8 @@ void SimbadLookupReply::httpQueryFinished()
 			QList<QByteArray> l = line.split(' ');
 			if (l.size()!=2)
 			{
-				currentStatus = SimbadLookupErrorOccured;
-				errorString = q_("Error parsing position");
-				emit statusChanged();
-				return;
+				error = q_("Error parsing position");
+				return false;
 			}
 			else
 			{
@@ -101,54 +237,72 @@ void SimbadLookupReply::httpQueryFinished()
 				const double dec = l[1].toDouble(&ok2)*M_PI/180.;
 				if (ok1==false || ok2==false)
 				{
-					currentStatus = SimbadLookupErrorOccured;
-					errorString = q_("Error parsing position");
-					emit statusChanged();
-					return;
+					error = q_("Error parsing position");
+					return false;
 				}
 				Vec3d v;
 				StelUtils::spheToRect(ra, dec, v);
 				line = reply->readLine();
 				line.chop(1); // Remove a line break at the end
 				line.replace("NAME " ,"");
-				resultPositions[line]=v;
+				results[line]=v;
 			}
 			line = reply->readLine();
 			line.chop(1); // Remove a line break at the end
 		}
 	}
 
-	currentStatus = SimbadLookupFinished;
-	emit statusChanged();
+	return true;
 }
 
-// Get a I18n string describing the current status.
-QString SimbadLookupReply::getCurrentStatusString() const
+void SimbadSearcher::loadCache()
 {
-	switch (currentStatus)
+	QFile file(StelFileMgr::getCacheDir()+"/simbad_lookups.dat");
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, count;
+	in >> magic >> count;
+	if (magic!=CacheFileMagic)
+		return;
+	for (quint32 i=0;i<count && in.status()==QDataStream::Ok;++i)
 	{
-		case SimbadLookupQuerying:
-			return q_("Querying");
-		case SimbadLookupErrorOccured:
-			return q_("Error");
-		case SimbadLookupFinished:
-			return resultPositions.isEmpty() ? q_("Not found") : q_("Found");
+		QString url;
+		quint32 nbResults;
+		CacheEntry* entry = new CacheEntry;
+		in >> url >> entry->date >> nbResults;
+		for (quint32 j=0;j<nbResults && in.status()==QDataStream::Ok;++j)
+		{
+			QString name;
+			Vec3d v;
+			in >> name >> v[0] >> v[1] >> v[2];
+			entry->results.insert(name, v);
+		}
+		if (in.status()!=QDataStream::Ok || entry->date.daysTo(QDateTime::currentDateTime())>=CacheLifetimeDays)
+			delete entry;
+		else
+			cache.insert(url, entry);
 	}
-	return QString();
 }
 
-SimbadSearcher::SimbadSearcher(QObject* parent) : QObject(parent)
+void SimbadSearcher::saveCache() const
 {
-	networkMgr = new QNetworkAccessManager(this);
-}
-
-// Lookup in Simbad for the passed object name.
-SimbadLookupReply* SimbadSearcher::lookup(const QString& serverUrl, const QString& objectName, int maxNbResult, int delayMs)
-{
-	// Create the Simbad query
-	QString url(serverUrl);
-	url += "simbad/sim-script?script=format object \"%COO(d;A D)\\n%IDLIST(1)\"\n";
-	url += QString("set epoch J2000\nset limit %1\n query id ").arg(maxNbResult);
-	url += objectName;
-	return new SimbadLookupReply(url, networkMgr, delayMs);
+	QFile file(StelFileMgr::getCacheDir()+"/simbad_lookups.dat");
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "WARNING: Can't save the Simbad lookups to" << QDir::toNativeSeparators(file.fileName());
+		return;
+	}
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	const QList<QString> urls = cache.keys();
+	out << CacheFileMagic << (quint32)urls.size();
+	foreach (const QString& url, urls)
+	{
+		const CacheEntry* entry = cache.object(url);
+		out << url << entry->date << (quint32)entry->results.size();
+		for (QMap<QString, Vec3d>::ConstIterator iter=entry->results.constBegin();iter!=entry->results.constEnd();++iter)
+			out << iter.key() << iter.value()[0] << iter.value()[1] << iter.value()[2];
+	}
 }
@@ -21,10 +21,16 @@
 
 #include "VecMath.hpp"
 #include <QObject>
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
 #include <QMap>
+#include <QPointer>
 
 class QNetworkReply;
 class QNetworkAccessManager;
+class SimbadSearcher;
 
 //! @class SimbadLookupReply
 //! Contains all the information about a current simbad lookup query.
@@ -45,6 +51,7 @@ public:
 		SimbadLookupFinished		//!< The query is over. The reply can be deleted.
 	};
 
+	//! Deleting a reply cancels its query, the download stops if no other reply waits for it.
 	~SimbadLookupReply();
 
 	//! Get the result list of matching objectName/position.
@@ -64,18 +71,22 @@ signals:
 	void statusChanged();
 
 private slots:
-	void httpQueryFinished();
 	void delayTimerCompleted();
 
 private:
 	//! Private constructor can be called by SimbadSearcher only.
-	SimbadLookupReply(const QString& url, QNetworkAccessManager* mgr, int delayMs=500);
+	SimbadLookupReply(const QString& url, SimbadSearcher* searcher, int delayMs=500);
+
+	//! Called by the SimbadSearcher when the query is over.
+	void setResults(const QMap<QString, Vec3d>& results);
+	void setError(const QString& error);
 
 	QString url;
 
-	//! The reply used internally.
-	QNetworkReply* reply;
-	QNetworkAccessManager* netMgr;
+	QPointer<SimbadSearcher> searcher;
+
+	//! Whether the query was sent to the searcher.
+	bool started;
 
 	//! The list of resulting objectNames/Position in ICRS.
 	QMap<QString, Vec3d> resultPositions;
@@ -91,12 +102,17 @@ private:
 //! @class SimbadSearcher
 //! Provides lookup features into the online Simbad service from CDS.
 //! See http://simbad.u-strasbg.fr for more info.
+//! The results are kept in a cache of the last lookups, which is saved in the cache directory
+//! at the end of the program, so that the objects which were already searched are found at once.
+//! The lookups identical to a query being downloaded wait for its result instead of sending the
+//! same query again.
 class SimbadSearcher : public QObject
 {
 	Q_OBJECT
 
 public:
 	SimbadSearcher(QObject* parent);
+	~SimbadSearcher();
 
 	//! Lookup in Simbad for object which have a name starting with @em objectName.
 	//! @param serverUrl URL of the SIMBAD mirror server.
@@ -104,12 +120,43 @@ public:
 	//! @param maxNbResult the maximum number of returned result.
 	//! @param delayMs a delay in ms to wait for before actually triggering the lookup.
 	//! This used to group requests, e.g. send only one request when a used types a word insead of one per letter.
+	//! There is no delay when the result is in the cache.
 	//! @return a new SimbadLookupReply which is owned by the caller.
 	SimbadLookupReply* lookup(const QString& serverUrl, const QString& objectName, int maxNbResult=1, int delayMs=500);
 
+private slots:
+	void httpQueryFinished();
+
 private:
+	friend class SimbadLookupReply;
+
+	//! Start the query of a lookup, or answer it from the cache or with a query already running.
+	void startQuery(SimbadLookupReply* lookupReply);
+	//! Forget a lookup, and abort its query if no other lookup waits for it.
+	void cancelQuery(SimbadLookupReply* lookupReply);
+
+	//! Parse the result of a query.
+	//! @return false and set error if the result can't be parsed.
+	static bool parseResult(QNetworkReply* reply, QMap<QString, Vec3d>& results, QString& error);
+
+	void loadCache();
+	void saveCache() const;
+
 	//! The network manager used query simbad
 	QNetworkAccessManager* networkMgr;
+
+	//! A result of the cache.
+	struct CacheEntry
+	{
+		QMap<QString, Vec3d> results;
+		QDateTime date;
+	};
+	//! The last results, indexed by URL of the query.
+	QCache<QString, CacheEntry> cache;
+
+	//! The queries being downloaded, and the lookups waiting for their result.
+	QHash<QString, QNetworkReply*> pendingReplies;
+	QHash<QNetworkReply*, QList<SimbadLookupReply*> > pendingLookups;
 };
 
 #endif /*SIMBADSEARCHER_HPP_*/
@@ -20,6 +20,8 @@
 #include "StelApp.hpp"
 
 #include "StelCore.hpp"
+#include "StelFader.hpp"
+#include "StelMovementMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelTextureMgr.hpp"
 #include "StelObjectMgr.hpp"
@@ -34,6 +36,7 @@
 #include "SolarSystem.hpp"
 #include "StelIniParser.hpp"
 #include "StelProjector.hpp"
+#include "StelSkyDrawer.hpp"
 #include "StelLocationMgr.hpp"
 #include "StelActionMgr.hpp"
 
@@ -48,6 +51,24 @@
 #include "StelVideoMgr.hpp"
 #include "StelGuiBase.hpp"
 #include "StelPainter.hpp"
+#include "StelViewportEffect.hpp"
+#include "StelRenderTargetPool.hpp"
+#include "StelFoveatedRenderer.hpp"
+#include "StelCubemapRenderer.hpp"
+#include "StelMultiViewport.hpp"
+#include "StelDynamicResolution.hpp"
+#include "StelTemporalAntialiasing.hpp"
+#include "StelTiledCapture.hpp"
+#include "StelLiveOutput.hpp"
+#include "StelSensorInput.hpp"
+#include "StelFrameProfiler.hpp"
+#include "StelFrameRecorder.hpp"
+#include "StelSessionRecorder.hpp"
+#include "StelRenderStats.hpp"
+#include "StelMemoryStats.hpp"
+#include "StelRenderProfile.hpp"
+#include "StelTracer.hpp"
+#include "StelJobSystem.hpp"
 #ifndef DISABLE_SCRIPTING
  #include "StelScriptMgr.hpp"
  #include "StelMainScriptAPIProxy.hpp"
@@ -57,6 +78,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QMouseEvent>
@@ -65,6 +87,7 @@
 #include <QNetworkProxy>
 #include <QNetworkReply>
 #include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
 #include <QString>
 #include <QStringList>
 #include <QSysInfo>
@@ -73,6 +96,7 @@
 #include <QDir>
 #include <QCoreApplication>
 #include <QScreen>
+#include <QtConcurrentRun>
 
 Q_IMPORT_PLUGIN(StelStandardGuiPluginInterface)
 
@@ -96,6 +120,10 @@ Q_IMPORT_PLUGIN(SimpleDrawLineStelPluginInterface)
 Q_IMPORT_PLUGIN(AngleMeasureStelPluginInterface)
 #endif
 
+#ifdef USE_STATIC_PLUGIN_CLUSTERSYNC
+Q_IMPORT_PLUGIN(ClusterSyncStelPluginInterface)
+#endif
+
 #ifdef USE_STATIC_PLUGIN_COMPASSMARKS
 Q_IMPORT_PLUGIN(CompassMarksStelPluginInterface)
 #endif
@@ -172,9 +200,15 @@ Q_IMPORT_PLUGIN(PointerCoordinatesStelPluginInterface)
 Q_IMPORT_PLUGIN(ObservabilityStelPluginInterface)
 #endif
 
+#ifdef USE_STATIC_PLUGIN_REMOTECONTROL
+Q_IMPORT_PLUGIN(RemoteControlStelPluginInterface)
+#endif
+
 // Initialize static variables
 StelApp* StelApp::singleton = NULL;
 QTime* StelApp::qtime = NULL;
+double StelApp::fixedRunTime = -1.;
+double StelApp::runTimeOffset = 0.;
 
 void StelApp::initStatic()
 {
@@ -214,7 +248,57 @@ StelApp::StelApp(QObject* parent)
 	, initialized(false)
 	, saveProjW(-1)
 	, saveProjH(-1)
+	, appliedStereoMode(StelCore::StereoNone)
+	, appliedStereoLensOffset(0.f)
+	, stereoEffect(NULL)
+	, flagWarpMesh(false)
+	, warpEffect(NULL)
+	, flagIdleRedraw(false)
+	, idleEffect(NULL)
+	, idleRefreshPeriod(10.)
+	, drawnTime(0.)
+	, drawnJD(0.)
+	, drawnFov(0.)
+	, drawnFaderTransitions(0)
+	, dirtyUntil(0.)
+	, flagFrameDirty(true)
+	, viewportTargets(NULL)
+	, viewportFbo(NULL)
+	, foveatedRenderer(NULL)
+	, cubemapRenderer(NULL)
+	, multiViewport(NULL)
+	, dynamicResolution(NULL)
+	, temporalAntialiasing(NULL)
+	, sensorInput(NULL)
+	, flagStereoReprojection(false)
+	, stereoReprojectionMargin(0)
+	, stereoFrameBudget(1./90.)
+	, headPosePrediction(0.)
+	, frameStartTime(0.)
+	, lastFrameDuration(0.)
+	, lastFrameReprojected(false)
+	, renderedPixelPerRad(0.f)
+	, frameProfiler(NULL)
+	, frameRecorder(NULL)
+	, tiledCapture(NULL)
+	, liveOutput(NULL)
+	, sessionRecorder(NULL)
+	, renderStats(NULL)
+	, memoryStats(NULL)
+	, renderProfile(NULL)
+	, flagRecordFrame(false)
+	, flagSkipFrame(false)
+	, flagParallelInit(true)
+	, flagDeferredInit(true)
+	, flagParallelUpdate(true)
+	, jobSystem(NULL)
 {
+	windowXywh[0] = windowXywh[1] = windowXywh[2] = windowXywh[3] = 0.f;
+	renderedHeadPose[0] = renderedHeadPose[1] = 0.;
+	drawnViewDirection[0] = drawnViewDirection[1] = drawnViewDirection[2] = 0.;
+	stereoLensDistortion[0] = 1.f;
+	stereoLensDistortion[1] = stereoLensDistortion[2] = stereoLensDistortion[3] = 0.f;
+	stereoChromaticAberration[0] = stereoChromaticAberration[1] = 1.f;
 	// Stat variables
 	nbDownloadedFiles=0;
 	totalDownloadedSize=0;
@@ -236,6 +320,12 @@ StelApp::StelApp(QObject* parent)
 	singleton = this;
 
 	moduleMgr = new StelModuleMgr();
+	jobSystem = new StelJobSystem();
+	// Created first as the input handlers record the events
+	sessionRecorder = new StelSessionRecorder();
+	// Created before the painters and the textures which count their work
+	renderStats = new StelRenderStats();
+	memoryStats = new StelMemoryStats();
 
 	wheelEventTimer = new QTimer(this);
 	wheelEventTimer->setInterval(25);
@@ -252,9 +342,12 @@ StelApp::~StelApp()
 {
 	qDebug() << qPrintable(QString("Downloaded %1 files (%2 kbytes) in a session of %3 sec (average of %4 kB/s + %5 files from cache (%6 kB)).").arg(nbDownloadedFiles).arg(totalDownloadedSize/1024).arg(getTotalRunTime()).arg((double)(totalDownloadedSize/1024)/getTotalRunTime()).arg(nbUsedCache).arg(totalUsedCacheSize/1024));
 
+	// Close the captured session while the core and the actions it listens to exist
+	delete sessionRecorder; sessionRecorder=NULL;
 	stelObjectMgr->unSelect();
 	moduleMgr->unloadModule("StelSkyLayerMgr", false);  // We need to delete it afterward
 	moduleMgr->unloadModule("StelObjectMgr", false);// We need to delete it afterward
+	moduleMgr->unloadModule("StelVideoMgr", false);  // We need to delete it afterward
 	StelModuleMgr* tmp = moduleMgr;
 	moduleMgr = new StelModuleMgr(); // Create a secondary instance to avoid crashes at other deinit
 	delete tmp; tmp=NULL;
@@ -269,13 +362,29 @@ StelApp::~StelApp()
 	delete planetLocationMgr; planetLocationMgr=NULL;
 	delete moduleMgr; moduleMgr=NULL; // Delete the secondary instance
 	delete actionMgr; actionMgr = NULL;
+	delete jobSystem; jobSystem = NULL;
+	delete renderStats; renderStats = NULL;
+	delete memoryStats; memoryStats = NULL;
+	delete renderProfile; renderProfile = NULL;
 
 	Q_ASSERT(singleton);
 	singleton = NULL;
 }
 
-void StelApp::setupHttpProxy()
+void StelApp::setupNetwork()
 {
+	// All the downloads share this manager, so that they share its connections to the servers and its
+	// cache. The cache sends conditional requests for the expired files and is bounded in size.
+	networkAccessManager = new QNetworkAccessManager(this);
+	QNetworkDiskCache* cache = new QNetworkDiskCache(networkAccessManager);
+	QString cachePath = StelFileMgr::getCacheDir();
+
+	qDebug() << "Cache directory is: " << QDir::toNativeSeparators(cachePath);
+	cache->setCacheDirectory(cachePath);
+	cache->setMaximumCacheSize(confSettings->value("main/network_cache_size", 100).toLongLong()*1024*1024);
+	networkAccessManager->setCache(cache);
+	connect(networkAccessManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(reportFileDownloadFinished(QNetworkReply*)));
+
 	QString proxyHost = confSettings->value("proxy/host_name").toString();
 	QString proxyPort = confSettings->value("proxy/port").toString();
 	QString proxyUser = confSettings->value("proxy/user").toString();
@@ -347,6 +456,9 @@ void StelApp::initScriptMgr(QSettings *conf)
 	scriptAPIProxy = new StelMainScriptAPIProxy(this);
 	scriptMgr = new StelScriptMgr(this);
 	scriptMgr->addModules();
+	// The calls of the scripts are part of a replayed session
+	if (qApp->property("session_replay_file").isValid())
+		return;
 	QString startupScript;
 	if (qApp->property("onetime_startup_script").isValid())
 		startupScript = qApp->property("onetime_startup_script").toString();
@@ -365,26 +477,80 @@ void StelApp::initScriptMgr(QSettings *conf) {Q_UNUSED(conf);}
 void StelApp::init(QSettings* conf)
 {
 	confSettings = conf;
+	// Read first, the modules and the painters follow the profile
+	renderProfile = new StelRenderProfile(conf);
+	StelPainter::setFlagVertexBuffersOnly(renderProfile->getFlagVertexBuffersOnly());
 
 	devicePixelsPerPixel = QOpenGLContext::currentContext()->screen()->devicePixelRatio();
 	
+	flagStereoReprojection = conf->value("video/flag_stereo_reprojection", false).toBool();
+	stereoReprojectionMargin = conf->value("video/stereo_reprojection_margin", 64).toInt();
+	stereoFrameBudget = conf->value("video/stereo_frame_budget", 1./90.).toDouble();
+	headPosePrediction = conf->value("video/head_pose_prediction", 0.).toDouble();
+	// The lists may be read as a single string when they are not in the configuration file
+	const QStringList distortion = conf->value("video/stereo_lens_distortion", "1,0,0,0").toStringList().join(",").split(",");
+	for (int i=0; i<4; ++i)
+		stereoLensDistortion[i] = distortion.value(i, i==0 ? "1" : "0").toFloat();
+	const QStringList aberration = conf->value("video/stereo_chromatic_aberration", "1,1").toStringList().join(",").split(",");
+	for (int i=0; i<2; ++i)
+		stereoChromaticAberration[i] = aberration.value(i, "1").toFloat();
+	flagWarpMesh = conf->value("warp_mesh/flag_enabled", false).toBool();
+	flagIdleRedraw = conf->value("video/flag_idle_redraw", false).toBool();
+	idleRefreshPeriod = conf->value("video/idle_refresh_period", 10.).toDouble();
+	if (conf->value("video/flag_foveated_rendering", false).toBool())
+	{
+		foveatedRenderer = new StelFoveatedRenderer(conf->value("video/foveated_periphery_scale", 0.5).toFloat(),
+							    conf->value("video/foveated_inset_size", 0.4).toFloat());
+	}
+	if (conf->value("video/flag_dome_cubemap", false).toBool())
+		cubemapRenderer = new StelCubemapRenderer(conf->value("video/dome_cubemap_face_size", 0).toInt());
+	if (conf->value("video/flag_dynamic_resolution", false).toBool())
+	{
+		dynamicResolution = new StelDynamicResolution(conf->value("video/dynamic_resolution_budget", 0.014).toDouble(),
+							      conf->value("video/dynamic_resolution_min_scale", 0.5).toFloat(),
+							      conf->value("video/dynamic_resolution_sharpness", 0.2).toFloat());
+	}
+	if (conf->value("video/flag_temporal_antialiasing", false).toBool())
+		temporalAntialiasing = new StelTemporalAntialiasing(conf->value("video/temporal_antialiasing_feedback", 0.9).toFloat());
+	// The faces of the cube map are kept in the pool with the buffer in which they are resampled
+	viewportTargets = new StelRenderTargetPool(cubemapRenderer ? 12 : 6);
+	viewportTargets->setSamples(conf->value("video/viewport_samples", 0).toInt());
+
+	frameProfiler = new StelFrameProfiler(conf->value("main/frame_profiler_frames", 120).toInt());
+	frameProfiler->setEnabled(conf->value("main/flag_frame_profiler", false).toBool());
+	renderStats->setFlagOverlay(conf->value("main/flag_render_stats", false).toBool());
+	StelTracer::setEnabled(conf->value("main/flag_tracing", false).toBool());
+	frameRecorder = new StelFrameRecorder();
+	tiledCapture = new StelTiledCapture();
+	if (conf->value("video/flag_live_output", false).toBool())
+	{
+		liveOutput = new StelLiveOutput(conf->value("video/live_output_command").toString(),
+						QSize(conf->value("video/live_output_width", 0).toInt(), conf->value("video/live_output_height", 0).toInt()),
+						conf->value("video/live_output_fps", 30.).toDouble());
+	}
+
+	// The modules reading large files do it on worker threads while the other ones are initialized
+	flagParallelInit = conf->value("main/flag_parallel_init", true).toBool();
+	flagDeferredInit = conf->value("main/flag_deferred_init", true).toBool();
+	flagParallelUpdate = conf->value("main/flag_parallel_update", true).toBool();
+	NebulaMgr* nebulas = new NebulaMgr();
+	startPreload(nebulas);
+
 	core = new StelCore();
 	if (saveProjW!=-1 && saveProjH!=-1)
-		core->windowHasBeenResized(0, 0, saveProjW, saveProjH);
+		updateStereoViewport();
+	multiViewport = new StelMultiViewport(conf, core);
+	if (!multiViewport->isValid())
+	{
+		delete multiViewport;
+		multiViewport = NULL;
+	}
 
 	// Initialize AFTER creation of openGL context
 	textureMgr = new StelTextureMgr();
 	textureMgr->init();
 
-	networkAccessManager = new QNetworkAccessManager(this);
-	// Activate http cache if Qt version >= 4.5
-	QNetworkDiskCache* cache = new QNetworkDiskCache(networkAccessManager);
-	QString cachePath = StelFileMgr::getCacheDir();
-
-	qDebug() << "Cache directory is: " << QDir::toNativeSeparators(cachePath);
-	cache->setCacheDirectory(cachePath);
-	networkAccessManager->setCache(cache);
-	connect(networkAccessManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(reportFileDownloadFinished(QNetworkReply*)));
+	setupNetwork();
 
 	// Stel Object Data Base manager
 	stelObjectMgr = new StelObjectMgr();
@@ -410,9 +576,16 @@ void StelApp::init(QSettings* conf)
 
 	core->init();
 
+	// The head tracker is read at its own rate, its latest pose is latched at each frame
+	if (conf->value("sensors/flag_enabled", false).toBool())
+	{
+		sensorInput = new StelSensorInput(conf);
+		sensorInput->start(QThread::HighestPriority);
+		core->getMovementMgr()->setHeadPoseProvider(sensorInput);
+	}
+
 	// Init nebulas
-	NebulaMgr* nebulas = new NebulaMgr();
-	nebulas->init();
+	initModule(nebulas);
 	getModuleMgr().registerModule(nebulas);
 
 	// Init milky way
@@ -428,9 +601,6 @@ void StelApp::init(QSettings* conf)
 	// Init audio manager
 	audioMgr = new StelAudioMgr();
 
-	// Init video manager
-	videoMgr = new StelVideoMgr();
-
 	// Constellations
 	ConstellationMgr* asterisms = new ConstellationMgr(hip_stars);
 	asterisms->init();
@@ -455,6 +625,11 @@ void StelApp::init(QSettings* conf)
 	skyLabels->init();
 	getModuleMgr().registerModule(skyLabels);
 
+	// Init video manager, drawn over the landscape
+	videoMgr = new StelVideoMgr();
+	videoMgr->init();
+	getModuleMgr().registerModule(videoMgr);
+
 	skyCultureMgr->init();
 
 	initScriptMgr(conf);
@@ -463,13 +638,15 @@ void StelApp::init(QSettings* conf)
 	emit colorSchemeChanged("color");
 	setVisionModeNight(confSettings->value("viewing/flag_night").toBool());
 
-	// Proxy Initialisation
-	setupHttpProxy();
 	updateI18n();
 
 	// Init actions.
 	actionMgr->addAction("actionShow_Night_Mode", N_("Display Options"), N_("Night mode"), this, "nightMode");
 
+	// Started before the startup script, so that its calls are recorded
+	if (qApp->property("session_capture_file").isValid())
+		sessionRecorder->startCapture(qApp->property("session_capture_file").toString());
+
 	initialized = true;
 }
 
@@ -478,6 +655,7 @@ void StelApp::initPlugIns()
 {
 	// Load dynamically all the modules found in the modules/ directories
 	// which are configured to be loaded at startup
+	QList<StelModule*> plugins;
 	foreach (StelModuleMgr::PluginDescriptor i, moduleMgr->getPluginsList())
 	{
 		if (i.loadAtStartup==false)
@@ -486,9 +664,50 @@ void StelApp::initPlugIns()
 		if (m!=NULL)
 		{
 			moduleMgr->registerModule(m, true);
-			m->init();
+			startPreload(m);
+			plugins << m;
 		}
 	}
+	// Initialize them in the same order, the data of the next ones being loaded meanwhile
+	foreach (StelModule* m, plugins)
+		initModule(m);
+}
+
+void StelApp::startPreload(StelModule* module)
+{
+	if (flagParallelInit)
+		modulePreloads.insert(module, QtConcurrent::run(module, &StelModule::preload));
+}
+
+void StelApp::initModule(StelModule* module)
+{
+	if (modulePreloads.contains(module))
+		modulePreloads.take(module).waitForFinished();
+	else
+		module->preload();
+	module->init();
+	if (flagDeferredInit)
+		deferredInits << module;
+	else
+		module->deferredInit();
+}
+
+void StelApp::finishDeferredInit(StelModule* module)
+{
+	if (deferredInits.removeOne(module))
+	{
+		module->deferredInit();
+		markFrameDirty();
+	}
+}
+
+void StelApp::runNextDeferredInit()
+{
+	StelModule* module = deferredInits.takeFirst();
+	STEL_TRACE_SCOPE("StelApp::runNextDeferredInit");
+	module->deferredInit();
+	// The module may show new objects
+	markFrameDirty();
 }
 
 void StelApp::deinit()
@@ -497,9 +716,46 @@ void StelApp::deinit()
 	if (scriptMgr->scriptIsRunning())
 		scriptMgr->stopScript();
 #endif
+	deferredInits.clear();
+	// The searches of names running in the background read the modules
+	stelObjectMgr->waitPendingSearches();
 	QCoreApplication::processEvents();
 	getModuleMgr().unloadAllPlugins();
 	QCoreApplication::processEvents();
+
+	if (sensorInput)
+	{
+		core->getMovementMgr()->setHeadPoseProvider(NULL);
+		delete sensorInput;
+		sensorInput = NULL;
+	}
+	delete foveatedRenderer;
+	foveatedRenderer = NULL;
+	delete cubemapRenderer;
+	cubemapRenderer = NULL;
+	delete multiViewport;
+	multiViewport = NULL;
+	delete dynamicResolution;
+	dynamicResolution = NULL;
+	delete temporalAntialiasing;
+	temporalAntialiasing = NULL;
+	delete viewportTargets;
+	viewportTargets = NULL;
+	viewportFbo = NULL;
+	delete stereoEffect;
+	stereoEffect = NULL;
+	delete warpEffect;
+	warpEffect = NULL;
+	delete idleEffect;
+	idleEffect = NULL;
+	delete frameProfiler;
+	frameProfiler = NULL;
+	delete frameRecorder;
+	frameRecorder = NULL;
+	delete tiledCapture;
+	tiledCapture = NULL;
+	delete liveOutput;
+	liveOutput = NULL;
 	
 	StelPainter::deinitGLShaders();
 }
@@ -525,7 +781,41 @@ void StelApp::update(double deltaTime)
 {
 	if (!initialized)
 		return;
+	STEL_TRACE_SCOPE("StelApp::update");
 
+	// While recording, a frame is only rendered when a script waits for it, and the clock
+	// advances by the duration of a frame of the sequence whatever the time taken to render it.
+	flagRecordFrame = false;
+	flagSkipFrame = false;
+	if (frameRecorder->isRecording())
+	{
+		if (!frameRecorder->hasPendingFrames())
+		{
+#ifndef DISABLE_SCRIPTING
+			scriptMgr->processScriptCommands();
+#endif
+			flagSkipFrame = true;
+			return;
+		}
+		flagRecordFrame = true;
+		deltaTime = frameRecorder->getFrameDuration();
+		if (fixedRunTime<0.)
+			fixedRunTime = getTotalRunTime();
+		fixedRunTime += deltaTime;
+	}
+	else if (fixedRunTime>=0.)
+	{
+		frameRecorder->releaseBuffers();
+		// Go on from the time reached by the recording
+		runTimeOffset = fixedRunTime - qtime->elapsed()/1000.;
+		fixedRunTime = -1.;
+		// The buffers of the viewport effects still hold the view of before the recording
+		updateStereoViewport();
+	}
+
+	sessionRecorder->beginFrame(deltaTime);
+
+	frameStartTime = getTotalRunTime();
 	++frame;
 	timefr+=deltaTime;
 	if (timefr-timeBase > 1.)
@@ -536,17 +826,111 @@ void StelApp::update(double deltaTime)
 		timeBase+=1.;
 	}
 		
+#ifndef DISABLE_SCRIPTING
+	// Apply the calls done by the running script since the last frame. When recording, this
+	// has to be done after checking for pending frames, so that the calls done before a wait are
+	// applied to the frames rendered for it.
+	scriptMgr->processScriptCommands();
+	sessionRecorder->replayScriptCommands();
+#endif
+
+	// The work queued for the main thread by the workers, e.g. the loaded tiles to apply
+	static const int mainThreadJobsBudgetMs = 4;
+	jobSystem->runMainThreadJobs(mainThreadJobsBudgetMs);
+
+	frameProfiler->beginFrame();
+	frameProfiler->beginSection("StelCore", false);
 	core->update(deltaTime);
+	frameProfiler->endSection();
 
 	moduleMgr->update();
 
 	// Send the event to every StelModule
-	foreach (StelModule* i, moduleMgr->getCallOrders(StelModule::ActionUpdate))
+	updateModules(deltaTime);
+
+	frameProfiler->beginSection("StelObjectMgr", false);
+	stelObjectMgr->update(deltaTime);
+	frameProfiler->endSection();
+
+	sessionRecorder->endFrame();
+}
+
+// A module updated by StelApp::updateModulesInParallel(), and the time it took.
+struct ParallelModuleUpdate
+{
+	StelModule* module;
+	float ms;
+};
+
+// Run the update of one module on the thread pool.
+struct ParallelModuleUpdater
+{
+	double deltaTime;
+	void operator()(ParallelModuleUpdate& moduleUpdate) const
 	{
-		i->update(deltaTime);
+		STEL_TRACE_SCOPE_DETAIL("update", moduleUpdate.module->objectName());
+		QElapsedTimer timer;
+		timer.start();
+		moduleUpdate.module->update(deltaTime);
+		moduleUpdate.ms = timer.nsecsElapsed()/1e6f;
 	}
+};
 
-	stelObjectMgr->update(deltaTime);
+void StelApp::updateModules(double deltaTime)
+{
+	QList<StelModule*> batch;
+	int batchReads = 0;
+	int batchWrites = 0;
+	foreach (StelModule* module, moduleMgr->getCallOrders(StelModule::ActionUpdate))
+	{
+		const StelModule::UpdateDependencies deps = flagParallelUpdate ? module->getUpdateDependencies() : StelModule::UpdateDependencies();
+		// A module joins the batch when it doesn't use the data written by the others, nor writes the data they use
+		if (!deps.parallel || (deps.writes & (batchReads|batchWrites)) || (deps.reads & batchWrites))
+		{
+			updateModulesInParallel(batch, deltaTime);
+			batch.clear();
+			batchReads = 0;
+			batchWrites = 0;
+		}
+		if (deps.parallel)
+		{
+			batch << module;
+			batchReads |= deps.reads;
+			batchWrites |= deps.writes;
+			continue;
+		}
+		// A serial module is updated after the ones called before it, and before the ones called after it
+		STEL_TRACE_SCOPE_DETAIL("update", module->objectName());
+		frameProfiler->beginSection(module->objectName(), false);
+		module->update(deltaTime);
+		frameProfiler->endSection();
+	}
+	updateModulesInParallel(batch, deltaTime);
+}
+
+void StelApp::updateModulesInParallel(const QList<StelModule*>& modules, double deltaTime)
+{
+	if (modules.isEmpty())
+		return;
+	if (modules.size()==1)
+	{
+		STEL_TRACE_SCOPE_DETAIL("update", modules.first()->objectName());
+		frameProfiler->beginSection(modules.first()->objectName(), false);
+		modules.first()->update(deltaTime);
+		frameProfiler->endSection();
+		return;
+	}
+
+	QVector<ParallelModuleUpdate> updates;
+	foreach (StelModule* module, modules)
+	{
+		const ParallelModuleUpdate moduleUpdate = {module, 0.f};
+		updates << moduleUpdate;
+	}
+	const ParallelModuleUpdater updater = {deltaTime};
+	jobSystem->blockingMap(updates, updater);
+	foreach (const ParallelModuleUpdate& moduleUpdate, updates)
+		frameProfiler->addSectionTime(moduleUpdate.module->objectName(), false, moduleUpdate.ms);
 }
 
 //! Main drawing function called at each frame
@@ -554,14 +938,464 @@ void StelApp::draw()
 {
 	if (!initialized)
 		return;
+	STEL_TRACE_SCOPE("StelApp::draw");
+
+	// The heavy part of the initialization of the modules waits for the first frame
+	if (!deferredInits.isEmpty() && drawnTime>0.)
+		runNextDeferredInit();
+
+	// Show the last recorded frame while the script prepares the next ones
+	if (flagSkipFrame)
+	{
+		frameRecorder->paintPreview(core);
+		return;
+	}
+
+	// In the idle redraw mode, a frame in which nothing changed presents the last one again
+	if (flagIdleRedraw && !flagRecordFrame && viewportFbo && !isFrameDirty())
+	{
+		if (stereoEffect)
+			stereoEffect->paintViewportBuffer(viewportFbo);
+		else if (warpEffect)
+			warpEffect->paintViewportBuffer(viewportFbo);
+		else if (idleEffect)
+			idleEffect->paintViewportBuffer(viewportFbo);
+		frameProfiler->endFrame();
+		frameProfiler->drawOverlay(core);
+		renderStats->endFrame();
+		renderStats->drawOverlay(core);
+		if (liveOutput)
+			liveOutput->captureFrame(QSize(qRound(windowXywh[2]*devicePixelsPerPixel), qRound(windowXywh[3]*devicePixelsPerPixel)), getTotalRunTime());
+		return;
+	}
+
+	// Upload the textures loaded in the background threads within the budget of the frame
+	textureMgr->update();
+
+	if (core->getStereoMode()!=appliedStereoMode || core->getStereoLensOffset()!=appliedStereoLensOffset)
+		updateStereoViewport();
+
+	// The tiled capture is drawn before the frame, which then shows the view of the window again
+	if (tiledCapture->isPending())
+		drawTiledCapture();
+
+	// The recorded frames are drawn in the buffer of the recorder instead of the window
+	const StelProjector::StelProjectorParams windowParams = core->getCurrentStelProjectorParams();
+	const bool recordFrame = flagRecordFrame && frameRecorder->beginFrame(core);
+
+	// In stereo mode the modules are drawn only once in a buffer which is then presented to both eyes.
+	// With the warp meshes the buffer is the fisheye view presented to all the projectors.
+	// The buffers are kept in a pool so that switching the effect or resizing the window back does not reallocate them.
+	QOpenGLFramebufferObject* renderTarget = NULL;
+	if ((stereoEffect || warpEffect || idleEffect) && !recordFrame)
+	{
+		viewportFbo = NULL;
+		viewportTargets->beginFrame();
+		if (stereoEffect)
+			renderTarget = viewportTargets->acquire(stereoEffect->getBufferSize());
+		else if (warpEffect)
+			renderTarget = viewportTargets->acquire(warpEffect->getBufferSize());
+		else
+			renderTarget = viewportTargets->acquire(QSize(windowXywh[2], windowXywh[3]));
+	}
+
+	// Latch the head pose as late as possible to reduce the motion to photon latency
+	StelMovementMgr* movementMgr = core->getMovementMgr();
+	movementMgr->latchHeadPose(getTotalRunTime()+headPosePrediction);
+	if (stereoEffect)
+	{
+		renderedHeadPose[0] = movementMgr->getLatchedHeadPose()[0];
+		renderedHeadPose[1] = movementMgr->getLatchedHeadPose()[1];
+		renderedPixelPerRad = core->getProjection(StelCore::FrameJ2000)->getPixelPerRadAtCenter();
+		stereoEffect->setReprojectionShift(0.f, 0.f);
+	}
+
+	// The fisheye view can be drawn from the faces of a cube map, and the fill cost of the effect buffers
+	// is reduced by drawing most of them at a lower resolution
+	if (dynamicResolution && renderTarget)
+		dynamicResolution->beginGpuTime();
+	// Each frame samples the pixels at another position, the frames are accumulated once resolved
+	if (temporalAntialiasing && renderTarget)
+	{
+		const Vec2f jitter = temporalAntialiasing->getJitter();
+		StelProjector::setSubpixelJitter(jitter[0], jitter[1]);
+	}
+	bool drawn = false;
+	if (renderTarget && cubemapRenderer && core->getCurrentProjectionType()==StelCore::ProjectionFisheye)
+		drawn = drawCubemap(renderTarget);
+	if (renderTarget && foveatedRenderer && !drawn)
+		drawn = drawFoveated(renderTarget);
+	if (renderTarget && dynamicResolution && !drawn)
+		drawn = drawScaled(renderTarget);
+	if (!renderTarget && multiViewport && !recordFrame)
+	{
+		drawMultiViewport();
+		drawn = true;
+	}
+	if (!drawn)
+	{
+		if (renderTarget)
+			renderTarget->bind();
+		drawModules();
+	}
+	if (dynamicResolution && renderTarget)
+		dynamicResolution->endGpuTime();
+	StelProjector::setSubpixelJitter(0.f, 0.f);
+	frameProfiler->endFrame();
+	frameProfiler->drawOverlay(core);
+	renderStats->endFrame();
+	renderStats->drawOverlay(core);
+
+	if (recordFrame)
+	{
+		frameRecorder->endFrame();
+		// Only the viewport is restored, the viewport effects and their buffers are kept for the end of the recording
+		const Vector4<int>& xywh = windowParams.viewportXywh;
+		core->windowHasBeenResized(xywh[0], xywh[1], xywh[2], xywh[3]);
+		StelProjector::StelProjectorParams params = core->getCurrentStelProjectorParams();
+		params.viewportCenter = windowParams.viewportCenter;
+		params.viewportFovDiameter = windowParams.viewportFovDiameter;
+		core->setCurrentStelProjectorParams(params);
+		frameRecorder->paintPreview(core);
+	}
+	else if (renderTarget)
+	{
+		renderTarget->release();
+		// A multisampled buffer is resolved in a texture, else the effect samples the buffer directly
+		viewportFbo = viewportTargets->resolve(renderTarget);
+		if (viewportFbo && temporalAntialiasing)
+			viewportFbo = temporalAntialiasing->resolve(viewportFbo, core);
+		if (viewportFbo && stereoEffect)
+			stereoEffect->paintViewportBuffer(viewportFbo);
+		else if (viewportFbo && warpEffect)
+			warpEffect->paintViewportBuffer(viewportFbo);
+		else if (viewportFbo)
+			idleEffect->paintViewportBuffer(viewportFbo);
+	}
+	// The stream gets the final frame of the window, after the viewport effects
+	if (liveOutput && !recordFrame)
+		liveOutput->captureFrame(QSize(qRound(windowXywh[2]*devicePixelsPerPixel), qRound(windowXywh[3]*devicePixelsPerPixel)), getTotalRunTime());
+	lastFrameDuration = getTotalRunTime()-frameStartTime;
+	lastFrameReprojected = false;
+
+	// Remember the state of the frame for the idle redraw mode
+	const StelMovementMgr* mvmgr = core->getMovementMgr();
+	const Vec3d& viewDirection = mvmgr->getViewDirectionJ2000();
+	drawnTime = getTotalRunTime();
+	drawnJD = core->getJDay();
+	drawnFov = mvmgr->getCurrentFov();
+	drawnViewDirection[0] = viewDirection[0];
+	drawnViewDirection[1] = viewDirection[1];
+	drawnViewDirection[2] = viewDirection[2];
+	drawnFaderTransitions = StelFader::getTransitionCounter();
+	flagFrameDirty = false;
+}
+
+void StelApp::markFrameDirty(double duration)
+{
+	flagFrameDirty = true;
+	dirtyUntil = qMax(dirtyUntil, getTotalRunTime()+duration);
+}
+
+bool StelApp::isFrameDirty() const
+{
+	const double now = getTotalRunTime();
+	if (flagFrameDirty || now<dirtyUntil || now-drawnTime>idleRefreshPeriod)
+		return true;
+	if (StelFader::getTransitionCounter()!=drawnFaderTransitions || textureMgr->getNbPendingUploads()>0)
+		return true;
+#ifndef DISABLE_SCRIPTING
+	if (scriptMgr->scriptIsRunning())
+		return true;
+#endif
+	const StelSkyDrawer* skyDrawer = core->getSkyDrawer();
+	if (skyDrawer->getFlagTwinkle() && skyDrawer->getFlagHasAtmosphere())
+		return true;
+
+	const StelMovementMgr* mvmgr = core->getMovementMgr();
+	if (mvmgr->getCurrentFov()!=drawnFov)
+		return true;
+	// Motion of the sky in pixels at the center of the view, by the rotation of the Earth and the change of the view direction
+	const Vec3d& viewDirection = mvmgr->getViewDirectionJ2000();
+	const Vec3d drawnDirection(drawnViewDirection[0], drawnViewDirection[1], drawnViewDirection[2]);
+	const double rotation = std::fabs(core->getJDay()-drawnJD)*2.*M_PI*1.00273790935;
+	const double pixelPerRad = core->getProjection(StelCore::FrameJ2000)->getPixelPerRadAtCenter();
+	return (rotation+(viewDirection-drawnDirection).length())*pixelPerRad>0.5;
+}
+
+void StelApp::drawModules()
+{
+	frameProfiler->beginSection("StelCore", true);
 	core->preDraw();
+	frameProfiler->endSection();
 
 	const QList<StelModule*> modules = moduleMgr->getCallOrders(StelModule::ActionDraw);
 	foreach(StelModule* module, modules)
 	{
+		STEL_TRACE_SCOPE_DETAIL("draw", module->objectName());
+		frameProfiler->beginSection(module->objectName(), true);
 		module->draw(core);
+		frameProfiler->endSection();
 	}
+
+	frameProfiler->beginSection("StelCore", true);
 	core->postDraw();
+	frameProfiler->endSection();
+}
+
+bool StelApp::drawFoveated(QOpenGLFramebufferObject* renderTarget)
+{
+	const QSize bufferSize = renderTarget->size();
+	const QRect insetRect = foveatedRenderer->getInsetRect(bufferSize);
+	QOpenGLFramebufferObject* peripheryTarget = viewportTargets->acquire(foveatedRenderer->getPeripherySize(bufferSize));
+	QOpenGLFramebufferObject* insetTarget = viewportTargets->acquire(insetRect.size());
+	if (!peripheryTarget || !insetTarget)
+		return false;
+
+	// Both passes use the projection of the whole buffer, only the region drawn in the buffers changes
+	peripheryTarget->bind();
+	StelPainter::setRenderRegion(0.f, 0.f, foveatedRenderer->getPeripheryScale());
+	drawModules();
+	peripheryTarget->release();
+	insetTarget->bind();
+	StelPainter::setRenderRegion(insetRect.x(), insetRect.y(), 1.f);
+	drawModules();
+	insetTarget->release();
+	StelPainter::setRenderRegion(0.f, 0.f, 1.f);
+
+	const QOpenGLFramebufferObject* periphery = viewportTargets->resolve(peripheryTarget);
+	const QOpenGLFramebufferObject* inset = viewportTargets->resolve(insetTarget);
+	renderTarget->bind();
+	if (periphery && inset)
+		foveatedRenderer->composite(periphery, inset, bufferSize);
+	return true;
+}
+
+bool StelApp::drawCubemap(QOpenGLFramebufferObject* renderTarget)
+{
+	const QSize bufferSize = renderTarget->size();
+	const StelProjector::StelProjectorParams params = core->getCurrentStelProjectorParams();
+	const int faceSize = cubemapRenderer->getFaceSize(params);
+	const int faceDeviceSize = qRound(faceSize*params.devicePixelsPerPixel);
+	const bool halfFaces = StelCubemapRenderer::useHalfFaces(params, bufferSize);
+	const StelProjector::StelProjectorParams faceParams = StelCubemapRenderer::getFaceParams(params, faceSize);
+	QOpenGLFramebufferObject* faceTargets[StelCubemapRenderer::NbFaces];
+	QRect faceRects[StelCubemapRenderer::NbFaces];
+	for (int i=0; i<StelCubemapRenderer::NbFaces; ++i)
+	{
+		faceRects[i] = StelCubemapRenderer::getFaceRect((StelCubemapRenderer::Face)i, faceDeviceSize, halfFaces);
+		faceTargets[i] = viewportTargets->acquire(faceRects[i].size());
+		if (!faceTargets[i])
+			return false;
+	}
+
+	// Each face only draws its region of the full face projection
+	for (int i=0; i<StelCubemapRenderer::NbFaces; ++i)
+	{
+		faceTargets[i]->bind();
+		StelPainter::setRenderRegion(faceRects[i].x(), faceRects[i].y(), 1.f);
+		core->beginView(StelCubemapRenderer::getFaceRotation((StelCubemapRenderer::Face)i), StelCore::ProjectionPerspective, faceParams);
+		drawModules();
+		core->endView();
+		faceTargets[i]->release();
+	}
+	StelPainter::setRenderRegion(0.f, 0.f, 1.f);
+
+	const QOpenGLFramebufferObject* faces[StelCubemapRenderer::NbFaces];
+	for (int i=0; i<StelCubemapRenderer::NbFaces; ++i)
+	{
+		faces[i] = viewportTargets->resolve(faceTargets[i]);
+		if (!faces[i])
+			return true;
+	}
+	renderTarget->bind();
+	glClearColor(0,0,0,0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	cubemapRenderer->resample(faces, faceDeviceSize, halfFaces, params, bufferSize);
+	return true;
+}
+
+void StelApp::drawTiledCapture()
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	const int tileSize = qMin(tiledCapture->getTileSize(), (int)maxSize);
+	QOpenGLFramebufferObject fbo(tileSize, tileSize, QOpenGLFramebufferObject::CombinedDepthStencil);
+	if (!fbo.isValid())
+	{
+		qWarning() << "ERROR: can't create a framebuffer of" << tileSize << "pixels for the tiled capture";
+		tiledCapture->finish();
+		return;
+	}
+
+	const int nbRows = tiledCapture->getNbRows();
+	const int nbColumns = tiledCapture->getNbColumns();
+	bool ok = true;
+	for (int v=0; v<tiledCapture->getNbViews() && ok; ++v)
+	{
+		Mat4d rotation;
+		StelCore::ProjectionType type;
+		StelProjector::StelProjectorParams params;
+		tiledCapture->getView(v, core, rotation, type, params);
+		ok = tiledCapture->beginView(v);
+		// Each tile is the region of the projection of the whole image drawn in the framebuffer
+		for (int row=0; row<nbRows && ok; ++row)
+		{
+			for (int column=0; column<nbColumns && ok; ++column)
+			{
+				const QRect rect = tiledCapture->getTileRect(row, column);
+				fbo.bind();
+				StelProjector::setRenderTile(Vec4i(rect.x(), rect.y(), rect.width(), rect.height()));
+				core->beginView(rotation, type, params);
+				drawModules();
+				core->endView();
+				StelProjector::setRenderTile(Vec4i(0, 0, 0, 0));
+
+				QImage tile(rect.size(), QImage::Format_RGB32);
+				glPixelStorei(GL_PACK_ALIGNMENT, 4);
+				glReadPixels(0, 0, rect.width(), rect.height(), GL_BGRA, GL_UNSIGNED_BYTE, tile.bits());
+				fbo.release();
+				ok = tiledCapture->writeTile(row, column, tile.mirrored());
+			}
+		}
+		tiledCapture->endView();
+	}
+	tiledCapture->finish();
+	qDebug() << (ok ? "INFO: tiled capture written" : "ERROR: the tiled capture was not completed");
+}
+
+bool StelApp::drawScaled(QOpenGLFramebufferObject* renderTarget)
+{
+	const float scale = dynamicResolution->getScale();
+	if (scale>=1.f)
+		return false;
+	const QSize bufferSize = renderTarget->size();
+	QOpenGLFramebufferObject* scaledTarget = viewportTargets->acquire(dynamicResolution->getScaledSize(bufferSize));
+	if (!scaledTarget)
+		return false;
+
+	// The projection is the one of the whole buffer, drawn at a lower resolution
+	scaledTarget->bind();
+	StelPainter::setRenderRegion(0.f, 0.f, scale);
+	drawModules();
+	scaledTarget->release();
+	StelPainter::setRenderRegion(0.f, 0.f, 1.f);
+
+	const QOpenGLFramebufferObject* scaled = viewportTargets->resolve(scaledTarget);
+	renderTarget->bind();
+	if (scaled)
+		dynamicResolution->upscale(scaled, bufferSize);
+	return true;
+}
+
+void StelApp::drawMultiViewport()
+{
+	const StelProjector::StelProjectorParams mainParams = core->getCurrentStelProjectorParams();
+	const float dpp = mainParams.devicePixelsPerPixel;
+	const StelProjector::ModelViewTranformP identity(new StelProjector::Mat4dTransform(Mat4d::identity()));
+	// The views are cleared and drawn one after the other in the same window
+	glClearColor(0,0,0,0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glEnable(GL_SCISSOR_TEST);
+	for (int i=0; i<multiViewport->getNbViews(); ++i)
+	{
+		const StelCore::ProjectionType type = multiViewport->getViewProjectionType(i, core->getCurrentProjectionType());
+		StelProjector::StelProjectorParams params = multiViewport->getViewParams(i, mainParams, qRound(windowXywh[3]));
+		params.fov = qMin(params.fov, (float)core->getProjection(identity, type)->getMaxFov());
+		const QRect rect = multiViewport->getViewRect(i, qRound(windowXywh[3]));
+		glScissor(qRound(rect.x()*dpp), qRound(rect.y()*dpp), qRound(rect.width()*dpp), qRound(rect.height()*dpp));
+		core->beginView(multiViewport->getViewRotation(i), type, params);
+		drawModules();
+		core->endView();
+	}
+	glDisable(GL_SCISSOR_TEST);
+}
+
+void StelApp::setGazePosition(float x, float y)
+{
+	if (foveatedRenderer)
+		foveatedRenderer->setGazePosition(x, y);
+}
+
+bool StelApp::drawReprojectedFrame()
+{
+	if (!initialized || !stereoEffect || !viewportFbo || !flagStereoReprojection)
+		return false;
+	StelMovementMgr* movementMgr = core->getMovementMgr();
+	if (!movementMgr->hasHeadPoseProvider())
+		return false;
+	// Never reproject twice in a row, so that the scene keeps being updated at least at half the display rate
+	if (lastFrameReprojected || lastFrameDuration<=stereoFrameBudget)
+		return false;
+
+	movementMgr->latchHeadPose(getTotalRunTime()+headPosePrediction);
+	const Vec3d& pose = movementMgr->getLatchedHeadPose();
+	stereoEffect->setReprojectionShift((pose[0]-renderedHeadPose[0])*renderedPixelPerRad, (pose[1]-renderedHeadPose[1])*renderedPixelPerRad);
+	stereoEffect->paintViewportBuffer(viewportFbo);
+	lastFrameReprojected = true;
+	return true;
+}
+
+void StelApp::updateStereoViewport()
+{
+	appliedStereoMode = core->getStereoMode();
+	appliedStereoLensOffset = core->getStereoLensOffset();
+	delete stereoEffect;
+	stereoEffect = NULL;
+	delete warpEffect;
+	warpEffect = NULL;
+	delete idleEffect;
+	idleEffect = NULL;
+	// The last frame was drawn for the previous effect, it can not be reprojected
+	viewportFbo = NULL;
+	if (temporalAntialiasing)
+		temporalAntialiasing->reset();
+
+	// The window size is not known yet, it will be set by the next call to glWindowHasBeenResized()
+	if (windowXywh[2]<=0.f || windowXywh[3]<=0.f)
+		return;
+
+	if (appliedStereoMode==StelCore::StereoNone && flagWarpMesh)
+	{
+		warpEffect = new StelViewportWarpMesh(windowXywh[2], windowXywh[3]);
+		if (warpEffect->isValid())
+		{
+			// The whole buffer is the fisheye disk sampled by the meshes
+			const QSize bufferSize = warpEffect->getBufferSize();
+			core->windowHasBeenResized(0, 0, bufferSize.width(), bufferSize.height());
+			StelProjector::StelProjectorParams params = core->getCurrentStelProjectorParams();
+			params.viewportFovDiameter = bufferSize.width();
+			core->setCurrentStelProjectorParams(params);
+			return;
+		}
+		delete warpEffect;
+		warpEffect = NULL;
+	}
+
+	if (appliedStereoMode==StelCore::StereoNone)
+	{
+		// In the idle redraw mode the sky is drawn in a buffer which can be presented again,
+		// the cube map faces are resampled, the scaled sky is upscaled and the frames are accumulated
+		// from such a buffer too
+		if (flagIdleRedraw || cubemapRenderer || dynamicResolution || temporalAntialiasing)
+		{
+			idleEffect = new StelViewportEffect();
+			core->windowHasBeenResized(0, 0, windowXywh[2], windowXywh[3]);
+			return;
+		}
+		core->windowHasBeenResized(windowXywh[0], windowXywh[1], windowXywh[2], windowXywh[3]);
+		return;
+	}
+
+	stereoEffect = new StelViewportStereoSideBySide(windowXywh[2], windowXywh[3], appliedStereoLensOffset, flagStereoReprojection ? stereoReprojectionMargin : 0,
+							Vec4f(stereoLensDistortion[0], stereoLensDistortion[1], stereoLensDistortion[2], stereoLensDistortion[3]),
+							Vec2f(stereoChromaticAberration[0], stereoChromaticAberration[1]));
+	const QSize bufferSize = stereoEffect->getBufferSize();
+	core->windowHasBeenResized(0, 0, bufferSize.width(), bufferSize.height());
+	// Keep the angular scale of the eye view, the margin only widens the rendered field of view
+	StelProjector::StelProjectorParams params = core->getCurrentStelProjectorParams();
+	params.viewportFovDiameter = qMin(stereoEffect->getEyeSize().width(), stereoEffect->getEyeSize().height());
+	core->setCurrentStelProjectorParams(params);
 }
 
 /*************************************************************************
@@ -569,8 +1403,12 @@ void StelApp::draw()
 *************************************************************************/
 void StelApp::glWindowHasBeenResized(float x, float y, float w, float h)
 {
+	windowXywh[0] = x;
+	windowXywh[1] = y;
+	windowXywh[2] = w;
+	windowXywh[3] = h;
 	if (core)
-		core->windowHasBeenResized(x, y, w, h);
+		updateStereoViewport();
 	else
 	{
 		saveProjW = w;
@@ -581,6 +1419,8 @@ void StelApp::glWindowHasBeenResized(float x, float y, float w, float h)
 // Handle mouse clics
 void StelApp::handleClick(QMouseEvent* inputEvent)
 {
+	sessionRecorder->recordMouseEvent(inputEvent);
+	StelSessionRecorder::EventScope scope(sessionRecorder);
 	inputEvent->setAccepted(false);
 	
 	QMouseEvent event(inputEvent->type(), QPoint(inputEvent->pos().x()*devicePixelsPerPixel, inputEvent->pos().y()*devicePixelsPerPixel), inputEvent->button(), inputEvent->buttons(), inputEvent->modifiers());
@@ -624,19 +1464,30 @@ void StelApp::handleWheel(QWheelEvent* event)
 	// Reset the collected values
 	wheelEventDelta[deltaIndex] = 0;
 
+	dispatchWheel(&deltaEvent);
+	if (deltaEvent.isAccepted())
+		event->accept();
+}
+
+void StelApp::dispatchWheel(QWheelEvent* event)
+{
+	// The collected event is recorded, so that the replay does not depend on the timer
+	sessionRecorder->recordWheelEvent(event);
+	StelSessionRecorder::EventScope scope(sessionRecorder);
+
 	// Send the event to every StelModule
 	foreach (StelModule* i, moduleMgr->getCallOrders(StelModule::ActionHandleMouseClicks)) {
-		i->handleMouseWheel(&deltaEvent);
-		if (deltaEvent.isAccepted()) {
-			event->accept();
+		i->handleMouseWheel(event);
+		if (event->isAccepted())
 			break;
-		}
 	}
 }
 
 // Handle mouse move
 void StelApp::handleMove(int x, int y, Qt::MouseButtons b)
 {
+	sessionRecorder->recordMove(x, y, b);
+	StelSessionRecorder::EventScope scope(sessionRecorder);
 	// Send the event to every StelModule
 	foreach (StelModule* i, moduleMgr->getCallOrders(StelModule::ActionHandleMouseMoves))
 	{
@@ -648,6 +1499,8 @@ void StelApp::handleMove(int x, int y, Qt::MouseButtons b)
 // Handle key press and release
 void StelApp::handleKeys(QKeyEvent* event)
 {
+	sessionRecorder->recordKeyEvent(event);
+	StelSessionRecorder::EventScope scope(sessionRecorder);
 	event->setAccepted(false);
 	// First try to trigger a shortcut.
 	if (event->type() == QEvent::KeyPress)
@@ -670,6 +1523,8 @@ void StelApp::handleKeys(QKeyEvent* event)
 // Handle pinch on multi touch devices
 void StelApp::handlePinch(qreal scale, bool started)
 {
+	sessionRecorder->recordPinch(scale, started);
+	StelSessionRecorder::EventScope scope(sessionRecorder);
 	// Send the event to every StelModule
 	foreach (StelModule* i, moduleMgr->getCallOrders(StelModule::ActionHandleMouseMoves))
 	{
@@ -706,7 +1561,9 @@ void StelApp::updateSkyCulture()
 // Return the time since when stellarium is running in second.
 double StelApp::getTotalRunTime()
 {
-	return (double)(StelApp::qtime->elapsed())/1000.;
+	if (fixedRunTime>=0.)
+		return fixedRunTime;
+	return (double)(StelApp::qtime->elapsed())/1000. + runTimeOffset;
 }
 
 
@@ -725,10 +1582,10 @@ void StelApp::reportFileDownloadFinished(QNetworkReply* reply)
 	}
 }
 
-void StelApp::quit()
+void StelApp::quit(int exitCode)
 {
 	emit aboutToQuit();
-	QCoreApplication::exit(0);
+	QCoreApplication::exit(exitCode);
 }
 
 void StelApp::setDevicePixelsPerPixel(float dppp)
@@ -23,6 +23,8 @@
 #include "config.h"
 #include <QString>
 #include <QObject>
+#include <QFuture>
+#include <QHash>
 
 // Predeclaration of some classes
 class StelCore;
@@ -45,6 +47,27 @@ class StelMainScriptAPIProxy;
 class StelScriptMgr;
 class StelActionMgr;
 class StelProgressController;
+class StelViewportEffect;
+class StelViewportStereoSideBySide;
+class StelViewportWarpMesh;
+class StelRenderTargetPool;
+class StelFoveatedRenderer;
+class StelCubemapRenderer;
+class StelMultiViewport;
+class StelDynamicResolution;
+class StelTemporalAntialiasing;
+class StelSensorInput;
+class StelFrameProfiler;
+class StelFrameRecorder;
+class StelTiledCapture;
+class StelLiveOutput;
+class StelSessionRecorder;
+class StelRenderStats;
+class StelMemoryStats;
+class StelRenderProfile;
+class StelJobSystem;
+class StelModule;
+class QOpenGLFramebufferObject;
 
 //! @class StelApp
 //! Singleton main Stellarium application class.
@@ -65,6 +88,8 @@ class StelApp : public QObject
 public:
 	friend class StelAppGraphicsWidget;
 	friend class StelSkyItem;
+	// Replays the recorded input events
+	friend class StelSessionRecorder;
 
 	//! Create and initialize the main Stellarium application.
 	//! @param parent the QObject parent
@@ -84,6 +109,10 @@ public:
 	//! Load and initialize external modules (plugins)
 	void initPlugIns();
 
+	//! Run the deferred initialization of a module now if it is still pending, typically when the
+	//! module is first used before the frames which run the pending ones got to it.
+	void finishDeferredInit(StelModule* module);
+
 	//! Get the StelApp singleton instance.
 	//! @return the StelApp singleton instance
 	static StelApp& getInstance() {Q_ASSERT(singleton); return *singleton;}
@@ -128,7 +157,34 @@ public:
 	//! @return the StelCore instance of the program
 	StelCore* getCore() {return core;}
 
-	//! Get the common instance of QNetworkAccessManager used in stellarium
+	//! Get the profiler measuring the time spent by each module in the main loop.
+	StelFrameProfiler* getFrameProfiler() {return frameProfiler;}
+
+	//! Get the recorder used to render sequences of frames offline from scripts.
+	StelFrameRecorder* getFrameRecorder() {return frameRecorder;}
+
+	//! Get the capture of the still images larger than the window, drawn tile by tile.
+	StelTiledCapture* getTiledCapture() {return tiledCapture;}
+
+	//! Get the recorder capturing and replaying the sessions to reproduce the performance problems.
+	StelSessionRecorder* getSessionRecorder() {return sessionRecorder;}
+
+	//! Get the registry of the counters of the work done to render each frame.
+	StelRenderStats* getRenderStats() {return renderStats;}
+
+	//! Get the accounting of the memory held by each subsystem.
+	StelMemoryStats* getMemoryStats() {return memoryStats;}
+
+	//! Get the rendering profile selected at startup, e.g. for the low power devices.
+	const StelRenderProfile* getRenderProfile() const {return renderProfile;}
+
+	//! Get the job system running the parallel work of the modules on the shared thread pool.
+	StelJobSystem* getJobSystem() {return jobSystem;}
+
+	//! Get the common instance of QNetworkAccessManager used in stellarium.
+	//! It should be used for all the downloads, setting the priority of the requests
+	//! with QNetworkRequest::setPriority(): high for the lookups the user waits for,
+	//! normal for what is displayed and low for the background updates.
 	QNetworkAccessManager* getNetworkAccessManager() {return networkAccessManager;}
 
 	//! Update translations, font for GUI and sky everywhere in the program.
@@ -150,6 +206,27 @@ public:
 	//! @return the max squared distance in pixels that any object has travelled since the last update.
 	void draw();
 
+	//! Present the last drawn frame again, reprojected for the latest head pose, instead of drawing a new one.
+	//! This is done in stereo mode when reprojection is enabled and the last frame was over the frame time budget.
+	//! @return false if a regular frame has to be updated and drawn.
+	bool drawReprojectedFrame();
+
+	//! Keep drawing the frames for a while in the idle redraw mode, e.g. for the animations started by an event.
+	//! @param duration the time in seconds during which the frames are considered changed, 0 for the next frame only.
+	void markFrameDirty(double duration=0.);
+
+	//! Get whether the next frame would differ from the last drawn one. In the idle redraw mode (video/flag_idle_redraw)
+	//! the frames which did not change present the last drawn one again instead of drawing the modules.
+	//! The changes tracked are the events, the running scripts, the faders, the textures waiting for upload,
+	//! the twinkling, the field of view and the motion of the sky by more than half a pixel, due to the time or the view.
+	//! The sky is drawn anyway after video/idle_refresh_period seconds.
+	bool isFrameDirty() const;
+
+	//! Set the position looked at in the viewport, used to center the full resolution inset of the foveated rendering.
+	//! This is meant for an eye tracker, the inset stays at the center of the viewport otherwise.
+	//! @param x,y the position from the bottom left corner of the viewport, (0.5,0.5) being its center.
+	void setGazePosition(float x, float y);
+
 	//! Call this when the size of the GL window has changed.
 	void glWindowHasBeenResized(float x, float y, float w, float h);
 
@@ -200,14 +277,15 @@ public slots:
 	float getFps() const {return fps;}
 
 	//! Return the time since when stellarium is running in second.
+	//! While frames are recorded, this time advances by a fixed step per frame.
 	static double getTotalRunTime();
 
 	//! Report that a download occured. This is used for statistics purposes.
 	//! Connect this slot to QNetworkAccessManager::finished() slot to obtain statistics at the end of the program.
 	void reportFileDownloadFinished(QNetworkReply* reply);
 
-	//! do some cleanup and call QCoreApplication::exit(0)
-	void quit();
+	//! do some cleanup and call QCoreApplication::exit(exitCode)
+	void quit(int exitCode=0);
 signals:
 	void visionNightModeChanged(bool);
 	void colorSchemeChanged(const QString&);
@@ -227,6 +305,8 @@ private:
 	void handleClick(class QMouseEvent* event);
 	//! Handle mouse wheel.
 	void handleWheel(class QWheelEvent* event);
+	//! Send a wheel event whose delta was collected by handleWheel() to the modules.
+	void dispatchWheel(class QWheelEvent* event);
 	//! Handle mouse move.
 	void handleMove(int x, int y, Qt::MouseButtons b);
 	//! Handle key press and release.
@@ -236,6 +316,36 @@ private:
 
 	void initScriptMgr(QSettings* conf);
 
+	//! Start the preload of a module, on a worker thread if the parallel start up is enabled.
+	void startPreload(StelModule* module);
+	//! Wait for the preload of a module to finish, then initialize it.
+	//! Its deferred initialization is queued, or done at once if the deferred initialization is disabled.
+	void initModule(StelModule* module);
+	//! Run the deferred initialization of the next module, once a frame has been presented.
+	void runNextDeferredInit();
+
+	//! Set the core viewport from the window size and the current stereo mode of the core.
+	void updateStereoViewport();
+	//! Draw the core and all the modules in the current render target.
+	void drawModules();
+	//! Update all the modules in the call order, the consecutive independent ones in parallel.
+	void updateModules(double deltaTime);
+	//! Update the modules of a batch of independent modules at the same time.
+	void updateModulesInParallel(const QList<StelModule*>& modules, double deltaTime);
+	//! Draw the periphery and the inset of the foveated rendering, then composite them in the render target.
+	//! @return false if the buffers could not be created, nothing being drawn.
+	bool drawFoveated(QOpenGLFramebufferObject* renderTarget);
+	//! Draw the faces of the cube map of the fisheye view, then resample them in the render target.
+	//! @return false if the buffers could not be created, nothing being drawn.
+	bool drawCubemap(QOpenGLFramebufferObject* renderTarget);
+	//! Draw the modules at the resolution of the dynamic resolution scaling, then upscale them in the render target.
+	//! @return false if the buffer could not be created or the scale is 1, nothing being drawn.
+	bool drawScaled(QOpenGLFramebufferObject* renderTarget);
+	//! Draw the modules in each view of the multiple viewports.
+	void drawMultiViewport();
+	//! Draw the tiles of the requested tiled capture and write them.
+	void drawTiledCapture();
+
 	// The StelApp singleton
 	static StelApp* singleton;
 
@@ -266,8 +376,9 @@ private:
 	// Main network manager used for the program
 	QNetworkAccessManager* networkAccessManager;
 
+	//! Create the network manager shared by all the downloads, with its disk cache.
 	//! Get proxy settings from config file... if not set use http_proxy env var
-	void setupHttpProxy();
+	void setupNetwork();
 
 	// The audio manager.  Must execute in the main thread.
 	StelAudioMgr* audioMgr;
@@ -315,12 +426,100 @@ private:
 	bool initialized;
 
 	static QTime* qtime;
+	// Time returned by getTotalRunTime() while recording frames, negative otherwise
+	static double fixedRunTime;
+	// Offset keeping getTotalRunTime() continuous after a recording
+	static double runTimeOffset;
 
 	// Temporary variables used to store the last gl window resize
 	// if the core was not yet initialized
 	int saveProjW;
 	int saveProjH;
 
+	// Last gl window geometry, used to recompute the viewport when the stereo mode changes
+	float windowXywh[4];
+
+	// Stereo mode and lens offset for which stereoEffect was created
+	int appliedStereoMode;
+	float appliedStereoLensOffset;
+	// Effect presenting the sky to both eyes, NULL in mono mode
+	StelViewportStereoSideBySide* stereoEffect;
+	// Define whether the mono viewport is presented through the warp meshes of a multi-projector dome
+	bool flagWarpMesh;
+	// Effect presenting the sky to the projectors, NULL if disabled or in stereo mode
+	StelViewportWarpMesh* warpEffect;
+	// Define whether the frames which did not change present the last one again, see isFrameDirty()
+	bool flagIdleRedraw;
+	// Effect presenting the mono viewport buffer unchanged in the idle redraw mode, NULL if not used
+	StelViewportEffect* idleEffect;
+	// Maximum time in seconds during which the last frame is presented again
+	double idleRefreshPeriod;
+	// State with which the last frame was drawn, compared by isFrameDirty()
+	double drawnTime, drawnJD, drawnFov;
+	double drawnViewDirection[3];
+	unsigned int drawnFaderTransitions;
+	// The frames are drawn until this time, or at the next frame if the flag is set
+	double dirtyUntil;
+	bool flagFrameDirty;
+	// Buffers in which the sky is drawn once before being presented by the stereo or warp effect
+	StelRenderTargetPool* viewportTargets;
+	// Texture of the last frame drawn for the effect, resolved if multisampled
+	QOpenGLFramebufferObject* viewportFbo;
+	// Draw the buffer of the effects at a reduced resolution out of a full resolution inset, NULL if disabled
+	StelFoveatedRenderer* foveatedRenderer;
+	// Draw the fisheye view from the faces of a cube map, NULL if disabled
+	StelCubemapRenderer* cubemapRenderer;
+	// The views drawn in regions of the window from the same frame, NULL if the window has a single view
+	StelMultiViewport* multiViewport;
+	// Scale the resolution of the sky to keep its GPU time within a budget, NULL if disabled
+	StelDynamicResolution* dynamicResolution;
+	// Accumulate the jittered frames of the effect buffers to antialias them, NULL if disabled
+	StelTemporalAntialiasing* temporalAntialiasing;
+	// Thread reading the head tracker, NULL if disabled
+	StelSensorInput* sensorInput;
+
+	// Define whether late frames are replaced by a reprojection of the previous one in stereo mode
+	bool flagStereoReprojection;
+	// Number of extra pixels drawn around the stereo buffer for reprojection
+	int stereoReprojectionMargin;
+	// Frame time budget in seconds above which the next frame is reprojected
+	double stereoFrameBudget;
+	// Time in seconds between the pose latching and the display of the frame
+	double headPosePrediction;
+	// Radial distortion coefficients of the HMD lenses, and scales of the red and blue distortions
+	float stereoLensDistortion[4];
+	float stereoChromaticAberration[2];
+	// Duration of the last full update and draw in seconds
+	double frameStartTime, lastFrameDuration;
+	bool lastFrameReprojected;
+	// Head yaw and pitch and angular scale the stereo buffer was drawn with
+	double renderedHeadPose[2];
+	float renderedPixelPerRad;
+
+	// Timings of the modules in the last frames
+	StelFrameProfiler* frameProfiler;
+
+	// Offline rendering of frame sequences
+	StelFrameRecorder* frameRecorder;
+	// Capture of the still images larger than the window
+	StelTiledCapture* tiledCapture;
+	// Stream of the frames of the window to an external encoder, NULL if disabled
+	StelLiveOutput* liveOutput;
+	// Whether the current frame is rendered for the recorder, or not rendered at all
+	bool flagRecordFrame, flagSkipFrame;
+
+	// Capture and replay of the sessions
+	StelSessionRecorder* sessionRecorder;
+
+	// Counters of the rendering, per frame
+	StelRenderStats* renderStats;
+
+	// Memory held by each subsystem
+	StelMemoryStats* memoryStats;
+
+	// The rendering profile selected at startup
+	StelRenderProfile* renderProfile;
+
 	//! Store the number of downloaded files for statistics.
 	int nbDownloadedFiles;
 	//! Store the summed size of all downloaded files in bytes.
@@ -332,6 +531,20 @@ private:
 	qint64 totalUsedCacheSize;
 
 	QList<StelProgressController*> progressControllers;
+
+	// Whether the modules are preloaded on worker threads during the start up
+	bool flagParallelInit;
+	// Whether the independent modules are updated at the same time on the thread pool
+	bool flagParallelUpdate;
+	// Preloads of the modules which are not initialized yet
+	QHash<StelModule*, QFuture<void> > modulePreloads;
+	// Whether the heavy part of the initialization of the plugins waits for the first frames
+	bool flagDeferredInit;
+	// The modules initialized whose deferredInit() is still to be called, in order
+	QList<StelModule*> deferredInits;
+
+	// The parallel work of the modules
+	StelJobSystem* jobSystem;
 };
 
 #endif // _STELAPP_HPP_
@@ -0,0 +1,405 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "StelBinaryCatalog.hpp"
+#include "StelJsonParser.hpp"
+#include "StelFileMgr.hpp"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QVector>
+#include <QtEndian>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const quint32 catalogMagic = 0x54434253;	// "SBCT" in little endian
+	const quint32 catalogVersion = 1;
+	const int headerSize = 32;
+
+	enum NodeType
+	{
+		NodeNull = 0,
+		NodeFalse = 1,
+		NodeTrue = 2,
+		NodeInt = 3,
+		NodeDouble = 4,
+		NodeString = 5,
+		NodeList = 6,
+		NodeMap = 7,
+		NodeDate = 8
+	};
+
+	//! Encode the nodes in a buffer while collecting the strings in the table.
+	class CatalogWriter
+	{
+	public:
+		QByteArray nodes;
+		QVector<QString> strings;
+
+		void write(const QVariant& v)
+		{
+			switch (v.type())
+			{
+				case QVariant::Invalid:
+					putByte(NodeNull);
+					break;
+				case QVariant::Bool:
+					putByte(v.toBool() ? NodeTrue : NodeFalse);
+					break;
+				case QVariant::Int:
+					putByte(NodeInt);
+					put32((quint32)v.toInt());
+					break;
+				case QVariant::Double:
+				{
+					putByte(NodeDouble);
+					const double d = v.toDouble();
+					quint64 bits;
+					std::memcpy(&bits, &d, sizeof(bits));
+					put64(bits);
+					break;
+				}
+				case QVariant::List:
+				{
+					const QVariantList& l = v.toList();
+					putByte(NodeList);
+					put32(l.size());
+					foreach (const QVariant& e, l)
+						write(e);
+					break;
+				}
+				case QVariant::Map:
+				{
+					const QVariantMap& m = v.toMap();
+					putByte(NodeMap);
+					put32(m.size());
+					for (QVariantMap::ConstIterator i=m.constBegin();i!=m.constEnd();++i)
+					{
+						put32(stringIndex(i.key()));
+						write(i.value());
+					}
+					break;
+				}
+				case QVariant::DateTime:
+					// Stored like in the JSON files so that it is read back identically
+					putByte(NodeDate);
+					put32(stringIndex(v.toDateTime().toString(Qt::ISODate)));
+					break;
+				default:
+					putByte(NodeString);
+					put32(stringIndex(v.toString()));
+					break;
+			}
+		}
+
+	private:
+		QHash<QString, quint32> stringIndices;
+
+		quint32 stringIndex(const QString& s)
+		{
+			QHash<QString, quint32>::ConstIterator iter = stringIndices.constFind(s);
+			if (iter!=stringIndices.constEnd())
+				return iter.value();
+			const quint32 index = strings.size();
+			stringIndices.insert(s, index);
+			strings.append(s);
+			return index;
+		}
+		void putByte(int b) {nodes.append((char)b);}
+		void put32(quint32 v)
+		{
+			uchar buf[4];
+			qToLittleEndian(v, buf);
+			nodes.append((const char*)buf, 4);
+		}
+		void put64(quint64 v)
+		{
+			uchar buf[8];
+			qToLittleEndian(v, buf);
+			nodes.append((const char*)buf, 8);
+		}
+	};
+
+	//! Decode the nodes, checking that the data stays in the bounds.
+	class CatalogReader
+	{
+	public:
+		CatalogReader(const uchar* begin, const uchar* end, const QVector<QString>& astrings) : cur(begin), last(end), strings(astrings) {;}
+
+		QVariant read()
+		{
+			switch (getByte())
+			{
+				case NodeNull:
+					return QVariant();
+				case NodeFalse:
+					return QVariant(false);
+				case NodeTrue:
+					return QVariant(true);
+				case NodeInt:
+					return QVariant((int)get32());
+				case NodeDouble:
+				{
+					const quint64 bits = get64();
+					double d;
+					std::memcpy(&d, &bits, sizeof(d));
+					return QVariant(d);
+				}
+				case NodeString:
+					return QVariant(getString());
+				case NodeList:
+				{
+					const quint32 count = get32();
+					// Each node takes at least one byte
+					if (count>(quint32)(last-cur))
+						throw std::runtime_error("invalid list size");
+					QVariantList l;
+					l.reserve(count);
+					for (quint32 i=0;i<count;++i)
+						l.append(read());
+					return l;
+				}
+				case NodeMap:
+				{
+					const quint32 count = get32();
+					QVariantMap m;
+					for (quint32 i=0;i<count;++i)
+					{
+						const QString& key = getString();
+						m.insert(key, read());
+					}
+					return m;
+				}
+				case NodeDate:
+					return QVariant(QDateTime::fromString(getString(), Qt::ISODate));
+				default:
+					throw std::runtime_error("invalid node type");
+			}
+		}
+
+		bool atEnd() const {return cur==last;}
+
+	private:
+		const uchar* cur;
+		const uchar* last;
+		const QVector<QString>& strings;
+
+		void check(int n)
+		{
+			if (last-cur<n)
+				throw std::runtime_error("unexpected end of data");
+		}
+		int getByte()
+		{
+			check(1);
+			return *cur++;
+		}
+		quint32 get32()
+		{
+			check(4);
+			const quint32 v = qFromLittleEndian<quint32>(cur);
+			cur += 4;
+			return v;
+		}
+		quint64 get64()
+		{
+			check(8);
+			const quint64 v = qFromLittleEndian<quint64>(cur);
+			cur += 8;
+			return v;
+		}
+		const QString& getString()
+		{
+			const quint32 index = get32();
+			if (index>=(quint32)strings.size())
+				throw std::runtime_error("invalid string index");
+			return strings.at(index);
+		}
+	};
+}
+
+bool StelBinaryCatalog::write(const QVariant& root, QIODevice* output, qint64 sourceSize, qint64 sourceTime)
+{
+	CatalogWriter writer;
+	writer.write(root);
+
+	uchar header[headerSize];
+	qToLittleEndian(catalogMagic, header);
+	qToLittleEndian(catalogVersion, header+4);
+	qToLittleEndian((quint64)sourceSize, header+8);
+	qToLittleEndian((quint64)sourceTime, header+16);
+	qToLittleEndian((quint32)writer.nodes.size(), header+24);
+	qToLittleEndian((quint32)writer.strings.size(), header+28);
+	if (output->write((const char*)header, headerSize)!=headerSize || output->write(writer.nodes)!=writer.nodes.size())
+		return false;
+
+	QByteArray table;
+	foreach (const QString& s, writer.strings)
+	{
+		const QByteArray utf8 = s.toUtf8();
+		uchar size[4];
+		qToLittleEndian((quint32)utf8.size(), size);
+		table.append((const char*)size, 4);
+		table.append(utf8);
+	}
+	return output->write(table)==table.size();
+}
+
+bool StelBinaryCatalog::read(const QByteArray& data, QVariant& root, qint64 sourceSize, qint64 sourceTime)
+{
+	if (data.size()<headerSize)
+		return false;
+	const uchar* bytes = (const uchar*)data.constData();
+	if (qFromLittleEndian<quint32>(bytes)!=catalogMagic || qFromLittleEndian<quint32>(bytes+4)!=catalogVersion)
+		return false;
+	if ((qint64)qFromLittleEndian<quint64>(bytes+8)!=sourceSize || (qint64)qFromLittleEndian<quint64>(bytes+16)!=sourceTime)
+		return false;
+	const quint32 nodesSize = qFromLittleEndian<quint32>(bytes+24);
+	const quint32 nbStrings = qFromLittleEndian<quint32>(bytes+28);
+	if (nodesSize>(quint32)(data.size()-headerSize))
+		return false;
+
+	// Decode the string table first, each string is then shared by all the nodes using it
+	QVector<QString> strings;
+	strings.reserve(nbStrings);
+	const uchar* cur = bytes+headerSize+nodesSize;
+	const uchar* end = bytes+data.size();
+	for (quint32 i=0;i<nbStrings;++i)
+	{
+		if (end-cur<4)
+			return false;
+		const quint32 size = qFromLittleEndian<quint32>(cur);
+		cur += 4;
+		if (size>(quint32)(end-cur))
+			return false;
+		strings.append(QString::fromUtf8((const char*)cur, size));
+		cur += size;
+	}
+
+	try
+	{
+		CatalogReader reader(bytes+headerSize, bytes+headerSize+nodesSize, strings);
+		root = reader.read();
+		return reader.atEnd();
+	}
+	catch (std::runtime_error& e)
+	{
+		qWarning() << "Invalid binary catalog:" << e.what();
+		return false;
+	}
+}
+
+QString StelBinaryCatalog::getBinaryPath(const QString& jsonPath)
+{
+	const QFileInfo info(jsonPath);
+	const QByteArray hash = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+	return StelFileMgr::getCacheDir() + "/catalogs/" + info.completeBaseName() + "-" + QString::fromLatin1(hash) + ".bin";
+}
+
+QVariantMap StelBinaryCatalog::loadJsonCatalog(const QString& jsonPath)
+{
+	const QFileInfo info(jsonPath);
+	const qint64 sourceSize = info.size();
+	const qint64 sourceTime = info.lastModified().toMSecsSinceEpoch();
+	const QString binaryPath = getBinaryPath(jsonPath);
+
+	QFile binaryFile(binaryPath);
+	if (binaryFile.open(QIODevice::ReadOnly))
+	{
+		const qint64 size = binaryFile.size();
+		uchar* mapped = binaryFile.map(0, size);
+		if (mapped)
+		{
+			QVariant root;
+			const bool ok = read(QByteArray::fromRawData((const char*)mapped, size), root, sourceSize, sourceTime);
+			binaryFile.unmap(mapped);
+			if (ok)
+				return root.toMap();
+		}
+		binaryFile.close();
+	}
+
+	QFile jsonFile(jsonPath);
+	if (!jsonFile.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "Cannot open" << QDir::toNativeSeparators(jsonPath);
+		return QVariantMap();
+	}
+	QVariantMap map;
+	try
+	{
+		map = StelJsonParser::parse(jsonFile.readAll()).toMap();
+	}
+	catch (std::runtime_error& e)
+	{
+		qWarning() << "Cannot parse" << QDir::toNativeSeparators(jsonPath) << ":" << e.what();
+		return QVariantMap();
+	}
+	jsonFile.close();
+
+	// Write the binary version for the next time
+	QDir().mkpath(QFileInfo(binaryPath).absolutePath());
+	QSaveFile output(binaryPath);
+	if (!output.open(QIODevice::WriteOnly) || !write(map, &output, sourceSize, sourceTime) || !output.commit())
+		qWarning() << "Cannot write the binary catalog" << QDir::toNativeSeparators(binaryPath);
+	return map;
+}
+
+bool StelBinaryCatalog::saveJsonCatalog(const QVariantMap& map, const QString& jsonPath)
+{
+	QSaveFile jsonFile(jsonPath);
+	if (!jsonFile.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "Cannot open for writing" << QDir::toNativeSeparators(jsonPath);
+		return false;
+	}
+	StelJsonParser::write(map, &jsonFile);
+	if (!jsonFile.commit())
+	{
+		qWarning() << "Cannot write" << QDir::toNativeSeparators(jsonPath);
+		return false;
+	}
+
+	saveBinaryVersion(map, jsonPath);
+	return true;
+}
+
+bool StelBinaryCatalog::saveBinaryVersion(const QVariant& root, const QString& jsonPath)
+{
+	// The binary version is tied to the size and modification time of the new file
+	const QFileInfo info(jsonPath);
+	const QString binaryPath = getBinaryPath(jsonPath);
+	QDir().mkpath(QFileInfo(binaryPath).absolutePath());
+	QSaveFile output(binaryPath);
+	if (!output.open(QIODevice::WriteOnly) || !write(root, &output, info.size(), info.lastModified().toMSecsSinceEpoch()) || !output.commit())
+	{
+		qWarning() << "Cannot write the binary catalog" << QDir::toNativeSeparators(binaryPath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#ifndef _STELBINARYCATALOG_HPP_
+#define _STELBINARYCATALOG_HPP_
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+class QIODevice;
+
+//! @class StelBinaryCatalog
+//! Compact binary version of the JSON catalogs used by the plugins (satellites, exoplanets, pulsars...).
+//! Parsing a large JSON file at each start is slow, so when a catalog is loaded with loadJsonCatalog()
+//! its content is also written in a binary file in the cache directory, which is used instead of the
+//! JSON file as long as the latter is not modified or downloaded again.
+//! The binary file is memory mapped for reading. All the strings are stored once in a string table,
+//! so that the keys repeated in each entry of a catalog share the same QString in memory.
+//!
+//! Format, in little endian:
+//! @verbatim
+//! header      magic "SBCT", format version, size and modification time of the JSON file,
+//!             size of the node data, number of strings
+//! nodes       the tree of values, each node being a type byte followed by its payload:
+//!             null, false, true, int32, float64, string index, list (count, nodes),
+//!             map (count, pairs of key string index and node), date (ISO string index)
+//! strings     for each string, its UTF-8 size followed by the UTF-8 data
+//! @endverbatim
+class StelBinaryCatalog
+{
+public:
+	//! Load a JSON catalog, from its binary version when it is up to date.
+	//! The binary version is created in the cache directory when it is missing or outdated.
+	//! @param jsonPath the path of the JSON file.
+	//! @return the content of the file, or an empty map if it could not be read.
+	static QVariantMap loadJsonCatalog(const QString& jsonPath);
+
+	//! Save a JSON catalog and its binary version, so that the next loadJsonCatalog() does not
+	//! have to parse the JSON file. The JSON file is replaced atomically, and the function does
+	//! not use any global state, so it can be run in a worker thread.
+	//! @param jsonPath the path of the JSON file.
+	//! @return false if the JSON file could not be written.
+	static bool saveJsonCatalog(const QVariantMap& map, const QString& jsonPath);
+
+	//! Write the binary version of a JSON catalog already saved, tied to its current size and modification time.
+	//! Like saveJsonCatalog(), it can be run in a worker thread.
+	//! @return false if the binary file could not be written.
+	static bool saveBinaryVersion(const QVariant& root, const QString& jsonPath);
+
+	//! Write a tree of values in the binary format.
+	//! @param sourceSize the size of the JSON file the values come from.
+	//! @param sourceTime the modification time in ms since epoch of the JSON file the values come from.
+	//! @return false if the data could not be written.
+	static bool write(const QVariant& root, QIODevice* output, qint64 sourceSize, qint64 sourceTime);
+
+	//! Read a tree of values in the binary format.
+	//! @param data the binary data, typically memory mapped.
+	//! @param sourceSize, sourceTime the version of the JSON file which is expected.
+	//! @return false if the data is invalid, or was written for another version of the JSON file.
+	static bool read(const QByteArray& data, QVariant& root, qint64 sourceSize, qint64 sourceTime);
+
+	//! Get the path of the binary version of a JSON catalog in the cache directory.
+	static QString getBinaryPath(const QString& jsonPath);
+};
+
+#endif // _STELBINARYCATALOG_HPP_
@@ -0,0 +1,194 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelCatalogUpdater.hpp"
+#include "StelApp.hpp"
+#include "StelBinaryCatalog.hpp"
+#include "StelJsonParser.hpp"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QSettings>
+#include <QtConcurrent>
+#include <stdexcept>
+
+StelCatalogUpdater::StelCatalogUpdater(const QString& aname, const QString& ajsonPath, QObject* parent)
+	: QObject(parent)
+	, name(aname)
+	, jsonPath(ajsonPath)
+	, reply(NULL)
+{
+	connect(&watcher, SIGNAL(finished()), this, SLOT(processingFinished()));
+}
+
+StelCatalogUpdater::~StelCatalogUpdater()
+{
+	if (reply)
+	{
+		reply->disconnect(this);
+		reply->abort();
+		reply->deleteLater();
+		reply = NULL;
+	}
+	// The worker must not write the files after the plugin is gone
+	watcher.waitForFinished();
+}
+
+bool StelCatalogUpdater::update(const QUrl& url, const QByteArray& userAgent)
+{
+	if (isUpdating())
+		return false;
+
+	QNetworkRequest request(url);
+	request.setRawHeader("User-Agent", userAgent);
+	request.setPriority(QNetworkRequest::LowPriority);
+	// The validators are handled here, the catalog does not need a second copy in the disk cache
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+	request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+	const Validators validators = loadValidators();
+	if (!validators.etag.isEmpty())
+		request.setRawHeader("If-None-Match", validators.etag);
+	if (!validators.lastModified.isEmpty())
+		request.setRawHeader("If-Modified-Since", validators.lastModified);
+
+	reply = StelApp::getInstance().getNetworkAccessManager()->get(request);
+	connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SIGNAL(downloadProgress(qint64,qint64)));
+	connect(reply, SIGNAL(finished()), this, SLOT(downloadFinished()));
+	return true;
+}
+
+QVariantMap StelCatalogUpdater::takeCatalog()
+{
+	QVariantMap taken;
+	taken.swap(catalog);
+	return taken;
+}
+
+void StelCatalogUpdater::downloadFinished()
+{
+	QNetworkReply* finishedReply = reply;
+	reply = NULL;
+	finishedReply->deleteLater();
+
+	if (finishedReply->error() != QNetworkReply::NoError)
+	{
+		qWarning() << qPrintable(name + ":") << "FAILED to download" << finishedReply->url() << " Error: " << finishedReply->errorString();
+		emit(finished(DownloadFailed));
+		return;
+	}
+	if (finishedReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+	{
+		qDebug() << qPrintable(name + ":") << "the catalog is up to date";
+		emit(finished(NotModified));
+		return;
+	}
+
+	received.etag = finishedReply->rawHeader("ETag");
+	received.lastModified = finishedReply->rawHeader("Last-Modified");
+	watcher.setFuture(QtConcurrent::run(processDownload, finishedReply->readAll(), name, jsonPath));
+}
+
+void StelCatalogUpdater::processingFinished()
+{
+	catalog = watcher.result();
+	if (catalog.isEmpty())
+	{
+		emit(finished(InvalidCatalog));
+		return;
+	}
+	saveValidators(received);
+	emit(finished(Updated));
+}
+
+QVariantMap StelCatalogUpdater::processDownload(QByteArray data, QString name, QString jsonPath)
+{
+	QVariantMap map;
+	try
+	{
+		map = StelJsonParser::parse(data).toMap();
+	}
+	catch (std::runtime_error& e)
+	{
+		qWarning() << qPrintable(name + ":") << "the downloaded catalog is invalid:" << e.what();
+		return QVariantMap();
+	}
+	if (map.isEmpty())
+	{
+		qWarning() << qPrintable(name + ":") << "the downloaded catalog is empty";
+		return QVariantMap();
+	}
+
+	// Keep the previous catalog as a backup
+	const QString backupPath = jsonPath + ".old";
+	if (QFile::exists(jsonPath))
+	{
+		QFile::remove(backupPath);
+		if (!QFile::copy(jsonPath, backupPath))
+			qWarning() << qPrintable(name + ":") << "cannot back up" << QDir::toNativeSeparators(jsonPath);
+	}
+
+	// Save the data as downloaded, so that the file is the same as the one on the server
+	QSaveFile jsonFile(jsonPath);
+	if (!jsonFile.open(QIODevice::WriteOnly) || jsonFile.write(data) != data.size() || !jsonFile.commit())
+	{
+		qWarning() << qPrintable(name + ":") << "cannot write JSON data to file" << QDir::toNativeSeparators(jsonPath);
+		return QVariantMap();
+	}
+	StelBinaryCatalog::saveBinaryVersion(map, jsonPath);
+	return map;
+}
+
+QString StelCatalogUpdater::getValidatorsPath() const
+{
+	QString path = StelBinaryCatalog::getBinaryPath(jsonPath);
+	path.chop(QString(".bin").size());
+	return path + ".http";
+}
+
+StelCatalogUpdater::Validators StelCatalogUpdater::loadValidators() const
+{
+	Validators validators;
+	const QSettings settings(getValidatorsPath(), QSettings::IniFormat);
+	// The validators belong to the downloaded file, not to a file restored or edited since
+	const QFileInfo info(jsonPath);
+	if (!info.exists()
+	    || settings.value("size", -1).toLongLong() != info.size()
+	    || settings.value("modified", -1).toLongLong() != info.lastModified().toMSecsSinceEpoch())
+		return validators;
+	validators.etag = settings.value("etag").toByteArray();
+	validators.lastModified = settings.value("last_modified").toByteArray();
+	return validators;
+}
+
+void StelCatalogUpdater::saveValidators(const Validators& validators) const
+{
+	const QFileInfo info(jsonPath);
+	QSettings settings(getValidatorsPath(), QSettings::IniFormat);
+	settings.setValue("etag", validators.etag);
+	settings.setValue("last_modified", validators.lastModified);
+	settings.setValue("size", info.size());
+	settings.setValue("modified", info.lastModified().toMSecsSinceEpoch());
+}
@@ -0,0 +1,104 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELCATALOGUPDATER_HPP_
+#define _STELCATALOGUPDATER_HPP_
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QVariantMap>
+
+class QNetworkReply;
+
+//! @class StelCatalogUpdater
+//! Download the new versions of the JSON catalog of a plugin (exoplanets, novae, pulsars...).
+//! The download is a conditional request: the ETag and the Last-Modified date of the last
+//! download are sent back to the server, so an unchanged catalog is not downloaded again.
+//! A new catalog is parsed in a worker thread, and if it is valid the previous file is kept
+//! as a backup with the .old suffix, the new one is saved and its binary version written
+//! for StelBinaryCatalog::loadJsonCatalog(). Only then the plugin is notified in the main
+//! thread, and can replace its data set with takeCatalog() without reading the file again.
+//! An invalid or truncated download leaves the current catalog untouched.
+class StelCatalogUpdater : public QObject
+{
+	Q_OBJECT
+public:
+	enum Result
+	{
+		Updated,		//!< A new catalog was saved, get it with takeCatalog().
+		NotModified,		//!< The catalog on the server is the one already saved.
+		DownloadFailed,		//!< The server could not be reached or returned an error.
+		InvalidCatalog		//!< The downloaded data could not be parsed or saved.
+	};
+
+	//! @param name the name used in the log messages, typically the plugin name.
+	//! @param jsonPath the path of the JSON file which is replaced by the updates.
+	StelCatalogUpdater(const QString& name, const QString& jsonPath, QObject* parent=NULL);
+	~StelCatalogUpdater();
+
+	//! Start downloading a catalog. The finished() signal is emitted at the end.
+	//! @param userAgent the User-Agent header sent with the request.
+	//! @return false if an update is already running.
+	bool update(const QUrl& url, const QByteArray& userAgent);
+
+	//! Tell whether an update is running, from the download to the saving of the catalog.
+	bool isUpdating() const {return reply!=NULL || watcher.isRunning();}
+
+	//! Get the catalog of the last update which returned Updated, and release it.
+	QVariantMap takeCatalog();
+
+signals:
+	//! Emitted during the download.
+	void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	//! Emitted in the main thread when the update is over.
+	void finished(StelCatalogUpdater::Result result);
+
+private slots:
+	void downloadFinished();
+	void processingFinished();
+
+private:
+	//! The HTTP validators of the last download, stored with the catalog they belong to.
+	struct Validators
+	{
+		QByteArray etag;
+		QByteArray lastModified;
+	};
+
+	//! Parse and save a downloaded catalog, run in a worker thread.
+	//! @return the catalog, or an empty map if it is invalid or could not be saved.
+	static QVariantMap processDownload(QByteArray data, QString name, QString jsonPath);
+	//! Get the path of the file which keeps the validators of the JSON file.
+	QString getValidatorsPath() const;
+	//! Read the validators saved with the current JSON file, empty if the file changed since.
+	Validators loadValidators() const;
+	void saveValidators(const Validators& validators) const;
+
+	QString name;
+	QString jsonPath;
+	QNetworkReply* reply;
+	//! The validators of the download being processed.
+	Validators received;
+	QFutureWatcher<QVariantMap> watcher;
+	QVariantMap catalog;
+};
+
+#endif // _STELCATALOGUPDATER_HPP_
@@ -29,6 +29,7 @@
 #include "StelMovementMgr.hpp"
 #include "StelModuleMgr.hpp"
 #include "StelPainter.hpp"
+#include "StelRiseSet.hpp"
 #include "StelLocationMgr.hpp"
 #include "StelObserver.hpp"
 #include "StelObjectMgr.hpp"
@@ -37,10 +38,12 @@
 #include "LandscapeMgr.hpp"
 #include "StelTranslator.hpp"
 #include "StelActionMgr.hpp"
+#include "StelTracer.hpp"
 
 #include <QSettings>
 #include <QDebug>
 #include <QMetaEnum>
+#include <cstring>
 
 // Init statics transfo matrices
 // See vsop87.doc:
@@ -59,9 +62,13 @@ const double StelCore::ONE_OVER_JD_SECOND = 24 * 60 * 60;
 StelCore::StelCore()
 	: skyDrawer(NULL)
 	, movementMgr(NULL)
+	, riseSet(NULL)
 	, geodesicGrid(NULL)
 	, currentProjectionType(ProjectionStereographic)
 	, currentDeltaTAlgorithm(EspenakMeeus)
+	, stereoMode(StereoNone)
+	, stereoLensOffset(0.f)
+	, savedProjectionType(ProjectionStereographic)
 	, position(NULL)
 	, timeSpeed(JD_SECOND)
 	, JDay(0.)
@@ -70,8 +77,11 @@ StelCore::StelCore()
 	, JDayOfLastJDayUpdate(0.)
 	, deltaTCustomNDot(-26.0)
 	, deltaTCustomYear(1820.0)
+	, deltaTCacheCount(0)
+	, deltaTCacheNext(0)
 {
 	toneConverter = new StelToneReproducer();
+	riseSet = new StelRiseSet();
 
 	QSettings* conf = StelApp::getInstance().getSettings();
 	// Create and initialize the default projector params
@@ -93,6 +103,9 @@ StelCore::StelCore()
 	currentProjectorParams.gravityLabels = conf->value("viewing/flag_gravity_labels").toBool();
 	
 	currentProjectorParams.devicePixelsPerPixel = StelApp::getInstance().getDevicePixelsPerPixel();
+
+	stereoMode = conf->value("video/stereo_mode", "none").toString()=="side_by_side" ? StereoSideBySide : StereoNone;
+	stereoLensOffset = conf->value("video/stereo_lens_offset", 0.f).toFloat();
 }
 
 
@@ -102,6 +115,7 @@ StelCore::~StelCore()
 	delete geodesicGrid; geodesicGrid=NULL;
 	delete skyDrawer; skyDrawer=NULL;
 	delete position; position=NULL;
+	delete riseSet; riseSet=NULL;
 }
 
 /*************************************************************************
@@ -231,8 +245,8 @@ const StelGeodesicGrid* StelCore::getGeodesicGrid(int maxLevel) const
 	}
 	else if (maxLevel>geodesicGrid->getMaxLevel())
 	{
-		delete geodesicGrid;
-		geodesicGrid = new StelGeodesicGrid(maxLevel);
+		// Only the new levels are subdivided
+		geodesicGrid->extend(maxLevel);
 	}
 	return geodesicGrid;
 }
@@ -285,28 +299,76 @@ StelProjectorP StelCore::getProjection(StelProjector::ModelViewTranformP modelVi
 	return prj;
 }
 
+static bool sameProjectorParams(const StelProjector::StelProjectorParams& p1, const StelProjector::StelProjectorParams& p2)
+{
+	return p1.viewportXywh==p2.viewportXywh && p1.fov==p2.fov && p1.gravityLabels==p2.gravityLabels
+		&& p1.defautAngleForGravityText==p2.defautAngleForGravityText && p1.maskType==p2.maskType
+		&& p1.zNear==p2.zNear && p1.zFar==p2.zFar && p1.viewportCenter==p2.viewportCenter
+		&& p1.viewportFovDiameter==p2.viewportFovDiameter && p1.flipHorz==p2.flipHorz && p1.flipVert==p2.flipVert
+		&& p1.devicePixelsPerPixel==p2.devicePixelsPerPixel;
+}
+
+static bool sameMatrix(const Mat4d& m1, const Mat4d& m2)
+{
+	return memcmp(m1.r, m2.r, sizeof(m1.r))==0;
+}
+
 // Get an instance of projector using the current display parameters from Navigation, StelMovementMgr
 StelProjectorP StelCore::getProjection(FrameType frameType, RefractionMode refractionMode) const
 {
+	if (frameType<FrameAltAz || frameType>FrameGalactic)
+	{
+		qDebug() << "Unknown reference frame type: " << (int)frameType << ".";
+		Q_ASSERT(0);
+		return getProjection2d();
+	}
+
+	// Same test as in the get*ModelViewTransform() methods
+	const bool withRefraction = !(refractionMode==RefractionOff || skyDrawer==NULL || (refractionMode==RefractionAuto && skyDrawer->getFlagHasAtmosphere()==false));
+	CachedProjection& cached = projectionCache[frameType][withRefraction ? 1 : 0];
+	if (cached.prj && cached.projectionType==currentProjectionType && sameProjectorParams(cached.params, currentProjectorParams)
+		&& (!withRefraction || (cached.refractionPressure==skyDrawer->getRefraction().getPressure()
+					&& cached.refractionTemperature==skyDrawer->getRefraction().getTemperature())))
+		return cached.prj;
+
+	const RefractionMode mode = withRefraction ? RefractionOn : RefractionOff;
 	switch (frameType)
 	{
 		case FrameAltAz:
-			return getProjection(getAltAzModelViewTransform(refractionMode));
+			cached.prj = getProjection(getAltAzModelViewTransform(mode));
+			break;
 		case FrameHeliocentricEcliptic:
-			return getProjection(getHeliocentricEclipticModelViewTransform(refractionMode));
+			cached.prj = getProjection(getHeliocentricEclipticModelViewTransform(mode));
+			break;
 		case FrameObservercentricEcliptic:
-			return getProjection(getObservercentricEclipticModelViewTransform(refractionMode));
+			cached.prj = getProjection(getObservercentricEclipticModelViewTransform(mode));
+			break;
 		case FrameEquinoxEqu:
-			return getProjection(getEquinoxEquModelViewTransform(refractionMode));
+			cached.prj = getProjection(getEquinoxEquModelViewTransform(mode));
+			break;
 		case FrameJ2000:
-			return getProjection(getJ2000ModelViewTransform(refractionMode));
-		case FrameGalactic:
-			 return getProjection(getGalacticModelViewTransform(refractionMode));
+			cached.prj = getProjection(getJ2000ModelViewTransform(mode));
+			break;
 		default:
-			qDebug() << "Unknown reference frame type: " << (int)frameType << ".";
+			cached.prj = getProjection(getGalacticModelViewTransform(mode));
+	}
+	cached.projectionType = currentProjectionType;
+	cached.params = currentProjectorParams;
+	if (withRefraction)
+	{
+		cached.refractionPressure = skyDrawer->getRefraction().getPressure();
+		cached.refractionTemperature = skyDrawer->getRefraction().getTemperature();
+	}
+	return cached.prj;
+}
+
+void StelCore::clearProjectionCache(bool keepAltAz)
+{
+	for (int f=keepAltAz ? FrameAltAz+1 : 0;f<=FrameGalactic;++f)
+	{
+		projectionCache[f][0].prj.clear();
+		projectionCache[f][1].prj.clear();
 	}
-	Q_ASSERT(0);
-	return getProjection2d();
 }
 
 StelToneReproducer* StelCore::getToneReproducer()
@@ -342,14 +404,8 @@ const StelMovementMgr* StelCore::getMovementMgr() const
 SphericalCap StelCore::getVisibleSkyArea() const
 {
 	const LandscapeMgr* landscapeMgr = GETSTELMODULE(LandscapeMgr);
-	Vec3d up(0, 0, 1);
-	up = altAzToJ2000(up, RefractionOff);
-	
-	if (landscapeMgr->getIsLandscapeFullyVisible())
-	{
-		return SphericalCap(up, -0.035f);
-	}
-	return SphericalCap(up, -1.f);
+	const SphericalCap cap = landscapeMgr->getVisibleSkyCap();
+	return SphericalCap(altAzToJ2000(cap.n, RefractionOff), cap.d);
 }
 
 void StelCore::setClippingPlanes(double znear, double zfar)
@@ -397,6 +453,7 @@ void StelCore::update(double deltaTime)
 *************************************************************************/
 void StelCore::preDraw()
 {
+	STEL_TRACE_SCOPE("StelCore::preDraw");
 	// Init openGL viewing with fov, screen size and clip planes
 	currentProjectorParams.zNear = 0.000001;
 	currentProjectorParams.zFar = 50.;
@@ -435,15 +492,20 @@ StelCore::ProjectionType StelCore::getCurrentProjectionType() const
 
 //! Set the current projection type to use
 void StelCore::setCurrentProjectionTypeKey(QString key)
+{
+	setCurrentProjectionType(projectionTypeKeyToProjectionType(key));
+}
+
+StelCore::ProjectionType StelCore::projectionTypeKeyToProjectionType(const QString& key) const
 {
 	const QMetaEnum& en = metaObject()->enumerator(metaObject()->indexOfEnumerator("ProjectionType"));
-	ProjectionType newType = (ProjectionType)en.keyToValue(key.toLatin1().data());
-	if (newType<0)
+	const int type = en.keyToValue(key.toLatin1().data());
+	if (type<0)
 	{
 		qWarning() << "Unknown projection type: " << key << "setting \"ProjectionStereographic\" instead";
-		newType = ProjectionStereographic;
+		return ProjectionStereographic;
 	}
-	setCurrentProjectionType(newType);
+	return (ProjectionType)type;
 }
 
 //! Get the current Mapping used by the Projection
@@ -544,11 +606,38 @@ void StelCore::lookAtJ2000(const Vec3d& pos, const Vec3d& aup)
 	s.normalize();
 	Vec3d u(s^f);	// Up vector in AltAz coordinates
 	u.normalize();
-	matAltAzModelView.set(s[0],u[0],-f[0],0.,
+	const Mat4d modelView(s[0],u[0],-f[0],0.,
 			      s[1],u[1],-f[1],0.,
 			      s[2],u[2],-f[2],0.,
 			      0.,0.,0.,1.);
+	// The view is set at every frame, the projectors are only rebuilt when it moved
+	if (sameMatrix(modelView, matAltAzModelView))
+		return;
+	matAltAzModelView = modelView;
+	invertMatAltAzModelView = matAltAzModelView.inverse();
+	clearProjectionCache();
+}
+
+void StelCore::beginView(const Mat4d& rotation, ProjectionType type, const StelProjector::StelProjectorParams& params)
+{
+	savedModelView = matAltAzModelView;
+	savedProjectorParams = currentProjectorParams;
+	savedProjectionType = currentProjectionType;
+
+	matAltAzModelView = rotation*matAltAzModelView;
 	invertMatAltAzModelView = matAltAzModelView.inverse();
+	currentProjectionType = type;
+	currentProjectorParams = params;
+	clearProjectionCache();
+}
+
+void StelCore::endView()
+{
+	matAltAzModelView = savedModelView;
+	invertMatAltAzModelView = matAltAzModelView.inverse();
+	currentProjectorParams = savedProjectorParams;
+	currentProjectionType = savedProjectionType;
+	clearProjectionCache();
 }
 
 Vec3d StelCore::altAzToEquinoxEqu(const Vec3d& v, RefractionMode refMode) const
@@ -711,23 +800,50 @@ StelProjector::ModelViewTranformP StelCore::getGalacticModelViewTransform(Refrac
 
 void StelCore::updateTransformMatrices()
 {
-	matAltAzToEquinoxEqu = position->getRotAltAzToEquatorial(JDay);
-	matEquinoxEquToAltAz = matAltAzToEquinoxEqu.transpose();
+	const Mat4d rotAltAzToEquatorial = position->getRotAltAzToEquatorial(JDay);
+	const Mat4d rotEquatorialToVsop87 = position->getRotEquatorialToVsop87();
+	const Vec3d centerVsop87Pos = position->getCenterVsop87Pos();
+	const double distanceFromCenter = position->getDistanceFromCenter();
+
+	// The precession changes slowly, the rotation of the planet and the observer position at every frame
+	// when the time is running, and none of them when the time is stopped.
+	const bool equatorialChanged = !transformInputs.valid || !sameMatrix(rotEquatorialToVsop87, transformInputs.rotEquatorialToVsop87);
+	const bool altAzChanged = !transformInputs.valid || !sameMatrix(rotAltAzToEquatorial, transformInputs.rotAltAzToEquatorial);
+	const bool centerChanged = !transformInputs.valid || centerVsop87Pos!=transformInputs.centerVsop87Pos
+		|| distanceFromCenter!=transformInputs.distanceFromCenter;
+	if (!equatorialChanged && !altAzChanged && !centerChanged)
+		return;
+	transformInputs.valid = true;
+	transformInputs.rotAltAzToEquatorial = rotAltAzToEquatorial;
+	transformInputs.rotEquatorialToVsop87 = rotEquatorialToVsop87;
+	transformInputs.centerVsop87Pos = centerVsop87Pos;
+	transformInputs.distanceFromCenter = distanceFromCenter;
 
-	matEquinoxEquToJ2000 = matVsop87ToJ2000 * position->getRotEquatorialToVsop87();
-	matJ2000ToEquinoxEqu = matEquinoxEquToJ2000.transpose();
-	matJ2000ToAltAz = matEquinoxEquToAltAz*matJ2000ToEquinoxEqu;
+	if (altAzChanged)
+	{
+		matAltAzToEquinoxEqu = rotAltAzToEquatorial;
+		matEquinoxEquToAltAz = matAltAzToEquinoxEqu.transpose();
+	}
+	if (equatorialChanged)
+	{
+		matEquinoxEquToJ2000 = matVsop87ToJ2000 * rotEquatorialToVsop87;
+		matJ2000ToEquinoxEqu = matEquinoxEquToJ2000.transpose();
+	}
+	if (altAzChanged || equatorialChanged)
+		matJ2000ToAltAz = matEquinoxEquToAltAz*matJ2000ToEquinoxEqu;
 
-	matHeliocentricEclipticToEquinoxEqu = matJ2000ToEquinoxEqu * matVsop87ToJ2000 * Mat4d::translation(-position->getCenterVsop87Pos());
+	matHeliocentricEclipticToEquinoxEqu = matJ2000ToEquinoxEqu * matVsop87ToJ2000 * Mat4d::translation(-centerVsop87Pos);
 
 	// These two next have to take into account the position of the observer on the earth
 	Mat4d tmp = matJ2000ToVsop87 * matEquinoxEquToJ2000 * matAltAzToEquinoxEqu;
 
-	matAltAzToHeliocentricEcliptic =  Mat4d::translation(position->getCenterVsop87Pos()) * tmp *
-						  Mat4d::translation(Vec3d(0.,0., position->getDistanceFromCenter()));
+	matAltAzToHeliocentricEcliptic =  Mat4d::translation(centerVsop87Pos) * tmp *
+						  Mat4d::translation(Vec3d(0.,0., distanceFromCenter));
 
-	matHeliocentricEclipticToAltAz =  Mat4d::translation(Vec3d(0.,0.,-position->getDistanceFromCenter())) * tmp.transpose() *
-						  Mat4d::translation(-position->getCenterVsop87Pos());
+	matHeliocentricEclipticToAltAz =  Mat4d::translation(Vec3d(0.,0.,-distanceFromCenter)) * tmp.transpose() *
+						  Mat4d::translation(-centerVsop87Pos);
+	// The AltAz projectors only depend on the view, they are kept while the time runs
+	clearProjectionCache(true);
 }
 
 // Return the observer heliocentric position
@@ -1158,6 +1274,20 @@ double StelCore::getLocalSiderealTime() const
 	return (position->getHomePlanet()->getSiderealTime(JDay)+position->getCurrentLocation().longitude)*M_PI/180.;
 }
 
+StelRiseSet* StelCore::getRiseSet()
+{
+	// Standard altitude of the stars at rise and set, lifted by the refraction
+	static const double horizonAltitude = -34./60.*M_PI/180.;
+	const double longitude = position->getCurrentLocation().longitude;
+	const double jdStart = std::floor(JDay+0.5+longitude/360.)-0.5-longitude/360.;
+	double siderealDay = getLocalSiderealDayLength();
+	if (siderealDay<=0.)
+		siderealDay = 1.;
+	const double lst = (position->getHomePlanet()->getSiderealTime(jdStart)+longitude)*M_PI/180.;
+	riseSet->setObserver(jdStart, lst, siderealDay, position->getCurrentLocation().latitude*M_PI/180., horizonAltitude);
+	return riseSet;
+}
+
 //! Get the duration of a sidereal day for the current observer in day.
 double StelCore::getLocalSiderealDayLength() const
 {
@@ -1287,6 +1417,30 @@ void StelCore::setStartupTimeMode(const QString& s)
 }
 
 double StelCore::getDeltaT(double jDay) const
+{
+	QMutexLocker locker(&deltaTCacheMutex);
+	for (int i=0; i<deltaTCacheCount; ++i)
+	{
+		if (deltaTCache[i].jDay==jDay)
+			return deltaTCache[i].deltaT;
+	}
+	const double DeltaT = computeDeltaT(jDay);
+	deltaTCache[deltaTCacheNext].jDay = jDay;
+	deltaTCache[deltaTCacheNext].deltaT = DeltaT;
+	deltaTCacheNext = (deltaTCacheNext+1) % DeltaTCacheSize;
+	if (deltaTCacheCount<DeltaTCacheSize)
+		++deltaTCacheCount;
+	return DeltaT;
+}
+
+void StelCore::clearDeltaTCache()
+{
+	QMutexLocker locker(&deltaTCacheMutex);
+	deltaTCacheCount = 0;
+	deltaTCacheNext = 0;
+}
+
+double StelCore::computeDeltaT(double jDay) const
 {
 	double DeltaT = 0.;
 	double ndot = 0.;
@@ -24,6 +24,7 @@
 #include "StelProjectorType.hpp"
 #include "StelLocation.hpp"
 #include "StelSkyDrawer.hpp"
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 #include <QTime>
@@ -33,6 +34,7 @@ class StelSkyDrawer;
 class StelGeodesicGrid;
 class StelMovementMgr;
 class StelObserver;
+class StelRiseSet;
 
 //! @class StelCore
 //! Main class for Stellarium core processing.
@@ -125,6 +127,14 @@ public:
 		Custom                          //!< User defined coefficients for quadratic equation for DeltaT
 	};
 
+	//! @enum StereoMode
+	//! Available stereo rendering modes for head-mounted displays.
+	enum StereoMode
+	{
+		StereoNone,			//!< Regular mono rendering
+		StereoSideBySide		//!< The sky is drawn once and presented to each half of the window
+	};
+
 	StelCore();
 	virtual ~StelCore();
 
@@ -138,6 +148,16 @@ public:
 	//! Handle the resizing of the window
 	void windowHasBeenResized(float x, float y, float width, float height);
 
+	//! Get the current stereo rendering mode.
+	StereoMode getStereoMode() const {return stereoMode;}
+	//! Set the stereo rendering mode. The viewport is updated by StelApp on the next frame.
+	void setStereoMode(StereoMode mode) {stereoMode=mode;}
+	//! Get the horizontal offset in pixels of each eye lens center from the center of its half of the window.
+	//! Positive values move the lens centers toward the middle of the window.
+	float getStereoLensOffset() const {return stereoLensOffset;}
+	//! Set the horizontal offset in pixels of each eye lens center.
+	void setStereoLensOffset(float offset) {stereoLensOffset=offset;}
+
 	//! Update core state before drawing modules.
 	void preDraw();
 
@@ -148,8 +168,9 @@ public:
 	//! only for 2d painting
 	StelProjectorP getProjection2d() const;
 
-	//! Get a new instance of projector using a modelview transformation corresponding to the the given frame.
+	//! Get an instance of projector using a modelview transformation corresponding to the the given frame.
 	//! If not specified the refraction effect is included if atmosphere is on.
+	//! The instance is shared by all the calls made until the view, the time or the projector parameters change.
 	StelProjectorP getProjection(FrameType frameType, RefractionMode refractionMode=RefractionAuto) const;
 
 	//! Get a new instance of projector using the given modelview transformatione.
@@ -166,6 +187,11 @@ public:
 	//! Get the current StelSkyDrawer used in the core.
 	const StelSkyDrawer* getSkyDrawer() const;
 
+	//! Get the rise/set calculator shared by the modules, set for the current location
+	//! and the current local day, starting at the mean local midnight.
+	//! The rise and set times are computed for the standard refraction at the horizon.
+	StelRiseSet* getRiseSet();
+
 	//! Get an instance of StelGeodesicGrid which is garanteed to allow for at least maxLevel levels
 	const StelGeodesicGrid* getGeodesicGrid(int maxLevel) const;
 
@@ -193,6 +219,13 @@ public:
 	//! Set vision direction
 	void lookAtJ2000(const Vec3d& pos, const Vec3d& up);
 
+	//! Draw the next modules in another view of the same state, a face of a cube map or one of several viewports:
+	//! the view is rotated by the given matrix in the view frame, and projected with the given projection.
+	//! The current view and projection are restored by endView().
+	void beginView(const Mat4d& rotation, ProjectionType type, const StelProjector::StelProjectorParams& params);
+	//! Restore the view and the projection saved by beginView().
+	void endView();
+
 	Vec3d altAzToEquinoxEqu(const Vec3d& v, RefractionMode refMode=RefractionAuto) const;
 	Vec3d equinoxEquToAltAz(const Vec3d& v, RefractionMode refMode=RefractionAuto) const;
 	Vec3d altAzToJ2000(const Vec3d& v, RefractionMode refMode=RefractionAuto) const;
@@ -247,6 +280,7 @@ public:
 
 	const QSharedPointer<class Planet> getCurrentPlanet() const;
 
+	//! Get the part of the sky which is not hidden by the landscape in the J2000 frame, see LandscapeMgr::getVisibleSkyCap().
 	SphericalCap getVisibleSkyArea() const;
 	
 	//! Smoothly move the observer to the given location
@@ -281,6 +315,8 @@ public:
 	//! @param jDay the date and time expressed as a julian day
 	//! @return Delta-T in seconds
 	//! @note Thanks to Rob van Gent which create a collection from many formulas for calculation of Delta-T: http://www.staff.science.uu.nl/~gent0113/deltat/deltat.htm
+	//! @note The last values computed are memorized, so that calling this many times per frame
+	//! for the same dates is cheap. This method can be called from several threads.
 	double getDeltaT(double jDay) const;
 
 	//! Get info about valid range for current algorithm for calculation of Delta-T
@@ -296,6 +332,8 @@ public slots:
 
 	//! Get the current Mapping used by the Projection
 	QString getCurrentProjectionTypeKey(void) const;
+	//! Get the projection type of a key, ProjectionStereographic if the key is unknown.
+	ProjectionType projectionTypeKeyToProjectionType(const QString& key) const;
 	//! Set the current ProjectionType to use from its key
 	void setCurrentProjectionTypeKey(QString type);
 
@@ -303,7 +341,7 @@ public slots:
 	QStringList getAllProjectionTypeKeys() const;
 
 	//! Set the current algorithm for time correction (DeltaT)
-	void setCurrentDeltaTAlgorithm(DeltaTAlgorithm algorithm) { currentDeltaTAlgorithm=algorithm; }
+	void setCurrentDeltaTAlgorithm(DeltaTAlgorithm algorithm) { currentDeltaTAlgorithm=algorithm; clearDeltaTCache(); }
 	//! Get the current algorithm for time correction (DeltaT)
 	DeltaTAlgorithm getCurrentDeltaTAlgorithm() const { return currentDeltaTAlgorithm; }
 	//! Get description of the current algorithm for time correction
@@ -497,13 +535,13 @@ public slots:
 
 	//! Set year for custom equation for calculation of Delta-T
 	//! @param y the year, e.g. 1820
-	void setDeltaTCustomYear(float y) { deltaTCustomYear=y; }
+	void setDeltaTCustomYear(float y) { deltaTCustomYear=y; clearDeltaTCache(); }
 	//! Set n-dot for custom equation for calculation of Delta-T
 	//! @param y the n-dot value, e.g. -26.0
-	void setDeltaTCustomNDot(float v) { deltaTCustomNDot=v; }
+	void setDeltaTCustomNDot(float v) { deltaTCustomNDot=v; clearDeltaTCache(); }
 	//! Set coefficients for custom equation for calculation of Delta-T
 	//! @param y the coefficients, e.g. -20,0,32
-	void setDeltaTCustomEquationCoefficients(Vec3f c) { deltaTCustomEquationCoeff=c; }
+	void setDeltaTCustomEquationCoefficients(Vec3f c) { deltaTCustomEquationCoeff=c; clearDeltaTCache(); }
 
 	//! Get year for custom equation for calculation of Delta-T
 	float getDeltaTCustomYear() const { return deltaTCustomYear; }
@@ -522,6 +560,7 @@ private:
 	StelToneReproducer* toneConverter;		// Tones conversion between stellarium world and display device
 	StelSkyDrawer* skyDrawer;
 	StelMovementMgr* movementMgr;		// Manage vision movements
+	StelRiseSet* riseSet;			// Rise, transit and set times cached for the current day
 
 	// Manage geodesic grid
 	mutable StelGeodesicGrid* geodesicGrid;
@@ -535,6 +574,29 @@ private:
 	// Parameters to use when creating new instances of StelProjector
 	StelProjector::StelProjectorParams currentProjectorParams;
 
+	// Stereo rendering mode and per eye lens center offset in pixels
+	StereoMode stereoMode;
+	float stereoLensOffset;
+
+	//! A projector returned by getProjection(FrameType, RefractionMode), with the state it was built for.
+	struct CachedProjection
+	{
+		StelProjectorP prj;
+		ProjectionType projectionType;
+		StelProjector::StelProjectorParams params;
+		float refractionPressure;
+		float refractionTemperature;
+	};
+	//! The projectors indexed by frame type and by whether refraction is applied.
+	//! They are dropped when the view direction changes, and all but the AltAz ones when the transformation
+	//! matrices change, so that the results kept for a projector, like the tessellated arcs of StelPainter,
+	//! remain valid for the horizon frame while the time runs.
+	mutable CachedProjection projectionCache[FrameGalactic+1][2];
+	void clearProjectionCache(bool keepAltAz=false);
+
+	//! Update the transformation matrices between the frames. Only the matrices whose inputs changed
+	//! since the last call are computed again, and the projectors are kept when nothing changed,
+	//! e.g. when the time is stopped.
 	void updateTransformMatrices();
 	void updateTime(double deltaTime);
 	void resetSync();
@@ -549,9 +611,26 @@ private:
 	Mat4d matJ2000ToEquinoxEqu;
 	Mat4d matJ2000ToAltAz;
 
+	//! The observer state the matrices above were computed from, see updateTransformMatrices().
+	struct TransformInputs
+	{
+		TransformInputs() : valid(false), distanceFromCenter(0.) {}
+		bool valid;
+		Mat4d rotAltAzToEquatorial;
+		Mat4d rotEquatorialToVsop87;
+		Vec3d centerVsop87Pos;
+		double distanceFromCenter;
+	};
+	TransformInputs transformInputs;
+
 	Mat4d matAltAzModelView;           // Modelview matrix for observer-centric altazimuthal drawing
 	Mat4d invertMatAltAzModelView;     // Inverted modelview matrix for observer-centric altazimuthal drawing
 
+	// View and projection saved while another view is drawn, see beginView()
+	Mat4d savedModelView;
+	StelProjector::StelProjectorParams savedProjectorParams;
+	ProjectionType savedProjectionType;
+
 	// Position variables
 	StelObserver* position;
 	// The ID of the default startup location
@@ -571,6 +650,22 @@ private:
 	float deltaTCustomNDot;
 	float deltaTCustomYear;
 
+	//! The last values of Delta-T computed, used as a ring buffer.
+	struct DeltaTCacheEntry
+	{
+		double jDay;
+		double deltaT;
+	};
+	static const int DeltaTCacheSize = 4;
+	mutable DeltaTCacheEntry deltaTCache[DeltaTCacheSize];
+	mutable int deltaTCacheCount;
+	mutable int deltaTCacheNext;
+	mutable QMutex deltaTCacheMutex;
+	//! Compute Delta-T with the current algorithm, without using the cache.
+	double computeDeltaT(double jDay) const;
+	//! Forget the memorized values, to be called when the algorithm or its parameters change.
+	void clearDeltaTCache();
+
 };
 
 #endif // _STELCORE_HPP_
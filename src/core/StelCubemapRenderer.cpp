@@ -0,0 +1,231 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelCubemapRenderer.hpp"
+#include "StelPainter.hpp"
+
+#include <QDebug>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QVector4D>
+
+#include <cmath>
+
+//! Get the number of pixels per radian of a fisheye projection, in device pixels.
+static float fisheyePixelPerRad(const StelProjector::StelProjectorParams& params)
+{
+	return 0.5f*params.viewportFovDiameter*params.devicePixelsPerPixel/(params.fov*(M_PI/360.f));
+}
+
+StelCubemapRenderer::StelCubemapRenderer(int faceSize)
+	: faceSize(qMax(faceSize, 0))
+	, shaderInitialized(false)
+	, resampleProgram(NULL)
+{
+}
+
+StelCubemapRenderer::~StelCubemapRenderer()
+{
+	delete resampleProgram;
+}
+
+Mat4d StelCubemapRenderer::getFaceRotation(Face face)
+{
+	// The view looks toward -z, each rotation brings the center of the face there
+	switch (face)
+	{
+		case FaceRight:
+			return Mat4d::yrotation(M_PI_2);
+		case FaceLeft:
+			return Mat4d::yrotation(-M_PI_2);
+		case FaceTop:
+			return Mat4d::xrotation(-M_PI_2);
+		case FaceBottom:
+			return Mat4d::xrotation(M_PI_2);
+		default:
+			return Mat4d::identity();
+	}
+}
+
+StelProjector::StelProjectorParams StelCubemapRenderer::getFaceParams(const StelProjector::StelProjectorParams& params, int faceSize)
+{
+	StelProjector::StelProjectorParams faceParams = params;
+	faceParams.viewportXywh.set(0, 0, faceSize, faceSize);
+	faceParams.viewportCenter.set(0.5f*faceSize, 0.5f*faceSize);
+	faceParams.viewportFovDiameter = faceSize;
+	faceParams.fov = 90.f;
+	faceParams.flipHorz = false;
+	faceParams.flipVert = false;
+	faceParams.maskType = StelProjector::MaskNone;
+	return faceParams;
+}
+
+int StelCubemapRenderer::getFaceSize(const StelProjector::StelProjectorParams& params) const
+{
+	if (faceSize>0)
+		return faceSize;
+	// The perspective of 90 degrees has size/2 pixels per radian at the center of the face
+	const int size = qRound(2.f*fisheyePixelPerRad(params)/params.devicePixelsPerPixel);
+	return qBound(64, size+(size&1), 8192);
+}
+
+bool StelCubemapRenderer::useHalfFaces(const StelProjector::StelProjectorParams& params, const QSize& bufferSize)
+{
+	// Largest distance to the center of the view in the buffer, or in the fisheye disk if it is masked
+	const float cx = params.viewportCenter[0]*params.devicePixelsPerPixel;
+	const float cy = params.viewportCenter[1]*params.devicePixelsPerPixel;
+	const float dx = qMax(cx, bufferSize.width()-cx);
+	const float dy = qMax(cy, bufferSize.height()-cy);
+	float radius = std::sqrt(dx*dx+dy*dy);
+	if (params.maskType==StelProjector::MaskDisk)
+		radius = qMin(radius, 0.5f*params.viewportFovDiameter*params.devicePixelsPerPixel);
+	return radius/fisheyePixelPerRad(params)<=M_PI_2;
+}
+
+QRect StelCubemapRenderer::getFaceRect(Face face, int faceSize, bool halfFaces)
+{
+	if (!halfFaces)
+		return QRect(0, 0, faceSize, faceSize);
+	// The half of each side face toward the front face
+	const int half = faceSize/2;
+	switch (face)
+	{
+		case FaceRight:
+			return QRect(0, 0, half, faceSize);
+		case FaceLeft:
+			return QRect(half, 0, faceSize-half, faceSize);
+		case FaceTop:
+			return QRect(0, 0, faceSize, half);
+		case FaceBottom:
+			return QRect(0, half, faceSize, faceSize-half);
+		default:
+			return QRect(0, 0, faceSize, faceSize);
+	}
+}
+
+bool StelCubemapRenderer::initShader() const
+{
+	shaderInitialized = true;
+
+	const char* vsrc =
+		"attribute highp vec2 pos;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = vec4(2.*pos-vec2(1.), 0., 1.);\n"
+		"}\n";
+	// The direction of each pixel is found from the fisheye projection, then looked up in the face of its major axis
+	const char* fsrc =
+		"uniform sampler2D face0;\n"
+		"uniform sampler2D face1;\n"
+		"uniform sampler2D face2;\n"
+		"uniform sampler2D face3;\n"
+		"uniform sampler2D face4;\n"
+		"uniform highp vec4 faceRects[5];\n"
+		"uniform highp vec2 center;\n"
+		"uniform highp vec2 scale;\n"
+		"uniform highp float maskRadius;\n"
+		"highp vec2 faceCoord(highp vec2 p, highp vec4 rect)\n"
+		"{\n"
+		"    return ((0.5*p+vec2(0.5))-rect.xy)/rect.zw;\n"
+		"}\n"
+		"void main(void)\n"
+		"{\n"
+		"    highp vec2 p = gl_FragCoord.xy-center;\n"
+		"    highp vec2 v = p*scale;\n"
+		"    highp float a = length(v);\n"
+		"    highp vec3 d = vec3(a>0. ? v*(sin(a)/a) : v, -cos(a));\n"
+		"    highp vec3 ad = abs(d);\n"
+		"    mediump vec3 color = vec3(0.);\n"
+		"    if (maskRadius>0. && dot(p, p)>maskRadius*maskRadius)\n"
+		"        discard;\n"
+		"    if (d.z<=0. && ad.z>=ad.x && ad.z>=ad.y)\n"
+		"        color = texture2D(face0, faceCoord(d.xy/ad.z, faceRects[0])).rgb;\n"
+		"    else if (d.z>0. && ad.z>max(ad.x, ad.y))\n"
+		"        discard;\n"
+		"    else if (ad.x>=ad.y && d.x>0.)\n"
+		"        color = texture2D(face1, faceCoord(vec2(d.z, d.y)/ad.x, faceRects[1])).rgb;\n"
+		"    else if (ad.x>=ad.y)\n"
+		"        color = texture2D(face2, faceCoord(vec2(-d.z, d.y)/ad.x, faceRects[2])).rgb;\n"
+		"    else if (d.y>0.)\n"
+		"        color = texture2D(face3, faceCoord(vec2(d.x, d.z)/ad.y, faceRects[3])).rgb;\n"
+		"    else\n"
+		"        color = texture2D(face4, faceCoord(vec2(d.x, -d.z)/ad.y, faceRects[4])).rgb;\n"
+		"    gl_FragColor = vec4(color, 1.);\n"
+		"}\n";
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelCubemapRenderer: Warnings while compiling vshader: " << vshader.log(); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelCubemapRenderer: Warnings while compiling fshader: " << fshader.log(); }
+	resampleProgram = new QOpenGLShaderProgram();
+	resampleProgram->addShader(&vshader);
+	resampleProgram->addShader(&fshader);
+	if (!StelPainter::linkProg(resampleProgram, "cubemapResampleShader"))
+	{
+		delete resampleProgram;
+		resampleProgram = NULL;
+		return false;
+	}
+	return true;
+}
+
+void StelCubemapRenderer::resample(const QOpenGLFramebufferObject* const faces[NbFaces], int faceSize, bool halfFaces,
+				   const StelProjector::StelProjectorParams& params, const QSize& bufferSize) const
+{
+	if (!shaderInitialized)
+		initShader();
+	if (!resampleProgram)
+		return;
+
+	static const char* samplerNames[NbFaces] = {"face0", "face1", "face2", "face3", "face4"};
+	glViewport(0, 0, bufferSize.width(), bufferSize.height());
+	resampleProgram->bind();
+	QVector4D rects[NbFaces];
+	for (int i=0; i<NbFaces; ++i)
+	{
+		glActiveTexture(GL_TEXTURE0+i);
+		glBindTexture(GL_TEXTURE_2D, faces[i]->texture());
+		// The faces are magnified near the center of the fisheye and their borders must not wrap
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		resampleProgram->setUniformValue(samplerNames[i], i);
+		const QRect r = getFaceRect((Face)i, faceSize, halfFaces);
+		rects[i] = QVector4D((float)r.x()/faceSize, (float)r.y()/faceSize, (float)r.width()/faceSize, (float)r.height()/faceSize);
+	}
+	resampleProgram->setUniformValueArray("faceRects", rects, NbFaces);
+
+	const float pixelPerRad = fisheyePixelPerRad(params);
+	resampleProgram->setUniformValue("center", params.viewportCenter[0]*params.devicePixelsPerPixel, params.viewportCenter[1]*params.devicePixelsPerPixel);
+	resampleProgram->setUniformValue("scale", (params.flipHorz ? -1.f : 1.f)/pixelPerRad, (params.flipVert ? -1.f : 1.f)/pixelPerRad);
+	resampleProgram->setUniformValue("maskRadius", params.maskType==StelProjector::MaskDisk ? 0.5f*params.viewportFovDiameter*params.devicePixelsPerPixel : 0.f);
+
+	static const float quad[8] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 1.f};
+	glDisable(GL_BLEND);
+	const int pos = resampleProgram->attributeLocation("pos");
+	resampleProgram->enableAttributeArray(pos);
+	resampleProgram->setAttributeArray(pos, GL_FLOAT, quad, 2);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	resampleProgram->disableAttributeArray(pos);
+	resampleProgram->release();
+	glActiveTexture(GL_TEXTURE0);
+}
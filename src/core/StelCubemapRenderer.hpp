@@ -0,0 +1,84 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELCUBEMAPRENDERER_HPP_
+#define _STELCUBEMAPRENDERER_HPP_
+
+#include "VecMath.hpp"
+#include "StelProjector.hpp"
+
+#include <QRect>
+#include <QSize>
+
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+
+//! @class StelCubemapRenderer
+//! Draw the fisheye view of a dome from the faces of a cube map instead of the fisheye projector.
+//! The fisheye projector is non linear, so the lines and the spheres are finely tessellated and the
+//! discontinuities are checked for each vertex. The faces of the cube use a 90 degrees perspective,
+//! which is linear, and are then resampled in the fisheye buffer in a single pass, see StelCore::beginView().
+//! The front face and the four side faces cover the view up to 135 degrees from its center, the side faces are
+//! only drawn on their half toward the center of the view when the fisheye does not go beyond 90 degrees.
+class StelCubemapRenderer
+{
+public:
+	//! The faces of the cube, in the view frame of the fisheye.
+	enum Face
+	{
+		FaceFront,
+		FaceRight,
+		FaceLeft,
+		FaceTop,
+		FaceBottom,
+		NbFaces
+	};
+
+	//! @param faceSize the size of the faces in pixels, 0 to match the resolution at the center of the fisheye.
+	StelCubemapRenderer(int faceSize=0);
+	~StelCubemapRenderer();
+
+	//! Get the rotation from the view frame of the fisheye to the view frame of a face.
+	static Mat4d getFaceRotation(Face face);
+	//! Get the projection of a face of the given size, the flips and the mask of the fisheye being applied by resample().
+	static StelProjector::StelProjectorParams getFaceParams(const StelProjector::StelProjectorParams& params, int faceSize);
+	//! Get the size of the faces in pixels for a fisheye projection.
+	int getFaceSize(const StelProjector::StelProjectorParams& params) const;
+	//! Get whether only the inner half of the side faces is seen in a buffer of the given size.
+	static bool useHalfFaces(const StelProjector::StelProjectorParams& params, const QSize& bufferSize);
+	//! Get the region of a face which is drawn, from its bottom left corner.
+	//! @param faceSize the size of the face in device pixels.
+	static QRect getFaceRect(Face face, int faceSize, bool halfFaces);
+
+	//! Resample the faces in the fisheye view of the given projection, in the currently bound buffer of the given size.
+	//! @param faces the textures of the faces, drawn in the regions returned by getFaceRect().
+	void resample(const QOpenGLFramebufferObject* const faces[NbFaces], int faceSize, bool halfFaces,
+		      const StelProjector::StelProjectorParams& params, const QSize& bufferSize) const;
+
+private:
+	//! Build the resampling shader, return false if it is not possible.
+	bool initShader() const;
+
+	const int faceSize;
+
+	mutable bool shaderInitialized;
+	mutable QOpenGLShaderProgram* resampleProgram;
+};
+
+#endif // _STELCUBEMAPRENDERER_HPP_
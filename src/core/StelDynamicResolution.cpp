@@ -0,0 +1,225 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelDynamicResolution.hpp"
+#include "StelPainter.hpp"
+
+#include <QDebug>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#ifndef QT_OPENGL_ES_2
+#include <QOpenGLTimerQuery>
+#endif
+
+#include <cmath>
+
+const float StelDynamicResolution::ScaleStep = 0.05f;
+
+StelDynamicResolution::StelDynamicResolution(double budget, float minScale, float sharpness)
+	: budget(qMax(budget, 0.001))
+	, minScale(qBound(0.25f, minScale, 1.f))
+	, sharpness(qBound(0.f, sharpness, 1.f))
+	, scale(1.f)
+	, smoothedTime(-1.)
+	, framesUntilChange(0)
+	, gpuTimerSupported(-1)
+	, currentSlot(0)
+	, measuring(false)
+	, shaderInitialized(false)
+	, upscaleProgram(NULL)
+{
+	for (int i=0; i<NbQueryFrames; ++i)
+	{
+		beginQueries[i] = NULL;
+		endQueries[i] = NULL;
+		pending[i] = false;
+	}
+}
+
+StelDynamicResolution::~StelDynamicResolution()
+{
+#ifndef QT_OPENGL_ES_2
+	for (int i=0; i<NbQueryFrames; ++i)
+	{
+		delete beginQueries[i];
+		delete endQueries[i];
+	}
+#endif
+	delete upscaleProgram;
+}
+
+QSize StelDynamicResolution::getScaledSize(const QSize& bufferSize) const
+{
+	return QSize(qMax(1, qRound(bufferSize.width()*scale)), qMax(1, qRound(bufferSize.height()*scale)));
+}
+
+void StelDynamicResolution::beginGpuTime()
+{
+#ifndef QT_OPENGL_ES_2
+	if (gpuTimerSupported==-1)
+	{
+		gpuTimerSupported = 1;
+		for (int i=0; i<NbQueryFrames && gpuTimerSupported==1; ++i)
+		{
+			beginQueries[i] = new QOpenGLTimerQuery();
+			endQueries[i] = new QOpenGLTimerQuery();
+			if (!beginQueries[i]->create() || !endQueries[i]->create())
+			{
+				qWarning() << "OpenGL timer queries are not supported: the resolution of the sky is not scaled.";
+				gpuTimerSupported = 0;
+			}
+		}
+	}
+	if (gpuTimerSupported==0)
+		return;
+	// The queries of this slot are reused only once their results were read
+	collect(currentSlot);
+	if (pending[currentSlot])
+		return;
+	beginQueries[currentSlot]->recordTimestamp();
+	measuring = true;
+#endif
+}
+
+void StelDynamicResolution::endGpuTime()
+{
+#ifndef QT_OPENGL_ES_2
+	if (!measuring)
+		return;
+	endQueries[currentSlot]->recordTimestamp();
+	pending[currentSlot] = true;
+	measuring = false;
+	currentSlot = (currentSlot+1)%NbQueryFrames;
+	// The oldest frames first
+	for (int i=0; i<NbQueryFrames; ++i)
+		collect((currentSlot+i)%NbQueryFrames);
+#endif
+}
+
+void StelDynamicResolution::collect(int slot)
+{
+#ifndef QT_OPENGL_ES_2
+	if (!pending[slot] || !endQueries[slot]->isResultAvailable())
+		return;
+	const GLuint64 begin = beginQueries[slot]->waitForResult();
+	const GLuint64 end = endQueries[slot]->waitForResult();
+	pending[slot] = false;
+	updateScale((end-begin)/1e9);
+#else
+	Q_UNUSED(slot);
+#endif
+}
+
+void StelDynamicResolution::updateScale(double gpuTime)
+{
+	smoothedTime = smoothedTime<0. ? gpuTime : smoothedTime+0.2*(gpuTime-smoothedTime);
+	if (framesUntilChange>0)
+	{
+		--framesUntilChange;
+		return;
+	}
+
+	// The fill cost is about proportional to the number of pixels, i.e. to the square of the scale.
+	// A margin under the budget avoids going back and forth between two scales,
+	// and the scale goes down faster than it goes up.
+	float newScale = scale*std::sqrt(0.9*budget/qMax(smoothedTime, 1e-6));
+	newScale = qBound(scale-4.f*ScaleStep, newScale, scale+ScaleStep);
+	newScale = qBound(minScale, std::floor(newScale/ScaleStep+0.5f)*ScaleStep, 1.f);
+	if (newScale==scale)
+		return;
+	scale = newScale;
+	// The times measured in the frames already issued are the ones of the previous scale
+	smoothedTime = -1.;
+	framesUntilChange = NbQueryFrames;
+}
+
+bool StelDynamicResolution::initShader() const
+{
+	shaderInitialized = true;
+
+	const char* vsrc =
+		"attribute highp vec2 pos;\n"
+		"varying highp vec2 texc;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = vec4(2.*pos-vec2(1.), 0., 1.);\n"
+		"    texc = pos;\n"
+		"}\n";
+	// Bilinear upscale with an unsharp mask on the four neighbour texels
+	const char* fsrc =
+		"varying highp vec2 texc;\n"
+		"uniform sampler2D tex;\n"
+		"uniform highp vec2 texelSize;\n"
+		"uniform mediump float sharpness;\n"
+		"void main(void)\n"
+		"{\n"
+		"    mediump vec3 c = texture2D(tex, texc).rgb;\n"
+		"    mediump vec3 n = texture2D(tex, texc+vec2(0., texelSize.y)).rgb\n"
+		"                   + texture2D(tex, texc-vec2(0., texelSize.y)).rgb\n"
+		"                   + texture2D(tex, texc+vec2(texelSize.x, 0.)).rgb\n"
+		"                   + texture2D(tex, texc-vec2(texelSize.x, 0.)).rgb;\n"
+		"    gl_FragColor = vec4(clamp(c+sharpness*(4.*c-n), 0., 1.), 1.);\n"
+		"}\n";
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelDynamicResolution: Warnings while compiling vshader: " << vshader.log(); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelDynamicResolution: Warnings while compiling fshader: " << fshader.log(); }
+	upscaleProgram = new QOpenGLShaderProgram();
+	upscaleProgram->addShader(&vshader);
+	upscaleProgram->addShader(&fshader);
+	if (!StelPainter::linkProg(upscaleProgram, "dynamicResolutionUpscaleShader"))
+	{
+		delete upscaleProgram;
+		upscaleProgram = NULL;
+		return false;
+	}
+	return true;
+}
+
+void StelDynamicResolution::upscale(const QOpenGLFramebufferObject* scaled, const QSize& bufferSize) const
+{
+	if (!shaderInitialized)
+		initShader();
+	if (!upscaleProgram)
+		return;
+
+	glViewport(0, 0, bufferSize.width(), bufferSize.height());
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, scaled->texture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	upscaleProgram->bind();
+	upscaleProgram->setUniformValue("tex", 0);
+	upscaleProgram->setUniformValue("texelSize", 1.f/scaled->width(), 1.f/scaled->height());
+	upscaleProgram->setUniformValue("sharpness", sharpness);
+
+	static const float quad[8] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 1.f};
+	glDisable(GL_BLEND);
+	const int pos = upscaleProgram->attributeLocation("pos");
+	upscaleProgram->enableAttributeArray(pos);
+	upscaleProgram->setAttributeArray(pos, GL_FLOAT, quad, 2);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	upscaleProgram->disableAttributeArray(pos);
+	upscaleProgram->release();
+}
@@ -0,0 +1,93 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELDYNAMICRESOLUTION_HPP_
+#define _STELDYNAMICRESOLUTION_HPP_
+
+#include <QSize>
+
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+class QOpenGLTimerQuery;
+
+//! @class StelDynamicResolution
+//! Scale the resolution at which the sky is drawn to keep its GPU time within a budget.
+//! The GPU time of the sky is measured with timer queries, read a few frames later to avoid stalling the
+//! pipeline. When it goes over the budget the sky is drawn in a smaller buffer, the fill cost being about
+//! proportional to the number of pixels, and the resolution goes back up when the time allows it.
+//! The small buffer is drawn with the projection of the full one, see StelPainter::setRenderRegion(), then
+//! upscaled with a sharpening filter. The GUI is drawn over the upscaled sky, at the native resolution.
+//! Without timer queries, as on OpenGL ES, the sky is always drawn at the native resolution.
+class StelDynamicResolution
+{
+public:
+	//! @param budget the GPU time of the sky to stay under, in seconds.
+	//! @param minScale the smallest resolution relative to the native one.
+	//! @param sharpness the strength of the sharpening of the upscaled sky, 0 to disable it.
+	StelDynamicResolution(double budget=0.014, float minScale=0.5f, float sharpness=0.2f);
+	~StelDynamicResolution();
+
+	//! Get the current resolution relative to the native one, 1 when the sky is drawn at the native resolution.
+	float getScale() const {return scale;}
+	//! Get the size of the buffer in which the sky of a buffer of the given size is drawn.
+	QSize getScaledSize(const QSize& bufferSize) const;
+
+	//! Start measuring the GPU time of the sky, to be called with the GL context current.
+	void beginGpuTime();
+	//! Stop measuring the GPU time of the sky, and update the scale from the times already available.
+	void endGpuTime();
+
+	//! Draw the scaled sky texture in the currently bound buffer of the given size.
+	void upscale(const QOpenGLFramebufferObject* scaled, const QSize& bufferSize) const;
+
+private:
+	//! Number of frames for which the timer queries are kept before their results are read.
+	static const int NbQueryFrames = 3;
+	//! Step of the scale, so that the buffers of the pool are reused while the scale stays close.
+	static const float ScaleStep;
+
+	//! Read the results of the queries of a frame if they are available.
+	void collect(int slot);
+	//! Change the scale from the GPU time of a frame, in seconds.
+	void updateScale(double gpuTime);
+	//! Build the upscaling shader, return false if it is not possible.
+	bool initShader() const;
+
+	const double budget;
+	const float minScale;
+	const float sharpness;
+	float scale;
+	//! Exponential average of the GPU time, negative when no time was measured at the current scale.
+	double smoothedTime;
+	//! Number of measured frames to wait before changing the scale again.
+	int framesUntilChange;
+
+	//! Whether the timer queries are supported, -1 if not known yet.
+	int gpuTimerSupported;
+	int currentSlot;
+	bool measuring;
+	QOpenGLTimerQuery* beginQueries[NbQueryFrames];
+	QOpenGLTimerQuery* endQueries[NbQueryFrames];
+	bool pending[NbQueryFrames];
+
+	mutable bool shaderInitialized;
+	mutable QOpenGLShaderProgram* upscaleProgram;
+};
+
+#endif // _STELDYNAMICRESOLUTION_HPP_
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <QtGlobal>
+#include <QAtomicInt>
 
 //! @class StelFader
 //! Manages a (usually smooth) transition between two states (typically ON/OFF) in function of a counter
@@ -48,9 +49,14 @@ public:
 	virtual void setMaxValue(float _max) {maxValue = _max;}
 	float getMinValue() {return minValue;}
 	float getMaxValue() {return maxValue;}
+	//! Get a counter incremented each time a fader changes its value, used to find whether
+	//! anything changed since the last frame, see StelApp::isFrameDirty().
+	static unsigned int getTransitionCounter() {return (unsigned int)transitionCounter.load();}
 protected:
 	bool state;
 	float minValue, maxValue;
+	//! Atomic, as the faders of the modules updated in parallel change it at the same time.
+	static QAtomicInt transitionCounter;
 };
 
 //! @class BooleanFader
@@ -67,7 +73,7 @@ public:
 	float getInterstate() const {return state ? maxValue : minValue;}
 	float getInterstatePercentage() const {return state ? 100.f : 0.f;}
 	// Switchors can be used just as bools
-	StelFader& operator=(bool s) {state=s; return *this;}
+	StelFader& operator=(bool s) {if (state!=s) transitionCounter.ref(); state=s; return *this;}
 	virtual float getDuration() {return 0.f;}
 protected:
 };
@@ -97,6 +103,7 @@ public:
 	void update(int deltaTicks)
 	{
 		if (!isTransiting) return; // We are not in transition
+		transitionCounter.ref();
 		counter+=deltaTicks;
 		if (counter>=duration)
 		{
@@ -180,6 +187,7 @@ public:
 	void update(int deltaTicks)
 	{
 		if (!isTransiting) return; // We are not in transition
+		transitionCounter.ref();
 		counter+=deltaTicks;
 		if (counter>=duration)
 		{
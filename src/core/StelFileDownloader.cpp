@@ -0,0 +1,429 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelFileDownloader.hpp"
+#include "StelApp.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSettings>
+#include <QTimer>
+
+StelFileDownloader::StelFileDownloader(const QUrl& aurl, const QString& apath, const QByteArray& amd5, QObject* parent)
+	: QObject(parent)
+	, url(aurl)
+	, requestUrl(aurl)
+	, path(apath)
+	, md5(amd5.toLower())
+	, partFile(apath + ".part")
+	, totalSize(-1)
+	, bytesReceived(0)
+	, hash(QCryptographicHash::Md5)
+	, hashedSize(0)
+	, redirections(0)
+{
+}
+
+StelFileDownloader::~StelFileDownloader()
+{
+	abortReplies();
+}
+
+bool StelFileDownloader::start(const QByteArray& auserAgent)
+{
+	if (isRunning())
+		return true;
+	userAgent = auserAgent;
+	error.clear();
+	redirections = 0;
+	requestUrl = url;
+	if (!partFile.isOpen() && !partFile.open(QIODevice::ReadWrite))
+	{
+		error = QString("Can't open a writable file for storing %1").arg(QDir::toNativeSeparators(partFile.fileName()));
+		return false;
+	}
+
+	loadState();
+	chunksRequested = QBitArray(chunksDone.size());
+	bytesReceived = 0;
+	for (int i=0;i<chunksDone.size();++i)
+	{
+		if (chunksDone.testBit(i))
+			bytesReceived += getChunkEnd(i)-i*ChunkSize;
+	}
+	// The hash can't be saved, the part received by the previous runs is read again
+	hash.reset();
+	hashedSize = 0;
+	if (!hashCompletedChunks())
+	{
+		error = QString("Can't read %1").arg(QDir::toNativeSeparators(partFile.fileName()));
+		partFile.close();
+		return false;
+	}
+	if (bytesReceived>0)
+		qDebug() << "Resuming the download of" << QDir::toNativeSeparators(path) << "at" << bytesReceived << "of" << totalSize << "bytes";
+
+	if (totalSize<0)
+	{
+		// The first range also tells the size of the file
+		request(0);
+	}
+	else if (chunksDone.count(true)==chunksDone.size())
+	{
+		QTimer::singleShot(0, this, SLOT(complete()));
+		return true;
+	}
+	else
+	{
+		fillRequests();
+	}
+	emit(progress(bytesReceived, totalSize));
+	return true;
+}
+
+void StelFileDownloader::abort()
+{
+	if (!isRunning())
+		return;
+	qDebug() << "Aborting the download of" << QDir::toNativeSeparators(path);
+	abortReplies();
+	partFile.close();
+	error = "Download aborted";
+	emit(finished(Aborted));
+}
+
+void StelFileDownloader::request(int chunk)
+{
+	Range range;
+	range.chunk = chunk;
+	range.start = chunk*ChunkSize;
+	range.pos = range.start;
+	range.end = totalSize<0 ? range.start+ChunkSize : getChunkEnd(chunk);
+	range.checked = false;
+
+	QNetworkRequest req(requestUrl);
+	req.setRawHeader("User-Agent", userAgent);
+	req.setRawHeader("Range", QString("bytes=%1-%2").arg(range.start).arg(range.end-1).toLatin1());
+	req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+	req.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+	QNetworkReply* reply = StelApp::getInstance().getNetworkAccessManager()->get(req);
+	reply->setReadBufferSize(1024*1024*2);
+	connect(reply, SIGNAL(readyRead()), this, SLOT(replyReadyRead()));
+	connect(reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+	replies.insert(reply, range);
+	if (chunk<chunksRequested.size())
+		chunksRequested.setBit(chunk);
+}
+
+void StelFileDownloader::fillRequests()
+{
+	if (chunksDone.isEmpty())
+		return;
+	for (int i=0;i<chunksDone.size() && replies.size()<MaxParallelRequests;++i)
+	{
+		if (!chunksDone.testBit(i) && !chunksRequested.testBit(i))
+			request(i);
+	}
+}
+
+bool StelFileDownloader::checkReply(QNetworkReply* reply, Range& range)
+{
+	const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if (status==206)
+	{
+		// Content-Range: bytes <first>-<last>/<size>
+		const QByteArray contentRange = reply->rawHeader("Content-Range");
+		const int dash = contentRange.indexOf('-');
+		const int slash = contentRange.indexOf('/');
+		bool okStart, okSize;
+		const qint64 first = contentRange.mid(6, dash-6).trimmed().toLongLong(&okStart);
+		const qint64 size = contentRange.mid(slash+1).trimmed().toLongLong(&okSize);
+		if (!contentRange.startsWith("bytes ") || dash<0 || slash<dash || !okStart || !okSize || first!=range.start || size<=0)
+		{
+			fail(QString("Invalid range in the reply: %1").arg(QString::fromLatin1(contentRange)));
+			return false;
+		}
+		if (totalSize<0)
+		{
+			totalSize = size;
+			if (!partFile.resize(totalSize))
+			{
+				fail(QString("Can't write %1").arg(QDir::toNativeSeparators(partFile.fileName())));
+				return false;
+			}
+			chunksDone = QBitArray(getNbChunks());
+			chunksRequested = QBitArray(getNbChunks());
+			chunksRequested.setBit(0);
+			range.end = getChunkEnd(0);
+			saveState();
+		}
+		else if (size!=totalSize)
+		{
+			// Start again from the beginning, the parts already received are of another file
+			clearState();
+			fail("The file was changed on the server");
+			return false;
+		}
+		return true;
+	}
+	if (status==200)
+	{
+		if (range.start!=0 || totalSize>=0 || replies.size()>1)
+		{
+			// The next start() downloads the whole file in one request
+			clearState();
+			fail("The server can't resume the download");
+			return false;
+		}
+		// The whole file is sent, it is hashed as it arrives
+		qDebug() << "The server does not accept range requests, downloading" << QDir::toNativeSeparators(path) << "in one request";
+		partFile.resize(0);
+		clearState();
+		const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+		totalSize = length.isValid() ? length.toLongLong() : -1;
+		range.end = -1;
+		return true;
+	}
+	fail(QString("Unexpected HTTP status %1 for %2").arg(status).arg(reply->url().toString()));
+	return false;
+}
+
+void StelFileDownloader::replyReadyRead()
+{
+	QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+	if (!reply || !replies.contains(reply))
+		return;
+	if (reply->error()!=QNetworkReply::NoError || !reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isNull())
+	{
+		// Handled when the reply is finished
+		reply->readAll();
+		return;
+	}
+
+	Range& range = replies[reply];
+	const bool firstData = !range.checked;
+	if (firstData)
+	{
+		if (!checkReply(reply, range))
+			return;
+		range.checked = true;
+	}
+	const QByteArray data = reply->readAll();
+	if (range.end>=0 && range.pos+data.size()>range.end)
+	{
+		fail(QString("The server sent too much data for %1").arg(reply->url().toString()));
+		return;
+	}
+	if (!partFile.seek(range.pos) || partFile.write(data)!=data.size())
+	{
+		fail(QString("Can't write %1").arg(QDir::toNativeSeparators(partFile.fileName())));
+		return;
+	}
+	range.pos += data.size();
+	bytesReceived += data.size();
+	if (range.end<0)
+	{
+		hash.addData(data);
+		hashedSize += data.size();
+	}
+	emit(progress(bytesReceived, totalSize));
+
+	// The other ranges can be requested once the size is known
+	if (firstData)
+		fillRequests();
+}
+
+void StelFileDownloader::replyFinished()
+{
+	QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+	if (!reply || !replies.contains(reply))
+		return;
+	const Range range = replies.take(reply);
+	reply->deleteLater();
+	if (range.chunk<chunksRequested.size())
+		chunksRequested.clearBit(range.chunk);
+
+	if (reply->error()!=QNetworkReply::NoError)
+	{
+		fail(QString("Error downloading %1: %2").arg(reply->url().toString()).arg(reply->errorString()));
+		return;
+	}
+	const QVariant redirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
+	if (!redirect.isNull())
+	{
+		if (++redirections>MaxRedirections)
+		{
+			fail(QString("Too many redirections for %1").arg(url.toString()));
+			return;
+		}
+		// The next requests go directly to the new location
+		requestUrl = reply->url().resolved(redirect.toUrl());
+		bytesReceived -= range.pos-range.start;
+		request(range.chunk);
+		return;
+	}
+	if (!range.checked)
+	{
+		fail(QString("Empty reply for %1").arg(reply->url().toString()));
+		return;
+	}
+
+	if (range.end<0)
+	{
+		totalSize = range.pos;
+		complete();
+		return;
+	}
+	if (range.pos!=range.end)
+	{
+		fail(QString("The download of %1 was interrupted").arg(reply->url().toString()));
+		return;
+	}
+	chunksDone.setBit(range.chunk);
+	saveState();
+	if (!hashCompletedChunks())
+	{
+		fail(QString("Can't read %1").arg(QDir::toNativeSeparators(partFile.fileName())));
+		return;
+	}
+	if (chunksDone.count(true)==chunksDone.size())
+		complete();
+	else
+		fillRequests();
+}
+
+bool StelFileDownloader::hashCompletedChunks()
+{
+	while (hashedSize<totalSize && !chunksDone.isEmpty())
+	{
+		const int chunk = (int)(hashedSize/ChunkSize);
+		if (!chunksDone.testBit(chunk))
+			break;
+		// The chunk was just written, it is read from the system cache
+		const qint64 end = getChunkEnd(chunk);
+		if (!partFile.seek(hashedSize))
+			return false;
+		const QByteArray data = partFile.read(end-hashedSize);
+		if (data.size()!=end-hashedSize)
+			return false;
+		hash.addData(data);
+		hashedSize = end;
+	}
+	return true;
+}
+
+void StelFileDownloader::complete()
+{
+	abortReplies();
+	partFile.close();
+	if (hashedSize!=totalSize)
+	{
+		error = QString("Incomplete file %1").arg(QDir::toNativeSeparators(partFile.fileName()));
+		emit(finished(Failed));
+		return;
+	}
+	if (!md5.isEmpty() && hash.result().toHex()!=md5)
+	{
+		qWarning() << "Error: File" << QDir::toNativeSeparators(path) << "is corrupt, MD5 mismatch! Found" << hash.result().toHex() << "expected" << md5;
+		clearState();
+		partFile.remove();
+		error = "File is corrupted";
+		emit(finished(Corrupted));
+		return;
+	}
+	clearState();
+	QFile::remove(path);
+	if (!partFile.rename(path))
+	{
+		error = QString("Can't move the downloaded file to %1").arg(QDir::toNativeSeparators(path));
+		partFile.setFileName(path + ".part");
+		emit(finished(Failed));
+		return;
+	}
+	partFile.setFileName(path + ".part");
+	emit(finished(Completed));
+}
+
+void StelFileDownloader::fail(const QString& message)
+{
+	qWarning() << "Download of" << QDir::toNativeSeparators(path) << "failed:" << message;
+	error = message;
+	abortReplies();
+	partFile.close();
+	emit(finished(Failed));
+}
+
+void StelFileDownloader::abortReplies()
+{
+	QHash<QNetworkReply*, Range>::iterator i;
+	for (i=replies.begin();i!=replies.end();++i)
+	{
+		i.key()->disconnect(this);
+		i.key()->abort();
+		i.key()->deleteLater();
+	}
+	replies.clear();
+	chunksRequested.fill(false);
+}
+
+void StelFileDownloader::loadState()
+{
+	totalSize = -1;
+	chunksDone.clear();
+	const QSettings state(getStatePath(), QSettings::IniFormat);
+	const qint64 size = state.value("size", -1).toLongLong();
+	if (state.value("url").toString()!=url.toString()
+	    || state.value("chunk_size").toLongLong()!=ChunkSize
+	    || size<=0 || partFile.size()!=size)
+	{
+		partFile.resize(0);
+		return;
+	}
+	totalSize = size;
+	chunksDone = QBitArray(getNbChunks());
+	const QByteArray done = state.value("done").toByteArray();
+	for (int i=0;i<chunksDone.size() && i<done.size();++i)
+		chunksDone.setBit(i, done.at(i)=='1');
+}
+
+void StelFileDownloader::saveState() const
+{
+	// Only the range requests can be resumed
+	if (chunksDone.isEmpty())
+		return;
+	QByteArray done(chunksDone.size(), '0');
+	for (int i=0;i<chunksDone.size();++i)
+	{
+		if (chunksDone.testBit(i))
+			done[i] = '1';
+	}
+	QSettings state(getStatePath(), QSettings::IniFormat);
+	state.setValue("url", url.toString());
+	state.setValue("size", totalSize);
+	state.setValue("chunk_size", ChunkSize);
+	state.setValue("done", done);
+}
+
+void StelFileDownloader::clearState()
+{
+	QFile::remove(getStatePath());
+}
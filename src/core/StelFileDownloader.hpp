@@ -0,0 +1,137 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELFILEDOWNLOADER_HPP_
+#define _STELFILEDOWNLOADER_HPP_
+
+#include <QBitArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+
+class QNetworkReply;
+
+//! @class StelFileDownloader
+//! Download a large file, such as the extra star catalogs, as several ranges requested in parallel.
+//! The data is written to a ".part" file next to the destination, and the ranges already received
+//! are listed in a ".part.ini" file, so that a download which was cancelled or interrupted resumes
+//! where it stopped, also after a restart. The MD5 sum is computed while the file is received, as
+//! soon as the beginning of the file is complete, so the file is not read again at the end.
+//! The file is only moved to its destination once its checksum is correct.
+//! When the server does not accept range requests, the file is downloaded as a single request,
+//! which can't be resumed.
+class StelFileDownloader : public QObject
+{
+	Q_OBJECT
+public:
+	enum Result
+	{
+		Completed,		//!< The file was downloaded, verified and moved to its destination.
+		Failed,			//!< The download failed, see errorString(). It can be resumed with start().
+		Aborted,		//!< The download was stopped by abort(). It can be resumed with start().
+		Corrupted		//!< The checksum of the file is wrong, the partial file was removed.
+	};
+
+	//! @param path the destination of the file.
+	//! @param md5 the expected MD5 sum in hexadecimal, or empty to skip the verification.
+	StelFileDownloader(const QUrl& url, const QString& path, const QByteArray& md5, QObject* parent=NULL);
+	~StelFileDownloader();
+
+	//! Start or resume the download. The finished() signal is emitted at the end.
+	//! @param userAgent the User-Agent header sent with the requests.
+	//! @return false if the partial file can't be opened, see errorString().
+	bool start(const QByteArray& userAgent);
+	//! Stop the download, keeping what was received for a later start(). Emits finished(Aborted).
+	void abort();
+	bool isRunning() const {return !replies.isEmpty();}
+
+	//! Get the description of the last error.
+	QString errorString() const {return error;}
+
+signals:
+	//! Emitted when data is received. bytesTotal is -1 until the size of the file is known.
+	void progress(qint64 bytesReceived, qint64 bytesTotal);
+	void finished(StelFileDownloader::Result result);
+
+private slots:
+	void replyReadyRead();
+	void replyFinished();
+	//! Verify the file and move it to its destination.
+	void complete();
+
+private:
+	//! The part of the file requested by a reply.
+	struct Range
+	{
+		int chunk;
+		qint64 start;
+		//! Offset of the next byte to write.
+		qint64 pos;
+		//! Offset after the last byte, -1 when the whole file is requested.
+		qint64 end;
+		//! Whether the status of the reply was checked.
+		bool checked;
+	};
+
+	//! Size of the ranges requested.
+	static const qint64 ChunkSize = 4*1024*1024;
+	static const int MaxParallelRequests = 4;
+	static const int MaxRedirections = 5;
+
+	void request(int chunk);
+	//! Send the requests of the chunks which are not received, up to MaxParallelRequests.
+	void fillRequests();
+	//! Check the status of the first data of a reply.
+	bool checkReply(QNetworkReply* reply, Range& range);
+	//! Add the chunks received after the part already hashed to the checksum.
+	bool hashCompletedChunks();
+	void fail(const QString& message);
+	void abortReplies();
+	int getNbChunks() const {return (int)((totalSize+ChunkSize-1)/ChunkSize);}
+	qint64 getChunkEnd(int chunk) const {return qMin(totalSize, (chunk+1)*ChunkSize);}
+
+	QString getStatePath() const {return partFile.fileName() + ".ini";}
+	void loadState();
+	void saveState() const;
+	void clearState();
+
+	QUrl url;
+	//! The url of the requests, after the redirections.
+	QUrl requestUrl;
+	QString path;
+	QByteArray md5;
+	QByteArray userAgent;
+	QFile partFile;
+	//! Size of the file, -1 until the first reply.
+	qint64 totalSize;
+	QBitArray chunksDone;
+	QBitArray chunksRequested;
+	QHash<QNetworkReply*, Range> replies;
+	qint64 bytesReceived;
+	QCryptographicHash hash;
+	//! Size of the beginning of the file added to the hash.
+	qint64 hashedSize;
+	int redirections;
+	QString error;
+};
+
+#endif // _STELFILEDOWNLOADER_HPP_
@@ -25,6 +25,9 @@
 #include <QDir>
 #include <QString>
 #include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QStandardPaths>
 
 #include <stdio.h>
@@ -45,6 +48,11 @@ QString StelFileMgr::userDir;
 QString StelFileMgr::screenshotDir;
 QString StelFileMgr::installDir;
 
+// Listings of the directories of the installation directory, with for each entry whether it is a directory.
+// The installation directory is not written to while running, so they stay valid until the cache is cleared.
+static QHash<QString, QHash<QString, bool> > installDirListings;
+static QMutex installDirListingsMutex;
+
 void StelFileMgr::init()
 {
 	// Set the userDir member.
@@ -175,9 +183,16 @@ QString StelFileMgr::findFile(const QString& path, Flags flags)
 	
 	foreach (const QString& i, fileLocations)
 	{
-		const QFileInfo finfo(i + "/" + path);
-		if (fileFlagsCheck(finfo, flags))
-			return i + "/" + path;
+		const QString fullPath = i + "/" + path;
+		bool found;
+		if (i==installDir && installDirFlagsCheck(path, flags, found))
+		{
+			if (found)
+				return fullPath;
+			continue;
+		}
+		if (fileFlagsCheck(QFileInfo(fullPath), flags))
+			return fullPath;
 	}
 
 	//FIXME: This line give false positive values for static plugins (trying search dynamic plugin first)
@@ -217,9 +232,16 @@ QStringList StelFileMgr::findFileInAllPaths(const QString &path, const Flags &fl
 
 	foreach (const QString& locationPath, fileLocations)
 	{
-		const QFileInfo finfo(locationPath + "/" + path);
-		if (fileFlagsCheck(finfo, flags))
-			filePaths.append(locationPath + "/" + path);
+		const QString fullPath = locationPath + "/" + path;
+		bool found;
+		if (locationPath==installDir && installDirFlagsCheck(path, flags, found))
+		{
+			if (found)
+				filePaths.append(fullPath);
+			continue;
+		}
+		if (fileFlagsCheck(QFileInfo(fullPath), flags))
+			filePaths.append(fullPath);
 	}
 
 	return filePaths;
@@ -272,6 +294,13 @@ QSet<QString> StelFileMgr::listContents(const QString& path, const StelFileMgr::
 void StelFileMgr::setSearchPaths(const QStringList& paths)
 {
 	fileLocations = paths;
+	clearCache();
+}
+
+void StelFileMgr::clearCache()
+{
+	QMutexLocker locker(&installDirListingsMutex);
+	installDirListings.clear();
 }
 
 bool StelFileMgr::exists(const QString& path)
@@ -306,6 +335,7 @@ qint64 StelFileMgr::size(const QString& path)
 
 bool StelFileMgr::mkDir(const QString& path)
 {
+	clearCache();
 	return QDir("/").mkpath(path);
 }
 
@@ -319,6 +349,52 @@ QString StelFileMgr::baseName(const QString& path)
 	return QFileInfo(path).baseName();
 }
 
+// Key of a file name in the directory listings: the file systems are usually case insensitive on Windows and OSX
+static inline QString listingKey(const QString& name)
+{
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+	return name.toLower();
+#else
+	return name;
+#endif
+}
+
+bool StelFileMgr::installDirFlagsCheck(const QString& path, const Flags& flags, bool& found)
+{
+	// The listings can only tell whether an entry exists and whether it is a directory
+	if (flags & (Writable|New))
+		return false;
+	const int sep = path.lastIndexOf('/');
+	const QString name = path.mid(sep+1);
+	if (name.isEmpty() || name=="." || name==".." || name.contains('\\'))
+		return false;
+	const QString dirPath = sep<0 ? installDir : installDir + "/" + path.left(sep);
+
+	QMutexLocker locker(&installDirListingsMutex);
+	QHash<QString, QHash<QString, bool> >::ConstIterator iter = installDirListings.constFind(dirPath);
+	if (iter==installDirListings.constEnd())
+	{
+		// A directory which doesn't exist gets an empty listing
+		QHash<QString, bool> listing;
+		const QDir dir(dirPath);
+		foreach (const QString& entry, dir.entryList(QDir::Dirs|QDir::NoDotAndDotDot|QDir::Hidden))
+			listing.insert(listingKey(entry), true);
+		foreach (const QString& entry, dir.entryList(QDir::Files|QDir::Hidden))
+			listing.insert(listingKey(entry), false);
+		iter = installDirListings.insert(dirPath, listing);
+	}
+	QHash<QString, bool>::ConstIterator entry = iter->constFind(listingKey(name));
+	if (entry==iter->constEnd())
+		found = false;
+	else if (flags & Directory)
+		found = entry.value();
+	else if (flags & File)
+		found = !entry.value();
+	else
+		found = true;
+	return true;
+}
+
 bool StelFileMgr::fileFlagsCheck(const QFileInfo& thePath, const Flags& flags)
 {
 	const bool exists = thePath.exists();
@@ -448,6 +524,7 @@ QString StelFileMgr::getCacheDir()
 
 void StelFileMgr::makeSureDirExistsAndIsWritable(const QString& dirFullPath)
 {
+	clearCache();
 	// Check that the dirFullPath directory exists
 	QFileInfo uDir(dirFullPath);
 	if (!uDir.exists())
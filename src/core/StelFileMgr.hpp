@@ -99,6 +99,11 @@ public:
 	//! @param paths is a vector of strings which will become the new search paths
 	static void setSearchPaths(const QStringList& paths);
 
+	//! Clear the cached listings of the installation directory used by findFile() and findFileInAllPaths().
+	//! It is called when directories are created or the search paths change, and has to be called
+	//! after writing into the installation directory.
+	static void clearCache();
+
 	//! Make sure the passed directory path exist and is writable.
 	//! If it doesn't exist creates it. If it's not possible throws an error.
 	static void makeSureDirExistsAndIsWritable(const QString& dirFullPath);
@@ -206,6 +211,12 @@ private:
 	//! @exception misc
 	static bool fileFlagsCheck(const QFileInfo& thePath, const Flags& flags=(Flags)0);
 
+	//! Check if a path relative to the installation directory matches a set of flags, using the cached
+	//! listing of its parent directory instead of querying the file system each time.
+	//! @param found set to whether the path exists and matches the flags.
+	//! @return false if the flags cannot be checked from the listing, then fileFlagsCheck() has to be used.
+	static bool installDirFlagsCheck(const QString& path, const Flags& flags, bool& found);
+
 	static QStringList fileLocations;
 
 	//! Used to store the user data directory
@@ -0,0 +1,139 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelFoveatedRenderer.hpp"
+#include "StelPainter.hpp"
+
+#include <QDebug>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+
+//! Fraction of the inset over which its border is faded in the periphery.
+static const float InsetFeather = 0.1f;
+
+StelFoveatedRenderer::StelFoveatedRenderer(float peripheryScale, float insetSize)
+	: peripheryScale(qBound(0.1f, peripheryScale, 1.f))
+	, insetSize(qBound(0.1f, insetSize, 1.f))
+	, gazePosition(0.5f, 0.5f)
+	, shaderInitialized(false)
+	, compositeProgram(NULL)
+{
+}
+
+StelFoveatedRenderer::~StelFoveatedRenderer()
+{
+	delete compositeProgram;
+}
+
+void StelFoveatedRenderer::setGazePosition(float x, float y)
+{
+	gazePosition.set(qBound(0.f, x, 1.f), qBound(0.f, y, 1.f));
+}
+
+QSize StelFoveatedRenderer::getPeripherySize(const QSize& bufferSize) const
+{
+	return QSize(qMax(1, qRound(bufferSize.width()*peripheryScale)), qMax(1, qRound(bufferSize.height()*peripheryScale)));
+}
+
+QRect StelFoveatedRenderer::getInsetRect(const QSize& bufferSize) const
+{
+	// The inset is square, it is kept inside the buffer when the gaze goes to its border
+	const int size = qRound(qMin(bufferSize.width(), bufferSize.height())*insetSize);
+	const int x = qBound(0, qRound(gazePosition[0]*bufferSize.width())-size/2, bufferSize.width()-size);
+	const int y = qBound(0, qRound(gazePosition[1]*bufferSize.height())-size/2, bufferSize.height()-size);
+	return QRect(x, y, size, size);
+}
+
+bool StelFoveatedRenderer::initShader() const
+{
+	shaderInitialized = true;
+
+	const char* vsrc =
+		"attribute highp vec2 pos;\n"
+		"uniform highp vec4 rect;\n"
+		"varying highp vec2 texc;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = vec4(mix(rect.xy, rect.zw, pos), 0., 1.);\n"
+		"    texc = pos;\n"
+		"}\n";
+	const char* fsrc =
+		"varying highp vec2 texc;\n"
+		"uniform sampler2D tex;\n"
+		"uniform mediump float feather;\n"
+		"void main(void)\n"
+		"{\n"
+		"    highp vec2 d = min(texc, vec2(1.)-texc);\n"
+		"    mediump float a = feather>0. ? smoothstep(0., feather, min(d.x, d.y)) : 1.;\n"
+		"    gl_FragColor = vec4(texture2D(tex, texc).rgb, a);\n"
+		"}\n";
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelFoveatedRenderer: Warnings while compiling vshader: " << vshader.log(); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelFoveatedRenderer: Warnings while compiling fshader: " << fshader.log(); }
+	compositeProgram = new QOpenGLShaderProgram();
+	compositeProgram->addShader(&vshader);
+	compositeProgram->addShader(&fshader);
+	if (!StelPainter::linkProg(compositeProgram, "foveatedCompositeShader"))
+	{
+		delete compositeProgram;
+		compositeProgram = NULL;
+		return false;
+	}
+	return true;
+}
+
+void StelFoveatedRenderer::drawRect(unsigned int texture, const QRectF& rect, const QSize& bufferSize, float feather) const
+{
+	static const float quad[8] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 1.f};
+	glBindTexture(GL_TEXTURE_2D, texture);
+	compositeProgram->setUniformValue("rect",
+		(float)(2.*rect.left()/bufferSize.width()-1.), (float)(2.*rect.top()/bufferSize.height()-1.),
+		(float)(2.*rect.right()/bufferSize.width()-1.), (float)(2.*rect.bottom()/bufferSize.height()-1.));
+	compositeProgram->setUniformValue("feather", feather);
+	const int pos = compositeProgram->attributeLocation("pos");
+	compositeProgram->enableAttributeArray(pos);
+	compositeProgram->setAttributeArray(pos, GL_FLOAT, quad, 2);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	compositeProgram->disableAttributeArray(pos);
+}
+
+void StelFoveatedRenderer::composite(const QOpenGLFramebufferObject* periphery, const QOpenGLFramebufferObject* inset, const QSize& bufferSize) const
+{
+	if (!shaderInitialized)
+		initShader();
+	if (!compositeProgram)
+		return;
+
+	glViewport(0, 0, bufferSize.width(), bufferSize.height());
+	glActiveTexture(GL_TEXTURE0);
+	compositeProgram->bind();
+	compositeProgram->setUniformValue("tex", 0);
+	// QRectF is used with its top being the bottom of the buffer, like the GL viewport
+	glDisable(GL_BLEND);
+	drawRect(periphery->texture(), QRectF(0., 0., bufferSize.width(), bufferSize.height()), bufferSize, 0.f);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	drawRect(inset->texture(), QRectF(getInsetRect(bufferSize)), bufferSize, InsetFeather);
+	glDisable(GL_BLEND);
+	compositeProgram->release();
+}
@@ -0,0 +1,74 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELFOVEATEDRENDERER_HPP_
+#define _STELFOVEATEDRENDERER_HPP_
+
+#include "VecMath.hpp"
+
+#include <QRect>
+#include <QSize>
+
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+
+//! @class StelFoveatedRenderer
+//! Draw the viewport buffer of a StelViewportEffect at two resolutions to reduce the fill cost.
+//! Most of the pixels of the fisheye and head-mounted display outputs are seen in the periphery of the
+//! vision, so the whole buffer is drawn at a reduced resolution while only an inset around the gaze position
+//! is drawn at the full resolution. Both are then composited in the buffer sampled by the effect, the inset
+//! border being faded in the periphery to hide the transition.
+//! The projection is the same for both passes, see StelPainter::setRenderRegion(), so the modules are not
+//! aware of the foveation.
+class StelFoveatedRenderer
+{
+public:
+	//! @param peripheryScale the resolution of the periphery relative to the full resolution.
+	//! @param insetSize the size of the full resolution inset relative to the size of the buffer.
+	StelFoveatedRenderer(float peripheryScale=0.5f, float insetSize=0.4f);
+	~StelFoveatedRenderer();
+
+	//! Set the center of the full resolution inset, from an eye tracker for instance.
+	//! @param x,y the position in the buffer from its bottom left corner, (0.5,0.5) being its center.
+	void setGazePosition(float x, float y);
+	float getPeripheryScale() const {return peripheryScale;}
+
+	//! Get the size of the buffer in which the periphery of a buffer of the given size is drawn.
+	QSize getPeripherySize(const QSize& bufferSize) const;
+	//! Get the region of a buffer of the given size drawn at the full resolution, from its bottom left corner.
+	QRect getInsetRect(const QSize& bufferSize) const;
+
+	//! Draw the periphery and the inset textures in the currently bound buffer of the given size.
+	void composite(const QOpenGLFramebufferObject* periphery, const QOpenGLFramebufferObject* inset, const QSize& bufferSize) const;
+
+private:
+	//! Build the compositing shader, return false if it is not possible.
+	bool initShader() const;
+	//! Draw a texture on a rectangle of the bound buffer, with its border faded over the given fraction.
+	void drawRect(unsigned int texture, const QRectF& rect, const QSize& bufferSize, float feather) const;
+
+	const float peripheryScale;
+	const float insetSize;
+	Vec2f gazePosition;
+
+	mutable bool shaderInitialized;
+	mutable QOpenGLShaderProgram* compositeProgram;
+};
+
+#endif // _STELFOVEATEDRENDERER_HPP_
@@ -0,0 +1,401 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelFrameProfiler.hpp"
+#include "StelCore.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+#include "StelJsonParser.hpp"
+#include "StelApp.hpp"
+#include "StelTextureMgr.hpp"
+#include "StelMemoryStats.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFont>
+#include <QTextStream>
+#ifndef QT_OPENGL_ES_2
+#include <QOpenGLTimerQuery>
+#endif
+
+const float StelFrameProfiler::HistogramFirstBinMs = 0.125f;
+
+StelFrameProfiler::StelFrameProfiler(int nbFrames)
+	: enabled(false)
+	, nbFrames(qMax(nbFrames, 1))
+	, nbRecordedFrames(0)
+	, frameCounter(0)
+	, currentSection(-1)
+	, currentIsDraw(false)
+	, gpuTimerSupported(-1)
+{
+}
+
+StelFrameProfiler::~StelFrameProfiler()
+{
+#ifndef QT_OPENGL_ES_2
+	for (int i=0; i<NbGpuFrames; ++i)
+		qDeleteAll(gpuFrames[i].queries);
+#endif
+}
+
+void StelFrameProfiler::setEnabled(bool b)
+{
+	if (b && !enabled)
+		clear();
+	enabled = b;
+	currentSection = -1;
+}
+
+void StelFrameProfiler::setNbFrames(int n)
+{
+	nbFrames = qMax(n, 1);
+	clear();
+}
+
+void StelFrameProfiler::clear()
+{
+	sections.clear();
+	sectionIndices.clear();
+	nbRecordedFrames = 0;
+	currentSection = -1;
+	for (int i=0; i<NbGpuFrames; ++i)
+	{
+		gpuFrames[i].frame = -1;
+		gpuFrames[i].nbUsed = 0;
+	}
+}
+
+int StelFrameProfiler::getSection(const QString& name)
+{
+	QHash<QString, int>::ConstIterator iter = sectionIndices.constFind(name);
+	if (iter!=sectionIndices.constEnd())
+		return iter.value();
+
+	Section section;
+	section.name = name;
+	for (int m=0; m<NbMeasures; ++m)
+	{
+		section.samples[m].fill(0.f, nbFrames);
+		section.current[m] = 0.f;
+	}
+	sections.append(section);
+	sectionIndices.insert(name, sections.size()-1);
+	return sections.size()-1;
+}
+
+void StelFrameProfiler::beginFrame()
+{
+	if (!enabled)
+		return;
+	for (int i=0; i<sections.size(); ++i)
+	{
+		for (int m=0; m<NbMeasures; ++m)
+			sections[i].current[m] = 0.f;
+	}
+	// Read the GPU times of the previous frames which are available
+	for (int i=0; i<NbGpuFrames; ++i)
+		collectGpuResults(gpuFrames[i], false);
+}
+
+void StelFrameProfiler::beginSection(const QString& name, bool draw)
+{
+	if (!enabled)
+		return;
+	currentSection = getSection(name);
+	currentIsDraw = draw;
+	if (draw)
+		recordGpuTimestamp(currentSection);
+	sectionTimer.start();
+}
+
+void StelFrameProfiler::endSection()
+{
+	if (!enabled || currentSection<0)
+		return;
+	sections[currentSection].current[currentIsDraw ? DrawCpu : UpdateCpu] += sectionTimer.nsecsElapsed()/1e6f;
+	if (currentIsDraw)
+		recordGpuTimestamp(currentSection);
+	currentSection = -1;
+}
+
+void StelFrameProfiler::addSectionTime(const QString& name, bool draw, float ms)
+{
+	if (!enabled)
+		return;
+	sections[getSection(name)].current[draw ? DrawCpu : UpdateCpu] += ms;
+}
+
+void StelFrameProfiler::endFrame()
+{
+	if (!enabled)
+		return;
+	const int slot = frameCounter%nbFrames;
+	for (int i=0; i<sections.size(); ++i)
+	{
+		Section& section = sections[i];
+		section.samples[UpdateCpu][slot] = section.current[UpdateCpu];
+		section.samples[DrawCpu][slot] = section.current[DrawCpu];
+		// Added when the results of the timer queries are read
+		section.samples[DrawGpu][slot] = 0.f;
+	}
+	++frameCounter;
+	nbRecordedFrames = qMin(nbRecordedFrames+1, nbFrames);
+}
+
+void StelFrameProfiler::recordGpuTimestamp(int section)
+{
+#ifndef QT_OPENGL_ES_2
+	if (gpuTimerSupported==0)
+		return;
+	GpuFrame& gpuFrame = gpuFrames[frameCounter%NbGpuFrames];
+	if (gpuFrame.frame!=frameCounter)
+	{
+		// The queries of this slot were issued NbGpuFrames frames ago, so waiting for them should not stall
+		collectGpuResults(gpuFrame, true);
+		gpuFrame.frame = frameCounter;
+		gpuFrame.nbUsed = 0;
+	}
+	if (gpuFrame.nbUsed==gpuFrame.queries.size())
+	{
+		QOpenGLTimerQuery* query = new QOpenGLTimerQuery();
+		if (!query->create())
+		{
+			qWarning() << "OpenGL timer queries are not supported: the GPU times will not be measured.";
+			delete query;
+			gpuTimerSupported = 0;
+			return;
+		}
+		gpuTimerSupported = 1;
+		gpuFrame.queries.append(query);
+		gpuFrame.sections.append(-1);
+	}
+	gpuFrame.sections[gpuFrame.nbUsed] = section;
+	gpuFrame.queries[gpuFrame.nbUsed]->recordTimestamp();
+	++gpuFrame.nbUsed;
+#else
+	Q_UNUSED(section);
+	gpuTimerSupported = 0;
+#endif
+}
+
+void StelFrameProfiler::collectGpuResults(GpuFrame& gpuFrame, bool wait)
+{
+#ifndef QT_OPENGL_ES_2
+	if (gpuFrame.frame<0 || gpuFrame.frame>=frameCounter || gpuFrame.nbUsed<2)
+		return;
+	if (!wait && !gpuFrame.queries[gpuFrame.nbUsed-1]->isResultAvailable())
+		return;
+	// Skip the frames which were already removed from the ring buffers
+	if (frameCounter-gpuFrame.frame<=nbFrames)
+	{
+		const int slot = gpuFrame.frame%nbFrames;
+		for (int i=0; i+1<gpuFrame.nbUsed; i+=2)
+		{
+			const GLuint64 begin = gpuFrame.queries[i]->waitForResult();
+			const GLuint64 end = gpuFrame.queries[i+1]->waitForResult();
+			sections[gpuFrame.sections[i]].samples[DrawGpu][slot] += (end-begin)/1e6f;
+		}
+	}
+	gpuFrame.frame = -1;
+	gpuFrame.nbUsed = 0;
+#else
+	Q_UNUSED(gpuFrame);
+	Q_UNUSED(wait);
+#endif
+}
+
+QStringList StelFrameProfiler::getSectionNames() const
+{
+	QStringList names;
+	foreach (const Section& section, sections)
+		names << section.name;
+	return names;
+}
+
+StelFrameProfiler::Statistics StelFrameProfiler::getStatistics(int sectionIndex, Measure measure) const
+{
+	Q_ASSERT(sectionIndex>=0 && sectionIndex<sections.size());
+	Statistics stats;
+	stats.mean = 0.f;
+	stats.max = 0.f;
+	for (int i=0; i<NbHistogramBins; ++i)
+		stats.histogram[i] = 0;
+
+	const QVector<float>& samples = sections.at(sectionIndex).samples[measure];
+	for (int i=0; i<nbRecordedFrames; ++i)
+	{
+		const float t = samples.at((frameCounter-1-i)%nbFrames);
+		stats.mean += t;
+		stats.max = qMax(stats.max, t);
+		int bin = 0;
+		for (float limit=HistogramFirstBinMs; bin<NbHistogramBins-1 && t>=limit; limit*=2.f)
+			++bin;
+		++stats.histogram[bin];
+	}
+	if (nbRecordedFrames>0)
+		stats.mean /= nbRecordedFrames;
+	return stats;
+}
+
+QString StelFrameProfiler::measureName(Measure measure)
+{
+	switch (measure)
+	{
+		case UpdateCpu:
+			return "update_cpu";
+		case DrawCpu:
+			return "draw_cpu";
+		case DrawGpu:
+			return "draw_gpu";
+		default:
+			Q_ASSERT(0);
+	}
+	return QString();
+}
+
+void StelFrameProfiler::drawOverlay(StelCore* core) const
+{
+	if (!enabled)
+		return;
+
+	QStringList lines;
+	lines << QString("%1 %2 %3 %4").arg("ms (mean/max)", -20).arg("update", 13).arg("draw", 13).arg("gpu", 13);
+	float totals[NbMeasures] = {0.f, 0.f, 0.f};
+	for (int i=0; i<sections.size(); ++i)
+	{
+		QString line = QString("%1").arg(sections.at(i).name.left(20), -20);
+		for (int m=0; m<NbMeasures; ++m)
+		{
+			if (m==DrawGpu && gpuTimerSupported!=1)
+			{
+				line += QString(" %1").arg("-", 13);
+				continue;
+			}
+			const Statistics stats = getStatistics(i, (Measure)m);
+			totals[m] += stats.mean;
+			line += QString(" %1/%2").arg(stats.mean, 6, 'f', 2).arg(stats.max, 6, 'f', 2);
+		}
+		lines << line;
+	}
+	lines << QString("%1 %2 %3 %4").arg("Total", -20).arg(totals[UpdateCpu], 13, 'f', 2).arg(totals[DrawCpu], 13, 'f', 2).arg(totals[DrawGpu], 13, 'f', 2);
+	const StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	QString textureLine = QString("%1 %2 MB").arg("Textures", -20).arg(texMgr.getTextureMemoryUsed()/(1024.*1024.), 6, 'f', 1);
+	if (texMgr.getTextureMemoryBudget()>0)
+		textureLine += QString(" / %1 MB").arg(texMgr.getTextureMemoryBudget()/(1024*1024));
+	lines << textureLine + QString(" (%1 evictable)").arg(texMgr.getNbEvictableTextures());
+	lines << QString() << StelApp::getInstance().getMemoryStats()->getOverlayLines();
+
+	StelPainter sPainter(core->getProjection2d());
+	QFont font("DejaVu Sans Mono");
+	font.setStyleHint(QFont::TypeWriter);
+	font.setPixelSize(12);
+	sPainter.setFont(font);
+	const int lineHeight = sPainter.getFontMetrics().height();
+	int width = 0;
+	foreach (const QString& line, lines)
+		width = qMax(width, sPainter.getFontMetrics().width(line));
+
+	// The 2D projection has its origin at the bottom left of the viewport
+	const float x = 10.f;
+	const float top = core->getProjection2d()->getViewportHeight() - 10.f;
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	sPainter.setColor(0.f, 0.f, 0.f, 0.6f);
+	sPainter.drawRect2d(x-5.f, top-lines.size()*lineHeight-5.f, width+10.f, lines.size()*lineHeight+10.f, false);
+	sPainter.setColor(1.f, 1.f, 1.f, 1.f);
+	for (int i=0; i<lines.size(); ++i)
+		sPainter.drawText(x, top-(i+1)*lineHeight+sPainter.getFontMetrics().descent(), lines.at(i));
+}
+
+QString StelFrameProfiler::toCsv() const
+{
+	QString csv;
+	QTextStream out(&csv);
+	out << "section,measure,frames,mean_ms,max_ms";
+	for (int b=0; b<NbHistogramBins; ++b)
+		out << ",bin" << b;
+	out << "\n";
+	for (int i=0; i<sections.size(); ++i)
+	{
+		for (int m=0; m<NbMeasures; ++m)
+		{
+			const Statistics stats = getStatistics(i, (Measure)m);
+			out << sections.at(i).name << "," << measureName((Measure)m) << "," << nbRecordedFrames << "," << stats.mean << "," << stats.max;
+			for (int b=0; b<NbHistogramBins; ++b)
+				out << "," << stats.histogram[b];
+			out << "\n";
+		}
+	}
+	return csv;
+}
+
+QVariantMap StelFrameProfiler::toVariantMap() const
+{
+	QVariantList binLimits;
+	float limit = HistogramFirstBinMs;
+	for (int b=0; b<NbHistogramBins-1; ++b, limit*=2.f)
+		binLimits << limit;
+
+	QVariantList sectionList;
+	for (int i=0; i<sections.size(); ++i)
+	{
+		QVariantMap sectionMap;
+		sectionMap["name"] = sections.at(i).name;
+		for (int m=0; m<NbMeasures; ++m)
+		{
+			if (m==DrawGpu && gpuTimerSupported!=1)
+				continue;
+			const Statistics stats = getStatistics(i, (Measure)m);
+			QVariantMap measureMap;
+			measureMap["mean"] = stats.mean;
+			measureMap["max"] = stats.max;
+			QVariantList histogram;
+			for (int b=0; b<NbHistogramBins; ++b)
+				histogram << stats.histogram[b];
+			measureMap["histogram"] = histogram;
+			sectionMap[measureName((Measure)m)] = measureMap;
+		}
+		sectionList << sectionMap;
+	}
+
+	QVariantMap map;
+	map["frames"] = nbRecordedFrames;
+	map["histogramBinLimitsMs"] = binLimits;
+	map["sections"] = sectionList;
+	return map;
+}
+
+bool StelFrameProfiler::writeReport(const QString& fileName) const
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	{
+		qWarning() << "Cannot write the frame profile to" << QDir::toNativeSeparators(fileName);
+		return false;
+	}
+	if (QFileInfo(fileName).suffix().toLower()=="json")
+		StelJsonParser::write(toVariantMap(), &file);
+	else
+		file.write(toCsv().toUtf8());
+	file.close();
+	return true;
+}
@@ -0,0 +1,153 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELFRAMEPROFILER_HPP_
+#define _STELFRAMEPROFILER_HPP_
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+class StelCore;
+class QOpenGLTimerQuery;
+
+//! @class StelFrameProfiler
+//! Measure the time spent in each section of the main loop, i.e. in the update()
+//! and draw() calls of each StelModule, over the last frames.
+//! The CPU time is measured for the update and draw calls, and the GPU time is
+//! measured for the draw calls using OpenGL timer queries when they are supported.
+//! The GPU results are read a few frames later to avoid stalling the pipeline.
+//! The statistics can be drawn on screen or written to a CSV or JSON file.
+class StelFrameProfiler
+{
+public:
+	//! The measures done for each section.
+	enum Measure
+	{
+		UpdateCpu,	//!< CPU time in the update() call
+		DrawCpu,	//!< CPU time in the draw() call
+		DrawGpu,	//!< GPU time of the commands issued in the draw() call
+		NbMeasures
+	};
+
+	//! Number of bins of the histograms. Bin 0 holds the times under HistogramFirstBinMs
+	//! and each following bin holds times twice as long as the previous one.
+	static const int NbHistogramBins = 12;
+	static const float HistogramFirstBinMs;
+
+	//! Statistics of one measure of one section over the recorded frames, in milliseconds.
+	struct Statistics
+	{
+		float mean;
+		float max;
+		int histogram[NbHistogramBins];
+	};
+
+	//! @param nbFrames the number of frames over which the statistics are computed.
+	StelFrameProfiler(int nbFrames=120);
+	~StelFrameProfiler();
+
+	//! Enable or disable the measures. The recorded frames are cleared when enabling.
+	void setEnabled(bool b);
+	bool isEnabled() const {return enabled;}
+	//! Set the number of frames over which the statistics are computed.
+	//! The recorded frames are cleared.
+	void setNbFrames(int n);
+
+	//! Start a new frame, to be called before the first section of the update.
+	void beginFrame();
+	//! Start measuring a section.
+	//! @param name the name of the section, usually the name of the module.
+	//! @param draw true in the draw phase, false in the update phase.
+	void beginSection(const QString& name, bool draw);
+	//! Stop measuring the section started by the last call to beginSection().
+	void endSection();
+	//! Add the time of a section measured by the caller, e.g. in a worker thread.
+	//! @param ms the CPU time in milliseconds.
+	void addSectionTime(const QString& name, bool draw, float ms);
+	//! End the frame, to be called after the last section of the draw.
+	void endFrame();
+
+	//! Get the number of frames the statistics are computed on.
+	int getNbRecordedFrames() const {return nbRecordedFrames;}
+	//! Get the names of all the sections measured, in the order they were first seen.
+	QStringList getSectionNames() const;
+	//! Get the statistics of one measure of a section over the recorded frames.
+	Statistics getStatistics(int section, Measure measure) const;
+
+	//! Draw a table of the timings of each section on top of the view.
+	void drawOverlay(StelCore* core) const;
+
+	//! Get the statistics of all the sections as CSV, one line per section and measure.
+	QString toCsv() const;
+	//! Get the statistics of all the sections as a map which can be written as JSON.
+	QVariantMap toVariantMap() const;
+	//! Write the statistics to a file, in JSON if its suffix is .json, else in CSV.
+	//! @return false if the file could not be written.
+	bool writeReport(const QString& fileName) const;
+
+private:
+	struct Section
+	{
+		QString name;
+		//! Ring buffers of the times measured in the last frames, in milliseconds.
+		QVector<float> samples[NbMeasures];
+		//! Time accumulated since the beginning of the current frame.
+		float current[NbMeasures];
+	};
+
+	//! Timer queries issued during one frame, read when their results are available.
+	struct GpuFrame
+	{
+		GpuFrame() : frame(-1), nbUsed(0) {}
+		qint64 frame;
+		int nbUsed;
+		//! Timestamps recorded at the beginning and end of each draw section.
+		QVector<QOpenGLTimerQuery*> queries;
+		QVector<int> sections;
+	};
+	static const int NbGpuFrames = 3;
+
+	void clear();
+	int getSection(const QString& name);
+	void recordGpuTimestamp(int section);
+	void collectGpuResults(GpuFrame& gpuFrame, bool wait);
+	static QString measureName(Measure measure);
+
+	bool enabled;
+	int nbFrames;
+	int nbRecordedFrames;
+	qint64 frameCounter;
+
+	QVector<Section> sections;
+	QHash<QString, int> sectionIndices;
+
+	QElapsedTimer sectionTimer;
+	int currentSection;
+	bool currentIsDraw;
+
+	//! Whether the timer queries are supported, -1 if not known yet.
+	int gpuTimerSupported;
+	GpuFrame gpuFrames[NbGpuFrames];
+};
+
+#endif // _STELFRAMEPROFILER_HPP_
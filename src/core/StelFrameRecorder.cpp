@@ -0,0 +1,262 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelFrameRecorder.hpp"
+#include "StelOpenGL.hpp"
+#include "StelCore.hpp"
+#include "StelPainter.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QMutexLocker>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
+#include <QThread>
+#include <QtConcurrent>
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+StelFrameRecorder::StelFrameRecorder()
+	: fps(30.)
+	, frameNumber(0)
+	, fbo(NULL)
+	, recording(false)
+	, pendingFrames(0)
+{
+	for (int i=0; i<NbPixelBuffers; ++i)
+		pixelBuffers[i] = NULL;
+}
+
+StelFrameRecorder::~StelFrameRecorder()
+{
+	stop();
+	releaseBuffers();
+}
+
+bool StelFrameRecorder::start(const QString& aDir, const QString& aPrefix, const QSize& aSize, double aFps)
+{
+	stop();
+
+	const QFileInfo dirInfo(aDir);
+	if (!dirInfo.isDir() || !dirInfo.isWritable())
+	{
+		qWarning() << "ERROR: the frames can not be written in the directory" << QDir::toNativeSeparators(aDir);
+		return false;
+	}
+	if (aSize.isEmpty() || aFps<=0.)
+	{
+		qWarning() << "ERROR: invalid size or frame rate for the recording:" << aSize << aFps;
+		return false;
+	}
+
+	dir = aDir;
+	prefix = aPrefix;
+	size = aSize;
+	fps = aFps;
+	frameNumber = 0;
+	qDebug() << "INFO: recording frames of" << size << "at" << fps << "FPS in" << QDir::toNativeSeparators(dir);
+
+	QMutexLocker locker(&mutex);
+	recording = true;
+	pendingFrames = 0;
+	return true;
+}
+
+void StelFrameRecorder::stop()
+{
+	QMutexLocker locker(&mutex);
+	if (!recording)
+		return;
+	recording = false;
+	pendingFrames = 0;
+	framesRendered.wakeAll();
+}
+
+bool StelFrameRecorder::createBuffers()
+{
+	fbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+	if (!fbo->isValid())
+	{
+		qWarning() << "ERROR: can't create a framebuffer of" << size << "to record the frames";
+		delete fbo;
+		fbo = NULL;
+		return false;
+	}
+	for (int i=0; i<NbPixelBuffers; ++i)
+	{
+		pixelBuffers[i] = new QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer);
+		pixelBuffers[i]->setUsagePattern(QOpenGLBuffer::StreamRead);
+		pixelBuffers[i]->create();
+		pixelBuffers[i]->bind();
+		pixelBuffers[i]->allocate(size.width()*size.height()*4);
+		pixelBuffers[i]->release();
+	}
+	return true;
+}
+
+void StelFrameRecorder::releaseBuffers()
+{
+	if (fbo==NULL)
+		return;
+
+	// Write the frames still in the pixel buffers, in their order
+	for (int i=0; i<NbPixelBuffers; ++i)
+		collectPixelBuffer((frameNumber+i) % NbPixelBuffers);
+	foreach (QFuture<bool> future, pendingWrites)
+		future.waitForFinished();
+	pendingWrites.clear();
+
+	for (int i=0; i<NbPixelBuffers; ++i)
+	{
+		delete pixelBuffers[i];
+		pixelBuffers[i] = NULL;
+	}
+	delete fbo;
+	fbo = NULL;
+	qDebug() << "INFO: recorded" << frameNumber << "frames";
+}
+
+bool StelFrameRecorder::isRecording() const
+{
+	QMutexLocker locker(&mutex);
+	return recording;
+}
+
+bool StelFrameRecorder::waitFrames(int nbFrames)
+{
+	QMutexLocker locker(&mutex);
+	if (!recording)
+		return false;
+	pendingFrames += qMax(nbFrames, 0);
+	while (recording && pendingFrames>0)
+		framesRendered.wait(&mutex);
+	return true;
+}
+
+bool StelFrameRecorder::hasPendingFrames() const
+{
+	QMutexLocker locker(&mutex);
+	return recording && pendingFrames>0;
+}
+
+bool StelFrameRecorder::beginFrame(StelCore* core)
+{
+	if (!hasPendingFrames())
+		return false;
+	// The buffers of a previous recording may not be released yet
+	if (fbo!=NULL && fbo->size()!=size)
+		releaseBuffers();
+	if (fbo==NULL && !createBuffers())
+	{
+		stop();
+		return false;
+	}
+	core->windowHasBeenResized(0, 0, size.width(), size.height());
+	fbo->bind();
+	return true;
+}
+
+void StelFrameRecorder::endFrame()
+{
+	if (fbo==NULL)
+		return;
+
+	// Reuse the oldest pixel buffer, once the frame it holds is handed to a worker
+	const int index = frameNumber % NbPixelBuffers;
+	collectPixelBuffer(index);
+
+	// With a pixel pack buffer bound, glReadPixels() only queues the transfer and returns
+	pixelBuffers[index]->bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, size.width(), size.height(), GL_BGRA, GL_UNSIGNED_BYTE, 0);
+	pixelBuffers[index]->release();
+	pixelBufferFiles[index] = dir + "/" + prefix + QString("%1").arg(frameNumber, 5, 10, QLatin1Char('0')) + ".png";
+	fbo->release();
+	++frameNumber;
+
+	QMutexLocker locker(&mutex);
+	if (pendingFrames>0)
+		--pendingFrames;
+	if (pendingFrames==0)
+		framesRendered.wakeAll();
+}
+
+void StelFrameRecorder::collectPixelBuffer(int index)
+{
+	if (pixelBuffers[index]==NULL || pixelBufferFiles[index].isEmpty())
+		return;
+
+	// Mapping the buffer waits for the end of the transfer, which was queued frames ago
+	QImage image(size, QImage::Format_ARGB32);
+	pixelBuffers[index]->bind();
+	const uchar* pixels = static_cast<const uchar*>(pixelBuffers[index]->map(QOpenGLBuffer::ReadOnly));
+	if (pixels!=NULL)
+	{
+		memcpy(image.bits(), pixels, image.byteCount());
+		pixelBuffers[index]->unmap();
+	}
+	pixelBuffers[index]->release();
+	if (pixels==NULL)
+	{
+		qWarning() << "WARNING: can't read back the recorded frame" << QDir::toNativeSeparators(pixelBufferFiles[index]);
+		pixelBufferFiles[index].clear();
+		return;
+	}
+
+	// Don't let the frames pile up in memory when the workers can't keep up with the rendering
+	const int maxPendingWrites = 2*QThread::idealThreadCount();
+	while (pendingWrites.size()>=maxPendingWrites)
+		pendingWrites.takeFirst().waitForFinished();
+	while (!pendingWrites.isEmpty() && pendingWrites.first().isFinished())
+		pendingWrites.removeFirst();
+
+	pendingWrites.append(QtConcurrent::run(writeFrame, image, pixelBufferFiles[index]));
+	pixelBufferFiles[index].clear();
+}
+
+bool StelFrameRecorder::writeFrame(QImage image, QString filePath)
+{
+	// The rows of the OpenGL framebuffer go from the bottom to the top
+	if (!image.mirrored(false, true).save(filePath))
+	{
+		qWarning() << "WARNING: failed to write the frame" << QDir::toNativeSeparators(filePath);
+		return false;
+	}
+	return true;
+}
+
+void StelFrameRecorder::paintPreview(StelCore* core) const
+{
+	if (fbo==NULL || frameNumber==0)
+		return;
+
+	StelProjector::StelProjectorParams params = core->getCurrentStelProjectorParams();
+	const float scale = qMin(params.viewportXywh[2]/(float)size.width(), params.viewportXywh[3]/(float)size.height());
+	const float w = size.width()*scale;
+	const float h = size.height()*scale;
+	StelPainter sPainter(core->getProjection2d());
+	sPainter.setColor(1,1,1);
+	sPainter.enableTexture2d(true);
+	glBindTexture(GL_TEXTURE_2D, fbo->texture());
+	sPainter.drawRect2d(params.viewportXywh[0]+0.5f*(params.viewportXywh[2]-w), params.viewportXywh[1]+0.5f*(params.viewportXywh[3]-h), w, h);
+}
@@ -0,0 +1,121 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELFRAMERECORDER_HPP_
+#define _STELFRAMERECORDER_HPP_
+
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QWaitCondition>
+
+class StelCore;
+class QImage;
+class QOpenGLBuffer;
+class QOpenGLFramebufferObject;
+
+//! @class StelFrameRecorder
+//! Render a sequence of frames offline, e.g. to produce a video from a script.
+//! While recording, the frames are drawn in a framebuffer object of the requested size
+//! instead of the window, and the application clock advances by a fixed step per frame,
+//! so that the sequence does not depend on the speed of the computer.
+//! The frames are only rendered when the script asks for them with waitFrames(), which
+//! replaces the real time waits of the script.
+//! The pixels are read back asynchronously through a ring of pixel buffer objects and
+//! written to image files by worker threads. The main loop only waits for them when
+//! too many frames are still being written, so no frame is ever dropped.
+class StelFrameRecorder
+{
+public:
+	StelFrameRecorder();
+	~StelFrameRecorder();
+
+	//! Start recording frames. To be called from the main thread.
+	//! The GPU buffers are only created when the first frame is rendered.
+	//! @param dir the directory in which the image files are written.
+	//! @param prefix the prefix of the file names, followed by the frame number.
+	//! @param size the size of the frames in pixels.
+	//! @param fps the number of frames per second of the sequence.
+	//! @return false if the directory is not writable or the parameters are invalid.
+	bool start(const QString& dir, const QString& prefix, const QSize& size, double fps);
+	//! Stop recording. The scripts waiting for frames are released.
+	//! The frames already rendered are written by releaseBuffers().
+	void stop();
+	//! Write the frames already rendered and release the GPU buffers once the recording is stopped.
+	//! To be called from the main thread with the OpenGL context current.
+	void releaseBuffers();
+	//! Can be called from any thread.
+	bool isRecording() const;
+
+	//! Get the time step between two frames in seconds.
+	double getFrameDuration() const {return 1./fps;}
+	//! Get the number of frames written since the start of the recording.
+	int getNbRecordedFrames() const {return frameNumber;}
+
+	//! Record the given number of frames, and wait until they are rendered.
+	//! To be called from the script thread.
+	//! @return false if not recording, in which case the caller has to wait by itself.
+	bool waitFrames(int nbFrames);
+	//! Whether a frame has to be rendered now, i.e. a script waits for frames.
+	bool hasPendingFrames() const;
+
+	//! Bind the framebuffer and set the viewport of the core to the size of the frames.
+	//! @return false if no frame has to be recorded now.
+	bool beginFrame(StelCore* core);
+	//! Release the framebuffer and start reading back the frame rendered since beginFrame().
+	//! The caller then has to restore the viewport of the core for the window.
+	void endFrame();
+	//! Show the last rendered frame in the current viewport, keeping its aspect ratio.
+	void paintPreview(StelCore* core) const;
+
+private:
+	//! Create the framebuffer and the pixel buffers for the size of the frames.
+	bool createBuffers();
+
+	//! Number of pixel buffers, i.e. of frames read back in parallel.
+	static const int NbPixelBuffers = 3;
+
+	//! Copy the pixels of a pixel buffer to an image, and give it to a worker thread.
+	void collectPixelBuffer(int index);
+	//! Write a frame in a file, in a worker thread.
+	static bool writeFrame(QImage image, QString filePath);
+
+	QString dir;
+	QString prefix;
+	QSize size;
+	double fps;
+	int frameNumber;
+
+	QOpenGLFramebufferObject* fbo;
+	QOpenGLBuffer* pixelBuffers[NbPixelBuffers];
+	//! The file of the frame stored in each pixel buffer, empty if there is none.
+	QString pixelBufferFiles[NbPixelBuffers];
+	//! The frames still being written by the workers.
+	QList<QFuture<bool> > pendingWrites;
+
+	//! Protect the state shared with the script thread.
+	mutable QMutex mutex;
+	QWaitCondition framesRendered;
+	bool recording;
+	int pendingFrames;
+};
+
+#endif // _STELFRAMERECORDER_HPP_
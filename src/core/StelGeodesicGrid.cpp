@@ -88,42 +88,71 @@ static const TopLevelTriangle icosahedron_triangles[20] =
         {{ 8, 9, 5}}  //  8
     };
 
-StelGeodesicGrid::StelGeodesicGrid(const int lev) : maxLevel(lev<0?0:lev), lastMaxSearchlevel(-1)
+StelGeodesicGrid::StelGeodesicGrid(const int lev) : maxLevel(0), triangles(0)
+{
+	initCachedSearches();
+	extend(lev);
+}
+
+StelGeodesicGrid::~StelGeodesicGrid(void)
 {
 	if (maxLevel > 0)
 	{
-		triangles = new Triangle*[maxLevel+1];
-		int nr_of_triangles = 20;
-		for (int i=0;i<maxLevel;i++)
-		{
-			triangles[i] = new Triangle[nr_of_triangles];
-			nr_of_triangles *= 4;
-		}
-		for (int i=0;i<20;i++)
-		{
-			const int *const corners = icosahedron_triangles[i].corners;
-			initTriangle(0,i,
-			             icosahedron_corners[corners[0]],
-			             icosahedron_corners[corners[1]],
-			             icosahedron_corners[corners[2]]);
-		}
+		for (int i=maxLevel-1;i>=0;i--) delete[] triangles[i];
+		delete[] triangles;
 	}
-	else
+	deleteCachedSearches();
+}
+
+void StelGeodesicGrid::extend(int newMaxLevel)
+{
+	if (newMaxLevel <= maxLevel)
+		return;
+	// The search results are sized for the levels of the grid
+	deleteCachedSearches();
+
+	Triangle **newTriangles = new Triangle*[newMaxLevel+1];
+	int nr_of_triangles = 20;
+	for (int i=0;i<newMaxLevel;i++)
 	{
-		triangles = 0;
+		newTriangles[i] = (i < maxLevel) ? triangles[i] : new Triangle[nr_of_triangles];
+		nr_of_triangles *= 4;
+	}
+	delete[] triangles;
+	triangles = newTriangles;
+
+	const int fromLevel = maxLevel;
+	maxLevel = newMaxLevel;
+	for (int i=0;i<20;i++)
+	{
+		const int *const corners = icosahedron_triangles[i].corners;
+		initTriangle(0,i,
+		             icosahedron_corners[corners[0]],
+		             icosahedron_corners[corners[1]],
+		             icosahedron_corners[corners[2]],
+		             fromLevel);
 	}
-	cacheSearchResult = new GeodesicSearchResult(*this);
+	initCachedSearches();
 }
 
-StelGeodesicGrid::~StelGeodesicGrid(void)
+void StelGeodesicGrid::initCachedSearches()
 {
-	if (maxLevel > 0)
+	for (int i=0;i<NbCachedSearches;++i)
 	{
-		for (int i=maxLevel-1;i>=0;i--) delete[] triangles[i];
-		delete[] triangles;
+		cachedSearches[i].result = new GeodesicSearchResult(*this);
+		cachedSearches[i].maxSearchLevel = -1;
+		cachedSearches[i].tolerance = 0.;
+		cachedSearches[i].region.clear();
+	}
+}
+
+void StelGeodesicGrid::deleteCachedSearches()
+{
+	for (int i=0;i<NbCachedSearches;++i)
+	{
+		delete cachedSearches[i].result;
+		cachedSearches[i].result = NULL;
 	}
-	delete cacheSearchResult;
-	cacheSearchResult = NULL;
 }
 
 void StelGeodesicGrid::getTriangleCorners(int lev,int index,
@@ -205,24 +234,29 @@ int StelGeodesicGrid::getPartnerTriangle(int lev, int index) const
 void StelGeodesicGrid::initTriangle(int lev,int index,
 								const Vec3f &c0,
 								const Vec3f &c1,
-								const Vec3f &c2)
+								const Vec3f &c2,
+								int fromLevel)
 {
 	Q_ASSERT((c0^c1)*c2 >= 0.0);
 	Triangle &t(triangles[lev][index]);
-	t.e0 = c1+c2;
-	t.e0.normalize();
-	t.e1 = c2+c0;
-	t.e1.normalize();
-	t.e2 = c0+c1;
-	t.e2.normalize();
+	// The levels above fromLevel were computed when the grid was created, only their corners are needed
+	if (lev >= fromLevel)
+	{
+		t.e0 = c1+c2;
+		t.e0.normalize();
+		t.e1 = c2+c0;
+		t.e1.normalize();
+		t.e2 = c0+c1;
+		t.e2.normalize();
+	}
 	lev++;
 	if (lev < maxLevel)
 	{
 		index *= 4;
-		initTriangle(lev,index+0,c0,t.e2,t.e1);
-		initTriangle(lev,index+1,t.e2,c1,t.e0);
-		initTriangle(lev,index+2,t.e1,t.e0,c2);
-		initTriangle(lev,index+3,t.e0,t.e1,t.e2);
+		initTriangle(lev,index+0,c0,t.e2,t.e1,fromLevel);
+		initTriangle(lev,index+1,t.e2,c1,t.e0,fromLevel);
+		initTriangle(lev,index+2,t.e1,t.e0,c2,fromLevel);
+		initTriangle(lev,index+3,t.e0,t.e1,t.e2,fromLevel);
 	}
 }
 
@@ -331,10 +365,11 @@ void StelGeodesicGrid::searchZones(const QVector<SphericalCap>& convex,
 #endif
 	for (int h=0;h<convex.size();h++)
 	{
-		const SphericalCap& half_space(convex.at(h));
+		bool inside[12];
+		convex.at(h).containsPoints(icosahedron_corners, 12, inside);
 		for (int i=0;i<12;i++)
 		{
-			corner_inside[i][h] = half_space.contains(icosahedron_corners[i]);
+			corner_inside[i][h] = inside[i];
 		}
 	}
 	for (int i=0;i<20;i++)
@@ -412,13 +447,15 @@ void StelGeodesicGrid::searchZones(int lev,int index,
 			bool edge1_inside[convex.size()];
 			bool edge2_inside[convex.size()];
 #endif
+			const Vec3f edges[3] = {t.e0, t.e1, t.e2};
 			for (int h=0;h<halfs_used_count;h++)
 			{
 				const int i = halfs_used[h];
-				const SphericalCap& half_space(convex.at(i));
-				edge0_inside[i] = half_space.contains(t.e0);
-				edge1_inside[i] = half_space.contains(t.e1);
-				edge2_inside[i] = half_space.contains(t.e2);
+				bool inside[3];
+				convex.at(i).containsPoints(edges, 3, inside);
+				edge0_inside[i] = inside[0];
+				edge1_inside[i] = inside[1];
+				edge2_inside[i] = inside[2];
 			}
 			searchZones(lev,index+0,
 			            convex,halfs_used,halfs_used_count,
@@ -451,18 +488,53 @@ void StelGeodesicGrid::searchZones(int lev,int index,
 /*************************************************************************
  Return a search result matching the given spatial region
 *************************************************************************/
-const GeodesicSearchResult* StelGeodesicGrid::search(const QVector<SphericalCap>& convex, int maxSearchLevel) const
+const GeodesicSearchResult* StelGeodesicGrid::search(const QVector<SphericalCap>& convex, int maxSearchLevel, double tolerance) const
 {
-	// Try to use the cached version
-	if (maxSearchLevel==lastMaxSearchlevel && convex==lastSearchRegion)
+	// Try to use one of the cached versions
+	int found = -1;
+	for (int i=0;i<NbCachedSearches && found<0;++i)
 	{
-		return cacheSearchResult;
+		const CachedSearch& cached = cachedSearches[i];
+		if (cached.maxSearchLevel!=maxSearchLevel || cached.tolerance!=tolerance || cached.region.size()!=convex.size())
+			continue;
+		if (tolerance==0.)
+		{
+			if (cached.region==convex)
+				found = i;
+			continue;
+		}
+		bool containsAll = true;
+		for (int j=0;j<convex.size() && containsAll;++j)
+			containsAll = cached.region.at(j).contains(convex.at(j));
+		if (containsAll)
+			found = i;
+	}
+
+	// Else recompute it in place of the least recently used one
+	if (found<0)
+	{
+		found = NbCachedSearches-1;
+		CachedSearch& cached = cachedSearches[found];
+		cached.maxSearchLevel = maxSearchLevel;
+		cached.tolerance = tolerance;
+		cached.region = convex;
+		if (tolerance>0.)
+		{
+			for (int j=0;j<cached.region.size();++j)
+			{
+				SphericalCap& cap = cached.region[j];
+				cap.d = std::cos(qMin(M_PI, std::acos(qBound(-1., cap.d, 1.))+tolerance));
+			}
+		}
+		cached.result->search(cached.region, maxSearchLevel);
 	}
-	// Else recompute it and update cache parameters
-	lastMaxSearchlevel = maxSearchLevel;
-	lastSearchRegion = convex;
-	cacheSearchResult->search(convex, maxSearchLevel);
-	return cacheSearchResult;
+
+	// Move it to the front
+	const CachedSearch used = cachedSearches[found];
+	for (int i=found;i>0;--i)
+		cachedSearches[i] = cachedSearches[i-1];
+	cachedSearches[0] = used;
+	return used.result;
 }
 
 
@@ -51,6 +51,10 @@ public:
 	~StelGeodesicGrid(void);
 	
 	int getMaxLevel(void) const {return maxLevel;}
+
+	//! Subdivide the grid down to a deeper level. The triangles of the current levels are kept, only the
+	//! new levels are computed. The cached search results are discarded.
+	void extend(int newMaxLevel);
 	
 	static int nrOfZones(int level) {return (20<<(level<<1));} // 20*4^level
 	
@@ -77,9 +81,17 @@ public:
 	int getPartnerTriangle(int lev, int index) const;
 	
 	//! Return a search result matching the given spatial region
-	//! The result is cached, meaning that it is very fast to search the same region consecutively
-	//! @return a GeodesicSearchResult instance which must be used with GeodesicSearchBorderIterator and GeodesicSearchInsideIterator
-	const GeodesicSearchResult* search(const QVector<SphericalCap>& convex, int maxSearchLevel) const;
+	//! The last results are cached, meaning that it is very fast to search again one of the last regions searched.
+	//! @param tolerance when not null, the caps are enlarged by this angle in radian before searching,
+	//! and the result is reused as long as the searched caps still contain the requested ones. The result
+	//! then includes zones outside of the region, so this is only suited to uses such as drawing where
+	//! a few more zones do not matter.
+	//! @return a GeodesicSearchResult instance which must be used with GeodesicSearchBorderIterator and GeodesicSearchInsideIterator.
+	//! It stays valid until NbCachedSearches other regions have been searched.
+	const GeodesicSearchResult* search(const QVector<SphericalCap>& convex, int maxSearchLevel, double tolerance=0.) const;
+
+	//! The number of search results kept in the cache.
+	static const int NbCachedSearches = 4;
 
 private:
 	friend class GeodesicSearchResult;
@@ -103,10 +115,17 @@ private:
 					 int **inside,int **border,int maxSearchLevel) const;
 	
 	const Vec3f& getTriangleCorner(int lev, int index, int cornerNumber) const;
+	//! Compute the subdivision of a triangle and of its children, from the level fromLevel only,
+	//! the upper levels being already computed.
 	void initTriangle(int lev,int index,
 					  const Vec3f &c0,
 					  const Vec3f &c1,
-					  const Vec3f &c2);
+					  const Vec3f &c2,
+					  int fromLevel);
+	//! Create the cached search results for the levels of the grid.
+	void initCachedSearches();
+	//! Delete the cached search results.
+	void deleteCachedSearches();
 	void visitTriangles(int lev,int index,
 						const Vec3f &c0,
 						const Vec3f &c1,
@@ -123,7 +142,7 @@ private:
 	                 const bool *corner2_inside,
 	                 int **inside,int **border,int maxSearchLevel) const;
 
-	const int maxLevel;
+	int maxLevel;
 	struct Triangle
 	{
 		Vec3f e0,e1,e2;   // Seitenmittelpunkte
@@ -133,9 +152,16 @@ private:
 	// 2+10*4^n corners
 	
 	//! A cached search result used to avoid doing twice the same search
-	mutable GeodesicSearchResult* cacheSearchResult;
-	mutable int lastMaxSearchlevel;
-	mutable QVector<SphericalCap> lastSearchRegion;
+	struct CachedSearch
+	{
+		GeodesicSearchResult* result;
+		int maxSearchLevel;
+		double tolerance;
+		//! The caps which were searched, i.e. the requested ones enlarged by the tolerance
+		QVector<SphericalCap> region;
+	};
+	//! The cached searches, the most recently used first
+	mutable CachedSearch cachedSearches[NbCachedSearches];
 };
 
 class GeodesicSearchResult
@@ -0,0 +1,156 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelHealpix.hpp"
+
+#include <cmath>
+
+// Position of the 12 base pixels: ring of the southmost corner and longitude in quarters of pi/2
+static const int jrll[12] = {2,2,2,2,3,3,3,3,4,4,4,4};
+static const int jpll[12] = {1,3,5,7,0,2,4,6,1,3,5,7};
+
+// Extract the even bits of a nested index, i.e. one of both coordinates in the base pixel
+static quint64 compressBits(quint64 v)
+{
+	quint64 raw = v & Q_UINT64_C(0x5555555555555555);
+	raw = (raw | (raw>>1)) & Q_UINT64_C(0x3333333333333333);
+	raw = (raw | (raw>>2)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+	raw = (raw | (raw>>4)) & Q_UINT64_C(0x00ff00ff00ff00ff);
+	raw = (raw | (raw>>8)) & Q_UINT64_C(0x0000ffff0000ffff);
+	raw = (raw | (raw>>16)) & Q_UINT64_C(0x00000000ffffffff);
+	return raw;
+}
+
+// Inverse of compressBits: spread the bits of a coordinate in the even bits of a nested index
+static quint64 spreadBits(quint64 v)
+{
+	quint64 raw = v & Q_UINT64_C(0x00000000ffffffff);
+	raw = (raw | (raw<<16)) & Q_UINT64_C(0x0000ffff0000ffff);
+	raw = (raw | (raw<<8)) & Q_UINT64_C(0x00ff00ff00ff00ff);
+	raw = (raw | (raw<<4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+	raw = (raw | (raw<<2)) & Q_UINT64_C(0x3333333333333333);
+	raw = (raw | (raw<<1)) & Q_UINT64_C(0x5555555555555555);
+	return raw;
+}
+
+Vec3d StelHealpix::pixelPoint(int order, quint64 pix, double x, double y)
+{
+	const quint64 nbFacePixels = (quint64)1 << (2*order);
+	const int face = (int)(pix >> (2*order));
+	Q_ASSERT(face>=0 && face<12);
+	const quint64 facePix = pix & (nbFacePixels-1);
+	const double nside = (double)((quint64)1 << order);
+	// Coordinates in the base pixel, from 0 to 1
+	const double fx = (compressBits(facePix)+x)/nside;
+	const double fy = (compressBits(facePix>>1)+y)/nside;
+
+	// The polar caps are split in 4 triangles, the equatorial belt is a simple cylindrical projection
+	const double jr = jrll[face] - fx - fy;
+	double nr, z;
+	if (jr<1.)
+	{
+		nr = jr;
+		z = 1. - nr*nr/3.;
+	}
+	else if (jr>3.)
+	{
+		nr = 4. - jr;
+		z = nr*nr/3. - 1.;
+	}
+	else
+	{
+		nr = 1.;
+		z = (2.-jr)*2./3.;
+	}
+	double tmp = jpll[face]*nr + fx - fy;
+	if (tmp<0.)
+		tmp += 8.;
+	if (tmp>=8.)
+		tmp -= 8.;
+	const double phi = nr<1e-15 ? 0. : (M_PI/4.*tmp)/nr;
+	const double sinTheta = std::sqrt(qMax(0., (1.-z)*(1.+z)));
+	return Vec3d(sinTheta*std::cos(phi), sinTheta*std::sin(phi), z);
+}
+
+double StelHealpix::pixelBoundingCap(int order, quint64 pix, Vec3d& center)
+{
+	center = pixelPoint(order, pix, 0.5, 0.5);
+	// The edges are not great circles: test the corners and the middle of the edges, with a margin
+	static const double points[8][2] = {{0.,0.}, {0.5,0.}, {1.,0.}, {1.,0.5}, {1.,1.}, {0.5,1.}, {0.,1.}, {0.,0.5}};
+	double minCos = 1.;
+	for (int i=0;i<8;++i)
+		minCos = qMin(minCos, center*pixelPoint(order, pix, points[i][0], points[i][1]));
+	const double radius = qMin(M_PI, 1.05*std::acos(qBound(-1., minCos, 1.)));
+	return std::cos(radius);
+}
+
+quint64 StelHealpix::vectorToPixel(int order, const Vec3d& v)
+{
+	const int nside = 1 << order;
+	const double z = v[2]/v.length();
+	const double za = std::fabs(z);
+	// Longitude in units of the base pixels, from 0 to 4
+	double tt = std::atan2(v[1], v[0])*2./M_PI;
+	if (tt<0.)
+		tt += 4.;
+	if (tt>=4.)
+		tt -= 4.;
+
+	int face, ix, iy;
+	if (za<=2./3.)
+	{
+		// Equatorial belt: the pixels are on the lines of constant phi+z and phi-z
+		const double t1 = nside*(0.5+tt);
+		const double t2 = nside*(z*0.75);
+		const int jp = (int)(t1-t2);
+		const int jm = (int)(t1+t2);
+		const int ifp = jp >> order;
+		const int ifm = jm >> order;
+		if (ifp==ifm)
+			face = ifp | 4;
+		else if (ifp<ifm)
+			face = ifp;
+		else
+			face = ifm + 8;
+		ix = jm & (nside-1);
+		iy = nside - (jp & (nside-1)) - 1;
+	}
+	else
+	{
+		// Polar caps
+		const int ntt = qMin(3, (int)tt);
+		const double tp = tt - ntt;
+		const double tmp = nside*std::sqrt(3.*(1.-za));
+		const int jp = qMin((int)(tp*tmp), nside-1);
+		const int jm = qMin((int)((1.-tp)*tmp), nside-1);
+		if (z>=0.)
+		{
+			face = ntt;
+			ix = nside - jm - 1;
+			iy = nside - jp - 1;
+		}
+		else
+		{
+			face = ntt + 8;
+			ix = jp;
+			iy = jm;
+		}
+	}
+	return ((quint64)face << (2*order)) + spreadBits(ix) + (spreadBits(iy) << 1);
+}
@@ -0,0 +1,59 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELHEALPIX_HPP_
+#define _STELHEALPIX_HPP_
+
+#include "VecMath.hpp"
+
+#include <QtGlobal>
+
+//! @namespace StelHealpix
+//! Geometry of the HEALPix pixelization of the sphere in the nested scheme, as used by the
+//! HiPS surveys (see StelHipsSkyLayer). At order k the sphere is divided in 12*4^k pixels
+//! of equal area, the 4 children of the pixel p at order k being the pixels 4p to 4p+3 at order k+1.
+//! The vectors are in the frame of the pixelization, z being the pole and x the origin of the longitudes.
+namespace StelHealpix
+{
+	//! Get the number of pixels of the sphere at a given order.
+	inline quint64 getNbPixels(int order) {return (quint64)12 << (2*order);}
+
+	//! Get a point of a pixel.
+	//! @param order the order of the pixel.
+	//! @param pix the index of the pixel in the nested scheme.
+	//! @param x,y the position in the pixel along its two axes, from 0 to 1.
+	//! (0.5, 0.5) is the center of the pixel, (0, 0) its southmost corner.
+	//! @return the normalized vector of the point.
+	Vec3d pixelPoint(int order, quint64 pix, double x, double y);
+
+	//! Get a cap containing a whole pixel.
+	//! @param order the order of the pixel.
+	//! @param pix the index of the pixel in the nested scheme.
+	//! @param center the center of the cap.
+	//! @return the cosine of the radius of the cap.
+	double pixelBoundingCap(int order, quint64 pix, Vec3d& center);
+
+	//! Get the pixel containing a point.
+	//! @param order the order of the pixel.
+	//! @param v the vector of the point, not necessarily normalized.
+	//! @return the index of the pixel in the nested scheme.
+	quint64 vectorToPixel(int order, const Vec3d& v);
+}
+
+#endif // _STELHEALPIX_HPP_
@@ -0,0 +1,366 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelHipsSkyLayer.hpp"
+#include "StelHealpix.hpp"
+#include "StelApp.hpp"
+#include "StelCore.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+#include "StelTexture.hpp"
+#include "StelTextureMgr.hpp"
+#include "StelUtils.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrl>
+
+#include <cmath>
+
+int StelHipsSkyLayer::maxParallelRequests = 4;
+
+// The tiles not used during this number of frames can be removed
+static const unsigned int TileLifetime = 600;
+// Number of tiles kept before the unused ones are removed
+static const int MaxTiles = 2048;
+
+StelHipsSkyLayer::StelHipsSkyLayer(const QString& url, QObject* parent) : StelSkyLayer(parent),
+	ready(false), propertiesReply(NULL), minOrder(0), maxOrder(0), tileWidth(512), tileExtension("jpg"),
+	galacticFrame(false), drawOrder(0), frameCounter(0), pixelPerRad(1.), nbDrawnTiles(0), nbLoadingTiles(0),
+	loadingState(false), lastPercent(-1)
+{
+	baseUrl = url;
+	while (baseUrl.endsWith('/'))
+		baseUrl.chop(1);
+	shortName = baseUrl.mid(baseUrl.lastIndexOf('/')+1);
+
+	if (baseUrl.startsWith("http://") || baseUrl.startsWith("https://"))
+	{
+		serverCredits = QUrl(baseUrl).host();
+		QNetworkRequest req(QUrl(baseUrl+"/properties"));
+		req.setRawHeader("User-Agent", StelUtils::getApplicationName().toLatin1());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+		req.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
+		propertiesReply = StelApp::getInstance().getNetworkAccessManager()->get(req);
+		connect(propertiesReply, SIGNAL(finished()), this, SLOT(propertiesDownloaded()));
+	}
+	else
+	{
+		QFile file(baseUrl+"/properties");
+		if (file.open(QIODevice::ReadOnly))
+			parseProperties(file.readAll());
+		else
+			qWarning() << "WARNING : Can't read the properties of the HiPS survey" << QDir::toNativeSeparators(baseUrl);
+	}
+}
+
+StelHipsSkyLayer::~StelHipsSkyLayer()
+{
+	if (propertiesReply)
+	{
+		propertiesReply->abort();
+		propertiesReply->deleteLater();
+	}
+	qDeleteAll(tiles);
+}
+
+void StelHipsSkyLayer::propertiesDownloaded()
+{
+	if (propertiesReply->error()!=QNetworkReply::NoError)
+		qWarning() << "WARNING : Can't download the properties of the HiPS survey" << baseUrl << ":" << propertiesReply->errorString();
+	else
+		parseProperties(propertiesReply->readAll());
+	propertiesReply->deleteLater();
+	propertiesReply = NULL;
+}
+
+void StelHipsSkyLayer::parseProperties(const QByteArray& data)
+{
+	QMap<QString, QString> properties;
+	foreach (const QByteArray& line, data.split('\n'))
+	{
+		const QString l = QString::fromUtf8(line).trimmed();
+		const int sep = l.indexOf('=');
+		if (l.startsWith('#') || sep<0)
+			continue;
+		properties.insert(l.left(sep).trimmed(), l.mid(sep+1).trimmed());
+	}
+
+	bool ok;
+	maxOrder = properties.value("hips_order").toInt(&ok);
+	if (!ok || maxOrder<0 || maxOrder>26)
+	{
+		qWarning() << "WARNING : Invalid HiPS survey" << baseUrl << ": no valid hips_order";
+		return;
+	}
+	minOrder = qBound(0, properties.value("hips_order_min", "0").toInt(), maxOrder);
+	tileWidth = qMax(1, properties.value("hips_tile_width", "512").toInt());
+	const QStringList formats = properties.value("hips_tile_format", "jpeg").split(' ', QString::SkipEmptyParts);
+	if (formats.contains("jpeg"))
+		tileExtension = "jpg";
+	else if (formats.contains("png"))
+		tileExtension = "png";
+	else
+	{
+		qWarning() << "WARNING : Unsupported tile format of the HiPS survey" << baseUrl << ":" << formats.join(" ");
+		return;
+	}
+	const QString frame = properties.value("hips_frame", "equatorial");
+	galacticFrame = frame=="galactic";
+	if (!galacticFrame && frame!="equatorial")
+		qWarning() << "WARNING : Unsupported frame" << frame << "of the HiPS survey" << baseUrl << ", the equatorial frame is used";
+
+	if (properties.contains("obs_title"))
+		shortName = properties.value("obs_title");
+	htmlDescription = "<h3>"+shortName+"</h3>";
+	if (properties.contains("obs_description"))
+		htmlDescription += "<p>"+properties.value("obs_description")+"</p>";
+	if (properties.contains("obs_copyright"))
+		htmlDescription += "<p>"+properties.value("obs_copyright")+"</p>";
+	if (properties.contains("hips_creator"))
+		htmlDescription += "<p>Created by "+properties.value("hips_creator")+"</p>";
+	ready = true;
+}
+
+QString StelHipsSkyLayer::getTileUrl(int order, quint64 pix) const
+{
+	return QString("%1/Norder%2/Dir%3/Npix%4.%5").arg(baseUrl).arg(order).arg((pix/10000)*10000).arg(pix).arg(tileExtension);
+}
+
+StelHipsSkyLayer::Tile* StelHipsSkyLayer::getTile(int order, quint64 pix)
+{
+	const quint64 key = ((quint64)order<<56) | pix;
+	Tile* tile = tiles.value(key);
+	if (tile)
+		return tile;
+
+	tile = new Tile();
+	// The largest tiles are subdivided for the projections which are not linear
+	const int grid = qMin(order, 3);
+	const int n = 16>>grid;
+	tile->vertices.reserve((n+1)*(n+1));
+	for (int i=0;i<=n;++i)
+	{
+		for (int j=0;j<=n;++j)
+		{
+			const Vec3d v = StelHealpix::pixelPoint(order, pix, (double)i/n, (double)j/n);
+			tile->vertices.append(galacticFrame ? StelCore::matGalacticToJ2000*v : v);
+		}
+	}
+	tile->capD = StelHealpix::pixelBoundingCap(order, pix, tile->capCenter);
+	if (galacticFrame)
+		tile->capCenter = StelCore::matGalacticToJ2000*tile->capCenter;
+
+	if (gridIndices[grid].isEmpty())
+	{
+		// The rows of the images go along the y axis of the pixels, starting from their x=0 edge,
+		// and the textures are flipped vertically when they are loaded.
+		for (int i=0;i<=n;++i)
+			for (int j=0;j<=n;++j)
+				gridTexCoords[grid].append(Vec2f((float)j/n, 1.f-(float)i/n));
+		for (int i=0;i<n;++i)
+		{
+			for (int j=0;j<n;++j)
+			{
+				const unsigned short v = i*(n+1)+j;
+				gridIndices[grid] << v << v+n+1 << v+1 << v+1 << v+n+1 << v+n+2;
+			}
+		}
+	}
+	tiles.insert(key, tile);
+	return tile;
+}
+
+bool StelHipsSkyLayer::isTileMissing(const Tile* tile)
+{
+	return tile->tex && !tile->tex->getErrorMessage().isEmpty();
+}
+
+bool StelHipsSkyLayer::isTileDone(int order, const Tile* tile) const
+{
+	if (order<minOrder)
+		return true;
+	return tile->tex && (tile->tex->canBind() || isTileMissing(tile));
+}
+
+void StelHipsSkyLayer::loadTile(int order, quint64 pix, Tile* tile)
+{
+	if (order<minOrder)
+		return;
+	if (!tile->tex)
+	{
+		// The tiles of the lowest orders first, then the closest to the center of the view
+		wantedTiles.insert(order+(1.-tile->capCenter*viewDirection)/2.1, ((quint64)order<<56) | pix);
+	}
+	else if (!tile->tex->canBind() && !isTileMissing(tile))
+	{
+		// Keep the loading going on, the tiles covering the largest part of the screen are uploaded first
+		tile->tex->setUploadPriority(4.*M_PI/StelHealpix::getNbPixels(order)*pixelPerRad*pixelPerRad);
+		tile->tex->bind();
+		++nbLoadingTiles;
+	}
+}
+
+void StelHipsSkyLayer::drawTile(StelPainter& sPainter, int order, quint64 pix)
+{
+	Tile* tile = getTile(order, pix);
+	if (!viewportRegion->intersects(SphericalCap(tile->capCenter, tile->capD)))
+		return;
+	tile->lastUsedFrame = frameCounter;
+	loadTile(order, pix, tile);
+	// There is no data below a missing tile
+	if (isTileMissing(tile))
+		return;
+
+	if (order<drawOrder)
+	{
+		// The children are drawn once they are all loaded, the tile itself until then
+		bool childrenDone = true;
+		for (int c=0;c<4;++c)
+		{
+			Tile* child = getTile(order+1, pix*4+c);
+			if (!viewportRegion->intersects(SphericalCap(child->capCenter, child->capD)) || isTileDone(order+1, child))
+				continue;
+			childrenDone = false;
+			child->lastUsedFrame = frameCounter;
+			loadTile(order+1, pix*4+c, child);
+		}
+		if (childrenDone)
+		{
+			for (int c=0;c<4;++c)
+				drawTile(sPainter, order+1, pix*4+c);
+			return;
+		}
+	}
+
+	if (order<minOrder || !tile->tex || !tile->tex->bind())
+		return;
+	const int grid = qMin(order, 3);
+	sPainter.setColor(color[0], color[1], color[2], color[3]);
+	sPainter.setArrays(tile->vertices.constData(), gridTexCoords[grid].constData());
+	sPainter.drawFromArray(StelPainter::Triangles, gridIndices[grid].size(), 0, true, gridIndices[grid].constData());
+	++nbDrawnTiles;
+}
+
+void StelHipsSkyLayer::draw(StelCore* core, StelPainter& sPainter, float opacity)
+{
+	Q_UNUSED(core);
+	if (!ready)
+		return;
+	++frameCounter;
+
+	// Use the order whose pixels are just smaller than the pixels of the screen
+	const StelProjectorP prj = sPainter.getProjector();
+	pixelPerRad = prj->getPixelPerRadAtCenter();
+	const double order0Resolution = std::sqrt(M_PI/3.)/tileWidth;
+	drawOrder = qBound(minOrder, (int)std::ceil(std::log(order0Resolution*pixelPerRad)/std::log(2.)), maxOrder);
+	viewportRegion = prj->getViewportConvexPolygon(0, 0);
+	viewDirection = viewportRegion->getBoundingCap().n;
+
+	wantedTiles.clear();
+	nbDrawnTiles = 0;
+	nbLoadingTiles = 0;
+	color.set(opacity, opacity, opacity, 1.f);
+	sPainter.enableTexture2d(true);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glEnable(GL_BLEND);
+	for (int pix=0;pix<12;++pix)
+		drawTile(sPainter, 0, pix);
+
+	startRequests();
+	updatePercent(nbDrawnTiles, nbLoadingTiles+wantedTiles.size());
+	purgeTiles();
+}
+
+void StelHipsSkyLayer::startRequests()
+{
+	// The loadings of the tiles not visible anymore are canceled to free their slot
+	QList<quint64> stillRequested;
+	foreach (quint64 key, requestedTiles)
+	{
+		Tile* tile = tiles.value(key);
+		if (tile==NULL || !tile->tex || !tile->tex->isLoading())
+			continue;
+		if (tile->lastUsedFrame!=frameCounter)
+			tile->tex.clear();
+		else
+			stillRequested.append(key);
+	}
+	requestedTiles = stillRequested;
+
+	StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	StelTexture::StelTextureParams params(true);
+	params.evictable = true;
+	for (QMultiMap<double, quint64>::ConstIterator iter=wantedTiles.constBegin();
+	     iter!=wantedTiles.constEnd() && requestedTiles.size()<maxParallelRequests;++iter)
+	{
+		Tile* tile = tiles.value(iter.value());
+		const int order = (int)(iter.value()>>56);
+		const quint64 pix = iter.value() & ((Q_UINT64_C(1)<<56)-1);
+		tile->tex = texMgr.createTextureThread(getTileUrl(order, pix), params, false);
+		if (tile->tex)
+			requestedTiles.append(iter.value());
+	}
+}
+
+void StelHipsSkyLayer::purgeTiles()
+{
+	if (tiles.size()<=MaxTiles)
+		return;
+	QHash<quint64, Tile*>::Iterator iter = tiles.begin();
+	while (iter!=tiles.end())
+	{
+		if (iter.value()->lastUsedFrame+TileLifetime < frameCounter)
+		{
+			delete iter.value();
+			iter = tiles.erase(iter);
+		}
+		else
+			++iter;
+	}
+}
+
+void StelHipsSkyLayer::updatePercent(int nbTiles, int nbToBeLoaded)
+{
+	const int p = nbTiles+nbToBeLoaded==0 ? 100 : (int)(100.f*nbTiles/(nbTiles+nbToBeLoaded));
+	if (p==100 || nbToBeLoaded==0)
+	{
+		if (loadingState)
+		{
+			loadingState = false;
+			emit(loadingStateChanged(false));
+		}
+		return;
+	}
+	if (!loadingState)
+	{
+		loadingState = true;
+		lastPercent = -1;
+		emit(loadingStateChanged(true));
+	}
+	if (p==lastPercent)
+		return;
+	lastPercent = p;
+	emit(percentLoadedChanged(p));
+}
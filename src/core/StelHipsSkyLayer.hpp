@@ -0,0 +1,165 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELHIPSSKYLAYER_HPP_
+#define _STELHIPSSKYLAYER_HPP_
+
+#include "StelSkyLayer.hpp"
+#include "StelSphereGeometry.hpp"
+#include "StelTextureTypes.hpp"
+#include "VecMath.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+class QNetworkReply;
+
+//! @class StelHipsSkyLayer
+//! Display a HiPS survey (Hierarchical Progressive Survey, an IVOA standard), whose tiles are
+//! the pixels of the HEALPix pixelization of the sphere, directly from the standard servers.
+//! The survey is described by the properties file found at its base URL, and its tiles are
+//! the images Norder{k}/Dir{d}/Npix{n}.{jpg|png}, where d is n rounded down to a multiple of 10000.
+//! The tiles whose resolution matches the screen resolution are drawn, or their parents
+//! as long as they are not loaded. At most getMaxParallelRequests() tiles are downloaded at the
+//! same time for each survey, the tiles of the lowest orders and closest to the center of the
+//! view first, so that the requests of the tiles not visible anymore don't delay the other ones.
+//! The tiles are downloaded with the network manager of the application, which keeps them in the
+//! disk cache and reuses the connections to the servers (with HTTP/2 when Qt supports it).
+//! The surveys in the equatorial and galactic frames are supported.
+class StelHipsSkyLayer : public StelSkyLayer
+{
+	Q_OBJECT
+public:
+	//! Constructor. The properties of the survey start downloading.
+	//! @param url the base URL of the survey, or a local directory.
+	StelHipsSkyLayer(const QString& url, QObject* parent=NULL);
+	~StelHipsSkyLayer();
+
+	//! Draw the visible tiles, and request the missing ones.
+	virtual void draw(StelCore* core, StelPainter& sPainter, float opacity=1.);
+
+	//! Return the title of the survey.
+	virtual QString getShortName() const {return shortName;}
+
+	//! Return the host of the survey.
+	virtual QString getShortServerCredits() const {return serverCredits;}
+
+	//! Return the title, creator and copyright of the survey.
+	virtual QString getLayerDescriptionHtml() const {return htmlDescription;}
+
+	//! Set the maximum number of tiles downloaded at the same time by each survey.
+	static void setMaxParallelRequests(int n) {maxParallelRequests = qMax(1, n);}
+	static int getMaxParallelRequests() {return maxParallelRequests;}
+
+private slots:
+	//! Called when the properties of the survey were downloaded.
+	void propertiesDownloaded();
+
+private:
+	//! A tile of the survey.
+	struct Tile
+	{
+		Tile() : capD(1.), lastUsedFrame(0) {;}
+		//! The texture, NULL as long as the download is not started or when it was canceled.
+		StelTextureSP tex;
+		//! The vertices of the grid used to draw the tile, in the J2000 frame.
+		QVector<Vec3d> vertices;
+		//! The bounding cap of the tile, in the J2000 frame.
+		Vec3d capCenter;
+		double capD;
+		unsigned int lastUsedFrame;
+	};
+
+	//! Parse the properties file of the survey.
+	void parseProperties(const QByteArray& data);
+
+	//! Get a tile, creating it if needed.
+	Tile* getTile(int order, quint64 pix);
+
+	//! Get whether a tile is known to be missing on the server, so that it has no children either.
+	static bool isTileMissing(const Tile* tile);
+
+	//! Get whether a tile is ready to be drawn or missing, or doesn't need a texture.
+	bool isTileDone(int order, const Tile* tile) const;
+
+	//! Request the texture of a tile, or continue its loading.
+	void loadTile(int order, quint64 pix, Tile* tile);
+
+	//! Draw the visible tiles inside a tile, and collect the ones which need to be downloaded.
+	void drawTile(StelPainter& sPainter, int order, quint64 pix);
+
+	//! Start the downloads of the wanted tiles while slots are available, and cancel the ones not wanted anymore.
+	void startRequests();
+
+	//! Remove the tiles not used for a while when there are too many of them.
+	void purgeTiles();
+
+	//! Emit the loading signals for the progress bar.
+	void updatePercent(int nbTiles, int nbToBeLoaded);
+
+	//! Get the URL of a tile.
+	QString getTileUrl(int order, quint64 pix) const;
+
+	QString baseUrl;
+	QString shortName;
+	QString serverCredits;
+	QString htmlDescription;
+
+	//! Whether the properties were loaded and the tiles can be requested.
+	bool ready;
+	QNetworkReply* propertiesReply;
+
+	//! Properties of the survey.
+	int minOrder;
+	int maxOrder;
+	int tileWidth;
+	QString tileExtension;
+	bool galacticFrame;
+
+	//! The tiles, indexed by order and pixel.
+	QHash<quint64, Tile*> tiles;
+
+	//! Drawing state of the current frame.
+	int drawOrder;
+	unsigned int frameCounter;
+	SphericalRegionP viewportRegion;
+	Vec3d viewDirection;
+	double pixelPerRad;
+	Vec4f color;
+	//! The tiles to download, in the order of their priority.
+	QMultiMap<double, quint64> wantedTiles;
+	//! The tiles whose texture is being downloaded or decoded.
+	QList<quint64> requestedTiles;
+	int nbDrawnTiles;
+	int nbLoadingTiles;
+
+	//! Texture coordinates and indices of the drawing grid, the same for all the tiles of an order.
+	QVector<Vec2f> gridTexCoords[4];
+	QVector<unsigned short> gridIndices[4];
+
+	bool loadingState;
+	int lastPercent;
+
+	static int maxParallelRequests;
+};
+
+#endif // _STELHIPSSKYLAYER_HPP_
@@ -0,0 +1,157 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelJobSystem.hpp"
+
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+//! The state of a group, shared with the runners queued in the pool which
+//! may still be waiting for a thread when the group is deleted.
+struct StelJobGroupData
+{
+	StelJobGroupData() : nbRunning(0) {}
+	~StelJobGroupData() {qDeleteAll(pending);}
+
+	//! Run the next job not started yet.
+	//! @return false if there was none.
+	bool runNext()
+	{
+		mutex.lock();
+		if (pending.isEmpty())
+		{
+			mutex.unlock();
+			return false;
+		}
+		StelJob* job = pending.takeFirst();
+		++nbRunning;
+		mutex.unlock();
+
+		job->run();
+		delete job;
+
+		QMutexLocker lock(&mutex);
+		--nbRunning;
+		if (nbRunning==0 && pending.isEmpty())
+			finished.wakeAll();
+		return true;
+	}
+
+	QMutex mutex;
+	QWaitCondition finished;
+	QList<StelJob*> pending;
+	int nbRunning;
+};
+
+//! Queued in the pool for each job submitted, runs the next job of its group.
+class StelJobRunner : public QRunnable
+{
+public:
+	StelJobRunner(const QSharedPointer<StelJobGroupData>& agroup) : group(agroup) {}
+	virtual void run() {group->runNext();}
+private:
+	QSharedPointer<StelJobGroupData> group;
+};
+
+StelJobGroup::StelJobGroup() : d(new StelJobGroupData())
+{
+}
+
+StelJobGroup::~StelJobGroup()
+{
+	cancel();
+	wait();
+}
+
+void StelJobGroup::wait()
+{
+	while (d->runNext()) {}
+	QMutexLocker lock(&d->mutex);
+	while (d->nbRunning>0 || !d->pending.isEmpty())
+		d->finished.wait(&d->mutex);
+}
+
+void StelJobGroup::cancel()
+{
+	QMutexLocker lock(&d->mutex);
+	qDeleteAll(d->pending);
+	d->pending.clear();
+	if (d->nbRunning==0)
+		d->finished.wakeAll();
+}
+
+bool StelJobGroup::isFinished() const
+{
+	QMutexLocker lock(&d->mutex);
+	return d->nbRunning==0 && d->pending.isEmpty();
+}
+
+StelJobSystem::StelJobSystem() : pool(QThreadPool::globalInstance())
+{
+}
+
+StelJobSystem::~StelJobSystem()
+{
+	QMutexLocker lock(&mainThreadMutex);
+	qDeleteAll(mainThreadJobs);
+	mainThreadJobs.clear();
+}
+
+int StelJobSystem::getNbThreads() const
+{
+	return pool->maxThreadCount();
+}
+
+void StelJobSystem::submit(StelJobGroup& group, StelJob* job, Priority priority)
+{
+	group.d->mutex.lock();
+	group.d->pending.append(job);
+	group.d->mutex.unlock();
+	pool->start(new StelJobRunner(group.d), priority);
+}
+
+void StelJobSystem::submitToMainThread(StelJob* job)
+{
+	QMutexLocker lock(&mainThreadMutex);
+	mainThreadJobs.append(job);
+}
+
+void StelJobSystem::runMainThreadJobs(int budgetMs)
+{
+	QElapsedTimer timer;
+	timer.start();
+	forever
+	{
+		mainThreadMutex.lock();
+		if (mainThreadJobs.isEmpty())
+		{
+			mainThreadMutex.unlock();
+			return;
+		}
+		StelJob* job = mainThreadJobs.takeFirst();
+		mainThreadMutex.unlock();
+
+		job->run();
+		delete job;
+		if (timer.elapsed()>=budgetMs)
+			return;
+	}
+}
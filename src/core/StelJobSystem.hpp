@@ -0,0 +1,152 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELJOBSYSTEM_HPP_
+#define _STELJOBSYSTEM_HPP_
+
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+
+class QThreadPool;
+struct StelJobGroupData;
+
+//! @class StelJob
+//! A unit of work run by the StelJobSystem.
+class StelJob
+{
+public:
+	virtual ~StelJob() {}
+	virtual void run() = 0;
+};
+
+//! @class StelJobGroup
+//! A set of jobs submitted to the StelJobSystem which can be waited for together, e.g. the
+//! jobs of one step of a frame. The jobs are queued in the group and the threads of the pool
+//! take them in order. A thread waiting for the group takes the jobs not started yet instead
+//! of sleeping, so it does its share of the work, and a job running in the pool can wait for
+//! another group without blocking a thread of the pool.
+//! The group owns its jobs, which are deleted once run.
+class StelJobGroup
+{
+public:
+	StelJobGroup();
+	//! Cancel the jobs not started yet and wait for the running ones.
+	~StelJobGroup();
+
+	//! Run the jobs not started yet in the calling thread, and wait until all the jobs are finished.
+	void wait();
+	//! Delete the jobs which have not started yet.
+	void cancel();
+	//! Get whether all the jobs submitted to the group are finished.
+	bool isFinished() const;
+
+private:
+	friend class StelJobSystem;
+	QSharedPointer<StelJobGroupData> d;
+	Q_DISABLE_COPY(StelJobGroup)
+};
+
+//! @class StelJobSystem
+//! Run the parallel work of all the modules on the shared thread pool of the application.
+//! The pool is the global QThreadPool also used by QtConcurrent for the loaders, so that
+//! the number of busy threads never exceeds the number of cores and no thread is created
+//! per task. The jobs waited for in the current frame have a higher priority than the
+//! background ones, and the thread waiting for a group runs its jobs too (see StelJobGroup).
+//! The work which needs the GL context can be queued for the main thread, where it is run
+//! at the beginning of the next update within a time budget.
+class StelJobSystem
+{
+public:
+	//! The priority of the jobs in the queue of the pool.
+	enum Priority
+	{
+		PriorityBackground=0,	//!< Loading and other work not needed in the current frame
+		PriorityFrame=1		//!< Work waited for in the current frame
+	};
+
+	StelJobSystem();
+	//! Delete the main thread jobs not run yet.
+	~StelJobSystem();
+
+	//! Get the number of threads of the pool.
+	int getNbThreads() const;
+
+	//! Submit a job in a group. The group takes the ownership of the job.
+	void submit(StelJobGroup& group, StelJob* job, Priority priority=PriorityFrame);
+
+	//! Call func on each item of a container with random access iterators, like QtConcurrent::blockingMap.
+	//! The items are split in contiguous ranges of at least minItemsPerJob items, one job per range.
+	//! Below 2*minItemsPerJob items, they are all processed in the calling thread.
+	template<class Container, class Func>
+	void blockingMap(Container& items, Func func, int minItemsPerJob=1);
+
+	//! Queue a job run in the main thread at the beginning of the next update.
+	//! Thread safe, the job system takes the ownership of the job.
+	void submitToMainThread(StelJob* job);
+	//! Run the jobs queued for the main thread, until the time budget is exceeded.
+	//! At least one job is run when there are some, the other ones are kept for the next frame.
+	//! @param budgetMs the time budget in milliseconds.
+	void runMainThreadJobs(int budgetMs);
+
+private:
+	template<class Iterator, class Func>
+	class MapJob : public StelJob
+	{
+	public:
+		MapJob(Iterator abegin, Iterator aend, const Func& afunc) : begin(abegin), end(aend), func(afunc) {}
+		virtual void run()
+		{
+			for (Iterator i=begin; i!=end; ++i)
+				func(*i);
+		}
+	private:
+		Iterator begin, end;
+		Func func;
+	};
+
+	QThreadPool* pool;
+	QMutex mainThreadMutex;
+	QList<StelJob*> mainThreadJobs;
+};
+
+template<class Container, class Func>
+void StelJobSystem::blockingMap(Container& items, Func func, int minItemsPerJob)
+{
+	typedef typename Container::iterator Iterator;
+	const int count = items.size();
+	minItemsPerJob = qMax(minItemsPerJob, 1);
+	// Detach the container once, before sharing its iterators with the threads
+	const Iterator first = items.begin();
+	if (count<2*minItemsPerJob)
+	{
+		MapJob<Iterator, Func>(first, items.end(), func).run();
+		return;
+	}
+	// A few jobs per thread, so that the threads finishing first take the remaining ones
+	const int nbJobs = qMin(count/minItemsPerJob, 4*(getNbThreads()+1));
+	StelJobGroup group;
+	for (int i=1; i<nbJobs; ++i)
+		submit(group, new MapJob<Iterator, Func>(first+count*i/nbJobs, first+count*(i+1)/nbJobs, func));
+	// The first range is run here while the pool starts the other ones
+	MapJob<Iterator, Func>(first, first+count/nbJobs, func).run();
+	group.wait();
+}
+
+#endif // _STELJOBSYSTEM_HPP_
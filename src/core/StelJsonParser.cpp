@@ -40,6 +40,7 @@ public:
 	QByteArray readString();
 	QVariant readOther();
 	QVariant parse();
+	void parse(StelJsonHandler* handler);
 
 private:
 	QIODevice* input;
@@ -328,6 +329,86 @@ QVariant StelJsonParserInstance::parse()
 	}
 }
 
+// Parse the given input stream, reporting the content to the handler
+void StelJsonParserInstance::parse(StelJsonHandler* handler)
+{
+	skipJson();
+
+	char r;
+	if (!getChar(&r))
+	{
+		handler->value(QVariant());
+		return;
+	}
+
+	switch (r)
+	{
+		case '{':
+		{
+			handler->startObject();
+			if (skipAndConsumeChar('}'))
+			{
+				handler->endObject();
+				return;
+			}
+			for (;;)
+			{
+				if (!skipAndConsumeChar('\"'))
+				{
+					char cc=0;
+					getChar(&cc);
+					throw std::runtime_error(qPrintable(QString("Expected '\"' at beginning of string, found: '%1' (ASCII %2)").arg(cc).arg((int)(cc))));
+				}
+				const QByteArray& ar = readString();
+				const QString& key = QString::fromUtf8(ar.constData(), ar.size());
+				if (!skipAndConsumeChar(':'))
+					throw std::runtime_error(qPrintable(QString("Expected ':' after a member name: ")+key));
+
+				skipJson();
+				handler->key(key);
+				parse(handler);
+				if (!skipAndConsumeChar(','))
+					break;
+			}
+			if (!skipAndConsumeChar('}'))
+				throw std::runtime_error("Expected '}' to close an object");
+			handler->endObject();
+			return;
+		}
+		case '[':
+		{
+			handler->startArray();
+			if (skipAndConsumeChar(']'))
+			{
+				handler->endArray();
+				return;
+			}
+			for (;;)
+			{
+				parse(handler);
+				if (!skipAndConsumeChar(','))
+					break;
+			}
+			if (!skipAndConsumeChar(']'))
+				throw std::runtime_error("Expected ']' to close an array");
+			handler->endArray();
+			return;
+		}
+		case '\"':
+		{
+			const QByteArray& ar = readString();
+			handler->value(QString::fromUtf8(ar.constData(), ar.size()));
+			return;
+		}
+		default:
+		{
+			ungetChar(r);
+			handler->value(readOther());
+			return;
+		}
+	}
+}
+
 QHash<int, void (*)(const QVariant&, QIODevice*, int)> StelJsonParser::otherSerializer;
 
 // Serialize the passed QVariant as JSON into the output QIODevice
@@ -459,6 +540,12 @@ QVariant StelJsonParser::parse(const QByteArray& aar)
 	return v;
 }
 
+void StelJsonParser::parse(QIODevice* input, StelJsonHandler* handler)
+{
+	StelJsonParserInstance parser(input);
+	parser.parse(handler);
+}
+
 JsonListIterator::JsonListIterator(QIODevice* input)
 {
 	parser = new StelJsonParserInstance(input);
@@ -487,3 +574,14 @@ QVariant JsonListIterator::next()
 	}
 	return ret;
 }
+
+void JsonListIterator::next(StelJsonHandler* handler)
+{
+	parser->parse(handler);
+	ahasNext = parser->skipAndConsumeChar(',');
+	if (!ahasNext)
+	{
+		if (!parser->skipAndConsumeChar(']'))
+			throw std::runtime_error("Expected ']' to end a list iterator");
+	}
+}
@@ -24,6 +24,25 @@
 #include <QByteArray>
 
 
+//! @class StelJsonHandler
+//! Interface receiving the content of a JSON document as a stream of events, so that large files
+//! can be loaded directly into application objects without building the full QVariant tree.
+//! The default implementations ignore the events, so that handlers only override what they need.
+//! The events of an object are startObject(), then key() followed by the events of the value for
+//! each member, and endObject(). Scalar values are reported by value() using the same types as
+//! StelJsonParser::parse().
+class StelJsonHandler
+{
+public:
+	virtual ~StelJsonHandler() {;}
+	virtual void startObject() {;}
+	virtual void key(const QString& name) {Q_UNUSED(name);}
+	virtual void endObject() {;}
+	virtual void startArray() {;}
+	virtual void endArray() {;}
+	virtual void value(const QVariant& v) {Q_UNUSED(v);}
+};
+
 //! Qt-style iterator over a JSON array. An actual list is not kept in memory,
 //! so only forward iteration is supported and all methods, including the constructor,
 //! involve read() calls on the QIODevice. Because of this, do not modify the
@@ -44,6 +63,11 @@ public:
 	//! @return the next object from the array
 	QVariant next();
 
+	//! Reads the next object from input and reports its content to the handler, without building a QVariant.
+	//! Advances QIODevice to just after the object.
+	//! @param handler receives the events, use a StelJsonHandler to skip the object.
+	void next(StelJsonHandler* handler);
+
 	//! Returns true if the next non-whitespace character is not a ']' character.
 	bool hasNext() const {return ahasNext;}
 
@@ -76,6 +100,11 @@ public:
 	static QVariant parse(QIODevice* input);
 	static QVariant parse(const QByteArray& input);
 
+	//! Parse the given input stream and report its content to the handler.
+	//! This uses much less memory than parse() for large files as no QVariant tree is built.
+	//! @throw std::runtime_error if the input is not valid JSON.
+	static void parse(QIODevice* input, StelJsonHandler* handler);
+
 	//! Serialize the passed QVariant as JSON into the output QIODevice.
 	static void write(const QVariant& jsonObject, QIODevice* output, int indentLevel=0);
 
@@ -0,0 +1,164 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelLiveOutput.hpp"
+#include "StelOpenGL.hpp"
+
+#include <QDebug>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
+#include <QProcess>
+
+StelLiveOutput::StelLiveOutput(const QString& aCommand, const QSize& aSize, double aFps)
+	: command(aCommand)
+	, size(aSize)
+	, fps(qMax(aFps, 1.))
+	, nextFrameTime(0.)
+	, frameNumber(0)
+	, droppedFrames(0)
+	, failed(false)
+	, encoder(NULL)
+	, fbo(NULL)
+{
+	for (int i=0; i<NbPixelBuffers; ++i)
+	{
+		pixelBuffers[i] = NULL;
+		pixelBufferFull[i] = false;
+	}
+}
+
+StelLiveOutput::~StelLiveOutput()
+{
+	stop();
+}
+
+bool StelLiveOutput::start()
+{
+	fbo = new QOpenGLFramebufferObject(size);
+	if (!fbo->isValid())
+	{
+		qWarning() << "ERROR: can't create a framebuffer of" << size << "for the live output";
+		delete fbo;
+		fbo = NULL;
+		return false;
+	}
+	for (int i=0; i<NbPixelBuffers; ++i)
+	{
+		pixelBuffers[i] = new QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer);
+		pixelBuffers[i]->setUsagePattern(QOpenGLBuffer::StreamRead);
+		pixelBuffers[i]->create();
+		pixelBuffers[i]->bind();
+		pixelBuffers[i]->allocate(size.width()*size.height()*4);
+		pixelBuffers[i]->release();
+		pixelBufferFull[i] = false;
+	}
+
+	// The encoder is started without waiting, the frames are buffered until it reads them
+	const QString cmd = command.arg(size.width()).arg(size.height()).arg(fps);
+	encoder = new QProcess();
+	encoder->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+	encoder->start(cmd, QIODevice::WriteOnly);
+	qDebug() << "INFO: live output of" << size << "at" << fps << "FPS to" << cmd;
+	return true;
+}
+
+void StelLiveOutput::stop()
+{
+	if (encoder)
+	{
+		encoder->closeWriteChannel();
+		if (!encoder->waitForFinished(3000))
+			encoder->kill();
+		delete encoder;
+		encoder = NULL;
+		qDebug() << "INFO: live output stopped after" << frameNumber << "frames," << droppedFrames << "dropped";
+	}
+	for (int i=0; i<NbPixelBuffers; ++i)
+	{
+		delete pixelBuffers[i];
+		pixelBuffers[i] = NULL;
+		pixelBufferFull[i] = false;
+	}
+	delete fbo;
+	fbo = NULL;
+}
+
+void StelLiveOutput::collectPixelBuffer(int index)
+{
+	if (!pixelBufferFull[index])
+		return;
+	pixelBufferFull[index] = false;
+
+	// Waiting for the encoder would delay the next frames, the frame is dropped instead
+	const qint64 frameBytes = (qint64)size.width()*size.height()*4;
+	if (encoder->bytesToWrite()>MaxQueuedFrames*frameBytes)
+	{
+		++droppedFrames;
+		return;
+	}
+	// Mapping the buffer doesn't wait, the transfer was queued frames ago
+	pixelBuffers[index]->bind();
+	const char* pixels = static_cast<const char*>(pixelBuffers[index]->map(QOpenGLBuffer::ReadOnly));
+	if (pixels!=NULL)
+	{
+		encoder->write(pixels, frameBytes);
+		pixelBuffers[index]->unmap();
+	}
+	pixelBuffers[index]->release();
+}
+
+void StelLiveOutput::captureFrame(const QSize& windowSize, double time)
+{
+	if (failed || windowSize.isEmpty() || time<nextFrameTime)
+		return;
+	// Keep the rate of the stream, without catching up the frames missed while the rendering was slow
+	nextFrameTime = qMax(nextFrameTime+1./fps, time);
+
+	if (encoder==NULL)
+	{
+		if (size.isEmpty())
+			size = windowSize;
+		if (!start())
+		{
+			failed = true;
+			return;
+		}
+	}
+	if (encoder->state()==QProcess::NotRunning)
+	{
+		qWarning() << "ERROR: the live output encoder is not running:" << encoder->errorString();
+		stop();
+		failed = true;
+		return;
+	}
+
+	const int index = frameNumber % NbPixelBuffers;
+	collectPixelBuffer(index);
+
+	// The window is scaled to the size of the stream, then read back without waiting
+	QOpenGLFramebufferObject::blitFramebuffer(fbo, QRect(QPoint(0, 0), size), NULL, QRect(QPoint(0, 0), windowSize), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	fbo->bind();
+	pixelBuffers[index]->bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, size.width(), size.height(), GL_BGRA, GL_UNSIGNED_BYTE, 0);
+	pixelBuffers[index]->release();
+	fbo->release();
+	pixelBufferFull[index] = true;
+	++frameNumber;
+}
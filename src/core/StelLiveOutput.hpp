@@ -0,0 +1,84 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELLIVEOUTPUT_HPP_
+#define _STELLIVEOUTPUT_HPP_
+
+#include <QSize>
+#include <QString>
+
+class QOpenGLBuffer;
+class QOpenGLFramebufferObject;
+class QProcess;
+
+//! @class StelLiveOutput
+//! Feed the frames shown in the window to an external encoder, to stream the shows live without
+//! capturing the screen. The encoder is a command reading raw BGRA frames from its standard input,
+//! typically ffmpeg with a hardware encoder like h264_nvenc, h264_vaapi or h264_videotoolbox and an
+//! SRT or RTP output. In the command, %1 and %2 are replaced by the width and the height of the
+//! frames and %3 by their rate. The frames are bottom up, as read from OpenGL.
+//! The final framebuffer, after the viewport effects, is scaled to the size of the stream on the GPU and
+//! read back asynchronously through a ring of pixel buffer objects, so the frame is never waited for.
+//! A frame is dropped rather than delaying the rendering when the encoder does not keep up.
+//! All the methods must be called from the main thread with the GL context current.
+class StelLiveOutput
+{
+public:
+	//! @param command the command of the encoder.
+	//! @param size the size of the stream in pixels, or an empty size to use the size of the window
+	//! at the first frame.
+	//! @param fps the number of frames per second of the stream.
+	StelLiveOutput(const QString& command, const QSize& size, double fps);
+	~StelLiveOutput();
+
+	//! Send the frame drawn in the window to the encoder if a frame of the stream is due.
+	//! @param windowSize the size of the window framebuffer in device pixels.
+	//! @param time the time of the frame in seconds.
+	void captureFrame(const QSize& windowSize, double time);
+
+private:
+	//! Number of pixel buffers, i.e. of frames read back in parallel.
+	static const int NbPixelBuffers = 3;
+	//! Number of frames waiting to be read by the encoder above which the new frames are dropped.
+	static const int MaxQueuedFrames = 2;
+
+	//! Create the buffers for the size of the stream and start the encoder.
+	bool start();
+	//! Close the input of the encoder and release the GPU buffers.
+	void stop();
+	//! Write the frame of a pixel buffer to the encoder, or drop it if the encoder is late.
+	void collectPixelBuffer(int index);
+
+	QString command;
+	QSize size;
+	double fps;
+	double nextFrameTime;
+	int frameNumber;
+	int droppedFrames;
+	//! Whether the encoder could not be started or stopped, in which case nothing is captured anymore.
+	bool failed;
+
+	QProcess* encoder;
+	QOpenGLFramebufferObject* fbo;
+	QOpenGLBuffer* pixelBuffers[NbPixelBuffers];
+	//! Whether each pixel buffer holds a frame not given to the encoder yet.
+	bool pixelBufferFull[NbPixelBuffers];
+};
+
+#endif // _STELLIVEOUTPUT_HPP_
@@ -0,0 +1,468 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelLocationDatabase.hpp"
+#include "StelFileMgr.hpp"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	const quint32 databaseMagic = 0x42444c53;	// "SLDB" in little endian
+	const quint32 databaseVersion = 1;
+	const int headerSize = 44;
+	const int recordSize = 52;
+	//! Number of rings of cells searched around a position before checking all the locations.
+	const int maxSearchRings = 30;
+
+	enum StringField
+	{
+		FieldID = 0,
+		FieldKey,
+		FieldName,
+		FieldState,
+		FieldCountry,
+		FieldPlanet,
+		FieldLandscape,
+		NbStringFields
+	};
+
+	void put32(QByteArray& buf, quint32 v)
+	{
+		uchar bytes[4];
+		qToLittleEndian(v, bytes);
+		buf.append((const char*)bytes, 4);
+	}
+
+	void putFloat(QByteArray& buf, float f)
+	{
+		quint32 bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+		put32(buf, bits);
+	}
+
+	float getFloat(const uchar* p)
+	{
+		const quint32 bits = qFromLittleEndian<quint32>(p);
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	//! Collect the strings in the table, each distinct string being stored once.
+	class StringTable
+	{
+	public:
+		QByteArray data;
+
+		quint32 offset(const QString& s)
+		{
+			QHash<QString, quint32>::ConstIterator iter = offsets.constFind(s);
+			if (iter!=offsets.constEnd())
+				return iter.value();
+			const quint32 off = data.size();
+			const QByteArray utf8 = s.toUtf8();
+			put32(data, utf8.size());
+			data.append(utf8);
+			offsets.insert(s, off);
+			return off;
+		}
+
+	private:
+		QHash<QString, quint32> offsets;
+	};
+
+	//! Order of the name index.
+	struct NameLess
+	{
+		NameLess(const QVector<QString>& k, const QVector<QString>& i) : keys(k), ids(i) {}
+		bool operator()(int a, int b) const
+		{
+			if (keys[a]!=keys[b])
+				return keys[a]<keys[b];
+			return ids[a]<ids[b];
+		}
+		const QVector<QString>& keys;
+		const QVector<QString>& ids;
+	};
+}
+
+StelLocationDatabase::StelLocationDatabase() : mapped(NULL)
+{
+	close();
+}
+
+StelLocationDatabase::~StelLocationDatabase()
+{
+	close();
+}
+
+void StelLocationDatabase::close()
+{
+	if (mapped)
+	{
+		file.unmap(mapped);
+		mapped = NULL;
+	}
+	if (file.isOpen())
+		file.close();
+	memoryData.clear();
+	data = NULL;
+	dataSize = 0;
+	nbLocations = 0;
+	records = names = cellStarts = cells = strings = NULL;
+	nbGridEntries = 0;
+	stringsSize = 0;
+}
+
+QString StelLocationDatabase::getDatabasePath(const QString& sourcePath)
+{
+	const QFileInfo info(sourcePath);
+	const QByteArray hash = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+	return StelFileMgr::getCacheDir() + "/locations/" + info.baseName() + "-" + QString::fromLatin1(hash) + ".db";
+}
+
+bool StelLocationDatabase::write(const QList<StelLocation>& locations, QIODevice* output, qint64 sourceSize, qint64 sourceTime)
+{
+	const int n = locations.size();
+	StringTable table;
+	QVector<QString> ids(n), keys(n);
+	QByteArray recordData;
+	recordData.reserve(n*recordSize);
+	QVector<QVector<quint32> > gridCells(GridRows*GridCols);
+	for (int i=0;i<n;++i)
+	{
+		const StelLocation& loc = locations.at(i);
+		ids[i] = loc.getID();
+		keys[i] = ids[i].toLower();
+		put32(recordData, table.offset(ids[i]));
+		put32(recordData, table.offset(keys[i]));
+		put32(recordData, table.offset(loc.name));
+		put32(recordData, table.offset(loc.state));
+		put32(recordData, table.offset(loc.country));
+		put32(recordData, table.offset(loc.planetName));
+		put32(recordData, table.offset(loc.landscapeKey));
+		putFloat(recordData, loc.latitude);
+		putFloat(recordData, loc.longitude);
+		putFloat(recordData, loc.bortleScaleIndex);
+		put32(recordData, (quint32)loc.altitude);
+		put32(recordData, (quint32)loc.population);
+		put32(recordData, loc.role.unicode());
+
+		if (loc.planetName=="Earth")
+		{
+			int row, col;
+			getCell(loc.latitude, loc.longitude, row, col);
+			gridCells[row*GridCols+col].append(i);
+		}
+	}
+
+	QVector<int> sorted(n);
+	for (int i=0;i<n;++i)
+		sorted[i] = i;
+	std::sort(sorted.begin(), sorted.end(), NameLess(keys, ids));
+	QByteArray nameData;
+	foreach (int i, sorted)
+		put32(nameData, i);
+
+	QByteArray gridData;
+	quint32 start = 0;
+	foreach (const QVector<quint32>& cell, gridCells)
+	{
+		put32(gridData, start);
+		start += cell.size();
+	}
+	put32(gridData, start);
+	foreach (const QVector<quint32>& cell, gridCells)
+	{
+		foreach (quint32 i, cell)
+			put32(gridData, i);
+	}
+
+	const quint32 namesOffset = headerSize + recordData.size();
+	const quint32 gridOffset = namesOffset + nameData.size();
+	const quint32 stringsOffset = gridOffset + gridData.size();
+	QByteArray header;
+	put32(header, databaseMagic);
+	put32(header, databaseVersion);
+	put32(header, (quint32)sourceSize);
+	put32(header, (quint32)((quint64)sourceSize>>32));
+	put32(header, (quint32)sourceTime);
+	put32(header, (quint32)((quint64)sourceTime>>32));
+	put32(header, n);
+	put32(header, namesOffset);
+	put32(header, gridOffset);
+	put32(header, stringsOffset);
+	put32(header, table.data.size());
+	Q_ASSERT(header.size()==headerSize);
+
+	return output->write(header)==header.size()
+		&& output->write(recordData)==recordData.size()
+		&& output->write(nameData)==nameData.size()
+		&& output->write(gridData)==gridData.size()
+		&& output->write(table.data)==table.data.size();
+}
+
+bool StelLocationDatabase::open(const QString& path, qint64 sourceSize, qint64 sourceTime)
+{
+	close();
+	file.setFileName(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	const qint64 size = file.size();
+	mapped = file.map(0, size);
+	if (!mapped || !setData(mapped, size, sourceSize, sourceTime))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool StelLocationDatabase::open(const QByteArray& bytes, qint64 sourceSize, qint64 sourceTime)
+{
+	close();
+	memoryData = bytes;
+	if (!setData((const uchar*)memoryData.constData(), memoryData.size(), sourceSize, sourceTime))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool StelLocationDatabase::setData(const uchar* bytes, qint64 size, qint64 sourceSize, qint64 sourceTime)
+{
+	if (size<headerSize)
+		return false;
+	if (qFromLittleEndian<quint32>(bytes)!=databaseMagic || qFromLittleEndian<quint32>(bytes+4)!=databaseVersion)
+		return false;
+	const qint64 size64 = qFromLittleEndian<quint32>(bytes+8) | ((qint64)qFromLittleEndian<quint32>(bytes+12)<<32);
+	const qint64 time64 = qFromLittleEndian<quint32>(bytes+16) | ((qint64)qFromLittleEndian<quint32>(bytes+20)<<32);
+	if (size64!=sourceSize || time64!=sourceTime)
+		return false;
+	const quint32 n = qFromLittleEndian<quint32>(bytes+24);
+	const quint32 namesOffset = qFromLittleEndian<quint32>(bytes+28);
+	const quint32 gridOffset = qFromLittleEndian<quint32>(bytes+32);
+	const quint32 stringsOffset = qFromLittleEndian<quint32>(bytes+36);
+	const quint32 nbStringBytes = qFromLittleEndian<quint32>(bytes+40);
+
+	// Check the layout once, so that the accesses do not need to
+	const qint64 nbCells = GridRows*GridCols;
+	if (namesOffset!=headerSize+(qint64)n*recordSize || gridOffset!=namesOffset+(qint64)n*4
+		|| (qint64)stringsOffset+nbStringBytes!=size || (qint64)gridOffset+(nbCells+1)*4>stringsOffset)
+		return false;
+	const quint32 nbEntries = qFromLittleEndian<quint32>(bytes+gridOffset+nbCells*4);
+	if (nbEntries>n || stringsOffset!=gridOffset+(nbCells+1+(qint64)nbEntries)*4)
+		return false;
+
+	data = bytes;
+	dataSize = size;
+	nbLocations = n;
+	records = bytes+headerSize;
+	names = bytes+namesOffset;
+	cellStarts = bytes+gridOffset;
+	cells = cellStarts+(nbCells+1)*4;
+	nbGridEntries = nbEntries;
+	strings = bytes+stringsOffset;
+	stringsSize = nbStringBytes;
+	return true;
+}
+
+QString StelLocationDatabase::getString(quint32 offset) const
+{
+	if (offset+4>stringsSize)
+		return QString();
+	const quint32 size = qFromLittleEndian<quint32>(strings+offset);
+	if (size>stringsSize-offset-4)
+		return QString();
+	return QString::fromUtf8((const char*)strings+offset+4, size);
+}
+
+const uchar* StelLocationDatabase::record(int i) const
+{
+	Q_ASSERT(i>=0 && i<nbLocations);
+	return records+(qint64)i*recordSize;
+}
+
+StelLocation StelLocationDatabase::at(int i) const
+{
+	const uchar* r = record(i);
+	StelLocation loc;
+	loc.name = getString(qFromLittleEndian<quint32>(r+FieldName*4));
+	loc.state = getString(qFromLittleEndian<quint32>(r+FieldState*4));
+	loc.country = getString(qFromLittleEndian<quint32>(r+FieldCountry*4));
+	loc.planetName = getString(qFromLittleEndian<quint32>(r+FieldPlanet*4));
+	loc.landscapeKey = getString(qFromLittleEndian<quint32>(r+FieldLandscape*4));
+	r += NbStringFields*4;
+	loc.latitude = getFloat(r);
+	loc.longitude = getFloat(r+4);
+	loc.bortleScaleIndex = getFloat(r+8);
+	loc.altitude = (int)qFromLittleEndian<quint32>(r+12);
+	loc.population = (int)qFromLittleEndian<quint32>(r+16);
+	loc.role = QChar((ushort)qFromLittleEndian<quint32>(r+20));
+	loc.isUserLocation = false;
+	return loc;
+}
+
+QString StelLocationDatabase::getID(int i) const
+{
+	return getString(qFromLittleEndian<quint32>(record(i)+FieldID*4));
+}
+
+QString StelLocationDatabase::getKey(int i) const
+{
+	return getString(qFromLittleEndian<quint32>(record(i)+FieldKey*4));
+}
+
+int StelLocationDatabase::getSorted(int rank) const
+{
+	Q_ASSERT(rank>=0 && rank<nbLocations);
+	return qFromLittleEndian<quint32>(names+(qint64)rank*4);
+}
+
+int StelLocationDatabase::lowerBound(const QString& key) const
+{
+	int lo = 0;
+	int hi = nbLocations;
+	while (lo<hi)
+	{
+		const int mid = (lo+hi)/2;
+		if (getKey(getSorted(mid))<key)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int StelLocationDatabase::find(const QString& id) const
+{
+	const QString key = id.toLower();
+	for (int rank=lowerBound(key);rank<nbLocations;++rank)
+	{
+		const int i = getSorted(rank);
+		if (getKey(i)!=key)
+			break;
+		// Only a few IDs differ by their case
+		if (getID(i)==id)
+			return i;
+	}
+	return -1;
+}
+
+QVector<int> StelLocationDatabase::findStartingWith(const QString& prefix, int maxNbItem) const
+{
+	QVector<int> result;
+	const QString key = prefix.toLower();
+	for (int rank=lowerBound(key);rank<nbLocations && result.size()!=maxNbItem;++rank)
+	{
+		const int i = getSorted(rank);
+		if (!getKey(i).startsWith(key))
+			break;
+		result.append(i);
+	}
+	return result;
+}
+
+void StelLocationDatabase::getCell(float latitude, float longitude, int& row, int& col)
+{
+	row = qBound(0, (int)std::floor(latitude+90.f), GridRows-1);
+	col = ((int)std::floor(longitude+180.f)%GridCols+GridCols)%GridCols;
+}
+
+void StelLocationDatabase::toVector(float latitude, float longitude, double pos[3])
+{
+	const double lat = latitude*M_PI/180.;
+	const double lng = longitude*M_PI/180.;
+	pos[0] = std::cos(lat)*std::cos(lng);
+	pos[1] = std::cos(lat)*std::sin(lng);
+	pos[2] = std::sin(lat);
+}
+
+void StelLocationDatabase::searchCell(int row, int col, const double pos[3], int& best, double& bestDot) const
+{
+	const int cell = row*GridCols+col;
+	const quint32 begin = qFromLittleEndian<quint32>(cellStarts+cell*4);
+	const quint32 end = qFromLittleEndian<quint32>(cellStarts+cell*4+4);
+	for (quint32 k=begin;k<end && k<nbGridEntries;++k)
+	{
+		const int i = qFromLittleEndian<quint32>(cells+k*4);
+		if (i<0 || i>=nbLocations)
+			continue;
+		const uchar* r = record(i)+NbStringFields*4;
+		double p[3];
+		toVector(getFloat(r), getFloat(r+4), p);
+		const double dot = p[0]*pos[0]+p[1]*pos[1]+p[2]*pos[2];
+		if (dot>bestDot)
+		{
+			bestDot = dot;
+			best = i;
+		}
+	}
+}
+
+int StelLocationDatabase::findNearest(float latitude, float longitude, float* distance) const
+{
+	int best = -1;
+	double bestDot = -2.;
+	double pos[3];
+	toVector(latitude, longitude, pos);
+	int row0, col0;
+	getCell(latitude, longitude, row0, col0);
+
+	// Search the rings of cells around the position, until the nearest location found
+	// is closer than any location in the next ring can be
+	for (int ring=0;ring<=maxSearchRings;++ring)
+	{
+		for (int row=row0-ring;row<=row0+ring;++row)
+		{
+			if (row<0 || row>=GridRows)
+				continue;
+			const bool edgeRow = (row==row0-ring || row==row0+ring);
+			for (int dc=-ring;dc<=ring;dc+=(edgeRow || ring==0 ? 1 : 2*ring))
+				searchCell(row, ((col0+dc)%GridCols+GridCols)%GridCols, pos, best, bestDot);
+		}
+		if (best>=0)
+		{
+			// The unvisited cells are at least ring degrees away in latitude or in longitude,
+			// the latter being shortened by the cosine of the highest latitude they reach
+			const double maxLat = qMin(90., std::fabs(latitude)+ring+1.);
+			const double bound = std::asin(std::sin(ring*M_PI/180.)*std::cos(maxLat*M_PI/180.));
+			if (std::acos(qBound(-1., bestDot, 1.))<=bound)
+				break;
+		}
+		if (ring==maxSearchRings)
+		{
+			// Isolated or polar positions, it is simpler to check all the locations
+			for (int cell=0;cell<GridRows*GridCols;++cell)
+				searchCell(cell/GridCols, cell%GridCols, pos, best, bestDot);
+		}
+	}
+	if (distance && best>=0)
+		*distance = std::acos(qBound(-1., bestDot, 1.))*180./M_PI;
+	return best;
+}
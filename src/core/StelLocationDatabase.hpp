@@ -0,0 +1,131 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELLOCATIONDATABASE_HPP_
+#define _STELLOCATIONDATABASE_HPP_
+
+#include "StelLocation.hpp"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+//! @class StelLocationDatabase
+//! Read only database of the base locations, stored in a binary file which is memory mapped,
+//! so that opening it does not require to decode all the locations.
+//! The locations are only decoded when they are accessed. The database contains a name index,
+//! sorted by the case insensitive IDs of the locations, used to find a location by its ID or
+//! its prefix, and a spatial index on a grid of 1x1 degree cells, used to find the location
+//! nearest to given coordinates, e.g. the ones received from a GPS.
+//!
+//! Format, in little endian:
+//! @verbatim
+//! header      magic "SLDB", format version, size and modification time of the source file,
+//!             number of locations, offsets of the name index, grid and string table
+//! records     for each location, the offsets in the string table of its ID, lower case ID,
+//!             name, state, country, planet and landscape, then its latitude, longitude,
+//!             Bortle index (float32), altitude, population and role (32 bits)
+//! names       the numbers of the locations sorted by their lower case, then exact, IDs
+//! grid        for each cell from the south west corner, row by row, the position in the
+//!             following list of its first location, then the numbers of the locations of each cell,
+//!             only the locations on Earth being indexed
+//! strings     for each string, its UTF-8 size followed by the UTF-8 data
+//! @endverbatim
+class StelLocationDatabase
+{
+public:
+	StelLocationDatabase();
+	~StelLocationDatabase();
+
+	//! Open a database file, memory mapping it.
+	//! @param sourceSize, sourceTime the version of the source file which is expected.
+	//! @return false if the file cannot be read, is invalid or was built for another version of the source.
+	bool open(const QString& path, qint64 sourceSize, qint64 sourceTime);
+	//! Use a database already in memory, e.g. because it could not be written on disk.
+	bool open(const QByteArray& data, qint64 sourceSize, qint64 sourceTime);
+	//! Release the database.
+	void close();
+
+	//! Write a database containing the given locations.
+	//! @param sourceSize the size of the file the locations come from.
+	//! @param sourceTime the modification time in ms since epoch of the file the locations come from.
+	//! @return false if the data could not be written.
+	static bool write(const QList<StelLocation>& locations, QIODevice* output, qint64 sourceSize, qint64 sourceTime);
+
+	//! Get the path of the database built from a location file in the cache directory.
+	static QString getDatabasePath(const QString& sourcePath);
+
+	//! Get the number of locations.
+	int size() const {return nbLocations;}
+	//! Decode the location with the given number.
+	StelLocation at(int i) const;
+	//! Get the ID of the location with the given number, see StelLocation::getID().
+	QString getID(int i) const;
+	//! Get the number of the location at the given rank in the alphabetical order of the IDs.
+	int getSorted(int rank) const;
+
+	//! Get the number of the location with the given ID, or -1 if there is none.
+	int find(const QString& id) const;
+	//! Get the numbers of the locations whose IDs start with the given prefix, in alphabetical order.
+	//! @param prefix the case insensitive prefix.
+	//! @param maxNbItem the maximum number of values returned, or -1 for no limit.
+	QVector<int> findStartingWith(const QString& prefix, int maxNbItem=-1) const;
+	//! Get the number of the location on Earth nearest to the given coordinates, or -1 if there is none.
+	//! @param distance if not NULL, receive the angular distance to the location in degree.
+	int findNearest(float latitude, float longitude, float* distance=NULL) const;
+
+	//! Number of rows and columns of the grid of the spatial index, whose cells are 1x1 degree.
+	static const int GridRows = 180;
+	static const int GridCols = 360;
+
+private:
+	bool setData(const uchar* bytes, qint64 size, qint64 sourceSize, qint64 sourceTime);
+	QString getString(quint32 offset) const;
+	const uchar* record(int i) const;
+	QString getKey(int i) const;
+	//! Get the first rank in the name index whose lower case ID is not less than the given key.
+	int lowerBound(const QString& key) const;
+	//! Check the locations of a cell of the grid, updating the nearest one.
+	void searchCell(int row, int col, const double pos[3], int& best, double& bestDot) const;
+	//! Get the cell of the grid containing the given coordinates.
+	static void getCell(float latitude, float longitude, int& row, int& col);
+	static void toVector(float latitude, float longitude, double pos[3]);
+
+	QFile file;
+	uchar* mapped;
+	//! Data of a database used from memory.
+	QByteArray memoryData;
+
+	const uchar* data;
+	qint64 dataSize;
+	int nbLocations;
+	const uchar* records;
+	const uchar* names;
+	const uchar* cellStarts;
+	const uchar* cells;
+	quint32 nbGridEntries;
+	const uchar* strings;
+	quint32 stringsSize;
+};
+
+#endif // _STELLOCATIONDATABASE_HPP_
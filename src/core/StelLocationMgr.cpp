@@ -21,26 +21,97 @@
 #include "StelLocationMgr.hpp"
 #include "StelUtils.hpp"
 
-#include <QStringListModel>
+#include <QBuffer>
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QDir>
+#include <QSaveFile>
+
+StelLocationListModel::StelLocationListModel(const StelLocationDatabase& base, QObject* parent)
+	: QAbstractListModel(parent)
+	, baseLocations(base)
+{
+}
+
+int StelLocationListModel::rowCount(const QModelIndex& parent) const
+{
+	return parent.isValid() ? 0 : baseLocations.size()+userIDs.size();
+}
+
+QVariant StelLocationListModel::data(const QModelIndex& index, int role) const
+{
+	if (!index.isValid() || (role!=Qt::DisplayRole && role!=Qt::EditRole))
+		return QVariant();
+	const int row = index.row();
+	if (row<baseLocations.size())
+		return baseLocations.getID(baseLocations.getSorted(row));
+	return userIDs.value(row-baseLocations.size());
+}
+
+void StelLocationListModel::setUserIDs(const QStringList& ids)
+{
+	beginResetModel();
+	userIDs = ids;
+	endResetModel();
+}
 
 StelLocationMgr::StelLocationMgr()
 {
 	// The line below allows to re-generate the location file, you still need to gunzip it manually afterward.
 	// generateBinaryLocationFile("data/base_locations.txt", false, "data/base_locations.bin");
 
-	locations = loadCitiesBin("data/base_locations.bin.gz");
-	locations.unite(loadCities("data/user_locations.txt", true));
+	openBaseLocations("data/base_locations.bin.gz");
+	locations = loadCities("data/user_locations.txt", true);
 
-	modelAllLocation = new QStringListModel(this);
-	modelAllLocation->setStringList(locations.keys());
+	modelAllLocation = new StelLocationListModel(baseLocations, this);
+	modelAllLocation->setUserIDs(locations.keys());
 	
 	// Init to Paris France because it's the center of the world.
 	lastResortLocation = locationForString("Paris, France");
 }
 
+void StelLocationMgr::openBaseLocations(const QString& fileName)
+{
+	const QString sourcePath = StelFileMgr::findFile(fileName);
+	if (sourcePath.isEmpty())
+	{
+		qWarning() << "WARNING: Failed to locate location data file: " << QDir::toNativeSeparators(fileName);
+		return;
+	}
+	const QFileInfo info(sourcePath);
+	const qint64 sourceSize = info.size();
+	const qint64 sourceTime = info.lastModified().toMSecsSinceEpoch();
+	const QString dbPath = StelLocationDatabase::getDatabasePath(sourcePath);
+	if (baseLocations.open(dbPath, sourceSize, sourceTime))
+		return;
+
+	// Build the database for the next times
+	QByteArray data;
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+	StelLocationDatabase::write(loadCitiesBin(fileName).values(), &buffer, sourceSize, sourceTime);
+	buffer.close();
+	QDir().mkpath(QFileInfo(dbPath).absolutePath());
+	QSaveFile output(dbPath);
+	if (output.open(QIODevice::WriteOnly) && output.write(data)==data.size() && output.commit()
+		&& baseLocations.open(dbPath, sourceSize, sourceTime))
+		return;
+	qWarning() << "Cannot write the location database" << QDir::toNativeSeparators(dbPath);
+	baseLocations.open(data, sourceSize, sourceTime);
+}
+
+QList<StelLocation> StelLocationMgr::getAll() const
+{
+	QList<StelLocation> all;
+	all.reserve(baseLocations.size()+locations.size());
+	for (int i=0;i<baseLocations.size();++i)
+		all.append(baseLocations.at(i));
+	all.append(locations.values());
+	return all;
+}
+
 void StelLocationMgr::generateBinaryLocationFile(const QString& fileName, bool isUserLocation, const QString& binFilePath) const
 {
 	const QMap<QString, StelLocation>& cities = loadCities(fileName, isUserLocation);
@@ -174,6 +245,11 @@ const StelLocation StelLocationMgr::locationForString(const QString& s) const
 	{
 		return iter.value();
 	}
+	const int baseIndex = baseLocations.find(s);
+	if (baseIndex>=0)
+	{
+		return baseLocations.at(baseIndex);
+	}
 	StelLocation ret;
 	// Maybe it is a coordinate set ? (e.g. GPS 25.107363,121.558807 )
 	QRegExp reg("(?:(.+)\\s+)?(.+),(.+)");
@@ -193,10 +269,57 @@ const StelLocation StelLocationMgr::locationForString(const QString& s) const
 	return ret;
 }
 
+const StelLocation StelLocationMgr::locationForPosition(float latitude, float longitude, float maxDistance) const
+{
+	float distance = 180.f;
+	StelLocation ret;
+	const int baseIndex = baseLocations.findNearest(latitude, longitude, &distance);
+	if (baseIndex>=0)
+		ret = baseLocations.at(baseIndex);
+
+	// The user locations are few, they are simply all checked
+	Vec3d pos;
+	StelUtils::spheToRect(longitude*M_PI/180., latitude*M_PI/180., pos);
+	for (QMap<QString, StelLocation>::ConstIterator iter=locations.constBegin();iter!=locations.constEnd();++iter)
+	{
+		const StelLocation& loc = iter.value();
+		if (loc.planetName!="Earth")
+			continue;
+		Vec3d p;
+		StelUtils::spheToRect(loc.longitude*M_PI/180., loc.latitude*M_PI/180., p);
+		const float d = pos.angle(p)*180./M_PI;
+		if (d<distance)
+		{
+			distance = d;
+			ret = loc;
+		}
+	}
+
+	if (distance>maxDistance)
+		ret.role = '!';
+	return ret;
+}
+
+QStringList StelLocationMgr::getIDsStartingWith(const QString& prefix, int maxNbItem) const
+{
+	QStringList ids;
+	foreach (int i, baseLocations.findStartingWith(prefix, maxNbItem))
+		ids << baseLocations.getID(i);
+	for (QMap<QString, StelLocation>::ConstIterator iter=locations.constBegin();iter!=locations.constEnd();++iter)
+	{
+		if (iter.key().startsWith(prefix, Qt::CaseInsensitive))
+			ids << iter.key();
+	}
+	ids.sort(Qt::CaseInsensitive);
+	if (maxNbItem>=0 && ids.size()>maxNbItem)
+		ids = ids.mid(0, maxNbItem);
+	return ids;
+}
+
 // Get whether a location can be permanently added to the list of user locations
 bool StelLocationMgr::canSaveUserLocation(const StelLocation& loc) const
 {
-	return loc.isValid() && locations.find(loc.getID())==locations.end();
+	return loc.isValid() && locations.find(loc.getID())==locations.end() && baseLocations.find(loc.getID())<0;
 }
 
 // Add permanently a location to the list of user locations
@@ -209,7 +332,7 @@ bool StelLocationMgr::saveUserLocation(const StelLocation& loc)
 	locations[loc.getID()]=loc;
 
 	// Append in the Qt model
-	modelAllLocation->setStringList(locations.keys());
+	modelAllLocation->setUserIDs(locations.keys());
 
 	// Append to the user location file
 	QString cityDataPath = StelFileMgr::findFile("data/user_locations.txt", StelFileMgr::Flags(StelFileMgr::Writable|StelFileMgr::File));
@@ -266,7 +389,7 @@ bool StelLocationMgr::deleteUserLocation(const QString& id)
 
 	locations.remove(id);
 	// Remove in the Qt model file
-	modelAllLocation->setStringList(locations.keys());
+	modelAllLocation->setUserIDs(locations.keys());
 
 	// Resave the whole remaining user locations file
 	QString cityDataPath = StelFileMgr::findFile("data/user_locations.txt", StelFileMgr::Writable);
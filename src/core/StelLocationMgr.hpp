@@ -20,15 +20,21 @@
 #define _STELLOCATIONMGR_HPP_
 
 #include "StelLocation.hpp"
+#include "StelLocationDatabase.hpp"
 #include <QString>
 #include <QObject>
 #include <QMetaType>
 #include <QMap>
+#include <QAbstractListModel>
+#include <QStringList>
 
-class QStringListModel;
+class StelLocationListModel;
 
 //! @class StelLocationMgr
 //! Manage the list of available location.
+//! The base locations are read from a StelLocationDatabase built in the cache directory the first
+//! time, which is memory mapped so that they do not need to be loaded at start up. The user
+//! locations are few and are kept in memory.
 class StelLocationMgr : public QObject
 {
 	Q_OBJECT
@@ -40,15 +46,24 @@ public:
 	~StelLocationMgr();
 
 	//! Return the model containing all the city
-	QStringListModel* getModelAll() {return modelAllLocation;}
+	QAbstractItemModel* getModelAll() {return modelAllLocation;}
 
 	//! Return the list of all loaded locations
-	QList<StelLocation> getAll() const {return locations.values();}
+	QList<StelLocation> getAll() const;
 
 	//! Return the StelLocation for a given string
 	//! Can match location name, or coordinates
 	const StelLocation locationForString(const QString& s) const;
 
+	//! Return the known location nearest to the given coordinates on Earth, e.g. for a position received from a GPS.
+	//! @param maxDistance the maximum angular distance of the location in degree.
+	//! @return the location, or an invalid one if there is none close enough.
+	const StelLocation locationForPosition(float latitude, float longitude, float maxDistance=1.f) const;
+
+	//! Return the IDs of the locations starting with the given case insensitive prefix, in alphabetical order.
+	//! @param maxNbItem the maximum number of IDs returned, or -1 for no limit.
+	QStringList getIDsStartingWith(const QString& prefix, int maxNbItem=-1) const;
+
 	//! Return a valid location when no valid one was found.
 	const StelLocation& getLastResortLocation() const {return lastResortLocation;}
 	
@@ -76,14 +91,39 @@ private:
 	//! Load cities from a file
 	QMap<QString, StelLocation> loadCities(const QString& fileName, bool isUserLocation) const;
 	QMap<QString, StelLocation> loadCitiesBin(const QString& fileName) const;
+	//! Open the database of the base locations, building it if it is missing or outdated.
+	void openBaseLocations(const QString& fileName);
 
 	//! Model containing all the city information
-	QStringListModel* modelAllLocation;
+	StelLocationListModel* modelAllLocation;
 
-	//! The list of all loaded locations
+	//! The base locations
+	StelLocationDatabase baseLocations;
+	//! The user locations
 	QMap<QString, StelLocation> locations;
 	
 	StelLocation lastResortLocation;
 };
 
+//! @class StelLocationListModel
+//! List model of the IDs of all the locations, reading the base locations from the database
+//! only when the rows are displayed.
+class StelLocationListModel : public QAbstractListModel
+{
+	Q_OBJECT
+
+public:
+	StelLocationListModel(const StelLocationDatabase& baseLocations, QObject* parent=NULL);
+
+	int rowCount(const QModelIndex& parent=QModelIndex()) const;
+	QVariant data(const QModelIndex& index, int role=Qt::DisplayRole) const;
+
+	//! Set the IDs of the user locations, which follow the base locations.
+	void setUserIDs(const QStringList& ids);
+
+private:
+	const StelLocationDatabase& baseLocations;
+	QStringList userIDs;
+};
+
 #endif // _STELLOCATIONMGR_HPP_
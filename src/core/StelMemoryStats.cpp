@@ -0,0 +1,237 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelMemoryStats.hpp"
+#include "StelApp.hpp"
+#include "StelModule.hpp"
+#include "StelModuleMgr.hpp"
+#include "StelStringPool.hpp"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QVector>
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+StelMemoryStats::StelMemoryStats()
+{
+	for (int i=0; i<MaxTags; ++i)
+	{
+		kinds[i] = Cpu;
+		bytes[i] = 0;
+	}
+	// Registered in the order of the CoreTag values
+	registerTag("Textures", Gpu);
+	registerTag("Evictable textures", Gpu);
+	registerTag("Star catalogs", Cpu);
+	Q_ASSERT(names.size()==NbCoreTags);
+}
+
+int StelMemoryStats::registerTag(const QString& name, Kind kind)
+{
+	QMutexLocker locker(&mutex);
+	const int index = names.indexOf(name);
+	if (index>=0)
+		return index;
+	if (names.size()>=MaxTags)
+	{
+		qWarning() << "WARNING: too many memory statistics tags, cannot register" << name;
+		return -1;
+	}
+	kinds[names.size()] = kind;
+	names << name;
+	return names.size()-1;
+}
+
+void StelMemoryStats::add(int tag, qint64 n)
+{
+	if (tag<0 || tag>=MaxTags)
+		return;
+	QMutexLocker locker(&mutex);
+	bytes[tag] += n;
+}
+
+void StelMemoryStats::addMapping(int tag, const void* address, qint64 size)
+{
+	if (tag<0 || tag>=MaxTags || address==NULL)
+		return;
+	QMutexLocker locker(&mutex);
+	Mapping mapping;
+	mapping.tag = tag;
+	mapping.size = size;
+	mappings.insert(address, mapping);
+	bytes[tag] += size;
+}
+
+void StelMemoryStats::removeMapping(const void* address)
+{
+	QMutexLocker locker(&mutex);
+	QMap<const void*, Mapping>::Iterator i = mappings.find(address);
+	if (i==mappings.end())
+		return;
+	bytes[i.value().tag] -= i.value().size;
+	mappings.erase(i);
+}
+
+static bool usageGreater(const StelMemoryStats::Usage& a, const StelMemoryStats::Usage& b)
+{
+	return a.bytes>b.bytes;
+}
+
+QList<StelMemoryStats::Usage> StelMemoryStats::getUsage() const
+{
+	QList<Usage> usage;
+	QMap<const void*, Mapping> sampledMappings;
+	{
+		QMutexLocker locker(&mutex);
+		for (int i=0; i<names.size(); ++i)
+		{
+			Usage u = {names.at(i), kinds[i], bytes[i], 0, 0};
+			usage << u;
+		}
+		sampledMappings = mappings;
+	}
+	// The mappings are sampled without locking, they are only removed from the main thread
+	for (QMap<const void*, Mapping>::ConstIterator i=sampledMappings.constBegin(); i!=sampledMappings.constEnd(); ++i)
+	{
+		Usage& u = usage[i.value().tag];
+		u.mapped += i.value().size;
+		const qint64 resident = getResidentBytes(i.key(), i.value().size);
+		u.resident = (resident<0 || u.resident<0) ? -1 : u.resident+resident;
+	}
+
+	// The names interned by all the catalogs
+	Usage pool = {"String pool", Cpu, StelStringPool::getNbBytes(), 0, 0};
+	usage << pool;
+	foreach (StelModule* module, StelApp::getInstance().getModuleMgr().getAllModules())
+	{
+		const qint64 moduleBytes = module->getMemoryUsed();
+		if (moduleBytes>0)
+		{
+			Usage u = {module->objectName(), Cpu, moduleBytes, 0, 0};
+			usage << u;
+		}
+	}
+	std::stable_sort(usage.begin(), usage.end(), usageGreater);
+	return usage;
+}
+
+QVariantMap StelMemoryStats::getReport() const
+{
+	QVariantMap report;
+	qint64 totals[2] = {0, 0};
+	foreach (const Usage& u, getUsage())
+	{
+		QVariantMap entry;
+		entry["kind"] = u.kind==Gpu ? "gpu" : "cpu";
+		entry["bytes"] = u.bytes;
+		entry["mapped"] = u.mapped;
+		entry["resident"] = u.resident;
+		report[u.name] = entry;
+		totals[u.kind] += u.bytes;
+	}
+	report["cpu"] = totals[Cpu];
+	report["gpu"] = totals[Gpu];
+	return report;
+}
+
+QStringList StelMemoryStats::getOverlayLines()
+{
+	// Sampling the resident pages of the large mappings is not free, the lines are kept for a second
+	if (overlayTimer.isValid() && overlayTimer.elapsed()<1000)
+		return overlayLines;
+	overlayTimer.start();
+	overlayLines.clear();
+	foreach (const Usage& u, getUsage())
+	{
+		if (u.bytes==0)
+			continue;
+		QString line = QString("%1 %2 MB %3").arg(u.name.left(20), -20).arg(u.bytes/(1024.*1024.), 6, 'f', 1).arg(u.kind==Gpu ? "GPU" : "CPU");
+		if (u.mapped>0)
+		{
+			line += QString(" (%1 MB mapped").arg(u.mapped/(1024.*1024.), 0, 'f', 1);
+			if (u.resident>=0)
+				line += QString(", %1 MB resident").arg(u.resident/(1024.*1024.), 0, 'f', 1);
+			line += ")";
+		}
+		overlayLines << line;
+	}
+	return overlayLines;
+}
+
+qint64 StelMemoryStats::getResidentBytes(const void* address, qint64 size)
+{
+	if (address==NULL || size<=0)
+		return 0;
+#ifdef Q_OS_WIN
+	// The PSAPI function is exported by kernel32 since Windows 7, so it is looked up at runtime
+	struct WorkingSetExInformation
+	{
+		PVOID VirtualAddress;
+		ULONG_PTR VirtualAttributes;
+	};
+	typedef BOOL (WINAPI *QueryWorkingSetExFunc)(HANDLE, PVOID, DWORD);
+	static QueryWorkingSetExFunc queryWorkingSetEx = (QueryWorkingSetExFunc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "K32QueryWorkingSetEx");
+	if (!queryWorkingSetEx)
+		return -1;
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const quintptr pageSize = info.dwPageSize;
+	const quintptr start = (quintptr)address & ~(pageSize-1);
+	const quintptr end = (quintptr)address + size;
+	QVector<WorkingSetExInformation> pages((end-start+pageSize-1)/pageSize);
+	for (int i=0; i<pages.size(); ++i)
+		pages[i].VirtualAddress = (PVOID)(start+i*pageSize);
+	if (!queryWorkingSetEx(GetCurrentProcess(), pages.data(), pages.size()*sizeof(WorkingSetExInformation)))
+		return -1;
+	qint64 resident = 0;
+	for (int i=0; i<pages.size(); ++i)
+	{
+		// The first bit of the attributes is set for the pages in the working set
+		if (pages.at(i).VirtualAttributes & 1)
+			resident += pageSize;
+	}
+	return qMin(resident, size);
+#else
+	static const quintptr pageSize = sysconf(_SC_PAGESIZE);
+	const quintptr start = (quintptr)address & ~(pageSize-1);
+	const quintptr end = (quintptr)address + size;
+	QVector<unsigned char> pages((end-start+pageSize-1)/pageSize);
+#ifdef Q_OS_MAC
+	if (mincore((void*)start, end-start, (char*)pages.data())!=0)
+#else
+	if (mincore((void*)start, end-start, pages.data())!=0)
+#endif
+		return -1;
+	qint64 resident = 0;
+	for (int i=0; i<pages.size(); ++i)
+	{
+		if (pages.at(i) & 1)
+			resident += pageSize;
+	}
+	return qMin(resident, size);
+#endif
+}
@@ -0,0 +1,115 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELMEMORYSTATS_HPP_
+#define _STELMEMORYSTATS_HPP_
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+//! @class StelMemoryStats
+//! Account for the memory held by each subsystem, to find which one uses too much.
+//! The large buffers are counted under a tag when they are allocated and released, e.g. the textures
+//! in GPU memory or the stars of the catalogs. For the files mapped in memory, the mapped size is
+//! counted and the pages actually resident in RAM are sampled when the report is built.
+//! The smaller structures, like the names tables, are estimated by the modules themselves, see
+//! StelModule::getMemoryUsed(), and added to the report with the StelStringPool.
+class StelMemoryStats
+{
+public:
+	//! Where the memory of a tag is allocated.
+	enum Kind
+	{
+		Cpu,
+		Gpu
+	};
+
+	//! The tags of the core classes.
+	enum CoreTag
+	{
+		Textures,		//!< GPU memory of the StelTexture which are not evictable
+		EvictableTextures,	//!< GPU memory of the evictable StelTexture, mostly the tiles of the sky layers
+		StarCatalogs,		//!< Stars of the ZoneArray catalogs, read or mapped
+		NbCoreTags
+	};
+
+	//! The maximum number of tags which can be registered.
+	static const int MaxTags = 64;
+
+	//! The memory used by a tag or a module.
+	struct Usage
+	{
+		QString name;
+		Kind kind;
+		//! The bytes allocated, including the mapped ones.
+		qint64 bytes;
+		//! The bytes of the files mapped in memory, and of their pages resident in RAM.
+		//! The resident bytes are -1 if they can't be sampled on this system.
+		qint64 mapped;
+		qint64 resident;
+	};
+
+	StelMemoryStats();
+
+	//! Register a tag, or get the one already registered with this name. Thread safe.
+	//! @return the identifier to pass to add(), or -1 if too many tags are registered.
+	int registerTag(const QString& name, Kind kind=Cpu);
+	//! Add bytes allocated under a tag, or remove them if negative. Thread safe, an invalid tag is ignored.
+	void add(int tag, qint64 bytes);
+	//! Count a file mapped in memory under a tag. Thread safe.
+	void addMapping(int tag, const void* address, qint64 size);
+	//! Remove a mapping added by addMapping(). Thread safe.
+	void removeMapping(const void* address);
+
+	//! Get the memory used by the tags and the modules, sampling the resident pages of the mappings.
+	//! The entries are sorted by decreasing size. Must be called from the main thread.
+	QList<Usage> getUsage() const;
+	//! Get the memory report for the scripts: the "cpu" and "gpu" total bytes, and for each tag and
+	//! module a map with the "kind", "bytes", "mapped" and "resident" values.
+	QVariantMap getReport() const;
+	//! Get the lines of the report shown in the profiler overlay. The usage is sampled once per second.
+	QStringList getOverlayLines();
+
+	//! Get the bytes of a memory range which are resident in RAM.
+	//! @return -1 if it can't be sampled on this system.
+	static qint64 getResidentBytes(const void* address, qint64 size);
+
+private:
+	struct Mapping
+	{
+		int tag;
+		qint64 size;
+	};
+
+	mutable QMutex mutex;
+	QStringList names;
+	Kind kinds[MaxTags];
+	qint64 bytes[MaxTags];
+	QMap<const void*, Mapping> mappings;
+
+	QElapsedTimer overlayTimer;
+	QStringList overlayLines;
+};
+
+#endif // _STELMEMORYSTATS_HPP_
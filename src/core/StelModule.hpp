@@ -59,10 +59,23 @@ public:
 
 	virtual ~StelModule() {;}
 
+	//! Load the data needed by init() which depend neither on the other modules nor on the
+	//! OpenGL context, typically by reading and parsing catalog files.
+	//! At start up it is called on a worker thread, possibly at the same time as the preload()
+	//! of other modules, so it must not use the settings, the translations or the other modules.
+	//! It is always called before init(), which waits for it to finish.
+	virtual void preload() {;}
+
 	//! Initialize itself.
 	//! If the initialization takes significant time, the progress should be displayed on the loading bar.
 	virtual void init() = 0;
 
+	//! Initialize the part of the module which is only needed once it is shown or used, like
+	//! the loading of a catalog, its textures or its network updates. It is always called after init().
+	//! When the deferred initialization is enabled, it is called once the first frame is presented,
+	//! one module per frame, or earlier by StelApp::finishDeferredInit() when the module is first used.
+	virtual void deferredInit() {;}
+
 	//! Called before the module will be delete, and before the openGL context is suppressed.
 	//! Deinitialize all openGL texture in this method.
 	virtual void deinit() {;}
@@ -75,6 +88,38 @@ public:
 	//! @param deltaTime the time increment in second since last call.
 	virtual void update(double deltaTime) = 0;
 
+	//! The shared data which the update() methods can read or write, see getUpdateDependencies().
+	enum UpdateResource
+	{
+		UpdateTime     = 0x01, //!< The date and the time rate of the StelCore
+		UpdateObserver = 0x02, //!< The location of the observer
+		UpdateView     = 0x04, //!< The view direction, the field of view and the projection
+		UpdatePlanets  = 0x08  //!< The positions and the state of the SolarSystem bodies
+	};
+
+	//! The data dependencies of the update() method of a module.
+	struct UpdateDependencies
+	{
+		UpdateDependencies(bool aparallel=false, int areads=0, int awrites=0) : parallel(aparallel), reads(areads), writes(awrites) {}
+		//! Whether update() can run on a worker thread at the same time as the updates of other modules.
+		bool parallel;
+		//! The UpdateResource flags of the data read and written by update().
+		int reads;
+		int writes;
+	};
+
+	//! Get the data dependencies of update(), used to run the updates of the independent modules in parallel.
+	//! The modules following each other in the update call order whose dependencies don't conflict are
+	//! updated at the same time on the thread pool. A parallel update may only modify the module itself and
+	//! the declared data, and must not use OpenGL, the GUI or emit signals connected to the main thread.
+	//! The static data written by the objects of several modules, like StelFader::getTransitionCounter(),
+	//! must be atomic. By default the update is serial: it runs on the main thread, in the call order.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies();}
+
+	//! Estimate the memory in bytes held by the module, for the report of StelMemoryStats.
+	//! The buffers already counted under a StelMemoryStats tag, like the textures, are not included.
+	virtual qint64 getMemoryUsed() const {return 0;}
+
 	//! Get the version of the module, default is stellarium main version
 	virtual QString getModuleVersion() const;
 
@@ -70,6 +70,12 @@ StelMovementMgr::StelMovementMgr(StelCore* acore)
 	, flagAutoZoom(0)
 	, flagAutoZoomOutResetsDirection(0)
 	, dragTriggerDistance(4.f)
+	, headPoseProvider(NULL)
+	, latchedHeadPose(0.)
+	, lastViewDirectionJ2000(0.)
+	, lastFov(0.)
+	, viewAngularVelocity(0.)
+	, fovLogSpeed(0.)
 {
 	setObjectName("StelMovementMgr");
 	isDragging = false;
@@ -592,6 +598,56 @@ void StelMovementMgr::updateMotion(double deltaTime)
 	}
 	panView(deltaAz, deltaAlt);
 	updateAutoZoom(deltaTime);
+
+	// Measure the speed of the view, smoothed over a few frames
+	Vec3d dir = viewDirectionJ2000;
+	dir.normalize();
+	if (deltaTime>0. && lastFov>0.)
+	{
+		const double a = qMin(1., deltaTime/0.1);
+		Vec3d axis = lastViewDirectionJ2000^dir;
+		const double sinAngle = axis.length();
+		if (sinAngle>1e-12)
+			axis *= std::atan2(sinAngle, lastViewDirectionJ2000*dir)/(sinAngle*deltaTime);
+		viewAngularVelocity = viewAngularVelocity*(1.-a) + axis*a;
+		fovLogSpeed = fovLogSpeed*(1.-a) + std::log(currentFov/lastFov)/deltaTime*a;
+	}
+	lastViewDirectionJ2000 = dir;
+	lastFov = currentFov;
+}
+
+void StelMovementMgr::predictView(double deltaTime, Vec3d& viewDirection, double& fov) const
+{
+	viewDirection = viewDirectionJ2000;
+	viewDirection.normalize();
+	if (flagAutoMove && move.speed>0.f)
+	{
+		// Go along the great circle to the aim, at the mean speed of the remaining movement.
+		const double remaining = (1.-move.coef)/(move.speed*1000.);
+		Vec3d aim = move.aim;
+		aim.normalize();
+		const double f = remaining>deltaTime ? deltaTime/remaining : 1.;
+		viewDirection = viewDirection*(1.-f) + aim*f;
+		viewDirection.normalize();
+	}
+	else
+	{
+		const double speed = viewAngularVelocity.length();
+		if (speed*deltaTime>1e-9)
+			viewDirection.transfo4d(Mat4d::rotation(viewAngularVelocity/speed, speed*deltaTime));
+	}
+
+	if (flagAutoZoom && zoomMove.speed>0.f)
+	{
+		const double remaining = (1.-zoomMove.coef)/(zoomMove.speed*1000.);
+		const double f = remaining>deltaTime ? deltaTime/remaining : 1.;
+		fov = currentFov + (zoomMove.aim-currentFov)*f;
+	}
+	else
+	{
+		fov = currentFov*std::exp(fovLogSpeed*deltaTime);
+	}
+	fov = qBound(minFov, fov, maxFov);
 }
 
 
@@ -847,11 +903,55 @@ Vec3d StelMovementMgr::mountFrameToJ2000(const Vec3d& v) const
 
 void StelMovementMgr::setViewDirectionJ2000(const Vec3d& v)
 {
-	core->lookAtJ2000(v, getViewUpVectorJ2000());
+	lookAtJ2000(v);
 	viewDirectionJ2000 = v;
 	viewDirectionMountFrame = j2000ToMountFrame(v);
 }
 
+void StelMovementMgr::lookAtJ2000(const Vec3d& v)
+{
+	const Vec3d up = getViewUpVectorJ2000();
+	if (headPoseProvider==NULL)
+	{
+		core->lookAtJ2000(v, up);
+		return;
+	}
+
+	// Rotate the view frame by the head yaw, pitch and roll
+	Vec3d f(v);
+	f.normalize();
+	Vec3d s(f^up);
+	s.normalize();
+	Vec3d u(s^f);
+	const double yaw = latchedHeadPose[0];
+	const double pitch = latchedHeadPose[1];
+	const double roll = latchedHeadPose[2];
+	const Vec3d f1 = f*std::cos(yaw) + s*std::sin(yaw);
+	const Vec3d s1 = s*std::cos(yaw) - f*std::sin(yaw);
+	const Vec3d f2 = f1*std::cos(pitch) + u*std::sin(pitch);
+	const Vec3d u2 = u*std::cos(pitch) - f1*std::sin(pitch);
+	core->lookAtJ2000(f2, u2*std::cos(roll) + s1*std::sin(roll));
+}
+
+void StelMovementMgr::setHeadPoseProvider(StelHeadPoseProvider* provider)
+{
+	headPoseProvider = provider;
+	latchedHeadPose.set(0., 0., 0.);
+	lookAtJ2000(viewDirectionJ2000);
+}
+
+bool StelMovementMgr::latchHeadPose(double displayTime)
+{
+	if (headPoseProvider==NULL)
+		return false;
+	Vec3d pose;
+	if (!headPoseProvider->predictHeadPose(displayTime, pose))
+		return false;
+	latchedHeadPose = pose;
+	lookAtJ2000(viewDirectionJ2000);
+	return true;
+}
+
 void StelMovementMgr::panView(double deltaAz, double deltaAlt)
 {
 	double azVision, altVision;
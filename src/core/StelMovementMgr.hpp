@@ -24,6 +24,19 @@
 #include "StelProjector.hpp"
 #include "StelObjectType.hpp"
 
+//! @class StelHeadPoseProvider
+//! Interface used by head tracking devices to feed their orientation to the StelMovementMgr.
+class StelHeadPoseProvider
+{
+public:
+	virtual ~StelHeadPoseProvider() {;}
+	//! Predict the orientation of the head at the time the frame will be displayed.
+	//! @param displayTime the time in seconds, as given by StelApp::getTotalRunTime(), at which the frame will be displayed.
+	//! @param yawPitchRoll the head angles in radian, relative to the view direction of the StelMovementMgr.
+	//! @return false if no pose is available.
+	virtual bool predictHeadPose(double displayTime, Vec3d& yawPitchRoll) = 0;
+};
+
 //! @class StelMovementMgr
 //! Manages the head movements and zoom operations.
 class StelMovementMgr : public StelModule
@@ -76,6 +89,26 @@ public:
 	//! Increment/decrement smoothly the vision field and position.
 	void updateMotion(double deltaTime);
 
+	//! Set the head tracking device providing the head pose. The caller keeps the ownership of the provider.
+	//! Use NULL to disable head tracking.
+	void setHeadPoseProvider(StelHeadPoseProvider* provider);
+	//! Get whether a head tracking device is used.
+	bool hasHeadPoseProvider() const {return headPoseProvider!=NULL;}
+	//! Query the head tracking device for the pose at the given display time and update the view matrices of the core.
+	//! This is meant to be called as late as possible before drawing, so that the frame uses the freshest orientation.
+	//! @return true if a new pose was latched.
+	bool latchHeadPose(double displayTime);
+	//! Get the last latched head pose (yaw, pitch, roll in radian).
+	const Vec3d& getLatchedHeadPose() const {return latchedHeadPose;}
+
+	//! Predict the view after some time, to prepare the data which will become visible.
+	//! The automatic movements and zooms are followed to their aim, and the other motions
+	//! are extrapolated from the speed measured in the last frames.
+	//! @param deltaTime the time in seconds from now.
+	//! @param viewDirection the predicted viewing direction in J2000 frame.
+	//! @param fov the predicted field of view in degrees.
+	void predictView(double deltaTime, Vec3d& viewDirection, double& fov) const;
+
 	// These are hopefully temporary.
 	bool getHasDragged() const {return hasDragged;}
 
@@ -159,6 +192,17 @@ public slots:
 	void zoomTo(double aimFov, float moveDuration = 1.);
 	//! Get the current Field Of View in degrees
 	double getCurrentFov() const {return currentFov;}
+	//! Set the Field Of View in degrees at once, within the minimum and maximum, e.g. to restore a recorded view.
+	void setFov(double f)
+	{
+		currentFov = f;
+		if (f>maxFov)
+			currentFov = maxFov;
+		if (f<minFov)
+			currentFov = minFov;
+
+		changeConstellationArtIntensity();
+	}
 
 	//! Return the initial default FOV in degree.
 	double getInitFov() const {return initFov;}
@@ -225,16 +269,6 @@ private:
 	double maxFov;     // Maximum FOV in degree
 	double initConstellationIntensity;   // The initial constellation art intensity (level at startup)
 
-	void setFov(double f)
-	{
-		currentFov = f;
-		if (f>maxFov)
-			currentFov = maxFov;
-		if (f<minFov)
-			currentFov = minFov;
-
-		changeConstellationArtIntensity();
-	}
 	void changeFov(double deltaFov);
 	void changeConstellationArtIntensity();
 
@@ -335,6 +369,17 @@ private:
 	Vec3d upVectorMountFrame;
 
 	float dragTriggerDistance;
+
+	//! Set the core view matrices for the given view direction, taking the latched head pose into account.
+	void lookAtJ2000(const Vec3d& v);
+	StelHeadPoseProvider* headPoseProvider;
+	Vec3d latchedHeadPose;
+
+	// The motion measured in the last frames, used by predictView()
+	Vec3d lastViewDirectionJ2000;
+	double lastFov;
+	Vec3d viewAngularVelocity;	// Rotation axis scaled by the speed in radian per second
+	double fovLogSpeed;		// Derivative of the log of the fov per second
 };
 
 #endif // _STELMOVEMENTMGR_HPP_
@@ -0,0 +1,83 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelMultiViewport.hpp"
+
+#include <QDebug>
+#include <QSettings>
+#include <QStringList>
+
+StelMultiViewport::StelMultiViewport(QSettings* conf, const StelCore* core)
+{
+	const int nbViewports = conf->value("viewports/nb_viewports", 0).toInt();
+	for (int v=1; v<=nbViewports; ++v)
+	{
+		const QString prefix = QString("viewports/viewport_%1_").arg(v);
+		// The lists may be read as a single string when they are not in the configuration file
+		const QStringList rect = conf->value(prefix+"rect", "").toStringList().join(",").split(",");
+		const int w = rect.value(2).toInt();
+		const int h = rect.value(3).toInt();
+		if (rect.size()!=4 || w<=0 || h<=0)
+		{
+			qWarning() << "WARNING: invalid rectangle for the viewport" << v;
+			continue;
+		}
+		View view;
+		view.rect = QRect(rect.value(0).toInt(), rect.value(1).toInt(), w, h);
+		const QString projection = conf->value(prefix+"projection", "").toString();
+		view.projectionType = projection.isEmpty() ? -1 : (int)core->projectionTypeKeyToProjectionType(projection);
+		view.fov = qMax(conf->value(prefix+"fov", 0.).toFloat(), 0.f);
+		// The view looks toward -z: it is first turned around its up axis, then raised
+		const double azimuth = conf->value(prefix+"azimuth", 0.).toDouble()*M_PI/180.;
+		const double altitude = conf->value(prefix+"altitude", 0.).toDouble()*M_PI/180.;
+		view.rotation = Mat4d::xrotation(-altitude)*Mat4d::yrotation(azimuth);
+		view.flipHorz = conf->value(prefix+"flip_horz", false).toBool();
+		view.flipVert = conf->value(prefix+"flip_vert", false).toBool();
+		views << view;
+	}
+	if (nbViewports>0 && views.isEmpty())
+		qWarning() << "WARNING: no valid viewport, only the main view is drawn";
+}
+
+StelCore::ProjectionType StelMultiViewport::getViewProjectionType(int i, StelCore::ProjectionType mainType) const
+{
+	const int type = views.at(i).projectionType;
+	return type<0 ? mainType : (StelCore::ProjectionType)type;
+}
+
+QRect StelMultiViewport::getViewRect(int i, int windowHeight) const
+{
+	const QRect& rect = views.at(i).rect;
+	return QRect(rect.x(), windowHeight-rect.y()-rect.height(), rect.width(), rect.height());
+}
+
+StelProjector::StelProjectorParams StelMultiViewport::getViewParams(int i, const StelProjector::StelProjectorParams& mainParams, int windowHeight) const
+{
+	const View& view = views.at(i);
+	const QRect rect = getViewRect(i, windowHeight);
+	StelProjector::StelProjectorParams params = mainParams;
+	params.viewportXywh.set(rect.x(), rect.y(), rect.width(), rect.height());
+	params.viewportCenter.set(rect.x()+0.5f*rect.width(), rect.y()+0.5f*rect.height());
+	params.viewportFovDiameter = qMin(rect.width(), rect.height());
+	if (view.fov>0.f)
+		params.fov = view.fov;
+	params.flipHorz = view.flipHorz;
+	params.flipVert = view.flipVert;
+	return params;
+}
@@ -0,0 +1,80 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELMULTIVIEWPORT_HPP_
+#define _STELMULTIVIEWPORT_HPP_
+
+#include "StelCore.hpp"
+#include "VecMath.hpp"
+
+#include <QRect>
+#include <QVector>
+
+class QSettings;
+
+//! @class StelMultiViewport
+//! Draw several views of the same frame in regions of one window, to drive the wall panels, a dome and a
+//! control monitor of an installation from a single instance.
+//! The modules are updated once per frame, so the time, the positions of the planets and the fading of the
+//! labels are computed once for all the views; only the drawing is done for each view, with its own projector.
+//! Each view is turned from the main view direction and can have its own projection and field of view.
+//! The views are read from the viewports section of the settings: nb_viewports, and for each view N from 1,
+//! viewport_N_rect (x,y,width,height in the window, from its top left corner), and the optional
+//! viewport_N_projection (a projection key, the projection of the main view if empty), viewport_N_fov (in
+//! degrees, the field of view of the main view if 0), viewport_N_azimuth and viewport_N_altitude (the angles
+//! in degrees by which the view is turned right and up from the main view), viewport_N_flip_horz and
+//! viewport_N_flip_vert.
+class StelMultiViewport
+{
+public:
+	StelMultiViewport(QSettings* conf, const StelCore* core);
+
+	//! Get whether at least one view is defined.
+	bool isValid() const {return !views.isEmpty();}
+	int getNbViews() const {return views.size();}
+
+	//! Get the rotation of a view from the main view frame.
+	const Mat4d& getViewRotation(int i) const {return views.at(i).rotation;}
+	//! Get the projection type of a view.
+	//! @param mainType the projection type of the main view.
+	StelCore::ProjectionType getViewProjectionType(int i, StelCore::ProjectionType mainType) const;
+	//! Get the projection parameters of a view in a window of the given height.
+	//! @param mainParams the parameters of the main view, from which the view keeps the other settings.
+	StelProjector::StelProjectorParams getViewParams(int i, const StelProjector::StelProjectorParams& mainParams, int windowHeight) const;
+	//! Get the rectangle of a view in the window from its bottom left corner, like the GL viewport.
+	QRect getViewRect(int i, int windowHeight) const;
+
+private:
+	struct View
+	{
+		//! Rectangle of the view in the window, from its top left corner.
+		QRect rect;
+		//! The projection type, or -1 for the one of the main view.
+		int projectionType;
+		//! The field of view in degrees, or 0 for the one of the main view.
+		float fov;
+		Mat4d rotation;
+		bool flipHorz;
+		bool flipVert;
+	};
+
+	QVector<View> views;
+};
+
+#endif // _STELMULTIVIEWPORT_HPP_
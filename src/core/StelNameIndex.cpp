@@ -0,0 +1,190 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "StelNameIndex.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+	//! Compare the suffixes of the names, which end with the null character terminating each name.
+	struct SuffixLess
+	{
+		SuffixLess(const ushort* atext) : text(atext) {;}
+		bool operator()(quint32 a, quint32 b) const
+		{
+			const ushort* pa = text+a;
+			const ushort* pb = text+b;
+			while (*pa && *pa==*pb)
+			{
+				++pa;
+				++pb;
+			}
+			return *pa<*pb;
+		}
+		const ushort* text;
+	};
+
+	//! Compare a suffix with a string, only on the length of the string.
+	struct SuffixPrefixLess
+	{
+		SuffixPrefixLess(const ushort* atext, const QString& astr) : text(atext), str(astr.utf16()), size(astr.size()) {;}
+		//! Whether the suffix is before all the suffixes starting with the string.
+		bool operator()(quint32 suffix, int) const
+		{
+			const ushort* p = text+suffix;
+			for (int i=0;i<size;++i)
+			{
+				if (p[i]!=str[i])
+					return p[i]<str[i];
+			}
+			return false;
+		}
+		bool startsWith(quint32 suffix) const
+		{
+			const ushort* p = text+suffix;
+			for (int i=0;i<size;++i)
+			{
+				if (p[i]!=str[i])
+					return false;
+			}
+			return true;
+		}
+		const ushort* text;
+		const ushort* str;
+		int size;
+	};
+}
+
+StelNameIndex::StelNameIndex() : sorted(true), suffixesBuilt(false)
+{
+}
+
+void StelNameIndex::clear()
+{
+	entries.clear();
+	text.clear();
+	entryStarts.clear();
+	suffixes.clear();
+	sorted = true;
+	suffixesBuilt = false;
+}
+
+qint64 StelNameIndex::getMemoryUsed() const
+{
+	// Each name has its QString header and UTF-16 data
+	qint64 total = entries.capacity()*(qint64)sizeof(Entry);
+	foreach (const Entry& e, entries)
+		total += 24 + e.name.capacity()*sizeof(ushort);
+	return total + text.capacity()*(qint64)sizeof(ushort) + (entryStarts.capacity()+suffixes.capacity())*(qint64)sizeof(quint32);
+}
+
+void StelNameIndex::insert(const QString& name, int value)
+{
+	if (name.isEmpty())
+		return;
+	Entry e;
+	e.name = name.toUpper();
+	e.value = value;
+	entries.append(e);
+	sorted = false;
+	suffixesBuilt = false;
+}
+
+void StelNameIndex::sort() const
+{
+	if (sorted)
+		return;
+	std::sort(entries.begin(), entries.end());
+	sorted = true;
+}
+
+void StelNameIndex::buildSuffixes() const
+{
+	sort();
+	if (suffixesBuilt)
+		return;
+	text.clear();
+	entryStarts.clear();
+	suffixes.clear();
+	entryStarts.reserve(entries.size());
+	foreach (const Entry& e, entries)
+	{
+		entryStarts.append(text.size());
+		for (int i=0;i<e.name.size();++i)
+		{
+			suffixes.append(text.size());
+			text.append(e.name.at(i).unicode());
+		}
+		text.append(0);
+	}
+	std::sort(suffixes.begin(), suffixes.end(), SuffixLess(text.constData()));
+	suffixesBuilt = true;
+}
+
+void StelNameIndex::prepare(bool containing) const
+{
+	sort();
+	if (containing)
+		buildSuffixes();
+}
+
+QVector<int> StelNameIndex::findStartingWith(const QString& prefix, int maxNbItem) const
+{
+	QVector<int> result;
+	sort();
+	Entry e;
+	e.name = prefix.toUpper();
+	e.value = INT_MIN;
+	for (QVector<Entry>::ConstIterator iter = std::lower_bound(entries.constBegin(), entries.constEnd(), e); iter!=entries.constEnd(); ++iter)
+	{
+		if (result.size()==maxNbItem || !iter->name.startsWith(e.name))
+			break;
+		result.append(iter->value);
+	}
+	return result;
+}
+
+QVector<int> StelNameIndex::findContaining(const QString& str, int maxNbItem) const
+{
+	QVector<int> result;
+	if (str.isEmpty())
+		return findStartingWith(str, maxNbItem);
+	buildSuffixes();
+
+	// The suffixes starting with the string are contiguous in the suffix array
+	const QString strUpper = str.toUpper();
+	const SuffixPrefixLess less(text.constData(), strUpper);
+	QVector<int> matchingEntries;
+	for (QVector<quint32>::ConstIterator iter = std::lower_bound(suffixes.constBegin(), suffixes.constEnd(), 0, less); iter!=suffixes.constEnd() && less.startsWith(*iter); ++iter)
+		matchingEntries.append(std::upper_bound(entryStarts.constBegin(), entryStarts.constEnd(), *iter)-entryStarts.constBegin()-1);
+
+	// A name containing the string several times appears once, in the alphabetical order
+	std::sort(matchingEntries.begin(), matchingEntries.end());
+	matchingEntries.erase(std::unique(matchingEntries.begin(), matchingEntries.end()), matchingEntries.end());
+	foreach (int i, matchingEntries)
+	{
+		if (result.size()==maxNbItem)
+			break;
+		result.append(entries.at(i).value);
+	}
+	return result;
+}
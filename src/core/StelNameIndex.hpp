@@ -0,0 +1,102 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#ifndef _STELNAMEINDEX_HPP_
+#define _STELNAMEINDEX_HPP_
+
+#include <QString>
+#include <QVector>
+
+//! @class StelNameIndex
+//! Index of object names used to auto-complete the names typed in the search dialog.
+//! Each name is stored in upper case together with an integer chosen by the module owning
+//! the objects, typically the index of the object in its list.
+//! The names are kept sorted so that the names starting with a prefix are found by a binary
+//! search. For the names containing a string, a suffix array of all the names is built the
+//! first time it is needed, so that the search is a binary search as well.
+//! The index is meant to be rebuilt when the names change, e.g. in updateI18n().
+class StelNameIndex
+{
+public:
+	StelNameIndex();
+
+	//! Remove all the names.
+	void clear();
+
+	//! Add a name to the index. The same name can be added several times with different values.
+	//! @param name the name, which is converted to upper case.
+	//! @param value the value returned by the queries for this name.
+	void insert(const QString& name, int value);
+
+	//! Get the number of names in the index.
+	int size() const {return entries.size();}
+
+	//! Estimate the memory in bytes used by the names and their suffix array.
+	qint64 getMemoryUsed() const;
+
+	//! Get the values of the names starting with the given prefix, in the alphabetical order of the names.
+	//! @param prefix the case insensitive prefix.
+	//! @param maxNbItem the maximum number of values returned, or -1 for no limit.
+	QVector<int> findStartingWith(const QString& prefix, int maxNbItem=-1) const;
+
+	//! Get the values of the names containing the given string, in the alphabetical order of the names.
+	//! @param str the case insensitive string.
+	//! @param maxNbItem the maximum number of values returned, or -1 for no limit.
+	QVector<int> findContaining(const QString& str, int maxNbItem=-1) const;
+
+	//! Get the values of the matching names, using findStartingWith() if useStartOfWords is true,
+	//! else findContaining(), like the StelObjectModule::listMatchingObjects() methods.
+	QVector<int> find(const QString& str, int maxNbItem, bool useStartOfWords) const
+	{
+		return useStartOfWords ? findStartingWith(str, maxNbItem) : findContaining(str, maxNbItem);
+	}
+
+	//! Sort the names, and build the suffix array of findContaining() if containing is true, which are
+	//! otherwise done by the first query. The queries can then be run by several threads at once.
+	void prepare(bool containing) const;
+	//! Get whether prepare() has nothing left to do.
+	bool isPrepared(bool containing) const {return sorted && (suffixesBuilt || !containing);}
+
+private:
+	struct Entry
+	{
+		QString name;
+		int value;
+		bool operator<(const Entry& e) const {return name<e.name || (name==e.name && value<e.value);}
+	};
+
+	//! Sort the entries, if new names were inserted since the last query.
+	void sort() const;
+	//! Build the suffix array, if it is not up to date.
+	void buildSuffixes() const;
+
+	mutable QVector<Entry> entries;
+	mutable bool sorted;
+
+	//! All the names, each one terminated by a null character.
+	mutable QVector<ushort> text;
+	//! Position in text of the first character of each entry.
+	mutable QVector<quint32> entryStarts;
+	//! Positions in text of all the suffixes of the names, in alphabetical order.
+	mutable QVector<quint32> suffixes;
+	mutable bool suffixesBuilt;
+};
+
+#endif // _STELNAMEINDEX_HPP_
@@ -32,8 +32,11 @@
 #include <QString>
 #include <QDebug>
 #include <QStringList>
+#include <QSettings>
+#include <QMetaProperty>
+#include <QtConcurrent>
 
-StelObjectMgr::StelObjectMgr() : searchRadiusPixel(25.f), distanceWeight(1.f)
+StelObjectMgr::StelObjectMgr() : searchRadiusPixel(25.f), distanceWeight(1.f), flagParallelSearch(true), nbPendingNameSearches(0)
 {
 	setObjectName("StelObjectMgr");
 	objectPointerVisibility = true;
@@ -41,6 +44,14 @@ StelObjectMgr::StelObjectMgr() : searchRadiusPixel(25.f), distanceWeight(1.f)
 
 StelObjectMgr::~StelObjectMgr()
 {
+	waitPendingSearches();
+}
+
+void StelObjectMgr::init()
+{
+	QSettings* conf = StelApp::getInstance().getSettings();
+	Q_ASSERT(conf);
+	flagParallelSearch = conf->value("search/flag_parallel_object_search", true).toBool();
 }
 
 /*************************************************************************
@@ -48,7 +59,9 @@ StelObjectMgr::~StelObjectMgr()
 *************************************************************************/
 void StelObjectMgr::registerStelObjectMgr(StelObjectModule* mgr)
 {
+	waitPendingSearches();
 	objectsModule.push_back(mgr);
+	searchCache.valid = false;
 }
 
 
@@ -129,8 +142,7 @@ StelObjectP StelObjectMgr::cleverFind(const StelCore* core, const Vec3d& v) cons
 	float fov_around = core->getMovementMgr()->getCurrentFov()/qMin(prj->getViewportWidth(), prj->getViewportHeight()) * searchRadiusPixel;
 
 	// Collect the objects inside the range
-	foreach (const StelObjectModule* m, objectsModule)
-		candidates += m->searchAround(v, fov_around, core);
+	candidates = searchAround(core, v, fov_around);
 
 	float limitMag = core->getSkyDrawer()->getLimitMagnitude()-2.f;
 	QList<StelObjectP> tmp;
@@ -166,6 +178,92 @@ StelObjectP StelObjectMgr::cleverFind(const StelCore* core, const Vec3d& v) cons
 	return sobj;
 }
 
+// Defined to be passed to QtConcurrent::run
+static QList<StelObjectP> searchModule(const StelObjectModule* m, Vec3d v, double limitFov, const StelCore* core)
+{
+	return m->searchAround(v, limitFov, core);
+}
+
+// The values of the boolean properties of the modules, like their display flags, which change
+// the objects they find
+static QByteArray getModulesState(const QList<StelObjectModule*>& modules)
+{
+	QByteArray state;
+	foreach (const StelObjectModule* m, modules)
+	{
+		const QMetaObject* metaObject = m->metaObject();
+		for (int i=QObject::staticMetaObject.propertyCount(); i<metaObject->propertyCount(); ++i)
+		{
+			const QMetaProperty property = metaObject->property(i);
+			if (property.type()==QVariant::Bool)
+				state.append(property.read(m).toBool() ? '1' : '0');
+		}
+		state.append(';');
+	}
+	return state;
+}
+
+QList<StelObjectP> StelObjectMgr::searchAround(const StelCore* core, const Vec3d& av, double limitFov) const
+{
+	Vec3d v(av);
+	v.normalize();
+	const double cosLimFov = std::cos(limitFov*M_PI/180.);
+	const double jd = core->getJDay();
+	const QString location = core->getCurrentLocation().getID();
+	const float limitMagnitude = core->getSkyDrawer()->getLimitMagnitude();
+	const QByteArray modulesState = getModulesState(objectsModule);
+
+	// The cache is reused when the point is inside its inner cap, and the objects had no time to move
+	// nor to appear or disappear
+	const bool cacheHit = searchCache.valid && searchCache.limitFov==limitFov && std::fabs(jd-searchCache.jd)<1./86400.
+		&& searchCache.center*v>=cosLimFov && searchCache.location==location && searchCache.limitMagnitude==limitMagnitude
+		&& searchCache.modulesState==modulesState;
+	if (!cacheHit)
+	{
+		searchCache.valid = true;
+		searchCache.center = v;
+		searchCache.limitFov = limitFov;
+		searchCache.jd = jd;
+		searchCache.location = location;
+		searchCache.limitMagnitude = limitMagnitude;
+		searchCache.modulesState = modulesState;
+		searchCache.candidates.clear();
+		if (!flagParallelSearch || objectsModule.size()<2)
+		{
+			foreach (const StelObjectModule* m, objectsModule)
+				searchCache.candidates += m->searchAround(v, 2.*limitFov, core);
+		}
+		else
+		{
+			// All the searches are finished before returning, so that none of them reads the
+			// objects while they are updated or drawn
+			QList<QFuture<QList<StelObjectP> > > futures;
+			foreach (const StelObjectModule* m, objectsModule)
+				futures.append(QtConcurrent::run(searchModule, m, v, 2.*limitFov, core));
+			foreach (QFuture<QList<StelObjectP> > future, futures)
+				searchCache.candidates += future.result();
+		}
+	}
+
+	// Keep the candidates inside the requested cap, or whose disk covers the point
+	QList<StelObjectP> result;
+	foreach (const StelObjectP& obj, searchCache.candidates)
+	{
+		Vec3d pos = obj->getJ2000EquatorialPos(core);
+		pos.normalize();
+		if (pos*v>=qMin(cosLimFov, std::cos(obj->getAngularSize(core)*M_PI/180.)))
+			result.append(obj);
+	}
+	return result;
+}
+
+void StelObjectMgr::waitPendingSearches() const
+{
+	// Their results are still sent from the event loop
+	foreach (QFutureWatcher<QStringList>* watcher, nameSearches)
+		watcher->waitForFinished();
+}
+
 /*************************************************************************
  Find in a "clever" way an object from its equatorial position
 *************************************************************************/
@@ -276,6 +374,93 @@ QStringList StelObjectMgr::listMatchingObjects(const QString& objPrefix, unsigne
 	return result;
 }
 
+//! The parameters of the search of names of a module, passed to QtConcurrent::run.
+struct ModuleNameSearch
+{
+	const StelObjectModule* module;
+	QStringList prefixes;
+	unsigned int maxNbItem;
+	bool useStartOfWords;
+	int search;
+};
+
+static QStringList listModuleMatchingObjects(const ModuleNameSearch& s, const QAtomicInt* currentSearch)
+{
+	QStringList result;
+	foreach (const QString& prefix, s.prefixes)
+	{
+		// A newer search was started while this one waited for a thread
+		if (currentSearch->load()!=s.search)
+			return QStringList();
+		result += s.module->listMatchingObjectsI18n(prefix, s.maxNbItem, s.useStartOfWords);
+		result += s.module->listMatchingObjects(prefix, s.maxNbItem, s.useStartOfWords);
+	}
+	return result;
+}
+
+static QStringList listModuleMatchingObjectsLocked(const ModuleNameSearch& s, const QAtomicInt* currentSearch)
+{
+	QReadLocker locker(s.module->getNameSearchLock());
+	return listModuleMatchingObjects(s, currentSearch);
+}
+
+int StelObjectMgr::startMatchingObjectsSearch(const QStringList& prefixes, unsigned int maxNbItem, bool useStartOfWords)
+{
+	const int search = currentNameSearch.fetchAndAddOrdered(1)+1;
+	nbPendingNameSearches = 0;
+	// The modules which can't be searched in the thread pool are searched at once, their matches
+	// are sent from the event loop like the others, once the caller knows the search identifier
+	QStringList mainThreadMatches;
+	bool hasMainThreadModules = false;
+	foreach (StelObjectModule* m, objectsModule)
+	{
+		const ModuleNameSearch s = {m, prefixes, maxNbItem, useStartOfWords, search};
+		if (!m->hasThreadSafeNameSearch())
+		{
+			mainThreadMatches += listModuleMatchingObjects(s, &currentNameSearch);
+			hasMainThreadModules = true;
+			continue;
+		}
+		m->prepareNameSearch(useStartOfWords);
+		QFutureWatcher<QStringList>* watcher = new QFutureWatcher<QStringList>(this);
+		watcher->setProperty("search", search);
+		connect(watcher, SIGNAL(finished()), this, SLOT(moduleMatchingObjectsFound()));
+		watcher->setFuture(QtConcurrent::run(listModuleMatchingObjectsLocked, s, &currentNameSearch));
+		nameSearches << watcher;
+		++nbPendingNameSearches;
+	}
+	if (hasMainThreadModules)
+	{
+		++nbPendingNameSearches;
+		QMetaObject::invokeMethod(this, "addMatchingObjects", Qt::QueuedConnection, Q_ARG(int, search), Q_ARG(QStringList, mainThreadMatches));
+	}
+	if (objectsModule.isEmpty())
+		emit(matchingObjectsFound(search, QStringList(), true));
+	return search;
+}
+
+void StelObjectMgr::cancelMatchingObjectsSearch()
+{
+	currentNameSearch.fetchAndAddOrdered(1);
+	nbPendingNameSearches = 0;
+}
+
+void StelObjectMgr::moduleMatchingObjectsFound()
+{
+	QFutureWatcher<QStringList>* watcher = static_cast<QFutureWatcher<QStringList>*>(sender());
+	nameSearches.removeOne(watcher);
+	watcher->deleteLater();
+	addMatchingObjects(watcher->property("search").toInt(), watcher->result());
+}
+
+void StelObjectMgr::addMatchingObjects(int search, const QStringList& matches)
+{
+	if (search!=currentNameSearch.load() || nbPendingNameSearches<=0)
+		return;
+	--nbPendingNameSearches;
+	emit(matchingObjectsFound(search, matches, nbPendingNameSearches==0));
+}
+
 QStringList StelObjectMgr::listAllModuleObjects(const QString &moduleId, bool inEnglish) const
 {
 	// search for module
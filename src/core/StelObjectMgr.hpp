@@ -24,8 +24,12 @@
 #include "StelModule.hpp"
 #include "StelObject.hpp"
 
+#include <QAtomicInt>
+#include <QFuture>
+#include <QFutureWatcher>
 #include <QList>
 #include <QString>
+#include <QStringList>
 
 class StelObjectModule;
 class StelCore;
@@ -42,7 +46,7 @@ public:
 
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in the StelModule class
-	virtual void init() {;}
+	virtual void init();
 	virtual void draw(StelCore*) {;}
 	virtual void update(double) {;}
 
@@ -92,6 +96,19 @@ public:
 	//! @return a list of matching object names by order of relevance, or an empty list if nothing match
 	QStringList listMatchingObjects(const QString& objPrefix, unsigned int maxNbItem=5, bool useStartOfWords=false) const;
 
+	//! Start listing the objects matching prefixes in their I18n and English names, the modules whose
+	//! StelObjectModule::hasThreadSafeNameSearch() returns true being searched in the global thread pool
+	//! so that the caller is not blocked by the large catalogs. The other modules are searched at once.
+	//! The search started before is cancelled: the modules which did not start it skip it and its results are
+	//! dropped. The matches of each module are sent by matchingObjectsFound() as they arrive.
+	//! @param prefixes the case insensitive first letters of the searched objects.
+	//! @param maxNbItem the maximum number of names returned by each module for each prefix.
+	//! @param useStartOfWords the autofill mode for returned objects names.
+	//! @return the identifier of the search, sent with its results.
+	int startMatchingObjectsSearch(const QStringList& prefixes, unsigned int maxNbItem=5, bool useStartOfWords=false);
+	//! Cancel the search started by startMatchingObjectsSearch(), no more results are sent for it.
+	void cancelMatchingObjectsSearch();
+
 	QStringList listAllModuleObjects(const QString& moduleId, bool inEnglish) const;
 	QMap<QString, QString> objectModulesMap() const;
 
@@ -138,11 +155,32 @@ public:
 	//! Default to 1.
 	void setDistanceWeight(float newDistanceWeight) {distanceWeight=newDistanceWeight;}
 
+	//! Set whether the registered modules are searched in parallel in the global thread pool
+	//! when looking for the object under the cursor.
+	void setFlagParallelSearch(bool b) {flagParallelSearch=b;}
+	bool getFlagParallelSearch() const {return flagParallelSearch;}
+
+	//! Wait for the searches of names still running in the thread pool, before the modules they read are deleted.
+	void waitPendingSearches() const;
+
 signals:
 	//! Indicate that the selected StelObjects has changed.
 	//! @param action define if the user requested that the objects are added to the selection or just replace it
 	void selectedObjectChanged(StelModule::StelModuleSelectAction);
 
+	//! Send the names matching a search started by startMatchingObjectsSearch() in one module, or in all
+	//! the modules searched on the main thread.
+	//! @param search the identifier of the search.
+	//! @param matches the names found by the module, unsorted.
+	//! @param finished true for the last module of the search.
+	void matchingObjectsFound(int search, const QStringList& matches, bool finished);
+
+private slots:
+	//! Called when the search of names of a module is finished.
+	void moduleMatchingObjectsFound();
+	//! Send the matches of one or several modules for the given search, if it is still the current one.
+	void addMatchingObjects(int search, const QStringList& matches);
+
 private:
 	// The list of StelObjectModule that are referenced in Stellarium
 	QList<StelObjectModule*> objectsModule;
@@ -162,6 +200,37 @@ private:
 
 	// Weight of the distance factor when choosing the best object to select.
 	float distanceWeight;
+
+	//! Get the objects of all the modules within limitFov of v, from the cached search when possible.
+	QList<StelObjectP> searchAround(const StelCore* core, const Vec3d& v, double limitFov) const;
+
+	bool flagParallelSearch;
+
+	//! Result of the last search of the modules. It is done within twice the requested radius,
+	//! so that it contains all the candidates of the following searches around a point less
+	//! than the radius away, for the same observer and visible objects.
+	struct SearchCache
+	{
+		SearchCache() : valid(false), limitFov(0.), jd(0.), limitMagnitude(0.f) {;}
+		bool valid;
+		Vec3d center;
+		double limitFov;
+		double jd;
+		//! The identifier of the location of the observer.
+		QString location;
+		float limitMagnitude;
+		//! The values of the boolean properties of the modules, like their display flags.
+		QByteArray modulesState;
+		QList<StelObjectP> candidates;
+	};
+	mutable SearchCache searchCache;
+
+	//! The identifier of the current search of names, read by the workers to skip the stale ones.
+	QAtomicInt currentNameSearch;
+	//! The number of modules which did not send their matches for the current search of names.
+	int nbPendingNameSearches;
+	//! The searches of names of the modules not finished yet, the stale ones included.
+	QList<QFutureWatcher<QStringList>*> nameSearches;
 };
 
 #endif // _SELECTIONMGR_HPP_
@@ -21,6 +21,7 @@
 
 StelObjectModule::StelObjectModule()
  : StelModule()
+ , nameSearchLock(QReadWriteLock::Recursive)
 {
 }
 
@@ -25,6 +25,7 @@
 #include "VecMath.hpp"
 
 #include <QList>
+#include <QReadWriteLock>
 #include <QString>
 #include <QStringList>
 
@@ -32,6 +33,15 @@
 //! Specialization of StelModule which manages a collection of StelObject.
 //! Instances deriving from the StelObjectModule class can be managed by the StelObjectMgr.
 //! The class defines extra abstract functions for searching and listing StelObjects.
+//!
+//! All the methods are called from the main thread, except:
+//! - searchAround(), which the StelObjectMgr calls for all the modules at once in the thread pool
+//! while the main thread waits. It must only read the module.
+//! - listMatchingObjectsI18n() and listMatchingObjects() when hasThreadSafeNameSearch() returns
+//! true. The StelObjectMgr then calls them in the thread pool while the main thread goes on, after a
+//! call to prepareNameSearch() and holding getNameSearchLock() for reading. They must only read what
+//! prepareNameSearch() built, and the module must hold the lock for writing on the main thread while it
+//! modifies what they read, like when the language changes.
 class StelObjectModule : public StelModule
 {
 public:
@@ -73,6 +83,23 @@ public:
 	virtual QStringList listAllObjects(bool inEnglish) const = 0;
 
 	virtual QString getName() const = 0;
+
+	//! Get whether listMatchingObjectsI18n() and listMatchingObjects() can be called from the thread pool.
+	//! The default implementation returns false, the module is then searched on the main thread.
+	virtual bool hasThreadSafeNameSearch() const {return false;}
+
+	//! Build on the main thread what the next searches of names read, like the translations and the
+	//! indexes of the names which are otherwise built on first use. Only called if hasThreadSafeNameSearch()
+	//! returns true, before the searches are started in the thread pool.
+	//! @param useStartOfWords the autofill mode of the searches.
+	virtual void prepareNameSearch(bool useStartOfWords) {Q_UNUSED(useStartOfWords);}
+
+	//! Get the lock held for reading by the searches of names running in the thread pool.
+	QReadWriteLock* getNameSearchLock() const {return &nameSearchLock;}
+
+private:
+	//! Recursive, so that the methods holding it for writing can call each other.
+	mutable QReadWriteLock nameSearchLock;
 };
 
 #endif // _STELOBJECTMODULE_HPP_
@@ -20,28 +20,50 @@
 #include "StelPainter.hpp"
 
 #include "StelApp.hpp"
+#include "StelFileMgr.hpp"
 #include "StelLocaleMgr.hpp"
 #include "StelProjector.hpp"
 #include "StelProjectorClasses.hpp"
+#include "StelRenderStats.hpp"
+#include "StelTextAtlas.hpp"
 #include "StelUtils.hpp"
 
 #include <QDebug>
 #include <QString>
 #include <QSettings>
-#include <QLinkedList>
 #include <QPainter>
 #include <QMutex>
 #include <QVarLengthArray>
 #include <QPaintEngine>
 #include <QCache>
+#include <QOpenGLBuffer>
 #include <QOpenGLPaintDevice>
 #include <QOpenGLShader>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
 
 
 #ifndef NDEBUG
 QMutex* StelPainter::globalMutex = new QMutex();
 #endif
 
+StelTextAtlas* StelPainter::textAtlas=NULL;
+StelPainter* StelPainter::textAtlasOwner=NULL;
+Vec3f StelPainter::renderRegion(0.f, 0.f, 1.f);
+QCache<QByteArray, StelPainter::SphereMesh> StelPainter::sphereMeshCache(500000);
+QHash<QByteArray, QOpenGLShaderProgram*> StelPainter::projectionPrograms;
+QVector<StelPainter::BatchCommand> StelPainter::batchCommands;
+QVector<Vec3f> StelPainter::batchVertices;
+QVector<Vec2f> StelPainter::batchTexCoords;
+QVector<Vec4f> StelPainter::batchColors;
+bool StelPainter::flagVertexBuffersOnly=false;
+QOpenGLBuffer* StelPainter::streamVertexBuffer=NULL;
+QOpenGLBuffer* StelPainter::streamIndexBuffer=NULL;
 QOpenGLShaderProgram* StelPainter::texturesShaderProgram=NULL;
 QOpenGLShaderProgram* StelPainter::basicShaderProgram=NULL;
 QOpenGLShaderProgram* StelPainter::colorShaderProgram=NULL;
@@ -51,6 +73,22 @@ StelPainter::TexturesShaderVars StelPainter::texturesShaderVars;
 StelPainter::BasicShaderVars StelPainter::colorShaderVars;
 StelPainter::TexturesColorShaderVars StelPainter::texturesColorShaderVars;
 
+// The program used by the last draw call, to count the state changes between the draw calls
+static const QOpenGLShaderProgram* lastDrawProgram = NULL;
+
+// Count a draw call in the render statistics, and a state change if its program is not the one of the
+// previous draw call, or if stateChanged is true, e.g. when its texture or its blending changed
+static void countDrawCall(const QOpenGLShaderProgram* program, bool stateChanged=false)
+{
+	StelRenderStats* stats = StelApp::getInstance().getRenderStats();
+	if (!stats)
+		return;
+	stats->add(StelRenderStats::PainterDrawCalls);
+	if (stateChanged || program!=lastDrawProgram)
+		stats->add(StelRenderStats::PainterStateChanges);
+	lastDrawProgram = program;
+}
+
 StelPainter::GLState::GLState()
 {
 	blend = glIsEnabled(GL_BLEND);
@@ -81,7 +119,168 @@ bool StelPainter::linkProg(QOpenGLShaderProgram* prog, const QString& name)
 	return ret;
 }
 
-StelPainter::StelPainter(const StelProjectorP& proj) : prj(proj)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+//! The cache of the linked programs, using the functions of GL_ARB_get_program_binary (core in OpenGL 4.1
+//! and OpenGL ES 3) or GL_OES_get_program_binary. The binaries are only valid for the driver which produced
+//! them, so the driver is part of the key of each program with its sources.
+struct StelProgramBinaryCache
+{
+	typedef void (QOPENGLF_APIENTRYP GetProgramBinaryFunc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+	typedef void (QOPENGLF_APIENTRYP ProgramBinaryFunc)(GLuint program, GLenum binaryFormat, const void* binary, GLint length);
+	typedef void (QOPENGLF_APIENTRYP ProgramParameteriFunc)(GLuint program, GLenum pname, GLint value);
+
+	StelProgramBinaryCache() : context(NULL), getProgramBinary(NULL), programBinary(NULL), programParameteri(NULL) {;}
+
+	//! Resolve the functions for the current context.
+	//! @return false if the cache can't be used.
+	bool resolve()
+	{
+		QOpenGLContext* current = QOpenGLContext::currentContext();
+		if (current==context)
+			return getProgramBinary!=NULL;
+		context = current;
+		getProgramBinary = NULL;
+		if (!context || !StelApp::getInstance().getSettings()->value("video/flag_shader_cache", true).toBool())
+			return false;
+		const QSurfaceFormat format = context->format();
+		const int version = format.majorVersion()*10+format.minorVersion();
+		if (format.renderableType()==QSurfaceFormat::OpenGLES)
+		{
+			if (version>=30)
+			{
+				getProgramBinary = (GetProgramBinaryFunc)context->getProcAddress("glGetProgramBinary");
+				programBinary = (ProgramBinaryFunc)context->getProcAddress("glProgramBinary");
+			}
+			else if (context->hasExtension("GL_OES_get_program_binary"))
+			{
+				getProgramBinary = (GetProgramBinaryFunc)context->getProcAddress("glGetProgramBinaryOES");
+				programBinary = (ProgramBinaryFunc)context->getProcAddress("glProgramBinaryOES");
+			}
+		}
+		else if (version>=41 || context->hasExtension("GL_ARB_get_program_binary"))
+		{
+			getProgramBinary = (GetProgramBinaryFunc)context->getProcAddress("glGetProgramBinary");
+			programBinary = (ProgramBinaryFunc)context->getProcAddress("glProgramBinary");
+			programParameteri = (ProgramParameteriFunc)context->getProcAddress("glProgramParameteri");
+		}
+		// Some drivers have the functions but no binary format
+		GLint nbFormats = 0;
+		if (getProgramBinary && programBinary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+		if (nbFormats<=0)
+		{
+			getProgramBinary = NULL;
+			return false;
+		}
+		driver = QByteArray((const char*)glGetString(GL_VENDOR)) + '\n' + (const char*)glGetString(GL_RENDERER) + '\n' + (const char*)glGetString(GL_VERSION) + '\n' + qVersion();
+		dir = StelFileMgr::getCacheDir() + "/shaders";
+		QDir().mkpath(dir);
+		return true;
+	}
+
+	QString fileName(const QByteArray& vsrc, const QByteArray& fsrc) const
+	{
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(driver);
+		hash.addData(vsrc);
+		hash.addData("\0", 1);
+		hash.addData(fsrc);
+		return dir + "/" + hash.result().toHex() + ".bin";
+	}
+
+	//! Load the binary of the program from the cache.
+	//! @return true if the program is linked.
+	bool load(QOpenGLShaderProgram* prog, const QString& file)
+	{
+		QFile f(file);
+		if (!f.open(QIODevice::ReadOnly))
+			return false;
+		const QByteArray data = f.readAll();
+		f.close();
+		if (data.size()<=(int)sizeof(GLenum))
+			return false;
+		GLenum binaryFormat;
+		memcpy(&binaryFormat, data.constData(), sizeof(GLenum));
+		programBinary(prog->programId(), binaryFormat, data.constData()+sizeof(GLenum), data.size()-sizeof(GLenum));
+		GLint status = GL_FALSE;
+		glGetProgramiv(prog->programId(), GL_LINK_STATUS, &status);
+		// QOpenGLShaderProgram::link() without shaders only checks the state of the program loaded
+		if (status!=GL_TRUE || !prog->link())
+		{
+			// The driver probably changed without changing its version string
+			QFile::remove(file);
+			return false;
+		}
+		return true;
+	}
+
+	//! Save the binary of a linked program in the cache.
+	void save(QOpenGLShaderProgram* prog, const QString& file)
+	{
+		GLint length = 0;
+		glGetProgramiv(prog->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length<=0)
+			return;
+		QByteArray data(sizeof(GLenum)+length, 0);
+		GLenum binaryFormat = 0;
+		getProgramBinary(prog->programId(), length, &length, &binaryFormat, data.data()+sizeof(GLenum));
+		if (length<=0)
+			return;
+		memcpy(data.data(), &binaryFormat, sizeof(GLenum));
+		data.resize(sizeof(GLenum)+length);
+		QFile f(file);
+		if (!f.open(QIODevice::WriteOnly) || f.write(data)!=data.size())
+			qWarning() << "StelPainter: Can't write the shader cache file" << QDir::toNativeSeparators(file);
+	}
+
+	QOpenGLContext* context;
+	QByteArray driver;
+	QString dir;
+	GetProgramBinaryFunc getProgramBinary;
+	ProgramBinaryFunc programBinary;
+	ProgramParameteriFunc programParameteri;
+};
+
+static StelProgramBinaryCache programBinaryCache;
+
+bool StelPainter::buildProg(QOpenGLShaderProgram* prog, const QString& name, const QByteArray& vsrc, const QByteArray& fsrc)
+{
+	const bool useCache = programBinaryCache.resolve();
+	QString file;
+	if (useCache)
+	{
+		file = programBinaryCache.fileName(vsrc, fsrc);
+		if (programBinaryCache.load(prog, file))
+			return true;
+	}
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << QString("StelPainter: Warnings while compiling %1 vertex shader:\n%2").arg(name, vshader.log()); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << QString("StelPainter: Warnings while compiling %1 fragment shader:\n%2").arg(name, fshader.log()); }
+	prog->addShader(&vshader);
+	prog->addShader(&fshader);
+	if (useCache && programBinaryCache.programParameteri)
+		programBinaryCache.programParameteri(prog->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	if (!linkProg(prog, name))
+		return false;
+	if (useCache)
+		programBinaryCache.save(prog, file);
+	return true;
+}
+
+StelPainter::StelPainter(const StelProjectorP& proj) : batching(false), prj(proj), vertexOrigin(0.)
 {
 	Q_ASSERT(proj);
 
@@ -114,14 +313,37 @@ StelPainter::StelPainter(const StelProjectorP& proj) : prj(proj)
 
 void StelPainter::setProjector(const StelProjectorP& p)
 {
+	// The texts and draws already added are in the pixel coordinates of the previous projector
+	if (prj)
+		flushText();
 	prj=p;
 	// Init GL viewport to current projector values
-	glViewport(prj->viewportXywh[0], prj->viewportXywh[1], prj->viewportXywh[2], prj->viewportXywh[3]);
+	applyViewport();
 	glFrontFace(prj->needGlFrontFaceCW()?GL_CW:GL_CCW);
 }
 
+void StelPainter::applyViewport() const
+{
+	const Vec4i& renderTile = StelProjector::getRenderTile();
+	if (renderTile[2]>0)
+		glViewport(0, 0, renderTile[2], renderTile[3]);
+	else if (renderRegion==Vec3f(0.f, 0.f, 1.f))
+		glViewport(prj->viewportXywh[0], prj->viewportXywh[1], prj->viewportXywh[2], prj->viewportXywh[3]);
+	else
+		glViewport(qRound((prj->viewportXywh[0]-renderRegion[0])*renderRegion[2]), qRound((prj->viewportXywh[1]-renderRegion[1])*renderRegion[2]),
+			   qRound(prj->viewportXywh[2]*renderRegion[2]), qRound(prj->viewportXywh[3]*renderRegion[2]));
+}
+
+void StelPainter::setRenderRegion(float x, float y, float scale)
+{
+	renderRegion.set(x, y, scale);
+}
+
 StelPainter::~StelPainter()
 {
+	endBatch();
+	flushText();
+
 #ifndef NDEBUG
 	GLenum er = glGetError();
 	if (er!=GL_NO_ERROR)
@@ -330,6 +552,12 @@ void StelPainter::computeFanDisk(float radius, int innerFanSlices, int level, QV
 
 }
 
+// Texture coordinate in [0, 1] normalized as GL_UNSIGNED_SHORT, precise to 1/65535 of the texture
+static inline unsigned short packTexCoord(float t)
+{
+	return (unsigned short)(qBound(0.f, t, 1.f)*65535.f+0.5f);
+}
+
 static void sSphereMapTexCoordFast(float rho_div_fov, const float costheta, const float sintheta, QVector<float>& out)
 {
 	if (rho_div_fov>0.5f)
@@ -337,8 +565,14 @@ static void sSphereMapTexCoordFast(float rho_div_fov, const float costheta, cons
 	out << 0.5f + rho_div_fov * costheta << 0.5f + rho_div_fov * sintheta;
 }
 
-void StelPainter::sSphereMap(const float radius, const int slices, const int stacks, const float textureFov, const int orientInside)
+StelPainter::SphereMesh* StelPainter::getSphereMapMesh(const float radius, const int slices, const int stacks, const float textureFov, const int orientInside)
 {
+	const float params[6] = {1.f, radius, (float)slices, (float)stacks, textureFov, (float)orientInside};
+	const QByteArray key((const char*)params, sizeof(params));
+	SphereMesh* mesh = sphereMeshCache.object(key);
+	if (mesh)
+		return mesh;
+
 	float rho,x,y,z;
 	int i, j;
 	const float* cos_sin_rho = StelUtils::ComputeCosSinRho(stacks);
@@ -356,57 +590,66 @@ void StelPainter::sSphereMap(const float radius, const int slices, const int sta
 
 	const int imax = stacks;
 
-	static QVector<double> vertexArr;
-	static QVector<float> texCoordArr;
+	mesh = new SphereMesh();
+	QVector<float> texCoordArr;
 
-	// draw intermediate stacks as quad strips
-	if (!orientInside) // nsign==1
+	// intermediate stacks as quad strips, split into triangles with the same orientation
+	for (i = 0,cos_sin_rho_p=cos_sin_rho,rho=0.f; i < imax; ++i,cos_sin_rho_p+=2,rho+=drho)
 	{
-		for (i = 0,cos_sin_rho_p=cos_sin_rho,rho=0.f; i < imax; ++i,cos_sin_rho_p+=2,rho+=drho)
+		const unsigned short offset = mesh->vertices.size();
+		for (j=0,cos_sin_theta_p=cos_sin_theta;j<=slices;++j,cos_sin_theta_p+=2)
 		{
-			vertexArr.resize(0);
-			texCoordArr.resize(0);
-			for (j=0,cos_sin_theta_p=cos_sin_theta;j<=slices;++j,cos_sin_theta_p+=2)
+			if (!orientInside) // nsign==1
 			{
 				x = -cos_sin_theta_p[1] * cos_sin_rho_p[1];
 				y = cos_sin_theta_p[0] * cos_sin_rho_p[1];
 				z = cos_sin_rho_p[0];
 				sSphereMapTexCoordFast(rho, cos_sin_theta_p[0], cos_sin_theta_p[1], texCoordArr);
-				vertexArr << x*radius << y*radius << z*radius;
+				mesh->vertices << Vec3f(x*radius, y*radius, z*radius);
 
 				x = -cos_sin_theta_p[1] * cos_sin_rho_p[3];
 				y = cos_sin_theta_p[0] * cos_sin_rho_p[3];
 				z = cos_sin_rho_p[2];
 				sSphereMapTexCoordFast(rho + drho, cos_sin_theta_p[0], cos_sin_theta_p[1], texCoordArr);
-				vertexArr << x*radius << y*radius << z*radius;
+				mesh->vertices << Vec3f(x*radius, y*radius, z*radius);
 			}
-			setArrays((Vec3d*)vertexArr.constData(), (Vec2f*)texCoordArr.constData());
-			drawFromArray(TriangleStrip, vertexArr.size()/3);
-		}
-	}
-	else
-	{
-		for (i = 0,cos_sin_rho_p=cos_sin_rho,rho=0.f; i < imax; ++i,cos_sin_rho_p+=2,rho+=drho)
-		{
-			vertexArr.resize(0);
-			texCoordArr.resize(0);
-			for (j=0,cos_sin_theta_p=cos_sin_theta;j<=slices;++j,cos_sin_theta_p+=2)
+			else
 			{
 				x = -cos_sin_theta_p[1] * cos_sin_rho_p[3];
 				y = cos_sin_theta_p[0] * cos_sin_rho_p[3];
 				z = cos_sin_rho_p[2];
 				sSphereMapTexCoordFast(rho + drho, cos_sin_theta_p[0], -cos_sin_theta_p[1], texCoordArr);
-				vertexArr << x*radius << y*radius << z*radius;
+				mesh->vertices << Vec3f(x*radius, y*radius, z*radius);
 
 				x = -cos_sin_theta_p[1] * cos_sin_rho_p[1];
 				y = cos_sin_theta_p[0] * cos_sin_rho_p[1];
 				z = cos_sin_rho_p[0];
 				sSphereMapTexCoordFast(rho, cos_sin_theta_p[0], -cos_sin_theta_p[1], texCoordArr);
-				vertexArr << x*radius << y*radius << z*radius;
+				mesh->vertices << Vec3f(x*radius, y*radius, z*radius);
 			}
-			setArrays((Vec3d*)vertexArr.constData(), (Vec2f*)texCoordArr.constData());
-			drawFromArray(TriangleStrip, vertexArr.size()/3);
 		}
+		for (j = 2;j<slices*2+2;j+=2)
+		{
+			mesh->indices << offset+j-2 << offset+j-1 << offset+j;
+			mesh->indices << offset+j << offset+j-1 << offset+j+1;
+		}
+	}
+	for (i=0;i<texCoordArr.size();++i)
+		mesh->texCoords << packTexCoord(texCoordArr.at(i));
+
+	sphereMeshCache.insert(key, mesh, mesh->vertices.size());
+	return mesh;
+}
+
+void StelPainter::sSphereMap(const float radius, const int slices, const int stacks, const float textureFov, const int orientInside)
+{
+	SphereMesh* mesh = getSphereMapMesh(radius, slices, stacks, textureFov, orientInside);
+	if (!drawMeshGpu(mesh))
+	{
+		setArrays(mesh->vertices.constData());
+		enableClientStates(true, true);
+		setTexCoordPointer(2, GL_UNSIGNED_SHORT, mesh->texCoords.constData());
+		drawFromArray(Triangles, mesh->indices.size(), 0, true, mesh->indices.constData());
 	}
 }
 
@@ -514,65 +757,112 @@ struct StringTexture
 
 void StelPainter::drawText(float x, float y, const QString& str, float angleDeg, float xshift, float yshift, const bool noGravity)
 {
-	StelPainter::GLState state; // Will restore the opengl state at the end of the function.
 	if (prj->gravityLabels && !noGravity)
 	{
 		drawTextGravity180(x, y, str, xshift, yshift);
+		return;
 	}
-	else
+
+	// Translate/rotate
+	if (!noGravity)
+		angleDeg += prj->defautAngleForGravityText;
+
+	const float globalScalingRatio = StelApp::getInstance().getGlobalScalingRatio();
+	xshift*=globalScalingRatio;
+	yshift*=globalScalingRatio;
+	const int pixelSize = currentFont.pixelSize()*prj->getDevicePixelsPerPixel()*globalScalingRatio;
+
+	if (textAtlas && pixelSize>0)
 	{
-		QOpenGLPaintDevice device;
-		device.setSize(QSize(prj->getViewportWidth(), prj->getViewportHeight()));
-		// This doesn't seem to work correctly, so implement the hack below instead.
-		// Maybe check again later, or check on mac with retina..
-		// device.setDevicePixelRatio(prj->getDevicePixelsPerPixel());
-		// painter.setFont(currentFont);
-		
-		QPainter painter(&device);
-		painter.beginNativePainting();
-		
-		QFont tmpFont = currentFont;
-		tmpFont.setPixelSize(currentFont.pixelSize()*prj->getDevicePixelsPerPixel()*StelApp::getInstance().getGlobalScalingRatio());
-		painter.setFont(tmpFont);
-		painter.setPen(QColor(currentColor[0]*255, currentColor[1]*255, currentColor[2]*255, currentColor[3]*255));
-		
-		xshift*=StelApp::getInstance().getGlobalScalingRatio();
-		yshift*=StelApp::getInstance().getGlobalScalingRatio();
-		
-		y = prj->getViewportHeight()-y;
-		yshift = -yshift;
-
-		// Translate/rotate
-		if (!noGravity)
-			angleDeg += prj->defautAngleForGravityText;
-
-		if (std::fabs(angleDeg)>1.f)
+		// The batch only holds the texts of one painter, in the pixel coordinates of its projector
+		if (textAtlasOwner!=this)
+			flushPendingText();
+		const float angle = std::fabs(angleDeg)>1.f ? angleDeg : 0.f;
+		bool added = textAtlas->addText(currentFont, str, x, y, angle, xshift, yshift, pixelSize, currentColor);
+		if (!added && textAtlas->isFull())
 		{
-			QTransform m;
-			m.translate(x, y);
-			m.rotate(-angleDeg);
-			painter.setTransform(m);
-			painter.drawText(xshift, yshift, str);
+			flushText();
+			textAtlas->clear();
+			added = textAtlas->addText(currentFont, str, x, y, angle, xshift, yshift, pixelSize, currentColor);
 		}
-		else
+		if (added)
 		{
-			painter.drawText(x+xshift, y+yshift, str);
+			textAtlasOwner = this;
+			return;
 		}
-		
-		painter.endNativePainting();
 	}
+
+	// The texts already in the batch go under this one
+	flushText();
+	StelPainter::GLState state; // Will restore the opengl state at the end of the function.
+	QOpenGLPaintDevice device;
+	device.setSize(QSize(prj->getViewportWidth(), prj->getViewportHeight()));
+	// This doesn't seem to work correctly, so implement the hack below instead.
+	// Maybe check again later, or check on mac with retina..
+	// device.setDevicePixelRatio(prj->getDevicePixelsPerPixel());
+	// painter.setFont(currentFont);
+
+	QPainter painter(&device);
+	painter.beginNativePainting();
+
+	QFont tmpFont = currentFont;
+	tmpFont.setPixelSize(pixelSize);
+	painter.setFont(tmpFont);
+	painter.setPen(QColor(currentColor[0]*255, currentColor[1]*255, currentColor[2]*255, currentColor[3]*255));
+
+	y = prj->getViewportHeight()-y;
+	yshift = -yshift;
+
+	if (std::fabs(angleDeg)>1.f)
+	{
+		QTransform m;
+		m.translate(x, y);
+		m.rotate(-angleDeg);
+		painter.setTransform(m);
+		painter.drawText(xshift, yshift, str);
+	}
+	else
+	{
+		painter.drawText(x+xshift, y+yshift, str);
+	}
+
+	painter.endNativePainting();
 }
 
-// Recursive method cutting a small circle in small segments
-inline void fIter(const StelProjectorP& prj, const Vec3d& p1, const Vec3d& p2, Vec3d& win1, Vec3d& win2, QLinkedList<Vec3d>& vertexList, const QLinkedList<Vec3d>::iterator& iter, double radius, const Vec3d& center, int nbI=0, bool checkCrossDiscontinuity=true)
+void StelPainter::flushText()
+{
+	// The recorded draws go under the texts
+	if (batching)
+		executeBatch();
+	flushPendingText();
+}
+
+void StelPainter::flushPendingText()
+{
+	const StelPainter* owner = textAtlasOwner;
+	textAtlasOwner = NULL;
+	if (!owner || !textAtlas || !textAtlas->hasPendingText())
+		return;
+	StelPainter::GLState state;
+	// The owner may not be the painter which set the current viewport
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	owner->applyViewport();
+	textAtlas->flush(toQMatrix(owner->getProjector()->getProjectionMatrix()));
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Recursive method cutting a small circle in small segments.
+// The points found between win1 and win2 are appended in order to vertexList.
+inline void fIter(const StelProjectorP& prj, const Vec3d& p1, const Vec3d& p2, Vec3d& win1, Vec3d& win2, QVector<Vec3d>& vertexList, double radius, const Vec3d& center, int nbI=0, bool checkCrossDiscontinuity=true)
 {
 	const bool crossDiscontinuity = checkCrossDiscontinuity && prj->intersectViewportDiscontinuity(p1+center, p2+center);
 	if (crossDiscontinuity && nbI>=10)
 	{
 		win1[2]=-2.;
 		win2[2]=-2.;
-		vertexList.insert(iter, win1);
-		vertexList.insert(iter, win2);
+		vertexList.append(win1);
+		vertexList.append(win2);
 		return;
 	}
 
@@ -593,11 +883,47 @@ inline void fIter(const StelProjectorP& prj, const Vec3d& p1, const Vec3d& p2, V
 	{
 		// Use the 3rd component of the vector to store whether the vertex is valid
 		win3[2]= isValidVertex ? 1.0 : -1.;
-		fIter(prj, p1, newVertex, win1, win3, vertexList, vertexList.insert(iter, win3), radius, center, nbI+1, crossDiscontinuity || dist>50*50);
-		fIter(prj, newVertex, p2, win3, win2, vertexList, iter, radius, center, nbI+1, crossDiscontinuity || dist>50*50 );
+		// The first half may flag win3 as crossing a discontinuity, but the point itself is kept as computed
+		const Vec3d middle(win3);
+		fIter(prj, p1, newVertex, win1, win3, vertexList, radius, center, nbI+1, crossDiscontinuity || dist>50*50);
+		vertexList.append(middle);
+		fIter(prj, newVertex, p2, win3, win2, vertexList, radius, center, nbI+1, crossDiscontinuity || dist>50*50 );
 	}
 }
 
+// Scratch array of the projected points of the arc being drawn, kept to avoid allocations
+static QVector<Vec3d> tessArc;
+
+// An arc tessellated with a projector. The projectors don't change once created, and the grids, the lines
+// and the horizon are drawn with the same arcs at every frame, so their tessellation is kept for the
+// projectors still in use: the AltAz ones are kept by StelCore as long as the view doesn't move.
+struct TessArcKey
+{
+	int serial;
+	Vec3d start;
+	Vec3d stop;
+	Vec3d rotCenter;
+	bool operator==(const TessArcKey& o) const {return serial==o.serial && start==o.start && stop==o.stop && rotCenter==o.rotCenter;}
+};
+
+static inline uint qHash(const TessArcKey& key)
+{
+	// The struct is hashed field by field, its padding is not initialized
+	uint h = key.serial;
+	const Vec3d* v[3] = {&key.start, &key.stop, &key.rotCenter};
+	for (int i=0; i<3; ++i)
+		for (int j=0; j<3; ++j)
+		{
+			quint64 bits;
+			memcpy(&bits, &(*v[i])[j], sizeof(bits));
+			h = h*31 + (uint)(bits ^ (bits>>32));
+		}
+	return h;
+}
+
+// The tessellated arcs, the cost being their number of points
+static QCache<TessArcKey, QVector<Vec3d> > tessArcCache(200000);
+
 // Used by the method below
 QVector<Vec2f> StelPainter::smallCircleVertexArray;
 
@@ -639,39 +965,56 @@ void StelPainter::drawSmallCircleArc(const Vec3d& start, const Vec3d& stop, cons
 {
 	Q_ASSERT(smallCircleVertexArray.empty());
 
-	QLinkedList<Vec3d> tessArc;	// Contains the list of projected points from the tesselated arc
+	const TessArcKey key = {prj->getSerial(), start, stop, rotCenter};
+	const QVector<Vec3d>* cachedArc = tessArcCache.object(key);
+	if (cachedArc)
+	{
+		drawTessellatedArc(*cachedArc, viewportEdgeIntersectCallback, userData);
+		return;
+	}
+
+	tessArc.resize(0);	// Contains the list of projected points from the tesselated arc
 	Vec3d win1, win2;
 	win1[2] = prj->project(start, win1) ? 1.0 : -1.;
 	win2[2] = prj->project(stop, win2) ? 1.0 : -1.;
 	tessArc.append(win1);
+	const Vec3d last(win2);
 
 
 	if (rotCenter.lengthSquared()<0.00000001)
 	{
 		// Great circle
 		// Perform the tesselation of the arc in small segments in a way so that the lines look smooth
-		fIter(prj, start, stop, win1, win2, tessArc, tessArc.insert(tessArc.end(), win2), 1, rotCenter);
+		fIter(prj, start, stop, win1, win2, tessArc, 1, rotCenter);
 	}
 	else
 	{
 		Vec3d tmp = (rotCenter^start)/rotCenter.length();
 		const double radius = fabs(tmp.length());
 		// Perform the tesselation of the arc in small segments in a way so that the lines look smooth
-		fIter(prj, start-rotCenter, stop-rotCenter, win1, win2, tessArc, tessArc.insert(tessArc.end(), win2), radius, rotCenter);
-	}
+		fIter(prj, start-rotCenter, stop-rotCenter, win1, win2, tessArc, radius, rotCenter);
+	}
+	tessArc.append(last);
+	// Copied rather than shared, so that the scratch array keeps its allocation
+	QVector<Vec3d>* arc = new QVector<Vec3d>(tessArc.size());
+	std::copy(tessArc.constBegin(), tessArc.constEnd(), arc->begin());
+	tessArcCache.insert(key, arc, arc->size());
+	drawTessellatedArc(tessArc, viewportEdgeIntersectCallback, userData);
+}
 
-	// And draw.
-	QLinkedList<Vec3d>::ConstIterator i = tessArc.constBegin();
-	while (i+1 != tessArc.constEnd())
+void StelPainter::drawTessellatedArc(const QVector<Vec3d>& arc, void (*viewportEdgeIntersectCallback)(const Vec3d& screenPos, const Vec3d& direction, void* userData), void* userData)
+{
+	const int nbPoints = arc.size();
+	for (int i=1;i<nbPoints;++i)
 	{
-		const Vec3d& p1 = *i;
-		const Vec3d& p2 = *(++i);
+		const Vec3d& p1 = arc.at(i-1);
+		const Vec3d& p2 = arc.at(i);
 		const bool p1InViewport = prj->checkInViewport(p1);
 		const bool p2InViewport = prj->checkInViewport(p2);
 		if ((p1[2]>0 && p1InViewport) || (p2[2]>0 && p2InViewport))
 		{
 			smallCircleVertexArray.append(Vec2f(p1[0], p1[1]));
-			if (i+1==tessArc.constEnd())
+			if (i+1==nbPoints)
 			{
 				smallCircleVertexArray.append(Vec2f(p2[0], p2[1]));
 				drawSmallCircleVertexArray();
@@ -1222,6 +1565,171 @@ void StelPainter::drawSphericalRegion(const SphericalRegion* poly, SphericalPoly
 	}
 }
 
+// The function object used to subdivide the triangles of a StelVertexArray until their edges are
+// shorter than a given angle. The resulting triangles are added to the arrays of a SphericalRegionDrawCache.
+class TriangleSubdivider
+{
+public:
+	TriangleSubdivider(double maxEdgeAngle, const SphericalCap* aclippingCap, QVector<Vec3d>* aoutVertices, QVector<Vec2f>* aoutTexCoords=NULL)
+		: cosMaxEdgeAngle(std::cos(maxEdgeAngle)), clippingCap(aclippingCap), outVertices(aoutVertices), outTexCoords(aoutTexCoords)
+	{
+	}
+
+	inline void operator()(const Vec3d* v0, const Vec3d* v1, const Vec3d* v2,
+						   const Vec2f* t0, const Vec2f* t1, const Vec2f* t2,
+						   unsigned int, unsigned int, unsigned)
+	{
+		const Vec3d tmpVertex[3] = {*v0, *v1, *v2};
+		if (outTexCoords)
+		{
+			const Vec2f tmpTexture[3] = {*t0, *t1, *t2};
+			subdivide(tmpVertex, tmpTexture, clippingCap, 0);
+		}
+		else
+			subdivide(tmpVertex, NULL, clippingCap, 0);
+	}
+
+private:
+	// Maximum number of recursive subdivisions, as done by StelPainter::projectSphericalTriangle
+	static const int MaxLevel = 5;
+
+	void subdivide(const Vec3d* vertices, const Vec2f* texturePos, const SphericalCap* cap, int level)
+	{
+		if (cap && cap->containsTriangle(vertices))
+			cap = NULL;
+		if (cap && !cap->intersectsTriangle(vertices))
+			return;
+
+		if (level>=MaxLevel || (vertices[0]*vertices[1]>=cosMaxEdgeAngle && vertices[1]*vertices[2]>=cosMaxEdgeAngle && vertices[2]*vertices[0]>=cosMaxEdgeAngle))
+		{
+			outVertices->append(vertices[0]); outVertices->append(vertices[1]); outVertices->append(vertices[2]);
+			if (outTexCoords)
+			{
+				outTexCoords->append(texturePos[0]); outTexCoords->append(texturePos[1]); outTexCoords->append(texturePos[2]);
+			}
+			return;
+		}
+
+		// Split the triangle in 4 using the middle of its sides, keeping the same orientation.
+		Vec3d m[3] = {vertices[0]+vertices[1], vertices[1]+vertices[2], vertices[2]+vertices[0]};
+		m[0].normalize(); m[1].normalize(); m[2].normalize();
+		const Vec3d va[4][3] = {{vertices[0], m[0], m[2]}, {m[0], vertices[1], m[1]}, {m[2], m[1], vertices[2]}, {m[0], m[1], m[2]}};
+		if (texturePos)
+		{
+			const Vec2f mt[3] = {(texturePos[0]+texturePos[1])*0.5f, (texturePos[1]+texturePos[2])*0.5f, (texturePos[2]+texturePos[0])*0.5f};
+			const Vec2f ta[4][3] = {{texturePos[0], mt[0], mt[2]}, {mt[0], texturePos[1], mt[1]}, {mt[2], mt[1], texturePos[2]}, {mt[0], mt[1], mt[2]}};
+			for (int i=0;i<4;++i)
+				subdivide(va[i], ta[i], cap, level+1);
+		}
+		else
+		{
+			for (int i=0;i<4;++i)
+				subdivide(va[i], NULL, cap, level+1);
+		}
+	}
+
+	const double cosMaxEdgeAngle;
+	const SphericalCap* clippingCap;
+	QVector<Vec3d>* outVertices;
+	QVector<Vec2f>* outTexCoords;
+};
+
+void StelPainter::drawSphericalRegion(const SphericalRegion* poly, SphericalRegionDrawCache* cache, SphericalPolygonDrawMode drawMode, const SphericalCap* clippingCap, const double maxSqDistortion)
+{
+	if (drawMode==SphericalPolygonDrawModeBoundary)
+	{
+		drawSphericalRegion(poly, drawMode, clippingCap, true, maxSqDistortion);
+		return;
+	}
+	const SphericalCap& viewportCap = prj->getBoundingCap();
+	const SphericalCap regionCap = poly->getBoundingCap();
+	if (!viewportCap.intersects(regionCap))
+		return;
+
+	// A great circle arc of angle a projected as a circle of radius R pixels deviates from its chord by
+	// about R*a*a/8 pixels. Great circles are projected with a radius of about the pixel per radian at
+	// the center of the viewport or more, which gives the maximum angle of the edges to keep the distortion
+	// below the limit. It is rounded to a power of 2 so that the cache stays valid while zooming.
+	const double maxEdgeAngle = std::sqrt(8.*std::sqrt(maxSqDistortion)/prj->getPixelPerRadAtCenter());
+	const int subdivisionLevel = qBound(0, (int)std::ceil(std::log(M_PI/maxEdgeAngle)/std::log(2.)), 30);
+	const QByteArray projectionType(typeid(*prj).name());
+	const bool textured = drawMode==SphericalPolygonDrawModeTextureFill;
+	if (cache->subdivisionLevel!=subdivisionLevel || cache->projectionType!=projectionType || cache->textured!=textured
+		|| cache->hasClippingCap!=(clippingCap!=NULL) || (clippingCap && (cache->clippingCap.n!=clippingCap->n || cache->clippingCap.d!=clippingCap->d)))
+	{
+		cache->clear();
+		cache->subdivisionLevel = subdivisionLevel;
+		cache->projectionType = projectionType;
+		cache->textured = textured;
+		cache->hasClippingCap = clippingCap!=NULL;
+		if (clippingCap)
+			cache->clippingCap = *clippingCap;
+		const StelVertexArray fillArray = poly->getFillVertexArray();
+		fillArray.foreachTriangle(TriangleSubdivider(M_PI/(1<<subdivisionLevel), clippingCap, &cache->vertices, textured && fillArray.isTextured() ? &cache->texCoords : NULL));
+	}
+	if (cache->vertices.isEmpty())
+		return;
+	const bool hasTexCoords = !cache->texCoords.isEmpty();
+
+	// Only keep the triangles in the viewport. The ones crossing a projection discontinuity are split
+	// further by projectSphericalTriangle() like in the uncached path, so that they leave no gap.
+	const bool checkViewport = !viewportCap.contains(regionCap);
+	const bool checkDiscontinuity = prj->hasDiscontinuity();
+	const Vec3d* vertices = cache->vertices.constData();
+	polygonTextureCoordArray.clear();
+	int nbVertices = cache->vertices.size();
+	// Kept between the calls to avoid allocations
+	static QVector<Vec3d> visibleVertices;
+	static QVector<int> crossingTriangles;
+	crossingTriangles.resize(0);
+	if (checkViewport || checkDiscontinuity)
+	{
+		visibleVertices.resize(0);
+		visibleVertices.reserve(nbVertices);
+		for (int i=0;i<nbVertices;i+=3)
+		{
+			const Vec3d* v = vertices+i;
+			if (checkViewport && !viewportCap.intersectsTriangle(v))
+				continue;
+			if (checkDiscontinuity && (prj->intersectViewportDiscontinuity(v[0], v[1]) || prj->intersectViewportDiscontinuity(v[1], v[2]) || prj->intersectViewportDiscontinuity(v[2], v[0])))
+			{
+				crossingTriangles.append(i);
+				continue;
+			}
+			visibleVertices.append(v[0]); visibleVertices.append(v[1]); visibleVertices.append(v[2]);
+			if (hasTexCoords)
+				polygonTextureCoordArray.append(cache->texCoords.constData()+i, 3);
+		}
+		vertices = visibleVertices.constData();
+		nbVertices = visibleVertices.size();
+		if (nbVertices==0 && crossingTriangles.isEmpty())
+			return;
+	}
+	else if (hasTexCoords)
+	{
+		polygonTextureCoordArray.append(cache->texCoords.constData(), nbVertices);
+	}
+
+	polygonVertexArray.resize(nbVertices);
+	prj->project(nbVertices, vertices, polygonVertexArray.data());
+	// The split triangles are added after the others, already projected
+	foreach (int i, crossingTriangles)
+		projectSphericalTriangle(clippingCap, cache->vertices.constData()+i, &polygonVertexArray,
+					 hasTexCoords ? cache->texCoords.constData()+i : NULL, hasTexCoords ? &polygonTextureCoordArray : NULL, maxSqDistortion);
+	nbVertices = polygonVertexArray.size();
+	if (nbVertices==0)
+		return;
+
+	glEnable(GL_CULL_FACE);
+	setVertexPointer(3, GL_FLOAT, polygonVertexArray.constData());
+	if (hasTexCoords)
+		setTexCoordPointer(2, GL_FLOAT, polygonTextureCoordArray.constData());
+	enableClientStates(true, hasTexCoords);
+	drawFromArray(StelPainter::Triangles, nbVertices, 0, false);
+	enableClientStates(false);
+	glDisable(GL_CULL_FACE);
+}
+
 
 /*************************************************************************
  draw a simple circle, 2d viewport coordinates in pixel
@@ -1259,9 +1767,18 @@ void StelPainter::drawCircle(const float x, const float y, float r)
 
 
 void StelPainter::drawSprite2dMode(const float x, const float y, float radius)
+{
+	drawSprite2dMode(x, y, radius, Vec4f(0.f, 0.f, 1.f, 1.f));
+}
+
+void StelPainter::drawSprite2dMode(const float x, const float y, float radius, const Vec4f& texRect)
 {
 	static float vertexData[] = {-10.,-10.,10.,-10., 10.,10., -10.,10.};
-	static const float texCoordData[] = {0.,0., 1.,0., 0.,1., 1.,1.};
+	static float texCoordData[8];
+	texCoordData[0]=texRect[0]; texCoordData[1]=texRect[1];
+	texCoordData[2]=texRect[2]; texCoordData[3]=texRect[1];
+	texCoordData[4]=texRect[0]; texCoordData[5]=texRect[3];
+	texCoordData[6]=texRect[2]; texCoordData[7]=texRect[3];
 	
 	// Takes into account device pixel density and global scale ratio, as we are drawing 2D stuff.
 	radius *= prj->getDevicePixelsPerPixel()*StelApp::getInstance().getGlobalScalingRatio();
@@ -1289,6 +1806,13 @@ void StelPainter::drawSprite2dMode(const Vec3d& v, const float radius)
 		drawSprite2dMode(win[0], win[1], radius);
 }
 
+void StelPainter::drawSprite2dMode(const Vec3d& v, const float radius, const Vec4f& texRect)
+{
+	Vec3d win;
+	if (prj->project(v, win))
+		drawSprite2dMode(win[0], win[1], radius, texRect);
+}
+
 void StelPainter::drawSprite2dMode(const float x, const float y, float radius, const float rotation)
 {
 	static float vertexData[8];
@@ -1376,6 +1900,29 @@ void StelPainter::drawLine2d(const float x1, const float y1, const float x2, con
 // GZ This used to draw a full sphere. Now it's possible to have a spherical zone only.
 void StelPainter::sSphere(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside, const bool flipTexture, const float topAngle, const float bottomAngle)
 {
+	SphereMesh* mesh = getSphereMesh(radius, oneMinusOblateness, slices, stacks, orientInside, flipTexture, topAngle, bottomAngle);
+	if (!drawMeshGpu(mesh))
+	{
+		setArrays(mesh->vertices.constData());
+		enableClientStates(true, true);
+		setTexCoordPointer(2, GL_UNSIGNED_SHORT, mesh->texCoords.constData());
+		drawFromArray(Triangles, mesh->indices.size(), 0, true, mesh->indices.constData());
+	}
+}
+
+bool StelPainter::sSphereGpu(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside, const bool flipTexture, const float topAngle, const float bottomAngle)
+{
+	return drawMeshGpu(getSphereMesh(radius, oneMinusOblateness, slices, stacks, orientInside, flipTexture, topAngle, bottomAngle));
+}
+
+StelPainter::SphereMesh* StelPainter::getSphereMesh(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside, const bool flipTexture, const float topAngle, const float bottomAngle)
+{
+	const float params[9] = {0.f, radius, oneMinusOblateness, (float)slices, (float)stacks, (float)orientInside, (float)flipTexture, topAngle, bottomAngle};
+	const QByteArray key((const char*)params, sizeof(params));
+	SphereMesh* mesh = sphereMeshCache.object(key);
+	if (mesh)
+		return mesh;
+
 	GLfloat x, y, z;
 	GLfloat s=0.f, t=0.f;
 	GLint i, j;
@@ -1414,17 +1961,8 @@ void StelPainter::sSphere(const float radius, const float oneMinusOblateness, co
 	const GLfloat ds = (flipTexture ? -1.f : 1.f) / slices;
 	const GLfloat dt = nsign / stacks; // from inside texture is reversed
 
-	// draw intermediate  as quad strips
-	static QVector<double> vertexArr;
-	static QVector<float> texCoordArr;
-	static QVector<float> colorArr;
-	static QVector<unsigned short> indiceArr;
-
-	texCoordArr.resize(0);
-	vertexArr.resize(0);
-	colorArr.resize(0);
-	indiceArr.resize(0);
-
+	// intermediate  as quad strips
+	mesh = new SphereMesh();
 	for (i = 0,cos_sin_rho_p = cos_sin_rho; i < stacks; ++i,cos_sin_rho_p+=2)
 	{
 		s = !flipTexture ? 0.f : 1.f;
@@ -1433,27 +1971,153 @@ void StelPainter::sSphere(const float radius, const float oneMinusOblateness, co
 			x = -cos_sin_theta_p[1] * cos_sin_rho_p[1];
 			y = cos_sin_theta_p[0] * cos_sin_rho_p[1];
 			z = nsign * cos_sin_rho_p[0];
-			texCoordArr << s << t;
-			vertexArr << x * radius << y * radius << z * oneMinusOblateness * radius;
+			mesh->texCoords << packTexCoord(s) << packTexCoord(t);
+			mesh->vertices << Vec3f(x * radius, y * radius, z * oneMinusOblateness * radius);
 			x = -cos_sin_theta_p[1] * cos_sin_rho_p[3];
 			y = cos_sin_theta_p[0] * cos_sin_rho_p[3];
 			z = nsign * cos_sin_rho_p[2];
-			texCoordArr << s << t - dt;
-			vertexArr << x * radius << y * radius << z * oneMinusOblateness * radius;
+			mesh->texCoords << packTexCoord(s) << packTexCoord(t - dt);
+			mesh->vertices << Vec3f(x * radius, y * radius, z * oneMinusOblateness * radius);
 			s += ds;
 		}
 		unsigned int offset = i*(slices+1)*2;
 		for (j = 2;j<slices*2+2;j+=2)
 		{
-			indiceArr << offset+j-2 << offset+j-1 << offset+j;
-			indiceArr << offset+j << offset+j-1 << offset+j+1;
+			mesh->indices << offset+j-2 << offset+j-1 << offset+j;
+			mesh->indices << offset+j << offset+j-1 << offset+j+1;
 		}
 		t -= dt;
 	}
 
-	// Draw the array now
-	setArrays((Vec3d*)vertexArr.constData(), (Vec2f*)texCoordArr.constData());
-	drawFromArray(Triangles, indiceArr.size(), 0, true, indiceArr.constData());
+	sphereMeshCache.insert(key, mesh, mesh->vertices.size());
+	return mesh;
+}
+
+StelPainter::SphereMesh::~SphereMesh()
+{
+	if (vertexBuffer)
+	{
+		vertexBuffer->destroy();
+		delete vertexBuffer;
+	}
+	if (indexBuffer)
+	{
+		indexBuffer->destroy();
+		delete indexBuffer;
+	}
+}
+
+QOpenGLShaderProgram* StelPainter::getProjectionProgram(const QString& name, const QByteArray& forwardTransform,
+							const char* vertexHeader, const char* vertexMain, const char* fsrc)
+{
+	if (forwardTransform.isEmpty())
+		return NULL;
+	QByteArray vsrc(vertexHeader);
+	vsrc += forwardTransform;
+	vsrc += vertexMain;
+	const QByteArray key = vsrc + fsrc;
+	QHash<QByteArray, QOpenGLShaderProgram*>::const_iterator it = projectionPrograms.constFind(key);
+	if (it!=projectionPrograms.constEnd())
+		return it.value();
+
+	QOpenGLShaderProgram* prog = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
+	if (!buildProg(prog, name, vsrc, fsrc))
+	{
+		delete prog;
+		prog = NULL;
+	}
+	projectionPrograms.insert(key, prog);
+	return prog;
+}
+
+QMatrix4x4 StelPainter::toQMatrix(const Mat4f& m)
+{
+	return QMatrix4x4(m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]);
+}
+
+QMatrix4x4 StelPainter::toQMatrix(const Mat4d& m)
+{
+	return QMatrix4x4(m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]);
+}
+
+bool StelPainter::drawMeshGpu(SphereMesh* mesh)
+{
+	static const char* vertexHeader =
+		"attribute highp vec3 vertex;\n"
+		"attribute mediump vec2 texCoord;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"varying mediump vec2 texc;\n";
+	static const char* vertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(vertex, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    texc = texCoord;\n"
+		"}\n";
+	static const char* fsrc =
+		"varying mediump vec2 texc;\n"
+		"uniform sampler2D tex;\n"
+		"uniform mediump vec4 texColor;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_FragColor = texture2D(tex, texc)*texColor;\n"
+		"}\n";
+	QOpenGLShaderProgram* prog = getProjectionProgram("gpuProjectionShader", prj->getForwardTransformShader(), vertexHeader, vertexMain, fsrc);
+	if (!prog)
+		return false;
+
+	flushText();
+	if (!mesh->vertexBuffer)
+	{
+		mesh->vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		mesh->vertexBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+		mesh->vertexBuffer->create();
+		mesh->vertexBuffer->bind();
+		const int verticesSize = mesh->vertices.size()*sizeof(Vec3f);
+		mesh->vertexBuffer->allocate(verticesSize + mesh->texCoords.size()*sizeof(unsigned short));
+		mesh->vertexBuffer->write(0, mesh->vertices.constData(), verticesSize);
+		mesh->vertexBuffer->write(verticesSize, mesh->texCoords.constData(), mesh->texCoords.size()*sizeof(unsigned short));
+		mesh->indexBuffer = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+		mesh->indexBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+		mesh->indexBuffer->create();
+		mesh->indexBuffer->bind();
+		mesh->indexBuffer->allocate(mesh->indices.constData(), mesh->indices.size()*sizeof(unsigned short));
+	}
+	else
+	{
+		mesh->vertexBuffer->bind();
+		mesh->indexBuffer->bind();
+	}
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+	// Refraction, if any, is ignored here as in StarGpuDrawer.
+	const Mat4d mv = prj->getModelViewTransform()->getApproximateLinearTransfo();
+	prog->bind();
+	prog->setUniformValue("projectionMatrix", toQMatrix(prj->getProjectionMatrix()));
+	prog->setUniformValue("modelViewMatrix", toQMatrix(mv));
+	prog->setUniformValue("screenCenter", screenCenter[0], screenCenter[1]);
+	prog->setUniformValue("screenScale", screenScale[0], screenScale[1]);
+	prog->setUniformValue("texColor", currentColor[0], currentColor[1], currentColor[2], currentColor[3]);
+	prog->setUniformValue("tex", 0);
+
+	const int vertexLoc = prog->attributeLocation("vertex");
+	const int texCoordLoc = prog->attributeLocation("texCoord");
+	prog->enableAttributeArray(vertexLoc);
+	prog->enableAttributeArray(texCoordLoc);
+	prog->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 3);
+	prog->setAttributeBuffer(texCoordLoc, GL_UNSIGNED_SHORT, mesh->vertices.size()*sizeof(Vec3f), 2);
+	glDrawElements(GL_TRIANGLES, mesh->indices.size(), GL_UNSIGNED_SHORT, 0);
+	countDrawCall(prog);
+	prog->disableAttributeArray(vertexLoc);
+	prog->disableAttributeArray(texCoordLoc);
+	prog->release();
+	mesh->vertexBuffer->release();
+	mesh->indexBuffer->release();
+	return true;
 }
 
 StelVertexArray StelPainter::computeSphereNoLight(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside, const bool flipTexture)
@@ -1556,7 +2220,6 @@ void StelPainter::initGLShaders()
 {
 	qWarning() << "Intializing basic GL shaders... ";
 	// Basic shader: just vertex filled with plain color
-	QOpenGLShader vshader3(QOpenGLShader::Vertex);
 	const char *vsrc3 =
 		"attribute mediump vec3 vertex;\n"
 		"uniform mediump mat4 projectionMatrix;\n"
@@ -1564,28 +2227,20 @@ void StelPainter::initGLShaders()
 		"{\n"
 		"    gl_Position = projectionMatrix*vec4(vertex, 1.);\n"
 		"}\n";
-	vshader3.compileSourceCode(vsrc3);
-	if (!vshader3.log().isEmpty()) { qWarning() << "StelPainter: Warnings while compiling vshader3: " << vshader3.log(); }
-	QOpenGLShader fshader3(QOpenGLShader::Fragment);
 	const char *fsrc3 =
 		"uniform mediump vec4 color;\n"
 		"void main(void)\n"
 		"{\n"
 		"    gl_FragColor = color;\n"
 		"}\n";
-	fshader3.compileSourceCode(fsrc3);
-	if (!fshader3.log().isEmpty()) { qWarning() << "StelPainter: Warnings while compiling fshader3: " << fshader3.log(); }
 	basicShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	basicShaderProgram->addShader(&vshader3);
-	basicShaderProgram->addShader(&fshader3);
-	linkProg(basicShaderProgram, "basicShaderProgram");
+	buildProg(basicShaderProgram, "basicShaderProgram", vsrc3, fsrc3);
 	basicShaderVars.projectionMatrix = basicShaderProgram->uniformLocation("projectionMatrix");
 	basicShaderVars.color = basicShaderProgram->uniformLocation("color");
 	basicShaderVars.vertex = basicShaderProgram->attributeLocation("vertex");
 	
 
 	// Basic shader: vertex filled with interpolated color
-	QOpenGLShader vshaderInterpolatedColor(QOpenGLShader::Vertex);
 	const char *vshaderInterpolatedColorSrc =
 		"attribute mediump vec3 vertex;\n"
 		"attribute mediump vec4 color;\n"
@@ -1596,31 +2251,19 @@ void StelPainter::initGLShaders()
 		"    gl_Position = projectionMatrix*vec4(vertex, 1.);\n"
 		"    fragcolor = color;\n"
 		"}\n";
-	vshaderInterpolatedColor.compileSourceCode(vshaderInterpolatedColorSrc);
-	if (!vshaderInterpolatedColor.log().isEmpty()) {
-	  qWarning() << "StelPainter: Warnings while compiling vshaderInterpolatedColor: " << vshaderInterpolatedColor.log();
-	}
-	QOpenGLShader fshaderInterpolatedColor(QOpenGLShader::Fragment);
 	const char *fshaderInterpolatedColorSrc =
 		"varying mediump vec4 fragcolor;\n"
 		"void main(void)\n"
 		"{\n"
 		"    gl_FragColor = fragcolor;\n"
 		"}\n";
-	fshaderInterpolatedColor.compileSourceCode(fshaderInterpolatedColorSrc);
-	if (!fshaderInterpolatedColor.log().isEmpty()) {
-	  qWarning() << "StelPainter: Warnings while compiling fshaderInterpolatedColor: " << fshaderInterpolatedColor.log();
-	}
 	colorShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	colorShaderProgram->addShader(&vshaderInterpolatedColor);
-	colorShaderProgram->addShader(&fshaderInterpolatedColor);
-	linkProg(colorShaderProgram, "colorShaderProgram");
+	buildProg(colorShaderProgram, "colorShaderProgram", vshaderInterpolatedColorSrc, fshaderInterpolatedColorSrc);
 	colorShaderVars.projectionMatrix = colorShaderProgram->uniformLocation("projectionMatrix");
 	colorShaderVars.color = colorShaderProgram->attributeLocation("color");
 	colorShaderVars.vertex = colorShaderProgram->attributeLocation("vertex");
 	
 	// Basic texture shader program
-	QOpenGLShader vshader2(QOpenGLShader::Vertex);
 	const char *vsrc2 =
 		"attribute highp vec3 vertex;\n"
 		"attribute mediump vec2 texCoord;\n"
@@ -1631,10 +2274,7 @@ void StelPainter::initGLShaders()
 		"    gl_Position = projectionMatrix * vec4(vertex, 1.);\n"
 		"    texc = texCoord;\n"
 		"}\n";
-	vshader2.compileSourceCode(vsrc2);
-	if (!vshader2.log().isEmpty()) { qWarning() << "StelPainter: Warnings while compiling vshader2: " << vshader2.log(); }
 
-	QOpenGLShader fshader2(QOpenGLShader::Fragment);
 	const char *fsrc2 =
 		"varying mediump vec2 texc;\n"
 		"uniform sampler2D tex;\n"
@@ -1643,13 +2283,9 @@ void StelPainter::initGLShaders()
 		"{\n"
 		"    gl_FragColor = texture2D(tex, texc)*texColor;\n"
 		"}\n";
-	fshader2.compileSourceCode(fsrc2);
-	if (!fshader2.log().isEmpty()) { qWarning() << "StelPainter: Warnings while compiling fshader2: " << fshader2.log(); }
 
 	texturesShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	texturesShaderProgram->addShader(&vshader2);
-	texturesShaderProgram->addShader(&fshader2);
-	linkProg(texturesShaderProgram, "texturesShaderProgram");
+	buildProg(texturesShaderProgram, "texturesShaderProgram", vsrc2, fsrc2);
 	texturesShaderVars.projectionMatrix = texturesShaderProgram->uniformLocation("projectionMatrix");
 	texturesShaderVars.texCoord = texturesShaderProgram->attributeLocation("texCoord");
 	texturesShaderVars.vertex = texturesShaderProgram->attributeLocation("vertex");
@@ -1657,7 +2293,6 @@ void StelPainter::initGLShaders()
 	texturesShaderVars.texture = texturesShaderProgram->uniformLocation("tex");
 
 	// Texture shader program + interpolated color per vertex
-	QOpenGLShader vshader4(QOpenGLShader::Vertex);
 	const char *vsrc4 =
 		"attribute highp vec3 vertex;\n"
 		"attribute mediump vec2 texCoord;\n"
@@ -1671,10 +2306,7 @@ void StelPainter::initGLShaders()
 		"    texc = texCoord;\n"
 		"    outColor = color;\n"
 		"}\n";
-	vshader4.compileSourceCode(vsrc4);
-	if (!vshader4.log().isEmpty()) { qWarning() << "StelPainter: Warnings while compiling vshader4: " << vshader4.log(); }
 
-	QOpenGLShader fshader4(QOpenGLShader::Fragment);
 	const char *fsrc4 =
 		"varying mediump vec2 texc;\n"
 		"varying mediump vec4 outColor;\n"
@@ -1683,18 +2315,17 @@ void StelPainter::initGLShaders()
 		"{\n"
 		"    gl_FragColor = texture2D(tex, texc)*outColor;\n"
 		"}\n";
-	fshader4.compileSourceCode(fsrc4);
-	if (!fshader4.log().isEmpty()) { qWarning() << "StelPainter: Warnings while compiling fshader4: " << fshader4.log(); }
 
 	texturesColorShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	texturesColorShaderProgram->addShader(&vshader4);
-	texturesColorShaderProgram->addShader(&fshader4);
-	linkProg(texturesColorShaderProgram, "texturesColorShaderProgram");
+	buildProg(texturesColorShaderProgram, "texturesColorShaderProgram", vsrc4, fsrc4);
 	texturesColorShaderVars.projectionMatrix = texturesColorShaderProgram->uniformLocation("projectionMatrix");
 	texturesColorShaderVars.texCoord = texturesColorShaderProgram->attributeLocation("texCoord");
 	texturesColorShaderVars.vertex = texturesColorShaderProgram->attributeLocation("vertex");
 	texturesColorShaderVars.color = texturesColorShaderProgram->attributeLocation("color");
 	texturesColorShaderVars.texture = texturesColorShaderProgram->uniformLocation("tex");
+
+	if (StelApp::getInstance().getSettings()->value("video/flag_text_glyph_atlas", true).toBool())
+		textAtlas = new StelTextAtlas();
 }
 
 
@@ -1708,6 +2339,18 @@ void StelPainter::deinitGLShaders()
 	texturesShaderProgram = NULL;
 	delete texturesColorShaderProgram;
 	texturesColorShaderProgram = NULL;
+	delete textAtlas;
+	textAtlas = NULL;
+	textAtlasOwner = NULL;
+	// The GPU buffers of the meshes must be released while the GL context is still there
+	sphereMeshCache.clear();
+	foreach (QOpenGLShaderProgram* prog, projectionPrograms)
+		delete prog;
+	projectionPrograms.clear();
+	delete streamVertexBuffer;
+	streamVertexBuffer = NULL;
+	delete streamIndexBuffer;
+	streamIndexBuffer = NULL;
 }
 
 
@@ -1739,6 +2382,10 @@ void StelPainter::enableClientStates(const bool vertex, const bool texture, cons
 
 void StelPainter::drawFromArray(const DrawingMode mode, const int count, const int offset, const bool doProj, const unsigned short* indices)
 {
+	// In batch mode the texts are drawn after the recorded draws
+	if (!batching || normalArray.enabled)
+		flushText();
+
 	ArrayDesc projectedVertexArray = vertexArray;
 	if (doProj)
 	{
@@ -1749,14 +2396,21 @@ void StelPainter::drawFromArray(const DrawingMode mode, const int count, const i
 			projectedVertexArray = projectArray(vertexArray, offset, count, NULL);
 	}
 
+	if (batching && !normalArray.enabled)
+	{
+		recordBatchCommand(mode, count, offset, projectedVertexArray, indices);
+		return;
+	}
+
 	QOpenGLShaderProgram* pr=NULL;
+	int vertexLocation, texCoordLocation=-1, colorLocation=-1;
 
-	const Mat4f& m = getProjector()->getProjectionMatrix();
-	const QMatrix4x4 qMat(m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]);
+	const QMatrix4x4 qMat = toQMatrix(getProjector()->getProjectionMatrix());
 
 	if (!texCoordArray.enabled && !colorArray.enabled && !normalArray.enabled)
 	{
 		pr = basicShaderProgram;
+		vertexLocation = basicShaderVars.vertex;
 		pr->bind();
 		pr->setAttributeArray(basicShaderVars.vertex, (const GLfloat*)projectedVertexArray.pointer, projectedVertexArray.size);
 		pr->enableAttributeArray(basicShaderVars.vertex);
@@ -1766,36 +2420,43 @@ void StelPainter::drawFromArray(const DrawingMode mode, const int count, const i
 	else if (texCoordArray.enabled && !colorArray.enabled && !normalArray.enabled)
 	{
 		pr = texturesShaderProgram;
+		vertexLocation = texturesShaderVars.vertex;
+		texCoordLocation = texturesShaderVars.texCoord;
 		pr->bind();
 		pr->setAttributeArray(texturesShaderVars.vertex, (const GLfloat*)projectedVertexArray.pointer, projectedVertexArray.size);
 		pr->enableAttributeArray(texturesShaderVars.vertex);
 		pr->setUniformValue(texturesShaderVars.projectionMatrix, qMat);
 		pr->setUniformValue(texturesShaderVars.texColor, currentColor[0], currentColor[1], currentColor[2], currentColor[3]);
-		pr->setAttributeArray(texturesShaderVars.texCoord, (const GLfloat*)texCoordArray.pointer, 2);
+		pr->setAttributeArray(texturesShaderVars.texCoord, texCoordArray.type, texCoordArray.pointer, 2);
 		pr->enableAttributeArray(texturesShaderVars.texCoord);
 		//pr->setUniformValue(texturesShaderVars.texture, 0);    // use texture unit 0
 	}
 	else if (texCoordArray.enabled && colorArray.enabled && !normalArray.enabled)
 	{
 		pr = texturesColorShaderProgram;
+		vertexLocation = texturesColorShaderVars.vertex;
+		texCoordLocation = texturesColorShaderVars.texCoord;
+		colorLocation = texturesColorShaderVars.color;
 		pr->bind();
 		pr->setAttributeArray(texturesColorShaderVars.vertex, (const GLfloat*)projectedVertexArray.pointer, projectedVertexArray.size);
 		pr->enableAttributeArray(texturesColorShaderVars.vertex);
 		pr->setUniformValue(texturesColorShaderVars.projectionMatrix, qMat);
-		pr->setAttributeArray(texturesColorShaderVars.texCoord, (const GLfloat*)texCoordArray.pointer, 2);
+		pr->setAttributeArray(texturesColorShaderVars.texCoord, texCoordArray.type, texCoordArray.pointer, 2);
 		pr->enableAttributeArray(texturesColorShaderVars.texCoord);
-		pr->setAttributeArray(texturesColorShaderVars.color, (const GLfloat*)colorArray.pointer, colorArray.size);
+		pr->setAttributeArray(texturesColorShaderVars.color, colorArray.type, colorArray.pointer, colorArray.size);
 		pr->enableAttributeArray(texturesColorShaderVars.color);
 		//pr->setUniformValue(texturesShaderVars.texture, 0);    // use texture unit 0
 	}
 	else if (!texCoordArray.enabled && colorArray.enabled && !normalArray.enabled)
 	{
 		pr = colorShaderProgram;
+		vertexLocation = colorShaderVars.vertex;
+		colorLocation = colorShaderVars.color;
 		pr->bind();
 		pr->setAttributeArray(colorShaderVars.vertex, (const GLfloat*)projectedVertexArray.pointer, projectedVertexArray.size);
 		pr->enableAttributeArray(colorShaderVars.vertex);
 		pr->setUniformValue(colorShaderVars.projectionMatrix, qMat);
-		pr->setAttributeArray(colorShaderVars.color, (const GLfloat*)colorArray.pointer, colorArray.size);
+		pr->setAttributeArray(colorShaderVars.color, colorArray.type, colorArray.pointer, colorArray.size);
 		pr->enableAttributeArray(colorShaderVars.color);
 	}
 	else
@@ -1805,10 +2466,42 @@ void StelPainter::drawFromArray(const DrawingMode mode, const int count, const i
 		return;
 	}
 	
-	if (indices)
+	if (flagVertexBuffersOnly)
+	{
+		// The indices refer to the vertices from the first one
+		int first = offset;
+		int nbVertices = count;
+		if (indices)
+		{
+			unsigned short max = 0;
+			for (int i=offset;i<offset+count;++i)
+				max = std::max(max, indices[i]);
+			first = 0;
+			nbVertices = max+1;
+		}
+		streamArrays(pr, first, nbVertices, vertexLocation, projectedVertexArray, texCoordLocation, texCoordArray, colorLocation, colorArray);
+		if (indices)
+		{
+			if (!streamIndexBuffer)
+			{
+				streamIndexBuffer = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+				streamIndexBuffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+				streamIndexBuffer->create();
+			}
+			streamIndexBuffer->bind();
+			streamIndexBuffer->allocate(indices + offset, count*sizeof(unsigned short));
+			glDrawElements(mode, count, GL_UNSIGNED_SHORT, 0);
+			streamIndexBuffer->release();
+		}
+		else
+			glDrawArrays(mode, 0, count);
+		streamVertexBuffer->release();
+	}
+	else if (indices)
 		glDrawElements(mode, count, GL_UNSIGNED_SHORT, indices + offset);
 	else
 		glDrawArrays(mode, offset, count);
+	countDrawCall(pr);
 
 	if (pr==texturesColorShaderProgram)
 	{
@@ -1835,26 +2528,311 @@ void StelPainter::drawFromArray(const DrawingMode mode, const int count, const i
 }
 
 
+void StelPainter::beginBatch()
+{
+	flushText();
+	batching = true;
+}
+
+void StelPainter::endBatch()
+{
+	if (!batching)
+		return;
+	executeBatch();
+	batching = false;
+}
+
+void StelPainter::recordBatchCommand(const DrawingMode mode, const int count, const int offset, const ArrayDesc& projectedVertexArray, const unsigned short* indices)
+{
+	if (count<=0)
+		return;
+
+	// Convert the strips, loops and fans so that the consecutive draws can be merged
+	QVarLengthArray<int, 64> order;
+	DrawingMode primitive;
+	switch (mode)
+	{
+		case Points:
+		case Lines:
+		case Triangles:
+			primitive = mode;
+			for (int i=0;i<count;++i)
+				order.append(i);
+			break;
+		case LineStrip:
+		case LineLoop:
+			primitive = Lines;
+			for (int i=0;i<count-1;++i)
+			{
+				order.append(i);
+				order.append(i+1);
+			}
+			if (mode==LineLoop && count>2)
+			{
+				order.append(count-1);
+				order.append(0);
+			}
+			break;
+		case TriangleStrip:
+			primitive = Triangles;
+			// Keep the orientation of the triangles of the strip
+			for (int i=0;i<count-2;++i)
+			{
+				order.append(i%2 ? i+1 : i);
+				order.append(i%2 ? i : i+1);
+				order.append(i+2);
+			}
+			break;
+		case TriangleFan:
+			primitive = Triangles;
+			for (int i=1;i<count-1;++i)
+			{
+				order.append(0);
+				order.append(i);
+				order.append(i+1);
+			}
+			break;
+		default:
+			Q_ASSERT(0);
+			return;
+	}
+
+	BatchCommand cmd;
+	cmd.mode = primitive;
+	cmd.texture = 0;
+	if (texCoordArray.enabled)
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &cmd.texture);
+	cmd.blend = glIsEnabled(GL_BLEND);
+	glGetIntegerv(GL_BLEND_SRC_RGB, &cmd.blendSrcRGB);
+	glGetIntegerv(GL_BLEND_DST_RGB, &cmd.blendDstRGB);
+	glGetIntegerv(GL_BLEND_SRC_ALPHA, &cmd.blendSrcAlpha);
+	glGetIntegerv(GL_BLEND_DST_ALPHA, &cmd.blendDstAlpha);
+	cmd.first = batchVertices.size();
+	cmd.count = order.size();
+
+	const GLfloat* vertices = (const GLfloat*)projectedVertexArray.pointer;
+	for (int i=0;i<order.size();++i)
+	{
+		const int v = indices ? indices[offset+order[i]] : offset+order[i];
+		const GLfloat* pos = vertices+v*projectedVertexArray.size;
+		batchVertices.append(Vec3f(pos[0], pos[1], projectedVertexArray.size>2 ? pos[2] : 0.f));
+		if (cmd.texture)
+			batchTexCoords.append(Vec2f(getArrayValue(texCoordArray, v, 0), getArrayValue(texCoordArray, v, 1)));
+		else
+			batchTexCoords.append(Vec2f(0.f, 0.f));
+		if (colorArray.enabled)
+		{
+			batchColors.append(Vec4f(getArrayValue(colorArray, v, 0), getArrayValue(colorArray, v, 1), getArrayValue(colorArray, v, 2),
+						 colorArray.size>3 ? getArrayValue(colorArray, v, 3) : 1.f));
+		}
+		else
+			batchColors.append(currentColor);
+	}
+	batchCommands.append(cmd);
+}
+
+void StelPainter::streamArrays(QOpenGLShaderProgram* pr, int first, int count, int vertexLocation, const ArrayDesc& vertices,
+			       int texCoordLocation, const ArrayDesc& texCoords, int colorLocation, const ArrayDesc& colors)
+{
+	if (!streamVertexBuffer)
+	{
+		streamVertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		streamVertexBuffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+		streamVertexBuffer->create();
+	}
+	const int vertexBytes = count*vertices.size*sizeof(GLfloat);
+	const int texCoordBytes = texCoordLocation>=0 ? count*texCoords.size*getTypeSize(texCoords.type) : 0;
+	const int colorBytes = colorLocation>=0 ? count*4 : 0;
+	streamVertexBuffer->bind();
+	// Allocating again orphans the data of the previous draw, which the GPU may still be reading
+	streamVertexBuffer->allocate(vertexBytes+texCoordBytes+colorBytes);
+	streamVertexBuffer->write(0, (const GLfloat*)vertices.pointer + first*vertices.size, vertexBytes);
+	pr->setAttributeBuffer(vertexLocation, GL_FLOAT, 0, vertices.size);
+	if (texCoordLocation>=0)
+	{
+		streamVertexBuffer->write(vertexBytes, (const char*)texCoords.pointer + first*texCoords.size*getTypeSize(texCoords.type), texCoordBytes);
+		pr->setAttributeBuffer(texCoordLocation, texCoords.type, vertexBytes, texCoords.size);
+	}
+	if (colorLocation>=0 && colors.type==GL_UNSIGNED_BYTE)
+	{
+		Q_ASSERT(colors.size==4);
+		streamVertexBuffer->write(vertexBytes+texCoordBytes, (const GLubyte*)colors.pointer + first*4, colorBytes);
+		pr->setAttributeBuffer(colorLocation, GL_UNSIGNED_BYTE, vertexBytes+texCoordBytes, 4);
+	}
+	else if (colorLocation>=0)
+	{
+		// 4 bytes per color instead of 12 or 16, normalized back to [0,1] by the attribute
+		static QVector<GLubyte> packedColors;
+		packedColors.resize(count*4);
+		const GLfloat* c = (const GLfloat*)colors.pointer + first*colors.size;
+		for (int i=0;i<count;++i,c+=colors.size)
+		{
+			for (int k=0;k<4;++k)
+				packedColors[i*4+k] = k<colors.size ? (GLubyte)(qBound(0.f, c[k], 1.f)*255.f+0.5f) : 255;
+		}
+		streamVertexBuffer->write(vertexBytes+texCoordBytes, packedColors.constData(), colorBytes);
+		pr->setAttributeBuffer(colorLocation, GL_UNSIGNED_BYTE, vertexBytes+texCoordBytes, 4);
+	}
+}
+
+void StelPainter::executeBatch()
+{
+	if (batchCommands.isEmpty())
+		return;
+
+	// Group the runs of additive draws by state
+	const int nbCommands = batchCommands.size();
+	for (int start=0;start<nbCommands;)
+	{
+		int end = start;
+		while (end<nbCommands && batchCommands.at(end).isAdditive())
+			++end;
+		if (end-start>1)
+			std::stable_sort(batchCommands.begin()+start, batchCommands.begin()+end);
+		start = end>start ? end : start+1;
+	}
+
+	StelPainter::GLState state;
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	const QMatrix4x4 qMat = toQMatrix(getProjector()->getProjectionMatrix());
+
+	GLint lastTexture = 0;
+	bool lastBlend = state.blend;
+
+	// The merged draws are copied in contiguous arrays
+	static QVector<Vec3f> vertices;
+	static QVector<Vec2f> texCoords;
+	static QVector<Vec4f> colors;
+	for (int i=0;i<nbCommands;)
+	{
+		const BatchCommand& cmd = batchCommands.at(i);
+		vertices.resize(0);
+		texCoords.resize(0);
+		colors.resize(0);
+		int j = i;
+		for (;j<nbCommands && batchCommands.at(j).canMerge(cmd);++j)
+		{
+			const BatchCommand& other = batchCommands.at(j);
+			for (int k=other.first;k<other.first+other.count;++k)
+			{
+				vertices.append(batchVertices.at(k));
+				texCoords.append(batchTexCoords.at(k));
+				colors.append(batchColors.at(k));
+			}
+		}
+
+		if (cmd.blend)
+		{
+			glEnable(GL_BLEND);
+			glBlendFuncSeparate(cmd.blendSrcRGB, cmd.blendDstRGB, cmd.blendSrcAlpha, cmd.blendDstAlpha);
+		}
+		else
+			glDisable(GL_BLEND);
+
+		QOpenGLShaderProgram* pr;
+		int vertexLocation, colorLocation, texCoordLocation=-1;
+		if (cmd.texture)
+		{
+			glBindTexture(GL_TEXTURE_2D, cmd.texture);
+			pr = texturesColorShaderProgram;
+			pr->bind();
+			vertexLocation = texturesColorShaderVars.vertex;
+			colorLocation = texturesColorShaderVars.color;
+			texCoordLocation = texturesColorShaderVars.texCoord;
+			pr->setUniformValue(texturesColorShaderVars.projectionMatrix, qMat);
+			pr->setAttributeArray(texCoordLocation, (const GLfloat*)texCoords.constData(), 2);
+			pr->enableAttributeArray(texCoordLocation);
+		}
+		else
+		{
+			pr = colorShaderProgram;
+			pr->bind();
+			vertexLocation = colorShaderVars.vertex;
+			colorLocation = colorShaderVars.color;
+			pr->setUniformValue(colorShaderVars.projectionMatrix, qMat);
+		}
+		pr->setAttributeArray(vertexLocation, (const GLfloat*)vertices.constData(), 3);
+		pr->enableAttributeArray(vertexLocation);
+		pr->setAttributeArray(colorLocation, (const GLfloat*)colors.constData(), 4);
+		pr->enableAttributeArray(colorLocation);
+		if (flagVertexBuffersOnly)
+		{
+			ArrayDesc vertexDesc, texCoordDesc, colorDesc;
+			vertexDesc.size = 3; vertexDesc.type = GL_FLOAT; vertexDesc.pointer = vertices.constData();
+			texCoordDesc.size = 2; texCoordDesc.type = GL_FLOAT; texCoordDesc.pointer = texCoords.constData();
+			colorDesc.size = 4; colorDesc.type = GL_FLOAT; colorDesc.pointer = colors.constData();
+			streamArrays(pr, 0, vertices.size(), vertexLocation, vertexDesc, texCoordLocation, texCoordDesc, colorLocation, colorDesc);
+			glDrawArrays(cmd.mode, 0, vertices.size());
+			streamVertexBuffer->release();
+		}
+		else
+			glDrawArrays(cmd.mode, 0, vertices.size());
+		countDrawCall(pr, cmd.texture!=lastTexture || cmd.blend!=lastBlend);
+		lastTexture = cmd.texture;
+		lastBlend = cmd.blend;
+		pr->disableAttributeArray(vertexLocation);
+		pr->disableAttributeArray(colorLocation);
+		if (texCoordLocation>=0)
+			pr->disableAttributeArray(texCoordLocation);
+		pr->release();
+		i = j;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+	batchCommands.resize(0);
+	batchVertices.resize(0);
+	batchTexCoords.resize(0);
+	batchColors.resize(0);
+}
+
+float StelPainter::getArrayValue(const ArrayDesc& array, int v, int k)
+{
+	const int i = v*array.size+k;
+	switch (array.type)
+	{
+		case GL_UNSIGNED_BYTE:
+			return ((const GLubyte*)array.pointer)[i]/255.f;
+		case GL_UNSIGNED_SHORT:
+			return ((const GLushort*)array.pointer)[i]/65535.f;
+		case GL_DOUBLE:
+			return ((const double*)array.pointer)[i];
+		default:
+			return ((const GLfloat*)array.pointer)[i];
+	}
+}
+
+int StelPainter::getTypeSize(int type)
+{
+	switch (type)
+	{
+		case GL_UNSIGNED_BYTE:
+			return 1;
+		case GL_UNSIGNED_SHORT:
+			return 2;
+		case GL_DOUBLE:
+			return 8;
+		default:
+			return 4;
+	}
+}
+
 StelPainter::ArrayDesc StelPainter::projectArray(const StelPainter::ArrayDesc& array, int offset, int count, const unsigned short* indices)
 {
-	// XXX: we should use a more generic way to test whether or not to do the projection.
-	if (dynamic_cast<StelProjector2d*>(prj.data()))
+	if (prj->isScreen2d())
 	{
 		return array;
 	}
 
 	Q_ASSERT(array.size == 3);
-	Q_ASSERT(array.type == GL_DOUBLE);
-	Vec3d* vecArray = (Vec3d*)array.pointer;
+	Q_ASSERT(array.type == GL_DOUBLE || array.type == GL_FLOAT);
 
 	// We have two different cases :
 	// 1) We are not using an indice array.  In that case the size of the array is known
 	// 2) We are using an indice array.  In that case we have to find the max value by iterating through the indices.
-	if (!indices)
-	{
-		polygonVertexArray.resize(offset + count);
-		prj->project(count, vecArray + offset, polygonVertexArray.data() + offset);
-	} else
+	int first = offset;
+	int nbVertices = count;
+	if (indices)
 	{
 		// we need to find the max value of the indices !
 		unsigned short max = 0;
@@ -1862,9 +2840,31 @@ StelPainter::ArrayDesc StelPainter::projectArray(const StelPainter::ArrayDesc& a
 		{
 			max = std::max(max, indices[i]);
 		}
-		polygonVertexArray.resize(max+1);
-		prj->project(max + 1, vecArray + offset, polygonVertexArray.data() + offset);
+		first = 0;
+		nbVertices = max+1;
+	}
+
+	const Vec3d* vecArray = (const Vec3d*)array.pointer + first;
+	if (array.type == GL_FLOAT || vertexOrigin != Vec3d(0.))
+	{
+		// The compact vertices are converted back to double before being put at their origin
+		static QVector<Vec3d> absoluteVertices;
+		absoluteVertices.resize(nbVertices);
+		if (array.type == GL_FLOAT)
+		{
+			const Vec3f* v = (const Vec3f*)array.pointer + first;
+			for (int i = 0; i < nbVertices; ++i)
+				absoluteVertices[i].set(vertexOrigin[0]+v[i][0], vertexOrigin[1]+v[i][1], vertexOrigin[2]+v[i][2]);
+		}
+		else
+		{
+			for (int i = 0; i < nbVertices; ++i)
+				absoluteVertices[i] = vecArray[i] + vertexOrigin;
+		}
+		vecArray = absoluteVertices.constData();
 	}
+	polygonVertexArray.resize(first + nbVertices);
+	prj->project(nbVertices, vecArray, polygonVertexArray.data() + first);
 
 	ArrayDesc ret;
 	ret.size = 3;
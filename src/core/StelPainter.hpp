@@ -28,8 +28,40 @@
 #include <QString>
 #include <QVarLengthArray>
 #include <QFontMetrics>
+#include <QCache>
+#include <QMap>
+#include <QHash>
 
+class QOpenGLBuffer;
 class QOpenGLShaderProgram;
+class QMatrix4x4;
+
+//! @class SphericalRegionDrawCache
+//! Keep the triangles of a static SphericalRegion subdivided for drawing, so that
+//! StelPainter::drawSphericalRegion() does not need to subdivide them again at each frame.
+//! The triangles are only computed again when the projection type, the zoom level or the
+//! clipping cap change. An instance must be used with one region only, and be cleared when
+//! the region is modified.
+class SphericalRegionDrawCache
+{
+public:
+	SphericalRegionDrawCache() : subdivisionLevel(-1), hasClippingCap(false), textured(false) {;}
+
+	//! Discard the cached triangles.
+	void clear() {subdivisionLevel=-1; vertices.clear(); texCoords.clear();}
+
+private:
+	friend class StelPainter;
+	QByteArray projectionType;
+	//! The number of times the maximum edge angle was halved from 180 deg, -1 if the cache is empty.
+	int subdivisionLevel;
+	bool hasClippingCap;
+	SphericalCap clippingCap;
+	bool textured;
+	//! The subdivided triangles in the frame of the region.
+	QVector<Vec3d> vertices;
+	QVector<Vec2f> texCoords;
+};
 
 //! @class StelPainter
 //! Provides functions for performing openGL drawing operations.
@@ -95,6 +127,17 @@ public:
 	//! Typically set that to false if you think that the region is fully contained in the viewport.
 	void drawSphericalRegion(const SphericalRegion* region, SphericalPolygonDrawMode drawMode=SphericalPolygonDrawModeFill, const SphericalCap* clippingCap=NULL, bool doSubDivise=true, double maxSqDistortion=5.);
 
+	//! Draw the given static SphericalRegion, reusing the triangles subdivided in the previous calls.
+	//! Instead of following the projection distortions, the triangles are subdivided until their edges
+	//! are short enough for the distortion to stay under the limit at the current zoom level.
+	//! They are then kept in the cache, and only need to be projected in the next frames.
+	//! @param region The SphericalRegion to draw.
+	//! @param cache the cache associated to this region.
+	//! @param drawMode define whether to draw the outline or the fill. The outline is not cached.
+	//! @param clippingCap if not set to NULL, tells the painter to try to clip part of the region outside the cap.
+	//! @param maxSqDistortion the maximum square distance in pixel between a projected edge and the real curve.
+	void drawSphericalRegion(const SphericalRegion* region, SphericalRegionDrawCache* cache, SphericalPolygonDrawMode drawMode=SphericalPolygonDrawModeFill, const SphericalCap* clippingCap=NULL, double maxSqDistortion=5.);
+
 	void drawGreatCircleArcs(const StelVertexArray& va, const SphericalCap* clippingCap=NULL);
 
 	void drawSphericalTriangles(const StelVertexArray& va, const bool textured, const SphericalCap* clippingCap=NULL, const bool doSubDivide=true, const double maxSqDistortion=5.);
@@ -126,6 +169,10 @@ public:
 	//! @param v direction vector of object to draw. GZ20120826: Will draw only if this is in the visible hemisphere.
 	void drawSprite2dMode(const float x, const float y, float radius);
 	void drawSprite2dMode(const Vec3d& v, const float radius);
+	//! Same as drawSprite2dMode but only draw a part of the current texture, like a sprite of the sprite atlas.
+	//! @param texRect the texture coordinates of the part, as (left, bottom, right, top).
+	void drawSprite2dMode(const float x, const float y, float radius, const Vec4f& texRect);
+	void drawSprite2dMode(const Vec3d& v, const float radius, const Vec4f& texRect);
 
 	//! Same as drawSprite2dMode but don't scale according to display device scaling. 
 	void drawSprite2dModeNoDeviceScale(const float x, const float y, const float radius);
@@ -174,9 +221,16 @@ public:
 	//!        region around the bottom pole, like for a spherical equirectangular horizon panorama (SphericalLandscape class).
 	//!        Example: your light pollution image (pano photo) goes down to just -5 degrees altitude (lowest street lamps below you):
 	//!        bottomAngle = 95 degrees = 95*M_PI/180.0f
+	//! The tessellated spheres are cached, and drawn from static GPU buffers with the projection done in the vertex shader
+	//! when the projection provides a StelProjector::getForwardTransformShader().
 	void sSphere(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside = 0, const bool flipTexture = false,
 				 const float topAngle=0.0f, const float bottomAngle=M_PI);
 
+	//! Draw the same sphere as sSphere() but only if the projection can be done on the GPU.
+	//! @return false if nothing was drawn, in which case the caller has to use its own CPU path.
+	bool sSphereGpu(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside = 0, const bool flipTexture = false,
+				 const float topAngle=0.0f, const float bottomAngle=M_PI);
+
 	//! Generate a StelVertexArray for a sphere.
 	static StelVertexArray computeSphereNoLight(const float radius, const float oneMinusOblateness, const int slices, const int stacks,
 												const int orientInside = 0, const bool flipTexture = false);
@@ -194,12 +248,15 @@ public:
 	//! @param texCoordArr the vertex array in which the resulting texture coordinates are returned.
 	static void computeFanDisk(float radius, int innerFanSlices, int level, QVector<double>& vertexArr, QVector<float>& texCoordArr);
 
-	//! Draw a fisheye texture in a sphere.
+	//! Draw a fisheye texture in a sphere. The tessellation is cached like for sSphere().
 	void sSphereMap(const float radius, const int slices, const int stacks, const float textureFov = 2.f*M_PI, const int orientInside = 0);
 
 	//! Set the font to use for subsequent text drawing.
 	void setFont(const QFont& font);
 
+	//! Get the font currently used for drawing text.
+	const QFont& getFont() const {return currentFont;}
+
 	//! Set the color to use for subsequent drawing.
 	void setColor(float r, float g, float b, float a=1.f);
 
@@ -222,17 +279,26 @@ public:
 
 	// Thoses methods should eventually be replaced by a single setVertexArray
 	//! use instead of glVertexPointer
+	//! The projected vertices can be GL_DOUBLE or GL_FLOAT, the latter relative to the origin set by setVertexOrigin().
 	void setVertexPointer(const int size, const int type, const void* pointer) {
 		vertexArray.size = size; vertexArray.type = type; vertexArray.pointer = pointer;
+		vertexOrigin.set(0., 0., 0.);
 	}
 
+	//! Set the position added to the vertices when they are projected, until the next setVertexPointer().
+	//! This allows storing the vertices of an object far from the origin, like an orbit around its parent body,
+	//! as floats without losing precision: they are converted to double before the origin is added.
+	void setVertexOrigin(const Vec3d& origin) {vertexOrigin = origin;}
+
 	//! use instead of glTexCoordPointer
+	//! The coordinates can be GL_FLOAT, or GL_UNSIGNED_SHORT normalized to [0, 1].
 	void setTexCoordPointer(const int size, const int type, const void* pointer)
 	{
 		texCoordArray.size = size; texCoordArray.type = type; texCoordArray.pointer = pointer;
 	}
 
 	//! use instead of glColorPointer
+	//! The colors can be GL_FLOAT, or 4 GL_UNSIGNED_BYTE normalized to [0, 1].
 	void setColorPointer(const int size, const int type, const void* pointer)
 	{
 		colorArray.size = size; colorArray.type = type; colorArray.pointer = pointer;
@@ -267,6 +333,50 @@ public:
 	//! @return true if the link was successful.
 	static bool linkProg(class QOpenGLShaderProgram* prog, const QString& name);
 
+	//! Compile and link an opengl program from the sources of its vertex and fragment shaders, and show a message
+	//! in case of error or warnings. When the driver supports binary programs, the linked program is saved in the
+	//! shader cache of the cache directory, and loaded from there at the next starts instead of being compiled.
+	//! @return true if the link was successful.
+	static bool buildProg(class QOpenGLShaderProgram* prog, const QString& name, const QByteArray& vsrc, const QByteArray& fsrc);
+
+	//! Get a program doing the projection of a projector in its vertex shader, built with buildProg() on first use and
+	//! kept until deinitGLShaders(). The vertex shader is made of vertexHeader, the function projectorForwardTransform()
+	//! given by StelProjector::getForwardTransformShader(), and vertexMain which calls it. The programs are cached by
+	//! their sources, the ones which failed to build included, so that they are not built again at each frame.
+	//! @param name the name of the program in the messages.
+	//! @return the linked program, or NULL if the forward transform is empty or the program could not be built.
+	static QOpenGLShaderProgram* getProjectionProgram(const QString& name, const QByteArray& forwardTransform,
+							  const char* vertexHeader, const char* vertexMain, const char* fsrc);
+
+	//! Draw the texts waiting in the glyph atlas batch, whichever painter added them.
+	//! To be called before drawing directly with OpenGL, so that the texts drawn before stay under the new primitives.
+	static void flushPendingText();
+
+	//! Convert a matrix to the column major order of the Qt shader programs.
+	static QMatrix4x4 toQMatrix(const Mat4f& m);
+	static QMatrix4x4 toQMatrix(const Mat4d& m);
+
+	//! Record the draws of drawFromArray() instead of executing them at once, until endBatch() is called or the
+	//! painter is destroyed. The recorded draws are then executed with as few state changes as possible: the
+	//! consecutive draws with the same texture and blending are merged in one draw call, and the consecutive draws
+	//! with an additive blending, whose order doesn't matter, are grouped by texture first.
+	//! The texture and blending used are the ones current when each draw is recorded. Between beginBatch() and
+	//! endBatch() the drawing must only be done with the painter, and the texts are drawn over the recorded draws.
+	void beginBatch();
+	//! Execute the draws recorded since beginBatch() and go back to the immediate drawing.
+	void endBatch();
+
+	//! Set the region of the viewport drawn in the current render target, for the painters created afterward.
+	//! The coordinates stay the ones of the whole viewport, only the GL viewport is changed so that the pixel
+	//! p of the viewport is drawn at (p-(x,y))*scale in the render target.
+	//! This is used to draw parts of the viewport at other resolutions. Use (0,0,1) to draw the whole viewport.
+	static void setRenderRegion(float x, float y, float scale);
+
+	//! Set whether the arrays are copied to a stream vertex buffer before each draw instead of being drawn as
+	//! client arrays, as preferred by the GLES2 class drivers. The colors are then packed in bytes, clamped to [0,1].
+	static void setFlagVertexBuffersOnly(bool b) {flagVertexBuffersOnly=b;}
+	static bool getFlagVertexBuffersOnly() {return flagVertexBuffersOnly;}
+
 private:
 
 	friend class StelTextureMgr;
@@ -289,11 +399,16 @@ private:
 	{
 		ArrayDesc() : size(0), type(0), pointer(NULL), enabled(false) {}
 		int size;				// The number of coordinates per vertex.
-		int type;				// The data type of each coordinate (GL_SHORT, GL_INT, GL_FLOAT, or GL_DOUBLE).
+		int type;				// The data type of each coordinate (GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_FLOAT, or GL_DOUBLE).
 		const void* pointer;	// Pointer to the first coordinate of the first vertex in the array.
 		bool enabled;			// Define whether the array is enabled or not.
 	} ArrayDesc;
 
+	//! Get the component k of the vertex v of an array as a float, the integer types being normalized to [0, 1].
+	static float getArrayValue(const ArrayDesc& array, int v, int k);
+	//! Get the size in bytes of a component of an array.
+	static int getTypeSize(int type);
+
 	//! Project an array using the current projection.
 	//! @return a descriptor of the new array
 	ArrayDesc projectArray(const ArrayDesc& array, int offset, int count, const unsigned short *indices=NULL);
@@ -310,13 +425,111 @@ private:
 
 	void drawTextGravity180(float x, float y, const QString& str, const float xshift = 0, const float yshift = 0);
 
+	//! Execute the recorded draws and draw the texts accumulated in the glyph atlas batch.
+	//! Called before any other drawing and when the painter is destroyed, so that the texts stay in order.
+	void flushText();
+
+	//! Set the OpenGL viewport of the projector, restricted to the render tile or region if any.
+	void applyViewport() const;
+
+	//! A draw recorded in batch mode. Its vertices are projected and converted to a list of points,
+	//! lines or triangles, with the current color stored in each vertex.
+	struct BatchCommand
+	{
+		DrawingMode mode;
+		//! The bound texture, 0 if the draw is not textured.
+		GLint texture;
+		bool blend;
+		int blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha;
+		//! Range of the vertices in the batch arrays.
+		int first;
+		int count;
+
+		//! Whether the draw can be done in one call with the other one.
+		bool canMerge(const BatchCommand& other) const
+		{
+			return mode==other.mode && texture==other.texture && blend==other.blend && (!blend || (blendSrcRGB==other.blendSrcRGB
+				&& blendDstRGB==other.blendDstRGB && blendSrcAlpha==other.blendSrcAlpha && blendDstAlpha==other.blendDstAlpha));
+		}
+		//! Whether the draw only adds to the framebuffer, so that it can be done in any order with the other additive draws.
+		bool isAdditive() const {return blend && blendDstRGB==GL_ONE && blendDstAlpha==GL_ONE;}
+		//! Order of the additive draws, grouping the ones which can be merged.
+		bool operator<(const BatchCommand& other) const
+		{
+			if (texture!=other.texture)
+				return texture<other.texture;
+			if (mode!=other.mode)
+				return mode<other.mode;
+			if (blendSrcRGB!=other.blendSrcRGB)
+				return blendSrcRGB<other.blendSrcRGB;
+			return blendSrcAlpha<other.blendSrcAlpha;
+		}
+	};
+
+	//! Record a draw of drawFromArray() in the batch.
+	void recordBatchCommand(const DrawingMode mode, const int count, const int offset, const ArrayDesc& projectedVertexArray, const unsigned short* indices);
+	//! Execute the recorded draws and clear them, staying in batch mode.
+	void executeBatch();
+
+	//! Copy count vertices from first of the arrays of a draw to the stream vertex buffer, which is left bound,
+	//! and point the attributes of the program at them. The locations of the arrays not used are -1.
+	void streamArrays(QOpenGLShaderProgram* pr, int first, int count, int vertexLocation, const ArrayDesc& vertices,
+			  int texCoordLocation, const ArrayDesc& texCoords, int colorLocation, const ArrayDesc& colors);
+
+	//! Whether the arrays are drawn from the stream buffers, see setFlagVertexBuffersOnly().
+	static bool flagVertexBuffersOnly;
+	//! The buffers to which the arrays are copied before each draw, created when first needed.
+	static QOpenGLBuffer* streamVertexBuffer;
+	static QOpenGLBuffer* streamIndexBuffer;
+
+	//! Whether the draws are recorded.
+	bool batching;
+	//! The commands and vertices recorded, shared by all the painters since only one exists at a time.
+	static QVector<BatchCommand> batchCommands;
+	static QVector<Vec3f> batchVertices;
+	static QVector<Vec2f> batchTexCoords;
+	static QVector<Vec4f> batchColors;
+
+	//! A tessellated sphere kept between the frames, as triangles with the orientation of the original strips.
+	struct SphereMesh
+	{
+		SphereMesh() : vertexBuffer(NULL), indexBuffer(NULL) {}
+		~SphereMesh();
+		QVector<Vec3f> vertices;
+		//! Two per vertex, normalized to [0, 1] as GL_UNSIGNED_SHORT.
+		QVector<unsigned short> texCoords;
+		QVector<unsigned short> indices;
+		//! The same arrays in static GPU buffers, created the first time the mesh is drawn by drawMeshGpu().
+		QOpenGLBuffer* vertexBuffer;
+		QOpenGLBuffer* indexBuffer;
+	};
+
+	//! Get the mesh of sSphere() from the cache, computing it if needed.
+	static SphereMesh* getSphereMesh(const float radius, const float oneMinusOblateness, const int slices, const int stacks, const int orientInside,
+					 const bool flipTexture, const float topAngle, const float bottomAngle);
+	//! Get the mesh of sSphereMap() from the cache, computing it if needed.
+	static SphereMesh* getSphereMapMesh(const float radius, const int slices, const int stacks, const float textureFov, const int orientInside);
+	//! Draw a textured mesh with the current color, the projection being done in the vertex shader.
+	//! @return false if the current projection cannot be performed on the GPU.
+	bool drawMeshGpu(SphereMesh* mesh);
+
+	//! The cached meshes, the cost being the number of vertices.
+	static QCache<QByteArray, SphereMesh> sphereMeshCache;
+	//! The programs of getProjectionProgram(), the keys are their sources.
+	static QHash<QByteArray, QOpenGLShaderProgram*> projectionPrograms;
+
 	// Used by the method below
 	static QVector<Vec2f> smallCircleVertexArray;
 	void drawSmallCircleVertexArray();
+	//! Draw the line strips of an arc tessellated by drawSmallCircleArc(), split where it leaves the viewport.
+	void drawTessellatedArc(const QVector<Vec3d>& arc, void (*viewportEdgeIntersectCallback)(const Vec3d& screenPos, const Vec3d& direction, void* userData), void* userData);
 
 	//! The associated instance of projector
 	StelProjectorP prj;
 
+	//! Origin and scale of the region of the viewport drawn in the render target
+	static Vec3f renderRegion;
+
 #ifndef NDEBUG
 	//! Mutex allowing thread safety
 	static class QMutex* globalMutex;
@@ -328,6 +541,11 @@ private:
 	Vec4f currentColor;
 	bool texture2dEnabled;
 	
+	//! Used to draw the texts in batches, NULL if the QPainter has to be used for each text.
+	static class StelTextAtlas* textAtlas;
+	//! The painter whose texts are in the batch of textAtlas, their pixel coordinates are the ones of its projector.
+	static StelPainter* textAtlasOwner;
+
 	static QOpenGLShaderProgram* basicShaderProgram;
 	struct BasicShaderVars {
 		int projectionMatrix;
@@ -361,6 +579,8 @@ private:
 
 	//! The descriptor for the current opengl vertex array
 	ArrayDesc vertexArray;
+	//! The position added to the vertices when they are projected, see setVertexOrigin().
+	Vec3d vertexOrigin;
 	//! The descriptor for the current opengl texture coordinate array
 	ArrayDesc texCoordArray;
 	//! The descriptor for the current opengl normal array
@@ -0,0 +1,174 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelPointCatalog.hpp"
+#include "StelCore.hpp"
+#include "StelHealpix.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+#include "StelSphereGeometry.hpp"
+
+#include <algorithm>
+
+// Order of the HEALPix pixels of the buckets, 768 pixels of about 7 degrees
+static const int cellOrder = 3;
+
+namespace
+{
+	// Compare the indices of the points by magnitude
+	struct MagnitudeLess
+	{
+		MagnitudeLess(const QVector<float>& m) : magnitudes(m.constData()) {}
+		bool operator()(int a, int b) const {return magnitudes[a]<magnitudes[b];}
+		const float* magnitudes;
+	};
+}
+
+StelPointCatalog::StelPointCatalog()
+{
+}
+
+void StelPointCatalog::clear()
+{
+	positions.clear();
+	magnitudes.clear();
+	colors.clear();
+	sortedPoints.clear();
+	cells.clear();
+	batch.clear();
+}
+
+void StelPointCatalog::setPoints(const QVector<Vec3d>& pos, const QVector<float>& mags, const QVector<Vec3f>& cols)
+{
+	Q_ASSERT(pos.size()==mags.size() && pos.size()==cols.size());
+	positions = pos;
+	magnitudes = mags;
+	colors = cols;
+
+	// Counting sort of the points by pixel
+	const int nbPixels = (int)StelHealpix::getNbPixels(cellOrder);
+	QVector<int> pixels(positions.size());
+	QVector<int> counts(nbPixels, 0);
+	for (int i=0;i<positions.size();++i)
+	{
+		pixels[i] = (int)StelHealpix::vectorToPixel(cellOrder, positions.at(i));
+		++counts[pixels[i]];
+	}
+
+	cells.clear();
+	QVector<int> offsets(nbPixels);
+	int first = 0;
+	for (int p=0;p<nbPixels;++p)
+	{
+		offsets[p] = first;
+		if (counts[p]==0)
+			continue;
+		Cell cell;
+		cell.cosRadius = StelHealpix::pixelBoundingCap(cellOrder, p, cell.center);
+		cell.first = first;
+		cell.count = counts[p];
+		cells.append(cell);
+		first += counts[p];
+	}
+
+	sortedPoints.resize(positions.size());
+	for (int i=0;i<positions.size();++i)
+		sortedPoints[offsets[pixels[i]]++] = i;
+
+	sortCells();
+}
+
+void StelPointCatalog::setMagnitudes(const QVector<float>& mags)
+{
+	Q_ASSERT(mags.size()==positions.size());
+	magnitudes = mags;
+	sortCells();
+}
+
+void StelPointCatalog::sortCells()
+{
+	int* points = sortedPoints.data();
+	const MagnitudeLess less(magnitudes);
+	foreach (const Cell& cell, cells)
+		std::sort(points+cell.first, points+cell.first+cell.count, less);
+}
+
+void StelPointCatalog::draw(StelCore* core, StelPainter* painter, QVector<int>* visible, QVector<float>* visibleMagnitudes)
+{
+	if (visible)
+		visible->resize(0);
+	if (visibleMagnitudes)
+		visibleMagnitudes->resize(0);
+	if (cells.isEmpty())
+		return;
+
+	StelSkyDrawer* sd = core->getSkyDrawer();
+	const StelProjectorP prj = painter->getProjector();
+	const SphericalRegionP viewport = prj->getViewportConvexPolygon(0.f, 0.f);
+	const SphericalCap visibleSky = core->getVisibleSkyArea();
+	const float limitMag = sd->getLimitMagnitude();
+	const bool withExtinction = sd->getFlagHasAtmosphere();
+	const Extinction& extinction = sd->getExtinction();
+
+	batch.clear();
+	foreach (const Cell& cell, cells)
+	{
+		const SphericalCap cap(cell.center, cell.cosRadius);
+		if (!viewport->intersects(cap) || !visibleSky.intersects(cap))
+			continue;
+		const bool checkInScreen = !viewport->contains(cap);
+		for (int i=cell.first;i<cell.first+cell.count;++i)
+		{
+			const int index = sortedPoints.at(i);
+			float mag = magnitudes.at(index);
+			// The points are sorted by magnitude and the extinction only makes them fainter
+			if (mag>limitMag)
+				break;
+			if (withExtinction)
+			{
+				Vec3d altAz = core->j2000ToAltAz(positions.at(index), StelCore::RefractionOff);
+				altAz.normalize();
+				extinction.forward(altAz, &mag);
+				if (mag>limitMag)
+					continue;
+			}
+			RCMag rcMag;
+			if (!sd->computeRCMag(mag, &rcMag))
+			{
+				// Without the extinction the following points are even fainter
+				if (withExtinction)
+					continue;
+				break;
+			}
+			const Vec3d& pos = positions.at(index);
+			if (!sd->projectPointSource(prj.data(), Vec3f(pos[0], pos[1], pos[2]), rcMag, colors.at(index), checkInScreen, batch))
+				continue;
+			if (visible)
+				visible->append(index);
+			if (visibleMagnitudes)
+				visibleMagnitudes->append(mag);
+		}
+	}
+
+	if (batch.vertices.isEmpty() && batch.bigHaloPositions.isEmpty())
+		return;
+	sd->preDrawPointSource(painter);
+	sd->drawPointSourceBatch(painter, batch);
+	sd->postDrawPointSource(painter);
+}
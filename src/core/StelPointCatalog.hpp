@@ -0,0 +1,90 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELPOINTCATALOG_HPP_
+#define _STELPOINTCATALOG_HPP_
+
+#include "StelSkyDrawer.hpp"
+#include "VecMath.hpp"
+
+#include <QVector>
+
+class StelCore;
+class StelPainter;
+
+//! @class StelPointCatalog
+//! A catalog of point sources drawn like the stars, for the plug-ins showing many objects such as the
+//! novae or the pulsars. The positions, magnitudes and colors are given once as arrays, and the points
+//! are bucketed in the HEALPix pixels of order 3 (see StelHealpix) and sorted by magnitude in each pixel.
+//! At each frame only the pixels intersecting the viewport are walked, each up to the limiting
+//! magnitude, and the visible points are drawn together through StelSkyDrawer::drawPointSourceBatch().
+class StelPointCatalog
+{
+public:
+	StelPointCatalog();
+
+	//! Set the points of the catalog, all the arrays must have the same size.
+	//! @param positions the J2000 positions of the points, normalized.
+	//! @param magnitudes the visual magnitudes of the points, without the extinction.
+	//! @param colors the RGB colors of the points, see StelSkyDrawer::indexToColor().
+	void setPoints(const QVector<Vec3d>& positions, const QVector<float>& magnitudes, const QVector<Vec3f>& colors);
+
+	//! Change the magnitudes of the points, e.g. for the variable objects.
+	//! This only sorts the points of each pixel again.
+	void setMagnitudes(const QVector<float>& magnitudes);
+
+	//! Remove all the points.
+	void clear();
+
+	//! Get the number of points of the catalog.
+	int size() const {return positions.size();}
+
+	//! Draw the visible points.
+	//! @param core the core, used for the extinction and the sky drawer.
+	//! @param painter a painter using a projector in the J2000 frame.
+	//! @param visible if not NULL, receives the indices of the points drawn, e.g. to draw their labels.
+	//! @param magnitudes if not NULL, receives the magnitudes with the extinction of the points drawn.
+	void draw(StelCore* core, StelPainter* painter, QVector<int>* visible=NULL, QVector<float>* magnitudes=NULL);
+
+private:
+	struct Cell
+	{
+		Vec3d center;
+		//! Cosine of the radius of the cap containing the pixel.
+		double cosRadius;
+		//! The points of the pixel are sortedPoints[first] to sortedPoints[first+count-1].
+		int first;
+		int count;
+	};
+
+	//! Sort the points of each pixel by increasing magnitude.
+	void sortCells();
+
+	QVector<Vec3d> positions;
+	QVector<float> magnitudes;
+	QVector<Vec3f> colors;
+	//! The indices of the points grouped by pixel.
+	QVector<int> sortedPoints;
+	//! The non empty pixels.
+	QVector<Cell> cells;
+
+	StelSkyDrawer::PointSourceBatch batch;
+};
+
+#endif // _STELPOINTCATALOG_HPP_
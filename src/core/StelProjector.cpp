@@ -26,6 +26,10 @@
 #include <QDebug>
 #include <QString>
 
+Vec2f StelProjector::subpixelJitter(0.f, 0.f);
+Vec4i StelProjector::renderTile(0, 0, 0, 0);
+QAtomicInt StelProjector::nextSerial(1);
+
 StelProjector::Mat4dTransform::Mat4dTransform(const Mat4d& m)
     : transfoMat(m),
       transfoMatf(m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], m[9], m[10], m[11], m[12], m[13], m[14], m[15])
@@ -33,11 +37,6 @@ StelProjector::Mat4dTransform::Mat4dTransform(const Mat4d& m)
 	Q_ASSERT(m[0]==m[0]); // prelude to assert later in Atmosphere rendering... still investigating
 }
 
-void StelProjector::Mat4dTransform::forward(Vec3d& v) const
-{
-	v.transfo4d(transfoMat);
-}
-
 void StelProjector::Mat4dTransform::backward(Vec3d& v) const
 {
 	// We need no matrix inversion because we always work with orthogonal matrices (where the transposed is the inverse).
@@ -50,11 +49,6 @@ void StelProjector::Mat4dTransform::backward(Vec3d& v) const
 	v[2] = transfoMat.r[8]*x + transfoMat.r[9]*y + transfoMat.r[10]*z;
 }
 
-void StelProjector::Mat4dTransform::forward(Vec3f& v) const
-{
-	v.transfo4d(transfoMatf);
-}
-
 void StelProjector::Mat4dTransform::backward(Vec3f& v) const
 {
 	// We need no matrix inversion because we always work with orthogonal matrices (where the transposed is the inverse).
@@ -154,6 +148,11 @@ bool StelProjector::getFlagGravityLabels() const
 	return gravityLabels;
 }
 
+float StelProjector::getDefaultAngleForGravityText() const
+{
+	return defautAngleForGravityText;
+}
+
 const Vec4i& StelProjector::getViewport() const
 {
 	return viewportXywh;
@@ -191,6 +190,18 @@ int StelProjector::getViewportHeight() const
  current frame
 *************************************************************************/
 SphericalRegionP StelProjector::getViewportConvexPolygon(float marginX, float marginY) const
+{
+	// The projectors are shared during a frame, so keep the most common case
+	if (marginX==0.f && marginY==0.f)
+	{
+		if (viewportConvexPolygon.isNull())
+			viewportConvexPolygon = computeViewportConvexPolygon(0.f, 0.f);
+		return viewportConvexPolygon;
+	}
+	return computeViewportConvexPolygon(marginX, marginY);
+}
+
+SphericalRegionP StelProjector::computeViewportConvexPolygon(float marginX, float marginY) const
 {
 	Vec3d e0, e1, e2, e3;
 	const Vec4i& vp = viewportXywh;
@@ -286,6 +297,12 @@ Vec3d StelProjector::viewPortIntersect(const Vec3d& p1, const Vec3d& p2) const
 	return v;
 }
 
+void StelProjector::getScreenTransform(Vec2f& center, Vec2f& scale) const
+{
+	center = viewportCenter;
+	scale.set(flipHorz*pixelPerRad, flipVert*pixelPerRad);
+}
+
 bool StelProjector::project(const Vec3d& v, Vec3d& win) const
 {
 	win = v;
@@ -466,7 +483,11 @@ StelProjector::ModelViewTranformP StelProjector::getModelViewTransform() const
 //! Get the current projection matrix.
 Mat4f StelProjector::getProjectionMatrix() const
 {
-	return Mat4f(2.f/viewportXywh[2], 0, 0, 0, 0, 2.f/viewportXywh[3], 0, 0, 0, 0, -1., 0., -(2.f*viewportXywh[0] + viewportXywh[2])/viewportXywh[2], -(2.f*viewportXywh[1] + viewportXywh[3])/viewportXywh[3], 0, 1);
+	// A render tile fills the GL viewport instead of the whole viewport
+	const Vec4i& rect = renderTile[2]>0 ? renderTile : viewportXywh;
+	return Mat4f(2.f/rect[2], 0, 0, 0, 0, 2.f/rect[3], 0, 0, 0, 0, -1., 0.,
+		     -(2.f*(rect[0]-subpixelJitter[0]) + rect[2])/rect[2],
+		     -(2.f*(rect[1]-subpixelJitter[1]) + rect[3])/rect[3], 0, 1);
 }
 
 StelProjector::StelProjectorMaskType StelProjector::getMaskType(void) const
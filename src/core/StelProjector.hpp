@@ -25,6 +25,8 @@
 #include "VecMath.hpp"
 #include "StelSphereGeometry.hpp"
 
+#include <QAtomicInt>
+
 //! @class StelProjector
 //! Provide the main interface to all operations of projecting coordinates from sky to screen.
 //! The StelProjector also defines the viewport size and position.
@@ -39,6 +41,7 @@ class StelProjector
 public:
 	friend class StelPainter;
 	friend class StelCore;
+	friend class TestKernelBenchmarks;
 
 	class ModelViewTranform;
 	//! @typedef ModelViewTranformP
@@ -56,6 +59,11 @@ public:
 		virtual void backward(Vec3d&) const =0;
 		virtual void forward(Vec3f&) const =0;
 		virtual void backward(Vec3f&) const =0;
+		//! Apply the transformation to an array, the default implementation calls forward() for each vector.
+		virtual void forwardArray(int n, Vec3d* v) const {for (int i=0; i<n; ++i) forward(v[i]);}
+		virtual void forwardArray(int n, Vec3f* v) const {for (int i=0; i<n; ++i) forward(v[i]);}
+		//! Apply the inverse transformation to an array, the default implementation calls backward() for each vector.
+		virtual void backwardArray(int n, Vec3d* v) const {for (int i=0; i<n; ++i) backward(v[i]);}
 
 		virtual void combine(const Mat4d&)=0;
 		virtual ModelViewTranformP clone() const=0;
@@ -67,10 +75,13 @@ public:
 	{
 	public:
         Mat4dTransform(const Mat4d& m);
-        void forward(Vec3d& v) const;
+        void forward(Vec3d& v) const {v.transfo4d(transfoMat);}
         void backward(Vec3d& v) const;
-        void forward(Vec3f& v) const;
+        void forward(Vec3f& v) const {v.transfo4d(transfoMatf);}
         void backward(Vec3f& v) const;
+        void forwardArray(int n, Vec3d* v) const {transfoMat.transfoArray(n, v);}
+        void forwardArray(int n, Vec3f* v) const {transfoMatf.transfoArray(n, v);}
+        void backwardArray(int n, Vec3d* v) const {transfoMat.transfoArrayOrthoInverse(n, v);}
         void combine(const Mat4d& m);
         Mat4d getApproximateLinearTransfo() const;
         ModelViewTranformP clone() const;
@@ -141,6 +152,17 @@ public:
 	virtual bool forward(Vec3f& v) const = 0;
 	//! Apply the transformation in the backward projection in place.
 	virtual bool backward(Vec3d& v) const = 0;
+	//! Get the GLSL source code of the forward transformation, for use in vertex shaders.
+	//! The returned code defines the function <tt>vec3 projectorForwardTransform(vec3 v)</tt>
+	//! which returns the projected x,y coordinates and 1. or 0. in z depending whether the projected point is valid.
+	//! @return an empty string if the projection cannot be performed on the GPU.
+	virtual QByteArray getForwardTransformShader() const {return QByteArray();}
+	//! Get the parameters used to convert the output of the forward transformation to screen coordinates:
+	//! win = center + scale*forward(v).
+	void getScreenTransform(Vec2f& center, Vec2f& scale) const;
+	//! Return whether this is the projector used for 2d painting, which keeps the screen coordinates unchanged.
+	//! This is a plain flag so that it can be tested in the drawing code without any RTTI.
+	bool isScreen2d() const {return screen2d;}
 	//! Return the small zoom increment to use at the given FOV for nice movements
 	virtual float deltaZoom(float fov) const = 0;
 
@@ -160,6 +182,9 @@ public:
 	//! screen, or a 3d dome.
 	bool getFlagGravityLabels() const;
 
+	//! Get the rotation angle applied to the texts drawn with gravity when the gravity labels are off.
+	float getDefaultAngleForGravityText() const;
+
 	//! Get the lower left corner of the viewport and the width, height.
 	const Vec4i& getViewport() const;
 
@@ -268,8 +293,23 @@ public:
 	ModelViewTranformP getModelViewTransform() const;
 
 	//! Get the current projection matrix.
+	//! It includes the subpixel jitter of the temporal antialiasing, see setSubpixelJitter(), and maps the
+	//! render tile to the whole GL viewport when one is set, see setRenderTile().
 	Mat4f getProjectionMatrix() const;
 
+	//! Set the offset in pixels applied by the projection matrices to all the draws, so that each frame samples
+	//! the pixels at a different position. The positions returned by project() are not offset.
+	static void setSubpixelJitter(float dx, float dy) {subpixelJitter.set(dx, dy);}
+	//! Restrict all the draws to a tile of the viewport, drawn in the GL viewport (0, 0, width, height).
+	//! This allows drawing views larger than the maximum size of the GL viewport piece by piece.
+	//! @param tile the tile x, y, width, height in the window coordinates of project(), a null width for none.
+	static void setRenderTile(const Vec4i& tile) {renderTile = tile;}
+	static const Vec4i& getRenderTile() {return renderTile;}
+
+	//! Get a number identifying this projector among all the ones created, never reused.
+	//! A projector doesn't change once created, so the results computed with it can be kept under this key.
+	int getSerial() const {return serial;}
+
 	///////////////////////////////////////////////////////////////////////////
 	//! Get a string description of a StelProjectorMaskType.
 	static const QString maskTypeToString(StelProjectorMaskType type);
@@ -292,7 +332,9 @@ protected:
 		  viewportFovDiameter(0.f),
 		  gravityLabels(true),
 		  defautAngleForGravityText(0.f),
-		  devicePixelsPerPixel(1.f) {;}
+		  devicePixelsPerPixel(1.f),
+		  screen2d(false),
+		  serial(nextSerial.fetchAndAddRelaxed(1)) {;}
 
 	//! Return whether the projection presents discontinuities. Used for optimization.
 	virtual bool hasDiscontinuity() const =0;
@@ -307,6 +349,42 @@ protected:
 	//! Initialize the bounding cap.
 	virtual void computeBoundingCap();
 
+	//! Project an array of vertices with the forward() function of the projection class P.
+	//! This is used by the subclasses to implement project(int n, ...) without any virtual call
+	//! per vertex: the forward() function is called non virtually, and so is the model view
+	//! transformation when it is a plain matrix. The vertices are processed by blocks so that
+	//! each step runs in a tight loop over a few vertices which the compiler can vectorize.
+	template<class P, class V> void projectVertices(int n, const V* in, Vec3f* out) const
+	{
+		static const int BlockSize = 8;
+		const P* prj = static_cast<const P*>(this);
+		const Mat4dTransform* matTransform = dynamic_cast<const Mat4dTransform*>(modelViewTransform.data());
+		const float sx = flipHorz * pixelPerRad;
+		const float sy = flipVert * pixelPerRad;
+		V v[BlockSize];
+		for (int i = 0; i < n; i += BlockSize, in += BlockSize, out += BlockSize)
+		{
+			const int m = qMin(BlockSize, n - i);
+			for (int k = 0; k < m; ++k)
+				v[k] = in[k];
+			// The non linear transformations like the refraction are applied to the whole block in one call
+			if (matTransform)
+				matTransform->Mat4dTransform::forwardArray(m, v);
+			else
+				modelViewTransform->forwardArray(m, v);
+			for (int k = 0; k < m; ++k)
+				out[k].set(v[k][0], v[k][1], v[k][2]);
+			for (int k = 0; k < m; ++k)
+				prj->P::forward(out[k]);
+			for (int k = 0; k < m; ++k)
+			{
+				out[k][0] = viewportCenter[0] + sx * out[k][0];
+				out[k][1] = viewportCenter[1] + sy * out[k][1];
+				out[k][2] = (out[k][2] - zNear) * oneOverZNearMinusZFar;
+			}
+		}
+	}
+
 	ModelViewTranformP modelViewTransform;	// Operator to apply (if not NULL) before the modelview projection step
 
 	float flipHorz,flipVert;            // Whether to flip in horizontal or vertical directions
@@ -319,11 +397,19 @@ protected:
 	bool gravityLabels;                 // should label text align with the horizon?
 	float defautAngleForGravityText;    // a rotation angle to apply to gravity text (only if gravityLabels is set to false)
 	SphericalCap boundingCap;           // Bounding cap of the whole viewport
+	mutable SphericalRegionP viewportConvexPolygon; // Polygon of the viewport without margins, computed on first use
 	float devicePixelsPerPixel;         // The number of device pixel per "Device Independent Pixels" (value is usually 1, but 2 for mac retina screens)
+	bool screen2d;                      // Whether this is a StelProjector2d
 
 private:
+	static Vec2f subpixelJitter;
+	static Vec4i renderTile;
+	static QAtomicInt nextSerial;
+	const int serial;
+
 	//! Initialise the StelProjector from a param instance.
 	void init(const StelProjectorParams& param);
+	SphericalRegionP computeViewportConvexPolygon(float marginX, float marginY) const;
 };
 
 #endif // _STELPROJECTOR_HPP_
@@ -30,6 +30,17 @@ QString StelProjectorPerspective::getDescriptionI18() const
 	return q_("Perspective projection keeps the horizon a straight line. The mathematical name for this projection method is <i>gnomonic projection</i>.");
 }
 
+QByteArray StelProjectorPerspective::getForwardTransformShader() const
+{
+	return
+		"vec3 projectorForwardTransform(vec3 v)\n"
+		"{\n"
+		"    if (v.z < 0.)\n"
+		"        return vec3(v.xy/(-v.z), 1.);\n"
+		"    return vec3(0., 0., 0.);\n"
+		"}\n";
+}
+
 bool StelProjectorPerspective::backward(Vec3d &v) const
 {
 	v[2] = std::sqrt(1.0/(1.0+v[0]*v[0]+v[1]*v[1]));
@@ -68,6 +79,17 @@ QString StelProjectorEqualArea::getDescriptionI18() const
 	return q_("The full name of this projection method is, <i>Lambert azimuthal equal-area projection</i>. It preserves the area but not the angle.");
 }
 
+QByteArray StelProjectorEqualArea::getForwardTransformShader() const
+{
+	return
+		"vec3 projectorForwardTransform(vec3 v)\n"
+		"{\n"
+		"    float r = length(v);\n"
+		"    float f = sqrt(2./(r*(r-v.z)));\n"
+		"    return vec3(v.xy*f, 1.);\n"
+		"}\n";
+}
+
 bool StelProjectorEqualArea::backward(Vec3d &v) const
 {
 	const double dq = v[0]*v[0] + v[1]*v[1];
@@ -113,6 +135,18 @@ QString StelProjectorStereographic::getDescriptionI18() const
 	return q_("Stereographic projection is known since the antiquity and was originally known as the planisphere projection. It preserves the angles at which curves cross each other but it does not preserve area.");
 }
 
+QByteArray StelProjectorStereographic::getForwardTransformShader() const
+{
+	return
+		"vec3 projectorForwardTransform(vec3 v)\n"
+		"{\n"
+		"    float h = 0.5*(length(v)-v.z);\n"
+		"    if (h <= 0.)\n"
+		"        return vec3(0., 0., 0.);\n"
+		"    return vec3(v.xy/h, 1.);\n"
+		"}\n";
+}
+
 bool StelProjectorStereographic::backward(Vec3d &v) const
 {
   const double lqq = 0.25*(v[0]*v[0] + v[1]*v[1]);
@@ -150,6 +184,23 @@ QString StelProjectorFisheye::getDescriptionI18() const
 	return q_("In fish-eye projection, or <i>azimuthal equidistant projection</i>, straight lines become curves when they appear a large angular distance from the centre of the field of view (like the distortions seen with very wide angle camera lenses).");
 }
 
+QByteArray StelProjectorFisheye::getForwardTransformShader() const
+{
+	return
+		"vec3 projectorForwardTransform(vec3 v)\n"
+		"{\n"
+		"    float rq1 = dot(v.xy, v.xy);\n"
+		"    if (rq1 > 0.)\n"
+		"    {\n"
+		"        float h = sqrt(rq1);\n"
+		"        return vec3(v.xy*(atan(h, -v.z)/h), 1.);\n"
+		"    }\n"
+		"    if (v.z < 0.)\n"
+		"        return vec3(0., 0., 1.);\n"
+		"    return vec3(0., 0., 0.);\n"
+		"}\n";
+}
+
 bool StelProjectorFisheye::backward(Vec3d &v) const
 {
 	const double a = std::sqrt(v[0]*v[0]+v[1]*v[1]);
@@ -228,18 +279,6 @@ QString StelProjectorCylinder::getDescriptionI18() const
 	return q_("The full name of this projection mode is <i>cylindrical equidistant projection</i>. With this projection all parallels are equally spaced.");
 }
 
-bool StelProjectorCylinder::forward(Vec3f &v) const
-{
-	const float r = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
-	const bool rval = (-r < v[1] && v[1] < r);
-	const float alpha = std::atan2(v[0],-v[2]);
-	const float delta = std::asin(v[1]/r);
-	v[0] = alpha;
-	v[1] = delta;
-	v[2] = r;
-	return rval;
-}
-
 bool StelProjectorCylinder::backward(Vec3d &v) const
 {
 	const bool rval = v[1]<M_PI_2 && v[1]>-M_PI_2 && v[0]>-M_PI && v[0]<M_PI;
@@ -338,6 +377,15 @@ bool StelProjectorOrthographic::forward(Vec3f &v) const
 	return rval;
 }
 
+QByteArray StelProjectorOrthographic::getForwardTransformShader() const
+{
+	return
+		"vec3 projectorForwardTransform(vec3 v)\n"
+		"{\n"
+		"    return vec3(v.xy/length(v), v.z <= 0. ? 1. : 0.);\n"
+		"}\n";
+}
+
 bool StelProjectorOrthographic::backward(Vec3d &v) const
 {
 	const double dq = v[0]*v[0] + v[1]*v[1];
@@ -31,6 +31,8 @@ public:
 	virtual QString getNameI18() const;
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 120.f;}
+	virtual void project(int n, const Vec3d* in, Vec3f* out) {projectVertices<StelProjectorPerspective>(n, in, out);}
+	virtual void project(int n, const Vec3f* in, Vec3f* out) {projectVertices<StelProjectorPerspective>(n, in, out);}
 	bool forward(Vec3f &v) const
 	{
 		const float r = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
@@ -51,6 +53,7 @@ public:
 		v[2] = r;
 		return false;
 	}
+	virtual QByteArray getForwardTransformShader() const;
 	bool backward(Vec3d &v) const;
 	float fovToViewScalingFactor(float fov) const;
 	float viewScalingFactorToFov(float vsf) const;
@@ -68,6 +71,8 @@ public:
 	virtual QString getNameI18() const;
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 360.f;}
+	virtual void project(int n, const Vec3d* in, Vec3f* out) {projectVertices<StelProjectorEqualArea>(n, in, out);}
+	virtual void project(int n, const Vec3f* in, Vec3f* out) {projectVertices<StelProjectorEqualArea>(n, in, out);}
 	bool forward(Vec3f &v) const
 	{
 		const float r = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
@@ -77,6 +82,7 @@ public:
 		v[2] = r;
 		return true;
 	}
+	virtual QByteArray getForwardTransformShader() const;
 	bool backward(Vec3d &v) const;
 	float fovToViewScalingFactor(float fov) const;
 	float viewScalingFactorToFov(float vsf) const;
@@ -111,21 +117,10 @@ public:
 		return true;
 	}
 
-	virtual void project(int n, const Vec3d* in, Vec3f* out)
-	{
-		Vec3d v;
-		for (int i = 0; i < n; ++i, ++out)
-		{
-			v = in[i];
-			modelViewTransform->forward(v);
-			out->set(v[0], v[1], v[2]);
-			StelProjectorStereographic::forward(*out);
-			out->set(viewportCenter[0] + flipHorz * pixelPerRad * (*out)[0],
-				viewportCenter[1] + flipVert * pixelPerRad * (*out)[1],
-				((*out)[2] - zNear) * oneOverZNearMinusZFar);
-		}
-	}
+	virtual void project(int n, const Vec3d* in, Vec3f* out) {projectVertices<StelProjectorStereographic>(n, in, out);}
+	virtual void project(int n, const Vec3f* in, Vec3f* out) {projectVertices<StelProjectorStereographic>(n, in, out);}
 
+	virtual QByteArray getForwardTransformShader() const;
 	bool backward(Vec3d &v) const;
 	float fovToViewScalingFactor(float fov) const;
 	float viewScalingFactorToFov(float vsf) const;
@@ -143,6 +138,8 @@ public:
 	virtual QString getNameI18() const;
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 180.00001f;}
+	virtual void project(int n, const Vec3d* in, Vec3f* out) {projectVertices<StelProjectorFisheye>(n, in, out);}
+	virtual void project(int n, const Vec3f* in, Vec3f* out) {projectVertices<StelProjectorFisheye>(n, in, out);}
 	bool forward(Vec3f &v) const
 	{
 		const float rq1 = v[0]*v[0] + v[1]*v[1];
@@ -165,6 +162,7 @@ public:
 		v[2] = std::numeric_limits<float>::min();
 		return false;
 	}
+	virtual QByteArray getForwardTransformShader() const;
 	bool backward(Vec3d &v) const;
 	float fovToViewScalingFactor(float fov) const;
 	float viewScalingFactorToFov(float vsf) const;
@@ -182,20 +180,8 @@ public:
 	virtual QString getNameI18() const;
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 360.f;}
-	virtual void project(int n, const Vec3d* in, Vec3f* out)
-	{
-		Vec3d v;
-		for (int i = 0; i < n; ++i)
-		{
-			v = in[i];
-			modelViewTransform->forward(v);
-			out[i].set(v[0], v[1], v[2]);
-			StelProjectorHammer::forward(out[i]);
-			out[i][0] = viewportCenter[0] + flipHorz * pixelPerRad * out[i][0];
-			out[i][1] = viewportCenter[1] + flipVert * pixelPerRad * out[i][1];
-			out[i][2] = (out[i][2] - zNear) * oneOverZNearMinusZFar;
-		}
-	}
+	virtual void project(int n, const Vec3d* in, Vec3f* out) {projectVertices<StelProjectorHammer>(n, in, out);}
+	virtual void project(int n, const Vec3f* in, Vec3f* out) {projectVertices<StelProjectorHammer>(n, in, out);}
 	bool forward(Vec3f &v) const
 	{
 		// Hammer Aitoff
@@ -232,7 +218,19 @@ public:
 	virtual QString getNameI18() const;
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 175.f * 4.f/3.f;} // assume aspect ration of 4/3 for getting a full 360 degree horizon
-	bool forward(Vec3f &win) const;
+	virtual void project(int n, const Vec3d* in, Vec3f* out) {projectVertices<StelProjectorCylinder>(n, in, out);}
+	virtual void project(int n, const Vec3f* in, Vec3f* out) {projectVertices<StelProjectorCylinder>(n, in, out);}
+	bool forward(Vec3f &v) const
+	{
+		const float r = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+		const bool rval = (-r < v[1] && v[1] < r);
+		const float alpha = std::atan2(v[0],-v[2]);
+		const float delta = std::asin(v[1]/r);
+		v[0] = alpha;
+		v[1] = delta;
+		v[2] = r;
+		return rval;
+	}
 	bool backward(Vec3d &v) const;
 	float fovToViewScalingFactor(float fov) const;
 	float viewScalingFactorToFov(float vsf) const;
@@ -289,6 +287,7 @@ public:
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 179.9999f;}
 	bool forward(Vec3f &win) const;
+	virtual QByteArray getForwardTransformShader() const;
 	bool backward(Vec3d &v) const;
 	float fovToViewScalingFactor(float fov) const;
 	float viewScalingFactorToFov(float vsf) const;
@@ -302,7 +301,7 @@ protected:
 class StelProjector2d : public StelProjector
 {
 public:
-	StelProjector2d() : StelProjector(ModelViewTranformP(new StelProjector::Mat4dTransform(Mat4d::identity()))) {;}
+	StelProjector2d() : StelProjector(ModelViewTranformP(new StelProjector::Mat4dTransform(Mat4d::identity()))) {screen2d=true;}
 	virtual QString getNameI18() const;
 	virtual QString getDescriptionI18() const;
 	virtual float getMaxFov() const {return 360.f;}
@@ -0,0 +1,50 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelRenderProfile.hpp"
+
+#include <QDebug>
+#include <QSettings>
+
+StelRenderProfile::StelRenderProfile(QSettings* conf)
+	: name("default")
+	, lowPower(false)
+	, flagVertexBuffersOnly(false)
+	, atmosphereResolution(0)
+	, atmosphereRowsPerFrame(-1)
+	, maxStarCatalogs(-1)
+	, maxSkyLabels(-1)
+{
+	const QString profile = conf->value("video/render_profile", "default").toString();
+	if (profile=="low_power")
+	{
+		name = profile;
+		lowPower = true;
+		flagVertexBuffersOnly = conf->value("low_power/flag_vertex_buffers_only", true).toBool();
+		atmosphereResolution = conf->value("low_power/atmosphere_resolution", 16).toInt();
+		atmosphereRowsPerFrame = conf->value("low_power/atmosphere_rows_per_frame", 4).toInt();
+		maxStarCatalogs = conf->value("low_power/max_star_catalogs", 4).toInt();
+		maxSkyLabels = conf->value("low_power/max_sky_labels", 64).toInt();
+	}
+	else if (profile!="default")
+	{
+		qWarning() << "WARNING: unknown rendering profile" << profile << ", using the default one";
+	}
+	qDebug() << "Rendering profile:" << name;
+}
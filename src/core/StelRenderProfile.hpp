@@ -0,0 +1,67 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELRENDERPROFILE_HPP_
+#define _STELRENDERPROFILE_HPP_
+
+#include <QString>
+
+class QSettings;
+
+//! @class StelRenderProfile
+//! The rendering profile selected at startup with the video/render_profile option.
+//! The "default" profile changes nothing. The "low_power" profile is meant for the GLES2 class devices,
+//! like the ARM single board computers: the painters draw from vertex buffers only, with the colors
+//! packed in bytes, the atmosphere is computed on a coarser grid spread over several frames, and the
+//! number of star catalogs loaded and of sky labels drawn per frame are capped.
+//! The values of the low_power profile are read from the [low_power] section of the configuration, so
+//! that they can be tuned for each device. The profile doesn't modify the configuration, it only
+//! overrides the values read by the modules while it is selected.
+class StelRenderProfile
+{
+public:
+	//! Read the profile selected in the configuration.
+	StelRenderProfile(QSettings* conf);
+
+	//! Get the name of the selected profile, "default" or "low_power".
+	const QString& getName() const {return name;}
+	bool isLowPower() const {return lowPower;}
+
+	//! Whether the painters copy the vertex arrays to vertex buffers instead of drawing from client arrays.
+	bool getFlagVertexBuffersOnly() const {return flagVertexBuffersOnly;}
+	//! Get the number of rows of the grid of the atmosphere, or 0 to use the one of the configuration.
+	int getAtmosphereResolution() const {return atmosphereResolution;}
+	//! Get the number of rows of the grid of the atmosphere computed per frame, or -1 to use the one of the configuration.
+	int getAtmosphereRowsPerFrame() const {return atmosphereRowsPerFrame;}
+	//! Get the maximum number of star catalogs loaded, or -1 for no limit.
+	int getMaxStarCatalogs() const {return maxStarCatalogs;}
+	//! Get the maximum number of sky labels drawn per frame, or -1 to use the one of the configuration.
+	int getMaxSkyLabels() const {return maxSkyLabels;}
+
+private:
+	QString name;
+	bool lowPower;
+	bool flagVertexBuffersOnly;
+	int atmosphereResolution;
+	int atmosphereRowsPerFrame;
+	int maxStarCatalogs;
+	int maxSkyLabels;
+};
+
+#endif // _STELRENDERPROFILE_HPP_
@@ -0,0 +1,109 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelRenderStats.hpp"
+#include "StelCore.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+
+#include <QDebug>
+#include <QFont>
+#include <QMutexLocker>
+
+StelRenderStats::StelRenderStats() : flagOverlay(false)
+{
+	for (int i=0; i<MaxCounters; ++i)
+	{
+		gauges[i] = false;
+		lastFrame[i] = 0;
+	}
+	// Registered in the order of the CoreCounter values
+	registerCounter("Painter draw calls");
+	registerCounter("Painter state changes");
+	registerCounter("Point source flushes");
+	registerCounter("Texture upload bytes");
+	registerCounter("Sky image tiles", true);
+	Q_ASSERT(names.size()==NbCoreCounters);
+}
+
+int StelRenderStats::registerCounter(const QString& name, bool gauge)
+{
+	QMutexLocker locker(&mutex);
+	const int index = names.indexOf(name);
+	if (index>=0)
+		return index;
+	if (names.size()>=MaxCounters)
+	{
+		qWarning() << "WARNING: too many render statistics counters, cannot register" << name;
+		return -1;
+	}
+	gauges[names.size()] = gauge;
+	names << name;
+	return names.size()-1;
+}
+
+void StelRenderStats::endFrame()
+{
+	QMutexLocker locker(&mutex);
+	for (int i=0; i<names.size(); ++i)
+		lastFrame[i] = gauges[i] ? values[i].load() : values[i].fetchAndStoreRelaxed(0);
+}
+
+QVariantMap StelRenderStats::getLastFrame() const
+{
+	QMutexLocker locker(&mutex);
+	QVariantMap map;
+	for (int i=0; i<names.size(); ++i)
+		map[names.at(i)] = lastFrame[i];
+	return map;
+}
+
+void StelRenderStats::drawOverlay(StelCore* core) const
+{
+	if (!flagOverlay)
+		return;
+
+	QStringList lines;
+	{
+		QMutexLocker locker(&mutex);
+		for (int i=0; i<names.size(); ++i)
+			lines << QString("%1 %2").arg(names.at(i).left(30), -30).arg(lastFrame[i], 10);
+	}
+
+	StelPainter sPainter(core->getProjection2d());
+	QFont font("DejaVu Sans Mono");
+	font.setStyleHint(QFont::TypeWriter);
+	font.setPixelSize(12);
+	sPainter.setFont(font);
+	const int lineHeight = sPainter.getFontMetrics().height();
+	int width = 0;
+	foreach (const QString& line, lines)
+		width = qMax(width, sPainter.getFontMetrics().width(line));
+
+	// On the right of the frame profiler table, which is drawn at the top left
+	const float x = core->getProjection2d()->getViewportWidth() - width - 10.f;
+	const float top = core->getProjection2d()->getViewportHeight() - 10.f;
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	sPainter.setColor(0.f, 0.f, 0.f, 0.6f);
+	sPainter.drawRect2d(x-5.f, top-lines.size()*lineHeight-5.f, width+10.f, lines.size()*lineHeight+10.f, false);
+	sPainter.setColor(1.f, 1.f, 1.f, 1.f);
+	for (int i=0; i<lines.size(); ++i)
+		sPainter.drawText(x, top-(i+1)*lineHeight+sPainter.getFontMetrics().descent(), lines.at(i));
+}
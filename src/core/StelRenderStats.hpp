@@ -0,0 +1,88 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELRENDERSTATS_HPP_
+#define _STELRENDERSTATS_HPP_
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+class StelCore;
+
+//! @class StelRenderStats
+//! Count what is done to render each frame, e.g. the draw calls, the stars projected or the bytes
+//! of the textures uploaded, for the performance dashboards and the debug overlay.
+//! The counters are incremented during the frame, from any thread, and their values are kept at
+//! the end of the frame by endFrame(), when they are reset. The gauges count a quantity which is
+//! not reset, e.g. the number of tiles in memory.
+//! The counters of the core are always registered, the modules register their own ones by name.
+class StelRenderStats
+{
+public:
+	//! The counters of the core classes.
+	enum CoreCounter
+	{
+		PainterDrawCalls,	//!< Draw calls issued by StelPainter
+		PainterStateChanges,	//!< Changes of program, texture or blending between the StelPainter draw calls
+		PointSourceFlushes,	//!< Draw calls of the point sources in StelSkyDrawer::postDrawPointSource()
+		TextureUploadBytes,	//!< Bytes of texture data uploaded to the GPU
+		SkyImageTiles,		//!< Gauge of the StelSkyImageTile in memory
+		NbCoreCounters
+	};
+
+	//! The maximum number of counters which can be registered.
+	static const int MaxCounters = 128;
+
+	StelRenderStats();
+
+	//! Register a counter, or get the one already registered with this name. Thread safe.
+	//! @param gauge if true the value is not reset at the end of each frame.
+	//! @return the identifier to pass to add(), or -1 if too many counters are registered.
+	int registerCounter(const QString& name, bool gauge=false);
+	//! Add to a counter of the current frame. Thread safe, an invalid identifier is ignored.
+	void add(int counter, int n=1)
+	{
+		if (counter>=0 && counter<MaxCounters)
+			values[counter].fetchAndAddRelaxed(n);
+	}
+
+	//! Keep the values of the frame and reset the counters, to be called once per frame.
+	void endFrame();
+	//! Get the values of the last frame by counter name.
+	QVariantMap getLastFrame() const;
+
+	//! Set whether the values of the last frame are drawn on top of the view.
+	void setFlagOverlay(bool b) {flagOverlay = b;}
+	bool getFlagOverlay() const {return flagOverlay;}
+	//! Draw the values of the last frame on the top right of the view if the overlay is enabled.
+	void drawOverlay(StelCore* core) const;
+
+private:
+	mutable QMutex mutex;
+	QStringList names;
+	bool gauges[MaxCounters];
+	QAtomicInt values[MaxCounters];
+	int lastFrame[MaxCounters];
+	bool flagOverlay;
+};
+
+#endif // _STELRENDERSTATS_HPP_
@@ -0,0 +1,112 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelRenderTargetPool.hpp"
+
+#include <QDebug>
+#include <QOpenGLFramebufferObject>
+
+StelRenderTargetPool::StelRenderTargetPool(int maxTargets)
+	: maxTargets(qMax(maxTargets, 1))
+	, samples(0)
+{
+}
+
+StelRenderTargetPool::~StelRenderTargetPool()
+{
+	clear();
+}
+
+void StelRenderTargetPool::setSamples(int n)
+{
+	if (n>0 && !QOpenGLFramebufferObject::hasOpenGLFramebufferBlit())
+	{
+		qWarning() << "WARNING: the multisampled framebuffers can not be resolved, multisampling of the viewport is disabled";
+		n = 0;
+	}
+	samples = qMax(n, 0);
+}
+
+QOpenGLFramebufferObject* StelRenderTargetPool::get(const QSize& size, int nbSamples)
+{
+	for (int i=0; i<targets.size(); ++i)
+	{
+		QOpenGLFramebufferObject* fbo = targets.at(i);
+		// The implementation may give more samples than requested
+		if (fbo->size()==size && (fbo->format().samples()>0)==(nbSamples>0) && !inUse.contains(fbo))
+		{
+			targets.move(i, 0);
+			inUse.insert(fbo);
+			return fbo;
+		}
+	}
+
+	QOpenGLFramebufferObjectFormat format;
+	format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+	format.setSamples(nbSamples);
+	QOpenGLFramebufferObject* fbo = new QOpenGLFramebufferObject(size, format);
+	if (!fbo->isValid())
+	{
+		qWarning() << "ERROR: can't create a framebuffer of" << size << "with" << nbSamples << "samples";
+		delete fbo;
+		return NULL;
+	}
+	targets.prepend(fbo);
+	inUse.insert(fbo);
+	evict();
+	return fbo;
+}
+
+void StelRenderTargetPool::evict()
+{
+	// The buffers used in the current frame are kept even if there are too many
+	for (int i=targets.size()-1; i>=0 && targets.size()>maxTargets; --i)
+	{
+		if (!inUse.contains(targets.at(i)))
+			delete targets.takeAt(i);
+	}
+}
+
+void StelRenderTargetPool::beginFrame()
+{
+	inUse.clear();
+}
+
+QOpenGLFramebufferObject* StelRenderTargetPool::acquire(const QSize& size)
+{
+	return get(size, samples);
+}
+
+QOpenGLFramebufferObject* StelRenderTargetPool::resolve(QOpenGLFramebufferObject* fbo)
+{
+	if (fbo==NULL || fbo->format().samples()==0)
+		return fbo;
+	QOpenGLFramebufferObject* resolved = get(fbo->size(), 0);
+	if (resolved==NULL)
+		return NULL;
+	QOpenGLFramebufferObject::blitFramebuffer(resolved, fbo, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	return resolved;
+}
+
+void StelRenderTargetPool::clear()
+{
+	qDeleteAll(targets);
+	targets.clear();
+	inUse.clear();
+}
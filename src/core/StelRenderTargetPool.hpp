@@ -0,0 +1,75 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELRENDERTARGETPOOL_HPP_
+#define _STELRENDERTARGETPOOL_HPP_
+
+#include <QList>
+#include <QSet>
+#include <QSize>
+
+class QOpenGLFramebufferObject;
+
+//! @class StelRenderTargetPool
+//! Keep the frame buffers in which the viewport is drawn before being presented by a StelViewportEffect,
+//! so that switching between the effects or back to a previous window size does not reallocate them.
+//! When multisampling is requested the viewport is drawn in a multisampled buffer which is resolved in a
+//! texture only when the effect needs to sample it. Without multisampling the viewport is drawn directly
+//! in the texture sampled by the effect, with no extra copy.
+//! All the methods must be called with the GL context current.
+class StelRenderTargetPool
+{
+public:
+	//! @param maxTargets the number of buffers kept, the least recently used ones are released first.
+	StelRenderTargetPool(int maxTargets=6);
+	~StelRenderTargetPool();
+
+	//! Set the number of samples of the buffers returned by acquire(), 0 to disable multisampling.
+	//! It is set to 0 if the GL implementation can not resolve multisampled buffers.
+	void setSamples(int n);
+	int getSamples() const {return samples;}
+
+	//! Start a new frame: the buffers returned in the previous frame can be returned again.
+	void beginFrame();
+	//! Get a buffer of the given size in which the viewport can be drawn, multisampled if enabled.
+	//! The same buffer is not returned twice in a frame.
+	//! @return NULL if the buffer could not be created.
+	QOpenGLFramebufferObject* acquire(const QSize& size);
+	//! Get a buffer with a texture holding the content of a buffer returned by acquire().
+	//! The buffer itself is returned when it is not multisampled, else it is resolved in another buffer
+	//! of the pool. The result stays valid until the next call to beginFrame().
+	QOpenGLFramebufferObject* resolve(QOpenGLFramebufferObject* fbo);
+
+	//! Release all the buffers.
+	void clear();
+
+private:
+	//! Get a buffer of the size and number of samples not used in the current frame, creating it if needed.
+	QOpenGLFramebufferObject* get(const QSize& size, int nbSamples);
+	//! Release the least recently used buffers which are not used in the current frame.
+	void evict();
+
+	const int maxTargets;
+	int samples;
+	QList<QOpenGLFramebufferObject*> targets;
+	//! Buffers returned since the last call to beginFrame().
+	QSet<QOpenGLFramebufferObject*> inUse;
+};
+
+#endif // _STELRENDERTARGETPOOL_HPP_
@@ -0,0 +1,132 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelRiseSet.hpp"
+
+#include <cmath>
+
+const double StelRiseSet::AlwaysAbove = -1.;
+const double StelRiseSet::AlwaysBelow = -2.;
+
+StelRiseSet::StelRiseSet()
+	: jdStart(0.)
+	, localSiderealTime(0.)
+	, siderealDayLength(1.)
+	, latitude(0.)
+	, horizonAltitude(0.)
+{
+}
+
+void StelRiseSet::setObserver(double ajdStart, double alocalSiderealTime, double asiderealDayLength,
+			      double alatitude, double ahorizonAltitude)
+{
+	if (ajdStart==jdStart && alocalSiderealTime==localSiderealTime && asiderealDayLength==siderealDayLength
+	    && alatitude==latitude && ahorizonAltitude==horizonAltitude)
+		return;
+	jdStart = ajdStart;
+	localSiderealTime = alocalSiderealTime;
+	siderealDayLength = asiderealDayLength;
+	latitude = alatitude;
+	horizonAltitude = ahorizonAltitude;
+	cache.clear();
+}
+
+const StelRiseSet::Events& StelRiseSet::getEvents(const QString& id, const Vec3d& equPos)
+{
+	QHash<QString, Events>::iterator it = cache.find(id);
+	if (it == cache.end())
+	{
+		it = cache.insert(id, Events());
+		computeEvents(1, &equPos, &it.value());
+	}
+	return it.value();
+}
+
+double StelRiseSet::hourAngle(double latitude, double altitude, double declination)
+{
+	double h;
+	hourAngles(latitude, altitude, 1, &declination, &h);
+	return h;
+}
+
+void StelRiseSet::hourAngles(double latitude, double altitude, int n, const double* declinations, double* hourAngles)
+{
+	const double sinLat = std::sin(latitude);
+	const double cosLat = std::cos(latitude);
+	const double sinAlt = std::sin(altitude);
+	for (int i=0; i<n; ++i)
+	{
+		// cos(H) = (sin(alt) - sin(lat)*sin(dec)) / (cos(lat)*cos(dec))
+		const double numer = sinAlt - sinLat*std::sin(declinations[i]);
+		const double denom = cosLat*std::cos(declinations[i]);
+		if (numer <= -std::fabs(denom))
+			hourAngles[i] = AlwaysAbove;
+		else if (numer >= std::fabs(denom))
+			hourAngles[i] = AlwaysBelow;
+		else
+			hourAngles[i] = std::acos(numer/denom);
+	}
+}
+
+// Put an interval of time in [0, siderealDayLength[
+static inline double wrapDay(double t, double length)
+{
+	t = std::fmod(t, length);
+	return t<0. ? t+length : t;
+}
+
+void StelRiseSet::computeEvents(int n, const Vec3d* equPos, Events* events) const
+{
+	const double sinLat = std::sin(latitude);
+	const double cosLat = std::cos(latitude);
+	const double sinAlt = std::sin(horizonAltitude);
+	const double daysPerRadian = siderealDayLength/(2.*M_PI);
+	for (int i=0; i<n; ++i)
+	{
+		const Vec3d& v = equPos[i];
+		const double r = v.length();
+		const double sinDec = v[2]/r;
+		const double cosDec = std::sqrt(v[0]*v[0]+v[1]*v[1])/r;
+		const double ra = std::atan2(v[1], v[0]);
+		Events& e = events[i];
+
+		// The object transits when the local sidereal time equals its right ascension
+		e.transit = jdStart + wrapDay((ra-localSiderealTime)*daysPerRadian, siderealDayLength);
+
+		const double numer = sinAlt - sinLat*sinDec;
+		const double denom = cosLat*cosDec;
+		if (numer <= -std::fabs(denom))
+		{
+			e.type = Circumpolar;
+			e.rise = e.set = e.transit;
+		}
+		else if (numer >= std::fabs(denom))
+		{
+			e.type = NeverRises;
+			e.rise = e.set = e.transit;
+		}
+		else
+		{
+			const double h = std::acos(numer/denom)*daysPerRadian;
+			e.type = Normal;
+			e.rise = jdStart + wrapDay(e.transit-h-jdStart, siderealDayLength);
+			e.set = jdStart + wrapDay(e.transit+h-jdStart, siderealDayLength);
+		}
+	}
+}
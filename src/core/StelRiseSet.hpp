@@ -0,0 +1,112 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELRISESET_HPP_
+#define _STELRISESET_HPP_
+
+#include "VecMath.hpp"
+
+#include <QHash>
+#include <QString>
+
+//! @class StelRiseSet
+//! Compute the rise, transit and set times of objects fixed on the sky for
+//! one observer and one day.
+//! The computations only need the equatorial coordinates of date of the objects, so
+//! many objects can be processed at once with computeEvents(). The events
+//! asked with getEvents() are cached until the observer or the day changes,
+//! so that the plugins and dialogs can query them at each frame.
+//! The objects of the Solar System move too quickly for these results to be
+//! accurate, their events have to be refined by the caller.
+//! The instance shared by the plugins is available from StelCore::getRiseSet().
+class StelRiseSet
+{
+public:
+	//! How an object behaves during the day.
+	enum EventType
+	{
+		Normal,		//!< The object rises and sets
+		Circumpolar,	//!< The object is always above the horizon
+		NeverRises	//!< The object is always below the horizon
+	};
+
+	//! The events of one object. The dates are julian days, in the first
+	//! sidereal day starting at the beginning of the day set with setObserver().
+	//! For the objects which do not rise and set, only the transit is set.
+	struct Events
+	{
+		EventType type;
+		double rise;
+		double transit;
+		double set;
+	};
+
+	//! Values returned by hourAngle() when the altitude is not reached.
+	static const double AlwaysAbove;
+	static const double AlwaysBelow;
+
+	StelRiseSet();
+
+	//! Set the observer and the day for which the events are computed.
+	//! The cached events are dropped if any parameter changed.
+	//! @param jdStart the julian day of the beginning of the day.
+	//! @param localSiderealTime the local sidereal time at jdStart in radians.
+	//! @param siderealDayLength the length of the sidereal day in days.
+	//! @param latitude the latitude of the observer in radians.
+	//! @param horizonAltitude the altitude of the object at rise and set in radians,
+	//! which includes the refraction and the radius of the object if needed.
+	void setObserver(double jdStart, double localSiderealTime, double siderealDayLength,
+			 double latitude, double horizonAltitude);
+
+	//! Get the events of an object, from the cache if they were already computed for the current day.
+	//! @param id a unique identifier of the object, e.g. its English name.
+	//! @param equPos the position of the object in equatorial coordinates of date.
+	const Events& getEvents(const QString& id, const Vec3d& equPos);
+
+	//! Compute the events of many objects at once, without using the cache.
+	//! @param n the number of objects.
+	//! @param equPos the positions of the objects in equatorial coordinates of date.
+	//! @param events the array in which the n results are written.
+	void computeEvents(int n, const Vec3d* equPos, Events* events) const;
+
+	//! Get the hour angle at which an object reaches an altitude.
+	//! @param latitude the latitude of the observer in radians.
+	//! @param altitude the altitude in radians.
+	//! @param declination the declination of the object in radians.
+	//! @return the hour angle in radians between 0 and pi, or AlwaysAbove or AlwaysBelow
+	//! when the object doesn't reach that altitude.
+	static double hourAngle(double latitude, double altitude, double declination);
+
+	//! Compute hourAngle() for many declinations at once.
+	//! @param n the number of declinations.
+	//! @param declinations the declinations in radians.
+	//! @param hourAngles the array in which the n results are written.
+	static void hourAngles(double latitude, double altitude, int n, const double* declinations, double* hourAngles);
+
+private:
+	double jdStart;
+	double localSiderealTime;
+	double siderealDayLength;
+	double latitude;
+	double horizonAltitude;
+
+	QHash<QString, Events> cache;
+};
+
+#endif // _STELRISESET_HPP_
@@ -0,0 +1,190 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelSensorInput.hpp"
+#include "StelApp.hpp"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QSettings>
+#include <QStringList>
+#include <QUdpSocket>
+
+#include <cmath>
+
+//! Standard gravity in m/s^2.
+static const double Gravity = 9.80665;
+
+//! Bring an angle difference in [-pi, pi].
+static double wrapAngle(double a)
+{
+	while (a>M_PI)
+		a -= 2.*M_PI;
+	while (a<-M_PI)
+		a += 2.*M_PI;
+	return a;
+}
+
+StelSensorInput::StelSensorInput(QSettings* conf)
+	: format(FormatOpentrack)
+	, axisSigns(1.)
+	, stopRequested(0)
+	, backSlot(0)
+	, frontSlot(2)
+	, middleSlot(1)
+{
+	format = conf->value("sensors/format", "opentrack").toString()=="imu" ? FormatImu : FormatOpentrack;
+	port = conf->value("sensors/port", 4242).toInt();
+	pollInterval = qMax(1, qRound(1000./qMax(conf->value("sensors/poll_rate", 1000).toDouble(), 1.)));
+	// The lists may be read as a single string when they are not in the configuration file
+	const QStringList signs = conf->value("sensors/axis_signs", "1,1,1").toStringList().join(",").split(",");
+	for (int i=0; i<3; ++i)
+		axisSigns[i] = signs.value(i, "1").toDouble()<0. ? -1. : 1.;
+	maxPrediction = qBound(0., conf->value("sensors/max_prediction", 0.05).toDouble(), 0.2);
+	gravityTimeConstant = qMax(conf->value("sensors/gravity_time_constant", 0.5).toDouble(), 0.01);
+	clock.start();
+}
+
+StelSensorInput::~StelSensorInput()
+{
+	stop();
+}
+
+void StelSensorInput::stop()
+{
+	stopRequested.fetchAndStoreOrdered(1);
+	wait();
+}
+
+void StelSensorInput::run()
+{
+	QUdpSocket socket;
+	if (!socket.bind(QHostAddress::Any, port))
+	{
+		qWarning() << "WARNING: can't listen to the head tracker on the port" << port << ":" << socket.errorString();
+		return;
+	}
+	qDebug() << "Reading the head tracker on the port" << port;
+
+	QByteArray datagram;
+	while (stopRequested.load()==0)
+	{
+		// The timeout only bounds the time taken to stop, the samples are read as soon as they arrive
+		if (!socket.waitForReadyRead(pollInterval))
+			continue;
+		bool received = false;
+		while (socket.hasPendingDatagrams())
+		{
+			datagram.resize(qMax(0, (int)socket.pendingDatagramSize()));
+			if (socket.readDatagram(datagram.data(), datagram.size())<0)
+				break;
+			processDatagram(datagram, clock.nsecsElapsed());
+			received = true;
+		}
+		if (received)
+			publish();
+	}
+}
+
+void StelSensorInput::processDatagram(const QByteArray& datagram, qint64 time)
+{
+	QDataStream in(datagram);
+	in.setByteOrder(QDataStream::LittleEndian);
+	if (format==FormatOpentrack)
+	{
+		if (datagram.size()<6*(int)sizeof(double))
+			return;
+		in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+		double values[6];
+		for (int i=0; i<6; ++i)
+			in >> values[i];
+		fuseOrientation(Vec3d(values[3], values[4], values[5])*(M_PI/180.), time);
+	}
+	else
+	{
+		if (datagram.size()<6*(int)sizeof(float))
+			return;
+		in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+		float values[6];
+		for (int i=0; i<6; ++i)
+			in >> values[i];
+		fuseImu(Vec3d(values[0], values[1], values[2]), Vec3d(values[3], values[4], values[5]), time);
+	}
+}
+
+void StelSensorInput::fuseOrientation(const Vec3d& yawPitchRoll, qint64 time)
+{
+	const double dt = (time-current.time)/1e9;
+	if (current.valid && dt>1e-4)
+	{
+		// The rate is smoothed, the successive orientations being noisy
+		const Vec3d rates(wrapAngle(yawPitchRoll[0]-current.yawPitchRoll[0])/dt,
+				  (yawPitchRoll[1]-current.yawPitchRoll[1])/dt,
+				  wrapAngle(yawPitchRoll[2]-current.yawPitchRoll[2])/dt);
+		current.rates += (rates-current.rates)*0.3;
+	}
+	current.yawPitchRoll = yawPitchRoll;
+	current.time = time;
+	current.valid = true;
+}
+
+void StelSensorInput::fuseImu(const Vec3d& rates, const Vec3d& acceleration, qint64 time)
+{
+	// Turning right is a negative rotation around the up axis, rolling clockwise a negative one around the backward axis
+	current.rates.set(-rates[1], rates[0], -rates[2]);
+	const double dt = current.valid ? qBound(0., (time-current.time)/1e9, 0.1) : 0.;
+	Vec3d pose = current.yawPitchRoll + current.rates*dt;
+
+	// The accelerometer measures the opposite of the gravity when the head does not accelerate
+	const double g = acceleration.length();
+	if (g>0.8*Gravity && g<1.2*Gravity)
+	{
+		const double gravityPitch = std::atan2(-acceleration[2], std::sqrt(acceleration[0]*acceleration[0]+acceleration[1]*acceleration[1]));
+		const double gravityRoll = std::atan2(-acceleration[0], acceleration[1]);
+		const double k = current.valid ? 1.-std::exp(-dt/gravityTimeConstant) : 1.;
+		pose[1] += k*(gravityPitch-pose[1]);
+		pose[2] += k*wrapAngle(gravityRoll-pose[2]);
+	}
+	pose[0] = wrapAngle(pose[0]);
+	current.yawPitchRoll = pose;
+	current.time = time;
+	current.valid = true;
+}
+
+void StelSensorInput::publish()
+{
+	poseSlots[backSlot] = current;
+	backSlot = middleSlot.fetchAndStoreOrdered(backSlot|NewPoseFlag) & 3;
+}
+
+bool StelSensorInput::predictHeadPose(double displayTime, Vec3d& yawPitchRoll)
+{
+	if (middleSlot.load() & NewPoseFlag)
+		frontSlot = middleSlot.fetchAndStoreOrdered(frontSlot) & 3;
+	const Pose& pose = poseSlots[frontSlot];
+	if (!pose.valid)
+		return false;
+
+	// The pose is extrapolated over its age and until the frame is displayed
+	const double age = (clock.nsecsElapsed()-pose.time)/1e9;
+	const double dt = qBound(0., age+displayTime-StelApp::getTotalRunTime(), maxPrediction);
+	const Vec3d predicted = pose.yawPitchRoll + pose.rates*dt;
+	yawPitchRoll.set(axisSigns[0]*predicted[0], axisSigns[1]*predicted[1], axisSigns[2]*predicted[2]);
+	return true;
+}
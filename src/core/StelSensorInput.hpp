@@ -0,0 +1,111 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELSENSORINPUT_HPP_
+#define _STELSENSORINPUT_HPP_
+
+#include "StelMovementMgr.hpp"
+#include "VecMath.hpp"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QThread>
+
+class QSettings;
+
+//! @class StelSensorInput
+//! Read the samples of a head tracker in a dedicated thread and provide the latest head pose to the StelMovementMgr.
+//! The samples are received as UDP datagrams and read as soon as they arrive, up to the poll rate, so they are
+//! not quantized to the frames nor delayed by the event queue of the GUI thread. The thread fuses the samples in
+//! a head pose and its angular rate, published in a slot read without lock by predictHeadPose(), which
+//! extrapolates the pose to the display time of the frame.
+//! Two formats of datagrams are read, set by the sensors/format setting:
+//! - opentrack: the "UDP over network" output of opentrack, 6 little endian doubles: x, y, z, then yaw, pitch and
+//!   roll in degrees. The angular rate is estimated from the successive orientations.
+//! - imu: 6 little endian floats from a raw inertial sensor: the angular rates around the right, up and backward
+//!   axes of the head in radian per second, then the acceleration along the same axes. The rates are integrated
+//!   and the pitch and roll are corrected from the gravity with a complementary filter. The yaw drifts slowly,
+//!   there is no magnetometer.
+//! The other settings of the sensors section are port, poll_rate (in Hz), axis_signs (the signs applied to the
+//! yaw, pitch and roll), max_prediction (in seconds) and gravity_time_constant (in seconds).
+class StelSensorInput : public QThread, public StelHeadPoseProvider
+{
+	Q_OBJECT
+public:
+	enum Format
+	{
+		FormatOpentrack,
+		FormatImu
+	};
+
+	StelSensorInput(QSettings* conf);
+	~StelSensorInput();
+
+	//! Stop the thread and wait for it to finish.
+	void stop();
+
+	//! Extrapolate the latest pose to the display time, called from the main thread.
+	virtual bool predictHeadPose(double displayTime, Vec3d& yawPitchRoll);
+
+protected:
+	virtual void run();
+
+private:
+	//! The state of the head, published by the sensor thread.
+	struct Pose
+	{
+		Pose() : yawPitchRoll(0.), rates(0.), time(0), valid(false) {}
+		Vec3d yawPitchRoll;
+		Vec3d rates;
+		//! Time of the last sample, from the clock of the instance, in nanoseconds.
+		qint64 time;
+		bool valid;
+	};
+
+	//! Decode a datagram and fuse it in the current pose, in the sensor thread.
+	void processDatagram(const QByteArray& datagram, qint64 time);
+	void fuseOrientation(const Vec3d& yawPitchRoll, qint64 time);
+	void fuseImu(const Vec3d& rates, const Vec3d& acceleration, qint64 time);
+	//! Make the current pose the latest one, in the sensor thread.
+	void publish();
+
+	Format format;
+	quint16 port;
+	int pollInterval;
+	Vec3d axisSigns;
+	double maxPrediction;
+	double gravityTimeConstant;
+
+	//! Clock of the samples, started at the creation of the instance.
+	QElapsedTimer clock;
+	QAtomicInt stopRequested;
+
+	//! Pose fused by the sensor thread.
+	Pose current;
+
+	//! Triple buffer of the published poses: the sensor thread writes in poseSlots[backSlot], the main thread reads
+	//! poseSlots[frontSlot], and they exchange their slot with middleSlot, whose NewPoseFlag is set by the writer.
+	static const int NewPoseFlag = 4;
+	Pose poseSlots[3];
+	int backSlot;
+	int frontSlot;
+	QAtomicInt middleSlot;
+};
+
+#endif // _STELSENSORINPUT_HPP_
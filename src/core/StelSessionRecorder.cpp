@@ -0,0 +1,386 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelSessionRecorder.hpp"
+#include "StelApp.hpp"
+#include "StelActionMgr.hpp"
+#include "StelCore.hpp"
+#include "StelMovementMgr.hpp"
+#ifndef DISABLE_SCRIPTING
+ #include "StelScriptMgr.hpp"
+#endif
+
+#include <QBuffer>
+#include <QDebug>
+#include <QDir>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+StelSessionRecorder::StelSessionRecorder(QObject* parent)
+	: QObject(parent)
+	, capturing(false)
+	, actionsConnected(false)
+	, nestedEvents(0)
+	, inUpdate(false)
+	, hasLastState(false)
+	, lastJD(0.)
+	, lastTimeRate(0.)
+	, lastFov(0.)
+	, replayPos(0)
+	, nbReplayFrames(0)
+{
+}
+
+StelSessionRecorder::~StelSessionRecorder()
+{
+	stopCapture();
+}
+
+bool StelSessionRecorder::startCapture(const QString& path)
+{
+	stopCapture();
+	file.setFileName(path);
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "ERROR: cannot write the session to" << QDir::toNativeSeparators(path) << file.errorString();
+		return false;
+	}
+	stream.setDevice(&file);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << FileMagic << FileVersion;
+
+	StelCore* core = StelApp::getInstance().getCore();
+	connect(core, SIGNAL(locationChanged(StelLocation)), this, SLOT(locationChanged(StelLocation)));
+	capturing = true;
+	hasLastState = false;
+	// The replay starts from the location of the capture
+	locationChanged(core->getCurrentLocation());
+	captureTimer.start();
+	qDebug() << "Capturing the session to" << QDir::toNativeSeparators(path);
+	return true;
+}
+
+void StelSessionRecorder::stopCapture()
+{
+	if (!capturing)
+		return;
+	capturing = false;
+	StelApp::getInstance().getCore()->disconnect(this);
+	if (actionsConnected)
+	{
+		StelActionMgr* actionMgr = StelApp::getInstance().getStelActionManager();
+		foreach (const QString& group, actionMgr->getGroupList())
+		{
+			foreach (StelAction* action, actionMgr->getActionList(group))
+				action->disconnect(this);
+		}
+		actionsConnected = false;
+	}
+	stream.setDevice(NULL);
+	file.close();
+}
+
+bool StelSessionRecorder::startReplay(const QString& path)
+{
+	records.clear();
+	replayPos = 0;
+	nbReplayFrames = 0;
+
+	QFile in(path);
+	if (!in.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "ERROR: cannot read the session" << QDir::toNativeSeparators(path) << in.errorString();
+		return false;
+	}
+	// The sessions are small, read them at once so that the replay does not wait for the disk
+	QByteArray data = in.readAll();
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::ReadOnly);
+	QDataStream input(&buffer);
+	input.setVersion(QDataStream::Qt_5_1);
+	quint32 magic, version;
+	input >> magic >> version;
+	if (input.status()!=QDataStream::Ok || magic!=FileMagic || version!=FileVersion)
+	{
+		qWarning() << "ERROR:" << QDir::toNativeSeparators(path) << "is not a session file of this version";
+		return false;
+	}
+	while (!input.atEnd())
+	{
+		quint8 type;
+		Record record;
+		input >> type >> record.values;
+		if (input.status()!=QDataStream::Ok)
+		{
+			// A capture which was interrupted is replayed up to its last complete record
+			qWarning() << "WARNING: the session" << QDir::toNativeSeparators(path) << "is truncated";
+			break;
+		}
+		record.type = type;
+		if (record.type==FrameRecord)
+			++nbReplayFrames;
+		records.append(record);
+	}
+	qDebug() << "Replaying" << nbReplayFrames << "frames from" << QDir::toNativeSeparators(path);
+	return true;
+}
+
+bool StelSessionRecorder::replayFrame(double* deltaTime, double* captureTime)
+{
+	while (replayPos<records.size())
+	{
+		const Record& record = records.at(replayPos++);
+		if (record.type==FrameRecord)
+		{
+			*captureTime = record.values.at(0).toDouble();
+			*deltaTime = record.values.at(1).toDouble();
+			return true;
+		}
+		apply(record);
+	}
+	return false;
+}
+
+void StelSessionRecorder::replayScriptCommands()
+{
+	// The calls done in the update directly follow the frame
+	while (replayPos<records.size())
+	{
+		const Record& record = records.at(replayPos);
+		if (record.type!=ScriptRecord || !record.values.at(0).toBool())
+			return;
+		apply(record);
+		++replayPos;
+	}
+}
+
+void StelSessionRecorder::beginFrame(double deltaTime)
+{
+	if (!capturing)
+		return;
+	if (!actionsConnected)
+		connectActions();
+
+	// Record what was changed since the last update by the events which are not recorded
+	StelCore* core = StelApp::getInstance().getCore();
+	const StelMovementMgr* mmgr = core->getMovementMgr();
+	const double jd = core->getJDay();
+	const double timeRate = core->getTimeRate();
+	if (!hasLastState || jd!=lastJD || timeRate!=lastTimeRate)
+		write(TimeRecord, QVariantList() << jd << timeRate);
+	const Vec3d viewDirection = mmgr->getViewDirectionJ2000();
+	const double fov = mmgr->getCurrentFov();
+	if (!hasLastState || viewDirection!=lastViewDirection || fov!=lastFov)
+		write(ViewRecord, QVariantList() << viewDirection[0] << viewDirection[1] << viewDirection[2] << fov);
+
+	write(FrameRecord, QVariantList() << captureTimer.nsecsElapsed()/1e9 << deltaTime);
+	inUpdate = true;
+}
+
+void StelSessionRecorder::endFrame()
+{
+	if (!capturing)
+		return;
+	inUpdate = false;
+	StelCore* core = StelApp::getInstance().getCore();
+	const StelMovementMgr* mmgr = core->getMovementMgr();
+	lastJD = core->getJDay();
+	lastTimeRate = core->getTimeRate();
+	lastViewDirection = mmgr->getViewDirectionJ2000();
+	lastFov = mmgr->getCurrentFov();
+	hasLastState = true;
+}
+
+void StelSessionRecorder::recordKeyEvent(const QKeyEvent* event)
+{
+	if (!isRecordingChanges())
+		return;
+	write(KeyRecord, QVariantList() << (int)event->type() << event->key() << (int)event->modifiers()
+	                                << event->text() << event->isAutoRepeat() << event->count());
+}
+
+void StelSessionRecorder::recordMouseEvent(const QMouseEvent* event)
+{
+	if (!isRecordingChanges())
+		return;
+	write(MouseRecord, QVariantList() << (int)event->type() << event->pos() << (int)event->button()
+	                                  << (int)event->buttons() << (int)event->modifiers());
+}
+
+void StelSessionRecorder::recordMove(int x, int y, Qt::MouseButtons b)
+{
+	if (!isRecordingChanges())
+		return;
+	write(MoveRecord, QVariantList() << x << y << (int)b);
+}
+
+void StelSessionRecorder::recordWheelEvent(const QWheelEvent* event)
+{
+	if (!isRecordingChanges())
+		return;
+	write(WheelRecord, QVariantList() << event->pos() << event->globalPos() << event->delta()
+	                                  << (int)event->buttons() << (int)event->modifiers() << (int)event->orientation());
+}
+
+void StelSessionRecorder::recordPinch(qreal scale, bool started)
+{
+	if (!isRecordingChanges())
+		return;
+	write(PinchRecord, QVariantList() << (double)scale << started);
+}
+
+void StelSessionRecorder::recordScriptCommand(const QString& object, bool property, const QByteArray& member, const QVariantList& args)
+{
+	if (!isRecordingChanges())
+		return;
+	write(ScriptRecord, QVariantList() << inUpdate << object << property << member << QVariant(args));
+}
+
+void StelSessionRecorder::actionToggled(bool checked)
+{
+	StelAction* action = qobject_cast<StelAction*>(sender());
+	if (action && isRecordingChanges())
+		write(ActionRecord, QVariantList() << action->getId() << true << checked);
+}
+
+void StelSessionRecorder::actionTriggered()
+{
+	StelAction* action = qobject_cast<StelAction*>(sender());
+	if (action && isRecordingChanges())
+		write(ActionRecord, QVariantList() << action->getId() << false << false);
+}
+
+void StelSessionRecorder::locationChanged(StelLocation loc)
+{
+	if (!isRecordingChanges())
+		return;
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out << loc;
+	write(LocationRecord, QVariantList() << data);
+}
+
+void StelSessionRecorder::write(RecordType type, const QVariantList& values)
+{
+	stream << (quint8)type << values;
+}
+
+void StelSessionRecorder::connectActions()
+{
+	// The actions are added until the plugins are initialized, after the capture was started
+	StelActionMgr* actionMgr = StelApp::getInstance().getStelActionManager();
+	foreach (const QString& group, actionMgr->getGroupList())
+	{
+		foreach (StelAction* action, actionMgr->getActionList(group))
+		{
+			if (action->isCheckable())
+			{
+				write(ActionRecord, QVariantList() << action->getId() << true << action->isChecked());
+				connect(action, SIGNAL(toggled(bool)), this, SLOT(actionToggled(bool)));
+			}
+			else
+				connect(action, SIGNAL(triggered()), this, SLOT(actionTriggered()));
+		}
+	}
+	actionsConnected = true;
+}
+
+void StelSessionRecorder::apply(const Record& record)
+{
+	StelApp& app = StelApp::getInstance();
+	StelCore* core = app.getCore();
+	const QVariantList& v = record.values;
+	switch (record.type)
+	{
+		case KeyRecord:
+		{
+			QKeyEvent event((QEvent::Type)v.at(0).toInt(), v.at(1).toInt(), (Qt::KeyboardModifiers)v.at(2).toInt(),
+			                v.at(3).toString(), v.at(4).toBool(), v.at(5).toInt());
+			app.handleKeys(&event);
+			break;
+		}
+		case MouseRecord:
+		{
+			QMouseEvent event((QEvent::Type)v.at(0).toInt(), v.at(1).toPoint(), (Qt::MouseButton)v.at(2).toInt(),
+			                  (Qt::MouseButtons)v.at(3).toInt(), (Qt::KeyboardModifiers)v.at(4).toInt());
+			app.handleClick(&event);
+			break;
+		}
+		case MoveRecord:
+			app.handleMove(v.at(0).toInt(), v.at(1).toInt(), (Qt::MouseButtons)v.at(2).toInt());
+			break;
+		case WheelRecord:
+		{
+			QWheelEvent event(v.at(0).toPoint(), v.at(1).toPoint(), v.at(2).toInt(), (Qt::MouseButtons)v.at(3).toInt(),
+			                  (Qt::KeyboardModifiers)v.at(4).toInt(), (Qt::Orientation)v.at(5).toInt());
+			app.dispatchWheel(&event);
+			break;
+		}
+		case PinchRecord:
+			app.handlePinch(v.at(0).toDouble(), v.at(1).toBool());
+			break;
+		case TimeRecord:
+			core->setJDay(v.at(0).toDouble());
+			core->setTimeRate(v.at(1).toDouble());
+			break;
+		case ViewRecord:
+		{
+			StelMovementMgr* mmgr = core->getMovementMgr();
+			mmgr->setViewDirectionJ2000(Vec3d(v.at(0).toDouble(), v.at(1).toDouble(), v.at(2).toDouble()));
+			mmgr->setFov(v.at(3).toDouble());
+			break;
+		}
+		case LocationRecord:
+		{
+			QByteArray data = v.at(0).toByteArray();
+			QDataStream in(&data, QIODevice::ReadOnly);
+			StelLocation loc;
+			in >> loc;
+			// The travel from the previous location is not replayed, only the new location
+			core->moveObserverTo(loc, 0., 0.);
+			break;
+		}
+		case ActionRecord:
+		{
+			StelAction* action = app.getStelActionManager()->findAction(v.at(0).toString());
+			if (!action)
+			{
+				qWarning() << "WARNING: the recorded action" << v.at(0).toString() << "does not exist";
+				break;
+			}
+			if (v.at(1).toBool())
+			{
+				if (action->isCheckable())
+					action->setChecked(v.at(2).toBool());
+			}
+			else
+				action->trigger();
+			break;
+		}
+		case ScriptRecord:
+#ifndef DISABLE_SCRIPTING
+			app.getScriptMgr().replayCommand(v.at(1).toString(), v.at(2).toBool(), v.at(3).toByteArray(), v.at(4).toList());
+#endif
+			break;
+		default:
+			qWarning() << "WARNING: unknown record" << record.type << "in the session";
+			break;
+	}
+}
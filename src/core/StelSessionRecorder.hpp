@@ -0,0 +1,167 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELSESSIONRECORDER_HPP_
+#define _STELSESSIONRECORDER_HPP_
+
+#include "StelLocation.hpp"
+#include "VecMath.hpp"
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QVariantList>
+#include <QVector>
+
+class QKeyEvent;
+class QMouseEvent;
+class QWheelEvent;
+
+//! @class StelSessionRecorder
+//! Capture a session to a file and replay it frame by frame, to reproduce the performance problems.
+//! While capturing, each frame is written with its time step and the time at which it started, followed
+//! by what happened until the next frame: the input events sent to StelApp, the actions triggered or
+//! toggled, e.g. by the GUI or when the flag of a module changed, the calls of the scripts, and the
+//! changes of the date, time rate, location and view done outside of the updates.
+//! The state changes caused by a recorded event, e.g. an action triggered by a key, are not recorded
+//! again as the replay of the event reproduces them. The dates and views are written as absolute values
+//! and applied as such, so they can't accumulate errors.
+//! The replay, driven by StelBenchmark (see the --replay-session option), applies the events in the same
+//! order and updates the frames with the recorded time steps, so that the profiler measures the same
+//! frames whatever the speed of the computer. It should be run with the configuration and window size
+//! of the capture. The scripts are not run during a replay, their recorded calls are applied instead.
+class StelSessionRecorder : public QObject
+{
+	Q_OBJECT
+public:
+	StelSessionRecorder(QObject* parent=NULL);
+	~StelSessionRecorder();
+
+	//! Start writing the session to a file, from the next frame.
+	//! @return false if the file can not be written.
+	bool startCapture(const QString& path);
+	//! Stop the capture and close the file.
+	void stopCapture();
+	bool isCapturing() const {return capturing;}
+
+	//! Load a session captured with startCapture() to replay it.
+	//! @return false if the file can not be read or is not a session.
+	bool startReplay(const QString& path);
+	bool isReplaying() const {return replayPos<records.size();}
+	//! Get the number of frames of the session loaded by startReplay().
+	int getNbReplayFrames() const {return nbReplayFrames;}
+	//! Apply the events recorded before the next frame. To be called before StelApp::update().
+	//! @param deltaTime receives the time step of the frame.
+	//! @param captureTime receives the time of the frame since the start of the capture, in seconds.
+	//! @return false at the end of the session.
+	bool replayFrame(double* deltaTime, double* captureTime);
+	//! Apply the script calls which were executed in the update of the current frame.
+	//! Called by StelApp::update() where the script commands are processed.
+	void replayScriptCommands();
+
+	//! Record the start of the update of a frame. Called by StelApp::update().
+	void beginFrame(double deltaTime);
+	//! Keep the state updated by the frame, to find what was changed before the next one.
+	void endFrame();
+
+	//! Record the input events, called by the StelApp handlers.
+	void recordKeyEvent(const QKeyEvent* event);
+	void recordMouseEvent(const QMouseEvent* event);
+	void recordMove(int x, int y, Qt::MouseButtons b);
+	//! Record a wheel event whose delta was collected, as sent to StelApp::dispatchWheel().
+	void recordWheelEvent(const QWheelEvent* event);
+	void recordPinch(qreal scale, bool started);
+	//! Record a call done by a script, executed in the main thread.
+	//! @param object the name of the object in the script engine.
+	//! @param property whether member is a property written, else the signature of a method called.
+	void recordScriptCommand(const QString& object, bool property, const QByteArray& member, const QVariantList& args);
+
+	//! Mark the handling of a recorded event, when the changes it causes are not recorded.
+	class EventScope
+	{
+	public:
+		EventScope(StelSessionRecorder* r) : recorder(r) {if (recorder) ++recorder->nestedEvents;}
+		~EventScope() {if (recorder) --recorder->nestedEvents;}
+	private:
+		StelSessionRecorder* recorder;
+	};
+
+private slots:
+	void actionToggled(bool checked);
+	void actionTriggered();
+	void locationChanged(StelLocation loc);
+
+private:
+	enum RecordType
+	{
+		FrameRecord,
+		KeyRecord,
+		MouseRecord,
+		MoveRecord,
+		WheelRecord,
+		PinchRecord,
+		TimeRecord,
+		ViewRecord,
+		LocationRecord,
+		ActionRecord,
+		ScriptRecord
+	};
+
+	struct Record
+	{
+		int type;
+		QVariantList values;
+	};
+
+	//! The first bytes of a session file, "STSF", and the version of the format.
+	static const quint32 FileMagic = 0x53545346;
+	static const quint32 FileVersion = 1;
+
+	void write(RecordType type, const QVariantList& values);
+	//! Whether the changes happening now have to be recorded.
+	bool isRecordingChanges() const {return capturing && nestedEvents==0;}
+	//! Listen to the actions, and record their current state so that the replay starts from it.
+	void connectActions();
+	void apply(const Record& record);
+
+	bool capturing;
+	QFile file;
+	QDataStream stream;
+	QElapsedTimer captureTimer;
+	bool actionsConnected;
+	//! Depth of the recorded events being handled.
+	int nestedEvents;
+	//! Whether the current frame is being updated, between beginFrame() and endFrame().
+	bool inUpdate;
+
+	//! The state at the end of the last update, invalid before the first frame.
+	bool hasLastState;
+	double lastJD;
+	double lastTimeRate;
+	Vec3d lastViewDirection;
+	double lastFov;
+
+	QVector<Record> records;
+	int replayPos;
+	int nbReplayFrames;
+};
+
+#endif // _STELSESSIONRECORDER_HPP_
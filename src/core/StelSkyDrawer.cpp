@@ -35,6 +35,8 @@
 #include "StelUtils.hpp"
 #include "StelMovementMgr.hpp"
 #include "StelPainter.hpp"
+#include "StelRenderStats.hpp"
+#include "StelRenderProfile.hpp"
 
 #include <QOpenGLContext>
 #include <QOpenGLShaderProgram>
@@ -43,6 +45,8 @@
 #include <QDebug>
 #include <QtGlobal>
 
+#include <cstddef>
+
 // The 0.025 corresponds to the maximum eye resolution in degree
 #define EYE_RESOLUTION (0.25f)
 #define MAX_LINEAR_RADIUS 8.f
@@ -62,9 +66,17 @@ StelSkyDrawer::StelSkyDrawer(StelCore* acore) :
 	inScale(1.f),
 	starShaderProgram(NULL),
 	starShaderVars(StarShaderVars()),
+	flagUseVertexBuffers(false),
+	starVertexBuffer(QOpenGLBuffer::VertexBuffer),
+	starTexCoordBuffer(QOpenGLBuffer::VertexBuffer),
+	starVertexBufferOffset(0),
 	maxLum(0.f),
 	oldLum(-1.f),
-	big3dModelHaloRadius(150.f)
+	big3dModelHaloRadius(150.f),
+	rcMagRadius0(-1.f),
+	rcMagLnRadiusPerMag(0.f),
+	rcMagVersion(0),
+	twinklePhase(0.f)
 {
 	QSettings* conf = StelApp::getInstance().getSettings();
 	initColorTableFromConfigFile(conf);
@@ -137,6 +149,9 @@ StelSkyDrawer::~StelSkyDrawer()
 	delete[] textureCoordArray;
 	textureCoordArray = NULL;
 	
+	starVertexBuffer.destroy();
+	starTexCoordBuffer.destroy();
+
 	delete starShaderProgram;
 	starShaderProgram = NULL;
 }
@@ -150,24 +165,26 @@ void StelSkyDrawer::init()
 	texSunHalo = StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/halo.png");
 
 	// Create shader program
-	QOpenGLShader vshader(QOpenGLShader::Vertex);
 	const char *vsrc =
 		"attribute mediump vec2 pos;\n"
 		"attribute mediump vec2 texCoord;\n"
-		"attribute mediump vec3 color;\n"
+		"attribute mediump vec4 color;\n"
 		"uniform mediump mat4 projectionMatrix;\n"
+		"uniform mediump float twinkleAmount;\n"
+		"uniform highp float twinklePhase;\n"
 		"varying mediump vec2 texc;\n"
 		"varying mediump vec3 outColor;\n"
 		"void main(void)\n"
 		"{\n"
 		"    gl_Position = projectionMatrix * vec4(pos.x, pos.y, 0, 1);\n"
 		"    texc = texCoord;\n"
-		"    outColor = color;\n"
+		"    // The alpha channel holds 128 plus a per-star seed for the twinkling sources, 0 for the others\n"
+		"    highp float seed = floor(color.a*255.+0.5);\n"
+		"    highp float twinkles = step(127.5, seed);\n"
+		"    highp float rnd = fract(sin((seed-128.*twinkles)*12.9898+twinklePhase*78.233)*43758.5453);\n"
+		"    outColor = color.rgb*(1.-twinkleAmount*twinkles*rnd);\n"
 		"}\n";
-	vshader.compileSourceCode(vsrc);
-	if (!vshader.log().isEmpty()) { qWarning() << "StelSkyDrawer::init(): Warnings while compiling vshader: " << vshader.log(); }
 
-	QOpenGLShader fshader(QOpenGLShader::Fragment);
 	const char *fsrc =
 		"varying mediump vec2 texc;\n"
 		"varying mediump vec3 outColor;\n"
@@ -176,22 +193,74 @@ void StelSkyDrawer::init()
 		"{\n"
 		"    gl_FragColor = texture2D(tex, texc)*vec4(outColor, 1.);\n"
 		"}\n";
-	fshader.compileSourceCode(fsrc);
-	if (!fshader.log().isEmpty()) { qWarning() << "StelSkyDrawer::init(): Warnings while compiling fshader: " << fshader.log(); }
 
 	starShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	starShaderProgram->addShader(&vshader);
-	starShaderProgram->addShader(&fshader);
-	StelPainter::linkProg(starShaderProgram, "starShader");
+	StelPainter::buildProg(starShaderProgram, "starShader", vsrc, fsrc);
 	starShaderVars.projectionMatrix = starShaderProgram->uniformLocation("projectionMatrix");
 	starShaderVars.texCoord = starShaderProgram->attributeLocation("texCoord");
 	starShaderVars.pos = starShaderProgram->attributeLocation("pos");
 	starShaderVars.color = starShaderProgram->attributeLocation("color");
 	starShaderVars.texture = starShaderProgram->uniformLocation("tex");
-			
+	starShaderVars.twinkleAmount = starShaderProgram->uniformLocation("twinkleAmount");
+	starShaderVars.twinklePhase = starShaderProgram->uniformLocation("twinklePhase");
+
+	setFlagUseVertexBuffers(StelApp::getInstance().getSettings()->value("stars/flag_star_vertex_buffers", false).toBool()
+				|| StelApp::getInstance().getRenderProfile()->getFlagVertexBuffersOnly());
+
 	update(0);
 }
 
+void StelSkyDrawer::setFlagUseVertexBuffers(bool b)
+{
+	flagUseVertexBuffers = b;
+	if (flagUseVertexBuffers && !starVertexBuffer.isCreated())
+		initVertexBuffers();
+}
+
+void StelSkyDrawer::initVertexBuffers()
+{
+	// The texture coordinates are the same for every batch: upload them once.
+	starTexCoordBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+	if (!starTexCoordBuffer.create())
+	{
+		qWarning() << "StelSkyDrawer: cannot create vertex buffers, falling back to client-side arrays";
+		flagUseVertexBuffers = false;
+		return;
+	}
+	starTexCoordBuffer.bind();
+	starTexCoordBuffer.allocate(textureCoordArray, maxPointSources*6*2);
+	starTexCoordBuffer.release();
+
+	starVertexBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+	starVertexBuffer.create();
+	starVertexBuffer.bind();
+	starVertexBuffer.allocate(maxPointSources*6*sizeof(StarVertex)*starVertexBufferBatches);
+	starVertexBuffer.release();
+	starVertexBufferOffset = 0;
+}
+
+void StelSkyDrawer::setVertexBufferAttributes()
+{
+	const int batchSize = nbPointSources*6*sizeof(StarVertex);
+	starVertexBuffer.bind();
+	if (starVertexBufferOffset+batchSize > starVertexBuffer.size())
+	{
+		// Orphan the old storage, the driver will give us a fresh block
+		// while the previous draw calls are still using the old one.
+		starVertexBuffer.allocate(starVertexBuffer.size());
+		starVertexBufferOffset = 0;
+	}
+	starVertexBuffer.write(starVertexBufferOffset, vertexArray, batchSize);
+	starShaderProgram->setAttributeBuffer(starShaderVars.pos, GL_FLOAT, starVertexBufferOffset, 2, sizeof(StarVertex));
+	starShaderProgram->setAttributeBuffer(starShaderVars.color, GL_UNSIGNED_BYTE, starVertexBufferOffset+offsetof(StarVertex, color), 4, sizeof(StarVertex));
+	starVertexBuffer.release();
+	starVertexBufferOffset += batchSize;
+
+	starTexCoordBuffer.bind();
+	starShaderProgram->setAttributeBuffer(starShaderVars.texCoord, GL_UNSIGNED_BYTE, 0, 2, 0);
+	starTexCoordBuffer.release();
+}
+
 void StelSkyDrawer::update(double)
 {
 	float fov = core->getMovementMgr()->getCurrentFov();
@@ -235,70 +304,26 @@ void StelSkyDrawer::update(double)
 	limitLuminance = computeLimitLuminance();
 }
 
-// Compute the current limit magnitude by dichotomy
+// Compute the current limit magnitude
+// The radius computed by computeRCMag() is an exponential function of the magnitude,
+// so the magnitude at which it reaches the visibility threshold can be solved directly.
 float StelSkyDrawer::computeLimitMagnitude() const
 {
-	float a=-26.f;
-	float b=30.f;
-	RCMag rcmag;
-	float lim = 0.f;
-	int safety=0;
-	while (std::fabs(lim-a)>0.05f)
-	{
-		computeRCMag(lim, &rcmag);
-		if (rcmag.radius<=0.f)
-		{
-			float tmp = lim;
-			lim=(a+lim)*0.5;
-			b=tmp;
-		}
-		else
-		{
-			float tmp = lim;
-			lim=(b+lim)*0.5;
-			a=tmp;
-		}
-		++safety;
-		if (safety>20)
-		{
-			lim=-99;
-			break;
-		}
-	}
-	return lim;
+	// Smallest radius for which computeRCMag() returns true: r^3/1.728 >= 0.05
+	static const float lnMinVisibleRadius = std::log(0.442083f);
+	const float pFact = starRelativeScale*1.40f/2.f;
+	const float lnRadius0 = std::log(eye->adaptLuminanceScaledLn(pointSourceMagToLnLuminance(0.f), pFact)*starLinearScale);
+	const float lnRadiusPerMag = -0.92103f*eye->getLuminanceExponent()*pFact;
+	if (lnRadiusPerMag>=0.f)
+		return lnRadius0>=lnMinVisibleRadius ? 30.f : -26.f;
+	return qBound(-26.f, (lnMinVisibleRadius-lnRadius0)/lnRadiusPerMag, 30.f);
 }
 
-// Compute the current limit luminance by dichotomy
+// Compute the current limit luminance
 float StelSkyDrawer::computeLimitLuminance() const
 {
-	float a=0.f;
-	float b=500000.f;
-	float lim=40.f;
-	int safety=0;
-	float adaptL;
-	while (std::fabs(lim-a)>0.05)
-	{
-		adaptL = eye->adaptLuminanceScaled(lim);
-		if (adaptL<=0.05f) // Object considered not visible if its adapted scaled luminance<0.05
-		{
-			float tmp = lim;
-			lim=(b+lim)*0.5;
-			a=tmp;
-		}
-		else
-		{
-			float tmp = lim;
-			lim=(a+lim)*0.5;
-			b=tmp;
-		}
-		++safety;
-		if (safety>30)
-		{
-			lim=500000;
-			break;
-		}
-	}
-	return lim;
+	// Object considered not visible if its adapted scaled luminance<0.05
+	return qBound(0.f, eye->reverseAdaptLuminanceScaled(0.05f), 500000.f);
 }
 
 // Compute the ln of the luminance for a point source with the given mag for the current FOV
@@ -327,8 +352,90 @@ float StelSkyDrawer::luminanceToSurfacebrightness(float lum)
 // Compute RMag and CMag from magnitude for a point source.
 bool StelSkyDrawer::computeRCMag(float mag, RCMag* rcMag) const
 {
-	rcMag->radius = eye->adaptLuminanceScaledLn(pointSourceMagToLnLuminance(mag), starRelativeScale*1.40f/2.f);
-	rcMag->radius *=starLinearScale;
+	const float radius = eye->adaptLuminanceScaledLn(pointSourceMagToLnLuminance(mag), starRelativeScale*1.40f/2.f);
+	return radiusToRCMag(radius*starLinearScale, rcMag);
+}
+
+int StelSkyDrawer::computeRCMagTable(float magMin, float magStep, int n, RCMag* table) const
+{
+	// The radius is an exponential function of the magnitude, so only the first entry needs
+	// an exp(), the next ones are obtained by multiplying by a constant ratio.
+	const float pFact = starRelativeScale*1.40f/2.f;
+	const float ratio = std::exp(-0.92103f*magStep*eye->getLuminanceExponent()*pFact);
+	float radius = eye->adaptLuminanceScaledLn(pointSourceMagToLnLuminance(magMin), pFact)*starLinearScale;
+	int i=0;
+	for (;i<n;++i)
+	{
+		if (radiusToRCMag(radius, &table[i])==false)
+			break;
+		radius *= ratio;
+	}
+	const int nbVisible = i;
+	// The radius decreases with the magnitude so all the remaining entries are too faint
+	for (;i<n;++i)
+	{
+		table[i].radius=0.f;
+		table[i].luminance=0.f;
+	}
+	return nbVisible;
+}
+
+unsigned int StelSkyDrawer::getRCMagVersion()
+{
+	// The eye adaptation is changed in preDraw() and by findWorldLumForMag(), so the
+	// parameters are compared when needed instead of being tracked in all the setters.
+	const float pFact = starRelativeScale*1.40f/2.f;
+	const float radius0 = eye->adaptLuminanceScaledLn(pointSourceMagToLnLuminance(0.f), pFact)*starLinearScale;
+	const float lnRadiusPerMag = -0.92103f*eye->getLuminanceExponent()*pFact;
+	if (radius0!=rcMagRadius0 || lnRadiusPerMag!=rcMagLnRadiusPerMag)
+	{
+		rcMagRadius0 = radius0;
+		rcMagLnRadiusPerMag = lnRadiusPerMag;
+		++rcMagVersion;
+	}
+	return rcMagVersion;
+}
+
+const RCMag* StelSkyDrawer::getRCMagTable(float magMin, float magStep, int n, float radiusFactor, int* nbVisible)
+{
+	const unsigned int version = getRCMagVersion();
+	RCMagTable* t = NULL;
+	for (int i=0;i<rcMagTables.size();++i)
+	{
+		RCMagTable& c = rcMagTables[i];
+		if (c.magMin==magMin && c.magStep==magStep && c.table.size()==n)
+		{
+			t = &c;
+			break;
+		}
+	}
+	if (t==NULL)
+	{
+		rcMagTables.append(RCMagTable());
+		t = &rcMagTables.last();
+		t->magMin = magMin;
+		t->magStep = magStep;
+		t->radiusFactor = 0.f;
+		t->nbVisible = 0;
+		t->table.resize(n);
+		t->version = version-1;
+	}
+	if (t->version!=version || t->radiusFactor!=radiusFactor)
+	{
+		RCMag* table = t->table.data();
+		t->nbVisible = computeRCMagTable(magMin, magStep, n, table);
+		for (int i=0;i<t->nbVisible;++i)
+			table[i].radius *= radiusFactor;
+		t->version = version;
+		t->radiusFactor = radiusFactor;
+	}
+	*nbVisible = t->nbVisible;
+	return t->table.constData();
+}
+
+bool StelSkyDrawer::radiusToRCMag(float radius, RCMag* rcMag) const
+{
+	rcMag->radius = radius;
 
 	// Use now statically min_rmag = 0.5, because higher and too small values look bad
 	if (rcMag->radius < 0.3f)
@@ -387,20 +494,31 @@ void StelSkyDrawer::postDrawPointSource(StelPainter* sPainter)
 	glEnable(GL_BLEND);
 
 	const Mat4f& m = sPainter->getProjector()->getProjectionMatrix();
-	const QMatrix4x4 qMat(m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]);
+	const QMatrix4x4 qMat = StelPainter::toQMatrix(m);
 	
 	Q_ASSERT(sizeof(StarVertex)==12);
 	
+	StelPainter::flushPendingText();
 	starShaderProgram->bind();
-	starShaderProgram->setAttributeArray(starShaderVars.pos, GL_FLOAT, (GLfloat*)vertexArray, 2, 12);
+	if (flagUseVertexBuffers)
+	{
+		setVertexBufferAttributes();
+	}
+	else
+	{
+		starShaderProgram->setAttributeArray(starShaderVars.pos, GL_FLOAT, (GLfloat*)vertexArray, 2, 12);
+		starShaderProgram->setAttributeArray(starShaderVars.color, GL_UNSIGNED_BYTE, (GLubyte*)&(vertexArray[0].color), 4, 12);
+		starShaderProgram->setAttributeArray(starShaderVars.texCoord, GL_UNSIGNED_BYTE, (GLubyte*)textureCoordArray, 2, 0);
+	}
 	starShaderProgram->enableAttributeArray(starShaderVars.pos);
-	starShaderProgram->setAttributeArray(starShaderVars.color, GL_UNSIGNED_BYTE, (GLubyte*)&(vertexArray[0].color), 3, 12);
 	starShaderProgram->enableAttributeArray(starShaderVars.color);
-	starShaderProgram->setUniformValue(starShaderVars.projectionMatrix, qMat);
-	starShaderProgram->setAttributeArray(starShaderVars.texCoord, GL_UNSIGNED_BYTE, (GLubyte*)textureCoordArray, 2, 0);
 	starShaderProgram->enableAttributeArray(starShaderVars.texCoord);
+	starShaderProgram->setUniformValue(starShaderVars.projectionMatrix, qMat);
+	starShaderProgram->setUniformValue(starShaderVars.twinkleAmount, twinkleAmount);
+	starShaderProgram->setUniformValue(starShaderVars.twinklePhase, twinklePhase);
 	
 	glDrawArrays(GL_TRIANGLES, 0, nbPointSources*6);
+	StelApp::getInstance().getRenderStats()->add(StelRenderStats::PointSourceFlushes);
 	
 	starShaderProgram->disableAttributeArray(starShaderVars.pos);
 	starShaderProgram->disableAttributeArray(starShaderVars.color);
@@ -410,6 +528,52 @@ void StelSkyDrawer::postDrawPointSource(StelPainter* sPainter)
 	nbPointSources = 0;
 }
 
+unsigned char StelSkyDrawer::computeTwinkleSeed(const Vec3f& v) const
+{
+	// The twinkling is computed in the shader, from a seed derived from the direction of the source
+	// so that it is stable from one frame to the next. The seed is 0 for the sources which don't twinkle.
+	const int seed = (int)(v[0]*5003.f+v[1]*7919.f+v[2]*3571.f);
+	return (flagStarTwinkle && flagHasAtmosphere) ? (unsigned char)(128 | (seed & 127)) : 0;
+}
+
+void StelSkyDrawer::fillPointSourceVertices(StarVertex* vx, const Vec3f& win, float radius, const Vec3f& color, float luminance, unsigned char twinkleSeed)
+{
+	unsigned char starColor[4] = {0, 0, 0, twinkleSeed};
+	starColor[0] = (unsigned char)std::min((int)(color[0]*luminance*255+0.5f), 255);
+	starColor[1] = (unsigned char)std::min((int)(color[1]*luminance*255+0.5f), 255);
+	starColor[2] = (unsigned char)std::min((int)(color[2]*luminance*255+0.5f), 255);
+
+	vx->pos.set(win[0]-radius,win[1]-radius); memcpy(vx->color, starColor, 4); ++vx;
+	vx->pos.set(win[0]+radius,win[1]-radius); memcpy(vx->color, starColor, 4); ++vx;
+	vx->pos.set(win[0]+radius,win[1]+radius); memcpy(vx->color, starColor, 4); ++vx;
+	vx->pos.set(win[0]-radius,win[1]-radius); memcpy(vx->color, starColor, 4); ++vx;
+	vx->pos.set(win[0]+radius,win[1]+radius); memcpy(vx->color, starColor, 4); ++vx;
+	vx->pos.set(win[0]-radius,win[1]+radius); memcpy(vx->color, starColor, 4); ++vx;
+}
+
+bool StelSkyDrawer::computeBigHalo(const RCMag& rcMag, const Vec3f& color, Vec3f& haloColor)
+{
+	// If the rmag is big, draw a big halo
+	if (rcMag.radius<=MAX_LINEAR_RADIUS+5.f)
+		return false;
+	float cmag = qMin(rcMag.luminance,(float)(rcMag.radius-(MAX_LINEAR_RADIUS+5.f))/30.f);
+	if (cmag>1.f)
+		cmag = 1.f;
+	haloColor = color*cmag;
+	return true;
+}
+
+void StelSkyDrawer::drawBigHalo(StelPainter* sPainter, const Vec3f& win, const Vec3f& haloColor)
+{
+	const float rmag = 150.f;
+	texBigHalo->bind();
+	sPainter->enableTexture2d(true);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glEnable(GL_BLEND);
+	sPainter->setColor(haloColor[0], haloColor[1], haloColor[2]);
+	sPainter->drawSprite2dModeNoDeviceScale(win[0], win[1], rmag);
+}
+
 // Draw a point source halo.
 bool StelSkyDrawer::drawPointSource(StelPainter* sPainter, const Vec3f& v, const RCMag& rcMag, const Vec3f& color, bool checkInScreen)
 {
@@ -422,39 +586,12 @@ bool StelSkyDrawer::drawPointSource(StelPainter* sPainter, const Vec3f& v, const
 	if (!(checkInScreen ? sPainter->getProjector()->projectCheck(v, win) : sPainter->getProjector()->project(v, win)))
 		return false;
 
-	const float radius = rcMag.radius;
-	// Random coef for star twinkling
-	const float tw = (flagStarTwinkle && flagHasAtmosphere) ? (1.f-twinkleAmount*rand()/RAND_MAX)*rcMag.luminance : rcMag.luminance;
+	Vec3f haloColor;
+	if (computeBigHalo(rcMag, color, haloColor))
+		drawBigHalo(sPainter, win, haloColor);
 
-	// If the rmag is big, draw a big halo
-	if (radius>MAX_LINEAR_RADIUS+5.f)
-	{
-		float cmag = qMin(rcMag.luminance,(float)(radius-(MAX_LINEAR_RADIUS+5.f))/30.f);
-		float rmag = 150.f;
-		if (cmag>1.f)
-			cmag = 1.f;
-
-		texBigHalo->bind();
-		sPainter->enableTexture2d(true);
-		glBlendFunc(GL_ONE, GL_ONE);
-		glEnable(GL_BLEND);				
-		sPainter->setColor(color[0]*cmag, color[1]*cmag, color[2]*cmag);
-		sPainter->drawSprite2dModeNoDeviceScale(win[0], win[1], rmag);
-	}
-
-	unsigned char starColor[3] = {0, 0, 0};
-	starColor[0] = (unsigned char)std::min((int)(color[0]*tw*255+0.5f), 255);
-	starColor[1] = (unsigned char)std::min((int)(color[1]*tw*255+0.5f), 255);
-	starColor[2] = (unsigned char)std::min((int)(color[2]*tw*255+0.5f), 255);
-	
 	// Store the drawing instructions in the vertex arrays
-	StarVertex* vx = &(vertexArray[nbPointSources*6]);
-	vx->pos.set(win[0]-radius,win[1]-radius); memcpy(vx->color, starColor, 3); ++vx;
-	vx->pos.set(win[0]+radius,win[1]-radius); memcpy(vx->color, starColor, 3); ++vx;
-	vx->pos.set(win[0]+radius,win[1]+radius); memcpy(vx->color, starColor, 3); ++vx;
-	vx->pos.set(win[0]-radius,win[1]-radius); memcpy(vx->color, starColor, 3); ++vx;
-	vx->pos.set(win[0]+radius,win[1]+radius); memcpy(vx->color, starColor, 3); ++vx;
-	vx->pos.set(win[0]-radius,win[1]+radius); memcpy(vx->color, starColor, 3); ++vx;
+	fillPointSourceVertices(&(vertexArray[nbPointSources*6]), win, rcMag.radius, color, rcMag.luminance, computeTwinkleSeed(v));
 
 	++nbPointSources;
 	if (nbPointSources>=maxPointSources)
@@ -465,6 +602,55 @@ bool StelSkyDrawer::drawPointSource(StelPainter* sPainter, const Vec3f& v, const
 	return true;
 }
 
+bool StelSkyDrawer::projectPointSource(const StelProjector* prj, const Vec3f& v, const RCMag& rcMag, unsigned int bV, bool checkInScreen, PointSourceBatch& batch) const
+{
+	return projectPointSource(prj, v, rcMag, colorTable[bV], checkInScreen, batch);
+}
+
+bool StelSkyDrawer::projectPointSource(const StelProjector* prj, const Vec3f& v, const RCMag& rcMag, const Vec3f& color, bool checkInScreen, PointSourceBatch& batch) const
+{
+	if (rcMag.radius<=0.f)
+		return false;
+
+	Vec3f win;
+	if (!(checkInScreen ? prj->projectCheck(v, win) : prj->project(v, win)))
+		return false;
+
+	Vec3f haloColor;
+	if (computeBigHalo(rcMag, color, haloColor))
+	{
+		batch.bigHaloPositions.append(win);
+		batch.bigHaloColors.append(haloColor);
+	}
+
+	const int first = batch.vertices.size();
+	batch.vertices.resize(first+6);
+	fillPointSourceVertices(batch.vertices.data()+first, win, rcMag.radius, color, rcMag.luminance, computeTwinkleSeed(v));
+	return true;
+}
+
+void StelSkyDrawer::drawPointSourceBatch(StelPainter* sPainter, const PointSourceBatch& batch)
+{
+	Q_ASSERT(sPainter);
+
+	for (int i=0;i<batch.bigHaloPositions.size();++i)
+		drawBigHalo(sPainter, batch.bigHaloPositions.at(i), batch.bigHaloColors.at(i));
+
+	// Copy the sources in the vertex arrays, flushing them each time they are full
+	const StarVertex* src = batch.vertices.constData();
+	unsigned int remaining = batch.vertices.size()/6;
+	while (remaining>0)
+	{
+		const unsigned int n = qMin(remaining, maxPointSources-nbPointSources);
+		memcpy(&(vertexArray[nbPointSources*6]), src, n*6*sizeof(StarVertex));
+		src += n*6;
+		remaining -= n;
+		nbPointSources += n;
+		if (nbPointSources>=maxPointSources)
+			postDrawPointSource(sPainter);
+	}
+}
+
 
 // Terminate drawing of a 3D model, draw the halo
 void StelSkyDrawer::postDrawSky3dModel(StelPainter* painter, const Vec3f& v, float illuminatedArea, float mag, const Vec3f& color)
@@ -495,10 +681,24 @@ void StelSkyDrawer::postDrawSky3dModel(StelPainter* painter, const Vec3f& v, flo
 	}
 
 	// Now draw the halo according the object brightness
-	bool save = flagStarTwinkle;
-	flagStarTwinkle = false;
-
 	RCMag rcm;
+	if (computeSky3dModelHalo(pixPerRad, illuminatedArea, mag, &rcm) && !noStarHalo)
+	{
+		bool save = flagStarTwinkle;
+		flagStarTwinkle = false;
+		preDrawPointSource(painter);
+		drawPointSource(painter, v, rcm, color);
+		postDrawPointSource(painter);
+		flagStarTwinkle=save;
+	}
+}
+
+bool StelSkyDrawer::computeSky3dModelHalo(float pixPerRad, float illuminatedArea, float mag, RCMag* rcMag)
+{
+	// Assume a disk shape
+	float pixRadius = std::sqrt(illuminatedArea/(60.*60.)*M_PI/180.*M_PI/180.*(pixPerRad*pixPerRad))/M_PI;
+
+	RCMag& rcm = *rcMag;
 	computeRCMag(mag, &rcm);
 
 	// We now have the radius and luminosity of the small halo
@@ -536,13 +736,7 @@ void StelSkyDrawer::postDrawSky3dModel(StelPainter* painter, const Vec3f& v, flo
 		}
 	}
 
-	if (!noStarHalo)
-	{
-		preDrawPointSource(painter);
-		drawPointSource(painter, v, rcm, color);
-		postDrawPointSource(painter);
-	}
-	flagStarTwinkle=save;
+	return rcm.radius>0.f && rcm.luminance>0.f;
 }
 
 float StelSkyDrawer::findWorldLumForMag(float mag, float targetRadius)
@@ -614,6 +808,8 @@ void StelSkyDrawer::reportLuminanceInFov(float lum, bool fastAdaptation)
 
 void StelSkyDrawer::preDraw()
 {
+	// A new random phase each frame makes the twinkling of all the sources change
+	twinklePhase = (float)rand()/RAND_MAX;
 	eye->setWorldAdaptationLuminance(maxLum);
 	// Re-initialize for next stage
 	oldLum = maxLum;
@@ -26,6 +26,8 @@
 #include "VecMath.hpp"
 
 #include <QObject>
+#include <QOpenGLBuffer>
+#include <QVector>
 
 class StelToneReproducer;
 class StelCore;
@@ -78,6 +80,45 @@ public:
 
 	bool drawPointSource(StelPainter* sPainter, const Vec3f& v, const RCMag &rcMag, const Vec3f& bcolor, bool checkInScreen=false);
 
+	//! Vertex format for a point source.
+	//! Texture pos is stored in another separately.
+	struct StarVertex {
+		Vec2f pos;
+		unsigned char color[4];
+	};
+
+	//! Point sources projected by projectPointSource(), which can be filled from a worker thread
+	//! and then drawn from the GL thread with drawPointSourceBatch().
+	struct PointSourceBatch
+	{
+		//! The 6 vertices of each point source.
+		QVector<StarVertex> vertices;
+		//! The window position and color of the big halos of the brightest sources.
+		QVector<Vec3f> bigHaloPositions;
+		QVector<Vec3f> bigHaloColors;
+		void clear() {vertices.resize(0); bigHaloPositions.resize(0); bigHaloColors.resize(0);}
+	};
+
+	//! Project a point source halo into a batch instead of drawing it.
+	//! This method does not use OpenGL and can be called from several threads at the same time
+	//! with different batches, as long as the StelSkyDrawer parameters are not changed meanwhile.
+	//! @param prj the projector to use.
+	//! @param v the 3d position of the source in J2000 reference frame
+	//! @param rcMag the radius and luminance of the source as computed by computeRCMag()
+	//! @param bV the source B-V index
+	//! @param checkInScreen whether source in screen should be checked to avoid unnecessary drawing.
+	//! @param batch the batch receiving the source.
+	//! @return true if the source was actually visible and added to the batch
+	bool projectPointSource(const StelProjector* prj, const Vec3f& v, const RCMag& rcMag, unsigned int bV, bool checkInScreen, PointSourceBatch& batch) const;
+
+	//! Project a point source halo of a given color into a batch, see the projectPointSource() above.
+	//! @param color the RGB color of the source.
+	bool projectPointSource(const StelProjector* prj, const Vec3f& v, const RCMag& rcMag, const Vec3f& color, bool checkInScreen, PointSourceBatch& batch) const;
+
+	//! Draw the point sources of a batch filled by projectPointSource().
+	//! Must be called between preDrawPointSource() and postDrawPointSource().
+	void drawPointSourceBatch(StelPainter* sPainter, const PointSourceBatch& batch);
+
 	//! Terminate drawing of a 3D model, draw the halo
 	//! @param p the StelPainter instance to use for this drawing operation
 	//! @param v the 3d position of the source in J2000 reference frame
@@ -86,12 +127,49 @@ public:
 	//! @param color the object halo RGB color
 	void postDrawSky3dModel(StelPainter* p, const Vec3f& v, float illuminatedArea, float mag, const Vec3f& color = Vec3f(1.f,1.f,1.f));
 
+	//! Compute the point source halo drawn by postDrawSky3dModel() around a 3D model, and report its
+	//! luminance for the eye adaptation. The halo can then be drawn with drawPointSource() with the
+	//! twinkling disabled, which allows to draw the halos of many small bodies in a single batch.
+	//! The special halo of the sun (magnitude brighter than -15) is not included.
+	//! @param pixPerRad the scale at the center of the projector the halo will be drawn with.
+	//! @param illuminatedArea the illuminated area in arcmin^2
+	//! @param mag the source integrated magnitude
+	//! @param rcMag receives the radius and luminance of the halo.
+	//! @return false if there is no halo to draw.
+	bool computeSky3dModelHalo(float pixPerRad, float illuminatedArea, float mag, RCMag* rcMag);
+
 	//! Compute RMag and CMag from magnitude.
 	//! @param mag the object integrated V magnitude
 	//! @param rcMag array of 2 floats containing the radius and luminance
 	//! @return false if the object is too faint to be displayed
 	bool computeRCMag(float mag, RCMag*) const;
 
+	//! Compute RMag and CMag for a table of regularly spaced magnitudes, as used for the magnitude
+	//! steps of the star catalogs. This is equivalent to calling computeRCMag() for each entry but
+	//! much faster, as the radius follows a geometric series along the table.
+	//! @param magMin the magnitude of the first entry
+	//! @param magStep the magnitude increment between two entries
+	//! @param n the number of entries of the table
+	//! @param table the table to fill, the entries too faint to be displayed are set to 0
+	//! @return the number of entries which can be displayed, the following ones are all too faint
+	int computeRCMagTable(float magMin, float magStep, int n, RCMag* table) const;
+
+	//! Get a table of RCMag computed by computeRCMagTable(), with the radius multiplied by radiusFactor.
+	//! The tables are kept from one frame to the next and only recomputed when the parameters
+	//! of the point sources conversion changed, see getRCMagVersion().
+	//! @param magMin the magnitude of the first entry
+	//! @param magStep the magnitude increment between two entries
+	//! @param n the number of entries of the table
+	//! @param radiusFactor the factor applied to the radius of all the entries, e.g. a fader state
+	//! @param nbVisible set to the number of entries which can be displayed
+	//! @return the table, valid until the next call to this method with the same magnitudes
+	const RCMag* getRCMagTable(float magMin, float magStep, int n, float radiusFactor, int* nbVisible);
+
+	//! Get a counter which is incremented each time the output of computeRCMag() changes,
+	//! i.e. when the adaptation of the StelToneReproducer, the FOV, the Bortle scale or the
+	//! star scales changed.
+	unsigned int getRCMagVersion();
+
 	//! Report that an object of luminance lum with an on-screen area of area pixels is currently displayed
 	//! This information is used to determine the world adaptation luminance
 	//! This method should be called during the update operations of the main loop
@@ -117,6 +195,12 @@ public:
 		return (float)bV*(4.f/127.f)-0.5f;
 	}
 
+	//! Convert float B-V to quantized B-V index, the inverse of indexToBV()
+	static inline unsigned char bvToIndex(float bV)
+	{
+		return (unsigned char)qBound(0, (int)std::floor(0.5f+127.f*(bV+0.5f)/4.f), 127);
+	}
+
 	//! Convert quantized B-V index to RGB colors
 	static inline const Vec3f& indexToColor(unsigned char bV)
 	{
@@ -143,6 +227,9 @@ public slots:
 	void setFlagTwinkle(bool b) {flagStarTwinkle=b;}
 	//! Get flag for source twinkling.
 	bool getFlagTwinkle() const {return flagStarTwinkle;}
+	//! Get the random phase of the twinkling for the current frame, in [0;1].
+	//! The shaders drawing point sources combine it with a per-source seed.
+	float getTwinklePhase() const {return twinklePhase;}
 
 	//! Set the parameters so that the stars disappear at about the limit given by the bortle scale
 	//! The limit is valid only at a given zoom level (around 60 deg)
@@ -216,6 +303,12 @@ public slots:
 	//! Get the current valid refraction computation object.
 	const Refraction& getRefraction() const {return refraction;}
 
+	//! Set whether point sources are streamed to the GPU through vertex buffer objects
+	//! instead of being transfered from client-side arrays at each flush.
+	void setFlagUseVertexBuffers(bool b);
+	//! Get whether point sources are streamed to the GPU through vertex buffer objects.
+	bool getFlagUseVertexBuffers() const {return flagUseVertexBuffers;}
+
 	//! Get the radius of the big halo texture used when a 3d model is very bright.
 	float getBig3dModelHaloRadius() const {return big3dModelHaloRadius;}
 	//! Set the radius of the big halo texture used when a 3d model is very bright.
@@ -225,10 +318,34 @@ private:
 	// Debug
 	float reverseComputeRCMag(float rmag) const;
 
-	//! Compute the current limit magnitude by dichotomy
+	//! Compute the luminance factor of a point source from its radius, see computeRCMag()
+	bool radiusToRCMag(float radius, RCMag* rcMag) const;
+
+	//! A table of RCMag kept by getRCMagTable().
+	struct RCMagTable
+	{
+		float magMin;
+		float magStep;
+		float radiusFactor;
+		unsigned int version;
+		int nbVisible;
+		QVector<RCMag> table;
+	};
+	QVector<RCMagTable> rcMagTables;
+
+	//! Radius at magnitude 0 and ln of the radius change per magnitude for which rcMagVersion was computed.
+	//! These two values fully define the result of computeRCMag().
+	float rcMagRadius0;
+	float rcMagLnRadiusPerMag;
+	unsigned int rcMagVersion;
+
+	//! Random value in [0;1] changed each frame, from which the shaders compute the twinkling.
+	float twinklePhase;
+
+	//! Compute the current limit magnitude
 	float computeLimitMagnitude() const;
 
-	//! Compute the current limit luminance by dichotomy
+	//! Compute the current limit luminance
 	float computeLimitLuminance() const;
 
 	//! Get StelSkyDrawer maximum FOV.
@@ -331,13 +448,15 @@ private:
 	float inScale;
 
 	// Variables used for GL optimization when displaying point sources
-	//! Vertex format for a point source.
-	//! Texture pos is stored in another separately.
-	struct StarVertex {
-		Vec2f pos;
-		unsigned char color[4];
-	};
-	
+	//! Get the seed stored in the vertices of a point source for the twinkling computed in the shader.
+	unsigned char computeTwinkleSeed(const Vec3f& v) const;
+	//! Fill the 6 vertices of the quad of a point source.
+	static void fillPointSourceVertices(StarVertex* vx, const Vec3f& win, float radius, const Vec3f& color, float luminance, unsigned char twinkleSeed);
+	//! Get the color of the big halo drawn around a point source, return false if there is none.
+	static bool computeBigHalo(const RCMag& rcMag, const Vec3f& color, Vec3f& haloColor);
+	//! Draw the big halo of a point source.
+	void drawBigHalo(StelPainter* sPainter, const Vec3f& win, const Vec3f& haloColor);
+
 	//! Buffer for storing the vertex array data
 	StarVertex* vertexArray;
 
@@ -351,6 +470,8 @@ private:
 		int pos;
 		int color;
 		int texture;
+		int twinkleAmount;
+		int twinklePhase;
 	};
 	StarShaderVars starShaderVars;
 	
@@ -359,6 +480,25 @@ private:
 	//! Maximum number of sources which can be stored in the buffers
 	unsigned int maxPointSources;
 
+	//! Create the vertex buffer objects used by the streaming path.
+	void initVertexBuffers();
+	//! Upload the buffered point sources into the streaming vertex buffer and
+	//! set the shader attributes to point inside it.
+	void setVertexBufferAttributes();
+
+	//! Whether point sources are drawn from VBOs instead of client-side arrays.
+	bool flagUseVertexBuffers;
+	//! Streaming vertex buffer, used as a ring of maxPointSources sized batches.
+	//! It is orphaned each time it wraps so that the driver never has to wait
+	//! for a pending draw call to complete before we can write into it again.
+	QOpenGLBuffer starVertexBuffer;
+	//! Static buffer containing the (constant) texture coordinates of maxPointSources quads.
+	QOpenGLBuffer starTexCoordBuffer;
+	//! Byte offset of the next free batch in starVertexBuffer.
+	int starVertexBufferOffset;
+	//! Number of batches which can be stored in starVertexBuffer before it needs to be orphaned.
+	static const int starVertexBufferBatches = 8;
+
 	//! The maximum transformed luminance to apply at the next update
 	float maxLum;
 	//! The previously used world luminance
@@ -27,11 +27,15 @@
 #include "StelCore.hpp"
 #include "StelSkyDrawer.hpp"
 #include "StelPainter.hpp"
+#include "StelMovementMgr.hpp"
+#include "StelRenderStats.hpp"
 
 #include <QDebug>
 
 #include <stdio.h>
 
+float StelSkyImageTile::prefetchTime = 0.3f;
+
 StelSkyImageTile::StelSkyImageTile()
 {
 	initCtor();
@@ -44,6 +48,10 @@ void StelSkyImageTile::initCtor()
 	alphaBlend = false;
 	noTexture = false;
 	texFader = NULL;
+	brightness = 1.f;
+	flagTransparency = false;
+	flagExtinction = true;
+	StelApp::getInstance().getRenderStats()->add(StelRenderStats::SkyImageTiles);
 }
 
 // Constructor
@@ -73,15 +81,18 @@ StelSkyImageTile::StelSkyImageTile(const QVariantMap& map, StelSkyImageTile* par
 // Destructor
 StelSkyImageTile::~StelSkyImageTile()
 {
+	StelApp::getInstance().getRenderStats()->add(StelRenderStats::SkyImageTiles, -1);
 }
 
-void StelSkyImageTile::draw(StelCore* core, StelPainter& sPainter, float)
+void StelSkyImageTile::draw(StelCore* core, StelPainter& sPainter, float opacity)
 {
-	const StelProjectorP prj = core->getProjection(StelCore::FrameJ2000);
+	// The tiles are defined in the frame of the projector set by the caller
+	const StelProjectorP prj = sPainter.getProjector();
+	const double degPerPixel = 1./prj->getPixelPerRadAtCenter()*180./M_PI;
 
 	const float limitLuminance = core->getSkyDrawer()->getLimitLuminance();
 	QMultiMap<double, StelSkyImageTile*> result;
-	getTilesToDraw(result, core, prj->getViewportConvexPolygon(0, 0), limitLuminance, true);
+	getTilesToDraw(result, core, prj->getViewportConvexPolygon(0, 0), degPerPixel, limitLuminance, true);
 
 	int numToBeLoaded=0;
 	foreach (StelSkyImageTile* t, result)
@@ -96,14 +107,62 @@ void StelSkyImageTile::draw(StelCore* core, StelPainter& sPainter, float)
 	while (i!=result.begin())
 	{
 		--i;
-		i.value()->drawTile(core, sPainter);
+		i.value()->drawTile(core, sPainter, this, opacity);
 	}
 
+	// The view motion is predicted in the J2000 frame
+	if (getFrameType()==StelCore::FrameJ2000)
+		updatePrefetch(core, result, limitLuminance);
 	deleteUnusedSubTiles();
 }
 
+void StelSkyImageTile::updatePrefetch(StelCore* core, const QMultiMap<double, StelSkyImageTile*>& drawnTiles, float limitLuminance)
+{
+	QList<QPointer<StelSkyImageTile> > prefetched;
+	if (prefetchTime>0.f && !errorOccured)
+	{
+		const StelProjectorP prj = core->getProjection(StelCore::FrameJ2000);
+		const StelMovementMgr* mvMgr = core->getMovementMgr();
+		Vec3d direction;
+		double fov;
+		mvMgr->predictView(prefetchTime, direction, fov);
+		Vec3d currentDirection = mvMgr->getViewDirectionJ2000();
+		currentDirection.normalize();
+		const double scale = fov/mvMgr->getCurrentFov();
+		// Nothing to prefetch when the view is not moving, the visible tiles are already loading
+		if (std::fabs(scale-1.)>0.01 || direction*currentDirection<std::cos(0.001*fov*M_PI/180.))
+		{
+			// Predict the viewport by moving and scaling the cap bounding the current one.
+			const double radius = qMin(M_PI, std::acos(qBound(-1., prj->getBoundingCap().d, 1.))*scale);
+			const SphericalCap region(direction, std::cos(radius));
+			const double degPerPixel = 1./prj->getPixelPerRadAtCenter()*180./M_PI*scale;
+			int nbNewRequests = 8;
+			prefetchTiles(region, degPerPixel, limitLuminance, prefetched, nbNewRequests);
+		}
+	}
+
+	// The motion changed: stop loading the textures of the tiles which are not expected anymore.
+	foreach (const QPointer<StelSkyImageTile>& t, prefetchedTiles)
+	{
+		if (t.isNull() || !t->tex || t->tex->canBind() || prefetched.contains(t))
+			continue;
+		bool drawn = false;
+		foreach (const StelSkyImageTile* d, drawnTiles)
+		{
+			if (d==t.data())
+			{
+				drawn = true;
+				break;
+			}
+		}
+		if (!drawn)
+			t->tex.clear();
+	}
+	prefetchedTiles = prefetched;
+}
+
 // Return the list of tiles which should be drawn.
-void StelSkyImageTile::getTilesToDraw(QMultiMap<double, StelSkyImageTile*>& result, StelCore* core, const SphericalRegionP& viewPortPoly, float limitLuminance, bool recheckIntersect)
+void StelSkyImageTile::getTilesToDraw(QMultiMap<double, StelSkyImageTile*>& result, StelCore* core, const SphericalRegionP& viewPortPoly, double degPerPixel, float limitLuminance, bool recheckIntersect)
 {
 
 #ifndef NDEBUG
@@ -115,7 +174,6 @@ void StelSkyImageTile::getTilesToDraw(QMultiMap<double, StelSkyImageTile*>& resu
 	if (parent!=NULL)
 	{
 		Q_ASSERT(isDeletionScheduled()==false);
-		const double degPerPixel = 1./core->getProjection(StelCore::FrameJ2000)->getPixelPerRadAtCenter()*180./M_PI;
 		Q_ASSERT(degPerPixel<parent->minResolution);
 
 		Q_ASSERT(parent->isDeletionScheduled()==false);
@@ -153,9 +211,18 @@ void StelSkyImageTile::getTilesToDraw(QMultiMap<double, StelSkyImageTile*>& resu
 		}
 		else
 		{
-			foreach (const SphericalRegionP& poly, skyConvexPolygons)
+			// The bounding caps of all the polygons are tested first in one call, so that the exact
+			// tests are only done on the polygons which can be visible
+			QVarLengthArray<bool, 16> capIntersect(skyConvexPolygons.size());
+			skyConvexPolygonCaps.intersects(viewPortPoly->getBoundingCap(), 0, capIntersect.size(), capIntersect.data());
+			for (int i=0;i<skyConvexPolygons.size();++i)
 			{
-				if (viewPortPoly->contains(poly))
+				const SphericalRegionP& poly = skyConvexPolygons.at(i);
+				if (!capIntersect[i])
+				{
+					fullInScreen = false;
+				}
+				else if (viewPortPoly->contains(poly))
 				{
 					intersectScreen = true;
 				}
@@ -182,47 +249,23 @@ void StelSkyImageTile::getTilesToDraw(QMultiMap<double, StelSkyImageTile*>& resu
 
 	if (noTexture==false)
 	{
-		if (!tex)
-		{
-			// The tile has an associated texture, but it is not yet loaded: load it now
-			StelTextureMgr& texMgr=StelApp::getInstance().getTextureManager();
-			tex = texMgr.createTextureThread(absoluteImageURI, StelTexture::StelTextureParams(true));
-			if (!tex)
-			{
-				qWarning() << "WARNING : Can't create tile: " << absoluteImageURI;
-				errorOccured = true;
-				return;
-			}
-		}
+		// The tile has an associated texture, but it is not yet loaded: load it now
+		if (!tex && !createTexture())
+			return;
 
 		// The tile is in screen and has a texture: every test passed :) The tile will be displayed
 		result.insert(minResolution, this);
 	}
 
 	// Check if we reach the resolution limit
-	const double degPerPixel = 1./core->getProjection(StelCore::FrameJ2000)->getPixelPerRadAtCenter()*180./M_PI;
 	if (degPerPixel < minResolution)
 	{
-		if (subTiles.isEmpty() && !subTilesUrls.isEmpty())
-		{
-			// Load the sub tiles because we reached the maximum resolution and they are not yet loaded
-			foreach (QVariant s, subTilesUrls)
-			{
-				StelSkyImageTile* nt;
-				if (s.type()==QVariant::Map)
-					nt = new StelSkyImageTile(s.toMap(), this);
-				else
-				{
-					Q_ASSERT(s.type()==QVariant::String);
-					nt = new StelSkyImageTile(s.toString(), this);
-				}
-				subTiles.append(nt);
-			}
-		}
+		// Load the sub tiles because we reached the maximum resolution and they are not yet loaded
+		createSubTiles();
 		// Try to add the subtiles
 		foreach (MultiLevelJsonBase* tile, subTiles)
 		{
-			qobject_cast<StelSkyImageTile*>(tile)->getTilesToDraw(result, core, viewPortPoly, limitLuminance, !fullInScreen);
+			qobject_cast<StelSkyImageTile*>(tile)->getTilesToDraw(result, core, viewPortPoly, degPerPixel, limitLuminance, !fullInScreen);
 		}
 	}
 	else
@@ -232,10 +275,97 @@ void StelSkyImageTile::getTilesToDraw(QMultiMap<double, StelSkyImageTile*>& resu
 	}
 }
 
+bool StelSkyImageTile::createTexture()
+{
+	StelTextureMgr& texMgr=StelApp::getInstance().getTextureManager();
+	StelTexture::StelTextureParams params(true);
+	params.evictable = true;
+	tex = texMgr.createTextureThread(absoluteImageURI, params);
+	if (!tex)
+	{
+		qWarning() << "WARNING : Can't create tile: " << absoluteImageURI;
+		errorOccured = true;
+		return false;
+	}
+	return true;
+}
+
+void StelSkyImageTile::createSubTiles()
+{
+	if (!subTiles.isEmpty() || subTilesUrls.isEmpty())
+		return;
+	foreach (QVariant s, subTilesUrls)
+	{
+		StelSkyImageTile* nt;
+		if (s.type()==QVariant::Map)
+			nt = new StelSkyImageTile(s.toMap(), this);
+		else
+		{
+			Q_ASSERT(s.type()==QVariant::String);
+			nt = new StelSkyImageTile(s.toString(), this);
+		}
+		subTiles.append(nt);
+	}
+}
+
+void StelSkyImageTile::prefetchTiles(const SphericalCap& region, double degPerPixel, float limitLuminance, QList<QPointer<StelSkyImageTile> >& prefetched, int& nbNewRequests)
+{
+	// Same selection as in getTilesToDraw(), the JSON descriptions of the subtiles start
+	// downloading when they are created.
+	if (errorOccured || downloading || nbNewRequests<=0)
+		return;
+	if (luminance>0 && luminance<limitLuminance)
+		return;
+	if (!skyConvexPolygons.isEmpty())
+	{
+		bool intersect = false;
+		foreach (const SphericalRegionP& poly, skyConvexPolygons)
+		{
+			if (poly->intersects(region))
+			{
+				intersect = true;
+				break;
+			}
+		}
+		if (!intersect)
+			return;
+	}
+
+	if (noTexture==false)
+	{
+		if (!tex)
+		{
+			if (!createTexture())
+				return;
+			--nbNewRequests;
+		}
+		// Start or continue the download and decoding
+		if (!tex->canBind())
+		{
+			tex->bind();
+			prefetched.append(this);
+		}
+	}
+
+	if (degPerPixel < minResolution)
+	{
+		createSubTiles();
+		foreach (MultiLevelJsonBase* tile, subTiles)
+			qobject_cast<StelSkyImageTile*>(tile)->prefetchTiles(region, degPerPixel, limitLuminance, prefetched, nbNewRequests);
+	}
+}
+
 // Draw the image on the screen.
 // Assume GL_TEXTURE_2D is enabled
-bool StelSkyImageTile::drawTile(StelCore* core, StelPainter& sPainter)
+bool StelSkyImageTile::drawTile(StelCore* core, StelPainter& sPainter, const StelSkyImageTile* root, float opacity)
 {
+	// When the texture uploads are limited, the tiles covering the largest part of the screen go first,
+	// and when the texture memory is full, the smallest ones are released first.
+	const double pixelPerRad = sPainter.getProjector()->getPixelPerRadAtCenter();
+	double area = skyConvexPolygons.isEmpty() ? 4.*M_PI : 0.;
+	foreach (const SphericalRegionP& poly, skyConvexPolygons)
+		area += poly->getBoundingCap().getArea();
+	tex->setUploadPriority(area*pixelPerRad*pixelPerRad);
 	if (!tex->bind())
 		return false;
 
@@ -247,16 +377,16 @@ bool StelSkyImageTile::drawTile(StelCore* core, StelPainter& sPainter)
 
 	// Draw the real texture for this image
 	float ad_lum = (luminance>0) ? core->getToneReproducer()->adaptLuminanceScaled(luminance) : 1.f;
-	ad_lum=std::min(1.f, ad_lum);
+	ad_lum=std::min(1.f, ad_lum)*root->brightness;
 	Vec4f color;
-	if (alphaBlend==true || texFader->state()==QTimeLine::Running)
+	if (alphaBlend==true || root->flagTransparency || opacity<1.f || texFader->state()==QTimeLine::Running)
 	{
-		if (!alphaBlend)
+		if (!alphaBlend || root->flagTransparency)
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Normal transparency mode
 		else
 			glBlendFunc(GL_ONE, GL_ONE);
 		glEnable(GL_BLEND);
-		color.set(ad_lum,ad_lum,ad_lum, texFader->currentValue());
+		color.set(ad_lum,ad_lum,ad_lum, texFader->currentValue()*opacity);
 	}
 	else
 	{
@@ -264,16 +394,23 @@ bool StelSkyImageTile::drawTile(StelCore* core, StelPainter& sPainter)
 		color.set(ad_lum,ad_lum,ad_lum, 1.f);
 	}
 
-	const bool withExtinction=(core->getSkyDrawer()->getFlagHasAtmosphere() && core->getSkyDrawer()->getExtinction().getExtinctionCoefficient()>=0.01f);
+	const bool withExtinction=(root->flagExtinction && core->getSkyDrawer()->getFlagHasAtmosphere() && core->getSkyDrawer()->getExtinction().getExtinctionCoefficient()>=0.01f);
+	const bool altAzFrame = root->getFrameType()==StelCore::FrameAltAz;
 	
 	sPainter.enableTexture2d(true);
-	foreach (const SphericalRegionP& poly, skyConvexPolygons)
+	if (drawCaches.size()!=skyConvexPolygons.size())
+	{
+		drawCaches.clear();
+		drawCaches.resize(skyConvexPolygons.size());
+	}
+	for (int i=0;i<skyConvexPolygons.size();++i)
 	{
+		const SphericalRegionP& poly = skyConvexPolygons.at(i);
 		Vec4f extinctedColor = color;
 		if (withExtinction)
 		{
 			Vec3d bary= poly->getPointInside(); // This is a J000.0 vector that points "somewhere" in the first triangle.
-			Vec3d altAz = core->j2000ToAltAz(bary, StelCore::RefractionOff);
+			Vec3d altAz = altAzFrame ? bary : core->j2000ToAltAz(bary, StelCore::RefractionOff);
 			float extinctionMagnitude=0.0f;
 			altAz.normalize();
 			core->getSkyDrawer()->getExtinction().forward(altAz, &extinctionMagnitude);
@@ -284,7 +421,7 @@ bool StelSkyImageTile::drawTile(StelCore* core, StelPainter& sPainter)
 			extinctedColor[2]*=fabs(extinctionFactor);
 		}
 		sPainter.setColor(extinctedColor[0], extinctedColor[1], extinctedColor[2], extinctedColor[3]);
-		sPainter.drawSphericalRegion(poly.data(), StelPainter::SphericalPolygonDrawModeTextureFill);
+		sPainter.drawSphericalRegion(poly.data(), &drawCaches[i], StelPainter::SphericalPolygonDrawModeTextureFill);
 		
 	}
 
@@ -425,12 +562,14 @@ void StelSkyImageTile::loadFromQVariantMap(const QVariantMap& map)
 			SphericalTexturedConvexPolygon* pol = new SphericalTexturedConvexPolygon(vertices, texCoords);
 			Q_ASSERT(pol->checkValid());
 			skyConvexPolygons.append(SphericalRegionP(pol));
+			skyConvexPolygonCaps.append(pol->getBoundingCap());
 		}
 		else
 		{
 			SphericalConvexPolygon* pol = new SphericalConvexPolygon(vertices);
 			Q_ASSERT(pol->checkValid());
 			skyConvexPolygons.append(SphericalRegionP(pol));
+			skyConvexPolygonCaps.append(pol->getBoundingCap());
 		}
 	}
 
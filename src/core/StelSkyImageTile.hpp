@@ -22,15 +22,16 @@
 
 #include "MultiLevelJsonBase.hpp"
 #include "StelSphereGeometry.hpp"
+#include "StelPainter.hpp"
 #include "StelTextureTypes.hpp"
 
 #include <QTimeLine>
+#include <QPointer>
 
 //#define DEBUG_STELSKYIMAGE_TILE 1
 
 class QIODevice;
 class StelCore;
-class StelPainter;
 
 //! Contain all the credits for a given server hosting the data
 class ServerCredits
@@ -80,8 +81,19 @@ public:
 	~StelSkyImageTile();
 
 	//! Draw the image on the screen.
+	//! The visible tiles are selected for the current projector of the painter.
+	//! @param opacity the opacity by which the alpha of all the tiles is multiplied.
 	void draw(StelCore* core, StelPainter& sPainter, float opacity=1.);
 
+	//! Set the brightness by which the color of all the tiles is multiplied.
+	//! It is used in addition to the luminance adaptation of the tiles defining a maximum brightness.
+	void setBrightness(float b) {brightness = b;}
+	//! Set whether the alpha channel of the textures is used for normal transparency,
+	//! instead of drawing them opaque or additively when the alphaBlend key is set.
+	void setFlagTransparency(bool b) {flagTransparency = b;}
+	//! Set whether the atmospheric extinction is applied to the tiles (the default).
+	void setFlagExtinction(bool b) {flagExtinction = b;}
+
 	//! Return the dataset credits to use in the progress bar
 	DataSetCredits getDataSetCredits() const {return dataSetCredits;}
 
@@ -101,6 +113,11 @@ public:
 	//! Return an HTML description of the image to be displayed in the GUI.
 	virtual QString getLayerDescriptionHtml() const {return htmlDescription;}
 
+	//! Set the time in seconds by which the tiles which will become visible are loaded in advance,
+	//! following the motion of the view. 0 disables the prefetching.
+	static void setPrefetchTime(float t) {prefetchTime = t;}
+	static float getPrefetchTime() {return prefetchTime;}
+
 protected:
 	//! Reimplement the abstract method.
 	//! Load the tile from a valid QVariantMap.
@@ -126,6 +143,11 @@ protected:
 
 	//! list of all the polygons.
 	QList<SphericalRegionP> skyConvexPolygons;
+	//! The bounding caps of the polygons, with the same indices.
+	SphericalCapArray skyConvexPolygonCaps;
+
+	//! The triangles of each polygon subdivided for drawing.
+	QVector<SphericalRegionDrawCache> drawCaches;
 
 	//! The texture of the tile
 	StelTextureSP tex;
@@ -145,12 +167,41 @@ private:
 	//! @return true if the tile was actually displayed
 	bool drawTile(StelCore* core, StelPainter& sPainter);
 
+	//! Create the texture of the tile, whose loading starts when it is bound.
+	//! @return false if the texture could not be created, in which case the tile is in error.
+	bool createTexture();
+
+	//! Create the subtiles if they were not created yet. The JSON descriptions start loading.
+	void createSubTiles();
+
+	//! Start loading the JSON descriptions and textures of the tiles intersecting a region of the sky
+	//! which will become visible soon, without drawing them.
+	//! @param region the predicted viewport.
+	//! @param degPerPixel the predicted resolution.
+	//! @param prefetched the tiles whose texture was requested for the prefetch.
+	//! @param nbNewRequests the number of new textures which can still be requested in this frame.
+	void prefetchTiles(const SphericalCap& region, double degPerPixel, float limitLuminance, QList<QPointer<StelSkyImageTile> >& prefetched, int& nbNewRequests);
+
+	//! Run the prefetching for the root tile, and cancel the loading of the tiles prefetched
+	//! in the previous frame which are not predicted to be visible anymore.
+	void updatePrefetch(StelCore* core, const QMultiMap<double, StelSkyImageTile*>& drawnTiles, float limitLuminance);
+
 	//! Return the minimum resolution
 	double getMinResolution() const {return minResolution;}
 
 	//! The list of all the subTiles URL or already loaded JSON map for this tile
 	QVariantList subTilesUrls;
 
+	//! The tiles prefetched during the last frame, only used in the root tile.
+	QList<QPointer<StelSkyImageTile> > prefetchedTiles;
+
+	static float prefetchTime;
+
+	//! Drawing parameters, only used in the root tile.
+	float brightness;
+	bool flagTransparency;
+	bool flagExtinction;
+
 	// Used for smooth fade in
 	QTimeLine* texFader;
 
@@ -58,7 +58,7 @@ public:
 	void setFrameType(StelCore::FrameType ft) {frameType = ft;}
 
 	//! Get the reference frame type.
-	StelCore::FrameType getFrameType() {return frameType;}
+	StelCore::FrameType getFrameType() const {return frameType;}
 
 signals:
 	//! Emitted when loading of data started or stopped.
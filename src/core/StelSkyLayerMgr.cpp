@@ -23,6 +23,7 @@
 #include "StelFileMgr.hpp"
 #include "StelProjector.hpp"
 #include "StelSkyImageTile.hpp"
+#include "StelHipsSkyLayer.hpp"
 #include "StelModuleMgr.hpp"
 #include "StelPainter.hpp"
 #include "MilkyWay.hpp"
@@ -70,6 +71,8 @@ void StelSkyLayerMgr::init()
 	else
 		insertSkyImage(path);
 	QSettings* conf = StelApp::getInstance().getSettings();
+	StelSkyImageTile::setPrefetchTime(conf->value("video/tile_prefetch_time", 0.3).toFloat());
+	StelHipsSkyLayer::setMaxParallelRequests(conf->value("video/hips_max_parallel_requests", 4).toInt());
 	conf->beginGroup("skylayers");
 	foreach (const QString& key, conf->childKeys())
 	{
@@ -83,6 +86,14 @@ void StelSkyLayerMgr::init()
 		}
 	}
 	conf->endGroup();
+	conf->beginGroup("hips_surveys");
+	foreach (const QString& key, conf->childKeys())
+	{
+		QString url = conf->value(key, "").toString();
+		if (!url.isEmpty())
+			insertHipsSurvey(url, key);
+	}
+	conf->endGroup();
 
 	addAction("actionShow_DSS", N_("Display Options"), N_("Deep-sky objects background images"), "visible", "I");
 }
@@ -125,6 +136,12 @@ QString StelSkyLayerMgr::insertSkyImage(const QString& uri, const QString& keyHi
 	return insertSkyLayer(StelSkyLayerP(new StelSkyImageTile(uri)), keyHint, ashow);
 }
 
+// Add a new HiPS survey from its base URL
+QString StelSkyLayerMgr::insertHipsSurvey(const QString& url, const QString& keyHint, bool ashow)
+{
+	return insertSkyLayer(StelSkyLayerP(new StelHipsSkyLayer(url)), keyHint, ashow);
+}
+
 // Remove a sky image tile from the list of background images
 void StelSkyLayerMgr::removeSkyLayer(const QString& key)
 {
@@ -152,6 +152,14 @@ public slots:
 	//! @return the reference key to use when accessing this image later on.
 	QString insertSkyImage(const QString& uri, const QString& keyHint=QString(), bool show=true);
 
+	//! Add a new HiPS survey from its base URL, the directory containing its properties file.
+	//! The surveys listed in the [hips_surveys] section of the configuration file are added at startup.
+	//! @param url the URL or the local directory of the survey.
+	//! @param keyHint a hint on which key to use for later referencing the survey.
+	//! @param show defined whether the survey should be shown by default.
+	//! @return the reference key to use when accessing this survey later on.
+	QString insertHipsSurvey(const QString& url, const QString& keyHint=QString(), bool show=true);
+
 	//! Remove a sky layer from the list.
 	//! Note: this is not thread safe, and so should not be used directly
 	//! from scripts - use the similarly named function in the core
@@ -338,6 +338,20 @@ bool SphericalCap::intersectsTriangle(const Vec3d* v) const
 	return true;
 }
 
+void SphericalCap::containsPoints(const Vec3d* points, int nbPoints, bool* result) const
+{
+	const double n0=n[0], n1=n[1], n2=n[2], dd=d;
+	for (int i=0;i<nbPoints;++i)
+		result[i] = points[i][0]*n0+points[i][1]*n1+points[i][2]*n2>=dd;
+}
+
+void SphericalCap::containsPoints(const Vec3f* points, int nbPoints, bool* result) const
+{
+	const double n0=n[0], n1=n[1], n2=n[2], dd=d;
+	for (int i=0;i<nbPoints;++i)
+		result[i] = points[i][0]*n0+points[i][1]*n1+points[i][2]*n2>=dd;
+}
+
 bool SphericalCap::intersectsConvexContour(const Vec3d* vertice, int nbVertice) const
 {
 	for (int i=0;i<nbVertice;++i)
@@ -1382,3 +1396,20 @@ void SphericalRegionP::serializeToJson(const QVariant& jsonObject, QIODevice* ou
 	const SphericalRegionP& reg = jsonObject.value<SphericalRegionP>();
 	StelJsonParser::write(reg->toQVariant(), output, indentLevel);
 }
+
+void SphericalCapArray::intersects(const SphericalCap& h, int first, int nbCaps, bool* result) const
+{
+	Q_ASSERT(first>=0 && first+nbCaps<=size());
+	const double* x = nx.constData()+first;
+	const double* y = ny.constData()+first;
+	const double* z = nz.constData()+first;
+	const double* dd = d.constData()+first;
+	const double hn0=h.n[0], hn1=h.n[1], hn2=h.n[2], hd=h.d;
+	const double hd2 = 1.-hd*hd;
+	for (int i=0;i<nbCaps;++i)
+	{
+		// Same test as SphericalCap::intersects(), written without branches
+		const double a = dd[i]*hd - (x[i]*hn0+y[i]*hn1+z[i]*hn2);
+		result[i] = (dd[i]+hd<=0.) | (a<=0.) | ((a<=1.) & (a*a <= (1.-dd[i]*dd[i])*hd2));
+	}
+}
@@ -377,6 +377,11 @@ public:
 	//! Return whether the cap intersect with the passed triangle.
 	bool intersectsTriangle(const Vec3d* vertice) const;
 
+	//! Test an array of points at once: result[i] is set to whether the cap contains points[i].
+	//! Unlike contains(), no virtual call is made per point so the loop can be vectorized.
+	void containsPoints(const Vec3d* points, int nbPoints, bool* result) const;
+	void containsPoints(const Vec3f* points, int nbPoints, bool* result) const;
+
 	//! Deserialize the region. This method must allow as fast as possible deserialization.
 	static SphericalRegionP deserialize(QDataStream& in);
 
@@ -425,6 +430,27 @@ inline bool sideHalfSpaceIntersects(const Vec3d& v1, const Vec3d& v2, const Sphe
 	return  h.intersectsHalfSpace(n[0], n[1], n[2]);
 }
 
+//! @class SphericalCapArray
+//! An array of SphericalCap stored as one array per coordinate, so that many caps can be tested
+//! against one cap in a single tight loop. It is used where the bounding caps of many objects
+//! are tested against the same view, e.g. in the spherical index.
+class SphericalCapArray
+{
+public:
+	void append(const SphericalCap& cap) {nx.append(cap.n[0]); ny.append(cap.n[1]); nz.append(cap.n[2]); d.append(cap.d);}
+	void clear() {nx.clear(); ny.clear(); nz.clear(); d.clear();}
+	void squeeze() {nx.squeeze(); ny.squeeze(); nz.squeeze(); d.squeeze();}
+	int size() const {return d.size();}
+	SphericalCap at(int i) const {return SphericalCap(Vec3d(nx.at(i), ny.at(i), nz.at(i)), d.at(i));}
+
+	//! Test the caps first to first+nbCaps-1 against the cap h, with the same test as SphericalCap::intersects().
+	//! result[i] is set to whether the cap first+i intersects h.
+	void intersects(const SphericalCap& h, int first, int nbCaps, bool* result) const;
+
+private:
+	QVector<double> nx, ny, nz, d;
+};
+
 //! @class SphericalPoint
 //! Special SphericalRegion for a point on the sphere.
 class SphericalPoint : public SphericalRegion
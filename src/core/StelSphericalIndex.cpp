@@ -32,8 +32,134 @@ StelSphericalIndex::~StelSphericalIndex()
 
 void StelSphericalIndex::insert(StelRegionObjectP regObj)
 {
+	clearFlat();
 	NodeElem el(regObj);
 	rootNode->insert(el, 0);
 }
 
+void StelSphericalIndex::freeze()
+{
+	clearFlat();
+	buildFlat(*rootNode);
+	flatNodes.squeeze();
+	flatElems.squeeze();
+	flatCaps.squeeze();
+	flatObjects.squeeze();
+}
+
+void StelSphericalIndex::buildFlat(const Node& node)
+{
+	const int index = flatNodes.size();
+	FlatNode flatNode;
+	flatNode.triangle = node.triangle;
+	flatNode.firstElem = flatElems.size();
+	foreach (const NodeElem& el, node.elements)
+	{
+		FlatElem flatElem;
+		flatElem.pointInRegion = el.obj->getPointInRegion();
+		flatElem.obj = el.obj.data();
+		flatElems.append(flatElem);
+		flatCaps.append(el.cap);
+		flatObjects.append(el.obj);
+	}
+	flatNode.endElem = flatElems.size();
+	flatNodes.append(flatNode);
+	foreach (const Node& child, node.children)
+		buildFlat(child);
+	flatNodes[index].endNode = flatNodes.size();
+	flatNodes[index].endSubtreeElem = flatElems.size();
+}
+
+void StelSphericalIndex::collectParallelTasks(int node, const SphericalRegion* region, int depth, QVector<ParallelTask>& tasks) const
+{
+	const FlatNode& n = flatNodes.at(node);
+	if (n.endElem>n.firstElem)
+	{
+		ParallelTask task = {node, TaskNodeElements};
+		tasks.append(task);
+	}
+	for (int c=node+1;c<n.endNode;c=flatNodes.at(c).endNode)
+	{
+		const FlatNode& child = flatNodes.at(c);
+		if (region->contains(child.triangle))
+		{
+			ParallelTask task = {c, TaskAll};
+			tasks.append(task);
+		}
+		else if (region->intersects(child.triangle))
+		{
+			if (depth+1<ParallelSplitDepth && child.endNode>c+1)
+				collectParallelTasks(c, region, depth+1, tasks);
+			else
+			{
+				ParallelTask task = {c, TaskSubtree};
+				tasks.append(task);
+			}
+		}
+	}
+}
+
+void StelSphericalIndex::clearFlat()
+{
+	flatNodes.clear();
+	flatElems.clear();
+	flatCaps.clear();
+	flatObjects.clear();
+}
+
 
+
+QList<StelRegionObjectP> StelSphericalIndex::getPointsInRegion(const SphericalRegion* region) const
+{
+	QList<StelRegionObjectP> result;
+	if (isFrozen())
+		getPointsInRegion(0, region, result);
+	else
+		getPointsInRegion(*rootNode, region, result);
+	return result;
+}
+
+void StelSphericalIndex::getPointsInRegion(int node, const SphericalRegion* region, QList<StelRegionObjectP>& result) const
+{
+	const FlatNode& n = flatNodes.at(node);
+	for (int i=n.firstElem;i<n.endElem;++i)
+	{
+		if (region->contains(flatElems.at(i).pointInRegion))
+			result.append(flatObjects.at(i));
+	}
+	for (int c=node+1;c<n.endNode;c=flatNodes.at(c).endNode)
+	{
+		const FlatNode& child = flatNodes.at(c);
+		if (region->contains(child.triangle))
+		{
+			for (int i=child.firstElem;i<child.endSubtreeElem;++i)
+				result.append(flatObjects.at(i));
+		}
+		else if (region->intersects(child.triangle))
+			getPointsInRegion(c, region, result);
+	}
+}
+
+void StelSphericalIndex::getPointsInRegion(const Node& node, const SphericalRegion* region, QList<StelRegionObjectP>& result)
+{
+	foreach (const NodeElem& el, node.elements)
+	{
+		if (region->contains(el.obj->getPointInRegion()))
+			result.append(el.obj);
+	}
+	foreach (const Node& child, node.children)
+	{
+		if (region->contains(child.triangle))
+			getAll(child, result);
+		else if (region->intersects(child.triangle))
+			getPointsInRegion(child, region, result);
+	}
+}
+
+void StelSphericalIndex::getAll(const Node& node, QList<StelRegionObjectP>& result)
+{
+	foreach (const NodeElem& el, node.elements)
+		result.append(el.obj);
+	foreach (const Node& child, node.children)
+		getAll(child, result);
+}
@@ -22,6 +22,10 @@
 
 #include "StelRegionObject.hpp"
 
+#include <QList>
+#include <QVarLengthArray>
+#include <QtConcurrent>
+
 //! @class StelSphericalIndex
 //! Container allowing to store and query SphericalRegion.
 class StelSphericalIndex
@@ -31,42 +35,98 @@ public:
 	virtual ~StelSphericalIndex();
 
 	//! Insert the given object in the StelSphericalIndex.
+	//! This discards the flat layout built by freeze().
 	void insert(StelRegionObjectP obj);
 
+	//! Build a flat copy of the tree used by all the process methods, for containers which are not modified
+	//! anymore such as the catalogs. The nodes and the elements are stored in contiguous arrays in depth first
+	//! order, so that the elements of a subtree are contiguous, and the bounding cap and point in region of
+	//! each element are stored next to it so that the traversals do not need to follow the shared pointers.
+	void freeze();
+
+	//! Return whether the flat layout built by freeze() is used.
+	bool isFrozen() const {return !flatNodes.isEmpty();}
+
 	//! Process all the objects intersecting the given region using the passed function object.
 	template<class FuncObject> void processIntersectingRegions(const SphericalRegion* region, FuncObject& func) const
 	{
-		rootNode->processIntersectingRegions(region, func);
+		if (isFrozen())
+			processIntersectingRegions(0, region, func);
+		else
+			rootNode->processIntersectingRegions(region, func);
 	}
 
 	//! Process all the objects intersecting the given region using the passed function object.
 	template<class FuncObject> void processIntersectingPointInRegions(const SphericalRegion* region, FuncObject& func) const
 	{
-		rootNode->processIntersectingPointInRegions(region, func);
+		if (isFrozen())
+			processIntersectingPointInRegions(0, region, func);
+		else
+			rootNode->processIntersectingPointInRegions(region, func);
 	}
 	
 	//! Process all the objects intersecting the given region using the passed function object.
 	template<class FuncObject> void processBoundingCapIntersectingRegions(const SphericalCap& cap, FuncObject& func) const
 	{
-		rootNode->processBoundingCapIntersectingRegions(cap, func);
+		if (isFrozen())
+			processBoundingCapIntersectingRegions(0, cap, func);
+		else
+			rootNode->processBoundingCapIntersectingRegions(cap, func);
 	}
 	
 	//! Process all the objects contained in the given region using the passed function object.
 	template<class FuncObject> void processContainedRegions(const SphericalRegion* region, FuncObject& func) const
 	{
-		rootNode->processContainedRegions(region, func);
+		if (isFrozen())
+			processContainedRegions(0, region, func);
+		else
+			rootNode->processContainedRegions(region, func);
 	}
 
 	//! Process all the objects intersecting the given region using the passed function object.
 	template<class FuncObject> void processAll(FuncObject& func) const
 	{
-		rootNode->processAll(func);
+		if (isFrozen())
+			processAll(0, func);
+		else
+			rootNode->processAll(func);
+	}
+
+	//! Process in parallel all the objects intersecting the given region, using copies of the passed function object.
+	//! The traversal of the flat layout built by freeze() is split in tasks run by the global thread pool, each one
+	//! calling its own copy of func made before the traversal. func is then set to the copy of the first task, and
+	//! the copies of the other tasks are merged into it in order by calling <tt>func.merge(const FuncObject&)</tt>.
+	//! The objects are thus not processed in the same order as by processIntersectingRegions(). The function
+	//! object copies must be usable from different threads at the same time, and so must the region.
+	//! If the index is not frozen, the objects are processed sequentially by func.
+	template<class FuncObject> void processIntersectingRegionsParallel(const SphericalRegion* region, FuncObject& func) const
+	{
+		if (isFrozen())
+			processParallel(region, false, func);
+		else
+			rootNode->processIntersectingRegions(region, func);
 	}
 
+	//! Process in parallel all the objects whose bounding cap intersects the given cap, using copies of the passed
+	//! function object which are then merged as for processIntersectingRegionsParallel().
+	template<class FuncObject> void processBoundingCapIntersectingRegionsParallel(const SphericalCap& cap, FuncObject& func) const
+	{
+		if (isFrozen())
+			processParallel(&cap, true, func);
+		else
+			rootNode->processBoundingCapIntersectingRegions(cap, func);
+	}
+
+	//! Get all the objects whose point in region is inside the given region.
+	//! Unlike the process* methods the shared pointers of the objects are returned, so that
+	//! they can be used as the result of a StelObjectModule::searchAround() implementation.
+	QList<StelRegionObjectP> getPointsInRegion(const SphericalRegion* region) const;
+
 	//! Remove all the elements in the container.
 	void clear()
 	{
 		rootNode->clear();
+		clearFlat();
 	}
 
 	//! Return the total number of elements in the container.
@@ -334,6 +394,213 @@ private:
 	int maxObjectsPerNode;
 
 	RootNode* rootNode;
+
+	static void getPointsInRegion(const Node& node, const SphericalRegion* region, QList<StelRegionObjectP>& result);
+	static void getAll(const Node& node, QList<StelRegionObjectP>& result);
+
+	//! A node of the flat layout. Its children follow it, the first one at the next index,
+	//! and the next sibling of each child is at the endNode index of the child.
+	struct FlatNode
+	{
+		SphericalConvexPolygon triangle;
+		//! One after the last node of the subtree
+		int endNode;
+		//! The elements stored in this node
+		int firstElem, endElem;
+		//! One after the last element of the subtree
+		int endSubtreeElem;
+	};
+
+	//! An element of the flat layout.
+	struct FlatElem
+	{
+		Vec3d pointInRegion;
+		StelRegionObject* obj;
+	};
+
+	void buildFlat(const Node& node);
+	void clearFlat();
+	void getPointsInRegion(int node, const SphericalRegion* region, QList<StelRegionObjectP>& result) const;
+
+	template<class FuncObject> void processIntersectingRegions(int node, const SphericalRegion* region, FuncObject& func) const
+	{
+		const FlatNode& n = flatNodes.at(node);
+		for (int i=n.firstElem;i<n.endElem;++i)
+		{
+			if (region->intersects(flatElems.at(i).obj->getRegion().data()))
+				func(flatElems.at(i).obj);
+		}
+		for (int c=node+1;c<n.endNode;c=flatNodes.at(c).endNode)
+		{
+			const FlatNode& child = flatNodes.at(c);
+			if (region->contains(child.triangle))
+				processAll(c, func);
+			else if (region->intersects(child.triangle))
+				processIntersectingRegions(c, region, func);
+		}
+	}
+
+	template<class FuncObject> void processIntersectingPointInRegions(int node, const SphericalRegion* region, FuncObject& func) const
+	{
+		const FlatNode& n = flatNodes.at(node);
+		for (int i=n.firstElem;i<n.endElem;++i)
+		{
+			if (region->contains(flatElems.at(i).pointInRegion))
+				func(flatElems.at(i).obj);
+		}
+		for (int c=node+1;c<n.endNode;c=flatNodes.at(c).endNode)
+		{
+			const FlatNode& child = flatNodes.at(c);
+			if (region->contains(child.triangle))
+				processAll(c, func);
+			else if (region->intersects(child.triangle))
+				processIntersectingPointInRegions(c, region, func);
+		}
+	}
+
+	template<class FuncObject> void processBoundingCapIntersectingRegions(int node, const SphericalCap& cap, FuncObject& func) const
+	{
+		const FlatNode& n = flatNodes.at(node);
+		QVarLengthArray<bool, 64> intersect(n.endElem-n.firstElem);
+		flatCaps.intersects(cap, n.firstElem, intersect.size(), intersect.data());
+		for (int i=n.firstElem;i<n.endElem;++i)
+		{
+			if (intersect[i-n.firstElem])
+				func(flatElems.at(i).obj);
+		}
+		for (int c=node+1;c<n.endNode;c=flatNodes.at(c).endNode)
+		{
+			const FlatNode& child = flatNodes.at(c);
+			if (cap.contains(child.triangle))
+				processAll(c, func);
+			else if (cap.intersects(child.triangle))
+				processBoundingCapIntersectingRegions(c, cap, func);
+		}
+	}
+
+	template<class FuncObject> void processContainedRegions(int node, const SphericalRegion* region, FuncObject& func) const
+	{
+		const FlatNode& n = flatNodes.at(node);
+		for (int i=n.firstElem;i<n.endElem;++i)
+		{
+			if (region->contains(flatElems.at(i).obj->getRegion().data()))
+				func(flatElems.at(i).obj);
+		}
+		for (int c=node+1;c<n.endNode;c=flatNodes.at(c).endNode)
+		{
+			const FlatNode& child = flatNodes.at(c);
+			if (region->contains(child.triangle))
+				processAll(c, func);
+			else if (region->intersects(child.triangle))
+				processContainedRegions(c, region, func);
+		}
+	}
+
+	//! The elements of a subtree are contiguous, so they are processed in a single loop.
+	template<class FuncObject> void processAll(int node, FuncObject& func) const
+	{
+		const FlatNode& n = flatNodes.at(node);
+		for (int i=n.firstElem;i<n.endSubtreeElem;++i)
+			func(flatElems.at(i).obj);
+	}
+
+	//! The parallel traversals split the tree down to this depth.
+	static const int ParallelSplitDepth = 2;
+
+	enum ParallelTaskType
+	{
+		TaskNodeElements,	//!< Process the elements stored in the node only
+		TaskSubtree,		//!< Traverse the subtree, whose node intersects the region
+		TaskAll			//!< Process all the elements of the subtree, whose node is contained in the region
+	};
+
+	struct ParallelTask
+	{
+		int node;
+		ParallelTaskType type;
+	};
+
+	//! One task of a parallel traversal with its own copy of the function object.
+	template<class FuncObject> struct ParallelJob
+	{
+		const StelSphericalIndex* index;
+		const SphericalRegion* region;
+		bool boundingCaps;
+		ParallelTask task;
+		FuncObject func;
+	};
+
+	//! Split the traversal of a frozen index in tasks which can be run independently.
+	void collectParallelTasks(int node, const SphericalRegion* region, int depth, QVector<ParallelTask>& tasks) const;
+
+	template<class FuncObject> void processParallel(const SphericalRegion* region, bool boundingCaps, FuncObject& func) const
+	{
+		QVector<ParallelTask> tasks;
+		collectParallelTasks(0, region, 0, tasks);
+		if (tasks.isEmpty())
+			return;
+		QVector<ParallelJob<FuncObject> > jobs;
+		jobs.reserve(tasks.size());
+		foreach (const ParallelTask& task, tasks)
+		{
+			ParallelJob<FuncObject> job = {this, region, boundingCaps, task, func};
+			jobs.append(job);
+		}
+		QtConcurrent::blockingMap(jobs, &StelSphericalIndex::runParallelJob<FuncObject>);
+		func = jobs.at(0).func;
+		for (int i=1;i<jobs.size();++i)
+			func.merge(jobs.at(i).func);
+	}
+
+	template<class FuncObject> static void runParallelJob(ParallelJob<FuncObject>& job)
+	{
+		const StelSphericalIndex* index = job.index;
+		const int node = job.task.node;
+		// The region is the cap passed to processBoundingCapIntersectingRegionsParallel() in this case
+		const SphericalCap* cap = job.boundingCaps ? static_cast<const SphericalCap*>(job.region) : NULL;
+		switch (job.task.type)
+		{
+			case TaskAll:
+				index->processAll(node, job.func);
+				break;
+			case TaskSubtree:
+				if (cap)
+					index->processBoundingCapIntersectingRegions(node, *cap, job.func);
+				else
+					index->processIntersectingRegions(node, job.region, job.func);
+				break;
+			case TaskNodeElements:
+			{
+				const FlatNode& n = index->flatNodes.at(node);
+				if (cap)
+				{
+					QVarLengthArray<bool, 64> intersect(n.endElem-n.firstElem);
+					index->flatCaps.intersects(*cap, n.firstElem, intersect.size(), intersect.data());
+					for (int i=n.firstElem;i<n.endElem;++i)
+					{
+						if (intersect[i-n.firstElem])
+							job.func(index->flatElems.at(i).obj);
+					}
+					break;
+				}
+				for (int i=n.firstElem;i<n.endElem;++i)
+				{
+					const FlatElem& el = index->flatElems.at(i);
+					if (job.region->intersects(el.obj->getRegion().data()))
+						job.func(el.obj);
+				}
+				break;
+			}
+		}
+	}
+
+	//! The flat layout, empty if not frozen.
+	QVector<FlatNode> flatNodes;
+	QVector<FlatElem> flatElems;
+	//! The bounding caps of the flat elements, with the same indices.
+	SphericalCapArray flatCaps;
+	//! The shared pointers of the flat elements, with the same indices.
+	QVector<StelRegionObjectP> flatObjects;
 };
 
 #endif // _STELSPHERICALINDEX_HPP_
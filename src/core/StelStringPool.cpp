@@ -0,0 +1,201 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "StelStringPool.hpp"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+#include <cstring>
+
+namespace
+{
+	const int chunkBits = 16;
+	const quint32 chunkSize = 1u<<chunkBits;
+	// Up to 256 MB of strings
+	const int maxChunks = 4096;
+	const int minNbSlots = 1024;
+
+	//! FNV-1a hash of the UTF-8 bytes.
+	uint hashBytes(const char* data, int size)
+	{
+		uint h = 2166136261u;
+		for (int i=0;i<size;++i)
+		{
+			h ^= (uchar)data[i];
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	//! The table, a list of chunks and an open addressing hash table of the offsets.
+	class Pool
+	{
+	public:
+		Pool() : nbChunks(0), used(chunkSize), nbStrings(0), nbBytes(0)
+		{
+			// The empty string is at the offset 0
+			memset(chunks, 0, sizeof(chunks));
+			store("", 0);
+			slots.fill(0, minNbSlots);
+		}
+
+		~Pool()
+		{
+			for (int i=0;i<nbChunks;++i)
+				delete[] chunks[i];
+		}
+
+		const char* at(quint32 offset) const
+		{
+			return chunks[offset>>chunkBits] + (offset&(chunkSize-1));
+		}
+
+		quint32 intern(const QByteArray& bytes)
+		{
+			if (bytes.isEmpty())
+				return 0;
+			QMutexLocker locker(&mutex);
+			const int slot = findSlot(bytes.constData(), bytes.size());
+			if (slots.at(slot))
+				return slots.at(slot);
+			const quint32 offset = store(bytes.constData(), bytes.size());
+			if (!offset)
+				return 0;
+			slots[slot] = offset;
+			++nbStrings;
+			// Keep the load factor below one half
+			if (nbStrings*2 > slots.size())
+				rehash();
+			return offset;
+		}
+
+		quint32 find(const QByteArray& bytes)
+		{
+			if (bytes.isEmpty())
+				return 0;
+			QMutexLocker locker(&mutex);
+			return slots.at(findSlot(bytes.constData(), bytes.size()));
+		}
+
+		int getNbStrings()
+		{
+			QMutexLocker locker(&mutex);
+			return nbStrings;
+		}
+
+		qint64 getNbBytes()
+		{
+			QMutexLocker locker(&mutex);
+			return nbBytes;
+		}
+
+	private:
+		//! Find the slot of a string, or the empty slot where it goes.
+		int findSlot(const char* data, int size) const
+		{
+			const int mask = slots.size()-1;
+			int i = hashBytes(data, size) & mask;
+			while (slots.at(i))
+			{
+				const char* s = at(slots.at(i));
+				if (strncmp(s, data, size)==0 && s[size]=='\0')
+					break;
+				i = (i+1) & mask;
+			}
+			return i;
+		}
+
+		//! Copy a string at the end of the last chunk, or in a new chunk when it is full.
+		//! @return 0 if the table is full.
+		quint32 store(const char* data, int size)
+		{
+			if (size >= (int)chunkSize)
+				size = chunkSize-1;
+			if (used+size+1 > chunkSize)
+			{
+				if (nbChunks==maxChunks)
+					return 0;
+				chunks[nbChunks++] = new char[chunkSize];
+				used = 0;
+			}
+			const quint32 offset = ((nbChunks-1)<<chunkBits) | used;
+			char* dest = chunks[nbChunks-1] + used;
+			memcpy(dest, data, size);
+			dest[size] = '\0';
+			used += size+1;
+			nbBytes += size+1;
+			return offset;
+		}
+
+		void rehash()
+		{
+			const QVector<quint32> oldSlots = slots;
+			slots.fill(0, oldSlots.size()*2);
+			foreach (quint32 offset, oldSlots)
+			{
+				if (!offset)
+					continue;
+				const char* s = at(offset);
+				slots[findSlot(s, strlen(s))] = offset;
+			}
+		}
+
+		char* chunks[maxChunks];
+		int nbChunks;
+		//! Bytes used in the last chunk.
+		quint32 used;
+		QVector<quint32> slots;
+		int nbStrings;
+		qint64 nbBytes;
+		QMutex mutex;
+	};
+
+	Pool& pool()
+	{
+		static Pool p;
+		return p;
+	}
+}
+
+quint32 StelStringPool::intern(const QString& str)
+{
+	return pool().intern(str.toUtf8());
+}
+
+quint32 StelStringPool::find(const QString& str)
+{
+	return pool().find(str.toUtf8());
+}
+
+const char* StelStringPool::utf8(quint32 offset)
+{
+	return pool().at(offset);
+}
+
+int StelStringPool::getNbStrings()
+{
+	return pool().getNbStrings();
+}
+
+qint64 StelStringPool::getNbBytes()
+{
+	return pool().getNbBytes();
+}
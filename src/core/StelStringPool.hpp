@@ -0,0 +1,78 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#ifndef _STELSTRINGPOOL_HPP_
+#define _STELSTRINGPOOL_HPP_
+
+#include <QString>
+
+//! @class StelStringPool
+//! Shared table of the interned names of the catalogs (stars, nebulae, solar system bodies...).
+//! Each distinct string is stored once in UTF-8, null terminated, in large chunks which are never
+//! moved, and is referred to by its 32 bits offset in the table. The strings are never removed.
+//! Compared to a QString per object, this saves the UTF-16 encoding, the allocation overhead of
+//! each string and the copies of the values repeated by many objects, like the types.
+//! Interning is thread safe, and the strings can be read from any thread without locking.
+class StelStringPool
+{
+public:
+	//! Get the offset of a string, adding it to the table if needed.
+	//! The empty string has the offset 0. The strings longer than 64 KB are truncated.
+	static quint32 intern(const QString& str);
+	//! Get the offset of a string without adding it.
+	//! @return 0 if the string is not in the table.
+	static quint32 find(const QString& str);
+	//! Get a string of the table in UTF-8, valid until the end of the program.
+	static const char* utf8(quint32 offset);
+	//! Get the number of distinct strings in the table.
+	static int getNbStrings();
+	//! Get the number of bytes used by the strings of the table.
+	static qint64 getNbBytes();
+};
+
+//! @class StelInternedString
+//! Handle of a string of the StelStringPool, to be stored in the objects instead of a QString.
+//! The QString is only created when needed by toString(), typically to display the name.
+//! As the strings are interned, two handles are equal if and only if their strings are equal.
+class StelInternedString
+{
+public:
+	StelInternedString() : offset(0) {}
+	explicit StelInternedString(const QString& str) : offset(StelStringPool::intern(str)) {}
+
+	//! Get the handle of a string which is already interned, without adding it.
+	//! @return an empty handle if the string is not in the pool.
+	static StelInternedString find(const QString& str) {StelInternedString s; s.offset = StelStringPool::find(str); return s;}
+
+	QString toString() const {return offset ? QString::fromUtf8(StelStringPool::utf8(offset)) : QString();}
+	const char* utf8() const {return StelStringPool::utf8(offset);}
+	bool isEmpty() const {return offset==0;}
+	quint32 getOffset() const {return offset;}
+
+	bool operator==(const StelInternedString& other) const {return offset==other.offset;}
+	bool operator!=(const StelInternedString& other) const {return offset!=other.offset;}
+
+private:
+	quint32 offset;
+};
+
+inline uint qHash(const StelInternedString& str) {return str.getOffset();}
+
+#endif // _STELSTRINGPOOL_HPP_
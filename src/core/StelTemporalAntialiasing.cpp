@@ -0,0 +1,239 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelTemporalAntialiasing.hpp"
+#include "StelPainter.hpp"
+
+#include <QDebug>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+
+//! Get the element of index i of the Halton sequence of a base, in [0,1[.
+static float halton(int i, int base)
+{
+	float f = 1.f, r = 0.f;
+	for (; i>0; i/=base)
+	{
+		f /= base;
+		r += f*(i%base);
+	}
+	return r;
+}
+
+StelTemporalAntialiasing::StelTemporalAntialiasing(float feedback, int meshSize)
+	: feedback(qBound(0.f, feedback, 0.98f))
+	, meshSize(qBound(2, meshSize, 128))
+	, frame(0)
+	, current(0)
+	, historyValid(false)
+	, lastProjectionType(StelCore::ProjectionPerspective)
+	, shaderInitialized(false)
+	, resolveProgram(NULL)
+{
+	history[0] = NULL;
+	history[1] = NULL;
+}
+
+StelTemporalAntialiasing::~StelTemporalAntialiasing()
+{
+	delete history[0];
+	delete history[1];
+	delete resolveProgram;
+}
+
+Vec2f StelTemporalAntialiasing::getJitter() const
+{
+	// The Halton (2,3) offsets cover the pixel evenly over a few frames
+	const int i = frame%NbJitters+1;
+	return Vec2f(halton(i, 2)-0.5f, halton(i, 3)-0.5f);
+}
+
+void StelTemporalAntialiasing::reset()
+{
+	historyValid = false;
+	lastProjector.clear();
+}
+
+bool StelTemporalAntialiasing::initBuffers(const QSize& size)
+{
+	if (history[0] && history[0]->size()==size)
+		return true;
+	delete history[0];
+	delete history[1];
+	history[0] = new QOpenGLFramebufferObject(size);
+	history[1] = new QOpenGLFramebufferObject(size);
+	reset();
+	if (!history[0]->isValid() || !history[1]->isValid())
+	{
+		qWarning() << "Could not create the temporal antialiasing buffers of size" << size;
+		delete history[0];
+		delete history[1];
+		history[0] = NULL;
+		history[1] = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool StelTemporalAntialiasing::initShader() const
+{
+	shaderInitialized = true;
+
+	const char* vsrc =
+		"attribute highp vec2 pos;\n"
+		"attribute highp vec3 hist;\n"
+		"varying highp vec2 texc;\n"
+		"varying highp vec3 histc;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = vec4(2.*pos-vec2(1.), 0., 1.);\n"
+		"    texc = pos;\n"
+		"    histc = hist;\n"
+		"}\n";
+	// The history is clamped to the range of the pixel and its four neighbours in the current frame,
+	// and not used where it falls outside of the last frame
+	const char* fsrc =
+		"varying highp vec2 texc;\n"
+		"varying highp vec3 histc;\n"
+		"uniform sampler2D current;\n"
+		"uniform sampler2D history;\n"
+		"uniform highp vec2 texelSize;\n"
+		"uniform mediump float feedback;\n"
+		"void main(void)\n"
+		"{\n"
+		"    mediump vec3 c = texture2D(current, texc).rgb;\n"
+		"    mediump vec3 n0 = texture2D(current, texc+vec2(0., texelSize.y)).rgb;\n"
+		"    mediump vec3 n1 = texture2D(current, texc-vec2(0., texelSize.y)).rgb;\n"
+		"    mediump vec3 n2 = texture2D(current, texc+vec2(texelSize.x, 0.)).rgb;\n"
+		"    mediump vec3 n3 = texture2D(current, texc-vec2(texelSize.x, 0.)).rgb;\n"
+		"    mediump vec3 lo = min(c, min(min(n0, n1), min(n2, n3)));\n"
+		"    mediump vec3 hi = max(c, max(max(n0, n1), max(n2, n3)));\n"
+		"    mediump vec3 h = clamp(texture2D(history, histc.xy).rgb, lo, hi);\n"
+		"    mediump vec2 inside = step(vec2(0.), histc.xy)*step(histc.xy, vec2(1.));\n"
+		"    gl_FragColor = vec4(mix(c, h, feedback*histc.z*inside.x*inside.y), 1.);\n"
+		"}\n";
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelTemporalAntialiasing: Warnings while compiling vshader: " << vshader.log(); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelTemporalAntialiasing: Warnings while compiling fshader: " << fshader.log(); }
+	resolveProgram = new QOpenGLShaderProgram();
+	resolveProgram->addShader(&vshader);
+	resolveProgram->addShader(&fshader);
+	if (!StelPainter::linkProg(resolveProgram, "temporalAntialiasingShader"))
+	{
+		delete resolveProgram;
+		resolveProgram = NULL;
+		return false;
+	}
+	return true;
+}
+
+void StelTemporalAntialiasing::updateMesh(const StelProjectorP& prj, const QSize& size)
+{
+	const int n = meshSize+1;
+	if (meshPos.size()!=n*n)
+	{
+		meshPos.resize(n*n);
+		for (int j=0; j<n; ++j)
+			for (int i=0; i<n; ++i)
+				meshPos[j*n+i].set((float)i/meshSize, (float)j/meshSize);
+		meshIndices.clear();
+		for (int j=0; j<meshSize; ++j)
+		{
+			for (int i=0; i<meshSize; ++i)
+			{
+				const unsigned short k = j*n+i;
+				meshIndices << k << k+1 << k+n << k+1 << k+n+1 << k+n;
+			}
+		}
+	}
+
+	meshHistory.resize(n*n);
+	Vec3d v, win;
+	for (int i=0; i<n*n; ++i)
+	{
+		const Vec2f& p = meshPos.at(i);
+		if (historyValid && lastProjector && prj->unProject(p[0]*size.width(), p[1]*size.height(), v) && lastProjector->project(v, win))
+			meshHistory[i].set(win[0]/size.width(), win[1]/size.height(), 1.f);
+		else
+			meshHistory[i].set(p[0], p[1], 0.f);
+	}
+}
+
+QOpenGLFramebufferObject* StelTemporalAntialiasing::resolve(QOpenGLFramebufferObject* currentFbo, StelCore* core)
+{
+	const QSize size = currentFbo->size();
+	if (!initBuffers(size))
+		return currentFbo;
+	if (!shaderInitialized)
+		initShader();
+	if (!resolveProgram)
+		return currentFbo;
+
+	// The history of another projection can not be reprojected
+	const StelProjectorP prj = core->getProjection(StelCore::FrameJ2000);
+	if (core->getCurrentProjectionType()!=lastProjectionType)
+		historyValid = false;
+	lastProjectionType = core->getCurrentProjectionType();
+	updateMesh(prj, size);
+	lastProjector = prj;
+
+	const int next = 1-current;
+	history[next]->bind();
+	glViewport(0, 0, size.width(), size.height());
+	glDisable(GL_BLEND);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, history[current]->texture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// The current frame is sampled at the centers of its pixels
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, currentFbo->texture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	resolveProgram->bind();
+	resolveProgram->setUniformValue("current", 0);
+	resolveProgram->setUniformValue("history", 1);
+	resolveProgram->setUniformValue("texelSize", 1.f/size.width(), 1.f/size.height());
+	resolveProgram->setUniformValue("feedback", feedback);
+	const int pos = resolveProgram->attributeLocation("pos");
+	const int hist = resolveProgram->attributeLocation("hist");
+	resolveProgram->enableAttributeArray(pos);
+	resolveProgram->enableAttributeArray(hist);
+	resolveProgram->setAttributeArray(pos, GL_FLOAT, meshPos.constData(), 2);
+	resolveProgram->setAttributeArray(hist, GL_FLOAT, meshHistory.constData(), 3);
+	glDrawElements(GL_TRIANGLES, meshIndices.size(), GL_UNSIGNED_SHORT, meshIndices.constData());
+	resolveProgram->disableAttributeArray(pos);
+	resolveProgram->disableAttributeArray(hist);
+	resolveProgram->release();
+	history[next]->release();
+
+	current = next;
+	historyValid = true;
+	++frame;
+	return history[current];
+}
@@ -0,0 +1,98 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELTEMPORALANTIALIASING_HPP_
+#define _STELTEMPORALANTIALIASING_HPP_
+
+#include "StelCore.hpp"
+#include "StelProjector.hpp"
+#include "VecMath.hpp"
+
+#include <QSize>
+#include <QVector>
+
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+
+//! @class StelTemporalAntialiasing
+//! Antialias the viewport buffer by accumulating the frames, each of them drawn with a different subpixel
+//! offset, see StelProjector::setSubpixelJitter(). The cost is one pass over the buffer, much less than the
+//! fill cost of multisampling a large fisheye buffer, and the stars and thin lines stop shimmering when the
+//! sky rotates slowly.
+//! The accumulated frames are reprojected for the motion of the sky since the last frame: the motion is
+//! the one of the J2000 frame, from the rotation of the view of the StelMovementMgr and the time step of
+//! the StelCore. It is computed on a coarse mesh by unprojecting each of its nodes with the projector of the
+//! current frame and projecting it back with the one of the last frame. The objects moving in this frame,
+//! like the landscape or the planets, are kept from ghosting by clamping the history to the neighbourhood
+//! of each pixel in the current frame.
+//! All the methods must be called with the GL context current.
+class StelTemporalAntialiasing
+{
+public:
+	//! @param feedback the weight of the history in each frame, the higher the smoother but the slower to
+	//! converge after a change.
+	//! @param meshSize the number of cells on each side of the reprojection mesh.
+	StelTemporalAntialiasing(float feedback=0.9f, int meshSize=32);
+	~StelTemporalAntialiasing();
+
+	//! Get the subpixel offset with which the next frame has to be drawn, in pixels.
+	Vec2f getJitter() const;
+	//! Blend the frame just drawn with the history reprojected for the motion of the sky.
+	//! @param current the buffer of the frame, drawn with the offset returned by getJitter().
+	//! @param core the core with the view of the frame.
+	//! @return the buffer holding the antialiased frame, valid until the next call, or the current one
+	//! if the history buffers could not be created.
+	QOpenGLFramebufferObject* resolve(QOpenGLFramebufferObject* current, StelCore* core);
+	//! Discard the history, so that the next frame is shown as drawn.
+	void reset();
+
+private:
+	//! Number of offsets of the jitter sequence.
+	static const int NbJitters = 8;
+
+	//! Create the history buffers for a size, return false if it is not possible.
+	bool initBuffers(const QSize& size);
+	//! Build the resolve shader, return false if it is not possible.
+	bool initShader() const;
+	//! Compute the position in the history of the nodes of the mesh.
+	void updateMesh(const StelProjectorP& prj, const QSize& size);
+
+	const float feedback;
+	const int meshSize;
+	int frame;
+
+	//! The frames accumulated, written and read in turn.
+	QOpenGLFramebufferObject* history[2];
+	int current;
+	bool historyValid;
+	//! The projector and the projection type of the last frame, used to reproject the history.
+	StelProjectorP lastProjector;
+	StelCore::ProjectionType lastProjectionType;
+
+	//! For each node of the mesh, its position in the buffer, between 0 and 1, and its position in the
+	//! history with the weight of the history, 0 when the node was not visible in the last frame.
+	QVector<Vec2f> meshPos;
+	QVector<Vec3f> meshHistory;
+	QVector<unsigned short> meshIndices;
+
+	mutable bool shaderInitialized;
+	mutable QOpenGLShaderProgram* resolveProgram;
+};
+
+#endif // _STELTEMPORALANTIALIASING_HPP_
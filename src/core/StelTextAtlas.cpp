@@ -0,0 +1,371 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "StelTextAtlas.hpp"
+#include "StelPainter.hpp"
+
+#include <QDebug>
+#include <QGlyphRun>
+#include <QMatrix4x4>
+#include <QOpenGLShaderProgram>
+#include <QPainter>
+#include <QPainterPath>
+#include <QRawFont>
+#include <QTextLayout>
+
+#include <cmath>
+
+// Compute the signed distance field of a glyph mask, stored in all the channels.
+// 0.5 is on the outline, greater values are inside the glyph.
+static QImage computeDistanceField(const QImage& mask, int spread)
+{
+	const int w = mask.width();
+	const int h = mask.height();
+	QVector<bool> inside(w*h);
+	for (int y=0;y<h;++y)
+	{
+		const QRgb* line = reinterpret_cast<const QRgb*>(mask.constScanLine(y));
+		for (int x=0;x<w;++x)
+			inside[y*w+x] = qAlpha(line[x])>=128;
+	}
+
+	QImage field(w, h, QImage::Format_RGBA8888);
+	const int maxSqDist = spread*spread;
+	for (int y=0;y<h;++y)
+	{
+		uchar* line = field.scanLine(y);
+		for (int x=0;x<w;++x)
+		{
+			const bool in = inside[y*w+x];
+			int best = maxSqDist;
+			for (int dy=qMax(-spread, -y);dy<=qMin(spread, h-1-y);++dy)
+			{
+				for (int dx=qMax(-spread, -x);dx<=qMin(spread, w-1-x);++dx)
+				{
+					const int sqDist = dx*dx+dy*dy;
+					if (sqDist<best && inside[(y+dy)*w+x+dx]!=in)
+						best = sqDist;
+				}
+			}
+			// The outline is about half a pixel away from the center of the nearest opposite pixel
+			const float d = std::sqrt((float)best)-0.5f;
+			const float value = 0.5f + (in ? d : -d)/(2.f*spread);
+			const uchar c = (uchar)qBound(0, (int)(value*255.f+0.5f), 255);
+			line[4*x] = c;
+			line[4*x+1] = c;
+			line[4*x+2] = c;
+			line[4*x+3] = c;
+		}
+	}
+	return field;
+}
+
+StelTextAtlas::StelTextAtlas()
+	: program(NULL)
+	, texture(0)
+	, layouts(4096)
+	, shelfX(0)
+	, shelfY(0)
+	, shelfHeight(0)
+	, full(false)
+	, textureNeedsClear(true)
+	, nbVertices(0)
+{
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	const char *vsrc =
+		"attribute highp vec2 vertex;\n"
+		"attribute mediump vec2 texCoord;\n"
+		"attribute mediump vec4 color;\n"
+		"attribute mediump float smoothing;\n"
+		"uniform mediump mat4 projectionMatrix;\n"
+		"varying mediump vec2 texc;\n"
+		"varying mediump vec4 outColor;\n"
+		"varying mediump float outSmoothing;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = projectionMatrix * vec4(vertex, 0., 1.);\n"
+		"    texc = texCoord;\n"
+		"    outColor = color;\n"
+		"    outSmoothing = smoothing;\n"
+		"}\n";
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelTextAtlas: Warnings while compiling vshader: " << vshader.log(); }
+
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	const char *fsrc =
+		"varying mediump vec2 texc;\n"
+		"varying mediump vec4 outColor;\n"
+		"varying mediump float outSmoothing;\n"
+		"uniform sampler2D tex;\n"
+		"void main(void)\n"
+		"{\n"
+		"    mediump float d = texture2D(tex, texc).a;\n"
+		"    gl_FragColor = vec4(outColor.rgb, outColor.a*smoothstep(0.5-outSmoothing, 0.5+outSmoothing, d));\n"
+		"}\n";
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelTextAtlas: Warnings while compiling fshader: " << fshader.log(); }
+
+	program = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
+	program->addShader(&vshader);
+	program->addShader(&fshader);
+	StelPainter::linkProg(program, "textAtlasShaderProgram");
+	vars.projectionMatrix = program->uniformLocation("projectionMatrix");
+	vars.vertex = program->attributeLocation("vertex");
+	vars.texCoord = program->attributeLocation("texCoord");
+	vars.color = program->attributeLocation("color");
+	vars.smoothing = program->attributeLocation("smoothing");
+	vars.texture = program->uniformLocation("tex");
+}
+
+StelTextAtlas::~StelTextAtlas()
+{
+	if (texture != 0)
+		glDeleteTextures(1, &texture);
+	delete program;
+	program = NULL;
+}
+
+void StelTextAtlas::clear()
+{
+	Q_ASSERT(nbVertices==0);
+	glyphs.clear();
+	layouts.clear();
+	pendingUploads.clear();
+	shelfX = 0;
+	shelfY = 0;
+	shelfHeight = 0;
+	full = false;
+	// The filtering at the edges of the new glyphs must not pick the old ones
+	textureNeedsClear = true;
+}
+
+const StelTextAtlas::Glyph* StelTextAtlas::getGlyph(const QRawFont& rawFont, quint32 glyphIndex)
+{
+	const QPair<QString, quint32> key(rawFont.familyName()+QChar('|')+rawFont.styleName(), glyphIndex);
+	QHash<QPair<QString, quint32>, Glyph>::const_iterator iter = glyphs.constFind(key);
+	if (iter!=glyphs.constEnd())
+		return &iter.value();
+
+	Glyph g;
+	g.x0 = g.y0 = g.x1 = g.y1 = 0.f;
+	g.u0 = g.v0 = g.u1 = g.v1 = 0.f;
+	const QPainterPath path = rawFont.pathForGlyph(glyphIndex);
+	const QRectF bounds = path.boundingRect();
+	const int left = (int)std::floor(bounds.left())-Spread;
+	const int top = (int)std::floor(bounds.top())-Spread;
+	const int w = (int)std::ceil(bounds.right())+Spread-left;
+	const int h = (int)std::ceil(bounds.bottom())+Spread-top;
+	// Blank glyphs are cached too, with an empty quad
+	if (path.isEmpty() || w>AtlasSize || h>AtlasSize)
+		return &glyphs.insert(key, g).value();
+
+	if (shelfX+w>AtlasSize)
+	{
+		shelfX = 0;
+		shelfY += shelfHeight+1;
+		shelfHeight = 0;
+	}
+	if (shelfY+h>AtlasSize)
+	{
+		full = true;
+		return NULL;
+	}
+
+	QImage mask(w, h, QImage::Format_ARGB32_Premultiplied);
+	mask.fill(0);
+	{
+		QPainter painter(&mask);
+		painter.setRenderHint(QPainter::Antialiasing);
+		painter.translate(-left, -top);
+		painter.fillPath(path, Qt::white);
+	}
+	PendingUpload upload;
+	upload.x = shelfX;
+	upload.y = shelfY;
+	upload.image = computeDistanceField(mask, Spread);
+	pendingUploads.append(upload);
+
+	g.x0 = left;
+	g.y0 = top;
+	g.x1 = left+w;
+	g.y1 = top+h;
+	g.u0 = (float)shelfX/AtlasSize;
+	g.v0 = (float)shelfY/AtlasSize;
+	g.u1 = (float)(shelfX+w)/AtlasSize;
+	g.v1 = (float)(shelfY+h)/AtlasSize;
+	shelfX += w+1;
+	shelfHeight = qMax(shelfHeight, h);
+	return &glyphs.insert(key, g).value();
+}
+
+const StelTextAtlas::Layout* StelTextAtlas::getLayout(const QFont& font, const QString& str)
+{
+	QFont baseFont(font);
+	baseFont.setPixelSize(BasePixelSize);
+	const QString key = baseFont.key()+QChar('\n')+str;
+	Layout* layout = layouts.object(key);
+	if (layout)
+		return layout;
+
+	QTextLayout textLayout(str, baseFont);
+	textLayout.beginLayout();
+	QTextLine line = textLayout.createLine();
+	textLayout.endLayout();
+
+	layout = new Layout();
+	if (line.isValid())
+	{
+		// The glyph positions are relative to the top of the line, QPainter::drawText() puts the baseline at the origin
+		const float baseline = line.ascent();
+		foreach (const QGlyphRun& run, textLayout.glyphRuns())
+		{
+			const QRawFont rawFont = run.rawFont();
+			const QVector<quint32> indexes = run.glyphIndexes();
+			const QVector<QPointF> positions = run.positions();
+			for (int i=0;i<indexes.size();++i)
+			{
+				const Glyph* g = getGlyph(rawFont, indexes.at(i));
+				if (g==NULL)
+				{
+					delete layout;
+					return NULL;
+				}
+				if (g->x0==g->x1)
+					continue;
+				Glyph placed = *g;
+				const float px = positions.at(i).x();
+				const float py = positions.at(i).y()-baseline;
+				placed.x0 += px;
+				placed.x1 += px;
+				placed.y0 += py;
+				placed.y1 += py;
+				layout->glyphs.append(placed);
+			}
+		}
+	}
+	layouts.insert(key, layout);
+	return layout;
+}
+
+bool StelTextAtlas::addText(const QFont& font, const QString& str, float x, float y, float angleDeg,
+			    float xshift, float yshift, float pixelSize, const Vec4f& color)
+{
+	const Layout* layout = getLayout(font, str);
+	if (layout==NULL)
+		return false;
+	if (layout->glyphs.isEmpty())
+		return true;
+
+	const float scale = pixelSize/BasePixelSize;
+	const float cosa = std::cos(angleDeg*M_PI/180.);
+	const float sina = std::sin(angleDeg*M_PI/180.);
+	// Half a pixel of transition on the outline, in distance field units
+	const float smoothing = qMin(0.5f, 0.25f/(Spread*scale));
+
+	const int needed = nbVertices+6*layout->glyphs.size();
+	if (vertices.size()<needed)
+		vertices.resize(qMax(needed, 2*vertices.size()));
+	Vertex* v = vertices.data()+nbVertices;
+	foreach (const Glyph& g, layout->glyphs)
+	{
+		// Corners in the frame of the text with y going up, then rotated around the origin
+		const float lx[4] = {xshift+g.x0*scale, xshift+g.x1*scale, xshift+g.x1*scale, xshift+g.x0*scale};
+		const float ly[4] = {yshift-g.y1*scale, yshift-g.y1*scale, yshift-g.y0*scale, yshift-g.y0*scale};
+		const float tu[4] = {g.u0, g.u1, g.u1, g.u0};
+		const float tv[4] = {g.v1, g.v1, g.v0, g.v0};
+		static const int corners[6] = {0, 1, 2, 0, 2, 3};
+		for (int i=0;i<6;++i)
+		{
+			const int c = corners[i];
+			v->x = x+cosa*lx[c]-sina*ly[c];
+			v->y = y+sina*lx[c]+cosa*ly[c];
+			v->u = tu[c];
+			v->v = tv[c];
+			v->r = color[0];
+			v->g = color[1];
+			v->b = color[2];
+			v->a = color[3];
+			v->smoothing = smoothing;
+			++v;
+		}
+	}
+	nbVertices = needed;
+	return true;
+}
+
+void StelTextAtlas::initTexture()
+{
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void StelTextAtlas::flush(const QMatrix4x4& projection)
+{
+	if (nbVertices==0)
+		return;
+
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	if (texture==0)
+		initTexture();
+	else
+		glBindTexture(GL_TEXTURE_2D, texture);
+	if (textureNeedsClear)
+	{
+		const QByteArray zeros(AtlasSize*AtlasSize*4, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, AtlasSize, AtlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, zeros.constData());
+		textureNeedsClear = false;
+	}
+	foreach (const PendingUpload& upload, pendingUploads)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, upload.x, upload.y, upload.image.width(), upload.image.height(),
+				GL_RGBA, GL_UNSIGNED_BYTE, upload.image.constBits());
+	}
+	pendingUploads.clear();
+
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	const Vertex* data = vertices.constData();
+	program->bind();
+	program->setUniformValue(vars.projectionMatrix, projection);
+	program->setUniformValue(vars.texture, 0);
+	program->setAttributeArray(vars.vertex, GL_FLOAT, &data->x, 2, sizeof(Vertex));
+	program->enableAttributeArray(vars.vertex);
+	program->setAttributeArray(vars.texCoord, GL_FLOAT, &data->u, 2, sizeof(Vertex));
+	program->enableAttributeArray(vars.texCoord);
+	program->setAttributeArray(vars.color, GL_FLOAT, &data->r, 4, sizeof(Vertex));
+	program->enableAttributeArray(vars.color);
+	program->setAttributeArray(vars.smoothing, GL_FLOAT, &data->smoothing, 1, sizeof(Vertex));
+	program->enableAttributeArray(vars.smoothing);
+	glDrawArrays(GL_TRIANGLES, 0, nbVertices);
+	program->disableAttributeArray(vars.vertex);
+	program->disableAttributeArray(vars.texCoord);
+	program->disableAttributeArray(vars.color);
+	program->disableAttributeArray(vars.smoothing);
+	program->release();
+
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+	nbVertices = 0;
+}
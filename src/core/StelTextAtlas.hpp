@@ -0,0 +1,153 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#ifndef _STELTEXTATLAS_HPP_
+#define _STELTEXTATLAS_HPP_
+
+#include "StelOpenGL.hpp"
+#include "VecMath.hpp"
+
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+class QOpenGLShaderProgram;
+class QMatrix4x4;
+class QRawFont;
+
+//! @class StelTextAtlas
+//! Draw the texts of the StelPainter from a texture atlas of signed distance field glyphs.
+//! The strings are laid out once with QTextLayout, so that complex scripts are shaped like
+//! with QPainter, and their glyphs are rendered at a single base size in the atlas. The same
+//! glyphs are then scaled to any font size. The quads of all the texts drawn by a StelPainter
+//! are accumulated and drawn in a single call when flush() is called.
+class StelTextAtlas
+{
+public:
+	//! Pixel size at which the glyphs are rendered in the atlas.
+	static const int BasePixelSize = 32;
+	//! Distance in pixels at the base size covered by the distance field around the glyphs.
+	static const int Spread = 4;
+	//! Width and height of the atlas texture.
+	static const int AtlasSize = 1024;
+
+	//! Needs a current OpenGL context, the texture is created on the first flush().
+	StelTextAtlas();
+	~StelTextAtlas();
+
+	//! Add the quads of a text to the batch.
+	//! @param font the font of the text, only its family and style are used.
+	//! @param str the text.
+	//! @param x, y the position of the origin of the text in pixels, with y going up.
+	//! @param angleDeg the rotation of the text around its origin, counterclockwise.
+	//! @param xshift, yshift the shift of the text in its rotated frame.
+	//! @param pixelSize the size of the text in pixels.
+	//! @param color the color of the text.
+	//! @return false if the text could not be added, in which case isFull() tells whether the
+	//! atlas has to be cleared first.
+	bool addText(const QFont& font, const QString& str, float x, float y, float angleDeg,
+		     float xshift, float yshift, float pixelSize, const Vec4f& color);
+
+	//! Whether some glyphs could not be added because the atlas is full.
+	bool isFull() const {return full;}
+
+	//! Remove all the glyphs from the atlas. The batch must have been flushed before.
+	void clear();
+
+	//! Whether some quads are waiting for flush().
+	bool hasPendingText() const {return nbVertices>0;}
+
+	//! Draw all the quads added since the last call, and empty the batch.
+	//! The blending and the texture bound to the current unit are changed, and the caller
+	//! is responsible for restoring them.
+	//! @param projection the matrix transforming the pixel coordinates to clip coordinates.
+	void flush(const QMatrix4x4& projection);
+
+private:
+	//! One glyph of the atlas.
+	struct Glyph
+	{
+		//! Quad of the glyph relative to its origin at the base size, with y going down.
+		float x0, y0, x1, y1;
+		//! Texture coordinates of the quad.
+		float u0, v0, u1, v1;
+	};
+
+	//! A laid out string, with the glyphs already placed relative to the origin of the text.
+	struct Layout
+	{
+		QVector<Glyph> glyphs;
+	};
+
+	struct Vertex
+	{
+		float x, y;
+		float u, v;
+		float r, g, b, a;
+		float smoothing;
+	};
+
+	//! Glyph images waiting to be uploaded at the next flush.
+	struct PendingUpload
+	{
+		int x, y;
+		QImage image;
+	};
+
+	const Layout* getLayout(const QFont& font, const QString& str);
+	//! Get a glyph of the atlas, rendering it if needed.
+	//! @return NULL if the atlas is full.
+	const Glyph* getGlyph(const QRawFont& rawFont, quint32 glyphIndex);
+	void initTexture();
+
+	QOpenGLShaderProgram* program;
+	struct ShaderVars
+	{
+		int projectionMatrix;
+		int vertex;
+		int texCoord;
+		int color;
+		int smoothing;
+		int texture;
+	};
+	ShaderVars vars;
+
+	GLuint texture;
+	QVector<PendingUpload> pendingUploads;
+
+	//! The glyphs of the atlas, indexed by font and glyph index.
+	QHash<QPair<QString, quint32>, Glyph> glyphs;
+	//! The recently drawn strings, indexed by font and string.
+	QCache<QString, Layout> layouts;
+
+	//! Shelf packing of the glyphs in the atlas.
+	int shelfX, shelfY, shelfHeight;
+	bool full;
+	bool textureNeedsClear;
+
+	QVector<Vertex> vertices;
+	int nbVertices;
+};
+
+#endif // _STELTEXTATLAS_HPP_
@@ -24,6 +24,9 @@
 #include "StelApp.hpp"
 #include "StelUtils.hpp"
 #include "StelPainter.hpp"
+#include "StelRenderStats.hpp"
+#include "StelMemoryStats.hpp"
+#include "StelTracer.hpp"
 
 #include <QImageReader>
 #include <QSize>
@@ -34,10 +37,16 @@
 #include <QtEndian>
 #include <QFuture>
 #include <QtConcurrent>
+#include <QOpenGLBuffer>
+#include <QFile>
+#include <QBuffer>
 
 #include <cstdlib>
+#include <cstring>
 
-StelTexture::StelTexture() : networkReply(NULL), loader(NULL), errorOccured(false), id(0), avgLuminance(-1.f)
+int StelTexture::maxTextureSize = 0;
+
+StelTexture::StelTexture() : networkReply(NULL), loader(NULL), uploadQueued(false), uploadPriority(0.f), lastUsedFrame(0), gpuMemory(0), errorOccured(false), id(0), avgLuminance(-1.f)
 {
 	width = -1;
 	height = -1;
@@ -45,6 +54,18 @@ StelTexture::StelTexture() : networkReply(NULL), loader(NULL), errorOccured(fals
 
 StelTexture::~StelTexture()
 {
+	if (uploadQueued)
+		StelApp::getInstance().getTextureManager().cancelUpload(this);
+	if (loadParams.evictable)
+		StelApp::getInstance().getTextureManager().removeEvictableTexture(this);
+	// A texture created by the upload thread but not bound yet was not counted
+	const bool accounted = id!=0;
+	if (threadedUpload && !threadedUpload->state.testAndSetOrdered(ThreadedUpload::Pending, ThreadedUpload::Cancelled))
+	{
+		// The upload thread already created the texture, it is deleted below
+		StelApp::getInstance().getTextureManager().isThreadedUploadComplete(threadedUpload.data(), true);
+		id = threadedUpload->id;
+	}
 	if (id != 0)
 	{
 		if (glIsTexture(id)==GL_FALSE)
@@ -55,6 +76,8 @@ StelTexture::~StelTexture()
 		{
 			glDeleteTextures(1, &id);
 		}
+		if (accounted)
+			accountGpuMemory(-1);
 		id = 0;
 	}
 	if (networkReply != NULL)
@@ -93,14 +116,185 @@ StelTexture::GLData StelTexture::imageToGLData(const QImage &image)
 /*************************************************************************
  Defined to be passed to QtConcurrent::run
  *************************************************************************/
-StelTexture::GLData StelTexture::loadFromPath(const QString &path)
+StelTexture::GLData StelTexture::loadFromPath(const QString &path, int maxSize)
+{
+	STEL_TRACE_SCOPE("StelTexture::loadFromPath");
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return GLData();
+	if (path.endsWith(".ktx", Qt::CaseInsensitive) || path.endsWith(".dds", Qt::CaseInsensitive))
+		return loadCompressed(file.readAll());
+	return imageToGLData(readImage(&file, maxSize));
+}
+
+StelTexture::GLData StelTexture::loadFromData(const QByteArray& data, int maxSize)
+{
+	STEL_TRACE_SCOPE("StelTexture::loadFromData");
+	if (isCompressedData(data))
+		return loadCompressed(data);
+	QBuffer buffer;
+	buffer.setData(data);
+	if (!buffer.open(QIODevice::ReadOnly))
+		return GLData();
+	return imageToGLData(readImage(&buffer, maxSize));
+}
+
+QImage StelTexture::readImage(QIODevice* device, int maxSize)
+{
+	QImageReader reader(device);
+	if (maxTextureSize>0 && (maxSize<=0 || maxSize>maxTextureSize))
+		maxSize = maxTextureSize;
+	const QSize size = reader.size();
+	if (maxSize>0 && size.isValid() && (size.width()>maxSize || size.height()>maxSize))
+	{
+		// The JPEG decoder scales the DCT coefficients, so the full size image is never decoded.
+		// The other formats are decoded at full size and scaled by QImageReader.
+		reader.setScaledSize(size.scaled(maxSize, maxSize, Qt::KeepAspectRatio));
+	}
+	return reader.read();
+}
+
+static const char ktxIdentifier[12] = {'\xAB', 'K', 'T', 'X', ' ', '1', '1', '\xBB', '\r', '\n', '\x1A', '\n'};
+
+bool StelTexture::isCompressedData(const QByteArray& data)
 {
-	return imageToGLData(QImage(path));
+	return data.startsWith("DDS ") || data.startsWith(QByteArray::fromRawData(ktxIdentifier, sizeof(ktxIdentifier)));
+}
+
+// Return the size in bytes of a 4x4 block for the supported compressed formats, or 0.
+static int compressedBlockSize(GLint format)
+{
+	switch (format)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGB8_ETC2:
+		case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_RGBA8_ETC2_EAC:
+			return 16;
+		default:
+			return 0;
+	}
 }
 
-StelTexture::GLData StelTexture::loadFromData(const QByteArray& data)
+// Map the DXGI formats of the DDS DX10 header to the GL formats.
+// The sRGB variants are used as the uncompressed images are, without conversion.
+static GLint dxgiToGLFormat(quint32 dxgiFormat)
 {
-	return imageToGLData(QImage::fromData(data));
+	switch (dxgiFormat)
+	{
+		case 71: case 72: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;	// BC1_UNORM(_SRGB)
+		case 74: case 75: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;	// BC2_UNORM(_SRGB)
+		case 77: case 78: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;	// BC3_UNORM(_SRGB)
+		case 98: case 99: return GL_COMPRESSED_RGBA_BPTC_UNORM;		// BC7_UNORM(_SRGB)
+		default: return 0;
+	}
+}
+
+StelTexture::GLData StelTexture::loadCompressed(const QByteArray& fileData, bool headerOnly)
+{
+	GLData ret;
+	const uchar* bytes = (const uchar*)fileData.constData();
+	int nbLevels;
+	int offset;
+	bool ktx;
+	bool swap = false;
+	if (fileData.startsWith(QByteArray::fromRawData(ktxIdentifier, sizeof(ktxIdentifier))))
+	{
+		// KTX 1.1: identifier followed by 13 32 bits fields.
+		if (fileData.size() < 64)
+			return GLData();
+		ktx = true;
+		swap = qFromLittleEndian<quint32>(bytes+12)!=0x04030201;
+		quint32 header[13];
+		for (int i=0;i<13;++i)
+			header[i] = swap ? qFromBigEndian<quint32>(bytes+12+4*i) : qFromLittleEndian<quint32>(bytes+12+4*i);
+		// glType must be 0 for compressed data, and only simple 2D textures are supported.
+		if (header[1]!=0 || header[8]!=0 || header[9]!=0 || header[10]!=1)
+			return GLData();
+		ret.compressedFormat = header[4];
+		ret.width = header[6];
+		ret.height = header[7];
+		nbLevels = qMax(1, (int)header[11]);
+		offset = 64 + header[12];
+	}
+	else if (fileData.startsWith("DDS "))
+	{
+		if (fileData.size() < 128)
+			return GLData();
+		ktx = false;
+		ret.height = qFromLittleEndian<quint32>(bytes+12);
+		ret.width = qFromLittleEndian<quint32>(bytes+16);
+		nbLevels = qMax(1, (int)qFromLittleEndian<quint32>(bytes+28));
+		// Cube maps and volume textures are not supported.
+		if (qFromLittleEndian<quint32>(bytes+112) & 0x200200)
+			return GLData();
+		const QByteArray fourCC = fileData.mid(84, 4);
+		offset = 128;
+		if (fourCC=="DXT1")
+			ret.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		else if (fourCC=="DXT3")
+			ret.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		else if (fourCC=="DXT5")
+			ret.compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		else if (fourCC=="DX10")
+		{
+			if (fileData.size() < 148)
+				return GLData();
+			// Only 2D textures (resourceDimension 3) with a single element are supported.
+			if (qFromLittleEndian<quint32>(bytes+132)!=3 || qFromLittleEndian<quint32>(bytes+140)>1)
+				return GLData();
+			ret.compressedFormat = dxgiToGLFormat(qFromLittleEndian<quint32>(bytes+128));
+			offset = 148;
+		}
+	}
+	else
+		return GLData();
+
+	const int blockSize = compressedBlockSize(ret.compressedFormat);
+	if (blockSize==0 || ret.width<=0 || ret.height<=0)
+	{
+		qWarning() << "Unsupported compressed texture format" << QString::number(ret.compressedFormat, 16);
+		return GLData();
+	}
+	if (headerOnly)
+		return ret;
+
+	// Collect the mipmap levels, skipping the size fields and padding of the KTX files.
+	int w = ret.width;
+	int h = ret.height;
+	ret.data.reserve(fileData.size()-offset);
+	for (int level=0;level<nbLevels;++level)
+	{
+		const int levelSize = ((w+3)/4) * ((h+3)/4) * blockSize;
+		if (ktx)
+		{
+			if (offset+4 > fileData.size())
+				break;
+			const quint32 imageSize = swap ? qFromBigEndian<quint32>(bytes+offset) : qFromLittleEndian<quint32>(bytes+offset);
+			if ((int)imageSize!=levelSize)
+				break;
+			offset += 4;
+		}
+		if (offset+levelSize > fileData.size())
+			break;
+		ret.data.append(fileData.constData()+offset, levelSize);
+		ret.levelSizes.append(levelSize);
+		offset += ktx ? (levelSize+3)&~3 : levelSize;
+		if (w==1 && h==1)
+			break;
+		w = qMax(1, w/2);
+		h = qMax(1, h/2);
+	}
+	if (ret.levelSizes.isEmpty())
+		return GLData();
+	ret.format = GL_RGBA;
+	ret.type = GL_UNSIGNED_BYTE;
+	return ret;
 }
 
 /*************************************************************************
@@ -112,6 +306,8 @@ bool StelTexture::bind(int slot)
 	if (id != 0)
 	{
 		// The texture is already fully loaded, just bind and return true;
+		if (loadParams.evictable)
+			lastUsedFrame = StelApp::getInstance().getTextureManager().getFrameCounter();
 		glActiveTexture(GL_TEXTURE0 + slot);
 		glBindTexture(GL_TEXTURE_2D, id);
 		return true;
@@ -119,11 +315,34 @@ bool StelTexture::bind(int slot)
 	if (errorOccured)
 		return false;
 
+	// The texture is being created by the texture upload thread.
+	if (threadedUpload)
+	{
+		if (threadedUpload->state.loadAcquire()!=ThreadedUpload::Done || !StelApp::getInstance().getTextureManager().isThreadedUploadComplete(threadedUpload.data()))
+			return false;
+		id = threadedUpload->id;
+		threadedUpload.clear();
+		if (id==0)
+		{
+			reportError("Unknown error");
+			return false;
+		}
+		accountGpuMemory(1);
+		if (loadParams.evictable)
+			StelApp::getInstance().getTextureManager().addEvictableTexture(this);
+		emit(loadingProcessFinished(false));
+		return bind(slot);
+	}
+
 	// If the file is remote, start a network connection.
-	if (loader == NULL && networkReply == NULL && fullPath.startsWith("http://")) {
+	if (loader == NULL && networkReply == NULL && (fullPath.startsWith("http://") || fullPath.startsWith("https://"))) {
 		QNetworkRequest req = QNetworkRequest(QUrl(fullPath));
 		// Define that preference should be given to cached files (no etag checks)
 		req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+		// Many tiles are requested from the same servers, a single multiplexed connection is enough
+		req.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
 		req.setRawHeader("User-Agent", StelUtils::getApplicationName().toLatin1());
 		networkReply = StelApp::getInstance().getNetworkAccessManager()->get(req);
 		connect(networkReply, SIGNAL(finished()), this, SLOT(onNetworkReply()));
@@ -135,17 +354,38 @@ bool StelTexture::bind(int slot)
 	// Not a remote file, start a loader from local file.
 	if (loader == NULL)
 	{
-		loader = new QFuture<GLData>(QtConcurrent::run(loadFromPath, fullPath));
+		loader = new QFuture<GLData>(QtConcurrent::run(loadFromPath, fullPath, loadParams.maxSize));
 		return false;
 	}
 	// Wait until the loader finish.
-	if (!loader->isFinished())
+	if (!loader->isFinished() || uploadQueued)
+		return false;
+	// Finally load the data in the upload thread, or else in the main thread, or let the texture manager
+	// do it when the uploads are limited.
+	StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	if (texMgr.uploadInThread(this))
 		return false;
-	// Finally load the data in the main thread.
+	if (texMgr.getUploadBudget()>0)
+	{
+		texMgr.queueUpload(this);
+		return false;
+	}
+	finishLoading();
+	return id!=0;
+}
+
+void StelTexture::finishLoading()
+{
+	Q_ASSERT(loader && loader->isFinished());
 	glLoad(loader->result());
 	delete loader;
 	loader = NULL;
-	return true;
+}
+
+int StelTexture::getLoadedDataSize() const
+{
+	Q_ASSERT(loader && loader->isFinished());
+	return loader->result().data.size();
 }
 
 void StelTexture::onNetworkReply()
@@ -158,7 +398,7 @@ void StelTexture::onNetworkReply()
 	else
 	{
 		QByteArray data = networkReply->readAll();
-		loader = new QFuture<GLData>(QtConcurrent::run(loadFromData, data));
+		loader = new QFuture<GLData>(QtConcurrent::run(loadFromData, data, loadParams.maxSize));
 	}
 	networkReply->deleteLater();
 	networkReply = NULL;
@@ -173,13 +413,24 @@ bool StelTexture::getDimensions(int &awidth, int &aheight)
 	{
 		// Try to get the size from the file without loading data
 		QImageReader im(fullPath);
-		if (!im.canRead())
+		if (im.canRead())
 		{
-			return false;
+			QSize size = im.size();
+			width = size.width();
+			height = size.height();
+		}
+		else
+		{
+			// The compressed textures can be read only from a local file
+			QFile file(fullPath);
+			if (!file.open(QIODevice::ReadOnly))
+				return false;
+			const GLData header = loadCompressed(file.read(148), true);
+			if (header.compressedFormat==0)
+				return false;
+			width = header.width;
+			height = header.height;
 		}
-		QSize size = im.size();
-		width = size.width();
-		height = size.height();
 	}
 	awidth = width;
 	aheight = height;
@@ -207,6 +458,38 @@ QByteArray StelTexture::convertToGLFormat(const QImage& image, GLint *format, GL
 			  *format == GL_RGBA ? 4 :
 			  3;
 
+	// The formats whose rows are already laid out as OpenGL expects them are copied row by row
+	QImage::Format directFormat = QImage::Format_Invalid;
+	switch (*format)
+	{
+		case GL_RGB:
+			directFormat = QImage::Format_RGB888;
+			break;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 2, 0)
+		case GL_RGBA:
+			directFormat = QImage::Format_RGBA8888;
+			break;
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+		case GL_LUMINANCE:
+			directFormat = QImage::Format_Grayscale8;
+			break;
+#endif
+		default:
+			break;
+	}
+	if (directFormat!=QImage::Format_Invalid)
+	{
+		const QImage tmp = image.format()==directFormat ? image : image.convertToFormat(directFormat);
+		const int rowSize = width * bpp;
+		ret.resize(rowSize * height);
+		char* dst = ret.data();
+		// flips the rows over y
+		for (int y = height - 1; y >= 0; --y, dst += rowSize)
+			memcpy(dst, tmp.constScanLine(y), rowSize);
+		return ret;
+	}
+
 	ret.reserve(width * height * bpp);
 	QImage tmp = image.convertToFormat(QImage::Format_ARGB32);
 
@@ -254,30 +537,112 @@ QByteArray StelTexture::convertToGLFormat(const QImage& image, GLint *format, GL
 
 bool StelTexture::glLoad(const GLData& data)
 {
+	STEL_TRACE_SCOPE("StelTexture::glLoad");
 	if (data.data.isEmpty())
 	{
 		reportError("Unknown error");
 		return false;
 	}
+	StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	if (data.compressedFormat!=0 && !texMgr.isCompressedFormatSupported(data.compressedFormat))
+	{
+		reportError("Compressed texture format not supported by the graphics driver");
+		return false;
+	}
 	width = data.width;
 	height = data.height;
+	gpuMemory = estimateGpuMemory(data, loadParams);
+	id = createGLTexture(data, loadParams, texMgr.getPixelUnpackBuffer());
+	accountGpuMemory(1);
+	if (loadParams.evictable)
+		texMgr.addEvictableTexture(this);
+	// Report success of texture loading
+	emit(loadingProcessFinished(false));
+	return true;
+}
+
+void StelTexture::accountGpuMemory(int sign) const
+{
+	const int tag = loadParams.evictable ? StelMemoryStats::EvictableTextures : StelMemoryStats::Textures;
+	StelApp::getInstance().getMemoryStats()->add(tag, sign*(qint64)gpuMemory);
+}
+
+int StelTexture::estimateGpuMemory(const GLData& data, const StelTextureParams& params)
+{
+	// The compressed data contains its own mipmaps, the generated ones add a third of the size.
+	if (data.compressedFormat==0 && params.generateMipmaps)
+		return data.data.size() + data.data.size()/3;
+	return data.data.size();
+}
+
+GLuint StelTexture::createGLTexture(const GLData& data, const StelTextureParams& params, QOpenGLBuffer* pixelUnpackBuffer)
+{
+	GLuint texId;
 	glActiveTexture(GL_TEXTURE0);
-	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, loadParams.filtering);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, loadParams.filtering);
-	glTexImage2D(GL_TEXTURE_2D, 0, data.format, width, height, 0, data.format,
-				 data.type, data.data.constData());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, loadParams.wrapMode);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, loadParams.wrapMode);
-	if (loadParams.generateMipmaps)
+	glGenTextures(1, &texId);
+	glBindTexture(GL_TEXTURE_2D, texId);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, params.filtering);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, params.filtering);
+	if (data.compressedFormat!=0)
+	{
+		// Upload all the levels stored in the file, the mipmaps can't be generated for compressed textures.
+		const char* pixels = data.data.constData();
+		if (pixelUnpackBuffer)
+		{
+			pixelUnpackBuffer->bind();
+			pixelUnpackBuffer->allocate(data.data.constData(), data.data.size());
+			pixels = NULL;
+		}
+		int w = data.width;
+		int h = data.height;
+		int offset = 0;
+		bool completeChain = false;
+		for (int level=0;level<data.levelSizes.size();++level)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, data.compressedFormat, w, h, 0, data.levelSizes[level], pixels+offset);
+			offset += data.levelSizes[level];
+			completeChain = w==1 && h==1;
+			w = qMax(1, w/2);
+			h = qMax(1, h/2);
+		}
+		if (pixelUnpackBuffer)
+			pixelUnpackBuffer->release();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.wrapMode);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.wrapMode);
+		if (data.levelSizes.size()>1)
+		{
+#ifdef GL_TEXTURE_MAX_LEVEL
+			// The chain may stop before the 1x1 level.
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, data.levelSizes.size()-1);
+			completeChain = true;
+#endif
+			if (completeChain)
+				glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		}
+		return texId;
+	}
+	if (pixelUnpackBuffer)
+	{
+		// Reallocating the buffer for each texture lets the driver keep transferring the previous one.
+		pixelUnpackBuffer->bind();
+		pixelUnpackBuffer->allocate(data.data.constData(), data.data.size());
+		glTexImage2D(GL_TEXTURE_2D, 0, data.format, data.width, data.height, 0, data.format, data.type, NULL);
+		pixelUnpackBuffer->release();
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, data.format, data.width, data.height, 0, data.format,
+					 data.type, data.data.constData());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.wrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.wrapMode);
+	if (params.generateMipmaps)
 	{
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
-	// Report success of texture loading
-	emit(loadingProcessFinished(false));
-	return true;
+	StelApp::getInstance().getRenderStats()->add(StelRenderStats::TextureUploadBytes, data.data.size());
+	return texId;
 }
 
 // Actually load the texture to openGL memory
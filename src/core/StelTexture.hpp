@@ -25,16 +25,46 @@
 
 #include <QObject>
 #include <QImage>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QVector>
 
 class QFile;
 class StelTextureMgr;
 class QNetworkReply;
+class QOpenGLBuffer;
 template <class T> class QFuture;
 
 #ifndef GL_CLAMP_TO_EDGE
 #define GL_CLAMP_TO_EDGE 0x812F
 #endif
 
+// The compressed formats which can be read from KTX and DDS files
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9276
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
 //! @class StelTexture
 //! Base texture class. For creating an instance, use StelTextureMgr::createTexture() and StelTextureMgr::createTextureThread()
 //! @sa StelTextureSP
@@ -49,13 +79,23 @@ public:
 		StelTextureParams(bool qgenerateMipmaps=false, GLint afiltering=GL_LINEAR, GLint awrapMode=GL_CLAMP_TO_EDGE) :
 				generateMipmaps(qgenerateMipmaps),
 				filtering(afiltering),
-				wrapMode(awrapMode) {;}
+				wrapMode(awrapMode),
+				evictable(false),
+				maxSize(0) {;}
 		//! Define if mipmaps must be created.
 		bool generateMipmaps;
 		//! Define the scaling filter to use. Must be one of GL_NEAREST or GL_LINEAR
 		GLint filtering;
 		//! Define the wrapping mode to use. Must be one of GL_CLAMP_TO_EDGE, or GL_REPEAT.
 		GLint wrapMode;
+		//! Define whether the texture counts in the texture memory budget of the StelTextureMgr,
+		//! which can then release it when it was not used recently. The texture is loaded again
+		//! from its file the next time bind() is called. Only for the textures created in a thread.
+		bool evictable;
+		//! Define the largest width or height of the texture, 0 for no limit other than the maximum
+		//! texture size of the GPU. Larger images are decoded at a reduced size, which for the JPEG
+		//! images is done by the decoder itself and is faster than decoding the whole image.
+		int maxSize;
 	};
 
 	//! Destructor
@@ -67,6 +107,9 @@ public:
 	
 	bool bind(int slot=0);
 
+	//! Return the estimated GPU memory used by the texture in bytes, 0 if not loaded.
+	int getGpuMemory() const {return id!=0 ? gpuMemory : 0;}
+
 	//! Return whether the texture can be binded, i.e. it is fully loaded
 	bool canBind() const {return id!=0;}
 
@@ -82,7 +125,14 @@ public:
 	const QString& getFullPath() const {return fullPath;}
 
 	//! Return whether the image is currently being loaded
-	bool isLoading() const {return (loader || networkReply) && !canBind();}
+	bool isLoading() const {return (loader || networkReply || threadedUpload) && !canBind();}
+
+	//! Set the priority of the upload of the texture to the GPU, usually the area in pixels it covers on screen.
+	//! When the uploads are limited per frame, the waiting textures with the highest priority are uploaded first.
+	//! When the texture memory budget is exceeded, the evictable textures last used in the same frame are
+	//! released by increasing priority.
+	void setUploadPriority(float priority) {uploadPriority = priority;}
+	float getUploadPriority() const {return uploadPriority;}
 
 signals:
 	//! Emitted when the texture is ready to be bind(), i.e. when downloaded, imageLoading and	glLoading is over
@@ -96,22 +146,42 @@ private slots:
 
 private:
 	friend class StelTextureMgr;
+	friend class StelTextureUploadThread;
 
 	//! structure returned by the loader threads, containing all the
 	//! data and information to create the OpenGL texture.
 	struct GLData
 	{
-		GLData() : data(NULL), width(0), height(0), format(0), type(0) {}
+		GLData() : data(NULL), width(0), height(0), format(0), type(0), compressedFormat(0) {}
 		QByteArray data;
 		int width;
 		int height;
 		GLint format;
 		GLint type;
+		//! The GL internal format of compressed data, or 0 if the data is not compressed.
+		GLint compressedFormat;
+		//! For compressed data, the size in bytes of each mipmap level, stored one after the other in data.
+		QVector<int> levelSizes;
 	};
 	//! Those static methods can be called by QtConcurrent::run
 	static GLData imageToGLData(const QImage &image);
-	static GLData loadFromPath(const QString &path);
-	static GLData loadFromData(const QByteArray& data);
+	//! @param maxSize the largest width or height the image is decoded at, see StelTextureParams::maxSize.
+	static GLData loadFromPath(const QString &path, int maxSize=0);
+	static GLData loadFromData(const QByteArray& data, int maxSize=0);
+
+	//! Decode an image, at a reduced size if it is larger than maxSize or than the maximum texture size.
+	static QImage readImage(QIODevice* device, int maxSize);
+	//! The maximum texture size of the GPU, 0 if unknown. Set by StelTextureMgr::init().
+	static int maxTextureSize;
+
+	//! Return whether the data starts like a KTX or DDS file.
+	static bool isCompressedData(const QByteArray& data);
+	//! Read a KTX or DDS file containing a 2D texture compressed in one of the BC1, BC2, BC3,
+	//! BC7 or ETC2 formats, with all its mipmap levels. The rows of blocks have to be stored
+	//! from the bottom to the top of the image as usual in OpenGL, like util/texture2dds.py does.
+	//! @param headerOnly if true, only the size and format are read.
+	//! @return an empty GLData if the file could not be read.
+	static GLData loadCompressed(const QByteArray& fileData, bool headerOnly=false);
 
 	//! Private constructor
 	StelTexture();
@@ -129,6 +199,20 @@ private:
 	bool glLoad(const QImage& image);
 	//! Same as glLoad(QImage), but with an image already in OpenGl format
 	bool glLoad(const GLData& data);
+	//! Create an OpenGL texture from the data in the current context.
+	//! @param pixelUnpackBuffer if not NULL, the buffer used to transfer the data.
+	//! @return the id of the texture.
+	static GLuint createGLTexture(const GLData& data, const StelTextureParams& params, QOpenGLBuffer* pixelUnpackBuffer=NULL);
+
+	//! Estimate the GPU memory needed by a texture created from the data.
+	static int estimateGpuMemory(const GLData& data, const StelTextureParams& params);
+	//! Count the GPU memory of the texture in the StelMemoryStats when it is created (sign=1) or deleted (sign=-1).
+	void accountGpuMemory(int sign) const;
+
+	//! Upload the data decoded by the loader thread and delete the loader.
+	void finishLoading();
+	//! Get the size in bytes of the data decoded by the loader thread.
+	int getLoadedDataSize() const;
 
 	StelTextureParams loadParams;
 
@@ -138,6 +222,32 @@ private:
 	//! The loader object
 	QFuture<GLData>* loader;
 
+	//! Whether the texture is waiting for its upload in the StelTextureMgr queue.
+	bool uploadQueued;
+	float uploadPriority;
+
+	//! The StelTextureMgr frame in which the texture was last bound, for the evictable textures.
+	int lastUsedFrame;
+	//! The estimated GPU memory used once loaded, in bytes.
+	int gpuMemory;
+
+	//! The state of an upload done by the texture upload thread, shared with that thread.
+	struct ThreadedUpload
+	{
+		enum State
+		{
+			Pending = 0,	//!< The upload is not done yet
+			Done = 1,	//!< The id and fence are set, the fence is signaled when the texture can be used
+			Cancelled = 2	//!< The texture was deleted before the end of the upload
+		};
+		ThreadedUpload() : state(Pending), id(0), fence(NULL) {}
+		QAtomicInt state;
+		GLuint id;
+		//! The GLsync object to wait for, NULL if the upload thread already waited for the upload.
+		void* fence;
+	};
+	QSharedPointer<ThreadedUpload> threadedUpload;
+
 
 	//! The URL where to download the file
 	QString fullPath;
@@ -26,15 +26,334 @@
 #include <QFileInfo>
 #include <QFile>
 #include <QDebug>
+#include <QDir>
+#include <QPainter>
+#include <QPair>
+#include <QPoint>
 #include <QNetworkRequest>
 #include <QThread>
 #include <QSettings>
 #include <cstdlib>
+#include <algorithm>
 #include <QOpenGLContext>
+#include <QOpenGLBuffer>
+#include <QOffscreenSurface>
+#include <QMutex>
+#include <QWaitCondition>
 
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+//! The functions of GL_ARB_sync (core in OpenGL 3.2) resolved for one context. The GLsync handles are
+//! manipulated as void pointers so that this also compiles with the OpenGL ES 2 headers.
+struct StelGLSyncFunctions
+{
+	typedef void* (QOPENGLF_APIENTRYP FenceSyncFunc)(GLenum condition, GLbitfield flags);
+	typedef GLenum (QOPENGLF_APIENTRYP ClientWaitSyncFunc)(void* sync, GLbitfield flags, quint64 timeout);
+	typedef void (QOPENGLF_APIENTRYP DeleteSyncFunc)(void* sync);
+
+	StelGLSyncFunctions() : fenceSync(NULL), clientWaitSync(NULL), deleteSync(NULL) {;}
+
+	//! Resolve the functions for the given context.
+	//! @return false if fences are not supported.
+	bool resolve(QOpenGLContext* context)
+	{
+		const QSurfaceFormat format = context->format();
+		const bool supported = (format.renderableType()!=QSurfaceFormat::OpenGLES && (format.majorVersion()>3 || (format.majorVersion()==3 && format.minorVersion()>=2)))
+				|| context->hasExtension("GL_ARB_sync");
+		if (!supported)
+			return false;
+		fenceSync = (FenceSyncFunc)context->getProcAddress("glFenceSync");
+		clientWaitSync = (ClientWaitSyncFunc)context->getProcAddress("glClientWaitSync");
+		deleteSync = (DeleteSyncFunc)context->getProcAddress("glDeleteSync");
+		return fenceSync && clientWaitSync && deleteSync;
+	}
+
+	FenceSyncFunc fenceSync;
+	ClientWaitSyncFunc clientWaitSync;
+	DeleteSyncFunc deleteSync;
+};
+
+//! @class StelTextureUploadThread
+//! Thread creating the OpenGL textures from the data loaded by the StelTexture loaders, in a context
+//! shared with the main one. After each texture, a fence is inserted so that the main thread knows
+//! when the texture can be used, or glFinish() is called when fences are not supported.
+class StelTextureUploadThread : public QThread
+{
+public:
+	struct Job
+	{
+		StelTexture::GLData data;
+		StelTexture::StelTextureParams params;
+		QSharedPointer<StelTexture::ThreadedUpload> upload;
+	};
+
+	//! Create the context and surface, must be called from the main thread.
+	StelTextureUploadThread(QOpenGLContext* mainContext) : context(NULL), surface(NULL), stopRequested(false)
+	{
+		surface = new QOffscreenSurface();
+		surface->setFormat(mainContext->format());
+		surface->create();
+		context = new QOpenGLContext();
+		context->setFormat(mainContext->format());
+		context->setShareContext(mainContext);
+		if (!surface->isValid() || !context->create() || !context->shareContext())
+		{
+			delete context;
+			context = NULL;
+			return;
+		}
+		context->moveToThread(this);
+	}
+
+	~StelTextureUploadThread()
+	{
+		mutex.lock();
+		stopRequested = true;
+		condition.wakeAll();
+		mutex.unlock();
+		wait();
+		delete context;
+		delete surface;
+	}
+
+	//! Return whether the shared context could be created.
+	bool isValid() const {return context!=NULL;}
+
+	void addJob(const Job& job)
+	{
+		QMutexLocker lock(&mutex);
+		jobs.append(job);
+		condition.wakeOne();
+	}
+
+protected:
+	void run()
+	{
+		if (!context->makeCurrent(surface))
+		{
+			qWarning() << "Cannot use the texture upload context, the textures created in the thread will not be available";
+			return;
+		}
+		StelGLSyncFunctions sync;
+		const bool useFences = sync.resolve(context);
+		forever
+		{
+			mutex.lock();
+			while (jobs.isEmpty() && !stopRequested)
+				condition.wait(&mutex);
+			if (stopRequested)
+			{
+				mutex.unlock();
+				break;
+			}
+			Job job = jobs.takeFirst();
+			mutex.unlock();
+
+			if (job.upload->state.loadAcquire()==StelTexture::ThreadedUpload::Cancelled)
+				continue;
+			const GLuint id = StelTexture::createGLTexture(job.data, job.params);
+			void* fence = NULL;
+			if (useFences)
+			{
+				fence = sync.fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				glFlush();
+			}
+			else
+			{
+				glFinish();
+			}
+			job.upload->id = id;
+			job.upload->fence = fence;
+			if (!job.upload->state.testAndSetOrdered(StelTexture::ThreadedUpload::Pending, StelTexture::ThreadedUpload::Done))
+			{
+				// The texture was deleted in the meantime
+				glDeleteTextures(1, &id);
+				if (fence)
+					sync.deleteSync(fence);
+			}
+		}
+		context->doneCurrent();
+	}
+
+private:
+	QOpenGLContext* context;
+	QOffscreenSurface* surface;
+	QMutex mutex;
+	QWaitCondition condition;
+	QList<Job> jobs;
+	bool stopRequested;
+};
+
+// The fence functions of the main context
+static StelGLSyncFunctions mainSyncFunctions;
+
+StelTextureMgr::StelTextureMgr() : uploadBudget(0), pixelUnpackBuffer(NULL), uploadThread(NULL), textureMemoryBudget(0), textureMemoryUsed(0), frameCounter(0),
+	spriteAtlasDirty(false)
+{
+}
+
+StelTextureMgr::~StelTextureMgr()
+{
+	delete uploadThread;
+	uploadThread = NULL;
+	foreach (StelTexture* tex, pendingUploads)
+		tex->uploadQueued = false;
+	pendingUploads.clear();
+	delete pixelUnpackBuffer;
+	pixelUnpackBuffer = NULL;
+}
 
 void StelTextureMgr::init()
 {
+	QSettings* conf = StelApp::getInstance().getSettings();
+	Q_ASSERT(conf);
+	uploadBudget = conf->value("video/texture_upload_budget", 4).toInt() * 1024 * 1024;
+	textureMemoryBudget = conf->value("video/texture_memory_budget", 1024).toLongLong() * 1024 * 1024;
+
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	if (context)
+	{
+		const QSurfaceFormat format = context->format();
+		const bool desktopGL = format.renderableType()!=QSurfaceFormat::OpenGLES;
+		const int version = format.majorVersion()*10 + format.minorVersion();
+		GLint maxTextureSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+		StelTexture::maxTextureSize = maxTextureSize;
+		if (context->hasExtension("GL_EXT_texture_compression_s3tc"))
+		{
+			compressedFormats << GL_COMPRESSED_RGB_S3TC_DXT1_EXT << GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+					  << GL_COMPRESSED_RGBA_S3TC_DXT3_EXT << GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		}
+		if ((desktopGL && version>=42) || context->hasExtension("GL_ARB_texture_compression_bptc") || context->hasExtension("GL_EXT_texture_compression_bptc"))
+			compressedFormats << GL_COMPRESSED_RGBA_BPTC_UNORM;
+		if ((desktopGL && version>=43) || (!desktopGL && version>=30) || context->hasExtension("GL_ARB_ES3_compatibility"))
+		{
+			compressedFormats << GL_COMPRESSED_RGB8_ETC2 << GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+					  << GL_COMPRESSED_RGBA8_ETC2_EAC;
+		}
+	}
+	if (context && conf->value("video/flag_texture_upload_thread", true).toBool())
+	{
+		mainSyncFunctions.resolve(context);
+		uploadThread = new StelTextureUploadThread(context);
+		if (uploadThread->isValid())
+		{
+			uploadThread->start(QThread::LowPriority);
+		}
+		else
+		{
+			qWarning() << "Cannot create a shared OpenGL context, the textures will be uploaded in the main thread";
+			delete uploadThread;
+			uploadThread = NULL;
+		}
+	}
+
+#ifndef QT_OPENGL_ES_2
+	// Upload the textures from a pixel buffer object when supported, so that the copy to the GPU
+	// is done asynchronously by the driver instead of blocking the main thread.
+	if (context && (context->format().majorVersion()>=3 || context->hasExtension("GL_ARB_pixel_buffer_object")))
+	{
+		pixelUnpackBuffer = new QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+		pixelUnpackBuffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+		if (!pixelUnpackBuffer->create())
+		{
+			delete pixelUnpackBuffer;
+			pixelUnpackBuffer = NULL;
+		}
+	}
+#endif
+}
+
+static bool uploadPriorityGreater(const StelTexture* t1, const StelTexture* t2)
+{
+	return t1->getUploadPriority() > t2->getUploadPriority();
+}
+
+void StelTextureMgr::update()
+{
+	++frameCounter;
+	if (textureMemoryBudget>0 && textureMemoryUsed>textureMemoryBudget)
+		evictTextures();
+
+	if (pendingUploads.isEmpty())
+		return;
+	std::stable_sort(pendingUploads.begin(), pendingUploads.end(), uploadPriorityGreater);
+	int uploadedBytes = 0;
+	while (!pendingUploads.isEmpty())
+	{
+		StelTexture* tex = pendingUploads.first();
+		const int size = tex->getLoadedDataSize();
+		if (uploadBudget>0 && uploadedBytes>0 && uploadedBytes+size>uploadBudget)
+			break;
+		pendingUploads.removeFirst();
+		tex->uploadQueued = false;
+		tex->finishLoading();
+		uploadedBytes += size;
+	}
+}
+
+void StelTextureMgr::queueUpload(StelTexture* tex)
+{
+	Q_ASSERT(!tex->uploadQueued);
+	tex->uploadQueued = true;
+	pendingUploads.append(tex);
+}
+
+void StelTextureMgr::cancelUpload(StelTexture* tex)
+{
+	pendingUploads.removeOne(tex);
+	tex->uploadQueued = false;
+}
+
+void StelTextureMgr::addEvictableTexture(StelTexture* tex)
+{
+	Q_ASSERT(tex->loadParams.evictable && tex->id!=0);
+	tex->lastUsedFrame = frameCounter;
+	if (!evictableTextures.contains(tex))
+	{
+		evictableTextures.insert(tex);
+		textureMemoryUsed += tex->gpuMemory;
+	}
+}
+
+void StelTextureMgr::removeEvictableTexture(StelTexture* tex)
+{
+	if (evictableTextures.remove(tex))
+		textureMemoryUsed -= tex->gpuMemory;
+}
+
+// The least recently used textures come first, and among the ones used in the same frame the smallest on screen.
+bool StelTextureMgr::evictionOrderLess(const StelTexture* t1, const StelTexture* t2)
+{
+	if (t1->lastUsedFrame!=t2->lastUsedFrame)
+		return t1->lastUsedFrame < t2->lastUsedFrame;
+	return t1->getUploadPriority() < t2->getUploadPriority();
+}
+
+void StelTextureMgr::evictTextures()
+{
+	QList<StelTexture*> candidates = evictableTextures.toList();
+	std::sort(candidates.begin(), candidates.end(), evictionOrderLess);
+	foreach (StelTexture* tex, candidates)
+	{
+		if (textureMemoryUsed<=textureMemoryBudget)
+			break;
+		// Never release the textures drawn in the last frame, they would be reloaded immediately.
+		if (tex->lastUsedFrame >= frameCounter-1)
+			break;
+		removeEvictableTexture(tex);
+		glDeleteTextures(1, &tex->id);
+		tex->accountGpuMemory(-1);
+		tex->id = 0;
+	}
 }
 
 StelTextureSP StelTextureMgr::createTexture(const QString& afilename, const StelTexture::StelTextureParams& params)
@@ -45,10 +364,26 @@ StelTextureSP StelTextureMgr::createTexture(const QString& afilename, const Stel
 	StelTextureSP tex = StelTextureSP(new StelTexture());
 	tex->fullPath = afilename;
 
-	QImage image(tex->fullPath);
+	const StelTexture::GLData data = StelTexture::loadFromPath(tex->fullPath, params.maxSize);
+	if (data.data.isEmpty())
+		return StelTextureSP();
+
+	tex->loadParams = params;
+	if (tex->glLoad(data))
+		return tex;
+	else
+		return StelTextureSP();
+}
+
+StelTextureSP StelTextureMgr::createTextureFromImage(const QImage& image, const QString& name, const StelTexture::StelTextureParams& params)
+{
+	// An evictable texture couldn't be loaded again from its file
+	Q_ASSERT(!params.evictable);
 	if (image.isNull())
 		return StelTextureSP();
 
+	StelTextureSP tex = StelTextureSP(new StelTexture());
+	tex->fullPath = name;
 	tex->loadParams = params;
 	if (tex->glLoad(image))
 		return tex;
@@ -56,6 +391,103 @@ StelTextureSP StelTextureMgr::createTexture(const QString& afilename, const Stel
 		return StelTextureSP();
 }
 
+// The largest sprites and atlas accepted, in pixels
+static const int MaxSpriteSize = 512;
+static const int MaxSpriteAtlasSize = 4096;
+// The transparent border around each sprite, so that the linear filtering doesn't read the neighbour sprites
+static const int SpritePadding = 2;
+
+int StelTextureMgr::addSprite(const QString& filename)
+{
+	if (spriteIds.contains(filename))
+		return spriteIds.value(filename);
+	QImage image(filename);
+	if (image.isNull() || image.width()>MaxSpriteSize || image.height()>MaxSpriteSize)
+	{
+		qWarning() << "WARNING: Can't add the sprite" << QDir::toNativeSeparators(filename);
+		return -1;
+	}
+	spriteImages.append(image.convertToFormat(QImage::Format_ARGB32));
+	spriteIds.insert(filename, spriteImages.size()-1);
+	spriteAtlasDirty = true;
+	return spriteImages.size()-1;
+}
+
+StelTextureSP StelTextureMgr::getSpriteAtlas()
+{
+	if (spriteAtlasDirty)
+		buildSpriteAtlas();
+	return spriteAtlas;
+}
+
+static bool spriteHeightGreater(const QPair<int, int>& s1, const QPair<int, int>& s2)
+{
+	return s1.first>s2.first;
+}
+
+void StelTextureMgr::buildSpriteAtlas()
+{
+	spriteAtlasDirty = false;
+
+	// Pack the sprites in shelves by decreasing height, in the narrowest power of two width where they fit
+	QList<QPair<int, int> > order;
+	for (int i=0;i<spriteImages.size();++i)
+		order.append(qMakePair(spriteImages.at(i).height()+2*SpritePadding, i));
+	std::stable_sort(order.begin(), order.end(), spriteHeightGreater);
+	QVector<QPoint> positions(spriteImages.size());
+	int width = 256;
+	int height;
+	for (;;)
+	{
+		int x = 0, y = 0, shelfHeight = 0;
+		for (int i=0;i<order.size();++i)
+		{
+			const QImage& image = spriteImages.at(order.at(i).second);
+			const int w = image.width()+2*SpritePadding;
+			if (x+w>width)
+			{
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			positions[order.at(i).second] = QPoint(x+SpritePadding, y+SpritePadding);
+			x += w;
+			shelfHeight = qMax(shelfHeight, order.at(i).first);
+		}
+		height = y+shelfHeight;
+		if (height<=width || width>=MaxSpriteAtlasSize)
+			break;
+		width *= 2;
+	}
+	height = qMin(MaxSpriteAtlasSize, qMax(1, height));
+	// Power of two sizes for the old drivers
+	int atlasHeight = 1;
+	while (atlasHeight<height)
+		atlasHeight *= 2;
+
+	QImage atlas(width, atlasHeight, QImage::Format_ARGB32);
+	atlas.fill(Qt::transparent);
+	QPainter painter(&atlas);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	spriteRects.resize(spriteImages.size());
+	for (int i=0;i<spriteImages.size();++i)
+	{
+		const QImage& image = spriteImages.at(i);
+		const QPoint& pos = positions.at(i);
+		painter.drawImage(pos, image);
+		// The textures are flipped vertically when loaded, so that t=0 is the bottom of the image
+		spriteRects[i].set((float)pos.x()/width, 1.f-(float)(pos.y()+image.height())/atlasHeight,
+				   (float)(pos.x()+image.width())/width, 1.f-(float)pos.y()/atlasHeight);
+	}
+	painter.end();
+
+	StelTextureSP tex = StelTextureSP(new StelTexture());
+	tex->fullPath = "sprite atlas";
+	if (tex->glLoad(atlas))
+		spriteAtlas = tex;
+	else
+		qWarning() << "WARNING: Can't create the sprite atlas texture";
+}
 
 StelTextureSP StelTextureMgr::createTextureThread(const QString& url, const StelTexture::StelTextureParams& params, bool lazyLoading)
 {
@@ -65,9 +497,51 @@ StelTextureSP StelTextureMgr::createTextureThread(const QString& url, const Stel
 	StelTextureSP tex = StelTextureSP(new StelTexture());
 	tex->loadParams = params;
 	tex->fullPath = url;
+	// A texture created in a worker thread is loaded and used in the main thread
+	if (tex->thread()!=thread())
+		tex->moveToThread(thread());
 	if (!lazyLoading)
 	{
+		Q_ASSERT(QThread::currentThread()==thread());
 		tex->bind();
 	}
 	return tex;
 }
+
+bool StelTextureMgr::uploadInThread(StelTexture* tex)
+{
+	Q_ASSERT(tex->loader && tex->loader->isFinished());
+	const StelTexture::GLData& data = tex->loader->result();
+	if (!uploadThread || data.data.isEmpty() || (data.compressedFormat!=0 && !isCompressedFormatSupported(data.compressedFormat)))
+		return false;
+	StelTextureUploadThread::Job job;
+	job.data = data;
+	job.params = tex->loadParams;
+	job.upload = QSharedPointer<StelTexture::ThreadedUpload>(new StelTexture::ThreadedUpload());
+	tex->width = job.data.width;
+	tex->height = job.data.height;
+	tex->gpuMemory = StelTexture::estimateGpuMemory(job.data, job.params);
+	tex->threadedUpload = job.upload;
+	delete tex->loader;
+	tex->loader = NULL;
+	uploadThread->addJob(job);
+	return true;
+}
+
+bool StelTextureMgr::isThreadedUploadComplete(StelTexture::ThreadedUpload* upload, bool release)
+{
+	if (upload->fence==NULL)
+		return true;
+	bool complete = release;
+	if (!complete && mainSyncFunctions.clientWaitSync)
+	{
+		const GLenum res = mainSyncFunctions.clientWaitSync(upload->fence, 0, 0);
+		complete = res==GL_ALREADY_SIGNALED || res==GL_CONDITION_SATISFIED;
+	}
+	if (complete && mainSyncFunctions.deleteSync)
+	{
+		mainSyncFunctions.deleteSync(upload->fence);
+		upload->fence = NULL;
+	}
+	return complete;
+}
@@ -21,38 +21,160 @@
 #define _STELTEXTUREMGR_HPP_
 
 #include "StelTexture.hpp"
+#include "VecMath.hpp"
 #include <QObject>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QVector>
 
 class QNetworkReply;
 class QThread;
+class QOpenGLBuffer;
+class StelTextureUploadThread;
 
 
 //! @class StelTextureMgr
 //! Manage textures loading.
 //! It provides method for loading images in a separate thread.
+//! The images decoded in the threads are uploaded to the GPU in the main thread. To avoid
+//! long frames when many of them are ready at the same time, the uploads can be limited to
+//! a number of bytes per frame, in which case the textures wait in a queue and the ones which
+//! cover the largest part of the screen are uploaded first.
+//! When the OpenGL driver supports it, the uploads are instead done by a dedicated thread owning
+//! an OpenGL context shared with the main one, and the main thread only waits for a fence before
+//! using the texture.
+//! The textures created with the evictable parameter are counted in a global memory budget, and
+//! the least recently used ones are released when it is exceeded.
+//! The small images of the hints and markers of the modules are packed in one sprite atlas texture, so that
+//! the sprites using different images can be drawn with the same texture, in one draw call.
 class StelTextureMgr : QObject
 {
 public:
+	StelTextureMgr();
+	~StelTextureMgr();
+
 	//! Initialize some variable from the openGL contex.
 	//! Must be called after the creation of the GLContext.
 	void init();
 
+	//! Upload the textures waiting in the queue by decreasing priority, until the budget of the frame is spent.
+	//! Must be called once per frame from the main thread, with the GL context current.
+	void update();
+
+	//! Set the maximum number of bytes uploaded to the GPU per frame for the textures loaded in a thread.
+	//! At least one texture is uploaded per frame when some are waiting. 0 means no limit.
+	void setUploadBudget(int bytes) {uploadBudget = bytes;}
+	int getUploadBudget() const {return uploadBudget;}
+
+	//! Return whether the graphics driver supports a compressed texture format.
+	//! @param format one of the GL_COMPRESSED_* formats which can be read from KTX and DDS files.
+	bool isCompressedFormatSupported(GLint format) const {return compressedFormats.contains(format);}
+
+	//! Set the maximum GPU memory in bytes used by the evictable textures, like the sky image tiles.
+	//! When it is exceeded, the textures which were not used for the longest time are released. 0 means no limit.
+	void setTextureMemoryBudget(qint64 bytes) {textureMemoryBudget = bytes;}
+	qint64 getTextureMemoryBudget() const {return textureMemoryBudget;}
+	//! Get the estimated GPU memory in bytes used by the evictable textures currently loaded.
+	qint64 getTextureMemoryUsed() const {return textureMemoryUsed;}
+	//! Get the number of evictable textures currently loaded.
+	int getNbEvictableTextures() const {return evictableTextures.size();}
+	//! Get the number of frames since the initialization, incremented by update().
+	int getFrameCounter() const {return frameCounter;}
+
+	//! Get the number of textures waiting to be uploaded.
+	int getNbPendingUploads() const {return pendingUploads.size();}
+
 	//! Load an image from a file and create a new texture from it
 	//! @param filename the texture file name, can be absolute path if starts with '/' otherwise
 	//!    the file will be looked in stellarium standard textures directories.
 	//! @param params the texture creation parameters.
 	StelTextureSP createTexture(const QString& filename, const StelTexture::StelTextureParams& params=StelTexture::StelTextureParams());
 
+	//! Create a new texture from an image already in memory, like an atlas built by a module.
+	//! Must be called from the main thread, with the GL context current.
+	//! @param image the image, whose first line is the top of the texture.
+	//! @param name the name of the texture, returned by StelTexture::getFullPath().
+	//! @param params the texture creation parameters, the texture can't be evictable.
+	StelTextureSP createTextureFromImage(const QImage& image, const QString& name, const StelTexture::StelTextureParams& params=StelTexture::StelTextureParams());
+
 	//! Load an image from a file and create a new texture from it in a new thread.
 	//! @param url the texture file name or URL, can be absolute path if starts with '/' otherwise
 	//!    the file will be looked in stellarium standard textures directories.
 	//! @param params the texture creation parameters.
 	//! @param lazyLoading define whether the texture should be actually loaded only when needed, i.e. when bind() is called the first time.
+	//! With lazyLoading, this method can be called from a worker thread, the texture is then loaded in the main thread.
 	StelTextureSP createTextureThread(const QString& url, const StelTexture::StelTextureParams& params=StelTexture::StelTextureParams(), bool lazyLoading=true);
 
+	//! Add an image to the sprite atlas. The atlas is built again the next time it is used.
+	//! @param filename the image file name, can be absolute path or a Qt resource.
+	//! @return the id of the sprite, the same one if the image was already added, or -1 if the image can't be read
+	//! or is too large for the atlas.
+	int addSprite(const QString& filename);
+	//! Get the texture of the sprite atlas, built from the sprites added so far.
+	StelTextureSP getSpriteAtlas();
+	//! Get the texture coordinates of a sprite in the atlas, as (left, bottom, right, top).
+	//! They are only valid for the texture returned by the last call to getSpriteAtlas().
+	//! @param sprite the id returned by addSprite(), the whole texture being returned for -1.
+	Vec4f getSpriteTexRect(int sprite) const {return sprite>=0 && sprite<spriteRects.size() ? spriteRects.at(sprite) : Vec4f(0.f, 0.f, 1.f, 1.f);}
+
 private:
 	friend class StelTexture;
 	friend class ImageLoader;
+
+	//! Pack the sprites in a new atlas texture.
+	void buildSpriteAtlas();
+
+	//! Add a texture whose image is loaded to the upload queue.
+	void queueUpload(StelTexture* tex);
+	//! Remove a texture from the upload queue.
+	void cancelUpload(StelTexture* tex);
+
+	//! Give the data loaded for a texture to the upload thread.
+	//! @return false if there is no upload thread, in which case the texture has to be uploaded in the main thread.
+	bool uploadInThread(StelTexture* tex);
+	//! Check whether the GPU finished a texture upload done by the upload thread, and release its fence when it did.
+	//! @param release release the fence even if the upload is not finished.
+	bool isThreadedUploadComplete(StelTexture::ThreadedUpload* upload, bool release=false);
+
+	//! Add a loaded texture to the ones counted in the texture memory budget.
+	void addEvictableTexture(StelTexture* tex);
+	//! Remove a texture from the ones counted in the texture memory budget.
+	void removeEvictableTexture(StelTexture* tex);
+	//! Release the least recently used textures until the texture memory budget is respected.
+	void evictTextures();
+	static bool evictionOrderLess(const StelTexture* t1, const StelTexture* t2);
+
+	//! Get the buffer used to upload the textures asynchronously, NULL if not supported.
+	QOpenGLBuffer* getPixelUnpackBuffer() const {return pixelUnpackBuffer;}
+
+	//! The textures waiting to be uploaded.
+	QList<StelTexture*> pendingUploads;
+	//! The maximum number of bytes uploaded per frame, 0 if not limited.
+	int uploadBudget;
+	QOpenGLBuffer* pixelUnpackBuffer;
+	//! The thread creating the textures in a shared context, NULL if not used.
+	StelTextureUploadThread* uploadThread;
+
+	//! The loaded textures counted in the texture memory budget.
+	QSet<StelTexture*> evictableTextures;
+	//! The maximum GPU memory of the evictable textures, 0 if not limited.
+	qint64 textureMemoryBudget;
+	qint64 textureMemoryUsed;
+	int frameCounter;
+
+	//! The compressed texture formats supported by the graphics driver.
+	QSet<GLint> compressedFormats;
+
+	//! The images of the sprites, indexed by their ids.
+	QList<QImage> spriteImages;
+	QMap<QString, int> spriteIds;
+	//! The texture coordinates of the sprites in the atlas.
+	QVector<Vec4f> spriteRects;
+	StelTextureSP spriteAtlas;
+	//! Whether sprites were added since the atlas was built.
+	bool spriteAtlasDirty;
 };
 
 
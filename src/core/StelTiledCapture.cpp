@@ -0,0 +1,234 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelTiledCapture.hpp"
+#include "StelCubemapRenderer.hpp"
+#include "StelMovementMgr.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+static const char* faceNames[6] = {"front", "right", "back", "left", "top", "bottom"};
+
+StelTiledCapture::StelTiledCapture()
+	: pending(false)
+	, mode(ModeView)
+	, tileSize(2048)
+	, currentView(-1)
+{
+}
+
+bool StelTiledCapture::modeFromString(const QString& name, Mode& aMode)
+{
+	if (name=="view")
+		aMode = ModeView;
+	else if (name=="equirectangular")
+		aMode = ModeEquirectangular;
+	else if (name=="cubemap")
+		aMode = ModeCubemap;
+	else
+		return false;
+	return true;
+}
+
+bool StelTiledCapture::request(const QString& aFilePath, Mode aMode, int width, int height, int aTileSize)
+{
+	// The panoramas have the proportions of their projection
+	if (aMode==ModeEquirectangular)
+		height = width/2;
+	else if (aMode==ModeCubemap)
+		height = width;
+	if (width<=0 || height<=0 || aTileSize<=0)
+	{
+		qWarning() << "ERROR: invalid size for the tiled capture:" << width << height << aTileSize;
+		return false;
+	}
+	const QFileInfo dirInfo(QFileInfo(aFilePath).absolutePath());
+	if (!dirInfo.isDir() || !dirInfo.isWritable())
+	{
+		qWarning() << "ERROR: the tiled capture can not be written in the directory" << QDir::toNativeSeparators(dirInfo.filePath());
+		return false;
+	}
+
+	filePath = aFilePath;
+	mode = aMode;
+	size = QSize(width, height);
+	tileSize = aTileSize;
+	pending = true;
+	qDebug() << "INFO: tiled capture of" << size << "in" << QDir::toNativeSeparators(filePath);
+	return true;
+}
+
+Mat4d StelTiledCapture::getHorizonModelView(const StelCore* core)
+{
+	const Vec3d up(0., 0., 1.);
+	Vec3d f(core->j2000ToAltAz(core->getMovementMgr()->getViewDirectionJ2000(), StelCore::RefractionOff));
+	f[2] = 0.;
+	// Looking at the zenith or the nadir, the panorama is centered on the north
+	if (f.length()<1e-6)
+		f.set(-1., 0., 0.);
+	f.normalize();
+	Vec3d s(f^up);
+	s.normalize();
+	const Vec3d u(s^f);
+	return Mat4d(s[0],u[0],-f[0],0.,
+		     s[1],u[1],-f[1],0.,
+		     s[2],u[2],-f[2],0.,
+		     0.,0.,0.,1.);
+}
+
+void StelTiledCapture::getView(int view, const StelCore* core, Mat4d& rotation, StelCore::ProjectionType& type, StelProjector::StelProjectorParams& params) const
+{
+	const StelProjector::StelProjectorParams current = core->getCurrentStelProjectorParams();
+	params = current;
+	rotation = Mat4d::identity();
+	type = core->getCurrentProjectionType();
+	if (mode==ModeView)
+	{
+		// The current view scaled to the size of the image
+		const float sx = (float)size.width()/current.viewportXywh[2];
+		const float sy = (float)size.height()/current.viewportXywh[3];
+		params.viewportXywh.set(0, 0, size.width(), size.height());
+		params.viewportCenter.set((current.viewportCenter[0]-current.viewportXywh[0])*sx, (current.viewportCenter[1]-current.viewportXywh[1])*sy);
+		params.viewportFovDiameter = current.viewportFovDiameter*qMin(sx, sy);
+	}
+	else
+	{
+		// The panoramas replace the current view by the horizontal one
+		const Mat4d horizon = getHorizonModelView(core);
+		const Mat4d toHorizon = horizon*core->getAltAzModelViewTransform(StelCore::RefractionOff)->getApproximateLinearTransfo().inverse();
+		if (mode==ModeEquirectangular)
+		{
+			type = StelCore::ProjectionCylinder;
+			params.viewportXywh.set(0, 0, size.width(), size.height());
+			params.viewportCenter.set(0.5f*size.width(), 0.5f*size.height());
+			params.viewportFovDiameter = size.height();
+			params.fov = 180.f;
+			params.flipHorz = false;
+			params.flipVert = false;
+			params.maskType = StelProjector::MaskNone;
+			rotation = toHorizon;
+		}
+		else
+		{
+			type = StelCore::ProjectionPerspective;
+			params = StelCubemapRenderer::getFaceParams(current, size.width());
+			Mat4d face = Mat4d::identity();
+			switch (view)
+			{
+				case 1: face = Mat4d::yrotation(M_PI_2); break;
+				case 2: face = Mat4d::yrotation(M_PI); break;
+				case 3: face = Mat4d::yrotation(-M_PI_2); break;
+				case 4: face = Mat4d::xrotation(-M_PI_2); break;
+				case 5: face = Mat4d::xrotation(M_PI_2); break;
+				default: break;
+			}
+			rotation = face*toHorizon;
+		}
+	}
+	// The image is drawn in its own pixels, whatever the density of the screen
+	params.devicePixelsPerPixel = 1.f;
+}
+
+QRect StelTiledCapture::getTileRect(int row, int column) const
+{
+	const int x = column*tileSize;
+	const int y = row*tileSize;
+	const int w = qMin(tileSize, size.width()-x);
+	const int h = qMin(tileSize, size.height()-y);
+	return QRect(x, size.height()-y-h, w, h);
+}
+
+QString StelTiledCapture::getFilePath(int view, int row, int column) const
+{
+	const QFileInfo info(filePath);
+	QString name = info.completeBaseName();
+	if (mode==ModeCubemap)
+		name += QString("_") + faceNames[view];
+	if (row>=0 && (getNbRows()>1 || getNbColumns()>1))
+		name += QString("_r%1_c%2").arg(row).arg(column);
+	return info.absolutePath() + "/" + name + "." + info.suffix();
+}
+
+bool StelTiledCapture::beginView(int view)
+{
+	currentView = view;
+	rowTiles.clear();
+	if (QFileInfo(filePath).suffix().toLower()!="ppm")
+		return true;
+
+	ppmFile.setFileName(getFilePath(view, -1, -1));
+	if (!ppmFile.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "ERROR: can't write the tiled capture" << QDir::toNativeSeparators(ppmFile.fileName());
+		return false;
+	}
+	ppmFile.write(QString("P6\n%1 %2\n255\n").arg(size.width()).arg(size.height()).toLatin1());
+	return true;
+}
+
+bool StelTiledCapture::writeTile(int row, int column, const QImage& tile)
+{
+	if (!ppmFile.isOpen())
+	{
+		const QString tilePath = getFilePath(currentView, row, column);
+		if (!tile.save(tilePath))
+		{
+			qWarning() << "ERROR: can't write the tile" << QDir::toNativeSeparators(tilePath);
+			return false;
+		}
+		return true;
+	}
+
+	// The rows of pixels span all the tiles of the row
+	rowTiles << tile.convertToFormat(QImage::Format_RGB888);
+	if (column<getNbColumns()-1)
+		return true;
+	QByteArray line;
+	line.reserve(size.width()*3);
+	for (int y=0; y<rowTiles.first().height(); ++y)
+	{
+		line.clear();
+		foreach (const QImage& t, rowTiles)
+			line.append(reinterpret_cast<const char*>(t.constScanLine(y)), t.width()*3);
+		if (ppmFile.write(line)!=line.size())
+		{
+			qWarning() << "ERROR: can't write the tiled capture" << QDir::toNativeSeparators(ppmFile.fileName());
+			rowTiles.clear();
+			return false;
+		}
+	}
+	rowTiles.clear();
+	return true;
+}
+
+void StelTiledCapture::endView()
+{
+	if (ppmFile.isOpen())
+		ppmFile.close();
+	rowTiles.clear();
+	currentView = -1;
+}
+
+void StelTiledCapture::finish()
+{
+	endView();
+	pending = false;
+}
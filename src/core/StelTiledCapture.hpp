@@ -0,0 +1,120 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELTILEDCAPTURE_HPP_
+#define _STELTILEDCAPTURE_HPP_
+
+#include "StelCore.hpp"
+#include "StelProjector.hpp"
+#include "VecMath.hpp"
+
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+//! @class StelTiledCapture
+//! Capture a still image of the sky larger than the window and than the GL limits, for print and for the
+//! dome masters. The image is drawn tile by tile in a framebuffer of the size of the tiles, each tile
+//! being a region of the projection of the whole image, see StelProjector::setRenderTile().
+//! Three kinds of images can be captured: the current view at a higher resolution, an equirectangular
+//! panorama of the whole sky, and the six faces of a cube map. The panoramas are centered on the azimuth
+//! of the current view with the zenith up.
+//! The tiles are written as they are drawn, so the whole image is never held in memory: a ".ppm" file is
+//! written one row of tiles at a time, with any other extension each tile is written in its own file
+//! named after the row and the column of the tile, to be assembled by an external tool.
+//! The capture is requested with request() and drawn by StelApp at the next frame.
+class StelTiledCapture
+{
+public:
+	enum Mode
+	{
+		ModeView,               //!< The current view and projection
+		ModeEquirectangular,    //!< The whole sky in the cylinder projection, twice as wide as high
+		ModeCubemap             //!< The six faces of a cube map in the perspective projection
+	};
+
+	StelTiledCapture();
+
+	//! Request a capture, drawn at the next frame.
+	//! @param filePath the path of the image, for the cube maps the name of each face is appended to it.
+	//! @param mode the kind of image.
+	//! @param width the width of the image in pixels, the size of the faces for the cube maps.
+	//! @param height the height of the image in pixels, only used for the current view.
+	//! @param tileSize the size of the tiles in pixels.
+	//! @return false if the parameters are invalid.
+	bool request(const QString& filePath, Mode mode, int width, int height, int tileSize);
+	//! Whether a capture has to be drawn at the next frame.
+	bool isPending() const {return pending;}
+	//! Get the mode of a name, "view", "equirectangular" or "cubemap".
+	//! @return false if the name is unknown.
+	static bool modeFromString(const QString& name, Mode& mode);
+
+	//! Get the number of images to draw, 6 for the cube maps, else 1.
+	int getNbViews() const {return mode==ModeCubemap ? 6 : 1;}
+	//! Get the view of an image.
+	//! @param view the index of the image.
+	//! @param core the core with the current view, from which the view of the image is derived.
+	//! @param rotation the rotation to pass to StelCore::beginView().
+	//! @param type the projection of the image.
+	//! @param params the projector parameters of the image.
+	void getView(int view, const StelCore* core, Mat4d& rotation, StelCore::ProjectionType& type, StelProjector::StelProjectorParams& params) const;
+	//! Get the size of the images in pixels.
+	QSize getSize() const {return size;}
+	//! Get the number of rows and columns of tiles of an image.
+	int getNbRows() const {return (size.height()+tileSize-1)/tileSize;}
+	int getNbColumns() const {return (size.width()+tileSize-1)/tileSize;}
+	int getTileSize() const {return tileSize;}
+	//! Get the rectangle of a tile in the window coordinates of the projector, so from the bottom of the image.
+	//! Row 0 is the top row of the image.
+	QRect getTileRect(int row, int column) const;
+
+	//! Open the files of an image.
+	//! @return false if they can't be written, in which case the capture is abandoned.
+	bool beginView(int view);
+	//! Write a tile of the current image. The tiles are given by rows from the top, and from left to right.
+	bool writeTile(int row, int column, const QImage& tile);
+	//! Close the files of the current image.
+	void endView();
+	//! Mark the capture as done.
+	void finish();
+
+private:
+	//! Get the path of a file of the image, from the name of the face and the tile.
+	QString getFilePath(int view, int row, int column) const;
+	//! Get the view of the panoramas, centered on the azimuth of the current view with the zenith up.
+	static Mat4d getHorizonModelView(const StelCore* core);
+
+	bool pending;
+	QString filePath;
+	Mode mode;
+	QSize size;
+	int tileSize;
+
+	//! The image being written.
+	int currentView;
+	//! The file of the image when it is written as a single PPM.
+	QFile ppmFile;
+	//! The tiles of the row being drawn, written at once in the PPM.
+	QList<QImage> rowTiles;
+};
+
+#endif // _STELTILEDCAPTURE_HPP_
@@ -23,7 +23,7 @@
 /*********************************************************************
  Constructor: Set some default values to prevent bugs in case of bad use
 *********************************************************************/
-StelToneReproducer::StelToneReproducer() : Lda(50.f), Lwa(40000.f), oneOverMaxdL(1.f/100.f), lnOneOverMaxdL(std::log(1.f/100.f)), oneOverGamma(1.f/2.2222f)
+StelToneReproducer::StelToneReproducer() : Lda(50.f), Lwa(40000.f), oneOverMaxdL(1.f/100.f), lnOneOverMaxdL(std::log(1.f/100.f)), oneOverGamma(1.f/2.2222f), alphaWaOverAlphaDa(1.f), lnTerm2(0.f)
 {
 	// Initialize  sensor
 	setInputScale();
@@ -52,6 +52,7 @@ void StelToneReproducer::setInputScale(float scale)
 {
 	inputScale=scale;
 	lnInputScale = std::log(inputScale);
+	updateLnAdaptOffset();
 }
 	
 /*********************************************************************
@@ -71,6 +72,7 @@ void StelToneReproducer::setDisplayAdaptationLuminance(float _Lda)
 	term2 = (float) (pow10((betaWa-betaDa)/alphaDa) / (M_PI*0.0001f));
 	lnTerm2 = std::log(term2);
 	term2TimesOneOverMaxdLpOneOverGamma = std::pow(term2*oneOverMaxdL, oneOverGamma);
+	updateLnAdaptOffset();
 }
 
 /*********************************************************************
@@ -90,6 +92,7 @@ void StelToneReproducer::setWorldAdaptationLuminance(float _Lwa)
 	term2 = (float) (pow10((betaWa-betaDa)/alphaDa) / (M_PI*0.0001f));
 	lnTerm2 = std::log(term2);
 	term2TimesOneOverMaxdLpOneOverGamma = std::pow(term2*oneOverMaxdL, oneOverGamma);
+	updateLnAdaptOffset();
 }
 
 
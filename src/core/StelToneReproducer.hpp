@@ -93,6 +93,7 @@ public:
 	void setMaxDisplayLuminance(float maxdL)
 	{
 		oneOverMaxdL = 1.f/maxdL; lnOneOverMaxdL=std::log(oneOverMaxdL); term2TimesOneOverMaxdLpOneOverGamma = std::pow(term2*oneOverMaxdL, oneOverGamma);
+		updateLnAdaptOffset();
 	}
 
 	//! Get the display gamma
@@ -147,8 +148,16 @@ public:
 	//! @return the converted display set at the pFact power. Luminance with 1 corresponding to full display white. The value can be more than 1 when saturation..
 	float adaptLuminanceScaledLn(float lnWorldLuminance, float pFact=0.5f) const
 	{
-		const float lnPix0p0001 = -8.0656104861f;
-		return std::exp(((lnInputScale+lnWorldLuminance+lnPix0p0001)*alphaWaOverAlphaDa+lnTerm2+lnOneOverMaxdL)*pFact);
+		return std::exp((lnWorldLuminance*alphaWaOverAlphaDa+lnAdaptOffset)*pFact);
+	}
+
+	//! Get the exponent applied to the world luminance by the adaptation, i.e. the factor by which
+	//! ln(adaptLuminanceScaled()) grows when the ln of the world luminance grows by 1.
+	//! It allows to compute the adapted luminance of a geometric series of luminances with
+	//! multiplications only, as done for the magnitude steps of the star catalogs.
+	float getLuminanceExponent() const
+	{
+		return alphaWaOverAlphaDa;
 	}
 	
 	//! Convert from xyY color system to RGB.
@@ -163,6 +172,13 @@ public:
 		c=term2TimesOneOverMaxdLpOneOverGamma;
 	}
 private:
+	//! Update lnAdaptOffset after one of the terms it depends on changed.
+	void updateLnAdaptOffset()
+	{
+		const float lnPix0p0001 = -8.0656104861f;
+		lnAdaptOffset = (lnInputScale+lnPix0p0001)*alphaWaOverAlphaDa+lnTerm2+lnOneOverMaxdL;
+	}
+
 	// The global luminance scaling
 	float inputScale;
 	float lnInputScale;		// std::log(inputScale)
@@ -183,6 +199,7 @@ private:
 	float lnTerm2;	// log(term2)
 	
 	float term2TimesOneOverMaxdLpOneOverGamma;
+	float lnAdaptOffset;	// ln(adaptLuminanceScaled(1))
 };
 
 #endif // _STELTONEREPRODUCER_HPP_
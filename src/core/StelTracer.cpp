@@ -0,0 +1,162 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelTracer.hpp"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+QAtomicInt StelTracer::enabled(0);
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char* name;
+		QString detail;
+		qint64 start;
+		qint64 end;
+		int thread;
+	};
+
+	QMutex traceMutex;
+	QElapsedTimer traceClock;
+	//! Ring buffer of the events, allocated when the tracer is enabled.
+	QVector<TraceEvent> traceEvents;
+	int traceNext = 0;
+	int traceCount = 0;
+	//! Index of each thread which recorded events, and their names.
+	QHash<QThread*, int> traceThreads;
+	QStringList traceThreadNames;
+
+	QString escapeJson(const QString& s)
+	{
+		QString res = s;
+		res.replace('\\', "\\\\");
+		res.replace('"', "\\\"");
+		return res;
+	}
+}
+
+void StelTracer::setEnabled(bool b)
+{
+	QMutexLocker lock(&traceMutex);
+	if (b && !isEnabled())
+	{
+		traceEvents.resize(MaxEvents);
+		traceNext = 0;
+		traceCount = 0;
+		traceThreads.clear();
+		traceThreadNames.clear();
+		traceClock.start();
+	}
+	enabled.store(b ? 1 : 0);
+}
+
+qint64 StelTracer::now()
+{
+	return traceClock.nsecsElapsed();
+}
+
+void StelTracer::addEvent(const char* name, const QString& detail, qint64 start, qint64 end)
+{
+	QThread* thread = QThread::currentThread();
+	QMutexLocker lock(&traceMutex);
+	// Disabled since the scope was entered
+	if (!isEnabled())
+		return;
+	QHash<QThread*, int>::ConstIterator iter = traceThreads.constFind(thread);
+	int threadIndex;
+	if (iter==traceThreads.constEnd())
+	{
+		threadIndex = traceThreadNames.size();
+		traceThreads.insert(thread, threadIndex);
+		QString threadName = thread->objectName();
+		if (QCoreApplication::instance() && thread==QCoreApplication::instance()->thread())
+			threadName = "Main thread";
+		else if (threadName.isEmpty())
+			threadName = QString("Worker %1").arg(threadIndex);
+		traceThreadNames << threadName;
+	}
+	else
+		threadIndex = iter.value();
+
+	TraceEvent& event = traceEvents[traceNext];
+	event.name = name;
+	event.detail = detail;
+	event.start = start;
+	event.end = end;
+	event.thread = threadIndex;
+	traceNext = (traceNext+1)%MaxEvents;
+	traceCount = qMin(traceCount+1, (int)MaxEvents);
+}
+
+bool StelTracer::writeChromeTrace(const QString& fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	{
+		qWarning() << "Cannot write the trace to" << QDir::toNativeSeparators(fileName);
+		return false;
+	}
+
+	QMutexLocker lock(&traceMutex);
+	QTextStream out(&file);
+	out.setCodec("UTF-8");
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const char* separator = "\n";
+	for (int i=0; i<traceThreadNames.size(); ++i)
+	{
+		out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+		    << ",\"args\":{\"name\":\"" << escapeJson(traceThreadNames.at(i)) << "\"}}";
+		separator = ",\n";
+	}
+	// The times are in microseconds, the events are written from the oldest one
+	out.setRealNumberNotation(QTextStream::FixedNotation);
+	out.setRealNumberPrecision(3);
+	const int first = (traceNext-traceCount+MaxEvents)%MaxEvents;
+	for (int i=0; i<traceCount; ++i)
+	{
+		const TraceEvent& event = traceEvents.at((first+i)%MaxEvents);
+		QString name(event.name);
+		if (!event.detail.isEmpty())
+			name += " " + event.detail;
+		out << separator << "{\"name\":\"" << escapeJson(name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+		    << ",\"ts\":" << event.start/1000. << ",\"dur\":" << (event.end-event.start)/1000. << "}";
+		separator = ",\n";
+	}
+	out << "\n]}\n";
+	out.flush();
+	file.close();
+	if (file.error()!=QFile::NoError)
+	{
+		qWarning() << "Cannot write the trace to" << QDir::toNativeSeparators(fileName) << ":" << file.errorString();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELTRACER_HPP_
+#define _STELTRACER_HPP_
+
+#include <QAtomicInt>
+#include <QString>
+
+//! @class StelTracer
+//! Record the time spent in scopes marked with the STEL_TRACE_SCOPE macros, in the main
+//! thread and in the worker threads, for the timeline of the frames.
+//! The events are kept in a ring buffer of the last MaxEvents events, which can be written
+//! in the Chrome trace event format, readable by chrome://tracing and by the Perfetto UI.
+//! When the tracer is disabled a marked scope costs one atomic read, and the markers are
+//! removed from the build when ENABLE_TRACING is not defined.
+class StelTracer
+{
+public:
+	//! The number of events kept, the oldest ones are dropped.
+	static const int MaxEvents = 1<<18;
+
+	//! Enable or disable the recording. The recorded events are cleared when enabling.
+	static void setEnabled(bool b);
+	static bool isEnabled() {return enabled.load()!=0;}
+
+	//! Get the time since the tracer was enabled in nanoseconds.
+	static qint64 now();
+	//! Record a scope of the current thread, thread safe.
+	//! @param name the name of the scope, a string literal.
+	//! @param detail appended to the name if not empty, e.g. the name of the module.
+	//! @param start, end the times returned by now() when entering and leaving the scope.
+	static void addEvent(const char* name, const QString& detail, qint64 start, qint64 end);
+
+	//! Write the recorded events to a file in the Chrome trace event JSON format.
+	//! @return false if the file could not be written.
+	static bool writeChromeTrace(const QString& fileName);
+
+private:
+	static QAtomicInt enabled;
+};
+
+//! @class StelTraceScope
+//! Record the time between its construction and its destruction with the StelTracer.
+//! Use it through the STEL_TRACE_SCOPE macros.
+class StelTraceScope
+{
+public:
+	StelTraceScope(const char* aname) : name(aname), start(StelTracer::isEnabled() ? StelTracer::now() : -1) {}
+	StelTraceScope(const char* aname, const QString& adetail) : name(aname), start(-1)
+	{
+		if (StelTracer::isEnabled())
+		{
+			detail = adetail;
+			start = StelTracer::now();
+		}
+	}
+	~StelTraceScope()
+	{
+		if (start>=0)
+			StelTracer::addEvent(name, detail, start, StelTracer::now());
+	}
+
+private:
+	const char* name;
+	QString detail;
+	qint64 start;
+};
+
+#ifdef ENABLE_TRACING
+ #define STEL_TRACE_CONCAT2(a, b) a##b
+ #define STEL_TRACE_CONCAT(a, b) STEL_TRACE_CONCAT2(a, b)
+ //! Record the time spent until the end of the current scope.
+ #define STEL_TRACE_SCOPE(name) StelTraceScope STEL_TRACE_CONCAT(stelTraceScope, __LINE__)(name)
+ //! Record the time spent until the end of the current scope, with a name completed at run time.
+ #define STEL_TRACE_SCOPE_DETAIL(name, detail) StelTraceScope STEL_TRACE_CONCAT(stelTraceScope, __LINE__)(name, detail)
+#else
+ #define STEL_TRACE_SCOPE(name)
+ #define STEL_TRACE_SCOPE_DETAIL(name, detail)
+#endif
+
+#endif // _STELTRACER_HPP_
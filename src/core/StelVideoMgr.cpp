@@ -17,24 +17,104 @@
  */
 
 #include "StelVideoMgr.hpp"
-#include "StelMainView.hpp"
+#include "StelApp.hpp"
+#include "StelCore.hpp"
+#include "StelModuleMgr.hpp"
+#include "StelPainter.hpp"
+#include "StelUtils.hpp"
 #include <QDebug>
 #include <QDir>
 
+#ifdef ENABLE_VIDEO
+
+#include <QAbstractVideoSurface>
+#include <QFileInfo>
+#include <QMediaPlayer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <QVideoFrame>
+#include <QVideoSurfaceFormat>
+
+#include <cstring>
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+// Number of subdivisions of each side of the videos drawn on the sky
+static const int SkyGridSize = 8;
+// Difference between the position of a video and the simulation time from which it is moved, in ms
+static const qint64 SyncToleranceMs = 200;
+
+//! Receive the frames decoded by the media player, possibly in another thread.
+class StelVideoSurface : public QAbstractVideoSurface
+{
+public:
+	StelVideoSurface(QObject* parent) : QAbstractVideoSurface(parent), hasNewFrame(false) {}
+
+	virtual QList<QVideoFrame::PixelFormat> supportedPixelFormats(QAbstractVideoBuffer::HandleType handleType) const
+	{
+		// The formats which can be uploaded as BGRA, or used directly when already in a texture
+		QList<QVideoFrame::PixelFormat> formats;
+		if (handleType==QAbstractVideoBuffer::NoHandle || handleType==QAbstractVideoBuffer::GLTextureHandle)
+			formats << QVideoFrame::Format_RGB32 << QVideoFrame::Format_ARGB32;
+		return formats;
+	}
+
+	virtual bool present(const QVideoFrame& frame)
+	{
+		QMutexLocker locker(&mutex);
+		lastFrame = frame;
+		hasNewFrame = true;
+		return true;
+	}
+
+	//! Get the last frame presented since the last call.
+	bool takeFrame(QVideoFrame& frame)
+	{
+		QMutexLocker locker(&mutex);
+		if (!hasNewFrame)
+			return false;
+		frame = lastFrame;
+		hasNewFrame = false;
+		return true;
+	}
+
+	//! The frame provided in a texture must be kept until it is not drawn anymore.
+	QVideoFrame textureFrame;
+
+private:
+	QMutex mutex;
+	QVideoFrame lastFrame;
+	bool hasNewFrame;
+};
 
 StelVideoMgr::StelVideoMgr()
 {
+	setObjectName("StelVideoMgr");
 }
 
-#if 0
 StelVideoMgr::~StelVideoMgr()
 {
-	foreach(QString id, videoObjects.keys())
+	foreach(const QString& id, videoObjects.keys())
 	{
 		dropVideo(id);
 	}
 }
 
+void StelVideoMgr::init()
+{
+}
+
+double StelVideoMgr::getCallOrder(StelModuleActionName actionName) const
+{
+	// Drawn over the landscape, just after the screen images
+	if (actionName==StelModule::ActionDraw)
+		return StelApp::getInstance().getModuleMgr().getModule("LandscapeMgr")->getCallOrder(actionName)+12;
+	return 0;
+}
+
 void StelVideoMgr::loadVideo(const QString& filename, const QString& id, float x, float y, bool show, float alpha)
 {
 	if (videoObjects.contains(id))
@@ -43,147 +123,348 @@ void StelVideoMgr::loadVideo(const QString& filename, const QString& id, float x
 		dropVideo(id);
 	}
 
-	videoObjects[id] = new VideoPlayer;
-	videoObjects[id]->widget = new QWidget();
-	videoObjects[id]->player = new Phonon::VideoPlayer(Phonon::VideoCategory, videoObjects[id]->widget);
-
-	videoObjects[id]->player->load(Phonon::MediaSource(filename));
-	videoObjects[id]->pWidget =
-		StelMainView::getInstance().scene()->addWidget(videoObjects[id]->widget, Qt::FramelessWindowHint);
-
-	videoObjects[id]->pWidget->setPos(x, y);
-	videoObjects[id]->pWidget->setOpacity(alpha);
-	videoObjects[id]->pWidget->setVisible(show);
-	videoObjects[id]->player->show();
-
+	VideoObject* video = new VideoObject;
+	video->player = new QMediaPlayer(NULL, QMediaPlayer::VideoSurface);
+	video->surface = new StelVideoSurface(video->player);
+	// With the context, the backends able to decode in GL textures give the frames without copy
+	video->surface->setProperty("GLContext", QVariant::fromValue<QObject*>(QOpenGLContext::currentContext()));
+	video->player->setVideoOutput(video->surface);
+	video->player->setMedia(QMediaContent(QUrl::fromLocalFile(QFileInfo(filename).absoluteFilePath())));
+	video->texture = 0;
+	video->frameTexture = 0;
+	video->flipped = false;
+	video->visible = show;
+	video->alpha = alpha;
+	video->x = x;
+	video->y = y;
+	video->width = 0.f;
+	video->height = 0.f;
+	video->onSky = false;
+	video->ra = video->dec = video->skyWidth = video->skyHeight = 0.;
+	video->syncToTime = false;
+	video->syncStartJd = 0.;
+	video->syncPlaying = false;
+	videoObjects[id] = video;
 }
 
 void StelVideoMgr::playVideo(const QString& id)
 {
-	if (videoObjects.contains(id))
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	if (video->syncToTime)
 	{
-		if (videoObjects[id]->player!=NULL)
-		{
-			// if already playing, stop and play from the start
-			if (videoObjects[id]->player->isPlaying() == true)
-			{
-				videoObjects[id]->player->stop();
-			}
-
-			// otherwise just play it
-			videoObjects[id]->player->play();
-		}
+		// Start from the current position at the current date
+		video->syncStartJd = StelApp::getInstance().getCore()->getJDay() - video->player->position()/86400000.;
+		video->syncPlaying = true;
+		return;
 	}
+	// if already playing, stop and play from the start
+	if (video->player->state()==QMediaPlayer::PlayingState)
+		video->player->stop();
+	video->player->play();
 }
 
 void StelVideoMgr::pauseVideo(const QString& id)
 {
-	if (videoObjects.contains(id))
-	{
-		if (videoObjects[id]->player!=NULL)
-		{
-			videoObjects[id]->player->pause();
-		}
-	}
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	video->syncPlaying = false;
+	video->player->pause();
 }
 
 void StelVideoMgr::stopVideo(const QString& id)
 {
-	if (videoObjects.contains(id))
-	{
-		if (videoObjects[id]->player!=NULL)
-		{
-			videoObjects[id]->player->stop();
-		}
-	}
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	video->syncPlaying = false;
+	video->player->stop();
 }
 
 void StelVideoMgr::seekVideo(const QString& id, qint64 ms)
 {
-	if (videoObjects.contains(id))
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	if (!video->player->isSeekable())
 	{
-		if (videoObjects[id]->player!=NULL) 
-		{
-			if (videoObjects[id]->player->mediaObject()->isSeekable())
-			{
-				videoObjects[id]->player->seek(ms);
-				// Seek capability depends on the backend used.
-			}
-			else
-			{
-				qDebug() << "[StelVideoMgr] Cannot seek media source.";
-			}
-		}
+		qDebug() << "[StelVideoMgr] Cannot seek media source.";
+		return;
 	}
+	video->player->setPosition(ms);
+	if (video->syncToTime)
+		video->syncStartJd = StelApp::getInstance().getCore()->getJDay() - ms/86400000.;
 }
 
 void StelVideoMgr::dropVideo(const QString& id)
 {
-	if (!videoObjects.contains(id))
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	video->player->stop();
+	video->surface->textureFrame = QVideoFrame();
+	if (video->texture!=0)
+		glDeleteTextures(1, &video->texture);
+	// The surface is deleted with the player
+	delete video->player;
+	delete video;
+	videoObjects.remove(id);
+}
+
+void StelVideoMgr::setVideoXY(const QString& id, float x, float y)
+{
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
 		return;
-	if (videoObjects[id]->player!=NULL)
+	video->x = x;
+	video->y = y;
+	video->onSky = false;
+}
+
+void StelVideoMgr::setVideoAlpha(const QString& id, float alpha)
+{
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video!=NULL)
+		video->alpha = alpha;
+}
+
+void StelVideoMgr::resizeVideo(const QString& id, float w, float h)
+{
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	video->width = w;
+	video->height = h;
+}
+
+void StelVideoMgr::showVideo(const QString& id, bool show)
+{
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video!=NULL)
+		video->visible = show;
+}
+
+void StelVideoMgr::setVideoSkyPosition(const QString& id, double ra, double dec, double width, double height)
+{
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL)
+		return;
+	video->ra = ra*M_PI/180.;
+	video->dec = dec*M_PI/180.;
+	video->skyWidth = qBound(0., width, 179.)*M_PI/180.;
+	video->skyHeight = qBound(0., height, 179.)*M_PI/180.;
+	video->onSky = true;
+}
+
+void StelVideoMgr::setVideoSyncToTime(const QString& id, bool sync)
+{
+	VideoObject* video = videoObjects.value(id, NULL);
+	if (video==NULL || video->syncToTime==sync)
+		return;
+	video->syncToTime = sync;
+	video->syncPlaying = sync && video->player->state()==QMediaPlayer::PlayingState;
+	video->syncStartJd = StelApp::getInstance().getCore()->getJDay() - video->player->position()/86400000.;
+	if (!sync)
+		video->player->setPlaybackRate(1.);
+}
+
+void StelVideoMgr::syncToTime(StelCore* core, VideoObject* video)
+{
+	const qint64 target = (qint64)((core->getJDay()-video->syncStartJd)*86400000.);
+	const qint64 duration = video->player->duration();
+	if (target<0 || (duration>0 && target>duration))
 	{
-		videoObjects[id]->player->stop();
-		delete videoObjects[id]->player;
-		delete videoObjects[id]->pWidget;
-		delete videoObjects[id];
+		// Outside of the video, its first or last frame is kept
+		if (video->player->state()==QMediaPlayer::PlayingState)
+			video->player->pause();
+		return;
+	}
 
-		videoObjects.remove(id); 
+	// The players can only play forward, in the other cases the frames are shown by seeking
+	const double rate = core->getTimeRate()/StelCore::JD_SECOND;
+	const bool play = rate>0. && video->syncPlaying;
+	if (play)
+	{
+		if (video->player->playbackRate()!=rate)
+			video->player->setPlaybackRate(rate);
+		if (video->player->state()!=QMediaPlayer::PlayingState)
+			video->player->play();
 	}
+	else if (video->player->state()==QMediaPlayer::PlayingState)
+		video->player->pause();
+
+	if (qAbs(video->player->position()-target)>SyncToleranceMs && video->player->isSeekable())
+		video->player->setPosition(target);
 }
 
-void StelVideoMgr::setVideoXY(const QString& id, float x, float y)
+void StelVideoMgr::update(double)
 {
-	if (videoObjects.contains(id))
+	StelCore* core = StelApp::getInstance().getCore();
+	foreach (VideoObject* video, videoObjects)
 	{
-		if (videoObjects[id]->pWidget!=NULL)
-		{
-			videoObjects[id]->pWidget->setPos(x, y);
-		}
+		if (video->syncToTime)
+			syncToTime(core, video);
 	}
-
 }
 
-void StelVideoMgr::setVideoAlpha(const QString& id, float alpha)
+void StelVideoMgr::uploadFrame(VideoObject* video)
 {
-	if (videoObjects.contains(id))
+	QVideoFrame frame;
+	if (!video->surface->takeFrame(frame) || !frame.isValid())
+		return;
+	video->flipped = video->surface->surfaceFormat().scanLineDirection()==QVideoSurfaceFormat::BottomToTop;
+
+	if (frame.handleType()==QAbstractVideoBuffer::GLTextureHandle)
 	{
-		if (videoObjects[id]->pWidget!=NULL)
-		{
-			videoObjects[id]->pWidget->setOpacity(alpha);
-		}
+		// Decoded by the backend in a texture of the context, nothing to copy
+		video->surface->textureFrame = frame;
+		video->frameTexture = frame.handle().toUInt();
+		return;
+	}
+	video->surface->textureFrame = QVideoFrame();
+
+	if (!frame.map(QAbstractVideoBuffer::ReadOnly))
+		return;
+	if (video->texture==0)
+	{
+		glGenTextures(1, &video->texture);
+		glBindTexture(GL_TEXTURE_2D, video->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	else
+		glBindTexture(GL_TEXTURE_2D, video->texture);
+
+	// The RGB32 and ARGB32 pixels are BGRA bytes in memory, the lines have to be contiguous
+	const QSize size = frame.size();
+	const uchar* bits = frame.bits();
+	QByteArray packed;
+	if (frame.bytesPerLine()!=size.width()*4)
+	{
+		packed.resize(size.width()*4*size.height());
+		for (int i=0;i<size.height();++i)
+			memcpy(packed.data()+i*size.width()*4, bits+i*frame.bytesPerLine(), size.width()*4);
+		bits = (const uchar*)packed.constData();
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (video->textureSize!=size)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.width(), size.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, bits);
+		video->textureSize = size;
+	}
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_BGRA, GL_UNSIGNED_BYTE, bits);
+	frame.unmap();
+	video->frameTexture = video->texture;
 }
 
-void StelVideoMgr::resizeVideo(const QString& id, float w, float h)
+void StelVideoMgr::drawOnScreen(StelCore* core, const VideoObject* video)
 {
-	if (videoObjects.contains(id))
+	StelPainter sPainter(core->getProjection2d());
+	const QSize frameSize = video->surface->surfaceFormat().frameSize();
+	const float w = video->width>0.f ? video->width : frameSize.width();
+	const float h = video->height>0.f ? video->height : frameSize.height();
+	// The position is given from the top left corner of the screen like for the screen images
+	const float x = video->x;
+	const float y = core->getProjection2d()->getViewportHeight() - video->y - h;
+	const Vec3f vertices[4] = {Vec3f(x, y, 0.f), Vec3f(x+w, y, 0.f), Vec3f(x, y+h, 0.f), Vec3f(x+w, y+h, 0.f)};
+	const float bottom = video->flipped ? 0.f : 1.f;
+	const Vec2f texCoords[4] = {Vec2f(0.f, bottom), Vec2f(1.f, bottom), Vec2f(0.f, 1.f-bottom), Vec2f(1.f, 1.f-bottom)};
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	sPainter.enableTexture2d(true);
+	glBindTexture(GL_TEXTURE_2D, video->frameTexture);
+	sPainter.setColor(1.f, 1.f, 1.f, video->alpha);
+	sPainter.setArrays(vertices, texCoords);
+	sPainter.drawFromArray(StelPainter::TriangleStrip, 4, 0, false);
+	sPainter.enableClientStates(false);
+}
+
+void StelVideoMgr::drawOnSky(StelCore* core, const VideoObject* video)
+{
+	// A rectangle of the plane tangent to the sphere at the center, with the east on the left
+	Vec3d center, east, north;
+	StelUtils::spheToRect(video->ra, video->dec, center);
+	east.set(-std::sin(video->ra), std::cos(video->ra), 0.);
+	north = center^east;
+	const double halfWidth = std::tan(video->skyWidth/2.);
+	const double halfHeight = std::tan(video->skyHeight/2.);
+
+	static const int nbVertices = (SkyGridSize+1)*(SkyGridSize+1);
+	Vec3d vertices[nbVertices];
+	Vec2f texCoords[nbVertices];
+	for (int j=0;j<=SkyGridSize;++j)
+	{
+		const float t = (float)j/SkyGridSize;
+		for (int i=0;i<=SkyGridSize;++i)
+		{
+			const float s = (float)i/SkyGridSize;
+			Vec3d v = center + east*((1.-2.*s)*halfWidth) + north*((2.*t-1.)*halfHeight);
+			v.normalize();
+			vertices[j*(SkyGridSize+1)+i] = v;
+			texCoords[j*(SkyGridSize+1)+i].set(s, video->flipped ? t : 1.f-t);
+		}
+	}
+	unsigned short indices[SkyGridSize*SkyGridSize*6];
+	unsigned short* index = indices;
+	for (int j=0;j<SkyGridSize;++j)
 	{
-		if (videoObjects[id]->pWidget!=NULL)
+		for (int i=0;i<SkyGridSize;++i)
 		{
-			videoObjects[id]->pWidget->resize(w, h);
-			videoObjects[id]->player->resize(w, h);
+			const unsigned short first = j*(SkyGridSize+1)+i;
+			*index++ = first;
+			*index++ = first+1;
+			*index++ = first+SkyGridSize+1;
+			*index++ = first+1;
+			*index++ = first+SkyGridSize+2;
+			*index++ = first+SkyGridSize+1;
 		}
 	}
+
+	StelPainter sPainter(core->getProjection(StelCore::FrameJ2000));
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	sPainter.enableTexture2d(true);
+	glBindTexture(GL_TEXTURE_2D, video->frameTexture);
+	sPainter.setColor(1.f, 1.f, 1.f, video->alpha);
+	sPainter.setArrays(vertices, texCoords);
+	sPainter.drawFromArray(StelPainter::Triangles, SkyGridSize*SkyGridSize*6, 0, true, indices);
+	sPainter.enableClientStates(false);
 }
 
-void StelVideoMgr::showVideo(const QString& id, bool show) 
+void StelVideoMgr::draw(StelCore* core)
 {
-	if (videoObjects.contains(id))
+	foreach (VideoObject* video, videoObjects)
 	{
-		if (videoObjects[id]->pWidget!=NULL)
-		{
-			videoObjects[id]->pWidget->setVisible(show);
-		}
+		uploadFrame(video);
+		if (!video->visible || video->frameTexture==0 || video->alpha<=0.f)
+			continue;
+		if (video->onSky)
+			drawOnSky(core, video);
+		else
+			drawOnScreen(core, video);
 	}
 }
 
-#else 
+#else
+StelVideoMgr::StelVideoMgr()
+{
+	setObjectName("StelVideoMgr");
+}
 void StelVideoMgr::loadVideo(const QString& filename, const QString& id, float x, float y, bool show, float alpha)
 {
 	qWarning() << "[StelVideoMgr] This build of Stellarium does not support video - cannot load video" << QDir::toNativeSeparators(filename) << id << x << y << show << alpha;
 }
 StelVideoMgr::~StelVideoMgr() {;}
+void StelVideoMgr::init() {;}
+void StelVideoMgr::update(double) {;}
+void StelVideoMgr::draw(StelCore*) {;}
+double StelVideoMgr::getCallOrder(StelModuleActionName) const {return 0;}
 void StelVideoMgr::playVideo(const QString&) {;}
 void StelVideoMgr::pauseVideo(const QString&) {;}
 void StelVideoMgr::stopVideo(const QString&) {;}
@@ -193,6 +474,6 @@ void StelVideoMgr::setVideoXY(const QString&, float, float) {;}
 void StelVideoMgr::setVideoAlpha(const QString&, float) {;}
 void StelVideoMgr::resizeVideo(const QString&, float, float) {;}
 void StelVideoMgr::showVideo(const QString&, bool) {;}
-#endif // HAVE_QT_PHONON
-
-
+void StelVideoMgr::setVideoSkyPosition(const QString&, double, double, double, double) {;}
+void StelVideoMgr::setVideoSyncToTime(const QString&, bool) {;}
+#endif // ENABLE_VIDEO
@@ -19,17 +19,37 @@
 #ifndef _STELVIDEOMGR_HPP_
 #define _STELVIDEOMGR_HPP_
 
-#include <QObject>
+#include "StelModule.hpp"
+
 #include <QMap>
+#include <QSize>
 #include <QString>
 
-class StelVideoMgr : public QObject
+class QMediaPlayer;
+class StelVideoSurface;
+
+//! @class StelVideoMgr
+//! Play videos for the scripts. The frames are decoded by Qt Multimedia, with the hardware decoders
+//! of the platform when its backend provides them, and streamed into GL textures drawn after the sky.
+//! When the backend can decode into GL textures of the context, they are used directly without copy.
+//! A video is drawn on the screen, or on the sky as a rectangle centered on J2000 coordinates.
+//! Its position can also follow the simulation time instead of the clock, so that it stays in sync
+//! with the sky when the time is accelerated, paused or set.
+//! Without video support in the build (ENABLE_VIDEO), the calls only print a warning.
+class StelVideoMgr : public StelModule
 {
 	Q_OBJECT
 
 public:
 	StelVideoMgr();
-	~StelVideoMgr();
+	virtual ~StelVideoMgr();
+
+	///////////////////////////////////////////////////////////////////////////
+	// Methods defined in the StelModule class
+	virtual void init();
+	virtual void update(double deltaTime);
+	virtual void draw(StelCore* core);
+	virtual double getCallOrder(StelModuleActionName actionName) const;
 
 public slots:
 	void loadVideo(const QString& filename, const QString& id, float x, float y, bool show, float alpha);
@@ -38,21 +58,53 @@ public slots:
 	void stopVideo(const QString& id);
 	void dropVideo(const QString& id);
 	void seekVideo(const QString& id, qint64 ms);
+	//! Draw the video on the screen, with its top left corner at x, y in pixels.
 	void setVideoXY(const QString& id, float x, float y);
 	void setVideoAlpha(const QString& id, float alpha);
+	//! Set the size of the video in pixels on the screen, 0 to use the size of the frames.
 	void resizeVideo(const QString& id, float w, float h);
 	void showVideo(const QString& id, bool show);
+	//! Draw the video on the sky instead of the screen.
+	//! @param ra, dec the J2000 coordinates of the center of the video, in degrees.
+	//! @param width, height the angular size of the video, in degrees.
+	void setVideoSkyPosition(const QString& id, double ra, double dec, double width, double height);
+	//! Make the position of the video follow the simulation time: the video is played at the
+	//! time rate, paused when the time is stopped and moved when the date is set.
+	//! The current date corresponds to the current position of the video.
+	void setVideoSyncToTime(const QString& id, bool sync);
 
 private:
-#if 0
-	typedef struct {
-		QWidget *widget;
-		Phonon::VideoPlayer *player;
-		QGraphicsProxyWidget *pWidget;
-	} VideoPlayer;
-	QMap<QString, VideoPlayer*> videoObjects; 
-#endif
+#ifdef ENABLE_VIDEO
+	struct VideoObject
+	{
+		QMediaPlayer* player;
+		StelVideoSurface* surface;
+		//! The texture the frames are uploaded in, 0 if not created yet.
+		unsigned int texture;
+		QSize textureSize;
+		//! The texture of the last frame, provided by the decoder or the uploaded one.
+		unsigned int frameTexture;
+		bool flipped;
+		bool visible;
+		float alpha;
+		float x, y, width, height;
+		bool onSky;
+		double ra, dec, skyWidth, skyHeight;
+		bool syncToTime;
+		//! The Julian day corresponding to the start of the video when synced to the time.
+		double syncStartJd;
+		bool syncPlaying;
+	};
+
+	//! Upload the last frame decoded to the texture of the video.
+	void uploadFrame(VideoObject* video);
+	void drawOnScreen(StelCore* core, const VideoObject* video);
+	void drawOnSky(StelCore* core, const VideoObject* video);
+	//! Move the video to the position corresponding to the simulation time.
+	void syncToTime(StelCore* core, VideoObject* video);
 
+	QMap<QString, VideoObject*> videoObjects;
+#endif
 };
 
 #endif // _STELVIDEOMGR_HPP_
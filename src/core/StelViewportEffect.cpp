@@ -22,14 +22,22 @@
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 #include "StelPainter.hpp"
+#include "StelProjectorClasses.hpp"
 #include "SphericMirrorCalculator.hpp"
 #include "StelFileMgr.hpp"
 #include "StelMovementMgr.hpp"
+#include "StelTextureMgr.hpp"
 
+#include <cstddef>
+
+#include <QOpenGLBuffer>
 #include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QDebug>
 #include <QSettings>
 #include <QFile>
 #include <QDir>
+#include <QTextStream>
 
 void StelViewportEffect::paintViewportBuffer(const QOpenGLFramebufferObject* buf) const
 {
@@ -40,6 +48,284 @@ void StelViewportEffect::paintViewportBuffer(const QOpenGLFramebufferObject* buf
 	sPainter.drawRect2d(0, 0, buf->size().width(), buf->size().height());
 }
 
+//! Number of cells on each side of the distortion mesh of one eye.
+static const int LensMeshSize = 32;
+
+struct LensMeshVertex
+{
+	Vec2f pos;
+	Vec2f red;
+	Vec2f green;
+	Vec2f blue;
+};
+
+StelViewportStereoSideBySide::StelViewportStereoSideBySide(int screen_w, int screen_h, float lensOffset, int margin,
+							   const Vec4f& distortion, const Vec2f& chromaticAberration)
+	: screen_w(screen_w)
+	, screen_h(screen_h)
+	, eyeWidth(screen_w/2)
+	, lensOffset(qRound(lensOffset))
+	, margin(qMax(margin, 0))
+	, reprojectionShift(0.f, 0.f)
+	, distortion(distortion)
+	, chromaticAberration(chromaticAberration)
+	, flagDistortion(distortion!=Vec4f(1.f,0.f,0.f,0.f) || chromaticAberration!=Vec2f(1.f,1.f))
+	, distortionMeshInitialized(false)
+	, meshVertices(NULL)
+	, meshIndices(NULL)
+	, nbMeshIndices(0)
+	, distortionProgram(NULL)
+{
+}
+
+StelViewportStereoSideBySide::~StelViewportStereoSideBySide()
+{
+	delete meshVertices;
+	delete meshIndices;
+	delete distortionProgram;
+}
+
+QSize StelViewportStereoSideBySide::getBufferSize() const
+{
+	return QSize(eyeWidth+2*qAbs(lensOffset)+2*margin, screen_h+2*margin);
+}
+
+int StelViewportStereoSideBySide::getEyeBufferOffset(bool rightEye) const
+{
+	// The sky center is in the middle of the buffer, it must appear at the lens center of each eye.
+	return margin + (rightEye ? qAbs(lensOffset)+lensOffset : qAbs(lensOffset)-lensOffset);
+}
+
+void StelViewportStereoSideBySide::setReprojectionShift(float dx, float dy)
+{
+	reprojectionShift.set(qBound((float)-margin, dx, (float)margin), qBound((float)-margin, dy, (float)margin));
+}
+
+Vec2f StelViewportStereoSideBySide::getBufferPos(float x, float y, float scale) const
+{
+	const bool rightEye = x>=eyeWidth;
+	const float localX = rightEye ? x-eyeWidth : x;
+	// The lens center is where the sky center of the buffer is presented
+	const float cx = 0.5f*eyeWidth + (rightEye ? -lensOffset : lensOffset);
+	const float cy = 0.5f*screen_h;
+	const float radius = 0.5f*eyeWidth;
+	const float dx = (localX-cx)/radius;
+	const float dy = (y-cy)/radius;
+	const float r2 = dx*dx+dy*dy;
+	const float f = scale*radius*(distortion[0]+r2*(distortion[1]+r2*(distortion[2]+r2*distortion[3])));
+	return Vec2f(getEyeBufferOffset(rightEye)+cx+dx*f, margin+cy+dy*f);
+}
+
+bool StelViewportStereoSideBySide::initDistortionMesh() const
+{
+	distortionMeshInitialized = true;
+
+	const char* vsrc =
+		"attribute highp vec2 pos;\n"
+		"attribute highp vec2 red;\n"
+		"attribute highp vec2 green;\n"
+		"attribute highp vec2 blue;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp vec2 shift;\n"
+		"uniform highp vec2 invBufferSize;\n"
+		"varying highp vec2 texRed;\n"
+		"varying highp vec2 texGreen;\n"
+		"varying highp vec2 texBlue;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = projectionMatrix*vec4(pos, 0., 1.);\n"
+		"    texRed = (red+shift)*invBufferSize;\n"
+		"    texGreen = (green+shift)*invBufferSize;\n"
+		"    texBlue = (blue+shift)*invBufferSize;\n"
+		"}\n";
+	const char* fsrc =
+		"varying highp vec2 texRed;\n"
+		"varying highp vec2 texGreen;\n"
+		"varying highp vec2 texBlue;\n"
+		"uniform sampler2D tex;\n"
+		"mediump float inside(highp vec2 t)\n"
+		"{\n"
+		"    highp vec2 s = step(vec2(0.), t)*step(t, vec2(1.));\n"
+		"    return s.x*s.y;\n"
+		"}\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_FragColor = vec4(texture2D(tex, texRed).r*inside(texRed),\n"
+		"                        texture2D(tex, texGreen).g*inside(texGreen),\n"
+		"                        texture2D(tex, texBlue).b*inside(texBlue), 1.);\n"
+		"}\n";
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelViewportStereoSideBySide: Warnings while compiling vshader: " << vshader.log(); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelViewportStereoSideBySide: Warnings while compiling fshader: " << fshader.log(); }
+	distortionProgram = new QOpenGLShaderProgram();
+	distortionProgram->addShader(&vshader);
+	distortionProgram->addShader(&fshader);
+	if (!StelPainter::linkProg(distortionProgram, "lensDistortionShader"))
+	{
+		delete distortionProgram;
+		distortionProgram = NULL;
+		return false;
+	}
+
+	// One grid per eye, the positions are computed once as the buffer layout does not change
+	QVector<LensMeshVertex> vertices;
+	vertices.reserve(2*(LensMeshSize+1)*(LensMeshSize+1));
+	QVector<GLushort> indices;
+	indices.reserve(2*LensMeshSize*LensMeshSize*6);
+	for (int eye=0; eye<2; ++eye)
+	{
+		const int first = vertices.size();
+		for (int j=0; j<=LensMeshSize; ++j)
+		{
+			for (int i=0; i<=LensMeshSize; ++i)
+			{
+				LensMeshVertex v;
+				// Keep the inner border of each eye in its own half
+				const float x = eye*eyeWidth + qMin((float)i*eyeWidth/LensMeshSize, eyeWidth-0.001f);
+				const float y = (float)j*screen_h/LensMeshSize;
+				v.pos.set(i==LensMeshSize ? (eye+1)*eyeWidth : x, y);
+				v.red = getBufferPos(x, y, chromaticAberration[0]);
+				v.green = getBufferPos(x, y, 1.f);
+				v.blue = getBufferPos(x, y, chromaticAberration[1]);
+				vertices << v;
+			}
+		}
+		for (int j=0; j<LensMeshSize; ++j)
+		{
+			for (int i=0; i<LensMeshSize; ++i)
+			{
+				const GLushort a = first + j*(LensMeshSize+1) + i;
+				const GLushort b = a + LensMeshSize+1;
+				indices << a << a+1 << b << a+1 << b+1 << b;
+			}
+		}
+	}
+	nbMeshIndices = indices.size();
+
+	meshVertices = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+	meshVertices->setUsagePattern(QOpenGLBuffer::StaticDraw);
+	meshVertices->create();
+	meshVertices->bind();
+	meshVertices->allocate(vertices.constData(), vertices.size()*sizeof(LensMeshVertex));
+	meshVertices->release();
+	meshIndices = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+	meshIndices->setUsagePattern(QOpenGLBuffer::StaticDraw);
+	meshIndices->create();
+	meshIndices->bind();
+	meshIndices->allocate(indices.constData(), indices.size()*sizeof(GLushort));
+	meshIndices->release();
+	return true;
+}
+
+void StelViewportStereoSideBySide::paintDistortionMesh(const QOpenGLFramebufferObject* buf) const
+{
+	StelProjector::StelProjectorParams params = StelApp::getInstance().getCore()->getCurrentStelProjectorParams();
+	params.viewportXywh.set(0, 0, screen_w, screen_h);
+	params.viewportCenter.set(0.5f*screen_w, 0.5f*screen_h);
+	StelProjectorP prj(new StelProjector2d());
+	prj->init(params);
+	// The painter sets up the viewport and the GL state, the drawing is done by the mesh shader
+	StelPainter sPainter(prj);
+	glDisable(GL_BLEND);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, buf->texture());
+
+	const Mat4f& m = prj->getProjectionMatrix();
+	distortionProgram->bind();
+	distortionProgram->setUniformValue("projectionMatrix", StelPainter::toQMatrix(m));
+	distortionProgram->setUniformValue("shift", reprojectionShift[0], reprojectionShift[1]);
+	distortionProgram->setUniformValue("invBufferSize", 1.f/buf->size().width(), 1.f/buf->size().height());
+	distortionProgram->setUniformValue("tex", 0);
+
+	const int pos = distortionProgram->attributeLocation("pos");
+	const int red = distortionProgram->attributeLocation("red");
+	const int green = distortionProgram->attributeLocation("green");
+	const int blue = distortionProgram->attributeLocation("blue");
+	meshVertices->bind();
+	meshIndices->bind();
+	distortionProgram->enableAttributeArray(pos);
+	distortionProgram->enableAttributeArray(red);
+	distortionProgram->enableAttributeArray(green);
+	distortionProgram->enableAttributeArray(blue);
+	distortionProgram->setAttributeBuffer(pos, GL_FLOAT, offsetof(LensMeshVertex, pos), 2, sizeof(LensMeshVertex));
+	distortionProgram->setAttributeBuffer(red, GL_FLOAT, offsetof(LensMeshVertex, red), 2, sizeof(LensMeshVertex));
+	distortionProgram->setAttributeBuffer(green, GL_FLOAT, offsetof(LensMeshVertex, green), 2, sizeof(LensMeshVertex));
+	distortionProgram->setAttributeBuffer(blue, GL_FLOAT, offsetof(LensMeshVertex, blue), 2, sizeof(LensMeshVertex));
+	glDrawElements(GL_TRIANGLES, nbMeshIndices, GL_UNSIGNED_SHORT, 0);
+	distortionProgram->disableAttributeArray(pos);
+	distortionProgram->disableAttributeArray(red);
+	distortionProgram->disableAttributeArray(green);
+	distortionProgram->disableAttributeArray(blue);
+	meshIndices->release();
+	meshVertices->release();
+	distortionProgram->release();
+}
+
+void StelViewportStereoSideBySide::paintViewportBuffer(const QOpenGLFramebufferObject* buf) const
+{
+	if (flagDistortion && (distortionMeshInitialized || initDistortionMesh()) && distortionProgram)
+	{
+		paintDistortionMesh(buf);
+		return;
+	}
+
+	StelProjector::StelProjectorParams params = StelApp::getInstance().getCore()->getCurrentStelProjectorParams();
+	params.viewportXywh.set(0, 0, screen_w, screen_h);
+	params.viewportCenter.set(0.5f*screen_w, 0.5f*screen_h);
+	StelProjectorP prj(new StelProjector2d());
+	prj->init(params);
+	StelPainter sPainter(prj);
+	sPainter.setColor(1,1,1);
+	sPainter.enableTexture2d(true);
+	glBindTexture(GL_TEXTURE_2D, buf->texture());
+
+	const float bufWidth = buf->size().width();
+	const float bufHeight = buf->size().height();
+	const float v0 = (margin+reprojectionShift[1])/bufHeight;
+	const float v1 = v0 + screen_h/bufHeight;
+	float vertexData[8];
+	float texCoordData[8];
+	for (int eye=0; eye<2; ++eye)
+	{
+		const float x = eye*eyeWidth;
+		const float u0 = (getEyeBufferOffset(eye==1)+reprojectionShift[0])/bufWidth;
+		const float u1 = u0 + eyeWidth/bufWidth;
+		vertexData[0]=x; vertexData[1]=0.f;
+		vertexData[2]=x+eyeWidth; vertexData[3]=0.f;
+		vertexData[4]=x; vertexData[5]=screen_h;
+		vertexData[6]=x+eyeWidth; vertexData[7]=screen_h;
+		texCoordData[0]=u0; texCoordData[1]=v0;
+		texCoordData[2]=u1; texCoordData[3]=v0;
+		texCoordData[4]=u0; texCoordData[5]=v1;
+		texCoordData[6]=u1; texCoordData[7]=v1;
+		sPainter.enableClientStates(true, true);
+		sPainter.setVertexPointer(2, GL_FLOAT, vertexData);
+		sPainter.setTexCoordPointer(2, GL_FLOAT, texCoordData);
+		sPainter.drawFromArray(StelPainter::TriangleStrip, 4, 0, false);
+	}
+	sPainter.enableClientStates(false);
+}
+
+void StelViewportStereoSideBySide::distortXY(float& x, float& y) const
+{
+	if (flagDistortion)
+	{
+		const Vec2f p = getBufferPos(x, y, 1.f);
+		x = p[0];
+		y = p[1];
+		return;
+	}
+	y += margin;
+	if (x < eyeWidth)
+		x += getEyeBufferOffset(false);
+	else
+		x += getEyeBufferOffset(true) - eyeWidth;
+}
+
 struct VertexPoint
 {
 	Vec2f ver_xy;
@@ -392,3 +678,288 @@ void StelViewportDistorterFisheyeToSphericMirror::paintViewportBuffer(const QOpe
 	sPainter.enableClientStates(false);
 }
 
+
+struct WarpMeshVertex
+{
+	Vec2f pos;		// Position in the window
+	Vec2f texCoord;		// Position in the fisheye buffer
+	Vec2f blendCoord;	// Position in the output, for the blend map
+	float intensity;
+};
+
+StelViewportWarpMesh::StelViewportWarpMesh(int screen_w, int screen_h)
+	: screen_w(screen_w)
+	, screen_h(screen_h)
+	, bufferSize(2048)
+	, glInitialized(false)
+	, meshVertices(NULL)
+	, meshIndices(NULL)
+	, warpProgram(NULL)
+{
+	QSettings& conf = *StelApp::getInstance().getSettings();
+	bufferSize = qBound(64, conf.value("warp_mesh/buffer_size", 2048).toInt(), 8192);
+	const int nbProjectors = conf.value("warp_mesh/nb_projectors", 0).toInt();
+	for (int p=1; p<=nbProjectors; ++p)
+	{
+		const QString prefix = QString("warp_mesh/projector_%1_").arg(p);
+		// The lists may be read as a single string when they are not in the configuration file
+		const QStringList rect = conf.value(prefix+"output", "").toStringList().join(",").split(",");
+		Output output;
+		const int w = rect.value(2).toInt();
+		const int h = rect.value(3).toInt();
+		if (rect.size()!=4 || w<=0 || h<=0)
+		{
+			qWarning() << "WARNING: invalid output rectangle for the warp mesh projector" << p;
+			continue;
+		}
+		// The rectangle is given from the top left corner of the window, the viewport is from the bottom left one
+		output.rect = QRect(rect.value(0).toInt(), screen_h-rect.value(1).toInt()-h, w, h);
+		if (!loadMesh(conf.value(prefix+"mesh", "").toString(), output))
+			continue;
+		output.blendMapFile = conf.value(prefix+"blend", "").toString();
+		outputs << output;
+	}
+	if (outputs.isEmpty())
+		qWarning() << "WARNING: no warp mesh could be loaded, the viewport is not warped";
+}
+
+StelViewportWarpMesh::~StelViewportWarpMesh()
+{
+	delete meshVertices;
+	delete meshIndices;
+	delete warpProgram;
+}
+
+bool StelViewportWarpMesh::loadMesh(const QString& fileName, Output& output) const
+{
+	const QString path = StelFileMgr::findFile(fileName);
+	QFile file(path);
+	if (path.isEmpty() || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		qWarning() << "WARNING: could not open the warp mesh file:" << fileName;
+		return false;
+	}
+	QTextStream in(&file);
+	int type = 0;
+	in >> type >> output.nbCols >> output.nbRows;
+	// Type 2 is the rectangular mesh, the only type used for projectors
+	if (in.status()!=QTextStream::Ok || type!=2 || output.nbCols<2 || output.nbRows<2 || output.nbCols*output.nbRows>65536)
+	{
+		qWarning() << "WARNING: unsupported warp mesh file:" << fileName;
+		return false;
+	}
+	const int nbNodes = output.nbCols*output.nbRows;
+	const float aspect = (float)output.rect.width()/output.rect.height();
+	output.pos.resize(nbNodes);
+	output.texCoord.resize(nbNodes);
+	output.intensity.resize(nbNodes);
+	for (int i=0; i<nbNodes; ++i)
+	{
+		float x, y, u, v, intensity;
+		in >> x >> y >> u >> v >> intensity;
+		if (in.status()!=QTextStream::Ok)
+		{
+			qWarning() << "WARNING: truncated warp mesh file:" << fileName;
+			return false;
+		}
+		output.pos[i].set(output.rect.x()+0.5f*(x/aspect+1.f)*output.rect.width(), output.rect.y()+0.5f*(y+1.f)*output.rect.height());
+		output.texCoord[i].set(u, v);
+		output.intensity[i] = intensity;
+	}
+	return true;
+}
+
+bool StelViewportWarpMesh::initGL() const
+{
+	glInitialized = true;
+
+	const char* vsrc =
+		"attribute highp vec2 pos;\n"
+		"attribute highp vec2 texCoord;\n"
+		"attribute highp vec2 blendCoord;\n"
+		"attribute mediump float intensity;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"varying highp vec2 texc;\n"
+		"varying highp vec2 blendc;\n"
+		"varying mediump float intens;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_Position = projectionMatrix*vec4(pos, 0., 1.);\n"
+		"    texc = texCoord;\n"
+		"    blendc = blendCoord;\n"
+		"    intens = intensity;\n"
+		"}\n";
+	const char* fsrc =
+		"varying highp vec2 texc;\n"
+		"varying highp vec2 blendc;\n"
+		"varying mediump float intens;\n"
+		"uniform sampler2D tex;\n"
+		"uniform sampler2D blendMap;\n"
+		"uniform mediump float blendWeight;\n"
+		"void main(void)\n"
+		"{\n"
+		"    mediump vec3 blend = mix(vec3(1.), texture2D(blendMap, blendc).rgb, blendWeight);\n"
+		"    gl_FragColor = vec4(texture2D(tex, texc).rgb*blend*intens, 1.);\n"
+		"}\n";
+
+	QOpenGLShader vshader(QOpenGLShader::Vertex);
+	vshader.compileSourceCode(vsrc);
+	if (!vshader.log().isEmpty()) { qWarning() << "StelViewportWarpMesh: Warnings while compiling vshader: " << vshader.log(); }
+	QOpenGLShader fshader(QOpenGLShader::Fragment);
+	fshader.compileSourceCode(fsrc);
+	if (!fshader.log().isEmpty()) { qWarning() << "StelViewportWarpMesh: Warnings while compiling fshader: " << fshader.log(); }
+	warpProgram = new QOpenGLShaderProgram();
+	warpProgram->addShader(&vshader);
+	warpProgram->addShader(&fshader);
+	if (!StelPainter::linkProg(warpProgram, "warpMeshShader"))
+	{
+		delete warpProgram;
+		warpProgram = NULL;
+		return false;
+	}
+
+	// All the meshes share the same buffers, the indices of each mesh are relative to its first vertex
+	QVector<WarpMeshVertex> vertices;
+	QVector<GLushort> indices;
+	for (int o=0; o<outputs.size(); ++o)
+	{
+		Output& output = outputs[o];
+		output.firstVertex = vertices.size();
+		output.firstIndex = indices.size();
+		for (int i=0; i<output.pos.size(); ++i)
+		{
+			WarpMeshVertex v;
+			v.pos = output.pos[i];
+			v.texCoord = output.texCoord[i];
+			v.blendCoord.set((output.pos[i][0]-output.rect.x())/output.rect.width(), (output.pos[i][1]-output.rect.y())/output.rect.height());
+			v.intensity = qMax(output.intensity[i], 0.f);
+			vertices << v;
+		}
+		for (int j=0; j<output.nbRows-1; ++j)
+		{
+			for (int i=0; i<output.nbCols-1; ++i)
+			{
+				const GLushort a = j*output.nbCols + i;
+				const GLushort b = a + output.nbCols;
+				// The cells touching a node with a negative intensity are outside of the projector image
+				if (output.intensity[a]<0.f || output.intensity[a+1]<0.f || output.intensity[b]<0.f || output.intensity[b+1]<0.f)
+					continue;
+				indices << a << a+1 << b << a+1 << b+1 << b;
+			}
+		}
+		output.nbIndices = indices.size()-output.firstIndex;
+		if (!output.blendMapFile.isEmpty())
+		{
+			output.blendMap = StelApp::getInstance().getTextureManager().createTexture(output.blendMapFile);
+			if (output.blendMap.isNull())
+				qWarning() << "WARNING: could not load the warp mesh blend map:" << output.blendMapFile;
+		}
+	}
+
+	meshVertices = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+	meshVertices->setUsagePattern(QOpenGLBuffer::StaticDraw);
+	meshVertices->create();
+	meshVertices->bind();
+	meshVertices->allocate(vertices.constData(), vertices.size()*sizeof(WarpMeshVertex));
+	meshVertices->release();
+	meshIndices = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+	meshIndices->setUsagePattern(QOpenGLBuffer::StaticDraw);
+	meshIndices->create();
+	meshIndices->bind();
+	meshIndices->allocate(indices.constData(), indices.size()*sizeof(GLushort));
+	meshIndices->release();
+	return true;
+}
+
+void StelViewportWarpMesh::paintViewportBuffer(const QOpenGLFramebufferObject* buf) const
+{
+	if (!glInitialized)
+		initGL();
+	if (!warpProgram)
+	{
+		StelViewportEffect::paintViewportBuffer(buf);
+		return;
+	}
+
+	StelProjector::StelProjectorParams params = StelApp::getInstance().getCore()->getCurrentStelProjectorParams();
+	params.viewportXywh.set(0, 0, screen_w, screen_h);
+	params.viewportCenter.set(0.5f*screen_w, 0.5f*screen_h);
+	StelProjectorP prj(new StelProjector2d());
+	prj->init(params);
+	// The painter sets up the viewport and the GL state, the drawing is done by the warp shader
+	StelPainter sPainter(prj);
+	glClearColor(0.f, 0.f, 0.f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_BLEND);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, buf->texture());
+
+	const Mat4f& m = prj->getProjectionMatrix();
+	warpProgram->bind();
+	warpProgram->setUniformValue("projectionMatrix", StelPainter::toQMatrix(m));
+	warpProgram->setUniformValue("tex", 0);
+	warpProgram->setUniformValue("blendMap", 1);
+
+	const int pos = warpProgram->attributeLocation("pos");
+	const int texCoord = warpProgram->attributeLocation("texCoord");
+	const int blendCoord = warpProgram->attributeLocation("blendCoord");
+	const int intensity = warpProgram->attributeLocation("intensity");
+	meshVertices->bind();
+	meshIndices->bind();
+	warpProgram->enableAttributeArray(pos);
+	warpProgram->enableAttributeArray(texCoord);
+	warpProgram->enableAttributeArray(blendCoord);
+	warpProgram->enableAttributeArray(intensity);
+	// One pass per projector output, the attributes start at its first vertex as the indices are 16 bits
+	for (int o=0; o<outputs.size(); ++o)
+	{
+		const Output& output = outputs.at(o);
+		const bool useBlendMap = !output.blendMap.isNull() && output.blendMap->bind(1);
+		glActiveTexture(GL_TEXTURE0);
+		warpProgram->setUniformValue("blendWeight", useBlendMap ? 1.f : 0.f);
+		const int offset = output.firstVertex*sizeof(WarpMeshVertex);
+		warpProgram->setAttributeBuffer(pos, GL_FLOAT, offset+offsetof(WarpMeshVertex, pos), 2, sizeof(WarpMeshVertex));
+		warpProgram->setAttributeBuffer(texCoord, GL_FLOAT, offset+offsetof(WarpMeshVertex, texCoord), 2, sizeof(WarpMeshVertex));
+		warpProgram->setAttributeBuffer(blendCoord, GL_FLOAT, offset+offsetof(WarpMeshVertex, blendCoord), 2, sizeof(WarpMeshVertex));
+		warpProgram->setAttributeBuffer(intensity, GL_FLOAT, offset+offsetof(WarpMeshVertex, intensity), 1, sizeof(WarpMeshVertex));
+		glDrawElements(GL_TRIANGLES, output.nbIndices, GL_UNSIGNED_SHORT, (const GLvoid*)(output.firstIndex*sizeof(GLushort)));
+	}
+	warpProgram->disableAttributeArray(pos);
+	warpProgram->disableAttributeArray(texCoord);
+	warpProgram->disableAttributeArray(blendCoord);
+	warpProgram->disableAttributeArray(intensity);
+	meshIndices->release();
+	meshVertices->release();
+	warpProgram->release();
+}
+
+void StelViewportWarpMesh::distortXY(float& x, float& y) const
+{
+	for (int o=0; o<outputs.size(); ++o)
+	{
+		const Output& output = outputs.at(o);
+		if (!output.rect.contains((int)floor(x), (int)floor(y)))
+			continue;
+		// The nodes are on a regular grid of the output, but the rows and columns may be stored in any order
+		const int nx = output.nbCols;
+		const int ny = output.nbRows;
+		float s = (x-output.rect.x())/output.rect.width();
+		float t = (y-output.rect.y())/output.rect.height();
+		if (output.pos.at(nx-1)[0] < output.pos.at(0)[0])
+			s = 1.f-s;
+		if (output.pos.at((ny-1)*nx)[1] < output.pos.at(0)[1])
+			t = 1.f-t;
+		const float fi = qBound(0.f, s*(nx-1), nx-1.001f);
+		const float fj = qBound(0.f, t*(ny-1), ny-1.001f);
+		const int i = (int)fi;
+		const int j = (int)fj;
+		const float dx = fi-i;
+		const float dy = fj-j;
+		const Vec2f* t0 = output.texCoord.constData() + j*nx + i;
+		const Vec2f* t1 = t0 + nx;
+		const Vec2f uv = (t0[0]*(1.f-dx) + t0[1]*dx)*(1.f-dy) + (t1[0]*(1.f-dx) + t1[1]*dx)*dy;
+		x = uv[0]*bufferSize;
+		y = uv[1]*bufferSize;
+		return;
+	}
+}
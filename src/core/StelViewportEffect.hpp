@@ -22,8 +22,15 @@
 
 #include "VecMath.hpp"
 #include "StelProjector.hpp"
+#include "StelTextureTypes.hpp"
+
+#include <QRect>
+#include <QSize>
+#include <QVector>
 
 class QOpenGLFramebufferObject;
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
 
 //! @class StelViewportEffect
 //! Allow to apply visual effects on the whole Stellarium viewport.
@@ -46,6 +53,69 @@ public:
 };
 
 
+//! @class StelViewportStereoSideBySide
+//! Present a single rendered view of the sky to both halves of the window for head-mounted displays.
+//! All the objects drawn by Stellarium are at optical infinity, so both eyes see the same image up to
+//! the position of the lens center: the viewport is rendered once, a little wider than one eye, and each
+//! eye samples its own window of the buffer. The CPU cost is therefore the one of a mono frame.
+//! When a margin is given, the buffer is rendered larger than the eye view so that the last frame can be
+//! reprojected for a newer head pose by shifting the windows, see setReprojectionShift().
+//! The barrel distortion of the lenses and their chromatic aberration can be compensated: each eye is then
+//! drawn from a static mesh storing, for each of its vertices, the position in the buffer to sample for the
+//! red, green and blue channels. Both eyes are drawn in a single pass and the fragment shader only does
+//! three texture lookups, so the cost does not depend on the distortion model.
+class StelViewportStereoSideBySide : public StelViewportEffect
+{
+public:
+	//! @param screen_w the width of the whole window.
+	//! @param screen_h the height of the whole window.
+	//! @param lensOffset the offset in pixels of each lens center toward the middle of the window.
+	//! @param margin the number of extra pixels rendered on each side of the buffer for reprojection.
+	//! @param distortion the coefficients k of the radial distortion applied to the green channel: a point at
+	//! the distance r from the lens center samples the buffer at r*(k0+k1*r^2+k2*r^4+k3*r^6), r being
+	//! normalized to half the width of an eye. (1,0,0,0) disables the distortion.
+	//! @param chromaticAberration the scales applied to the distortion of the red and blue channels.
+	StelViewportStereoSideBySide(int screen_w, int screen_h, float lensOffset, int margin=0,
+				     const Vec4f& distortion=Vec4f(1.f,0.f,0.f,0.f), const Vec2f& chromaticAberration=Vec2f(1.f,1.f));
+	~StelViewportStereoSideBySide();
+	virtual QString getName() {return "stereoSideBySide";}
+	virtual void paintViewportBuffer(const QOpenGLFramebufferObject* buf) const;
+	virtual void distortXY(float& x, float& y) const;
+	//! Get the size of the buffer in which the viewport has to be rendered.
+	QSize getBufferSize() const;
+	//! Get the size of the view presented to one eye.
+	QSize getEyeSize() const {return QSize(eyeWidth, screen_h);}
+	//! Set the shift in pixels to apply to the buffer when presenting it, clamped to the margin.
+	//! This is used to reproject the last rendered frame when the head has moved since it was drawn.
+	void setReprojectionShift(float dx, float dy);
+private:
+	//! Get the horizontal position in the buffer of the left border of the given eye window.
+	int getEyeBufferOffset(bool rightEye) const;
+	//! Get the position in the buffer sampled for a window position, without the reprojection shift.
+	//! @param scale the scale of the distortion of the color channel, 1 for green.
+	Vec2f getBufferPos(float x, float y, float scale) const;
+	//! Build the distortion mesh and its shader, return false if it is not possible.
+	bool initDistortionMesh() const;
+	void paintDistortionMesh(const QOpenGLFramebufferObject* buf) const;
+
+	const int screen_w;
+	const int screen_h;
+	const int eyeWidth;
+	const int lensOffset;
+	const int margin;
+	Vec2f reprojectionShift;
+
+	const Vec4f distortion;
+	const Vec2f chromaticAberration;
+	const bool flagDistortion;
+	//! The mesh is created at the first paint, when the GL context is current.
+	mutable bool distortionMeshInitialized;
+	mutable QOpenGLBuffer* meshVertices;
+	mutable QOpenGLBuffer* meshIndices;
+	mutable int nbMeshIndices;
+	mutable QOpenGLShaderProgram* distortionProgram;
+};
+
 class StelViewportDistorterFisheyeToSphericMirror : public StelViewportEffect
 {
 public:
@@ -71,5 +141,69 @@ private:
 	QVector<Vec2f> displayTexCoordList;
 };
 
+//! @class StelViewportWarpMesh
+//! Present the viewport through precomputed warp meshes, one for each projector of a multi-projector dome
+//! driven from a single window spanning all the projector outputs.
+//! The viewport is rendered once in a square fisheye buffer, then each projector output is drawn from its
+//! mesh, stored with the meshes of the other projectors in static GPU buffers, in one pass per output.
+//! The meshes use the format of the warp files of Paul Bourke: a first line with the mesh type (2), a line
+//! with the number of columns and rows, then for each node "x y u v i", x in [-aspect,aspect] and y in
+//! [-1,1] being the position in the output, u and v in [0,1] the position in the fisheye buffer and i the
+//! intensity, used for the edge blending of the overlapping projectors. The nodes with a negative
+//! intensity are not drawn. An alpha map image can also be given to each projector, it is stretched over
+//! the output and multiplied by the intensity.
+//! The projectors are read from the warp_mesh section of the settings: nb_projectors, buffer_size, and for
+//! each projector N from 1, projector_N_mesh, projector_N_output (x,y,width,height of the output in the
+//! window, from its top left corner) and the optional projector_N_blend.
+class StelViewportWarpMesh : public StelViewportEffect
+{
+public:
+	StelViewportWarpMesh(int screen_w, int screen_h);
+	~StelViewportWarpMesh();
+	virtual QString getName() {return "warpMesh";}
+	virtual void paintViewportBuffer(const QOpenGLFramebufferObject* buf) const;
+	virtual void distortXY(float& x, float& y) const;
+	//! Get the size of the fisheye buffer in which the viewport has to be rendered.
+	QSize getBufferSize() const {return QSize(bufferSize, bufferSize);}
+	//! Get whether at least one projector mesh could be loaded.
+	bool isValid() const {return !outputs.isEmpty();}
+
+private:
+	struct Output
+	{
+		Output() : nbCols(0), nbRows(0), firstVertex(0), firstIndex(0), nbIndices(0) {}
+		//! Rectangle of the output in the window, from its bottom left corner like the GL viewport.
+		QRect rect;
+		int nbCols;
+		int nbRows;
+		//! For each node, its position in the window, its position in the buffer and its intensity.
+		QVector<Vec2f> pos;
+		QVector<Vec2f> texCoord;
+		QVector<float> intensity;
+		QString blendMapFile;
+		//! The blend map and the position in the GPU buffers are set when the GL context is current.
+		StelTextureSP blendMap;
+		int firstVertex;
+		int firstIndex;
+		int nbIndices;
+	};
+
+	//! Read a mesh file of a projector.
+	bool loadMesh(const QString& fileName, Output& output) const;
+	//! Create the GPU buffers and the shader, return false if it is not possible.
+	bool initGL() const;
+
+	const int screen_w;
+	const int screen_h;
+	int bufferSize;
+	mutable QVector<Output> outputs;
+
+	//! The GPU buffers and the shader are created at the first paint, when the GL context is current.
+	mutable bool glInitialized;
+	mutable QOpenGLBuffer* meshVertices;
+	mutable QOpenGLBuffer* meshIndices;
+	mutable QOpenGLShaderProgram* warpProgram;
+};
+
 #endif // _STELVIEWPORTEFFECT_HPP_
 
@@ -24,65 +24,229 @@
 #include "StelObject.hpp"
 #include "Planet.hpp"
 
-TrailGroup::TrailGroup(float te) : timeExtent(te), opacity(1.f)
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QDebug>
+#include <QtAlgorithms>
+
+TrailGroup::TrailGroup(float te, int amaxPoints)
+	: timeExtent(te)
+	, maxPoints(qMax(amaxPoints, 2))
+	, firstPoint(0)
+	, nbPoints(0)
+	, nbPendingPoints(0)
+	, timeOrigin(0.)
+	, vertexBuffer(NULL)
+	, opacity(1.f)
 {
 	j2000ToTrailNative=Mat4d::identity();
 	j2000ToTrailNativeInverted=Mat4d::identity();
 }
 
-static QVector<Vec3d> vertexArray;
-static QVector<Vec4f> colorArray;
-void TrailGroup::draw(StelCore* core, StelPainter* sPainter)
+TrailGroup::~TrailGroup()
 {
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	float currentTime = core->getJDay();
-	StelProjector::ModelViewTranformP transfo = core->getJ2000ModelViewTransform();
-	transfo->combine(j2000ToTrailNativeInverted);
-	sPainter->setProjector(core->getProjection(transfo));
-	foreach (const Trail& trail, allTrails)
+	if (vertexBuffer)
 	{
-		Planet* hpl = dynamic_cast<Planet*>(trail.stelObject.data());
-		if (hpl!=NULL)
+		vertexBuffer->destroy();
+		delete vertexBuffer;
+		vertexBuffer = NULL;
+	}
+}
+
+QOpenGLShaderProgram* TrailGroup::getProgram(const QByteArray& forwardTransform)
+{
+	static const char* vertexHeader =
+		"attribute highp vec4 point;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"uniform highp float currentTime;\n"
+		"uniform highp float timeExtent;\n"
+		"uniform mediump vec4 color;\n"
+		"varying mediump vec4 outColor;\n";
+	static const char* vertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(point.xyz, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    outColor = vec4(color.rgb, color.a*(1.-(currentTime-point.w)/timeExtent));\n"
+		"}\n";
+
+	static const char* fsrc =
+		"varying mediump vec4 outColor;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_FragColor = outColor;\n"
+		"}\n";
+
+	return StelPainter::getProjectionProgram("trailShader", forwardTransform, vertexHeader, vertexMain, fsrc);
+}
+
+void TrailGroup::uploadPendingPoints()
+{
+	const int nbTrails = allTrails.size();
+	const int slotSize = nbTrails*sizeof(Vec4f);
+	if (!vertexBuffer)
+	{
+		vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		vertexBuffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+		vertexBuffer->create();
+		vertexBuffer->bind();
+		vertexBuffer->allocate(points.constData(), points.size()*sizeof(Vec4f));
+		nbPendingPoints = 0;
+		return;
+	}
+	vertexBuffer->bind();
+	const int nbPending = qMin(nbPendingPoints, nbPoints);
+	if (nbPending==0)
+		return;
+	// The pending slots, which may wrap around the end of the ring buffer
+	const int start = (firstPoint+nbPoints-nbPending)%maxPoints;
+	const int count1 = qMin(nbPending, maxPoints-start);
+	vertexBuffer->write(start*slotSize, points.constData()+start*nbTrails, count1*slotSize);
+	if (count1<nbPending)
+		vertexBuffer->write(0, points.constData(), (nbPending-count1)*slotSize);
+	if (start==0 || count1<nbPending)
+		vertexBuffer->write(maxPoints*slotSize, points.constData()+maxPoints*nbTrails, slotSize);
+	nbPendingPoints = 0;
+}
+
+bool TrailGroup::drawGpu(const StelProjectorP& prj, float currentTime, const QString& homePlanetName)
+{
+	const QByteArray forwardTransform = prj->getForwardTransformShader();
+	if (forwardTransform.isEmpty())
+		return false;
+	QOpenGLShaderProgram* prog = getProgram(forwardTransform);
+	if (!prog)
+		return false;
+
+	uploadPendingPoints();
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+	const Mat4f& m = prj->getProjectionMatrix();
+	// Refraction, if any, is ignored here as in StarGpuDrawer.
+	const Mat4d mv = prj->getModelViewTransform()->getApproximateLinearTransfo();
+	StelPainter::flushPendingText();
+	prog->bind();
+	prog->setUniformValue("projectionMatrix", StelPainter::toQMatrix(m));
+	prog->setUniformValue("modelViewMatrix", StelPainter::toQMatrix(mv));
+	prog->setUniformValue("screenCenter", screenCenter[0], screenCenter[1]);
+	prog->setUniformValue("screenScale", screenScale[0], screenScale[1]);
+	prog->setUniformValue("currentTime", currentTime);
+	prog->setUniformValue("timeExtent", timeExtent);
+
+	const int pointLoc = prog->attributeLocation("point");
+	prog->enableAttributeArray(pointLoc);
+	const int nbTrails = allTrails.size();
+	const int end = firstPoint+nbPoints;
+	for (int k=0;k<nbTrails;++k)
+	{
+		const Trail& trail = allTrails.at(k);
+		if (!trail.planetName.isEmpty() && trail.planetName==homePlanetName)
+			continue;
+		prog->setUniformValue("color", trail.color[0], trail.color[1], trail.color[2], opacity);
+		// The points of one trail are interleaved with the ones of the other trails
+		prog->setAttributeBuffer(pointLoc, GL_FLOAT, k*sizeof(Vec4f), 4, nbTrails*sizeof(Vec4f));
+		if (end<=maxPoints)
+			glDrawArrays(GL_LINE_STRIP, firstPoint, nbPoints);
+		else
 		{
-			// Avoid drawing the trails if the object is the home planet
-			QString homePlanetName = hpl->getEnglishName();
-			if (homePlanetName==StelApp::getInstance().getCore()->getCurrentLocation().planetName)
-				continue;
+			glDrawArrays(GL_LINE_STRIP, firstPoint, maxPoints+1-firstPoint);
+			glDrawArrays(GL_LINE_STRIP, 0, end-maxPoints);
 		}
-		const QList<Vec3d>& posHistory = trail.posHistory;
-		vertexArray.resize(posHistory.size());
-		colorArray.resize(posHistory.size());
-		for (int i=0;i<posHistory.size();++i)
+	}
+	prog->disableAttributeArray(pointLoc);
+	prog->release();
+	vertexBuffer->release();
+	return true;
+}
+
+// The points are projected in double precision, like the other painter fallbacks
+static QVector<Vec3d> vertexArray;
+// The colors packed in 4 bytes, normalized by the painter
+static QVector<GLubyte> colorArray;
+void TrailGroup::drawCpu(StelPainter* sPainter, float currentTime, const QString& homePlanetName)
+{
+	const int nbTrails = allTrails.size();
+	vertexArray.resize(nbPoints);
+	colorArray.resize(nbPoints*4);
+	for (int k=0;k<nbTrails;++k)
+	{
+		const Trail& trail = allTrails.at(k);
+		if (!trail.planetName.isEmpty() && trail.planetName==homePlanetName)
+			continue;
+		const GLubyte r = (GLubyte)(qBound(0.f, trail.color[0], 1.f)*255.f+0.5f);
+		const GLubyte g = (GLubyte)(qBound(0.f, trail.color[1], 1.f)*255.f+0.5f);
+		const GLubyte b = (GLubyte)(qBound(0.f, trail.color[2], 1.f)*255.f+0.5f);
+		for (int i=0;i<nbPoints;++i)
 		{
-			float colorRatio = 1.f-(currentTime-times.at(i))/timeExtent;
-			colorArray[i].set(trail.color[0], trail.color[1], trail.color[2], colorRatio*opacity);
-			vertexArray[i]=posHistory.at(i);
+			const Vec4f& point = points.at(((firstPoint+i)%maxPoints)*nbTrails+k);
+			float colorRatio = 1.f-(currentTime-point[3])/timeExtent;
+			GLubyte* color = colorArray.data()+i*4;
+			color[0] = r;
+			color[1] = g;
+			color[2] = b;
+			color[3] = (GLubyte)(qBound(0.f, colorRatio*opacity, 1.f)*255.f+0.5f);
+			vertexArray[i].set(point[0], point[1], point[2]);
 		}
 		sPainter->setVertexPointer(3, GL_DOUBLE, vertexArray.constData());
-		sPainter->setColorPointer(4, GL_FLOAT, colorArray.constData());
+		sPainter->setColorPointer(4, GL_UNSIGNED_BYTE, colorArray.constData());
 		sPainter->enableClientStates(true, false, true);
 		sPainter->drawFromArray(StelPainter::LineStrip, vertexArray.size(), 0, true);
 		sPainter->enableClientStates(false);
 	}
 }
 
+void TrailGroup::draw(StelCore* core, StelPainter* sPainter)
+{
+	if (nbPoints==0)
+		return;
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	const float currentTime = core->getJDay()-timeOrigin;
+	StelProjector::ModelViewTranformP transfo = core->getJ2000ModelViewTransform();
+	transfo->combine(j2000ToTrailNativeInverted);
+	sPainter->setProjector(core->getProjection(transfo));
+	// Avoid drawing the trails if the object is the home planet
+	const QString homePlanetName = core->getCurrentLocation().planetName;
+	if (!drawGpu(sPainter->getProjector(), currentTime, homePlanetName))
+		drawCpu(sPainter, currentTime, homePlanetName);
+}
+
 // Add 1 point to all the curves at current time and suppress too old points
 void TrailGroup::update()
 {
-	times.append(StelApp::getInstance().getCore()->getJDay());
-	for (QList<Trail>::Iterator iter=allTrails.begin();iter!=allTrails.end();++iter)
+	if (allTrails.isEmpty())
+		return;
+	StelCore* core = StelApp::getInstance().getCore();
+	const double jd = core->getJDay();
+	const int nbTrails = allTrails.size();
+	if (points.isEmpty())
+		points.resize((maxPoints+1)*nbTrails);
+	if (nbPoints==0)
+		timeOrigin = jd;
+
+	// Drop the oldest point when the buffer is full, and the points older than the time extent
+	while (nbPoints>0 && (nbPoints==maxPoints || jd-timeOrigin-points.at(firstPoint*nbTrails)[3]>timeExtent))
 	{
-		iter->posHistory.append(j2000ToTrailNative*iter->stelObject->getJ2000EquatorialPos(StelApp::getInstance().getCore()));
+		firstPoint = (firstPoint+1)%maxPoints;
+		--nbPoints;
 	}
-	if (StelApp::getInstance().getCore()->getJDay()-times.at(0)>timeExtent)
+
+	const int slot = (firstPoint+nbPoints)%maxPoints;
+	const float t = jd-timeOrigin;
+	Vec4f* slotPoints = points.data()+slot*nbTrails;
+	for (int k=0;k<nbTrails;++k)
 	{
-		times.pop_front();
-		for (QList<Trail>::Iterator iter=allTrails.begin();iter!=allTrails.end();++iter)
-		{
-			iter->posHistory.pop_front();
-		}
+		const Vec3d pos = j2000ToTrailNative*allTrails.at(k).stelObject->getJ2000EquatorialPos(core);
+		slotPoints[k].set(pos[0], pos[1], pos[2], t);
 	}
+	if (slot==0)
+		qCopy(slotPoints, slotPoints+nbTrails, points.data()+maxPoints*nbTrails);
+	++nbPoints;
+	nbPendingPoints = qMin(nbPendingPoints+1, maxPoints);
 }
 
 // Set the matrix to use to post process J2000 positions before storing in the trail
@@ -94,14 +258,22 @@ void TrailGroup::setJ2000ToTrailNative(const Mat4d& m)
 
 void TrailGroup::addObject(const StelObjectP& obj, const Vec3f* col)
 {
-	allTrails.append(TrailGroup::Trail(obj, col==NULL ? obj->getInfoColor() : *col));
+	const Planet* planet = dynamic_cast<const Planet*>(obj.data());
+	allTrails.append(TrailGroup::Trail(obj, col==NULL ? obj->getInfoColor() : *col, planet ? planet->getEnglishName() : QString()));
+	// The layout of the ring buffer depends on the number of trails
+	reset();
+	points.clear();
+	if (vertexBuffer)
+	{
+		vertexBuffer->destroy();
+		delete vertexBuffer;
+		vertexBuffer = NULL;
+	}
 }
 
 void TrailGroup::reset()
 {
-	times.clear();
-	for (QList<Trail>::Iterator iter=allTrails.begin();iter!=allTrails.end();++iter)
-	{
-		iter->posHistory.clear();
-	}
+	firstPoint = 0;
+	nbPoints = 0;
+	nbPendingPoints = 0;
 }
@@ -24,12 +24,26 @@
 #include "StelCore.hpp"
 #include "StelObjectType.hpp"
 
-class StelPainter;
+#include <QByteArray>
+#include <QVector>
 
+class StelPainter;
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
+
+//! @class TrailGroup
+//! Draw the trails of a group of objects over the last timeExtent days.
+//! The points of all the trails are kept in a fixed-capacity ring buffer, mirrored in a GPU buffer
+//! in which only the new points are uploaded. When the projection provides a
+//! StelProjector::getForwardTransformShader(), the projection and the fading of the trails are
+//! done in the vertex shader, else the points are projected by the StelPainter.
 class TrailGroup
 {
 public:
-	TrailGroup(float atimeExtent);
+	//! @param atimeExtent maximum time extent of the trails in days.
+	//! @param amaxPoints maximum number of points of each trail, the oldest points are dropped first.
+	TrailGroup(float atimeExtent, int amaxPoints=4096);
+	~TrailGroup();
 
 	void draw(StelCore* core, StelPainter*);
 
@@ -39,6 +53,7 @@ public:
 	// Set the matrix to use to post process J2000 positions before storing in the trail
 	void setJ2000ToTrailNative(const Mat4d& m);
 
+	//! Add an object to the group. The points already recorded are cleared.
 	void addObject(const StelObjectP&, const Vec3f* col=NULL);
 
 	void setOpacity(float op) {opacity=op;}
@@ -50,19 +65,45 @@ private:
 	class Trail
 	{
 	public:
-		Trail(const StelObjectP& obj, const Vec3f& col) : stelObject(obj), color(col) {;}
+		Trail(const StelObjectP& obj, const Vec3f& col, const QString& name) : stelObject(obj), color(col), planetName(name) {;}
 		StelObjectP stelObject;
-		// All previous positions
-		QList<Vec3d> posHistory;
 		Vec3f color;
+		// The english name if the object is a planet, used to skip the trail of the home planet
+		QString planetName;
 	};
 
+	//! Draw the trails with the projection done in the vertex shader.
+	//! @return false if the current projection cannot be performed on the GPU.
+	bool drawGpu(const StelProjectorP& prj, float currentTime, const QString& homePlanetName);
+	//! Draw the trails projected by the StelPainter.
+	void drawCpu(StelPainter* sPainter, float currentTime, const QString& homePlanetName);
+	//! Get or build the shader program for the given forward transform code.
+	QOpenGLShaderProgram* getProgram(const QByteArray& forwardTransform);
+	//! Upload the points added since the last call in the GPU buffer, creating it if needed.
+	void uploadPendingPoints();
+
 	QList<Trail> allTrails;
 
 	// Maximum time extent in days
 	float timeExtent;
 
-	QList<float> times;
+	// Capacity of the ring buffer for each trail
+	int maxPoints;
+
+	//! The ring buffer: the slot s holds the points of all the trails in the order of allTrails at one time,
+	//! with the position in xyz and the time relative to timeOrigin in w. The slot maxPoints is a copy of
+	//! slot 0, so that a trail wrapping around the end of the buffer is drawn with two line strips.
+	QVector<Vec4f> points;
+	//! The slot of the oldest point.
+	int firstPoint;
+	//! The number of points of each trail.
+	int nbPoints;
+	//! The number of newest points which were not uploaded in vertexBuffer yet.
+	int nbPendingPoints;
+	//! Julian day of the times stored in the points.
+	double timeOrigin;
+
+	QOpenGLBuffer* vertexBuffer;
 
 	Mat4d j2000ToTrailNative;
 	Mat4d j2000ToTrailNativeInverted;
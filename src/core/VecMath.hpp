@@ -256,6 +256,12 @@ template<class T> class Matrix4
 	inline Vector4<T> operator*(const Vector4<T>&) const;
 
 	inline void transfo(Vector3<T>&) const;
+	//! Transform an array of vectors in homogeneous coordinate (use a[3]=1).
+	//! The matrix coefficients are kept in local variables so that the loop can be vectorized.
+	inline void transfoArray(int n, Vector3<T>* a) const;
+	//! Apply the inverse transformation to an array of vectors, assuming that the 3x3 part of
+	//! the matrix is orthogonal so that its transposed is its inverse.
+	inline void transfoArrayOrthoInverse(int n, Vector3<T>* a) const;
 
 	static Matrix4<T> identity();
 	static Matrix4<T> translation(const Vector3<T>&);
@@ -951,6 +957,34 @@ template<class T> void Matrix4<T>::transfo(Vector3<T>& a) const
 			r[2]*a.v[0] + r[6]*a.v[1] + r[10]*a.v[2] + r[14]);
 }
 
+template<class T> void Matrix4<T>::transfoArray(int n, Vector3<T>* a) const
+{
+	const T m0=r[0], m1=r[1], m2=r[2], m4=r[4], m5=r[5], m6=r[6];
+	const T m8=r[8], m9=r[9], m10=r[10], m12=r[12], m13=r[13], m14=r[14];
+	for (int i=0; i<n; ++i)
+	{
+		T* v = a[i].v;
+		const T x=v[0], y=v[1], z=v[2];
+		v[0] = m0*x + m4*y +  m8*z + m12;
+		v[1] = m1*x + m5*y +  m9*z + m13;
+		v[2] = m2*x + m6*y + m10*z + m14;
+	}
+}
+
+template<class T> void Matrix4<T>::transfoArrayOrthoInverse(int n, Vector3<T>* a) const
+{
+	const T m0=r[0], m1=r[1], m2=r[2], m4=r[4], m5=r[5], m6=r[6];
+	const T m8=r[8], m9=r[9], m10=r[10], m12=r[12], m13=r[13], m14=r[14];
+	for (int i=0; i<n; ++i)
+	{
+		T* v = a[i].v;
+		const T x=v[0]-m12, y=v[1]-m13, z=v[2]-m14;
+		v[0] = m0*x + m1*y + m2*z;
+		v[1] = m4*x + m5*y + m6*z;
+		v[2] = m8*x + m9*y + m10*z;
+	}
+}
+
 template<class T> Matrix4<T> Matrix4<T>::transpose() const
 {
 	return Matrix4<T>(	r[0], r[4], r[8],  r[12],
@@ -25,8 +25,11 @@
 #include "StelCore.hpp"
 #include "StelPainter.hpp"
 #include "StelFileMgr.hpp"
+#include "StelJobSystem.hpp"
+#include "StelRenderProfile.hpp"
 
 #include <QDebug>
+#include <QFile>
 #include <QSettings>
 #include <QOpenGLShaderProgram>
 
@@ -47,36 +50,50 @@ Atmosphere::Atmosphere(void)
 	, averageLuminance(0.f)
 	, eclipseFactor(1.f)
 	, lightPollutionLuminance(0)
+	, flagGpuLuminance(true)
+	, moonPosition(0.f, 0.f, -1.f)
+	, gridValid(false)
+	, reuseThreshold(0.01f)
+	, rowsPerFrame(0)
+	, rowsToUpdate(0)
+	, nextRow(0)
+	, lastEclipseFactor(1.f)
+	, lastLightPollutionLuminance(0.f)
+	, lastMoonPhase(0.f)
+	, lastYear(0)
+	, lastMonth(0)
 {
 	setFadeDuration(1.5f);
 
-	QOpenGLShader vShader(QOpenGLShader::Vertex);
-	if (!vShader.compileSourceFile(":/shaders/xyYToRGB.glsl"))
-	{
-		qFatal("Error while compiling atmosphere vertex shader: %s", vShader.log().toLatin1().constData());
-	}
-	if (!vShader.log().isEmpty())
-	{
-		qWarning() << "Warnings while compiling atmosphere vertex shader: " << vShader.log();
-	}
-	QOpenGLShader fShader(QOpenGLShader::Fragment);
-	if (!fShader.compileSourceCode(
-					"varying mediump vec3 resultSkyColor;\n"
-					"void main()\n"
-					"{\n"
-					 "   gl_FragColor = vec4(resultSkyColor, 1.);\n"
-					 "}"))
+	QSettings* conf = StelApp::getInstance().getSettings();
+	flagGpuLuminance = conf->value("landscape/flag_atmosphere_gpu_luminance", true).toBool();
+	reuseThreshold = conf->value("landscape/atmosphere_reuse_threshold", 0.01).toFloat();
+	rowsPerFrame = conf->value("landscape/atmosphere_rows_per_frame", 0).toInt();
+	const StelRenderProfile* profile = StelApp::getInstance().getRenderProfile();
+	if (profile->getAtmosphereRowsPerFrame()>=0)
+		rowsPerFrame = profile->getAtmosphereRowsPerFrame();
+
+	QFile vShaderFile(":/shaders/xyYToRGB.glsl");
+	if (!vShaderFile.open(QIODevice::ReadOnly))
 	{
-		qFatal("Error while compiling atmosphere fragment shader: %s", fShader.log().toLatin1().constData());
+		qFatal("Cannot open atmosphere vertex shader: %s", vShaderFile.errorString().toLatin1().constData());
 	}
-	if (!fShader.log().isEmpty())
+	QByteArray vShaderSource = vShaderFile.readAll();
+	vShaderFile.close();
+	if (flagGpuLuminance)
+		vShaderSource.prepend("#define GPU_LUMINANCE\n");
+
+	atmoShaderProgram = new QOpenGLShaderProgram();
+	const QByteArray fShaderSource =
+		"varying mediump vec3 resultSkyColor;\n"
+		"void main()\n"
+		"{\n"
+		"   gl_FragColor = vec4(resultSkyColor, 1.);\n"
+		"}";
+	if (!StelPainter::buildProg(atmoShaderProgram, "atmosphere", vShaderSource, fShaderSource))
 	{
-		qWarning() << "Warnings while compiling atmosphere fragment shader: " << vShader.log();
+		qFatal("Error while building atmosphere shader program: %s", atmoShaderProgram->log().toLatin1().constData());
 	}
-	atmoShaderProgram = new QOpenGLShaderProgram();
-	atmoShaderProgram->addShader(&vShader);
-	atmoShaderProgram->addShader(&fShader);
-	StelPainter::linkProg(atmoShaderProgram, "atmosphere");
 
 	atmoShaderProgram->bind();
 	shaderAttribLocations.alphaWaOverAlphaDa = atmoShaderProgram->uniformLocation("alphaWaOverAlphaDa");
@@ -96,6 +113,15 @@ Atmosphere::Atmosphere(void)
 	shaderAttribLocations.Cy = atmoShaderProgram->uniformLocation("Cy");
 	shaderAttribLocations.Dy = atmoShaderProgram->uniformLocation("Dy");
 	shaderAttribLocations.Ey = atmoShaderProgram->uniformLocation("Ey");
+	shaderAttribLocations.moonPos = atmoShaderProgram->uniformLocation("moonPos");
+	shaderAttribLocations.K = atmoShaderProgram->uniformLocation("K");
+	shaderAttribLocations.C3 = atmoShaderProgram->uniformLocation("C3");
+	shaderAttribLocations.C4 = atmoShaderProgram->uniformLocation("C4");
+	shaderAttribLocations.bMoonTerm1 = atmoShaderProgram->uniformLocation("bMoonTerm1");
+	shaderAttribLocations.bTwilightTerm = atmoShaderProgram->uniformLocation("bTwilightTerm");
+	shaderAttribLocations.bNightTerm = atmoShaderProgram->uniformLocation("bNightTerm");
+	shaderAttribLocations.eclipseFactor = atmoShaderProgram->uniformLocation("eclipseFactor");
+	shaderAttribLocations.lightPollutionLuminance = atmoShaderProgram->uniformLocation("lightPollutionLuminance");
 	shaderAttribLocations.projectionMatrix = atmoShaderProgram->uniformLocation("projectionMatrix");
 	shaderAttribLocations.skyVertex = atmoShaderProgram->attributeLocation("skyVertex");
 	shaderAttribLocations.skyColor = atmoShaderProgram->attributeLocation("skyColor");
@@ -112,7 +138,18 @@ Atmosphere::~Atmosphere(void)
 	atmoShaderProgram = NULL;
 }
 
-void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moonPhase,
+//! Compute the rows of the grid given to blockingMap() by Atmosphere::computeColor().
+struct Atmosphere::GridRowComputer
+{
+	Atmosphere* atmosphere;
+	const StelProjector* prj;
+	const float* sunPos;
+	const float* moonPos;
+	int lumStep;
+	void operator()(int row) const {atmosphere->computeGridRow(prj, row, sunPos, moonPos, lumStep);}
+};
+
+void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moonPhase, float solarEclipseFactor,
 							   StelCore* core, float latitude, float altitude, float temperature, float relativeHumidity)
 {
 	const StelProjectorP prj = core->getProjection(StelCore::FrameAltAz, StelCore::RefractionOff);
@@ -123,6 +160,8 @@ void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moo
 		delete[] colorGrid;
 		delete [] posGrid;
 		skyResolutionY = StelApp::getInstance().getSettings()->value("landscape/atmosphereybin", 44).toInt();
+		if (StelApp::getInstance().getRenderProfile()->getAtmosphereResolution()>0)
+			skyResolutionY = StelApp::getInstance().getRenderProfile()->getAtmosphereResolution();
 		skyResolutionX = (int)floor(0.5+skyResolutionY*(0.5*sqrt(3.0))*prj->getViewportWidth()/prj->getViewportHeight());
 		posGrid = new Vec2f[(1+skyResolutionX)*(1+skyResolutionY)];
 		colorGrid = new Vec4f[(1+skyResolutionX)*(1+skyResolutionY)];
@@ -179,6 +218,10 @@ void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moo
 		colorGridBuffer.bind();
 		colorGridBuffer.allocate(colorGrid, (1+skyResolutionX)*(1+skyResolutionY)*4*4);
 		colorGridBuffer.release();
+
+		rowLuminanceSum.fill(0.f, 1+skyResolutionY);
+		rowLuminanceCount.fill(0, 1+skyResolutionY);
+		gridValid = false;
 	}
 
 	if (myisnan(_sunPos.length()))
@@ -186,46 +229,17 @@ void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moo
 	if (myisnan(moonPos.length()))
 		moonPos.set(0.,0.,-1.*AU);
 
-	// Update the eclipse intensity factor to apply on atmosphere model
-	// these are for radii
-	const float sun_angular_size = atan(696000.f/AU/_sunPos.length());
-	const float moon_angular_size = atan(1738.f/AU/moonPos.length());
-	const float touch_angle = sun_angular_size + moon_angular_size;
-
-	// determine luminance falloff during solar eclipses
 	_sunPos.normalize();
 	moonPos.normalize();
-	float separation_angle = std::acos(_sunPos.dot(moonPos));  // angle between them
-	// qDebug("touch at %f\tnow at %f (%f)\n", touch_angle, separation_angle, separation_angle/touch_angle);
-	// bright stars should be visible at total eclipse
-	// TODO: correct for atmospheric diffusion
-	// TODO: use better coverage function (non-linear)
-	// because of above issues, this algorithm darkens more quickly than reality
-	if (separation_angle < touch_angle)
-	{
-		float dark_angle = moon_angular_size - sun_angular_size;
-		float min = 0.0001f;  // so bright stars show up at total eclipse
-		if (dark_angle < 0.f)
-		{
-			// annular eclipse
-			float asun = sun_angular_size*sun_angular_size;
-			min = (asun - moon_angular_size*moon_angular_size)/asun;  // minimum proportion of sun uncovered
-			dark_angle *= -1;
-		}
-
-		if (separation_angle < dark_angle)
-			eclipseFactor = min;
-		else
-			eclipseFactor = min + (1.f-min)*(separation_angle-dark_angle)/(touch_angle-dark_angle);
-	}
-	else
-		eclipseFactor = 1.f;
+	// The eclipse intensity factor to apply on atmosphere model, computed once per frame by the SolarSystem
+	eclipseFactor = solarEclipseFactor;
 
 
 	// No need to calculate if not visible
 	if (!fader.getInterstate())
 	{
 		averageLuminance = 0.001f + lightPollutionLuminance;
+		gridValid = false;
 		return;
 	}
 
@@ -239,6 +253,7 @@ void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moo
 	moon_pos[0] = moonPos[0];
 	moon_pos[1] = moonPos[1];
 	moon_pos[2] = moonPos[2];
+	moonPosition.set(moon_pos[0], moon_pos[1], moon_pos[2]);
 
 	sky.setParamsv(sunPos, 5.f);
 
@@ -250,14 +265,109 @@ void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moo
 	StelUtils::getDateFromJulianDay(JD, &year, &month, &day);
 	skyb.setDate(year, month, moonPhase);
 
-	// Variables used to compute the average sky luminance
+	// Reuse the grid computed in the previous frames while the view and the inputs don't move.
+	// The view is compared through the directions of the corners and the center of the grid,
+	// which change with the orientation, the field of view and the type of the projection.
+	const int nbPoints = (1+skyResolutionX)*(1+skyResolutionY);
+	const int nbRows = 1+skyResolutionY;
+	bool viewChanged = !gridValid;
+	const int viewPointIndices[5] = {0, skyResolutionX, nbPoints-1-skyResolutionX, nbPoints-1, nbPoints/2};
+	Vec3d point(1., 0., 0.);
+	for (int k=0; k<5; ++k)
+	{
+		const Vec2f &v(posGrid[viewPointIndices[k]]);
+		prj->unProject(v[0],v[1],point);
+		if ((point-lastViewDirections[k]).lengthSquared()>1e-12)
+			viewChanged = true;
+		lastViewDirections[k] = point;
+	}
+
+	const Vec3f sunPosf(sunPos[0], sunPos[1], sunPos[2]);
+	const Vec4f location(latitude, altitude, temperature, relativeHumidity);
+	const float cosReuseThreshold = std::cos(reuseThreshold*M_PI/180.);
+	if (viewChanged || reuseThreshold<=0.f
+		|| sunPosf.dot(lastSunPos)<cosReuseThreshold || moonPosition.dot(lastMoonPos)<cosReuseThreshold
+		|| std::fabs(eclipseFactor-lastEclipseFactor)>1e-3f || std::fabs(moonPhase-lastMoonPhase)>1e-3f
+		|| lightPollutionLuminance!=lastLightPollutionLuminance || location!=lastLocation
+		|| year!=lastYear || month!=lastMonth)
+	{
+		lastSunPos = sunPosf;
+		lastMoonPos = moonPosition;
+		lastEclipseFactor = eclipseFactor;
+		lastLightPollutionLuminance = lightPollutionLuminance;
+		lastMoonPhase = moonPhase;
+		lastLocation = location;
+		lastYear = year;
+		lastMonth = month;
+		rowsToUpdate = nbRows;
+	}
+	gridValid = true;
+	if (rowsToUpdate==0)
+		return;
+
+	// When only the sun or moon moved, the update can be spread over several frames
+	int rowBegin = 0;
+	int rowCount = nbRows;
+	if (viewChanged || rowsPerFrame<=0)
+	{
+		nextRow = 0;
+	}
+	else
+	{
+		rowBegin = nextRow;
+		rowCount = qMin(qMin(rowsPerFrame, rowsToUpdate), nbRows-rowBegin);
+	}
+	rowsToUpdate -= rowCount;
+	nextRow = (rowBegin+rowCount)%nbRows;
+
+	// When the luminance is computed in the shader, only evaluate it on the CPU for a subsample
+	// of the grid, which is enough for the average luminance used by the tone reproducer.
+	// Reading back the luminance computed on the GPU would stall the pipeline instead.
+	const int lumStep = flagGpuLuminance ? qMax(2, skyResolutionY/22) : 1;
+
+	// The rows are independent, they are computed on the thread pool
+	static const int minRowsPerJob = 4;
+	gridRows.resize(0);
+	for (int row=rowBegin; row<rowBegin+rowCount; ++row)
+		gridRows.append(row);
+	const GridRowComputer computer = {this, prj.data(), sunPos, moon_pos, lumStep};
+	StelApp::getInstance().getJobSystem()->blockingMap(gridRows, computer, minRowsPerJob);
+
+	const int pointBegin = rowBegin*(1+skyResolutionX);
+	const int pointEnd = (rowBegin+rowCount)*(1+skyResolutionX);
+	colorGridBuffer.bind();
+	colorGridBuffer.write(pointBegin*4*4, colorGrid+pointBegin, (pointEnd-pointBegin)*4*4);
+	colorGridBuffer.release();
+	
+	// Update average luminance
 	float sum_lum = 0.f;
+	int nb_lum = 0;
+	for (int row=0; row<nbRows; ++row)
+	{
+		sum_lum += rowLuminanceSum[row];
+		nb_lum += rowLuminanceCount[row];
+	}
+	if (nb_lum>0)
+		averageLuminance = sum_lum/nb_lum;
+}
 
-	Vec3d point(1., 0., 0.);
-	float lumi;
+void Atmosphere::computeGridRow(const StelProjector* prj, int row, const float* sunPos, const float* moonPos, int lumStep)
+{
+	// Indices of the grid points for which the luminance is computed in the current batch
+	int batchIndices[Skybright::BatchSize];
+	float batchCosDistMoon[Skybright::BatchSize];
+	float batchCosDistSun[Skybright::BatchSize];
+	float batchCosDistZenith[Skybright::BatchSize];
+	float batchLuminance[Skybright::BatchSize];
+	int batchSize = 0;
+	float luminanceSum = 0.f;
+	int luminanceCount = 0;
 
 	// Compute the sky color for every point above the ground
-	for (int i=0; i<(1+skyResolutionX)*(1+skyResolutionY); ++i)
+	const int pointBegin = row*(1+skyResolutionX);
+	const int pointEnd = (row+1)*(1+skyResolutionX);
+	Vec3d point(1., 0., 0.);
+	for (int i=pointBegin; i<pointEnd; ++i)
 	{
 		const Vec2f &v(posGrid[i]);
 		prj->unProject(v[0],v[1],point);
@@ -271,38 +381,49 @@ void Atmosphere::computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moo
 			// it looks nice and gives proper values for brightness estimation
 		}
 
-		// Use the Skybright.cpp 's models for brightness which gives better results.
-		lumi = skyb.getLuminance(moon_pos[0]*point[0]+moon_pos[1]*point[1]+
-				moon_pos[2]*point[2], sunPos[0]*point[0]+sunPos[1]*point[1]+
-				sunPos[2]*point[2], point[2]);
-		lumi *= eclipseFactor;
-		// Add star background luminance
-		lumi += 0.0001f;
-		// Multiply by the input scale of the ToneConverter (is not done automatically by the xyYtoRGB method called later)
-		//lumi*=eye->getInputScale();
-
-		// Add the light pollution luminance AFTER the scaling to avoid scaling it because it is the cause
-		// of the scaling itself
-		lumi += lightPollutionLuminance;
-
-		// Store for later statistics
-		sum_lum+=lumi;
-
 		// Now need to compute the xy part of the color component
 		// This is done in the openGL shader
 		// Store the back projected position + luminance in the input color to the shader
-		colorGrid[i].set(point[0], point[1], point[2], lumi);
-	}
-	
-	colorGridBuffer.bind();
-	colorGridBuffer.write(0, colorGrid, (1+skyResolutionX)*(1+skyResolutionY)*4*4);
-	colorGridBuffer.release();
-	
-	// Update average luminance
-	averageLuminance = sum_lum/((1+skyResolutionX)*(1+skyResolutionY));
-}
+		colorGrid[i].set(point[0], point[1], point[2], 1.f);
 
+		// When the luminance is computed in the shader, only the position is needed for most points
+		if (lumStep==1 || ((i%(1+skyResolutionX))%lumStep==0 && (i/(1+skyResolutionX))%lumStep==0))
+		{
+			batchIndices[batchSize] = i;
+			batchCosDistMoon[batchSize] = moonPos[0]*point[0]+moonPos[1]*point[1]+moonPos[2]*point[2];
+			batchCosDistSun[batchSize] = sunPos[0]*point[0]+sunPos[1]*point[1]+sunPos[2]*point[2];
+			batchCosDistZenith[batchSize] = point[2];
+			++batchSize;
+		}
+		if (batchSize==0 || (batchSize<Skybright::BatchSize && i<pointEnd-1))
+			continue;
 
+		// Use the Skybright.cpp 's models for brightness which gives better results.
+		skyb.getLuminancev(batchCosDistMoon, batchCosDistSun, batchCosDistZenith, batchLuminance, batchSize);
+		for (int j=0; j<batchSize; ++j)
+		{
+			float lumi = batchLuminance[j]*eclipseFactor;
+			// Add star background luminance
+			lumi += 0.0001f;
+			// Multiply by the input scale of the ToneConverter (is not done automatically by the xyYtoRGB method called later)
+			//lumi*=eye->getInputScale();
+
+			// Add the light pollution luminance AFTER the scaling to avoid scaling it because it is the cause
+			// of the scaling itself
+			lumi += lightPollutionLuminance;
+
+			// Store for later statistics
+			luminanceSum += lumi;
+			++luminanceCount;
+			colorGrid[batchIndices[j]][3] = lumi;
+		}
+		batchSize = 0;
+	}
+
+	// Each row is computed by a single job
+	rowLuminanceSum.data()[row] = luminanceSum;
+	rowLuminanceCount.data()[row] = luminanceCount;
+}
 
 // Draw the atmosphere using the precalc values stored in tab_sky
 void Atmosphere::draw(StelCore* core)
@@ -322,6 +443,7 @@ void Atmosphere::draw(StelCore* core)
 
 	const float atm_intensity = fader.getInterstate();
 
+	StelPainter::flushPendingText();
 	atmoShaderProgram->bind();
 	float a, b, c;
 	eye->getShadersParams(a, b, c);
@@ -345,9 +467,22 @@ void Atmosphere::draw(StelCore* core)
 	atmoShaderProgram->setUniformValue(shaderAttribLocations.Cy, Cy);
 	atmoShaderProgram->setUniformValue(shaderAttribLocations.Dy, Dy);
 	atmoShaderProgram->setUniformValue(shaderAttribLocations.Ey, Ey);
+	if (flagGpuLuminance)
+	{
+		float K, C3, C4, bMoonTerm1, bTwilightTerm, bNightTerm;
+		skyb.getShadersParams(K, C3, C4, bMoonTerm1, bTwilightTerm, bNightTerm);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.moonPos, moonPosition[0], moonPosition[1], moonPosition[2]);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.K, K);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.C3, C3);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.C4, C4);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.bMoonTerm1, bMoonTerm1);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.bTwilightTerm, bTwilightTerm);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.bNightTerm, bNightTerm);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.eclipseFactor, eclipseFactor);
+		atmoShaderProgram->setUniformValue(shaderAttribLocations.lightPollutionLuminance, lightPollutionLuminance);
+	}
 	const Mat4f& m = sPainter.getProjector()->getProjectionMatrix();
-	atmoShaderProgram->setUniformValue(shaderAttribLocations.projectionMatrix,
-		QMatrix4x4(m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]));
+	atmoShaderProgram->setUniformValue(shaderAttribLocations.projectionMatrix, StelPainter::toQMatrix(m));
 	
 	colorGridBuffer.bind();
 	atmoShaderProgram->setAttributeBuffer(shaderAttribLocations.skyColor, GL_FLOAT, 0, 4, 0);
@@ -28,6 +28,7 @@
 #include "StelFader.hpp"
 
 #include <QOpenGLBuffer>
+#include <QVector>
 
 class StelProjector;
 class StelToneReproducer;
@@ -42,7 +43,8 @@ public:
 	Atmosphere();
 	virtual ~Atmosphere();
 	
-	void computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moonPhase, StelCore* core,
+	//! @param solarEclipseFactor the fraction of the Sun not hidden by the Moon, see SolarSystem::getSolarEclipseFactor().
+	void computeColor(double JD, Vec3d _sunPos, Vec3d moonPos, float moonPhase, float solarEclipseFactor, StelCore* core,
 		float latitude = 45.f, float altitude = 200.f,
 		float temperature = 15.f, float relativeHumidity = 40.f);
 	void draw(StelCore* core);
@@ -94,6 +96,42 @@ private:
 	LinearFader fader;
 	float lightPollutionLuminance;
 
+	//! Whether the luminance is computed in the vertex shader rather than for each point of the grid.
+	//! The CPU then only evaluates a subsample of the grid to get the average luminance.
+	bool flagGpuLuminance;
+	//! The normalized moon position of the last call to computeColor, used by the shader.
+	Vec3f moonPosition;
+
+	//! Whether the grid contains the result of a previous computation which can be reused.
+	bool gridValid;
+	//! Minimum angle in degree the sun or the moon have to move before the grid is recomputed.
+	//! If not positive, the grid is recomputed at each frame.
+	float reuseThreshold;
+	//! Number of rows of the grid recomputed at each frame when only the sun or moon moved.
+	//! If not positive, the whole grid is recomputed at once.
+	int rowsPerFrame;
+	//! Number of rows still to recompute with the current inputs, and the next one to compute.
+	int rowsToUpdate;
+	int nextRow;
+	//! The sum and number of the luminances computed in each row, for the average luminance.
+	QVector<float> rowLuminanceSum;
+	QVector<int> rowLuminanceCount;
+	//! The rows computed in the current frame, distributed to the thread pool.
+	QVector<int> gridRows;
+	struct GridRowComputer;
+	//! Compute the positions and luminances of one row of the grid, thread safe for different rows.
+	void computeGridRow(const StelProjector* prj, int row, const float* sunPos, const float* moonPos, int lumStep);
+	//! Inputs used for the current grid, compared to the new ones to detect changes.
+	Vec3f lastSunPos;
+	Vec3f lastMoonPos;
+	float lastEclipseFactor;
+	float lastLightPollutionLuminance;
+	float lastMoonPhase;
+	Vec4f lastLocation;
+	int lastYear, lastMonth;
+	//! Directions of some points of the grid, to detect changes of the view or the projection.
+	Vec3d lastViewDirections[5];
+
 	//! Vertex shader used for xyYToRGB computation
 	class QOpenGLShaderProgram* atmoShaderProgram;
 	struct {
@@ -104,6 +142,11 @@ private:
 		int sunPos;
 		int term_x, Ax, Bx, Cx, Dx, Ex;
 		int term_y, Ay, By, Cy, Dy, Ey;
+		int moonPos;
+		int K, C3, C4;
+		int bMoonTerm1, bTwilightTerm, bNightTerm;
+		int eclipseFactor;
+		int lightPollutionLuminance;
 		int projectionMatrix;
 		int skyVertex;
 		int skyColor;
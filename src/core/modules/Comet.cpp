@@ -40,6 +40,8 @@
 #define COMET_TAIL_SLICES 16 // segments around the perimeter
 #define COMET_TAIL_STACKS 16 // cuts along the rotational axis
 
+const float Comet::TailRebuildTolerance = 0.01f;
+
 Comet::Comet(const QString& englishName,
 		 int flagLighting,
 		 double radius,
@@ -72,7 +74,11 @@ Comet::Comet(const QString& englishName,
 		  pType),
 	  dustTailWidthFactor(dustTailWidthFact),
 	  dustTailLengthFactor(dustTailLengthFact),
-	  dustTailBrightnessFactor(dustTailBrightnessFact)
+	  dustTailBrightnessFactor(dustTailBrightnessFact),
+	  gasTailScale(1., 1., 1.),
+	  gasTailZShift(0.),
+	  comaRadius(0.),
+	  dustTailParams(0.f, 0.f, 0.f)
 {
 	texMapName = atexMapName;
 	lastOrbitJD =0;
@@ -151,8 +157,8 @@ QString Comet::getInfoString(const StelCore *core, const InfoStringGroup &flags)
 
 	if (flags&ObjectType)
 	{
-		if (pType.length()>0)
-			oss << q_("Type: <b>%1</b>").arg(q_(pType)) << "<br />";
+		if (!pType.isEmpty())
+			oss << q_("Type: <b>%1</b>").arg(q_(pType.toString())) << "<br />";
 	}
 
 	if (flags&Magnitude)
@@ -253,13 +259,13 @@ double Comet::getSiderealPeriod() const
 	return period;
 }
 
-float Comet::getVMagnitude(const StelCore* core) const
+float Comet::computeVMagnitude(const StelCore* core) const
 {
 	//If the two parameter system is not used,
 	//use the default radius/albedo mechanism
 	if (slopeParameter < 0)
 	{
-		return Planet::getVMagnitude(core);
+		return Planet::computeVMagnitude(core);
 	}
 
 	//Calculate distances
@@ -280,6 +286,16 @@ float Comet::getVMagnitude(const StelCore* core) const
 }
 
 // Draw the Comet and all the related infos : name, circle etc... GZ: Taken from Planet.cpp 2013-11-05 and extended
+bool Comet::hasVisibleOrbit(const StelCore* core, const StelProjectorP& prj) const
+{
+	// Like in draw(), nothing is drawn out of the useful date range of the elements
+	const CometOrbit* orbit=(const CometOrbit*)userDataPtr;
+	Q_ASSERT(orbit);
+	if (!orbit->objectDateValid(core->getJDay()))
+		return false;
+	return Planet::hasVisibleOrbit(core, prj);
+}
+
 void Comet::draw(StelCore* core, float maxMagLabels, const QFont& planetNameFont)
 {
 	if (hidden)
@@ -304,15 +320,32 @@ void Comet::draw(StelCore* core, float maxMagLabels, const QFont& planetNameFont
 		// The dust tail is thicker and usually shorter. The factors can be configured in the elements.
 		float dustparameter=gasTailEndRadius*gasTailEndRadius*dustTailWidthFactor*dustTailWidthFactor/(2.0f*dustTailLengthFactor*tailFactors[1]);
 
-		// Find valid parameters to create paraboloid vertex arrays: dustTail, gasTail.
-		computeParabola(gasparameter, gasTailEndRadius, -0.5f*gasparameter, gastailVertexArr,  gastailTexCoordArr, gastailIndices);
+		// The gas tail and the coma are computed once with unit sizes, and scaled in drawTail() and drawComa().
+		// A parabola of parameter 0.5 and radius 1 has z=r², it is scaled by the radius along x and y and
+		// by the length along z, which gives z=r²/2p since p=radius²/2length.
+		if (gastailVertexArr.isEmpty())
+		{
+			computeParabola(0.5f, 1.f, 0.f, gastailVertexArr,  gastailTexCoordArr, gastailIndices);
+			computeComa(2.f);
+		}
+		gasTailScale.set(gasTailEndRadius, gasTailEndRadius, tailFactors[1]);
+		gasTailZShift = -0.5f*gasparameter;
+		// Note that we use a diameter larger than what the formula returns. A scale factor of 1.2 is ad-hoc/empirical (GZ), but may look better.
+		comaRadius = 0.5f*tailFactors[0];
+
 		// This was for a rotated straight parabola:
 		//computeParabola(dustparameter, 2.0f*tailFactors[0], -0.5f*dustparameter, dusttailVertexArr, dusttailTexCoordArr, dusttailIndices);
 		// Now we make a skewed parabola. Skew factor 15 (last arg) ad-hoc/empirical. TBD later: Find physically correct solution.
-		computeParabola(dustparameter, dustTailWidthFactor*gasTailEndRadius, -0.5f*dustparameter, dusttailVertexArr, gastailTexCoordArr, gastailIndices, 25.0f*orbit->getVelocity().length());
-
-		// Note that we use a diameter larger than what the formula returns. A scale factor of 1.2 is ad-hoc/empirical (GZ), but may look better.
-		computeComa(1.0f*tailFactors[0]);
+		// The bend can't be obtained by scaling, so the dust tail is only computed again when its shape changed noticeably.
+		const Vec3f dustParams(dustparameter, dustTailWidthFactor*gasTailEndRadius, 25.0f*orbit->getVelocity().length());
+		bool dustTailChanged = dusttailVertexArr.isEmpty();
+		for (int i=0; i<3 && !dustTailChanged; ++i)
+			dustTailChanged = std::fabs(dustParams[i]-dustTailParams[i]) > TailRebuildTolerance*qMax(std::fabs(dustParams[i]), std::fabs(dustTailParams[i]));
+		if (dustTailChanged)
+		{
+			computeParabola(dustParams[0], dustParams[1], -0.5f*dustParams[0], dusttailVertexArr, gastailTexCoordArr, gastailIndices, dustParams[2]);
+			dustTailParams = dustParams;
+		}
 		orbit->setUpdateTails(false); // don't update until position has been recalculated elsewhere
 	}
 
@@ -343,9 +376,6 @@ void Comet::draw(StelCore* core, float maxMagLabels, const QFont& planetNameFont
 		float ang_dist = 300.f*atan(getEclipticPos().length()/getEquinoxEquatorialPos(core).length())/core->getMovementMgr()->getCurrentFov();
 		// if (ang_dist==0.f) ang_dist = 1.f; // if ang_dist == 0, the Planet is sun.. --> GZ: we can remove it.
 
-		// by putting here, only draw orbit if Comet is visible for clarity
-		drawOrbit(core);  // TODO - fade in here also...
-
 		if (flagLabels && ang_dist>0.25 && maxMagLabels>getVMagnitude(core))
 		{
 			labelsFader=true;
@@ -375,7 +405,11 @@ void Comet::drawTail(StelCore* core, StelProjector::ModelViewTranformP transfo,
 
 	StelProjector::ModelViewTranformP transfo2 = transfo->clone();
 	transfo2->combine(tailrot);
-	if (!gas) {
+	if (gas) {
+		// Scale the unit parabola, see draw()
+		transfo2->combine(Mat4d::translation(Vec3d(0.0, 0.0, gasTailZShift)) * Mat4d::scaling(gasTailScale));
+	}
+	else {
 		CometOrbit* orbit=(CometOrbit*)userDataPtr;
 		Vec3d velocity=orbit->getVelocity(); // [AU/d]
 		// This was a try to rotate a straight parabola somewhat away from the antisolar direction.
@@ -442,7 +476,7 @@ void Comet::drawComa(StelCore* core, StelProjector::ModelViewTranformP transfo)
 	Vec3d eclposNrm=eclipticPos - core->getObserverHeliocentricEclipticPos()  ; eclposNrm.normalize();
 	Mat4d comarot=Mat4d::rotation(Vec3d(0.0, 0.0, 1.0)^(eclposNrm), std::acos(Vec3d(0.0, 0.0, 1.0).dot(eclposNrm)) );
 	StelProjector::ModelViewTranformP transfo2 = transfo->clone();
-	transfo2->combine(comarot);
+	transfo2->combine(comarot * Mat4d::scaling(comaRadius));
 	StelPainter* sPainter = new StelPainter(core->getProjection(transfo2));
 
 	glEnable(GL_BLEND);
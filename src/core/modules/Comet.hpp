@@ -72,7 +72,7 @@ public:
 	//was not designed to handle different types of objects.
 	//virtual QString getType() const {return "Comet";}
 	//! \todo Find better sources for the g,k system
-	virtual float getVMagnitude(const StelCore* core) const;
+	virtual float computeVMagnitude(const StelCore* core) const;
 
 	//! \brief sets absolute magnitude and slope parameter.
 	//! These are the parameters in the IAU's two-parameter magnitude system
@@ -89,6 +89,8 @@ public:
 
 	//! re-implementation of Planet's draw()
 	virtual void draw(StelCore* core, float maxMagLabels, const QFont& planetNameFont);
+	//! re-implementation of Planet's hasVisibleOrbit(), false out of the date range of the elements.
+	virtual bool hasVisibleOrbit(const StelCore* core, const StelProjectorP& prj) const;
 
 private:
 	//! @returns estimates for (Coma diameter [AU], gas tail length [AU]).
@@ -123,13 +125,22 @@ private:
 	float dustTailWidthFactor;      //!< empirical individual broadening of the dust tail end, compared to the gas tail end. Actually, dust tail width=2*comaWidth*dustTailWidthFactor. Default 1.5
 	float dustTailLengthFactor;     //!< empirical individual length of dust tail relative to gas tail. Taken from ssystem.ini, typical value 0.3..0.5, default 0.4
 	float dustTailBrightnessFactor; //!< empirical individual brightness of dust tail relative to gas tail. Taken from ssystem.ini, default 1.5
-	QVector<double> gastailVertexArr;  // computed frequently, describes parabolic shape (along z axis) of gas tail.
-	QVector<double> dusttailVertexArr; // computed frequently, describes parabolic shape (along z axis) of dust tail.
+	QVector<double> gastailVertexArr;  // computed only once per comet! Unit parabolic shape (along z axis) of gas tail, scaled when drawn.
+	QVector<double> dusttailVertexArr; // computed when it changed noticeably, describes parabolic shape (along z axis) of dust tail.
 	QVector<float> gastailTexCoordArr; // computed only once per comet!
 	//QVector<float> dusttailTexCoordArr; // currently identical to gastailVertexArr, has been taken out.
 	QVector<unsigned short> gastailIndices; // computed only once per comet!
 	//QVector<unsigned short> dusttailIndices; // actually no longer required. Re-use gas tail indices.
-	QVector<double> comaVertexArr;
+	//! Scale and shift along z applied to the unit gas tail parabola.
+	Vec3d gasTailScale;
+	double gasTailZShift;
+	//! Radius applied to the unit coma disk [AU].
+	double comaRadius;
+	//! The parameter, radius and xOffset with which dusttailVertexArr was computed.
+	Vec3f dustTailParams;
+	//! Relative change of a dust tail parameter above which the dust tail is computed again.
+	static const float TailRebuildTolerance;
+	QVector<double> comaVertexArr;  // computed only once per comet! Unit disk, scaled when drawn.
 	QVector<float> comaTexCoordArr;
 	StelTextureSP comaTexture;
 	StelTextureSP gasTailTexture;
@@ -24,6 +24,8 @@
 
 #include "StelTexture.hpp"
 #include "StelPainter.hpp"
+#include "LabelMgr.hpp"
+#include "StelModuleMgr.hpp"
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 
@@ -122,7 +124,7 @@ void Constellation::drawName(StelPainter& sPainter) const
 	if (!nameFader.getInterstate())
 		return;
 	sPainter.setColor(labelColor[0], labelColor[1], labelColor[2], nameFader.getInterstate());
-	sPainter.drawText(XYname[0], XYname[1], nameI18, 0., -sPainter.getFontMetrics().width(nameI18)/2, 0, false);
+	GETSTELMODULE(LabelMgr)->addSkyLabel(sPainter, XYname[0], XYname[1], nameI18, -sPainter.getFontMetrics().width(nameI18)/2, 0, LabelMgr::ConstellationMagnitude);
 }
 
 void Constellation::drawArtOptim(StelPainter& sPainter, const SphericalRegion& region) const
@@ -42,6 +42,7 @@ class StelPainter;
 class Constellation : public StelObject
 {
 	friend class ConstellationMgr;
+	friend class ConstellationGpuDrawer;
 private:
 	Constellation();
 	~Constellation();
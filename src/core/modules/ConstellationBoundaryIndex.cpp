@@ -0,0 +1,188 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "ConstellationBoundaryIndex.hpp"
+
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+
+static const double TwoPi = 2.*M_PI;
+
+// Bring an angle in [0, 2pi)
+static double normalizeRa(double ra)
+{
+	ra = std::fmod(ra, TwoPi);
+	return ra<0. ? ra+TwoPi : ra;
+}
+
+// Bring an angle difference in [-pi, pi)
+static double normalizeDeltaRa(double d)
+{
+	d = normalizeRa(d+M_PI);
+	return d-M_PI;
+}
+
+static void toRaDec(const Vec3d& v, double* ra, double* dec)
+{
+	const double r = std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+	*ra = normalizeRa(std::atan2(v[1], v[0]));
+	*dec = r>0. ? std::asin(qBound(-1., v[2]/r, 1.)) : 0.;
+}
+
+int ConstellationBoundaryIndex::getConstellationIndex(const QString& name)
+{
+	QHash<QString, int>::ConstIterator i = indices.constFind(name);
+	if (i!=indices.constEnd())
+		return i.value();
+	names << name;
+	indices.insert(name, names.size()-1);
+	return names.size()-1;
+}
+
+void ConstellationBoundaryIndex::addBoundary(const std::vector<Vec3f>& points, const QString& constellation1, const QString& constellation2)
+{
+	if (points.size()<2 || constellation1==constellation2)
+		return;
+	if (bins.isEmpty())
+		bins.resize(NbBins);
+	const int c1 = getConstellationIndex(constellation1);
+	const int c2 = getConstellationIndex(constellation2);
+	double ra, dec;
+	toRaDec(Vec3d(points[0][0], points[0][1], points[0][2]), &ra, &dec);
+	for (unsigned int i=1;i<points.size();++i)
+	{
+		Edge e;
+		e.ra1 = ra;
+		e.dec1 = dec;
+		toRaDec(Vec3d(points[i][0], points[i][1], points[i][2]), &ra, &dec);
+		e.dRa = normalizeDeltaRa(ra-e.ra1);
+		e.dec2 = dec;
+		e.constellation1 = c1;
+		e.constellation2 = c2;
+		edges.append(e);
+
+		// Add the edge to all the bins it spans
+		const double start = e.dRa>=0. ? e.ra1 : normalizeRa(e.ra1+e.dRa);
+		const int firstBin = qMin(NbBins-1, (int)(start/TwoPi*NbBins));
+		const int lastBin = (int)((start+std::fabs(e.dRa))/TwoPi*NbBins);
+		for (int b=firstBin;b<=lastBin;++b)
+			bins[b%NbBins].append(edges.size()-1);
+	}
+}
+
+bool ConstellationBoundaryIndex::getCrossing(const Edge& e, double ra, double* dec)
+{
+	if (e.dRa==0.)
+		return false;
+	// The ranges are half open, so that a meridian going through a vertex crosses only one of its edges
+	const double t = normalizeDeltaRa(ra-e.ra1);
+	if (e.dRa>0. ? (t<0. || t>=e.dRa) : (t<e.dRa || t>=0.))
+		return false;
+	*dec = e.dec1 + (e.dec2-e.dec1)*(t/e.dRa);
+	return true;
+}
+
+void ConstellationBoundaryIndex::getCrossings(double ra, double dec, QVector<Crossing>& crossings) const
+{
+	crossings.resize(0);
+	if (bins.isEmpty())
+		return;
+	const QVector<int>& bin = bins.at(qMin(NbBins-1, (int)(ra/TwoPi*NbBins)));
+	for (int i=0;i<bin.size();++i)
+	{
+		Crossing c;
+		if (getCrossing(edges.at(bin.at(i)), ra, &c.dec) && c.dec>dec)
+		{
+			c.edge = bin.at(i);
+			crossings.append(c);
+		}
+	}
+	std::sort(crossings.begin(), crossings.end());
+}
+
+bool ConstellationBoundaryIndex::build()
+{
+	// The constellation of the pole is the one along the northernmost boundary of every meridian
+	poleConstellation = -1;
+	QSet<int> candidates;
+	bool first = true;
+	QVector<Crossing> crossings;
+	for (int i=0;i<8;++i)
+	{
+		getCrossings((i+0.5)*TwoPi/8., -M_PI, crossings);
+		if (crossings.isEmpty())
+			continue;
+		const Edge& e = edges.at(crossings.first().edge);
+		QSet<int> c;
+		c << e.constellation1 << e.constellation2;
+		if (first)
+			candidates = c;
+		else
+			candidates.intersect(c);
+		first = false;
+	}
+	if (candidates.size()!=1)
+		return false;
+	poleConstellation = *candidates.constBegin();
+	return true;
+}
+
+int ConstellationBoundaryIndex::locate(const Vec3d& pos, QVector<Crossing>& crossings) const
+{
+	double ra, dec;
+	toRaDec(pos, &ra, &dec);
+	getCrossings(ra, dec, crossings);
+	int c = poleConstellation;
+	for (int i=0;i<crossings.size();++i)
+	{
+		const Edge& e = edges.at(crossings.at(i).edge);
+		if (e.constellation1==c)
+			c = e.constellation2;
+		else if (e.constellation2==c)
+			c = e.constellation1;
+	}
+	return c;
+}
+
+QString ConstellationBoundaryIndex::getConstellation(const Vec3d& j2000Pos) const
+{
+	if (isEmpty())
+		return QString();
+	QVector<Crossing> crossings;
+	return names.at(locate(j2000Pos, crossings));
+}
+
+QStringList ConstellationBoundaryIndex::getConstellations(const QVector<Vec3d>& j2000Pos) const
+{
+	QStringList result;
+	if (isEmpty())
+	{
+		for (int i=0;i<j2000Pos.size();++i)
+			result << QString();
+		return result;
+	}
+	result.reserve(j2000Pos.size());
+	// The buffer of the crossings is reused for all the positions
+	QVector<Crossing> crossings;
+	crossings.reserve(16);
+	for (int i=0;i<j2000Pos.size();++i)
+		result << names.at(locate(j2000Pos.at(i), crossings));
+	return result;
+}
@@ -0,0 +1,96 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _CONSTELLATIONBOUNDARYINDEX_HPP_
+#define _CONSTELLATIONBOUNDARYINDEX_HPP_
+
+#include "VecMath.hpp"
+
+#include <vector>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+//! @class ConstellationBoundaryIndex
+//! Find the constellation which contains a position, from the boundaries separating the constellations
+//! such as the IAU boundaries of constellations_boundaries.dat.
+//! A position is located by following its meridian from the north pole down to the position. The
+//! constellation containing the pole is known, and each boundary crossed on the way leads from one of
+//! the two constellations it separates to the other one. So the boundaries don't need to be closed
+//! polygons, nor to be given in any order.
+//! The edges of the boundaries are sorted in bins of right ascension, so that only the few edges
+//! crossing the meridian of the position are tested. The queries are thread safe.
+class ConstellationBoundaryIndex
+{
+public:
+	ConstellationBoundaryIndex() : poleConstellation(-1) {}
+
+	//! Add a boundary separating two constellations.
+	//! @param points the vertices of the boundary in the J2000 equatorial frame.
+	void addBoundary(const std::vector<Vec3f>& points, const QString& constellation1, const QString& constellation2);
+	//! Find the constellation containing the north pole, to be called once all the boundaries are added.
+	//! @return false if it could not be found, in which case the index stays empty.
+	bool build();
+	bool isEmpty() const {return poleConstellation<0;}
+
+	//! Get the constellation containing a position.
+	//! @param j2000Pos the position in the J2000 equatorial frame, not necessarily normalized.
+	//! @return the name of the constellation as given to addBoundary(), or an empty string if the index is empty.
+	QString getConstellation(const Vec3d& j2000Pos) const;
+	//! Same as getConstellation() for many positions at once.
+	QStringList getConstellations(const QVector<Vec3d>& j2000Pos) const;
+
+private:
+	//! An edge of a boundary, in radians.
+	struct Edge
+	{
+		double ra1, dec1;
+		//! The right ascension difference to the second vertex, in [-pi, pi).
+		double dRa;
+		double dec2;
+		int constellation1, constellation2;
+	};
+	//! The point where a meridian crosses an edge.
+	struct Crossing
+	{
+		double dec;
+		int edge;
+		bool operator<(const Crossing& c) const {return dec>c.dec;}
+	};
+
+	static const int NbBins = 360;
+
+	int getConstellationIndex(const QString& name);
+	//! Get the declination at which an edge crosses a meridian.
+	//! @return false if the edge doesn't cross it.
+	static bool getCrossing(const Edge& e, double ra, double* dec);
+	//! Find the crossings of a meridian above a declination, sorted from the north.
+	void getCrossings(double ra, double dec, QVector<Crossing>& crossings) const;
+	int locate(const Vec3d& pos, QVector<Crossing>& crossings) const;
+
+	QStringList names;
+	QHash<QString, int> indices;
+	QVector<Edge> edges;
+	//! The edges crossing each bin of right ascension.
+	QVector<QVector<int> > bins;
+	int poleConstellation;
+};
+
+#endif // _CONSTELLATIONBOUNDARYINDEX_HPP_
@@ -0,0 +1,689 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "ConstellationGpuDrawer.hpp"
+#include "Constellation.hpp"
+#include "StelApp.hpp"
+#include "StelCore.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+#include "StelTexture.hpp"
+#include "StelTextureMgr.hpp"
+
+#include <cmath>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QPainter>
+#include <QtConcurrent>
+#include <QDebug>
+
+// Maximum angle between two points of the tessellated great circle arcs, in radian.
+static const double MaxArcStep = M_PI/180.;
+// Period after which the lines are rebuilt to follow the proper motion of their stars, in days.
+static const double LinesRebuildPeriod = 365.25;
+// The longest side of the art images in the atlases, and the width of the atlases, in pixels
+static const int ArtTileSize = 256;
+static const int ArtAtlasSize = 2048;
+// The transparent border around each image, so that the small mipmaps don't mix the neighbour images too much
+static const int ArtTilePadding = 4;
+
+ConstellationGpuDrawer::ConstellationGpuDrawer()
+	: linesJD(0.)
+	, atlasPending(false)
+{
+}
+
+ConstellationGpuDrawer::~ConstellationGpuDrawer()
+{
+	atlasFuture.waitForFinished();
+	for (int i=0;i<NbCategories;++i)
+	{
+		Geometry& geom = geometries[i];
+		clearGeometry((Category)i);
+		if (geom.vertexBuffer)
+		{
+			geom.vertexBuffer->destroy();
+			delete geom.vertexBuffer;
+			geom.vertexBuffer = NULL;
+		}
+		if (geom.fadeBuffer)
+		{
+			geom.fadeBuffer->destroy();
+			delete geom.fadeBuffer;
+			geom.fadeBuffer = NULL;
+		}
+	}
+}
+
+void ConstellationGpuDrawer::clearGeometry(Category category)
+{
+	Geometry& geom = geometries[category];
+	geom.vertices.clear();
+	geom.texCoords.clear();
+	geom.atlasTexCoords.clear();
+	geom.fades.clear();
+	geom.ranges.clear();
+	geom.uploaded = false;
+}
+
+void ConstellationGpuDrawer::clear()
+{
+	for (int i=0;i<NbCategories;++i)
+		clearGeometry((Category)i);
+	artAsterisms.clear();
+	artSources.clear();
+	atlasPending = false;
+	atlasTextures.clear();
+	atlasRanges.clear();
+}
+
+void ConstellationGpuDrawer::beginRange(Geometry& geom, const Constellation* cons)
+{
+	Range range;
+	range.cons = cons;
+	range.first = geom.vertices.size();
+	range.count = 0;
+	range.fade = -1.f;
+	range.atlas = -1;
+	range.tileSize = 0;
+	geom.ranges.append(range);
+}
+
+void ConstellationGpuDrawer::endRange(Geometry& geom)
+{
+	Range& range = geom.ranges.last();
+	range.count = geom.vertices.size()-range.first;
+	geom.fades.resize(geom.vertices.size());
+}
+
+void ConstellationGpuDrawer::addArc(Geometry& geom, const Vec3d& p1, const Vec3d& p2)
+{
+	const double angle = std::acos(qBound(-1., p1*p2, 1.));
+	const int n = qMax(1, (int)std::ceil(angle/MaxArcStep));
+	Vec3d prev = p1;
+	for (int k=1;k<=n;++k)
+	{
+		Vec3d v = p2;
+		if (k<n)
+		{
+			const double t = (double)k/n;
+			v = p1*std::sin((1.-t)*angle) + p2*std::sin(t*angle);
+			v.normalize();
+		}
+		geom.vertices << Vec3f(prev[0], prev[1], prev[2]) << Vec3f(v[0], v[1], v[2]);
+		prev = v;
+	}
+}
+
+void ConstellationGpuDrawer::setLines(const std::vector<Constellation*>& asterisms, const StelCore* core)
+{
+	clear();
+	buildLines(asterisms, core);
+}
+
+void ConstellationGpuDrawer::buildLines(const std::vector<Constellation*>& asterisms, const StelCore* core)
+{
+	clearGeometry(Lines);
+	Geometry& geom = geometries[Lines];
+	std::vector<Constellation*>::const_iterator iter;
+	for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
+	{
+		const Constellation* cons = *iter;
+		beginRange(geom, cons);
+		for (unsigned int i=0;i<cons->numberOfSegments;++i)
+		{
+			Vec3d star1 = cons->asterism[2*i]->getJ2000EquatorialPos(core);
+			Vec3d star2 = cons->asterism[2*i+1]->getJ2000EquatorialPos(core);
+			star1.normalize();
+			star2.normalize();
+			addArc(geom, star1, star2);
+		}
+		endRange(geom);
+	}
+	linesJD = core->getJDay();
+}
+
+void ConstellationGpuDrawer::setBoundaries(const std::vector<Constellation*>& asterisms)
+{
+	clearGeometry(SharedBoundaries);
+	clearGeometry(IsolatedBoundaries);
+	for (int c=SharedBoundaries;c<=IsolatedBoundaries;++c)
+	{
+		Geometry& geom = geometries[c];
+		std::vector<Constellation*>::const_iterator iter;
+		for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
+		{
+			const Constellation* cons = *iter;
+			const std::vector<std::vector<Vec3f> *>& segments = c==SharedBoundaries ? cons->sharedBoundarySegments : cons->isolatedBoundarySegments;
+			beginRange(geom, cons);
+			for (unsigned int i=0;i<segments.size();++i)
+			{
+				const std::vector<Vec3f>* points = segments[i];
+				for (unsigned int j=0;j+1<points->size();++j)
+				{
+					const Vec3f& pt1 = points->at(j);
+					const Vec3f& pt2 = points->at(j+1);
+					// Same test as Constellation::drawBoundaryOptim()
+					if (pt1*pt2>0.9999999f)
+						continue;
+					addArc(geom, Vec3d(pt1[0], pt1[1], pt1[2]), Vec3d(pt2[0], pt2[1], pt2[2]));
+				}
+			}
+			endRange(geom);
+		}
+	}
+}
+
+void ConstellationGpuDrawer::setArt(const std::vector<Constellation*>& asterisms)
+{
+	artAsterisms.clear();
+	artSources.clear();
+	atlasTextures.clear();
+	std::vector<Constellation*>::const_iterator iter;
+	for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
+	{
+		const Constellation* cons = *iter;
+		if (!cons->artTexture || cons->artPolygon.vertex.isEmpty())
+			continue;
+		artAsterisms.push_back(cons);
+		artSources << cons->artTexture->getFullPath();
+	}
+	buildArt(artAsterisms, NULL);
+
+	// The figures are drawn with their own texture until the atlases are packed
+	atlasPending = !artSources.isEmpty();
+	if (atlasPending)
+		atlasFuture = QtConcurrent::run(&ConstellationGpuDrawer::packArtAtlases, artSources);
+}
+
+void ConstellationGpuDrawer::buildArt(const std::vector<const Constellation*>& asterisms, const ArtAtlases* atlases)
+{
+	clearGeometry(Art);
+	atlasRanges.clear();
+	Geometry& geom = geometries[Art];
+	const int nbAtlases = atlases ? atlases->images.size() : 0;
+	// The figures of each atlas are contiguous so that they are drawn with one call,
+	// the ones drawn with their own texture come last.
+	for (int pass=0;pass<=nbAtlases;++pass)
+	{
+		const int atlas = pass<nbAtlases ? pass : -1;
+		const int first = geom.vertices.size();
+		for (unsigned int c=0;c<asterisms.size();++c)
+		{
+			if ((atlases ? atlases->atlasOf.at(c) : -1)!=atlas)
+				continue;
+			const Constellation* cons = asterisms[c];
+			beginRange(geom, cons);
+			Vec4f rect(0.f, 0.f, 1.f, 1.f);
+			if (atlas>=0)
+			{
+				rect = atlases->rects.at(c);
+				geom.ranges.last().atlas = atlas;
+				geom.ranges.last().tileSize = atlases->tileSizes.at(c);
+			}
+			const StelVertexArray& polygon = cons->artPolygon;
+			for (int i=0;i<polygon.vertex.size();++i)
+			{
+				Vec3d v = polygon.vertex.at(i);
+				v.normalize();
+				geom.vertices << Vec3f(v[0], v[1], v[2]);
+				const Vec2f& texCoord = polygon.texCoords.at(i);
+				geom.texCoords << texCoord;
+				geom.atlasTexCoords << Vec2f(rect[0]+texCoord[0]*(rect[2]-rect[0]), rect[1]+texCoord[1]*(rect[3]-rect[1]));
+			}
+			endRange(geom);
+		}
+		if (atlas>=0)
+			atlasRanges << qMakePair(first, geom.vertices.size()-first);
+	}
+}
+
+ConstellationGpuDrawer::ArtAtlases ConstellationGpuDrawer::packArtAtlases(const QStringList& sources)
+{
+	ArtAtlases result;
+	result.sources = sources;
+	result.atlasOf.fill(-1, sources.size());
+	result.rects.resize(sources.size());
+	result.tileSizes.fill(0, sources.size());
+
+	// The compressed textures can't be read by QImage, they stay drawn with their own texture
+	QList<QImage> tiles;
+	for (int i=0;i<sources.size();++i)
+	{
+		QImage image(sources.at(i));
+		if (!image.isNull() && (image.width()>ArtTileSize || image.height()>ArtTileSize))
+			image = image.scaled(ArtTileSize, ArtTileSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+		tiles << image;
+	}
+
+	// Pack the tiles in shelves, starting a new atlas when one is full
+	QVector<QPoint> positions(sources.size());
+	QVector<int> heights;
+	int x = 0, y = 0, shelfHeight = 0;
+	for (int i=0;i<tiles.size();++i)
+	{
+		const QImage& tile = tiles.at(i);
+		if (tile.isNull())
+			continue;
+		const int w = tile.width()+2*ArtTilePadding;
+		const int h = tile.height()+2*ArtTilePadding;
+		if (x+w>ArtAtlasSize)
+		{
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		if (heights.isEmpty() || y+h>ArtAtlasSize)
+		{
+			heights << 0;
+			x = y = shelfHeight = 0;
+		}
+		result.atlasOf[i] = heights.size()-1;
+		positions[i] = QPoint(x+ArtTilePadding, y+ArtTilePadding);
+		x += w;
+		shelfHeight = qMax(shelfHeight, h);
+		heights.last() = qMax(heights.last(), y+shelfHeight);
+	}
+
+	for (int a=0;a<heights.size();++a)
+	{
+		// Power of two sizes for the mipmaps of the old drivers
+		int atlasHeight = 1;
+		while (atlasHeight<heights.at(a))
+			atlasHeight *= 2;
+		QImage atlas(ArtAtlasSize, atlasHeight, QImage::Format_ARGB32);
+		atlas.fill(Qt::transparent);
+		QPainter painter(&atlas);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		for (int i=0;i<tiles.size();++i)
+		{
+			if (result.atlasOf.at(i)!=a)
+				continue;
+			const QImage& tile = tiles.at(i);
+			const QPoint& pos = positions.at(i);
+			painter.drawImage(pos, tile);
+			// Same convention as StelTextureMgr::getSpriteTexRect(), t=0 being the bottom of the image
+			result.rects[i].set((float)pos.x()/ArtAtlasSize, 1.f-(float)(pos.y()+tile.height())/atlasHeight,
+					    (float)(pos.x()+tile.width())/ArtAtlasSize, 1.f-(float)pos.y()/atlasHeight);
+			result.tileSizes[i] = qMax(tile.width(), tile.height());
+		}
+		painter.end();
+		result.images << atlas;
+	}
+	return result;
+}
+
+void ConstellationGpuDrawer::useArtAtlases(const ArtAtlases& atlases)
+{
+	StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	atlasTextures.clear();
+	foreach (const QImage& image, atlases.images)
+	{
+		StelTextureSP tex = texMgr.createTextureFromImage(image, "constellation art atlas", StelTexture::StelTextureParams(true));
+		if (tex.isNull())
+		{
+			qWarning() << "WARNING: Can't create the constellation art atlas texture";
+			atlasTextures.clear();
+			return;
+		}
+		atlasTextures << tex;
+	}
+	buildArt(artAsterisms, &atlases);
+}
+
+QOpenGLShaderProgram* ConstellationGpuDrawer::getProgram(const QByteArray& forwardTransform, bool art)
+{
+	static const char* lineVertexHeader =
+		"attribute highp vec3 vertex;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"attribute mediump float fade;\n"
+		"varying mediump float valid;\n"
+		"varying mediump float outFade;\n";
+	static const char* artVertexHeader =
+		"attribute highp vec3 vertex;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"attribute mediump float fade;\n"
+		"varying mediump float valid;\n"
+		"varying mediump float outFade;\n"
+		"attribute mediump vec2 texCoord;\n"
+		"varying mediump vec2 texc;\n";
+	static const char* lineVertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(vertex, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    valid = win.z < 0.5 ? 0. : 1.;\n"
+		"    outFade = fade;\n"
+		"}\n";
+	static const char* artVertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(vertex, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    valid = win.z < 0.5 ? 0. : 1.;\n"
+		"    outFade = fade;\n"
+		"    texc = texCoord;\n"
+		"}\n";
+
+	// The primitives with a point which can't be projected are discarded, like in OrbitGpuDrawer.
+	static const char* artFsrc =
+		"varying mediump float valid;\n"
+		"varying mediump float outFade;\n"
+		"varying mediump vec2 texc;\n"
+		"uniform sampler2D tex;\n"
+		"void main(void)\n"
+		"{\n"
+		"    if (valid < 0.999 || outFade <= 0.)\n"
+		"        discard;\n"
+		"    gl_FragColor = texture2D(tex, texc)*vec4(outFade, outFade, outFade, 1.);\n"
+		"}\n";
+	static const char* lineFsrc =
+		"varying mediump float valid;\n"
+		"varying mediump float outFade;\n"
+		"uniform mediump vec3 color;\n"
+		"void main(void)\n"
+		"{\n"
+		"    if (valid < 0.999 || outFade <= 0.)\n"
+		"        discard;\n"
+		"    gl_FragColor = vec4(color, outFade);\n"
+		"}\n";
+
+	if (art)
+		return StelPainter::getProjectionProgram("constellationArtGpuShader", forwardTransform, artVertexHeader, artVertexMain, artFsrc);
+	return StelPainter::getProjectionProgram("constellationLinesGpuShader", forwardTransform, lineVertexHeader, lineVertexMain, lineFsrc);
+}
+
+QOpenGLShaderProgram* ConstellationGpuDrawer::bindProgram(const StelProjectorP& prj, bool art)
+{
+	const QByteArray forwardTransform = prj->getForwardTransformShader();
+	if (forwardTransform.isEmpty())
+		return NULL;
+	QOpenGLShaderProgram* prog = getProgram(forwardTransform, art);
+	if (!prog)
+		return NULL;
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+	StelPainter::flushPendingText();
+	prog->bind();
+	prog->setUniformValue("projectionMatrix", StelPainter::toQMatrix(prj->getProjectionMatrix()));
+	// Refraction, if any, is ignored here as in StarGpuDrawer.
+	prog->setUniformValue("modelViewMatrix", StelPainter::toQMatrix(prj->getModelViewTransform()->getApproximateLinearTransfo()));
+	prog->setUniformValue("screenCenter", screenCenter[0], screenCenter[1]);
+	prog->setUniformValue("screenScale", screenScale[0], screenScale[1]);
+	return prog;
+}
+
+bool ConstellationGpuDrawer::prepareLines(Geometry& geom, Category category)
+{
+	if (geom.vertices.isEmpty())
+		return false;
+
+	if (!geom.uploaded)
+	{
+		if (!geom.vertexBuffer)
+		{
+			geom.vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+			geom.vertexBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+			geom.vertexBuffer->create();
+			geom.fadeBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+			geom.fadeBuffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+			geom.fadeBuffer->create();
+		}
+		geom.vertexBuffer->bind();
+		geom.vertexBuffer->allocate(geom.vertices.constData(), geom.vertices.size()*sizeof(Vec3f));
+		geom.fadeBuffer->bind();
+		geom.fadeBuffer->allocate(geom.fades.size()*sizeof(float));
+		for (int i=0;i<geom.ranges.size();++i)
+			geom.ranges[i].fade = -1.f;
+		geom.uploaded = true;
+	}
+
+	// Write the fades of the constellations whose fader changed since the last frame
+	bool visible = false;
+	geom.fadeBuffer->bind();
+	for (int i=0;i<geom.ranges.size();++i)
+	{
+		Range& range = geom.ranges[i];
+		const LinearFader& fader = category==Lines ? range.cons->lineFader : range.cons->boundaryFader;
+		float fade = fader.getInterstate();
+		// Same thresholds as Constellation::drawOptim() and drawBoundaryOptim()
+		if (category==Lines ? fade<=0.0001f : fade==0.f)
+			fade = 0.f;
+		if (fade>0.f)
+			visible = true;
+		if (fade==range.fade || range.count==0)
+			continue;
+		range.fade = fade;
+		float* f = geom.fades.data()+range.first;
+		for (int n=0;n<range.count;++n)
+			f[n] = fade;
+		geom.fadeBuffer->write(range.first*sizeof(float), f, range.count*sizeof(float));
+	}
+	return visible;
+}
+
+void ConstellationGpuDrawer::drawLinesGeometry(QOpenGLShaderProgram* prog, Geometry& geom, const Vec3f& color)
+{
+	const int vertexLoc = prog->attributeLocation("vertex");
+	const int fadeLoc = prog->attributeLocation("fade");
+	prog->setUniformValue("color", color[0], color[1], color[2]);
+
+	geom.vertexBuffer->bind();
+	prog->enableAttributeArray(vertexLoc);
+	prog->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 3);
+	geom.fadeBuffer->bind();
+	prog->enableAttributeArray(fadeLoc);
+	prog->setAttributeBuffer(fadeLoc, GL_FLOAT, 0, 1);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Normal transparency mode
+	glDrawArrays(GL_LINES, 0, geom.vertices.size());
+
+	prog->disableAttributeArray(vertexLoc);
+	prog->disableAttributeArray(fadeLoc);
+	geom.fadeBuffer->release();
+	prog->release();
+}
+
+bool ConstellationGpuDrawer::drawLines(const StelCore* core, const StelProjectorP& prj)
+{
+	QOpenGLShaderProgram* prog = bindProgram(prj, false);
+	if (!prog)
+		return false;
+
+	Geometry& geom = geometries[Lines];
+	if (std::fabs(core->getJDay()-linesJD)>LinesRebuildPeriod && !geom.ranges.isEmpty())
+	{
+		// Follow the proper motion of the stars: rebuild the lines of the same constellations
+		std::vector<Constellation*> asterisms;
+		for (int i=0;i<geom.ranges.size();++i)
+			asterisms.push_back(const_cast<Constellation*>(geom.ranges.at(i).cons));
+		buildLines(asterisms, core);
+	}
+
+	if (prepareLines(geom, Lines))
+		drawLinesGeometry(prog, geom, Constellation::lineColor);
+	else
+		prog->release();
+	return true;
+}
+
+bool ConstellationGpuDrawer::drawBoundaries(const StelProjectorP& prj, bool isolated)
+{
+	QOpenGLShaderProgram* prog = bindProgram(prj, false);
+	if (!prog)
+		return false;
+
+	Geometry& geom = geometries[isolated ? IsolatedBoundaries : SharedBoundaries];
+	if (prepareLines(geom, isolated ? IsolatedBoundaries : SharedBoundaries))
+		drawLinesGeometry(prog, geom, Constellation::boundaryColor);
+	else
+		prog->release();
+	return true;
+}
+
+bool ConstellationGpuDrawer::prepareArt(const StelProjectorP& prj, const SphericalRegion& region, QVector<int>& fullResolution)
+{
+	Geometry& geom = geometries[Art];
+	if (geom.vertices.isEmpty())
+		return false;
+
+	if (!geom.uploaded)
+	{
+		if (!geom.vertexBuffer)
+		{
+			geom.vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+			geom.vertexBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+			geom.vertexBuffer->create();
+			geom.fadeBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+			geom.fadeBuffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+			geom.fadeBuffer->create();
+		}
+		const int posSize = geom.vertices.size()*sizeof(Vec3f);
+		const int texSize = geom.texCoords.size()*sizeof(Vec2f);
+		geom.vertexBuffer->bind();
+		geom.vertexBuffer->allocate(posSize+2*texSize);
+		geom.vertexBuffer->write(0, geom.vertices.constData(), posSize);
+		geom.vertexBuffer->write(posSize, geom.texCoords.constData(), texSize);
+		geom.vertexBuffer->write(posSize+texSize, geom.atlasTexCoords.constData(), texSize);
+		geom.fadeBuffer->bind();
+		geom.fadeBuffer->allocate(geom.fades.size()*sizeof(float));
+		for (int i=0;i<geom.ranges.size();++i)
+			geom.ranges[i].fade = -1.f;
+		geom.uploaded = true;
+	}
+
+	// The fade in the atlas batch is 0 for the hidden figures and for the ones drawn with their own texture
+	bool visible = false;
+	const float pixelPerRad = prj->getPixelPerRadAtCenter();
+	geom.fadeBuffer->bind();
+	for (int i=0;i<geom.ranges.size();++i)
+	{
+		Range& range = geom.ranges[i];
+		float fade = range.cons->artFader.getInterstate();
+		// Same culling as in Constellation::drawArtOptim()
+		if (fade && !region.intersects(range.cons->boundingCap))
+			fade = 0.f;
+		if (fade)
+		{
+			visible = true;
+			const float size = 2.*std::acos(qBound(-1., range.cons->boundingCap.d, 1.))*pixelPerRad;
+			if (range.atlas<0 || size>range.tileSize)
+			{
+				// Stream the full resolution texture of the figures larger than their tile, the largest ones first.
+				// Until it is loaded, the figure stays drawn from the atlas.
+				const StelTextureSP& tex = range.cons->artTexture;
+				tex->setUploadPriority(size*size);
+				if (tex->bind())
+				{
+					fullResolution << i;
+					fade = 0.f;
+				}
+				else if (range.atlas<0)
+					fade = 0.f;
+			}
+		}
+		if (fade==range.fade || range.count==0)
+			continue;
+		range.fade = fade;
+		float* f = geom.fades.data()+range.first;
+		for (int n=0;n<range.count;++n)
+			f[n] = fade;
+		geom.fadeBuffer->write(range.first*sizeof(float), f, range.count*sizeof(float));
+	}
+	return visible;
+}
+
+bool ConstellationGpuDrawer::drawArt(const StelProjectorP& prj, const SphericalRegion& region)
+{
+	QOpenGLShaderProgram* prog = bindProgram(prj, true);
+	if (!prog)
+		return false;
+
+	if (atlasPending && atlasFuture.isFinished())
+	{
+		atlasPending = false;
+		const ArtAtlases atlases = atlasFuture.result();
+		if (atlases.sources==artSources)
+			useArtAtlases(atlases);
+	}
+
+	QVector<int> fullResolution;
+	if (!prepareArt(prj, region, fullResolution))
+	{
+		prog->release();
+		return true;
+	}
+
+	Geometry& geom = geometries[Art];
+	const int posSize = geom.vertices.size()*sizeof(Vec3f);
+	const int texSize = geom.texCoords.size()*sizeof(Vec2f);
+	const int vertexLoc = prog->attributeLocation("vertex");
+	const int texCoordLoc = prog->attributeLocation("texCoord");
+	const int fadeLoc = prog->attributeLocation("fade");
+	prog->setUniformValue("tex", 0);
+	geom.vertexBuffer->bind();
+	prog->enableAttributeArray(vertexLoc);
+	prog->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 3);
+	prog->enableAttributeArray(texCoordLoc);
+	prog->setAttributeBuffer(texCoordLoc, GL_FLOAT, posSize+texSize, 2);
+	geom.fadeBuffer->bind();
+	prog->enableAttributeArray(fadeLoc);
+	prog->setAttributeBuffer(fadeLoc, GL_FLOAT, 0, 1);
+
+	glBlendFunc(GL_ONE, GL_ONE);
+	glEnable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
+	// One draw call per atlas
+	for (int a=0;a<atlasRanges.size();++a)
+	{
+		const QPair<int, int>& atlasRange = atlasRanges.at(a);
+		if (atlasRange.second>0 && atlasTextures.at(a)->bind())
+			glDrawArrays(GL_TRIANGLES, atlasRange.first, atlasRange.second);
+	}
+	// Then the figures drawn with their own texture, already bound once by prepareArt()
+	if (!fullResolution.isEmpty())
+	{
+		prog->disableAttributeArray(fadeLoc);
+		geom.vertexBuffer->bind();
+		prog->setAttributeBuffer(texCoordLoc, GL_FLOAT, posSize, 2);
+		foreach (int i, fullResolution)
+		{
+			const Range& range = geom.ranges.at(i);
+			range.cons->artTexture->bind();
+			prog->setAttributeValue(fadeLoc, range.cons->artFader.getInterstate());
+			glDrawArrays(GL_TRIANGLES, range.first, range.count);
+		}
+	}
+	glDisable(GL_CULL_FACE);
+
+	prog->disableAttributeArray(vertexLoc);
+	prog->disableAttributeArray(texCoordLoc);
+	prog->disableAttributeArray(fadeLoc);
+	geom.vertexBuffer->release();
+	prog->release();
+	return true;
+}
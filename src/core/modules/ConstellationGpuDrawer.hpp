@@ -0,0 +1,184 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _CONSTELLATIONGPUDRAWER_HPP_
+#define _CONSTELLATIONGPUDRAWER_HPP_
+
+#include "VecMath.hpp"
+#include "StelProjectorType.hpp"
+#include "StelTextureTypes.hpp"
+
+#include <vector>
+#include <QByteArray>
+#include <QFuture>
+#include <QImage>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+class StelCore;
+class Constellation;
+class SphericalRegion;
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
+
+//! @class ConstellationGpuDrawer
+//! Draw the lines, boundaries and art of all the constellations of the sky culture from static GPU buffers.
+//! The geometry is built once when the sky culture is loaded: the great circle arcs are tessellated and
+//! uploaded with the J2000 positions, and the projection is done in the vertex shader, so that each
+//! category is drawn with a single glDrawArrays call.
+//! The art images are downscaled and packed in a few mipmapped atlas textures in a worker thread, so that
+//! all the figures are drawn with one call per atlas. The full resolution texture of a figure is only
+//! loaded and used when the figure is larger on screen than its tile in the atlas; these textures are
+//! evictable so that the StelTextureMgr releases them when they are no longer used. Until the atlases
+//! are ready, and for the images which can't be packed, each figure is drawn with its own texture.
+//! The fade of each constellation is passed as a vertex attribute, which is uploaded again only while
+//! a fader is changing. The lines are rebuilt when the proper motion of their stars becomes significant.
+//! Only the projections providing a StelProjector::getForwardTransformShader() are supported,
+//! and refraction is not applied to the geometry drawn this way.
+class ConstellationGpuDrawer
+{
+public:
+	ConstellationGpuDrawer();
+	~ConstellationGpuDrawer();
+
+	//! Build the lines of the constellations from the current positions of their stars.
+	//! The boundaries and art built for the previous constellations are cleared.
+	void setLines(const std::vector<Constellation*>& asterisms, const StelCore* core);
+	//! Build the boundaries of the constellations, shared and isolated.
+	void setBoundaries(const std::vector<Constellation*>& asterisms);
+	//! Build the art polygons of the constellations, and start packing their images in atlases.
+	void setArt(const std::vector<Constellation*>& asterisms);
+	//! Forget all the geometry, to be called when the constellations are deleted.
+	void clear();
+
+	//! Draw the lines of all the constellations with the given projector.
+	//! @return false if the projection cannot be performed on the GPU,
+	//! in which case the regular StelPainter path has to be used.
+	bool drawLines(const StelCore* core, const StelProjectorP& prj);
+	//! Draw the boundaries of all the constellations.
+	//! @param isolated true to draw the boundaries of each constellation, false to draw each boundary once.
+	//! @return false if the projection cannot be performed on the GPU.
+	bool drawBoundaries(const StelProjectorP& prj, bool isolated);
+	//! Draw the art of the constellations intersecting the region.
+	//! @return false if the projection cannot be performed on the GPU.
+	bool drawArt(const StelProjectorP& prj, const SphericalRegion& region);
+
+private:
+	enum Category
+	{
+		Lines,
+		SharedBoundaries,
+		IsolatedBoundaries,
+		Art,
+		NbCategories
+	};
+
+	//! The vertices of one constellation in a Geometry.
+	struct Range
+	{
+		const Constellation* cons;
+		int first;
+		int count;
+		//! The fade which was last written in the fades buffer, -1 if not yet written.
+		float fade;
+		//! For the art, the index of the atlas of the image, -1 if it is drawn with its own texture.
+		int atlas;
+		//! For the art, the size in pixels of the longest side of the image in the atlas.
+		int tileSize;
+	};
+
+	//! The geometry of one category, and its GPU buffers.
+	struct Geometry
+	{
+		Geometry() : vertexBuffer(NULL), fadeBuffer(NULL), uploaded(false) {}
+		//! J2000 positions, drawn as GL_LINES, or as GL_TRIANGLES for the art.
+		QVector<Vec3f> vertices;
+		//! Texture coordinates of the art, stored after the positions in vertexBuffer.
+		QVector<Vec2f> texCoords;
+		//! Texture coordinates of the art in the atlases, stored after texCoords in vertexBuffer.
+		QVector<Vec2f> atlasTexCoords;
+		//! The fade of the constellation of each vertex.
+		QVector<float> fades;
+		QVector<Range> ranges;
+		QOpenGLBuffer* vertexBuffer;
+		QOpenGLBuffer* fadeBuffer;
+		bool uploaded;
+	};
+
+	//! The art images packed in atlases by packArtAtlases().
+	struct ArtAtlases
+	{
+		//! The paths of the images, in the order of the art ranges when the packing started.
+		QStringList sources;
+		QList<QImage> images;
+		//! The atlas of each source, -1 if the image can't be read.
+		QVector<int> atlasOf;
+		//! The texture coordinates of each source in its atlas, as (left, bottom, right, top).
+		QVector<Vec4f> rects;
+		//! The size in pixels of the longest side of each source in its atlas.
+		QVector<int> tileSizes;
+	};
+
+	//! Remove the geometry of a category, keeping the GPU buffers to be reused.
+	void clearGeometry(Category category);
+	//! Start the range of a constellation at the current end of a geometry.
+	void beginRange(Geometry& geom, const Constellation* cons);
+	//! Finish the range started by beginRange().
+	void endRange(Geometry& geom);
+	//! Build the lines of the constellations from the positions of their stars at the current date.
+	void buildLines(const std::vector<Constellation*>& asterisms, const StelCore* core);
+	//! Build the art polygons, grouped by atlas when the atlases are given.
+	void buildArt(const std::vector<const Constellation*>& asterisms, const ArtAtlases* atlases);
+	//! Read, downscale and pack the art images, called in a worker thread.
+	static ArtAtlases packArtAtlases(const QStringList& sources);
+	//! Create the textures of the packed atlases and rebuild the art for them.
+	void useArtAtlases(const ArtAtlases& atlases);
+	//! Upload the art geometry and the fades which changed, and find the figures to draw with their own texture.
+	//! @return false if there is nothing visible to draw.
+	bool prepareArt(const StelProjectorP& prj, const SphericalRegion& region, QVector<int>& fullResolution);
+	//! Append a great circle arc tessellated as GL_LINES segments.
+	void addArc(Geometry& geom, const Vec3d& p1, const Vec3d& p2);
+	//! Upload the geometry if needed, and the fades which changed.
+	//! @return false if there is nothing visible to draw.
+	bool prepareLines(Geometry& geom, Category category);
+
+	//! Get or build the shader program for the given forward transform code.
+	QOpenGLShaderProgram* getProgram(const QByteArray& forwardTransform, bool art);
+	//! Bind the program for the projector and set its projection uniforms.
+	QOpenGLShaderProgram* bindProgram(const StelProjectorP& prj, bool art);
+	//! Draw a lines geometry with the given color.
+	void drawLinesGeometry(QOpenGLShaderProgram* prog, Geometry& geom, const Vec3f& color);
+
+	Geometry geometries[NbCategories];
+	//! Date of the star positions used for the lines.
+	double linesJD;
+
+	//! The constellations with art given to setArt(), and the paths of their images.
+	std::vector<const Constellation*> artAsterisms;
+	QStringList artSources;
+	QFuture<ArtAtlases> atlasFuture;
+	bool atlasPending;
+	QList<StelTextureSP> atlasTextures;
+	//! The vertices of the art of each atlas, as (first, count).
+	QVector<QPair<int, int> > atlasRanges;
+};
+
+#endif // _CONSTELLATIONGPUDRAWER_HPP_
@@ -21,6 +21,7 @@
 
 #include "ConstellationMgr.hpp"
 #include "Constellation.hpp"
+#include "ConstellationGpuDrawer.hpp"
 #include "StarMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelApp.hpp"
@@ -43,18 +44,23 @@
 #include <QString>
 #include <QStringList>
 #include <QDir>
+#include <QImageReader>
+#include <QTextStream>
+#include <QtConcurrent>
 
 using namespace std;
 
 // constructor which loads all data from appropriate files
 ConstellationMgr::ConstellationMgr(StarMgr *_hip_stars)
 	: hipStarMgr(_hip_stars),
+	  flagAsyncSkyCultureLoading(true),
 	  artFadeDuration(1.),
 	  artIntensity(0),
 	  artDisplayed(0),
 	  boundariesDisplayed(0),
 	  linesDisplayed(0),
-	  namesDisplayed(0)
+	  namesDisplayed(0),
+	  gpuDrawer(NULL)
 {
 	setObjectName("ConstellationMgr");
 	Q_ASSERT(hipStarMgr);
@@ -64,6 +70,10 @@ ConstellationMgr::ConstellationMgr(StarMgr *_hip_stars)
 
 ConstellationMgr::~ConstellationMgr()
 {
+	// The readers of the sky cultures do not use the constellations, but they must not outlive the module
+	skyCultureWatcher.waitForFinished();
+	preloadWatcher.waitForFinished();
+
 	std::vector<Constellation *>::iterator iter;
 
 	for (iter = asterisms.begin(); iter != asterisms.end(); iter++)
@@ -77,6 +87,9 @@ ConstellationMgr::~ConstellationMgr()
 		delete (*iter1);
 	}
 	allBoundarySegments.clear();
+
+	delete gpuDrawer;
+	gpuDrawer = NULL;
 }
 
 void ConstellationMgr::init()
@@ -94,6 +107,11 @@ void ConstellationMgr::init()
 	setFlagArt(conf->value("viewing/flag_constellation_art").toBool());
 	setFlagIsolateSelected(conf->value("viewing/flag_constellation_isolate_selected",
 					   conf->value("viewing/flag_constellation_pick", false).toBool() ).toBool());
+	if (conf->value("viewing/flag_gpu_constellations", false).toBool())
+		gpuDrawer = new ConstellationGpuDrawer();
+	flagAsyncSkyCultureLoading = conf->value("viewing/flag_async_sky_culture_loading", true).toBool();
+	connect(&skyCultureWatcher, SIGNAL(finished()), this, SLOT(skyCultureLoaded()));
+	connect(&preloadWatcher, SIGNAL(finished()), this, SLOT(skyCulturePreloaded()));
 
 	StelObjectMgr *objectManager = GETSTELMODULE(StelObjectMgr);
 	objectManager->registerStelObjectMgr(this);
@@ -124,35 +142,125 @@ double ConstellationMgr::getCallOrder(StelModuleActionName actionName) const
 void ConstellationMgr::updateSkyCulture(const QString& skyCultureDir)
 {
 	// Check if the sky culture changed since last load, if not don't load anything
+	if (pendingSkyCulture.isEmpty() ? lastLoadedSkyCulture == skyCultureDir : pendingSkyCulture == skyCultureDir)
+		return;
+
+	// Going back to the displayed sky culture during the loading of another one
 	if (lastLoadedSkyCulture == skyCultureDir)
+	{
+		pendingSkyCulture.clear();
 		return;
+	}
 
-	// Find constellation art.  If this doesn't exist, warn, but continue using ""
-	// the loadLinesAndArt function knows how to handle this (just loads lines).
-	QString conArtFile = StelFileMgr::findFile("skycultures/"+skyCultureDir+"/constellationsart.fab");
-	if (conArtFile.isEmpty())
+	if (preloadedSkyCultures.contains(skyCultureDir))
 	{
-		qDebug() << "No constellationsart.fab file found for sky culture " << QDir::toNativeSeparators(skyCultureDir);
+		pendingSkyCulture.clear();
+		SkyCultureData data = preloadedSkyCultures.take(skyCultureDir);
+		applySkyCulture(data);
+		return;
 	}
 
-	// first of all, remove constellations from the list of selected objects in StelObjectMgr, since we are going to delete them
-	deselectConstellations();
+	// Nothing must be drawn before the first sky culture is loaded, so it is read synchronously
+	if (!flagAsyncSkyCultureLoading || asterisms.empty())
+	{
+		pendingSkyCulture.clear();
+		SkyCultureData data = readSkyCulture(skyCultureDir);
+		createArtTextures(data);
+		applySkyCulture(data);
+		return;
+	}
+
+	// The current constellations stay displayed until the new ones are ready
+	pendingSkyCulture = skyCultureDir;
+	if (preloadingSkyCulture == skyCultureDir)
+		return; // applied by skyCulturePreloaded()
+	skyCultureWatcher.setFuture(QtConcurrent::run(&ConstellationMgr::readSkyCulture, skyCultureDir));
+}
+
+void ConstellationMgr::skyCultureLoaded()
+{
+	SkyCultureData data = skyCultureWatcher.result();
+	// Ignore a sky culture which was replaced by another one during its loading
+	if (data.skyCultureDir != pendingSkyCulture)
+		return;
+	pendingSkyCulture.clear();
+	createArtTextures(data);
+	applySkyCulture(data);
+}
+
+void ConstellationMgr::preloadSkyCultures(const QStringList& skyCultureDirs)
+{
+	foreach (const QString& dir, skyCultureDirs)
+	{
+		if (dir == lastLoadedSkyCulture || dir == pendingSkyCulture || dir == preloadingSkyCulture
+		    || preloadQueue.contains(dir) || preloadedSkyCultures.contains(dir))
+			continue;
+		if (StelApp::getInstance().getSkyCultureMgr().directoryToSkyCultureEnglish(dir).isEmpty())
+		{
+			qWarning() << "Cannot preload the invalid sky culture directory" << QDir::toNativeSeparators(dir);
+			continue;
+		}
+		preloadQueue << dir;
+	}
+	if (preloadingSkyCulture.isEmpty())
+		startNextPreload();
+}
+
+void ConstellationMgr::startNextPreload()
+{
+	if (preloadQueue.isEmpty())
+	{
+		preloadingSkyCulture.clear();
+		return;
+	}
+	preloadingSkyCulture = preloadQueue.takeFirst();
+	preloadWatcher.setFuture(QtConcurrent::run(&ConstellationMgr::readSkyCulture, preloadingSkyCulture));
+}
+
+void ConstellationMgr::skyCulturePreloaded()
+{
+	SkyCultureData data = preloadWatcher.result();
+	// The textures are loaded by the texture manager in its own threads
+	createArtTextures(data);
+	if (data.skyCultureDir == pendingSkyCulture)
+	{
+		pendingSkyCulture.clear();
+		applySkyCulture(data);
+	}
+	else if (data.skyCultureDir != lastLoadedSkyCulture)
+	{
+		preloadedSkyCultures.insert(data.skyCultureDir, data);
+	}
+	startNextPreload();
+}
+
+ConstellationMgr::SkyCultureData ConstellationMgr::readSkyCulture(const QString& skyCultureDir)
+{
+	SkyCultureData data;
+	data.skyCultureDir = skyCultureDir;
+	data.linesTotalRecords = 0;
+	data.artTotalRecords = 0;
 
 	QString fic = StelFileMgr::findFile("skycultures/"+skyCultureDir+"/constellationship.fab");
 	if (fic.isEmpty())
 		qWarning() << "ERROR loading constellation lines and art from file: " << fic;
 	else
-		loadLinesAndArt(fic, conArtFile, skyCultureDir);
+		readLines(fic, data);
+
+	// Find constellation art.  If this doesn't exist, warn, but continue using ""
+	// the readArt function knows how to handle this (just loads lines).
+	QString conArtFile = StelFileMgr::findFile("skycultures/"+skyCultureDir+"/constellationsart.fab");
+	if (conArtFile.isEmpty())
+		qDebug() << "No constellationsart.fab file found for sky culture " << QDir::toNativeSeparators(skyCultureDir);
+	else if (!fic.isEmpty())
+		readArt(conArtFile, data);
 
 	// load constellation names
 	fic = StelFileMgr::findFile("skycultures/" + skyCultureDir + "/constellation_names.eng.fab");
 	if (fic.isEmpty())
 		qWarning() << "ERROR loading constellation names from file: " << fic;
 	else
-		loadNames(fic);
-
-	// Translate constellation names for the new sky culture
-	updateI18n();
+		readNames(fic, data);
 
 	// load constellation boundaries
 	// First try load constellation boundaries from sky culture
@@ -172,9 +280,36 @@ void ConstellationMgr::updateSkyCulture(const QString& skyCultureDir)
 		existBoundaries = true;
 
 	if (existBoundaries)
-		loadBoundaries(fic);
+		readBoundaries(fic, data);
 
-	lastLoadedSkyCulture = skyCultureDir;
+	return data;
+}
+
+void ConstellationMgr::createArtTextures(SkyCultureData& data)
+{
+	// The art textures are released when not used for a while, the GPU drawer mostly drawing the figures from its atlases
+	StelTexture::StelTextureParams params;
+	params.evictable = true;
+	data.artTextures.clear();
+	foreach (const SkyCultureData::Art& art, data.art)
+		data.artTextures << StelApp::getInstance().getTextureManager().createTextureThread(art.texturePath, params);
+}
+
+void ConstellationMgr::applySkyCulture(SkyCultureData& data)
+{
+	// first of all, remove constellations from the list of selected objects in StelObjectMgr, since we are going to delete them
+	deselectConstellations();
+
+	applyLines(data);
+	applyArt(data);
+	applyNames(data);
+
+	// Translate constellation names for the new sky culture
+	updateI18n();
+
+	applyBoundaries(data);
+
+	lastLoadedSkyCulture = data.skyCultureDir;
 }
 
 void ConstellationMgr::setStelStyle(const QString& section)
@@ -310,89 +445,41 @@ float ConstellationMgr::getFontSize() const
 	return asterFont.pixelSize();
 }
 
-void ConstellationMgr::loadLinesAndArt(const QString &fileName, const QString &artfileName, const QString& cultureName)
+void ConstellationMgr::readLines(const QString& fileName, SkyCultureData& data)
 {
 	QFile in(fileName);
 	if (!in.open(QIODevice::ReadOnly | QIODevice::Text))
 	{
-		qWarning() << "Can't open constellation data file" << QDir::toNativeSeparators(fileName)  << "for culture" << cultureName;
-		Q_ASSERT(0);
+		qWarning() << "Can't open constellation data file" << QDir::toNativeSeparators(fileName)  << "for culture" << data.skyCultureDir;
+		return;
 	}
 
-	int totalRecords=0;
+	// keep a record per non-comment line
 	QString record;
 	QRegExp commentRx("^(\\s*#.*|\\s*)$");
-	while (!in.atEnd())
-	{
-		record = QString::fromUtf8(in.readLine());
-		if (!commentRx.exactMatch(record))
-			totalRecords++;
-	}
-	in.seek(0);
-
-	// delete existing data, if any
-	vector < Constellation * >::iterator iter;
-	for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
-		delete(*iter);
-
-	asterisms.clear();
-	Constellation *cons = NULL;
-
-	// read the file, adding a record per non-comment line
 	int currentLineNumber = 0;	// line in file
-	int readOk = 0;			// count of records processed OK
 	while (!in.atEnd())
 	{
 		record = QString::fromUtf8(in.readLine());
 		currentLineNumber++;
 		if (commentRx.exactMatch(record))
 			continue;
-
-		cons = new Constellation;
-		if(cons->read(record, hipStarMgr))
-		{
-			cons->artFader.setMaxValue(artIntensity);
-			cons->setFlagArt(artDisplayed);
-			cons->setFlagBoundaries(boundariesDisplayed);
-			cons->setFlagLines(linesDisplayed);
-			cons->setFlagLabels(namesDisplayed);
-			asterisms.push_back(cons);
-			++readOk;
-		}
-		else
-		{
-			qWarning() << "ERROR reading constellation rec at line " << currentLineNumber << "for culture" << cultureName;
-			delete cons;
-		}
+		data.lines << record;
+		data.lineNumbers << currentLineNumber;
 	}
 	in.close();
-	qDebug() << "Loaded" << readOk << "/" << totalRecords << "constellation records successfully for culture" << cultureName;
-
-	// Set current states
-	setFlagArt(artDisplayed);
-	setFlagLines(linesDisplayed);
-	setFlagLabels(namesDisplayed);
-	setFlagBoundaries(boundariesDisplayed);
+	data.linesTotalRecords = data.lines.size();
+}
 
-	// It's possible to have no art - just constellations
-	if (artfileName.isNull() || artfileName.isEmpty())
-		return;
+void ConstellationMgr::readArt(const QString& artfileName, SkyCultureData& data)
+{
 	QFile fic(artfileName);
 	if (!fic.open(QIODevice::ReadOnly | QIODevice::Text))
 	{
-		qWarning() << "Can't open constellation art file" << QDir::toNativeSeparators(fileName)  << "for culture" << cultureName;
+		qWarning() << "Can't open constellation art file" << QDir::toNativeSeparators(artfileName)  << "for culture" << data.skyCultureDir;
 		return;
 	}
 
-	totalRecords=0;
-	while (!fic.atEnd())
-	{
-		record = QString::fromUtf8(fic.readLine());
-		if (!commentRx.exactMatch(record))
-			totalRecords++;
-	}
-	fic.seek(0);
-
 	// Read the constellation art file with the following format :
 	// ShortName texture_file x1 y1 hp1 x2 y2 hp2
 	// Where :
@@ -401,110 +488,167 @@ void ConstellationMgr::loadLinesAndArt(const QString &fileName, const QString &a
 	// x1 y1 are the x and y texture coordinates in pixels of the star of hipparcos number hp1
 	// x2 y2 are the x and y texture coordinates in pixels of the star of hipparcos number hp2
 	// The coordinate are taken with (0,0) at the top left corner of the image file
-	QString shortname;
+	QString record;
+	QRegExp commentRx("^(\\s*#.*|\\s*)$");
 	QString texfile;
-	unsigned int x1, y1, x2, y2, x3, y3, hp1, hp2, hp3;
-	QString tmpstr;
-
-	currentLineNumber = 0;	// line in file
-	readOk = 0;		// count of records processed OK
-
+	int currentLineNumber = 0;	// line in file
 	while (!fic.atEnd())
 	{
 		++currentLineNumber;
 		record = QString::fromUtf8(fic.readLine());
 		if (commentRx.exactMatch(record))
 			continue;
+		++data.artTotalRecords;
 
 		// prevent leaving zeros on numbers from being interpretted as octal numbers
 		record.replace(" 0", " ");
 		QTextStream rStr(&record);
-		rStr >> shortname >> texfile >> x1 >> y1 >> hp1 >> x2 >> y2 >> hp2 >> x3 >> y3 >> hp3;
+		SkyCultureData::Art art;
+		rStr >> art.abbreviation >> texfile;
+		for (int i=0;i<3;++i)
+			rStr >> art.x[i] >> art.y[i] >> art.hp[i];
 		if (rStr.status()!=QTextStream::Ok)
 		{
-			qWarning() << "ERROR parsing constellation art record at line" << currentLineNumber << "of art file for culture" << cultureName;
+			qWarning() << "ERROR parsing constellation art record at line" << currentLineNumber << "of art file for culture" << data.skyCultureDir;
 			continue;
 		}
 
-		// Draw loading bar
-// 		lb.SetMessage(q_("Loading Constellation Art: %1/%2").arg(currentLineNumber).arg(totalRecords));
-// 		lb.Draw((float)(currentLineNumber)/totalRecords);
+		art.texturePath = StelFileMgr::findFile("skycultures/"+data.skyCultureDir+"/"+texfile);
+		if (art.texturePath.isEmpty())
+		{
+			qWarning() << "ERROR: could not find texture, " << QDir::toNativeSeparators(texfile);
+		}
 
-		cons = NULL;
-		cons = findFromAbbreviation(shortname);
-		if (!cons)
+		// Get the size from the file without loading data
+		art.texSizeX = art.texSizeY = -1;
+		QImageReader im(art.texturePath);
+		if (!art.texturePath.isEmpty() && im.canRead())
 		{
-			qWarning() << "ERROR in constellation art file at line" << currentLineNumber << "for culture" << cultureName
-					   << "constellation" << shortname << "unknown";
+			art.texSizeX = im.size().width();
+			art.texSizeY = im.size().height();
+		}
+		data.art << art;
+	}
+	fic.close();
+}
+
+void ConstellationMgr::applyLines(const SkyCultureData& data)
+{
+	std::vector<Constellation*> newAsterisms;
+	int readOk = 0;			// count of records processed OK
+	for (int i=0;i<data.lines.size();++i)
+	{
+		Constellation* cons = new Constellation;
+		if(cons->read(data.lines.at(i), hipStarMgr))
+		{
+			cons->artFader.setMaxValue(artIntensity);
+			cons->setFlagArt(artDisplayed);
+			cons->setFlagBoundaries(boundariesDisplayed);
+			cons->setFlagLines(linesDisplayed);
+			cons->setFlagLabels(namesDisplayed);
+			newAsterisms.push_back(cons);
+			++readOk;
 		}
 		else
 		{
-			QString texturePath = StelFileMgr::findFile("skycultures/"+cultureName+"/"+texfile);
-			if (texturePath.isEmpty())
-			{
-				qWarning() << "ERROR: could not find texture, " << QDir::toNativeSeparators(texfile);
-			}
+			qWarning() << "ERROR reading constellation rec at line " << data.lineNumbers.at(i) << "for culture" << data.skyCultureDir;
+			delete cons;
+		}
+	}
+	qDebug() << "Loaded" << readOk << "/" << data.linesTotalRecords << "constellation records successfully for culture" << data.skyCultureDir;
 
-			cons->artTexture = StelApp::getInstance().getTextureManager().createTextureThread(texturePath);
+	// delete existing data, if any
+	vector < Constellation * >::iterator iter;
+	for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
+		delete(*iter);
+	asterisms.swap(newAsterisms);
 
-			int texSizeX = 0, texSizeY = 0;
-			if (cons->artTexture==NULL || !cons->artTexture->getDimensions(texSizeX, texSizeY))
-			{
-				qWarning() << "Texture dimension not available";
-			}
+	// The previous constellations were deleted, so their boundaries and art too
+	if (gpuDrawer)
+		gpuDrawer->setLines(asterisms, StelApp::getInstance().getCore());
+}
+
+void ConstellationMgr::applyArt(const SkyCultureData& data)
+{
+	// It's possible to have no art - just constellations
+	if (data.art.isEmpty())
+		return;
+
+	int readOk = 0;		// count of records processed OK
+	for (int r=0;r<data.art.size();++r)
+	{
+		const SkyCultureData::Art& art = data.art.at(r);
+		Constellation* cons = findFromAbbreviation(art.abbreviation);
+		if (!cons)
+		{
+			qWarning() << "ERROR in constellation art file for culture" << data.skyCultureDir
+					   << "constellation" << art.abbreviation << "unknown";
+			continue;
+		}
+
+		cons->artTexture = data.artTextures.value(r);
+
+		int texSizeX = art.texSizeX, texSizeY = art.texSizeY;
+		if (texSizeX<0 && (cons->artTexture==NULL || !cons->artTexture->getDimensions(texSizeX, texSizeY)))
+		{
+			qWarning() << "Texture dimension not available";
+			texSizeX = texSizeY = 0;
+		}
 
-			StelCore* core = StelApp::getInstance().getCore();
-			Vec3d s1 = hipStarMgr->searchHP(hp1)->getJ2000EquatorialPos(core);
-			Vec3d s2 = hipStarMgr->searchHP(hp2)->getJ2000EquatorialPos(core);
-			Vec3d s3 = hipStarMgr->searchHP(hp3)->getJ2000EquatorialPos(core);
-
-			// To transform from texture coordinate to 2d coordinate we need to find X with XA = B
-			// A formed of 4 points in texture coordinate, B formed with 4 points in 3d coordinate
-			// We need 3 stars and the 4th point is deduced from the other to get an normal base
-			// X = B inv(A)
-			Vec3d s4 = s1 + ((s2 - s1) ^ (s3 - s1));
-			Mat4d B(s1[0], s1[1], s1[2], 1, s2[0], s2[1], s2[2], 1, s3[0], s3[1], s3[2], 1, s4[0], s4[1], s4[2], 1);
-			Mat4d A(x1, texSizeY - y1, 0.f, 1.f, x2, texSizeY - y2, 0.f, 1.f, x3, texSizeY - y3, 0.f, 1.f, x1, texSizeY - y1, texSizeX, 1.f);
-			Mat4d X = B * A.inverse();
-
-			// Tesselate on the plan assuming a tangential projection for the image
-			static const int nbPoints=5;
-			QVector<Vec2f> texCoords;
-			texCoords.reserve(nbPoints*nbPoints*6);
-			for (int j=0;j<nbPoints;++j)
+		StelCore* core = StelApp::getInstance().getCore();
+		Vec3d s1 = hipStarMgr->searchHP(art.hp[0])->getJ2000EquatorialPos(core);
+		Vec3d s2 = hipStarMgr->searchHP(art.hp[1])->getJ2000EquatorialPos(core);
+		Vec3d s3 = hipStarMgr->searchHP(art.hp[2])->getJ2000EquatorialPos(core);
+		const unsigned int x1 = art.x[0], y1 = art.y[0], x2 = art.x[1], y2 = art.y[1], x3 = art.x[2], y3 = art.y[2];
+
+		// To transform from texture coordinate to 2d coordinate we need to find X with XA = B
+		// A formed of 4 points in texture coordinate, B formed with 4 points in 3d coordinate
+		// We need 3 stars and the 4th point is deduced from the other to get an normal base
+		// X = B inv(A)
+		Vec3d s4 = s1 + ((s2 - s1) ^ (s3 - s1));
+		Mat4d B(s1[0], s1[1], s1[2], 1, s2[0], s2[1], s2[2], 1, s3[0], s3[1], s3[2], 1, s4[0], s4[1], s4[2], 1);
+		Mat4d A(x1, texSizeY - y1, 0.f, 1.f, x2, texSizeY - y2, 0.f, 1.f, x3, texSizeY - y3, 0.f, 1.f, x1, texSizeY - y1, texSizeX, 1.f);
+		Mat4d X = B * A.inverse();
+
+		// Tesselate on the plan assuming a tangential projection for the image
+		static const int nbPoints=5;
+		QVector<Vec2f> texCoords;
+		texCoords.reserve(nbPoints*nbPoints*6);
+		for (int j=0;j<nbPoints;++j)
+		{
+			for (int i=0;i<nbPoints;++i)
 			{
-				for (int i=0;i<nbPoints;++i)
-				{
-					texCoords << Vec2f(((float)i)/nbPoints, ((float)j)/nbPoints);
-					texCoords << Vec2f(((float)i+1.f)/nbPoints, ((float)j)/nbPoints);
-					texCoords << Vec2f(((float)i)/nbPoints, ((float)j+1.f)/nbPoints);
-					texCoords << Vec2f(((float)i+1.f)/nbPoints, ((float)j)/nbPoints);
-					texCoords << Vec2f(((float)i+1.f)/nbPoints, ((float)j+1.f)/nbPoints);
-					texCoords << Vec2f(((float)i)/nbPoints, ((float)j+1.f)/nbPoints);
-				}
+				texCoords << Vec2f(((float)i)/nbPoints, ((float)j)/nbPoints);
+				texCoords << Vec2f(((float)i+1.f)/nbPoints, ((float)j)/nbPoints);
+				texCoords << Vec2f(((float)i)/nbPoints, ((float)j+1.f)/nbPoints);
+				texCoords << Vec2f(((float)i+1.f)/nbPoints, ((float)j)/nbPoints);
+				texCoords << Vec2f(((float)i+1.f)/nbPoints, ((float)j+1.f)/nbPoints);
+				texCoords << Vec2f(((float)i)/nbPoints, ((float)j+1.f)/nbPoints);
 			}
-
-			QVector<Vec3d> contour;
-			contour.reserve(texCoords.size());
-			foreach (const Vec2f& v, texCoords)
-				contour << X * Vec3d(v[0]*texSizeX, v[1]*texSizeY, 0.);
-
-			cons->artPolygon.vertex=contour;
-			cons->artPolygon.texCoords=texCoords;
-			cons->artPolygon.primitiveType=StelVertexArray::Triangles;
-
-			Vec3d tmp(X * Vec3d(0.5*texSizeX, 0.5*texSizeY, 0.));
-			tmp.normalize();
-			Vec3d tmp2(X * Vec3d(0., 0., 0.));
-			tmp2.normalize();
-			cons->boundingCap.n=tmp;
-			cons->boundingCap.d=tmp*tmp2;
-			++readOk;
 		}
+
+		QVector<Vec3d> contour;
+		contour.reserve(texCoords.size());
+		foreach (const Vec2f& v, texCoords)
+			contour << X * Vec3d(v[0]*texSizeX, v[1]*texSizeY, 0.);
+
+		cons->artPolygon.vertex=contour;
+		cons->artPolygon.texCoords=texCoords;
+		cons->artPolygon.primitiveType=StelVertexArray::Triangles;
+
+		Vec3d tmp(X * Vec3d(0.5*texSizeX, 0.5*texSizeY, 0.));
+		tmp.normalize();
+		Vec3d tmp2(X * Vec3d(0., 0., 0.));
+		tmp2.normalize();
+		cons->boundingCap.n=tmp;
+		cons->boundingCap.d=tmp*tmp2;
+		++readOk;
 	}
 
-	qDebug() << "Loaded" << readOk << "/" << totalRecords << "constellation art records successfully for culture" << cultureName;
-	fic.close();
+	qDebug() << "Loaded" << readOk << "/" << data.artTotalRecords << "constellation art records successfully for culture" << data.skyCultureDir;
+
+	if (gpuDrawer)
+		gpuDrawer->setArt(asterisms);
 }
 
 void ConstellationMgr::draw(StelCore* core)
@@ -521,6 +665,9 @@ void ConstellationMgr::draw(StelCore* core)
 // Draw constellations art textures
 void ConstellationMgr::drawArt(StelPainter& sPainter) const
 {
+	if (gpuDrawer && gpuDrawer->drawArt(sPainter.getProjector(), *sPainter.getProjector()->getViewportConvexPolygon()))
+		return;
+
 	glBlendFunc(GL_ONE, GL_ONE);
 	sPainter.enableTexture2d(true);
 	glEnable(GL_BLEND);
@@ -539,6 +686,9 @@ void ConstellationMgr::drawArt(StelPainter& sPainter) const
 // Draw constellations lines
 void ConstellationMgr::drawLines(StelPainter& sPainter, const StelCore* core) const
 {
+	if (gpuDrawer && gpuDrawer->drawLines(core, sPainter.getProjector()))
+		return;
+
 	sPainter.enableTexture2d(false);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -599,18 +749,8 @@ QList<StelObjectP> ConstellationMgr::searchAround(const Vec3d&, double, const St
 	return QList<StelObjectP>();
 }
 
-void ConstellationMgr::loadNames(const QString& namesFile)
+void ConstellationMgr::readNames(const QString& namesFile, SkyCultureData& data)
 {
-	// Constellation not loaded yet
-	if (asterisms.empty()) return;
-
-	// clear previous names
-	vector < Constellation * >::const_iterator iter;
-	for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
-	{
-		(*iter)->englishName.clear();
-	}
-
 	// Open file
 	QFile commonNameFile(namesFile);
 	if (!commonNameFile.open(QIODevice::ReadOnly | QIODevice::Text))
@@ -627,13 +767,7 @@ void ConstellationMgr::loadNames(const QString& namesFile)
 	// which will be available in recRx.capturedTexts()
 	QRegExp recRx("^\\s*(\\w+)\\s+\"(.*)\"\\s+_[(]\"(.*)\"[)]\\n");
 
-	// Some more variables to use in the parsing
-	Constellation *aster;
-	QString record, shortName;
-
-	// keep track of how many records we processed.
-	int totalRecords=0;
-	int readOk=0;
+	QString record;
 	int lineNumber=0;
 	while (!commonNameFile.atEnd())
 	{
@@ -644,31 +778,51 @@ void ConstellationMgr::loadNames(const QString& namesFile)
 		if (commentRx.exactMatch(record))
 			continue;
 
-		totalRecords++;
-
 		if (!recRx.exactMatch(record))
 		{
 			qWarning() << "ERROR - cannot parse record at line" << lineNumber << "in constellation names file" << QDir::toNativeSeparators(namesFile);
 		}
 		else
 		{
-			shortName = recRx.capturedTexts().at(1);
-			aster = findFromAbbreviation(shortName);
-			// If the constellation exists, set the English name
-			if (aster != NULL)
-			{
-				aster->nativeName = recRx.capturedTexts().at(2);
-				aster->englishName = recRx.capturedTexts().at(3);
-				readOk++;
-			}
-			else
-			{
-				qWarning() << "WARNING - constellation abbreviation" << shortName << "not found when loading constellation names";
-			}
+			SkyCultureData::Name name;
+			name.abbreviation = recRx.capturedTexts().at(1);
+			name.nativeName = recRx.capturedTexts().at(2);
+			name.englishName = recRx.capturedTexts().at(3);
+			data.names << name;
 		}
 	}
 	commonNameFile.close();
-	qDebug() << "Loaded" << readOk << "/" << totalRecords << "constellation names";
+}
+
+void ConstellationMgr::applyNames(const SkyCultureData& data)
+{
+	// Constellation not loaded yet
+	if (asterisms.empty()) return;
+
+	// clear previous names
+	vector < Constellation * >::const_iterator iter;
+	for (iter = asterisms.begin(); iter != asterisms.end(); ++iter)
+	{
+		(*iter)->englishName.clear();
+	}
+
+	int readOk=0;
+	foreach (const SkyCultureData::Name& name, data.names)
+	{
+		Constellation* aster = findFromAbbreviation(name.abbreviation);
+		// If the constellation exists, set the English name
+		if (aster != NULL)
+		{
+			aster->nativeName = name.nativeName;
+			aster->englishName = name.englishName;
+			readOk++;
+		}
+		else
+		{
+			qWarning() << "WARNING - constellation abbreviation" << name.abbreviation << "not found when loading constellation names";
+		}
+	}
+	qDebug() << "Loaded" << readOk << "/" << data.names.size() << "constellation names";
 }
 
 void ConstellationMgr::updateI18n()
@@ -1006,19 +1160,8 @@ void ConstellationMgr::unsetSelectedConst(Constellation * c)
 	}
 }
 
-bool ConstellationMgr::loadBoundaries(const QString& boundaryFile)
+bool ConstellationMgr::readBoundaries(const QString& boundaryFile, SkyCultureData& data)
 {
-	Constellation *cons = NULL;
-	unsigned int i, j;
-
-	// delete existing boundaries if any exist
-	vector<vector<Vec3f> *>::iterator iter;
-	for (iter = allBoundarySegments.begin(); iter != allBoundarySegments.end(); ++iter)
-	{
-		delete (*iter);
-	}
-	allBoundarySegments.clear();
-
 	qDebug() << "Loading constellation boundary data ... ";
 
 	// Modified boundary file by Torsten Bronger with permission
@@ -1034,18 +1177,16 @@ bool ConstellationMgr::loadBoundaries(const QString& boundaryFile)
 	float DE, RA;
 	Vec3f XYZ;
 	unsigned num, numc;
-	vector<Vec3f> *points = NULL;
 	QString consname;
-	i = 0;
 	while (!istr.atEnd())
 	{
-		points = new vector<Vec3f>;
-
 		num = 0;
 		istr >> num;
 		if(num == 0) continue;  // empty line
 
-		for (j=0;j<num;j++)
+		SkyCultureData::Boundary boundary;
+		boundary.points.reserve(num);
+		for (unsigned int j=0;j<num;j++)
 		{
 			istr >> RA >> DE;
 
@@ -1054,21 +1195,50 @@ bool ConstellationMgr::loadBoundaries(const QString& boundaryFile)
 
 			// Calc the Cartesian coord with RA and DE
 			StelUtils::spheToRect(RA,DE,XYZ);
-			points->push_back(XYZ);
+			boundary.points.push_back(XYZ);
 		}
 
-		// this list is for the de-allocation
-		allBoundarySegments.push_back(points);
-
 		istr >> numc;
 		// there are 2 constellations per boundary
 
-		for (j=0;j<numc;j++)
+		for (unsigned int j=0;j<numc;j++)
 		{
 			istr >> consname;
 			// not used?
 			if (consname == "SER1" || consname == "SER2") consname = "SER";
+			boundary.constellations << consname;
+		}
+		if (boundary.constellations.size()==2)
+			data.boundaryIndex.addBoundary(boundary.points, boundary.constellations.at(0), boundary.constellations.at(1));
+		data.boundaries << boundary;
+	}
+	dataFile.close();
+	if (!data.boundaryIndex.build())
+		qWarning() << "Cannot locate the positions in the constellation boundaries of" << QDir::toNativeSeparators(boundaryFile);
+	return true;
+}
+
+void ConstellationMgr::applyBoundaries(const SkyCultureData& data)
+{
+	// delete existing boundaries if any exist
+	vector<vector<Vec3f> *>::iterator iter;
+	for (iter = allBoundarySegments.begin(); iter != allBoundarySegments.end(); ++iter)
+	{
+		delete (*iter);
+	}
+	allBoundarySegments.clear();
+	boundaryIndex = data.boundaryIndex;
+
+	Constellation *cons = NULL;
+	foreach (const SkyCultureData::Boundary& boundary, data.boundaries)
+	{
+		vector<Vec3f>* points = new vector<Vec3f>(boundary.points);
 
+		// this list is for the de-allocation
+		allBoundarySegments.push_back(points);
+
+		foreach (const QString& consname, boundary.constellations)
+		{
 			cons = findFromAbbreviation(consname);
 			if (!cons)
 				qWarning() << "ERROR while processing boundary file - cannot find constellation: " << consname;
@@ -1077,18 +1247,18 @@ bool ConstellationMgr::loadBoundaries(const QString& boundaryFile)
 		}
 
 		if (cons) cons->sharedBoundarySegments.push_back(points);
-		i++;
-
 	}
-	dataFile.close();
-	qDebug() << "Loaded" << i << "constellation boundary segments";
-	delete points;
+	qDebug() << "Loaded" << data.boundaries.size() << "constellation boundary segments";
 
-	return true;
+	if (gpuDrawer)
+		gpuDrawer->setBoundaries(asterisms);
 }
 
 void ConstellationMgr::drawBoundaries(StelPainter& sPainter) const
 {
+	if (gpuDrawer && gpuDrawer->drawBoundaries(sPainter.getProjector(), Constellation::singleSelected))
+		return;
+
 	sPainter.enableTexture2d(false);
 	glDisable(GL_BLEND);
 	vector < Constellation * >::const_iterator iter;
@@ -24,15 +24,20 @@
 #include "StelObjectType.hpp"
 #include "StelObjectModule.hpp"
 #include "StelProjectorType.hpp"
+#include "StelTextureTypes.hpp"
+#include "ConstellationBoundaryIndex.hpp"
 
 #include <vector>
 #include <QString>
 #include <QStringList>
 #include <QFont>
+#include <QFutureWatcher>
+#include <QHash>
 
 class StelToneReproducer;
 class StarMgr;
 class Constellation;
+class ConstellationGpuDrawer;
 class StelProjector;
 class StelPainter;
 
@@ -106,6 +111,8 @@ public:
 
 	//! Updates time-varying state for each Constellation.
 	virtual void update(double deltaTime);
+	//! Only the faders of the constellations are updated, so the update can run in parallel.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true);}
 
 	//! Return the value defining the order of call for the given action
 	//! @param actionName the name of the action for which we want the call order
@@ -139,6 +146,14 @@ public:
 	virtual QStringList listAllObjects(bool inEnglish) const;
 	virtual QString getName() const { return "Constellations"; }
 
+	//! Get the constellation whose boundaries contain a position, thread safe.
+	//! @param j2000Pos the position in the J2000 equatorial frame.
+	//! @return the abbreviation of the constellation in upper case, e.g. "UMI", or an empty string
+	//! if the sky culture has no boundaries.
+	QString getConstellationAt(const Vec3d& j2000Pos) const {return boundaryIndex.getConstellation(j2000Pos);}
+	//! Same as getConstellationAt() for many positions, e.g. to label all the objects of a catalog.
+	QStringList getConstellationsAt(const QVector<Vec3d>& j2000Pos) const {return boundaryIndex.getConstellations(j2000Pos);}
+
 	///////////////////////////////////////////////////////////////////////////
 	// Properties setters and getters
 public slots:	
@@ -212,6 +227,18 @@ public slots:
 	//! Get the font size used for constellation names display
 	float getFontSize() const;
 
+	//! Read the files of sky cultures in the background and start loading their art textures,
+	//! so that the sky culture changes planned in a show happen without delay.
+	//! The preloaded sky cultures are kept until they are used.
+	//! @param skyCultureDirs the names of the directories of the sky cultures, in the order they will be used.
+	//! @code
+	//! // example of usage in scripts
+	//! ConstellationMgr.preloadSkyCultures(["egyptian", "norse"]);
+	//! @endcode
+	void preloadSkyCultures(const QStringList& skyCultureDirs);
+	//! Get whether a new sky culture is being loaded in the background.
+	bool isLoadingSkyCulture() const {return !pendingSkyCulture.isEmpty();}
+
 signals:
 	void artDisplayedChanged(const bool displayed) const;
 	void artFadeDurationChanged(const float duration) const;
@@ -245,21 +272,64 @@ private slots:
 	//! in translations.h
 	void updateI18n();
 
+	//! The sky culture read in the background finished loading.
+	void skyCultureLoaded();
+	//! A preloaded sky culture finished loading.
+	void skyCulturePreloaded();
+
 private:
+	//! The content of the files of a sky culture, read in a worker thread.
+	struct SkyCultureData
+	{
+		//! A record of the constellation art file.
+		struct Art
+		{
+			QString abbreviation;
+			QString texturePath;
+			//! Size of the texture, -1 if it could not be read from the file.
+			int texSizeX, texSizeY;
+			unsigned int x[3], y[3], hp[3];
+		};
+		//! A boundary and the constellations it separates.
+		struct Boundary
+		{
+			std::vector<Vec3f> points;
+			QStringList constellations;
+		};
+		//! A record of the constellation names file.
+		struct Name
+		{
+			QString abbreviation;
+			QString nativeName;
+			QString englishName;
+		};
+
+		QString skyCultureDir;
+		//! The records of the constellationship.fab file, and the line numbers for the warnings.
+		QStringList lines;
+		QList<int> lineNumbers;
+		int linesTotalRecords;
+		QList<Art> art;
+		int artTotalRecords;
+		QList<Name> names;
+		QList<Boundary> boundaries;
+		//! The index of the boundaries, built in the worker thread too.
+		ConstellationBoundaryIndex boundaryIndex;
+		//! The art textures, only created once the data is back in the main thread.
+		QList<StelTextureSP> artTextures;
+	};
+
+	//! Read all the files of a sky culture, thread safe.
+	static SkyCultureData readSkyCulture(const QString& skyCultureDir);
+	//! Read the records of the constellation data file.
+	static void readLines(const QString& fileName, SkyCultureData& data);
+	//! Read the records of the constellation art file.
+	static void readArt(const QString& artfileName, SkyCultureData& data);
 	//! Read constellation names from the given file.
 	//! @param namesFile Name of the file containing the constellation names in english
-	void loadNames(const QString& namesFile);
-
-	//! Load constellation line shapes, art textures and boundaries shapes from data files.
-	//! @param fileName The name of the constellation data file
-	//! @param artFileName The name of the constellation art data file
-	//! @param cultureName A string ID of the current skyculture
-	void loadLinesAndArt(const QString& fileName, const QString& artfileName, const QString& cultureName);
-
-	//! Load the constellation boundary file.
-	//! This function deletes any currently loaded constellation boundaries
-	//! and loads a new set from the file passed as the parameter.  The boundary
-	//! data file consists of whitespace separated values (space, tab or newline).
+	static void readNames(const QString& namesFile, SkyCultureData& data);
+	//! Read the constellation boundary file.
+	//! The boundary data file consists of whitespace separated values (space, tab or newline).
 	//! Each boundary may span multiple lines, and consists of the following ordered
 	//! data items:
 	//!  - The number of vertexes which make up in the boundary (integer).
@@ -269,7 +339,24 @@ private:
 	//!  - Two constellation abbreviations representing the constellations which
 	//!    the boundary separates.
 	//! @param conCatFile the path to the file which contains the constellation boundary data.
-	bool loadBoundaries(const QString& conCatFile);
+	static bool readBoundaries(const QString& conCatFile, SkyCultureData& data);
+	//! Start loading the art textures of a sky culture read in the background.
+	static void createArtTextures(SkyCultureData& data);
+
+	//! Replace the constellations by the ones of a sky culture.
+	//! The new constellations are fully built before the current ones are deleted.
+	void applySkyCulture(SkyCultureData& data);
+	//! Build the constellation line shapes.
+	void applyLines(const SkyCultureData& data);
+	//! Set the names of the constellations.
+	void applyNames(const SkyCultureData& data);
+	//! Place the art textures on the sky.
+	void applyArt(const SkyCultureData& data);
+	//! Replace the constellation boundaries.
+	void applyBoundaries(const SkyCultureData& data);
+	//! Read the next sky culture waiting to be preloaded.
+	void startNextPreload();
+
         //! Draw the constellation lines at the epoch given by the StelCore.
 	void drawLines(StelPainter& sPainter, const StelCore* core) const;
 	//! Draw the constellation art.
@@ -307,9 +394,22 @@ private:
 
 	bool isolateSelected;
 	std::vector<std::vector<Vec3f> *> allBoundarySegments;
+	//! Locates the positions in the constellations of the current boundaries.
+	ConstellationBoundaryIndex boundaryIndex;
 
 	QString lastLoadedSkyCulture;	// Store the last loaded sky culture directory name
 
+	//! Whether the sky culture changes read the files in the background.
+	bool flagAsyncSkyCultureLoading;
+	//! The sky culture being loaded in the background, empty if none.
+	QString pendingSkyCulture;
+	QFutureWatcher<SkyCultureData> skyCultureWatcher;
+	//! The sky cultures waiting to be preloaded, the one being preloaded and the ones ready.
+	QStringList preloadQueue;
+	QString preloadingSkyCulture;
+	QFutureWatcher<SkyCultureData> preloadWatcher;
+	QHash<QString, SkyCultureData> preloadedSkyCultures;
+
 	// These are THE master settings - individual constellation settings can vary based on selection status
 	float artFadeDuration;
 	float artIntensity;
@@ -317,6 +417,9 @@ private:
 	bool boundariesDisplayed;
 	bool linesDisplayed;
 	bool namesDisplayed;
+
+	//! Draw the lines, boundaries and art from static GPU buffers, NULL if disabled.
+	ConstellationGpuDrawer* gpuDrawer;
 };
 
 #endif // _CONSTELLATIONMGR_HPP_
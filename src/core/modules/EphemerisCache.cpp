@@ -0,0 +1,225 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "EphemerisCache.hpp"
+
+#include <cmath>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtGlobal>
+
+//! Fit a window in the thread pool.
+class EphemerisCache::PrefetchJob : public StelJob
+{
+public:
+	PrefetchJob(EphemerisCache* cache, double start, double length) : cache(cache), start(start), length(length) {}
+	virtual void run()
+	{
+		Window window;
+		if (cache->fit(window, start, length, false))
+		{
+			QMutexLocker lock(&cache->prefetchedMutex);
+			cache->prefetched = window;
+		}
+		cache->prefetchRunning.fetchAndStoreOrdered(0);
+	}
+private:
+	EphemerisCache* cache;
+	const double start;
+	const double length;
+};
+
+EphemerisCache::EphemerisCache(PosFunc func, double windowLength, int degree, double tolerance)
+	: func(func)
+	, windowLength(windowLength)
+	, minWindowLength(windowLength/64.)
+	, degree(qMax(degree, 2))
+	, tolerance(tolerance)
+	, enabled(windowLength>0.)
+	, lastMissedWindow(0)
+	, prefetchRunning(0)
+	, nbFullEvaluations(0)
+{
+	Q_ASSERT(func);
+}
+
+QMutex* EphemerisCache::getSeriesMutex()
+{
+	static QMutex mutex;
+	return &mutex;
+}
+
+void EphemerisCache::staticPosFunc(double jd, double xyz[3], void* userDataPtr)
+{
+	static_cast<EphemerisCache*>(userDataPtr)->compute(jd, xyz);
+}
+
+void EphemerisCache::evaluate(double jd, double xyz[3], bool counted)
+{
+	if (counted)
+		++nbFullEvaluations;
+	QMutexLocker lock(getSeriesMutex());
+	func(jd, xyz, NULL);
+}
+
+void EphemerisCache::compute(double jd, double xyz[3])
+{
+	if (!enabled)
+	{
+		evaluate(jd, xyz);
+		return;
+	}
+	if (current.contains(jd))
+	{
+		interpolate(current, jd, xyz);
+		return;
+	}
+
+	// The window the time moved into may have been fitted in the background. The windows are
+	// swapped, so that a date of the previous window, like a point of an orbit, doesn't lose it.
+	{
+		QMutexLocker lock(&prefetchedMutex);
+		if (prefetched.contains(jd))
+		{
+			qSwap(current, prefetched);
+			lock.unlock();
+			interpolate(current, jd, xyz);
+			return;
+		}
+	}
+
+	// Only fit a window when the time is moving through it, i.e. on the second request in it
+	const qint64 window = (qint64)std::floor(jd/windowLength);
+	if (window!=lastMissedWindow || !fitWindow(jd))
+	{
+		lastMissedWindow = window;
+		evaluate(jd, xyz);
+		return;
+	}
+	interpolate(current, jd, xyz);
+}
+
+void EphemerisCache::prefetch(double jd, double rate, StelJobSystem* jobs)
+{
+	// The fit is started when the time will leave the current window within this number of seconds
+	static const double horizon = 0.5;
+	if (!enabled || rate==0. || prefetchRunning.load())
+		return;
+
+	// The window reached after the horizon, when it is not the one of the current date
+	const double length = windowLength;
+	const double start = std::floor((jd+rate*horizon)/length)*length;
+	if (start==std::floor(jd/length)*length)
+		return;
+	if (current.length==length && current.start==start)
+		return;
+	{
+		QMutexLocker lock(&prefetchedMutex);
+		if (prefetched.length==length && prefetched.start==start)
+			return;
+	}
+	prefetchRunning.fetchAndStoreOrdered(1);
+	jobs->submit(prefetchGroup, new PrefetchJob(this, start, length), StelJobSystem::PriorityBackground);
+}
+
+void EphemerisCache::waitForPrefetch()
+{
+	prefetchGroup.wait();
+}
+
+bool EphemerisCache::fitWindow(double jd)
+{
+	while (windowLength>=minWindowLength)
+	{
+		if (fit(current, std::floor(jd/windowLength)*windowLength, windowLength, true))
+			return true;
+		windowLength *= 0.5;
+	}
+
+	qDebug() << "EphemerisCache: cannot reach the required accuracy, using the full series";
+	current = Window();
+	enabled = false;
+	return false;
+}
+
+bool EphemerisCache::fit(Window& window, double start, double length, bool counted)
+{
+	const int n = degree+1;
+	QVector<double> values[3];
+	for (int i=0; i<3; ++i)
+		values[i].resize(n);
+	window.start = start;
+	window.length = length;
+
+	// Evaluate the series at the Chebyshev nodes of the window
+	double xyz[3];
+	for (int k=0; k<n; ++k)
+	{
+		const double x = std::cos(M_PI*(k+0.5)/n);
+		evaluate(start+0.5*length*(x+1.), xyz, counted);
+		for (int i=0; i<3; ++i)
+			values[i][k] = xyz[i];
+	}
+	for (int i=0; i<3; ++i)
+	{
+		window.coeffs[i].resize(n);
+		for (int j=0; j<n; ++j)
+		{
+			double sum = 0.;
+			for (int k=0; k<n; ++k)
+				sum += values[i][k]*std::cos(M_PI*j*(k+0.5)/n);
+			window.coeffs[i][j] = 2.*sum/n;
+		}
+	}
+
+	// Check the fit between the nodes, near the ends of the window where the error is the largest
+	const double checkDates[2] = {start+0.02*length, start+0.73*length};
+	for (int c=0; c<2; ++c)
+	{
+		double ref[3], fitted[3];
+		evaluate(checkDates[c], ref, counted);
+		interpolate(window, checkDates[c], fitted);
+		const double dist2 = ref[0]*ref[0]+ref[1]*ref[1]+ref[2]*ref[2];
+		const double err2 = (ref[0]-fitted[0])*(ref[0]-fitted[0])+(ref[1]-fitted[1])*(ref[1]-fitted[1])+(ref[2]-fitted[2])*(ref[2]-fitted[2]);
+		if (err2>tolerance*tolerance*dist2)
+		{
+			window.length = 0.;
+			return false;
+		}
+	}
+	return true;
+}
+
+void EphemerisCache::interpolate(const Window& window, double jd, double xyz[3])
+{
+	// Clenshaw recurrence on the normalized date in [-1, 1]
+	const double x = 2.*(jd-window.start)/window.length-1.;
+	for (int i=0; i<3; ++i)
+	{
+		const QVector<double>& c = window.coeffs[i];
+		double b1 = 0., b2 = 0.;
+		for (int j=c.size()-1; j>=1; --j)
+		{
+			const double b0 = 2.*x*b1 - b2 + c[j];
+			b2 = b1;
+			b1 = b0;
+		}
+		xyz[i] = x*b1 - b2 + 0.5*c[0];
+	}
+}
@@ -0,0 +1,129 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _EPHEMERISCACHE_HPP_
+#define _EPHEMERISCACHE_HPP_
+
+#include "StelJobSystem.hpp"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVector>
+
+//! @class EphemerisCache
+//! Cache the evaluations of an analytical ephemeris (VSOP87, ELP82B, L1, TASS17, GUST86...)
+//! with Chebyshev polynomials fitted over short time windows.
+//! When a date falls in the current window the position is interpolated from the fit, which
+//! costs a few multiplications instead of the evaluation of the full series.
+//! A new window is fitted only when two successive requests fall in it, so that random access
+//! dates, like the sampling of an orbit, are evaluated directly without wasting fits.
+//! Each fit is checked against the full series at dates which are not fitting nodes, and the
+//! window is shortened until the fit is accurate enough. If even the shortest window does not
+//! reach the required accuracy, the full series is always used.
+//! When the time runs fast, prefetch() fits the window the time is moving into on the thread
+//! pool, so that the frames crossing the windows don't stall on the fits.
+//! The cache has the same signature as the posFuncType of the Planet class, so it can
+//! be used in place of the original function using staticPosFunc() and the cache as user data.
+class EphemerisCache
+{
+public:
+	typedef void (*PosFunc)(double, double*, void*);
+
+	//! @param func the function computing the position, called with NULL user data.
+	//! @param windowLength the initial length of the fitted windows in days.
+	//! @param degree the degree of the Chebyshev polynomials.
+	//! @param tolerance the maximum error relative to the distance (i.e. in radian).
+	EphemerisCache(PosFunc func, double windowLength, int degree=12, double tolerance=1e-8);
+
+	//! Get the position at the given date, from the cache if possible.
+	void compute(double jd, double xyz[3]);
+
+	//! Function to use as posFuncType with the cache as user data.
+	static void staticPosFunc(double jd, double xyz[3], void* userDataPtr);
+
+	//! Fit in the background the window the time is moving into, if it will be reached soon.
+	//! Does nothing while a fit is running, or when the cache is disabled.
+	//! @param jd the current date.
+	//! @param rate the speed of the time in days per second, negative when it runs backward.
+	//! @param jobs the job system running the fit.
+	void prefetch(double jd, double rate, StelJobSystem* jobs);
+	//! Wait for the fit started by prefetch(), if any.
+	void waitForPrefetch();
+
+	//! Get the current window length in days, or 0 if the cache is disabled.
+	double getWindowLength() const {return enabled ? windowLength : 0.;}
+
+	//! Get the number of evaluations of the full series in the thread calling compute(), since the
+	//! creation of the cache. The evaluations of the prefetches are not counted.
+	int getNbFullEvaluations() const {return nbFullEvaluations;}
+
+	//! Get the mutex held while any of the caches evaluates its function.
+	//! The analytical theories keep shared static caches, so that they must not be evaluated
+	//! outside of this mutex, e.g. through the osculating functions, while a prefetch is running.
+	static QMutex* getSeriesMutex();
+
+private:
+	//! A time window with the Chebyshev coefficients for x, y and z.
+	struct Window
+	{
+		Window() : start(0.), length(0.) {}
+		bool contains(double jd) const {return length>0. && jd>=start && jd<start+length;}
+		double start;
+		double length;
+		QVector<double> coeffs[3];
+	};
+	class PrefetchJob;
+
+	//! Fit the window containing jd, shortening it until the fit is accurate.
+	//! @return false if the cache cannot reach the tolerance and was disabled.
+	bool fitWindow(double jd);
+	//! Fit a window of the given position, and check it at dates which are not fitting nodes.
+	//! @param counted whether the evaluations are counted in nbFullEvaluations.
+	//! @return whether the fit reaches the tolerance.
+	bool fit(Window& window, double start, double length, bool counted);
+	//! Evaluate the fit at the given date, which must be in the window.
+	static void interpolate(const Window& window, double jd, double xyz[3]);
+	//! Call the original function.
+	void evaluate(double jd, double xyz[3], bool counted=true);
+
+	PosFunc func;
+	double windowLength;
+	const double minWindowLength;
+	const int degree;
+	const double tolerance;
+	bool enabled;
+
+	//! The window of the last dates served, with a null length when there is none.
+	Window current;
+	//! Index of the window containing the last date which could not be served.
+	qint64 lastMissedWindow;
+
+	//! The window fitted by the last prefetch, protected by prefetchedMutex.
+	Window prefetched;
+	QMutex prefetchedMutex;
+	//! Whether a prefetch job is queued or running.
+	QAtomicInt prefetchRunning;
+
+	int nbFullEvaluations;
+
+	//! Declared last so that the running prefetch is finished before the other members are destroyed.
+	StelJobGroup prefetchGroup;
+};
+
+#endif // _EPHEMERISCACHE_HPP_
@@ -0,0 +1,143 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "GridGpuDrawer.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QDebug>
+
+GridGpuDrawer::GridGpuDrawer()
+	: currentProgram(NULL)
+	, vertexLoc(-1)
+	, colorLoc(-1)
+{
+}
+
+GridGpuDrawer::~GridGpuDrawer()
+{
+	foreach (const Buffer& b, buffers)
+	{
+		b.buffer->destroy();
+		delete b.buffer;
+	}
+	buffers.clear();
+}
+
+QOpenGLShaderProgram* GridGpuDrawer::getProgram(const QByteArray& forwardTransform)
+{
+	static const char* vertexHeader =
+		"attribute highp vec3 vertex;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"varying mediump float valid;\n";
+	static const char* vertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(vertex, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    valid = win.z < 0.5 ? 0. : 1.;\n"
+		"}\n";
+
+	// The segments with a point which can't be projected are discarded, like in OrbitGpuDrawer.
+	static const char* fsrc =
+		"varying mediump float valid;\n"
+		"uniform mediump vec4 color;\n"
+		"void main(void)\n"
+		"{\n"
+		"    if (valid < 0.999)\n"
+		"        discard;\n"
+		"    gl_FragColor = color;\n"
+		"}\n";
+
+	return StelPainter::getProjectionProgram("gridGpuShader", forwardTransform, vertexHeader, vertexMain, fsrc);
+}
+
+bool GridGpuDrawer::begin(const StelProjectorP& prj)
+{
+	Q_ASSERT(currentProgram==NULL);
+	const QByteArray forwardTransform = prj->getForwardTransformShader();
+	if (forwardTransform.isEmpty())
+		return false;
+	currentProgram = getProgram(forwardTransform);
+	if (!currentProgram)
+		return false;
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+	const Mat4f& m = prj->getProjectionMatrix();
+	const Mat4d mv = prj->getModelViewTransform()->getApproximateLinearTransfo();
+	StelPainter::flushPendingText();
+	currentProgram->bind();
+	currentProgram->setUniformValue("projectionMatrix", StelPainter::toQMatrix(m));
+	currentProgram->setUniformValue("modelViewMatrix", StelPainter::toQMatrix(mv));
+	currentProgram->setUniformValue("screenCenter", screenCenter[0], screenCenter[1]);
+	currentProgram->setUniformValue("screenScale", screenScale[0], screenScale[1]);
+	vertexLoc = currentProgram->attributeLocation("vertex");
+	colorLoc = currentProgram->uniformLocation("color");
+	currentProgram->enableAttributeArray(vertexLoc);
+
+	// Normal transparency mode
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	return true;
+}
+
+void GridGpuDrawer::drawLines(const void* owner, const QVector<Vec3f>& vertices, int version, const Vec4f& color)
+{
+	Q_ASSERT(currentProgram);
+	if (vertices.isEmpty())
+		return;
+
+	QHash<const void*, Buffer>::iterator it = buffers.find(owner);
+	if (it==buffers.end())
+	{
+		Buffer b;
+		b.buffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		b.buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+		b.buffer->create();
+		// Make sure that the geometry is uploaded below
+		b.version = version-1;
+		it = buffers.insert(owner, b);
+	}
+	Buffer& b = it.value();
+	b.buffer->bind();
+	if (b.version!=version)
+	{
+		b.buffer->allocate(vertices.constData(), vertices.size()*sizeof(Vec3f));
+		b.version = version;
+	}
+
+	currentProgram->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 3);
+	currentProgram->setUniformValue(colorLoc, color[0], color[1], color[2], color[3]);
+	glDrawArrays(GL_LINES, 0, vertices.size());
+	b.buffer->release();
+}
+
+void GridGpuDrawer::end()
+{
+	Q_ASSERT(currentProgram);
+	currentProgram->disableAttributeArray(vertexLoc);
+	currentProgram->release();
+	currentProgram = NULL;
+}
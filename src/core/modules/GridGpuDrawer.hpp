@@ -0,0 +1,77 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _GRIDGPUDRAWER_HPP_
+#define _GRIDGPUDRAWER_HPP_
+
+#include "VecMath.hpp"
+#include "StelProjectorType.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
+
+//! @class GridGpuDrawer
+//! Draw the tessellated lines of the sky grids and sky lines from GPU buffers.
+//! Each grid or line owns a geometry which is uploaded to its own buffer only when its version changes,
+//! and the projection is done in the vertex shader, so that a whole grid is drawn with one glDrawArrays call.
+//! Only the projections providing a StelProjector::getForwardTransformShader() are supported,
+//! and refraction is not applied to the lines drawn this way.
+class GridGpuDrawer
+{
+public:
+	GridGpuDrawer();
+	~GridGpuDrawer();
+
+	//! Prepare the drawing of lines with the given projector.
+	//! @return false if the projection cannot be performed on the GPU,
+	//! in which case the StelPainter path has to be used.
+	bool begin(const StelProjectorP& prj);
+
+	//! Draw the lines of a grid, uploading them first if they changed.
+	//! @param owner the grid owning the geometry, to which the buffer is associated.
+	//! @param vertices the pairs of points of the segments, in the frame of the projector.
+	//! @param version a number changed by the owner each time the vertices change.
+	//! @param color the RGBA color of the lines.
+	void drawLines(const void* owner, const QVector<Vec3f>& vertices, int version, const Vec4f& color);
+
+	//! Finish drawing and restore the GL state.
+	void end();
+
+private:
+	//! Get or build the shader program for the given forward transform code.
+	QOpenGLShaderProgram* getProgram(const QByteArray& forwardTransform);
+
+	//! The buffer of one grid, and the version of the geometry it holds.
+	struct Buffer
+	{
+		QOpenGLBuffer* buffer;
+		int version;
+	};
+	QHash<const void*, Buffer> buffers;
+
+	QOpenGLShaderProgram* currentProgram;
+	int vertexLoc;
+	int colorLoc;
+};
+
+#endif // _GRIDGPUDRAWER_HPP_
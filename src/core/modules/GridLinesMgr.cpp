@@ -30,12 +30,61 @@
 #include "StelPainter.hpp"
 #include "StelSkyDrawer.hpp"
 #include "StelMovementMgr.hpp"
+#include "GridGpuDrawer.hpp"
 
 #include <set>
 #include <QSettings>
 #include <QDebug>
 #include <QFontMetrics>
 
+struct ViewportEdgeIntersectCallbackData;
+
+//! The tessellated lines of a grid or line drawn with the GridGpuDrawer, and the labels placed
+//! where they cross the edges of the viewport, which are computed again only when the view changes.
+struct GridGeometry
+{
+	GridGeometry() : version(0), labelsVersion(-1) {}
+
+	//! One meridian, parallel or line in vertices, with what its label shows.
+	struct Line
+	{
+		int first;
+		int count;
+		double raAngle;
+		QString text;
+	};
+	//! The label at an intersection of a line with the viewport edge, as given to viewportEdgeIntersectCallback().
+	struct Label
+	{
+		Vec3d screenPos;
+		Vec3d direction;
+		double raAngle;
+		QString text;
+	};
+
+	//! Remove all the lines.
+	void clear();
+	//! Add a line going through the given points.
+	void addLine(const QVector<Vec3d>& points, double raAngle, const QString& text);
+	//! Compute the labels again if the view or the lines changed since the last call.
+	void updateLabels(const StelProjectorP& prj);
+	//! Draw the labels with viewportEdgeIntersectCallback().
+	void drawLabels(ViewportEdgeIntersectCallbackData* userData) const;
+
+	//! The pairs of points of the segments of all the lines.
+	QVector<Vec3f> vertices;
+	QVector<Line> lines;
+	//! Changed each time the lines change, so that the GridGpuDrawer uploads them again.
+	int version;
+
+	QVector<Label> labels;
+	//! The version of the lines and the view the labels were computed for.
+	int labelsVersion;
+	Mat4d labelsModelView;
+	Mat4f labelsProjection;
+	Vec4i labelsViewport;
+};
+
 //! @class SkyGrid
 //! Class which manages a grid to display in the sky.
 //! TODO needs support for DMS/DMS labelling, not only HMS/DMS
@@ -53,11 +102,31 @@ public:
 	void setFadeDuration(float duration) {fader.setDuration((int)(duration*1000.f));}
 	void setDisplayed(const bool displayed){fader = displayed;}
 	bool isDisplayed(void) const {return fader;}
+	//! Set the drawer used to draw the lines from GPU buffers, NULL to use the StelPainter.
+	void setGpuDrawer(GridGpuDrawer* drawer) {gpuDrawer = drawer;}
 private:
+	//! Compute the spacing of the meridians and parallels for the current view, and the
+	//! longitude and latitude at the center of the viewport.
+	void computeGridSteps(const StelProjectorP& prj, double* stepMeridian, double* stepParallel, double* lonCenter, double* latCenter) const;
+	//! Draw the grid with the gpuDrawer.
+	//! @return false if the projection cannot be performed on the GPU.
+	bool drawGpu(const StelCore* core) const;
+	//! Tessellate the lines of the part of the grid around the view, if the spacing of the lines
+	//! changed or if the view left the part which was tessellated.
+	void updateGeometry(const StelProjectorP& prj, double stepMeridian, double stepParallel) const;
+
 	Vec3f color;
 	StelCore::FrameType frameType;
 	QFont font;
 	LinearFader fader;
+
+	GridGpuDrawer* gpuDrawer;
+	mutable GridGeometry geometry;
+	//! The spacing and the cap around which the geometry was tessellated.
+	mutable double geometryStepMeridian;
+	mutable double geometryStepParallel;
+	mutable Vec3d geometryCenter;
+	mutable double geometryRadius;
 };
 
 
@@ -87,17 +156,33 @@ public:
 	void setFontSize(double newSize);
 	//! Re-translates the label.
 	void updateLabel();
+	//! Set the drawer used to draw the line from a GPU buffer, NULL to use the StelPainter.
+	void setGpuDrawer(GridGpuDrawer* drawer) {gpuDrawer = drawer;}
 private:
+	//! Draw the line with the gpuDrawer.
+	//! @return false if the projection cannot be performed on the GPU.
+	bool drawGpu(StelCore* core) const;
+
 	SKY_LINE_TYPE line_type;
 	Vec3f color;
 	StelCore::FrameType frameType;
 	LinearFader fader;
 	QFont font;
 	QString label;
+
+	GridGpuDrawer* gpuDrawer;
+	//! The whole circle of the line, tessellated once.
+	mutable GridGeometry geometry;
 };
 
 // rms added color as parameter
-SkyGrid::SkyGrid(StelCore::FrameType frame) : color(0.2,0.2,0.2), frameType(frame)
+SkyGrid::SkyGrid(StelCore::FrameType frame)
+	: color(0.2,0.2,0.2)
+	, frameType(frame)
+	, gpuDrawer(NULL)
+	, geometryStepMeridian(0.)
+	, geometryStepParallel(0.)
+	, geometryRadius(0.)
 {
 	font.setPixelSize(12);
 }
@@ -277,13 +362,86 @@ void viewportEdgeIntersectCallback(const Vec3d& screenPos, const Vec3d& directio
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-//! Draw the sky grid in the current frame
-void SkyGrid::draw(const StelCore* core) const
+void GridGeometry::clear()
 {
-	const StelProjectorP prj = core->getProjection(frameType, frameType!=StelCore::FrameAltAz ? StelCore::RefractionAuto : StelCore::RefractionOff);
-	if (!fader.getInterstate())
+	vertices.clear();
+	lines.clear();
+	++version;
+}
+
+void GridGeometry::addLine(const QVector<Vec3d>& points, double raAngle, const QString& text)
+{
+	Line line;
+	line.first = vertices.size();
+	line.raAngle = raAngle;
+	line.text = text;
+	for (int i=0;i+1<points.size();++i)
+	{
+		const Vec3d& p1 = points.at(i);
+		const Vec3d& p2 = points.at(i+1);
+		vertices << Vec3f(p1[0], p1[1], p1[2]) << Vec3f(p2[0], p2[1], p2[2]);
+	}
+	line.count = vertices.size()-line.first;
+	lines.append(line);
+}
+
+void GridGeometry::updateLabels(const StelProjectorP& prj)
+{
+	const Mat4d modelView = prj->getModelViewTransform()->getApproximateLinearTransfo();
+	const Mat4f& projection = prj->getProjectionMatrix();
+	bool sameView = labelsVersion==version && labelsViewport==prj->getViewport();
+	for (int i=0;i<16 && sameView;++i)
+		sameView = labelsModelView[i]==modelView[i] && labelsProjection[i]==projection[i];
+	if (sameView)
 		return;
+	labelsVersion = version;
+	labelsModelView = modelView;
+	labelsProjection = projection;
+	labelsViewport = prj->getViewport();
+	labels.clear();
 
+	// Same rule as StelPainter::drawSmallCircleArc() to place the labels where the lines leave the viewport
+	const SphericalCap& viewPortSphericalCap = prj->getBoundingCap();
+	for (int l=0;l<lines.size();++l)
+	{
+		const Line& line = lines.at(l);
+		for (int i=line.first;i<line.first+line.count;i+=2)
+		{
+			const Vec3d v1(vertices.at(i)[0], vertices.at(i)[1], vertices.at(i)[2]);
+			const Vec3d v2(vertices.at(i+1)[0], vertices.at(i+1)[1], vertices.at(i+1)[2]);
+			// The segments are short enough compared to the view to only look at those touching its bounding cap
+			if (!viewPortSphericalCap.contains(v1) && !viewPortSphericalCap.contains(v2))
+				continue;
+			Vec3d win1, win2;
+			const bool valid1 = prj->project(v1, win1);
+			const bool valid2 = prj->project(v2, win2);
+			const bool in1 = prj->checkInViewport(win1);
+			const bool in2 = prj->checkInViewport(win2);
+			if (in1==in2 || !((valid1 && in1) || (valid2 && in2)))
+				continue;
+			Label label;
+			label.screenPos = in1 ? prj->viewPortIntersect(win1, win2) : prj->viewPortIntersect(win2, win1);
+			label.direction = in1 ? win2-win1 : win1-win2;
+			label.raAngle = line.raAngle;
+			label.text = line.text;
+			labels.append(label);
+		}
+	}
+}
+
+void GridGeometry::drawLabels(ViewportEdgeIntersectCallbackData* userData) const
+{
+	for (int i=0;i<labels.size();++i)
+	{
+		const Label& label = labels.at(i);
+		userData->raAngle = label.raAngle;
+		userData->text = label.text;
+		viewportEdgeIntersectCallback(label.screenPos, label.direction, userData);
+	}
+}
+
+void SkyGrid::computeGridSteps(const StelProjectorP& prj, double* stepMeridian, double* stepParallel, double* lonCenter, double* latCenter) const
+{
 	// Look for all meridians and parallels intersecting with the disk bounding the viewport
 	// Check whether the pole are in the viewport
 	bool northPoleInViewport = false;
@@ -309,6 +467,130 @@ void SkyGrid::draw(const StelCore* core) const
 		gridStepMeridianRad = M_PI/180.* ((northPoleInViewport || southPoleInViewport) ? 15. : closetResLon);
 	}
 
+	*stepMeridian = gridStepMeridianRad;
+	*stepParallel = gridStepParallelRad;
+	*lonCenter = lon2;
+	*latCenter = lat2;
+}
+
+void SkyGrid::updateGeometry(const StelProjectorP& prj, double stepMeridian, double stepParallel) const
+{
+	const SphericalCap& viewPortSphericalCap = prj->getBoundingCap();
+	const double viewRadius = std::acos(qBound(-1., viewPortSphericalCap.d, 1.));
+	if (stepMeridian==geometryStepMeridian && stepParallel==geometryStepParallel && !geometry.lines.isEmpty()
+		&& (geometryRadius>=M_PI || std::acos(qBound(-1., viewPortSphericalCap.n*geometryCenter, 1.))+viewRadius<=geometryRadius))
+		return;
+
+	// Tessellate the part of the grid in a cap twice as large as the view, so that
+	// it can be used again until the view is moved by about its own size.
+	const double radius = qMin(M_PI, 2.*viewRadius+stepParallel);
+	double lonCenter, latCenter;
+	StelUtils::rectToSphe(&lonCenter, &latCenter, viewPortSphericalCap.n);
+	const double latMin = qMax(-M_PI_2, stepParallel*std::floor((latCenter-radius)/stepParallel));
+	const double latMax = qMin(M_PI_2, stepParallel*std::ceil((latCenter+radius)/stepParallel));
+	double lonMin = 0.;
+	double lonMax = 2.*M_PI;
+	const double maxAbsLat = qMax(std::fabs(latMin), std::fabs(latMax));
+	if (maxAbsLat<M_PI_2-0.0000001 && radius/std::cos(maxAbsLat)<M_PI)
+	{
+		const double lonRadius = radius/std::cos(maxAbsLat);
+		lonMin = stepMeridian*std::floor((lonCenter-lonRadius)/stepMeridian);
+		lonMax = stepMeridian*std::ceil((lonCenter+lonRadius)/stepMeridian);
+	}
+	const bool allLon = lonMax-lonMin>=2.*M_PI-0.0000001;
+
+	// The lines are sampled finely enough to look smooth once projected
+	const double latSampling = qMin(M_PI/180., stepParallel/2.);
+	const double lonSampling = qMin(M_PI/180., stepMeridian/2.);
+	const int nbLatSamples = qMax(1, (int)std::ceil((latMax-latMin)/latSampling));
+	const int nbLonSamples = qMax(1, (int)std::ceil((lonMax-lonMin)/lonSampling));
+
+	geometry.clear();
+	QVector<Vec3d> points;
+	Vec3d v;
+
+	// The meridians (great circles)
+	const int nbMeridians = (int)((lonMax-lonMin)/stepMeridian+0.5) + (allLon ? 0 : 1);
+	for (int i=0;i<nbMeridians;++i)
+	{
+		double lon = lonMin+i*stepMeridian;
+		points.clear();
+		for (int j=0;j<=nbLatSamples;++j)
+		{
+			StelUtils::spheToRect(lon, latMin+(latMax-latMin)*j/nbLatSamples, v);
+			points << v;
+		}
+		// Same range as the longitudes given by StelUtils::rectToSphe() in SkyGrid::draw()
+		lon = std::fmod(lon, 2.*M_PI);
+		if (lon>M_PI)
+			lon -= 2.*M_PI;
+		else if (lon<=-M_PI)
+			lon += 2.*M_PI;
+		geometry.addLine(points, lon, QString());
+	}
+
+	// The parallels (small circles)
+	const int firstParallel = (int)std::floor(latMin/stepParallel+0.5);
+	const int lastParallel = (int)std::floor(latMax/stepParallel+0.5);
+	for (int i=firstParallel;i<=lastParallel;++i)
+	{
+		const double lat = i*stepParallel;
+		if (std::fabs(lat)>=M_PI_2-0.0000001)
+			continue;
+		points.clear();
+		for (int j=0;j<=nbLonSamples;++j)
+		{
+			StelUtils::spheToRect(lonMin+(lonMax-lonMin)*j/nbLonSamples, lat, v);
+			points << v;
+		}
+		geometry.addLine(points, 0., StelUtils::radToDmsStrAdapt(lat));
+	}
+
+	geometryStepMeridian = stepMeridian;
+	geometryStepParallel = stepParallel;
+	geometryCenter = viewPortSphericalCap.n;
+	geometryRadius = radius;
+}
+
+bool SkyGrid::drawGpu(const StelCore* core) const
+{
+	// Refraction isn't applied by the GridGpuDrawer, so the labels are placed without it too
+	const StelProjectorP prj = core->getProjection(frameType, StelCore::RefractionOff);
+	if (!gpuDrawer->begin(prj))
+		return false;
+
+	double stepMeridian, stepParallel, lonCenter, latCenter;
+	computeGridSteps(prj, &stepMeridian, &stepParallel, &lonCenter, &latCenter);
+	updateGeometry(prj, stepMeridian, stepParallel);
+	gpuDrawer->drawLines(this, geometry.vertices, geometry.version, Vec4f(color[0], color[1], color[2], fader.getInterstate()));
+	gpuDrawer->end();
+
+	geometry.updateLabels(prj);
+	StelPainter sPainter(prj);
+	sPainter.setFont(font);
+	Vec4f textColor(color[0], color[1], color[2], 0);
+	textColor*=2;
+	textColor[3]=fader.getInterstate();
+	ViewportEdgeIntersectCallbackData userData(&sPainter);
+	userData.textColor = textColor;
+	userData.frameType = frameType;
+	geometry.drawLabels(&userData);
+	return true;
+}
+
+//! Draw the sky grid in the current frame
+void SkyGrid::draw(const StelCore* core) const
+{
+	const StelProjectorP prj = core->getProjection(frameType, frameType!=StelCore::FrameAltAz ? StelCore::RefractionAuto : StelCore::RefractionOff);
+	if (!fader.getInterstate())
+		return;
+
+	if (gpuDrawer && drawGpu(core))
+		return;
+
+	double gridStepMeridianRad, gridStepParallelRad, lon2, lat2;
+	computeGridSteps(prj, &gridStepMeridianRad, &gridStepParallelRad, &lon2, &lat2);
+
 	// Get the bounding halfspace
 	const SphericalCap& viewPortSphericalCap = prj->getBoundingCap();
 
@@ -520,7 +802,7 @@ void SkyGrid::draw(const StelCore* core) const
 }
 
 
-SkyLine::SkyLine(SKY_LINE_TYPE _line_type) : color(0.f, 0.f, 1.f)
+SkyLine::SkyLine(SKY_LINE_TYPE _line_type) : color(0.f, 0.f, 1.f), gpuDrawer(NULL)
 {
 	font.setPixelSize(14);
 	line_type = _line_type;
@@ -562,6 +844,42 @@ void SkyLine::updateLabel()
 			label = q_("Galactic Plane");
 			break;
 	}
+	// The label of the line is stored with its geometry
+	geometry.clear();
+}
+
+bool SkyLine::drawGpu(StelCore* core) const
+{
+	// Refraction isn't applied by the GridGpuDrawer, so the labels are placed without it too
+	const StelProjectorP prj = core->getProjection(frameType, StelCore::RefractionOff);
+	if (!gpuDrawer->begin(prj))
+		return false;
+
+	if (geometry.lines.isEmpty())
+	{
+		// The whole great circle, in the plane used by SkyLine::draw()
+		static const int nbSamples = 720;
+		QVector<Vec3d> points;
+		for (int i=0;i<=nbSamples;++i)
+		{
+			const double a = 2.*M_PI*i/nbSamples;
+			if (line_type==MERIDIAN)
+				points << Vec3d(std::cos(a), 0., std::sin(a));
+			else
+				points << Vec3d(std::cos(a), std::sin(a), 0.);
+		}
+		geometry.addLine(points, 0., label);
+	}
+	gpuDrawer->drawLines(this, geometry.vertices, geometry.version, Vec4f(color[0], color[1], color[2], fader.getInterstate()));
+	gpuDrawer->end();
+
+	geometry.updateLabels(prj);
+	StelPainter sPainter(prj);
+	sPainter.setFont(font);
+	ViewportEdgeIntersectCallbackData userData(&sPainter);
+	userData.textColor = Vec4f(color[0], color[1], color[2], fader.getInterstate());
+	geometry.drawLabels(&userData);
+	return true;
 }
 
 void SkyLine::draw(StelCore *core) const
@@ -569,6 +887,9 @@ void SkyLine::draw(StelCore *core) const
 	if (!fader.getInterstate())
 		return;
 
+	if (gpuDrawer && drawGpu(core))
+		return;
+
 	StelProjectorP prj = core->getProjection(frameType, frameType!=StelCore::FrameAltAz ? StelCore::RefractionAuto : StelCore::RefractionOff);
 
 	// Get the bounding halfspace
@@ -633,7 +954,7 @@ void SkyLine::draw(StelCore *core) const
 
 }
 
-GridLinesMgr::GridLinesMgr()
+GridLinesMgr::GridLinesMgr() : gpuDrawer(NULL)
 {
 	setObjectName("GridLinesMgr");
 	equGrid = new SkyGrid(StelCore::FrameEquinoxEqu);
@@ -660,6 +981,7 @@ GridLinesMgr::~GridLinesMgr()
 	delete meridianLine;
 	delete horizonLine;
 	delete galacticPlaneLine;
+	delete gpuDrawer;
 }
 
 /*************************************************************************
@@ -687,6 +1009,20 @@ void GridLinesMgr::init()
 	setFlagMeridianLine(conf->value("viewing/flag_meridian_line").toBool());
 	setFlagHorizonLine(conf->value("viewing/flag_horizon_line").toBool());
 	setFlagGalacticPlaneLine(conf->value("viewing/flag_galactic_plane_line").toBool());
+	if (conf->value("viewing/flag_gpu_grid_lines", false).toBool())
+	{
+		gpuDrawer = new GridGpuDrawer();
+		equGrid->setGpuDrawer(gpuDrawer);
+		equJ2000Grid->setGpuDrawer(gpuDrawer);
+		eclJ2000Grid->setGpuDrawer(gpuDrawer);
+		galacticGrid->setGpuDrawer(gpuDrawer);
+		aziGrid->setGpuDrawer(gpuDrawer);
+		equatorLine->setGpuDrawer(gpuDrawer);
+		eclipticLine->setGpuDrawer(gpuDrawer);
+		meridianLine->setGpuDrawer(gpuDrawer);
+		horizonLine->setGpuDrawer(gpuDrawer);
+		galacticPlaneLine->setGpuDrawer(gpuDrawer);
+	}
 	
 	StelApp& app = StelApp::getInstance();
 	connect(&app, SIGNAL(colorSchemeChanged(const QString&)), this, SLOT(setStelStyle(const QString&)));
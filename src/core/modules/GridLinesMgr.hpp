@@ -25,6 +25,7 @@
 
 class SkyGrid;
 class SkyLine;
+class GridGpuDrawer;
 
 //! @class GridLinesMgr
 //! The GridLinesMgr controls the drawing of the Azimuthal and Equatorial Grids,
@@ -133,6 +134,8 @@ public:
 	//! Update time-dependent features.
 	//! Used to control fading when turning on and off the grid lines and great circles.
 	virtual void update(double deltaTime);
+	//! The faders only depend on the time elapsed, so the update can run in parallel.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true);}
 
 	//! Used to determine the order in which the various modules are drawn.
 	virtual double getCallOrder(StelModuleActionName actionName) const;
@@ -321,6 +324,7 @@ private:
 	SkyLine * meridianLine; 	// Meridian line
 	SkyLine * horizonLine;		// Horizon line
 	SkyLine * galacticPlaneLine;	// line depciting the Galacitc plane as defined by the IAU definition of Galactic coordinates
+	GridGpuDrawer * gpuDrawer;	// Draws the grids and lines from GPU buffers, NULL if disabled
 };
 
 #endif // _GRIDLINESMGR_HPP_
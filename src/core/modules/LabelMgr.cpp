@@ -24,6 +24,7 @@
 #include "StelCore.hpp"
 #include "StelLocaleMgr.hpp"
 #include "StelModuleMgr.hpp"
+#include "StelRenderProfile.hpp"
 
 #include "StelProjector.hpp"
 #include "StelModule.hpp"
@@ -34,8 +35,11 @@
 #include "StelPainter.hpp"
 
 #include <vector>
+#include <algorithm>
 #include <QString>
 #include <QDebug>
+#include <QFontMetricsF>
+#include <QSettings>
 
 // Base class from which other label types inherit
 class StelLabel
@@ -329,7 +333,12 @@ bool ScreenLabel::draw(StelCore*, StelPainter& sPainter)
 ///////////////////////
 // LabelMgr class //
 ///////////////////////
-LabelMgr::LabelMgr()
+const float LabelMgr::ConstellationMagnitude = -100.f;
+
+// Size in pixels of the screen cells used to find the overlapping labels
+static const int SkyLabelCellSize = 64;
+
+LabelMgr::LabelMgr() : flagSkyLabelCulling(true), maxSkyLabels(0)
 {
 	setObjectName("LabelMgr");
 }
@@ -340,10 +349,133 @@ LabelMgr::~LabelMgr()
 
 void LabelMgr::init()
 {
+	QSettings* conf = StelApp::getInstance().getSettings();
+	Q_ASSERT(conf);
+	setFlagSkyLabelCulling(conf->value("astro/flag_label_culling", true).toBool());
+	setMaxSkyLabels(conf->value("astro/max_sky_labels", 0).toInt());
+	if (StelApp::getInstance().getRenderProfile()->getMaxSkyLabels()>=0)
+		setMaxSkyLabels(StelApp::getInstance().getRenderProfile()->getMaxSkyLabels());
+}
+
+void LabelMgr::addSkyLabel(StelPainter& sPainter, float x, float y, const QString& text,
+			   float xshift, float yshift, float magnitude)
+{
+	const StelProjectorP& prj = sPainter.getProjector();
+	if (!flagSkyLabelCulling || prj->getFlagGravityLabels())
+	{
+		sPainter.drawText(x, y, text, 0, xshift, yshift, false);
+		return;
+	}
+	skyLabels.resize(skyLabels.size()+1);
+	SkyLabelRequest& label = skyLabels.last();
+	label.font = sPainter.getFont();
+	label.color = sPainter.getColor();
+	label.text = text;
+	label.x = x;
+	label.y = y;
+	label.xshift = xshift;
+	label.yshift = yshift;
+	label.angleDeg = prj->getDefaultAngleForGravityText();
+	label.magnitude = magnitude;
+}
+
+bool LabelMgr::skyLabelBrighter(const SkyLabelRequest& a, const SkyLabelRequest& b)
+{
+	return a.magnitude < b.magnitude;
+}
+
+const LabelMgr::TextExtent& LabelMgr::getTextExtent(const QFont& font, const QString& text)
+{
+	const QString key = font.key()+QChar('\n')+text;
+	QHash<QString, TextExtent>::const_iterator iter = textExtents.constFind(key);
+	if (iter!=textExtents.constEnd())
+		return iter.value();
+	if (textExtents.size()>20000)
+		textExtents.clear();
+	const QFontMetricsF metrics(font);
+	TextExtent extent;
+	extent.width = metrics.width(text);
+	extent.ascent = metrics.ascent();
+	extent.descent = metrics.descent();
+	return textExtents.insert(key, extent).value();
+}
+
+void LabelMgr::drawSkyLabels(StelCore* core)
+{
+	if (skyLabels.isEmpty())
+		return;
+
+	// The labels of the brightest objects are placed first
+	std::stable_sort(skyLabels.begin(), skyLabels.end(), skyLabelBrighter);
+
+	const StelProjectorP prj = core->getProjection2d();
+	const Vec4i& viewport = prj->getViewport();
+	const float globalScalingRatio = StelApp::getInstance().getGlobalScalingRatio();
+	const float fontScale = prj->getDevicePixelsPerPixel()*globalScalingRatio;
+	const int nbCellsX = viewport[2]/SkyLabelCellSize+1;
+	const int nbCellsY = viewport[3]/SkyLabelCellSize+1;
+	cells.resize(nbCellsX*nbCellsY);
+	for (int i=0;i<cells.size();++i)
+		cells[i].resize(0);
+	drawnRects.resize(0);
+
+	StelPainter sPainter(prj);
+	foreach (const SkyLabelRequest& label, skyLabels)
+	{
+		// The labels of the faintest objects are dropped first
+		if (maxSkyLabels>0 && drawnRects.size()>=maxSkyLabels)
+			break;
+
+		// Rectangle of the text in the viewport: left, bottom, right, top.
+		// The rotation of the text is neglected.
+		const TextExtent& extent = getTextExtent(label.font, label.text);
+		const float left = label.x+label.xshift*globalScalingRatio-viewport[0];
+		const float baseline = label.y+label.yshift*globalScalingRatio-viewport[1];
+		const Vec4f rect(left, baseline-extent.descent*fontScale, left+extent.width*fontScale, baseline+extent.ascent*fontScale);
+		if (rect[2]<0 || rect[3]<0 || rect[0]>viewport[2] || rect[1]>viewport[3])
+			continue;
+
+		const int cx0 = qBound(0, (int)(rect[0]/SkyLabelCellSize), nbCellsX-1);
+		const int cy0 = qBound(0, (int)(rect[1]/SkyLabelCellSize), nbCellsY-1);
+		const int cx1 = qBound(0, (int)(rect[2]/SkyLabelCellSize), nbCellsX-1);
+		const int cy1 = qBound(0, (int)(rect[3]/SkyLabelCellSize), nbCellsY-1);
+		bool overlaps = false;
+		for (int cy=cy0;cy<=cy1 && !overlaps;++cy)
+		{
+			for (int cx=cx0;cx<=cx1 && !overlaps;++cx)
+			{
+				foreach (int i, cells.at(cy*nbCellsX+cx))
+				{
+					const Vec4f& r = drawnRects.at(i);
+					if (rect[0]<r[2] && r[0]<rect[2] && rect[1]<r[3] && r[1]<rect[3])
+					{
+						overlaps = true;
+						break;
+					}
+				}
+			}
+		}
+		if (overlaps)
+			continue;
+
+		const int index = drawnRects.size();
+		drawnRects.append(rect);
+		for (int cy=cy0;cy<=cy1;++cy)
+			for (int cx=cx0;cx<=cx1;++cx)
+				cells[cy*nbCellsX+cx].append(index);
+
+		sPainter.setFont(label.font);
+		sPainter.setColor(label.color[0], label.color[1], label.color[2], label.color[3]);
+		sPainter.drawText(label.x, label.y, label.text, label.angleDeg, label.xshift, label.yshift, true);
+	}
+	skyLabels.resize(0);
 }
 
 void LabelMgr::draw(StelCore* core)
 {
+	// In case the LandscapeMgr did not draw them
+	drawSkyLabels(core);
+
 	StelPainter sPainter(core->getProjection(StelCore::FrameJ2000));
 	foreach(StelLabel* l, allLabels) 
 		if (l!=NULL)
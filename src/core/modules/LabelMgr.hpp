@@ -29,6 +29,8 @@
 
 #include <QVector>
 #include <QString>
+#include <QFont>
+#include <QHash>
 
 class StelCore;
 class StelPainter;
@@ -60,10 +62,35 @@ public:
 	
 	//! Update time-dependent parts of the module.
 	virtual void update(double deltaTime);
+	//! Only the faders of the labels are updated, so the update can run in parallel.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true);}
 
 	//! Defines the order in which the various modules are drawn.
 	virtual double getCallOrder(StelModuleActionName actionName) const;
 
+	///////////////////////////////////////////////////////////////////////////
+	// Labels of the sky objects
+	//! Add the label of a sky object to the labels drawn at the end of the sky drawing.
+	//! The labels of all the modules are collected during the frame, and drawSkyLabels() draws
+	//! them together, dropping the labels which would overlap with the labels of brighter objects.
+	//! If the label culling is disabled, or with gravity labels, the label is drawn immediately.
+	//! @param sPainter the painter of the module, whose projector, font and color are used.
+	//! @param x horizontal position of the label in the viewport, in pixels.
+	//! @param y vertical position of the label in the viewport, in pixels.
+	//! @param text the text of the label.
+	//! @param xshift shift in pixels, as for StelPainter::drawText().
+	//! @param yshift shift in pixels, as for StelPainter::drawText().
+	//! @param magnitude the magnitude of the object, the brightest objects keep their labels.
+	void addSkyLabel(StelPainter& sPainter, float x, float y, const QString& text,
+			 float xshift, float yshift, float magnitude);
+
+	//! Draw and clear the labels added since the last call. This is called by the LandscapeMgr
+	//! before drawing the atmosphere and the landscape, so that they still cover the labels.
+	void drawSkyLabels(StelCore* core);
+
+	//! Magnitude given to the constellation names, so that they are kept before any object.
+	static const float ConstellationMagnitude;
+
 public slots:
 	//! Create a label which is attached to a StelObject.
 	//! @param text the text to display
@@ -115,8 +142,47 @@ public slots:
 	//! @return the number of labels deleted
 	int deleteAllLabels(void);
 
+	//! Set whether the labels of the sky objects overlapping brighter ones are hidden.
+	void setFlagSkyLabelCulling(bool b) {flagSkyLabelCulling=b;}
+	//! Get whether the labels of the sky objects overlapping brighter ones are hidden.
+	bool getFlagSkyLabelCulling() const {return flagSkyLabelCulling;}
+	//! Set the maximum number of sky labels drawn per frame when they are culled, 0 for no limit.
+	void setMaxSkyLabels(int n) {maxSkyLabels=n;}
+	//! Get the maximum number of sky labels drawn per frame, 0 if there is no limit.
+	int getMaxSkyLabels() const {return maxSkyLabels;}
+
 private:
 	QVector<class StelLabel*> allLabels;
+
+	//! A label of a sky object waiting to be drawn.
+	struct SkyLabelRequest
+	{
+		QFont font;
+		Vec4f color;
+		QString text;
+		float x, y;
+		float xshift, yshift;
+		float angleDeg;
+		float magnitude;
+	};
+
+	//! Size of a text in pixels, cached by font and text.
+	struct TextExtent
+	{
+		float width;
+		float ascent;
+		float descent;
+	};
+	const TextExtent& getTextExtent(const QFont& font, const QString& text);
+	static bool skyLabelBrighter(const SkyLabelRequest& a, const SkyLabelRequest& b);
+
+	bool flagSkyLabelCulling;
+	int maxSkyLabels;
+	QVector<SkyLabelRequest> skyLabels;
+	QHash<QString, TextExtent> textExtents;
+	//! Screen cells containing the indices of the rectangles of the labels drawn in this frame.
+	QVector<QVector<int> > cells;
+	QVector<Vec4f> drawnRects;
 };
 
 #endif // _SKYLABELMGR_HPP_
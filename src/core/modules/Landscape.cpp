@@ -26,13 +26,20 @@
 #include "StelLocation.hpp"
 #include "StelCore.hpp"
 #include "StelPainter.hpp"
+#include "StelSkyImageTile.hpp"
 
 #include <QDebug>
 #include <QSettings>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
 #include <QVarLengthArray>
 #include <QFile>
 #include <QDir>
 #include <QtAlgorithms>
+#include <QCoreApplication>
+#include <QThread>
+
+#include <cstddef>
 
 Landscape::Landscape(float _radius)
 	: radius(_radius)
@@ -49,6 +56,12 @@ Landscape::Landscape(float _radius)
 	, defaultTemperature(-1000.)
 	, defaultPressure(-2.)
 	, horizonPolygon(NULL)
+	, opacityTableWidth(0)
+	, opacityTableHeight(0)
+	, opacityTableAltMin(0.f)
+	, opacityTableAltMax(0.f)
+	, opacityTableHorizonMin(0.f)
+	, polygonHorizonMin(0.f)
 {
 	validLandscape = 0;
 }
@@ -56,6 +69,27 @@ Landscape::Landscape(float _radius)
 Landscape::~Landscape()
 {}
 
+StelTextureSP Landscape::createTexture(const QString& path, const StelTexture::StelTextureParams& params)
+{
+	StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	if (QThread::currentThread()==QCoreApplication::instance()->thread())
+		return texMgr.createTexture(path, params);
+	// The textures can not be loaded in a worker thread, only created
+	return texMgr.createTextureThread(path, params, true);
+}
+
+bool Landscape::loadTextures()
+{
+	bool ready = true;
+	foreach (const StelTextureSP& tex, getTextures())
+	{
+		// bind() starts the loading, the textures which could not be loaded are not waited for
+		if (tex && !tex->bind() && tex->isLoading())
+			ready = false;
+	}
+	return ready;
+}
+
 
 // Load attributes common to all landscapes
 void Landscape::loadCommon(const QSettings& landscapeIni, const QString& landscapeId)
@@ -200,6 +234,7 @@ void Landscape::createPolygonalHorizon(const QString& lineFileName, const float
 
 		StelUtils::spheToRect(az, alt, point);
 		horiPoints.append(point);
+		polygonHorizonMin = horiPoints.size()==1 ? alt : qMin(polygonHorizonMin, alt);
 	}
 	file.close();
 	//horiPoints.append(horiPoints.at(0)); // close loop? Apparently not necessary.
@@ -223,6 +258,73 @@ const QString Landscape::getTexturePath(const QString& basename, const QString&
 	return path;
 }
 
+// Size of the cells of the opacity table, about the resolution of a 4096 pixels wide panorama
+static const float OpacityTableStep = 0.1f*M_PI/180.f;
+
+void Landscape::buildOpacityTable(float altMin, float altMax)
+{
+	altMin = qMax(altMin, (float)-M_PI_2);
+	altMax = qMin(altMax, (float)M_PI_2);
+	if (altMax<=altMin)
+	{
+		opacityTable.clear();
+		return;
+	}
+	opacityTableAltMin = altMin;
+	opacityTableAltMax = altMax;
+	opacityTableWidth = (int)std::ceil(2.f*M_PI/OpacityTableStep);
+	opacityTableHeight = qMax(1, (int)std::ceil((altMax-altMin)/OpacityTableStep));
+	opacityTable.resize(opacityTableWidth*opacityTableHeight);
+
+	const float dAz = 2.f*M_PI/opacityTableWidth;
+	const float dAlt = (altMax-altMin)/opacityTableHeight;
+	int lowestOpenRow = opacityTableHeight;
+	for (int j=0; j<opacityTableHeight; ++j)
+	{
+		const float alt = altMin + (j+0.5f)*dAlt;
+		const float cosAlt = std::cos(alt);
+		const float sinAlt = std::sin(alt);
+		quint8* row = opacityTable.data() + j*opacityTableWidth;
+		for (int i=0; i<opacityTableWidth; ++i)
+		{
+			const float az = (i+0.5f)*dAz;
+			// Same azimuth convention as getOpacity(): atan2(x, y) is the azimuth from North
+			const Vec3d azalt(std::sin(az)*cosAlt, std::cos(az)*cosAlt, sinAlt);
+			row[i] = (quint8)qRound(qBound(0.f, sampleOpacity(azalt), 1.f)*255.f);
+			if (row[i]<255)
+				lowestOpenRow = qMin(lowestOpenRow, j);
+		}
+	}
+	opacityTableHorizonMin = altMin + lowestOpenRow*dAlt;
+}
+
+float Landscape::getHorizonAltitudeMin() const
+{
+	if (horizonPolygon && !opacityTable.isEmpty())
+		return qMin(polygonHorizonMin, opacityTableHorizonMin);
+	if (horizonPolygon)
+		return polygonHorizonMin;
+	if (!opacityTable.isEmpty())
+		return opacityTableHorizonMin;
+	return 0.f;
+}
+
+float Landscape::lookupOpacity(const Vec3d& azalt) const
+{
+	if (opacityTable.isEmpty())
+		return (azalt[2]<0 ? 1.0f : 0.0f);
+
+	const float alt = std::asin(qBound(-1., azalt[2], 1.));
+	if (alt<opacityTableAltMin) return 1.0f; // below the images, i.e. certainly opaque ground.
+	if (alt>opacityTableAltMax) return 0.0f; // above the images, i.e. certainly free sky.
+
+	float az = std::atan2(azalt[0], azalt[1]);
+	if (az<0) az+=2.f*M_PI;
+	const int i = qMin((int)(az*opacityTableWidth/(2.f*M_PI)), opacityTableWidth-1);
+	const int j = qMin((int)((alt-opacityTableAltMin)*opacityTableHeight/(opacityTableAltMax-opacityTableAltMin)), opacityTableHeight-1);
+	return opacityTable.at(j*opacityTableWidth+i)/255.0f;
+}
+
 LandscapeOldStyle::LandscapeOldStyle(float _radius)
 	: Landscape(_radius)
 	, sideTexs(NULL)
@@ -239,10 +341,23 @@ LandscapeOldStyle::LandscapeOldStyle(float _radius)
 	, drawGroundFirst(0)
 	, tanMode(false)
 	, calibrated(false)
+	, flagGpuMesh(true)
+	, gpuBuffer(NULL)
+	, gpuGroundFirst(0)
+	, gpuGroundCount(0)
+	, gpuFogFirst(0)
+	, gpuFogCount(0)
 {}
 
 LandscapeOldStyle::~LandscapeOldStyle()
 {
+	if (gpuBuffer)
+	{
+		gpuBuffer->destroy();
+		delete gpuBuffer;
+		gpuBuffer = NULL;
+	}
+
 	if (sideTexs)
 	{
 		delete [] sideTexs;
@@ -257,10 +372,20 @@ LandscapeOldStyle::~LandscapeOldStyle()
 	}
 }
 
+QList<StelTextureSP> LandscapeOldStyle::getTextures() const
+{
+	QList<StelTextureSP> textures;
+	for (int i=0; i<nbSideTexs; ++i)
+		textures << sideTexs[i];
+	textures << groundTex << fogTex;
+	return textures;
+}
+
 void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& landscapeId)
 {
 	// TODO: put values into hash and call create() method to consolidate code
 	loadCommon(landscapeIni, landscapeId);
+	flagGpuMesh = StelApp::getInstance().getSettings()->value("landscape/flag_landscape_gpu_mesh", true).toBool();
 	// rows, cols have been loaded already, but with different defaults.
 	// GZ Hey, they are not used altogether! Resolution is constant, below!
 	//rows = landscapeIni.value("landscape/tesselate_rows", 8).toInt();
@@ -275,6 +400,9 @@ void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& lands
 		return;
 	}
 
+	// The opacity can only be sampled for calibrated landscapes
+	calibrated = landscapeIni.value("landscape/calibrated", false).toBool();
+
 	// Load sides textures
 	nbSideTexs = landscapeIni.value("landscape/nbsidetex", 0).toInt();
 	sideTexs = new StelTextureSP[nbSideTexs];
@@ -283,7 +411,7 @@ void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& lands
 		QString textureKey = QString("landscape/tex%1").arg(i);
 		QString textureName = landscapeIni.value(textureKey).toString();
 		const QString texturePath = getTexturePath(textureName, landscapeId);
-		sideTexs[i] = StelApp::getInstance().getTextureManager().createTexture(texturePath);
+		sideTexs[i] = createTexture(texturePath);
 		// GZ: To query the textures, also fill an array of QImage*, but only
 		// if that query is not going to be prevented by the polygon that already has been loaded at that point...
 		if ( (!horizonPolygon) && calibrated ) { // for uncalibrated landscapes the texture is currently never queried, so no need to store.
@@ -327,7 +455,7 @@ void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& lands
 	}
 	QString groundTexName = landscapeIni.value("landscape/groundtex").toString();
 	QString groundTexPath = getTexturePath(groundTexName, landscapeId);
-	groundTex = StelApp::getInstance().getTextureManager().createTexture(groundTexPath, StelTexture::StelTextureParams(true));
+	groundTex = createTexture(groundTexPath, StelTexture::StelTextureParams(true));
 	// GZ 2013/11: I don't see any use of this:
 //	QString description = landscapeIni.value("landscape/ground").toString();
 //	//sscanf(description.toLocal8Bit(),"groundtex:%f:%f:%f:%f",&a,&b,&c,&d);
@@ -340,7 +468,7 @@ void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& lands
 
 	QString fogTexName = landscapeIni.value("landscape/fogtex").toString();
 	QString fogTexPath = getTexturePath(fogTexName, landscapeId);
-	fogTex = StelApp::getInstance().getTextureManager().createTexture(fogTexPath, StelTexture::StelTextureParams(true, GL_LINEAR, GL_REPEAT));
+	fogTex = createTexture(fogTexPath, StelTexture::StelTextureParams(true, GL_LINEAR, GL_REPEAT));
 	// GZ 2013/11: I don't see any use of this:
 //	QString description = landscapeIni.value("landscape/fog").toString();
 //	//sscanf(description.toLocal8Bit(),"fogtex:%f:%f:%f:%f",&a,&b,&c,&d);
@@ -361,7 +489,6 @@ void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& lands
 	groundAngleRotateZ = landscapeIni.value("landscape/ground_angle_rotatez", 0.).toFloat() * M_PI/180.f;
 	drawGroundFirst    = landscapeIni.value("landscape/draw_ground_first", 0).toInt();
 	tanMode            = landscapeIni.value("landscape/tan_mode", false).toBool();
-	calibrated         = landscapeIni.value("landscape/calibrated", false).toBool();
 
 	// Precompute the vertex arrays for ground display
 	// Make slices_per_side=(3<<K) so that the innermost polygon of the fandisk becomes a triangle:
@@ -479,6 +606,18 @@ void LandscapeOldStyle::load(const QSettings& landscapeIni, const QString& lands
 			precomputedSides.append(precompSide);
 		}
 	}
+
+	// The images are only needed to build the opacity table
+	if (!sidesImages.isEmpty())
+	{
+		bool imagesLoaded = true;
+		foreach (const QImage* image, sidesImages)
+			imagesLoaded = imagesLoaded && !image->isNull();
+		if (imagesLoaded)
+			buildOpacityTable(decorAngleShift*M_PI/180.0f, (decorAltAngle+decorAngleShift)*M_PI/180.0f);
+		qDeleteAll(sidesImages);
+		sidesImages.clear();
+	}
 }
 
 void LandscapeOldStyle::draw(StelCore* core)
@@ -491,12 +630,15 @@ void LandscapeOldStyle::draw(StelCore* core)
 
 	if (!validLandscape)
 		return;
-	if (drawGroundFirst)
-		drawGround(core, painter);
-	drawDecor(core, painter);
-	if (!drawGroundFirst)
-		drawGround(core, painter);
-	drawFog(core, painter);
+	if (!flagGpuMesh || !drawGpu(core))
+	{
+		if (drawGroundFirst)
+			drawGround(core, painter);
+		drawDecor(core, painter);
+		if (!drawGroundFirst)
+			drawGround(core, painter);
+		drawFog(core, painter);
+	}
 
 	// If a horizon line also has been defined, draw it.
 	if (horizonPolygon && (horizonPolygonLineColor[0] >= 0))
@@ -533,13 +675,17 @@ void LandscapeOldStyle::drawFog(StelCore* core, StelPainter& sPainter) const
 			  fogFader.getInterstate()*(0.1f+0.1f*landscapeBrightness),
 			  fogFader.getInterstate()*(0.1f+0.1f*landscapeBrightness));
 	fogTex->bind();
-	const float height = (calibrated?
-				radius*(std::tan((fogAltAngle+fogAngleShift)*M_PI/180.)  - std::tan(fogAngleShift*M_PI/180.))
-				: ((tanMode) ? radius*std::tan(fogAltAngle*M_PI/180.) : radius*std::sin(fogAltAngle*M_PI/180.)));
-	sPainter.sCylinder(radius, height, 64, 1);
+	sPainter.sCylinder(radius, getFogHeight(), 64, 1);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+float LandscapeOldStyle::getFogHeight() const
+{
+	return (calibrated?
+		radius*(std::tan((fogAltAngle+fogAngleShift)*M_PI/180.)  - std::tan(fogAngleShift*M_PI/180.))
+		: ((tanMode) ? radius*std::tan(fogAltAngle*M_PI/180.) : radius*std::sin(fogAltAngle*M_PI/180.)));
+}
+
 // Draw the side textures
 void LandscapeOldStyle::drawDecor(StelCore* core, StelPainter& sPainter) const
 {
@@ -575,6 +721,188 @@ void LandscapeOldStyle::drawGround(StelCore* core, StelPainter& sPainter) const
 	sPainter.drawFromArray(StelPainter::Triangles, groundVertexArr.size()/3);
 }
 
+//! Vertex format of the geometry stored in the GPU buffer.
+struct LandscapeGpuVertex
+{
+	Vec3f pos;
+	Vec2f texCoord;
+};
+
+void LandscapeOldStyle::createGpuBuffer()
+{
+	QVector<LandscapeGpuVertex> vertices;
+	LandscapeGpuVertex v;
+
+	// The sides, expanded from their indexed arrays
+	gpuSideFirst.clear();
+	gpuSideCount.clear();
+	foreach (const LOSSide& side, precomputedSides)
+	{
+		gpuSideFirst.append(vertices.size());
+		foreach (unsigned short i, side.arr.indices)
+		{
+			v.pos = Vec3f(side.arr.vertex.at(i)[0], side.arr.vertex.at(i)[1], side.arr.vertex.at(i)[2]);
+			v.texCoord = side.arr.texCoords.at(i);
+			vertices.append(v);
+		}
+		gpuSideCount.append(vertices.size()-gpuSideFirst.last());
+	}
+
+	// The ground fan disk
+	gpuGroundFirst = vertices.size();
+	for (int i=0;i<groundVertexArr.size()/3;++i)
+	{
+		v.pos = Vec3f(groundVertexArr.at(i*3), groundVertexArr.at(i*3+1), groundVertexArr.at(i*3+2));
+		v.texCoord = Vec2f(groundTexCoordArr.at(i*2), groundTexCoordArr.at(i*2+1));
+		vertices.append(v);
+	}
+	gpuGroundCount = vertices.size()-gpuGroundFirst;
+
+	// The fog cylinder, same geometry as StelPainter::sCylinder() with its strip split into triangles
+	gpuFogFirst = vertices.size();
+	const int slices = 64;
+	const float height = getFogHeight();
+	const float da = 2.f * M_PI / slices;
+	LandscapeGpuVertex strip[4];
+	for (int i=0;i<slices;++i)
+	{
+		for (int j=0;j<2;++j)
+		{
+			const float x = std::sin(da*(i+j));
+			const float y = std::cos(da*(i+j));
+			const float s = (float)(i+j)/slices;
+			strip[j*2].pos = Vec3f(x*radius, y*radius, 0.f);
+			strip[j*2].texCoord = Vec2f(s, 0.f);
+			strip[j*2+1].pos = Vec3f(x*radius, y*radius, height);
+			strip[j*2+1].texCoord = Vec2f(s, 1.f);
+		}
+		vertices << strip[0] << strip[1] << strip[2];
+		vertices << strip[2] << strip[1] << strip[3];
+	}
+	gpuFogCount = vertices.size()-gpuFogFirst;
+
+	gpuBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+	gpuBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+	gpuBuffer->create();
+	gpuBuffer->bind();
+	gpuBuffer->allocate(vertices.constData(), vertices.size()*sizeof(LandscapeGpuVertex));
+	gpuBuffer->release();
+}
+
+QOpenGLShaderProgram* LandscapeOldStyle::getGpuProgram(const QByteArray& forwardTransform)
+{
+	static const char* vertexHeader =
+		"attribute highp vec3 pos;\n"
+		"attribute mediump vec2 texCoord;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"varying mediump vec2 texc;\n"
+		"varying mediump float valid;\n";
+	static const char* vertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(pos, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    texc = texCoord;\n"
+		"    valid = win.z < 0.5 ? 0. : 1.;\n"
+		"}\n";
+
+	// The triangles with a vertex which can't be projected are discarded, like the StelPainter does.
+	static const char* fsrc =
+		"varying mediump vec2 texc;\n"
+		"varying mediump float valid;\n"
+		"uniform sampler2D tex;\n"
+		"uniform mediump vec4 color;\n"
+		"void main(void)\n"
+		"{\n"
+		"    if (valid < 0.999)\n"
+		"        discard;\n"
+		"    gl_FragColor = texture2D(tex, texc)*color;\n"
+		"}\n";
+
+	return StelPainter::getProjectionProgram("landscapeGpuShader", forwardTransform, vertexHeader, vertexMain, fsrc);
+}
+
+void LandscapeOldStyle::drawGpuRange(QOpenGLShaderProgram* prog, const Mat4d& modelView, int first, int count, const Vec4f& color, const StelTextureSP& tex) const
+{
+	if (count==0)
+		return;
+	prog->setUniformValue("modelViewMatrix", StelPainter::toQMatrix(modelView));
+	prog->setUniformValue("color", color[0], color[1], color[2], color[3]);
+	tex->bind();
+	glDrawArrays(GL_TRIANGLES, first, count);
+}
+
+bool LandscapeOldStyle::drawGpu(StelCore* core)
+{
+	const StelProjectorP prj = core->getProjection(StelCore::FrameAltAz, StelCore::RefractionOff);
+	const QByteArray forwardTransform = prj->getForwardTransformShader();
+	if (forwardTransform.isEmpty())
+		return false;
+	QOpenGLShaderProgram* prog = getGpuProgram(forwardTransform);
+	if (!prog)
+		return false;
+	if (!gpuBuffer)
+		createGpuBuffer();
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+	const Mat4f& m = prj->getProjectionMatrix();
+	StelPainter::flushPendingText();
+	prog->bind();
+	prog->setUniformValue("projectionMatrix", StelPainter::toQMatrix(m));
+	prog->setUniformValue("screenCenter", screenCenter[0], screenCenter[1]);
+	prog->setUniformValue("screenScale", screenScale[0], screenScale[1]);
+	prog->setUniformValue("tex", 0);
+
+	const int posLoc = prog->attributeLocation("pos");
+	const int texCoordLoc = prog->attributeLocation("texCoord");
+	gpuBuffer->bind();
+	prog->enableAttributeArray(posLoc);
+	prog->enableAttributeArray(texCoordLoc);
+	prog->setAttributeBuffer(posLoc, GL_FLOAT, offsetof(LandscapeGpuVertex, pos), 3, sizeof(LandscapeGpuVertex));
+	prog->setAttributeBuffer(texCoordLoc, GL_FLOAT, offsetof(LandscapeGpuVertex, texCoord), 2, sizeof(LandscapeGpuVertex));
+
+	// The same transformations as in drawDecor(), drawGround() and drawFog()
+	const Mat4d altAz = core->getAltAzModelViewTransform(StelCore::RefractionOff)->getApproximateLinearTransfo();
+	if (landFader.getInterstate())
+	{
+		const Vec4f color(landscapeBrightness, landscapeBrightness, landscapeBrightness, landFader.getInterstate());
+		const float vshift = radius * ((tanMode || calibrated) ? std::tan(groundAngleShift) : std::sin(groundAngleShift));
+		const Mat4d groundModelView = altAz*Mat4d::zrotation(groundAngleRotateZ-angleRotateZOffset)*Mat4d::translation(Vec3d(0,0,vshift));
+		if (drawGroundFirst)
+			drawGpuRange(prog, groundModelView, gpuGroundFirst, gpuGroundCount, color, groundTex);
+		const Mat4d sidesModelView = altAz*Mat4d::zrotation(-(angleRotateZ+angleRotateZOffset));
+		for (int i=0;i<precomputedSides.size();++i)
+			drawGpuRange(prog, sidesModelView, gpuSideFirst.at(i), gpuSideCount.at(i), color, precomputedSides.at(i).tex);
+		if (!drawGroundFirst)
+			drawGpuRange(prog, groundModelView, gpuGroundFirst, gpuGroundCount, color, groundTex);
+	}
+
+	if (fogFader.getInterstate())
+	{
+		const float vpos = (tanMode||calibrated) ? radius*std::tan(fogAngleShift*M_PI/180.) : radius*std::sin(fogAngleShift*M_PI/180.);
+		Mat4d fogModelView = altAz;
+		if (calibrated)
+			fogModelView = fogModelView*Mat4d::zrotation(-(angleRotateZ+angleRotateZOffset));
+		fogModelView = fogModelView*Mat4d::translation(Vec3d(0.,0.,vpos));
+		const float c = fogFader.getInterstate()*(0.1f+0.1f*landscapeBrightness);
+		glBlendFunc(GL_ONE, GL_ONE);
+		glCullFace(GL_FRONT);
+		drawGpuRange(prog, fogModelView, gpuFogFirst, gpuFogCount, Vec4f(c, c, c, 1.f), fogTex);
+		glCullFace(GL_BACK);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+
+	prog->disableAttributeArray(posLoc);
+	prog->disableAttributeArray(texCoordLoc);
+	gpuBuffer->release();
+	prog->release();
+	return true;
+}
+
 float LandscapeOldStyle::getOpacity(Vec3d azalt) const
 {
 	if (angleRotateZOffset!=0.0f)
@@ -585,16 +913,23 @@ float LandscapeOldStyle::getOpacity(Vec3d azalt) const
 	{
 		if (horizonPolygon->contains(azalt)	) return 1.0f; else return 0.0f;
 	}
-	// Else, sample the images...
-
-	const float alt_rad = std::asin(azalt[2]);  // sampled altitude, radians
-	if (alt_rad < decorAngleShift*M_PI/180.0f) return 1.0f; // below decor, i.e. certainly opaque ground.
-	if (alt_rad > (decorAltAngle+decorAngleShift)*M_PI/180.0f) return 0.0f; // above decor, i.e. certainly free sky.
 	if (!calibrated) // the result of this function has no real use here: just complain and return result for math. horizon.
 	{
+		const float alt_rad = std::asin(azalt[2]);  // sampled altitude, radians
+		if (alt_rad < decorAngleShift*M_PI/180.0f) return 1.0f; // below decor, i.e. certainly opaque ground.
+		if (alt_rad > (decorAltAngle+decorAngleShift)*M_PI/180.0f) return 0.0f; // above decor, i.e. certainly free sky.
 		qDebug() << "Dubious result: Landscape \"" << name << "\" not calibrated. Result for mathematical horizon only.";
 		return (azalt[2] > 0 ? 0.0f : 1.0f);
 	}
+	// Else, use the table sampled from the images at load time.
+	return lookupOpacity(azalt);
+}
+
+float LandscapeOldStyle::sampleOpacity(const Vec3d& azalt) const
+{
+	const float alt_rad = std::asin(azalt[2]);  // sampled altitude, radians
+	if (alt_rad < decorAngleShift*M_PI/180.0f) return 1.0f; // below decor, i.e. certainly opaque ground.
+	if (alt_rad > (decorAltAngle+decorAngleShift)*M_PI/180.0f) return 0.0f; // above decor, i.e. certainly free sky.
 
 	float az=atan2(azalt[0], azalt[1]) / M_PI + 0.5f;  // -0.5..+1.5
 	if (az<0) az+=2.0f;                                //  0..2 = N.E.S.W.N
@@ -607,10 +942,14 @@ float LandscapeOldStyle::getOpacity(Vec3d azalt) const
 
 	float az_panel =  nbSide*nbDecorRepeat * az_phot; // azimuth in "panel space". Ex for nbS=4, nbDR=3: [0..[12, say 11.4
 	float x_in_panel=fmodf(az_panel, 1.0f);
-	int currentSide = (int) floor(fmodf(az_panel, nbSide)); // must become 3
-	Q_ASSERT(currentSide<=nbSideTexs);
+	int currentSide = qMin((int) floor(fmodf(az_panel, nbSide)), nbSide-1); // must become 3
+	// The sides can share the textures: find the image of the texture of the current side.
+	int currentTex = 0;
+	while (currentTex<nbSideTexs-1 && sideTexs[currentTex]!=sides[currentSide].tex)
+		++currentTex;
+	const QImage* image = sidesImages[currentTex];
 	int x= (sides[currentSide].texCoords[0] + x_in_panel*(sides[currentSide].texCoords[2]-sides[currentSide].texCoords[0]))
-			* sidesImages[currentSide]->width(); // pixel X from left.
+			* image->width(); // pixel X from left.
 
 	// QImage has pixel 0/0 in top left corner. We must find image Y for optionally cropped images.
 	// It should no longer be possible that sample position is outside cropped texture. in this case, assert(0) but again assume full transparency and exit early.
@@ -636,15 +975,15 @@ float LandscapeOldStyle::getOpacity(Vec3d azalt) const
 
 	// x0/y0 is lower left, x1/y1 upper right corner.
 	float y_baseImg_1 = sides[currentSide].texCoords[1]+ y_img_1*(sides[currentSide].texCoords[3]-sides[currentSide].texCoords[1]);
-	int y=(1.0-y_baseImg_1)*sidesImages[currentSide]->height();           // pixel Y from top.
+	int y=(1.0-y_baseImg_1)*image->height();           // pixel Y from top.
 
-	QRgb pixVal=sidesImages[currentSide]->pixel(x, y);
+	QRgb pixVal=image->pixel(qBound(0, x, image->width()-1), qBound(0, y, image->height()-1));
 	// GZ: please leave the comment available for further development!
-	qDebug() << "Oldstyle Landscape sampling: az=" << az*180.0 << "° alt=" << alt_rad*180.0f/M_PI
-			 << "°, xShift[-1..+1]=" << xShift << " az_phot[0..1]=" << az_phot
-			 << " --> current side panel " << currentSide
-			 << ", w=" << sidesImages[currentSide]->width() << " h=" << sidesImages[currentSide]->height()
-			 << " --> x:" << x << " y:" << y << " alpha:" << qAlpha(pixVal)/255.0f;
+	//qDebug() << "Oldstyle Landscape sampling: az=" << az*180.0 << "° alt=" << alt_rad*180.0f/M_PI
+	//		 << "°, xShift[-1..+1]=" << xShift << " az_phot[0..1]=" << az_phot
+	//		 << " --> current side panel " << currentSide
+	//		 << ", w=" << image->width() << " h=" << image->height()
+	//		 << " --> x:" << x << " y:" << y << " alpha:" << qAlpha(pixVal)/255.0f;
 	return qAlpha(pixVal)/255.0f;
 }
 
@@ -660,6 +999,7 @@ void LandscapePolygonal::load(const QSettings& landscapeIni, const QString& land
 {
 	// loading the polygon has been moved to Landscape::loadCommon(), so that all Landscape classes can use a polygon line.
 	loadCommon(landscapeIni, landscapeId);
+	horizonPolygonCache.clear();
 	QString type = landscapeIni.value("landscape/type").toString();
 	if(type != "polygonal")
 	{
@@ -692,7 +1032,7 @@ void LandscapePolygonal::draw(StelCore* core)
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_BLEND);
 	sPainter.setColor(landscapeBrightness*groundColor[0], landscapeBrightness*groundColor[1], landscapeBrightness*groundColor[2], landFader.getInterstate());
-	sPainter.drawSphericalRegion(horizonPolygon.data(), StelPainter::SphericalPolygonDrawModeFill);
+	sPainter.drawSphericalRegion(horizonPolygon.data(), &horizonPolygonCache, StelPainter::SphericalPolygonDrawModeFill);
 
 	if (horizonPolygonLineColor[0] >= 0)
 	{
@@ -725,6 +1065,11 @@ LandscapeFisheye::~LandscapeFisheye()
 	if (mapImage) delete mapImage;
 }
 
+QList<StelTextureSP> LandscapeFisheye::getTextures() const
+{
+	return QList<StelTextureSP>() << mapTex << mapTexFog << mapTexIllum;
+}
+
 void LandscapeFisheye::load(const QSettings& landscapeIni, const QString& landscapeId)
 {
 	loadCommon(landscapeIni, landscapeId);
@@ -753,13 +1098,20 @@ void LandscapeFisheye::create(const QString _name, float _texturefov, const QStr
 	texFov = _texturefov*M_PI/180.f;
 	angleRotateZ = _angleRotateZ*M_PI/180.f;
 	if (!horizonPolygon)
+	{
+		// The image is only needed to build the opacity table
 		mapImage = new QImage(_maptex);
-	mapTex = StelApp::getInstance().getTextureManager().createTexture(_maptex, StelTexture::StelTextureParams(true));
+		if (!mapImage->isNull())
+			buildOpacityTable(M_PI_2-texFov/2.f, M_PI_2);
+		delete mapImage;
+		mapImage = NULL;
+	}
+	mapTex = createTexture(_maptex, StelTexture::StelTextureParams(true));
 
 	if (_maptexIllum.length())
-		mapTexIllum = StelApp::getInstance().getTextureManager().createTexture(_maptexIllum, StelTexture::StelTextureParams(true));
+		mapTexIllum = createTexture(_maptexIllum, StelTexture::StelTextureParams(true));
 	if (_maptexFog.length())
-		mapTexFog = StelApp::getInstance().getTextureManager().createTexture(_maptexFog, StelTexture::StelTextureParams(true));
+		mapTexFog = createTexture(_maptexFog, StelTexture::StelTextureParams(true));
 
 }
 
@@ -815,8 +1167,12 @@ float LandscapeFisheye::getOpacity(Vec3d azalt) const
 	{
 		if (horizonPolygon->contains(azalt)	) return 1.0f; else return 0.0f;
 	}
-	// Else, sample the image...
+	// Else, use the table sampled from the image at load time.
+	return lookupOpacity(azalt);
+}
 
+float LandscapeFisheye::sampleOpacity(const Vec3d& azalt) const
+{
 	// QImage has pixel 0/0 in top left corner.
 	// The texture is taken from the center circle in the square texture.
 	// It is possible that sample position is outside. in this case, assume full opacity and exit early.
@@ -830,11 +1186,11 @@ float LandscapeFisheye::getOpacity(Vec3d azalt) const
 	int x= mapImage->height()/2*(1 + radius*std::sin(az));
 	int y= mapImage->height()/2*(1 + radius*std::cos(az));
 
-	QRgb pixVal=mapImage->pixel(x, y);
+	QRgb pixVal=mapImage->pixel(qBound(0, x, mapImage->width()-1), qBound(0, y, mapImage->height()-1));
 	// GZ: please leave the comment available for further development!
-	qDebug() << "Landscape sampling: az=" << (az+angleRotateZ)/M_PI*180.0f << "° alt=" << alt_rad/M_PI*180.f
-			 << "°, w=" << mapImage->width() << " h=" << mapImage->height()
-			 << " --> x:" << x << " y:" << y << " alpha:" << qAlpha(pixVal)/255.0f;
+	//qDebug() << "Landscape sampling: az=" << (az+angleRotateZ)/M_PI*180.0f << "° alt=" << alt_rad/M_PI*180.f
+	//		 << "°, w=" << mapImage->width() << " h=" << mapImage->height()
+	//		 << " --> x:" << x << " y:" << y << " alpha:" << qAlpha(pixVal)/255.0f;
 	return qAlpha(pixVal)/255.0f;
 
 
@@ -851,11 +1207,36 @@ LandscapeSpherical::LandscapeSpherical(float _radius)
 	, illumTexTop(0.)
 	, illumTexBottom(0.)
 	, mapImage(NULL)
+	, mapTiles(NULL)
 {}
 
 LandscapeSpherical::~LandscapeSpherical()
 {
 	if (mapImage) delete mapImage;
+	if (mapTiles) delete mapTiles;
+}
+
+QList<StelTextureSP> LandscapeSpherical::getTextures() const
+{
+	return QList<StelTextureSP>() << mapTex << mapTexFog << mapTexIllum;
+}
+
+bool LandscapeSpherical::loadTextures()
+{
+	// The tiles are loaded according to the view, they are not waited for
+	createMapTiles();
+	return Landscape::loadTextures();
+}
+
+void LandscapeSpherical::createMapTiles()
+{
+	if (mapTilesUrl.isEmpty())
+		return;
+	mapTiles = new StelSkyImageTile(mapTilesUrl);
+	mapTiles->setFrameType(StelCore::FrameAltAz);
+	mapTiles->setFlagTransparency(true);
+	mapTiles->setFlagExtinction(false);
+	mapTilesUrl.clear();
 }
 
 void LandscapeSpherical::load(const QSettings& landscapeIni, const QString& landscapeId)
@@ -876,6 +1257,11 @@ void LandscapeSpherical::load(const QSettings& landscapeIni, const QString& land
 		return;
 	}
 
+	// The tiles can also be hosted on a server
+	QString mapTiles = landscapeIni.value("landscape/maptex_tiles").toString();
+	if (!mapTiles.isEmpty() && !mapTiles.startsWith("http://") && !mapTiles.startsWith("https://"))
+		mapTiles = getTexturePath(mapTiles, landscapeId);
+
 	create(name,
 	       getTexturePath(landscapeIni.value("landscape/maptex").toString(), landscapeId),
 	       getTexturePath(landscapeIni.value("landscape/maptex_fog").toString(), landscapeId),
@@ -886,7 +1272,8 @@ void LandscapeSpherical::load(const QSettings& landscapeIni, const QString& land
 	       landscapeIni.value("landscape/maptex_fog_top"     ,  90.f).toFloat(),
 	       landscapeIni.value("landscape/maptex_fog_bottom"  , -90.f).toFloat(),
 	       landscapeIni.value("landscape/maptex_illum_top"   ,  90.f).toFloat(),
-	       landscapeIni.value("landscape/maptex_illum_bottom", -90.f).toFloat());
+	       landscapeIni.value("landscape/maptex_illum_bottom", -90.f).toFloat(),
+	       mapTiles);
 }
 
 
@@ -894,7 +1281,8 @@ void LandscapeSpherical::load(const QSettings& landscapeIni, const QString& land
 void LandscapeSpherical::create(const QString _name, const QString& _maptex, const QString& _maptexFog, const QString& _maptexIllum, const float _angleRotateZ,
 								const float _mapTexTop, const float _mapTexBottom,
 								const float _fogTexTop, const float _fogTexBottom,
-								const float _illumTexTop, const float _illumTexBottom)
+								const float _illumTexTop, const float _illumTexBottom,
+								const QString& _mapTiles)
 {
 	//qDebug() << "LandscapeSpherical::create():"<< _name << " : " << _maptex << " : " << _maptexFog << " : " << _maptexIllum << " : " << _angleRotateZ;
 	validLandscape = 1;  // assume ok...
@@ -906,14 +1294,37 @@ void LandscapeSpherical::create(const QString _name, const QString& _maptex, con
 	fogTexBottom  = (90.f-_fogTexBottom)  *M_PI/180.f;
 	illumTexTop   = (90.f-_illumTexTop)   *M_PI/180.f;
 	illumTexBottom= (90.f-_illumTexBottom)*M_PI/180.f;
-	if (!horizonPolygon)
+	if (!horizonPolygon && !_maptex.isEmpty())
+	{
+		// The image is only needed to build the opacity table
 		mapImage = new QImage(_maptex);
-	mapTex = StelApp::getInstance().getTextureManager().createTexture(_maptex, StelTexture::StelTextureParams(true));
+		if (!mapImage->isNull())
+			buildOpacityTable(M_PI_2-mapTexBottom, M_PI_2-mapTexTop);
+		delete mapImage;
+		mapImage = NULL;
+	}
+	if (mapTiles)
+	{
+		delete mapTiles;
+		mapTiles = NULL;
+	}
+	mapTilesUrl.clear();
+	if (!_mapTiles.isEmpty())
+	{
+		// Large panoramas are split in tiles, loaded when they become visible.
+		// The tiles are defined in the frame of the landscape, so prefetching along the motion in J2000 does not apply.
+		// The tiles use the network, so in a worker thread they are created later by loadTextures().
+		mapTilesUrl = _mapTiles;
+		if (QThread::currentThread()==QCoreApplication::instance()->thread())
+			createMapTiles();
+	}
+	else
+		mapTex = createTexture(_maptex, StelTexture::StelTextureParams(true));
 
 	if (_maptexIllum.length())
-		mapTexIllum = StelApp::getInstance().getTextureManager().createTexture(_maptexIllum, StelTexture::StelTextureParams(true));
+		mapTexIllum = createTexture(_maptexIllum, StelTexture::StelTextureParams(true));
 	if (_maptexFog.length())
-		mapTexFog = StelApp::getInstance().getTextureManager().createTexture(_maptexFog, StelTexture::StelTextureParams(true));
+		mapTexFog = createTexture(_maptexFog, StelTexture::StelTextureParams(true));
 }
 
 void LandscapeSpherical::draw(StelCore* core)
@@ -930,14 +1341,25 @@ void LandscapeSpherical::draw(StelCore* core)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	sPainter.setColor(landscapeBrightness, landscapeBrightness, landscapeBrightness, landFader.getInterstate());
 
-	glEnable(GL_CULL_FACE);
 	sPainter.enableTexture2d(true);
 	glEnable(GL_BLEND);
-	mapTex->bind();
+	if (mapTiles)
+	{
+		// The tiles are drawn as spherical polygons, seen from the inside like the sky images.
+		mapTiles->setBrightness(landscapeBrightness);
+		mapTiles->draw(core, sPainter, landFader.getInterstate());
+		glEnable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+	}
+	else
+	{
+		glEnable(GL_CULL_FACE);
+		mapTex->bind();
 
-	// TODO: verify that this works correctly for custom projections [comment not by GZ]
-	// seam is at East, except if angleRotateZ has been given.
-	sPainter.sSphere(radius, 1.0, cols, rows, 1, true, mapTexTop, mapTexBottom);
+		// TODO: verify that this works correctly for custom projections [comment not by GZ]
+		// seam is at East, except if angleRotateZ has been given.
+		sPainter.sSphere(radius, 1.0, cols, rows, 1, true, mapTexTop, mapTexBottom);
+	}
 	// Since 0.13: Fog also for sphericals...
 	if (mapTexFog)
 	{
@@ -990,8 +1412,12 @@ float LandscapeSpherical::getOpacity(Vec3d azalt) const
 	{
 		if (horizonPolygon->contains(azalt)	) return 1.0f; else return 0.0f;
 	}
-	// Else, sample the image...
+	// Else, use the table sampled from the image at load time.
+	return lookupOpacity(azalt);
+}
 
+float LandscapeSpherical::sampleOpacity(const Vec3d& azalt) const
+{
 	// QImage has pixel 0/0 in top left corner. We must first find image Y for optionally cropped images.
 	// It is possible that sample position is outside cropped texture. in this case, assume full transparency and exit early.
 	const float alt_pm1 = 2.0f * std::asin(azalt[2])  / M_PI;  // sampled altitude, -1...+1 linear in altitude angle
@@ -1014,12 +1440,12 @@ float LandscapeSpherical::getOpacity(Vec3d azalt) const
 
 	int x=(az_phot/2.0f) * mapImage->width(); // pixel X from left.
 
-	QRgb pixVal=mapImage->pixel(x, y);
+	QRgb pixVal=mapImage->pixel(qBound(0, x, mapImage->width()-1), qBound(0, y, mapImage->height()-1));
 	// GZ: please leave the comment available for further development!
-	qDebug() << "Landscape sampling: az=" << az*180.0 << "° alt=" << alt_pm1*90.0f
-			 << "°, xShift[-2..+2]=" << xShift << " az_phot[0..2]=" << az_phot
-			 << ", w=" << mapImage->width() << " h=" << mapImage->height()
-			 << " --> x:" << x << " y:" << y << " alpha:" << qAlpha(pixVal)/255.0f;
+	//qDebug() << "Landscape sampling: az=" << az*180.0 << "° alt=" << alt_pm1*90.0f
+	//		 << "°, xShift[-2..+2]=" << xShift << " az_phot[0..2]=" << az_phot
+	//		 << ", w=" << mapImage->width() << " h=" << mapImage->height()
+	//		 << " --> x:" << x << " y:" << y << " alpha:" << qAlpha(pixVal)/255.0f;
 	return qAlpha(pixVal)/255.0f;
 
 }
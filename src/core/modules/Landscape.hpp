@@ -23,16 +23,24 @@
 #include "VecMath.hpp"
 #include "StelToneReproducer.hpp"
 #include "StelProjector.hpp"
+#include "StelPainter.hpp"
 
 #include "StelFader.hpp"
 #include "StelUtils.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelTexture.hpp"
 #include "StelLocation.hpp"
 
+#include <QByteArray>
 #include <QMap>
 #include <QImage>
+#include <QList>
+#include <QVector>
 
 class QSettings;
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
+class StelSkyImageTile;
 class StelLocation;
 class StelCore;
 class StelPainter;
@@ -126,6 +134,15 @@ public:
 	//! can be used to find sunrise or visibility questions on the real-world landscape horizon.
 	//! Default implementation indicates the horizon equals math horizon.
 	virtual float getOpacity(Vec3d azalt) const {return (azalt[2]<0 ? 1.0f : 0.0f); }
+	//! Start loading the textures of a landscape created in a worker thread, called in the main thread
+	//! until it returns true before the landscape is displayed.
+	//! @return true when all the textures are loaded, or could not be loaded.
+	virtual bool loadTextures();
+	//! Get the lowest altitude of the horizon, the landscape being opaque below it in all the directions.
+	//! It is taken from the opacity table and the horizon polygon, the lowest one if both are present,
+	//! or is the mathematical horizon without them.
+	//! @return the altitude [radians].
+	float getHorizonAltitudeMin() const;
 	//! The list of azimuths and altitudes can come in various formats. We read the first two elements, which can be of formats:
 	enum horizonListMode {
 		azDeg_altDeg   = 0, //! azimuth[degrees] altitude[degrees]
@@ -137,6 +154,11 @@ public:
 	};
 	
 protected:
+	//! Create a texture of the landscape. When the landscape is created in a worker thread, the texture
+	//! is only loaded by loadTextures(), otherwise it is loaded immediately.
+	static StelTextureSP createTexture(const QString& path, const StelTexture::StelTextureParams& params=StelTexture::StelTextureParams());
+	//! Get the textures of the landscape, to load them in loadTextures().
+	virtual QList<StelTextureSP> getTextures() const {return QList<StelTextureSP>();}
 	//! Load attributes common to all landscapes
 	//! @param landscapeIni A reference to an existing QSettings object which describes the landscape
 	//! @param landscapeId The name of the directory for the landscape files (e.g. "ocean")
@@ -152,6 +174,21 @@ protected:
 	//! @param landscapeId The landscape ID (directory name) to which the texture belongs
 	//! @exception misc possibility of throwing "file not found" exceptions
 	const QString getTexturePath(const QString& basename, const QString& landscapeId) const;
+
+	//! Fill the opacity table by calling sampleOpacity() for each of its cells, so that getOpacity()
+	//! does not have to keep and sample the images. The table covers the whole azimuth range
+	//! and the altitudes between altMin and altMax.
+	//! @param altMin [radians] altitude below which the landscape is considered fully opaque.
+	//! @param altMax [radians] altitude above which the landscape is considered fully transparent.
+	void buildOpacityTable(float altMin, float altMax);
+	//! Get the opacity of a direction from the opacity table.
+	//! If the table was not built, the mathematical horizon is used.
+	//! @param azalt normalized direction in the landscape frame, i.e. without angleRotateZOffset.
+	float lookupOpacity(const Vec3d& azalt) const;
+	//! Sample the landscape images for the opacity in a direction, used to build the opacity table.
+	//! @param azalt normalized direction in the landscape frame, i.e. without angleRotateZOffset.
+	virtual float sampleOpacity(const Vec3d& azalt) const {return (azalt[2]<0 ? 1.0f : 0.0f); }
+
 	float radius;
 	QString name;          //! Read from landscape.ini:[landscape]name
 	QString author;        //! Read from landscape.ini:[landscape]author
@@ -182,6 +219,15 @@ protected:
 									   //! For LandscapePolygonal, this is the only horizon data item.
 	Vec3f horizonPolygonLineColor ;    //! for all horizon types, the horizonPolygon line, if specified, will be drawn in this color
 									   //! specified in landscape.ini[landscape]horizon_line_color. Negative red (default) indicated "don't draw".
+
+private:
+	QVector<quint8> opacityTable;      //! Opacity from 0 to 255, by rows of increasing altitude starting at azimuth 0 (North).
+	int opacityTableWidth;             //! Number of azimuth cells.
+	int opacityTableHeight;            //! Number of altitude cells.
+	float opacityTableAltMin;          //! [radians] altitude of the bottom of the table.
+	float opacityTableAltMax;          //! [radians] altitude of the top of the table.
+	float opacityTableHorizonMin;      //! [radians] lowest altitude of the table which is not fully opaque in all the directions.
+	float polygonHorizonMin;           //! [radians] lowest altitude of the points of the horizon polygon.
 };
 
 //! @class LandscapeOldStyle
@@ -207,6 +253,8 @@ public:
 	//void create(bool _fullpath, QMap<QString, QString> param); // still not implemented
 	virtual float getOpacity(Vec3d azalt) const;
 protected:
+	virtual float sampleOpacity(const Vec3d& azalt) const;
+	virtual QList<StelTextureSP> getTextures() const;
 	typedef struct
 	{
 		StelTextureSP tex;
@@ -217,6 +265,19 @@ private:
 	void drawFog(StelCore* core, StelPainter&) const;
 	void drawDecor(StelCore* core, StelPainter&) const;
 	void drawGround(StelCore* core, StelPainter&) const;
+
+	//! Draw the sides, the ground and the fog from the static GPU buffer, with the projection done in the vertex shader.
+	//! @return false if the current projection cannot be performed on the GPU, in which case the StelPainter path has to be used.
+	bool drawGpu(StelCore* core);
+	//! Upload the precomputed geometry of the sides, the ground and the fog in the GPU buffer.
+	void createGpuBuffer();
+	//! Get or build the shader program for the given forward transform code.
+	QOpenGLShaderProgram* getGpuProgram(const QByteArray& forwardTransform);
+	//! Draw a range of the GPU buffer with the given model view matrix, color and texture.
+	void drawGpuRange(QOpenGLShaderProgram* prog, const Mat4d& modelView, int first, int count, const Vec4f& color, const StelTextureSP& tex) const;
+	//! Get the height of the fog cylinder.
+	float getFogHeight() const;
+
 	QVector<double> groundVertexArr;
 	QVector<float> groundTexCoordArr;
 	StelTextureSP* sideTexs;
@@ -226,7 +287,7 @@ private:
 	StelTextureSP fogTex;
 	//landscapeTexCoord fogTexCoord; // GZ: UNUSED!
 	StelTextureSP groundTex;
-	QVector<QImage*> sidesImages; // GZ: Required for opacity lookup
+	QVector<QImage*> sidesImages; // GZ: Required for opacity lookup. Only kept while building the opacity table.
 	//landscapeTexCoord groundTexCoord; // GZ: UNUSED!
 	int nbDecorRepeat;
 	float fogAltAngle;
@@ -245,6 +306,18 @@ private:
 	};
 
 	QList<LOSSide> precomputedSides;
+
+	//! Whether the geometry is drawn from a static GPU buffer when the projection allows it.
+	bool flagGpuMesh;
+	//! All the triangles of the sides, the ground and the fog, created at the first draw.
+	QOpenGLBuffer* gpuBuffer;
+	//! The ranges of the triangles of each side in gpuBuffer, one per element of precomputedSides.
+	QVector<int> gpuSideFirst;
+	QVector<int> gpuSideCount;
+	int gpuGroundFirst;
+	int gpuGroundCount;
+	int gpuFogFirst;
+	int gpuFogCount;
 };
 
 /////////////////////////////////////////////////////////
@@ -267,6 +340,7 @@ public:
 private:
 	// we have inherited: horizonFileName, horizonPolygon, horizonPolygonLineColor
 	Vec3f groundColor; //! specified in landscape.ini[landscape]ground_color.
+	SphericalRegionDrawCache horizonPolygonCache; //! the triangles of the horizonPolygon subdivided for drawing.
 };
 
 ///////////////////////////////////////////////////////////////
@@ -293,6 +367,9 @@ public:
 	//! @param angleRotateZ azimuth rotation angle, degrees
 	void create(const QString name, const QString& maptex, float texturefov, float angleRotateZ);
 	void create(const QString name, float texturefov, const QString& maptex, const QString &_maptexFog="", const QString& _maptexIllum="", const float angleRotateZ=0.0f);
+protected:
+	virtual float sampleOpacity(const Vec3d& azalt) const;
+	virtual QList<StelTextureSP> getTextures() const;
 private:
 
 	StelTextureSP mapTex;      //!< The fisheye image, centered on the zenith.
@@ -300,7 +377,7 @@ private:
 							   //!< can also be smaller, just the texture is again mapped onto the same geometry.
 	StelTextureSP mapTexIllum; //!< Optional fisheye image of identical size (create as layer in your favorite image processor) or at least, proportions.
 							   //!< To simulate light pollution (skyglow), street lights, light in windows, ... at night
-	QImage *mapImage;          //!< The same image as mapTex, but stored in-mem for sampling.
+	QImage *mapImage;          //!< The same image as mapTex, but stored in-mem for sampling. Only kept while building the opacity table.
 
 	float texFov;
 };
@@ -315,6 +392,11 @@ private:
 //! The textures should still be power-of-two, so maybe 8192x1024 for the fog, or 8192x2048 for the light pollution.
 //! (It's OK to stretch the textures. They just have to fit, geometrically!)
 //! TODO: Allow a horizontal split for 2 or even 4 parts, i.e. super-large, super-accurate panos.
+//! Larger panoramas can be given as a multi-resolution tree of tiles in the JSON format of the sky images
+//! with landscape/maptex_tiles. Only the tiles and levels needed for the current view are then loaded.
+//! Their worldCoords are given in degrees as longitude and altitude in the horizontal frame rotated by
+//! angle_rotatez, the longitude being counted from South towards East. In this case, landscape/maptex is optional:
+//! if given, the image is not drawn but only sampled for getOpacity(), so a reduced version of the panorama is enough.
 class LandscapeSpherical : public Landscape
 {
 public:
@@ -337,10 +419,17 @@ public:
 	//! @param _fogTexBottom altitude angle of bottom edge of fog texture, degrees [-90]
 	//! @param _illumTexTop altitude angle of top edge of light pollution texture, degrees [90]
 	//! @param _illumTexBottom altitude angle of bottom edge of light pollution texture, degrees [-90]
+	//! @param _mapTiles path or URL of the JSON description of the tiles to draw instead of maptex [none]
 	void create(const QString name, const QString& maptex, const QString &_maptexFog="", const QString& _maptexIllum="", const float _angleRotateZ=0.0f,
 				const float _mapTexTop=90.0f, const float _mapTexBottom=-90.0f,
 				const float _fogTexTop=90.0f, const float _fogTexBottom=-90.0f,
-				const float _illumTexTop=90.0f, const float _illumTexBottom=-90.0f);
+				const float _illumTexTop=90.0f, const float _illumTexBottom=-90.0f,
+				const QString& _mapTiles="");
+	//! Also create the tiles, which can not be created in a worker thread.
+	virtual bool loadTextures();
+protected:
+	virtual float sampleOpacity(const Vec3d& azalt) const;
+	virtual QList<StelTextureSP> getTextures() const;
 private:
 
 	StelTextureSP mapTex;      //!< The equirectangular panorama texture
@@ -356,7 +445,10 @@ private:
 	float fogTexBottom;		   //!< zenithal bottom angle of the fog texture, radians
 	float illumTexTop;		   //!< zenithal top angle of the illumination texture, radians
 	float illumTexBottom;	   //!< zenithal bottom angle of the illumination texture, radians
-	QImage *mapImage;          //!< The same image as mapTex, but stored in-mem for opacity sampling.
+	QImage *mapImage;          //!< The same image as mapTex, but stored in-mem for opacity sampling. Only kept while building the opacity table.
+	StelSkyImageTile* mapTiles; //!< Optional multi-resolution tiles drawn instead of mapTex, loaded according to the view.
+	QString mapTilesUrl;        //!< The description of the tiles, until they are created in the main thread.
+	void createMapTiles();
 };
 
 #endif // _LANDSCAPE_HPP_
@@ -34,6 +34,7 @@
 #include "StelIniParser.hpp"
 #include "StelSkyDrawer.hpp"
 #include "StelPainter.hpp"
+#include "LabelMgr.hpp"
 #include "qzipreader.h"
 
 #include <QDebug>
@@ -44,6 +45,7 @@
 #include <QFile>
 #include <QTemporaryFile>
 #include <QMouseEvent>
+#include <QtConcurrent>
 
 #include <stdexcept>
 
@@ -153,6 +155,8 @@ LandscapeMgr::LandscapeMgr()
 	: atmosphere(NULL)
 	, cardinalsPoints(NULL)
 	, landscape(NULL)
+	, flagAsyncLandscapeLoading(true)
+	, pendingLandscape(NULL)
 	, flagLandscapeSetsLocation(false)
 	, flagLandscapeAutoSelection(false)
 	, flagLightPollutionFromDatabase(false)
@@ -176,6 +180,10 @@ LandscapeMgr::LandscapeMgr()
 
 LandscapeMgr::~LandscapeMgr()
 {
+	landscapeWatcher.waitForFinished();
+	if (!creatingLandscapeID.isEmpty())
+		delete landscapeWatcher.result();
+	delete pendingLandscape;
 	delete atmosphere;
 	delete cardinalsPoints;
 	delete landscape;
@@ -199,6 +207,16 @@ double LandscapeMgr::getCallOrder(StelModuleActionName actionName) const
 
 void LandscapeMgr::update(double deltaTime)
 {
+	// The new landscape fades in only once its textures are resident
+	if (pendingLandscape && pendingLandscape->loadTextures())
+	{
+		Landscape* newLandscape = pendingLandscape;
+		pendingLandscape = NULL;
+		const QString id = pendingLandscapeID;
+		pendingLandscapeID.clear();
+		switchLandscape(newLandscape, id);
+	}
+
 	atmosphere->update(deltaTime);
 	landscape->update(deltaTime);
 	cardinalsPoints->update(deltaTime);
@@ -213,7 +231,7 @@ void LandscapeMgr::update(double deltaTime)
 	Vec3d moonPos = ssystem->getMoon()->getAltAzPosApparent(core);
 	atmosphere->computeColor(core->getJDay(), sunPos, moonPos,
 		ssystem->getMoon()->getPhaseAngle(ssystem->getEarth()->getHeliocentricEclipticPos()),
-		core, core->getCurrentLocation().latitude, core->getCurrentLocation().altitude,
+		ssystem->getSolarEclipseFactor(), core, core->getCurrentLocation().latitude, core->getCurrentLocation().altitude,
 		15.f, 40.f);	// Temperature = 15c, relative humidity = 40%
 
 	core->getSkyDrawer()->reportLuminanceInFov(3.75+atmosphere->getAverageLuminance()*3.5, true);
@@ -303,6 +321,9 @@ void LandscapeMgr::update(double deltaTime)
 
 void LandscapeMgr::draw(StelCore* core)
 {
+	// Draw the labels of the sky objects before they get covered
+	GETSTELMODULE(LabelMgr)->drawSkyLabels(core);
+
 	// Draw the atmosphere
 	atmosphere->draw(core);
 
@@ -320,6 +341,8 @@ void LandscapeMgr::init()
 
 	atmosphere = new Atmosphere();
 	landscape = new LandscapeOldStyle();
+	flagAsyncLandscapeLoading = conf->value("landscape/flag_async_loading", true).toBool();
+	connect(&landscapeWatcher, SIGNAL(finished()), this, SLOT(landscapeCreated()));
 	defaultLandscapeID = conf->value("init_location/landscape_name").toString();
 	setCurrentLandscapeID(defaultLandscapeID);
 	setFlagLandscape(conf->value("landscape/flag_landscape", conf->value("landscape/flag_ground", true).toBool()).toBool());
@@ -372,22 +395,79 @@ bool LandscapeMgr::setCurrentLandscapeID(const QString& id)
 		return false;
 
 	// We want to lookup the landscape ID (dir) from the name.
-	Landscape* newLandscape = createFromFile(StelFileMgr::findFile("landscapes/" + id + "/landscape.ini"), id);
-	
-	if (!newLandscape)
+	const QString landscapeFile = StelFileMgr::findFile("landscapes/" + id + "/landscape.ini");
+
+	// The first landscape is loaded synchronously, there is nothing else to display meanwhile
+	if (!flagAsyncLandscapeLoading || currentLandscapeID.isEmpty())
+	{
+		Landscape* newLandscape = createFromFile(landscapeFile, id);
+		if (!newLandscape)
+		{
+			qWarning() << "ERROR while loading default landscape " << "landscapes/" + id + "/landscape.ini";
+			return false;
+		}
+		switchLandscape(newLandscape, id);
+		return true;
+	}
+
+	if (landscapeFile.isEmpty())
 	{
-		qWarning() << "ERROR while loading default landscape " << "landscapes/" + id + "/landscape.ini";
+		qWarning() << "ERROR while loading landscape " << "landscapes/" + id + "/landscape.ini";
 		return false;
 	}
+	if (id == (pendingLandscapeID.isEmpty() ? currentLandscapeID : pendingLandscapeID))
+		return true;
 
+	// Replace the landscape waiting for its textures, if any
+	delete pendingLandscape;
+	pendingLandscape = NULL;
+	if (id == currentLandscapeID)
+	{
+		pendingLandscapeID.clear();
+		return true;
+	}
+	pendingLandscapeID = id;
+
+	// The parsing of the files and the decoding of the images are done in a worker thread,
+	// the textures are then loaded by the texture manager before the landscape is displayed
+	if (creatingLandscapeID.isEmpty())
+		startLandscapeCreation();
+	return true;
+}
+
+void LandscapeMgr::startLandscapeCreation()
+{
+	creatingLandscapeID = pendingLandscapeID;
+	if (creatingLandscapeID.isEmpty())
+		return;
+	const QString landscapeFile = StelFileMgr::findFile("landscapes/" + creatingLandscapeID + "/landscape.ini");
+	landscapeWatcher.setFuture(QtConcurrent::run(this, &LandscapeMgr::createFromFile, landscapeFile, creatingLandscapeID));
+}
+
+void LandscapeMgr::landscapeCreated()
+{
+	Landscape* newLandscape = landscapeWatcher.result();
+	if (creatingLandscapeID != pendingLandscapeID)
+	{
+		// Another landscape was requested during the creation
+		delete newLandscape;
+		startLandscapeCreation();
+		return;
+	}
+	creatingLandscapeID.clear();
+	pendingLandscape = newLandscape;
+}
+
+void LandscapeMgr::switchLandscape(Landscape* newLandscape, const QString& id)
+{
 	if (landscape)
 	{
 		// Copy display parameters from previous landscape to new one
 		newLandscape->setFlagShow(landscape->getFlagShow());
 		newLandscape->setFlagShowFog(landscape->getFlagShowFog());
 		delete landscape;
-		landscape = newLandscape;
 	}
+	landscape = newLandscape;
 	currentLandscapeID = id;
 
 	if (getFlagLandscapeSetsLocation() && landscape->hasLocation())
@@ -427,7 +507,7 @@ bool LandscapeMgr::setCurrentLandscapeID(const QString& id)
 		}
 	}
 	// else qDebug() << "Will not set new location; Landscape location: planet: " << landscape->getLocation().planetName << "name: " << landscape->getLocation().name;
-	return true;
+	emit currentLandscapeChanged(id);
 }
 
 bool LandscapeMgr::setCurrentLandscapeName(const QString& name)
@@ -482,6 +562,13 @@ bool LandscapeMgr::getIsLandscapeFullyVisible() const
 	return landscape->getIsFullyVisible();
 }
 
+SphericalCap LandscapeMgr::getVisibleSkyCap() const
+{
+	if (!landscape->getIsFullyVisible())
+		return SphericalCap(Vec3d(0, 0, 1), -1.);
+	return getSkyCapAbove(landscape->getHorizonAltitudeMin());
+}
+
 bool LandscapeMgr::getFlagUseLightPollutionFromDatabase() const
 {
 	return flagLightPollutionFromDatabase;
@@ -24,7 +24,9 @@
 
 #include "StelModule.hpp"
 #include "StelUtils.hpp"
+#include "StelSphereGeometry.hpp"
 
+#include <QFutureWatcher>
 #include <QMap>
 #include <QStringList>
 
@@ -137,6 +139,8 @@ public slots:
 	//! Get the current landscape ID.
 	const QString& getCurrentLandscapeID() const {return currentLandscapeID;}
 	//! Change the current landscape to the landscape with the ID specified.
+	//! The new landscape is loaded in the background, and replaces the current one (which
+	//! currentLandscapeChanged() signals) once its textures are loaded.
 	//! @param id the ID of the new landscape
 	//! @return false if the new landscape could not be set (e.g. no landscape of that ID was found).
 	bool setCurrentLandscapeID(const QString& id);
@@ -167,6 +171,18 @@ public slots:
 
 	//! Get whether the landscape is currently visible. If true, object below landscape must be rendered.
 	bool getIsLandscapeFullyVisible() const;
+
+	//! Get the part of the sky which is not hidden by the landscape, for culling the objects before projecting them.
+	//! This is a cap around the zenith in the alt-azimuthal frame, down to the lowest altitude of the horizon of
+	//! the landscape with a margin for the refraction. It is the whole sphere while the landscape is not fully visible.
+	SphericalCap getVisibleSkyCap() const;
+	//! Get the cap around the zenith in the alt-azimuthal frame, down to the given altitude of the horizon.
+	//! It is lowered by 2 degrees, as the objects there can still be lifted above the horizon by the refraction.
+	//! @param horizonAltitude the altitude [radians], which can be above the mathematical horizon.
+	static SphericalCap getSkyCapAbove(double horizonAltitude)
+	{
+		return SphericalCap(Vec3d(0, 0, 1), std::sin(horizonAltitude - 0.035));
+	}
 	
 	//! Get flag for displaying Fog.
 	bool getFlagFog() const;
@@ -324,6 +340,9 @@ signals:
 	//! the Sky and viewing options window (the ViewDialog class)
 	void landscapesChanged();
 
+	//! Emitted when a new landscape replaced the current one.
+	void currentLandscapeChanged(const QString& id);
+
 	void lightPollutionChanged();
 
 	//! Emitted when installLandscapeFromArchive() can't read from, write to or
@@ -353,6 +372,9 @@ private slots:
 	//! Translate labels to new language settings.
 	void updateI18n();	
 
+	//! The landscape created in the background is ready to load its textures.
+	void landscapeCreated();
+
 private:
 	//! Get light pollution luminance level.
 	float getAtmosphereLightPollutionLuminance() const;
@@ -377,6 +399,21 @@ private:
 	Cardinals* cardinalsPoints;		// Cardinals points
 	Landscape* landscape;			// The landscape i.e. the fog, the ground and "decor"
 
+	//! Make a new landscape the current one, once its textures are loaded.
+	void switchLandscape(Landscape* newLandscape, const QString& id);
+	//! Create the pending landscape in a worker thread.
+	void startLandscapeCreation();
+
+	//! Whether the new landscapes are created in the background.
+	bool flagAsyncLandscapeLoading;
+	//! The ID of the landscape being loaded in the background, empty if none.
+	QString pendingLandscapeID;
+	//! The landscape waiting for its textures, NULL while it is created or if none.
+	Landscape* pendingLandscape;
+	//! The ID of the landscape being created in the worker thread, empty if none.
+	QString creatingLandscapeID;
+	QFutureWatcher<Landscape*> landscapeWatcher;
+
 	// Define whether the observer location is to be updated when the landscape is updated.
 	bool flagLandscapeSetsLocation;
 
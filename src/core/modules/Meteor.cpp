@@ -24,12 +24,23 @@
 #include "StelPainter.hpp"
 #include "StelTexture.hpp"
 
+#include <QVarLengthArray>
+
 StelTextureSP Meteor::bolideTexture;
 
 Meteor::Meteor(const StelCore* core, float v)
 	: m_distMultiplier(0.)
 	, m_segments(10)
 {
+	start(core, v);
+}
+
+void Meteor::start(const StelCore* core, float v)
+{
+	m_distMultiplier = 0.;
+	m_lineColorArray.clear();
+	m_trainColorArray.clear();
+
 	// determine meteor velocity
 	// abs range 11-72 km/s by default (see line 427 in StelApp.cpp)
 	m_speed = 11+(float)rand()/((float)RAND_MAX+1)*(v-11);
@@ -263,13 +274,13 @@ bool Meteor::update(double deltaTime)
 	return m_alive;
 }
 
-void Meteor::insertVertex(const StelCore* core, const Mat4d& viewMatrix, QVector<Vec3d> &vertexArray, Vec3d vertex)
+Vec3d Meteor::transformVertex(const StelCore* core, const Mat4d& viewMatrix, Vec3d vertex)
 {
 	vertex.transfo4d(viewMatrix);
 	vertex = core->j2000ToAltAz(vertex);
 	vertex[2] -= EARTH_RADIUS;
 	vertex/=1216; // 1216 is to scale down under 1 for desktop version
-	vertexArray.push_back(vertex);
+	return vertex;
 }
 
 void Meteor::calculateThickness(const StelCore* core, float& thickness, float& bolideSize)
@@ -286,8 +297,27 @@ void Meteor::calculateThickness(const StelCore* core, float& thickness, float& b
 	bolideSize = thickness*3;
 }
 
+void Meteor::DrawBatch::clear()
+{
+	trainVertices.resize(0);
+	trainColors.resize(0);
+	lineVertices.resize(0);
+	lineColors.resize(0);
+	bolideVertices.resize(0);
+	bolideColors.resize(0);
+	bolideTexCoords.resize(0);
+}
+
 void Meteor::drawBolide(const StelCore* core, StelPainter& sPainter, const MeteorModel& mm,
 			const Mat4d& viewMatrix, const float bolideSize)
+{
+	DrawBatch batch;
+	addBolide(core, mm, viewMatrix, bolideSize, batch);
+	drawBatch(sPainter, batch);
+}
+
+void Meteor::addBolide(const StelCore* core, const MeteorModel& mm, const Mat4d& viewMatrix,
+		       const float bolideSize, DrawBatch& batch)
 {
 	if (!bolideSize) {
 		return;
@@ -295,47 +325,38 @@ void Meteor::drawBolide(const StelCore* core, StelPainter& sPainter, const Meteo
 
 	// bolide
 	//
-	QVector<Vec3d> vertexArrayBolide;
-	QVector<Vec4f> colorArrayBolide;
-	Vec4f bolideColor = Vec4f(1,1,1,mm.mag);
-
-	Vec3d topLeft = mm.position;
-	topLeft[1] -= bolideSize;
-	insertVertex(core, viewMatrix, vertexArrayBolide, topLeft);
-	colorArrayBolide.push_back(bolideColor);
-
-	Vec3d topRight = mm.position;
-	topRight[0] -= bolideSize;
-	insertVertex(core, viewMatrix, vertexArrayBolide, topRight);
-	colorArrayBolide.push_back(bolideColor);
-
-	Vec3d bottomRight = mm.position;
-	bottomRight[1] += bolideSize;
-	insertVertex(core, viewMatrix, vertexArrayBolide, bottomRight);
-	colorArrayBolide.push_back(bolideColor);
-
-	Vec3d bottomLeft = mm.position;
-	bottomLeft[0] += bolideSize;
-	insertVertex(core, viewMatrix, vertexArrayBolide, bottomLeft);
-	colorArrayBolide.push_back(bolideColor);
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE);
-	sPainter.enableClientStates(true, true, true);
-	Meteor::bolideTexture->bind();
-	static const float texCoordData[] = {1.,0., 0.,0., 0.,1., 1.,1.};
-	sPainter.setTexCoordPointer(2, GL_FLOAT, texCoordData);
-	sPainter.setColorPointer(4, GL_FLOAT, colorArrayBolide.constData());
-	sPainter.setVertexPointer(3, GL_DOUBLE, vertexArrayBolide.constData());
-	sPainter.drawFromArray(StelPainter::TriangleFan, vertexArrayBolide.size(), 0, true);
+	const Vec4f bolideColor = Vec4f(1,1,1,mm.mag);
+	Vec3d corners[4] = {mm.position, mm.position, mm.position, mm.position};
+	corners[0][1] -= bolideSize; // top left
+	corners[1][0] -= bolideSize; // top right
+	corners[2][1] += bolideSize; // bottom right
+	corners[3][0] += bolideSize; // bottom left
+	for (int i=0; i<4; i++) {
+		corners[i] = transformVertex(core, viewMatrix, corners[i]);
+	}
 
-	glDisable(GL_BLEND);
-	sPainter.enableClientStates(false);
+	// The fan of the quad as two triangles
+	static const int fan[6] = {0, 1, 2, 0, 2, 3};
+	static const Vec2f texCoords[4] = {Vec2f(1.f,0.f), Vec2f(0.f,0.f), Vec2f(0.f,1.f), Vec2f(1.f,1.f)};
+	for (int i=0; i<6; i++) {
+		batch.bolideVertices.append(corners[fan[i]]);
+		batch.bolideColors.append(bolideColor);
+		batch.bolideTexCoords.append(texCoords[fan[i]]);
+	}
 }
 
 void Meteor::drawTrain(const StelCore *core, StelPainter& sPainter, const MeteorModel& mm,
 		       const Mat4d& viewMatrix, const float thickness, const int segments,
 		       QList<Vec4f> lineColorArray, QList<Vec4f> trainColorArray)
+{
+	DrawBatch batch;
+	addTrain(core, mm, viewMatrix, thickness, segments, lineColorArray, trainColorArray, batch);
+	drawBatch(sPainter, batch);
+}
+
+void Meteor::addTrain(const StelCore* core, const MeteorModel& mm, const Mat4d& viewMatrix,
+		      const float thickness, const int segments, const QList<Vec4f>& lineColorArray,
+		      const QList<Vec4f>& trainColorArray, DrawBatch& batch)
 {
 	if (segments != lineColorArray.size() || 2*segments != trainColorArray.size())
 	{
@@ -345,10 +366,12 @@ void Meteor::drawTrain(const StelCore *core, StelPainter& sPainter, const Meteor
 
 	// train (triangular prism)
 	//
-	QVector<Vec3d> vertexArrayLine;
-	QVector<Vec3d> vertexArrayL;
-	QVector<Vec3d> vertexArrayR;
-	QVector<Vec3d> vertexArrayTop;
+	QVarLengthArray<Vec3d, 32> vertexArrayLine;
+	QVarLengthArray<Vec3d, 64> vertexArrayL;
+	QVarLengthArray<Vec3d, 64> vertexArrayR;
+	QVarLengthArray<Vec3d, 64> vertexArrayTop;
+	QVarLengthArray<Vec4f, 32> lineColors(segments);
+	QVarLengthArray<Vec4f, 64> trainColors(2*segments);
 
 	Vec3d posTrainB = mm.posTrain;
 	posTrainB[0] += thickness*0.7;
@@ -369,49 +392,89 @@ void Meteor::drawTrain(const StelCore *core, StelPainter& sPainter, const Meteor
 
 		posi = mm.posTrain;
 		posi[2] = height;
-		insertVertex(core, viewMatrix, vertexArrayLine, posi);
+		vertexArrayLine.append(transformVertex(core, viewMatrix, posi));
 
 		posi = posTrainB;
 		posi[2] = height;
-		insertVertex(core, viewMatrix, vertexArrayL, posi);
-		insertVertex(core, viewMatrix, vertexArrayR, posi);
+		posi = transformVertex(core, viewMatrix, posi);
+		vertexArrayL.append(posi);
+		vertexArrayR.append(posi);
 
 		posi = posTrainL;
 		posi[2] = height;
-		insertVertex(core, viewMatrix, vertexArrayL, posi);
-		insertVertex(core, viewMatrix, vertexArrayTop, posi);
+		posi = transformVertex(core, viewMatrix, posi);
+		vertexArrayL.append(posi);
+		vertexArrayTop.append(posi);
 
 		posi = posTrainR;
 		posi[2] = height;
-		insertVertex(core, viewMatrix, vertexArrayR, posi);
-		insertVertex(core, viewMatrix, vertexArrayTop, posi);
-
-		lineColorArray[i][3] = mag;
-		trainColorArray[i*2][3] = mag;
-		trainColorArray[i*2+1][3] = mag;
+		posi = transformVertex(core, viewMatrix, posi);
+		vertexArrayR.append(posi);
+		vertexArrayTop.append(posi);
+
+		lineColors[i] = lineColorArray.at(i);
+		lineColors[i][3] = mag;
+		trainColors[i*2] = trainColorArray.at(i*2);
+		trainColors[i*2][3] = mag;
+		trainColors[i*2+1] = trainColorArray.at(i*2+1);
+		trainColors[i*2+1][3] = mag;
 	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	sPainter.enableClientStates(true, false, true);
 	if (thickness) {
-		sPainter.setColorPointer(4, GL_FLOAT, trainColorArray.toVector().constData());
-
-		sPainter.setVertexPointer(3, GL_DOUBLE, vertexArrayL.constData());
-		sPainter.drawFromArray(StelPainter::TriangleStrip, vertexArrayL.size(), 0, true);
-
-		sPainter.setVertexPointer(3, GL_DOUBLE, vertexArrayR.constData());
-		sPainter.drawFromArray(StelPainter::TriangleStrip, vertexArrayR.size(), 0, true);
-
-		sPainter.setVertexPointer(3, GL_DOUBLE, vertexArrayTop.constData());
-		sPainter.drawFromArray(StelPainter::TriangleStrip, vertexArrayTop.size(), 0, true);
+		// The three strips of the prism as separate triangles
+		const QVarLengthArray<Vec3d, 64>* strips[3] = {&vertexArrayL, &vertexArrayR, &vertexArrayTop};
+		for (int s=0; s<3; s++) {
+			const QVarLengthArray<Vec3d, 64>& strip = *strips[s];
+			for (int k=0; k+2<strip.size(); k++) {
+				for (int j=k; j<k+3; j++) {
+					batch.trainVertices.append(strip.at(j));
+					batch.trainColors.append(trainColors.at(j));
+				}
+			}
+		}
+	}
+	// The line strip as separate lines
+	for (int i=0; i+1<segments; i++) {
+		batch.lineVertices.append(vertexArrayLine.at(i));
+		batch.lineVertices.append(vertexArrayLine.at(i+1));
+		batch.lineColors.append(lineColors.at(i));
+		batch.lineColors.append(lineColors.at(i+1));
 	}
-	sPainter.setColorPointer(4, GL_FLOAT, lineColorArray.toVector().constData());
-	sPainter.setVertexPointer(3, GL_DOUBLE, vertexArrayLine.constData());
-	sPainter.drawFromArray(StelPainter::LineStrip, vertexArrayLine.size(), 0, true);
+}
 
+void Meteor::drawBatch(StelPainter& sPainter, DrawBatch& batch)
+{
+	glEnable(GL_BLEND);
+	if (!batch.trainVertices.isEmpty() || !batch.lineVertices.isEmpty())
+	{
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		sPainter.enableClientStates(true, false, true);
+		if (!batch.trainVertices.isEmpty())
+		{
+			sPainter.setColorPointer(4, GL_FLOAT, batch.trainColors.constData());
+			sPainter.setVertexPointer(3, GL_DOUBLE, batch.trainVertices.constData());
+			sPainter.drawFromArray(StelPainter::Triangles, batch.trainVertices.size(), 0, true);
+		}
+		if (!batch.lineVertices.isEmpty())
+		{
+			sPainter.setColorPointer(4, GL_FLOAT, batch.lineColors.constData());
+			sPainter.setVertexPointer(3, GL_DOUBLE, batch.lineVertices.constData());
+			sPainter.drawFromArray(StelPainter::Lines, batch.lineVertices.size(), 0, true);
+		}
+	}
+	if (!batch.bolideVertices.isEmpty())
+	{
+		glBlendFunc(GL_ONE, GL_ONE);
+		sPainter.enableClientStates(true, true, true);
+		Meteor::bolideTexture->bind();
+		sPainter.setTexCoordPointer(2, GL_FLOAT, batch.bolideTexCoords.constData());
+		sPainter.setColorPointer(4, GL_FLOAT, batch.bolideColors.constData());
+		sPainter.setVertexPointer(3, GL_DOUBLE, batch.bolideVertices.constData());
+		sPainter.drawFromArray(StelPainter::Triangles, batch.bolideVertices.size(), 0, true);
+	}
 	glDisable(GL_BLEND);
 	sPainter.enableClientStates(false);
+	batch.clear();
 }
 
 // returns true if visible
@@ -426,8 +489,18 @@ void Meteor::draw(const StelCore* core, StelPainter& sPainter)
 	float thickness, bolideSize;
 	calculateThickness(core, thickness, bolideSize);
 
-	drawTrain(core, sPainter, meteor, m_viewMatrix, thickness,
-		  m_segments, m_lineColorArray, m_trainColorArray);
+	DrawBatch batch;
+	addToBatch(core, thickness, bolideSize, batch);
+	drawBatch(sPainter, batch);
+}
+
+void Meteor::addToBatch(const StelCore* core, float thickness, float bolideSize, DrawBatch& batch) const
+{
+	if (!m_alive)
+	{
+		return;
+	}
 
-	drawBolide(core, sPainter, meteor, m_viewMatrix, bolideSize);
+	addTrain(core, meteor, m_viewMatrix, thickness, m_segments, m_lineColorArray, m_trainColorArray, batch);
+	addBolide(core, meteor, m_viewMatrix, bolideSize, batch);
 }
@@ -26,6 +26,7 @@
 
 #include <QList>
 #include <QPair>
+#include <QVector>
 
 class StelCore;
 class StelPainter;
@@ -57,10 +58,31 @@ public:
 		int firstBrightSegment; //! First bright segment of the train
 	};
 
+	//! The geometry of several meteors, drawn with one call for the trains, one for the lines and one for the bolides.
+	struct DrawBatch
+	{
+		QVector<Vec3d> trainVertices;	//! Triangles
+		QVector<Vec4f> trainColors;
+		QVector<Vec3d> lineVertices;	//! Lines
+		QVector<Vec4f> lineColors;
+		QVector<Vec3d> bolideVertices;	//! Triangles
+		QVector<Vec4f> bolideColors;
+		QVector<Vec2f> bolideTexCoords;
+		//! Remove the geometry but keep the memory allocated.
+		void clear();
+	};
+
 	//! Create a Meteor object.
 	//! @param v the velocity of the meteor in km/s.
 	Meteor(const StelCore*, float v);
 	virtual ~Meteor();
+
+	//! Start a new random meteor, reusing this object.
+	//! @param v the velocity of the meteor in km/s.
+	void start(const StelCore* core, float v);
+
+	//! Return whether the meteor is still visible.
+	bool isAlive() const {return m_alive;}
 	
 	//! Updates the position of the meteor, and expires it if necessary.
 	//! @return true of the meteor is still alive, else false.
@@ -69,6 +91,9 @@ public:
 	//! Draws the meteor.
 	void draw(const StelCore* core, StelPainter& sPainter);
 
+	//! Add the meteor to a batch, with the sizes computed by calculateThickness().
+	void addToBatch(const StelCore* core, float thickness, float bolideSize, DrawBatch& batch) const;
+
 	//! Draws the meteor train. (useful to be reused in MeteorShowers plugin)
 	static void drawTrain(const StelCore* core, StelPainter& sPainter, const MeteorModel& mm,
 			      const Mat4d& viewMatrix, const float thickness, const int segments,
@@ -78,6 +103,18 @@ public:
 	static void drawBolide(const StelCore* core, StelPainter &sPainter, const MeteorModel& mm,
 			       const Mat4d& viewMatrix, const float bolideSize);
 
+	//! Add the meteor train to a batch instead of drawing it.
+	static void addTrain(const StelCore* core, const MeteorModel& mm, const Mat4d& viewMatrix,
+			     const float thickness, const int segments, const QList<Vec4f>& lineColorArray,
+			     const QList<Vec4f>& trainColorArray, DrawBatch& batch);
+
+	//! Add the meteor bolide to a batch instead of drawing it.
+	static void addBolide(const StelCore* core, const MeteorModel& mm, const Mat4d& viewMatrix,
+			      const float bolideSize, DrawBatch& batch);
+
+	//! Draw all the meteors added to the batch, and clear it.
+	static void drawBatch(StelPainter& sPainter, DrawBatch& batch);
+
 	//! Calculates the train thickness and bolide size.
 	static void calculateThickness(const StelCore* core, float &thickness, float &bolideSize);
 
@@ -102,8 +139,8 @@ public:
 	static StelTextureSP bolideTexture;
 
 private:
-	static void insertVertex(const StelCore* core, const Mat4d& viewMatrix,
-				 QVector<Vec3d> &vertexArray, Vec3d vertex);
+	//! Transform a point of the meteor model to the local frame.
+	static Vec3d transformVertex(const StelCore* core, const Mat4d& viewMatrix, Vec3d vertex);
 	static Vec4f getColorFromName(QString colorName);
 	QList<colorPair> getRandColor();
 
@@ -37,18 +37,19 @@ MeteorMgr::MeteorMgr(int zhr, int maxv )
 	: ZHR(zhr)
 	, maxVelocity(maxv)
 	, flagShow(true)
+	, nbActive(0)
 {
 	setObjectName("MeteorMgr");
 }
 
 MeteorMgr::~MeteorMgr()
 {
-	std::vector<Meteor*>::iterator iter;
-	for(iter = active.begin(); iter != active.end(); ++iter)
+	foreach (Meteor* m, meteors)
 	{
-		delete *iter;
+		delete m;
 	}
-	active.clear();
+	meteors.clear();
+	nbActive = 0;
 	Meteor::bolideTexture.clear();
 }
 
@@ -112,41 +113,50 @@ void MeteorMgr::update(double deltaTime)
 		deltaTime = 500;
 	}
 
-	// step through and update all active meteors
-	std::vector<Meteor*>::iterator iter;
-	for (iter = active.begin(); iter != active.end(); ++iter)
+	// step through and update all active meteors, moving the dead ones after the active ones
+	for (int i=0; i<nbActive; )
 	{
-		if (!(*iter)->update(deltaTime))
+		if (meteors.at(i)->update(deltaTime))
 		{
-			delete *iter;
-			iter = active.erase(iter);
-			iter--;  // important!
+			++i;
+		}
+		else
+		{
+			--nbActive;
+			qSwap(meteors[i], meteors[nbActive]);
 		}
 	}
 
-	// only makes sense given lifetimes of meteors to draw when timeSpeed is realtime
-	// otherwise high overhead of large numbers of meteors
-	if (tspeed<0 || fabs(tspeed)>1.)
-	{
-		// don't start any more meteors
-		return;
-	}
+	// The meteors are animated in real time, but they appear at the rate of the simulation time when it is
+	// accelerated, so that showers can be followed at any rate. The pool size bounds the cost of the storms.
+	const double rateFactor = qMax(1., fabs(tspeed));
+	const double expected = (double)ZHR*zhrToWsr*rateFactor*deltaTime/1000.0;
 
 	// determine average meteors per frame needing to be created
-	int mpf = (int)((double)ZHR*zhrToWsr*deltaTime/1000.0 + 0.5);
+	int mpf = (int)(expected + 0.5);
 	if (mpf<1)
 	{
 		mpf = 1;
 	}
 
-	for (int i=0; i<mpf; ++i)
+	for (int i=0; i<mpf && nbActive<MaxMeteors; ++i)
 	{
 		// start new meteor based on ZHR time probability
 		double prob = ((double)rand())/RAND_MAX;
-		if (ZHR>0 && prob<((double)ZHR*zhrToWsr*deltaTime/1000.0/(double)mpf))
+		if (ZHR>0 && prob<(expected/(double)mpf))
 		{
-			Meteor *m = new Meteor(core, maxVelocity);
-			active.push_back(m);
+			if (nbActive==meteors.size())
+			{
+				meteors.append(new Meteor(core, maxVelocity));
+			}
+			else
+			{
+				meteors.at(nbActive)->start(core, maxVelocity);
+			}
+			if (meteors.at(nbActive)->isAlive())
+			{
+				++nbActive;
+			}
 		}
 	}
 }
@@ -165,11 +175,18 @@ void MeteorMgr::draw(StelCore* core)
 		return;
 	}
 
-	// step through and draw all active meteors
-	StelPainter sPainter(core->getProjection(StelCore::FrameAltAz));
-	std::vector<Meteor*>::iterator iter;
-	for (iter = active.begin(); iter != active.end(); ++iter)
+	if (nbActive==0)
 	{
-		(*iter)->draw(core, sPainter);
+		return;
 	}
+
+	// step through all active meteors and draw them together
+	float thickness, bolideSize;
+	Meteor::calculateThickness(core, thickness, bolideSize);
+	for (int i=0; i<nbActive; ++i)
+	{
+		meteors.at(i)->addToBatch(core, thickness, bolideSize, drawBatch);
+	}
+	StelPainter sPainter(core->getProjection(StelCore::FrameAltAz));
+	Meteor::drawBatch(sPainter, drawBatch);
 }
@@ -22,9 +22,9 @@
 #define _METEORMGR_HPP_
 
 #include "StelModule.hpp"
-#include <vector>
+#include "Meteor.hpp"
 
-class Meteor;
+#include <QVector>
 
 //! @class MeteorMgr
 //! Simulates a meteor shower.
@@ -57,12 +57,18 @@ public:
 	//! ones based on the current rate, and removes those which have run their 
 	//! course.
 	virtual void update(double deltaTime);
+	//! The meteors are started from the time rate and the view of the observer. This is the only
+	//! parallel update drawing numbers from rand(), whose state is shared by the whole process.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true, UpdateTime|UpdateObserver|UpdateView);}
 	
 	//! Defines the order in which the various modules are drawn.
 	virtual double getCallOrder(StelModuleActionName actionName) const;
 
 	//! Factor to convert from zhr to whole earth per second rate
 	static const double zhrToWsr;
+
+	//! Maximum number of meteors visible at the same time.
+	static const int MaxMeteors = 2000;
 	
 public slots:
 	///////////////////////////////////////////////////////////////////////////
@@ -84,7 +90,11 @@ signals:
 	void zhrChanged(int);
 	
 private:
-	std::vector<Meteor*> active;	// Vector containing all active meteors
+	//! The meteors, the active ones first. The others are reused when new meteors start.
+	QVector<Meteor*> meteors;
+	int nbActive;
+	//! The geometry of the meteors being drawn, kept to reuse its memory
+	Meteor::DrawBatch drawBatch;
 	int ZHR;
 	int maxVelocity;
 	bool flagShow;
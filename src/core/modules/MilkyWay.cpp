@@ -111,6 +111,8 @@ void MilkyWay::draw(StelCore* core)
 	sPainter.enableTexture2d(true);
 	glDisable(GL_BLEND);
 	tex->bind();
-	sPainter.drawStelVertexArray(*vertexArray);
+	// The same sphere as vertexArray, drawn from the painter's static buffers when the projection allows it
+	if (!sPainter.sSphereGpu(1.f,1.f,20,20,1))
+		sPainter.drawStelVertexArray(*vertexArray);
 	glDisable(GL_CULL_FACE);
 }
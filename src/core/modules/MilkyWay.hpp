@@ -47,6 +47,8 @@ public:
 	//! Update and time-dependent state.  Updates the fade level while the 
 	//! Milky way rendering is being changed from on to off or off to on.
 	virtual void update(double deltaTime);
+	//! Only the fader is updated, so the update can run in parallel.
+	virtual UpdateDependencies getUpdateDependencies() const {return UpdateDependencies(true);}
 	
 	//! Used to determine the order in which the various modules are drawn.
 	virtual double getCallOrder(StelModuleActionName actionName) const {Q_UNUSED(actionName); return 1.;}
@@ -0,0 +1,312 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "MinorBodyStore.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QHash>
+
+#include <cmath>
+#include <cstring>
+
+MinorBodyStore::Record::Record()
+	: minorPlanetNumber(0), type(Asteroid), pericenterDistance(0.), eccentricity(0.),
+	  inclination(0.), ascendingNode(0.), argOfPericenter(0.), timeAtPericenter(0.),
+	  meanMotion(0.), orbitGoodDays(1000.), radius(0.f), albedo(0.f),
+	  absoluteMagnitude(-99.f), slopeParameter(0.15f), semiMajorAxis(0.f)
+{
+}
+
+MinorBodyStore::MinorBodyStore() : data(NULL), count(0), strings(NULL), stringsSize(0)
+{
+}
+
+MinorBodyStore::~MinorBodyStore()
+{
+	close();
+}
+
+qint64 MinorBodyStore::columnsSize(quint32 count)
+{
+	return HeaderSize + (qint64)(NbDoubleColumns*8 + NbFloatColumns*4 + NbIntColumns*4 + 1)*count;
+}
+
+bool MinorBodyStore::open(const QString& filePath)
+{
+	close();
+	file.setFileName(filePath);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "ERROR: can't open" << QDir::toNativeSeparators(filePath);
+		return false;
+	}
+	const qint64 fileSize = file.size();
+	const uchar* map = fileSize>=HeaderSize ? file.map(0, fileSize) : NULL;
+	if (map==NULL)
+	{
+		qWarning() << "ERROR: can't map" << QDir::toNativeSeparators(filePath);
+		file.close();
+		return false;
+	}
+
+	quint32 header[4];
+	std::memcpy(header, map, HeaderSize);
+	if (std::memcmp(map, "SSOB", 4)!=0 || header[1]!=FormatVersion
+	    || columnsSize(header[2])+header[3]!=fileSize
+	    || (header[3]>0 && map[fileSize-1]!='\0'))
+	{
+		qWarning() << "ERROR:" << QDir::toNativeSeparators(filePath) << "is not a valid minor bodies database";
+		file.unmap(const_cast<uchar*>(map));
+		file.close();
+		return false;
+	}
+	data = map;
+	count = header[2];
+	stringsSize = header[3];
+	strings = reinterpret_cast<const char*>(data + columnsSize(count));
+	return true;
+}
+
+void MinorBodyStore::close()
+{
+	if (data!=NULL)
+		file.unmap(const_cast<uchar*>(data));
+	if (file.isOpen())
+		file.close();
+	data = NULL;
+	count = 0;
+	strings = NULL;
+	stringsSize = 0;
+}
+
+QString MinorBodyStore::getString(qint32 offset) const
+{
+	if (offset<0 || (quint32)offset>=stringsSize)
+		return QString();
+	return QString::fromUtf8(strings+offset);
+}
+
+QString MinorBodyStore::getName(int i) const
+{
+	Q_ASSERT(isOpen() && i>=0 && (quint32)i<count);
+	return getString(intColumn(ColNameOffset)[i]);
+}
+
+MinorBodyStore::Record MinorBodyStore::getRecord(int i) const
+{
+	Q_ASSERT(isOpen() && i>=0 && (quint32)i<count);
+	Record r;
+	r.name = getString(intColumn(ColNameOffset)[i]);
+	r.provisionalDesignation = getString(intColumn(ColDesignationOffset)[i]);
+	r.minorPlanetNumber = intColumn(ColMinorPlanetNumber)[i];
+	const quint8 type = typeColumn()[i];
+	r.type = type<=Comet ? (BodyType)type : Asteroid;
+	r.pericenterDistance = doubleColumn(ColPericenterDistance)[i];
+	r.eccentricity = doubleColumn(ColEccentricity)[i];
+	r.inclination = doubleColumn(ColInclination)[i];
+	r.ascendingNode = doubleColumn(ColAscendingNode)[i];
+	r.argOfPericenter = doubleColumn(ColArgOfPericenter)[i];
+	r.timeAtPericenter = doubleColumn(ColTimeAtPericenter)[i];
+	r.meanMotion = doubleColumn(ColMeanMotion)[i];
+	r.orbitGoodDays = doubleColumn(ColOrbitGoodDays)[i];
+	r.radius = floatColumn(ColRadius)[i];
+	r.albedo = floatColumn(ColAlbedo)[i];
+	r.absoluteMagnitude = floatColumn(ColAbsoluteMagnitude)[i];
+	r.slopeParameter = floatColumn(ColSlopeParameter)[i];
+	r.semiMajorAxis = floatColumn(ColSemiMajorAxis)[i];
+	return r;
+}
+
+bool MinorBodyStore::readAll(const QString& filePath, QVector<Record>& records)
+{
+	records.clear();
+	MinorBodyStore store;
+	if (!store.open(filePath))
+		return false;
+	records.reserve(store.size());
+	for (int i=0;i<store.size();++i)
+		records.append(store.getRecord(i));
+	return true;
+}
+
+bool MinorBodyStore::write(const QString& filePath, const QVector<Record>& records)
+{
+	const quint32 n = records.size();
+
+	// Build the string table first, sharing the identical strings
+	QByteArray stringTable;
+	QHash<QString, qint32> stringOffsets;
+	QVector<qint32> nameOffsets(n), designationOffsets(n);
+	for (quint32 i=0;i<n;++i)
+	{
+		for (int k=0;k<2;++k)
+		{
+			const QString& s = k==0 ? records[i].name : records[i].provisionalDesignation;
+			qint32 offset = -1;
+			if (!s.isEmpty())
+			{
+				if (!stringOffsets.contains(s))
+				{
+					stringOffsets.insert(s, stringTable.size());
+					stringTable.append(s.toUtf8());
+					stringTable.append('\0');
+				}
+				offset = stringOffsets.value(s);
+			}
+			(k==0 ? nameOffsets : designationOffsets)[i] = offset;
+		}
+	}
+
+	QFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		qWarning() << "ERROR: can't write" << QDir::toNativeSeparators(filePath);
+		return false;
+	}
+
+	QByteArray buf;
+	buf.reserve(columnsSize(n) + stringTable.size());
+	buf.append("SSOB", 4);
+	const quint32 header[3] = {FormatVersion, n, (quint32)stringTable.size()};
+	buf.append(reinterpret_cast<const char*>(header), sizeof(header));
+
+	QVector<double> doubles(n);
+	for (int c=0;c<NbDoubleColumns;++c)
+	{
+		for (quint32 i=0;i<n;++i)
+		{
+			const Record& r = records[i];
+			const double values[NbDoubleColumns] = {r.pericenterDistance, r.eccentricity, r.inclination,
+				r.ascendingNode, r.argOfPericenter, r.timeAtPericenter, r.meanMotion, r.orbitGoodDays};
+			doubles[i] = values[c];
+		}
+		buf.append(reinterpret_cast<const char*>(doubles.constData()), n*sizeof(double));
+	}
+	QVector<float> floats(n);
+	for (int c=0;c<NbFloatColumns;++c)
+	{
+		for (quint32 i=0;i<n;++i)
+		{
+			const Record& r = records[i];
+			const float values[NbFloatColumns] = {r.radius, r.albedo, r.absoluteMagnitude, r.slopeParameter, r.semiMajorAxis};
+			floats[i] = values[c];
+		}
+		buf.append(reinterpret_cast<const char*>(floats.constData()), n*sizeof(float));
+	}
+	QVector<qint32> numbers(n);
+	QByteArray types(n, 0);
+	for (quint32 i=0;i<n;++i)
+	{
+		numbers[i] = records[i].minorPlanetNumber;
+		types[i] = (char)records[i].type;
+	}
+	buf.append(reinterpret_cast<const char*>(numbers.constData()), n*sizeof(qint32));
+	buf.append(reinterpret_cast<const char*>(nameOffsets.constData()), n*sizeof(qint32));
+	buf.append(reinterpret_cast<const char*>(designationOffsets.constData()), n*sizeof(qint32));
+	buf.append(types);
+	buf.append(stringTable);
+
+	if (file.write(buf)!=buf.size())
+	{
+		qWarning() << "ERROR: can't write" << QDir::toNativeSeparators(filePath);
+		file.close();
+		file.remove();
+		return false;
+	}
+	file.close();
+	return true;
+}
+
+bool MinorBodyStore::recordFromElements(const QVariantHash& elements, Record& record)
+{
+	const QString name = elements.value("name").toString().simplified();
+	const QString type = elements.value("type").toString();
+	const QString texMap = elements.value("tex_map", "nomap.png").toString();
+	if (name.isEmpty() || name.contains("Pluto")
+	    || elements.value("parent").toString()!="Sun"
+	    || elements.value("coord_func").toString()!="comet_orbit"
+	    || (type!="asteroid" && type!="plutoid" && type!="comet")
+	    || (!texMap.isEmpty() && texMap!="nomap.png")
+	    || elements.value("lighting", false).toBool()
+	    || elements.value("hidden", false).toBool())
+		return false;
+
+	Record r;
+	r.name = name;
+	r.type = type=="comet" ? Comet : (type=="plutoid" ? Plutoid : Asteroid);
+	r.minorPlanetNumber = elements.value("minor_planet_number", 0).toInt();
+	r.provisionalDesignation = elements.value("provisional_designation").toString();
+
+	// Same rules as the comet_orbit function in SolarSystem::loadPlanets(), knowing that the parent is the Sun
+	const double eccentricity = elements.value("orbit_Eccentricity", 0.0).toDouble();
+	double pericenterDistance = elements.value("orbit_PericenterDistance", -1e100).toDouble();
+	double semiMajorAxis;
+	if (pericenterDistance <= 0.0)
+	{
+		semiMajorAxis = elements.value("orbit_SemiMajorAxis", -1e100).toDouble();
+		if (semiMajorAxis <= -1e100 || eccentricity == 1.0)
+			return false;
+		pericenterDistance = semiMajorAxis * (1.0-eccentricity);
+	}
+	else
+	{
+		semiMajorAxis = (eccentricity == 1.0) ? 0.0 : pericenterDistance / (1.0-eccentricity);
+	}
+	double meanMotion = elements.value("orbit_MeanMotion", -1e100).toDouble();
+	if (meanMotion <= -1e100)
+	{
+		const double period = elements.value("orbit_Period", -1e100).toDouble();
+		if (period <= -1e100)
+		{
+			meanMotion = (eccentricity == 1.0)
+				? 0.01720209895 * (1.5/pericenterDistance) * std::sqrt(0.5/pericenterDistance)
+				: 0.01720209895 / (std::fabs(semiMajorAxis)*std::sqrt(std::fabs(semiMajorAxis)));
+		}
+		else
+			meanMotion = 2.0*M_PI/period;
+	}
+	else
+		meanMotion *= (M_PI/180.0);
+	double timeAtPericenter = elements.value("orbit_TimeAtPericenter", -1e100).toDouble();
+	if (timeAtPericenter <= -1e100)
+	{
+		const double epoch = elements.value("orbit_Epoch", -1e100).toDouble();
+		const double meanAnomaly = elements.value("orbit_MeanAnomaly", -1e100).toDouble();
+		if (epoch <= -1e100 || meanAnomaly <= -1e100)
+			return false;
+		timeAtPericenter = epoch - meanAnomaly*(M_PI/180.0) / meanMotion;
+	}
+	r.pericenterDistance = pericenterDistance;
+	r.eccentricity = eccentricity;
+	r.inclination = elements.value("orbit_Inclination").toDouble()*(M_PI/180.0);
+	r.ascendingNode = elements.value("orbit_AscendingNode").toDouble()*(M_PI/180.0);
+	r.argOfPericenter = elements.value("orbit_ArgOfPericenter").toDouble()*(M_PI/180.0);
+	r.timeAtPericenter = timeAtPericenter;
+	r.meanMotion = meanMotion;
+	r.orbitGoodDays = elements.value("orbit_good", 1000).toDouble();
+
+	r.radius = elements.value("radius").toFloat();
+	r.albedo = elements.value("albedo").toFloat();
+	r.absoluteMagnitude = elements.value("absolute_magnitude", -99).toFloat();
+	r.slopeParameter = elements.value("slope_parameter", r.type==Comet ? 4.0 : 0.15).toFloat();
+	r.semiMajorAxis = elements.value("orbit_SemiMajorAxis", 0).toFloat();
+	record = r;
+	return true;
+}
@@ -0,0 +1,152 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _MINORBODYSTORE_HPP_
+#define _MINORBODYSTORE_HPP_
+
+#include <QFile>
+#include <QString>
+#include <QVariantHash>
+#include <QVector>
+
+//! @class MinorBodyStore
+//! Binary database of the orbital elements of minor bodies (asteroids, plutoids and comets)
+//! orbiting the Sun, used instead of ssystem.ini for the large sets imported from the MPC.
+//! The file is memory mapped and read one column at a time, which avoids the costs of
+//! the parsing and of the QSettings groups for tens of thousands of bodies.
+//! The layout is a 16 bytes header followed by the columns of all the bodies:
+//! - magic "SSOB", format version, number of bodies and size of the string table (quint32 each)
+//! - the double columns (see DoubleColumn), then the float columns (see FloatColumn)
+//! - the minor planet numbers, name offsets and provisional designation offsets (qint32)
+//! - the types (quint8, see BodyType)
+//! - the string table, holding the UTF-8 names and designations terminated by a NUL character.
+//! The values are stored in the byte order of the machine which wrote the file, files written
+//! with another byte order are rejected.
+class MinorBodyStore
+{
+public:
+	enum BodyType
+	{
+		Asteroid,
+		Plutoid,
+		Comet
+	};
+
+	//! Orbital elements and physical parameters of one body, with the angles in radians.
+	struct Record
+	{
+		Record();
+		QString name;
+		QString provisionalDesignation;	//!< Empty if none
+		int minorPlanetNumber;	//!< 0 if none
+		BodyType type;
+		double pericenterDistance;	//!< AU
+		double eccentricity;
+		double inclination;
+		double ascendingNode;
+		double argOfPericenter;
+		double timeAtPericenter;	//!< JD
+		double meanMotion;	//!< radians per day
+		double orbitGoodDays;
+		float radius;	//!< km
+		float albedo;
+		float absoluteMagnitude;	//!< H (asteroids) or g (comets), -99 if unknown
+		float slopeParameter;	//!< G (asteroids) or k (comets)
+		float semiMajorAxis;	//!< AU, 0 if not given
+	};
+
+	MinorBodyStore();
+	~MinorBodyStore();
+
+	//! Map a database file in memory.
+	//! @return false if the file can't be read or is not a valid database.
+	bool open(const QString& filePath);
+	void close();
+	bool isOpen() const {return data!=NULL;}
+
+	//! Get the number of bodies in the open database.
+	int size() const {return count;}
+	//! Get the name of a body without reading the other columns.
+	QString getName(int i) const;
+	//! Get all the data of a body.
+	Record getRecord(int i) const;
+
+	//! Read all the bodies of a database file.
+	//! @return false if the file can't be read, in which case records is left empty.
+	static bool readAll(const QString& filePath, QVector<Record>& records);
+	//! Write a database file, replacing any existing one.
+	static bool write(const QString& filePath, const QVector<Record>& records);
+
+	//! Convert the elements of a body in the ssystem.ini format (as produced by the
+	//! SolarSystemEditor plugin) to a record, following the rules of the comet_orbit
+	//! coordinates function of SolarSystem::loadPlanets().
+	//! @return false if the body can't be stored in the database, i.e. if it doesn't
+	//! orbit the Sun, doesn't use comet_orbit, is not a minor body or has a texture.
+	static bool recordFromElements(const QVariantHash& elements, Record& record);
+
+private:
+	enum DoubleColumn
+	{
+		ColPericenterDistance,
+		ColEccentricity,
+		ColInclination,
+		ColAscendingNode,
+		ColArgOfPericenter,
+		ColTimeAtPericenter,
+		ColMeanMotion,
+		ColOrbitGoodDays,
+		NbDoubleColumns
+	};
+	enum FloatColumn
+	{
+		ColRadius,
+		ColAlbedo,
+		ColAbsoluteMagnitude,
+		ColSlopeParameter,
+		ColSemiMajorAxis,
+		NbFloatColumns
+	};
+	enum IntColumn
+	{
+		ColMinorPlanetNumber,
+		ColNameOffset,
+		ColDesignationOffset,
+		NbIntColumns
+	};
+
+	static const int HeaderSize = 16;
+	static const quint32 FormatVersion = 1;
+
+	//! Get the size of the file holding count bodies, without the string table.
+	static qint64 columnsSize(quint32 count);
+
+	const double* doubleColumn(DoubleColumn c) const {return reinterpret_cast<const double*>(data+HeaderSize)+c*count;}
+	const float* floatColumn(FloatColumn c) const {return reinterpret_cast<const float*>(data+HeaderSize+NbDoubleColumns*8*count)+c*count;}
+	const qint32* intColumn(IntColumn c) const {return reinterpret_cast<const qint32*>(data+HeaderSize+(NbDoubleColumns*8+NbFloatColumns*4)*count)+c*count;}
+	const quint8* typeColumn() const {return data+HeaderSize+(NbDoubleColumns*8+NbFloatColumns*4+NbIntColumns*4)*count;}
+	QString getString(qint32 offset) const;
+
+	QFile file;
+	const uchar* data;
+	quint32 count;
+	const char* strings;
+	quint32 stringsSize;
+};
+
+#endif // _MINORBODYSTORE_HPP_
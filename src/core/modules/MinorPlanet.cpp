@@ -212,8 +212,8 @@ QString MinorPlanet::getInfoString(const StelCore *core, const InfoStringGroup &
 
 	if (flags&ObjectType)
 	{
-		if (pType.length()>0)
-			oss << q_("Type: <b>%1</b>").arg(q_(pType)) << "<br />";
+		if (!pType.isEmpty())
+			oss << q_("Type: <b>%1</b>").arg(q_(pType.toString())) << "<br />";
 	}
 
 	if (flags&Magnitude)
@@ -296,16 +296,16 @@ double MinorPlanet::getSiderealPeriod() const
 	return period;
 }
 
-float MinorPlanet::getVMagnitude(const StelCore* core) const
+float MinorPlanet::computeVMagnitude(const StelCore* core) const
 {
 	//If the H-G system is not used, use the default radius/albedo mechanism
 	if (slopeParameter < 0)
 	{
-		return Planet::getVMagnitude(core);
+		return Planet::computeVMagnitude(core);
 	}
 
 	//Calculate phase angle
-	//(Code copied from Planet::getVMagnitude())
+	//(Code copied from Planet::computeVMagnitude())
 	//(LOL, this is actually vector subtraction + the cosine theorem :))
 	const Vec3d& observerHelioPos = core->getObserverHeliocentricEclipticPos();
 	const double observerRq = observerHelioPos.lengthSquared();
@@ -330,13 +330,33 @@ float MinorPlanet::getVMagnitude(const StelCore* core) const
 	return apparentMagnitude;
 }
 
-void MinorPlanet::translateName(const StelTranslator &translator)
+float MinorPlanet::getBrightestVMagnitude(double absoluteMagnitude, double slopeParameter,
+					   double perihelion, double aphelion, double observerSunDistance)
 {
-	nameI18 = translator.qtranslate(properName);
+	// The bound relies on the phase function of the H-G system, which is at most 1
+	if (slopeParameter < 0 || slopeParameter > 1)
+		return -100.f;
+
+	// Smallest value of (distance to the sun)*(distance to the observer) on the orbit
+	double minDistances;
+	if (observerSunDistance < perihelion)
+		minDistances = perihelion*(perihelion-observerSunDistance);
+	else if (observerSunDistance > aphelion)
+		minDistances = qMin(perihelion*(observerSunDistance-perihelion), aphelion*(observerSunDistance-aphelion));
+	else
+		return -100.f; // The orbit crosses the sphere of the observer
+
+	return absoluteMagnitude + 5 * std::log10(minDistances);
+}
+
+QString MinorPlanet::getTranslatedName(const StelTranslator &translator) const
+{
+	QString translatedName = translator.qtranslate(properName);
 	if (englishName.endsWith('*'))
 	{
-		nameI18.append('*');
+		translatedName.append('*');
 	}
+	return translatedName;
 }
 
 QString MinorPlanet::renderProvisionalDesignationinHtml(QString plainTextName)
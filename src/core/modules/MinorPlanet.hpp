@@ -71,10 +71,10 @@ public:
 	//was not designed to handle different types of objects.
 	// \todo Decide if this is going to be "MinorPlanet" or "Asteroid"
 	//virtual QString getType() const {return "MinorPlanet";}
-	virtual float getVMagnitude(const StelCore* core) const;
-	//! sets the nameI18 property with the appropriate translation.
+	virtual float computeVMagnitude(const StelCore* core) const;
+	//! gets the appropriate translation of the name.
 	//! Function overriden to handle the problem with name conflicts.
-	virtual void translateName(const StelTranslator& trans);
+	virtual QString getTranslatedName(const StelTranslator& trans) const;
 
 	//! set the minor planet's number, if any.
 	//! The number should be specified as an additional parameter, as
@@ -108,6 +108,18 @@ public:
 	//! get sidereal period for minor planet
 	double getSiderealPeriod() const;
 
+	//! Get a lower bound of the magnitude the minor planet can reach, whatever the date.
+	//! @param perihelion, aphelion the range of the distances to the sun of the minor planet [AU].
+	//! @param observerSunDistance the distance of the observer to the sun [AU].
+	//! @return the bound, or -100 if the minor planet may become arbitrarily bright.
+	float getBrightestVMagnitude(double perihelion, double aphelion, double observerSunDistance) const
+	{
+		return getBrightestVMagnitude(absoluteMagnitude, slopeParameter, perihelion, aphelion, observerSunDistance);
+	}
+	//! Same as above for a minor planet with the given H-G parameters, which doesn't need to exist.
+	static float getBrightestVMagnitude(double absoluteMagnitude, double slopeParameter,
+					    double perihelion, double aphelion, double observerSunDistance);
+
 private:
 	int minorPlanetNumber;
 	double absoluteMagnitude;
@@ -28,6 +28,7 @@
 #include "StelModuleMgr.hpp"
 #include "StelCore.hpp"
 #include "StelPainter.hpp"
+#include "LabelMgr.hpp"
 
 #include <QTextStream>
 #include <QFile>
@@ -36,13 +37,7 @@
 #include <QDebug>
 #include <QBuffer>
 
-StelTextureSP Nebula::texCircle;
-StelTextureSP Nebula::texGalaxy;
-StelTextureSP Nebula::texOpenCluster;
-StelTextureSP Nebula::texGlobularCluster;
-StelTextureSP Nebula::texPlanetaryNebula;
-StelTextureSP Nebula::texDiffuseNebula;
-StelTextureSP Nebula::texOpenClusterWithNebulosity;
+int Nebula::hintSprites[Nebula::NbHintSprites] = {-1, -1, -1, -1, -1, -1, -1};
 float Nebula::circleScale = 1.f;
 float Nebula::hintsBrightness = 0;
 Vec3f Nebula::labelColor = Vec3f(0.4,0.3,0.5);
@@ -183,7 +178,7 @@ float Nebula::getSurfaceBrightnessWithExtinction(const StelCore* core) const
 		return 99;
 }
 
-void Nebula::drawHints(StelPainter& sPainter, float maxMagHints)
+void Nebula::drawHints(StelPainter& sPainter, float maxMagHints, HintBatch& batch)
 {
 	float lim = mag;
 	if (lim > 50) lim = 15.f;
@@ -194,37 +189,64 @@ void Nebula::drawHints(StelPainter& sPainter, float maxMagHints)
 
 	if (lim>maxMagHints)
 		return;
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE);
-	float lum = 1.f;//qMin(1,4.f/getOnScreenSize(core))*0.8;
-	Vec3f col(circleColor[0]*lum*hintsBrightness, circleColor[1]*lum*hintsBrightness, circleColor[2]*lum*hintsBrightness);
 
-	sPainter.setColor(col[0], col[1], col[2], 1);
+	// Same indices as in NebulaMgr::init()
+	int texture;
 	switch (nType)
 	{
 		case NebGx:
-			Nebula::texGalaxy->bind();
+			texture = 0;
 			break;
 		case NebOc:
-			Nebula::texOpenCluster->bind();
+			texture = 1;
 			break;
 		case NebGc:
-			Nebula::texGlobularCluster->bind();
+			texture = 2;
 			break;
 		case NebN:
-			Nebula::texDiffuseNebula->bind();
+			texture = 3;
 			break;
 		case NebPn:
-			Nebula::texPlanetaryNebula->bind();
+			texture = 4;
 			break;
 		case NebCn:
-			Nebula::texOpenClusterWithNebulosity->bind();
+			texture = 5;
 			break;
 		default:
-			Nebula::texCircle->bind();
+			texture = 6;
 	}
 
-	sPainter.drawSprite2dMode(XY[0], XY[1], 6);
+	// Same sprite as StelPainter::drawSprite2dMode(), as two triangles
+	const float radius = 6.f*sPainter.getProjector()->getDevicePixelsPerPixel()*StelApp::getInstance().getGlobalScalingRatio();
+	const float x = XY[0];
+	const float y = XY[1];
+	const Vec4f r = StelApp::getInstance().getTextureManager().getSpriteTexRect(hintSprites[texture]);
+	batch.vertices << Vec2f(x-radius, y-radius) << Vec2f(x+radius, y-radius) << Vec2f(x-radius, y+radius)
+		       << Vec2f(x-radius, y+radius) << Vec2f(x+radius, y-radius) << Vec2f(x+radius, y+radius);
+	batch.texCoords << Vec2f(r[0], r[1]) << Vec2f(r[2], r[1]) << Vec2f(r[0], r[3])
+			<< Vec2f(r[0], r[3]) << Vec2f(r[2], r[1]) << Vec2f(r[2], r[3]);
+}
+
+void Nebula::drawHintBatch(StelPainter& sPainter, HintBatch& batch)
+{
+	if (batch.vertices.isEmpty())
+		return;
+	StelTextureSP atlas = StelApp::getInstance().getTextureManager().getSpriteAtlas();
+	if (!atlas)
+		return;
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	float lum = 1.f;//qMin(1,4.f/getOnScreenSize(core))*0.8;
+	Vec3f col(circleColor[0]*lum*hintsBrightness, circleColor[1]*lum*hintsBrightness, circleColor[2]*lum*hintsBrightness);
+	sPainter.setColor(col[0], col[1], col[2], 1);
+	atlas->bind();
+	sPainter.enableClientStates(true, true);
+	sPainter.setVertexPointer(2, GL_FLOAT, batch.vertices.constData());
+	sPainter.setTexCoordPointer(2, GL_FLOAT, batch.texCoords.constData());
+	sPainter.drawFromArray(StelPainter::Triangles, batch.vertices.size(), 0, false);
+	sPainter.enableClientStates(false);
+	batch.vertices.resize(0);
+	batch.texCoords.resize(0);
 }
 
 void Nebula::drawLabel(StelPainter& sPainter, float maxMagLabel)
@@ -259,7 +281,7 @@ void Nebula::drawLabel(StelPainter& sPainter, float maxMagLabel)
 			str = QString("IC %1").arg(IC_nb);		
 	}
 
-	sPainter.drawText(XY[0]+shift, XY[1]+shift, str, 0, 0, 0, false);
+	GETSTELMODULE(LabelMgr)->addSkyLabel(sPainter, XY[0]+shift, XY[1]+shift, str, 0, 0, mag);
 }
 
 
@@ -24,8 +24,10 @@
 #include "StelObject.hpp"
 #include "StelTranslator.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelStringPool.hpp"
 
 #include <QString>
+#include <QVector>
 
 class StelPainter;
 class QDataStream;
@@ -58,7 +60,7 @@ public:
 	virtual float getSelectPriority(const StelCore* core) const;
 	virtual Vec3f getInfoColor() const;
 	virtual QString getNameI18n() const {return nameI18;}
-	virtual QString getEnglishName() const {return englishName;}
+	virtual QString getEnglishName() const {return englishName.toString();}
 	virtual double getAngularSize(const StelCore*) const {return angularSize*0.5;}
 	virtual SphericalRegionP getRegion() const {return pointRegion;}
 
@@ -91,19 +93,31 @@ private:
 	};
 
 	//! Translate nebula name using the passed translator
-	void translateName(const StelTranslator& trans) {nameI18 = trans.qtranslate(englishName);}
+	void translateName(const StelTranslator& trans) {nameI18 = trans.qtranslate(englishName.toString());}
 
 	bool readNGC(char *record);
 	void readNGC(QDataStream& in);
 			
+	//! The hints of the nebulae, drawn together by drawHintBatch() with the sprite atlas.
+	struct HintBatch
+	{
+		QVector<Vec2f> vertices;
+		QVector<Vec2f> texCoords;
+	};
+	//! The number of hint sprites.
+	static const int NbHintSprites = 7;
+
 	void drawLabel(StelPainter& sPainter, float maxMagLabel);
-	void drawHints(StelPainter& sPainter, float maxMagHints);
+	//! Add the hint of the nebula to the batch, if it is bright enough.
+	void drawHints(StelPainter& sPainter, float maxMagHints, HintBatch& batch);
+	//! Draw the hints added to the batch in one call, and clear the batch.
+	static void drawHintBatch(StelPainter& sPainter, HintBatch& batch);
 
 	unsigned int M_nb;              // Messier Catalog number
 	unsigned int NGC_nb;            // New General Catalog number
 	unsigned int IC_nb;             // Index Catalog number
 	unsigned int C_nb;              // Caldwell Catalog number
-	QString englishName;            // English name
+	StelInternedString englishName; // English name, in the shared string pool
 	QString nameI18;                // Nebula name
 	float mag;                      // Apparent magnitude
 	float angularSize;              // Angular size in degree
@@ -113,13 +127,8 @@ private:
 
 	SphericalRegionP pointRegion;
 
-	static StelTextureSP texCircle;   // The symbolic circle texture
-	static StelTextureSP texGalaxy;
-	static StelTextureSP texOpenCluster;
-	static StelTextureSP texGlobularCluster;
-	static StelTextureSP texPlanetaryNebula;
-	static StelTextureSP texDiffuseNebula;
-	static StelTextureSP texOpenClusterWithNebulosity;
+	//! The ids of the hint images in the sprite atlas, in the order of drawHints().
+	static int hintSprites[NbHintSprites];
 	static float hintsBrightness;
 
 	static Vec3f labelColor, circleColor;
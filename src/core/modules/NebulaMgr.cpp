@@ -66,13 +66,6 @@ NebulaMgr::NebulaMgr(void)
 
 NebulaMgr::~NebulaMgr()
 {
-	Nebula::texCircle = StelTextureSP();
-	Nebula::texGalaxy = StelTextureSP();
-	Nebula::texOpenCluster = StelTextureSP();
-	Nebula::texGlobularCluster = StelTextureSP();
-	Nebula::texPlanetaryNebula = StelTextureSP();
-	Nebula::texDiffuseNebula = StelTextureSP();
-	Nebula::texOpenClusterWithNebulosity = StelTextureSP();
 }
 
 /*************************************************************************
@@ -86,7 +79,7 @@ double NebulaMgr::getCallOrder(StelModuleActionName actionName) const
 }
 
 // read from stream
-void NebulaMgr::init()
+void NebulaMgr::preload()
 {
 	// TODO: mechanism to specify which sets get loaded at start time.
 	// candidate methods:
@@ -96,18 +89,24 @@ void NebulaMgr::init()
 	// 4. info.ini file in each set containing a "load at startup" item
 	// For now (0.9.0), just load the default set
 	loadNebulaSet("default");
+}
 
+void NebulaMgr::init()
+{
 	QSettings* conf = StelApp::getInstance().getSettings();
 	Q_ASSERT(conf);
 
 	nebulaFont.setPixelSize(StelApp::getInstance().getSettings()->value("gui/base_font_size", 13).toInt());
-	Nebula::texCircle			= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb.png");		// Load circle texture
-	Nebula::texGalaxy			= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb_gal.png");	// Load ellipse texture
-	Nebula::texOpenCluster			= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb_ocl.png");	// Load open cluster marker texture
-	Nebula::texGlobularCluster		= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb_gcl.png");	// Load globular cluster marker texture
-	Nebula::texPlanetaryNebula		= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb_pnb.png");	// Load planetary nebula marker texture
-	Nebula::texDiffuseNebula		= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb_dif.png");	// Load diffuse nebula marker texture
-	Nebula::texOpenClusterWithNebulosity	= StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/neb_ocln.png");	// Load Ocl/Nebula marker texture
+	// The hints are sprites of the shared atlas, so that they are all drawn at once
+	StelTextureMgr& texMgr = StelApp::getInstance().getTextureManager();
+	const QString texDir = StelFileMgr::getInstallationDir()+"/textures/";
+	Nebula::hintSprites[0] = texMgr.addSprite(texDir+"neb_gal.png");	// Galaxy ellipse
+	Nebula::hintSprites[1] = texMgr.addSprite(texDir+"neb_ocl.png");	// Open cluster marker
+	Nebula::hintSprites[2] = texMgr.addSprite(texDir+"neb_gcl.png");	// Globular cluster marker
+	Nebula::hintSprites[3] = texMgr.addSprite(texDir+"neb_dif.png");	// Diffuse nebula marker
+	Nebula::hintSprites[4] = texMgr.addSprite(texDir+"neb_pnb.png");	// Planetary nebula marker
+	Nebula::hintSprites[5] = texMgr.addSprite(texDir+"neb_ocln.png");	// Ocl/Nebula marker
+	Nebula::hintSprites[6] = texMgr.addSprite(texDir+"neb.png");		// Circle
 	texPointer = StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/pointeur5.png");   // Load pointer texture
 
 	setFlagShow(conf->value("astro/flag_nebula",true).toBool());
@@ -128,9 +127,11 @@ void NebulaMgr::init()
 
 struct DrawNebulaFuncObject
 {
-	DrawNebulaFuncObject(float amaxMagHints, float amaxMagLabels, StelPainter* p, StelCore* aCore, bool acheckMaxMagHints) : maxMagHints(amaxMagHints), maxMagLabels(amaxMagLabels), sPainter(p), core(aCore), checkMaxMagHints(acheckMaxMagHints)
+	DrawNebulaFuncObject(float amaxMagHints, float amaxMagLabels, StelPainter* p, StelCore* aCore, bool acheckMaxMagHints, Nebula::HintBatch& ahintBatch) : maxMagHints(amaxMagHints), maxMagLabels(amaxMagLabels), sPainter(p), core(aCore), checkMaxMagHints(acheckMaxMagHints), hintBatch(ahintBatch)
 	{
 		angularSizeLimit = 5.f/sPainter->getProjector()->getPixelPerRadAtCenter()*180.f/M_PI;
+		visibleSky = core->getVisibleSkyArea();
+		visibleSkyAltitude = std::asin(qBound(-1., visibleSky.d, 1.));
 	}
 	void operator()(StelRegionObject* obj)
 	{
@@ -138,13 +139,16 @@ struct DrawNebulaFuncObject
 		StelSkyDrawer *drawer = core->getSkyDrawer();
 		// filter out DSOs which are too dim to be seen (e.g. for bino observers)
 		if ((drawer->getFlagNebulaMagnitudeLimit()) && (n->mag > drawer->getCustomNebulaMagnitudeLimit())) return;
+		// filter out DSOs hidden by the landscape, keeping the large ones which cross the horizon
+		if (visibleSky.d>-1. && !visibleSky.contains(n->XYZ)
+			&& std::asin(qBound(-1., n->XYZ*visibleSky.n, 1.))+n->angularSize*M_PI/180.<visibleSkyAltitude) return;
 
 		if (n->angularSize>angularSizeLimit || (checkMaxMagHints && n->mag <= maxMagHints))
 		{
 			float refmag_add=0; // value to adjust hints visibility threshold.
 			sPainter->getProjector()->project(n->XYZ,n->XY);
 			n->drawLabel(*sPainter, maxMagLabels-refmag_add);
-			n->drawHints(*sPainter, maxMagHints -refmag_add);
+			n->drawHints(*sPainter, maxMagHints -refmag_add, hintBatch);
 		}
 	}
 	float maxMagHints;
@@ -153,6 +157,9 @@ struct DrawNebulaFuncObject
 	StelCore* core;
 	float angularSizeLimit;
 	bool checkMaxMagHints;
+	Nebula::HintBatch& hintBatch;
+	SphericalCap visibleSky;
+	double visibleSkyAltitude;
 };
 
 float NebulaMgr::computeMaxMagHint(const StelSkyDrawer* skyDrawer) const
@@ -182,8 +189,10 @@ void NebulaMgr::draw(StelCore* core)
 	float maxMagHints  = computeMaxMagHint(skyDrawer);
 	float maxMagLabels = skyDrawer->getLimitMagnitude()     -2.f+(labelsAmount*1.2f)-2.f;
 	sPainter.setFont(nebulaFont);
-	DrawNebulaFuncObject func(maxMagHints, maxMagLabels, &sPainter, core, hintsFader.getInterstate()>0.0001);
+	DrawNebulaFuncObject func(maxMagHints, maxMagLabels, &sPainter, core, hintsFader.getInterstate()>0.0001, hintBatch);
 	nebGrid.processIntersectingPointInRegions(p.data(), func);
+	// The hints are drawn after the traversal so that the labels are not flushed for each of them
+	Nebula::drawHintBatch(sPainter, hintBatch);
 
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer())
 		drawPointer(core, sPainter);
@@ -266,6 +275,8 @@ void NebulaMgr::loadNebulaSet(const QString& setName)
 		return;
 	}
 	loadNGC(ngcPath);
+	// The catalog is not modified anymore, use the flat layout of the index
+	nebGrid.freeze();
 	loadNGCNames(ngcNamesPath);
 }
 
@@ -300,16 +311,10 @@ QList<StelObjectP> NebulaMgr::searchAround(const Vec3d& av, double limitFov, con
 
 	Vec3d v(av);
 	v.normalize();
-	double cosLimFov = cos(limitFov * M_PI/180.);
-	Vec3d equPos;
-	foreach (const NebulaP& n, nebArray)
+	const SphericalCap cap(v, cos(limitFov * M_PI/180.));
+	foreach (const StelRegionObjectP& obj, nebGrid.getPointsInRegion(&cap))
 	{
-		equPos = n->XYZ;
-		equPos.normalize();
-		if (equPos*v>=cosLimFov)
-		{
-			result.push_back(qSharedPointerCast<StelObject>(n));
-		}
+		result.push_back(qSharedPointerCast<StelObject>(obj));
 	}
 	return result;
 }
@@ -471,11 +476,11 @@ bool NebulaMgr::loadNGCNames(const QString& catNGCNames)
 			if (name.left(2).toUpper() != "M " && name.left(2).toUpper() != "C ")
 			{
 				if (transRx.exactMatch(name)) {
-					e->englishName = transRx.capturedTexts().at(1).trimmed();
+					e->englishName = StelInternedString(transRx.capturedTexts().at(1).trimmed());
 				}
 				 else 
 				{
-					e->englishName = name;
+					e->englishName = StelInternedString(name);
 				}
 			}
 			else if (name.left(2).toUpper() != "M " && name.left(2).toUpper() == "C ")
@@ -494,7 +499,7 @@ bool NebulaMgr::loadNGCNames(const QString& catNGCNames)
 				}
 
 				e->C_nb=(unsigned int)(num);
-				e->englishName = QString("C%1").arg(num);
+				e->englishName = StelInternedString(QString("C%1").arg(num));
 			}
 			else if (name.left(2).toUpper() == "M " && name.left(2).toUpper() != "C ")
 			{
@@ -512,7 +517,7 @@ bool NebulaMgr::loadNGCNames(const QString& catNGCNames)
 				}
 
 				e->M_nb=(unsigned int)(num);
-				e->englishName = QString("M%1").arg(num);
+				e->englishName = StelInternedString(QString("M%1").arg(num));
 			}
 
 
@@ -530,9 +535,19 @@ bool NebulaMgr::loadNGCNames(const QString& catNGCNames)
 
 void NebulaMgr::updateI18n()
 {
+	// The searches of names read them
+	QWriteLocker locker(getNameSearchLock());
 	const StelTranslator& trans = StelApp::getInstance().getLocaleMgr().getSkyTranslator();
 	foreach (NebulaP n, nebArray)
 		n->translateName(trans);
+
+	namesIndexI18n.clear();
+	namesIndex.clear();
+	for (int i=0;i<nebArray.size();++i)
+	{
+		namesIndexI18n.insert(nebArray.at(i)->nameI18, i);
+		namesIndex.insert(nebArray.at(i)->englishName.toString(), i);
+	}
 }
 
 
@@ -613,7 +628,9 @@ StelObjectP NebulaMgr::searchByName(const QString& name) const
 	// Search by common names
 	foreach (const NebulaP& n, nebArray)
 	{
-		QString objwcap = n->englishName.toUpper();
+		if (n->englishName.isEmpty())
+			continue;
+		QString objwcap = n->englishName.toString().toUpper();
 		if (objwcap==objw)
 			return qSharedPointerCast<StelObject>(n);
 	}
@@ -736,27 +753,9 @@ QStringList NebulaMgr::listMatchingObjectsI18n(const QString& objPrefix, int max
 		}
 	}
 
-	QString dson;
-	bool find;
 	// Search by common names
-	foreach (const NebulaP& n, nebArray)
-	{
-		dson = n->nameI18;
-		find = false;
-		if (useStartOfWords)
-		{
-			if (dson.mid(0, objw.size()).toUpper()==objw)
-				find = true;
-
-		}
-		else
-		{
-			if (dson.contains(objPrefix, Qt::CaseInsensitive))
-				find = true;
-		}
-		if (find)
-			result << dson;
-	}
+	foreach (int i, namesIndexI18n.find(objw, -1, useStartOfWords))
+		result << nebArray.at(i)->nameI18;
 
 	result.sort();
 	if (maxNbItem > 0)
@@ -850,27 +849,9 @@ QStringList NebulaMgr::listMatchingObjects(const QString& objPrefix, int maxNbIt
 		}
 	}
 
-	QString dson;
-	bool find;
 	// Search by common names
-	foreach (const NebulaP& n, nebArray)
-	{
-		dson = n->englishName;
-		find = false;
-		if (useStartOfWords)
-		{
-			if (dson.mid(0, objw.size()).toUpper()==objw)
-				find = true;
-
-		}
-		else
-		{
-			if (dson.contains(objPrefix, Qt::CaseInsensitive))
-				find = true;
-		}
-		if (find)
-			result << dson;
-	}
+	foreach (int i, namesIndex.find(objw, -1, useStartOfWords))
+		result << nebArray.at(i)->englishName.toString();
 
 	result.sort();
 	if (maxNbItem > 0)
@@ -24,14 +24,15 @@
 #include "StelObjectType.hpp"
 #include "StelFader.hpp"
 #include "StelSphericalIndex.hpp"
+#include "StelNameIndex.hpp"
 #include "StelObjectModule.hpp"
 #include "StelTextureTypes.hpp"
+#include "Nebula.hpp"
 
 #include <QString>
 #include <QStringList>
 #include <QFont>
 
-class Nebula;
 class StelTranslator;
 class StelToneReproducer;
 class QSettings;
@@ -57,6 +58,9 @@ public:
 
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in the StelModule class
+	//! Load the default set of nebulae catalogs.
+	virtual void preload();
+
 	//! Initialize the NebulaMgr object.
 	//!  - Load the font into the Nebula class, which is used to draw Nebula labels.
 	//!  - Load the texture used to draw nebula locations into the Nebula class (for
@@ -108,6 +112,9 @@ public:
 	// empty for now
 	virtual QStringList listAllObjects(bool inEnglish) const { Q_UNUSED(inEnglish) return QStringList(); }
 	virtual QString getName() const { return "Nebulae"; }
+	virtual bool hasThreadSafeNameSearch() const {return true;}
+	//! Build the indexes of the names, so that the searches in the thread pool only read them.
+	virtual void prepareNameSearch(bool useStartOfWords);
 
 	//! Compute the maximum magntiude for which hints will be displayed.
 	float computeMaxMagHint(const class StelSkyDrawer* skyDrawer) const;
@@ -216,6 +223,13 @@ private:
 	//! The internal grid for fast positional lookup
 	StelSphericalIndex nebGrid;
 
+	//! The hints of the nebulae being drawn, kept to reuse their memory
+	Nebula::HintBatch hintBatch;
+
+	//! Indexes of the common names, the values are the positions in nebArray.
+	StelNameIndex namesIndexI18n;
+	StelNameIndex namesIndex;
+
 	//! The amount of hints (between 0 and 10)
 	float hintsAmount;
 	//! The amount of labels (between 0 and 10)
@@ -248,6 +248,10 @@ void CometOrbit::positionAtTimevInVSOP87Coordinates(double JD, double *v, bool u
       InitHyp(q,n,e,JD,rCosNu,rSinNu);
   }
   else InitPar(q,n,JD,rCosNu,rSinNu);
+  setPosition(rCosNu, rSinNu, v, updateVelocityVector);
+}
+
+void CometOrbit::setPosition(double rCosNu, double rSinNu, double *v, bool updateVelocityVector) {
   double p0,p1,p2, s0, s1, s2;
   Init3D(i,Om,w,rCosNu,rSinNu,p0,p1,p2, s0, s1, s2, updateVelocityVector, e, q);
   // GZ: The next 3 lines are meaningless for a comet orbiting the sun. Or not?
@@ -264,6 +268,62 @@ void CometOrbit::positionAtTimevInVSOP87Coordinates(double JD, double *v, bool u
   }
 }
 
+void CometOrbit::positionsAtTimesInVSOP87Coordinates(CometOrbit* const* orbits, const double* JD, int count, Vec3d* positions) {
+  // Number of orbits solved together, small enough to keep the arrays in the L1 cache
+  static const int chunkSize = 64;
+  // The Laguerre-Conway iteration converges cubically, this is enough for nearly all the orbits
+  static const int nbIterations = 6;
+  double M[chunkSize], ecc[chunkSize], E[chunkSize], dE[chunkSize];
+  int index[chunkSize];
+
+  for (int first=0; first<count; first+=chunkSize) {
+    // Gather the elliptical orbits, the others are solved directly
+    int nbEll = 0;
+    const int last = qMin(first+chunkSize, count);
+    for (int k=first; k<last; ++k) {
+      CometOrbit* orb = orbits[k];
+      if (orb->e < 1.0) {
+        double m = fmod(orb->n*(JD[k]-orb->t0), 2*M_PI);
+        if (m < 0.0) m += 2.0*M_PI;
+        M[nbEll] = m;
+        ecc[nbEll] = orb->e;
+        index[nbEll] = k;
+        ++nbEll;
+      }
+      else
+        orb->positionAtTimevInVSOP87Coordinates(JD[k], positions[k]);
+    }
+
+    // Same initial guess as InitEll()
+    for (int j=0; j<nbEll; ++j)
+      E[j] = M[j] + (M[j] < M_PI ? 0.85 : -0.85)*ecc[j];
+    for (int it=0; it<nbIterations; ++it) {
+      for (int j=0; j<nbEll; ++j) {
+        const double f2 = ecc[j]*sin(E[j]);
+        const double f = E[j]-f2-M[j];
+        // f1 is always positive for elliptical orbits
+        const double f1 = 1.0-ecc[j]*cos(E[j]);
+        dE[j] = (-5.0*f)/(f1+sqrt(fabs(16.0*f1*f1-20.0*f*f2)));
+        E[j] += dE[j];
+      }
+    }
+
+    for (int j=0; j<nbEll; ++j) {
+      const int k = index[j];
+      CometOrbit* orb = orbits[k];
+      if (fabs(dE[j]) >= EPSILON) {
+        // Not converged yet, finish with the usual iterations
+        orb->positionAtTimevInVSOP87Coordinates(JD[k], positions[k]);
+        continue;
+      }
+      const double e = ecc[j];
+      const double a = orb->q/(1.0-e);
+      const double h1 = orb->q*sqrt((1.0+e)/(1.0-e));
+      orb->setPosition(a*(cos(E[j])-e), h1*sin(E[j]), positions[k], true);
+    }
+  }
+}
+
 
 
 EllipticalOrbit::EllipticalOrbit(double pericenterDistance,
@@ -99,7 +99,22 @@ public:
   void setUpdateTails(const bool update){updateTails=update;}
   Vec3d getVelocity() const {return rdot;} //! return speed value [AU/d] last computed by positionAtTimevInVSOP87Coordinates(JD, v, true)
   bool objectDateValid(const double JD) const {return (fabs(t0-JD)<orbitGood);}
+  //! Return the smallest distance to the focus [AU].
+  double getPericenterDistance() const {return q;}
+  //! Return the largest distance to the focus [AU], a huge value for the open orbits.
+  double getApocenterDistance() const {return e<1.0 ? q*(1.0+e)/(1.0-e) : 1e100;}
+  //! Compute the positions of several orbits at the given dates, like positionAtTimevInVSOP87Coordinates()
+  //! with updateVelocityVector=true. Kepler's equation of the elliptical orbits is solved on small arrays
+  //! of orbits with a fixed number of Laguerre-Conway iterations and no data dependent branch, so that the
+  //! compiler can vectorize the loops. The orbits which did not converge, and the parabolic and hyperbolic
+  //! orbits, are solved with the usual iterations.
+  //! @param orbits the orbits to compute.
+  //! @param JD the date for each orbit.
+  //! @param positions receives the position of each orbit.
+  static void positionsAtTimesInVSOP87Coordinates(CometOrbit* const* orbits, const double* JD, int count, Vec3d* positions);
 private:
+  //! Compute the position (and velocity) from the true anomaly components relative to the perihel.
+  void setPosition(double rCosNu, double rSinNu, double* v, bool updateVelocityVector);
   const double q;  //! perihel distance
   const double e;  //! eccentricity
   const double i;  //! inclination
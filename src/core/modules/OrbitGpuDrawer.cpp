@@ -0,0 +1,193 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "OrbitGpuDrawer.hpp"
+#include "Planet.hpp"
+#include "StelCore.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QDebug>
+
+// Number of vertices of each slot, the last one closing the orbit.
+static const int SlotSize = ORBIT_SEGMENTS+1;
+
+OrbitGpuDrawer::OrbitGpuDrawer()
+	: vertexBuffer(NULL)
+	, nbAllocatedSlots(0)
+	, currentProgram(NULL)
+	, vertexLoc(-1)
+	, midPosLoc(-1)
+	, parentPosLoc(-1)
+	, colorLoc(-1)
+{
+}
+
+OrbitGpuDrawer::~OrbitGpuDrawer()
+{
+	clear();
+}
+
+void OrbitGpuDrawer::clear()
+{
+	slots.clear();
+	vertices.clear();
+	nbAllocatedSlots = 0;
+	if (vertexBuffer)
+	{
+		vertexBuffer->destroy();
+		delete vertexBuffer;
+		vertexBuffer = NULL;
+	}
+}
+
+QOpenGLShaderProgram* OrbitGpuDrawer::getProgram(const QByteArray& forwardTransform)
+{
+	static const char* vertexHeader =
+		"attribute highp vec4 vertex;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"uniform highp vec3 midPos;\n"
+		"uniform highp vec3 parentPos;\n"
+		"varying mediump float valid;\n";
+	static const char* vertexMain =
+		"void main(void)\n"
+		"{\n"
+		"    highp vec3 v = vertex.w > 0.5 ? midPos : parentPos+vertex.xyz;\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(v, 1.)).xyz);\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    valid = win.z < 0.5 ? 0. : 1.;\n"
+		"}\n";
+
+	// The segments with a point which can't be projected are discarded, like in Planet::drawOrbit().
+	static const char* fsrc =
+		"varying mediump float valid;\n"
+		"uniform mediump vec4 color;\n"
+		"void main(void)\n"
+		"{\n"
+		"    if (valid < 0.999)\n"
+		"        discard;\n"
+		"    gl_FragColor = color;\n"
+		"}\n";
+
+	return StelPainter::getProjectionProgram("orbitGpuShader", forwardTransform, vertexHeader, vertexMain, fsrc);
+}
+
+void OrbitGpuDrawer::reserveSlots(int nbSlots)
+{
+	if (nbSlots<=nbAllocatedSlots && vertexBuffer)
+		return;
+	nbAllocatedSlots = qMax(qMax(nbSlots, 2*nbAllocatedSlots), 16);
+	vertices.resize(nbAllocatedSlots*SlotSize);
+	if (!vertexBuffer)
+	{
+		vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		vertexBuffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
+		vertexBuffer->create();
+	}
+	vertexBuffer->bind();
+	vertexBuffer->allocate(vertices.constData(), vertices.size()*sizeof(Vec4f));
+	currentProgram->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 4);
+}
+
+bool OrbitGpuDrawer::begin(StelCore* core)
+{
+	Q_ASSERT(currentProgram==NULL);
+	const StelProjectorP prj = core->getProjection(StelCore::FrameHeliocentricEcliptic);
+	const QByteArray forwardTransform = prj->getForwardTransformShader();
+	if (forwardTransform.isEmpty())
+		return false;
+	currentProgram = getProgram(forwardTransform);
+	if (!currentProgram)
+		return false;
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+	const Mat4f& m = prj->getProjectionMatrix();
+	// Refraction, if any, is ignored here as in StarGpuDrawer.
+	const Mat4d mv = prj->getModelViewTransform()->getApproximateLinearTransfo();
+	StelPainter::flushPendingText();
+	currentProgram->bind();
+	currentProgram->setUniformValue("projectionMatrix", StelPainter::toQMatrix(m));
+	currentProgram->setUniformValue("modelViewMatrix", StelPainter::toQMatrix(mv));
+	currentProgram->setUniformValue("screenCenter", screenCenter[0], screenCenter[1]);
+	currentProgram->setUniformValue("screenScale", screenScale[0], screenScale[1]);
+	vertexLoc = currentProgram->attributeLocation("vertex");
+	midPosLoc = currentProgram->uniformLocation("midPos");
+	parentPosLoc = currentProgram->uniformLocation("parentPos");
+	colorLoc = currentProgram->uniformLocation("color");
+
+	reserveSlots(slots.size());
+	vertexBuffer->bind();
+	currentProgram->enableAttributeArray(vertexLoc);
+	currentProgram->setAttributeBuffer(vertexLoc, GL_FLOAT, 0, 4);
+
+	// Normal transparency mode
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_BLEND);
+	return true;
+}
+
+void OrbitGpuDrawer::drawOrbit(const Planet* planet)
+{
+	Q_ASSERT(currentProgram);
+	QHash<const Planet*, Slot>::iterator it = slots.find(planet);
+	if (it==slots.end())
+	{
+		reserveSlots(slots.size()+1);
+		Slot slot;
+		slot.first = slots.size()*SlotSize;
+		// Make sure that the new slot is uploaded below
+		slot.lastOrbitJD = planet->lastOrbitJD-1.;
+		slot.orbitCached = !planet->orbitCached;
+		it = slots.insert(planet, slot);
+	}
+	Slot& slot = it.value();
+	if (slot.lastOrbitJD!=planet->lastOrbitJD || slot.orbitCached!=planet->orbitCached)
+	{
+		Vec4f* v = vertices.data()+slot.first;
+		for (int n=0;n<ORBIT_SEGMENTS;++n)
+			v[n].set(planet->orbitP[n][0], planet->orbitP[n][1], planet->orbitP[n][2], 0.f);
+		v[ORBIT_SEGMENTS/2][3] = 1.f;
+		v[ORBIT_SEGMENTS] = v[0];
+		vertexBuffer->write(slot.first*sizeof(Vec4f), v, SlotSize*sizeof(Vec4f));
+		slot.lastOrbitJD = planet->lastOrbitJD;
+		slot.orbitCached = planet->orbitCached;
+	}
+
+	const Vec3d pos = planet->getHeliocentricEclipticPos();
+	const Vec3d parentPos = planet->getHeliocentricPos(Vec3d(0.));
+	currentProgram->setUniformValue(midPosLoc, (GLfloat)pos[0], (GLfloat)pos[1], (GLfloat)pos[2]);
+	currentProgram->setUniformValue(parentPosLoc, (GLfloat)parentPos[0], (GLfloat)parentPos[1], (GLfloat)parentPos[2]);
+	currentProgram->setUniformValue(colorLoc, Planet::orbitColor[0], Planet::orbitColor[1], Planet::orbitColor[2], planet->orbitFader.getInterstate());
+	glDrawArrays(GL_LINE_STRIP, slot.first, planet->closeOrbit ? SlotSize : SlotSize-1);
+}
+
+void OrbitGpuDrawer::end()
+{
+	Q_ASSERT(currentProgram);
+	currentProgram->disableAttributeArray(vertexLoc);
+	currentProgram->release();
+	vertexBuffer->release();
+	currentProgram = NULL;
+}
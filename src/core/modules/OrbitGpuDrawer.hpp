@@ -0,0 +1,91 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _ORBITGPUDRAWER_HPP_
+#define _ORBITGPUDRAWER_HPP_
+
+#include "VecMath.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+class StelCore;
+class Planet;
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
+
+//! @class OrbitGpuDrawer
+//! Draw the orbits of the solar system bodies from one GPU buffer shared by all the bodies.
+//! Each body has a slot of the buffer holding its orbit polyline, which is uploaded again only
+//! when the body recomputes its orbit. The points are stored relative to the parent of the body,
+//! so that the orbits of the moons follow their planet without being uploaded again. The projection is done in the vertex shader, so that
+//! drawing an orbit only costs a few uniforms and one glDrawArrays call.
+//! The middle vertex of the orbit is replaced in the shader by the current position of the body,
+//! like in Planet::drawOrbit(), so that the orbit always goes through the body.
+//! Only the projections providing a StelProjector::getForwardTransformShader() are supported,
+//! and refraction is not applied to the orbits drawn this way.
+class OrbitGpuDrawer
+{
+public:
+	OrbitGpuDrawer();
+	~OrbitGpuDrawer();
+
+	//! Prepare the drawing of orbits in the heliocentric ecliptic frame.
+	//! @return false if the current projection cannot be performed on the GPU,
+	//! in which case Planet::drawOrbit() has to be used.
+	bool begin(StelCore* core);
+
+	//! Draw the orbit of a body, uploading it first if it changed since the last call.
+	void drawOrbit(const Planet* planet);
+
+	//! Finish drawing and restore the GL state.
+	void end();
+
+	//! Forget all the bodies, to be called when they are deleted.
+	void clear();
+
+private:
+	//! Get or build the shader program for the given forward transform code.
+	QOpenGLShaderProgram* getProgram(const QByteArray& forwardTransform);
+	//! Grow the buffer so that it can hold nbSlots orbits, keeping the uploaded ones.
+	void reserveSlots(int nbSlots);
+
+	//! The position of the slot of a body in the buffer, and the state of the orbit which was uploaded.
+	struct Slot
+	{
+		int first;
+		double lastOrbitJD;
+		bool orbitCached;
+	};
+
+	QHash<const Planet*, Slot> slots;
+	//! Copy of the buffer: the orbit points relative to the parent in xyz, with w set to 1 for the middle vertex.
+	QVector<Vec4f> vertices;
+	QOpenGLBuffer* vertexBuffer;
+	int nbAllocatedSlots;
+
+	QOpenGLShaderProgram* currentProgram;
+	int vertexLoc;
+	int midPosLoc;
+	int parentPosLoc;
+	int colorLoc;
+};
+
+#endif // _ORBITGPUDRAWER_HPP_
@@ -24,6 +24,7 @@
 #include "StelSkyDrawer.hpp"
 #include "SolarSystem.hpp"
 #include "Planet.hpp"
+#include "EphemerisCache.hpp"
 
 #include "StelProjector.hpp"
 #include "sidereal_time.h"
@@ -32,19 +33,31 @@
 #include "StarMgr.hpp"
 #include "StelMovementMgr.hpp"
 #include "StelPainter.hpp"
+#include "LabelMgr.hpp"
 #include "StelTranslator.hpp"
+#include "StelLocaleMgr.hpp"
 #include "StelUtils.hpp"
 #include "StelOpenGL.hpp"
 
 #include <iomanip>
+#include <cfloat>
 #include <QTextStream>
 #include <QString>
 #include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QCoreApplication>
+#include <QThread>
 #include <QVarLengthArray>
 #include <QOpenGLContext>
+#include <QOpenGLBuffer>
 #include <QOpenGLShader>
 
 Vec3f Planet::labelColor = Vec3f(0.4,0.4,0.8);
+int Planet::translationGeneration = 0;
+int Planet::photometryGeneration = 0;
 Vec3f Planet::orbitColor = Vec3f(1,0.6,1);
 StelTextureSP Planet::hintCircleTex;
 StelTextureSP Planet::texEarthShadow;
@@ -79,6 +92,10 @@ Planet::Planet(const QString& englishName,
 	  color(color),
 	  albedo(albedo),
 	  axisRotation(0.),
+	  shadowCandidatesJD(-1e10),
+	  mapTilesSearched(false),
+	  mapTileLevels(0),
+	  mapTileSize(0),
 	  rings(NULL),
 	  sphereScale(1.f),
 	  lastJD(J2000),
@@ -89,7 +106,7 @@ Planet::Planet(const QString& englishName,
 	  hidden(hidden),
 	  atmosphere(hasAtmosphere),
 	  halo(hasHalo),
-	  pType(pType)
+	  pType(StelInternedString(pType))
 {
 	texMapName = atexMapName;
 	normalMapName = anormalMapName;
@@ -101,11 +118,20 @@ Planet::Planet(const QString& englishName,
 	distance = 0;
 
 	eclipticPos=Vec3d(0.,0.,0.);
+	for (int i=0; i<NbCachedPositions; ++i)
+		cachedPositionJD[i] = -1e10;
+	nextCachedPosition = 0;
+	skipPositionUpdate = false;
 	rotLocalToParent = Mat4d::identity();
 	texMap = StelApp::getInstance().getTextureManager().createTextureThread(StelFileMgr::getInstallationDir()+"/textures/"+texMapName, StelTexture::StelTextureParams(true, GL_LINEAR, GL_REPEAT));
 	normalMap = StelApp::getInstance().getTextureManager().createTextureThread(StelFileMgr::getInstallationDir()+"/textures/"+normalMapName, StelTexture::StelTextureParams(true, GL_LINEAR, GL_REPEAT));
 
 	nameI18 = englishName;
+	nameI18Generation = -1;
+	cachedVMagnitude = 0.f;
+	vMagnitudeGeneration = -1;
+	cachedAngularSize = 0.;
+	angularSizeGeneration = -1;
 	if (englishName!="Pluto")
 	{
 		deltaJD = 0.001*StelCore::JD_SECOND;
@@ -119,9 +145,22 @@ Planet::~Planet()
 		delete rings;
 }
 
-void Planet::translateName(const StelTranslator& trans)
+void Planet::translateName(const StelTranslator& trans) const
 {
-	nameI18 = trans.qtranslate(englishName);
+	nameI18 = getTranslatedName(trans);
+	nameI18Generation = translationGeneration;
+}
+
+QString Planet::getTranslatedName(const StelTranslator& trans) const
+{
+	return trans.qtranslate(englishName);
+}
+
+QString Planet::getNameI18n() const
+{
+	if (nameI18Generation!=translationGeneration)
+		translateName(StelApp::getInstance().getLocaleMgr().getAppStelTranslator());
+	return nameI18;
 }
 
 // Return the information string "ready to print" :)
@@ -142,8 +181,8 @@ QString Planet::getInfoString(const StelCore* core, const InfoStringGroup& flags
 
 	if (flags&ObjectType)
 	{
-		if (pType.length()>0)
-			oss << q_("Type: <b>%1</b>").arg(q_(pType)) << "<br />";
+		if (!pType.isEmpty())
+			oss << q_("Type: <b>%1</b>").arg(q_(pType.toString())) << "<br />";
 	}
 
 	if (flags&Magnitude)
@@ -242,7 +281,7 @@ QString Planet::getSkyLabel(const StelCore*) const
 	QString str;
 	QTextStream oss(&str);
 	oss.setRealNumberPrecision(2);
-	oss << nameI18;
+	oss << getNameI18n();
 
 	if (sphereScale != 1.f)
 	{
@@ -316,11 +355,44 @@ void Planet::computePositionWithoutOrbits(const double date)
 {
 	if (fabs(lastJD-date)>deltaJD)
 	{
-		coordFunc(date, eclipticPos, userDataPtr);
+		computeEclipticPos(date);
 		lastJD = date;
 	}
 }
 
+void Planet::computeEclipticPos(const double date)
+{
+	for (int i=0; i<NbCachedPositions; ++i)
+	{
+		if (fabs(cachedPositionJD[i]-date)<=deltaJD)
+		{
+			eclipticPos = cachedPosition[i];
+			return;
+		}
+	}
+	coordFunc(date, eclipticPos, userDataPtr);
+	cachePosition(date, eclipticPos);
+}
+
+void Planet::cachePosition(const double date, const Vec3d& pos)
+{
+	cachedPositionJD[nextCachedPosition] = date;
+	cachedPosition[nextCachedPosition] = pos;
+	nextCachedPosition = (nextCachedPosition+1)%NbCachedPositions;
+}
+
+bool Planet::hasCachedPosition(const double date) const
+{
+	if (fabs(lastJD-date)<=deltaJD)
+		return true;
+	for (int i=0; i<NbCachedPositions; ++i)
+	{
+		if (fabs(cachedPositionJD[i]-date)<=deltaJD)
+			return true;
+	}
+	return false;
+}
+
 double Planet::getRotObliquity(double JDay) const
 {
 	// JDay=2451545.0 for J2000.0
@@ -355,23 +427,52 @@ bool willCastShadow(const Planet* thisPlanet, const Planet* p)
 	return false;
 }
 
-QVector<const Planet*> Planet::getCandidatesForShadow() const
+const QVector<const Planet*>& Planet::getCandidatesForShadow() const
+{
+	if (shadowCandidatesJD!=lastJD)
+		updateShadowCandidates();
+	return shadowCandidates;
+}
+
+void Planet::updateShadowCandidates() const
 {
-	QVector<const Planet*> res;
+	shadowCandidatesJD = lastJD;
+	shadowCandidates.clear();
+	shadowCandidatesData = QMatrix4x4();
 	const SolarSystem *ssystem=GETSTELMODULE(SolarSystem);
 	const Planet* sun = ssystem->getSun().data();
 	if (this==sun || (parent.data()==sun && satellites.empty()))
-		return res;
+		return;
 	
 	foreach (const PlanetP& planet, satellites)
 	{
 		if (willCastShadow(this, planet.data()))
-			res.append(planet.data());
+			shadowCandidates.append(planet.data());
 	}
 	if (willCastShadow(this, parent.data()))
-		res.append(parent.data());
-	
-	return res;
+		shadowCandidates.append(parent.data());
+
+	// Our shader doesn't support more than 4 planets creating shadow
+	if (shadowCandidates.size()>4)
+	{
+		qDebug() << "Too many satellite shadows, some won't be displayed";
+		shadowCandidates.resize(4);
+	}
+	if (shadowCandidates.isEmpty())
+		return;
+
+	Mat4d modelMatrix;
+	computeModelMatrix(modelMatrix);
+	const Mat4d mTarget = modelMatrix.inverse();
+	for (int i=0;i<shadowCandidates.size();++i)
+	{
+		shadowCandidates.at(i)->computeModelMatrix(modelMatrix);
+		const Vec4d position = mTarget * modelMatrix.getColumn(3);
+		shadowCandidatesData(0, i) = position[0];
+		shadowCandidatesData(1, i) = position[1];
+		shadowCandidatesData(2, i) = position[2];
+		shadowCandidatesData(3, i) = shadowCandidates.at(i)->getRadius();
+	}
 }
 
 void Planet::computePosition(const double date)
@@ -409,6 +510,7 @@ void Planet::computePosition(const double date)
 					computeTransMatrix(calc_date);
 					if (osculatingFunc)
 					{
+						QMutexLocker lock(EphemerisCache::getSeriesMutex());
 						(*osculatingFunc)(date,calc_date,eclipticPos);
 					}
 					else
@@ -416,12 +518,10 @@ void Planet::computePosition(const double date)
 						coordFunc(calc_date, eclipticPos, userDataPtr);
 					}
 					orbitP[d] = eclipticPos;
-					orbit[d] = getHeliocentricEclipticPos();
 				}
 				else
 				{
 					orbitP[d] = orbitP[d+delta_points];
-					orbit[d] = getHeliocentricPos(orbitP[d]);
 				}
 			}
 
@@ -439,6 +539,7 @@ void Planet::computePosition(const double date)
 
 					computeTransMatrix(calc_date);
 					if (osculatingFunc) {
+						QMutexLocker lock(EphemerisCache::getSeriesMutex());
 						(*osculatingFunc)(date,calc_date,eclipticPos);
 					}
 					else
@@ -446,12 +547,10 @@ void Planet::computePosition(const double date)
 						coordFunc(calc_date, eclipticPos, userDataPtr);
 					}
 					orbitP[d] = eclipticPos;
-					orbit[d] = getHeliocentricEclipticPos();
 				}
 				else
 				{
 					orbitP[d] = orbitP[d+delta_points];
-					orbit[d] = getHeliocentricPos(orbitP[d]);
 				}
 			}
 
@@ -468,6 +567,7 @@ void Planet::computePosition(const double date)
 				computeTransMatrix(calc_date);
 				if (osculatingFunc)
 				{
+					QMutexLocker lock(EphemerisCache::getSeriesMutex());
 					(*osculatingFunc)(date,calc_date,eclipticPos);
 				}
 				else
@@ -475,7 +575,6 @@ void Planet::computePosition(const double date)
 					coordFunc(calc_date, eclipticPos, userDataPtr);
 				}
 				orbitP[d] = eclipticPos;
-				orbit[d] = getHeliocentricEclipticPos();
 			}
 
 			lastOrbitJD = date;
@@ -484,7 +583,9 @@ void Planet::computePosition(const double date)
 
 
 		// calculate actual Planet position
+		// It is computed again even if cached, as the orbit points left the state of a comet orbit at another date
 		coordFunc(date, eclipticPos, userDataPtr);
+		cachePosition(date, eclipticPos);
 
 		lastJD = date;
 
@@ -492,10 +593,7 @@ void Planet::computePosition(const double date)
 	else if (fabs(lastJD-date)>deltaJD)
 	{
 		// calculate actual Planet position
-		coordFunc(date, eclipticPos, userDataPtr);
-		// XXX: do we need to do that even when the orbit is not visible?
-		for( int d=0; d<ORBIT_SEGMENTS; d++ )
-			orbit[d]=getHeliocentricPos(orbitP[d]);
+		computeEclipticPos(date);
 		lastJD = date;
 	}
 
@@ -574,7 +672,7 @@ double Planet::getMeanSolarDay() const
 	if (englishName=="Venus" || englishName=="Uranus" || englishName=="Pluto")
 		sign = -1;
 
-	if (pType.contains("moon"))
+	if (pType.toString().contains("moon"))
 	{
 		// duration of mean solar day on moon are same as synodic month on this moon
 		double a = parent->getSiderealPeriod()/sday;
@@ -678,8 +776,20 @@ double Planet::getElongation(const Vec3d& obsPos) const
 	return std::acos((observerPlanetRq  + observerRq - planetRq)/(2.0*sqrt(observerPlanetRq*observerRq)));
 }
 
-// Computation of the visual magnitude (V band) of the planet.
 float Planet::getVMagnitude(const StelCore* core) const
+{
+	if (!canUsePhotometryCache())
+		return computeVMagnitude(core);
+	if (vMagnitudeGeneration!=photometryGeneration)
+	{
+		cachedVMagnitude = computeVMagnitude(core);
+		vMagnitudeGeneration = photometryGeneration;
+	}
+	return cachedVMagnitude;
+}
+
+// Computation of the visual magnitude (V band) of the planet.
+float Planet::computeVMagnitude(const StelCore* core) const
 {
 	if (parent == 0)
 	{
@@ -844,12 +954,28 @@ float Planet::getVMagnitude(const StelCore* core) const
 	return -26.73 - 2.5 * std::log10(F);
 }
 
+// The values are cached by the main thread only, the other threads like the searches of the StelObjectMgr compute them
+static inline bool canUsePhotometryCache()
+{
+	const QCoreApplication* app = QCoreApplication::instance();
+	return app && QThread::currentThread()==app->thread();
+}
+
 double Planet::getAngularSize(const StelCore* core) const
 {
+	const bool useCache = canUsePhotometryCache();
+	if (useCache && angularSizeGeneration==photometryGeneration)
+		return cachedAngularSize;
 	double rad = radius;
 	if (rings)
 		rad = rings->getSize();
-	return std::atan2(rad*sphereScale,getJ2000EquatorialPos(core).length()) * 180./M_PI;
+	const double size = std::atan2(rad*sphereScale,getJ2000EquatorialPos(core).length()) * 180./M_PI;
+	if (useCache)
+	{
+		cachedAngularSize = size;
+		angularSizeGeneration = photometryGeneration;
+	}
+	return size;
 }
 
 
@@ -900,9 +1026,6 @@ void Planet::draw(StelCore* core, float maxMagLabels, const QFont& planetNameFon
 		if (ang_dist==0.f)
 			ang_dist = 1.f; // if ang_dist == 0, the Planet is sun..
 
-		// by putting here, only draw orbit if Planet is visible for clarity
-		drawOrbit(core);  // TODO - fade in here also...
-
 		if (flagLabels && ang_dist>0.25 && maxMagLabels>getVMagnitude(core))
 		{
 			labelsFader=true;
@@ -941,6 +1064,8 @@ void Planet::PlanetShaderVars::initLocations(QOpenGLShaderProgram* p)
 	GL(shadowCount = p->uniformLocation("shadowCount"));
 	GL(shadowData = p->uniformLocation("shadowData"));
 	GL(sunInfo = p->uniformLocation("sunInfo"));
+	GL(vertexScale = p->uniformLocation("vertexScale"));
+	GL(tileRect = p->uniformLocation("tileRect"));
 }
 
 void Planet::initShader()
@@ -954,6 +1079,7 @@ void Planet::initShader()
 		"uniform highp mat4 projectionMatrix;\n"
 		"uniform highp vec3 lightDirection;\n"
 		"uniform highp vec3 eyeDirection;\n"
+		"uniform highp vec3 vertexScale;\n"
 		"varying mediump vec2 texc;\n"
 		"varying highp vec3 P;\n"
 		"#ifdef IS_MOON\n"
@@ -968,7 +1094,8 @@ void Planet::initShader()
 		"{\n"
 		"    gl_Position = projectionMatrix * vec4(vertex, 1.);\n"
 		"    texc = texCoord;\n"
-		"    highp vec3 normal = normalize(unprojectedVertex);\n"
+		"    highp vec3 scaledVertex = unprojectedVertex*vertexScale;\n"
+		"    highp vec3 normal = normalize(scaledVertex);\n"
 		"#ifdef IS_MOON\n"
 		"    normalX = normalize(cross(vec3(0,0,1), normal));\n"
 		"    normalY = normalize(cross(normal, normalX));\n"
@@ -978,13 +1105,15 @@ void Planet::initShader()
 		"    lum_ = clamp(c, 0.0, 1.0);\n"
 		"#endif\n"
 		"\n"
-		"    P = unprojectedVertex;\n"
+		"    P = scaledVertex;\n"
 		"}\n"
 		"\n";
 	
 	const char *fsrc =
 		"varying mediump vec2 texc;\n"
 		"uniform sampler2D tex;\n"
+		"// The part of the map covered by the texture, for the tiles of the high resolution maps\n"
+		"uniform highp vec4 tileRect;\n"
 		"uniform mediump vec3 ambientLight;\n"
 		"uniform mediump vec3 diffuseLight;\n"
 		"uniform highp vec4 sunInfo;\n"
@@ -1122,28 +1251,18 @@ void Planet::initShader()
 		"    if(final_illumination < 0.99)\n"
 		"    {\n"
 		"        lowp vec4 shadowColor = texture2D(earthShadow, vec2(final_illumination, 0.5));\n"
-		"        gl_FragColor = mix(texture2D(tex, texc) * litColor, shadowColor, shadowColor.a);\n"
+		"        gl_FragColor = mix(texture2D(tex, (texc-tileRect.xy)/tileRect.zw) * litColor, shadowColor, shadowColor.a);\n"
 		"    }\n"
 		"    else\n"
 		"#endif\n"
 		"    {\n"
-		"        gl_FragColor = texture2D(tex, texc) * litColor;\n"
+		"        gl_FragColor = texture2D(tex, (texc-tileRect.xy)/tileRect.zw) * litColor;\n"
 		"    }\n"
 		"}\n";
 	
 	// Default planet shader program
-	QOpenGLShader vshader(QOpenGLShader::Vertex);
-	vshader.compileSourceCode(vsrc);
-	if (!vshader.log().isEmpty()) { qWarning() << "Planet: Warnings while compiling vshader: " << vshader.log(); }
-	
-	QOpenGLShader fshader(QOpenGLShader::Fragment);
-	fshader.compileSourceCode(fsrc);
-	if (!fshader.log().isEmpty()) { qWarning() << "Planet: Warnings while compiling fshader: " << fshader.log(); }
-
 	planetShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	planetShaderProgram->addShader(&vshader);
-	planetShaderProgram->addShader(&fshader);
-	GL(StelPainter::linkProg(planetShaderProgram, "planetShaderProgram"));
+	GL(StelPainter::buildProg(planetShaderProgram, "planetShaderProgram", vsrc, fsrc));
 	GL(planetShaderProgram->bind());
 	planetShaderVars.initLocations(planetShaderProgram);
 	GL(planetShaderProgram->release());
@@ -1151,14 +1270,8 @@ void Planet::initShader()
 	// Planet with ring shader program
 	QByteArray arr = "#define RINGS_SUPPORT\n\n";
 	arr+=fsrc;
-	QOpenGLShader ringFragmentShader(QOpenGLShader::Fragment);
-	ringFragmentShader.compileSourceCode(arr.constData());
-	if (!ringFragmentShader.log().isEmpty()) { qWarning() << "Planet: Warnings while compiling ringFragmentShader: " << ringFragmentShader.log(); }
-	
 	ringPlanetShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	ringPlanetShaderProgram->addShader(&vshader);
-	ringPlanetShaderProgram->addShader(&ringFragmentShader);
-	GL(StelPainter::linkProg(ringPlanetShaderProgram, "ringPlanetShaderProgram"));
+	GL(StelPainter::buildProg(ringPlanetShaderProgram, "ringPlanetShaderProgram", vsrc, arr));
 	GL(ringPlanetShaderProgram->bind());
 	ringPlanetShaderVars.initLocations(ringPlanetShaderProgram);
 	GL(ringPlanetShaderVars.isRing = ringPlanetShaderProgram->uniformLocation("isRing"));
@@ -1171,20 +1284,10 @@ void Planet::initShader()
 	// Moon shader program
 	arr = "#define IS_MOON\n\n";
 	arr+=vsrc;
-	QOpenGLShader moonVertexShader(QOpenGLShader::Vertex);
-	moonVertexShader.compileSourceCode(arr.constData());
-	if (!moonVertexShader.log().isEmpty()) { qWarning() << "Planet: Warnings while compiling moonVertexShader: " << moonVertexShader.log(); }
-	
-	arr = "#define IS_MOON\n\n";
-	arr+=fsrc;
-	QOpenGLShader moonFragmentShader(QOpenGLShader::Fragment);
-	moonFragmentShader.compileSourceCode(arr.constData());
-	if (!moonFragmentShader.log().isEmpty()) { qWarning() << "Planet: Warnings while compiling moonFragmentShader: " << moonFragmentShader.log(); }
-	
+	QByteArray moonFsrc = "#define IS_MOON\n\n";
+	moonFsrc+=fsrc;
 	moonShaderProgram = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
-	moonShaderProgram->addShader(&moonVertexShader);
-	moonShaderProgram->addShader(&moonFragmentShader);
-	GL(StelPainter::linkProg(moonShaderProgram, "moonPlanetShaderProgram"));
+	GL(StelPainter::buildProg(moonShaderProgram, "moonPlanetShaderProgram", arr, moonFsrc));
 	GL(moonShaderProgram->bind());
 	moonShaderVars.initLocations(moonShaderProgram);
 	GL(moonShaderVars.earthShadow = moonShaderProgram->uniformLocation("earthShadow"));
@@ -1192,10 +1295,13 @@ void Planet::initShader()
 	GL(moonShaderProgram->release());
 }
 
+static void releaseSphereLods();
+
 void Planet::deinitShader()
 {
 	delete planetShaderProgram;
 	planetShaderProgram = NULL;
+	releaseSphereLods();
 }
 
 void Planet::draw3dModel(StelCore* core, StelProjector::ModelViewTranformP transfo, float screenSz, bool drawOnlyRing)
@@ -1206,6 +1312,9 @@ void Planet::draw3dModel(StelCore* core, StelProjector::ModelViewTranformP trans
 
 	if (screenSz>1.)
 	{
+		// The halos of the further bodies must be drawn before the sphere hides them
+		ssm->flushPointSourceHalos(core);
+
 		StelProjector::ModelViewTranformP transfo2 = transfo->clone();
 		transfo2->combine(Mat4d::zrotation(M_PI/180*(axisRotation + 90.)));
 		StelPainter* sPainter = new StelPainter(core->getProjection(transfo2));
@@ -1264,9 +1373,18 @@ void Planet::draw3dModel(StelCore* core, StelProjector::ModelViewTranformP trans
 		float surfArcMin2 = getSpheroidAngularSize(core)*60;
 		surfArcMin2 = surfArcMin2*surfArcMin2*M_PI; // the total illuminated area in arcmin^2
 
-		StelPainter sPainter(core->getProjection(StelCore::FrameJ2000));
 		Vec3d tmp = getJ2000EquatorialPos(core);
-		core->getSkyDrawer()->postDrawSky3dModel(&sPainter, Vec3f(tmp[0], tmp[1], tmp[2]), surfArcMin2, getVMagnitudeWithExtinction(core), color);
+		const float mag = getVMagnitudeWithExtinction(core);
+		if (screenSz>1. || mag<-15.f)
+		{
+			StelPainter sPainter(core->getProjection(StelCore::FrameJ2000));
+			core->getSkyDrawer()->postDrawSky3dModel(&sPainter, Vec3f(tmp[0], tmp[1], tmp[2]), surfArcMin2, mag, color);
+		}
+		else
+		{
+			// Unresolved body, its halo is drawn with the other point sources of the frame
+			ssm->addPointSourceHalo(core, Vec3f(tmp[0], tmp[1], tmp[2]), surfArcMin2, mag, color);
+		}
 	}
 }
 
@@ -1328,6 +1446,66 @@ void sSphere(Planet3DModel* model, const float radius, const float oneMinusOblat
 	}
 }
 
+//! The spheres of unit radius shared by all the planets, from the coarsest to the finest level of detail.
+static const int NbSphereLods = 5;
+static const int sphereLodFacets[NbSphereLods] = {10, 18, 32, 56, 100};
+
+struct SphereLod
+{
+	SphereLod() : vertexBuffer(NULL), indexBuffer(NULL) {}
+	Planet3DModel model;
+	//! The vertices followed by the texture coordinates, and the indices, in static GPU buffers.
+	QOpenGLBuffer* vertexBuffer;
+	QOpenGLBuffer* indexBuffer;
+};
+static SphereLod sphereLods[NbSphereLods];
+
+//! Get the coarsest shared sphere with at least the given number of facets, creating it the first time.
+static SphereLod& getSphereLod(int nbFacets)
+{
+	int level = 0;
+	while (level<NbSphereLods-1 && sphereLodFacets[level]<nbFacets)
+		++level;
+	SphereLod& lod = sphereLods[level];
+	if (!lod.vertexBuffer)
+	{
+		sSphere(&lod.model, 1.f, 1.f, sphereLodFacets[level], sphereLodFacets[level]);
+		const int verticesSize = lod.model.vertexArr.size()*sizeof(float);
+		lod.vertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		lod.vertexBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+		lod.vertexBuffer->create();
+		lod.vertexBuffer->bind();
+		lod.vertexBuffer->allocate(verticesSize + lod.model.texCoordArr.size()*sizeof(float));
+		lod.vertexBuffer->write(0, lod.model.vertexArr.constData(), verticesSize);
+		lod.vertexBuffer->write(verticesSize, lod.model.texCoordArr.constData(), lod.model.texCoordArr.size()*sizeof(float));
+		lod.vertexBuffer->release();
+		lod.indexBuffer = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+		lod.indexBuffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+		lod.indexBuffer->create();
+		lod.indexBuffer->bind();
+		lod.indexBuffer->allocate(lod.model.indiceArr.constData(), lod.model.indiceArr.size()*sizeof(unsigned short));
+		lod.indexBuffer->release();
+	}
+	return lod;
+}
+
+//! Release the GPU buffers of the shared spheres, they are created again when needed.
+static void releaseSphereLods()
+{
+	for (int i=0;i<NbSphereLods;++i)
+	{
+		if (sphereLods[i].vertexBuffer)
+		{
+			sphereLods[i].vertexBuffer->destroy();
+			delete sphereLods[i].vertexBuffer;
+			sphereLods[i].vertexBuffer = NULL;
+			sphereLods[i].indexBuffer->destroy();
+			delete sphereLods[i].indexBuffer;
+			sphereLods[i].indexBuffer = NULL;
+		}
+	}
+}
+
 struct Ring3DModel
 {
 	QVector<float> vertexArr;
@@ -1383,6 +1561,220 @@ void Planet::computeModelMatrix(Mat4d &result) const
 	}
 }
 
+// Number of quads per side of the mesh drawn for one map tile
+static const int MapTileSteps = 8;
+// Number of points per side of a map tile tested for its visibility
+static const int MapTileSamples = 5;
+
+static inline quint64 mapTileKey(int level, int x, int y)
+{
+	return ((quint64)level<<48) | ((quint64)x<<24) | (quint64)y;
+}
+
+// The point of the unit sphere at the texture coordinates (s, t), as built by sSphere()
+static Vec3f mapPoint(float s, float t)
+{
+	const float theta = 2.f*M_PI*s;
+	const float rho = M_PI*(1.f-t);
+	return Vec3f(-std::sin(theta)*std::sin(rho), std::cos(theta)*std::sin(rho), std::cos(rho));
+}
+
+void Planet::findMapTiles()
+{
+	mapTilesSearched = true;
+	if (texMapName.isEmpty())
+		return;
+	const QFileInfo info(StelFileMgr::getInstallationDir()+"/textures/"+texMapName);
+	const QString dir = info.path()+"/"+info.completeBaseName()+"_tiles/";
+	const QStringList first = QDir(dir+"0").entryList(QStringList("0_0.*"), QDir::Files);
+	if (first.isEmpty())
+		return;
+	QImageReader reader(dir+"0/"+first.first());
+	const QSize size = reader.size();
+	if (size.width()<=0 || size.width()!=size.height())
+	{
+		qWarning() << "WARNING: The map tiles of" << englishName << "must be square";
+		return;
+	}
+	mapTileSize = size.width();
+	mapTileSuffix = QFileInfo(first.first()).suffix();
+	while (QDir(dir+QString::number(mapTileLevels)).exists())
+		++mapTileLevels;
+	mapTilesDir = dir;
+	qDebug() << "Found" << mapTileLevels << "levels of map tiles for" << englishName;
+}
+
+StelTextureSP Planet::getMapTile(int level, int x, int y)
+{
+	const quint64 key = mapTileKey(level, x, y);
+	QHash<quint64, StelTextureSP>::const_iterator it = mapTiles.constFind(key);
+	if (it!=mapTiles.constEnd())
+		return it.value();
+	StelTexture::StelTextureParams params(true, GL_LINEAR, GL_CLAMP_TO_EDGE);
+	params.evictable = true;
+	const QString path = QString("%1%2/%3_%4.%5").arg(mapTilesDir).arg(level).arg(x).arg(y).arg(mapTileSuffix);
+	StelTextureSP tex = StelApp::getInstance().getTextureManager().createTextureThread(path, params);
+	mapTiles.insert(key, tex);
+	return tex;
+}
+
+bool Planet::isMapTileVisible(const StelProjectorP& prj, const Vec3f& vertexScale, int level, int x, int y, float& area) const
+{
+	const int cols = 2<<level;
+	const int rows = 1<<level;
+	const StelProjector::ModelViewTranformP& modelView = prj->getModelViewTransform();
+	Vec3d center(0.);
+	modelView->forward(center);
+	bool facing = false;
+	bool projected = false;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i=0;i<MapTileSamples;++i)
+	{
+		for (int j=0;j<MapTileSamples;++j)
+		{
+			const float s = (x+(float)i/(MapTileSamples-1))/cols;
+			const float t = 1.f-(y+(float)j/(MapTileSamples-1))/rows;
+			const Vec3f p = mapPoint(s, t);
+			const Vec3d v(p[0]*vertexScale[0], p[1]*vertexScale[1], p[2]*vertexScale[2]);
+			// The surface faces the observer where the normal points towards the eye
+			Vec3d eye = v;
+			modelView->forward(eye);
+			if ((eye-center)*eye<0.)
+				facing = true;
+			Vec3d win;
+			if (prj->project(v, win))
+			{
+				projected = true;
+				minX = qMin(minX, (float)win[0]);
+				maxX = qMax(maxX, (float)win[0]);
+				minY = qMin(minY, (float)win[1]);
+				maxY = qMax(maxY, (float)win[1]);
+			}
+		}
+	}
+	if (!facing || !projected)
+		return false;
+	if (maxX<prj->getViewportPosX() || minX>prj->getViewportPosX()+prj->getViewportWidth()
+	    || maxY<prj->getViewportPosY() || minY>prj->getViewportPosY()+prj->getViewportHeight())
+		return false;
+	area = (maxX-minX)*(maxY-minY);
+	return true;
+}
+
+void Planet::findVisibleMapTiles(const StelProjectorP& prj, const Vec3f& vertexScale, int level, int x, int y, int targetLevel, QVector<QPair<quint64, float> >& tiles) const
+{
+	float area;
+	if (!isMapTileVisible(prj, vertexScale, level, x, y, area))
+		return;
+	if (level==targetLevel)
+	{
+		tiles.append(qMakePair(mapTileKey(level, x, y), area));
+		return;
+	}
+	for (int i=0;i<2;++i)
+		for (int j=0;j<2;++j)
+			findVisibleMapTiles(prj, vertexScale, level+1, 2*x+i, 2*y+j, targetLevel, tiles);
+}
+
+void Planet::drawMapTiles(StelPainter* painter, QOpenGLShaderProgram* shader, const PlanetShaderVars* shaderVars, float screenSz, const Vec3f& vertexScale)
+{
+	if (!mapTilesSearched)
+		findMapTiles();
+	if (mapTileLevels==0)
+		return;
+
+	// Choose the coarsest level giving at least one texel per pixel, the screen size being the radius
+	int mapWidth, mapHeight;
+	if (!texMap->getDimensions(mapWidth, mapHeight))
+		return;
+	const float neededWidth = 2.f*M_PI*screenSz;
+	int level = 0;
+	while (level<mapTileLevels-1 && (2<<level)*mapTileSize<neededWidth)
+		++level;
+	// When far enough, the texture map alone is sharp enough
+	if (neededWidth<=mapWidth || (2<<level)*mapTileSize<=mapWidth)
+		return;
+
+	const StelProjectorP& prj = painter->getProjector();
+	QVector<QPair<quint64, float> > tiles;
+	findVisibleMapTiles(prj, vertexScale, 0, 0, 0, level, tiles);
+	findVisibleMapTiles(prj, vertexScale, 0, 1, 0, level, tiles);
+	if (tiles.isEmpty())
+		return;
+
+	static QVector<unsigned short> indices;
+	if (indices.isEmpty())
+	{
+		// Same orientation as the triangles of sSphere()
+		for (int j=0;j<MapTileSteps;++j)
+		{
+			for (int i=0;i<MapTileSteps;++i)
+			{
+				const unsigned short a = j*(MapTileSteps+1)+i;
+				const unsigned short b = a+MapTileSteps+1;
+				indices << a << b << a+1;
+				indices << a+1 << b << b+1;
+			}
+		}
+	}
+
+	// The tiles are drawn over the sphere, which already filled the depth buffer for the rings
+	const bool depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	const int nbVertices = (MapTileSteps+1)*(MapTileSteps+1);
+	QVector<Vec3f> vertices(nbVertices);
+	QVector<Vec3f> projectedVertices(nbVertices);
+	QVector<Vec2f> texCoords(nbVertices);
+	for (int n=0;n<tiles.size();++n)
+	{
+		const quint64 key = tiles.at(n).first;
+		const int x = (key>>24)&0xffffff;
+		const int y = key&0xffffff;
+		StelTextureSP tex = getMapTile(level, x, y);
+		// The largest tiles on screen are loaded first
+		tex->setUploadPriority(tiles.at(n).second);
+		int texLevel = level;
+		bool bound = tex->bind(0);
+		while (!bound && texLevel>0)
+		{
+			--texLevel;
+			const StelTextureSP parent = mapTiles.value(mapTileKey(texLevel, x>>(level-texLevel), y>>(level-texLevel)));
+			bound = parent && parent->canBind() && parent->bind(0);
+		}
+		if (!bound)
+			continue;
+
+		const int shift = level-texLevel;
+		const float texCols = 2<<texLevel;
+		const float texRows = 1<<texLevel;
+		GL(shader->setUniformValue(shaderVars->tileRect, (x>>shift)/texCols, 1.f-((y>>shift)+1)/texRows, 1.f/texCols, 1.f/texRows));
+
+		const float cols = 2<<level;
+		const float rows = 1<<level;
+		for (int j=0;j<=MapTileSteps;++j)
+		{
+			for (int i=0;i<=MapTileSteps;++i)
+			{
+				const float s = (x+(float)i/MapTileSteps)/cols;
+				const float t = 1.f-(y+(float)j/MapTileSteps)/rows;
+				const int k = j*(MapTileSteps+1)+i;
+				vertices[k] = mapPoint(s, t);
+				texCoords[k].set(s, t);
+				const Vec3f v(vertices[k][0]*vertexScale[0], vertices[k][1]*vertexScale[1], vertices[k][2]*vertexScale[2]);
+				prj->project(v, projectedVertices[k]);
+			}
+		}
+		GL(shader->setAttributeArray(shaderVars->vertex, (const GLfloat*)projectedVertices.constData(), 3));
+		GL(shader->setAttributeArray(shaderVars->unprojectedVertex, (const GLfloat*)vertices.constData(), 3));
+		GL(shader->setAttributeArray(shaderVars->texCoord, (const GLfloat*)texCoords.constData(), 2));
+		GL(glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT, indices.constData()));
+	}
+
+	GL(shader->setUniformValue(shaderVars->tileRect, 0.f, 0.f, 1.f, 1.f));
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+}
+
 void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 {
 	if (texMap)
@@ -1403,14 +1795,18 @@ void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 	if (nb_facet<10) nb_facet = 10;
 	if (nb_facet>100) nb_facet = 100;
 
-	// Generates the vertice
-	Planet3DModel model;
-	sSphere(&model, radius*sphereScale, oneMinusOblateness, nb_facet, nb_facet);
+	// Use the shared unit sphere of this level of detail, scaled to the size and oblateness of the body
+	const SphereLod& lod = getSphereLod(nb_facet);
+	const Planet3DModel& model = lod.model;
+	const Vec3f vertexScale(radius*sphereScale, radius*sphereScale, radius*sphereScale*oneMinusOblateness);
 	
 	QVector<float> projectedVertexArr;
 	projectedVertexArr.resize(model.vertexArr.size());
 	for (int i=0;i<model.vertexArr.size()/3;++i)
-		painter->getProjector()->project(*((Vec3f*)(model.vertexArr.constData()+i*3)), *((Vec3f*)(projectedVertexArr.data()+i*3)));
+	{
+		const Vec3f v(model.vertexArr.at(i*3)*vertexScale[0], model.vertexArr.at(i*3+1)*vertexScale[1], model.vertexArr.at(i*3+2)*vertexScale[2]);
+		painter->getProjector()->project(v, *((Vec3f*)(projectedVertexArr.data()+i*3)));
+	}
 	
 	const SolarSystem* ssm = GETSTELMODULE(SolarSystem);
 		
@@ -1441,33 +1837,21 @@ void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 		shader = moonShaderProgram;
 		shaderVars = &moonShaderVars;
 	}
+	StelPainter::flushPendingText();
 	GL(shader->bind());
 	
 	const Mat4f& m = painter->getProjector()->getProjectionMatrix();
-	const QMatrix4x4 qMat(m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]);
+	const QMatrix4x4 qMat = StelPainter::toQMatrix(m);
 	
 	Mat4d modelMatrix;
 	computeModelMatrix(modelMatrix);
 	// TODO explain this
 	const Mat4d mTarget = modelMatrix.inverse();
 	
-	QMatrix4x4 shadowCandidatesData;
-	QVector<const Planet*> shadowCandidates = getCandidatesForShadow();
-	// Our shader doesn't support more than 4 planets creating shadow
-	if (shadowCandidates.size()>4)
-	{
-		qDebug() << "Too many satellite shadows, some won't be displayed";
-		shadowCandidates.resize(4);
-	}
-	for (int i=0;i<shadowCandidates.size();++i)
-	{
-		shadowCandidates.at(i)->computeModelMatrix(modelMatrix);
-		const Vec4d position = mTarget * modelMatrix.getColumn(3);
-		shadowCandidatesData(0, i) = position[0];
-		shadowCandidatesData(1, i) = position[1];
-		shadowCandidatesData(2, i) = position[2];
-		shadowCandidatesData(3, i) = shadowCandidates.at(i)->getRadius();
-	}
+	// The shadow casters are only computed again when the positions change
+	const QVector<const Planet*>& shadowCandidates = getCandidatesForShadow();
+	// Copied, the rings cast their own shadow below
+	QMatrix4x4 shadowCandidatesData = this->shadowCandidatesData;
 	
 	const StelProjectorP& projector = painter->getProjector();
 	
@@ -1489,6 +1873,8 @@ void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 	GL(shader->setUniformValue(shaderVars->shadowCount, shadowCandidates.size()));
 	GL(shader->setUniformValue(shaderVars->shadowData, shadowCandidatesData));
 	GL(shader->setUniformValue(shaderVars->sunInfo, mTarget[12], mTarget[13], mTarget[14], ssm->getSun()->getRadius()));
+	GL(shader->setUniformValue(shaderVars->vertexScale, vertexScale[0], vertexScale[1], vertexScale[2]));
+	GL(shader->setUniformValue(shaderVars->tileRect, 0.f, 0.f, 1.f, 1.f));
 	GL(texMap->bind(1));
 	
 	if (rings!=NULL)
@@ -1514,10 +1900,13 @@ void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 
 	GL(shader->setAttributeArray(shaderVars->vertex, (const GLfloat*)projectedVertexArr.constData(), 3));
 	GL(shader->enableAttributeArray(shaderVars->vertex));
-	GL(shader->setAttributeArray(shaderVars->unprojectedVertex, (const GLfloat*)model.vertexArr.constData(), 3));
+	// The unit sphere is read from the static buffers
+	lod.vertexBuffer->bind();
+	GL(shader->setAttributeBuffer(shaderVars->unprojectedVertex, GL_FLOAT, 0, 3));
 	GL(shader->enableAttributeArray(shaderVars->unprojectedVertex));
-	GL(shader->setAttributeArray(shaderVars->texCoord, (const GLfloat*)model.texCoordArr.constData(), 2));
+	GL(shader->setAttributeBuffer(shaderVars->texCoord, GL_FLOAT, model.vertexArr.size()*sizeof(float), 2));
 	GL(shader->enableAttributeArray(shaderVars->texCoord));
+	lod.vertexBuffer->release();
 
 	if (rings)
 	{
@@ -1527,7 +1916,12 @@ void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 	}
 	
 	if (!drawOnlyRing)
-		GL(glDrawElements(GL_TRIANGLES, model.indiceArr.size(), GL_UNSIGNED_SHORT, model.indiceArr.constData()));
+	{
+		lod.indexBuffer->bind();
+		GL(glDrawElements(GL_TRIANGLES, model.indiceArr.size(), GL_UNSIGNED_SHORT, 0));
+		lod.indexBuffer->release();
+		drawMapTiles(painter, shader, shaderVars, screenSz, vertexScale);
+	}
 
 	if (rings)
 	{
@@ -1542,6 +1936,8 @@ void Planet::drawSphere(StelPainter* painter, float screenSz, bool drawOnlyRing)
 		sRing(&ringModel, rings->radiusMin, rings->radiusMax, 128, 32);
 		
 		GL(ringPlanetShaderProgram->setUniformValue(ringPlanetShaderVars.isRing, true));
+		// The ring vertices are already in the frame of the planet
+		GL(ringPlanetShaderProgram->setUniformValue(ringPlanetShaderVars.vertexScale, 1.f, 1.f, 1.f));
 		GL(ringPlanetShaderProgram->setUniformValue(ringPlanetShaderVars.texture, 2));
 		
 		computeModelMatrix(modelMatrix);
@@ -1592,7 +1988,7 @@ void Planet::drawHints(const StelCore* core, const QFont& planetNameFont)
 	// Draw nameI18 + scaling if it's not == 1.
 	float tmp = (hintFader.getInterstate()<=0 ? 7.f : 10.f) + getAngularSize(core)*M_PI/180.f*prj->getPixelPerRadAtCenter()/1.44f; // Shift for nameI18 printing
 	sPainter.setColor(labelColor[0], labelColor[1], labelColor[2],labelsFader.getInterstate());
-	sPainter.drawText(screenPos[0],screenPos[1], getSkyLabel(core), 0, tmp, tmp, false);
+	GETSTELMODULE(LabelMgr)->addSkyLabel(sPainter, screenPos[0], screenPos[1], getSkyLabel(core), tmp, tmp, getVMagnitude(core));
 
 	// hint disappears smoothly on close view
 	if (hintFader.getInterstate()<=0)
@@ -1617,6 +2013,22 @@ Ring::Ring(float radiusMin, float radiusMax, const QString &texname)
 
 
 // draw orbital path of Planet
+bool Planet::hasVisibleOrbit(const StelCore* core, const StelProjectorP& prj) const
+{
+	if (hidden || !orbitFader.getInterstate() || !re.siderealPeriod)
+		return false;
+	if (getEnglishName() == core->getCurrentLocation().planetName)
+		return false;
+	// Same test as in draw()
+	Vec3d win;
+	const float screenSz = getAngularSize(core)*M_PI/180.*prj->getPixelPerRadAtCenter();
+	const float viewport_left = prj->getViewportPosX();
+	const float viewport_bottom = prj->getViewportPosY();
+	return prj->project(getHeliocentricEclipticPos(), win)
+		&& win[1]>viewport_bottom - screenSz && win[1] < viewport_bottom + prj->getViewportHeight()+screenSz
+		&& win[0]>viewport_left - screenSz && win[0] < viewport_left + prj->getViewportWidth() + screenSz;
+}
+
 void Planet::drawOrbit(const StelCore* core)
 {
 	if (!orbitFader.getInterstate())
@@ -1634,9 +2046,13 @@ void Planet::drawOrbit(const StelCore* core)
 
 	sPainter.setColor(orbitColor[0], orbitColor[1], orbitColor[2], orbitFader.getInterstate());
 	Vec3d onscreen;
+	// The orbit is stored relative to the parent, whose position only has to be added
+	const Vec3d parentPos = getHeliocentricPos(Vec3d(0.));
+	Vec3d orbit[ORBIT_SEGMENTS+1];
+	for (int n=0; n<ORBIT_SEGMENTS; ++n)
+		orbit[n] = orbitP[n]+parentPos;
 	// special case - use current Planet position as center vertex so that draws
 	// on it's orbit all the time (since segmented rather than smooth curve)
-	Vec3d savePos = orbit[ORBIT_SEGMENTS/2];
 	orbit[ORBIT_SEGMENTS/2]=getHeliocentricEclipticPos();
 	orbit[ORBIT_SEGMENTS]=orbit[0];
 	int nbIter = closeOrbit ? ORBIT_SEGMENTS : ORBIT_SEGMENTS-1;
@@ -1658,7 +2074,6 @@ void Planet::drawOrbit(const StelCore* core)
 			vertexArray.clear();
 		}
 	}
-	orbit[ORBIT_SEGMENTS/2]=savePos;
 	if (!vertexArray.isEmpty())
 	{
 		sPainter.setVertexPointer(2, GL_FLOAT, vertexArray.constData());
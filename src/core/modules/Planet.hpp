@@ -25,8 +25,12 @@
 #include "VecMath.hpp"
 #include "StelFader.hpp"
 #include "StelTextureTypes.hpp"
+#include "StelStringPool.hpp"
 #include "StelProjectorType.hpp"
 
+#include <QHash>
+#include <QMatrix4x4>
+#include <QPair>
 #include <QString>
 
 // The callback type for the external position computation function
@@ -112,21 +116,34 @@ public:
 	virtual double getCloseViewFov(const StelCore* core) const;
 	virtual double getSatellitesFov(const StelCore* core) const;
 	virtual double getParentSatellitesFov(const StelCore* core) const;
+	//! Get the visual magnitude, computed once per frame by computeVMagnitude().
 	virtual float getVMagnitude(const StelCore* core) const;
 	virtual float getSelectPriority(const StelCore* core) const;
 	virtual Vec3f getInfoColor(void) const;
 	virtual QString getType(void) const {return "Planet";}
 	virtual Vec3d getJ2000EquatorialPos(const StelCore *core) const;
 	virtual QString getEnglishName(void) const {return englishName;}
-	virtual QString getNameI18n(void) const {return nameI18;}
+	//! Get the translated name, translated on first use after a change of the language.
+	//! The translation is only done from the main thread, see SolarSystem::prepareNameSearch().
+	virtual QString getNameI18n(void) const;
+	//! Get the angular radius in degrees, computed once per frame.
 	virtual double getAngularSize(const StelCore* core) const;
 	virtual bool hasAtmosphere(void) {return atmosphere;}
 	virtual bool hasHalo(void) {return halo;}
 
 	///////////////////////////////////////////////////////////////////////////
 	// Methods of SolarSystem object
-	//! Translate planet name using the passed translator
-	virtual void translateName(const StelTranslator &trans);
+	//! Translate planet name using the passed translator.
+	//! Only the cached translated name is modified.
+	void translateName(const StelTranslator &trans) const;
+	//! Get the planet name translated by the passed translator.
+	virtual QString getTranslatedName(const StelTranslator &trans) const;
+	//! Mark the translated names of all the planets as outdated after a change of the language.
+	//! They are translated again when they are first used, not all at once.
+	static void invalidateTranslations() {++translationGeneration;}
+	//! Mark the magnitudes and angular sizes cached by all the planets as outdated,
+	//! called by the SolarSystem each time the positions are computed.
+	static void invalidatePhotometry() {++photometryGeneration;}
 
 	// Draw the Planet
 	// GZ Made that virtual to allow comets having their own draw().
@@ -193,7 +210,7 @@ public:
 
 	void setRings(Ring* r) {rings = r;}
 
-	void setSphereScale(float s) {sphereScale = s;}
+	void setSphereScale(float s) {sphereScale = s; angularSizeGeneration = -1;}
 	float getSphereScale(void) const {return sphereScale;}
 
 	const QSharedPointer<Planet> getParent(void) const {return parent;}
@@ -219,8 +236,10 @@ public:
 	LinearFader orbitFader;
 	// draw orbital path of Planet
 	void drawOrbit(const StelCore*);
-	Vec3d orbit[ORBIT_SEGMENTS+1];   // store heliocentric coordinates for drawing the orbit
-	Vec3d orbitP[ORBIT_SEGMENTS+1];  // store local coordinate for orbit
+	//! Whether the orbit has to be drawn: only the orbits of the bodies which are on screen are drawn, for clarity.
+	//! @param prj the projector of the heliocentric ecliptic frame.
+	virtual bool hasVisibleOrbit(const StelCore* core, const StelProjectorP& prj) const;
+	Vec3d orbitP[ORBIT_SEGMENTS+1];  // store local coordinate for orbit, the position of the parent is added when drawing
 	double lastOrbitJD;
 	double deltaJD;                  // time difference between positional updates.
 	double deltaOrbitJD;
@@ -233,10 +252,14 @@ public:
 	static void setOrbitColor(const Vec3f& oc) {orbitColor = oc;}
 	static const Vec3f& getOrbitColor() {return orbitColor;}
 
-	//! Return the list of planets which project some shadow on this planet
-	QVector<const Planet*> getCandidatesForShadow() const;
+	//! Return the list of planets which project some shadow on this planet, at most 4.
+	//! The list is cached, and computed again only when the positions change.
+	const QVector<const Planet*>& getCandidatesForShadow() const;
 	
 protected:
+	//! Compute the visual magnitude (V band) for the current positions, cached by getVMagnitude().
+	virtual float computeVMagnitude(const StelCore* core) const;
+
 	static StelTextureSP texEarthShadow;     // for lunar eclipses
 
 	void computeModelMatrix(Mat4d &result) const;
@@ -254,7 +277,12 @@ protected:
 	void drawHints(const StelCore* core, const QFont& planetNameFont);
 
 	QString englishName;             // english planet name
-	QString nameI18;                 // International translated name
+	mutable QString nameI18;         // International translated name
+	mutable int nameI18Generation;   // Value of translationGeneration when nameI18 was translated
+	mutable float cachedVMagnitude;  // Value returned by getVMagnitude()
+	mutable int vMagnitudeGeneration; // Value of photometryGeneration when cachedVMagnitude was computed
+	mutable double cachedAngularSize; // Value returned by getAngularSize()
+	mutable int angularSizeGeneration; // Value of photometryGeneration when cachedAngularSize was computed
 	QString texMapName;              // Texture file path	
 	QString normalMapName;              // Texture file path
 	int flagLighting;                // Set whether light computation has to be proceed
@@ -273,11 +301,41 @@ protected:
 	StelTextureSP texMap;            // Planet map texture
 	StelTextureSP normalMap;         // Planet normal map texture
 
+	//! Compute shadowCandidates and shadowCandidatesData for the current positions.
+	void updateShadowCandidates() const;
+	mutable QVector<const Planet*> shadowCandidates; // Cache of getCandidatesForShadow()
+	mutable QMatrix4x4 shadowCandidatesData; // Positions and radii of the shadowCandidates in the frame of this planet, for the shaders
+	mutable double shadowCandidatesJD; // Value of lastJD when the shadowCandidates were computed
+
+	//! The optional high resolution version of the map, cut in tiles stored in the directory
+	//! textures/<map name without extension>_tiles/. The level 0 has 2x1 square tiles named 0/0_0 and 0/1_0,
+	//! and each level divides the tiles of the previous one in 4: <level>/<x>_<y>, y=0 being the north.
+	bool mapTilesSearched;           // Whether the directory of the tiles was looked for
+	QString mapTilesDir;             // Directory of the tiles, empty if there are none
+	QString mapTileSuffix;           // File extension of the tiles
+	int mapTileLevels;               // Number of levels of tiles
+	int mapTileSize;                 // Size in pixels of the side of the tiles
+	QHash<quint64, StelTextureSP> mapTiles; // The tile textures created so far, by mapTileKey()
+
 	Ring* rings;                     // Planet rings
 	double distance;                 // Temporary variable used to store the distance to a given point
 					 // it is used for sorting while drawing
 	float sphereScale;               // Artificial scaling for better viewing
 	double lastJD;                   // caches JD of last positional computation
+	//! Number of positions kept by computeEclipticPos(), enough for the two dates
+	//! of the light travel time correction when the time is not running.
+	static const int NbCachedPositions = 4;
+	double cachedPositionJD[NbCachedPositions];
+	Vec3d cachedPosition[NbCachedPositions];
+	int nextCachedPosition;
+	//! Set eclipticPos to the position at the given date, from the cache if it was computed recently.
+	void computeEclipticPos(const double date);
+	//! Store a position computed for the given date in the cache.
+	void cachePosition(const double date, const Vec3d& pos);
+	//! Whether the position at the given date is known without calling coordFunc.
+	bool hasCachedPosition(const double date) const;
+	//! Set by SolarSystem when the body is too faint to be seen, its position is then not updated.
+	bool skipPositionUpdate;
 	// The callback for the calculation of the equatorial rect heliocentric position at time JD.
 	posFuncType coordFunc;
 	void* userDataPtr;
@@ -291,9 +349,11 @@ protected:
 	bool hidden;                     // useful for fake planets used as observation positions - not drawn or labeled
 	bool atmosphere;                 // Does the planet have an atmosphere?
 	bool halo;                       // Does the planet have a halo?
-	QString pType;			 // Type of body
+	StelInternedString pType;	 // Type of body, in the shared string pool
 
 	static Vec3f labelColor;
+	static int translationGeneration;
+	static int photometryGeneration;
 	static StelTextureSP hintCircleTex;
 	
 	// Shader-related variables
@@ -310,6 +370,8 @@ protected:
 		int shadowCount;
 		int shadowData;
 		int sunInfo;
+		int vertexScale;
+		int tileRect;
 		
 		void initLocations(QOpenGLShaderProgram*);
 	};
@@ -339,6 +401,21 @@ protected:
 	static void initShader();
 	static void deinitShader();
 
+	//! Look for the tiles of the high resolution map.
+	void findMapTiles();
+	//! Get the texture of a tile of the high resolution map, created lazily and evictable.
+	StelTextureSP getMapTile(int level, int x, int y);
+	//! Test whether a tile faces the observer and overlaps the viewport.
+	//! @param area set to the area of the tile on screen in pixels, when it is visible.
+	bool isMapTileVisible(const StelProjectorP& prj, const Vec3f& vertexScale, int level, int x, int y, float& area) const;
+	//! Append the visible tiles of the target level, descending from the tile (level, x, y).
+	void findVisibleMapTiles(const StelProjectorP& prj, const Vec3f& vertexScale, int level, int x, int y, int targetLevel, QVector<QPair<quint64, float> >& tiles) const;
+	//! Draw the visible tiles of the high resolution map over the sphere, when the texture map is too coarse
+	//! for the size of the body on screen. The tiles which are not loaded yet are replaced by the finest
+	//! loaded tile covering them, or the texture map itself.
+	//! The shader must be bound, with the uniforms of drawSphere() set.
+	void drawMapTiles(StelPainter* painter, QOpenGLShaderProgram* shader, const PlanetShaderVars* shaderVars, float screenSz, const Vec3f& vertexScale);
+
 };
 
 #endif // _PLANET_HPP_
@@ -86,6 +86,8 @@ void Skybright::setSunMoon(const float cosDistMoonZenith, const float cosDistSun
 	bTwilightTerm = -6.724f + 22.918312f * (M_PI_2-std::acos(cosDistSunZenith));
 
 	C4 = stelpow10f(-0.4f*K*airMassSun);	// Term for sky brightness computation
+
+	bMoonTermMax = bMoonTerm1 * (28860205.1341274269f * C3 + 440000.f * (1.f - C3));
 }
 
 
@@ -114,7 +116,7 @@ float Skybright::getLuminance( float cosDistMoon,
 	float b_total = ((b_twilight<b_daylight) ? b_twilight : b_daylight);
 
 	// Moonlight brightness, don't compute if less than 1% daylight
-	if ((bMoonTerm1 * (1.f - bKX) * (28860205.1341274269f * C3 + 440000.f * (1.f - C3)))/b_total>0.01f)
+	if (bMoonTermMax * (1.f - bKX)/b_total>0.01f)
 	{
 		float dist_moon;
 		if (cosDistMoon >= 1.f) {cosDistMoon = 1.f;dist_moon = 0.f;}
@@ -141,3 +143,54 @@ float Skybright::getLuminance( float cosDistMoon,
 	// lambert -> cd/m^2 formula seems to be wrong...
 }
 
+void Skybright::getLuminancev(const float* cosDistMoon, const float* cosDistSun, const float* cosDistZenith,
+			      float* luminance, int n) const
+{
+	Q_ASSERT(n<=BatchSize);
+	float bKX[BatchSize];
+	const float twilightZenithTerm = 0.063661977f / (K> 0.05f ? K : 0.05f);
+	const float luminanceScale = 900900.9f * static_cast<float>(M_PI) * 1e-4f * 3239389.f*2.f *1.5f;
+
+	// Daylight and twilight brightness, computed for every position
+	for (int i=0; i<n; ++i)
+	{
+		const float cosZ = cosDistZenith[i];
+		const float cosSun = cosDistSun[i];
+
+		// Air mass
+		bKX[i] = stelpow10f(-0.4f * K * (1.f / (cosZ + 0.025f*StelUtils::fastExp(-11.f*cosZ))));
+
+		const float distSun = StelUtils::fastAcos(cosSun);
+		const float FSv = 18886.28f / (distSun*distSun + 0.0007f)
+		               + stelpow10f(6.15f - (distSun+0.001f)* 1.43239f)
+		               + 229086.77f * ( 1.06f + cosSun*cosSun );
+		const float b_daylight = 9.289663e-12f * (1.f - bKX[i]) * (FSv * C4 + 440000.f * (1.f - C4));
+		const float b_twilight = stelpow10f(bTwilightTerm + twilightZenithTerm * StelUtils::fastAcos(cosZ)) * (1.7453293f / distSun) * (1.f-bKX[i]);
+		luminance[i] = (b_twilight<b_daylight) ? b_twilight : b_daylight;
+	}
+
+	// Moonlight and dark night sky brightness, only where they are more than 1% of the daylight
+	for (int i=0; i<n; ++i)
+	{
+		float b_total = luminance[i];
+		if (bMoonTermMax * (1.f - bKX[i])/b_total>0.01f)
+		{
+			float cosMoon = cosDistMoon[i];
+			float dist_moon;
+			if (cosMoon >= 1.f) {cosMoon = 1.f;dist_moon = 0.f;}
+			else
+				dist_moon = cosMoon > 0.99f ? std::acos(cosMoon) : StelUtils::fastAcos(cosMoon);
+			const float FM = 18886.28f / (dist_moon*dist_moon + 0.0005f)
+				+ stelpow10f(6.15f - dist_moon * 1.43239f)
+				+ 229086.77f * ( 1.06f + cosMoon*cosMoon );
+			b_total += bMoonTerm1 * (1.f - bKX[i]) * (FM * C3 + 440000.f * (1.f - C3));
+		}
+		if ((bNightTerm*bKX[i])/b_total>0.01f)
+		{
+			const float cosZ = cosDistZenith[i];
+			b_total += (0.4f + 0.6f / std::sqrt(0.04f + 0.96f * cosZ*cosZ)) * bNightTerm * bKX[i];
+		}
+		luminance[i] = (b_total<0.f) ? 0.f : b_total * luminanceScale;
+	}
+}
+
@@ -67,6 +67,28 @@ public:
 	//! @param cosDistZenith cos(angular distance between zenith and the position)
 	float getLuminance(float cosDistMoon, const float cosDistSun, const float cosDistZenith) const;
 
+	//! Maximum number of positions processed by one call to getLuminancev().
+	static const int BatchSize = 64;
+
+	//! Compute the luminance for a batch of positions, giving the same results as getLuminance().
+	//! The terms common to all the positions are evaluated in loops without branches which the
+	//! compiler can vectorize, the moon and night terms are then only added where they matter.
+	//! @param cosDistMoon cos(angular distance between moon and the positions)
+	//! @param cosDistSun cos(angular distance between sun and the positions)
+	//! @param cosDistZenith cos(angular distance between zenith and the positions)
+	//! @param luminance the array receiving the luminance of each position in cd/m^2
+	//! @param n the number of positions, at most BatchSize
+	void getLuminancev(const float* cosDistMoon, const float* cosDistSun, const float* cosDistZenith,
+			   float* luminance, int n) const;
+
+	//! Get the terms precomputed by setDate(), setLocation() and setSunMoon(),
+	//! to evaluate getLuminance() in the atmosphere vertex shader.
+	void getShadersParams(float& aK, float& aC3, float& aC4, float& abMoonTerm1, float& abTwilightTerm, float& abNightTerm) const
+	{
+		aK=K;aC3=C3;aC4=C4;
+		abMoonTerm1=bMoonTerm1;abTwilightTerm=bTwilightTerm;abNightTerm=bNightTerm;
+	}
+
 private:
 	float airMassMoon;  // Air mass for the Moon
 	float airMassSun;   // Air mass for the Sun
@@ -81,6 +103,7 @@ private:
 	float bNightTerm;
 	float bMoonTerm1;
 	float bTwilightTerm;
+	float bMoonTermMax;	// Moon brightness term at the moon position, to test if the moonlight matters
 };
 
 #endif // _SKYBRIGHT_HPP_
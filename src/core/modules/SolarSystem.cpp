@@ -23,6 +23,8 @@
 #include "StelTexture.hpp"
 #include "stellplanet.h"
 #include "Orbit.hpp"
+#include "EphemerisCache.hpp"
+#include "MinorBodyStore.hpp"
 
 #include "StelProjector.hpp"
 #include "StelApp.hpp"
@@ -42,7 +44,10 @@
 #include "StelUtils.hpp"
 #include "StelPainter.hpp"
 #include "TrailGroup.hpp"
+#include "OrbitGpuDrawer.hpp"
 #include "RefractionExtinction.hpp"
+#include "StelTracer.hpp"
+#include "StelJobSystem.hpp"
 
 #include <functional>
 #include <algorithm>
@@ -57,17 +62,35 @@
 #include <QMapIterator>
 #include <QDebug>
 #include <QDir>
+#include <QSet>
+#include <QThread>
+#include <QReadWriteLock>
 
 SolarSystem::SolarSystem()
 	: shadowPlanetCount(0)
 	, flagMoonScale(false)
 	, moonScale(1.)
 	, labelsAmount(false)
+	, haloPixPerRad(1.f)
+	, flagNamesIndexI18nValid(false)
+	, flagParallelComputation(true)
+	, solarEclipseFactor(1.f)
+	, flagEphemerisCache(false)
+	, ephemerisCacheWindow(4.)
+	, prefetchDate(0.)
+	, flagBatchOrbits(true)
+	, flagSkipFaintBodies(true)
+	, faintBodiesObserverDistance(-1.)
+	, faintBodiesFrame(0)
+	, flagDormantMinorBodies(true)
+	, dormantObserverDistance(-1.)
+	, dormantBrightestMag(-100.f)
 	, flagOrbits(false)
 	, flagLightTravelTime(false)
 	, flagShow(false)
 	, flagMarker(false)
 	, allTrails(NULL)
+	, orbitDrawer(NULL)
 {
 	planetNameFont.setPixelSize(StelApp::getInstance().getSettings()->value("gui/base_font_size", 13).toInt());
 	setObjectName("SolarSystem");
@@ -87,6 +110,7 @@ SolarSystem::~SolarSystem()
 		delete orb;
 		orb = NULL;
 	}
+	qDeleteAll(ephemerisCaches);
 	sun.clear();
 	moon.clear();
 	earth.clear();
@@ -95,6 +119,8 @@ SolarSystem::~SolarSystem()
 
 	delete allTrails;
 	allTrails = NULL;
+	delete orbitDrawer;
+	orbitDrawer = NULL;
 
 	// Get rid of circular reference between the shared pointers which prevent proper destruction of the Planet objects.
 	foreach (PlanetP p, systemPlanets)
@@ -113,12 +139,31 @@ double SolarSystem::getCallOrder(StelModuleActionName actionName) const
 	return 0;
 }
 
+qint64 SolarSystem::getMemoryUsed() const
+{
+	// The subclasses of Planet only add a few members, the orbits are stored in the objects
+	qint64 total = systemPlanets.size()*(qint64)(sizeof(Planet)+sizeof(PlanetP)+2*sizeof(void*));
+	total += drawOrder.capacity()*(qint64)sizeof(Planet*) + faintBodies.capacity()*(qint64)sizeof(FaintBody);
+	total += indexedBodies.capacity()*(qint64)sizeof(PlanetP);
+	total += dormantBodies.capacity()*(qint64)sizeof(DormantMinorBody);
+	// A node of the hash per dormant body, with the QString header and the UTF-16 name
+	for (QHash<QString, int>::ConstIterator i=dormantIndices.constBegin(); i!=dormantIndices.constEnd(); ++i)
+		total += 2*sizeof(void*)+sizeof(uint)+sizeof(QString)+sizeof(int) + 24 + i.key().size()*sizeof(ushort);
+	return total;
+}
+
 // Init and load the solar system data
 void SolarSystem::init()
 {
 	QSettings* conf = StelApp::getInstance().getSettings();
 	Q_ASSERT(conf);
 
+	flagParallelComputation = conf->value("astro/flag_parallel_planet_positions", true).toBool();
+	flagEphemerisCache = conf->value("astro/flag_ephemeris_cache", false).toBool();
+	ephemerisCacheWindow = conf->value("astro/ephemeris_cache_window", 4.).toDouble();
+	flagBatchOrbits = conf->value("astro/flag_batch_orbit_solver", true).toBool();
+	flagSkipFaintBodies = conf->value("astro/flag_skip_faint_minor_planets", true).toBool();
+	flagDormantMinorBodies = conf->value("astro/flag_dormant_minor_planets", true).toBool();
 	loadPlanets();	// Load planets data
 
 	// Compute position and matrix of sun and all the satellites (ie planets)
@@ -135,6 +180,8 @@ void SolarSystem::init()
 	setFlagOrbits(conf->value("astro/flag_planets_orbits").toBool());
 	setFlagLightTravelTime(conf->value("astro/flag_light_travel_time", false).toBool());
 	setFlagMarkers(conf->value("astro/flag_planets_markers", true).toBool());
+	if (conf->value("astro/flag_gpu_orbits", true).toBool())
+		orbitDrawer = new OrbitGpuDrawer();
 
 	recreateTrails();
 
@@ -232,6 +279,10 @@ void cometOrbitPosFunc(double jd,double xyz[3], void* userDataPtr)
 void SolarSystem::loadPlanets()
 {
 	qDebug() << "Loading Solar System data ...";
+	QWriteLocker locker(getNameSearchLock());
+	dormantBodies.clear();
+	dormantIndices.clear();
+	dormantObserverDistance = -1.;
 	QStringList solarSystemFiles = StelFileMgr::findFileInAllPaths("data/ssystem.ini");
 	if (solarSystemFiles.isEmpty())
 	{
@@ -255,6 +306,9 @@ void SolarSystem::loadPlanets()
 				p.clear();
 			}
 			systemPlanets.clear();
+			drawOrder.clear();
+			if (orbitDrawer)
+				orbitDrawer->clear();
 			//Memory leak? What's the proper way of cleaning shared pointers?
 
 			//If the file is in the user data directory, rename it:
@@ -272,11 +326,70 @@ void SolarSystem::loadPlanets()
 		}
 	}
 
+	// The large sets of minor bodies are stored in binary databases rather than in ssystem.ini
+	if (sun)
+	{
+		foreach (const QString& minorBodiesFile, StelFileMgr::findFileInAllPaths("data/minor_bodies.dat"))
+			loadMinorBodies(minorBodiesFile);
+	}
+
 	shadowPlanetCount = 0;
 
 	foreach (const PlanetP& planet, systemPlanets)
 		if(planet->parent != sun || !planet->satellites.isEmpty())
 			shadowPlanetCount++;
+
+	buildComputeSchedule();
+	updateNamesIndexes();
+
+	drawOrder.clear();
+	foreach (const PlanetP& p, systemPlanets)
+		drawOrder.append(p.data());
+}
+
+void SolarSystem::buildComputeSchedule()
+{
+	// Only the bodies with their own orbit object can be computed concurrently,
+	// the analytical theories (VSOP87, ELP82B...) keep shared static caches.
+	QSet<const void*> orbitPtrs;
+	QHash<const void*, CometOrbit*> cometOrbits;
+	foreach (Orbit* orb, orbits)
+	{
+		orbitPtrs.insert(orb);
+		CometOrbit* cometOrbit = dynamic_cast<CometOrbit*>(orb);
+		if (cometOrbit)
+			cometOrbits.insert(orb, cometOrbit);
+	}
+
+	computeSchedule.clear();
+	faintBodies.clear();
+	faintBodiesObserverDistance = -1.;
+	foreach (const PlanetP& p, systemPlanets)
+	{
+		int depth = 0;
+		for (PlanetP parent = p->parent; parent; parent = parent->parent)
+			++depth;
+		if (computeSchedule.size()<=depth)
+			computeSchedule.resize(depth+1);
+		if (p->osculatingFunc==NULL && orbitPtrs.contains(p->userDataPtr))
+		{
+			computeSchedule[depth].concurrent.append(p);
+			if (p->coordFunc==&cometOrbitPosFunc && cometOrbits.contains(p->userDataPtr))
+			{
+				computeSchedule[depth].batched.append(p.data());
+				computeSchedule[depth].batchedOrbits.append(cometOrbits.value(p->userDataPtr));
+			}
+			MinorPlanet* minorPlanet = dynamic_cast<MinorPlanet*>(p.data());
+			if (minorPlanet && cometOrbits.contains(p->userDataPtr))
+			{
+				const CometOrbit* orb = cometOrbits.value(p->userDataPtr);
+				FaintBody faintBody = {minorPlanet, orb->getPericenterDistance(), orb->getApocenterDistance(), -100.f};
+				faintBodies.append(faintBody);
+			}
+		}
+		else
+			computeSchedule[depth].serial.append(p);
+	}
 }
 
 bool SolarSystem::loadPlanets(const QString& filePath)
@@ -719,6 +832,15 @@ bool SolarSystem::loadPlanets(const QString& filePath)
 			exit(-1);
 		}
 
+		// Put a cache in front of the analytical theories, which are expensive to evaluate
+		if (flagEphemerisCache && userDataPtr==NULL && funcName!="sun_special")
+		{
+			EphemerisCache* cache = new EphemerisCache(posfunc, ephemerisCacheWindow);
+			ephemerisCaches.append(cache);
+			posfunc = &EphemerisCache::staticPosFunc;
+			userDataPtr = cache;
+		}
+
 		// Create the Solar System body and add it to the list
 		QString type = pd.value(secname+"/type").toString();		
 		PlanetP p;
@@ -908,30 +1030,370 @@ bool SolarSystem::loadPlanets(const QString& filePath)
 	return true;
 }
 
+int SolarSystem::loadMinorBodies(const QString& filePath)
+{
+	MinorBodyStore store;
+	if (!store.open(filePath))
+		return 0;
+
+	QSet<QString> loadedNames;
+	foreach (const PlanetP& p, systemPlanets)
+		loadedNames.insert(p->getEnglishName());
+
+	int nbLoaded = 0;
+	int nbDormant = 0;
+	for (int i=0;i<store.size();++i)
+	{
+		const QString englishName = store.getName(i);
+		if (englishName.isEmpty() || loadedNames.contains(englishName) || dormantIndices.contains(englishName))
+			continue;
+		const MinorBodyStore::Record r = store.getRecord(i);
+		++nbLoaded;
+
+		// Only the asteroids on closed orbits have a bound of their magnitude, see MinorPlanet::getBrightestVMagnitude()
+		if (flagDormantMinorBodies && r.type!=MinorBodyStore::Comet && r.eccentricity<1.
+		    && r.absoluteMagnitude>-99 && r.slopeParameter>=0 && r.slopeParameter<=1)
+		{
+			DormantMinorBody d;
+			d.record = r;
+			d.perihelion = r.pericenterDistance;
+			d.aphelion = r.pericenterDistance*(1.+r.eccentricity)/(1.-r.eccentricity);
+			d.brightestMag = -100.f;
+			dormantIndices.insert(englishName, dormantBodies.size());
+			dormantBodies.append(d);
+			++nbDormant;
+			continue;
+		}
+
+		loadedNames.insert(englishName);
+		systemPlanets.push_back(createMinorBody(r));
+	}
+
+	qDebug() << "Loaded" << nbLoaded << "minor bodies from" << QDir::toNativeSeparators(filePath)
+		 << "," << nbDormant << "of them are dormant until they become visible";
+	return nbLoaded;
+}
+
+PlanetP SolarSystem::createMinorBody(const MinorBodyStore::Record& r)
+{
+	// The parent is the Sun, so the orbit is in the ecliptic frame
+	CometOrbit *orb = new CometOrbit(r.pericenterDistance,
+					 r.eccentricity,
+					 r.inclination,
+					 r.ascendingNode,
+					 r.argOfPericenter,
+					 r.timeAtPericenter,
+					 r.orbitGoodDays,
+					 r.meanMotion,
+					 0., 0., 0.);
+	orbits.push_back(orb);
+	const bool closeOrbit = r.eccentricity < 1.0;
+
+	PlanetP p;
+	if (r.type == MinorBodyStore::Comet)
+	{
+		QSharedPointer<Comet> comet(new Comet(r.name, false, r.radius/AU, 0.0, Vec3f(1.f, 1.f, 1.f),
+						      r.albedo, "nomap.png", &cometOrbitPosFunc, orb, NULL,
+						      closeOrbit, false, "comet", 1.5f, 0.4f, 1.5f));
+		if (r.absoluteMagnitude > -99)
+			comet->setAbsoluteMagnitudeAndSlope(r.absoluteMagnitude, (r.slopeParameter >= 0 && r.slopeParameter <= 20) ? r.slopeParameter : 4.0);
+		p = comet;
+	}
+	else
+	{
+		QSharedPointer<MinorPlanet> mp(new MinorPlanet(r.name, false, r.radius/AU, 0.0, Vec3f(1.f, 1.f, 1.f),
+							       r.albedo, "nomap.png", &cometOrbitPosFunc, orb, NULL,
+							       closeOrbit, false,
+							       r.type == MinorBodyStore::Plutoid ? "plutoid" : "asteroid"));
+		if (r.minorPlanetNumber)
+			mp->setMinorPlanetNumber(r.minorPlanetNumber);
+		if (!r.provisionalDesignation.isEmpty())
+			mp->setProvisionalDesignation(r.provisionalDesignation);
+		if (r.absoluteMagnitude > -99)
+			mp->setAbsoluteMagnitudeAndSlope(r.absoluteMagnitude, (r.slopeParameter >= 0 && r.slopeParameter <= 1) ? r.slopeParameter : 0.15);
+		mp->setSemiMajorAxis(r.semiMajorAxis);
+		p = mp;
+	}
+
+	sun->satellites.append(p);
+	p->parent = sun;
+	// Same defaults as for the bodies of ssystem.ini without rotation elements
+	p->setRotationElements(1., 0., J2000, 0., 0., 0., 0.);
+	return p;
+}
+
+void SolarSystem::updateDormantBodies(const Vec3d& observerPos)
+{
+	// Same margin as for the faint bodies, so that the bodies are woken before they can be seen
+	static const float magMargin = 1.f;
+	const StelCore* core = StelApp::getInstance().getCore();
+	if (dormantBodies.isEmpty() || !core->getSkyDrawer())
+		return;
+
+	const double observerDistance = observerPos.length();
+	const bool boundsChanged = dormantObserverDistance<0. || fabs(observerDistance-dormantObserverDistance)>0.01*dormantObserverDistance;
+	if (boundsChanged)
+	{
+		dormantBrightestMag = 100.f;
+		for (int i=0; i<dormantBodies.size(); ++i)
+		{
+			DormantMinorBody& d = dormantBodies[i];
+			if (d.planet)
+				continue;
+			d.brightestMag = MinorPlanet::getBrightestVMagnitude(d.record.absoluteMagnitude, d.record.slopeParameter,
+									     d.perihelion, d.aphelion, observerDistance);
+			dormantBrightestMag = qMin(dormantBrightestMag, d.brightestMag);
+		}
+		dormantObserverDistance = observerDistance;
+	}
+
+	// Most of the time no dormant body can reach the limiting magnitude, which avoids going through the list
+	const float maxMag = qMax(core->getSkyDrawer()->getLimitMagnitude(), getMaxMagLabel(core))+magMargin;
+	if (maxMag < dormantBrightestMag)
+		return;
+
+	QVector<int> wake;
+	dormantBrightestMag = 100.f;
+	for (int i=0; i<dormantBodies.size(); ++i)
+	{
+		const DormantMinorBody& d = dormantBodies.at(i);
+		if (d.planet)
+			continue;
+		if (d.brightestMag <= maxMag)
+			wake.append(i);
+		else
+			dormantBrightestMag = qMin(dormantBrightestMag, d.brightestMag);
+	}
+	wakeDormantBodies(wake, false);
+}
+
+void SolarSystem::wakeDormantBodies(const QVector<int>& indices, bool computeNow)
+{
+	if (indices.isEmpty())
+		return;
+
+	const StelTranslator& trans = StelApp::getInstance().getLocaleMgr().getAppStelTranslator();
+	const double date = StelApp::getInstance().getCore()->getJDay();
+	// The searches of names read the bodies
+	QWriteLocker locker(getNameSearchLock());
+	foreach (int i, indices)
+	{
+		DormantMinorBody& d = dormantBodies[i];
+		if (d.planet)
+			continue;
+		d.planet = createMinorBody(d.record);
+		d.planet->translateName(trans);
+		if (computeNow)
+			d.planet->computePosition(date);
+		systemPlanets.append(d.planet);
+		drawOrder.append(d.planet.data());
+	}
+	// The names indexes still refer to the bodies by their positions in dormantBodies
+	buildComputeSchedule();
+}
+
+PlanetP SolarSystem::wakeDormantBody(const QString& englishName) const
+{
+	QHash<QString, int>::const_iterator it = dormantIndices.constFind(englishName);
+	if (it == dormantIndices.constEnd())
+		return PlanetP();
+	if (!dormantBodies.at(it.value()).planet)
+		const_cast<SolarSystem*>(this)->wakeDormantBodies(QVector<int>(1, it.value()), true);
+	return dormantBodies.at(it.value()).planet;
+}
+
+//! Functor computing the position of one body, used for both the serial and concurrent computations.
+struct ComputePlanetPosition
+{
+	typedef void result_type;
+	enum Pass
+	{
+		PassGeometric,		//!< Position and orbit at the given date
+		PassWithoutOrbits,	//!< First pass of the light travel time correction
+		PassLightTravelTime	//!< Position and orbit at the date corrected for light travel time
+	};
+	ComputePlanetPosition(double date, const Vec3d& observerPos, int pass)
+		: date(date), observerPos(observerPos), pass(pass) {}
+	//! The date at which the position of a body is computed in this pass.
+	double getDate(const Planet* p) const
+	{
+		if (pass!=PassLightTravelTime)
+			return date;
+		const double light_speed_correction = (p->getHeliocentricEclipticPos()-observerPos).length() * (AU / (SPEED_OF_LIGHT * 86400));
+		return date-light_speed_correction;
+	}
+	void operator()(const PlanetP& p) const
+	{
+		if (p->skipPositionUpdate)
+			return;
+		if (pass==PassWithoutOrbits)
+			p->computePositionWithoutOrbits(date);
+		else
+			p->computePosition(getDate(p.data()));
+	}
+	double date;
+	Vec3d observerPos;
+	int pass;
+};
+
 // Compute the position for every elements of the solar system.
-// The order is not important since the position is computed relatively to the mother body
+// The bodies are computed one hierarchy level after the other since the position
+// is relative to the mother body and the orbits use the heliocentric position of the parent.
 void SolarSystem::computePositions(double date, const Vec3d& observerPos)
 {
+	STEL_TRACE_SCOPE("SolarSystem::computePositions");
+	updateDormantBodies(observerPos);
+	updateFaintBodies(observerPos);
 	if (flagLightTravelTime)
 	{
-		foreach (PlanetP p, systemPlanets)
+		computeScheduledPositions(date, observerPos, ComputePlanetPosition::PassWithoutOrbits);
+		computeScheduledPositions(date, observerPos, ComputePlanetPosition::PassLightTravelTime);
+	}
+	else
+	{
+		computeScheduledPositions(date, observerPos, ComputePlanetPosition::PassGeometric);
+	}
+	prefetchEphemerides(date);
+	computeTransMatrices(date, observerPos);
+	// The magnitudes and sizes are computed again on their first use with the new positions
+	Planet::invalidatePhotometry();
+}
+
+void SolarSystem::prefetchEphemerides(double date)
+{
+	if (ephemerisCaches.isEmpty())
+		return;
+	// The speed is measured between the frames, so that the scrubbing of the date is followed too
+	const qint64 elapsed = prefetchTimer.isValid() ? prefetchTimer.restart() : 0;
+	if (elapsed<=0)
+	{
+		prefetchTimer.start();
+		prefetchDate = date;
+		return;
+	}
+	const double rate = (date-prefetchDate)*1000./elapsed;
+	prefetchDate = date;
+	StelJobSystem* jobs = StelApp::getInstance().getJobSystem();
+	foreach (EphemerisCache* cache, ephemerisCaches)
+		cache->prefetch(date, rate, jobs);
+}
+
+void SolarSystem::computeScheduledPositions(double date, const Vec3d& observerPos, int pass)
+{
+	// Below this number of bodies the thread pool overhead is not worth it
+	static const int minConcurrentBodies = 16;
+	const ComputePlanetPosition compute(date, observerPos, pass);
+	for (int i=0; i<computeSchedule.size(); ++i)
+	{
+		ComputeLevel& level = computeSchedule[i];
+		if (flagBatchOrbits && !level.batched.isEmpty())
+			computeBatchedPositions(level, compute);
+		foreach (const PlanetP& p, level.serial)
+			compute(p);
+		if (flagParallelComputation && level.concurrent.size()>=minConcurrentBodies)
 		{
-			p->computePositionWithoutOrbits(date);
+			// Each body only writes its own members, and only reads its already computed parents
+			StelApp::getInstance().getJobSystem()->blockingMap(level.concurrent, compute, minConcurrentBodies/2);
 		}
-		foreach (PlanetP p, systemPlanets)
+		else
 		{
-			const double light_speed_correction = (p->getHeliocentricEclipticPos()-observerPos).length() * (AU / (SPEED_OF_LIGHT * 86400));
-			p->computePosition(date-light_speed_correction);
+			foreach (const PlanetP& p, level.concurrent)
+				compute(p);
 		}
 	}
-	else
+}
+
+void SolarSystem::updateFaintBodies(const Vec3d& observerPos)
+{
+	// Margin above the limiting magnitude, and number of frames between two updates of the skipped bodies
+	static const float magMargin = 1.f;
+	static const int skippedUpdateInterval = 16;
+	if (faintBodies.isEmpty())
+		return;
+
+	// The bounds only need to be computed again when the observer moves away from the sun
+	const double observerDistance = observerPos.length();
+	if (faintBodiesObserverDistance<0. || fabs(observerDistance-faintBodiesObserverDistance)>0.01*faintBodiesObserverDistance)
 	{
-		foreach (PlanetP p, systemPlanets)
+		for (int i=0; i<faintBodies.size(); ++i)
 		{
-			p->computePosition(date);
+			FaintBody& f = faintBodies[i];
+			f.brightestMag = f.body->getBrightestVMagnitude(f.perihelion, f.aphelion, observerDistance);
 		}
+		faintBodiesObserverDistance = observerDistance;
+	}
+
+	// The trails and orbits of the faint bodies are drawn, so their positions are needed
+	const StelCore* core = StelApp::getInstance().getCore();
+	const bool canSkip = flagSkipFaintBodies && core->getSkyDrawer() && trailFader.getInterstate()<=0.f;
+	const float maxMag = canSkip ? qMax(core->getSkyDrawer()->getLimitMagnitude(), getMaxMagLabel(core))+magMargin : 0.f;
+	++faintBodiesFrame;
+	for (int i=0; i<faintBodies.size(); ++i)
+	{
+		const FaintBody& f = faintBodies.at(i);
+		// Spread the low frequency updates of the skipped bodies over the frames
+		f.body->skipPositionUpdate = canSkip && f.brightestMag>maxMag && f.body->orbitFader.getInterstate()<=0.f
+				&& f.body!=selected.data() && (i+faintBodiesFrame)%skippedUpdateInterval!=0;
 	}
-	computeTransMatrices(date, observerPos);
+}
+
+// A part of the orbits computed by computeBatchedPositions() on one thread.
+struct BatchedOrbitsSlice
+{
+	CometOrbit* const* orbits;
+	const double* dates;
+	Vec3d* positions;
+	int count;
+};
+
+static void computeBatchedOrbitsSlice(BatchedOrbitsSlice& slice)
+{
+	CometOrbit::positionsAtTimesInVSOP87Coordinates(slice.orbits, slice.dates, slice.count, slice.positions);
+}
+
+void SolarSystem::computeBatchedPositions(const ComputeLevel& level, const ComputePlanetPosition& compute)
+{
+	// Number of orbits computed by each task of the thread pool
+	static const int sliceSize = 4096;
+
+	// Only the bodies whose position at their date is not cached yet are computed
+	batchPlanets.clear();
+	batchOrbits.clear();
+	batchDates.clear();
+	for (int i=0; i<level.batched.size(); ++i)
+	{
+		Planet* p = level.batched.at(i);
+		if (p->skipPositionUpdate)
+			continue;
+		const double date = compute.getDate(p);
+		if (p->hasCachedPosition(date))
+			continue;
+		batchPlanets.append(p);
+		batchOrbits.append(level.batchedOrbits.at(i));
+		batchDates.append(date);
+	}
+	const int count = batchPlanets.size();
+	if (count==0)
+		return;
+	batchPositions.resize(count);
+
+	if (flagParallelComputation && count>sliceSize)
+	{
+		QVector<BatchedOrbitsSlice> slices;
+		for (int first=0; first<count; first+=sliceSize)
+		{
+			BatchedOrbitsSlice slice = {batchOrbits.constData()+first, batchDates.constData()+first, batchPositions.data()+first, qMin(sliceSize, count-first)};
+			slices.append(slice);
+		}
+		StelApp::getInstance().getJobSystem()->blockingMap(slices, computeBatchedOrbitsSlice);
+	}
+	else
+	{
+		CometOrbit::positionsAtTimesInVSOP87Coordinates(batchOrbits.constData(), batchDates.constData(), count, batchPositions.data());
+	}
+
+	for (int i=0; i<count; ++i)
+		batchPlanets.at(i)->cachePosition(batchDates.at(i), batchPositions.at(i));
 }
 
 // Compute the transformation matrix for every elements of the solar system.
@@ -940,7 +1402,7 @@ void SolarSystem::computeTransMatrices(double date, const Vec3d& observerPos)
 {
 	if (flagLightTravelTime)
 	{
-		foreach (PlanetP p, systemPlanets)
+		foreach (const PlanetP& p, systemPlanets)
 		{
 			const double light_speed_correction = (p->getHeliocentricEclipticPos()-observerPos).length() * (AU / (SPEED_OF_LIGHT * 86400));
 			p->computeTransMatrix(date-light_speed_correction);
@@ -948,7 +1410,7 @@ void SolarSystem::computeTransMatrices(double date, const Vec3d& observerPos)
 	}
 	else
 	{
-		foreach (PlanetP p, systemPlanets)
+		foreach (const PlanetP& p, systemPlanets)
 		{
 			p->computeTransMatrix(date);
 		}
@@ -956,14 +1418,42 @@ void SolarSystem::computeTransMatrices(double date, const Vec3d& observerPos)
 }
 
 // And sort them from the furthest to the closest to the observer
-struct biggerDistance : public std::binary_function<PlanetP, PlanetP, bool>
+struct biggerDistance : public std::binary_function<const Planet*, const Planet*, bool>
 {
-	bool operator()(PlanetP p1, PlanetP p2)
+	bool operator()(const Planet* p1, const Planet* p2) const
 	{
 		return p1->getDistance() > p2->getDistance();
 	}
 };
 
+void SolarSystem::sortDrawOrder()
+{
+	// The order changes little from one frame to the next, so an insertion sort is nearly linear.
+	// After a jump in time or space it would be quadratic, so a full sort is done past this many moves per body.
+	static const int maxMovesPerBody = 8;
+	const int n = drawOrder.size();
+	Planet** bodies = drawOrder.data();
+	qint64 movesLeft = (qint64)maxMovesPerBody*n;
+	for (int i=1; i<n; ++i)
+	{
+		Planet* p = bodies[i];
+		const double distance = p->getDistance();
+		int j = i;
+		while (j>0 && bodies[j-1]->getDistance()<distance)
+		{
+			bodies[j] = bodies[j-1];
+			--j;
+			--movesLeft;
+		}
+		bodies[j] = p;
+		if (movesLeft<0)
+		{
+			std::stable_sort(drawOrder.begin(), drawOrder.end(), biggerDistance());
+			return;
+		}
+	}
+}
+
 // Draw all the elements of the solar system
 // We are supposed to be in heliocentric coordinate
 void SolarSystem::draw(StelCore* core)
@@ -974,13 +1464,13 @@ void SolarSystem::draw(StelCore* core)
 	// Compute each Planet distance to the observer
 	Vec3d obsHelioPos = core->getObserverHeliocentricEclipticPos();
 
-	foreach (PlanetP p, systemPlanets)
+	for (int i=0; i<drawOrder.size(); ++i)
 	{
-		p->computeDistance(obsHelioPos);
+		drawOrder.at(i)->computeDistance(obsHelioPos);
 	}
 
 	// And sort them from the furthest to the closest
-	sort(systemPlanets.begin(),systemPlanets.end(),biggerDistance());
+	sortDrawOrder();
 
 	if (trailFader.getInterstate()>0.0000001f)
 	{
@@ -990,20 +1480,92 @@ void SolarSystem::draw(StelCore* core)
 		delete sPainter;
 	}
 
-	// Make some voodoo to determine when labels should be displayed
-	float maxMagLabel = (core->getSkyDrawer()->getLimitMagnitude()<5.f ? core->getSkyDrawer()->getLimitMagnitude() :
-			5.f+(core->getSkyDrawer()->getLimitMagnitude()-5.f)*1.2f) +(labelsAmount-3.f)*1.2f;
+	const float maxMagLabel = getMaxMagLabel(core);
+
+	// Draw the orbits first so that the bodies are drawn over them
+	drawOrbits(core);
 
 	// Draw the elements
-	foreach (const PlanetP& p, systemPlanets)
+	haloPixPerRad = core->getProjection(StelCore::FrameJ2000)->getPixelPerRadAtCenter();
+	for (int i=0; i<drawOrder.size(); ++i)
 	{
-		p->draw(core, maxMagLabel, planetNameFont);
+		drawOrder.at(i)->draw(core, maxMagLabel, planetNameFont);
 	}
+	flushPointSourceHalos(core);
 
 	if (GETSTELMODULE(StelObjectMgr)->getFlagSelectedObjectPointer() && getFlagMarkers())
 		drawPointer(core);
 }
 
+void SolarSystem::addPointSourceHalo(StelCore* core, const Vec3f& pos, float illuminatedArea, float mag, const Vec3f& color)
+{
+	RCMag rcm;
+	if (!core->getSkyDrawer()->computeSky3dModelHalo(haloPixPerRad, illuminatedArea, mag, &rcm))
+		return;
+	PointSourceHalo halo;
+	halo.pos = pos;
+	halo.radius = rcm.radius;
+	halo.luminance = rcm.luminance;
+	halo.color = color;
+	pendingHalos.append(halo);
+}
+
+void SolarSystem::flushPointSourceHalos(StelCore* core)
+{
+	if (pendingHalos.isEmpty())
+		return;
+
+	StelSkyDrawer* skyDrawer = core->getSkyDrawer();
+	StelPainter sPainter(core->getProjection(StelCore::FrameJ2000));
+	// The halos of the 3D models never twinkle
+	const bool saveTwinkle = skyDrawer->getFlagTwinkle();
+	skyDrawer->setFlagTwinkle(false);
+	skyDrawer->preDrawPointSource(&sPainter);
+	RCMag rcm;
+	for (int i=0; i<pendingHalos.size(); ++i)
+	{
+		const PointSourceHalo& halo = pendingHalos.at(i);
+		rcm.radius = halo.radius;
+		rcm.luminance = halo.luminance;
+		skyDrawer->drawPointSource(&sPainter, halo.pos, rcm, halo.color);
+	}
+	skyDrawer->postDrawPointSource(&sPainter);
+	skyDrawer->setFlagTwinkle(saveTwinkle);
+	pendingHalos.clear();
+}
+
+float SolarSystem::getMaxMagLabel(const StelCore* core) const
+{
+	// Make some voodoo to determine when labels should be displayed
+	return (core->getSkyDrawer()->getLimitMagnitude()<5.f ? core->getSkyDrawer()->getLimitMagnitude() :
+			5.f+(core->getSkyDrawer()->getLimitMagnitude()-5.f)*1.2f) +(labelsAmount-3.f)*1.2f;
+}
+
+void SolarSystem::drawOrbits(StelCore* core)
+{
+	const StelProjectorP prj = core->getProjection(StelCore::FrameHeliocentricEcliptic);
+	bool useDrawer = orbitDrawer!=NULL;
+	bool begun = false;
+	for (int i=0; i<drawOrder.size(); ++i)
+	{
+		Planet* p = drawOrder.at(i);
+		if (!p->hasVisibleOrbit(core, prj))
+			continue;
+		// The drawer is only started if there is an orbit to draw
+		if (useDrawer && !begun)
+		{
+			begun = orbitDrawer->begin(core);
+			useDrawer = begun;
+		}
+		if (useDrawer)
+			orbitDrawer->drawOrbit(p);
+		else
+			p->drawOrbit(core);
+	}
+	if (begun)
+		orbitDrawer->end();
+}
+
 void SolarSystem::setStelStyle(const QString& section)
 {
 	// Load colors from config file
@@ -1025,7 +1587,7 @@ PlanetP SolarSystem::searchByEnglishName(QString planetEnglishName) const
 		if (p->getEnglishName() == planetEnglishName)
 			return p;
 	}
-	return PlanetP();
+	return wakeDormantBody(planetEnglishName);
 }
 
 StelObjectP SolarSystem::searchByNameI18n(const QString& planetNameI18) const
@@ -1035,7 +1597,8 @@ StelObjectP SolarSystem::searchByNameI18n(const QString& planetNameI18) const
 		if (p->getNameI18n() == planetNameI18)
 			return qSharedPointerCast<StelObject>(p);
 	}
-	return StelObjectP();
+	// The names of the dormant bodies are not translated
+	return qSharedPointerCast<StelObject>(wakeDormantBody(planetNameI18));
 }
 
 
@@ -1046,7 +1609,7 @@ StelObjectP SolarSystem::searchByName(const QString& name) const
 		if (p->getEnglishName() == name)
 			return qSharedPointerCast<StelObject>(p);
 	}
-	return StelObjectP();
+	return qSharedPointerCast<StelObject>(wakeDormantBody(name));
 }
 
 float SolarSystem::getPlanetVMagnitude(QString planetName) const
@@ -1144,12 +1707,72 @@ QList<StelObjectP> SolarSystem::searchAround(const Vec3d& vv, double limitFov, c
 	return result;
 }
 
-// Update i18 names from english names according to current translator
+// Update i18 names from english names according to current translator.
+// With thousands of minor bodies translating all of them at once stalls the change of
+// the language, so the names are only translated when they are first displayed or searched.
 void SolarSystem::updateI18n()
 {
-	const StelTranslator& trans = StelApp::getInstance().getLocaleMgr().getAppStelTranslator();
-	foreach (PlanetP p, systemPlanets)
-		p->translateName(trans);
+	QWriteLocker locker(getNameSearchLock());
+	Planet::invalidateTranslations();
+	flagNamesIndexI18nValid = false;
+}
+
+void SolarSystem::updateNamesIndexes()
+{
+	QWriteLocker locker(getNameSearchLock());
+	namesIndex.clear();
+	indexedBodies.clear();
+	foreach (const PlanetP& p, systemPlanets)
+	{
+		// The dormant bodies which already woke up are indexed with the others below
+		if (dormantIndices.contains(p->getEnglishName()))
+			continue;
+		namesIndex.insert(p->getEnglishName(), indexedBodies.size());
+		indexedBodies.append(p);
+	}
+	// The dormant bodies are indexed by -1-(position in dormantBodies), which stays valid when they wake up
+	for (int i=0;i<dormantBodies.size();++i)
+		namesIndex.insert(dormantBodies.at(i).record.name, -1-i);
+	flagNamesIndexI18nValid = false;
+}
+
+void SolarSystem::ensureNamesIndexI18n() const
+{
+	if (flagNamesIndexI18nValid)
+		return;
+	QWriteLocker locker(getNameSearchLock());
+	namesIndexI18n.clear();
+	for (int i=0;i<indexedBodies.size();++i)
+		namesIndexI18n.insert(indexedBodies.at(i)->getNameI18n(), i);
+	for (int i=0;i<dormantBodies.size();++i)
+	{
+		const DormantMinorBody& d = dormantBodies.at(i);
+		if (d.planet)
+			namesIndexI18n.insert(d.planet->getNameI18n(), -1-i);
+		else
+			namesIndexI18n.insert(d.record.name, -1-i);
+	}
+	flagNamesIndexI18nValid = true;
+}
+
+void SolarSystem::prepareNameSearch(bool useStartOfWords)
+{
+	ensureNamesIndexI18n();
+	if (namesIndexI18n.isPrepared(!useStartOfWords) && namesIndex.isPrepared(!useStartOfWords))
+		return;
+	QWriteLocker locker(getNameSearchLock());
+	namesIndexI18n.prepare(!useStartOfWords);
+	namesIndex.prepare(!useStartOfWords);
+}
+
+QString SolarSystem::getIndexedName(int value, bool i18n) const
+{
+	if (value>=0)
+		return i18n ? indexedBodies.at(value)->getNameI18n() : indexedBodies.at(value)->getEnglishName();
+	const DormantMinorBody& d = dormantBodies.at(-1-value);
+	if (d.planet)
+		return i18n ? d.planet->getNameI18n() : d.planet->getEnglishName();
+	return d.record.name;
 }
 
 QString SolarSystem::getPlanetHashString(void)
@@ -1258,10 +1881,55 @@ void SolarSystem::update(double deltaTime)
 		allTrails->update();
 	}
 
-	foreach (PlanetP p, systemPlanets)
+	foreach (const PlanetP& p, systemPlanets)
 	{
 		p->update((int)(deltaTime*1000));
 	}
+
+	computeSolarEclipseFactor(StelApp::getInstance().getCore());
+}
+
+void SolarSystem::computeSolarEclipseFactor(const StelCore* core)
+{
+	solarEclipseFactor = 1.f;
+	if (!sun || !moon)
+		return;
+	Vec3d sunPos = sun->getAltAzPosApparent(core);
+	Vec3d moonPos = moon->getAltAzPosApparent(core);
+	// The positions are not defined yet
+	if (sunPos.length()!=sunPos.length() || moonPos.length()!=moonPos.length())
+		return;
+
+	// these are for radii
+	const float sun_angular_size = atan(696000.f/AU/sunPos.length());
+	const float moon_angular_size = atan(1738.f/AU/moonPos.length());
+	const float touch_angle = sun_angular_size + moon_angular_size;
+
+	// determine luminance falloff during solar eclipses
+	sunPos.normalize();
+	moonPos.normalize();
+	float separation_angle = std::acos(qBound(-1., sunPos.dot(moonPos), 1.));  // angle between them
+	// bright stars should be visible at total eclipse
+	// TODO: correct for atmospheric diffusion
+	// TODO: use better coverage function (non-linear)
+	// because of above issues, this algorithm darkens more quickly than reality
+	if (separation_angle < touch_angle)
+	{
+		float dark_angle = moon_angular_size - sun_angular_size;
+		float min = 0.0001f;  // so bright stars show up at total eclipse
+		if (dark_angle < 0.f)
+		{
+			// annular eclipse
+			float asun = sun_angular_size*sun_angular_size;
+			min = (asun - moon_angular_size*moon_angular_size)/asun;  // minimum proportion of sun uncovered
+			dark_angle *= -1;
+		}
+
+		if (separation_angle < dark_angle)
+			solarEclipseFactor = min;
+		else
+			solarEclipseFactor = min + (1.f-min)*(separation_angle-dark_angle)/(touch_angle-dark_angle);
+	}
 }
 
 
@@ -1296,32 +1964,13 @@ QStringList SolarSystem::listMatchingObjectsI18n(const QString& objPrefix, int m
 	if (maxNbItem==0)
 		return result;
 
-	QString sson;
-	bool find;
-	foreach (const PlanetP& p, systemPlanets)
-	{
-		sson = p->getNameI18n();
-		find = false;
-		if (useStartOfWords)
-		{
-			QString constw = sson.mid(0, objPrefix.size()).toUpper();
-			if (constw==objPrefix.toUpper())
-				find = true;
-		}
-		else
-		{
-			if (sson.contains(objPrefix, Qt::CaseInsensitive))
-				find = true;
-
-		}
-		if (find)
-		{
-			result << sson;
-			if (result.size()==maxNbItem)
-				return result;
-		}
-
-	}
+	// In the thread pool the index built by prepareNameSearch() is only read
+	if (QThread::currentThread()==thread())
+		ensureNamesIndexI18n();
+	else if (!flagNamesIndexI18nValid)
+		return result;
+	foreach (int i, namesIndexI18n.find(objPrefix, maxNbItem, useStartOfWords))
+		result << getIndexedName(i, true);
 	return result;
 }
 
@@ -1332,31 +1981,8 @@ QStringList SolarSystem::listMatchingObjects(const QString& objPrefix, int maxNb
 	if (maxNbItem==0)
 		return result;
 
-	QString sson;
-	bool find;
-	foreach (const PlanetP& p, systemPlanets)
-	{
-		sson = p->getEnglishName();
-		find = false;
-		if (useStartOfWords)
-		{
-			QString constw = sson.mid(0, objPrefix.size()).toUpper();
-			if (constw==objPrefix.toUpper())
-				find = true;
-		}
-		else
-		{
-			if (sson.contains(objPrefix, Qt::CaseInsensitive))
-				find = true;
-
-		}
-		if (find)
-		{
-			result << sson;
-			if (result.size()==maxNbItem)
-				return result;
-		}
-	}
+	foreach (int i, namesIndex.find(objPrefix, maxNbItem, useStartOfWords))
+		result << getIndexedName(i, false);
 	return result;
 }
 
@@ -1377,6 +2003,11 @@ QStringList SolarSystem::listAllObjects(bool inEnglish) const
 			result << p->getNameI18n();
 		}
 	}
+	foreach (const DormantMinorBody& d, dormantBodies)
+	{
+		if (!d.planet)
+			result << d.record.name;
+	}
 	return result;
 }
 
@@ -1431,6 +2062,11 @@ QStringList SolarSystem::getAllPlanetEnglishNames() const
 	QStringList res;
 	foreach (const PlanetP& p, systemPlanets)
 		res.append(p->englishName);
+	foreach (const DormantMinorBody& d, dormantBodies)
+	{
+		if (!d.planet)
+			res.append(d.record.name);
+	}
 	return res;
 }
 
@@ -1438,7 +2074,12 @@ QStringList SolarSystem::getAllPlanetLocalizedNames() const
 {
 	QStringList res;
 	foreach (const PlanetP& p, systemPlanets)
-		res.append(p->nameI18);
+		res.append(p->getNameI18n());
+	foreach (const DormantMinorBody& d, dormantBodies)
+	{
+		if (!d.planet)
+			res.append(d.record.name);
+	}
 	return res;
 }
 
@@ -1457,7 +2098,8 @@ void SolarSystem::reloadPlanets()
 	StelCore* core = StelApp::getInstance().getCore();
 	StelLocation loc = core->getCurrentLocation();
 
-	// Unload all Solar System objects
+	// Unload all Solar System objects, while no search of names reads them
+	QWriteLocker locker(getNameSearchLock());
 	selected.clear();//Release the selected one
 	foreach (Orbit* orb, orbits)
 	{
@@ -1465,6 +2107,8 @@ void SolarSystem::reloadPlanets()
 		orb = NULL;
 	}
 	orbits.clear();
+	qDeleteAll(ephemerisCaches);
+	ephemerisCaches.clear();
 
 	sun.clear();
 	moon.clear();
@@ -1480,6 +2124,9 @@ void SolarSystem::reloadPlanets()
 		p.clear();
 	}
 	systemPlanets.clear();
+	drawOrder.clear();
+	if (orbitDrawer)
+		orbitDrawer->clear();
 	// Memory leak? What's the proper way of cleaning shared pointers?
 
 	// Re-load the ssystem.ini file
@@ -28,10 +28,16 @@
 #include "StelObjectModule.hpp"
 #include "StelTextureTypes.hpp"
 #include "Planet.hpp"
+#include "StelNameIndex.hpp"
+#include "MinorBodyStore.hpp"
 
+#include <QElapsedTimer>
 #include <QFont>
 
 class Orbit;
+class CometOrbit;
+class MinorPlanet;
+struct ComputePlanetPosition;
 class StelTranslator;
 class StelObject;
 class StelCore;
@@ -84,6 +90,10 @@ public:
 	//! Used to determine what order to draw the various StelModules.
 	virtual double getCallOrder(StelModuleActionName actionName) const;
 
+	//! Estimate the memory used by the bodies and the dormant minor bodies.
+	//! Their textures and models are counted with the textures and the models caches.
+	virtual qint64 getMemoryUsed() const;
+
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in StelObjectManager class
 	//! Search for SolarSystem objects in some area around a point.
@@ -124,6 +134,9 @@ public:
 	virtual QStringList listMatchingObjects(const QString& objPrefix, int maxNbItem=5, bool useStartOfWords=false) const;
 	virtual QStringList listAllObjects(bool inEnglish) const;
 	virtual QString getName() const { return "Solar System"; }
+	virtual bool hasThreadSafeNameSearch() const {return true;}
+	//! Translate the names and build their indexes, so that the searches in the thread pool only read them.
+	virtual void prepareNameSearch(bool useStartOfWords);
 
 public slots:
 	///////////////////////////////////////////////////////////////////////////
@@ -275,6 +288,10 @@ public:
 	//! Determine if a lunar eclipse is close at hand?
 	bool nearLunarEclipse();
 
+	//! Get the fraction of the light of the Sun which is not hidden by the Moon for the observer,
+	//! 1 outside of the solar eclipses. It is computed once per frame by update().
+	float getSolarEclipseFactor() const {return solarEclipseFactor;}
+
 	//! Get the list of all the planet english names
 	QStringList getAllPlanetEnglishNames() const;
 
@@ -303,6 +320,17 @@ public:
 	//! \deprecated Used in LandscapeMgr::update(), but commented out.
 	const QList<PlanetP>& getAllPlanets() const {return systemPlanets;}	
 
+	//! Queue the halo of an unresolved body, to be drawn with the halos of the other bodies
+	//! in a single batch of point sources.
+	//! @param pos the position of the body in the J2000 frame.
+	//! @param illuminatedArea the illuminated area in arcmin^2.
+	//! @param mag the magnitude of the body.
+	//! @param color the halo color.
+	void addPointSourceHalo(StelCore* core, const Vec3f& pos, float illuminatedArea, float mag, const Vec3f& color);
+	//! Draw the queued halos. Called before drawing a resolved body so that the halos of the
+	//! further bodies stay behind it, and at the end of draw().
+	void flushPointSourceHalos(StelCore* core);
+
 private slots:
 	//! Called when a new object is selected.
 	void selectedObjectChange(StelModule::StelModuleSelectAction action);
@@ -326,6 +354,12 @@ private:
 	//! Draw a nice animated pointer around the object.
 	void drawPointer(const StelCore* core);
 
+	//! Draw the orbits of the visible bodies, using the orbitDrawer when possible.
+	void drawOrbits(StelCore* core);
+
+	//! Get the faintest magnitude at which the bodies are labelled.
+	float getMaxMagLabel(const StelCore* core) const;
+
 	//! Load planet data from the Solar System configuration file.
 	//! This function attempts to load every possible instance of the
 	//! Solar System configuration file in the file paths, falling back if a
@@ -335,6 +369,13 @@ private:
 	//! Load planet data from the given file
 	bool loadPlanets(const QString& filePath);
 
+	//! Load the minor bodies of a binary database (see MinorBodyStore) written by the
+	//! SolarSystemEditor plugin. The bodies already loaded from ssystem.ini are skipped.
+	//! @return the number of bodies loaded.
+	int loadMinorBodies(const QString& filePath);
+	//! Create the body and orbit of a record of a minor bodies database, as a satellite of the sun.
+	PlanetP createMinorBody(const MinorBodyStore::Record& r);
+
 	void recreateTrails();
 
 
@@ -365,6 +406,126 @@ private:
 
 	//! List of all the bodies of the solar system.
 	QList<PlanetP> systemPlanets;
+	//! The bodies of systemPlanets, sorted from the furthest to the closest to the observer when drawing.
+	QVector<Planet*> drawOrder;
+	//! Sort drawOrder by decreasing distance, assuming it is nearly sorted already.
+	void sortDrawOrder();
+
+	//! The halo of an unresolved body waiting to be drawn.
+	struct PointSourceHalo
+	{
+		Vec3f pos;
+		float radius;
+		float luminance;
+		Vec3f color;
+	};
+	QVector<PointSourceHalo> pendingHalos;
+	//! Scale of the J2000 projector for the current frame, used to compute the halos.
+	float haloPixPerRad;
+
+	//! Indexes of the names of the bodies, the values are the positions in indexedBodies, or -1-(position
+	//! in dormantBodies) for the dormant bodies, so that they don't depend on the order of systemPlanets.
+	//! The index of the translated names is only built when it is first searched on the main thread,
+	//! or by prepareNameSearch(). They are modified holding getNameSearchLock() for writing.
+	mutable StelNameIndex namesIndexI18n;
+	mutable bool flagNamesIndexI18nValid;
+	StelNameIndex namesIndex;
+	//! The bodies which were not dormant when the names indexes were built.
+	QVector<PlanetP> indexedBodies;
+	//! Rebuild the names indexes, when the bodies change.
+	void updateNamesIndexes();
+	//! Build the index of the translated names if the bodies or their translations changed.
+	//! Only called from the main thread, as it translates the names.
+	void ensureNamesIndexI18n() const;
+	//! Get the name of the body of a value of the names indexes.
+	QString getIndexedName(int value, bool i18n) const;
+
+	//! The bodies of one depth of the hierarchy (Sun, planets, moons...).
+	struct ComputeLevel
+	{
+		QList<PlanetP> serial;		//!< Bodies using the analytical theories, computed in order.
+		QList<PlanetP> concurrent;	//!< Bodies with their own orbit, computed on the thread pool.
+		//! The bodies of concurrent with a CometOrbit, whose positions are computed together before the level.
+		QVector<Planet*> batched;
+		QVector<CometOrbit*> batchedOrbits;
+	};
+	//! Build computeSchedule from systemPlanets.
+	void buildComputeSchedule();
+	//! Run one pass of position computation over computeSchedule, one hierarchy level after the other
+	//! so that the parent of a body is always up to date when the body is computed.
+	void computeScheduledPositions(double date, const Vec3d& observerPos, int pass);
+	//! Compute at once the positions of the batched bodies of a level which are not known yet,
+	//! and store them in the position cache of the bodies.
+	void computeBatchedPositions(const ComputeLevel& level, const ComputePlanetPosition& compute);
+	QVector<ComputeLevel> computeSchedule;
+	//! Define whether the bodies with their own orbit are computed on multiple threads.
+	bool flagParallelComputation;
+
+	//! Compute solarEclipseFactor from the apparent positions of the Sun and the Moon.
+	void computeSolarEclipseFactor(const StelCore* core);
+	float solarEclipseFactor;
+	//! Define whether the analytical theories are evaluated through an EphemerisCache.
+	bool flagEphemerisCache;
+	//! Initial length in days of the time windows fitted by the ephemeris caches.
+	double ephemerisCacheWindow;
+	//! Start the background fits of the ephemeris caches for the speed at which the date moves,
+	//! either because the time runs fast or because the date is scrubbed.
+	void prefetchEphemerides(double date);
+	//! The date of the last prefetchEphemerides() call, and the time elapsed since.
+	double prefetchDate;
+	QElapsedTimer prefetchTimer;
+	//! Define whether the bodies with a CometOrbit are computed together by CometOrbit::positionsAtTimesInVSOP87Coordinates().
+	bool flagBatchOrbits;
+	//! A minor planet whose position is not updated while it is too faint to be seen.
+	struct FaintBody
+	{
+		MinorPlanet* body;
+		double perihelion;
+		double aphelion;
+		float brightestMag;	//!< Lower bound of the magnitude for the current observer distance to the sun.
+	};
+	//! Set Planet::skipPositionUpdate for the faintBodies which can't be seen from the observer position.
+	void updateFaintBodies(const Vec3d& observerPos);
+	//! Define whether the position of the minor planets which can't reach the limiting magnitude is updated less often.
+	bool flagSkipFaintBodies;
+	QVector<FaintBody> faintBodies;
+	//! Observer distance to the sun for which the FaintBody::brightestMag were computed, or -1.
+	double faintBodiesObserverDistance;
+	int faintBodiesFrame;
+
+	//! A minor body of a database which has no MinorPlanet object yet. The object is created
+	//! when the body may become bright enough to be drawn, or when it is searched for.
+	struct DormantMinorBody
+	{
+		MinorBodyStore::Record record;
+		double perihelion;
+		double aphelion;
+		float brightestMag;	//!< Lower bound of the magnitude for the current observer distance to the sun.
+		PlanetP planet;		//!< The created object, or NULL while the body is dormant.
+	};
+	//! Define whether the asteroids of the databases are kept dormant while they can't be seen.
+	bool flagDormantMinorBodies;
+	QVector<DormantMinorBody> dormantBodies;
+	//! Positions in dormantBodies, the keys are the english names.
+	QHash<QString, int> dormantIndices;
+	//! Observer distance to the sun for which the DormantMinorBody::brightestMag were computed, or -1.
+	double dormantObserverDistance;
+	//! Smallest DormantMinorBody::brightestMag of the bodies still dormant.
+	float dormantBrightestMag;
+	//! Create the objects of the dormant bodies bright enough to be drawn.
+	void updateDormantBodies(const Vec3d& observerPos);
+	//! Create the objects of the given dormant bodies.
+	//! @param computeNow if true, compute the positions of the new bodies at once rather than at the next update.
+	void wakeDormantBodies(const QVector<int>& indices, bool computeNow);
+	//! Get the body of the given dormant body name, creating its object if needed, or NULL if there is no such name.
+	//! The object is created even though the method is const, so that the searches can find the dormant bodies.
+	PlanetP wakeDormantBody(const QString& englishName) const;
+
+	//! The bodies, orbits and dates to compute in the current call to computeBatchedPositions().
+	QVector<Planet*> batchPlanets;
+	QVector<CometOrbit*> batchOrbits;
+	QVector<double> batchDates;
+	QVector<Vec3d> batchPositions;
 
 	// Master settings
 	bool flagOrbits;
@@ -377,6 +538,8 @@ private:
 	bool flagMarker;
 
 	class TrailGroup* allTrails;
+	//! Draw the orbits from a GPU buffer, NULL if disabled with astro/flag_gpu_orbits.
+	class OrbitGpuDrawer* orbitDrawer;
 	LinearFader trailFader;
 	Vec3f trailColor;
 	Vec3f pointerColor;
@@ -385,6 +548,7 @@ private:
 	// DEPRECATED
 	//////////////////////////////////////////////////////////////////////////////////
 	QList<Orbit*> orbits;           // Pointers on created elliptical orbits
+	QList<class EphemerisCache*> ephemerisCaches;	// Caches in front of the analytical theories
 };
 
 
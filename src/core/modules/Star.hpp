@@ -67,7 +67,8 @@ struct Star1 { // 28 byte
 	unsigned char mag;		//  8 bits needed
 	Uint16 spInt;			// 16 bits needed
 	Int32 dx0,dx1,plx;		// 32 bits needed (x3)
-	enum {MaxPosVal=0x7FFFFFFF};
+	// The proper motions are not bounded so the decoded positions can't be cached
+	enum {MaxPosVal=0x7FFFFFFF, MaxPmVal=-1};
 	StelObjectP createStelObject(const SpecialZoneArray<Star1> *a, const SpecialZoneData<Star1> *z) const;
 	void getJ2000Pos(const ZoneData *z,float movementFactor, Vec3f& pos) const
 	{
@@ -106,7 +107,7 @@ struct Star2 {  // 10 byte
 	int dx1:14;		// 14 bits needed
 	unsigned int bV:7;	//  7 bits needed
 	unsigned int mag:5;	//  5 bits needed
-	enum {MaxPosVal=((1<<19)-1)};
+	enum {MaxPosVal=((1<<19)-1), MaxPmVal=(1<<13)};
 	StelObjectP createStelObject(const SpecialZoneArray<Star2> *a, const SpecialZoneData<Star2> *z) const;
 	void getJ2000Pos(const ZoneData *z,float movementFactor, Vec3f& pos) const
 	{
@@ -142,7 +143,7 @@ struct Star3 {  // 6 byte
 	int x1:18;		// 18 bits needed
 	unsigned int bV:7;	//  7 bits needed
 	unsigned int mag:5;	//  5 bits needed
-	enum {MaxPosVal=((1<<17)-1)};
+	enum {MaxPosVal=((1<<17)-1), MaxPmVal=0};
 	StelObjectP createStelObject(const SpecialZoneArray<Star3> *a, const SpecialZoneData<Star3> *z) const;
 	void getJ2000Pos(const ZoneData *z,float, Vec3f& pos) const
 	{
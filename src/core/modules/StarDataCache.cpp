@@ -0,0 +1,169 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "StarDataCache.hpp"
+#include "StelFileMgr.hpp"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <cstring>
+
+namespace
+{
+	const quint32 cacheMagic = 0x31434453;	// "SDC1" in little endian
+	const quint32 cacheVersion = 1;
+	const int headerSize = 32;
+
+	struct Header
+	{
+		quint32 magic;
+		quint32 version;
+		quint64 sourceSize;
+		quint64 sourceTime;
+		quint32 nbFields;
+		quint32 nbRecords;
+	};
+
+	struct MappedFile
+	{
+		MappedFile() : data(NULL), size(0) {;}
+		const uchar* data;
+		qint64 size;
+	};
+
+	//! The mapped cache files. They are never unmapped, as the strings read from them point to their data.
+	QHash<QString, MappedFile> mappedFiles;
+
+	bool isUpToDate(const MappedFile& mapped, const QFileInfo& info, int nbFields)
+	{
+		if (!mapped.data || mapped.size<headerSize)
+			return false;
+		Header header;
+		std::memcpy(&header, mapped.data, sizeof(header));
+		return header.magic==cacheMagic && header.version==cacheVersion && (qint64)header.sourceSize==info.size()
+			&& (qint64)header.sourceTime==info.lastModified().toMSecsSinceEpoch() && (int)header.nbFields==nbFields;
+	}
+}
+
+QString StarDataCache::getCachePath(const QString& dataFile)
+{
+	const QFileInfo info(dataFile);
+	const QByteArray hash = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+	return StelFileMgr::getCacheDir() + "/stars/" + info.completeBaseName() + "-" + QString::fromLatin1(hash) + ".bin";
+}
+
+bool StarDataCache::read(const QString& dataFile, int nbFields, QVector<Record>& records)
+{
+	Q_ASSERT(nbFields<=MaxFields);
+	const QFileInfo info(dataFile);
+	const QString cachePath = getCachePath(dataFile);
+
+	// Reuse the file mapped by a previous load, unless the text file was modified since then
+	MappedFile mapped = mappedFiles.value(cachePath);
+	if (!isUpToDate(mapped, info, nbFields))
+	{
+		QFile* file = new QFile(cachePath);
+		if (file->open(QIODevice::ReadOnly))
+		{
+			mapped.size = file->size();
+			mapped.data = file->map(0, mapped.size);
+		}
+		if (!isUpToDate(mapped, info, nbFields))
+		{
+			delete file;
+			return false;
+		}
+		// The previous mapping, if any, is left as the strings read from it may still be used
+		mappedFiles.insert(cachePath, mapped);
+	}
+	Header header;
+	std::memcpy(&header, mapped.data, sizeof(header));
+
+	records.clear();
+	records.reserve(header.nbRecords);
+	const uchar* cur = mapped.data+headerSize;
+	const uchar* end = mapped.data+mapped.size;
+	for (quint32 i=0;i<header.nbRecords;++i)
+	{
+		Record record;
+		quint32 value;
+		if (end-cur<4)
+			return false;
+		std::memcpy(&value, cur, 4);
+		cur += 4;
+		record.hip = value;
+		for (int f=0;f<nbFields;++f)
+		{
+			if (end-cur<4)
+				return false;
+			std::memcpy(&value, cur, 4);
+			cur += 4;
+			if (value>(quint32)(end-cur)/2)
+				return false;
+			record.fields[f] = QString::fromRawData((const QChar*)cur, value);
+			cur += 2*value;
+		}
+		records.append(record);
+	}
+	return cur==end;
+}
+
+bool StarDataCache::write(const QString& dataFile, int nbFields, const QVector<Record>& records)
+{
+	Q_ASSERT(nbFields<=MaxFields);
+	const QFileInfo info(dataFile);
+	Header header;
+	header.magic = cacheMagic;
+	header.version = cacheVersion;
+	header.sourceSize = info.size();
+	header.sourceTime = info.lastModified().toMSecsSinceEpoch();
+	header.nbFields = nbFields;
+	header.nbRecords = records.size();
+
+	QByteArray data((const char*)&header, sizeof(header));
+	foreach (const Record& record, records)
+	{
+		quint32 value = record.hip;
+		data.append((const char*)&value, 4);
+		for (int f=0;f<nbFields;++f)
+		{
+			value = record.fields[f].size();
+			data.append((const char*)&value, 4);
+			data.append((const char*)record.fields[f].constData(), 2*value);
+		}
+	}
+
+	const QString cachePath = getCachePath(dataFile);
+	QDir().mkpath(QFileInfo(cachePath).absolutePath());
+	// The file is replaced by a rename, so that the mappings of the previous version stay valid
+	QSaveFile output(cachePath);
+	if (!output.open(QIODevice::WriteOnly) || output.write(data)!=data.size() || !output.commit())
+	{
+		qWarning() << "Cannot write the star data cache" << QDir::toNativeSeparators(cachePath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#ifndef _STARDATACACHE_HPP_
+#define _STARDATACACHE_HPP_
+
+#include <QString>
+#include <QVector>
+
+//! @class StarDataCache
+//! Binary cache of the records parsed from the star names and variable stars text files.
+//! The first time a file is loaded its records are written in a binary file of the cache
+//! directory, which is then memory mapped instead of parsing the text file again as long as
+//! the latter is not modified.
+//! The strings of the records read from the cache point directly to the mapped data, so that
+//! no memory is allocated for them. The mapped files are therefore never unmapped.
+//!
+//! The cache is written in the byte order of the machine, as it is not shared:
+//! @verbatim
+//! header      magic "SDC1", format version, size and modification time of the text file,
+//!             number of fields of the records, number of records
+//! records     for each record, the HIP number followed by each field as its number of
+//!             UTF-16 characters and the UTF-16 data
+//! @endverbatim
+class StarDataCache
+{
+public:
+	//! Maximum number of fields of a record.
+	static const int MaxFields = 11;
+
+	//! One record of a star data file.
+	struct Record
+	{
+		Record() : hip(0) {;}
+		int hip;
+		QString fields[MaxFields];
+	};
+
+	//! Read the records of a data file from its cache.
+	//! @param dataFile the path of the text file.
+	//! @param nbFields the number of fields of each record.
+	//! @return false if there is no up to date cache for the file.
+	static bool read(const QString& dataFile, int nbFields, QVector<Record>& records);
+
+	//! Write the cache of a data file.
+	//! @return false if the cache could not be written.
+	static bool write(const QString& dataFile, int nbFields, const QVector<Record>& records);
+
+private:
+	static QString getCachePath(const QString& dataFile);
+};
+
+#endif // _STARDATACACHE_HPP_
@@ -0,0 +1,281 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef GL_POINT_SPRITE
+ #define GL_POINT_SPRITE 0x8861
+#endif
+#ifndef GL_VERTEX_PROGRAM_POINT_SIZE
+ #define GL_VERTEX_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+#include "StarGpuDrawer.hpp"
+#include "ZoneArray.hpp"
+#include "StelApp.hpp"
+#include "StelCore.hpp"
+#include "StelFileMgr.hpp"
+#include "StelPainter.hpp"
+#include "StelProjector.hpp"
+#include "StelSkyDrawer.hpp"
+#include "StelTextureMgr.hpp"
+
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QDebug>
+
+#include <cstddef>
+
+StarGpuDrawer::StarGpuDrawer() : currentProgram(NULL)
+{
+	texHalo = StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/star16x16.png");
+}
+
+StarGpuDrawer::~StarGpuDrawer()
+{
+	while (!zoneBuffers.isEmpty())
+		releaseZoneArray(zoneBuffers.constBegin().key());
+}
+
+QOpenGLShaderProgram* StarGpuDrawer::getProgram(const QByteArray& forwardTransform)
+{
+	static const char* vertexHeader =
+		"attribute highp vec3 pos;\n"
+		"attribute highp vec3 pm;\n"
+		"attribute mediump vec3 color;\n"
+		"attribute mediump float mag;\n"
+		"uniform highp mat4 projectionMatrix;\n"
+		"uniform highp mat4 modelViewMatrix;\n"
+		"uniform highp mat3 j2000ToAltAz;\n"
+		"uniform highp vec2 screenCenter;\n"
+		"uniform highp vec2 screenScale;\n"
+		"uniform highp float movementFactor;\n"
+		"uniform mediump vec2 rcMag[64];\n"
+		"uniform mediump float cutoffMag;\n"
+		"uniform mediump float magStepsPerMag;\n"
+		"uniform mediump float extinctionCoefficient;\n"
+		"uniform mediump float undergroundExtinctionMode;\n"
+		"uniform mediump float twinkleAmount;\n"
+		"uniform highp float twinklePhase;\n"
+		"varying mediump vec3 outColor;\n";
+	static const char* vertexMain =
+		// Same as Extinction::airmass() for geometrical altitudes.
+		"float airmass(float cosZ)\n"
+		"{\n"
+		"    if (cosZ < -0.035)\n"
+		"    {\n"
+		"        if (undergroundExtinctionMode < 0.5)\n"
+		"            return 0.;\n"
+		"        if (undergroundExtinctionMode < 1.5)\n"
+		"            return 42.;\n"
+		"        cosZ = min(1., -0.035 - (cosZ+0.035));\n"
+		"    }\n"
+		"    float nom = (1.002432*cosZ+0.148386)*cosZ+0.0096467;\n"
+		"    float denum = ((cosZ+0.149864)*cosZ+0.0102963)*cosZ+0.000303978;\n"
+		"    return nom/denum;\n"
+		"}\n"
+		"void main(void)\n"
+		"{\n"
+		"    highp vec3 v = pos + movementFactor*pm;\n"
+		"    float magIndex = floor(mag*255.+0.5);\n"
+		"    if (extinctionCoefficient > 0.)\n"
+		"        magIndex += floor(airmass(normalize(j2000ToAltAz*v).z)*extinctionCoefficient*magStepsPerMag);\n"
+		"    vec3 win = projectorForwardTransform((modelViewMatrix*vec4(v, 1.)).xyz);\n"
+		"    vec2 rc = rcMag[int(min(magIndex, 63.))];\n"
+		"    bool culled = magIndex > cutoffMag || (extinctionCoefficient > 0. && magIndex >= cutoffMag);\n"
+		"    if (win.z < 0.5 || culled || rc.x <= 0.)\n"
+		"    {\n"
+		"        // Move the point outside of the clipping volume\n"
+		"        gl_Position = vec4(2., 2., 2., 1.);\n"
+		"        gl_PointSize = 0.;\n"
+		"        outColor = vec3(0.);\n"
+		"        return;\n"
+		"    }\n"
+		"    gl_Position = projectionMatrix*vec4(screenCenter+screenScale*win.xy, 0., 1.);\n"
+		"    gl_PointSize = 2.*rc.x;\n"
+		"    // Same twinkling as StelSkyDrawer::drawPointSource(), with a seed derived from the position\n"
+		"    highp float seed = mod(floor(dot(pos, vec3(5003., 7919., 3571.))), 128.);\n"
+		"    highp float rnd = fract(sin(seed*12.9898+twinklePhase*78.233)*43758.5453);\n"
+		"    outColor = color*rc.y*(1.-twinkleAmount*rnd);\n"
+		"}\n";
+
+	static const char* fsrc =
+		"varying mediump vec3 outColor;\n"
+		"uniform sampler2D tex;\n"
+		"void main(void)\n"
+		"{\n"
+		"    gl_FragColor = texture2D(tex, gl_PointCoord)*vec4(outColor, 1.);\n"
+		"}\n";
+
+	QOpenGLShaderProgram* prog = StelPainter::getProjectionProgram("starGpuShader", forwardTransform, vertexHeader, vertexMain, fsrc);
+	if (prog && !programVars.contains(prog))
+	{
+		ShaderVars vars;
+		vars.pos = prog->attributeLocation("pos");
+		vars.pm = prog->attributeLocation("pm");
+		vars.color = prog->attributeLocation("color");
+		vars.mag = prog->attributeLocation("mag");
+		vars.projectionMatrix = prog->uniformLocation("projectionMatrix");
+		vars.modelViewMatrix = prog->uniformLocation("modelViewMatrix");
+		vars.j2000ToAltAz = prog->uniformLocation("j2000ToAltAz");
+		vars.screenCenter = prog->uniformLocation("screenCenter");
+		vars.screenScale = prog->uniformLocation("screenScale");
+		vars.movementFactor = prog->uniformLocation("movementFactor");
+		vars.rcMag = prog->uniformLocation("rcMag");
+		vars.cutoffMag = prog->uniformLocation("cutoffMag");
+		vars.magStepsPerMag = prog->uniformLocation("magStepsPerMag");
+		vars.extinctionCoefficient = prog->uniformLocation("extinctionCoefficient");
+		vars.undergroundExtinctionMode = prog->uniformLocation("undergroundExtinctionMode");
+		vars.texture = prog->uniformLocation("tex");
+		vars.twinkleAmount = prog->uniformLocation("twinkleAmount");
+		vars.twinklePhase = prog->uniformLocation("twinklePhase");
+		programVars.insert(prog, vars);
+	}
+	return prog;
+}
+
+bool StarGpuDrawer::begin(StelCore* core, StelPainter* sPainter)
+{
+	Q_ASSERT(currentProgram==NULL);
+	const StelProjectorP& prj = sPainter->getProjector();
+	const QByteArray forwardTransform = prj->getForwardTransformShader();
+	if (forwardTransform.isEmpty())
+		return false;
+	currentProgram = getProgram(forwardTransform);
+	if (!currentProgram)
+		return false;
+	currentVars = programVars.value(currentProgram);
+
+	// The columns of the J2000 to AltAz rotation, used for extinction
+	Vec3f ex(1,0,0), ey(0,1,0), ez(0,0,1);
+	core->j2000ToAltAzInPlaceNoRefraction(&ex);
+	core->j2000ToAltAzInPlaceNoRefraction(&ey);
+	core->j2000ToAltAzInPlaceNoRefraction(&ez);
+	const GLfloat j2000ToAltAz[9] = {ex[0], ex[1], ex[2], ey[0], ey[1], ey[2], ez[0], ez[1], ez[2]};
+
+	const StelSkyDrawer* drawer = core->getSkyDrawer();
+	const Extinction& extinction = drawer->getExtinction();
+	const bool withExtinction = drawer->getFlagHasAtmosphere() && extinction.getExtinctionCoefficient()>=0.01f;
+
+	Vec2f screenCenter, screenScale;
+	prj->getScreenTransform(screenCenter, screenScale);
+
+	StelPainter::flushPendingText();
+	currentProgram->bind();
+	currentProgram->setUniformValue(currentVars.projectionMatrix, StelPainter::toQMatrix(prj->getProjectionMatrix()));
+	// Refraction, if any, is ignored here: it is only significant for the few stars close to the horizon.
+	currentProgram->setUniformValue(currentVars.modelViewMatrix, StelPainter::toQMatrix(prj->getModelViewTransform()->getApproximateLinearTransfo()));
+	glUniformMatrix3fv(currentVars.j2000ToAltAz, 1, GL_FALSE, j2000ToAltAz);
+	currentProgram->setUniformValue(currentVars.screenCenter, screenCenter[0], screenCenter[1]);
+	currentProgram->setUniformValue(currentVars.screenScale, screenScale[0], screenScale[1]);
+	currentProgram->setUniformValue(currentVars.extinctionCoefficient, withExtinction ? extinction.getExtinctionCoefficient() : 0.f);
+	currentProgram->setUniformValue(currentVars.undergroundExtinctionMode, (GLfloat)extinction.getUndergroundExtinctionMode());
+	currentProgram->setUniformValue(currentVars.texture, 0);
+	const bool twinkle = drawer->getFlagTwinkle() && drawer->getFlagHasAtmosphere();
+	currentProgram->setUniformValue(currentVars.twinkleAmount, twinkle ? drawer->getTwinkleAmount() : 0.f);
+	currentProgram->setUniformValue(currentVars.twinklePhase, drawer->getTwinklePhase());
+
+	currentProgram->enableAttributeArray(currentVars.pos);
+	currentProgram->enableAttributeArray(currentVars.pm);
+	currentProgram->enableAttributeArray(currentVars.color);
+	currentProgram->enableAttributeArray(currentVars.mag);
+
+	texHalo->bind();
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+#ifndef QT_OPENGL_ES_2
+	glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+	glEnable(GL_POINT_SPRITE);
+#endif
+	return true;
+}
+
+void StarGpuDrawer::setCatalogParams(const RCMag* rcmagTable, int cutoffMagStep, float magStepsPerMag, float movementFactor)
+{
+	Q_ASSERT(currentProgram);
+	GLfloat rcMag[MaxMagSteps*2];
+	for (int i=0;i<MaxMagSteps;++i)
+	{
+		rcMag[i*2] = rcmagTable[i].radius;
+		rcMag[i*2+1] = rcmagTable[i].luminance;
+	}
+	currentProgram->setUniformValueArray(currentVars.rcMag, rcMag, MaxMagSteps, 2);
+	currentProgram->setUniformValue(currentVars.cutoffMag, (GLfloat)cutoffMagStep);
+	currentProgram->setUniformValue(currentVars.magStepsPerMag, magStepsPerMag);
+	currentProgram->setUniformValue(currentVars.movementFactor, movementFactor);
+}
+
+void StarGpuDrawer::drawZone(const ZoneArray* zoneArray, int zone, int cutoffMagStep)
+{
+	Q_ASSERT(currentProgram);
+	const int nbStars = zoneArray->getNrOfStarsBrighterThan(zone, cutoffMagStep);
+	if (nbStars==0)
+		return;
+
+	QVector<QOpenGLBuffer*>& buffers = zoneBuffers[zoneArray];
+	if (buffers.isEmpty())
+		buffers.fill(NULL, zoneArray->getNrOfZones());
+	QOpenGLBuffer*& buffer = buffers[zone];
+	if (buffer==NULL)
+	{
+		zoneArray->fillGpuVertexArray(zone, uploadBuffer);
+		buffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+		buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+		buffer->create();
+		buffer->bind();
+		buffer->allocate(uploadBuffer.constData(), uploadBuffer.size()*sizeof(StarGpuVertex));
+		uploadBuffer.clear();
+	}
+	else
+	{
+		buffer->bind();
+	}
+	currentProgram->setAttributeBuffer(currentVars.pos, GL_FLOAT, offsetof(StarGpuVertex, pos), 3, sizeof(StarGpuVertex));
+	currentProgram->setAttributeBuffer(currentVars.pm, GL_FLOAT, offsetof(StarGpuVertex, pm), 3, sizeof(StarGpuVertex));
+	currentProgram->setAttributeBuffer(currentVars.color, GL_UNSIGNED_BYTE, offsetof(StarGpuVertex, color), 3, sizeof(StarGpuVertex));
+	currentProgram->setAttributeBuffer(currentVars.mag, GL_UNSIGNED_BYTE, offsetof(StarGpuVertex, mag), 1, sizeof(StarGpuVertex));
+	glDrawArrays(GL_POINTS, 0, nbStars);
+	buffer->release();
+}
+
+void StarGpuDrawer::end()
+{
+	Q_ASSERT(currentProgram);
+#ifndef QT_OPENGL_ES_2
+	glDisable(GL_POINT_SPRITE);
+	glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+	currentProgram->disableAttributeArray(currentVars.pos);
+	currentProgram->disableAttributeArray(currentVars.pm);
+	currentProgram->disableAttributeArray(currentVars.color);
+	currentProgram->disableAttributeArray(currentVars.mag);
+	currentProgram->release();
+	currentProgram = NULL;
+}
+
+void StarGpuDrawer::releaseZoneArray(const ZoneArray* zoneArray)
+{
+	foreach (QOpenGLBuffer* buffer, zoneBuffers.value(zoneArray))
+	{
+		if (buffer)
+		{
+			buffer->destroy();
+			delete buffer;
+		}
+	}
+	zoneBuffers.remove(zoneArray);
+}
@@ -0,0 +1,122 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STARGPUDRAWER_HPP_
+#define _STARGPUDRAWER_HPP_
+
+#include "VecMath.hpp"
+#include "StelTextureTypes.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+class StelCore;
+class StelPainter;
+class ZoneArray;
+class QOpenGLBuffer;
+class QOpenGLShaderProgram;
+struct RCMag;
+
+//! @struct StarGpuVertex
+//! Vertex format used to store the stars of one zone in a static GPU buffer.
+struct StarGpuVertex
+{
+	Vec3f pos;			// J2000 position at epoch J2000.0 (not normalized)
+	Vec3f pm;			// Position change per unit of movementFactor (proper motion)
+	unsigned char color[3];		// RGB color from the B-V index
+	unsigned char mag;		// Magnitude index in the catalog steps
+};
+
+//! @class StarGpuDrawer
+//! Draw the faint stars of the catalog levels without names (Star2 and Star3) from static GPU buffers.
+//! Each zone is uploaded once, the first time it becomes visible, and the projection, proper motion,
+//! extinction and magnitude cutoff are then evaluated in the vertex shader. The CPU is only
+//! responsible for selecting the zones to draw from the GeodesicSearchResult.
+//! Only the projections providing a StelProjector::getForwardTransformShader() are supported.
+//! Refraction is not applied to the stars drawn this way.
+class StarGpuDrawer
+{
+public:
+	StarGpuDrawer();
+	~StarGpuDrawer();
+
+	//! Prepare the drawing of zones for the given painter.
+	//! @return false if the current projection cannot be performed on the GPU,
+	//! in which case the regular CPU path has to be used.
+	bool begin(StelCore* core, StelPainter* sPainter);
+
+	//! Set the magnitude parameters of the catalog being drawn.
+	//! @param rcmagTable the RCMag table computed for the catalog.
+	//! @param cutoffMagStep the index in the table from which stars are not drawn anymore.
+	//! @param magStepsPerMag the inverse of the magnitude increment of one step.
+	//! @param movementFactor the factor to apply to proper motions for the current date.
+	void setCatalogParams(const RCMag* rcmagTable, int cutoffMagStep, float magStepsPerMag, float movementFactor);
+
+	//! Draw the bright enough stars of a zone, uploading the zone first if needed.
+	void drawZone(const ZoneArray* zoneArray, int zone, int cutoffMagStep);
+
+	//! Finish drawing and restore the GL state.
+	void end();
+
+	//! Release all the GPU buffers used by a catalog.
+	void releaseZoneArray(const ZoneArray* zoneArray);
+
+	//! Maximum number of magnitude steps which can be transfered to the shader.
+	static const int MaxMagSteps = 64;
+
+private:
+	//! Get or build the shader program for the given forward transform code.
+	QOpenGLShaderProgram* getProgram(const QByteArray& forwardTransform);
+
+	struct ShaderVars {
+		int pos;
+		int pm;
+		int color;
+		int mag;
+		int projectionMatrix;
+		int modelViewMatrix;
+		int j2000ToAltAz;
+		int screenCenter;
+		int screenScale;
+		int movementFactor;
+		int rcMag;
+		int cutoffMag;
+		int magStepsPerMag;
+		int extinctionCoefficient;
+		int undergroundExtinctionMode;
+		int twinkleAmount;
+		int twinklePhase;
+		int texture;
+	};
+
+	//! The locations of the variables of the programs, which are owned by StelPainter::getProjectionProgram().
+	QHash<const QOpenGLShaderProgram*, ShaderVars> programVars;
+
+	//! One buffer per zone, NULL if the zone was not uploaded yet.
+	QHash<const ZoneArray*, QVector<QOpenGLBuffer*> > zoneBuffers;
+
+	QOpenGLShaderProgram* currentProgram;
+	ShaderVars currentVars;
+
+	StelTextureSP texHalo;
+	QVector<StarGpuVertex> uploadBuffer;
+};
+
+#endif // _STARGPUDRAWER_HPP_
@@ -43,8 +43,14 @@
 #include "StelPainter.hpp"
 #include "StelJsonParser.hpp"
 #include "ZoneArray.hpp"
+#include "StarGpuDrawer.hpp"
+#include "StarDataCache.hpp"
 #include "StelSkyDrawer.hpp"
 #include "RefractionExtinction.hpp"
+#include "LabelMgr.hpp"
+#include "StelTracer.hpp"
+#include "StelJobSystem.hpp"
+#include "StelRenderProfile.hpp"
 
 #include <QTextStream>
 #include <QFile>
@@ -55,8 +61,10 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QCryptographicHash>
+#include <QThread>
 
 #include <errno.h>
+#include <algorithm>
 
 static QStringList spectral_array;
 static QStringList component_array;
@@ -66,15 +74,49 @@ static QStringList component_array;
 // It should always matchs the version field of the defaultStarsConfig.json file
 static const int StarCatalogFormatVersion = 6;
 
+// How many magnitudes before the brightest stars of a catalog become visible its loading is started
+static const float LazyLoadingMagMargin = 0.5f;
+
+// Cosine of the radius of the bounding cap of the viewport under which the field is considered narrow (2 degrees)
+static const double NarrowFieldCosRadius = 0.99939;
+
+// Minimum number of visible zones of a catalog for distributing them on the thread pool
+static const int MinParallelZones = 16;
+
+//! The visible zones of a catalog projected by one task of the thread pool.
+struct ZoneDrawSlice
+{
+	const ZoneArray* zoneArray;
+	QVector<int> insideZones;
+	QVector<int> borderZones;
+	const RCMag* rcmagTable;
+	int limitMagIndex;
+	int maxMagStarName;
+	float namesBrightness;
+	StelCore* core;
+	const QVector<SphericalCap>* viewportCaps;
+	ZoneDrawBatch batch;
+};
+
+static void drawZoneSlice(ZoneDrawSlice*& slice)
+{
+	foreach (int zone, slice->insideZones)
+		slice->zoneArray->draw(NULL, zone, true, slice->rcmagTable, slice->limitMagIndex, slice->core, slice->maxMagStarName, slice->namesBrightness, *slice->viewportCaps, &slice->batch);
+	foreach (int zone, slice->borderZones)
+		slice->zoneArray->draw(NULL, zone, false, slice->rcmagTable, slice->limitMagIndex, slice->core, slice->maxMagStarName, slice->namesBrightness, *slice->viewportCaps, &slice->batch);
+}
+
 // Initialise statics
 bool StarMgr::flagSciNames = true;
-QHash<int,QString> StarMgr::commonNamesMap;
-QHash<int,QString> StarMgr::commonNamesMapI18n;
+QHash<int,StelInternedString> StarMgr::commonNamesMap;
+QHash<int,StelInternedString> StarMgr::commonNamesMapI18n;
 QMap<QString,int> StarMgr::commonNamesIndexI18n;
 QMap<QString,int> StarMgr::commonNamesIndex;
-QHash<int,QString> StarMgr::sciNamesMapI18n;
+StelNameIndex StarMgr::commonNamesSearchIndexI18n;
+StelNameIndex StarMgr::commonNamesSearchIndex;
+QHash<int,StelInternedString> StarMgr::sciNamesMapI18n;
 QMap<QString,int> StarMgr::sciNamesIndexI18n;
-QHash<int,QString> StarMgr::sciAdditionalNamesMapI18n;
+QHash<int,StelInternedString> StarMgr::sciAdditionalNamesMapI18n;
 QMap<QString,int> StarMgr::sciAdditionalNamesIndexI18n;
 QHash<int, varstar> StarMgr::varStarsMapI18n;
 QMap<QString, int> StarMgr::varStarsIndexI18n;
@@ -128,6 +170,11 @@ StarMgr::StarMgr(void)
 	, labelsAmount(0.)
 	, gravityLabel(false)
 	, hipIndex(new HipIndexStruct[NR_OF_HIP+1])
+	, flagGpuStarProjection(false)
+	, gpuDrawer(NULL)
+	, flagLazyCatalogLoading(false)
+	, flagParallelDrawing(false)
+	, nbDrawSlices(0)
 {
 	setObjectName("StarMgr");
 	if (hipIndex == 0)
@@ -151,9 +198,38 @@ double StarMgr::getCallOrder(StelModuleActionName actionName) const
 	return 0;
 }
 
+// Estimate the memory of a hash table: a node per entry with its links, hash, key and value, plus a bucket
+template<class T> static qint64 estimateHashMemory(const QHash<int, T>& hash)
+{
+	return hash.size()*(qint64)(2*sizeof(void*)+sizeof(uint)+sizeof(int)+sizeof(T)) + hash.capacity()*(qint64)sizeof(void*);
+}
+
+// Estimate the memory of an index of names: a node per entry with its links, key and value, plus the names
+static qint64 estimateIndexMemory(const QMap<QString, int>& index)
+{
+	qint64 total = 0;
+	for (QMap<QString, int>::ConstIterator i=index.constBegin(); i!=index.constEnd(); ++i)
+		total += 3*sizeof(void*)+sizeof(QString)+sizeof(int) + 24 + i.key().size()*sizeof(ushort);
+	return total;
+}
+
+qint64 StarMgr::getMemoryUsed() const
+{
+	return (NR_OF_HIP+1)*(qint64)sizeof(HipIndexStruct)
+		+ estimateHashMemory(commonNamesMap) + estimateHashMemory(commonNamesMapI18n)
+		+ estimateIndexMemory(commonNamesIndex) + estimateIndexMemory(commonNamesIndexI18n)
+		+ commonNamesSearchIndex.getMemoryUsed() + commonNamesSearchIndexI18n.getMemoryUsed()
+		+ estimateHashMemory(sciNamesMapI18n) + estimateIndexMemory(sciNamesIndexI18n)
+		+ estimateHashMemory(sciAdditionalNamesMapI18n) + estimateIndexMemory(sciAdditionalNamesIndexI18n)
+		+ estimateHashMemory(varStarsMapI18n) + estimateIndexMemory(varStarsIndexI18n);
+}
 
 StarMgr::~StarMgr(void)
 {
+	delete gpuDrawer;
+	gpuDrawer = NULL;
+	qDeleteAll(drawSlices);
+	drawSlices.clear();
 	foreach(ZoneArray* z, gridLevels)
 		delete z;
 	gridLevels.clear();
@@ -163,25 +239,25 @@ StarMgr::~StarMgr(void)
 
 QString StarMgr::getCommonName(int hip)
 {
-	QHash<int,QString>::const_iterator it(commonNamesMapI18n.find(hip));
+	QHash<int,StelInternedString>::const_iterator it(commonNamesMapI18n.find(hip));
 	if (it!=commonNamesMapI18n.end())
-		return it.value();
+		return it.value().toString();
 	return QString();
 }
 
 QString StarMgr::getSciName(int hip)
 {
-	QHash<int,QString>::const_iterator it(sciNamesMapI18n.find(hip));
+	QHash<int,StelInternedString>::const_iterator it(sciNamesMapI18n.find(hip));
 	if (it!=sciNamesMapI18n.end())
-		return it.value();
+		return it.value().toString();
 	return QString();
 }
 
 QString StarMgr::getSciAdditionalName(int hip)
 {
-	QHash<int,QString>::const_iterator it(sciAdditionalNamesMapI18n.find(hip));
+	QHash<int,StelInternedString>::const_iterator it(sciAdditionalNamesMapI18n.find(hip));
 	if (it!=sciAdditionalNamesMapI18n.end())
-		return it.value();
+		return it.value().toString();
 	return QString();
 }
 
@@ -190,7 +266,7 @@ QString StarMgr::getGcvsName(int hip)
 {
 	QHash<int,varstar>::const_iterator it(varStarsMapI18n.find(hip));
 	if (it!=varStarsMapI18n.end())
-		return it.value().designation;
+		return it.value().designation.toString();
 	return QString();
 }
 
@@ -198,7 +274,7 @@ QString StarMgr::getGcvsVariabilityType(int hip)
 {
 	QHash<int,varstar>::const_iterator it(varStarsMapI18n.find(hip));
 	if (it!=varStarsMapI18n.end())
-		return it.value().vtype;
+		return it.value().vtype.toString();
 	return QString();
 }
 
@@ -240,7 +316,7 @@ QString StarMgr::getGcvsPhotometricSystem(int hip)
 {
 	QHash<int,varstar>::const_iterator it(varStarsMapI18n.find(hip));
 	if (it!=varStarsMapI18n.end())
-		return it.value().photosys;
+		return it.value().photosys.toString();
 	return QString();
 }
 
@@ -318,6 +394,9 @@ void StarMgr::init()
 		}
 	}
 
+	flagLazyCatalogLoading = conf->value("stars/flag_lazy_catalog_loading", true).toBool();
+	ZoneArray::setUseAccessHints(conf->value("stars/flag_mmap_access_hints", true).toBool());
+	ZoneArray::setPositionCacheMaxStars(conf->value("stars/position_cache_max_stars", 2000000).toInt());
 	loadData(starSettings);
 	starFont.setPixelSize(StelApp::getInstance().getSettings()->value("gui/base_font_size", 13).toInt());
 
@@ -328,6 +407,11 @@ void StarMgr::init()
 	objectMgr->registerStelObjectMgr(this);
 	texPointer = StelApp::getInstance().getTextureManager().createTexture(StelFileMgr::getInstallationDir()+"/textures/pointeur2.png");   // Load pointer texture
 
+	flagGpuStarProjection = conf->value("stars/flag_gpu_star_projection", false).toBool();
+	if (flagGpuStarProjection)
+		gpuDrawer = new StarGpuDrawer();
+	flagParallelDrawing = conf->value("stars/flag_parallel_drawing", true).toBool() && QThread::idealThreadCount()>1;
+
 	StelApp::getInstance().getCore()->getGeodesicGrid(maxGeodesicGridLevel)->visitTriangles(maxGeodesicGridLevel,initTriangleFunc,this);
 	foreach(ZoneArray* z, gridLevels)
 		z->scaleAxis();
@@ -374,7 +458,7 @@ void StarMgr::setStelStyle(const QString& section)
 	setLabelColor(StelUtils::strToVec3f(conf->value(section+"/star_label_color", defaultColor).toString()));
 }
 
-bool StarMgr::checkAndLoadCatalog(const QVariantMap& catDesc)
+bool StarMgr::checkAndLoadCatalog(const QVariantMap& catDesc, bool verified)
 {
 	const bool checked = catDesc.value("checked").toBool();
 	QString catalogFileName = catDesc.value("fileName").toString();
@@ -401,7 +485,11 @@ bool StarMgr::checkAndLoadCatalog(const QVariantMap& catDesc)
 		return false;
 	}
 
-	if (!checked)
+	if (!checked && verified)
+	{
+		setCheckFlag(catDesc.value("id").toString(), true);
+	}
+	else if (!checked)
 	{
 		// The file is not checked but we found it, maybe from a previous download/version
 		qWarning() << "Found file " << QDir::toNativeSeparators(catalogFilePath) << ", checking md5sum..";
@@ -443,7 +531,7 @@ bool StarMgr::checkAndLoadCatalog(const QVariantMap& catDesc)
 		}
 	}
 
-	ZoneArray* z = ZoneArray::create(catalogFilePath, true);
+	ZoneArray* z = ZoneArray::create(catalogFilePath, true, flagLazyCatalogLoading);
 	if (z)
 	{
 		if (z->level<gridLevels.size())
@@ -493,8 +581,15 @@ void StarMgr::loadData(QVariantMap starsConfig)
 	qDebug() << "Loading star data ...";
 
 	catalogsDescription = starsConfig.value("catalogs").toList();
+	// The catalogs are listed from the brightest stars, the low power profile keeps only the first ones
+	const int maxCatalogs = StelApp::getInstance().getRenderProfile()->getMaxStarCatalogs();
 	foreach (const QVariant& catV, catalogsDescription)
 	{
+		if (maxCatalogs>=0 && gridLevels.size()>=maxCatalogs)
+		{
+			qDebug() << "The rendering profile limits the star catalogs to" << maxCatalogs;
+			break;
+		}
 		QVariantMap m = catV.toMap();
 		checkAndLoadCatalog(m);
 	}
@@ -549,73 +644,86 @@ int StarMgr::loadCommonNames(const QString& commonNameFile)
 	commonNamesIndex.clear();
 
 	qDebug() << "Loading star names from" << QDir::toNativeSeparators(commonNameFile);
-	QFile cnFile(commonNameFile);
-	if (!cnFile.open(QIODevice::ReadOnly | QIODevice::Text))
-	{
-		qWarning() << "WARNING - could not open" << QDir::toNativeSeparators(commonNameFile);
-		return 0;
-	}
-
-	int readOk=0;
+	QVector<StarDataCache::Record> records;
 	int totalRecords=0;
-	int lineNumber=0;
-	QString record;
-	QRegExp commentRx("^(\\s*#.*|\\s*)$");
-	// record structure is delimited with a | character.  We will
-	// use a QRegExp to extract the fields. with whitespace padding permitted
-	// (i.e. it will be stripped automatically) Example record strings:
-	// " 10819|c_And"
-	// "113726|1_And"
-	QRegExp recordRx("^\\s*(\\d+)\\s*\\|(.*)\\n");
-
-	while(!cnFile.atEnd())
+	if (StarDataCache::read(commonNameFile, 1, records))
+		totalRecords = records.size();
+	else
 	{
-		record = QString::fromUtf8(cnFile.readLine());
-		lineNumber++;
-		if (commentRx.exactMatch(record))
-			continue;
-
-		totalRecords++;
-		if (!recordRx.exactMatch(record))
+		QFile cnFile(commonNameFile);
+		if (!cnFile.open(QIODevice::ReadOnly | QIODevice::Text))
 		{
-			qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(commonNameFile)
-				   << " - record does not match record pattern";
-			continue;
+			qWarning() << "WARNING - could not open" << QDir::toNativeSeparators(commonNameFile);
+			return 0;
 		}
-		else
+
+		int lineNumber=0;
+		QString record;
+		QRegExp commentRx("^(\\s*#.*|\\s*)$");
+		// record structure is delimited with a | character.  We will
+		// use a QRegExp to extract the fields. with whitespace padding permitted
+		// (i.e. it will be stripped automatically) Example record strings:
+		// " 10819|c_And"
+		// "113726|1_And"
+		QRegExp recordRx("^\\s*(\\d+)\\s*\\|(.*)\\n");
+
+		while(!cnFile.atEnd())
 		{
-			// The record is the right format.  Extract the fields
-			bool ok;
-			unsigned int hip = recordRx.capturedTexts().at(1).toUInt(&ok);
-			if (!ok)
+			record = QString::fromUtf8(cnFile.readLine());
+			lineNumber++;
+			if (commentRx.exactMatch(record))
+				continue;
+
+			totalRecords++;
+			if (!recordRx.exactMatch(record))
 			{
 				qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(commonNameFile)
-					   << " - failed to convert " << recordRx.capturedTexts().at(1) << "to a number";
+					   << " - record does not match record pattern";
 				continue;
 			}
-			QString englishCommonName = recordRx.capturedTexts().at(2).trimmed();
-			if (englishCommonName.isEmpty())
+			else
 			{
-				qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(commonNameFile)
-					   << " - empty name field";
-				continue;
+				// The record is the right format.  Extract the fields
+				bool ok;
+				StarDataCache::Record r;
+				r.hip = recordRx.capturedTexts().at(1).toUInt(&ok);
+				if (!ok)
+				{
+					qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(commonNameFile)
+						   << " - failed to convert " << recordRx.capturedTexts().at(1) << "to a number";
+					continue;
+				}
+				r.fields[0] = recordRx.capturedTexts().at(2).trimmed();
+				if (r.fields[0].isEmpty())
+				{
+					qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(commonNameFile)
+						   << " - empty name field";
+					continue;
+				}
+				records.append(r);
 			}
-
-			// Fix for translate star names 
-			// englishCommonName.replace('_', ' ');
-			const QString commonNameI18n = q_(englishCommonName);
-			QString commonNameI18n_cap = commonNameI18n.toUpper();
-
-			commonNamesMap[hip] = englishCommonName;
-			commonNamesMapI18n[hip] = commonNameI18n;
-			commonNamesIndexI18n[commonNameI18n_cap] = hip;
-			commonNamesIndex[englishCommonName.toUpper()] = hip;
-			readOk++;
 		}
+		cnFile.close();
+		StarDataCache::write(commonNameFile, 1, records);
 	}
-	cnFile.close();
 
-	qDebug() << "Loaded" << readOk << "/" << totalRecords << "common star names";
+	foreach (const StarDataCache::Record& r, records)
+	{
+		const QString& englishCommonName = r.fields[0];
+		// Fix for translate star names
+		// englishCommonName.replace('_', ' ');
+		const QString commonNameI18n = q_(englishCommonName);
+		QString commonNameI18n_cap = commonNameI18n.toUpper();
+
+		commonNamesMap[r.hip] = StelInternedString(englishCommonName);
+		commonNamesMapI18n[r.hip] = StelInternedString(commonNameI18n);
+		commonNamesIndexI18n[commonNameI18n_cap] = r.hip;
+		commonNamesIndex[englishCommonName.toUpper()] = r.hip;
+	}
+	fillSearchIndex(commonNamesSearchIndexI18n, commonNamesIndexI18n);
+	fillSearchIndex(commonNamesSearchIndex, commonNamesIndex);
+
+	qDebug() << "Loaded" << records.size() << "/" << totalRecords << "common star names";
 	return 1;
 }
 
@@ -629,72 +737,83 @@ void StarMgr::loadSciNames(const QString& sciNameFile)
 	sciAdditionalNamesIndexI18n.clear();
 
 	qDebug() << "Loading star names from" << QDir::toNativeSeparators(sciNameFile);
-	QFile snFile(sciNameFile);
-	if (!snFile.open(QIODevice::ReadOnly | QIODevice::Text))
-	{
-		qWarning() << "WARNING - could not open" << QDir::toNativeSeparators(sciNameFile);
-		return;
-	}
-	const QStringList& allRecords = QString::fromUtf8(snFile.readAll()).split('\n');
-	snFile.close();
-
-	int readOk=0;
+	QVector<StarDataCache::Record> records;
 	int totalRecords=0;
-	int lineNumber=0;
-	// record structure is delimited with a | character. Example record strings:
-	// " 10819|c_And"
-	// "113726|1_And"
-	foreach(const QString& record, allRecords)
+	if (StarDataCache::read(sciNameFile, 1, records))
+		totalRecords = records.size();
+	else
 	{
-		++lineNumber;
-		if (record.isEmpty())
-			continue;
-
-		++totalRecords;
-		const QStringList& fields = record.split('|');
-		if (fields.size()!=2)
+		QFile snFile(sciNameFile);
+		if (!snFile.open(QIODevice::ReadOnly | QIODevice::Text))
 		{
-			qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(sciNameFile)
-				   << " - record does not match record pattern";
-			continue;
+			qWarning() << "WARNING - could not open" << QDir::toNativeSeparators(sciNameFile);
+			return;
 		}
-		else
+		const QStringList& allRecords = QString::fromUtf8(snFile.readAll()).split('\n');
+		snFile.close();
+
+		int lineNumber=0;
+		// record structure is delimited with a | character. Example record strings:
+		// " 10819|c_And"
+		// "113726|1_And"
+		foreach(const QString& record, allRecords)
 		{
-			// The record is the right format.  Extract the fields
-			bool ok;
-			unsigned int hip = fields.at(0).toUInt(&ok);
-			if (!ok)
-			{
-				qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(sciNameFile)
-					   << " - failed to convert " << fields.at(0) << "to a number";
+			++lineNumber;
+			if (record.isEmpty())
 				continue;
-			}
 
-			QString sci_name_i18n = fields.at(1).trimmed();
-			if (sci_name_i18n.isEmpty())
+			++totalRecords;
+			const QStringList& fields = record.split('|');
+			if (fields.size()!=2)
 			{
 				qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(sciNameFile)
-					   << " - empty name field";
+					   << " - record does not match record pattern";
 				continue;
 			}
-
-			sci_name_i18n.replace('_',' ');
-			// Don't set the main sci name if it's already set - it's additional sci name
-			if (sciNamesMapI18n.find(hip)!=sciNamesMapI18n.end())
-			{
-				sciAdditionalNamesMapI18n[hip] = sci_name_i18n;
-				sciAdditionalNamesIndexI18n[sci_name_i18n.toUpper()] = hip;
-			}
 			else
 			{
-				sciNamesMapI18n[hip] = sci_name_i18n;
-				sciNamesIndexI18n[sci_name_i18n.toUpper()] = hip;
+				// The record is the right format.  Extract the fields
+				bool ok;
+				StarDataCache::Record r;
+				r.hip = fields.at(0).toUInt(&ok);
+				if (!ok)
+				{
+					qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(sciNameFile)
+						   << " - failed to convert " << fields.at(0) << "to a number";
+					continue;
+				}
+
+				r.fields[0] = fields.at(1).trimmed();
+				if (r.fields[0].isEmpty())
+				{
+					qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(sciNameFile)
+						   << " - empty name field";
+					continue;
+				}
+				r.fields[0].replace('_',' ');
+				records.append(r);
 			}
-			++readOk;
 		}
+		StarDataCache::write(sciNameFile, 1, records);
 	}
 
-	qDebug() << "Loaded" << readOk << "/" << totalRecords << "scientific star names";
+	foreach (const StarDataCache::Record& r, records)
+	{
+		const QString& sci_name_i18n = r.fields[0];
+		// Don't set the main sci name if it's already set - it's additional sci name
+		if (sciNamesMapI18n.find(r.hip)!=sciNamesMapI18n.end())
+		{
+			sciAdditionalNamesMapI18n[r.hip] = StelInternedString(sci_name_i18n);
+			sciAdditionalNamesIndexI18n[sci_name_i18n.toUpper()] = r.hip;
+		}
+		else
+		{
+			sciNamesMapI18n[r.hip] = StelInternedString(sci_name_i18n);
+			sciNamesIndexI18n[sci_name_i18n.toUpper()] = r.hip;
+		}
+	}
+
+	qDebug() << "Loaded" << records.size() << "/" << totalRecords << "scientific star names";
 }
 
 // Load GCVS from file
@@ -704,61 +823,82 @@ void StarMgr::loadGcvs(const QString& GcvsFile)
 	varStarsIndexI18n.clear();
 
 	qDebug() << "Loading variable stars from" << QDir::toNativeSeparators(GcvsFile);
-	QFile vsFile(GcvsFile);
-	if (!vsFile.open(QIODevice::ReadOnly | QIODevice::Text))
-	{
-		qWarning() << "WARNING - could not open" << QDir::toNativeSeparators(GcvsFile);
-		return;
-	}
-	const QStringList& allRecords = QString::fromUtf8(vsFile.readAll()).split('\n');
-	vsFile.close();
-
-	int readOk=0;
+	QVector<StarDataCache::Record> records;
 	int totalRecords=0;
-	int lineNumber=0;
-
-	// record structure is delimited with a tab character.
-	foreach(const QString& record, allRecords)
+	if (StarDataCache::read(GcvsFile, 11, records))
+		totalRecords = records.size();
+	else
 	{
-		++lineNumber;
-		if (record.isEmpty())
-			continue;
+		QFile vsFile(GcvsFile);
+		if (!vsFile.open(QIODevice::ReadOnly | QIODevice::Text))
+		{
+			qWarning() << "WARNING - could not open" << QDir::toNativeSeparators(GcvsFile);
+			return;
+		}
+		const QStringList& allRecords = QString::fromUtf8(vsFile.readAll()).split('\n');
+		vsFile.close();
 
-		++totalRecords;
-		const QStringList& fields = record.split('\t');
+		int lineNumber=0;
 
-		bool ok;
-		unsigned int hip = fields.at(0).toUInt(&ok);
-		if (!ok)
+		// record structure is delimited with a tab character.
+		foreach(const QString& record, allRecords)
 		{
-			qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(GcvsFile)
-				   << " - failed to convert " << fields.at(0) << "to a number";
-			continue;
+			++lineNumber;
+			if (record.isEmpty())
+				continue;
+
+			++totalRecords;
+			const QStringList& fields = record.split('\t');
+
+			bool ok;
+			StarDataCache::Record r;
+			r.hip = fields.at(0).toUInt(&ok);
+			if (!ok)
+			{
+				qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(GcvsFile)
+					   << " - failed to convert " << fields.at(0) << "to a number";
+				continue;
+			}
+			if (fields.size()<12)
+			{
+				qWarning() << "WARNING - parse error at line" << lineNumber << "in" << QDir::toNativeSeparators(GcvsFile)
+					   << " - record does not match record pattern";
+				continue;
+			}
+			// The fields are cached as strings, and converted when filling the table
+			for (int i=0;i<11;++i)
+				r.fields[i] = fields.at(i+1).trimmed();
+			records.append(r);
 		}
+		StarDataCache::write(GcvsFile, 11, records);
+	}
 
+	int readOk=0;
+	foreach (const StarDataCache::Record& r, records)
+	{
 		// Don't set the star if it's already set
-		if (varStarsMapI18n.find(hip)!=varStarsMapI18n.end())
+		if (varStarsMapI18n.find(r.hip)!=varStarsMapI18n.end())
 			continue;
 
 		varstar variableStar;
 
-		variableStar.designation = fields.at(1).trimmed();
-		variableStar.vtype = fields.at(2).trimmed();
-		variableStar.maxmag = fields.at(3).toFloat();
-		variableStar.mflag = fields.at(4).toInt();
-		variableStar.min1mag = fields.at(5).toFloat();
-		if (fields.at(6).isEmpty())
+		variableStar.designation = StelInternedString(r.fields[0]);
+		variableStar.vtype = StelInternedString(r.fields[1]);
+		variableStar.maxmag = r.fields[2].toFloat();
+		variableStar.mflag = r.fields[3].toInt();
+		variableStar.min1mag = r.fields[4].toFloat();
+		if (r.fields[5].isEmpty())
 			variableStar.min2mag = 99.f;
 		else
-			variableStar.min2mag = fields.at(6).toFloat();
-		variableStar.photosys = fields.at(7).trimmed();
-		variableStar.epoch = fields.at(8).toDouble();
-		variableStar.period = fields.at(9).toDouble();
-		variableStar.Mm = fields.at(10).toInt();
-		variableStar.stype = fields.at(11).trimmed();
-
-		varStarsMapI18n[hip] = variableStar;
-		varStarsIndexI18n[variableStar.designation.toUpper()] = hip;
+			variableStar.min2mag = r.fields[5].toFloat();
+		variableStar.photosys = StelInternedString(r.fields[6]);
+		variableStar.epoch = r.fields[7].toDouble();
+		variableStar.period = r.fields[8].toDouble();
+		variableStar.Mm = r.fields[9].toInt();
+		variableStar.stype = StelInternedString(r.fields[10]);
+
+		varStarsMapI18n[r.hip] = variableStar;
+		varStarsIndexI18n[r.fields[0].toUpper()] = r.hip;
 		++readOk;
 	}
 
@@ -781,9 +921,38 @@ int StarMgr::getMaxSearchLevel() const
 }
 
 
+void StarMgr::prefetchRegion(const Vec3d& j2000Pos, double fov, float limitMag)
+{
+	Vec3d center(j2000Pos);
+	center.normalize();
+	QVector<SphericalCap> caps;
+	caps.append(SphericalCap(center, std::cos(0.5*fov*M_PI/180.)));
+	StelCore* core = StelApp::getInstance().getCore();
+	foreach(ZoneArray* z, gridLevels)
+	{
+		// The catalogs are sorted by magnitude, the next ones are even fainter
+		if (0.001f*z->mag_min>limitMag)
+			break;
+		if (!z->isLoaded())
+		{
+			z->prefetch();
+			continue;
+		}
+		if (!ZoneArray::getUseAccessHints())
+			continue;
+		const GeodesicSearchResult* result = core->getGeodesicGrid(z->level)->search(caps, z->level);
+		int zone;
+		for (GeodesicSearchInsideIterator it(*result, z->level);(zone = it.next()) >= 0;)
+			z->willNeedZone(zone);
+		for (GeodesicSearchBorderIterator it(*result, z->level);(zone = it.next()) >= 0;)
+			z->willNeedZone(zone);
+	}
+}
+
 // Draw all the stars
 void StarMgr::draw(StelCore* core)
 {
+	STEL_TRACE_SCOPE("StarMgr::draw");
 	const StelProjectorP prj = core->getProjection(StelCore::FrameJ2000);
 	StelSkyDrawer* skyDrawer = core->getSkyDrawer();
 	// If stars are turned off don't waste time below
@@ -792,9 +961,18 @@ void StarMgr::draw(StelCore* core)
 		return;
 
 	int maxSearchLevel = getMaxSearchLevel();
-	QVector<SphericalCap> viewportCaps = prj->getViewportConvexPolygon()->getBoundingSphericalCaps();
+	QVector<SphericalCap> viewportCaps;
+	// In a narrow field, e.g. through an ocular, the zones are much larger than the viewport and most
+	// of their stars are outside of it: the bounding cap of the viewport rejects them with a single test.
+	const SphericalCap& boundingCap = prj->getBoundingCap();
+	if (boundingCap.d>NarrowFieldCosRadius)
+		viewportCaps.append(boundingCap);
+	viewportCaps += prj->getViewportConvexPolygon()->getBoundingSphericalCaps();
 	viewportCaps.append(core->getVisibleSkyArea());
-	const GeodesicSearchResult* geodesic_search_result = core->getGeodesicGrid(maxSearchLevel)->search(viewportCaps,maxSearchLevel);
+	// Search a slightly larger region so that the result can be reused while the view moves by less
+	// than a quarter of the width of the smallest zones (the sides of the icosahedron span 63.4 degrees)
+	const double searchTolerance = 0.25*1.1071/(1<<maxSearchLevel);
+	const GeodesicSearchResult* geodesic_search_result = core->getGeodesicGrid(maxSearchLevel)->search(viewportCaps,maxSearchLevel,searchTolerance);
 
 	// Set temporary static variable for optimization
 	const float names_brightness = labelsFader.getInterstate() * starsFader.getInterstate();
@@ -804,37 +982,39 @@ void StarMgr::draw(StelCore* core)
 	sPainter.setFont(starFont);
 	skyDrawer->preDrawPointSource(&sPainter);
 
-	// Prepare a table for storing precomputed RCMag for all ZoneArrays
-	RCMag rcmag_table[RCMAG_TABLE_SIZE];
-	
+	// The catalogs without names can be drawn from static GPU buffers if the projection allows it
+	const bool useGpuDrawer = gpuDrawer && gpuDrawer->begin(core, &sPainter);
+	static const double d2000 = 2451545.0;
+
 	// Draw all the stars of all the selected zones
-	foreach(const ZoneArray* z, gridLevels)
+	foreach(ZoneArray* z, gridLevels)
 	{
 		int limitMagIndex=RCMAG_TABLE_SIZE;
 		const float mag_min = 0.001f*z->mag_min;
 		const float k = (0.001f*z->mag_range)/z->mag_steps; // MagStepIncrement
-		for (int i=0;i<RCMAG_TABLE_SIZE;++i)
+		if (!z->isLoaded())
 		{
-			const float mag = mag_min+k*i;
-			if (skyDrawer->computeRCMag(mag, &rcmag_table[i])==false)
+			// Load the deep catalogs when their brightest stars become visible, and start
+			// reading them in the background when the limit magnitude gets close to them.
+			RCMag rcmag;
+			if (skyDrawer->computeRCMag(mag_min, &rcmag))
 			{
-				if (i==0)
+				// Don't wait for a catalog already being read in the background, it is drawn once ready
+				if (z->isPrefetching())
 					goto exit_loop;
-				
-				// The last magnitude at which the star is visible
-				limitMagIndex = i-1;
-				
-				// We reached the point where stars are not visible anymore
-				// Fill the rest of the table with zero and leave.
-				for (;i<RCMAG_TABLE_SIZE;++i)
-				{
-					rcmag_table[i].luminance=0;
-					rcmag_table[i].radius=0;
-				}
-				break;
+				z->load();
 			}
-			rcmag_table[i].radius *= starsFader.getInterstate();
+			else if (skyDrawer->computeRCMag(mag_min-LazyLoadingMagMargin, &rcmag))
+				z->prefetch();
 		}
+		// The RCMag tables are kept by the sky drawer as long as the view is not changed
+		int nbVisibleMagSteps;
+		const RCMag* rcmag_table = skyDrawer->getRCMagTable(mag_min, k, RCMAG_TABLE_SIZE, starsFader.getInterstate(), &nbVisibleMagSteps);
+		if (nbVisibleMagSteps==0)
+			goto exit_loop;
+		// The last magnitude at which the star is visible
+		if (nbVisibleMagSteps<RCMAG_TABLE_SIZE)
+			limitMagIndex = nbVisibleMagSteps-1;
 		lastMaxSearchLevel = z->level;
 
 		unsigned int maxMagStarName = 0;
@@ -847,14 +1027,98 @@ void StarMgr::draw(StelCore* core)
 				maxMagStarName = x;
 		}
 		int zone;
-		
+
+		if (ZoneArray::getUseAccessHints())
+		{
+			// Ask for all the visible zones before drawing the first one,
+			// so that the pages of the mapped catalogs are read in parallel
+			for (GeodesicSearchInsideIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
+				z->willNeedZone(zone);
+			for (GeodesicSearchBorderIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
+				z->willNeedZone(zone);
+		}
+
+		if (useGpuDrawer && z->mag_steps<=StarGpuDrawer::MaxMagSteps && dynamic_cast<const HipZoneArray*>(z)==NULL)
+		{
+			int cutoffMagStep = limitMagIndex;
+			if (skyDrawer->getFlagStarMagnitudeLimit())
+				cutoffMagStep = qMin(cutoffMagStep, ((int)(skyDrawer->getCustomStarMagnitudeLimit()*1000.f) - z->mag_min)*z->mag_steps/z->mag_range);
+			const float movementFactor = (M_PI/180)*(0.0001/3600) * ((core->getJDay()-d2000)/365.25) / z->star_position_scale;
+			gpuDrawer->setCatalogParams(rcmag_table, cutoffMagStep, 1.f/k, movementFactor);
+			for (GeodesicSearchInsideIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
+				gpuDrawer->drawZone(z, zone, cutoffMagStep);
+			for (GeodesicSearchBorderIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
+				gpuDrawer->drawZone(z, zone, cutoffMagStep);
+			continue;
+		}
+
+		if (flagParallelDrawing)
+		{
+			// Collect the visible zones, and if there are enough of them distribute them in slices
+			// projected by the thread pool once all the catalogs have been prepared
+			parallelInsideZones.resize(0);
+			parallelBorderZones.resize(0);
+			for (GeodesicSearchInsideIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
+				parallelInsideZones.append(zone);
+			for (GeodesicSearchBorderIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
+				parallelBorderZones.append(zone);
+			const int nbZones = parallelInsideZones.size()+parallelBorderZones.size();
+			if (nbZones>=MinParallelZones)
+			{
+				const int nbSlices = qMin(nbZones/(MinParallelZones/2), 2*QThread::idealThreadCount());
+				for (int i=0;i<nbSlices;++i)
+				{
+					if (nbDrawSlices==drawSlices.size())
+						drawSlices.append(new ZoneDrawSlice);
+					ZoneDrawSlice* slice = drawSlices.at(nbDrawSlices++);
+					slice->zoneArray = z;
+					slice->insideZones.resize(0);
+					slice->borderZones.resize(0);
+					for (int j=i;j<parallelInsideZones.size();j+=nbSlices)
+						slice->insideZones.append(parallelInsideZones.at(j));
+					for (int j=i;j<parallelBorderZones.size();j+=nbSlices)
+						slice->borderZones.append(parallelBorderZones.at(j));
+					slice->rcmagTable = rcmag_table;
+					slice->limitMagIndex = limitMagIndex;
+					slice->maxMagStarName = maxMagStarName;
+					slice->namesBrightness = names_brightness;
+					slice->core = core;
+					slice->viewportCaps = &viewportCaps;
+					slice->batch.clear();
+					slice->batch.projector = prj.data();
+				}
+				continue;
+			}
+		}
+
 		for (GeodesicSearchInsideIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
-			z->draw(&sPainter, zone, true, rcmag_table, limitMagIndex, core, maxMagStarName, names_brightness, viewportCaps);
+			z->draw(&sPainter, zone, true, rcmag_table, limitMagIndex, core, maxMagStarName, names_brightness, viewportCaps, NULL);
 		for (GeodesicSearchBorderIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
-			z->draw(&sPainter, zone, false, rcmag_table, limitMagIndex, core, maxMagStarName,names_brightness, viewportCaps);
+			z->draw(&sPainter, zone, false, rcmag_table, limitMagIndex, core, maxMagStarName,names_brightness, viewportCaps, NULL);
 	}
 	exit_loop:
 
+	if (nbDrawSlices>0)
+	{
+		// Project the slices in parallel, then submit their batches from this thread
+		QVector<ZoneDrawSlice*> slices = drawSlices.mid(0, nbDrawSlices);
+		StelApp::getInstance().getJobSystem()->blockingMap(slices, drawZoneSlice);
+		LabelMgr* labelMgr = GETSTELMODULE(LabelMgr);
+		foreach (const ZoneDrawSlice* slice, slices)
+		{
+			skyDrawer->drawPointSourceBatch(&sPainter, slice->batch.points);
+			foreach (const ZoneDrawBatch::Label& label, slice->batch.labels)
+			{
+				sPainter.setColor(label.color[0], label.color[1], label.color[2], label.brightness);
+				labelMgr->addSkyLabel(sPainter, label.win[0], label.win[1], label.text, label.offset, label.offset, label.mag);
+			}
+		}
+		nbDrawSlices = 0;
+	}
+
+	if (useGpuDrawer)
+		gpuDrawer->end();
+
 	// Finish drawing many stars
 	skyDrawer->postDrawPointSource(&sPainter);
 
@@ -863,6 +1127,11 @@ void StarMgr::draw(StelCore* core)
 }
 
 
+static bool candidateBrighter(const ZoneArray::SearchCandidate& a, const ZoneArray::SearchCandidate& b)
+{
+	return a.mag < b.mag;
+}
+
 // Return a stl vector containing the stars located
 // inside the limFov circle around position v
 QList<StelObjectP > StarMgr::searchAround(const Vec3d& vv, double limFov, const StelCore* core) const
@@ -917,22 +1186,34 @@ QList<StelObjectP > StarMgr::searchAround(const Vec3d& vv, double limFov, const
 
 	// Iterate over the stars inside the triangles
 	f = cos(limFov * M_PI/180.);
+	const float limitMag = core->getSkyDrawer()->getLimitMagnitude();
+	// The stars are only identified while searching
+	QVector<ZoneArray::SearchCandidate> candidates;
 	foreach(ZoneArray* z, gridLevels)
 	{
-		//qDebug() << "search inside(" << it->first << "):";
+		// The stars of a catalog which is not loaded yet are not drawn either
+		if (!z->isLoaded())
+			continue;
+		// Neither are the stars fainter than the limit magnitude
+		const int maxMagStep = (int)((limitMag*1000.f - z->mag_min)*z->mag_steps/z->mag_range);
+		if (maxMagStep < 0)
+			continue;
 		int zone;
 		for (GeodesicSearchInsideIterator it1(*geodesic_search_result,z->level);(zone = it1.next()) >= 0;)
-		{
-			z->searchAround(core, zone,v,f,result);
-			//qDebug() << " " << zone;
-		}
-		//qDebug() << endl << "search border(" << it->first << "):";
+			z->searchAround(core, zone,v,f,maxMagStep,candidates);
 		for (GeodesicSearchBorderIterator it1(*geodesic_search_result,z->level); (zone = it1.next()) >= 0;)
-		{
-			z->searchAround(core, zone,v,f,result);
-			//qDebug() << " " << zone;
-		}
+			z->searchAround(core, zone,v,f,maxMagStep,candidates);
 	}
+
+	// Only the brightest stars of the dense fields are made objects, they are the ones preferred by the selection
+	if (candidates.size() > MaxSearchResults)
+	{
+		std::nth_element(candidates.begin(), candidates.begin()+MaxSearchResults, candidates.end(), candidateBrighter);
+		candidates.resize(MaxSearchResults);
+	}
+	result.reserve(candidates.size());
+	foreach (const ZoneArray::SearchCandidate& c, candidates)
+		result.append(c.array->createStelObject(c));
 	return result;
 }
 
@@ -941,20 +1222,38 @@ QList<StelObjectP > StarMgr::searchAround(const Vec3d& vv, double limFov, const
 //! The translation is done using gettext with translated strings defined in translations.h
 void StarMgr::updateI18n()
 {
+	QWriteLocker locker(getNameSearchLock());
 	QRegExp transRx("_[(]\"(.*)\"[)]");
 	const StelTranslator& trans = StelApp::getInstance().getLocaleMgr().getSkyTranslator();
 	commonNamesMapI18n.clear();
 	commonNamesIndexI18n.clear();
-	for (QHash<int,QString>::ConstIterator it(commonNamesMap.constBegin());it!=commonNamesMap.constEnd();it++)
+	for (QHash<int,StelInternedString>::ConstIterator it(commonNamesMap.constBegin());it!=commonNamesMap.constEnd();it++)
 	{
 		const int i = it.key();
-		transRx.exactMatch(it.value());
+		transRx.exactMatch(it.value().toString());
 		QString tt = transRx.capturedTexts().at(1);
 		const QString t = trans.qtranslate(tt);
 		//const QString t(trans.qtranslate(it.value()));
-		commonNamesMapI18n[i] = t;
+		commonNamesMapI18n[i] = StelInternedString(t);
 		commonNamesIndexI18n[t.toUpper()] = i;
 	}
+	fillSearchIndex(commonNamesSearchIndexI18n, commonNamesIndexI18n);
+}
+
+void StarMgr::prepareNameSearch(bool useStartOfWords)
+{
+	if (commonNamesSearchIndexI18n.isPrepared(!useStartOfWords) && commonNamesSearchIndex.isPrepared(!useStartOfWords))
+		return;
+	QWriteLocker locker(getNameSearchLock());
+	commonNamesSearchIndexI18n.prepare(!useStartOfWords);
+	commonNamesSearchIndex.prepare(!useStartOfWords);
+}
+
+void StarMgr::fillSearchIndex(StelNameIndex& searchIndex, const QMap<QString, int>& namesIndex)
+{
+	searchIndex.clear();
+	for (QMap<QString,int>::ConstIterator it=namesIndex.constBegin();it!=namesIndex.constEnd();++it)
+		searchIndex.insert(it.key(), it.value());
 }
 
 // Search the star by HP number
@@ -1055,34 +1354,10 @@ QStringList StarMgr::listMatchingObjectsI18n(const QString& objPrefix, int maxNb
 	QString objw = objPrefix.toUpper();
 
 	// Search for common names
-	if (useStartOfWords) {
-		for (QMap<QString,int>::const_iterator it(commonNamesIndexI18n.lowerBound(objw)); it!=commonNamesIndexI18n.end(); ++it)
-		{
-			if (it.key().startsWith(objw))
-			{
-				if (maxNbItem==0)
-					break;
-				result << getCommonName(it.value());
-				--maxNbItem;
-			}
-			else
-				break;
-		}
-	}
-	else
+	foreach (int hip, commonNamesSearchIndexI18n.find(objw, maxNbItem, useStartOfWords))
 	{
-		QMapIterator<QString, int> i(commonNamesIndexI18n);
-		while (i.hasNext())
-		{
-			i.next();
-			if (i.key().contains(objw))
-			{
-				if (maxNbItem==0)
-					break;
-				result << getCommonName(i.value());
-				--maxNbItem;
-			}
-		}
+		result << getCommonName(hip);
+		--maxNbItem;
 	}
 
 	// Search for sci names
@@ -1165,35 +1440,10 @@ QStringList StarMgr::listMatchingObjects(const QString& objPrefix, int maxNbItem
 	QString objw = objPrefix.toUpper();
 
 	// Search for common names
-	if (useStartOfWords)
+	foreach (int hip, commonNamesSearchIndex.find(objw, maxNbItem, useStartOfWords))
 	{
-		for (QMap<QString,int>::const_iterator it(commonNamesIndex.lowerBound(objw)); it!=commonNamesIndex.end(); ++it)
-		{
-			if (it.key().startsWith(objw))
-			{
-				if (maxNbItem==0)
-					break;
-				result << getCommonName(it.value());
-				--maxNbItem;
-			}
-			else
-				break;
-		}
-	}
-	else
-	{
-		QMapIterator<QString, int> i(commonNamesIndex);
-		while (i.hasNext())
-		{
-			i.next();
-			if (i.key().contains(objw))
-			{
-				if (maxNbItem==0)
-					break;
-				result << getCommonName(i.value());
-				--maxNbItem;
-			}
-		}
+		result << getCommonName(hip);
+		--maxNbItem;
 	}
 
 	// Search for sci names
@@ -1276,6 +1526,8 @@ void StarMgr::setFontSize(float newFontSize)
 
 void StarMgr::updateSkyCulture(const QString& skyCultureDir)
 {
+	// The searches of names read them
+	QWriteLocker locker(getNameSearchLock());
 	// Load culture star names in english
 	QString fic = StelFileMgr::findFile("skycultures/" + skyCultureDir + "/star_names.fab");
 	if (fic.isEmpty())
@@ -1283,17 +1535,25 @@ void StarMgr::updateSkyCulture(const QString& skyCultureDir)
 	else
 		loadCommonNames(fic);
 
-	fic = StelFileMgr::findFile("stars/default/name.fab");
-	if (fic.isEmpty())
-		qWarning() << "WARNING: could not load scientific star names file: stars/default/name.fab";
-	else
-		loadSciNames(fic);
-	
-	fic = StelFileMgr::findFile("stars/default/gcvs_hip_part.dat");
-	if (fic.isEmpty())
-		qWarning() << "WARNING: could not load variable stars file: stars/default/gcvs_hip_part.dat";
-	else
-		loadGcvs(fic);
+	// The scientific names and the variable stars do not depend on the sky culture,
+	// they are only loaded with the first sky culture
+	if (sciNamesMapI18n.isEmpty())
+	{
+		fic = StelFileMgr::findFile("stars/default/name.fab");
+		if (fic.isEmpty())
+			qWarning() << "WARNING: could not load scientific star names file: stars/default/name.fab";
+		else
+			loadSciNames(fic);
+	}
+
+	if (varStarsMapI18n.isEmpty())
+	{
+		fic = StelFileMgr::findFile("stars/default/gcvs_hip_part.dat");
+		if (fic.isEmpty())
+			qWarning() << "WARNING: could not load variable stars file: stars/default/gcvs_hip_part.dat";
+		else
+			loadGcvs(fic);
+	}
 
 	// Turn on sci names/catalog names for western culture only
 	setFlagSciNames(skyCultureDir.startsWith("western"));
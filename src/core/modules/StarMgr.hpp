@@ -27,6 +27,8 @@
 #include "StelObjectModule.hpp"
 #include "StelTextureTypes.hpp"
 #include "StelProjectorType.hpp"
+#include "StelNameIndex.hpp"
+#include "StelStringPool.hpp"
 
 class StelObject;
 class StelToneReproducer;
@@ -35,23 +37,25 @@ class StelPainter;
 class QSettings;
 
 class ZoneArray;
+class StarGpuDrawer;
+struct ZoneDrawSlice;
 struct HipIndexStruct;
 
 static const int RCMAG_TABLE_SIZE = 4096;
 
 typedef struct
 {
-	QString designation;	//! GCVS designation
-	QString vtype;		//! Type of variability
+	StelInternedString designation;	//! GCVS designation
+	StelInternedString vtype;	//! Type of variability
 	float maxmag;		//! Magnitude at maximum brightness
 	int mflag;		//! Magnitude flag code
 	float min1mag;		//! First minimum magnitude or amplitude
 	float min2mag;		//! Second minimum magnitude or amplitude
-	QString photosys;	//! The photometric system for magnitudes
+	StelInternedString photosys;	//! The photometric system for magnitudes
 	double epoch;		//! Epoch for maximum light (Julian days)
 	double period;		//! Period of the variable star (days)
 	int Mm;			//! Rising time or duration of eclipse (%)
-	QString stype;		//! Spectral type
+	StelInternedString stype;	//! Spectral type
 } varstar;
 
 //! @class StarMgr
@@ -114,10 +118,17 @@ public:
 	//! Used to determine the order in which the various StelModules are drawn.
 	virtual double getCallOrder(StelModuleActionName actionName) const;
 
+	//! Estimate the memory used by the names tables and the Hipparcos index.
+	//! The stars of the catalogs are counted by the ZoneArray themselves.
+	virtual qint64 getMemoryUsed() const;
+
 	///////////////////////////////////////////////////////////////////////////
 	// Methods defined in StelObjectManager class
-	//! Return a list containing the stars located inside the limFov circle around position v
+	//! Return a list containing the stars located inside the limFov circle around position v.
+	//! In the dense fields only the MaxSearchResults brightest ones are returned.
 	virtual QList<StelObjectP > searchAround(const Vec3d& v, double limitFov, const StelCore* core) const;
+	//! The maximum number of stars returned by searchAround().
+	static const int MaxSearchResults = 256;
 
 	//! Return the matching Stars object's pointer if exists or NULL
 	//! @param nameI18n The case in-sensistive star common name or HP
@@ -143,6 +154,9 @@ public:
 	// empty, as there's too much stars for displaying at once
 	virtual QStringList listAllObjects(bool inEnglish) const { Q_UNUSED(inEnglish) return QStringList(); }
 	virtual QString getName() const { return "Stars"; }
+	virtual bool hasThreadSafeNameSearch() const {return true;}
+	//! Build the indexes of the names, so that the searches in the thread pool only read them.
+	virtual void prepareNameSearch(bool useStartOfWords);
 
 public slots:
 	///////////////////////////////////////////////////////////////////////////
@@ -271,8 +285,19 @@ public:
 
 	//! Try to load the given catalog, even if it is marched as unchecked.
 	//! Mark it as checked if checksum is correct.
+	//! @param verified true when the checksum of the file was already verified, e.g. while it was
+	//! downloaded, in which case the catalog is marked as checked without reading it again.
 	//! @return false in case of failure.
-	bool checkAndLoadCatalog(const QVariantMap& m);
+	bool checkAndLoadCatalog(const QVariantMap& m, bool verified=false);
+
+	//! Start reading the stars which will be drawn around a position, typically the target of a
+	//! zoom into a narrow field such as an ocular view, so that they are ready when the zoom ends.
+	//! The catalogs not loaded yet are loaded in the background, and for the mapped ones the pages
+	//! of the zones intersecting the field are read ahead.
+	//! @param j2000Pos the center of the field in the J2000 frame.
+	//! @param fov the diameter of the field in degrees.
+	//! @param limitMag the faintest magnitude which will be visible in the field.
+	void prefetchRegion(const Vec3d& j2000Pos, double fov, float limitMag);
 
 private slots:
 	void setStelStyle(const QString& section);
@@ -300,7 +325,7 @@ private:
 	int loadCommonNames(const QString& commonNameFile);
 
 	//! Loads scientific names for stars from a file.
-	//! Called when the SkyCulture is updated.
+	//! Called when the first SkyCulture is loaded.
 	//! @param the path to a file containing the scientific names for bright stars.
 	void loadSciNames(const QString& sciNameFile);
 
@@ -346,15 +371,20 @@ private:
 
 	HipIndexStruct *hipIndex; // array of hiparcos stars
 
-	static QHash<int, QString> commonNamesMap;
-	static QHash<int, QString> commonNamesMapI18n;
+	//! The names are kept in the shared StelStringPool, converted to QString when displayed.
+	static QHash<int, StelInternedString> commonNamesMap;
+	static QHash<int, StelInternedString> commonNamesMapI18n;
 	static QMap<QString, int> commonNamesIndexI18n;
 	static QMap<QString, int> commonNamesIndex;
+	//! Indexes of the common names used for the auto-completion.
+	static StelNameIndex commonNamesSearchIndexI18n;
+	static StelNameIndex commonNamesSearchIndex;
+	static void fillSearchIndex(StelNameIndex& searchIndex, const QMap<QString, int>& namesIndex);
 
-	static QHash<int, QString> sciNamesMapI18n;	
+	static QHash<int, StelInternedString> sciNamesMapI18n;
 	static QMap<QString, int> sciNamesIndexI18n;
 
-	static QHash<int, QString> sciAdditionalNamesMapI18n;
+	static QHash<int, StelInternedString> sciAdditionalNamesMapI18n;
 	static QMap<QString, int> sciAdditionalNamesIndexI18n;
 
 	static QHash<int, varstar> varStarsMapI18n;
@@ -366,6 +396,24 @@ private:
 
 	StelTextureSP texPointer;		// The selection pointer texture
 
+	//! Whether the catalogs without names are projected on the GPU from static buffers.
+	bool flagGpuStarProjection;
+	//! Used to draw the zones on the GPU, NULL if flagGpuStarProjection is false.
+	StarGpuDrawer* gpuDrawer;
+
+	//! Whether the stars of the catalogs without names are only loaded when they become visible.
+	bool flagLazyCatalogLoading;
+
+	//! Whether the visible zones are projected from the threads of the global thread pool.
+	bool flagParallelDrawing;
+	//! The slices of zones projected by each task, kept from one frame to the next to reuse their buffers.
+	QVector<ZoneDrawSlice*> drawSlices;
+	//! Number of slices of drawSlices used in the current frame.
+	int nbDrawSlices;
+	//! The visible zones of the catalog being distributed in drawSlices.
+	QVector<int> parallelInsideZones;
+	QVector<int> parallelBorderZones;
+
 	class StelObjectMgr* objectMgr;
 
 	QString starConfigFileFullPath;
@@ -27,6 +27,7 @@
 #include "StelUtils.hpp"
 #include "StelTranslator.hpp"
 
+#include <QMutex>
 #include <QTextStream>
 #include <limits>
 
@@ -262,6 +263,50 @@ QString StarWrapper1::getInfoString(const StelCore *core, const InfoStringGroup&
 	return str;
 }
 
+// The free blocks of the StarWrappers pool, linked by their first bytes. The StarWrappers are
+// created by the searches in the threads of the StelObjectMgr, and released by the main thread.
+static QMutex starWrapperPoolMutex;
+static void* starWrapperFreeBlocks = NULL;
+static int nbStarWrapperFreeBlocks = 0;
+// The blocks above this number are given back to the heap
+static const int MaxStarWrapperFreeBlocks = 4096;
+static const size_t StarWrapperBlockSize = qMax(sizeof(StarWrapper1), qMax(sizeof(StarWrapper2), sizeof(StarWrapper3)));
+
+void* StarWrapperBase::operator new(size_t size)
+{
+	if (size>StarWrapperBlockSize)
+		return ::operator new(size);
+	{
+		QMutexLocker lock(&starWrapperPoolMutex);
+		if (starWrapperFreeBlocks)
+		{
+			void* p = starWrapperFreeBlocks;
+			starWrapperFreeBlocks = *static_cast<void**>(p);
+			--nbStarWrapperFreeBlocks;
+			return p;
+		}
+	}
+	return ::operator new(StarWrapperBlockSize);
+}
+
+void StarWrapperBase::operator delete(void* p, size_t size)
+{
+	if (!p)
+		return;
+	if (size<=StarWrapperBlockSize)
+	{
+		QMutexLocker lock(&starWrapperPoolMutex);
+		if (nbStarWrapperFreeBlocks<MaxStarWrapperFreeBlocks)
+		{
+			*static_cast<void**>(p) = starWrapperFreeBlocks;
+			starWrapperFreeBlocks = p;
+			++nbStarWrapperFreeBlocks;
+			return;
+		}
+	}
+	::operator delete(p);
+}
+
 StelObjectP Star1::createStelObject(const SpecialZoneArray<Star1> *a,
 									const SpecialZoneData<Star1> *z) const {
   return StelObjectP(new StarWrapper1(a,z,this), true);
@@ -40,8 +40,14 @@ template <class Star> struct SpecialZoneData;
 //! The StarWrapper is destroyed when it is not needed anymore, by utilizing reference counting.
 //! So there is no chance that more than a few hundreds of StarWrappers are alive simultanousely.
 //! Another reason for having the StarWrapper is to encapsulate the differences between the different kinds of Stars (Star1,Star2,Star3).
+//! The searches around the mouse create and release many StarWrappers, so their memory is taken from
+//! a pool of free blocks instead of the heap.
 class StarWrapperBase : public StelObject
 {
+public:
+	static void* operator new(size_t size);
+	static void operator delete(void* p, size_t size);
+
 protected:
 	StarWrapperBase(void) : ref_count(0) {;}
 	virtual ~StarWrapperBase(void) {;}
@@ -23,13 +23,27 @@
 #include "StelGeodesicGrid.hpp"
 #include "StelObject.hpp"
 #include "StelPainter.hpp"
+#include "StelRenderStats.hpp"
+#include "StelMemoryStats.hpp"
+#include "StarGpuDrawer.hpp"
+#include "LabelMgr.hpp"
+#include "StelModuleMgr.hpp"
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
 #include <QDir>
+#include <QSaveFile>
+#include <QVarLengthArray>
+#include <QtConcurrent>
 #ifdef Q_OS_WIN
 #include <io.h>
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 
@@ -41,6 +55,60 @@ static unsigned int stel_bswap_32(unsigned int val)
 
 static const Vec3f north(0,0,1);
 
+bool ZoneArray::useAccessHints = true;
+int ZoneArray::positionCacheMaxStars = 0;
+int ZoneArray::positionCacheNbStars = 0;
+
+// Maximum error on the cached star positions caused by the proper motions, in radians (0.1 arcsec)
+static const float PositionCacheTolerance = 0.1f/3600.f*M_PI/180.f;
+
+enum MappingAdvice
+{
+	AdviceRandom,
+	AdviceWillNeed
+};
+
+// Give the system a hint on how a mapped range is going to be accessed.
+// The range is extended to whole pages, as required by madvise.
+static void adviseMapping(const void* data, qint64 size, MappingAdvice advice)
+{
+	if (data==0 || size<=0)
+		return;
+#ifdef Q_OS_WIN
+	if (advice!=AdviceWillNeed)
+		return;
+	// PrefetchVirtualMemory only exists since Windows 8, so it is looked up at runtime
+	struct MemoryRange
+	{
+		PVOID VirtualAddress;
+		SIZE_T NumberOfBytes;
+	};
+	typedef BOOL (WINAPI *PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR, MemoryRange*, ULONG);
+	static PrefetchVirtualMemoryFunc prefetchVirtualMemory = (PrefetchVirtualMemoryFunc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	if (prefetchVirtualMemory)
+	{
+		MemoryRange range;
+		range.VirtualAddress = (PVOID)data;
+		range.NumberOfBytes = (SIZE_T)size;
+		prefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	static const quintptr pageSize = sysconf(_SC_PAGESIZE);
+	const quintptr start = (quintptr)data & ~(pageSize-1);
+	const quintptr end = (quintptr)data + size;
+	if (advice==AdviceWillNeed)
+	{
+		madvise((void*)start, end-start, MADV_WILLNEED);
+		return;
+	}
+	madvise((void*)start, end-start, MADV_RANDOM);
+#ifdef MADV_HUGEPAGE
+	// Only effective when the kernel supports huge pages for read only file mappings
+	madvise((void*)start, end-start, MADV_HUGEPAGE);
+#endif
+#endif
+}
+
 void ZoneArray::initTriangle(int index, const Vec3f &c0, const Vec3f &c1, const Vec3f &c2)
 {
 	// initialize center,axis0,axis1:
@@ -50,6 +118,9 @@ void ZoneArray::initTriangle(int index, const Vec3f &c0, const Vec3f &c1, const
 	z.axis0 = north ^ z.center;
 	z.axis0.normalize();
 	z.axis1 = z.center ^ z.axis0;
+
+	const float minCos = qMin(c0*z.center, qMin(c1*z.center, c2*z.center));
+	zone_radius = qMax(zone_radius, std::acos(qBound(-1.f, minCos, 1.f)));
 	
 	// Initialize star_position_scale. This scale is used to multiply stars position
 	// encoded as integers so that it optimize precision over the triangle.
@@ -90,7 +161,15 @@ static inline int ReadInt(QFile& file, unsigned int &x)
 #endif
 #endif
 
-ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
+// Get the path of the native byte order copy of a catalog in the other byte order.
+static QString getNativeCopyPath(const QString& catalogFilePath)
+{
+	const QFileInfo info(catalogFilePath);
+	const QByteArray hash = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+	return StelFileMgr::getCacheDir() + "/stars/" + info.completeBaseName() + "-" + QString::fromLatin1(hash) + ".cat";
+}
+
+ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap, bool lazy_loading)
 {
 	QString dbStr; // for debugging output.
 	QFile* file = new QFile(catalogFilePath);
@@ -115,11 +194,24 @@ ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
 		return 0;
 	}
 	const bool byte_swap = (magic == FILE_MAGIC_OTHER_ENDIAN);
+	QString nativeCopyPath;
 	if (byte_swap)
 	{
 		// ok, FILE_MAGIC_OTHER_ENDIAN, must swap
 		if (use_mmap)
 		{
+			// Map the native copy written by a previous run, unless the catalog was replaced since
+			nativeCopyPath = getNativeCopyPath(catalogFilePath);
+			const QFileInfo copyInfo(nativeCopyPath);
+			if (copyInfo.exists() && copyInfo.lastModified() >= QFileInfo(catalogFilePath).lastModified())
+			{
+				ZoneArray* copy = create(nativeCopyPath, true, lazy_loading);
+				if (copy)
+				{
+					delete file;
+					return copy;
+				}
+			}
 			dbStr += "warning - must convert catalogue ";
 #if (!defined(__GNUC__))
 			dbStr += "to native format ";
@@ -128,7 +220,8 @@ ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
 			qWarning() << dbStr;
 			use_mmap = false;
 			qWarning() << "Revert to not using mmmap";
-			//return 0;
+			// The stars are all read now, to write the native copy mapped by the next runs
+			lazy_loading = false;
 		}
 		dbStr += "byteswap ";
 		type = stel_bswap_32(type);
@@ -169,7 +262,8 @@ ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
 	switch (type)
 	{
 		case 0:
-			if (major > MAX_MAJOR_FILE_VERSION)
+			// The Hipparcos catalog is small and referenced by the hip index, it's never compressed
+			if (major >= COMPRESSED_MAJOR_FILE_VERSION)
 			{
 				dbStr += "warning - unsupported version ";
 			}
@@ -201,7 +295,8 @@ ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
 #ifndef _MSC_BUILD
 				Q_ASSERT(sizeof(Star2) == 10);
 #endif
-				rval = new SpecialZoneArray<Star2>(file, byte_swap, use_mmap, level, mag_min, mag_range, mag_steps);
+				rval = new SpecialZoneArray<Star2>(file, byte_swap, use_mmap, lazy_loading, level, mag_min, mag_range, mag_steps,
+									 major==COMPRESSED_MAJOR_FILE_VERSION);
 				if (rval == 0)
 				{
 					dbStr += "error - no memory ";
@@ -222,7 +317,8 @@ ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
 #ifndef _MSC_BUILD
 				Q_ASSERT(sizeof(Star3) == 6);
 #endif
-				rval = new SpecialZoneArray<Star3>(file, byte_swap, use_mmap, level, mag_min, mag_range, mag_steps);
+				rval = new SpecialZoneArray<Star3>(file, byte_swap, use_mmap, lazy_loading, level, mag_min, mag_range, mag_steps,
+									 major==COMPRESSED_MAJOR_FILE_VERSION);
 				if (rval == 0)
 				{
 					dbStr += "error - no memory ";
@@ -237,6 +333,13 @@ ZoneArray* ZoneArray::create(const QString& catalogFilePath, bool use_mmap)
 	{
 		dbStr += QString("%1").arg(rval->getNrOfStars());
 		qDebug() << dbStr;
+		if (!nativeCopyPath.isEmpty())
+		{
+			if (rval->saveNativeCopy(nativeCopyPath, type, minor))
+				qDebug() << "Wrote native copy of" << QDir::toNativeSeparators(catalogFilePath) << "to" << QDir::toNativeSeparators(nativeCopyPath);
+			else
+				qWarning() << "Cannot write native copy of" << QDir::toNativeSeparators(catalogFilePath) << "to" << QDir::toNativeSeparators(nativeCopyPath);
+		}
 	}
 	else
 	{
@@ -255,10 +358,13 @@ ZoneArray::ZoneArray(const QString& fname, QFile* file, int level, int mag_min,
 			 int mag_range, int mag_steps)
 			: fname(fname), level(level), mag_min(mag_min),
 			  mag_range(mag_range), mag_steps(mag_steps),
-			  star_position_scale(0.0), zones(0), file(file)
+			  star_position_scale(0.0), zone_radius(0.f), zones(0), file(file), loaded(0)
 {
 	nr_of_zones = StelGeodesicGrid::nrOfZones(level);
 	nr_of_stars = 0;
+	StelRenderStats* stats = StelApp::getInstance().getRenderStats();
+	statsProjected = stats->registerCounter(QString("Stars projected (level %1)").arg(level));
+	statsDrawn = stats->registerCounter(QString("Stars drawn (level %1)").arg(level));
 }
 
 bool ZoneArray::readFile(QFile& file, void *data, qint64 size)
@@ -283,6 +389,25 @@ bool ZoneArray::readFile(QFile& file, void *data, qint64 size)
 	return true;
 }
 
+void ZoneArray::load()
+{
+	if (isLoaded())
+		return;
+	QMutexLocker lock(&loadMutex);
+	if (isLoaded())
+		return;
+	if (!loadStars())
+		qWarning() << "Error while loading the stars of" << QDir::toNativeSeparators(fname);
+	loaded.storeRelease(1);
+}
+
+void ZoneArray::prefetch()
+{
+	if (isLoaded() || prefetchFuture.isRunning())
+		return;
+	prefetchFuture = QtConcurrent::run(this, &ZoneArray::load);
+}
+
 void HipZoneArray::updateHipIndex(HipIndexStruct hipIndex[]) const
 {
 	for (const SpecialZoneData<Star1> *z=getZones()+(nr_of_zones-1);z>=getZones();z--)
@@ -317,10 +442,11 @@ void SpecialZoneArray<Star>::scaleAxis()
 }
 
 template<class Star>
-SpecialZoneArray<Star>::SpecialZoneArray(QFile* file, bool byte_swap,bool use_mmap,
-					 int level, int mag_min, int mag_range, int mag_steps)
+SpecialZoneArray<Star>::SpecialZoneArray(QFile* file, bool byte_swap,bool use_mmap,bool lazy_loading,
+					 int level, int mag_min, int mag_range, int mag_steps, bool compressed)
 		: ZoneArray(file->fileName(), file, level, mag_min, mag_range, mag_steps),
-		  stars(0), mmap_start(0)
+		  stars(0), mmap_start(0), byte_swap(byte_swap), use_mmap(use_mmap && !compressed), stars_pos(0),
+		  positionCacheMovementFactor(0.f), positionCacheNbStarsInArray(0)
 {
 	if (nr_of_zones > 0)
 	{
@@ -357,9 +483,29 @@ SpecialZoneArray<Star>::SpecialZoneArray(QFile* file, bool byte_swap,bool use_mm
 				getZones()[z].size = tmp_spu_int32;
 			}
 		}
+		if (compressed && zones)
+		{
+			// The zone sizes are followed by the sizes of the compressed zones
+			compressed_sizes.resize(nr_of_zones);
+			if ((qint64)(sizeof(unsigned int)*nr_of_zones) != file->read((char*)compressed_sizes.data(), sizeof(unsigned int)*nr_of_zones))
+			{
+				qDebug() << "Error reading compressed zones from catalog:"
+					 << file->fileName();
+				delete[] getZones();
+				zones = 0;
+				nr_of_zones = 0;
+				nr_of_stars = 0;
+			}
+			else if (byte_swap)
+			{
+				for (int z=0;z<compressed_sizes.size();z++)
+					compressed_sizes[z] = stel_bswap_32(compressed_sizes[z]);
+			}
+		}
 		// delete zone_size before allocating stars
 		// in order to avoid memory fragmentation:
 		delete[] zone_size;
+		stars_pos = file->pos();
 
 		if (nr_of_stars == 0)
 		{
@@ -368,110 +514,200 @@ SpecialZoneArray<Star>::SpecialZoneArray(QFile* file, bool byte_swap,bool use_mm
 			zones = 0;
 			nr_of_zones = 0;
 		}
+		else if (lazy_loading)
+		{
+			// The file is kept open until load() is called
+			return;
+		}
+		else if (!loadStars())
+		{
+			delete[] getZones();
+			zones = 0;
+			nr_of_zones = 0;
+		}
+		// GZ: Some diagnostics to understand the undocumented vars around mag.
+		// qDebug() << "SpecialZoneArray: mag_min=" << mag_min << ", mag_steps=" << mag_steps << ", mag_range=" << mag_range ;
+	}
+	loaded.storeRelease(1);
+}
+
+template<class Star>
+bool SpecialZoneArray<Star>::loadStars()
+{
+	bool ok = true;
+	if (use_mmap)
+	{
+		mmap_start = file->map(stars_pos, sizeof(Star)*nr_of_stars);
+		if (mmap_start == 0)
+		{
+			qDebug() << "ERROR: SpecialZoneArray(" << level
+				 << ")::SpecialZoneArray: QFile(" << file->fileName()
+				 << ".map(" << stars_pos
+				 << ',' << sizeof(Star)*nr_of_stars
+				 << ") failed: " << file->errorString();
+			ok = false;
+		}
 		else
 		{
-			if (use_mmap)
-			{
-				mmap_start = file->map(file->pos(), sizeof(Star)*nr_of_stars);
-				if (mmap_start == 0)
-				{
-					qDebug() << "ERROR: SpecialZoneArray(" << level
-						 << ")::SpecialZoneArray: QFile(" << file->fileName()
-						 << ".map(" << file->pos()
-						 << ',' << sizeof(Star)*nr_of_stars
-						 << ") failed: " << file->errorString();
-					stars = 0;
-					nr_of_stars = 0;
-					delete[] getZones();
-					zones = 0;
-					nr_of_zones = 0;
-				}
-				else
-				{
-					stars = (Star*)mmap_start;
-					Star *s = stars;
-					for (unsigned int z=0;z<nr_of_zones;z++)
-					{
-
-						getZones()[z].stars = s;
-						s += getZones()[z].size;
-					}
-				}
-				file->close();
-			}
-			else
-			{
-				stars = new Star[nr_of_stars];
-				if (stars == 0)
-				{
-					qDebug() << "ERROR: SpecialZoneArray(" << level
-						 << ")::SpecialZoneArray: no memory (3)";
-					exit(1);
-				}
-				if (!readFile(*file,stars,sizeof(Star)*nr_of_stars))
-				{
-					delete[] stars;
-					stars = 0;
-					nr_of_stars = 0;
-					delete[] getZones();
-					zones = 0;
-					nr_of_zones = 0;
-				}
-				else
-				{
-					Star *s = stars;
-					for (unsigned int z=0;z<nr_of_zones;z++)
-					{
-						getZones()[z].stars = s;
-						s += getZones()[z].size;
-					}
-					if (
+			stars = (Star*)mmap_start;
+			// The zones are accessed in the order they become visible,
+			// so reading ahead the neighbouring pages is mostly wasted
+			if (useAccessHints)
+				adviseMapping(mmap_start, sizeof(Star)*nr_of_stars, AdviceRandom);
+		}
+	}
+	else
+	{
+		stars = new Star[nr_of_stars];
+		if (stars == 0)
+		{
+			qDebug() << "ERROR: SpecialZoneArray(" << level
+				 << ")::SpecialZoneArray: no memory (3)";
+			exit(1);
+		}
+		const bool read = compressed_sizes.isEmpty() ?
+			(file->seek(stars_pos) && readFile(*file,stars,sizeof(Star)*nr_of_stars)) :
+			readCompressedStars();
+		if (!read)
+		{
+			delete[] stars;
+			ok = false;
+		}
+		else if (
 #if (!defined(__GNUC__))
-						true
+			true
 #else
-						byte_swap
+			byte_swap
 #endif
-					)
-					{
-						s = stars;
-						for (unsigned int i=0;i<nr_of_stars;i++,s++)
-						{
-							s->repack(
+		)
+		{
+			Star *s = stars;
+			for (unsigned int i=0;i<nr_of_stars;i++,s++)
+			{
+				s->repack(
 #if Q_BYTE_ORDER == Q_BIG_ENDIAN
-								// need for byte_swap on a BE machine means that catalog is LE
-								!byte_swap
+					// need for byte_swap on a BE machine means that catalog is LE
+					!byte_swap
 #else
-								// need for byte_swap on a LE machine means that catalog is BE
-								byte_swap
+					// need for byte_swap on a LE machine means that catalog is BE
+					byte_swap
 #endif
-							);
-						}
-					}
-				}
-				file->close();
+				);
 			}
 		}
-		// GZ: Some diagnostics to understand the undocumented vars around mag.
-		// qDebug() << "SpecialZoneArray: mag_min=" << mag_min << ", mag_steps=" << mag_steps << ", mag_range=" << mag_range ;
 	}
+	file->close();
+
+	if (!ok)
+	{
+		// Leave empty zones, they can still be iterated over
+		stars = 0;
+		nr_of_stars = 0;
+		for (unsigned int z=0;z<nr_of_zones;z++)
+			getZones()[z].size = 0;
+		return false;
+	}
+	StelMemoryStats* memoryStats = StelApp::getInstance().getMemoryStats();
+	if (mmap_start)
+		memoryStats->addMapping(StelMemoryStats::StarCatalogs, mmap_start, sizeof(Star)*nr_of_stars);
+	else
+		memoryStats->add(StelMemoryStats::StarCatalogs, sizeof(Star)*nr_of_stars);
+	Star *s = stars;
+	for (unsigned int z=0;z<nr_of_zones;z++)
+	{
+		getZones()[z].stars = s;
+		s += getZones()[z].size;
+	}
+	if (mmap_start && useAccessHints)
+		zones_needed.resize(nr_of_zones);
+	return true;
+}
+
+template<class Star>
+bool SpecialZoneArray<Star>::saveNativeCopy(const QString& path, unsigned int type, unsigned int minor) const
+{
+	if (!isLoaded() || stars==0 || !QDir().mkpath(QFileInfo(path).absolutePath()))
+		return false;
+	QSaveFile copy(path);
+	if (!copy.open(QIODevice::WriteOnly))
+		return false;
+	// The stars are in memory as this compiler lays them out, which is what FILE_MAGIC_NATIVE means.
+	// They are written uncompressed so that the copy can be mapped.
+	const unsigned int header[8] = {FILE_MAGIC_NATIVE, type, 0, minor, (unsigned int)level,
+					(unsigned int)mag_min, (unsigned int)mag_range, (unsigned int)mag_steps};
+	QVector<unsigned int> zone_sizes(nr_of_zones);
+	for (unsigned int z=0;z<nr_of_zones;z++)
+		zone_sizes[z] = getZones()[z].size;
+	const qint64 starsSize = sizeof(Star)*nr_of_stars;
+	if (copy.write((const char*)header, sizeof(header)) != (qint64)sizeof(header)
+	    || copy.write((const char*)zone_sizes.constData(), sizeof(unsigned int)*nr_of_zones) != (qint64)(sizeof(unsigned int)*nr_of_zones)
+	    || copy.write((const char*)stars, starsSize) != starsSize)
+	{
+		copy.cancelWriting();
+		return false;
+	}
+	return copy.commit();
+}
+
+template<class Star>
+bool SpecialZoneArray<Star>::readCompressedStars()
+{
+	if (!file->seek(stars_pos))
+		return false;
+	char* data = (char*)stars;
+	for (unsigned int z=0;z<nr_of_zones;z++)
+	{
+		const qint64 size = sizeof(Star)*getZones()[z].size;
+		if (size==0)
+			continue;
+		// The zones are decompressed one at a time, the whole compressed file is never in memory
+		const QByteArray block = file->read(compressed_sizes.at(z));
+		if (block.size()!=(int)compressed_sizes.at(z))
+			return false;
+		const QByteArray zoneStars = qUncompress(block);
+		if (zoneStars.size()!=size)
+		{
+			qDebug() << "ERROR: SpecialZoneArray(" << level << "): bad compressed zone" << z
+				 << "in" << file->fileName();
+			return false;
+		}
+		memcpy(data, zoneStars.constData(), size);
+		data += size;
+	}
+	return true;
+}
+
+template<class Star>
+void SpecialZoneArray<Star>::willNeedZone(int index)
+{
+	if (index>=zones_needed.size() || zones_needed.testBit(index))
+		return;
+	zones_needed.setBit(index);
+	const SpecialZoneData<Star>& z = getZones()[index];
+	adviseMapping(z.getStars(), sizeof(Star)*z.size, AdviceWillNeed);
 }
 
 template<class Star>
 SpecialZoneArray<Star>::~SpecialZoneArray(void)
 {
+	prefetchFuture.waitForFinished();
+	clearPositionCache();
 	if (stars)
 	{
+		StelMemoryStats* memoryStats = StelApp::getInstance().getMemoryStats();
 		if (mmap_start != 0)
 		{
+			memoryStats->removeMapping(mmap_start);
 			file->unmap(mmap_start);
 		}
 		else
 		{
+			memoryStats->add(StelMemoryStats::StarCatalogs, -(qint64)(sizeof(Star)*nr_of_stars));
 			delete[] stars;
 		}
-		delete file;
 		stars = 0;
 	}
+	delete file;
 	if (zones)
 	{
 		delete[] getZones();
@@ -483,7 +719,7 @@ SpecialZoneArray<Star>::~SpecialZoneArray(void)
 
 template<class Star>
 void SpecialZoneArray<Star>::draw(StelPainter* sPainter, int index, bool isInsideViewport, const RCMag* rcmag_table,
-	int limitMagIndex, StelCore* core, int maxMagStarName, float names_brightness, const QVector<SphericalCap> &boundingCaps) const
+	int limitMagIndex, StelCore* core, int maxMagStarName, float names_brightness, const QVector<SphericalCap> &boundingCaps, ZoneDrawBatch* batch) const
 {
     StelSkyDrawer* drawer = core->getSkyDrawer();
     Vec3f vf;
@@ -508,7 +744,37 @@ void SpecialZoneArray<Star>::draw(StelPainter* sPainter, int index, bool isInsid
     
 	// Go through all stars, which are sorted by magnitude (bright stars first)
 	const SpecialZoneData<Star>* zoneToDraw = getZones() + index;
+
+	// The sine of the altitude of a star is its dot product with the zenith. When the extinction is the same
+	// number of magnitude steps over the whole zone, it is folded into the rcmag_table index once for all the stars.
+	Vec3f zenith;
+	int zoneExtinctedMagShift = -1;
+	if (withExtinction)
+	{
+		const Vec3d z = core->altAzToJ2000(Vec3d(0., 0., 1.), StelCore::RefractionOff);
+		zenith.set(z[0], z[1], z[2]);
+		// Keep a margin for the stars moved out of their zone by their proper motion
+		const float radius = qMin(1.1f*zone_radius+0.001f, (float)M_PI_2);
+		const float cosRadius = std::cos(radius);
+		const float sinRadius = std::sin(radius);
+		const float sinAlt = zenith*zoneToDraw->center;
+		const float cosAlt = std::sqrt(qMax(0.f, 1.f-sinAlt*sinAlt));
+		const bool reachesPole = cosAlt < sinRadius;
+		const float minSinAlt = (reachesPole && sinAlt<0.f) ? -1.f : sinAlt*cosRadius-cosAlt*sinRadius;
+		const float maxSinAlt = (reachesPole && sinAlt>0.f) ? 1.f : sinAlt*cosRadius+cosAlt*sinRadius;
+		float minExtinction, maxExtinction;
+		extinction.getExtinctionRange(minSinAlt, maxSinAlt, minExtinction, maxExtinction);
+		if ((int)(minExtinction/k) == (int)(maxExtinction/k))
+			zoneExtinctedMagShift = (int)(minExtinction/k);
+	}
+
 	const Star* lastStar = zoneToDraw->getStars() + zoneToDraw->size;
+	// The position cache is not thread safe, the batched drawing decodes all the positions
+	const Vec3f* cachedPos = batch ? NULL : getCachedPositions(index, cutoffMagStep, movementFactor);
+	const StelProjector* prj = batch ? batch->projector : sPainter->getProjector().data();
+	LabelMgr* labelMgr = NULL;
+	int nbProjected = 0;
+	int nbDrawn = 0;
     for (const Star* s=zoneToDraw->getStars();s<lastStar;++s)
     {
 		// Artifical cutoff per magnitude
@@ -520,8 +786,11 @@ void SpecialZoneArray<Star>::draw(StelPainter* sPainter, int index, bool isInsid
 		// Array of 2 numbers containing radius and magnitude
 		const RCMag* tmpRcmag = &rcmag_table[s->mag];
 		
-		// Get the star position from the array
-		s->getJ2000Pos(zoneToDraw, movementFactor, vf);
+		// Get the star position from the cache or from the array
+		if (cachedPos)
+			vf = cachedPos[s-zoneToDraw->getStars()];
+		else
+			s->getJ2000Pos(zoneToDraw, movementFactor, vf);
 		
 		// If the star zone is not strictly contained inside the viewport, eliminate from the 
 		// beginning the stars actually outside viewport.
@@ -535,7 +804,7 @@ void SpecialZoneArray<Star>::draw(StelPainter* sPainter, int index, bool isInsid
 				if (vf[0]*static_cast<float>(cap.n[0])+vf[1]*static_cast<float>(cap.n[1])+vf[2]*static_cast<float>(cap.n[2])<static_cast<float>(cap.d))
 				{
 					isVisible = false;
-					continue;
+					break;
 				}
 			}
 			if (!isVisible)
@@ -545,45 +814,211 @@ void SpecialZoneArray<Star>::draw(StelPainter* sPainter, int index, bool isInsid
 		int extinctedMagIndex = s->mag;
 		if (withExtinction)
 		{
-			Vec3f altAz(vf);
-			altAz.normalize();
-			core->j2000ToAltAzInPlaceNoRefraction(&altAz);
-			float extMagShift=0.0f;
-			extinction.forward(altAz, &extMagShift);
-			extinctedMagIndex = s->mag + (int)(extMagShift/k);
+			if (zoneExtinctedMagShift >= 0)
+				extinctedMagIndex += zoneExtinctedMagShift;
+			else
+				extinctedMagIndex += (int)(extinction.getExtinction(zenith*vf/vf.length())/k);
 			if (extinctedMagIndex >= cutoffMagStep) // i.e., if extincted it is dimmer than cutoff, so remove
+			{
+				// With the same extinction over the zone, the next stars are fainter and not drawn either
+				if (zoneExtinctedMagShift >= 0)
+					break;
 				continue;
+			}
 			tmpRcmag = &rcmag_table[extinctedMagIndex];
 		}
 	
-		if (drawer->drawPointSource(sPainter, vf, *tmpRcmag, s->bV, !isInsideViewport) && s->hasName() && extinctedMagIndex < maxMagStarName && s->hasComponentID()<=1)
+		const bool drawn = batch ? drawer->projectPointSource(prj, vf, *tmpRcmag, s->bV, !isInsideViewport, batch->points)
+					 : drawer->drawPointSource(sPainter, vf, *tmpRcmag, s->bV, !isInsideViewport);
+		++nbProjected;
+		if (drawn)
+			++nbDrawn;
+		if (drawn && s->hasName() && extinctedMagIndex < maxMagStarName && s->hasComponentID()<=1)
 		{
-			const float offset = tmpRcmag->radius*0.7f;
-			const Vec3f colorr = StelSkyDrawer::indexToColor(s->bV)*0.75f;
-			sPainter->setColor(colorr[0], colorr[1], colorr[2],names_brightness);
-			sPainter->drawText(Vec3d(vf[0], vf[1], vf[2]), s->getNameI18n(), 0, offset, offset, false);
+			Vec3d win;
+			if (prj->project(Vec3d(vf[0], vf[1], vf[2]), win))
+			{
+				const float offset = tmpRcmag->radius*0.7f;
+				const Vec3f colorr = StelSkyDrawer::indexToColor(s->bV)*0.75f;
+				const float labelMag = 0.001f*mag_min+k*extinctedMagIndex;
+				if (batch)
+				{
+					const ZoneDrawBatch::Label label = {win, s->getNameI18n(), offset, colorr, names_brightness, labelMag};
+					batch->labels.append(label);
+				}
+				else
+				{
+					sPainter->setColor(colorr[0], colorr[1], colorr[2],names_brightness);
+					if (labelMgr==NULL)
+						labelMgr = GETSTELMODULE(LabelMgr);
+					labelMgr->addSkyLabel(*sPainter, win[0], win[1], s->getNameI18n(), offset, offset, labelMag);
+				}
+			}
 		}
     }
+	StelRenderStats* stats = StelApp::getInstance().getRenderStats();
+	stats->add(statsProjected, nbProjected);
+	stats->add(statsDrawn, nbDrawn);
+}
+
+//! Write the indices of the positions inside the cap of direction v and cosinus cosLimFov >= 0 in indices,
+//! which has room for n of them, and return their number. The positions don't need to be normalized.
+//! The loop has no square root and no branch so that the compiler can vectorize it.
+static int selectInsideCap(const Vec3f* pos, int n, const Vec3f& v, float cosLimFov, int* indices)
+{
+	const float cos2 = cosLimFov*cosLimFov;
+	int nb = 0;
+	for (int i=0;i<n;++i)
+	{
+		const float d = pos[i][0]*v[0] + pos[i][1]*v[1] + pos[i][2]*v[2];
+		const float l2 = pos[i][0]*pos[i][0] + pos[i][1]*pos[i][1] + pos[i][2]*pos[i][2];
+		indices[nb] = i;
+		nb += (d>=0.f) & (d*d>=cos2*l2);
+	}
+	return nb;
 }
 
 template<class Star>
 void SpecialZoneArray<Star>::searchAround(const StelCore* core, int index, const Vec3d &v, double cosLimFov,
-					  QList<StelObjectP > &result)
+					  int maxMagStep, QVector<SearchCandidate> &result) const
 {
 	static const double d2000 = 2451545.0;
-	const double movementFactor = (M_PI/180.)*(0.0001/3600.) * ((core->getJDay()-d2000)/365.25)/ star_position_scale;
+	const float movementFactor = (M_PI/180.)*(0.0001/3600.) * ((core->getJDay()-d2000)/365.25)/ star_position_scale;
 	const SpecialZoneData<Star> *const z = getZones()+index;
-	Vec3f tmp;
-	Vec3f vf(v[0], v[1], v[2]);
-	for (const Star* s=z->getStars();s<z->getStars()+z->size;++s)
+	const Vec3f vf(v[0], v[1], v[2]);
+	// The stars are sorted by magnitude, the ones too faint to be displayed are at the end of the zone
+	const int n = getNrOfStarsBrighterThan(index, maxMagStep);
+	if (n==0)
+		return;
+
+	// The positions drawn recently are already decoded, the other ones are decoded once in a row
+	const Vec3f* pos = getCachedPositions(index, maxMagStep, movementFactor);
+	QVarLengthArray<Vec3f, 512> decoded;
+	if (pos==NULL)
+	{
+		decoded.resize(n);
+		for (int i=0;i<n;++i)
+			z->getStars()[i].getJ2000Pos(z, movementFactor, decoded[i]);
+		pos = decoded.constData();
+	}
+
+	QVarLengthArray<int, 512> indices(n);
+	int nb;
+	if (cosLimFov>=0.)
+		nb = selectInsideCap(pos, n, vf, cosLimFov, indices.data());
+	else
+	{
+		// A cap larger than a hemisphere, the positions are normalized
+		nb = 0;
+		for (int i=0;i<n;++i)
+		{
+			Vec3f tmp(pos[i]);
+			tmp.normalize();
+			if (tmp*vf >= cosLimFov)
+				indices[nb++] = i;
+		}
+	}
+
+	for (int i=0;i<nb;++i)
+	{
+		const SearchCandidate candidate = {this, index, indices[i],
+			0.001f*mag_min + z->getStars()[indices[i]].mag*(0.001f*mag_range)/mag_steps};
+		result.append(candidate);
+	}
+}
+
+template<class Star>
+StelObjectP SpecialZoneArray<Star>::createStelObject(const SearchCandidate& candidate) const
+{
+	const SpecialZoneData<Star>* z = getZones()+candidate.zone;
+	return z->getStars()[candidate.star].createStelObject(this, z);
+}
+
+
+template<class Star>
+const Vec3f* SpecialZoneArray<Star>::getCachedPositions(int index, int magStep, float movementFactor) const
+{
+	if (positionCacheMaxStars<=0 || Star::MaxPmVal<0)
+		return NULL;
+
+	// Start again when the stars moved too much since the positions were computed
+	if (positionCache.isEmpty() || (Star::MaxPmVal>0 &&
+		std::fabs(movementFactor-positionCacheMovementFactor)*Star::MaxPmVal*star_position_scale > PositionCacheTolerance))
+	{
+		clearPositionCache();
+		positionCache.resize(nr_of_zones);
+		positionCacheMovementFactor = movementFactor;
+	}
+
+	QVector<Vec3f>* positions = &positionCache[index];
+	const int n = getNrOfStarsBrighterThan(index, magStep);
+	if (positions->size() < n)
 	{
-		s->getJ2000Pos(z,movementFactor, tmp);
-		tmp.normalize();
-		if (tmp*vf >= cosLimFov)
+		if (positionCacheNbStars+n-positions->size() > positionCacheMaxStars)
 		{
-			// TODO: do not select stars that are too faint to display
-			result.push_back(s->createStelObject(this,z));
+			// Make room by dropping the zones cached before for this catalog
+			clearPositionCache();
+			positionCache.resize(nr_of_zones);
+			positionCacheMovementFactor = movementFactor;
+			positions = &positionCache[index];
+			if (positionCacheNbStars+n > positionCacheMaxStars)
+				return NULL;
 		}
+		const SpecialZoneData<Star>* z = getZones() + index;
+		const int first = positions->size();
+		positions->resize(n);
+		Vec3f* pos = positions->data();
+		for (int i=first;i<n;++i)
+			z->getStars()[i].getJ2000Pos(z, positionCacheMovementFactor, pos[i]);
+		positionCacheNbStars += n-first;
+		positionCacheNbStarsInArray += n-first;
+	}
+	return positions->constData();
+}
+
+template<class Star>
+void SpecialZoneArray<Star>::clearPositionCache() const
+{
+	positionCache.clear();
+	positionCacheNbStars -= positionCacheNbStarsInArray;
+	positionCacheNbStarsInArray = 0;
+}
+
+template<class Star>
+int SpecialZoneArray<Star>::getNrOfStarsBrighterThan(int index, int magStep) const
+{
+	const SpecialZoneData<Star>* z = getZones() + index;
+	// Stars are sorted by magnitude (bright stars first): binary search the first fainter one
+	int lo = 0;
+	int hi = z->size;
+	while (lo < hi)
+	{
+		const int mid = (lo+hi)/2;
+		if ((int)z->getStars()[mid].mag > magStep)
+			hi = mid;
+		else
+			lo = mid+1;
 	}
+	return lo;
 }
 
+template<class Star>
+void SpecialZoneArray<Star>::fillGpuVertexArray(int index, QVector<StarGpuVertex>& result) const
+{
+	const SpecialZoneData<Star>* z = getZones() + index;
+	result.resize(z->size);
+	StarGpuVertex* v = result.data();
+	Vec3f pos1;
+	for (const Star* s=z->getStars();s<z->getStars()+z->size;++s,++v)
+	{
+		// Proper motion is linear in movementFactor
+		s->getJ2000Pos(z, 0.f, v->pos);
+		s->getJ2000Pos(z, 1.f, pos1);
+		v->pm = pos1 - v->pos;
+		const Vec3f& c = StelSkyDrawer::indexToColor(s->bV);
+		v->color[0] = (unsigned char)qMin((int)(c[0]*255+0.5f), 255);
+		v->color[1] = (unsigned char)qMin((int)(c[1]*255+0.5f), 255);
+		v->color[2] = (unsigned char)qMin((int)(c[2]*255+0.5f), 255);
+		v->mag = s->mag;
+	}
+}
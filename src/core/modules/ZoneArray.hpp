@@ -33,12 +33,18 @@
 #include <QString>
 #include <QFile>
 #include <QDebug>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QMutex>
+#include <QBitArray>
+#include <QVector>
 
 #ifdef __OpenBSD__
 #include <unistd.h>
 #endif
 
 class StelPainter;
+struct StarGpuVertex;
 
 // Patch by Rainer Canavan for compilation on irix with mipspro compiler part 1
 #ifndef MAP_NORESERVE
@@ -53,10 +59,35 @@ class StelPainter;
 
 
 #define NR_OF_HIP 120416
+
+//! @struct ZoneDrawBatch
+//! The stars and labels of the zones drawn by ZoneArray::draw() from a worker thread,
+//! which are submitted afterwards from the GL thread.
+struct ZoneDrawBatch
+{
+	//! A star label to add to the LabelMgr.
+	struct Label
+	{
+		Vec3d win;
+		QString text;
+		float offset;
+		Vec3f color;
+		float brightness;
+		float mag;
+	};
+
+	const StelProjector* projector;
+	StelSkyDrawer::PointSourceBatch points;
+	QVector<Label> labels;
+
+	void clear() {points.clear(); labels.resize(0);}
+};
 #define FILE_MAGIC 0x835f040a
 #define FILE_MAGIC_OTHER_ENDIAN 0x0a045f83
 #define FILE_MAGIC_NATIVE 0x835f040b
-#define MAX_MAJOR_FILE_VERSION 0
+#define MAX_MAJOR_FILE_VERSION 1
+//! Major version of the catalogs whose zones are stored as independent zlib blocks (see SpecialZoneArray).
+#define COMPRESSED_MAJOR_FILE_VERSION 1
 
 //! @struct HipIndexStruct
 //! Container for Hipparcos information. Stores a pointer to a Hipparcos star,
@@ -81,8 +112,13 @@ public:
 	//! loading.
 	//! @param extended_file_name path of the star catalog to load from
 	//! @param use_mmap whether or not to mmap the star catalog
+	//! @param lazy_loading whether the stars of the catalogs without names are only loaded by load().
+	//! The Hipparcos catalogs are always loaded immediately as they are needed for the hip index.
+	//! A catalog in the other byte order can't be mapped: the first time it is loaded with use_mmap,
+	//! its stars are read and swapped, and a native copy is written with saveNativeCopy(), which is
+	//! mapped instead as long as the catalog is not replaced.
 	//! @return an instance of SpecialZoneArray or HipZoneArray
-	static ZoneArray *create(const QString &extended_file_name, bool use_mmap);
+	static ZoneArray *create(const QString &extended_file_name, bool use_mmap, bool lazy_loading=false);
 	virtual ~ZoneArray()
 	{
 		nr_of_zones = 0;
@@ -91,23 +127,83 @@ public:
 	//! Get the total number of stars in this catalog.
 	unsigned int getNrOfStars() const { return nr_of_stars; }
 
+	//! Get the number of zones in this catalog.
+	unsigned int getNrOfZones() const { return nr_of_zones; }
+
+	//! Get the number of stars of a zone with a magnitude index <= magStep.
+	//! Because the stars are sorted by magnitude, these are the first stars of the zone.
+	virtual int getNrOfStarsBrighterThan(int index, int magStep) const = 0;
+
+	//! Fill the array with the decoded stars of a zone, in the format used by StarGpuDrawer.
+	virtual void fillGpuVertexArray(int index, QVector<StarGpuVertex>& result) const = 0;
+
 	//! Dummy method that does nothing. See subclass implementation.
 	virtual void updateHipIndex(HipIndexStruct hipIndex[]) const {Q_UNUSED(hipIndex);}
 
+	//! A star found by searchAround(), only made a StelObject by createStelObject() if it is kept.
+	struct SearchCandidate
+	{
+		const ZoneArray* array;
+		int zone;
+		int star;
+		//! The magnitude of the star, to keep the brightest candidates.
+		float mag;
+	};
+
 	//! Pure virtual method. See subclass implementation.
 	virtual void searchAround(const StelCore* core, int index,const Vec3d &v,double cosLimFov,
-							  QList<StelObjectP > &result) = 0;
+							  int maxMagStep, QVector<SearchCandidate> &result) const = 0;
+	//! Create the StelObject of a star found by searchAround().
+	virtual StelObjectP createStelObject(const SearchCandidate& candidate) const = 0;
 
 	//! Pure virtual method. See subclass implementation.
 	virtual void draw(StelPainter* sPainter, int index,bool is_inside,
 					  const RCMag* rcmag_table, int limitMagIndex, StelCore* core,
 					  int maxMagStarName, float names_brightness,
-					  const QVector<SphericalCap>& boundingCaps) const = 0;
+					  const QVector<SphericalCap>& boundingCaps, ZoneDrawBatch* batch) const = 0;
 
 	//! Get whether or not the catalog was successfully loaded.
 	//! @return @c true if at least one zone was loaded, otherwise @c false
 	bool isInitialized(void) const { return (nr_of_zones>0); }
 
+	//! Get whether the stars are loaded. When the catalog was created with lazy loading,
+	//! only the header and the zone sizes are read until load() is called.
+	bool isLoaded() const { return loaded.loadAcquire()!=0; }
+
+	//! Load the stars if they are not loaded yet, waiting for a prefetch() in progress.
+	//! If the stars cannot be read the zones are left empty.
+	void load();
+
+	//! Start loading the stars in a background thread, so that a later call to load() does not block.
+	void prefetch();
+	//! Get whether the stars are being loaded in the background after a call to prefetch().
+	bool isPrefetching() const { return prefetchFuture.isRunning(); }
+
+	//! Tell the system that the stars of a zone will be drawn soon, so that the pages of a mapped
+	//! catalog are read ahead instead of faulting one by one. Does nothing for the catalogs which
+	//! are not mapped, and after the first call for a given zone.
+	virtual void willNeedZone(int index) = 0;
+
+	//! Write the loaded stars to a catalog in the byte order and layout of this machine, with the
+	//! FILE_MAGIC_NATIVE magic. ZoneArray::create() writes such a copy in the cache directory for
+	//! the catalogs in the other byte order, and maps it in the next runs instead of swapping the
+	//! stars again.
+	//! @param type the type of the catalog, i.e. 0 for Star1, 1 for Star2 and 2 for Star3.
+	//! @param minor the minor version of the catalog.
+	//! @return false if the stars are not loaded or the file could not be written.
+	virtual bool saveNativeCopy(const QString& path, unsigned int type, unsigned int minor) const = 0;
+
+	//! Set whether the access hints are given for the mapped catalogs, i.e. random access for
+	//! the whole file, transparent huge pages where available, and willNeedZone().
+	static void setUseAccessHints(bool b) {useAccessHints = b;}
+	static bool getUseAccessHints() {return useAccessHints;}
+
+	//! Set how many decoded star positions can be kept in memory by all the catalogs.
+	//! The positions of the stars drawn from the catalogs without names are cached per zone, and
+	//! computed again only when the date changes enough for the proper motions to be noticed.
+	//! @param n the maximum number of positions, 0 to disable the cache.
+	static void setPositionCacheMaxStars(int n) {positionCacheMaxStars = n;}
+
 	//! Initialize the ZoneData struct at the given index.
 	void initTriangle(int index, const Vec3f &c0, const Vec3f &c1, const Vec3f &c2);
 	
@@ -130,22 +226,50 @@ public:
 
 	float star_position_scale;
 
+	//! Maximum angle in radians between the center and the corners of the zones.
+	float zone_radius;
+
 protected:
 	//! Load a catalog and display its progress on the splash screen.
 	//! @return @c true if successful, or @c false if an error occurred
 	static bool readFile(QFile& file, void *data, qint64 size);
 
+	//! Map or read the stars from the file.
+	//! @return @c false if an error occurred, in which case the zones are emptied.
+	virtual bool loadStars() = 0;
+
 	//! Protected constructor. Initializes fields and does not load anything.
 	ZoneArray(const QString& fname, QFile* file, int level, int mag_min, int mag_range, int mag_steps);
 	unsigned int nr_of_zones;
 	unsigned int nr_of_stars;
 	ZoneData *zones;
 	QFile* file;
+
+	//! Non zero once the stars are loaded. Set last, so that the threads searching the
+	//! catalog only see the stars when they are completely loaded.
+	QAtomicInt loaded;
+	//! Serializes load() between the main thread and a prefetch.
+	QMutex loadMutex;
+	//! The render statistics counters of the stars projected and drawn from this level.
+	int statsProjected;
+	int statsDrawn;
+	QFuture<void> prefetchFuture;
+
+	static bool useAccessHints;
+	static int positionCacheMaxStars;
+	//! Number of positions currently cached by all the catalogs.
+	static int positionCacheNbStars;
 };
 
 //! @class SpecialZoneArray
 //! Implements all the virtual methods in ZoneArray. Is only separate from
 //! %ZoneArray because %ZoneArray decides on the template parameter.
+//! The stars of the catalogs of major version COMPRESSED_MAJOR_FILE_VERSION are stored zone by
+//! zone as blocks compressed with qCompress(), listed after the sizes of the zones by a table of
+//! their sizes in bytes. These catalogs are a lot smaller, so that the large ones can be
+//! downloaded and read faster, at the price of the decompression and of not being mapped.
+//! In all the catalogs the stars of each zone are sorted by magnitude, so that the drawing of a
+//! zone stops at the first star fainter than the limit magnitude.
 //! @tparam Star either Star1, Star2 or Star3, depending on the brightness of
 //! stars in this catalog.
 template<class Star>
@@ -156,12 +280,14 @@ public:
 	//! @param file catalog to load from
 	//! @param byte_swap whether to switch endianness of catalog data
 	//! @param use_mmap whether or not to mmap the star catalog
+	//! @param lazy_loading whether to defer the loading of the stars until load() is called
 	//! @param level level in StelGeodesicGrid
 	//! @param mag_min lower bound of magnitudes
 	//! @param mag_range range of magnitudes
 	//! @param mag_steps number of steps used to describe values in range
-	SpecialZoneArray(QFile* file,bool byte_swap,bool use_mmap,int level,int mag_min,
-			 int mag_range,int mag_steps);
+	//! @param compressed whether the zones are compressed, in which case the catalog can't be mapped
+	SpecialZoneArray(QFile* file,bool byte_swap,bool use_mmap,bool lazy_loading,int level,int mag_min,
+			 int mag_range,int mag_steps,bool compressed=false);
 	~SpecialZoneArray(void);
 protected:
 	//! Get an array of all SpecialZoneData objects in this catalog.
@@ -179,18 +305,55 @@ protected:
 	//! @param core core to use for drawing
 	//! @param maxMagStarName magnitude limit of stars that display labels
 	//! @param names_brightness brightness of labels
+	//! @param batch if not NULL, the stars and labels are stored in it instead of being drawn with
+	//! sPainter, which is not used. It allows to draw several zones at the same time from worker threads.
 	virtual void draw(StelPainter* sPainter, int index, bool isInsideViewport,
 			  const RCMag *rcmag_table, int limitMagIndex, StelCore* core,
 			  int maxMagStarName, float names_brightness,
-			  const QVector<SphericalCap>& boundingCaps) const;
+			  const QVector<SphericalCap>& boundingCaps, ZoneDrawBatch* batch) const;
 
 	virtual void scaleAxis();
+	//! Add the stars of a zone close to a point to the result.
+	//! The positions are tested from the position cache when possible, without square root nor
+	//! branch so that the loop can be vectorized, and the stars are only identified by their index.
+	//! @param maxMagStep only the stars with a magnitude index <= maxMagStep are searched,
+	//! i.e. only the first stars of the zone need to be decoded.
 	virtual void searchAround(const StelCore* core, int index,const Vec3d &v,double cosLimFov,
-					  QList<StelObjectP > &result);
+					  int maxMagStep, QVector<SearchCandidate> &result) const;
+	virtual StelObjectP createStelObject(const SearchCandidate& candidate) const;
+
+	virtual int getNrOfStarsBrighterThan(int index, int magStep) const;
+	virtual void fillGpuVertexArray(int index, QVector<StarGpuVertex>& result) const;
+
+	virtual bool loadStars();
+	virtual void willNeedZone(int index);
+	virtual bool saveNativeCopy(const QString& path, unsigned int type, unsigned int minor) const;
+
+	//! Get the decoded J2000 positions of the stars of a zone up to the given magnitude step.
+	//! @return NULL if the positions can't be cached, in which case they have to be computed.
+	const Vec3f* getCachedPositions(int index, int magStep, float movementFactor) const;
+	//! Release all the positions cached for this catalog.
+	void clearPositionCache() const;
 
 	Star *stars;
 private:
+	//! Read and decompress the zones of a compressed catalog in the stars array.
+	bool readCompressedStars();
+
 	uchar *mmap_start;
+	bool byte_swap;
+	bool use_mmap;
+	//! Offset of the stars in the file.
+	qint64 stars_pos;
+	//! Size in bytes of the compressed zones, empty if the catalog is not compressed.
+	QVector<unsigned int> compressed_sizes;
+	//! The zones for which willNeedZone() was already called.
+	QBitArray zones_needed;
+
+	//! The positions of the brightest stars of each zone, computed for positionCacheMovementFactor.
+	mutable QVector<QVector<Vec3f> > positionCache;
+	mutable float positionCacheMovementFactor;
+	mutable int positionCacheNbStarsInArray;
 };
 
 //! @class HipZoneArray
@@ -201,7 +364,7 @@ class HipZoneArray : public SpecialZoneArray<Star1>
 public:
 	HipZoneArray(QFile* file,bool byte_swap,bool use_mmap,
 		   int level,int mag_min,int mag_range,int mag_steps)
-			: SpecialZoneArray<Star1>(file,byte_swap,use_mmap,level,
+			: SpecialZoneArray<Star1>(file,byte_swap,use_mmap,false,level,
 									  mag_min,mag_range,mag_steps) {}
 
 	//! Add Hipparcos information for all stars in this catalog into @em hipIndex.
@@ -350,10 +350,16 @@ double get_mean_sidereal_time (double JD)
 /* Calculate the apparent sidereal time at the meridian of Greenwich of a given date.
  * returns apparent sidereal time (degree).
  * Formula 11.1, 11.4 pg 83 */
+/* cache values: the sidereal time is asked many times for the same date in a frame */
+static double c_sidereal_JD = -1.0e9, c_sidereal = 0.0;
+
 double get_apparent_sidereal_time (double JD)
 {
 	double correction, sidereal;
 	struct ln_nutation nutation;
+
+	if (JD == c_sidereal_JD)
+		return c_sidereal;
    
 	/* get the mean sidereal time */
 	sidereal = get_mean_sidereal_time (JD);
@@ -366,6 +372,9 @@ double get_apparent_sidereal_time (double JD)
 	correction = (nutation.longitude * cos ((nutation.ecliptic+nutation.obliquity)*M_PI/180.));
 
 	sidereal += correction;
+
+	c_sidereal_JD = JD;
+	c_sidereal = sidereal;
    
 	return (sidereal);
 }
@@ -69,8 +69,7 @@ ConfigurationDialog::ConfigurationDialog(StelGui* agui, QObject* parent)
 	: StelDialog(parent)
 	, nextStarCatalogToDownloadIndex(0)
 	, starCatalogsCount(0)
-	, starCatalogDownloadReply(NULL)
-	, currentDownloadFile(NULL)
+	, starCatalogDownloader(NULL)
 	, progressBar(NULL)
 	, gui(agui)
 {
@@ -958,127 +957,83 @@ void ConfigurationDialog::updateStarCatalogControlsText()
 
 void ConfigurationDialog::cancelDownload(void)
 {
-	Q_ASSERT(currentDownloadFile);
-	Q_ASSERT(starCatalogDownloadReply);
-	qWarning() << "Aborting download";
-	starCatalogDownloadReply->abort();
+	Q_ASSERT(starCatalogDownloader);
+	starCatalogDownloader->abort();
 }
 
-void ConfigurationDialog::newStarCatalogData()
+void ConfigurationDialog::starCatalogDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	Q_ASSERT(currentDownloadFile);
-	Q_ASSERT(starCatalogDownloadReply);
 	Q_ASSERT(progressBar);
-
-	int size = starCatalogDownloadReply->bytesAvailable();
-	progressBar->setValue((float)progressBar->getValue()+(float)size/1024);
-	currentDownloadFile->write(starCatalogDownloadReply->read(size));
+	if (bytesTotal>0)
+		progressBar->setRange(0, bytesTotal/1024);
+	progressBar->setValue(bytesReceived/1024);
 }
 
 void ConfigurationDialog::downloadStars()
 {
 	Q_ASSERT(!nextStarCatalogToDownload.isEmpty());
 	Q_ASSERT(!isDownloadingStarCatalog);
-	Q_ASSERT(starCatalogDownloadReply==NULL);
-	Q_ASSERT(currentDownloadFile==NULL);
+	Q_ASSERT(starCatalogDownloader==NULL);
 	Q_ASSERT(progressBar==NULL);
 
+	// The parts already received by a cancelled or interrupted download are kept next to the file
 	QString path = StelFileMgr::getUserDir()+QString("/stars/default/")+nextStarCatalogToDownload.value("fileName").toString();
-	currentDownloadFile = new QFile(path);
-	if (!currentDownloadFile->open(QIODevice::WriteOnly))
+	starCatalogDownloader = new StelFileDownloader(QUrl(nextStarCatalogToDownload.value("url").toString()), path,
+						       nextStarCatalogToDownload.value("checksum").toByteArray(), this);
+	connect(starCatalogDownloader, SIGNAL(progress(qint64,qint64)), this, SLOT(starCatalogDownloadProgress(qint64,qint64)));
+	connect(starCatalogDownloader, SIGNAL(finished(StelFileDownloader::Result)), this, SLOT(downloadFinished(StelFileDownloader::Result)));
+
+	progressBar = StelApp::getInstance().addProgressBar();
+	progressBar->setValue(0);
+	progressBar->setRange(0, nextStarCatalogToDownload.value("sizeMb").toDouble()*1024);
+	progressBar->setFormat(QString("%1: %p%").arg(nextStarCatalogToDownload.value("id").toString()));
+
+	isDownloadingStarCatalog = true;
+	if (!starCatalogDownloader->start(StelUtils::getApplicationName().toLatin1()))
 	{
-		qWarning() << "Can't open a writable file for storing new star catalog: " << QDir::toNativeSeparators(path);
-		currentDownloadFile->deleteLater();
-		currentDownloadFile = NULL;
-		ui->downloadLabel->setText(q_("Error downloading %1:\n%2").arg(nextStarCatalogToDownload.value("id").toString()).arg(QString("Can't open a writable file for storing new star catalog: %1").arg(path)));
+		qWarning() << starCatalogDownloader->errorString();
+		isDownloadingStarCatalog = false;
+		ui->downloadLabel->setText(q_("Error downloading %1:\n%2").arg(nextStarCatalogToDownload.value("id").toString()).arg(starCatalogDownloader->errorString()));
 		ui->downloadRetryButton->setVisible(true);
+		starCatalogDownloader->deleteLater();
+		starCatalogDownloader = NULL;
+		StelApp::getInstance().removeProgressBar(progressBar);
+		progressBar=NULL;
 		return;
 	}
 
-	isDownloadingStarCatalog = true;
 	updateStarCatalogControlsText();
 	ui->downloadCancelButton->setVisible(true);
 	ui->downloadRetryButton->setVisible(false);
 	ui->getStarsButton->setVisible(true);
 	ui->getStarsButton->setEnabled(false);
-
-	QNetworkRequest req(nextStarCatalogToDownload.value("url").toString());
-	req.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
-	req.setAttribute(QNetworkRequest::RedirectionTargetAttribute, false);
-	req.setRawHeader("User-Agent", StelUtils::getApplicationName().toLatin1());
-	starCatalogDownloadReply = StelApp::getInstance().getNetworkAccessManager()->get(req);
-	starCatalogDownloadReply->setReadBufferSize(1024*1024*2);
-	connect(starCatalogDownloadReply, SIGNAL(readyRead()), this, SLOT(newStarCatalogData()));
-	connect(starCatalogDownloadReply, SIGNAL(finished()), this, SLOT(downloadFinished()));
-	connect(starCatalogDownloadReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(downloadError(QNetworkReply::NetworkError)));
-
-	progressBar = StelApp::getInstance().addProgressBar();
-	progressBar->setValue(0);
-	progressBar->setRange(0, nextStarCatalogToDownload.value("sizeMb").toDouble()*1024);
-	progressBar->setFormat(QString("%1: %p%").arg(nextStarCatalogToDownload.value("id").toString()));
-}
-
-void ConfigurationDialog::downloadError(QNetworkReply::NetworkError)
-{
-	Q_ASSERT(currentDownloadFile);
-	Q_ASSERT(starCatalogDownloadReply);
-
-	isDownloadingStarCatalog = false;
-	qWarning() << "Error downloading file" << starCatalogDownloadReply->url() << ": " << starCatalogDownloadReply->errorString();
-	ui->downloadLabel->setText(q_("Error downloading %1:\n%2").arg(nextStarCatalogToDownload.value("id").toString()).arg(starCatalogDownloadReply->errorString()));
-	ui->downloadCancelButton->setVisible(false);
-	ui->downloadRetryButton->setVisible(true);
-	ui->getStarsButton->setVisible(false);
-	ui->getStarsButton->setEnabled(true);
 }
 
-void ConfigurationDialog::downloadFinished()
+void ConfigurationDialog::downloadFinished(StelFileDownloader::Result result)
 {
-	Q_ASSERT(currentDownloadFile);
-	Q_ASSERT(starCatalogDownloadReply);
+	Q_ASSERT(starCatalogDownloader);
 	Q_ASSERT(progressBar);
 
-	if (starCatalogDownloadReply->error()!=QNetworkReply::NoError)
-	{
-		starCatalogDownloadReply->deleteLater();
-		starCatalogDownloadReply = NULL;
-		currentDownloadFile->close();
-		currentDownloadFile->deleteLater();
-		currentDownloadFile = NULL;
-		StelApp::getInstance().removeProgressBar(progressBar);
-		progressBar=NULL;
-		return;
-	}
-
-	Q_ASSERT(starCatalogDownloadReply->bytesAvailable()==0);
+	isDownloadingStarCatalog = false;
+	const QString error = starCatalogDownloader->errorString();
+	starCatalogDownloader->deleteLater();
+	starCatalogDownloader = NULL;
+	StelApp::getInstance().removeProgressBar(progressBar);
+	progressBar=NULL;
 
-	const QVariant& redirect = starCatalogDownloadReply->attribute(QNetworkRequest::RedirectionTargetAttribute);
-	if (!redirect.isNull())
+	if (result==StelFileDownloader::Failed || result==StelFileDownloader::Aborted)
 	{
-		// We got a redirection, we need to follow
-		starCatalogDownloadReply->deleteLater();
-		QNetworkRequest req(redirect.toUrl());
-		req.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
-		req.setRawHeader("User-Agent", StelUtils::getApplicationName().toLatin1());
-		starCatalogDownloadReply = StelApp::getInstance().getNetworkAccessManager()->get(req);
-		starCatalogDownloadReply->setReadBufferSize(1024*1024*2);
-		connect(starCatalogDownloadReply, SIGNAL(readyRead()), this, SLOT(newStarCatalogData()));
-		connect(starCatalogDownloadReply, SIGNAL(finished()), this, SLOT(downloadFinished()));
-		connect(starCatalogDownloadReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(downloadError(QNetworkReply::NetworkError)));
+		// Retry resumes the download
+		ui->downloadLabel->setText(q_("Error downloading %1:\n%2").arg(nextStarCatalogToDownload.value("id").toString()).arg(error));
+		ui->downloadCancelButton->setVisible(false);
+		ui->downloadRetryButton->setVisible(true);
+		ui->getStarsButton->setVisible(false);
+		ui->getStarsButton->setEnabled(true);
 		return;
 	}
 
-	isDownloadingStarCatalog = false;
-	currentDownloadFile->close();
-	currentDownloadFile->deleteLater();
-	currentDownloadFile = NULL;
-	starCatalogDownloadReply->deleteLater();
-	starCatalogDownloadReply = NULL;
-	StelApp::getInstance().removeProgressBar(progressBar);
-	progressBar=NULL;
-
-	ui->downloadLabel->setText(q_("Verifying file integrity..."));
-	if (GETSTELMODULE(StarMgr)->checkAndLoadCatalog(nextStarCatalogToDownload)==false)
+	// The checksum was computed during the download, the catalog is mapped right away
+	if (result==StelFileDownloader::Corrupted || GETSTELMODULE(StarMgr)->checkAndLoadCatalog(nextStarCatalogToDownload, true)==false)
 	{
 		ui->getStarsButton->setVisible(false);
 		ui->downloadLabel->setText(q_("Error downloading %1:\nFile is corrupted.").arg(nextStarCatalogToDownload.value("id").toString()));
@@ -21,9 +21,8 @@
 #define _CONFIGURATIONDIALOG_HPP_
 
 #include <QObject>
-#include <QNetworkReply>
-#include <QFile>
 #include "StelDialog.hpp"
+#include "StelFileDownloader.hpp"
 
 class Ui_configurationDialogForm;
 class QSettings;
@@ -68,8 +67,7 @@ private:
 	int starCatalogsCount;
 	//! True when at least one star catalog has been downloaded successfully this session
 	bool hasDownloadedStarCatalog;
-	QNetworkReply* starCatalogDownloadReply;
-	QFile* currentDownloadFile;
+	StelFileDownloader* starCatalogDownloader;
 	class StelProgressController* progressBar;
 
 private slots:
@@ -91,11 +89,10 @@ private slots:
 	void cursorTimeOutChanged();
 	void cursorTimeOutChanged(double) {cursorTimeOutChanged();}
 
-	void newStarCatalogData();
+	void starCatalogDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
 	void downloadStars();
 	void cancelDownload();
-	void downloadFinished();
-	void downloadError(QNetworkReply::NetworkError);
+	void downloadFinished(StelFileDownloader::Result result);
 
 	//! Update the labels displaying the current default state
 	void updateConfigLabels();
@@ -123,12 +123,13 @@ void CompletionLabel::updateText()
 
 const char* SearchDialog::DEF_SIMBAD_URL = "http://simbad.u-strasbg.fr/";
 
-SearchDialog::SearchDialog(QObject* parent) : StelDialog(parent), simbadReply(NULL)
+SearchDialog::SearchDialog(QObject* parent) : StelDialog(parent), simbadReply(NULL), currentSearch(-1)
 {
 	ui = new Ui_searchDialogForm;
 	simbadSearcher = new SimbadSearcher(this);
 	objectMgr = GETSTELMODULE(StelObjectMgr);
 	Q_ASSERT(objectMgr);
+	connect(objectMgr, SIGNAL(matchingObjectsFound(int,QStringList,bool)), this, SLOT(onMatchingObjectsFound(int,QStringList,bool)));
 
 	flagHasSelectedText = false;
 
@@ -328,7 +329,11 @@ void SearchDialog::onSearchTextChanged(const QString& text)
 	}
 
 	QString trimmedText = text.trimmed().toLower();
+	// The matches of the previous text are not wanted anymore
+	matches.clear();
 	if (trimmedText.isEmpty()) {
+		objectMgr->cancelMatchingObjectsSearch();
+		currentSearch = -1;
 		ui->completionLabel->clearValues();
 		ui->completionLabel->selectFirst();
 		ui->simbadStatusLabel->setText("");
@@ -341,34 +346,47 @@ void SearchDialog::onSearchTextChanged(const QString& text)
 			connect(simbadReply, SIGNAL(statusChanged()), this, SLOT(onSimbadStatusChanged()));
 		}
 
+		// The modules are searched in the worker threads, their matches are ranked as they arrive
+		QStringList prefixes(trimmedText);
 		QString greekText = substituteGreek(trimmedText);
-		QStringList matches;
-		if(greekText != trimmedText) {
-			matches = objectMgr->listMatchingObjectsI18n(trimmedText, 3, useStartOfWords);
-			matches += objectMgr->listMatchingObjects(trimmedText, 3, useStartOfWords);
-			matches += objectMgr->listMatchingObjectsI18n(greekText, (8 - matches.size()), useStartOfWords);
-		} else {
-			matches = objectMgr->listMatchingObjectsI18n(trimmedText, 5, useStartOfWords);
-			matches += objectMgr->listMatchingObjects(trimmedText, 5, useStartOfWords);
-		}
-
-		// remove possible duplicates from completion list
-		matches.removeDuplicates();
-
-		matches.sort(Qt::CaseInsensitive);
-		// objects with short names should be searched first
-		// examples: Moon, Hydra (moon); Jupiter, Ghost of Jupiter
-		stringLengthCompare comparator;
-		qSort(matches.begin(), matches.end(), comparator);
-
-		ui->completionLabel->setValues(matches);
-		ui->completionLabel->selectFirst();
+		if (greekText != trimmedText)
+			prefixes << greekText;
+		currentSearch = objectMgr->startMatchingObjectsSearch(prefixes, 5, useStartOfWords);
+		updateCompletion();
 
 		// Update push button enabled state
 		ui->pushButtonGotoSearchSkyObject->setEnabled(true);
 	}
 }
 
+void SearchDialog::onMatchingObjectsFound(int search, const QStringList& found, bool finished)
+{
+	if (search!=currentSearch)
+		return;
+	// Each name is inserted at its rank, the list keeping only the best ones
+	stringLengthCompare comparator;
+	foreach (const QString& name, found)
+	{
+		QStringList::Iterator i = qLowerBound(matches.begin(), matches.end(), name, comparator);
+		if (i!=matches.end() && *i==name)
+			continue;
+		if (i-matches.begin()>=MaxMatches)
+			continue;
+		matches.insert(i, name);
+		if (matches.size()>MaxMatches)
+			matches.removeLast();
+	}
+	updateCompletion();
+	if (finished)
+		currentSearch = -1;
+}
+
+void SearchDialog::updateCompletion()
+{
+	ui->completionLabel->setValues(matches + simbadResults.keys());
+	ui->completionLabel->selectFirst();
+}
+
 
 // Called when the current simbad query status changes
 void SearchDialog::onSimbadStatusChanged()
@@ -394,7 +412,7 @@ void SearchDialog::onSimbadStatusChanged()
 	if (simbadReply->getCurrentStatus()==SimbadLookupReply::SimbadLookupFinished)
 	{
 		simbadResults = simbadReply->getResults();
-		ui->completionLabel->appendValues(simbadResults.keys());
+		updateCompletion();
 		// Update push button enabled state
 		ui->pushButtonGotoSearchSkyObject->setEnabled(!ui->completionLabel->isEmpty());
 	}
@@ -30,11 +30,15 @@
 // pre declaration of the ui class
 class Ui_searchDialogForm;
 
+//! Rank the objects with short names first, e.g. Moon, Hydra (moon); Jupiter, Ghost of Jupiter,
+//! then in the alphabetical order.
 struct stringLengthCompare
 {
 	bool operator()(const QString &s1, const QString &s2) const
 	{
-		return s1.length() < s2.length();
+		if (s1.length()!=s2.length())
+			return s1.length() < s2.length();
+		return s1.compare(s2, Qt::CaseInsensitive) < 0;
 	}
 };
 
@@ -97,6 +101,8 @@ private slots:
 	void onSimbadStatusChanged();
 	//! Called when the user changed the input text
 	void onSearchTextChanged(const QString& text);
+	//! Called when a module sent the objects matching the current search
+	void onMatchingObjectsFound(int search, const QStringList& matches, bool finished);
 	
 	void gotoObject();
 	void gotoObject(const QString& nameI18n);
@@ -135,6 +141,13 @@ private:
 	class SimbadLookupReply* simbadReply;
 	QMap<QString, Vec3d> simbadResults;
 	class StelObjectMgr* objectMgr;
+	//! The identifier of the search of the object manager for the current text, -1 if none.
+	int currentSearch;
+	//! The names received for the current search, ranked and at most MaxMatches.
+	QStringList matches;
+	static const int MaxMatches = 10;
+	//! Show the ranked matches followed by the SIMBAD results.
+	void updateCompletion();
 	
 	QString substituteGreek(const QString& keyString);
 	QString getGreekLetterByName(const QString& potentialGreekLetterName);
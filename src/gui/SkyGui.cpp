@@ -35,10 +35,13 @@
 #define round(dbl) dbl >= 0.0 ? (int)(dbl + 0.5) : ((dbl - (double)(int)dbl) <= -0.5 ? (int)dbl : (int)(dbl - 0.5))
 #endif
 
-InfoPanel::InfoPanel(QGraphicsItem* parent) : QGraphicsTextItem("", parent)
+InfoPanel::InfoPanel(QGraphicsItem* parent) : QGraphicsTextItem("", parent), lastInfoObject(NULL)
 {
+	// The text is rendered in a texture, only updated when the text changes
+	setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 	QSettings* conf = StelApp::getInstance().getSettings();
 	Q_ASSERT(conf);
+	infoUpdateInterval = conf->value("gui/info_panel_update_interval", 200).toInt();
 	QString objectInfo = conf->value("gui/selected_object_info", "all").toString();
 	if (objectInfo == "all")
 	{
@@ -100,12 +103,26 @@ void InfoPanel::setTextFromObjects(const QList<StelObjectP>& selected)
 	{
 		if (!document()->isEmpty())
 			document()->clear();
+		lastInfoText.clear();
+		lastInfoObject = NULL;
 	}
 	else
 	{
+		// The values shown change slowly, the text of the same object is not generated at each frame
+		const StelObject* obj = selected[0].data();
+		if (obj==lastInfoObject && lastInfoUpdate.isValid() && lastInfoUpdate.elapsed()<infoUpdateInterval)
+			return;
+		lastInfoObject = obj;
+		lastInfoUpdate.start();
+
 		// just print details of the first item for now
 		QString s = selected[0]->getInfoString(StelApp::getInstance().getCore(), infoTextFilters);
-		setHtml(s);
+		// Setting the same text again would lay out the document and redraw the panel for nothing
+		if (s!=lastInfoText)
+		{
+			setHtml(s);
+			lastInfoText = s;
+		}
 	}
 }
 
@@ -25,6 +25,7 @@
 #include "StelObject.hpp"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QGraphicsWidget>
 
 class QGraphicsSceneMouseEvent;
@@ -41,13 +42,21 @@ class InfoPanel : public QGraphicsTextItem
 		//! Reads "gui/selected_object_info", etc from the configuration file.
 		//! @todo Bad idea to read from the configuration file in a constructor? --BM
 		InfoPanel(QGraphicsItem* parent);
-		void setInfoTextFilters(const StelObject::InfoStringGroup& aflags) {infoTextFilters=aflags;}
+		void setInfoTextFilters(const StelObject::InfoStringGroup& aflags) {infoTextFilters=aflags; lastInfoObject=NULL;}
 		const StelObject::InfoStringGroup& getInfoTextFilters(void) const {return infoTextFilters;}
+		//! Update the text for the selected objects. The text of the same object is only generated again
+		//! after the interval set by "gui/info_panel_update_interval", in milliseconds.
 		void setTextFromObjects(const QList<StelObjectP>&);
 		const QString getSelectedText(void);
 
 	private:
 		StelObject::InfoStringGroup infoTextFilters;
+		//! The text currently displayed, to only update the panel when it changes.
+		QString lastInfoText;
+		//! The object whose text is displayed, only compared to the selected one.
+		const StelObject* lastInfoObject;
+		QElapsedTimer lastInfoUpdate;
+		int infoUpdateInterval;
 };
 
 //! The class managing the layout for button bars, selected object info and loading bars.
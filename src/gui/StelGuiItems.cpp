@@ -229,6 +229,7 @@ LeftStelBar::LeftStelBar(QGraphicsItem* parent)
 	// Create the help label
 	helpLabel = new QGraphicsSimpleTextItem("", this);
 	helpLabel->setBrush(QBrush(QColor::fromRgbF(1,1,1,1)));
+	helpLabel->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 LeftStelBar::~LeftStelBar()
@@ -332,6 +333,14 @@ BottomStelBar::BottomStelBar(QGraphicsItem* parent,
 	helpLabel = new QGraphicsSimpleTextItem("", this);
 	helpLabel->setBrush(QBrush(QColor::fromRgbF(1,1,1,1)));
 
+	// The texts are rendered in textures which are only updated when the texts change,
+	// instead of drawing all the glyphs at each frame
+	datetime->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+	location->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+	fov->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+	fps->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+	helpLabel->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+
 	QColor color = QColor::fromRgbF(1,1,1,1);
 	setColor(color);
 
@@ -729,6 +738,8 @@ StelBarsPath::StelBarsPath(QGraphicsItem* parent) : QGraphicsPathItem(parent)
 	aPen.setWidthF(1.);
 	setBrush(QBrush(QColor::fromRgbF(0.22, 0.22, 0.23, 0.2)));
 	setPen(aPen);
+	// The antialiased path is only rendered again when the bars move
+	setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 void StelBarsPath::updatePath(BottomStelBar* bot, LeftStelBar* lef)
@@ -253,6 +253,7 @@ void ViewDialog::createDialogContent()
 	connect(ui->useAsDefaultLandscapeCheckBox, SIGNAL(clicked()), this, SLOT(setCurrentLandscapeAsDefault()));
 
 	connect(GETSTELMODULE(LandscapeMgr), SIGNAL(landscapesChanged()), this, SLOT(populateLists()));
+	connect(GETSTELMODULE(LandscapeMgr), SIGNAL(currentLandscapeChanged(QString)), this, SLOT(updateLandscapeDescription()));
 	connect(ui->pushButtonAddRemoveLandscapes, SIGNAL(clicked()), this, SLOT(showAddRemoveLandscapesDialog()));
 
 	// Grid and lines
@@ -512,7 +513,13 @@ void ViewDialog::projectionChanged(const QString& projectionNameI18n)
 void ViewDialog::landscapeChanged(QListWidgetItem* item)
 {
 	LandscapeMgr* lmgr = GETSTELMODULE(LandscapeMgr);
+	// The description is updated when the new landscape is loaded
 	lmgr->setCurrentLandscapeName(item->data(Qt::UserRole).toString());
+}
+
+void ViewDialog::updateLandscapeDescription()
+{
+	LandscapeMgr* lmgr = GETSTELMODULE(LandscapeMgr);
 	StelGui* gui = dynamic_cast<StelGui*>(StelApp::getInstance().getGui());
 	Q_ASSERT(gui);
 	ui->landscapeTextBrowser->document()->setDefaultStyleSheet(QString(gui->getStelStyle().htmlStyleSheet));
@@ -51,6 +51,7 @@ private slots:
 	void skyCultureChanged(const QString& cultureName);
 	void projectionChanged(const QString& projectionName);
 	void landscapeChanged(QListWidgetItem* item);
+	void updateLandscapeDescription();
 	void setZhrFromControls(int zhr);
 	void updateZhrDescription();
 	void updateZhrControls(int zhr);
@@ -358,7 +358,7 @@ int main(int argc, char **argv)
 	{
 		mainWin.init(confSettings);
 		splash.finish(&mainWin);
-		app.exec();
+		const int exitCode = app.exec();
 		mainWin.deinit();
 
 		delete confSettings;
@@ -374,7 +374,7 @@ int main(int argc, char **argv)
 		delete(value);
 		#endif
 
-		return 0;
+		return exitCode;
 	}
 	else
 	{
@@ -19,155 +19,141 @@
 
 
 #include "ScreenImageMgr.hpp"
-#include "StelMainView.hpp"
 #include "StelApp.hpp"
 #include "StelFileMgr.hpp"
 #include "StelCore.hpp"
 #include "StelModuleMgr.hpp"
+#include "StelPainter.hpp"
+#include "StelTexture.hpp"
+#include "StelTextureMgr.hpp"
 
 #include "StelProjector.hpp"
 #include "StelModule.hpp"
 #include "StelUtils.hpp"
 #include "VecMath.hpp"
 
-#include <QGraphicsPixmapItem>
-#include <QPixmap>
 #include <QString>
 #include <QDebug>
+#include <QDir>
 #include <QMap>
-#include <QTimeLine>
-#include <QGraphicsItemAnimation>
 
 ///////////////////////
 // ScreenImage class //
 ///////////////////////
 ScreenImage::ScreenImage(const QString& filename, float x, float y, bool show, float scale, float alpha, float fadeDuration)
-	: tex(NULL), maxAlpha(alpha)
+	: width(0), height(0), posX(x), posY(y), moveStartX(x), moveStartY(y), moveTargetX(x), moveTargetY(y),
+	  moveDuration(0.), moveElapsed(0.), maxAlpha(alpha)
 {
-	QPixmap pm(filename);
-	tex = StelMainView::getInstance().scene()->addPixmap(pm.scaled(pm.size()*scale));
-	tex->setPos(x, y);
-
-	anim = new QGraphicsItemAnimation();
-	moveTimer = new QTimeLine();
-	moveTimer->setCurveShape(QTimeLine::LinearCurve);
-	anim->setTimeLine(moveTimer);
-	anim->setItem(tex);
+	// The image is decoded and uploaded in the background, it is shown once loaded.
+	// The mipmaps keep the images drawn smaller than their size smooth.
+	tex = StelApp::getInstance().getTextureManager().createTextureThread(filename, StelTexture::StelTextureParams(true), false);
+	int w, h;
+	if (tex && tex->getDimensions(w, h))
+	{
+		width = (int)(w*scale);
+		height = (int)(h*scale);
+	}
+	else
+		qWarning() << "Failed to load screen image" << QDir::toNativeSeparators(filename);
 
-	fadeTimer = new QTimeLine();
-	fadeTimer->setCurveShape(QTimeLine::LinearCurve);
 	setFadeDuration(fadeDuration);
-	connect(fadeTimer, SIGNAL(valueChanged(qreal)), this, SLOT(setOpacity(qreal)));
-
 	// set inital displayed state
-	if (show)
-		tex->setOpacity(maxAlpha);
-	else
-		tex->setOpacity(0.);
+	fader = show;
+	fader.update(fader.getDuration());
 }
 
 ScreenImage::~ScreenImage()
 {
-	if (tex!=NULL)
-	{
-		delete tex;
-		tex = NULL;
-	}
-	moveTimer->stop();
-	delete anim; anim = NULL;
-	delete moveTimer; moveTimer = NULL;
 }
 
-bool ScreenImage::draw(const StelCore*)
+bool ScreenImage::draw(const StelCore* core)
 {
+	const float alpha = fader.getInterstate()*maxAlpha;
+	if (alpha<=0.f || width<=0 || height<=0 || !tex)
+		return true;
+	// bind() returns false while the texture is still loading
+	if (!tex->bind())
+		return true;
+
+	StelPainter sPainter(core->getProjection2d());
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	sPainter.enableTexture2d(true);
+	sPainter.setColor(1.f, 1.f, 1.f, alpha);
+	// The position is given from the top of the screen and the drawing is done from the bottom
+	const float y = core->getProjection2d()->getViewportHeight() - posY - height;
+	sPainter.drawRect2d(posX, y, width, height);
 	return true;
 }
 
-void ScreenImage::update(double)
+void ScreenImage::update(double deltaTime)
 {
+	fader.update((int)(deltaTime*1000));
+	if (moveDuration>0.)
+	{
+		moveElapsed += deltaTime;
+		const double f = qMin(1., moveElapsed/moveDuration);
+		posX = moveStartX + (moveTargetX-moveStartX)*f;
+		posY = moveStartY + (moveTargetY-moveStartY)*f;
+		if (f>=1.)
+			moveDuration = 0.;
+	}
 }
 
 void ScreenImage::setFadeDuration(float duration)
 {
 	int fadeMs = duration * 1000;
 	if (fadeMs<=0) fadeMs=1;
-	fadeTimer->setDuration(fadeMs);
+	fader.setDuration(fadeMs);
 }
 
 void ScreenImage::setFlagShow(bool b)
 {
-	if (b)
-	{
-		fadeTimer->setFrameRange(tex->opacity()*fadeTimer->duration(),fadeTimer->duration());
-		fadeTimer->setDirection(QTimeLine::Forward);
-	}
-	else
-	{
-		fadeTimer->setFrameRange(tex->opacity()*fadeTimer->duration(),0);
-		fadeTimer->setDirection(QTimeLine::Backward);
-	}
-	fadeTimer->start();
+	fader = b;
 }
 
 bool ScreenImage::getFlagShow(void)
 {
-	return (tex->opacity() > 0.);
+	return fader.getInterstate() > 0.;
 }
 
 void ScreenImage::setAlpha(float a)
 {
 	maxAlpha = a;
-	if (getFlagShow())
-	{
-		fadeTimer->stop();
-		tex->setOpacity(a);
-	}
 }
 
 void ScreenImage::setXY(float x, float y, float duration)
 {
+	moveTargetX = x;
+	moveTargetY = y;
 	if (duration<=0.)
 	{
-		moveTimer->stop();
-		tex->setPos(x, y);
+		moveDuration = 0.;
+		posX = x;
+		posY = y;
 	}
 	else
 	{
-		moveTimer->stop();
-		moveTimer->setDuration(duration*1000);
-		moveTimer->setFrameRange(0,100);
-		QPointF p(tex->pos());
-		if (p == QPointF(x,y)) return;
-		float sX = p.x();
-		float sY = p.y();
-		float dX = (x-sX) / 200.;
-		float dY = (y-sY) / 200.;
-		for(int i=0; i<200; i++)
-			anim->setPosAt(i/200., QPointF(sX+(dX*i), (sY+(dY*i))));
-		anim->setPosAt(1.0, QPointF(x, y));
-		moveTimer->start();
+		moveStartX = posX;
+		moveStartY = posY;
+		moveDuration = duration;
+		moveElapsed = 0.;
 	}
 }
 
 void ScreenImage::addXY(float x, float y, float duration)
 {
-	QPointF currentPos = tex->pos();
-	setXY(currentPos.x() + x, currentPos.y() + y, duration);
+	setXY(posX + x, posY + y, duration);
 }
 
 int ScreenImage::imageWidth(void)
 {
-	return tex->pixmap().size().width();
+	return width;
 }
 
 int ScreenImage::imageHeight(void)
 {
-	return tex->pixmap().size().height();
-}
-
-void ScreenImage::setOpacity(qreal alpha)
-{
-	tex->setOpacity(alpha*maxAlpha);
+	return height;
 }
 
 //////////////////////////
@@ -22,6 +22,7 @@
 
 
 #include "StelModule.hpp"
+#include "StelFader.hpp"
 #include "StelTextureTypes.hpp"
 #include "VecMath.hpp"
 
@@ -31,11 +32,10 @@
 #include <QSize>
 
 class StelCore;
-class QGraphicsPixmapItem;
-class QTimeLine;
-class QGraphicsItemAnimation;
 
 // base class for different image types
+//! The images are loaded in a thread by the StelTextureMgr and drawn as textured quads
+//! in the OpenGL pass, the movements and fades being computed at each frame.
 class ScreenImage : public QObject
 {
 	Q_OBJECT
@@ -45,7 +45,7 @@ public:
 	//! @param filename the partial path of the file to load.  This will be searched for in the
 	//! scripts directory using StelFileMgr.
 	//! @param x the screen x-position for the texture (in pixels), measured from the left side of the screen.
-	//! @param y the screen x-position for the texture (in pixels), measured from the bottom of the screen.
+	//! @param y the screen y-position for the texture (in pixels), measured from the top of the screen.
 	//! @param show the initial displayed status of the image (false == hidden).
 	//! @param scale scale factor for the image. 1 = original size, 0.5 = 50% size etc.
 	//! @param fadeDuration the time it takes for screen images to fade in/out/change alpha in seconds.
@@ -82,13 +82,15 @@ public:
 	virtual int imageWidth(void);
 
 protected:
-	QGraphicsPixmapItem* tex;
-	QTimeLine* moveTimer;
-	QTimeLine* fadeTimer;
-	QGraphicsItemAnimation* anim;
-
-private slots:
-	void setOpacity(qreal alpha);
+	StelTextureSP tex;
+	//! Size of the image on the screen, in pixels.
+	int width, height;
+	//! Current position of the top left corner, in pixels from the top left of the screen.
+	float posX, posY;
+	//! The linear movement in progress, if moveDuration>0.
+	float moveStartX, moveStartY, moveTargetX, moveTargetY;
+	double moveDuration, moveElapsed;
+	LinearFader fader;
 
 private:
 	float maxAlpha;
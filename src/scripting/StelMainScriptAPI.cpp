@@ -36,6 +36,12 @@
 #include "StelVideoMgr.hpp"
 #include "StelCore.hpp"
 #include "StelFileMgr.hpp"
+#include "StelFrameProfiler.hpp"
+#include "StelRenderStats.hpp"
+#include "StelMemoryStats.hpp"
+#include "StelTracer.hpp"
+#include "StelFrameRecorder.hpp"
+#include "StelTiledCapture.hpp"
 #include "StelLocation.hpp"
 #include "StelLocationMgr.hpp"
 #include "StelMainView.hpp"
@@ -89,6 +95,8 @@ StelMainScriptAPI::StelMainScriptAPI(QObject *parent) : QObject(parent)
 	connect(this, SIGNAL(requestSetVideoAlpha(const QString&, float)), StelApp::getInstance().getStelVideoMgr(), SLOT(setVideoAlpha(const QString&, float)));
 	connect(this, SIGNAL(requestResizeVideo(const QString&, float, float)), StelApp::getInstance().getStelVideoMgr(), SLOT(resizeVideo(const QString&, float, float)));
 	connect(this, SIGNAL(requestShowVideo(const QString&, bool)), StelApp::getInstance().getStelVideoMgr(), SLOT(showVideo(const QString&, bool)));
+	connect(this, SIGNAL(requestSetVideoSkyPosition(const QString&, double, double, double, double)), StelApp::getInstance().getStelVideoMgr(), SLOT(setVideoSkyPosition(const QString&, double, double, double, double)));
+	connect(this, SIGNAL(requestSetVideoSyncToTime(const QString&, bool)), StelApp::getInstance().getStelVideoMgr(), SLOT(setVideoSyncToTime(const QString&, bool)));
 
 	connect(this, SIGNAL(requestExit()), this->parent(), SLOT(stopScript()));
 	connect(this, SIGNAL(requestSetNightMode(bool)), &StelApp::getInstance(), SLOT(setVisionModeNight(bool)));
@@ -254,6 +262,94 @@ void StelMainScriptAPI::screenshot(const QString& prefix, bool invert, const QSt
 	StelMainView::getInstance().setFlagInvertScreenShotColors(oldInvertSetting);
 }
 
+void StelMainScriptAPI::setFlagFrameProfiler(bool b)
+{
+	StelApp::getInstance().getFrameProfiler()->setEnabled(b);
+}
+
+bool StelMainScriptAPI::getFlagFrameProfiler()
+{
+	return StelApp::getInstance().getFrameProfiler()->isEnabled();
+}
+
+bool StelMainScriptAPI::saveFrameProfile(const QString& fileName)
+{
+	StelFrameProfiler* profiler = StelApp::getInstance().getFrameProfiler();
+	if (!profiler->isEnabled())
+	{
+		qWarning() << "saveFrameProfile: the frame profiler is not enabled";
+		return false;
+	}
+	return profiler->writeReport(fileName);
+}
+
+void StelMainScriptAPI::setFlagRenderStats(bool b)
+{
+	StelApp::getInstance().getRenderStats()->setFlagOverlay(b);
+}
+
+bool StelMainScriptAPI::getFlagRenderStats()
+{
+	return StelApp::getInstance().getRenderStats()->getFlagOverlay();
+}
+
+QVariantMap StelMainScriptAPI::getRenderStats()
+{
+	return StelApp::getInstance().getRenderStats()->getLastFrame();
+}
+
+QVariantMap StelMainScriptAPI::getMemoryReport()
+{
+	return StelApp::getInstance().getMemoryStats()->getReport();
+}
+
+void StelMainScriptAPI::setFlagTracing(bool b)
+{
+	StelTracer::setEnabled(b);
+}
+
+bool StelMainScriptAPI::getFlagTracing()
+{
+	return StelTracer::isEnabled();
+}
+
+bool StelMainScriptAPI::saveTrace(const QString& fileName)
+{
+	if (!StelTracer::isEnabled())
+	{
+		qWarning() << "saveTrace: the tracing is not enabled";
+		return false;
+	}
+	return StelTracer::writeChromeTrace(fileName);
+}
+
+bool StelMainScriptAPI::startRecording(const QString& dir, const QString& prefix, int width, int height, double fps)
+{
+	const StelProjector::StelProjectorParams params = StelApp::getInstance().getCore()->getCurrentStelProjectorParams();
+	const QSize size(width>0 ? width : params.viewportXywh[2], height>0 ? height : params.viewportXywh[3]);
+	return StelApp::getInstance().getFrameRecorder()->start(dir.isEmpty() ? StelFileMgr::getScreenshotDir() : dir, prefix, size, fps);
+}
+
+void StelMainScriptAPI::stopRecording()
+{
+	StelApp::getInstance().getFrameRecorder()->stop();
+}
+
+bool StelMainScriptAPI::captureTiled(const QString& fileName, int width, int height, const QString& mode, int tileSize)
+{
+	StelTiledCapture::Mode captureMode;
+	if (!StelTiledCapture::modeFromString(mode, captureMode))
+	{
+		qWarning() << "captureTiled: unknown mode" << mode;
+		return false;
+	}
+	const StelProjector::StelProjectorParams params = StelApp::getInstance().getCore()->getCurrentStelProjectorParams();
+	if (height<=0 && width>0)
+		height = qRound((double)width*params.viewportXywh[3]/params.viewportXywh[2]);
+	const QString path = QFileInfo(fileName).isAbsolute() ? fileName : StelFileMgr::getScreenshotDir() + "/" + fileName;
+	return StelApp::getInstance().getTiledCapture()->request(path, captureMode, width, height, tileSize);
+}
+
 void StelMainScriptAPI::setGuiVisible(bool b)
 {
 	StelApp::getInstance().getGui()->setVisible(b);
@@ -569,6 +665,16 @@ void StelMainScriptAPI::showVideo(const QString& id, bool show)
 	emit(requestShowVideo(id, show));
 }
 
+void StelMainScriptAPI::setVideoSkyPosition(const QString& id, double ra, double dec, double width, double height)
+{
+	emit(requestSetVideoSkyPosition(id, ra, dec, width, height));
+}
+
+void StelMainScriptAPI::setVideoSyncToTime(const QString& id, bool sync)
+{
+	emit(requestSetVideoSyncToTime(id, sync));
+}
+
 int StelMainScriptAPI::getScreenWidth()
 {
 	return StelMainView::getInstance().size().width();
@@ -594,6 +700,11 @@ void StelMainScriptAPI::pauseScript()
 	return StelApp::getInstance().getScriptMgr().pauseScript();
 }
 
+bool StelMainScriptAPI::prepareScript(const QString& filename)
+{
+	return StelApp::getInstance().getScriptMgr().prepareScript(filename);
+}
+
 void StelMainScriptAPI::setSelectedObjectInfo(const QString& level)
 {
 	if (level == "AllInfo")
@@ -293,6 +293,80 @@ public slots:
 	//! @param invert whether colors have to be inverted in the output image
 	void screenshot(const QString& prefix, bool invert=false, const QString& dir="");
 
+	//! Enable or disable the measure of the time spent by each module in the main loop.
+	//! When enabled, a table of the timings of the last frames is drawn on top of the view.
+	//! @param b if true, enable the frame profiler, else disable it.
+	void setFlagFrameProfiler(bool b);
+	//! Get whether the frame profiler is enabled.
+	bool getFlagFrameProfiler();
+	//! Save the timings measured by the frame profiler.
+	//! @param fileName the path of the file to write. The statistics are written
+	//! in JSON if the file name ends with .json, else in CSV.
+	//! @return false if the profiler is disabled or the file could not be written.
+	bool saveFrameProfile(const QString& fileName);
+
+	//! Enable or disable the table of the rendering counters of the last frame drawn on top of the view.
+	//! @param b if true, draw the counters, else hide them.
+	void setFlagRenderStats(bool b);
+	//! Get whether the rendering counters are drawn on top of the view.
+	bool getFlagRenderStats();
+	//! Get the rendering counters of the last frame, e.g. the draw calls or the stars drawn by level.
+	//! @return a map of the values by counter name.
+	QVariantMap getRenderStats();
+
+	//! Get the memory held by the subsystems: the tagged buffers like the textures or the star catalogs,
+	//! and the estimates of the modules.
+	//! @return a map with the "cpu" and "gpu" total bytes, and for each tag or module a map of its "kind"
+	//! ("cpu" or "gpu"), "bytes", "mapped" bytes of the files mapped in memory and "resident" bytes of
+	//! these files in RAM (-1 if unknown).
+	QVariantMap getMemoryReport();
+
+	//! Enable or disable the recording of the timeline of the frames, including the
+	//! loading done in the worker threads. The previous events are cleared when enabling.
+	//! @param b if true, enable the tracing, else disable it.
+	void setFlagTracing(bool b);
+	//! Get whether the tracing is enabled.
+	bool getFlagTracing();
+	//! Save the timeline of the last recorded events in the Chrome trace event format,
+	//! which can be opened in chrome://tracing or in the Perfetto UI.
+	//! @param fileName the path of the JSON file to write.
+	//! @return false if the tracing is disabled or the file could not be written.
+	bool saveTrace(const QString& fileName);
+
+	//! Start rendering the frames offline to produce a video.
+	//! While recording, the sky is rendered in a buffer of the given size instead of the
+	//! window, and each call to wait() renders as many frames as the waited duration
+	//! lasts at the given frame rate, the time of the simulation advancing by exactly
+	//! one frame each time. The frames are written as numbered PNG files.
+	//! The recording stops with stopRecording() or at the end of the script.
+	//! @param dir the directory in which the frames are written. If none is specified,
+	//! the default screenshot directory will be used.
+	//! @param prefix the prefix of the file names, followed by the frame number.
+	//! @param width the width of the frames in pixels, 0 to use the width of the view.
+	//! @param height the height of the frames in pixels, 0 to use the height of the view.
+	//! @param fps the number of frames per second of the video.
+	//! @return false if the recording could not be started.
+	bool startRecording(const QString& dir="", const QString& prefix="frame-", int width=0, int height=0, double fps=30.);
+	//! Stop rendering the frames offline, after writing the frames already rendered.
+	void stopRecording();
+
+	//! Capture a still image larger than the window, drawn tile by tile at the next frame.
+	//! As for screenshot(), the capture is drawn after the call returns, with the view of the next frame.
+	//! A file with the ".ppm" extension is written one row of tiles at a time without holding the whole
+	//! image in memory. With any other extension, each tile is written in its own file, named after the
+	//! file name followed by _rROW_cCOLUMN.
+	//! @param fileName the path of the image. For a cube map the name of the face ("front", "right",
+	//! "back", "left", "top" or "bottom") is appended to the name of each file.
+	//! @param width the width of the image in pixels, the size of the faces for a cube map.
+	//! @param height the height of the image in pixels, 0 to keep the proportions of the view. It is not
+	//! used for the panoramas.
+	//! @param mode "view" for the current view, "equirectangular" for a panorama of the whole sky twice
+	//! as wide as high, "cubemap" for the six faces of a cube map. The panoramas are centered on the
+	//! azimuth of the current view with the zenith up.
+	//! @param tileSize the size of the tiles in pixels, within the limits of the graphics card.
+	//! @return false if the parameters are invalid or the file can not be written in its directory.
+	bool captureTiled(const QString& fileName, int width, int height=0, const QString& mode="view", int tileSize=2048);
+
 	//! Show or hide the GUI (toolbars).  Note this only applies to GUI plugins which
 	//! provide the public slot "setGuiVisible(bool)".
 	//! @param b if true, show the GUI, if false, hide the GUI.
@@ -580,6 +654,22 @@ public slots:
 	//! @param show the new visible state of the video.
         void showVideo(const QString& id, bool show);
 
+	//! Draw a video on the sky instead of the screen, as a rectangle centered on J2000 coordinates.
+	//! setVideoXY puts it back on the screen.
+	//! @param id the identifier used when loadVideo was called
+	//! @param ra the right ascension of the center of the video in degrees.
+	//! @param dec the declination of the center of the video in degrees.
+	//! @param width the angular width of the video in degrees.
+	//! @param height the angular height of the video in degrees.
+	void setVideoSkyPosition(const QString& id, double ra, double dec, double width, double height);
+
+	//! Make the position of a video follow the simulation time instead of the clock.
+	//! The video then plays at the time rate, stops with the time and moves when the date is set.
+	//! The current date corresponds to the current position of the video.
+	//! @param id the identifier used when loadVideo was called
+	//! @param sync true to follow the simulation time.
+	void setVideoSyncToTime(const QString& id, bool sync);
+
 	//! Get the screen width in pixels.
 	//! @return The screen width in pixels
 	int getScreenWidth();
@@ -600,6 +690,12 @@ public slots:
 	//! the key '6' or the GUI to resume script execution.
 	void pauseScript();
 
+	//! Preprocess a script and prepare its program, so that it starts at once when it is run.
+	//! A show can prepare the next scripts of its playlist while the current one is running.
+	//! @param filename the file name of the script, relative to the scripts directory or absolute.
+	//! @return false if the script could not be found or preprocessed.
+	bool prepareScript(const QString& filename);
+
 	//! Set the amount of selected object information to display
 	//! @param level can be "AllInfo", "ShortInfo", "None"
 	void setSelectedObjectInfo(const QString& level);
@@ -682,6 +778,8 @@ signals:
 	void requestSetVideoAlpha(const QString& id, float alpha);
 	void requestResizeVideo(const QString& id, float w, float h);
 	void requestShowVideo(const QString& id, bool show);
+	void requestSetVideoSkyPosition(const QString& id, double ra, double dec, double width, double height);
+	void requestSetVideoSyncToTime(const QString& id, bool sync);
 	
 	void requestSetNightMode(bool b);
 	void requestSetProjectionMode(QString id);
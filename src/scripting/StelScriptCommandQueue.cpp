@@ -0,0 +1,400 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "StelScriptCommandQueue.hpp"
+#include "StelApp.hpp"
+#include "StelSessionRecorder.hpp"
+
+#include <QDebug>
+#include <QMetaEnum>
+#include <QMetaMethod>
+#include <QMetaProperty>
+#include <QMutexLocker>
+#include <QScriptContext>
+#include <QScriptEngine>
+
+// The methods with more arguments can not be called with QMetaMethod::invoke()
+static const int MaxArguments = 10;
+
+StelScriptCommandQueue::StelScriptCommandQueue(QObject* parent) : QObject(parent), aborted(false), transactionDepth(0)
+{
+}
+
+QScriptValue StelScriptCommandQueue::wrapObject(QScriptEngine* engine, QObject* obj, const QString& name)
+{
+	if (obj==NULL)
+		return engine->nullValue();
+	if (!name.isEmpty())
+		namedObjects.insert(name, obj);
+
+	QScriptValue wrapper = engine->newObject();
+	const QMetaObject* metaObject = obj->metaObject();
+	QVariant queueData = QVariant::fromValue((void*)this);
+	QVariant objectData = QVariant::fromValue(obj);
+
+	// Group the overloads of the methods by name, the right one is chosen when called
+	QMap<QByteArray, QList<int> > methods;
+	for (int i=QObject::staticMetaObject.methodCount(); i<metaObject->methodCount(); ++i)
+	{
+		const QMetaMethod method = metaObject->method(i);
+		if (method.access()!=QMetaMethod::Public || method.parameterCount()>MaxArguments)
+			continue;
+		if (method.methodType()!=QMetaMethod::Slot && method.methodType()!=QMetaMethod::Method)
+			continue;
+		methods[method.name()].append(i);
+	}
+	for (QMap<QByteArray, QList<int> >::ConstIterator iter=methods.constBegin(); iter!=methods.constEnd(); ++iter)
+	{
+		QScriptValue data = engine->newObject();
+		data.setProperty("queue", engine->newVariant(queueData));
+		data.setProperty("object", engine->newVariant(objectData));
+		QScriptValue indices = engine->newArray(iter.value().size());
+		for (int i=0; i<iter.value().size(); ++i)
+			indices.setProperty(i, iter.value().at(i));
+		data.setProperty("indices", indices);
+		QScriptValue function = engine->newFunction(callMethod);
+		function.setData(data);
+		wrapper.setProperty(QString::fromLatin1(iter.key()), function);
+	}
+
+	for (int i=0; i<metaObject->propertyCount(); ++i)
+	{
+		const QMetaProperty property = metaObject->property(i);
+		if (!property.isReadable())
+			continue;
+		QScriptValue data = engine->newObject();
+		data.setProperty("queue", engine->newVariant(queueData));
+		data.setProperty("object", engine->newVariant(objectData));
+		data.setProperty("index", i);
+		QScriptValue function = engine->newFunction(accessProperty);
+		function.setData(data);
+		wrapper.setProperty(property.name(), function, QScriptValue::PropertyGetter|QScriptValue::PropertySetter);
+	}
+
+	for (int i=QObject::staticMetaObject.enumeratorCount(); i<metaObject->enumeratorCount(); ++i)
+	{
+		const QMetaEnum metaEnum = metaObject->enumerator(i);
+		for (int k=0; k<metaEnum.keyCount(); ++k)
+			wrapper.setProperty(metaEnum.key(k), metaEnum.value(k), QScriptValue::ReadOnly|QScriptValue::Undeletable);
+	}
+	return wrapper;
+}
+
+void StelScriptCommandQueue::setAborted(bool b)
+{
+	QMutexLocker locker(&mutex);
+	aborted = b;
+	if (aborted)
+	{
+		commands.clear();
+		transaction.clear();
+		transactionDepth = 0;
+		resultReady.wakeAll();
+	}
+}
+
+void StelScriptCommandQueue::beginTransaction()
+{
+	QMutexLocker locker(&mutex);
+	++transactionDepth;
+}
+
+void StelScriptCommandQueue::commitTransaction()
+{
+	QMutexLocker locker(&mutex);
+	if (transactionDepth==0 || --transactionDepth>0)
+		return;
+	foreach (const Command& command, transaction)
+		commands.enqueue(command);
+	transaction.clear();
+}
+
+void StelScriptCommandQueue::commitAllTransactions()
+{
+	QMutexLocker locker(&mutex);
+	transactionDepth = 0;
+	foreach (const Command& command, transaction)
+		commands.enqueue(command);
+	transaction.clear();
+}
+
+void StelScriptCommandQueue::addToTransaction(const Command& command)
+{
+	const bool setter = command.type==Command::CallMethod && command.args.size()>0
+	                    && command.object->metaObject()->method(command.index).name().startsWith("set");
+	if (command.type==Command::WriteProperty || setter)
+	{
+		for (int i=0; i<transaction.size(); ++i)
+		{
+			Command& previous = transaction[i];
+			if (previous.object!=command.object || previous.index!=command.index || previous.type!=command.type)
+				continue;
+			if (setter && previous.args.mid(0, previous.args.size()-1)!=command.args.mid(0, command.args.size()-1))
+				continue;
+			// Applied in the place of the first one, which the commands in between may follow
+			previous.args = command.args;
+			return;
+		}
+	}
+	transaction.append(command);
+}
+
+QVariant StelScriptCommandQueue::post(const Command& command)
+{
+	QMutexLocker locker(&mutex);
+	if (aborted)
+		return QVariant();
+	if (transactionDepth>0 && (command.type==Command::WriteProperty || command.result.isNull()))
+	{
+		// Nobody waits for the result of a write in a transaction
+		Command coalesced(command);
+		coalesced.result.clear();
+		addToTransaction(coalesced);
+		return QVariant();
+	}
+	commands.enqueue(command);
+	if (command.result.isNull())
+		return QVariant();
+
+	// Don't wait for the next frame to give the result
+	QMetaObject::invokeMethod(this, "processCommands", Qt::QueuedConnection);
+	while (!command.result->done && !aborted)
+		resultReady.wait(&mutex);
+	return command.result->value;
+}
+
+void StelScriptCommandQueue::processCommands()
+{
+	forever
+	{
+		Command command;
+		{
+			QMutexLocker locker(&mutex);
+			if (commands.isEmpty() || aborted)
+				return;
+			command = commands.dequeue();
+		}
+
+		// The lock is not held during the execution, as the command can stop the script
+		recordCommand(command);
+		QVariant value;
+		{
+			StelSessionRecorder::EventScope scope(StelApp::getInstance().getSessionRecorder());
+			value = execute(command);
+		}
+
+		if (!command.result.isNull())
+		{
+			QMutexLocker locker(&mutex);
+			command.result->value = value;
+			command.result->done = true;
+			resultReady.wakeAll();
+		}
+	}
+}
+
+void StelScriptCommandQueue::recordCommand(const Command& command) const
+{
+	StelSessionRecorder* recorder = StelApp::getInstance().getSessionRecorder();
+	if (!recorder || !recorder->isCapturing() || command.object==NULL || command.type==Command::ReadProperty)
+		return;
+	const QMetaObject* metaObject = command.object->metaObject();
+	const bool property = command.type==Command::WriteProperty;
+	const QByteArray member = property ? QByteArray(metaObject->property(command.index).name())
+	                                   : metaObject->method(command.index).methodSignature();
+	// The objects returned by the calls have no name, their calls can't be replayed
+	recorder->recordScriptCommand(namedObjects.key(command.object), property, member, command.args);
+}
+
+bool StelScriptCommandQueue::replayCommand(const QString& object, bool property, const QByteArray& member, const QVariantList& args)
+{
+	Command command;
+	command.object = namedObjects.value(object);
+	if (command.object==NULL)
+	{
+		qWarning() << "WARNING: cannot replay the script call to" << member << "of the object" << object;
+		return false;
+	}
+	const QMetaObject* metaObject = command.object->metaObject();
+	command.args = args;
+	if (property)
+	{
+		command.type = Command::WriteProperty;
+		command.index = metaObject->indexOfProperty(member.constData());
+	}
+	else
+	{
+		command.type = Command::CallMethod;
+		command.index = metaObject->indexOfMethod(member.constData());
+		if (command.index>=0)
+		{
+			const QMetaMethod method = metaObject->method(command.index);
+			for (int i=0; i<method.parameterCount(); ++i)
+				command.types.append(method.parameterType(i));
+		}
+	}
+	bool valid = command.index>=0 && (property ? !command.args.isEmpty() : command.types.size()==command.args.size());
+	// The arguments must be of the exact types of the parameters, which the file may not keep
+	for (int i=0; valid && i<command.types.size(); ++i)
+	{
+		const int type = command.types.at(i);
+		if (type!=QMetaType::QVariant && command.args.at(i).userType()!=type)
+			valid = command.args[i].convert(type);
+	}
+	if (!valid)
+	{
+		qWarning() << "WARNING: cannot replay the script call to" << member << "of the object" << object;
+		return false;
+	}
+	execute(command);
+	return true;
+}
+
+QVariant StelScriptCommandQueue::execute(Command& command)
+{
+	if (command.object==NULL)
+		return QVariant();
+
+	const QMetaObject* metaObject = command.object->metaObject();
+	if (command.type==Command::ReadProperty)
+		return metaObject->property(command.index).read(command.object);
+	if (command.type==Command::WriteProperty)
+	{
+		metaObject->property(command.index).write(command.object, command.args.at(0));
+		return QVariant();
+	}
+
+	const QMetaMethod method = metaObject->method(command.index);
+	QGenericArgument args[MaxArguments];
+	for (int i=0; i<command.args.size(); ++i)
+	{
+		// The arguments of type QVariant are passed as is
+		void* data = command.types.at(i)==QMetaType::QVariant ? (void*)&command.args[i] : command.args[i].data();
+		args[i] = QGenericArgument(QMetaType::typeName(command.types.at(i)), data);
+	}
+
+	const int returnType = method.returnType();
+	QVariant result;
+	if (returnType!=QMetaType::Void && returnType!=QMetaType::UnknownType)
+		result = QVariant(returnType, (const void*)NULL);
+	QGenericReturnArgument ret;
+	if (result.isValid())
+		ret = QGenericReturnArgument(method.typeName(), result.data());
+	if (!method.invoke(command.object, Qt::DirectConnection, ret,
+			   args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9]))
+	{
+		qWarning() << "WARNING: script call to" << method.methodSignature() << "failed";
+		return QVariant();
+	}
+	if (returnType==QMetaType::QVariant)
+		return result.value<QVariant>();
+	return result;
+}
+
+QScriptValue StelScriptCommandQueue::callMethod(QScriptContext* context, QScriptEngine* engine)
+{
+	const QScriptValue data = context->callee().data();
+	StelScriptCommandQueue* queue = static_cast<StelScriptCommandQueue*>(data.property("queue").toVariant().value<void*>());
+	QObject* obj = data.property("object").toVariant().value<QObject*>();
+	const QScriptValue indices = data.property("indices");
+	const int nbIndices = indices.property("length").toInt32();
+	const QMetaObject* metaObject = obj->metaObject();
+
+	// Like QtScript, use the overload taking as many arguments as given when possible,
+	// else the one taking the fewest extra arguments, else the one taking the most.
+	int best = -1;
+	int bestScore = 0;
+	for (int i=0; i<nbIndices; ++i)
+	{
+		const int index = indices.property(i).toInt32();
+		const int nbParams = metaObject->method(index).parameterCount();
+		const int score = nbParams>=context->argumentCount() ? nbParams-context->argumentCount() : 2*MaxArguments+context->argumentCount()-nbParams;
+		if (best<0 || score<bestScore)
+		{
+			best = index;
+			bestScore = score;
+		}
+	}
+	if (best<0)
+		return engine->undefinedValue();
+
+	const QMetaMethod method = metaObject->method(best);
+	Command command;
+	command.type = Command::CallMethod;
+	command.object = obj;
+	command.index = best;
+	for (int i=0; i<method.parameterCount(); ++i)
+	{
+		command.types.append(method.parameterType(i));
+		command.args.append(fromScriptValue(context->argument(i), method.parameterType(i)));
+	}
+	if (method.returnType()!=QMetaType::Void)
+		command.result = QSharedPointer<Result>(new Result());
+	return queue->toScriptValue(engine, queue->post(command));
+}
+
+QScriptValue StelScriptCommandQueue::accessProperty(QScriptContext* context, QScriptEngine* engine)
+{
+	const QScriptValue data = context->callee().data();
+	StelScriptCommandQueue* queue = static_cast<StelScriptCommandQueue*>(data.property("queue").toVariant().value<void*>());
+	QObject* obj = data.property("object").toVariant().value<QObject*>();
+
+	Command command;
+	command.object = obj;
+	command.index = data.property("index").toInt32();
+	command.result = QSharedPointer<Result>(new Result());
+	if (context->argumentCount()==1)
+	{
+		// The setter waits too, so that the new value can be read back by the script
+		const QMetaProperty property = obj->metaObject()->property(command.index);
+		command.type = Command::WriteProperty;
+		command.args.append(fromScriptValue(context->argument(0), property.userType()));
+		command.types.append(property.userType());
+		queue->post(command);
+		return context->argument(0);
+	}
+	command.type = Command::ReadProperty;
+	return queue->toScriptValue(engine, queue->post(command));
+}
+
+QVariant StelScriptCommandQueue::fromScriptValue(const QScriptValue& value, int typeId)
+{
+	if (typeId==QMetaType::QVariant)
+		return value.toVariant();
+	if (typeId==qMetaTypeId<Vec3f>())
+		return QVariant::fromValue(qscriptvalue_cast<Vec3f>(value));
+	if (typeId==QMetaType::QObjectStar)
+		return QVariant::fromValue(value.toQObject());
+
+	QVariant v = value.toVariant();
+	if (!v.isValid() || !v.convert(typeId))
+		v = QVariant(typeId, (const void*)NULL);
+	return v;
+}
+
+QScriptValue StelScriptCommandQueue::toScriptValue(QScriptEngine* engine, const QVariant& value)
+{
+	if (!value.isValid())
+		return engine->undefinedValue();
+	if (QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject)
+		return wrapObject(engine, value.value<QObject*>());
+	if (value.userType()==qMetaTypeId<Vec3f>())
+		return engine->toScriptValue(value.value<Vec3f>());
+	return engine->toScriptValue(value);
+}
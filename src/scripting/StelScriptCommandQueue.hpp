@@ -0,0 +1,148 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _STELSCRIPTCOMMANDQUEUE_HPP_
+#define _STELSCRIPTCOMMANDQUEUE_HPP_
+
+#include "VecMath.hpp"
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QScriptValue>
+#include <QSharedPointer>
+#include <QVariant>
+#include <QVector>
+#include <QWaitCondition>
+
+class QScriptContext;
+class QScriptEngine;
+
+Q_DECLARE_METATYPE(Vec3f)
+
+//! @class StelScriptCommandQueue
+//! Forward the calls done by a script running in the script thread to the objects
+//! living in the main thread.
+//! The objects are exposed to the script engine with wrapObject() instead of
+//! QScriptEngine::newQObject(). Each call to a slot or invokable method and each
+//! access to a property of a wrapped object is turned into a command, which is
+//! executed by processCommands() in the main thread, between two frames.
+//! The calls to methods without return value are only queued and the script goes
+//! on, the other calls and the property accesses wait for their result. To keep
+//! the script responsive, a command waited for is executed as soon as the main
+//! thread returns to its event loop instead of waiting for the next frame.
+//! Within a transaction, see beginTransaction(), the property writes and the calls to
+//! methods without return value are coalesced and queued together when it is committed,
+//! so that a scene change made of many calls is applied in a single frame.
+class StelScriptCommandQueue : public QObject
+{
+	Q_OBJECT
+
+public:
+	StelScriptCommandQueue(QObject* parent=0);
+
+	//! Create a script object forwarding the public slots, invokable methods and
+	//! properties of a QObject through the queue. The enums of the class are
+	//! exposed as read-only properties like QScriptEngine::newQObject() does.
+	//! To be called from the thread owning the engine or when no script is running.
+	//! @param name the name of the object in the engine, used to record and replay its calls
+	//! with the StelSessionRecorder. It must be given from the main thread.
+	QScriptValue wrapObject(QScriptEngine* engine, QObject* obj, const QString& name=QString());
+
+	//! When aborted, the queued commands are dropped, the new ones are ignored and
+	//! the calls waiting for a result return immediately with an invalid value.
+	//! Used to make sure that a script being stopped is not blocked in a call.
+	void setAborted(bool b);
+
+	//! Start coalescing the property writes and the calls to methods without return value,
+	//! instead of queuing them. The calls to a setter, i.e. a method whose name starts with "set",
+	//! with the same arguments but the last one, and the writes of the same property, replace the
+	//! previous ones: only the last value is applied. The commands with a result are still run
+	//! at once, so they do not see the changes of the transaction yet.
+	//! Transactions can be nested, the outermost one is committed. To be called from the script thread.
+	void beginTransaction();
+	//! Queue the commands coalesced since beginTransaction(), to be applied together at the next frame.
+	void commitTransaction();
+	//! Queue the commands of the transactions left open, e.g. when the script ends.
+	void commitAllTransactions();
+
+	//! Execute a call recorded by the StelSessionRecorder, to be called from the main thread.
+	//! @return false if the object or its member can not be found.
+	bool replayCommand(const QString& object, bool property, const QByteArray& member, const QVariantList& args);
+
+public slots:
+	//! Execute all the queued commands, to be called from the main thread.
+	void processCommands();
+
+private:
+	struct Result
+	{
+		Result() : done(false) {}
+		QVariant value;
+		bool done;
+	};
+
+	struct Command
+	{
+		enum Type
+		{
+			CallMethod,
+			ReadProperty,
+			WriteProperty
+		};
+		Type type;
+		QObject* object;
+		int index;
+		QVariantList args;
+		QVector<int> types;
+		//! NULL if nobody waits for the result.
+		QSharedPointer<Result> result;
+	};
+
+	//! Queue a command, and wait for its result if it has a result object.
+	QVariant post(const Command& command);
+	//! Add a command to the transaction, replacing the one it overrides. The mutex must be locked.
+	void addToTransaction(const Command& command);
+	//! Execute a command in the main thread.
+	static QVariant execute(Command& command);
+
+	//! Native functions used by the wrapped objects.
+	static QScriptValue callMethod(QScriptContext* context, QScriptEngine* engine);
+	static QScriptValue accessProperty(QScriptContext* context, QScriptEngine* engine);
+
+	//! Conversions between the script values and the types of the Qt meta system.
+	static QVariant fromScriptValue(const QScriptValue& value, int typeId);
+	QScriptValue toScriptValue(QScriptEngine* engine, const QVariant& value);
+
+	//! Record a command which changes the objects in the session being captured.
+	void recordCommand(const Command& command) const;
+
+	QMutex mutex;
+	QWaitCondition resultReady;
+	QQueue<Command> commands;
+	bool aborted;
+	//! The number of transactions begun and not committed, and their coalesced commands.
+	int transactionDepth;
+	QList<Command> transaction;
+	//! The objects wrapped with a name, which can be replayed.
+	QHash<QString, QObject*> namedObjects;
+};
+
+#endif // _STELSCRIPTCOMMANDQUEUE_HPP_
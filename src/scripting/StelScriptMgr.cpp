@@ -20,6 +20,7 @@
 
 
 #include "StelScriptMgr.hpp"
+#include "StelScriptCommandQueue.hpp"
 #include "StelMainScriptAPI.hpp"
 #include "StelModuleMgr.hpp"
 #include "LabelMgr.hpp"
@@ -30,6 +31,7 @@
 #include "StelApp.hpp"
 #include "StelCore.hpp"
 #include "StelFileMgr.hpp"
+#include "StelFrameRecorder.hpp"
 #include "StelModuleMgr.hpp"
 #include "StelMovementMgr.hpp"
 
@@ -39,8 +41,11 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QRegExp>
 #include <QSet>
 #include <QStringList>
@@ -49,8 +54,6 @@
 
 #include <cmath>
 
-Q_DECLARE_METATYPE(Vec3f);
-
 QScriptValue vec3fToScriptValue(QScriptEngine *engine, const Vec3f& c)
 {
 	QScriptValue obj = engine->newObject();
@@ -76,7 +79,7 @@ QScriptValue createVec3f(QScriptContext* context, QScriptEngine *engine)
 	return vec3fToScriptValue(engine, c);
 }
 
-StelScriptMgr::StelScriptMgr(QObject *parent): QObject(parent)
+StelScriptMgr::StelScriptMgr(QObject *parent): QObject(parent), scriptRate(1.0)
 {
 	connect(&StelApp::getInstance(), SIGNAL(aboutToQuit()), this, SLOT(stopScript()), Qt::DirectConnection);
 	// Scripting images
@@ -90,18 +93,21 @@ StelScriptMgr::StelScriptMgr(QObject *parent): QObject(parent)
 	QScriptValue ctor = engine.newFunction(createVec3f);
 	engine.globalObject().setProperty("Vec3f", ctor);
 
+	// The scripts run in their own thread and call the main thread objects through the queue
+	commandQueue = new StelScriptCommandQueue(this);
+	scriptThread = new StelScriptThread(&engine, this);
+	connect(scriptThread, SIGNAL(finished()), this, SLOT(scriptEnded()));
+
 	// Add the core object to access methods related to core
 	mainAPI = new StelMainScriptAPI(this);
-	QScriptValue objectValue = engine.newQObject(mainAPI);
+	QScriptValue objectValue = commandQueue->wrapObject(&engine, mainAPI, "core");
 	engine.globalObject().setProperty("core", objectValue);
 
-	engine.evaluate("function mywait__(sleepDurationSec) {"
-					"if (sleepDurationSec<0) return;"
-					"var date = new Date();"
-					"var curDate = null;"
-					"do {curDate = new Date();}"
-					"    while(curDate-date < sleepDurationSec*1000/scriptRateReadOnly);}");
-	engine.evaluate("core['wait'] = mywait__;");
+	engine.globalObject().setProperty("scriptRateReadOnly", engine.newFunction(scriptRateGetter), QScriptValue::PropertyGetter);
+	objectValue.setProperty("wait", engine.newFunction(scriptWait));
+	// The changes between the two calls are applied together at the next frame
+	objectValue.setProperty("beginTransaction", engine.newFunction(scriptBeginTransaction));
+	objectValue.setProperty("commitTransaction", engine.newFunction(scriptCommitTransaction));
 	
 	//! Waits until a specified simulation date/time.  This function
 	//! will take into account the rate (and direction) in which simulation
@@ -120,16 +126,9 @@ StelScriptMgr::StelScriptMgr(QObject *parent): QObject(parent)
 	engine.evaluate("core['waitFor'] = mywaitFor__;");
 	
 	// Add other classes which we want to be directly accessible from scripts
-	if(StelSkyLayerMgr* smgr = GETSTELMODULE(StelSkyLayerMgr))
-		objectValue = engine.newQObject(smgr);
-
 	// For accessing star scale, twinkle etc.
-	objectValue = engine.newQObject(StelApp::getInstance().getCore()->getSkyDrawer());
+	objectValue = commandQueue->wrapObject(&engine, StelApp::getInstance().getCore()->getSkyDrawer(), "StelSkyDrawer");
 	engine.globalObject().setProperty("StelSkyDrawer", objectValue);
-	
-	setScriptRate(1.0);
-	
-	engine.setProcessEventsInterval(10);
 
 	agent = new StelScriptEngineAgent(&engine);
 	engine.setAgent(agent);
@@ -155,6 +154,12 @@ void StelScriptMgr::initActions()
 
 StelScriptMgr::~StelScriptMgr()
 {
+	if (scriptThread->isRunning())
+	{
+		agent->setAbortScript(true);
+		commandQueue->setAborted(true);
+		scriptThread->wait();
+	}
 }
 
 void StelScriptMgr::addModules() 
@@ -163,12 +168,22 @@ void StelScriptMgr::addModules()
 	StelModuleMgr* mmgr = &StelApp::getInstance().getModuleMgr();
 	foreach (StelModule* m, mmgr->getAllModules())
 	{
-		QScriptValue objectValue = engine.newQObject(m);
+		QScriptValue objectValue = commandQueue->wrapObject(&engine, m, m->objectName());
 		engine.globalObject().setProperty(m->objectName(), objectValue);
 	}
 
 }
 
+void StelScriptMgr::processScriptCommands()
+{
+	commandQueue->processCommands();
+}
+
+bool StelScriptMgr::replayCommand(const QString& object, bool property, const QByteArray& member, const QVariantList& args)
+{
+	return commandQueue->replayCommand(object, property, member, args);
+}
+
 QStringList StelScriptMgr::getScriptList()
 {
 	QStringList scriptFiles;
@@ -189,12 +204,12 @@ QStringList StelScriptMgr::getScriptList()
 
 bool StelScriptMgr::scriptIsRunning()
 {
-	return engine.isEvaluating();
+	return scriptThread->isRunning();
 }
 
 QString StelScriptMgr::runningScriptId()
 {
-	if (engine.isEvaluating())
+	if (scriptThread->isRunning())
 		return scriptFileName;
 	else
 		return QString();
@@ -294,7 +309,7 @@ const QString StelScriptMgr::getDescription(const QString& s)
 
 bool StelScriptMgr::runPreprocessedScript(const QString &preprocessedScript)
 {
-	if (engine.isEvaluating())
+	if (scriptThread->isRunning())
 	{
 		QString msg = QString("ERROR: there is already a script running, please wait that it's over.");
 		emit(scriptDebug(msg));
@@ -307,26 +322,45 @@ bool StelScriptMgr::runPreprocessedScript(const QString &preprocessedScript)
 	// Make sure that the gui object have been completely initialized (there used to be problems with startup scripts).
 	Q_ASSERT(StelApp::getInstance().getGui());
 
-	engine.globalObject().setProperty("scriptRateReadOnly", 1.0);
+	setScriptRate(1.0);
+	agent->setAbortScript(false);
+	commandQueue->setAborted(false);
 
 	// Notify that the script starts here
 	emit(scriptRunning());
 
-	// run that script
-	engine.evaluate(preprocessedScript);
-	scriptEnded();
+	// run that script, scriptEnded() is called when the thread finishes
+	scriptThread->setScript(getProgram(preprocessedScript, scriptFileName));
+	scriptThread->start();
+	return true;
+}
+
+QString StelScriptMgr::getScriptPath(const QString& fileName)
+{
+	if (QFileInfo(fileName).isAbsolute())
+		return fileName;
+	return StelFileMgr::findFile("scripts/" + fileName);
+}
+
+bool StelScriptMgr::prepareScript(const QString& fileName)
+{
+	const QString absPath = getScriptPath(fileName);
+	if (absPath.isEmpty())
+	{
+		qWarning() << "WARNING: could not find script file" << QDir::toNativeSeparators(fileName);
+		return false;
+	}
+	QString preprocessedScript;
+	if (!preprocessFile(absPath, preprocessedScript, QFileInfo(absPath).dir().path(), NULL))
+		return false;
+	getProgram(preprocessedScript, fileName);
 	return true;
 }
 
 // Run the script located at the given location
 bool StelScriptMgr::runScript(const QString& fileName, const QString& includePath)
 {
-	QString absPath;
-
-	if (QFileInfo(fileName).isAbsolute())
-		absPath = fileName;
-	else
-		absPath = StelFileMgr::findFile("scripts/" + fileName);
+	const QString absPath = getScriptPath(fileName);
 
 	if (absPath.isEmpty())
 	{
@@ -350,15 +384,13 @@ bool StelScriptMgr::runScript(const QString& fileName, const QString& includePat
 	scriptFileName = fileName;
 	if (!includePath.isEmpty())
 		scriptDir = includePath;
-	QString preprocessedScript;
-	bool ok = false;
-	if (fileName.endsWith(".ssc"))
-		ok = preprocessScript(fic, preprocessedScript, scriptDir);
+	fic.close();
+	bool ok = fileName.endsWith(".ssc");
 #ifdef ENABLE_STRATOSCRIPT_COMPAT
-	else if (fileName.endsWith(".sts"))
-		ok = preprocessStratoScript(fic, preprocessedScript, scriptDir);
+	ok = ok || fileName.endsWith(".sts");
 #endif
-	if (!ok)
+	QString preprocessedScript;
+	if (!ok || !preprocessFile(absPath, preprocessedScript, scriptDir, NULL))
 	{
 		return false;
 	}
@@ -367,7 +399,7 @@ bool StelScriptMgr::runScript(const QString& fileName, const QString& includePat
 
 void StelScriptMgr::stopScript()
 {
-	if (engine.isEvaluating())
+	if (scriptThread->isRunning())
 	{
 		GETSTELMODULE(LabelMgr)->deleteAllLabels();
 		GETSTELMODULE(ScreenImageMgr)->deleteAllImages();
@@ -377,7 +409,13 @@ void StelScriptMgr::stopScript()
 		QString msg = QString("INFO: asking running script to exit");
 		emit(scriptDebug(msg));
 		//qDebug() << msg;
-		engine.abortEvaluation();
+		// Release the script if it waits for a command or a frame, it then stops at its next statement
+		StelApp::getInstance().getFrameRecorder()->stop();
+		agent->setAbortScript(true);
+		commandQueue->setAborted(true);
+		scriptThread->wait();
+		// scriptEnded() is called by the finished() signal of the thread
+		return;
 	}
 	scriptEnded();
 }
@@ -385,13 +423,14 @@ void StelScriptMgr::stopScript()
 void StelScriptMgr::setScriptRate(float r)
 {
 	//qDebug() << "StelScriptMgr::setScriptRate(" << r << ")";
-	if (!engine.isEvaluating())
+	if (!scriptThread->isRunning())
 	{
-		engine.globalObject().setProperty("scriptRateReadOnly", r);
+		QMutexLocker locker(&scriptRateMutex);
+		scriptRate = r;
 		return;
 	}
 	
-	float currentScriptRate = engine.globalObject().property("scriptRateReadOnly").toNumber();
+	float currentScriptRate = getScriptRate();
 	
 	// pre-calculate the new time rate in an effort to prevent there being much latency
 	// between setting the script rate and the time rate.
@@ -401,8 +440,8 @@ void StelScriptMgr::setScriptRate(float r)
 	core->setTimeRate(core->getTimeRate() * factor);
 	
 	GETSTELMODULE(StelMovementMgr)->setMovementSpeedFactor(core->getTimeRate());
-	engine.globalObject().setProperty("scriptRateReadOnly", r);
-
+	QMutexLocker locker(&scriptRateMutex);
+	scriptRate = r;
 }
 
 void StelScriptMgr::pauseScript() {
@@ -415,7 +454,52 @@ void StelScriptMgr::resumeScript() {
 
 double StelScriptMgr::getScriptRate()
 {
-	return engine.globalObject().property("scriptRateReadOnly").toNumber();
+	QMutexLocker locker(&scriptRateMutex);
+	return scriptRate;
+}
+
+QScriptValue StelScriptMgr::scriptWait(QScriptContext* context, QScriptEngine* engine)
+{
+	StelScriptMgr& mgr = StelApp::getInstance().getScriptMgr();
+	const double seconds = context->argument(0).toNumber();
+
+	// When recording, waiting means rendering the frames of the waited duration
+	StelFrameRecorder* recorder = StelApp::getInstance().getFrameRecorder();
+	if (seconds>0. && recorder->waitFrames(qRound(seconds/(recorder->getFrameDuration()*mgr.getScriptRate()))))
+		return engine->undefinedValue();
+
+	double remainingMs = seconds * 1000.;
+	// Sleep by small steps to follow the changes of the script rate, pause and abortion
+	QElapsedTimer timer;
+	timer.start();
+	while (remainingMs>0. && !mgr.agent->getAbortScript())
+	{
+		QThread::msleep(qMin(10, qMax(1, (int)remainingMs)));
+		const qint64 elapsed = timer.restart();
+		if (!mgr.agent->getPauseScript())
+			remainingMs -= elapsed * mgr.getScriptRate();
+	}
+	return engine->undefinedValue();
+}
+
+QScriptValue StelScriptMgr::scriptRateGetter(QScriptContext* context, QScriptEngine* engine)
+{
+	Q_UNUSED(context);
+	return QScriptValue(engine, StelApp::getInstance().getScriptMgr().getScriptRate());
+}
+
+QScriptValue StelScriptMgr::scriptBeginTransaction(QScriptContext* context, QScriptEngine* engine)
+{
+	Q_UNUSED(context);
+	StelApp::getInstance().getScriptMgr().commandQueue->beginTransaction();
+	return engine->undefinedValue();
+}
+
+QScriptValue StelScriptMgr::scriptCommitTransaction(QScriptContext* context, QScriptEngine* engine)
+{
+	Q_UNUSED(context);
+	StelApp::getInstance().getScriptMgr().commandQueue->commitTransaction();
+	return engine->undefinedValue();
 }
 
 void StelScriptMgr::debug(const QString& msg)
@@ -425,6 +509,8 @@ void StelScriptMgr::debug(const QString& msg)
 
 void StelScriptMgr::scriptEnded()
 {
+	// The changes of a transaction left open are still applied
+	commandQueue->commitAllTransactions();
 	if (engine.hasUncaughtException())
 	{
 		QString msg = QString("script error: \"%1\" @ line %2").arg(engine.uncaughtException().toString()).arg(engine.uncaughtExceptionLineNumber());
@@ -432,6 +518,8 @@ void StelScriptMgr::scriptEnded()
 		qWarning() << msg;
 	}
 
+	// The frames are only rendered when the script waits for them
+	StelApp::getInstance().getFrameRecorder()->stop();
 	GETSTELMODULE(StelMovementMgr)->setMovementSpeedFactor(1.0);
 	emit(scriptStopped());
 }
@@ -457,6 +545,11 @@ bool StelScriptMgr::strToBool(const QString& str)
 }
 
 bool StelScriptMgr::preprocessScript(const QString &input, QString &output, const QString &scriptDir)
+{
+	return preprocessScript(input, output, scriptDir, NULL);
+}
+
+bool StelScriptMgr::preprocessScript(const QString &input, QString &output, const QString &scriptDir, QList<ScriptFile>* files)
 {
 	QStringList lines = input.split("\n", QString::SkipEmptyParts);
 	QRegExp includeRe("^include\\s*\\(\\s*\"([^\"]+)\"\\s*\\)\\s*;\\s*(//.*)?$");
@@ -482,12 +575,10 @@ bool StelScriptMgr::preprocessScript(const QString &input, QString &output, cons
 				}
 			}
 
-			QFile fic(path);
-			bool ok = fic.open(QIODevice::ReadOnly);
-			if (ok)
+			if (QFileInfo(path).isReadable())
 			{
 				qDebug() << "script include: " << QDir::toNativeSeparators(path);
-				preprocessScript(fic, output, scriptDir);
+				preprocessFile(path, output, scriptDir, files);
 			}
 			else
 			{
@@ -511,10 +602,84 @@ bool StelScriptMgr::preprocessScript(QFile &input, QString& output, const QStrin
 	return preprocessScript(s, output, scriptDir);
 }
 
+StelScriptMgr::ScriptFile StelScriptMgr::getScriptFile(const QString& path)
+{
+	const QFileInfo info(path);
+	const ScriptFile file = {path, info.size(), info.lastModified()};
+	return file;
+}
+
+bool StelScriptMgr::isUpToDate(const PreprocessedScript& script)
+{
+	foreach (const ScriptFile& file, script.files)
+	{
+		const QFileInfo info(file.path);
+		if (!info.exists() || info.size()!=file.size || info.lastModified()!=file.modified)
+			return false;
+	}
+	return true;
+}
+
+bool StelScriptMgr::preprocessFile(const QString& path, QString& output, const QString& scriptDir, QList<ScriptFile>* files)
+{
+	// The includes of a file are searched in the include directory
+	const QString key = path + '\n' + scriptDir;
+	QHash<QString, PreprocessedScript>::ConstIterator cached = preprocessedScripts.constFind(key);
+	if (cached!=preprocessedScripts.constEnd() && isUpToDate(cached.value()))
+	{
+		output += cached.value().source;
+		if (files)
+			*files += cached.value().files;
+		return true;
+	}
+
+	PreprocessedScript script;
+	// Stamped before reading, so that a change while reading is seen next time
+	script.files << getScriptFile(path);
+	QFile fic(path);
+	if (!fic.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "WARNING: cannot open script:" << QDir::toNativeSeparators(path);
+		return false;
+	}
+	bool ok;
+#ifdef ENABLE_STRATOSCRIPT_COMPAT
+	if (path.endsWith(".sts"))
+		ok = preprocessStratoScript(fic, script.source, scriptDir, &script.files);
+	else
+#endif
+	ok = preprocessScript(QString::fromUtf8(fic.readAll()), script.source, scriptDir, &script.files);
+	if (!ok)
+		return false;
+
+	if (preprocessedScripts.size()>=MaxCachedScripts)
+		preprocessedScripts.clear();
+	preprocessedScripts.insert(key, script);
+	output += script.source;
+	if (files)
+		*files += script.files;
+	return true;
+}
+
+QScriptProgram StelScriptMgr::getProgram(const QString& source, const QString& fileName)
+{
+	// The engine parses a program once and keeps it for its next evaluations
+	const QByteArray hash = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Sha1);
+	QHash<QByteArray, QScriptProgram>::ConstIterator cached = programs.constFind(hash);
+	if (cached!=programs.constEnd())
+		return cached.value();
+	if (programs.size()>=MaxCachedScripts)
+		programs.clear();
+	const QScriptProgram program(source, fileName);
+	programs.insert(hash, program);
+	return program;
+}
+
 StelScriptEngineAgent::StelScriptEngineAgent(QScriptEngine *engine) 
 	: QScriptEngineAgent(engine)
+	, isPaused(0)
+	, isAborted(0)
 {
-	isPaused = false;
 }
 
 void StelScriptEngineAgent::positionChange(qint64 scriptId, int lineNumber, int columnNumber)
@@ -523,8 +688,10 @@ void StelScriptEngineAgent::positionChange(qint64 scriptId, int lineNumber, int
 	Q_UNUSED(lineNumber);
 	Q_UNUSED(columnNumber);
 
-	while (isPaused) {
-		// TODO : sleep for 'processEventsInterval' time
-		QCoreApplication::processEvents();
-	}
+	// The script runs in its own thread, so it can just sleep while paused
+	while (getPauseScript() && !getAbortScript())
+		QThread::msleep(10);
+
+	if (getAbortScript() && engine()->isEvaluating())
+		engine()->abortEvaluation();
 }
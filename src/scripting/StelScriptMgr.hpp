@@ -27,15 +27,28 @@
 #include <QTime>
 #include <QTimer>
 #include <QScriptEngineAgent>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
 
 class StelMainScriptAPI;
 class StelScriptEngineAgent;
+class StelScriptCommandQueue;
+class StelScriptThread;
 
 #ifdef ENABLE_SCRIPT_CONSOLE
 class ScriptConsole;
 #endif
 
 //! Manage scripting in Stellarium
+//! The scripts are run in a dedicated StelScriptThread so that long scripts do not
+//! stop the rendering. The objects of the main thread are exposed to the scripts
+//! through a StelScriptCommandQueue, whose commands are executed between two frames.
+//! The preprocessed script files and includes are cached while none of the files they
+//! were made from changes, and the programs are kept by the hash of their source so
+//! that the engine parses a script run again, or its shared includes, only once.
 class StelScriptMgr : public QObject
 {
 	Q_OBJECT
@@ -64,6 +77,15 @@ public:
 	
 	//! Add all the StelModules into the script engine
 	void addModules();
+
+	//! Execute the commands queued by the running script.
+	//! Called by StelApp at the beginning of each frame.
+	void processScriptCommands();
+	//! Execute a script call recorded by the StelSessionRecorder.
+	//! @param object the name of the object in the script engine.
+	//! @param property whether member is a property to write, else the signature of a method to call.
+	//! @return false if the object or its member can not be found.
+	bool replayCommand(const QString& object, bool property, const QByteArray& member, const QVariantList& args);
 public slots:
 	//! Gets a single line name of the script. 
 	//! @param s the file name of the script whose name is to be returned.
@@ -111,6 +133,12 @@ public slots:
 	//! @return false if the given script could not be run, true otherwise
 	bool runPreprocessedScript(const QString& preprocessedScript);
 
+	//! Preprocess a script and prepare its program without running it, so that it starts
+	//! at once when run later, e.g. the next scripts of the playlist of a show.
+	//! @param fileName the location of the file containing the script.
+	//! @return false if the script could not be found or preprocessed.
+	bool prepareScript(const QString& fileName);
+
 	//! Run the script located at the given location
 	//! @param fileName the location of the file containing the script.
 	//! @param includePath the directory to use when searching for include files
@@ -147,7 +175,7 @@ public slots:
 	void resumeScript();
 
 private slots:
-	//! Called at the end of the running threa
+	//! Called at the end of the running thread
 	void scriptEnded();
 signals:
 	//! Notification when a script starts running
@@ -166,8 +194,37 @@ private:
 	//! The name of the action is of the form: "actionScript/<script-path>"
 	void initActions();
 
+	//! A file read to preprocess a script, with its size and modification time when it was read.
+	struct ScriptFile
+	{
+		QString path;
+		qint64 size;
+		QDateTime modified;
+	};
+	//! A cached preprocessed script file.
+	struct PreprocessedScript
+	{
+		QString source;
+		//! The script file and all its includes.
+		QList<ScriptFile> files;
+	};
+	//! The maximum number of preprocessed files and of programs cached.
+	static const int MaxCachedScripts = 64;
+
+	//! Get the absolute path of a script file from its name, empty if not found.
+	static QString getScriptPath(const QString& fileName);
+	static ScriptFile getScriptFile(const QString& path);
+	//! Get whether the files of a preprocessed script did not change since it was cached.
+	static bool isUpToDate(const PreprocessedScript& script);
+	//! Preprocess a script file or an include, SSC or STS, reusing the cached result when its files did not change.
+	//! @param files if not NULL, the files read are added to it.
+	bool preprocessFile(const QString& path, QString& output, const QString& scriptDir, QList<ScriptFile>* files);
+	bool preprocessScript(const QString& input, QString& output, const QString& scriptDir, QList<ScriptFile>* files);
+	//! Get the program of a preprocessed script, shared by all the scripts with the same source.
+	QScriptProgram getProgram(const QString& source, const QString& fileName);
+
 #ifdef ENABLE_STRATOSCRIPT_COMPAT
-	bool preprocessStratoScript(QFile& input, QString& output, const QString& scriptDir);
+	bool preprocessStratoScript(QFile& input, QString& output, const QString& scriptDir, QList<ScriptFile>* files=NULL);
 #endif
 
 	//! This function is for use with getName, getAuthor and getLicense.
@@ -177,12 +234,36 @@ private:
 	//! @return the text following the id and : on a comment line near the top of 
 	//! the script file (i.e. before there is a non-comment line).
 	const QString getHeaderSingleLineCommentText(const QString& s, const QString& id, const QString& notFoundText="");	
+
+	//! Native implementation of core.wait(), sleeping in the script thread.
+	static QScriptValue scriptWait(QScriptContext* context, QScriptEngine* engine);
+	//! Getter of the scriptRateReadOnly global property.
+	static QScriptValue scriptRateGetter(QScriptContext* context, QScriptEngine* engine);
+	//! Native implementations of core.beginTransaction() and core.commitTransaction(), run in the
+	//! script thread, see StelScriptCommandQueue::beginTransaction().
+	static QScriptValue scriptBeginTransaction(QScriptContext* context, QScriptEngine* engine);
+	static QScriptValue scriptCommitTransaction(QScriptContext* context, QScriptEngine* engine);
+
+	//! Only used by the script thread while a script is running.
 	QScriptEngine engine;
 	
-	//! The thread in which scripts are run
 	StelMainScriptAPI *mainAPI;
 
+	//! The thread in which scripts are run
+	StelScriptThread* scriptThread;
+
+	//! The calls from the script thread to the objects of the main thread.
+	StelScriptCommandQueue* commandQueue;
+
+	//! The script rate is read from both threads.
+	mutable QMutex scriptRateMutex;
+	double scriptRate;
+
 	QString scriptFileName;
+
+	//! The preprocessed files by path and include directory, and the programs by hash of their source.
+	QHash<QString, PreprocessedScript> preprocessedScripts;
+	QHash<QByteArray, QScriptProgram> programs;
 	
 	//Script engine agent
 	StelScriptEngineAgent *agent;
@@ -195,14 +276,38 @@ public:
 	explicit StelScriptEngineAgent(QScriptEngine *engine);
 	virtual ~StelScriptEngineAgent() {}
 
-	void setPauseScript(bool pause) { isPaused=pause; }
-	bool getPauseScript() { return isPaused; }
+	void setPauseScript(bool pause) { isPaused.store(pause ? 1 : 0); }
+	bool getPauseScript() { return isPaused.load()!=0; }
+
+	//! Ask the script to stop at the next statement, as the evaluation can only be aborted
+	//! from the script thread. Can be called from any thread.
+	void setAbortScript(bool abort) { isAborted.store(abort ? 1 : 0); }
+	bool getAbortScript() { return isAborted.load()!=0; }
 
 	void positionChange(qint64 scriptId, int lineNumber, int columnNumber);
 	
 private:
-	bool isPaused;
+	QAtomicInt isPaused;
+	QAtomicInt isAborted;
 
 };
 
+//! @class StelScriptThread
+//! The thread evaluating the running script in the engine of the StelScriptMgr.
+class StelScriptThread : public QThread
+{
+public:
+	StelScriptThread(QScriptEngine* engine, QObject* parent=0) : QThread(parent), engine(engine) {}
+
+	//! Set the script to evaluate the next time the thread is started.
+	void setScript(const QScriptProgram& script) { program = script; }
+
+protected:
+	void run() { engine->evaluate(program); }
+
+private:
+	QScriptEngine* engine;
+	QScriptProgram program;
+};
+
 #endif // _STELSCRIPTMGR_HPP_
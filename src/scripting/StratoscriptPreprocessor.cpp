@@ -33,7 +33,7 @@
 #include <QVariant>
 #include <QDir>
 
-bool StelScriptMgr::preprocessStratoScript(QFile& input, QString& output, const QString& scriptDir)
+bool StelScriptMgr::preprocessStratoScript(QFile& input, QString& output, const QString& scriptDir, QList<ScriptFile>* files)
 {
 	int n=0;
 	qDebug() << "Translating stratoscript:";
@@ -68,12 +68,10 @@ bool StelScriptMgr::preprocessStratoScript(QFile& input, QString& output, const
 					}
 				}
 
-				QFile fic(path);
-				bool ok = fic.open(QIODevice::ReadOnly);
-				if (ok)
+				if (QFileInfo(path).isReadable())
 				{
 					qDebug() << "script include: " << QDir::toNativeSeparators(path);
-					preprocessScript(fic, output, scriptDir);
+					preprocessFile(path, output, scriptDir, files);
 				}
 				else
 				{
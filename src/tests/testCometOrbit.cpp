@@ -0,0 +1,63 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testCometOrbit.hpp"
+#include "Orbit.hpp"
+
+#include <QVector>
+#include <cmath>
+
+QTEST_MAIN(TestCometOrbit)
+
+void TestCometOrbit::testBatchedPositions()
+{
+	// Orbits from circular to near parabolic, plus parabolic and hyperbolic ones solved separately
+	const double eccentricities[] = {0., 0.05, 0.2, 0.5, 0.8, 0.95, 0.99, 0.999, 1.0, 1.2, 3.};
+	const int nbEcc = sizeof(eccentricities)/sizeof(eccentricities[0]);
+	const int nbDates = 40;
+	QVector<CometOrbit*> batchOrbits, refOrbits;
+	QVector<double> dates;
+	for (int i=0; i<nbEcc; ++i)
+	{
+		const double e = eccentricities[i];
+		const double q = 0.5+0.3*i;
+		// Mean motion of the elliptical orbits, or W/dt for the parabolic ones
+		const double n = e<1. ? 0.01720209895/std::pow(q/(1.-e), 1.5) : 0.01720209895*std::sqrt(1.5/(q*q*q));
+		for (int j=0; j<nbDates; ++j)
+		{
+			batchOrbits.append(new CometOrbit(q, e, 0.1*i, 0.3*j, 0.7, 2456000., 1000., n, 0., 0., 0.));
+			refOrbits.append(new CometOrbit(q, e, 0.1*i, 0.3*j, 0.7, 2456000., 1000., n, 0., 0., 0.));
+			dates.append(2456000.+(j-nbDates/2)*37.3);
+		}
+	}
+
+	QVector<Vec3d> positions(batchOrbits.size());
+	CometOrbit::positionsAtTimesInVSOP87Coordinates(batchOrbits.constData(), dates.constData(), batchOrbits.size(), positions.data());
+	for (int k=0; k<batchOrbits.size(); ++k)
+	{
+		double ref[3];
+		refOrbits[k]->positionAtTimevInVSOP87Coordinates(dates[k], ref);
+		const Vec3d refPos(ref[0], ref[1], ref[2]);
+		QVERIFY2((positions[k]-refPos).length()<1e-8*refPos.length(), qPrintable(QString("orbit %1").arg(k)));
+		// The velocity used by the comet tails must be updated too
+		QVERIFY((batchOrbits[k]->getVelocity()-refOrbits[k]->getVelocity()).length()<1e-8);
+	}
+	qDeleteAll(batchOrbits);
+	qDeleteAll(refOrbits);
+}
@@ -0,0 +1,109 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testConstellationBoundaryIndex.hpp"
+#include "ConstellationBoundaryIndex.hpp"
+
+#include <cmath>
+
+QTEST_MAIN(TestConstellationBoundaryIndex)
+
+static Vec3f toVec3f(double raDeg, double decDeg)
+{
+	const double ra = raDeg*M_PI/180., dec = decDeg*M_PI/180.;
+	return Vec3f(std::cos(dec)*std::cos(ra), std::cos(dec)*std::sin(ra), std::sin(dec));
+}
+
+static Vec3d toVec3d(double raDeg, double decDeg, double r=1.)
+{
+	const double ra = raDeg*M_PI/180., dec = decDeg*M_PI/180.;
+	return Vec3d(r*std::cos(dec)*std::cos(ra), r*std::cos(dec)*std::sin(ra), r*std::sin(dec));
+}
+
+static std::vector<Vec3f> parallel(double dec, double ra1, double ra2)
+{
+	std::vector<Vec3f> points;
+	for (double ra=ra1;ra<=ra2;ra+=10.)
+		points.push_back(toVec3f(ra, dec));
+	return points;
+}
+
+static std::vector<Vec3f> meridian(double ra, double dec1, double dec2)
+{
+	std::vector<Vec3f> points;
+	for (double dec=dec1;dec<=dec2;dec+=10.)
+		points.push_back(toVec3f(ra, dec));
+	return points;
+}
+
+// A northern cap, a southern cap, and between them an eastern and a western half
+static void buildIndex(ConstellationBoundaryIndex& index)
+{
+	index.addBoundary(parallel(60., 0., 180.), "NOR", "EAS");
+	index.addBoundary(parallel(60., 180., 360.), "WES", "NOR");
+	index.addBoundary(parallel(-30., 0., 180.), "EAS", "SOU");
+	index.addBoundary(parallel(-30., 180., 360.), "SOU", "WES");
+	index.addBoundary(meridian(0., -30., 60.), "EAS", "WES");
+	index.addBoundary(meridian(180., -30., 60.), "WES", "EAS");
+}
+
+void TestConstellationBoundaryIndex::testLocate()
+{
+	ConstellationBoundaryIndex index;
+	buildIndex(index);
+	QVERIFY(index.build());
+	QCOMPARE(index.getConstellation(toVec3d(30., 89.9)), QString("NOR"));
+	QCOMPARE(index.getConstellation(toVec3d(250., 70.)), QString("NOR"));
+	QCOMPARE(index.getConstellation(toVec3d(30., 10.)), QString("EAS"));
+	QCOMPARE(index.getConstellation(toVec3d(179., -29.)), QString("EAS"));
+	QCOMPARE(index.getConstellation(toVec3d(200., 10.)), QString("WES"));
+	QCOMPARE(index.getConstellation(toVec3d(359.5, 59.)), QString("WES"));
+	QCOMPARE(index.getConstellation(toVec3d(100., -50.)), QString("SOU"));
+	QCOMPARE(index.getConstellation(toVec3d(300., -89.9)), QString("SOU"));
+	// On the meridian of vertices, and not normalized
+	QCOMPARE(index.getConstellation(toVec3d(10., 0., 3.)), QString("EAS"));
+	QCOMPARE(index.getConstellation(toVec3d(120., 70., 0.5)), QString("NOR"));
+	QCOMPARE(index.getConstellation(toVec3d(190., -40.)), QString("SOU"));
+}
+
+void TestConstellationBoundaryIndex::testBatch()
+{
+	ConstellationBoundaryIndex index;
+	buildIndex(index);
+	QVERIFY(index.build());
+	QVector<Vec3d> positions;
+	for (int ra=0;ra<360;ra+=7)
+		for (int dec=-85;dec<=85;dec+=17)
+			positions << toVec3d(ra+0.5, dec);
+	const QStringList result = index.getConstellations(positions);
+	QCOMPARE(result.size(), positions.size());
+	for (int i=0;i<positions.size();++i)
+		QCOMPARE(result.at(i), index.getConstellation(positions.at(i)));
+}
+
+void TestConstellationBoundaryIndex::testEmpty()
+{
+	ConstellationBoundaryIndex index;
+	QVERIFY(!index.build());
+	QVERIFY(index.isEmpty());
+	QVERIFY(index.getConstellation(toVec3d(0., 0.)).isEmpty());
+	QVector<Vec3d> positions;
+	positions << toVec3d(0., 0.) << toVec3d(10., 10.);
+	QCOMPARE(index.getConstellations(positions).size(), 2);
+}
@@ -0,0 +1,126 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testEphemerisCache.hpp"
+#include "EphemerisCache.hpp"
+#include "StelJobSystem.hpp"
+
+#include <cmath>
+
+QTEST_MAIN(TestEphemerisCache)
+
+// Lunar-like orbit around the parent body, in AU
+static void circularOrbit(double jd, double xyz[3], void*)
+{
+	const double a = 2.*M_PI*jd/27.32;
+	xyz[0] = 0.00257*std::cos(a);
+	xyz[1] = 0.00257*std::sin(a);
+	xyz[2] = 0.0002*std::sin(1.3*a);
+}
+
+// Position with a fast non smooth oscillation, which cannot be fitted by polynomials
+static void roughOrbit(double jd, double xyz[3], void*)
+{
+	xyz[0] = 1.+std::fabs(std::sin(1000.*jd));
+	xyz[1] = 1.;
+	xyz[2] = 0.;
+}
+
+static double relativeError(const double a[3], const double b[3])
+{
+	const double d = std::sqrt(b[0]*b[0]+b[1]*b[1]+b[2]*b[2]);
+	return std::sqrt((a[0]-b[0])*(a[0]-b[0])+(a[1]-b[1])*(a[1]-b[1])+(a[2]-b[2])*(a[2]-b[2]))/d;
+}
+
+void TestEphemerisCache::testAccuracy()
+{
+	const double tolerance = 1e-9;
+	EphemerisCache cache(&circularOrbit, 4., 12, tolerance);
+	const int nbSteps = 20000;
+	double maxError = 0.;
+	for (int i=0; i<nbSteps; ++i)
+	{
+		const double jd = 2456000.+i*0.01;
+		double cached[3], ref[3];
+		cache.compute(jd, cached);
+		circularOrbit(jd, ref, NULL);
+		maxError = qMax(maxError, relativeError(cached, ref));
+	}
+	QVERIFY2(maxError<tolerance, qPrintable(QString("max relative error %1").arg(maxError)));
+	// Moving time through the windows must be much cheaper than the full series at each step
+	QVERIFY(cache.getWindowLength()>0.);
+	QVERIFY(cache.getNbFullEvaluations()<nbSteps/10);
+}
+
+void TestEphemerisCache::testRandomAccess()
+{
+	EphemerisCache cache(&circularOrbit, 4.);
+	// Dates in different windows, like the sampling of an orbit, are computed directly
+	for (int i=0; i<100; ++i)
+	{
+		double cached[3], ref[3];
+		cache.compute(2456000.+i*10., cached);
+		circularOrbit(2456000.+i*10., ref, NULL);
+		QCOMPARE(cached[0], ref[0]);
+		QCOMPARE(cached[1], ref[1]);
+		QCOMPARE(cached[2], ref[2]);
+	}
+	QCOMPARE(cache.getNbFullEvaluations(), 100);
+}
+
+void TestEphemerisCache::testFallback()
+{
+	EphemerisCache cache(&roughOrbit, 4.);
+	for (int i=0; i<1000; ++i)
+	{
+		const double jd = 2456000.1+i*0.05;
+		double cached[3], ref[3];
+		cache.compute(jd, cached);
+		roughOrbit(jd, ref, NULL);
+		QCOMPARE(cached[0], ref[0]);
+	}
+	QCOMPARE(cache.getWindowLength(), 0.);
+}
+
+void TestEphemerisCache::testPrefetch()
+{
+	StelJobSystem jobs;
+	EphemerisCache cache(&circularOrbit, 4.);
+	double cached[3], ref[3];
+	// The second request in the first window fits it
+	cache.compute(2456000.5, cached);
+	cache.compute(2456000.6, cached);
+	const int nbEvaluations = cache.getNbFullEvaluations();
+
+	// The time runs a day per second near the end of the window: the next one is fitted in the
+	// background and its first request is interpolated
+	cache.prefetch(cache.getWindowLength()+2455999.8, 1., &jobs);
+	cache.waitForPrefetch();
+	const double jd = cache.getWindowLength()+2456000.1;
+	cache.compute(jd, cached);
+	circularOrbit(jd, ref, NULL);
+	QVERIFY(relativeError(cached, ref)<1e-8);
+	QCOMPARE(cache.getNbFullEvaluations(), nbEvaluations);
+
+	// Nothing is fitted while the time stops
+	cache.prefetch(jd, 0., &jobs);
+	cache.waitForPrefetch();
+	cache.compute(jd+20., cached);
+	QCOMPARE(cache.getNbFullEvaluations(), nbEvaluations+1);
+}
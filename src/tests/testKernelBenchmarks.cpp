@@ -0,0 +1,297 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "tests/testKernelBenchmarks.hpp"
+
+#include <QDebug>
+#include <QFile>
+#include <QVariantMap>
+
+#include <cmath>
+
+#include "StelGeodesicGrid.hpp"
+#include "LandscapeMgr.hpp"
+#include "StelJsonParser.hpp"
+#include "StelProjectorClasses.hpp"
+#include "StelUtils.hpp"
+
+QTEST_MAIN(TestKernelBenchmarks)
+
+// Number of points in the simulated star field, about the number of stars of the default catalogs.
+static const int NbSkyPoints = 100000;
+// Level of the geodesic grid used by the default star catalogs.
+static const int GeodesicGridLevel = 7;
+
+StelProjectorP TestKernelBenchmarks::createProjector(const QString& type, float fov)
+{
+	StelProjector::ModelViewTranformP transform(new StelProjector::Mat4dTransform(Mat4d::identity()));
+	StelProjector* prj;
+	if (type=="perspective")
+		prj = new StelProjectorPerspective(transform);
+	else if (type=="stereographic")
+		prj = new StelProjectorStereographic(transform);
+	else if (type=="fisheye")
+		prj = new StelProjectorFisheye(transform);
+	else if (type=="equalArea")
+		prj = new StelProjectorEqualArea(transform);
+	else if (type=="hammer")
+		prj = new StelProjectorHammer(transform);
+	else
+	{
+		Q_ASSERT(type=="cylinder");
+		prj = new StelProjectorCylinder(transform);
+	}
+
+	StelProjector::StelProjectorParams params;
+	params.viewportXywh.set(0, 0, 1920, 1080);
+	params.viewportCenter.set(960.f, 540.f);
+	params.viewportFovDiameter = 1080.f;
+	params.fov = fov;
+	params.zNear = 0.000001f;
+	params.zFar = 500.f;
+	prj->init(params);
+	return StelProjectorP(prj);
+}
+
+void TestKernelBenchmarks::initTestCase()
+{
+	// Uniformly distributed points on the sphere, always the same ones so that the runs can be compared
+	qsrand(42);
+	skyPoints.resize(NbSkyPoints);
+	skyPointsf.resize(NbSkyPoints);
+	for (int i=0;i<NbSkyPoints;++i)
+	{
+		const double lng = 2.*M_PI*qrand()/RAND_MAX;
+		const double lat = std::asin(2.*qrand()/RAND_MAX-1.);
+		StelUtils::spheToRect(lng, lat, skyPoints[i]);
+		skyPointsf[i].set(skyPoints[i][0], skyPoints[i][1], skyPoints[i][2]);
+	}
+
+	// The footprints of the default nebula textures
+	QFile file(QFINDTESTDATA("../../nebulae/default/textures.json"));
+	if (file.open(QIODevice::ReadOnly))
+	{
+		const QVariantList tiles = StelJsonParser::parse(&file).toMap().value("subTiles").toList();
+		foreach (const QVariant& tile, tiles)
+		{
+			QVariantMap shape;
+			shape["worldCoords"] = tile.toMap().value("worldCoords");
+			footprints.append(SphericalRegionP::loadFromQVariant(shape));
+		}
+	}
+	else
+	{
+		qWarning() << "Cannot find the nebula textures, the polygon benchmarks will be skipped";
+	}
+
+	geodesicGrid = new StelGeodesicGrid(GeodesicGridLevel);
+}
+
+void TestKernelBenchmarks::cleanupTestCase()
+{
+	delete geodesicGrid;
+	geodesicGrid = NULL;
+}
+
+void TestKernelBenchmarks::benchmarkProjectArray_data()
+{
+	QTest::addColumn<QString>("projection");
+	QTest::addColumn<bool>("singlePrecision");
+	const char* projections[] = {"perspective", "stereographic", "fisheye", "equalArea", "hammer", "cylinder"};
+	for (unsigned int i=0;i<sizeof(projections)/sizeof(projections[0]);++i)
+	{
+		QTest::newRow(qPrintable(QString("%1 double").arg(projections[i]))) << QString(projections[i]) << false;
+		QTest::newRow(qPrintable(QString("%1 float").arg(projections[i]))) << QString(projections[i]) << true;
+	}
+}
+
+void TestKernelBenchmarks::benchmarkProjectArray()
+{
+	QFETCH(QString, projection);
+	QFETCH(bool, singlePrecision);
+	StelProjectorP prj = createProjector(projection, 60.f);
+	QVector<Vec3f> out(NbSkyPoints);
+
+	// The batch projection must match the projection of each vertex
+	prj->project(NbSkyPoints, skyPoints.constData(), out.data());
+	Vec3d win;
+	for (int i=0;i<NbSkyPoints;i+=97)
+	{
+		if (!prj->project(skyPoints[i], win))
+			continue;
+		QVERIFY(std::fabs(win[0]-out[i][0])<1e-3 && std::fabs(win[1]-out[i][1])<1e-3 && std::fabs(win[2]-out[i][2])<1e-6);
+	}
+
+	if (singlePrecision)
+	{
+		QBENCHMARK {
+			prj->project(NbSkyPoints, skyPointsf.constData(), out.data());
+		}
+	}
+	else
+	{
+		QBENCHMARK {
+			prj->project(NbSkyPoints, skyPoints.constData(), out.data());
+		}
+	}
+}
+
+void TestKernelBenchmarks::benchmarkPolygonIntersection()
+{
+	if (footprints.isEmpty())
+		QSKIP("The nebula textures were not found");
+
+	// A 60x60 degrees non convex view region toward the center of the Milky Way where most Messier objects lie
+	QVector<Vec3d> contour(4);
+	StelUtils::spheToRect(240.*M_PI/180., 10.*M_PI/180., contour[0]);
+	StelUtils::spheToRect(300.*M_PI/180., 10.*M_PI/180., contour[1]);
+	StelUtils::spheToRect(300.*M_PI/180., -50.*M_PI/180., contour[2]);
+	StelUtils::spheToRect(240.*M_PI/180., -50.*M_PI/180., contour[3]);
+	const SphericalRegionP view(new SphericalPolygon(contour));
+
+	int nbIntersecting = 0;
+	foreach (const SphericalRegionP& footprint, footprints)
+		if (!footprint->getIntersection(view)->isEmpty())
+			++nbIntersecting;
+	QVERIFY(nbIntersecting>0);
+
+	QBENCHMARK {
+		foreach (const SphericalRegionP& footprint, footprints)
+			footprint->getIntersection(view);
+	}
+}
+
+void TestKernelBenchmarks::benchmarkPolygonUnion()
+{
+	if (footprints.isEmpty())
+		QSKIP("The nebula textures were not found");
+
+	SphericalRegionP unionRegion = SphericalPolygon::multiUnion(footprints);
+	QVERIFY(unionRegion->getArea()>0.);
+
+	QBENCHMARK {
+		unionRegion = SphericalPolygon::multiUnion(footprints);
+	}
+}
+
+void TestKernelBenchmarks::benchmarkGeodesicSearch_data()
+{
+	QTest::addColumn<float>("fov");
+	QTest::newRow("fov 180") << 180.f;
+	QTest::newRow("fov 60") << 60.f;
+	QTest::newRow("fov 5") << 5.f;
+}
+
+void TestKernelBenchmarks::benchmarkGeodesicSearch()
+{
+	QFETCH(float, fov);
+	StelProjectorP prj = createProjector("stereographic", fov);
+	const QVector<SphericalCap> viewportCaps = prj->getViewportConvexPolygon()->getBoundingSphericalCaps();
+
+	// The last search result is cached by the grid, so look at a different direction each time
+	static const int NbDirections = 64;
+	QVector<QVector<SphericalCap> > views(NbDirections, viewportCaps);
+	for (int i=0;i<NbDirections;++i)
+	{
+		const Mat4d rot = Mat4d::zrotation(2.*M_PI*i/NbDirections) * Mat4d::xrotation(M_PI*(i%8)/8.);
+		for (int j=0;j<views[i].size();++j)
+			views[i][j].n.transfo4d(rot);
+	}
+
+	// Search the zones and walk through them as done when drawing the stars
+	int nbZones = 0;
+	int direction = 0;
+	QBENCHMARK {
+		const GeodesicSearchResult* result = geodesicGrid->search(views[direction], GeodesicGridLevel);
+		direction = (direction+1)%NbDirections;
+		for (int level=0;level<=GeodesicGridLevel;++level)
+		{
+			GeodesicSearchInsideIterator it1(*result, level);
+			for (int zone=it1.next();zone>=0;zone=it1.next())
+				++nbZones;
+			GeodesicSearchBorderIterator it2(*result, level);
+			for (int zone=it2.next();zone>=0;zone=it2.next())
+				++nbZones;
+		}
+	}
+	QVERIFY(nbZones>0);
+}
+
+// Count the zones of the geodesic grid walked through when drawing the stars
+static int countZones(const GeodesicSearchResult* result)
+{
+	int nbZones = 0;
+	for (int level=0;level<=GeodesicGridLevel;++level)
+	{
+		GeodesicSearchInsideIterator it1(*result, level);
+		for (int zone=it1.next();zone>=0;zone=it1.next())
+			++nbZones;
+		GeodesicSearchBorderIterator it2(*result, level);
+		for (int zone=it2.next();zone>=0;zone=it2.next())
+			++nbZones;
+	}
+	return nbZones;
+}
+
+void TestKernelBenchmarks::testHorizonCulling()
+{
+	// Look at the horizon, the zenith being +z and the view centered on -y
+	StelProjectorP prj = createProjector("stereographic", 60.f);
+	QVector<SphericalCap> viewportCaps = prj->getViewportConvexPolygon()->getBoundingSphericalCaps();
+	const Mat4d rot = Mat4d::xrotation(-M_PI_2);
+	for (int i=0;i<viewportCaps.size();++i)
+		viewportCaps[i].n.transfo4d(rot);
+
+	const int viewportZones = countZones(geodesicGrid->search(viewportCaps, GeodesicGridLevel));
+	int lastZones = viewportZones;
+	static const double altitudes[] = {-5., 0., 5., 15.};
+	for (unsigned int i=0;i<sizeof(altitudes)/sizeof(altitudes[0]);++i)
+	{
+		QVector<SphericalCap> caps(viewportCaps);
+		caps.append(LandscapeMgr::getSkyCapAbove(altitudes[i]*M_PI/180.));
+		const int nbZones = countZones(geodesicGrid->search(caps, GeodesicGridLevel));
+		qDebug() << "Horizon at" << altitudes[i] << "degrees:" << viewportZones-nbZones << "of the" << viewportZones << "zones of the viewport are skipped";
+		// The higher the horizon, the more zones are skipped
+		QVERIFY(nbZones<lastZones);
+		lastZones = nbZones;
+	}
+}
+
+void TestKernelBenchmarks::benchmarkJsonParse_data()
+{
+	QTest::addColumn<QString>("fileName");
+	QTest::newRow("nebula textures") << QFINDTESTDATA("../../nebulae/default/textures.json");
+	QTest::newRow("satellites") << QFINDTESTDATA("../../plugins/Satellites/resources/satellites.json");
+}
+
+void TestKernelBenchmarks::benchmarkJsonParse()
+{
+	QFETCH(QString, fileName);
+	QFile file(fileName);
+	if (fileName.isEmpty() || !file.open(QIODevice::ReadOnly))
+		QSKIP("The JSON file was not found");
+	const QByteArray data = file.readAll();
+
+	QVariant result;
+	QBENCHMARK {
+		result = StelJsonParser::parse(data);
+	}
+	QVERIFY(result.canConvert<QVariantMap>());
+}
@@ -0,0 +1,65 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#ifndef _TESTKERNELBENCHMARKS_HPP_
+#define _TESTKERNELBENCHMARKS_HPP_
+
+#include <QObject>
+#include <QTest>
+#include <QByteArray>
+#include <QVector>
+
+#include "StelProjectorType.hpp"
+#include "StelSphereGeometry.hpp"
+
+class StelGeodesicGrid;
+
+//! @class TestKernelBenchmarks
+//! Timings of the geometry and projection kernels called for each frame, on realistic inputs:
+//! a full sky of star positions, the footprints of the default nebula textures and the JSON
+//! files shipped with Stellarium. Run it with the "benchmarks" target, which writes the results
+//! in machine readable form in kernelBenchmarks.xml. Any QTest output option can also be used
+//! when running it directly, e.g. "-o results.csv,csv" or "-tickcounter".
+class TestKernelBenchmarks : public QObject
+{
+Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void benchmarkProjectArray_data();
+	void benchmarkProjectArray();
+	void benchmarkPolygonIntersection();
+	void benchmarkPolygonUnion();
+	void benchmarkGeodesicSearch_data();
+	void benchmarkGeodesicSearch();
+	void testHorizonCulling();
+	void benchmarkJsonParse_data();
+	void benchmarkJsonParse();
+private:
+	//! Create an initialized projector of the given type, looking toward -z.
+	static StelProjectorP createProjector(const QString& type, float fov);
+
+	QVector<Vec3d> skyPoints;
+	QVector<Vec3f> skyPointsf;
+	//! Footprints of the nebula textures, empty if the file could not be found.
+	QList<SphericalRegionP> footprints;
+	StelGeodesicGrid* geodesicGrid;
+};
+
+#endif // _TESTKERNELBENCHMARKS_HPP_
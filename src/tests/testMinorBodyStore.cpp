@@ -0,0 +1,144 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testMinorBodyStore.hpp"
+#include "MinorBodyStore.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cmath>
+
+QTEST_MAIN(TestMinorBodyStore)
+
+void TestMinorBodyStore::testRoundTrip()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	const QString path = dir.path() + "/minor_bodies.dat";
+
+	QVector<MinorBodyStore::Record> records;
+	for (int i=0;i<1000;++i)
+	{
+		MinorBodyStore::Record r;
+		r.name = i==7 ? QString::fromUtf8("Šteflová") : QString("Body %1").arg(i);
+		r.provisionalDesignation = i%2 ? QString("2014 AB%1").arg(i) : QString();
+		r.minorPlanetNumber = i%2 ? 0 : i+1;
+		r.type = i%3==0 ? MinorBodyStore::Comet : MinorBodyStore::Asteroid;
+		r.pericenterDistance = 1.+i*0.001;
+		r.eccentricity = 0.1+i*0.0001;
+		r.timeAtPericenter = 2456000.5+i;
+		r.meanMotion = 0.01/(1.+i);
+		r.absoluteMagnitude = 10.f+i*0.01f;
+		records.append(r);
+	}
+	QVERIFY(MinorBodyStore::write(path, records));
+
+	MinorBodyStore store;
+	QVERIFY(store.open(path));
+	QCOMPARE(store.size(), records.size());
+	for (int i=0;i<records.size();++i)
+	{
+		const MinorBodyStore::Record r = store.getRecord(i);
+		QCOMPARE(store.getName(i), records[i].name);
+		QCOMPARE(r.name, records[i].name);
+		QCOMPARE(r.provisionalDesignation, records[i].provisionalDesignation);
+		QCOMPARE(r.minorPlanetNumber, records[i].minorPlanetNumber);
+		QCOMPARE(r.type, records[i].type);
+		QCOMPARE(r.pericenterDistance, records[i].pericenterDistance);
+		QCOMPARE(r.eccentricity, records[i].eccentricity);
+		QCOMPARE(r.timeAtPericenter, records[i].timeAtPericenter);
+		QCOMPARE(r.meanMotion, records[i].meanMotion);
+		QCOMPARE(r.absoluteMagnitude, records[i].absoluteMagnitude);
+		QCOMPARE(r.orbitGoodDays, records[i].orbitGoodDays);
+	}
+	store.close();
+
+	QVector<MinorBodyStore::Record> empty;
+	QVERIFY(MinorBodyStore::write(path, empty));
+	QVERIFY(store.open(path));
+	QCOMPARE(store.size(), 0);
+}
+
+void TestMinorBodyStore::testInvalidFile()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	const QString path = dir.path() + "/minor_bodies.dat";
+
+	MinorBodyStore store;
+	QVERIFY(!store.open(path));
+
+	QFile file(path);
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	file.write("[sun]\nname = Sun\n");
+	file.close();
+	QVERIFY(!store.open(path));
+	QVERIFY(!store.isOpen());
+
+	// Truncated file
+	QVector<MinorBodyStore::Record> records(10);
+	QVERIFY(MinorBodyStore::write(path, records));
+	QVERIFY(file.open(QIODevice::ReadWrite));
+	file.resize(file.size()-8);
+	file.close();
+	QVERIFY(!store.open(path));
+}
+
+void TestMinorBodyStore::testFromElements()
+{
+	// Elements of (1) Ceres as read by the SolarSystemEditor plugin from the MPC format
+	QVariantHash elements;
+	elements.insert("name", "Ceres");
+	elements.insert("minor_planet_number", 1);
+	elements.insert("parent", "Sun");
+	elements.insert("type", "asteroid");
+	elements.insert("coord_func", "comet_orbit");
+	elements.insert("tex_map", "nomap.png");
+	elements.insert("orbit_Epoch", 2456800.5);
+	elements.insert("orbit_MeanAnomaly", 138.66);
+	elements.insert("orbit_MeanMotion", 0.21400);
+	elements.insert("orbit_SemiMajorAxis", 2.7671);
+	elements.insert("orbit_Eccentricity", 0.0758);
+	elements.insert("orbit_Inclination", 10.593);
+	elements.insert("absolute_magnitude", 3.34);
+	elements.insert("slope_parameter", 0.12);
+
+	MinorBodyStore::Record r;
+	QVERIFY(MinorBodyStore::recordFromElements(elements, r));
+	QCOMPARE(r.name, QString("Ceres"));
+	QCOMPARE(r.minorPlanetNumber, 1);
+	QCOMPARE(r.type, MinorBodyStore::Asteroid);
+	QVERIFY(std::fabs(r.pericenterDistance - 2.7671*(1.-0.0758)) < 1e-12);
+	QVERIFY(std::fabs(r.meanMotion - 0.21400*M_PI/180.) < 1e-12);
+	QVERIFY(std::fabs(r.timeAtPericenter - (2456800.5 - 138.66/0.21400)) < 1e-6);
+	QVERIFY(std::fabs(r.inclination - 10.593*M_PI/180.) < 1e-12);
+	QCOMPARE(r.slopeParameter, 0.12f);
+
+	// The moons and the bodies with their own textures stay in ssystem.ini
+	QVariantHash moon = elements;
+	moon.insert("parent", "Mars");
+	QVERIFY(!MinorBodyStore::recordFromElements(moon, r));
+	QVariantHash textured = elements;
+	textured.insert("tex_map", "ceres.png");
+	QVERIFY(!MinorBodyStore::recordFromElements(textured, r));
+	QVariantHash incomplete = elements;
+	incomplete.remove("orbit_MeanAnomaly");
+	QVERIFY(!MinorBodyStore::recordFromElements(incomplete, r));
+}
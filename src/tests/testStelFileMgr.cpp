@@ -286,3 +286,26 @@ void TestStelFileMgr::testListContentsDirAbs()
 	QVERIFY(resultSetQuery==resultSetQueryExpected);
 }
 
+void TestStelFileMgr::testFindFileInstallDir()
+{
+	// The installation directory is the working directory, as it contains data/ssystem.ini.
+	// Its files are found from the cached directory listings.
+	const QStringList oldPaths = StelFileMgr::getSearchPaths();
+	StelFileMgr::setSearchPaths(QStringList() << StelFileMgr::getInstallationDir());
+	QVERIFY(!StelFileMgr::findFile("data/ssystem.ini").isEmpty());
+	QVERIFY(!StelFileMgr::findFile("data/ssystem.ini", StelFileMgr::File).isEmpty());
+	QVERIFY(StelFileMgr::findFile("data/ssystem.ini", StelFileMgr::Directory).isEmpty());
+	QVERIFY(!StelFileMgr::findFile("data", StelFileMgr::Directory).isEmpty());
+	QVERIFY(StelFileMgr::findFile("data", StelFileMgr::File).isEmpty());
+	QVERIFY(StelFileMgr::findFile("data/notexists").isEmpty());
+	QVERIFY(StelFileMgr::findFile("notexists/notexists").isEmpty());
+	QCOMPARE(StelFileMgr::findFileInAllPaths("data/ssystem.ini", StelFileMgr::File).size(), 1);
+
+	// A file added in the installation directory is found once the cache is cleared
+	QFile f("data/added.txt");
+	QVERIFY(f.open(QIODevice::WriteOnly));
+	f.close();
+	StelFileMgr::clearCache();
+	QVERIFY(!StelFileMgr::findFile("data/added.txt", StelFileMgr::File).isEmpty());
+	StelFileMgr::setSearchPaths(oldPaths);
+}
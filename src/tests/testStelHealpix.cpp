@@ -0,0 +1,96 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testStelHealpix.hpp"
+#include "StelHealpix.hpp"
+
+#include <cmath>
+
+QTEST_MAIN(TestStelHealpix)
+
+static bool isClose(const Vec3d& a, const Vec3d& b)
+{
+	return (a-b).length()<1e-12;
+}
+
+void TestStelHealpix::testBasePixels()
+{
+	QCOMPARE(StelHealpix::getNbPixels(0), (quint64)12);
+	QCOMPARE(StelHealpix::getNbPixels(3), (quint64)768);
+
+	// The northern base pixels are centered at z=2/3, the equatorial ones on the equator
+	const double s = std::sqrt(5./9.)/std::sqrt(2.);
+	QVERIFY(isClose(StelHealpix::pixelPoint(0, 0, 0.5, 0.5), Vec3d(s, s, 2./3.)));
+	QVERIFY(isClose(StelHealpix::pixelPoint(0, 4, 0.5, 0.5), Vec3d(1., 0., 0.)));
+	QVERIFY(isClose(StelHealpix::pixelPoint(0, 6, 0.5, 0.5), Vec3d(-1., 0., 0.)));
+	QVERIFY(isClose(StelHealpix::pixelPoint(0, 8, 0.5, 0.5), Vec3d(s, s, -2./3.)));
+	// Corners on the poles
+	QVERIFY(isClose(StelHealpix::pixelPoint(0, 0, 1., 1.), Vec3d(0., 0., 1.)));
+	QVERIFY(isClose(StelHealpix::pixelPoint(0, 11, 0., 0.), Vec3d(0., 0., -1.)));
+}
+
+void TestStelHealpix::testChildren()
+{
+	// The children of a pixel are its quarters in the nested scheme
+	for (int order=0;order<6;++order)
+	{
+		for (quint64 pix=0;pix<StelHealpix::getNbPixels(order);pix+=7)
+		{
+			for (int c=0;c<4;++c)
+			{
+				const double x = (c&1)*0.5;
+				const double y = (c>>1)*0.5;
+				QVERIFY(isClose(StelHealpix::pixelPoint(order+1, pix*4+c, 0.3, 0.8),
+						StelHealpix::pixelPoint(order, pix, x+0.15, y+0.4)));
+			}
+		}
+	}
+}
+
+void TestStelHealpix::testBoundingCap()
+{
+	for (int order=0;order<4;++order)
+	{
+		for (quint64 pix=0;pix<StelHealpix::getNbPixels(order);pix+=5)
+		{
+			Vec3d center;
+			const double d = StelHealpix::pixelBoundingCap(order, pix, center);
+			for (int i=0;i<=10;++i)
+				for (int j=0;j<=10;++j)
+					QVERIFY(center*StelHealpix::pixelPoint(order, pix, 0.1*i, 0.1*j)>=d);
+		}
+	}
+}
+
+void TestStelHealpix::testVectorToPixel()
+{
+	// The points inside a pixel are found in this pixel
+	for (int order=0;order<6;++order)
+	{
+		for (quint64 pix=0;pix<StelHealpix::getNbPixels(order);pix+=3)
+		{
+			for (int i=1;i<10;i+=2)
+				for (int j=1;j<10;j+=2)
+					QCOMPARE(StelHealpix::vectorToPixel(order, StelHealpix::pixelPoint(order, pix, 0.1*i, 0.1*j)), pix);
+		}
+	}
+	// The vectors need not be normalized
+	QCOMPARE(StelHealpix::vectorToPixel(0, Vec3d(0., 0., 3.)), StelHealpix::vectorToPixel(0, Vec3d(0., 0., 1.)));
+	QCOMPARE(StelHealpix::vectorToPixel(2, Vec3d(2., 0., 0.)), StelHealpix::vectorToPixel(2, Vec3d(1., 0., 0.)));
+}
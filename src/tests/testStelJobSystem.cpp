@@ -0,0 +1,156 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testStelJobSystem.hpp"
+#include "StelJobSystem.hpp"
+
+#include <QAtomicInt>
+#include <QList>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QVector>
+
+QTEST_MAIN(TestStelJobSystem)
+
+namespace
+{
+	struct Square
+	{
+		void operator()(int& x) const {x = x*x;}
+	};
+
+	//! Run a blockingMap from a job of the pool.
+	struct NestedMap
+	{
+		StelJobSystem* jobSystem;
+		void operator()(QVector<int>& values) const {jobSystem->blockingMap(values, Square());}
+	};
+
+	class CountJob : public StelJob
+	{
+	public:
+		CountJob(QAtomicInt* acounter) : counter(acounter) {}
+		virtual void run() {counter->ref();}
+	private:
+		QAtomicInt* counter;
+	};
+
+	//! Keep a thread of the pool busy until released.
+	class BlockingJob : public StelJob
+	{
+	public:
+		BlockingJob(QSemaphore* astarted, QSemaphore* arelease) : started(astarted), release(arelease) {}
+		virtual void run() {started->release(); release->acquire();}
+	private:
+		QSemaphore* started;
+		QSemaphore* release;
+	};
+}
+
+void TestStelJobSystem::testBlockingMap()
+{
+	StelJobSystem jobSystem;
+	QVector<int> values;
+	for (int i=0; i<10000; ++i)
+		values << i;
+	jobSystem.blockingMap(values, Square(), 100);
+	for (int i=0; i<values.size(); ++i)
+		QCOMPARE(values.at(i), i*i);
+
+	// Too few items for several jobs, and a container other than QVector
+	QList<int> list;
+	list << 1 << 2 << 3;
+	jobSystem.blockingMap(list, Square(), 10);
+	QCOMPARE(list, QList<int>() << 1 << 4 << 9);
+
+	QVector<int> empty;
+	jobSystem.blockingMap(empty, Square());
+	QVERIFY(empty.isEmpty());
+}
+
+void TestStelJobSystem::testNestedGroups()
+{
+	// The jobs waiting for their own jobs must not block the pool, even with a single thread
+	const int maxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+	QThreadPool::globalInstance()->setMaxThreadCount(1);
+	StelJobSystem jobSystem;
+	QVector<QVector<int> > tables(16);
+	for (int t=0; t<tables.size(); ++t)
+	{
+		for (int i=0; i<100; ++i)
+			tables[t] << t+i;
+	}
+	const NestedMap nested = {&jobSystem};
+	jobSystem.blockingMap(tables, nested);
+	for (int t=0; t<tables.size(); ++t)
+	{
+		for (int i=0; i<100; ++i)
+			QCOMPARE(tables.at(t).at(i), (t+i)*(t+i));
+	}
+	QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+}
+
+void TestStelJobSystem::testCancel()
+{
+	const int maxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+	QThreadPool::globalInstance()->setMaxThreadCount(1);
+	StelJobSystem jobSystem;
+	QSemaphore started, release;
+	QAtomicInt counter(0);
+	{
+		StelJobGroup blocking;
+		jobSystem.submit(blocking, new BlockingJob(&started, &release));
+		started.acquire();
+
+		// The only thread is busy, so the jobs of this group can't start before the cancel
+		StelJobGroup group;
+		for (int i=0; i<10; ++i)
+			jobSystem.submit(group, new CountJob(&counter));
+		QVERIFY(!group.isFinished());
+		group.cancel();
+		QVERIFY(group.isFinished());
+		group.wait();
+		release.release();
+	}
+	QCOMPARE(counter.load(), 0);
+
+	// Waiting runs the pending jobs in the calling thread
+	StelJobGroup group;
+	for (int i=0; i<10; ++i)
+		jobSystem.submit(group, new CountJob(&counter));
+	group.wait();
+	QVERIFY(group.isFinished());
+	QCOMPARE(counter.load(), 10);
+	QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+}
+
+void TestStelJobSystem::testMainThreadJobs()
+{
+	StelJobSystem jobSystem;
+	QAtomicInt counter(0);
+	for (int i=0; i<3; ++i)
+		jobSystem.submitToMainThread(new CountJob(&counter));
+	// With no budget one job is run at each call
+	jobSystem.runMainThreadJobs(0);
+	QCOMPARE(counter.load(), 1);
+	jobSystem.runMainThreadJobs(1000);
+	QCOMPARE(counter.load(), 3);
+	jobSystem.runMainThreadJobs(0);
+	QCOMPARE(counter.load(), 3);
+}
@@ -30,6 +30,49 @@
 
 QTEST_MAIN(TestStelJsonParser);
 
+// Rebuild the QVariant tree from the events, to compare with the regular parser
+class TreeBuilderHandler : public StelJsonHandler
+{
+public:
+	virtual void startObject() {stack.append(QVariantMap()); keys.append(QString());}
+	virtual void key(const QString& name) {keys.last() = name;}
+	virtual void endObject() {keys.removeLast(); add(stack.takeLast());}
+	virtual void startArray() {stack.append(QVariantList()); keys.append(QString());}
+	virtual void endArray() {keys.removeLast(); add(stack.takeLast());}
+	virtual void value(const QVariant& v) {add(v);}
+
+	QVariant result;
+	int nbEvents() const {return events;}
+
+	TreeBuilderHandler() : events(0) {;}
+private:
+	void add(const QVariant& v)
+	{
+		++events;
+		if (stack.isEmpty())
+		{
+			result = v;
+			return;
+		}
+		QVariant& parent = stack.last();
+		if (parent.type()==QVariant::Map)
+		{
+			QVariantMap m = parent.toMap();
+			m.insert(keys.last(), v);
+			parent = m;
+		}
+		else
+		{
+			QVariantList l = parent.toList();
+			l.append(v);
+			parent = l;
+		}
+	}
+	QList<QVariant> stack;
+	QStringList keys;
+	int events;
+};
+
 void TestStelJsonParser::initTestCase()
 {
 	largeJsonBuff = "{\"test1\": {\"worldCoords\": [[[-0.5,0.5],[0.5,0.5],[0.5,-0.5],[-0.5,-0.5]], [[-0.2,-0.2],[0.2,-0.2],[0.2,0.2],[-0.2,0.2]]]}, \
@@ -113,6 +156,53 @@ void TestStelJsonParser::testIterator()
 	buf.close();
 }
 
+void TestStelJsonParser::testStreaming()
+{
+	QBuffer buf;
+	buf.setData(largeJsonBuff);
+	buf.open(QIODevice::ReadOnly);
+	TreeBuilderHandler handler;
+	StelJsonParser::parse(&buf, &handler);
+	QCOMPARE(handler.result, StelJsonParser::parse(largeJsonBuff));
+	buf.close();
+
+	// The default handler just skips the content
+	buf.setData("{\"a\": [1, 2.5, \"str\", true, null], \"b\": {}}");
+	buf.open(QIODevice::ReadOnly);
+	StelJsonHandler skipper;
+	StelJsonParser::parse(&buf, &skipper);
+	QVERIFY(buf.atEnd());
+	buf.close();
+
+	buf.setData(listJsonBuff);
+	buf.open(QIODevice::ReadOnly);
+	const QVariantList list = StelJsonParser::parse(listJsonBuff).toList();
+	int tot = 0;
+	JsonListIterator iter = StelJsonParser::initListIterator(&buf);
+	while (iter.hasNext())
+	{
+		TreeBuilderHandler elemHandler;
+		iter.next(&elemHandler);
+		QCOMPARE(elemHandler.result, list.at(tot));
+		++tot;
+	}
+	QCOMPARE(tot, 3);
+	buf.close();
+
+	bool wasCatched = false;
+	try
+	{
+		buf.setData("{\"a\": [1, 2}");
+		buf.open(QIODevice::ReadOnly);
+		StelJsonParser::parse(&buf, &skipper);
+	}
+	catch (std::runtime_error&)
+	{
+		wasCatched = true;
+	}
+	QVERIFY(wasCatched);
+}
+
 void TestStelJsonParser::testErrors()
 {
 	bool wasCatched = false;
@@ -142,3 +232,15 @@ void TestStelJsonParser::benchmarkParse()
 		result = StelJsonParser::parse(&buf);
 	}
 }
+
+void TestStelJsonParser::benchmarkParseStreaming()
+{
+	QBuffer buf;
+	buf.setData(largeJsonBuff);
+	buf.open(QIODevice::ReadOnly);
+	StelJsonHandler handler;
+	QBENCHMARK {
+		buf.seek(0);
+		StelJsonParser::parse(&buf, &handler);
+	}
+}
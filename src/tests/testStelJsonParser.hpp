@@ -30,7 +30,9 @@ private slots:
 	void initTestCase();
 	void testBase();
 	void testIterator();
+	void testStreaming();
 	void benchmarkParse();
+	void benchmarkParseStreaming();
 	void testErrors();
 private:
 	QByteArray largeJsonBuff;
@@ -0,0 +1,93 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "tests/testStelNameIndex.hpp"
+#include "StelNameIndex.hpp"
+
+#include <QStringList>
+
+QTEST_MAIN(TestStelNameIndex)
+
+static StelNameIndex makeIndex(const QStringList& names)
+{
+	StelNameIndex index;
+	for (int i=0;i<names.size();++i)
+		index.insert(names.at(i), i);
+	return index;
+}
+
+void TestStelNameIndex::testStartingWith()
+{
+	const QStringList names = QStringList() << "Sirius" << "Betelgeuse" << "Rigel" << "Bellatrix" << "Regulus" << "Sirrah";
+	const StelNameIndex index = makeIndex(names);
+	QCOMPARE(index.size(), 6);
+
+	// The results are in the alphabetical order of the names
+	QCOMPARE(index.findStartingWith("be"), QVector<int>() << 3 << 1);
+	QCOMPARE(index.findStartingWith("SIR"), QVector<int>() << 0 << 5);
+	QCOMPARE(index.findStartingWith("sir", 1), QVector<int>() << 0);
+	QVERIFY(index.findStartingWith("x").isEmpty());
+	QCOMPARE(index.findStartingWith("").size(), 6);
+}
+
+void TestStelNameIndex::testContaining()
+{
+	const QStringList names = QStringList() << "Sirius" << "Betelgeuse" << "Rigel" << "Bellatrix" << "Regulus" << "Sirrah";
+	StelNameIndex index = makeIndex(names);
+
+	// Only listed once even when the string appears several times in the name
+	QCOMPARE(index.findContaining("e"), QVector<int>() << 3 << 1 << 4 << 2);
+	QCOMPARE(index.findContaining("GEL"), QVector<int>() << 2);
+	QCOMPARE(index.findContaining("us"), QVector<int>() << 1 << 4 << 0);
+	QCOMPARE(index.findContaining("us", 2), QVector<int>() << 1 << 4);
+	QVERIFY(index.findContaining("xyz").isEmpty());
+
+	// Same results as a linear search
+	for (char c='a';c<='z';++c)
+	{
+		QVector<int> expected;
+		QStringList sorted = names;
+		sorted.sort(Qt::CaseInsensitive);
+		foreach (const QString& name, sorted)
+		{
+			if (name.contains(QChar(c), Qt::CaseInsensitive))
+				expected << names.indexOf(name);
+		}
+		QCOMPARE(index.findContaining(QString(c)), expected);
+	}
+
+	// The suffixes are rebuilt after an insertion
+	index.insert("Aldebaran", 6);
+	QCOMPARE(index.findContaining("bar"), QVector<int>() << 6);
+	index.clear();
+	QVERIFY(index.findContaining("e").isEmpty());
+}
+
+void TestStelNameIndex::benchmarkContaining()
+{
+	StelNameIndex index;
+	for (int i=0;i<100000;++i)
+		index.insert(QString("(%1) Minor planet %2").arg(i).arg(i*7919%100003), i);
+	index.findContaining("x");
+	QBENCHMARK
+	{
+		index.findContaining("1234", 10);
+	}
+}
@@ -0,0 +1,103 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+#include "tests/testStelRiseSet.hpp"
+#include "StelRiseSet.hpp"
+
+#include <cmath>
+
+QTEST_MAIN(TestStelRiseSet)
+
+static const double siderealDay = 0.99726957;
+
+static Vec3d equatorialPos(double ra, double dec)
+{
+	return Vec3d(std::cos(dec)*std::cos(ra), std::cos(dec)*std::sin(ra), std::sin(dec));
+}
+
+void TestStelRiseSet::testHourAngle()
+{
+	// On the equator everything stays 12 hours above the horizon
+	QVERIFY(std::fabs(StelRiseSet::hourAngle(0., 0., 0.)-M_PI/2.)<1e-12);
+	QVERIFY(std::fabs(StelRiseSet::hourAngle(0., 0., 1.)-M_PI/2.)<1e-12);
+
+	const double lat = 60.*M_PI/180.;
+	QCOMPARE(StelRiseSet::hourAngle(lat, 0., 40.*M_PI/180.), StelRiseSet::AlwaysAbove);
+	QCOMPARE(StelRiseSet::hourAngle(lat, 0., -40.*M_PI/180.), StelRiseSet::AlwaysBelow);
+
+	double decs[50], hourAngles[50];
+	for (int i=0; i<50; ++i)
+		decs[i] = (i-25)*M_PI/50.;
+	StelRiseSet::hourAngles(lat, -0.01, 50, decs, hourAngles);
+	for (int i=0; i<50; ++i)
+		QCOMPARE(hourAngles[i], StelRiseSet::hourAngle(lat, -0.01, decs[i]));
+}
+
+void TestStelRiseSet::testEvents()
+{
+	const double jdStart = 2456000.5;
+	const double lst = 1.;
+	StelRiseSet riseSet;
+	riseSet.setObserver(jdStart, lst, siderealDay, 0., 0.);
+
+	Vec3d pos[3];
+	// Transits half a sidereal day after the start of the day
+	pos[0] = equatorialPos(lst+M_PI, 0.);
+	// On the meridian at the start of the day, so it set during the day before
+	pos[1] = equatorialPos(lst, 0.);
+	// Circumpolar and never rising objects from the north pole
+	pos[2] = equatorialPos(lst, 0.5);
+	StelRiseSet::Events events[3];
+	riseSet.computeEvents(2, pos, events);
+
+	QCOMPARE(events[0].type, StelRiseSet::Normal);
+	QVERIFY(std::fabs(events[0].transit-(jdStart+0.5*siderealDay))<1e-9);
+	QVERIFY(std::fabs(events[0].rise-(jdStart+0.25*siderealDay))<1e-9);
+	QVERIFY(std::fabs(events[0].set-(jdStart+0.75*siderealDay))<1e-9);
+
+	QCOMPARE(events[1].type, StelRiseSet::Normal);
+	QVERIFY(std::fabs(events[1].transit-jdStart)<1e-9);
+	QVERIFY(std::fabs(events[1].set-(jdStart+0.25*siderealDay))<1e-9);
+	QVERIFY(std::fabs(events[1].rise-(jdStart+0.75*siderealDay))<1e-9);
+
+	riseSet.setObserver(jdStart, lst, siderealDay, M_PI/2., 0.);
+	riseSet.computeEvents(1, &pos[2], &events[2]);
+	QCOMPARE(events[2].type, StelRiseSet::Circumpolar);
+	riseSet.setObserver(jdStart, lst, siderealDay, -M_PI/2., 0.);
+	riseSet.computeEvents(1, &pos[2], &events[2]);
+	QCOMPARE(events[2].type, StelRiseSet::NeverRises);
+}
+
+void TestStelRiseSet::testCache()
+{
+	const double jdStart = 2456000.5;
+	StelRiseSet riseSet;
+	riseSet.setObserver(jdStart, 0., siderealDay, 0.8, 0.);
+	const double transit = riseSet.getEvents("star", equatorialPos(1., 0.2)).transit;
+
+	// The events are kept for the same day, even if the position given differs
+	QCOMPARE(riseSet.getEvents("star", equatorialPos(2., 0.2)).transit, transit);
+	riseSet.setObserver(jdStart, 0., siderealDay, 0.8, 0.);
+	QCOMPARE(riseSet.getEvents("star", equatorialPos(2., 0.2)).transit, transit);
+
+	// And recomputed when the day changes
+	riseSet.setObserver(jdStart+1., 0., siderealDay, 0.8, 0.);
+	QVERIFY(std::fabs(riseSet.getEvents("star", equatorialPos(2., 0.2)).transit-
+			  (jdStart+1.+siderealDay/(2.*M_PI)*2.))<1e-9);
+}
@@ -147,6 +147,25 @@ void TestStelSphericalGeometry::testSphericalCap()
 	QVERIFY(h3.contains(h3));
 	QVERIFY(h4.contains(h4));
 	QVERIFY(h5.contains(h5));
+
+	// The batch tests must give the same results as the tests on each cap and point
+	const SphericalCap caps[7] = {h0, h1, h2, h3, h4, h5, h6};
+	const Vec3d points[4] = {p0, p1, p2, p3};
+	SphericalCapArray capArray;
+	for (int i=0;i<7;++i)
+		capArray.append(caps[i]);
+	QCOMPARE(capArray.size(), 7);
+	for (int i=0;i<7;++i)
+	{
+		bool intersect[7];
+		capArray.intersects(caps[i], 0, 7, intersect);
+		bool inside[4];
+		caps[i].containsPoints(points, 4, inside);
+		for (int j=0;j<7;++j)
+			QCOMPARE(intersect[j], caps[j].intersects(caps[i]));
+		for (int j=0;j<4;++j)
+			QCOMPARE(inside[j], caps[i].contains(points[j]));
+	}
 }
 
 void TestStelSphericalGeometry::benchmarkSphericalCap()
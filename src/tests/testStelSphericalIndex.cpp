@@ -24,6 +24,7 @@
 #include <QTest>
 
 #include <stdexcept>
+#include <cmath>
 
 #include "StelSphereGeometry.hpp"
 #include "StelUtils.hpp"
@@ -36,9 +37,19 @@ class TestRegionObject : public StelRegionObject
 	public:
 		TestRegionObject(SphericalRegionP reg) : region(reg) {;}
 		virtual SphericalRegionP getRegion() const {return region;}
+		virtual Vec3d getPointInRegion() const {return region->getPointInside();}
 		SphericalRegionP region;
 };
 
+class TestPointObject : public StelRegionObject
+{
+	public:
+		TestPointObject(const Vec3d& apos) : pos(apos) {;}
+		virtual SphericalRegionP getRegion() const {return SphericalRegionP(new SphericalPoint(pos));}
+		virtual Vec3d getPointInRegion() const {return pos;}
+		Vec3d pos;
+};
+
 void TestStelSphericalIndex::initTestCase()
 {
 }
@@ -101,3 +112,119 @@ void TestStelSphericalIndex::testBase()
 	QVERIFY(countFunc.count==30000);
 }
 
+
+void TestStelSphericalIndex::testPointsInRegion()
+{
+	StelSphericalIndex grid(10);
+	// A grid of points every degree, so that the tree is split several times
+	int nbNear = 0;
+	const SphericalCap cap(Vec3d(1,0,0), std::cos(5.*M_PI/180.));
+	for (int ra=0;ra<360;++ra)
+	{
+		for (int de=-89;de<90;++de)
+		{
+			Vec3d v;
+			StelUtils::spheToRect(ra*M_PI/180., de*M_PI/180., v);
+			grid.insert(StelRegionObjectP(new TestPointObject(v)));
+			if (cap.contains(v))
+				++nbNear;
+		}
+	}
+	QList<StelRegionObjectP> result = grid.getPointsInRegion(&cap);
+	QCOMPARE(result.size(), nbNear);
+	foreach (const StelRegionObjectP& obj, result)
+		QVERIFY(cap.contains(obj->getPointInRegion()));
+
+	const SphericalCap emptyCap(Vec3d(0,0,1), std::cos(0.1*M_PI/180.));
+	QVERIFY(grid.getPointsInRegion(&emptyCap).isEmpty());
+}
+
+void TestStelSphericalIndex::testFrozen()
+{
+	StelSphericalIndex grid(10);
+	for (int ra=0;ra<360;ra+=2)
+	{
+		for (int de=-88;de<90;de+=2)
+		{
+			Vec3d v;
+			StelUtils::spheToRect(ra*M_PI/180., de*M_PI/180., v);
+			grid.insert(StelRegionObjectP(new TestPointObject(v)));
+			grid.insert(StelRegionObjectP(new TestRegionObject(SphericalRegionP(new SphericalCap(v, std::cos(3.*M_PI/180.))))));
+		}
+	}
+	const SphericalCap cap(Vec3d(1,0,0), std::cos(20.*M_PI/180.));
+	const SphericalCap smallCap(Vec3d(0,0,1), std::cos(4.*M_PI/180.));
+
+	CountFuncObject intersecting, points, boundingCaps, contained, all;
+	grid.processIntersectingRegions(&cap, intersecting);
+	grid.processIntersectingPointInRegions(&cap, points);
+	grid.processBoundingCapIntersectingRegions(smallCap, boundingCaps);
+	grid.processContainedRegions(&cap, contained);
+	grid.processAll(all);
+	const int nbPoints = grid.getPointsInRegion(&cap).size();
+
+	// The flat layout must give the same results as the tree
+	grid.freeze();
+	QVERIFY(grid.isFrozen());
+	CountFuncObject intersectingFrozen, pointsFrozen, boundingCapsFrozen, containedFrozen, allFrozen;
+	grid.processIntersectingRegions(&cap, intersectingFrozen);
+	grid.processIntersectingPointInRegions(&cap, pointsFrozen);
+	grid.processBoundingCapIntersectingRegions(smallCap, boundingCapsFrozen);
+	grid.processContainedRegions(&cap, containedFrozen);
+	grid.processAll(allFrozen);
+	QCOMPARE(intersectingFrozen.count, intersecting.count);
+	QCOMPARE(pointsFrozen.count, points.count);
+	QCOMPARE(boundingCapsFrozen.count, boundingCaps.count);
+	QCOMPARE(containedFrozen.count, contained.count);
+	QCOMPARE(allFrozen.count, all.count);
+	QCOMPARE(grid.getPointsInRegion(&cap).size(), nbPoints);
+	QVERIFY(points.count>0 && points.count<all.count);
+
+	// Inserting goes back to the tree
+	grid.insert(StelRegionObjectP(new TestPointObject(Vec3d(1,0,0))));
+	QVERIFY(!grid.isFrozen());
+	QCOMPARE(grid.getPointsInRegion(&cap).size(), nbPoints+1);
+}
+
+// Collect the processed objects, merged in order after a parallel traversal
+struct CollectFuncObject
+{
+	void operator()(const StelRegionObject* obj)
+	{
+		objects.append(obj);
+	}
+	void merge(const CollectFuncObject& other)
+	{
+		objects += other.objects;
+	}
+	QList<const StelRegionObject*> objects;
+};
+
+void TestStelSphericalIndex::testParallel()
+{
+	StelSphericalIndex grid(10);
+	for (int ra=0;ra<360;ra+=2)
+	{
+		for (int de=-88;de<90;de+=2)
+		{
+			Vec3d v;
+			StelUtils::spheToRect(ra*M_PI/180., de*M_PI/180., v);
+			grid.insert(StelRegionObjectP(new TestRegionObject(SphericalRegionP(new SphericalCap(v, std::cos(1.*M_PI/180.))))));
+		}
+	}
+	grid.freeze();
+	const SphericalCap cap(Vec3d(1,0,0), std::cos(60.*M_PI/180.));
+
+	CollectFuncObject sequential, parallel;
+	grid.processIntersectingRegions(&cap, sequential);
+	grid.processIntersectingRegionsParallel(&cap, parallel);
+	QVERIFY(!sequential.objects.isEmpty());
+	QCOMPARE(parallel.objects.toSet(), sequential.objects.toSet());
+	QCOMPARE(parallel.objects.size(), sequential.objects.size());
+
+	CollectFuncObject sequentialCaps, parallelCaps;
+	grid.processBoundingCapIntersectingRegions(cap, sequentialCaps);
+	grid.processBoundingCapIntersectingRegionsParallel(cap, parallelCaps);
+	QCOMPARE(parallelCaps.objects.toSet(), sequentialCaps.objects.toSet());
+	QCOMPARE(parallelCaps.objects.size(), sequentialCaps.objects.size());
+}
@@ -31,6 +31,9 @@ Q_OBJECT
 private slots:
 	void initTestCase();
 	void testBase();
+	void testPointsInRegion();
+	void testFrozen();
+	void testParallel();
 private:
 };
 
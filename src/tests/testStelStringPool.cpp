@@ -0,0 +1,67 @@
+/*
+ * Stellarium
+ * Copyright (C) 2014 Stellarium Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335, USA.
+ */
+
+
+#include "tests/testStelStringPool.hpp"
+#include "StelStringPool.hpp"
+
+QTEST_MAIN(TestStelStringPool)
+
+void TestStelStringPool::testIntern()
+{
+	const StelInternedString empty;
+	QVERIFY(empty.isEmpty());
+	QVERIFY(empty.toString().isNull());
+	QVERIFY(StelInternedString(QString()).isEmpty());
+
+	// The same string gives the same handle, and is stored once
+	const StelInternedString sirius("Sirius");
+	const int nbStrings = StelStringPool::getNbStrings();
+	QCOMPARE(StelInternedString(QString("Sir") + "ius"), sirius);
+	QCOMPARE(StelStringPool::getNbStrings(), nbStrings);
+	QCOMPARE(sirius.toString(), QString("Sirius"));
+
+	const StelInternedString deneb("Deneb");
+	QVERIFY(deneb != sirius);
+	QCOMPARE(StelStringPool::getNbStrings(), nbStrings+1);
+
+	// The strings are stored in UTF-8
+	const QString alpha = QString::fromUtf8("\xce\xb1 Centauri");
+	const StelInternedString alphaCen(alpha);
+	QCOMPARE(alphaCen.toString(), alpha);
+	QCOMPARE(QByteArray(alphaCen.utf8()), alpha.toUtf8());
+
+	// find() does not add the string
+	QCOMPARE(StelInternedString::find("Deneb"), deneb);
+	QVERIFY(StelInternedString::find("Vega not interned").isEmpty());
+	QCOMPARE(StelStringPool::getNbStrings(), nbStrings+2);
+}
+
+void TestStelStringPool::testManyStrings()
+{
+	// Enough strings to fill several chunks and grow the hash table
+	QVector<StelInternedString> handles;
+	for (int i=0;i<50000;++i)
+		handles.append(StelInternedString(QString("HIP %1").arg(i)));
+	for (int i=0;i<50000;i+=997)
+	{
+		QCOMPARE(handles.at(i).toString(), QString("HIP %1").arg(i));
+		QCOMPARE(StelInternedString::find(QString("HIP %1").arg(i)), handles.at(i));
+	}
+}
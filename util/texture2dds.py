@@ -0,0 +1,167 @@
+#!/usr/bin/python
+# Copyright (C) 2014 Stellarium Developers
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA
+# 02110-1335, USA.
+
+
+# Tool which converts an image (landscape panorama, sky tile...) into a BC1 or BC3 compressed
+# texture with all its mipmap levels, in a DDS or KTX file which Stellarium can upload directly.
+# The image is flipped vertically, as Stellarium expects the rows of the compressed textures to be
+# stored from the bottom to the top of the image like OpenGL does.
+# Files compressed in the BC7 or ETC2 formats by other encoders can be loaded by Stellarium too,
+# as long as they are flipped the same way.
+#
+# Usage: texture2dds.py [--alpha] image.png image.dds|image.ktx
+
+import sys
+import struct
+import numpy
+from optparse import OptionParser
+try:
+	from PIL import Image
+except ImportError:
+	import Image
+
+GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1
+GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3
+GL_RGBA = 0x1908
+
+def toBlocks(a):
+	"""Split a HxWxC array into a Nx16xC array of 4x4 blocks, replicating the edges if needed."""
+	h, w, c = a.shape
+	ph = (h + 3) // 4 * 4
+	pw = (w + 3) // 4 * 4
+	a = numpy.pad(a, ((0, ph - h), (0, pw - w), (0, 0)), 'edge')
+	a = a.reshape(ph // 4, 4, pw // 4, 4, c).transpose(0, 2, 1, 3, 4)
+	return a.reshape(-1, 16, c)
+
+def encodeColorBlocks(rgb):
+	"""Encode the Nx16x3 color blocks in the BC1 format, using the bounding box of the colors as end points."""
+	rgb = rgb.astype(numpy.float32)
+	hi = rgb.max(axis=1)
+	lo = rgb.min(axis=1)
+	# Inset the box a little to reduce the error on the end points
+	inset = (hi - lo) / 16.
+	hi = numpy.clip(hi - inset, 0, 255)
+	lo = numpy.clip(lo + inset, 0, 255)
+
+	def to565(c):
+		r = numpy.rint(c[:, 0] * 31 / 255.).astype(numpy.uint32)
+		g = numpy.rint(c[:, 1] * 63 / 255.).astype(numpy.uint32)
+		b = numpy.rint(c[:, 2] * 31 / 255.).astype(numpy.uint32)
+		return (r << 11) | (g << 5) | b
+
+	def from565(v):
+		r = ((v >> 11) & 31) * 255. / 31
+		g = ((v >> 5) & 63) * 255. / 63
+		b = (v & 31) * 255. / 31
+		return numpy.stack([r, g, b], axis=1)
+
+	c0 = to565(hi)
+	c1 = to565(lo)
+	# The four colors mode is used when c0 > c1
+	swap = c0 < c1
+	c0, c1 = numpy.where(swap, c1, c0), numpy.where(swap, c0, c1)
+	e0 = from565(c0)
+	e1 = from565(c1)
+	palette = numpy.stack([e0, e1, (2 * e0 + e1) / 3., (e0 + 2 * e1) / 3.], axis=1)
+	dist = ((rgb[:, :, None, :] - palette[:, None, :, :]) ** 2).sum(axis=3)
+	indices = dist.argmin(axis=2).astype(numpy.uint32)
+	indices[c0 == c1] = 0
+	bits = (indices << (2 * numpy.arange(16, dtype=numpy.uint32))).sum(axis=1).astype(numpy.uint32)
+
+	out = numpy.zeros((rgb.shape[0], 8), numpy.uint8)
+	out[:, 0:2] = c0.astype('<u2').view(numpy.uint8).reshape(-1, 2)
+	out[:, 2:4] = c1.astype('<u2').view(numpy.uint8).reshape(-1, 2)
+	out[:, 4:8] = bits.astype('<u4').view(numpy.uint8).reshape(-1, 4)
+	return out
+
+def encodeAlphaBlocks(alpha):
+	"""Encode the Nx16 alpha blocks in the BC3 (DXT5) alpha format, with 8 interpolated values."""
+	alpha = alpha.astype(numpy.float32)
+	a0 = alpha.max(axis=1)
+	a1 = alpha.min(axis=1)
+	# Palette order of the 8 values mode: a0, a1, then 6 values from a0 to a1
+	weights = numpy.array([0, 7, 1, 2, 3, 4, 5, 6], numpy.float32) / 7.
+	palette = a0[:, None] * (1 - weights[None, :]) + a1[:, None] * weights[None, :]
+	indices = numpy.abs(alpha[:, :, None] - palette[:, None, :]).argmin(axis=2).astype(numpy.uint64)
+	indices[a0 == a1] = 0
+	bits = (indices << (3 * numpy.arange(16, dtype=numpy.uint64))).sum(axis=1).astype(numpy.uint64)
+
+	out = numpy.zeros((alpha.shape[0], 8), numpy.uint8)
+	out[:, 0] = a0.astype(numpy.uint8)
+	out[:, 1] = a1.astype(numpy.uint8)
+	out[:, 2:8] = bits.astype('<u8').view(numpy.uint8).reshape(-1, 8)[:, 0:6]
+	return out
+
+def compress(im, withAlpha):
+	a = numpy.asarray(im.convert('RGBA'), numpy.uint8)
+	blocks = toBlocks(a)
+	color = encodeColorBlocks(blocks[:, :, 0:3])
+	if not withAlpha:
+		return color.tobytes()
+	return numpy.concatenate([encodeAlphaBlocks(blocks[:, :, 3]), color], axis=1).tobytes()
+
+def mipmapLevels(im):
+	levels = [im]
+	while im.size != (1, 1):
+		im = im.resize((max(1, im.size[0] // 2), max(1, im.size[1] // 2)), Image.ANTIALIAS)
+		levels.append(im)
+	return levels
+
+def writeDds(f, width, height, withAlpha, levels):
+	flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000
+	f.write(b'DDS ')
+	f.write(struct.pack('<7I', 124, flags, height, width, len(levels[0]), 0, len(levels)))
+	f.write(struct.pack('<11I', *([0] * 11)))
+	f.write(struct.pack('<2I4s5I', 32, 0x4, b'DXT5' if withAlpha else b'DXT1', 0, 0, 0, 0, 0))
+	f.write(struct.pack('<5I', 0x1000 | 0x8 | 0x400000, 0, 0, 0, 0))
+	for data in levels:
+		f.write(data)
+
+def writeKtx(f, width, height, withAlpha, levels):
+	f.write(b'\xabKTX 11\xbb\r\n\x1a\n')
+	glFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT if withAlpha else GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+	f.write(struct.pack('<13I', 0x04030201, 0, 1, 0, glFormat, GL_RGBA, width, height, 0, 0, 1, len(levels), 0))
+	for data in levels:
+		# The sizes of the blocks are multiples of 4 so no padding is needed
+		f.write(struct.pack('<I', len(data)))
+		f.write(data)
+
+def main():
+	parser = OptionParser(usage="%prog [options] image output.dds|output.ktx")
+	parser.add_option("-a", "--alpha", action="store_true", dest="alpha", default=False,
+	                  help="use the BC3 format to keep the alpha channel (default is BC1 with no alpha)")
+	parser.add_option("-n", "--no-mipmaps", action="store_false", dest="mipmaps", default=True,
+	                  help="store only the full resolution image")
+	(options, args) = parser.parse_args()
+	if len(args) != 2:
+		parser.print_help()
+		sys.exit(1)
+
+	im = Image.open(args[0]).convert('RGBA').transpose(Image.FLIP_TOP_BOTTOM)
+	images = mipmapLevels(im) if options.mipmaps else [im]
+	levels = [compress(level, options.alpha) for level in images]
+
+	f = open(args[1], 'wb')
+	if args[1].lower().endswith('.ktx'):
+		writeKtx(f, im.size[0], im.size[1], options.alpha, levels)
+	else:
+		writeDds(f, im.size[0], im.size[1], options.alpha, levels)
+	f.close()
+
+if __name__ == '__main__':
+	main()